@@ -0,0 +1,238 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <numeric>
+#include <stdexcept>
+#include <geodesk/synth/GolGenerator.h>
+
+namespace geodesk::bench {
+
+namespace {
+
+std::atomic<uint64_t> sink;
+
+/// Writes a synthetic GOL of 16 leaf tiles (some 140K features)
+/// to the temp directory and returns its path
+std::string generateGol(uint64_t seed)
+{
+    GolGenerator::Settings settings;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.35, 43.75);
+    settings.seed = seed;
+    std::string fileName = (std::filesystem::temp_directory_path() /
+        ("geodesk-bench-" + std::to_string(seed) + ".gol")).string();
+    GolGenerator(settings).generate(fileName.c_str());
+    return fileName;
+}
+
+} // namespace
+
+
+void doNotOptimize(uint64_t value)
+{
+    sink.fetch_add(value, std::memory_order_relaxed);
+}
+
+
+void appendJsonString(std::string& out, const std::string& s)
+{
+    out += '"';
+    for (char ch : s)
+    {
+        switch (ch)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        default:
+            if (static_cast<unsigned char>(ch) < 0x20)
+            {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", ch);
+                out += esc;
+            }
+            else
+            {
+                out += ch;
+            }
+        }
+    }
+    out += '"';
+}
+
+void appendNumber(std::string& out, double value)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.3f", value);
+    out += buf;
+}
+
+
+void appendJsonContext(const BenchmarkEnvironment& env, std::string& out)
+{
+    out += "\"context\": {\n    \"gol\": ";
+    appendJsonString(out, env.golFile);
+    out += ",\n    \"bbox\": ";
+    appendJsonString(out, env.boundsSpec);
+    out += ",\n    \"build\": ";
+    #ifdef NDEBUG
+    appendJsonString(out, "release");
+    #else
+    appendJsonString(out, "debug");
+    #endif
+    out += ",\n    \"multithreaded\": ";
+    #ifdef GEODESK_MULTITHREADED
+    out += "true";
+    #else
+    out += "false";
+    #endif
+    out += "\n  }";
+}
+
+
+BenchmarkEnvironment BenchmarkEnvironment::fromEnv()
+{
+    BenchmarkEnvironment env;
+    const char* minTime = getenv("GEODESK_BENCH_MIN_TIME");
+    if (minTime) env.minTime = std::max(atof(minTime), 1.0) / 1000;
+
+    const char* bbox = getenv("GEODESK_BENCH_BBOX");
+    if (bbox)
+    {
+        double w, s, e, n;
+        if (sscanf(bbox, "%lf,%lf,%lf,%lf", &w, &s, &e, &n) != 4)
+        {
+            throw std::runtime_error("GEODESK_BENCH_BBOX must be \"west,south,east,north\"");
+        }
+        env.bounds = Box::ofWSEN(w, s, e, n);
+        env.boundsSpec = bbox;
+    }
+
+    const char* gol = getenv("GEODESK_BENCH_GOL");
+    if (gol)
+    {
+        std::string_view spec(gol);
+        if (spec.starts_with("synthetic"))
+        {
+            uint64_t seed = 1;
+            if (spec.size() > 9)
+            {
+                if (spec[9] != ':')
+                {
+                    throw std::runtime_error("GEODESK_BENCH_GOL must be a file or \"synthetic[:seed]\"");
+                }
+                seed = strtoull(gol + 10, nullptr, 10);
+            }
+            env.golFile = generateGol(seed);
+        }
+        else
+        {
+            env.golFile = gol;
+        }
+        env.world = std::make_unique<Features>(env.golFile.c_str());
+    }
+    return env;
+}
+
+
+BenchmarkResult BenchmarkSuite::measure(const Entry& entry,
+    BenchmarkRun& run, double minTime)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr size_t MIN_RUNS = 5;
+    constexpr size_t MAX_RUNS = 1'000'000;
+
+    BenchmarkResult result;
+    result.name = entry.name;
+    result.unit = entry.unit;
+    result.itemsPerRun = run();       // warm-up (also faults in the tiles)
+
+    std::vector<double> samples;
+    double total = 0;
+    while ((total < minTime || samples.size() < MIN_RUNS) && samples.size() < MAX_RUNS)
+    {
+        auto start = Clock::now();
+        doNotOptimize(run());
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+        samples.push_back(elapsed.count() * 1e9);
+        total += elapsed.count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    result.runs = samples.size();
+    result.minNanos = samples.front();
+    result.medianNanos = samples[samples.size() / 2];
+    result.meanNanos = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    return result;
+}
+
+
+std::vector<BenchmarkResult> BenchmarkSuite::run(BenchmarkEnvironment& env,
+    const std::vector<std::string>& filters, bool verbose)
+{
+    std::vector<BenchmarkResult> results;
+    for (const Entry& entry : benchmarks_)
+    {
+        if (!filters.empty() && std::none_of(filters.begin(), filters.end(),
+            [&entry](const std::string& f) { return entry.name.find(f) != std::string::npos; }))
+        {
+            continue;
+        }
+        if (entry.needsGol && !env.world)
+        {
+            if (verbose) fprintf(stderr, "%-40s skipped (GEODESK_BENCH_GOL not set)\n", entry.name.c_str());
+            continue;
+        }
+
+        BenchmarkRun run = entry.setup(env);
+        BenchmarkResult result = measure(entry, run, env.minTime);
+        if (verbose)
+        {
+            fprintf(stderr, "%-40s %12.3f ms %10.2f ns/%s  (%llu %s, %llu runs)\n",
+                result.name.c_str(), result.medianNanos / 1e6,
+                result.nanosPerItem(), result.unit.c_str(),
+                static_cast<unsigned long long>(result.itemsPerRun), result.unit.c_str(),
+                static_cast<unsigned long long>(result.runs));
+        }
+        results.push_back(std::move(result));
+    }
+    return results;
+}
+
+
+void BenchmarkSuite::writeJson(const BenchmarkEnvironment& env,
+    const std::vector<BenchmarkResult>& results, std::string& out)
+{
+    out += "{\n  ";
+    appendJsonContext(env, out);
+    out += ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult& r = results[i];
+        out += i ? ",\n    {" : "\n    {";
+        out += "\"name\": ";
+        appendJsonString(out, r.name);
+        out += ", \"unit\": ";
+        appendJsonString(out, r.unit);
+        out += ", \"runs\": " + std::to_string(r.runs);
+        out += ", \"items_per_run\": " + std::to_string(r.itemsPerRun);
+        out += ", \"min_ns\": ";
+        appendNumber(out, r.minNanos);
+        out += ", \"median_ns\": ";
+        appendNumber(out, r.medianNanos);
+        out += ", \"mean_ns\": ";
+        appendNumber(out, r.meanNanos);
+        out += ", \"ns_per_item\": ";
+        appendNumber(out, r.nanosPerItem());
+        out += "}";
+    }
+    out += "\n  ]\n}\n";
+}
+
+} // namespace geodesk::bench
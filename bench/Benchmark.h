@@ -0,0 +1,183 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <geodesk/geodesk.h>
+
+namespace geodesk::bench {
+
+/**
+ * The inputs shared by all benchmarks, taken from the environment:
+ *
+ *   GEODESK_BENCH_GOL       the GOL to query (benchmarks that need
+ *                           one are skipped if this isn't set), or
+ *                           "synthetic[:seed]" to generate one with
+ *                           GolGenerator (results are then comparable
+ *                           across machines)
+ *   GEODESK_BENCH_BBOX      the area to query, as "west,south,east,north"
+ *                           in degrees (default: the whole GOL)
+ *   GEODESK_BENCH_MIN_TIME  minimum time to spend on each benchmark,
+ *                           in milliseconds (default: 1000)
+ */
+struct BenchmarkEnvironment
+{
+    static BenchmarkEnvironment fromEnv();
+
+    std::string golFile;
+    std::unique_ptr<Features> world;
+    Box bounds = Box::ofWorld();
+    std::string boundsSpec;
+    double minTime = 1.0;     // seconds
+};
+
+/**
+ * A single run of a benchmark. Returns the number of items (features,
+ * coordinates, bytes...) it has processed, which is used to derive
+ * the per-item cost.
+ */
+using BenchmarkRun = std::function<uint64_t()>;
+
+/**
+ * Prepares the data for a benchmark (outside of the timed section)
+ * and returns the function to be timed.
+ */
+using BenchmarkSetup = std::function<BenchmarkRun(BenchmarkEnvironment&)>;
+
+struct BenchmarkResult
+{
+    std::string name;
+    std::string unit;
+    uint64_t runs = 0;
+    uint64_t itemsPerRun = 0;
+    double minNanos = 0;        // per run
+    double medianNanos = 0;
+    double meanNanos = 0;
+
+    double nanosPerItem() const
+    {
+        return itemsPerRun ? medianNanos / itemsPerRun : 0;
+    }
+};
+
+class BenchmarkSuite
+{
+public:
+    /**
+     * Registers a benchmark.
+     *
+     * @param name      "group/kernel", used for filtering
+     * @param unit      what the items returned by a run are
+     * @param needsGol  whether the benchmark is skipped without a GOL
+     */
+    void add(std::string name, std::string unit, bool needsGol, BenchmarkSetup setup)
+    {
+        benchmarks_.push_back({ std::move(name), std::move(unit), needsGol, std::move(setup) });
+    }
+
+    /**
+     * Runs all benchmarks whose name contains one of the given
+     * filters (or all of them, if there are no filters).
+     */
+    std::vector<BenchmarkResult> run(BenchmarkEnvironment& env,
+        const std::vector<std::string>& filters, bool verbose);
+
+    static void writeJson(const BenchmarkEnvironment& env,
+        const std::vector<BenchmarkResult>& results, std::string& out);
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string unit;
+        bool needsGol;
+        BenchmarkSetup setup;
+    };
+
+    static BenchmarkResult measure(const Entry& entry, BenchmarkRun& run, double minTime);
+
+    std::vector<Entry> benchmarks_;
+};
+
+void addQueryBenchmarks(BenchmarkSuite& suite);
+void addGeometryBenchmarks(BenchmarkSuite& suite);
+void addFormatBenchmarks(BenchmarkSuite& suite);
+
+/// Keeps the compiler from discarding a result that is otherwise unused
+void doNotOptimize(uint64_t value);
+
+void appendJsonString(std::string& out, const std::string& s);
+void appendNumber(std::string& out, double value);
+/// Appends the "context" member that describes the build and the GOL
+void appendJsonContext(const BenchmarkEnvironment& env, std::string& out);
+
+/**
+ * How the workloads of the scaling benchmark share a GOL:
+ *
+ *   SHARED    all consumer threads use the same Features object
+ *   SEPARATE  each consumer thread opens its own FeatureStore (from
+ *             a hard link to the GOL, since stores are shared by path)
+ */
+enum class StoreSharing { SHARED, SEPARATE };
+
+struct ScalingResult
+{
+    std::string workload;
+    StoreSharing sharing;
+    int consumers;
+    int executors;
+    uint64_t runs = 0;          // by all consumers
+    double throughput = 0;      // runs per second
+    double p50Nanos = 0;        // latency of a single run
+    double p99Nanos = 0;
+    double cpuUtilization = 0;  // process CPU time / wall time
+    double efficiency = 0;      // throughput / (consumers * single-consumer
+                                // throughput with the same executors)
+};
+
+/**
+ * Runs each concurrency workload whose name contains one of the
+ * filters with 1, 2, 4 ... maxConsumers threads that issue queries,
+ * and 1, 2, 4 ... maxExecutors threads in the query executor.
+ */
+std::vector<ScalingResult> runScalingBenchmarks(BenchmarkEnvironment& env,
+    const std::vector<std::string>& filters, int maxConsumers, int maxExecutors,
+    bool verbose);
+
+void writeScalingJson(const BenchmarkEnvironment& env,
+    const std::vector<ScalingResult>& results, std::string& out);
+
+struct ReplayResult
+{
+    uint64_t index = 0;         // the query's position in the log
+    std::string query;          // consumption, view, filters and GOQL
+    uint64_t results = 0;
+    int passes = 0;
+    double medianNanos = 0;
+    double recordedNanos = 0;   // the latency when the log was recorded
+};
+
+/**
+ * Replays the queries of a QueryRecorder log against the benchmark
+ * GOL with the given number of consumer threads, repeating the log
+ * until the minimum time has passed. Queries that can't be replayed
+ * (see RecordedQuery::isReplayable()) are skipped.
+ */
+std::vector<ReplayResult> runReplay(BenchmarkEnvironment& env,
+    const char* logFile, int consumers, bool verbose);
+
+void writeReplayJson(const BenchmarkEnvironment& env,
+    const std::vector<ReplayResult>& results, std::string& out);
+
+/// Prints the total and percentile latencies of a replay and, given
+/// the JSON of a replay of the same log by another build, the `top`
+/// queries whose latency changed the most
+void printReplaySummary(const std::vector<ReplayResult>& results,
+    const char* baselineFile, int top);
+
+} // namespace geodesk::bench
@@ -0,0 +1,430 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <clarisma/sys/ProcessCounters.h>
+#include <clarisma/thread/Threads.h>
+
+// The workloads of the former concurrency test (test_concur), run by
+// a growing number of threads to show where throughput stops scaling.
+// Each workload visits the features in the benchmark bounds.
+
+namespace geodesk::bench {
+
+namespace {
+
+struct Workload
+{
+    const char* name;
+    int64_t (*run)(const Features& world);
+};
+
+/// The centroid of the largest country (or the origin, if the
+/// GOL has no countries)
+Coordinate largestCountryCentroid(const Features& world)
+{
+    Coordinate centroid;
+    double largestArea = -1;
+    for (Feature country : world("a[boundary=administrative][admin_level=2]"))
+    {
+        double area = country.area();
+        if (area > largestArea)
+        {
+            centroid = country.centroid();
+            largestArea = area;
+        }
+    }
+    return centroid;
+}
+
+const Workload WORKLOADS[] =
+{
+    { "areas_containing_largest_country_centroid_count", [](const Features& world) -> int64_t
+    {
+        return world("a").containing(largestCountryCentroid(world)).count();
+    }},
+    { "centroid_hash", [](const Features& world) -> int64_t
+    {
+        int64_t hash = 0;
+        for (Feature f : world)
+        {
+            Coordinate c = f.centroid();
+            hash ^= c.x;
+            hash ^= c.y;
+        }
+        return hash;
+    }},
+    { "id_hash", [](const Features& world) -> int64_t
+    {
+        int64_t hash = 0;
+        for (Feature f : world) hash ^= f.id();
+        return hash;
+    }},
+    { "italian_restaurant_count", [](const Features& world) -> int64_t
+    {
+        return world("na[amenity=restaurant][cuisine=italian]").count();
+    }},
+    { "member_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature parent : world) count += parent.members().count();
+        return count;
+    }},
+    { "member_iter_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature parent : world)
+        {
+            for (Feature child : parent.members()) count++;
+        }
+        return count;
+    }},
+    { "parent_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature child : world) count += child.parents().count();
+        return count;
+    }},
+    { "parent_iter_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature child : world)
+        {
+            for (Feature parent : child.parents()) count++;
+        }
+        return count;
+    }},
+    { "parents_of_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature child : world) count += world.parentsOf(child).count();
+        return count;
+    }},
+    { "parent_relations_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature child : world) count += child.parents().relations().count();
+        return count;
+    }},
+    { "parent_relations_of_count", [](const Features& world) -> int64_t
+    {
+        Features relations = world.relations();
+        int64_t count = 0;
+        for (Feature child : world) count += relations.parentsOf(child).count();
+        return count;
+    }},
+    { "parent_ways_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature child : world) count += child.parents().ways().count();
+        return count;
+    }},
+    { "parent_ways_of_count", [](const Features& world) -> int64_t
+    {
+        Features ways = world.ways();
+        int64_t count = 0;
+        for (Feature child : world) count += ways.parentsOf(child).count();
+        return count;
+    }},
+    { "relation_member_role_len", [](const Features& world) -> int64_t
+    {
+        int64_t len = 0;
+        for (Feature parent : world.relations())
+        {
+            for (Feature child : parent.members()) len += child.role().size();
+        }
+        return len;
+    }},
+    { "street_crossing_count", [](const Features& world) -> int64_t
+    {
+        Nodes crossings = world("n[highway=crossing]");
+        int64_t count = 0;
+        for (Feature street : world("w[highway]")) count += crossings.nodesOf(street).count();
+        return count;
+    }},
+    { "tags_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature f : world) count += f.tags().size();
+        return count;
+    }},
+    { "tags_str_len", [](const Features& world) -> int64_t
+    {
+        int64_t totalLen = 0;
+        for (Feature f : world)
+        {
+            for (Tag tag : f.tags())
+            {
+                std::string strValue = tag.value();
+                totalLen += static_cast<int64_t>(strValue.size());
+            }
+        }
+        return totalLen;
+    }},
+    { "tags_int_sum", [](const Features& world) -> int64_t
+    {
+        int64_t sum = 0;
+        for (Feature f : world)
+        {
+            for (Tag tag : f.tags()) sum += static_cast<int>(tag.value());
+        }
+        return sum;
+    }},
+    { "waynode_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature way : world.ways()) count += way.nodes().count();
+        return count;
+    }},
+    { "waynode_parent_ways_count", [](const Features& world) -> int64_t
+    {
+        int64_t count = 0;
+        for (Feature way : world.ways())
+        {
+            for (Feature node : way.nodes()) count += node.parents().ways().count();
+        }
+        return count;
+    }},
+    { "xy_hash", [](const Features& world) -> int64_t
+    {
+        int64_t hash = 0;
+        for (Feature f : world)
+        {
+            hash ^= f.x();
+            hash ^= f.y();
+        }
+        return hash;
+    }},
+};
+
+/// Opens one store per consumer thread. Since stores are shared by
+/// their canonical path, each one is opened from its own hard link
+/// to the GOL. Returns no stores if the links can't be created
+/// (e.g. because the file system doesn't support them).
+class SeparateStores
+{
+public:
+    SeparateStores(const BenchmarkEnvironment& env, int count)
+    {
+        std::error_code error;
+        for (int i = 0; i < count; i++)
+        {
+            std::string link = env.golFile + ".scaling-" + std::to_string(i) + ".gol";
+            std::filesystem::remove(link, error);
+            std::filesystem::create_hard_link(env.golFile, link, error);
+            if (error)
+            {
+                fprintf(stderr, "Unable to link %s (%s), skipping separate stores\n",
+                    link.c_str(), error.message().c_str());
+                close();
+                return;
+            }
+            links_.push_back(link);
+            worlds_.push_back(Features(link.c_str())(env.bounds));
+        }
+    }
+
+    ~SeparateStores() { close(); }
+
+    bool isEmpty() const { return worlds_.empty(); }
+    const Features& operator[](int i) const { return worlds_[i]; }
+
+    void setExecutor(const std::shared_ptr<QueryExecutor>& executor)
+    {
+        for (Features& world : worlds_) world.store()->setExecutor(executor);
+    }
+
+private:
+    void close()
+    {
+        worlds_.clear();        // stores must be closed before their files
+        std::error_code error;  // can be removed (on Windows)
+        for (const std::string& link : links_) std::filesystem::remove(link, error);
+        links_.clear();
+    }
+
+    std::vector<std::string> links_;
+    std::vector<Features> worlds_;
+};
+
+/// Runs the workload on the given number of threads for at least
+/// minTime seconds; world(i) returns the Features of thread i
+template<typename WorldOf>
+ScalingResult measure(const Workload& workload, int consumers, double minTime,
+    WorldOf world)
+{
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::vector<double>> latencies(consumers);
+    std::atomic<int> ready = 0;
+    std::atomic<bool> started = false;
+    std::vector<std::thread> threads;
+    threads.reserve(consumers);
+    for (int i = 0; i < consumers; i++)
+    {
+        threads.emplace_back([&, i]()
+        {
+            const Features& features = world(i);
+            std::vector<double>& samples = latencies[i];
+            ready++;
+            while (!started.load(std::memory_order_acquire)) std::this_thread::yield();
+            Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(minTime));
+            do
+            {
+                Clock::time_point start = Clock::now();
+                doNotOptimize(static_cast<uint64_t>(workload.run(features)));
+                samples.push_back(std::chrono::duration<double, std::nano>(
+                    Clock::now() - start).count());
+            }
+            while (Clock::now() < end);
+        });
+    }
+    while (ready < consumers) std::this_thread::yield();
+
+    clarisma::ProcessCounters countersStart = clarisma::ProcessCounters::current();
+    Clock::time_point start = Clock::now();
+    started.store(true, std::memory_order_release);
+    for (std::thread& thread : threads) thread.join();
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = (clarisma::ProcessCounters::current() - countersStart).cpuSeconds;
+
+    std::vector<double> samples;
+    for (const std::vector<double>& s : latencies) samples.insert(samples.end(), s.begin(), s.end());
+    std::sort(samples.begin(), samples.end());
+
+    ScalingResult result;
+    result.workload = workload.name;
+    result.consumers = consumers;
+    result.runs = samples.size();
+    result.throughput = samples.size() / wall;
+    result.p50Nanos = samples[samples.size() / 2];
+    result.p99Nanos = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+    result.cpuUtilization = cpu / wall;
+    return result;
+}
+
+std::vector<int> powersOfTwoUpTo(int max)
+{
+    std::vector<int> counts;
+    for (int n = 1; n < max; n *= 2) counts.push_back(n);
+    counts.push_back(max);
+    return counts;
+}
+
+const char* sharingName(StoreSharing sharing)
+{
+    return sharing == StoreSharing::SHARED ? "shared" : "separate";
+}
+
+} // namespace
+
+
+std::vector<ScalingResult> runScalingBenchmarks(BenchmarkEnvironment& env,
+    const std::vector<std::string>& filters, int maxConsumers, int maxExecutors,
+    bool verbose)
+{
+    std::vector<ScalingResult> results;
+    if (!env.world)
+    {
+        if (verbose) fprintf(stderr, "Scaling benchmarks skipped (GEODESK_BENCH_GOL not set)\n");
+        return results;
+    }
+    if (maxConsumers <= 0) maxConsumers = clarisma::Threads::hardwareConcurrency();
+    if (maxExecutors <= 0) maxExecutors = clarisma::Threads::hardwareConcurrency();
+
+    Features shared = (*env.world)(env.bounds);
+    SeparateStores separate(env, maxConsumers);
+
+    for (const Workload& workload : WORKLOADS)
+    {
+        std::string_view name(workload.name);
+        if (!filters.empty() && std::none_of(filters.begin(), filters.end(),
+            [name](const std::string& f) { return name.find(f) != std::string::npos; }))
+        {
+            continue;
+        }
+        for (StoreSharing sharing : { StoreSharing::SHARED, StoreSharing::SEPARATE })
+        {
+            if (sharing == StoreSharing::SEPARATE && separate.isEmpty()) continue;
+            for (int executors : powersOfTwoUpTo(maxExecutors))
+            {
+                auto executor = std::make_shared<QueryExecutor>(executors, 0);
+                shared.store()->setExecutor(executor);
+                separate.setExecutor(executor);
+
+                double singleThroughput = 0;
+                for (int consumers : powersOfTwoUpTo(maxConsumers))
+                {
+                    #ifndef GEODESK_MULTITHREADED
+                    // Without atomic refcounts, a store must not be
+                    // used by more than one consumer thread
+                    if (sharing == StoreSharing::SHARED && consumers > 1) break;
+                    #endif
+                    ScalingResult result = sharing == StoreSharing::SHARED ?
+                        measure(workload, consumers, env.minTime,
+                            [&shared](int) -> const Features& { return shared; }) :
+                        measure(workload, consumers, env.minTime,
+                            [&separate](int i) -> const Features& { return separate[i]; });
+                    result.sharing = sharing;
+                    result.executors = executors;
+                    if (consumers == 1) singleThroughput = result.throughput;
+                    result.efficiency = result.throughput / (consumers * singleThroughput);
+                    if (verbose)
+                    {
+                        fprintf(stderr, "%-48s %-8s c=%-3d e=%-3d %10.1f runs/s  "
+                            "p50 %10.3f ms  p99 %10.3f ms  cpu %6.2f  eff %5.2f\n",
+                            workload.name, sharingName(sharing), consumers, executors,
+                            result.throughput, result.p50Nanos / 1e6, result.p99Nanos / 1e6,
+                            result.cpuUtilization, result.efficiency);
+                    }
+                    results.push_back(std::move(result));
+                }
+            }
+        }
+    }
+    shared.store()->setExecutor(FeatureStore::sharedExecutor());
+    separate.setExecutor(FeatureStore::sharedExecutor());
+    return results;
+}
+
+
+void writeScalingJson(const BenchmarkEnvironment& env,
+    const std::vector<ScalingResult>& results, std::string& out)
+{
+    out += "{\n  ";
+    appendJsonContext(env, out);
+    out += ",\n  \"scaling\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ScalingResult& r = results[i];
+        out += i ? ",\n    {" : "\n    {";
+        out += "\"workload\": ";
+        appendJsonString(out, r.workload);
+        out += ", \"sharing\": ";
+        appendJsonString(out, sharingName(r.sharing));
+        out += ", \"consumers\": " + std::to_string(r.consumers);
+        out += ", \"executors\": " + std::to_string(r.executors);
+        out += ", \"runs\": " + std::to_string(r.runs);
+        out += ", \"runs_per_sec\": ";
+        appendNumber(out, r.throughput);
+        out += ", \"p50_ns\": ";
+        appendNumber(out, r.p50Nanos);
+        out += ", \"p99_ns\": ";
+        appendNumber(out, r.p99Nanos);
+        out += ", \"cpu_utilization\": ";
+        appendNumber(out, r.cpuUtilization);
+        out += ", \"efficiency\": ";
+        appendNumber(out, r.efficiency);
+        out += "}";
+    }
+    out += "\n  ]\n}\n";
+}
+
+} // namespace geodesk::bench
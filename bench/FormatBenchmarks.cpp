@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <geodesk/format/GeoJsonWriter.h>
+#include <geodesk/format/WktWriter.h>
+
+namespace geodesk::bench {
+
+namespace {
+
+/**
+ * A Buffer that discards its contents whenever it is full, so the
+ * writers are measured without the cost of growing a buffer or
+ * writing to a file.
+ */
+class DiscardingBuffer : public clarisma::Buffer
+{
+public:
+    DiscardingBuffer()
+    {
+        buf_ = data_;
+        p_ = buf_;
+        end_ = buf_ + sizeof(data_);
+    }
+
+    void filled(char* p) override
+    {
+        bytesWritten_ += p - buf_;
+        p_ = buf_;
+    }
+
+    void flush(char* p) override { filled(p); }
+
+    uint64_t bytesWritten() const { return bytesWritten_; }
+
+private:
+    uint64_t bytesWritten_ = 0;
+    char data_[64 * 1024];
+};
+
+template<typename Writer>
+BenchmarkSetup write()
+{
+    return [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        constexpr size_t MAX_FEATURES = 250'000;
+        std::vector<FeaturePtr> features;
+        for (Feature f : (*env.world)(env.bounds))
+        {
+            features.push_back(f.ptr());
+            if (features.size() == MAX_FEATURES) break;
+        }
+        FeatureStore* store = env.world->store();
+        return [store, features]()
+        {
+            DiscardingBuffer buf;
+            Writer writer(&buf);
+            writer.writeHeader();
+            for (FeaturePtr f : features) writer.writeFeature(store, f);
+            writer.writeFooter();
+            writer.flush();
+            return buf.bytesWritten();
+        };
+    };
+}
+
+} // namespace
+
+
+void addFormatBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("format/geojson", "bytes", true, write<GeoJsonWriter>());
+    suite.add("format/wkt", "bytes", true, write<WktWriter>());
+}
+
+} // namespace geodesk::bench
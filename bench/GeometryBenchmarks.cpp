@@ -0,0 +1,220 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+
+namespace geodesk::bench {
+
+namespace {
+
+std::vector<WayPtr> collectWays(BenchmarkEnvironment& env)
+{
+    std::vector<WayPtr> ways;
+    for (Feature f : (*env.world)("w")(env.bounds)) ways.push_back(WayPtr(f.ptr()));
+    return ways;
+}
+
+/// The area relations in the benchmark bounds with the largest
+/// bounding boxes (which tend to be those with the most members)
+std::vector<RelationPtr> collectLargestAreaRelations(BenchmarkEnvironment& env, size_t max)
+{
+    std::vector<RelationPtr> relations;
+    for (Feature f : (*env.world)("a")(env.bounds))
+    {
+        if (f.isRelation()) relations.push_back(RelationPtr(f.ptr()));
+    }
+    std::sort(relations.begin(), relations.end(), [](RelationPtr a, RelationPtr b)
+    {
+        return a.bounds().area() > b.bounds().area();
+    });
+    if (relations.size() > max) relations.resize(max);
+    return relations;
+}
+
+std::vector<Coordinate> randomPoints(const Box& bounds, size_t count)
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int32_t> x(bounds.minX(), bounds.maxX());
+    std::uniform_int_distribution<int32_t> y(bounds.minY(), bounds.maxY());
+    std::vector<Coordinate> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) points.emplace_back(x(random), y(random));
+    return points;
+}
+
+/// A wavy ring of the given number of vertices, which gives the
+/// index a few thousand chains (similar to a detailed coastline)
+MCIndex buildSyntheticIndex(int vertexCount, Box& bounds)
+{
+    constexpr double RADIUS = 100'000'000;
+    std::vector<Coordinate> ring;
+    for (int i = 0; i < vertexCount; i++)
+    {
+        double angle = 2 * 3.141592653589793 * i / vertexCount;
+        double r = RADIUS * (1 + 0.05 * sin(angle * 500));
+        ring.emplace_back(static_cast<int32_t>(r * cos(angle)),
+            static_cast<int32_t>(r * sin(angle)));
+    }
+    MCIndexBuilder builder;
+    for (int i = 0; i < vertexCount; i++)
+    {
+        Coordinate c = ring[i];
+        bounds.expandToInclude(c);
+        builder.addLineSegment(c, ring[(i + 1) % vertexCount]);
+    }
+    return builder.build(bounds);
+}
+
+BenchmarkRun probeIndex(std::shared_ptr<MCIndex> index, const Box& bounds, bool batched)
+{
+    constexpr size_t PROBE_COUNT = 100'000;
+    auto points = std::make_shared<std::vector<Coordinate>>(randomPoints(bounds, PROBE_COUNT));
+    if (batched)
+    {
+        return [index, points]()
+        {
+            std::unique_ptr<bool[]> results(new bool[points->size()]);
+            index->containsPoints(*points, results.get());
+            doNotOptimize(std::count(results.get(), results.get() + points->size(), true));
+            return static_cast<uint64_t>(points->size());
+        };
+    }
+    return [index, points]()
+    {
+        uint64_t inside = 0;
+        for (Coordinate c : *points) inside += index->containsPoint(c);
+        doNotOptimize(inside);
+        return static_cast<uint64_t>(points->size());
+    };
+}
+
+} // namespace
+
+
+void addGeometryBenchmarks(BenchmarkSuite& suite)
+{
+    suite.add("decode/way-coords/next", "coords", true,
+        [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        return [ways = collectWays(env)]()
+        {
+            uint64_t count = 0;
+            int64_t sum = 0;
+            for (WayPtr way : ways)
+            {
+                WayCoordinateIterator iter(way);
+                for (int n = iter.coordinatesRemaining(); n > 0; n--)
+                {
+                    sum += iter.next().x;
+                    count++;
+                }
+            }
+            doNotOptimize(static_cast<uint64_t>(sum));
+            return count;
+        };
+    });
+
+    suite.add("decode/way-coords/batch", "coords", true,
+        [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        return [ways = collectWays(env)]()
+        {
+            Coordinate buf[WayCoordinateIterator::BATCH_SIZE];
+            uint64_t count = 0;
+            int64_t sum = 0;
+            for (WayPtr way : ways)
+            {
+                WayCoordinateIterator iter(way);
+                for (;;)
+                {
+                    int n = iter.decode(buf, WayCoordinateIterator::BATCH_SIZE);
+                    if (n == 0) break;
+                    sum += buf[n - 1].x;
+                    count += n;
+                }
+            }
+            doNotOptimize(static_cast<uint64_t>(sum));
+            return count;
+        };
+    });
+
+    suite.add("polygonize/largest-relations", "relations", true,
+        [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        FeatureStore* store = env.world->store();
+        return [store, relations = collectLargestAreaRelations(env, 32)]()
+        {
+            for (RelationPtr rel : relations)
+            {
+                Polygonizer polygonizer;
+                polygonizer.createRings(store, rel);
+                polygonizer.assignAndMergeHoles();
+                doNotOptimize(polygonizer.outerRings() != nullptr);
+            }
+            return static_cast<uint64_t>(relations.size());
+        };
+    });
+
+    suite.add("mcindex/build/largest-relation", "chains", true,
+        [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        FeatureStore* store = env.world->store();
+        std::vector<RelationPtr> relations = collectLargestAreaRelations(env, 1);
+        return [store, relations]()
+        {
+            if (relations.empty()) return uint64_t(0);
+            MCIndex index = MCIndexBuilder::buildFromAreaRelation(store, relations[0]);
+            return static_cast<uint64_t>(index.chainCount());
+        };
+    });
+
+    suite.add("mcindex/probe/largest-relation", "points", true,
+        [](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        std::vector<RelationPtr> relations = collectLargestAreaRelations(env, 1);
+        if (relations.empty()) return []() { return uint64_t(0); };
+        auto index = std::make_shared<MCIndex>(MCIndexBuilder::buildFromAreaRelation(
+            env.world->store(), relations[0]));
+        return probeIndex(index, relations[0].bounds(), false);
+    });
+
+    // The synthetic index doesn't need a GOL, so MCIndex can be
+    // measured on any machine
+
+    suite.add("mcindex/build/synthetic", "vertices", false,
+        [](BenchmarkEnvironment&) -> BenchmarkRun
+    {
+        return []()
+        {
+            constexpr int VERTEX_COUNT = 100'000;
+            Box bounds;
+            MCIndex index = buildSyntheticIndex(VERTEX_COUNT, bounds);
+            doNotOptimize(index.chainCount());
+            return static_cast<uint64_t>(VERTEX_COUNT);
+        };
+    });
+
+    suite.add("mcindex/probe/synthetic", "points", false,
+        [](BenchmarkEnvironment&) -> BenchmarkRun
+    {
+        Box bounds;
+        auto index = std::make_shared<MCIndex>(buildSyntheticIndex(100'000, bounds));
+        return probeIndex(index, bounds, false);
+    });
+
+    suite.add("mcindex/probe/synthetic-batched", "points", false,
+        [](BenchmarkEnvironment&) -> BenchmarkRun
+    {
+        Box bounds;
+        auto index = std::make_shared<MCIndex>(buildSyntheticIndex(100'000, bounds));
+        return probeIndex(index, bounds, true);
+    });
+}
+
+} // namespace geodesk::bench
@@ -0,0 +1,56 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+
+namespace geodesk::bench {
+
+namespace {
+
+/**
+ * Iterates every feature of the query, so the leaf scans of the
+ * query tasks (and the matcher, if any) dominate the timing.
+ */
+BenchmarkSetup iterate(const char* query)
+{
+    return [query](BenchmarkEnvironment& env) -> BenchmarkRun
+    {
+        Features features = (*env.world)(query)(env.bounds);
+        return [features]()
+        {
+            uint64_t count = 0;
+            for (Feature f : features)
+            {
+                (void)f;
+                count++;
+            }
+            return count;
+        };
+    };
+}
+
+} // namespace
+
+
+void addQueryBenchmarks(BenchmarkSuite& suite)
+{
+    // Leaf scans, with a matcher that only checks the feature type
+    suite.add("query/scan/nodes", "features", true, iterate("n"));
+    suite.add("query/scan/ways", "features", true, iterate("w"));
+    suite.add("query/scan/areas", "features", true, iterate("a"));
+    suite.add("query/scan/all", "features", true, iterate("*"));
+
+    // One query per class of matcher opcode
+    suite.add("query/match/key-exists", "features", true, iterate("na[name]"));
+    suite.add("query/match/global-string", "features", true, iterate("w[highway=residential]"));
+    suite.add("query/match/string-set", "features", true,
+        iterate("w[highway=primary,secondary,tertiary,residential]"));
+    suite.add("query/match/local-string", "features", true, iterate("na[cuisine=italian]"));
+    suite.add("query/match/negated", "features", true, iterate("a[building][building!=yes]"));
+    suite.add("query/match/numeric", "features", true, iterate("na[population>10000]"));
+    suite.add("query/match/regex", "features", true, iterate("na[name~\".*[Ss]tra(ss|ß)e.*\"]"));
+    suite.add("query/match/multi-clause", "features", true,
+        iterate("na[amenity=restaurant,cafe][name], w[highway][maxspeed<50]"));
+}
+
+} // namespace geodesk::bench
@@ -0,0 +1,261 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <clarisma/io/File.h>
+#include <geodesk/query/QueryRecorder.h>
+
+// Replays a log written by QueryRecorder against the benchmark GOL,
+// so builds can be compared on a recorded production workload rather
+// than on synthetic loops.
+
+namespace geodesk::bench {
+
+namespace {
+
+std::string describe(const RecordedQuery& q)
+{
+    static const char* const VIEWS[] = { "empty", "world", "nodes", "members", "parents" };
+    std::string s = q.consumption == RecordedQuery::Consumption::COUNT ? "count " : "iterate ";
+    s += VIEWS[q.view];
+    if (q.view == View::WORLD && !(q.bounds == Box::ofWorld())) s += " bbox";
+    for (const RecordedQuery::FilterArgs& filter : q.filters)
+    {
+        s += ' ';
+        s += filter.name;
+    }
+    s += ' ';
+    if (!q.usesMatcher)
+    {
+        s += '*';
+    }
+    for (char ch : q.query)
+    {
+        if (ch == '\0')
+        {
+            s += " & ";
+        }
+        else
+        {
+            s += ch;
+        }
+    }
+    return s;
+}
+
+double median(std::vector<uint64_t>& samples)
+{
+    if (samples.empty()) return 0;
+    std::sort(samples.begin(), samples.end());
+    return static_cast<double>(samples[samples.size() / 2]);
+}
+
+/// Reads the per-query medians of a JSON file written by
+/// writeReplayJson() (one query per line)
+std::unordered_map<uint64_t, double> readBaseline(const char* fileName)
+{
+    clarisma::ByteBlock data = clarisma::File::readAll(fileName);
+    std::string text(reinterpret_cast<const char*>(data.data()), data.size());
+    std::unordered_map<uint64_t, double> medians;
+    size_t pos = 0;
+    while ((pos = text.find("{\"index\": ", pos)) != std::string::npos)
+    {
+        unsigned long long index;
+        double nanos;
+        const char* p = text.c_str() + pos;
+        const char* m = strstr(p, "\"median_ns\": ");
+        if (sscanf(p, "{\"index\": %llu", &index) == 1 && m &&
+            sscanf(m, "\"median_ns\": %lf", &nanos) == 1)
+        {
+            medians[index] = nanos;
+        }
+        pos++;
+    }
+    return medians;
+}
+
+} // namespace
+
+std::vector<ReplayResult> runReplay(BenchmarkEnvironment& env,
+    const char* logFile, int consumers, bool verbose)
+{
+    if (!env.world) throw std::runtime_error("GEODESK_BENCH_GOL is not set");
+    FeatureStore* store = env.world->store();
+    std::vector<RecordedQuery> log = QueryRecorder::load(logFile);
+
+    // Views are created up front, so only the consumption is timed
+    // (as it was when the queries were recorded)
+    std::vector<ReplayResult> results;
+    std::vector<View> views;
+    size_t skipped = 0;
+    for (size_t i = 0; i < log.size(); i++)
+    {
+        const RecordedQuery& q = log[i];
+        try
+        {
+            views.push_back(q.toView(store));
+        }
+        catch (const std::exception&)
+        {
+            skipped++;      // unknown GOQL, custom filter or missing feature
+            continue;
+        }
+        ReplayResult& r = results.emplace_back();
+        r.index = i;
+        r.query = describe(q);
+        r.recordedNanos = static_cast<double>(q.nanos);
+    }
+    if (verbose)
+    {
+        fprintf(stderr, "Replaying %zu of %zu queries (%zu cannot be replayed)\n",
+            results.size(), log.size(), skipped);
+    }
+    if (consumers < 1) consumers = 1;
+    #ifndef GEODESK_MULTITHREADED
+    // Without atomic refcounts, a store must not be used by more
+    // than one consumer thread
+    if (consumers > 1)
+    {
+        fprintf(stderr, "Replaying with 1 consumer (build without GEODESK_MULTITHREADED)\n");
+        consumers = 1;
+    }
+    #endif
+
+    // Each pass replays the whole log, with the consumers taking
+    // queries in log order; passes repeat until minTime has passed
+    std::vector<std::vector<uint64_t>> samples(results.size());
+    auto started = std::chrono::steady_clock::now();
+    int passes = 0;
+    do
+    {
+        std::atomic<size_t> next = 0;
+        auto consume = [&]()
+        {
+            for (;;)
+            {
+                size_t i = next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= results.size()) break;
+                const RecordedQuery& q = log[results[i].index];
+                auto start = std::chrono::steady_clock::now();
+                uint64_t n = q.replay(views[i]);
+                auto end = std::chrono::steady_clock::now();
+                samples[i].push_back(std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(end - start).count());
+                results[i].results = n;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int t = 1; t < consumers; t++) threads.emplace_back(consume);
+        consume();
+        for (std::thread& t : threads) t.join();
+        passes++;
+    }
+    while (std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - started).count() < env.minTime);
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        results[i].medianNanos = median(samples[i]);
+        results[i].passes = passes;
+    }
+    return results;
+}
+
+void writeReplayJson(const BenchmarkEnvironment& env,
+    const std::vector<ReplayResult>& results, std::string& out)
+{
+    out += "{\n  ";
+    appendJsonContext(env, out);
+    out += ",\n  \"replay\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const ReplayResult& r = results[i];
+        out += i ? ",\n    " : "\n    ";
+        out += "{\"index\": " + std::to_string(r.index);
+        out += ", \"median_ns\": ";
+        appendNumber(out, r.medianNanos);
+        out += ", \"recorded_ns\": ";
+        appendNumber(out, r.recordedNanos);
+        out += ", \"results\": " + std::to_string(r.results);
+        out += ", \"passes\": " + std::to_string(r.passes);
+        out += ", \"query\": ";
+        appendJsonString(out, r.query);
+        out += "}";
+    }
+    out += "\n  ]\n}\n";
+}
+
+void printReplaySummary(const std::vector<ReplayResult>& results,
+    const char* baselineFile, int top)
+{
+    std::vector<double> latencies;
+    double total = 0;
+    for (const ReplayResult& r : results)
+    {
+        latencies.push_back(r.medianNanos);
+        total += r.medianNanos;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](double p)
+    {
+        return latencies.empty() ? 0.0 :
+            latencies[static_cast<size_t>(p * (latencies.size() - 1))];
+    };
+    fprintf(stderr, "%zu queries: total %.3f ms, p50 %.1f us, p99 %.1f us\n",
+        results.size(), total / 1e6, percentile(0.5) / 1e3, percentile(0.99) / 1e3);
+    if (!baselineFile) return;
+
+    std::unordered_map<uint64_t, double> baseline = readBaseline(baselineFile);
+    struct Diff
+    {
+        const ReplayResult* result;
+        double before;
+    };
+    std::vector<Diff> diffs;
+    double totalBefore = 0;
+    double totalAfter = 0;
+    for (const ReplayResult& r : results)
+    {
+        auto it = baseline.find(r.index);
+        if (it == baseline.end() || it->second <= 0) continue;
+        diffs.push_back({ &r, it->second });
+        totalBefore += it->second;
+        totalAfter += r.medianNanos;
+    }
+    if (diffs.empty())
+    {
+        fprintf(stderr, "No queries in common with %s\n", baselineFile);
+        return;
+    }
+    fprintf(stderr, "Against %s (%zu queries): total %.3f ms -> %.3f ms (%+.1f%%)\n",
+        baselineFile, diffs.size(), totalBefore / 1e6, totalAfter / 1e6,
+        (totalAfter / totalBefore - 1) * 100);
+
+    // Largest changes first, by the time they add or save
+    std::sort(diffs.begin(), diffs.end(), [](const Diff& a, const Diff& b)
+    {
+        return std::abs(a.result->medianNanos - a.before) >
+            std::abs(b.result->medianNanos - b.before);
+    });
+    int n = std::min(top, static_cast<int>(diffs.size()));
+    for (int i = 0; i < n; i++)
+    {
+        const Diff& d = diffs[i];
+        fprintf(stderr, "  #%-6llu %10.1f us -> %10.1f us  %+7.1f%%  %s\n",
+            static_cast<unsigned long long>(d.result->index),
+            d.before / 1e3, d.result->medianNanos / 1e3,
+            (d.result->medianNanos / d.before - 1) * 100,
+            d.result->query.c_str());
+    }
+}
+
+} // namespace geodesk::bench
@@ -0,0 +1,221 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "Benchmark.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <clarisma/util/Tracer.h>
+#include <geodesk/match/MatcherProfiler.h>
+
+using namespace geodesk::bench;
+
+namespace {
+
+void printResidency(const char* when, BenchmarkEnvironment& env)
+{
+    if (!env.world) return;
+    using Residency = clarisma::MappedFile::Residency;
+    geodesk::FeatureStore::ResidencyReport report =
+        env.world->store()->residency(env.bounds);
+    auto print = [](const char* region, const Residency& r)
+    {
+        fprintf(stderr, "  %-16s %12.1f MB of %12.1f MB resident (%5.1f%%)\n", region,
+            r.residentBytes / 1048576.0, r.bytes / 1048576.0,
+            r.bytes ? r.residentBytes * 100.0 / r.bytes : 0.0);
+    };
+    fprintf(stderr, "Residency %s:\n", when);
+    print("tile index", report.tileIndex);
+    print("string table", report.strings);
+    print("tiles", report.tiles);
+    for (int zoom = 0; zoom <= report.MAX_ZOOM; zoom++)
+    {
+        if (report.tileCountByZoom[zoom] == 0) continue;
+        char region[32];
+        snprintf(region, sizeof(region), "  zoom %d", zoom);
+        print(region, report.tilesByZoom[zoom]);
+    }
+}
+
+void profileMatcher(const char* query, BenchmarkEnvironment& env)
+{
+    if (!env.world) throw std::runtime_error("GEODESK_BENCH_GOL is not set");
+    geodesk::MatcherProfiler profiler(env.world->store(), query);
+    profiler.run((*env.world)(env.bounds));
+    std::string report;
+    profiler.report(report, 20);
+    fprintf(stderr, "%s", report.c_str());
+}
+
+} // namespace
+
+// Usage: geodesk-bench [--json <file>] [--trace <file>] [--residency]
+//                      [--quiet] [filter...]
+//        geodesk-bench --scaling [--consumers <n>] [--executors <n>]
+//                      [--json <file>] [--trace <file>] [--quiet] [workload...]
+//        geodesk-bench --replay <log> [--consumers <n>] [--baseline <json>]
+//                      [--json <file>] [--quiet]
+//        geodesk-bench --profile-matcher <query>
+//
+// Runs the benchmarks whose names contain any of the filters (e.g.
+// "query/match" or "mcindex"), printing a summary to stderr. With
+// --json, the results are written as JSON to the given file ("-"
+// for stdout), which is what comparisons between builds should use.
+// See BenchmarkEnvironment for the environment variables that select
+// the GOL and the area to query.
+//
+// With --scaling, runs the concurrency workloads instead, with up to
+// the given number of query threads and executor threads (default:
+// one per hardware thread each). To see the cost of atomic refcounts,
+// compare the results of builds with and without GEODESK_MULTITHREADED
+// (without it, a shared store is only used by a single thread).
+//
+// With --trace, the spans of a build with GEODESK_TRACING are written
+// to the given file as Chrome trace JSON (for chrome://tracing or
+// ui.perfetto.dev); keep the filters narrow, since each thread only
+// retains its most recent events.
+//
+// With --replay, runs the queries of a log written by QueryRecorder
+// (see FeatureStore::setRecorder()) with the given number of query
+// threads (default: 1), and reports the median latency of each query.
+// Given the --json output of a replay by another build as --baseline,
+// it also prints the queries whose latency changed the most.
+//
+// With --profile-matcher, checks the features in the benchmark bounds
+// against the given GOQL query with an instrumented matcher, and
+// prints the cost of each of its clauses and opcodes (see
+// MatcherProfiler).
+//
+// With --residency, prints how much of the GOL (tile index, string
+// table and the tiles in the benchmark bounds, by zoom level) is in
+// memory before and after the benchmarks.
+
+int main(int argc, char* argv[])
+{
+    const char* jsonFile = nullptr;
+    const char* traceFile = nullptr;
+    bool residency = false;
+    bool verbose = true;
+    bool scaling = false;
+    int maxConsumers = 0;
+    int maxExecutors = 0;
+    const char* replayLog = nullptr;
+    const char* baselineFile = nullptr;
+    const char* profiledQuery = nullptr;
+    std::vector<std::string> filters;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+        {
+            jsonFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            traceFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--residency") == 0)
+        {
+            residency = true;
+        }
+        else if (strcmp(argv[i], "--quiet") == 0)
+        {
+            verbose = false;
+        }
+        else if (strcmp(argv[i], "--scaling") == 0)
+        {
+            scaling = true;
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replayLog = argv[++i];
+        }
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+        {
+            baselineFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--profile-matcher") == 0 && i + 1 < argc)
+        {
+            profiledQuery = argv[++i];
+        }
+        else if (strcmp(argv[i], "--consumers") == 0 && i + 1 < argc)
+        {
+            maxConsumers = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--executors") == 0 && i + 1 < argc)
+        {
+            maxExecutors = atoi(argv[++i]);
+        }
+        else
+        {
+            filters.emplace_back(argv[i]);
+        }
+    }
+
+    try
+    {
+        if (traceFile)
+        {
+            if (!clarisma::Tracer::COMPILED_IN)
+            {
+                fprintf(stderr, "--trace requires a build with GEODESK_TRACING\n");
+                return 1;
+            }
+            clarisma::Tracer::start();
+        }
+        BenchmarkEnvironment env = BenchmarkEnvironment::fromEnv();
+        if (residency) printResidency("before", env);
+        std::string json;
+        if (profiledQuery)
+        {
+            profileMatcher(profiledQuery, env);
+        }
+        else if (replayLog)
+        {
+            std::vector<ReplayResult> results = runReplay(
+                env, replayLog, maxConsumers, verbose);
+            printReplaySummary(results, baselineFile, verbose ? 20 : 0);
+            writeReplayJson(env, results, json);
+        }
+        else if (scaling)
+        {
+            std::vector<ScalingResult> results = runScalingBenchmarks(
+                env, filters, maxConsumers, maxExecutors, verbose);
+            writeScalingJson(env, results, json);
+        }
+        else
+        {
+            BenchmarkSuite suite;
+            addQueryBenchmarks(suite);
+            addGeometryBenchmarks(suite);
+            addFormatBenchmarks(suite);
+            std::vector<BenchmarkResult> results = suite.run(env, filters, verbose);
+            BenchmarkSuite::writeJson(env, results, json);
+        }
+
+        if (residency) printResidency("after", env);
+        if (traceFile)
+        {
+            clarisma::Tracer::stop();
+            clarisma::Tracer::writeChromeJson(traceFile);
+        }
+        if (jsonFile)
+        {
+            FILE* out = strcmp(jsonFile, "-") == 0 ? stdout : fopen(jsonFile, "wb");
+            if (!out)
+            {
+                fprintf(stderr, "Unable to open %s\n", jsonFile);
+                return 1;
+            }
+            fwrite(json.data(), 1, json.size(), out);
+            if (out != stdout) fclose(out);
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <cstring>
+#include <iostream>
+#include <geodesk/geodesk.h>
+#include <geodesk/build/GolCompactor.h>
+
+using namespace geodesk;
+
+// Usage: gol-compact <in.gol> <out.gol> [--tip] [--compress | --decompress]
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: gol-compact <in.gol> <out.gol> [--tip] [--compress | --decompress]\n";
+        return 1;
+    }
+    GolCompactor::Settings settings;
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--tip") == 0)
+        {
+            settings.order = GolCompactor::Order::TIP;
+        }
+        else if (strcmp(argv[i], "--compress") == 0)
+        {
+            settings.compression = GolCompactor::Compression::COMPRESS;
+        }
+        else if (strcmp(argv[i], "--decompress") == 0)
+        {
+            settings.compression = GolCompactor::Compression::DECOMPRESS;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    try
+    {
+        Features world(argv[1]);
+        GolCompactor::Stats stats = GolCompactor(settings).compact(world.store(), argv[2]);
+        std::cout << stats.tiles << " tiles (" << stats.compressedTiles
+            << " compressed), " << stats.sourceSize << " -> "
+            << stats.fileSize << " bytes" << std::endl;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
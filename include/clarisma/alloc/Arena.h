@@ -22,6 +22,14 @@ namespace clarisma {
 
 static_assert(nullptr == 0, "nullptr is not represented as 0!");
 
+/**
+ * A bump allocator that frees all of its memory at once.
+ *
+ * Arenas are often short-lived (one per query, per relation being
+ * assembled, etc.), so the chunks of common sizes (powers of 2
+ * from 4 KB to 64 KB) are not returned to the heap right away, but
+ * kept by the thread that freed them, for use by the next Arena.
+ */
 class Arena
 {
 public:
@@ -54,13 +62,7 @@ public:
 	
 	~Arena()
 	{
-		Chunk* chunk = current_;
-		while (chunk)
-		{
-			Chunk* next = chunk->next;
-			delete[] reinterpret_cast<uint8_t*>(chunk);
-			chunk = next;
-		}
+		freeChunks(current_);
 	}
 
 	void clear()
@@ -69,13 +71,7 @@ public:
 		// is <initialSize> (i.e. not a whale, which may be smaller), we
 		// could keep the oldest chunk instead of freeing all chunks
 
-		Chunk* chunk = current_;
-		while (chunk)
-		{
-			Chunk* next = chunk->next;
-			delete[] reinterpret_cast<uint8_t*>(chunk);
-			chunk = next;
-		}
+		freeChunks(current_);
 		nextSize_ = initialSize();
 		current_ = nullptr;
 		p_ = nullptr;
@@ -176,9 +172,11 @@ private:
 	struct Chunk
 	{
 		Chunk* next;
+		size_t size;		// excluding this header
 	};
 
 	void allocChunk(size_t size);
+	static void freeChunks(Chunk* chunk);
 
 	Chunk* current_;
 	uint8_t* p_;
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace clarisma {
+
+/**
+ * A hash set of integer keys, stored in a single flat array
+ * (open addressing with linear probing). Much more cache-friendly
+ * than std::unordered_set, which allocates a node for each entry.
+ *
+ * One key value (EMPTY_KEY) is reserved to mark empty slots and
+ * cannot be stored in the set. Keys cannot be removed.
+ *
+ * - K must be an unsigned integer type
+ */
+template<typename K, K EMPTY_KEY = 0>
+class FlatHashSet
+{
+    static_assert(std::is_integral_v<K> && std::is_unsigned_v<K>);
+
+public:
+    FlatHashSet() : mask_(0), count_(0), growThreshold_(0) {}
+
+    explicit FlatHashSet(size_t expectedCount) : FlatHashSet()
+    {
+        reserve(expectedCount);
+    }
+
+    size_t size() const { return count_; }
+    bool isEmpty() const { return count_ == 0; }
+    size_t capacity() const { return slots_ ? mask_ + 1 : 0; }
+
+    bool contains(K key) const
+    {
+        if (!slots_ || key == EMPTY_KEY) return false;
+        for (size_t slot = hash(key) & mask_; ; slot = (slot + 1) & mask_)
+        {
+            K k = slots_[slot];
+            if (k == key) return true;
+            if (k == EMPTY_KEY) return false;
+        }
+    }
+
+    /**
+     * Adds a key to the set.
+     *
+     * @return true if the key was added, false if it was already present
+     */
+    bool insert(K key)
+    {
+        assert(key != EMPTY_KEY);
+        if (count_ >= growThreshold_) rehash(capacity() ? capacity() * 2 : MIN_CAPACITY);
+        for (size_t slot = hash(key) & mask_; ; slot = (slot + 1) & mask_)
+        {
+            K k = slots_[slot];
+            if (k == key) return false;
+            if (k == EMPTY_KEY)
+            {
+                slots_[slot] = key;
+                count_++;
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Ensures the set can hold at least `count` keys without
+     * having to grow its table.
+     */
+    void reserve(size_t count)
+    {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity * MAX_LOAD_PERCENT / 100 < count) capacity <<= 1;
+        if (capacity > this->capacity()) rehash(capacity);
+    }
+
+    /**
+     * Calls `fn` for each key in the set (in no particular order).
+     */
+    template<typename Fn>
+    void forEach(Fn&& fn) const
+    {
+        for (size_t i = 0; i < capacity(); i++)
+        {
+            if (slots_[i] != EMPTY_KEY) fn(slots_[i]);
+        }
+    }
+
+    void clear()
+    {
+        if (slots_) std::fill_n(slots_.get(), mask_ + 1, EMPTY_KEY);
+        count_ = 0;
+    }
+
+private:
+    static constexpr size_t MIN_CAPACITY = 16;
+    static constexpr size_t MAX_LOAD_PERCENT = 70;
+
+    static size_t hash(K key)
+    {
+        // Fibonacci hashing: spreads sequential or aligned keys (such as
+        // feature IDs with flag bits) across the whole table
+        uint64_t h = static_cast<uint64_t>(key) * 0x9E37'79B9'7F4A'7C15ULL;
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    void rehash(size_t newCapacity)
+    {
+        assert((newCapacity & (newCapacity - 1)) == 0);
+        std::unique_ptr<K[]> oldSlots = std::move(slots_);
+        size_t oldCapacity = oldSlots ? mask_ + 1 : 0;
+        slots_.reset(new K[newCapacity]);
+        std::fill_n(slots_.get(), newCapacity, EMPTY_KEY);
+        mask_ = newCapacity - 1;
+        growThreshold_ = newCapacity * MAX_LOAD_PERCENT / 100;
+        for (size_t i = 0; i < oldCapacity; i++)
+        {
+            K key = oldSlots[i];
+            if (key == EMPTY_KEY) continue;
+            size_t slot = hash(key) & mask_;
+            while (slots_[slot] != EMPTY_KEY) slot = (slot + 1) & mask_;
+            slots_[slot] = key;
+        }
+    }
+
+    std::unique_ptr<K[]> slots_;
+    size_t mask_;
+    size_t count_;
+    size_t growThreshold_;
+};
+
+} // namespace clarisma
@@ -0,0 +1,159 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+namespace clarisma {
+
+/**
+ * A minimal perfect hash function (hash-and-displace) that maps a fixed
+ * set of `n` distinct 64-bit hashes onto the slots `0` to `n-1`, without
+ * collisions. Each key is assigned to one of about `n/4` buckets, and
+ * each bucket has a displacement that was chosen by build() so that its
+ * keys land in slots that no other key occupies. Looking up a slot takes
+ * one read of the displacement table, which can live in a memory-mapped
+ * file (PerfectHash does not own it).
+ *
+ * Hashes that are not part of the set are mapped to an arbitrary slot,
+ * so callers must verify the key stored in the slot.
+ */
+class PerfectHash
+{
+public:
+    PerfectHash() : displacements_(nullptr), bucketCount_(0), slotCount_(0) {}
+    PerfectHash(const uint32_t* displacements, uint32_t bucketCount,
+        uint32_t slotCount) :
+        displacements_(displacements),
+        bucketCount_(bucketCount),
+        slotCount_(slotCount)
+    {
+    }
+
+    bool isEmpty() const { return slotCount_ == 0; }
+    uint32_t slotCount() const { return slotCount_; }
+
+    uint32_t slot(uint64_t hash) const
+    {
+        assert(slotCount_ > 0);
+        uint64_t h = mix(hash);
+        uint32_t d = displacements_[bucket(h, bucketCount_)];
+        return slot(h, d, slotCount_);
+    }
+
+    static uint32_t bucketCountFor(uint32_t keyCount)
+    {
+        return keyCount / 4 + 1;
+    }
+
+    /**
+     * Calculates the displacement of each bucket for the given hashes
+     * (bucketCountFor(count) entries).
+     *
+     * @return false if the hashes are not distinct, or no displacement
+     *   could be found for one of the buckets (practically impossible)
+     */
+    static bool build(const uint64_t* hashes, uint32_t count,
+        std::vector<uint32_t>& displacements)
+    {
+        uint32_t bucketCount = bucketCountFor(count);
+        displacements.assign(bucketCount, 0);
+
+        // Group the (mixed) hashes by bucket, then place the largest
+        // buckets first, while most slots are still free
+
+        std::vector<std::pair<uint32_t,uint64_t>> keys(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint64_t h = mix(hashes[i]);
+            keys[i] = { bucket(h, bucketCount), h };
+        }
+        std::sort(keys.begin(), keys.end());
+
+        struct Group
+        {
+            uint32_t bucket;
+            uint32_t start;
+            uint32_t size;
+        };
+        std::vector<Group> groups;
+        for (uint32_t i = 0; i < count; )
+        {
+            uint32_t start = i;
+            uint32_t b = keys[i].first;
+            for (i++; i < count && keys[i].first == b; i++)
+            {
+                if (keys[i].second == keys[i - 1].second) return false;
+            }
+            groups.push_back({ b, start, i - start });
+        }
+        std::stable_sort(groups.begin(), groups.end(),
+            [](const Group& a, const Group& b) { return a.size > b.size; });
+
+        std::vector<bool> taken(count);
+        std::vector<uint32_t> slots;
+        for (const Group& group : groups)
+        {
+            uint32_t d = 0;
+            for (;;)
+            {
+                slots.clear();
+                for (uint32_t i = 0; i < group.size; i++)
+                {
+                    uint32_t s = slot(keys[group.start + i].second, d, count);
+                    if (taken[s] || std::find(slots.begin(), slots.end(), s)
+                        != slots.end())
+                    {
+                        break;
+                    }
+                    slots.push_back(s);
+                }
+                if (slots.size() == group.size) break;
+                if (++d == MAX_DISPLACEMENT) return false;
+            }
+            for (uint32_t s : slots) taken[s] = true;
+            displacements[group.bucket] = d;
+        }
+        return true;
+    }
+
+    static constexpr uint32_t MAX_DISPLACEMENT = 1 << 24;
+
+private:
+    static uint64_t mix(uint64_t x)
+    {
+        // finalizer of MurmurHash3 (our string hashes are rather weak)
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static uint32_t reduce(uint32_t x, uint32_t n)
+    {
+        return static_cast<uint32_t>((static_cast<uint64_t>(x) * n) >> 32);
+    }
+
+    static uint32_t bucket(uint64_t h, uint32_t bucketCount)
+    {
+        return reduce(static_cast<uint32_t>(h >> 32), bucketCount);
+    }
+
+    static uint32_t slot(uint64_t h, uint32_t d, uint32_t slotCount)
+    {
+        return reduce(static_cast<uint32_t>(
+            mix(h ^ (d * 0x9e3779b97f4a7c15ULL)) >> 32), slotCount);
+    }
+
+    const uint32_t* displacements_;
+    uint32_t bucketCount_;
+    uint32_t slotCount_;
+};
+
+} // namespace clarisma
@@ -105,6 +105,10 @@ public:
 
 
     void force();
+    /// Like force(), but may skip metadata that isn't needed to read
+    /// the file back (such as its modification time), which saves a
+    /// disk write on most file systems
+    void forceData();
 
     void error(const char* what);
 
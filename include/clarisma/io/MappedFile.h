@@ -41,10 +41,62 @@ public:
     }
     */
 
+    /// How a mapped range is expected to be accessed, which lets the
+    /// OS tune its readahead
+    enum class AccessPattern
+    {
+        NORMAL,         ///< moderate readahead (the default)
+        RANDOM,         ///< no readahead
+        SEQUENTIAL      ///< aggressive readahead, pages are freed early
+    };
+
     static void unmap(void* address, uint64_t length);
     void prefetch(void* address, uint64_t length);
+
+    // The following are only hints: they ignore any errors, and do
+    // nothing on platforms that don't support them. The range does
+    // not need to be page-aligned.
+
+    static void advise(const void* address, uint64_t length, AccessPattern pattern) noexcept;
+    /// Asks the OS to back the range with huge pages (on Linux, this
+    /// only takes effect for file mappings if the kernel supports
+    /// transparent huge pages for the page cache)
+    static void adviseHugePages(const void* address, uint64_t length) noexcept;
+    /// Reads the pages of the range into memory (waiting for them if
+    /// the OS supports it), so the first accesses don't fault
+    static void populate(const void* address, uint64_t length) noexcept;
+    /// Tells the OS that the range won't be needed soon, so it can
+    /// reclaim its pages first (the data itself is unaffected)
+    static void evict(const void* address, uint64_t length) noexcept;
+
+    /// The size of the pages that overlap a range, and how much of it
+    /// is in physical memory
+    struct Residency
+    {
+        uint64_t bytes = 0;
+        uint64_t residentBytes = 0;
+
+        Residency& operator+=(const Residency& other)
+        {
+            bytes += other.bytes;
+            residentBytes += other.residentBytes;
+            return *this;
+        }
+    };
+
+    /// Checks which pages of the range are in physical memory (on
+    /// Windows: in the working set of this process), without faulting
+    /// them in. Only a snapshot; if the OS can't tell, the pages are
+    /// counted as not resident.
+    static Residency residency(const void* address, uint64_t length) noexcept;
+
         // TODO: technically, does not need to be part of MappedFile
-    void sync(const void* address, uint64_t length);
+    /// Writes the modified pages of the range to disk, and waits until
+    /// they have been written. If `invalidate` is set, other mappings
+    /// of the file are made to see the new data (a no-op on platforms
+    /// with a unified page cache, such as Linux). The range is widened
+    /// to page boundaries.
+    void sync(const void* address, uint64_t length, bool invalidate = true);
 };
 
 // TODO: broken, needs to set size!!!
@@ -0,0 +1,78 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <chrono>
+#include <clarisma/util/Buffer.h>
+
+namespace clarisma {
+
+/// A Buffer that writes to a file descriptor (a pipe, a socket or an
+/// open file) with low latency, for output that a consumer reads as
+/// it is produced (e.g. features streamed to an HTTP client).
+///
+/// Unlike FileBuffer2, which only writes once its buffer is full,
+/// flush() sends the buffered bytes as soon as either `flushBytes`
+/// have accumulated or the oldest unsent byte has waited for
+/// `maxDelay` (as well as on the very first flush, so the consumer
+/// receives the first bytes right away). The delay is only checked
+/// when data is written or flushed, so there is no background timer.
+/// Call finish() (or let the destructor do it) to send the rest.
+///
+/// Chunks of output that were serialized elsewhere (such as the
+/// per-tile buffers of a ParallelExport) can be passed to write(),
+/// which sends them along with the buffered bytes in a single
+/// `writev` call instead of copying them.
+///
+/// The descriptor is not closed. For a socket, the caller should
+/// ignore (or handle) SIGPIPE. Write errors throw an IOException.
+///
+class StreamBuffer : public Buffer
+{
+public:
+	struct Settings
+	{
+		size_t capacity = 64 * 1024;
+		size_t flushBytes = 16 * 1024;
+		std::chrono::milliseconds maxDelay { 50 };
+	};
+
+	explicit StreamBuffer(int fd) : StreamBuffer(fd, Settings()) {}
+	StreamBuffer(int fd, const Settings& settings);
+	~StreamBuffer() override;
+
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+	void filled(char* p) override;
+	void flush(char* p) override;
+
+	/// Appends `len` bytes; if the thresholds are reached, they are
+	/// sent together with the buffered bytes without being copied.
+	/// A BufferWriter that writes to this buffer must be flushed
+	/// before, and re-attached (setBuffer()) after calling this method.
+	void write(const char* data, size_t len);
+
+	/// Sends all buffered bytes.
+	void finish();
+
+	/// The total number of bytes sent so far
+	uint64_t bytesSent() const { return bytesSent_; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	bool isDue() const;
+	void markPending();
+	void send(const char* extra, size_t extraLen);
+
+	int fd_;
+	size_t flushBytes_;
+	Clock::duration maxDelay_;
+	Clock::time_point pendingSince_;	// when the oldest unsent byte was written
+	uint64_t bytesSent_;
+	bool anySent_;
+};
+
+} // namespace clarisma
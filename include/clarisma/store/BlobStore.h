@@ -184,10 +184,15 @@ protected:
 	static const int LEAF_FREE_TABLE_OFS = 64;     // must be divisible by 64
 	*/
 
+	uint64_t pageOffset(PageNum page) const
+	{
+		return static_cast<uint64_t>(page) << pageSizeShift_;
+	}
+
 	// TODO: Return BlobPtr
 	DataPtr pagePointer(PageNum page)
 	{
-		return DataPtr(data(static_cast<uint64_t>(page) << pageSizeShift_));
+		return DataPtr(data(pageOffset(page)));
 	}
 
 	void createStore() override;
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <clarisma/store/Store_v2.h>
+#include <memory>
 #include <unordered_map>
 #include <clarisma/data/Span.h>
 #include <clarisma/util/DataPtr.h>
@@ -84,6 +85,72 @@ public:
 		};
 	};
 
+	/// An in-memory summary of the free-tables, with one bit for each
+	/// size class (1 to 262,144 pages) that has at least one free blob,
+	/// and two levels of bits on top that mark the non-empty words of
+	/// the level below. This lets a Transaction find the smallest size
+	/// class that fits a blob, and tell whether a range of the leaf or
+	/// trunk free-table has become empty, with a handful of bit scans
+	/// instead of walking the tables slot by slot.
+	///
+	/// Size classes are zero-based (a blob of n pages has class n - 1),
+	/// matching the slot numbering of the free-tables: class c lives in
+	/// slot c % 512 of the leaf table in trunk slot c / 512.
+	///
+	class FreeSizeMap
+	{
+	public:
+		static constexpr uint32_t SIZE_CLASSES = 512 * 512;
+
+		FreeSizeMap() : top_(0), middle_{}, bits_{} {}
+
+		void set(uint32_t sizeClass)
+		{
+			assert(sizeClass < SIZE_CLASSES);
+			uint32_t word = sizeClass >> 6;
+			bits_[word] |= 1ULL << (sizeClass & 63);
+			middle_[word >> 6] |= 1ULL << (word & 63);
+			top_ |= 1ULL << (word >> 6);
+		}
+
+		void clear(uint32_t sizeClass)
+		{
+			assert(sizeClass < SIZE_CLASSES);
+			uint32_t word = sizeClass >> 6;
+			bits_[word] &= ~(1ULL << (sizeClass & 63));
+			if (bits_[word]) return;
+			middle_[word >> 6] &= ~(1ULL << (word & 63));
+			if (middle_[word >> 6]) return;
+			top_ &= ~(1ULL << (word >> 6));
+		}
+
+		/// Returns the smallest non-empty size class that is at least
+		/// `sizeClass`, or -1 if there is none
+		int findFirst(uint32_t sizeClass) const;
+
+		/// Checks whether any size class in the given 16-slot range of
+		/// a leaf free-table (i.e. the range whose bit would be set in
+		/// `leafFreeTableRanges`) is non-empty
+		bool hasLeafRange(uint32_t trunkSlot, uint32_t leafRange) const
+		{
+			uint32_t first = trunkSlot * 512 + leafRange * 16;
+			return (bits_[first >> 6] >> (first & 63)) & 0xffff;
+		}
+
+		/// Checks whether any size class covered by the given 16-slot
+		/// range of the trunk free-table is non-empty
+		bool hasTrunkRange(uint32_t trunkRange) const
+		{
+			// A trunk range covers 2 words of middle_
+			return (top_ >> (trunkRange * 2)) & 3;
+		}
+
+	private:
+		uint64_t top_;
+		uint64_t middle_[SIZE_CLASSES / 64 / 64];
+		uint64_t bits_[SIZE_CLASSES / 64];
+	};
+
 	class Transaction : protected Store::Transaction
 	{
 	public:
@@ -95,13 +162,20 @@ public:
 		void begin(LockLevel lockLevel = LockLevel::LOCK_APPEND)
 		{
 			Store::Transaction::begin(lockLevel);
+			// Another process may have changed the free-tables since
+			// our last transaction, so the summary is rebuilt lazily
+			freeSizes_.reset();
 		}
 		[[nodiscard]] BlobStore* store() const { return reinterpret_cast<BlobStore*>(store_); }
 		PageNum alloc(uint32_t payloadSize);
 		void free(PageNum firstPage);
 		PageNum addBlob(ByteSpan data);
 		void commit();
-		void end() { Store::Transaction::end(); }
+		void end()
+		{
+			Store::Transaction::end();
+			freeSizes_.reset();
+		}
 
 	protected:
 		HeaderBlock* getRootBlock()
@@ -117,6 +191,20 @@ public:
 					<< store()->pageSizeShift_));
 		}
 
+		const Blob* getConstBlobBlock(PageNum page)
+		{
+			return reinterpret_cast<const Blob*>(
+				getConstBlock(static_cast<uint64_t>(page)
+					<< store()->pageSizeShift_));
+		}
+
+		FreeSizeMap& freeSizes()
+		{
+			if (!freeSizes_) buildFreeSizes();
+			return *freeSizes_;
+		}
+
+		void buildFreeSizes();
 		void addFreeBlob(PageNum firstPage, uint32_t pages, uint32_t precedingFreePages);
 		void removeFreeBlob(Blob* freeBlock);
 		PageNum relocateFreeTable(PageNum page, int sizeInPages);
@@ -126,6 +214,7 @@ public:
 		}
 
 		std::unordered_map<PageNum, uint32_t> freedBlobs_;
+		std::unique_ptr<FreeSizeMap> freeSizes_;
 	};
 
 	template<typename T>
@@ -184,6 +273,10 @@ protected:
 
 	DateTime getLocalCreationTimestamp() const override;
 	uint64_t getTrueSize() const override;
+	uint64_t getMetadataSize() const override
+	{
+		return getRoot()->metadataSize;
+	}
 	uint32_t pagesForPayloadSize(uint32_t payloadSize) const;
 	static void setMetadataSize(Header* header, size_t size);
 
@@ -2,7 +2,10 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
+#include <algorithm>
 #include <cassert>
+#include <span>
+#include <utility>
 #include <clarisma/io/ExpandableMappedFile.h>
 
 namespace clarisma {
@@ -43,12 +46,69 @@ public:
 		ExpandableMappedFile::open(filename, mode);
 	}
 
+	void close()
+	{
+		unmapSegments();
+		ExpandableMappedFile::close();
+	}
+
 	uint32_t get(uint64_t key);
 	void put(uint64_t key, uint32_t value);
 
+	using Entry = std::pair<uint64_t, uint32_t>;
+
+	/**
+	 * Stores multiple key/value pairs. The entries are sorted by key
+	 * (in place), and then written one block at a time, which turns
+	 * random single puts into a mostly sequential pass over the file.
+	 * If `threads` is greater than 1, the sorted entries are divided
+	 * into shards along block boundaries, and each shard is written
+	 * by its own thread (Since no two threads write to the same block,
+	 * they don't contend for the same cache lines).
+	 */
+	void putAll(std::span<Entry> entries, int threads = 1);
+
+	/**
+	 * Looks up multiple keys, one block at a time, and stores the
+	 * value of keys[i] in values[i] (both spans must have the same
+	 * size). Sorted keys are looked up most efficiently.
+	 */
+	void getAll(std::span<const uint64_t> keys, std::span<uint32_t> values);
+
 private:
 	static const uint32_t BLOCK_SIZE = 4096;
 
+	/**
+	 * Since we always access a full uint32_t even though the value takes
+	 * up fewer bits, we may run into a situation where we access bytes
+	 * beyond the block, which may result in a segfault; to avoid this,
+	 * we start at the offset that is <overrun> bytes earlier, and shift
+	 * the value by 8 * <overrun> bits to compensate
+	 */
+	struct SlotPosition
+	{
+		SlotPosition(uint32_t slot, int bits)
+		{
+			// The byte within the block where the value starts
+			byteOffset = slot * bits / 8;
+			// The bit within the first byte where the value starts
+			bitShift = slot * bits - byteOffset * 8;
+			uint32_t overrun = std::max(
+				static_cast<int32_t>(byteOffset) -
+				static_cast<int32_t>(BLOCK_SIZE - 4), 0);
+			assert(overrun <= 3);
+			byteOffset -= overrun;
+			bitShift += overrun * 8;
+		}
+
+		uint32_t byteOffset;
+		uint32_t bitShift;
+	};
+
+	uint32_t getInBlock(const byte* block, uint32_t slot) const;
+	void putInBlock(byte* block, uint32_t slot, uint32_t value) const;
+	void putSorted(std::span<const Entry> entries);
+
 	int bits_;
 	uint32_t slotsPerBlock_;
 	uint32_t mask_;
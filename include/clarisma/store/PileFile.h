@@ -2,6 +2,10 @@
 // SPDX-License-Identifier: LGPL-3.0-only
  
 #pragma once
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <clarisma/alloc/ReusableBlock.h>
 #include <clarisma/io/ExpandableMappedFile.h>
 
@@ -23,12 +27,61 @@ public:
 	void create(const char* fileName, uint32_t pileCount, 
 		uint32_t pageSize=(1 << 16), uint32_t preallocatedPages=0);
 	void preallocate(int pile, int pages);
+	/// Appends data to the given pile. Not thread-safe; threads that
+	/// append concurrently must each use their own Writer.
 	void append(int pile, const uint8_t* data, uint32_t len);
 	void load(int pile, ReusableBlock& block);
+	/// Loads all non-empty piles in order, and passes each to `consumer`
+	/// (the block is reused for the next pile). While a pile is being
+	/// consumed, the OS reads ahead the chunks of the piles that follow.
+	void loadAll(const std::function<void(int pile, ReusableBlock& block)>& consumer);
 	void close() { file_.close(); }
 
 	static const int MAX_PILE_COUNT = (1 << 26) - 1;
-		
+
+	/// Buffers the appends of a single thread. Each pile's data is
+	/// collected in memory and written as a chunk once the buffer is
+	/// full; chunks start out as a single page and grow with each
+	/// flush, so large piles end up in a few large, contiguous runs.
+	/// Any number of Writers can append to the same PileFile at the
+	/// same time (but not concurrently with PileFile::append()).
+	///
+	/// The data of a pile from the same Writer stays in order, but
+	/// the data of different Writers may be interleaved (at chunk
+	/// granularity). The data of a single append() is never split,
+	/// so each append can hold a self-contained record.
+	///
+	class Writer
+	{
+	public:
+		explicit Writer(PileFile& file, uint32_t maxChunkPages = 16) :
+			file_(file),
+			maxChunkPages_(maxChunkPages)
+		{
+		}
+
+		~Writer() { flush(); }
+
+		Writer(const Writer&) = delete;
+		Writer& operator=(const Writer&) = delete;
+
+		void append(int pile, const uint8_t* data, uint32_t len);
+		/// Writes all buffered data to the file.
+		void flush();
+
+	private:
+		struct Buffer
+		{
+			std::vector<uint8_t> data;
+			uint32_t chunkPages = 1;
+		};
+
+		void flush(int pile, Buffer& buf);
+
+		PileFile& file_;
+		uint32_t maxChunkPages_;
+		std::unordered_map<int, Buffer> buffers_;
+	};
 
 private:
 	static const uint32_t MAGIC = 0x454C4950;
@@ -71,11 +124,19 @@ private:
 
 	Metadata* metadata() const { return reinterpret_cast<Metadata*>(file_.mainMapping()); }
 	ChunkAllocation allocChunk(uint32_t minPayload);
+	uint32_t allocPages(uint32_t pages);
 	Chunk* getChunk(uint32_t page);
+	void prefetchPile(int pile);
+	void linkChunk(int pile, uint32_t page, uint32_t len);
+
+	static const int LINK_LOCK_COUNT = 64;
 
 	ExpandableMappedFile file_;
 	uint32_t pageSize_;
 	int pageSizeShift_;
+	/// Guard the tails of the piles while Writers link their chunks
+	/// (pile number modulo LINK_LOCK_COUNT)
+	std::mutex linkLocks_[LINK_LOCK_COUNT];
 };
 
 } // namespace clarisma
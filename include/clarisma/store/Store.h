@@ -48,6 +48,12 @@ public:
 
 	const std::string& fileName() const { return fileName_; }
 
+	/// Whether syncing the store also invalidates other mappings of its
+	/// file (MS_INVALIDATE). Unnecessary on Linux, whose page cache is
+	/// shared by all mappings, so it can be turned off to save time.
+	/// Default: on.
+	void setInvalidateOnSync(bool invalidate) { invalidateOnSync_ = invalidate; }
+
 protected:
 	virtual void createStore() = 0;
 	virtual void verifyHeader() const = 0;
@@ -97,11 +103,30 @@ protected:
 
 		byte* getBlock(uint64_t pos);
 		const byte* getConstBlock(uint64_t pos);
+
+		/// Commits the changes made since the last commit. With group
+		/// commit, the changes are only staged, unless this is the
+		/// last commit of a group (see setGroupSize()).
 		void commit();
 
+		/// Makes commit() write changes only every `n` commits, so
+		/// `n` logical transactions share the cost of writing the
+		/// journal and syncing the store (e.g. when many small tiles
+		/// are added). Staged changes are neither visible to other
+		/// processes nor durable until they are written; call flush()
+		/// before the Transaction is destroyed, or they are discarded.
+		void setGroupSize(uint32_t n) { groupSize_ = n ? n : 1; }
+
+		/// Writes all committed changes, and waits until they are
+		/// safely on disk.
+		void flush();
+
 	protected:
-		void saveJournal();
+		using SortedBlocks = std::vector<std::pair<uint64_t, TransactionBlock*>>;
+
+		void saveJournal(const SortedBlocks& blocks);
 		void clearJournal();
+		void syncRange(uint64_t start, uint64_t end);
 
 		Store* store_;
 		File journalFile_;
@@ -131,6 +156,10 @@ protected:
 		 * only once all of the actual tile data has been written to the Store.
 		 */
 		std::vector<TransactionBlock*> metadataBlocks_;
+
+		uint32_t groupSize_ = 1;
+		/// The number of commits that have been staged, but not written
+		uint32_t pendingCommits_ = 0;
 	};
 
 private:
@@ -149,6 +178,7 @@ private:
 
 	std::string fileName_;
 	int openMode_;
+	bool invalidateOnSync_ = true;
 	LockLevel lockLevel_;
 	FileLock lockRead_;
 	FileLock lockWrite_;
@@ -54,6 +54,12 @@ protected:
 	virtual void initialize() = 0;
 	virtual DateTime getLocalCreationTimestamp() const = 0;
 	virtual uint64_t getTrueSize() const = 0;
+
+	/// The size of the portion at the start of the store that holds
+	/// metadata (such as indexes that point to other data). In commit(),
+	/// changes to metadata are published last, with release semantics,
+	/// so readers that find a pointer there also find what it points to.
+	virtual uint64_t getMetadataSize() const { return 0; }
 	// void* mapSegment(uint32_t segNumber, uint32_t segCount);
 
 	byte* data(uint64_t ofs)
@@ -127,6 +133,11 @@ protected:
 
 	private:
 		static constexpr  uint64_t JOURNAL_END_MARKER = 0xffff'ffff'ffff'ffffUll;
+		// The first word of a journal: 0 = empty; otherwise, it holds
+		// patches, checksummed with CRC-32 (older versions) or CRC-32C
+		static constexpr uint32_t JOURNAL_PATCHES_CRC32 = 1;
+		static constexpr uint32_t JOURNAL_PATCHES_CRC32C = 2;
+		static constexpr size_t JOURNAL_READ_BUFFER_SIZE = 64 * 1024;
 
 		std::string fileName_;
 	};
@@ -0,0 +1,30 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+#include <cstdint>
+
+namespace clarisma {
+
+/// Resource usage of the current process (all threads), as reported
+/// by the OS. Differences of two snapshots tell whether the work in
+/// between was CPU-bound or waited for pages to be read.
+///
+struct ProcessCounters
+{
+	double cpuSeconds = 0;		// user + system
+	uint64_t majorFaults = 0;	// faults that required I/O (always 0 on
+								// Windows, which doesn't tell them apart)
+	uint64_t minorFaults = 0;	// on Windows: all faults
+
+	static ProcessCounters current() noexcept;
+
+	ProcessCounters operator-(const ProcessCounters& other) const
+	{
+		return { cpuSeconds - other.cpuSeconds,
+			majorFaults - other.majorFaults,
+			minorFaults - other.minorFaults };
+	}
+};
+
+} // namespace clarisma
@@ -131,6 +131,11 @@ namespace Format
         return &buf[12];
     }
 
+    /// The decimal digits of 00 to 99, for formatting integers
+    /// two digits at a time
+    inline constexpr char DIGIT_PAIRS[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839404142434445464748495051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
     /**
      * Formats an unsigned integr value, placing digits from end to start.
      * 
@@ -140,13 +145,21 @@ namespace Format
      */
     inline char* unsignedIntegerReverse(unsigned long long d, char* end)
     {
-        do
+        // Two digits at a time
+        while (d >= 100)
+        {
+            unsigned long long quot = d / 100;
+            end -= 2;
+            memcpy(end, &DIGIT_PAIRS[(d - quot * 100) * 2], 2);
+            d = quot;
+        }
+        if (d >= 10)
         {
-            lldiv_t result = lldiv(d, 10);
-            *(--end) = static_cast<char>('0' + result.rem);
-            d = result.quot;
+            end -= 2;
+            memcpy(end, &DIGIT_PAIRS[d * 2], 2);
+            return end;
         }
-        while (d != 0);
+        *(--end) = static_cast<char>('0' + d);
         return end;
     }
 
@@ -0,0 +1,108 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clarisma {
+
+/// A regular expression that is matched against entire strings (like
+/// std::regex_match) in linear time.
+///
+/// Patterns use ECMAScript syntax. They are compiled into a DFA over
+/// bytes (which matches without allocating memory), or into an NFA that
+/// is simulated without backtracking if the DFA would be too large.
+/// A literal prefix, a literal suffix and the minimum length of a match
+/// are extracted from the pattern, so most strings that cannot match
+/// are rejected without running the automaton.
+///
+/// Patterns that use features beyond regular languages (backreferences,
+/// lookahead or word boundaries) are handed to std::regex instead.
+///
+class Regex
+{
+public:
+    /// @throws std::regex_error if the pattern is invalid
+    explicit Regex(std::string_view pattern);
+    Regex(Regex&& other) noexcept = default;
+    Regex& operator=(Regex&& other) noexcept = default;
+
+    /// Returns true if the pattern matches `s` in its entirety.
+    bool match(std::string_view s) const
+    {
+        if (s.size() < minLength_ || !s.starts_with(prefix_) ||
+            !s.ends_with(suffix_))
+        {
+            return false;
+        }
+        if (!dfa_.empty())
+        {
+            uint32_t state = START;
+            for (char ch : s)
+            {
+                state = dfa_[state * classCount_ + classes_[static_cast<uint8_t>(ch)]];
+                if (state == DEAD) return false;
+            }
+            return accepting_[state];
+        }
+        if (fallback_) [[unlikely]]
+        {
+            return std::regex_match(s.begin(), s.end(), *fallback_);
+        }
+        return matchNfa(s);
+    }
+
+    /// Returns false if the pattern is matched by std::regex
+    bool isLinear() const { return fallback_ == nullptr; }
+    const std::string& prefix() const { return prefix_; }
+    const std::string& suffix() const { return suffix_; }
+
+    static constexpr uint32_t MAX_DFA_STATES = 1024;
+    static constexpr uint32_t MAX_NFA_STATES = 16384;
+
+private:
+    class Compiler;
+
+    using ByteSet = std::array<uint64_t, 4>;
+
+    struct NfaState
+    {
+        enum Kind : uint8_t { SET, SPLIT, MATCH };
+        Kind kind;
+        uint32_t set;       // index into sets_ (SET only)
+        int32_t out;
+        int32_t out2;       // SPLIT only
+    };
+
+    static constexpr uint32_t DEAD = 0;
+    static constexpr uint32_t START = 1;
+
+    bool matchNfa(std::string_view s) const;
+    void buildDfa();
+    void closure(std::vector<int32_t>& states) const;
+    static bool contains(const ByteSet& set, uint8_t ch)
+    {
+        return (set[ch >> 6] >> (ch & 63)) & 1;
+    }
+
+    std::string prefix_;
+    std::string suffix_;
+    size_t minLength_ = 0;
+    uint32_t classCount_ = 0;
+    std::vector<uint16_t> dfa_;         // [state * classCount_ + class]
+    std::vector<uint8_t> accepting_;
+    std::vector<NfaState> nfa_;         // only kept if there's no DFA
+    std::vector<ByteSet> sets_;
+    int32_t nfaStart_ = 0;
+    std::unique_ptr<std::regex> fallback_;
+    uint8_t classes_[256] = {};         // byte -> equivalence class
+};
+
+} // namespace clarisma
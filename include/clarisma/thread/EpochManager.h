@@ -0,0 +1,131 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <thread>
+
+namespace clarisma {
+
+/// Epoch-based reclamation: lets a single writer find out when
+/// memory it has unpublished can no longer be seen by any reader,
+/// without making readers take a lock.
+///
+/// A reader calls enter() before it looks up any shared structure,
+/// and exit() once it no longer uses anything it found. The writer
+/// unpublishes an object, calls retire() to obtain the epoch in which
+/// the object was last visible, and may reclaim it once
+/// canReclaim(epoch) returns true.
+///
+/// Readers are tracked in a fixed number of slots; if all are taken,
+/// enter() spins until one becomes available.
+///
+class EpochManager
+{
+public:
+	static constexpr int MAX_READERS = 128;
+
+	using Epoch = uint64_t;
+
+	/// Pins the current epoch on behalf of the calling reader.
+	/// @return the slot to pass to exit()
+	///
+	int enter()
+	{
+		int start = static_cast<int>(
+			std::hash<std::thread::id>()(std::this_thread::get_id()) % MAX_READERS);
+		for (;;)
+		{
+			for (int i = 0; i < MAX_READERS; i++)
+			{
+				int n = (start + i) % MAX_READERS;
+				std::atomic<Epoch>& slot = slots_[n].epoch;
+				Epoch expected = INACTIVE;
+				Epoch epoch = current_.load();
+				if (!slot.compare_exchange_strong(expected, epoch)) continue;
+
+				// If the writer advanced the epoch before it could see
+				// our slot, we may already be looking at its updates,
+				// so we must not claim an older epoch
+				for (;;)
+				{
+					Epoch now = current_.load();
+					if (now == epoch) return n;
+					epoch = now;
+					slot.store(epoch);
+				}
+			}
+			std::this_thread::yield();
+		}
+	}
+
+	void exit(int slot)
+	{
+		slots_[slot].epoch.store(INACTIVE, std::memory_order_release);
+	}
+
+	/// Called by the writer after it has unpublished an object
+	/// (with release semantics).
+	/// @return the epoch to pass to canReclaim()
+	///
+	Epoch retire()
+	{
+		return current_.fetch_add(1);
+	}
+
+	/// Returns true if no reader that could have seen an object
+	/// retired in `epoch` is still active.
+	bool canReclaim(Epoch epoch) const
+	{
+		return oldestActive() > epoch;
+	}
+
+	/// Returns the oldest epoch that is pinned by a reader
+	/// (or the current epoch if there are no readers).
+	Epoch oldestActive() const
+	{
+		Epoch oldest = current_.load();
+		for (const Slot& slot : slots_)
+		{
+			Epoch epoch = slot.epoch.load();
+			if (epoch < oldest) oldest = epoch;
+		}
+		return oldest;
+	}
+
+	/// Pins an epoch for the lifetime of the guard.
+	class Guard
+	{
+	public:
+		explicit Guard(EpochManager& epochs) :
+			epochs_(epochs),
+			slot_(epochs.enter())
+		{
+		}
+
+		~Guard() { epochs_.exit(slot_); }
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+	private:
+		EpochManager& epochs_;
+		int slot_;
+	};
+
+private:
+	static constexpr Epoch INACTIVE = std::numeric_limits<Epoch>::max();
+
+	struct alignas(64) Slot
+	{
+		std::atomic<Epoch> epoch { INACTIVE };
+	};
+
+	std::atomic<Epoch> current_ { 1 };
+	Slot slots_[MAX_READERS];
+};
+
+} // namespace clarisma
@@ -0,0 +1,44 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#ifdef GEODESK_PYTHON
+#include <Python.h>
+#endif
+
+namespace clarisma {
+
+/// Releases the Python GIL for as long as it lives, provided the
+/// current thread holds it, so other Python threads can run while
+/// this one blocks or does work that doesn't touch Python objects.
+/// The GIL is re-acquired on destruction (including when an
+/// exception unwinds the stack), before any Python API is called
+/// again. Without GEODESK_PYTHON, this does nothing.
+///
+class GilRelease
+{
+public:
+#ifdef GEODESK_PYTHON
+    GilRelease() :
+        state_((Py_IsInitialized() && PyGILState_Check()) ? PyEval_SaveThread() : nullptr)
+    {
+    }
+
+    ~GilRelease()
+    {
+        if (state_) PyEval_RestoreThread(state_);
+    }
+
+private:
+    PyThreadState* state_;
+#else
+    GilRelease() {}
+#endif
+
+public:
+    GilRelease(const GilRelease&) = delete;
+    GilRelease& operator=(const GilRelease&) = delete;
+};
+
+} // namespace clarisma
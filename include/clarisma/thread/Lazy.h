@@ -0,0 +1,31 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+#include <mutex>
+
+namespace clarisma {
+
+/// A value that is created on first use. If several threads ask for
+/// it at the same time, only one of them creates it, while the others
+/// wait until it is ready. If creation fails, the next call tries again.
+///
+template<typename T>
+class Lazy
+{
+public:
+	/// Returns the value, creating it via `create()` (which returns
+	/// a T) if this is the first call
+	template<typename Create>
+	T& get(Create&& create)
+	{
+		std::call_once(once_, [this, &create]() { value_ = create(); });
+		return value_;
+	}
+
+private:
+	std::once_flag once_;
+	T value_{};
+};
+
+} // namespace clarisma
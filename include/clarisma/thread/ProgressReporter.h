@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <stdio.h>
@@ -9,6 +11,18 @@
 
 namespace clarisma {
 
+/**
+ * Reports the progress of a task as a percentage, at most once per
+ * second. progress() may be called from any number of threads: it
+ * only adds to an atomic counter, and the clock is consulted only
+ * each time another 1% of the work has been completed. Of the threads
+ * that cross such a mark, exactly one checks the time and prints.
+ *
+ * Workers that complete many small units should accumulate them in
+ * a Batch, which keeps the shared counter from bouncing between cores.
+ *
+ * start() and end() must not run concurrently with progress().
+ */
 class ProgressReporter
 {
 public:
@@ -16,6 +30,8 @@ public:
 		verb_(verb),
 		totalUnits_(0),
 		unitsCompleted_(0),
+		nextCheck_(0),
+		lastReportTime_(0),
 		percentageCompleted_(0)
 	{
 	}
@@ -23,32 +39,44 @@ public:
 	void start(uint64_t totalUnits)
 	{
 		totalUnits_ = totalUnits;
+		unitsCompleted_.store(0, std::memory_order_relaxed);
+		nextCheck_.store(step(), std::memory_order_relaxed);
+		percentageCompleted_.store(0, std::memory_order_relaxed);
 		startTime_ = std::chrono::steady_clock::now();
-		lastReportTime_ = startTime_;
+		lastReportTime_.store(0, std::memory_order_relaxed);
 		report();
 	}
 
 	void progress(uint64_t units)
 	{
-		unitsCompleted_ += units;
-		int percentage = (int)(unitsCompleted_ * 100 / totalUnits_);
-		if (percentage != percentageCompleted_)
+		uint64_t done = unitsCompleted_.fetch_add(
+			units, std::memory_order_relaxed) + units;
+		uint64_t nextCheck = nextCheck_.load(std::memory_order_relaxed);
+		if (done < nextCheck) return;
+		// Only the thread that moves the mark gets to check the time
+		if (!nextCheck_.compare_exchange_strong(nextCheck, done + step(),
+			std::memory_order_relaxed))
 		{
-			std::chrono::time_point<std::chrono::steady_clock> now(
-				std::chrono::steady_clock::now());
-			// Check if at least one second has elapsed
-			if (now - lastReportTime_ >= std::chrono::seconds(1))
-			{
-				lastReportTime_ = now;
-				percentageCompleted_ = percentage;
-				report();
-			}
+			return;
 		}
+		int64_t now = elapsedMillis();
+		if (now - lastReportTime_.load(std::memory_order_relaxed) < 1000) return;
+		lastReportTime_.store(now, std::memory_order_relaxed);
+		percentageCompleted_.store(totalUnits_ ?
+			static_cast<int>(std::min(done, totalUnits_) * 100 / totalUnits_) : 100,
+			std::memory_order_relaxed);
+		report();
+	}
+
+	uint64_t unitsCompleted() const
+	{
+		return unitsCompleted_.load(std::memory_order_relaxed);
 	}
 
 	void report()
 	{
-		printf("%s... %d%%\r", verb_, percentageCompleted_);
+		printf("%s... %d%%\r", verb_,
+			percentageCompleted_.load(std::memory_order_relaxed));
 	}
 
 	void end(const char* what)
@@ -61,13 +89,63 @@ public:
 		printf("%s in %s\n", what, buf);
 	}
 
+	/**
+	 * Accumulates the progress of a single thread, and passes it on
+	 * to the reporter in chunks (and when it is destroyed).
+	 */
+	class Batch
+	{
+	public:
+		explicit Batch(ProgressReporter* reporter) :
+			reporter_(reporter),
+			pending_(0),
+			threshold_(reporter ? std::max<uint64_t>(reporter->step() / 8, 1) : 0)
+		{
+		}
+
+		~Batch() { flush(); }
+
+		void progress(uint64_t units)
+		{
+			pending_ += units;
+			if (pending_ >= threshold_) flush();
+		}
+
+		void flush()
+		{
+			if (reporter_ && pending_)
+			{
+				reporter_->progress(pending_);
+				pending_ = 0;
+			}
+		}
+
+	private:
+		ProgressReporter* reporter_;
+		uint64_t pending_;
+		uint64_t threshold_;
+	};
+
 private:
+	/// The number of units that make up 1%
+	uint64_t step() const
+	{
+		return std::max<uint64_t>(totalUnits_ / 100, 1);
+	}
+
+	int64_t elapsedMillis() const
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - startTime_).count();
+	}
+
 	const char* verb_;
 	uint64_t totalUnits_;
-	uint64_t unitsCompleted_;
+	alignas(64) std::atomic<uint64_t> unitsCompleted_;
+	std::atomic<uint64_t> nextCheck_;
+	alignas(64) std::atomic<int64_t> lastReportTime_;	// ms since start
+	std::atomic<int> percentageCompleted_;
 	std::chrono::time_point<std::chrono::steady_clock> startTime_;
-	std::chrono::time_point<std::chrono::steady_clock> lastReportTime_;
-	int percentageCompleted_;
 };
 
 } // namespace clarisma
@@ -2,6 +2,11 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
 #include <clarisma/thread/TaskQueue.h>
 #include <clarisma/thread/TaskStatus.h>
 #include <clarisma/text/Format.h>
@@ -34,14 +39,34 @@ namespace clarisma {
 // Derived won't be fully initialzied at that point
 // Use a "start" method that inits the contexts and starts the threads
 
+/**
+ * Ordered output: If enableOrderedOutput() is called before start(),
+ * workers submit their output with postOutput(sequence, task), and the
+ * output thread receives the tasks in sequence order (0, 1, 2, ...)
+ * rather than in order of completion. Every sequence number must be
+ * used exactly once (call skipOutput() for a work task that doesn't
+ * produce output). Output that arrives early is held in a reorder
+ * window; a worker whose output lies beyond the window waits until
+ * the output before it has been delivered.
+ */
+
+/**
+ * Failure: If a work task (or an output task) throws, the engine
+ * records the first exception and cancels both queues, discarding all
+ * pending work and output. Tasks that are already running finish, but
+ * anything posted afterwards is ignored (producers can check
+ * hasFailed() to stop generating work). end() then rethrows the
+ * exception, without calling harvestResults() or postProcess().
+ */
+
 template <typename Derived, typename WorkContext, typename WorkTask, typename OutputTask>
 class TaskEngine
 {
 public:
     TaskEngine(int numberOfThreads, int workQueueSize = 0, int outputQueueSize = 0) :
-        threadCount_(numberOfThreads),
         workQueue_(workQueueSize == 0 ? (numberOfThreads * 2) : workQueueSize),
-        outputQueue_(outputQueueSize == 0 ? (numberOfThreads * 2) : outputQueueSize)
+        outputQueue_(outputQueueSize == 0 ? (numberOfThreads * 2) : outputQueueSize),
+        threadCount_(numberOfThreads)
     {
         assert(numberOfThreads >= 1);
         workContexts_.reserve(numberOfThreads);
@@ -51,7 +76,36 @@ public:
     ~TaskEngine()
     {
         // If thread list is empty, this means processing has already ended
-        if(!threads_.empty()) end();
+        if(!threads_.empty())
+        {
+            try
+            {
+                end();
+            }
+            catch (...)
+            {
+                // A destructor can't throw; call end() explicitly to
+                // find out whether the work failed
+            }
+        }
+    }
+
+    /**
+     * Delivers output in sequence order, holding at most `window`
+     * tasks that arrive out of order. The window is widened as needed
+     * to exceed the number of work tasks that can be in flight at the
+     * same time (queue capacity plus number of threads), which rules
+     * out deadlocks as long as sequence numbers are assigned in the
+     * order in which work is posted. Must be called before start().
+     */
+    void enableOrderedOutput(int window = 0)
+    {
+        assert(threads_.empty());
+        int minWindow = workQueue_.stats().capacity + threadCount_ + 1;
+        reorderWindow_ = std::max(window, minWindow);
+        reorderSlots_.clear();
+        reorderSlots_.resize(reorderWindow_);
+        nextSequence_ = 0;
     }
 
     void start()
@@ -90,6 +144,13 @@ public:
         if (threads_[0].joinable()) threads_[0].join();
         //LOG("  Ended.");
         threads_.clear();
+        if (error_)
+        {
+            workContexts_.clear();
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
         for (auto& ctx : workContexts_)
         {
             ctx.harvestResults();
@@ -102,12 +163,69 @@ public:
     // TODO: rename to "submitOutput()"
     void postOutput(OutputTask&& task)
     {
+        assert(reorderWindow_ == 0);    // use postOutput(sequence, task)
         outputQueue_.post(std::move(task));
     }
 
+    /**
+     * Submits the output with the given sequence number (ordered
+     * output only).
+     */
+    void postOutput(uint64_t sequence, OutputTask&& task)
+    {
+        release(sequence, &task);
+    }
+
+    /**
+     * Marks the given sequence number as used by a work task that
+     * doesn't produce any output (ordered output only).
+     */
+    void skipOutput(uint64_t sequence)
+    {
+        release(sequence, nullptr);
+    }
+
+    /**
+     * Returns true once a task has thrown an exception (which end()
+     * will rethrow).
+     */
+    bool hasFailed() const
+    {
+        return failed_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Live metrics of the engine's queues. The blocked/idle times of
+     * the work queue are the time spent posting work and the time
+     * workers waited for work; those of the output queue are the time
+     * workers spent posting output and the time the output thread
+     * waited for output.
+     */
+    struct Metrics
+    {
+        TaskQueueStats work;
+        TaskQueueStats output;
+        int reorderPending;             ///< output held in the reorder window
+        uint64_t reorderBlockedNanos;   ///< time workers waited for the window
+    };
+
+    Metrics metrics()
+    {
+        Metrics m;
+        m.work = workQueue_.stats();
+        m.output = outputQueue_.stats();
+        {
+            std::lock_guard lock(reorderMutex_);
+            m.reorderPending = reorderPending_;
+            m.reorderBlockedNanos = reorderBlockedNanos_;
+        }
+        return m;
+    }
+
     void reportOutputQueueSpace()
     {
-        // printf("%d slots free in output queue\n", outputQueue_.minimumRemainingCapacity());
+        TaskQueueStats stats = outputQueue_.stats();
+        LOG("Output queue: %d of %d slots in use", stats.occupancy, stats.capacity);
     }
 
     std::vector<WorkContext>& workContexts()
@@ -137,16 +255,96 @@ private:
             // Console::debug("Calling afterTasks()...");
             ctx->afterTasks();
         }
-        catch (std::exception& ex)
+        catch (...)
         {
-            // TODO
-            printf(ex.what());
+            fail(std::current_exception());
         }
     }
     
     void processOutput()
     {
-        outputQueue_.process((Derived*)this);
+        try
+        {
+            outputQueue_.process((Derived*)this);
+        }
+        catch (...)
+        {
+            fail(std::current_exception());
+        }
+    }
+
+    void fail(std::exception_ptr error)
+    {
+        {
+            std::lock_guard lock(reorderMutex_);
+            if (error_) return;     // only the first exception is kept
+            error_ = error;
+            failed_.store(true, std::memory_order_relaxed);
+        }
+        workQueue_.cancel();
+        outputQueue_.cancel();
+        // Workers waiting for the reorder window would otherwise wait
+        // for output that never arrives
+        windowAdvanced_.notify_all();
+    }
+
+    struct ReorderSlot
+    {
+        enum State { EMPTY, FILLED, SKIPPED };
+
+        OutputTask task;
+        State state = EMPTY;
+    };
+
+    void release(uint64_t sequence, OutputTask* task)
+    {
+        assert(reorderWindow_ > 0);     // call enableOrderedOutput() first
+        std::unique_lock lock(reorderMutex_);
+        if (error_) return;
+        if (sequence >= nextSequence_ + reorderWindow_)
+        {
+            auto start = std::chrono::steady_clock::now();
+            windowAdvanced_.wait(lock, [this, sequence]
+            {
+                return sequence < nextSequence_ + reorderWindow_ || error_;
+            });
+            reorderBlockedNanos_ += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count());
+            if (error_) return;
+        }
+        assert(sequence >= nextSequence_);
+        ReorderSlot& slot = reorderSlots_[sequence % reorderWindow_];
+        assert(slot.state == ReorderSlot::EMPTY);   // each sequence used once
+        if (task)
+        {
+            slot.task = std::move(*task);
+            slot.state = ReorderSlot::FILLED;
+        }
+        else
+        {
+            slot.state = ReorderSlot::SKIPPED;
+        }
+        reorderPending_++;
+        if (sequence != nextSequence_) return;
+
+        // We completed the head of the window: deliver it and any
+        // output that follows it without gaps. We hold the lock while
+        // posting, so batches from different threads can't overtake
+        // each other
+        for (;;)
+        {
+            ReorderSlot& next = reorderSlots_[nextSequence_ % reorderWindow_];
+            if (next.state == ReorderSlot::EMPTY) break;
+            if (next.state == ReorderSlot::FILLED)
+            {
+                outputQueue_.post(std::move(next.task));
+            }
+            next.state = ReorderSlot::EMPTY;
+            nextSequence_++;
+            reorderPending_--;
+        }
+        windowAdvanced_.notify_all();
     }
 
 	std::vector<std::thread> threads_;
@@ -155,6 +353,18 @@ private:
 	TaskQueue<Derived, OutputTask> outputQueue_;
     TaskStatus status_;
     int threadCount_;
+
+    // State of ordered output (guarded by reorderMutex_)
+    int reorderWindow_ = 0;
+    std::vector<ReorderSlot> reorderSlots_;
+    uint64_t nextSequence_ = 0;
+    int reorderPending_ = 0;
+    uint64_t reorderBlockedNanos_ = 0;
+    std::mutex reorderMutex_;
+    std::condition_variable windowAdvanced_;
+    // The first exception thrown by a task (guarded by reorderMutex_)
+    std::exception_ptr error_;
+    std::atomic<bool> failed_ = false;
 };
 
 
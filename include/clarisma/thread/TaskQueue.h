@@ -3,127 +3,214 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <vector>
-#include <condition_variable>
+#include <chrono>
+#include <climits>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <thread>
 #include <clarisma/util/log.h>
 
 namespace clarisma {
 
+/**
+ * A snapshot of a TaskQueue's load, and of the time threads have
+ * spent waiting on it so far.
+ */
+struct TaskQueueStats
+{
+    int occupancy;              ///< tasks in the queue
+    int capacity;
+    uint64_t blockedNanos;      ///< time producers waited for space
+    uint64_t idleNanos;         ///< time consumers waited for tasks
+};
+
+/**
+ * A bounded multi-producer, multi-consumer queue of tasks, which are
+ * processed by one or more threads that call process().
+ *
+ * The queue is a lock-free ring (D. Vyukov's sequence-numbered cell
+ * design, as in WorkStealingPool), extended so that a batch of tasks
+ * can be claimed with a single CAS. Threads that find the queue empty
+ * (or full) spin briefly, then park on an atomic (futex-backed on
+ * Linux/Windows); producers and consumers only issue a wake-up call
+ * if someone is actually parked.
+ *
+ * The capacity is rounded up to the next power of 2.
+ *
+ * Task must be default-constructible and move-assignable.
+ */
 template <typename Context, typename Task>
 class TaskQueue
 {
 public:
     explicit TaskQueue(int size) :
-        size_(size),
-        count_(0),
-        front_(0),
-        rear_(0),
+        capacity_(roundUpToPowerOf2(static_cast<uint32_t>(size))),
+        cells_(new Cell[capacity_]),
+        mask_(capacity_ - 1),
+        enqueuePos_(0),
+        dequeuePos_(0),
         running_(true)
     {
         assert(size > 0);
-        queue_.resize(size);
+        for (uint32_t i = 0; i < capacity_; i++)
+        {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    TaskQueueStats stats() const
+    {
+        return
+        {
+            static_cast<int>(std::min<size_t>(size(), capacity_)),
+            static_cast<int>(capacity_),
+            blockedNanos_.load(std::memory_order_relaxed),
+            idleNanos_.load(std::memory_order_relaxed)
+        };
     }
 
     // TODO: rename to "submit()"
     void post(Task&& task)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (count_ == size_)
+        if (isCancelled()) return;
+        if (!push(task))
         {
-            /*
-            printf("Thread %s: Queue %p full, waiting for space...\n",
-                Threads::currentThreadId().c_str(), this);
-            */
-            notFull_.wait(lock, [this] { return count_ < size_; });
+            auto start = std::chrono::steady_clock::now();
+            do
+            {
+                notFull_.park([this] { return hasSpace() || isCancelled(); });
+                if (isCancelled()) return;
+            }
+            while (!push(task));
+            addTime(blockedNanos_, start);
         }
-        queue_[rear_] = std::move(task);
-        rear_ = (rear_ + 1) % size_;
-        count_++;
-        notEmpty_.notify_one();
+        notEmpty_.wake(1);
     }
 
     // TODO: rename to "trySubmit()"
     bool tryPost(Task&& task)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (count_ == size_) return false;
-        queue_[rear_] = std::move(task);
-        rear_ = (rear_ + 1) % size_;
-        count_++;
-        notEmpty_.notify_one();
+        if (isCancelled()) return true;     // discarded
+        if (!push(task)) return false;
+        notEmpty_.wake(1);
         return true;
     }
 
-    // TODO: Needs test
-    bool fill(std::function<bool(Task*)> supplier) 
+    /**
+     * Posts up to `count` tasks in order (moving from them), claiming
+     * as many consecutive slots as are free with a single operation.
+     *
+     * @return the number of tasks that were posted (0 if the queue
+     *   is full)
+     */
+    int tryPostBatch(Task* tasks, int count)
     {
-        std::unique_lock<std::mutex> lock(mutex_);
+        int posted = pushBatch(tasks, count);
+        if (posted) notEmpty_.wake(posted);
+        return posted;
+    }
 
-        int tasksAdded = 0;
-        while (count_ < size_) 
+    /**
+     * Posts all `count` tasks in order, waiting for space as needed.
+     */
+    void postBatch(Task* tasks, int count)
+    {
+        while (count > 0 && !isCancelled())
         {
-            if (!supplier(&queue_[rear_])) break;
-            // Successfully got a new task directly into the queue
-            rear_ = (rear_ + 1) % size_;
-            count_++;
-            tasksAdded++;
+            int posted = tryPostBatch(tasks, count);
+            tasks += posted;
+            count -= posted;
+            if (count)
+            {
+                auto start = std::chrono::steady_clock::now();
+                notFull_.park([this] { return hasSpace() || isCancelled(); });
+                addTime(blockedNanos_, start);
+            }
         }
+    }
 
-        if (tasksAdded) notEmpty_.notify_all();
-        return count_ == size_; // Return true if the queue is full, indicating there might be more tasks to add
+    /**
+     * Adds tasks obtained from `supplier` as long as the queue has
+     * room, or until the supplier returns false.
+     *
+     * @return true if the queue is full, indicating there might be
+     *   more tasks to add
+     */
+    bool fill(std::function<bool(Task*)> supplier)
+    {
+        Task task;
+        while (hasSpace())
+        {
+            if (!supplier(&task)) break;
+            post(std::move(task));
+        }
+        return !hasSpace();
     }
 
-    
     int minimumRemainingCapacity()
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        // TODO: No lock needed, as long as there aren't multiple consumers
-        // count_ will only decrease, so this should be safe without locking
-        // But no noticeable performance difference, so we'll leave the lock for now
-        return size_ - count_;
+        // Other threads may post concurrently, so this is only a snapshot
+        return static_cast<int>(capacity_) - static_cast<int>(std::min<size_t>(
+            size(), capacity_));
     }
 
+    /**
+     * Takes up to `max` tasks (moving them into `tasks`) with a
+     * single operation, without waiting.
+     *
+     * @return the number of tasks taken
+     */
+    int tryTakeBatch(Task* tasks, int max)
+    {
+        int taken = popBatch(tasks, max);
+        if (taken) notFull_.wake(INT32_MAX);
+        return taken;
+    }
+
+    /**
+     * Processes tasks until the queue has been shut down (tasks that
+     * have already been posted at that point are still processed).
+     */
     void process(Context* ctx)
     {
+        Task task;
         for(;;)
         {
-            Task task;
+            if (isCancelled()) return;
+            if (popBatch(&task, 1))
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-                for (;;)
-                {
-                    if (!running_)
-                    {
-                        // Console::debug("Finished processing queue %p.", this);
-                        return;
-                    }
-                    if (count_ > 0) break;
-                    /*
-                    printf("Thread %s: Waiting for tasks in queue %p...\n", 
-                        Threads::currentThreadId().c_str(), this);
-                    */
-                    notEmpty_.wait(lock);
-                }
-                task = std::move(queue_[front_]);
-                front_ = (front_ + 1) % size_;
-                count_--;
-                notFull_.notify_one();
+                notFull_.wake(INT32_MAX);
+                ctx->processTask(task);
+                continue;
             }
-            ctx->processTask(task);
+            if (!running_.load(std::memory_order_seq_cst))
+            {
+                // Console::debug("Finished processing queue %p.", this);
+                return;
+            }
+            auto start = std::chrono::steady_clock::now();
+            notEmpty_.park([this]
+            {
+                return hasTask() || !running_.load(std::memory_order_seq_cst);
+            });
+            addTime(idleNanos_, start);
         }
     }
 
-
+    /**
+     * Waits until all posted tasks have been taken by consumers
+     * (though they may still be processing them).
+     */
     void awaitCompletion()
     {
         //LOG("Awaiting completion of queue %p...", this);
-        std::unique_lock<std::mutex> lock(mutex_);
-        while (count_ != 0)
-        {  // Continue to wait as long as there are tasks in the queue
-            //LOG("There are still %d task(s) in queue %p...", count_, this);
-            notFull_.wait(lock);  // Wait for a signal that a task has been completed
+        while (size() != 0 && !isCancelled())
+        {
+            notFull_.park([this] { return size() == 0 || isCancelled(); });
         }
         //LOG("Queue %p is empty.", this);
     }
@@ -131,20 +218,219 @@ public:
     void shutdown()
     {
         //LOG("Shutting down queue %p...", this);
-        std::unique_lock<std::mutex> lock(mutex_);
-        running_ = false;
-        notEmpty_.notify_all();
+        running_.store(false, std::memory_order_seq_cst);
+        notEmpty_.wake(INT32_MAX);
+    }
+
+    /**
+     * Shuts down the queue and discards its pending tasks, as well as
+     * any tasks posted from now on. Threads in process() return once
+     * they have finished their current task, and awaitCompletion()
+     * returns right away.
+     */
+    void cancel()
+    {
+        cancelled_.store(true, std::memory_order_seq_cst);
+        running_.store(false, std::memory_order_seq_cst);
+        Task task;
+        while (popBatch(&task, 1)) {}
+        notFull_.wake(INT32_MAX);
+        notEmpty_.wake(INT32_MAX);
+    }
+
+    bool isCancelled() const
+    {
+        return cancelled_.load(std::memory_order_relaxed);
     }
 
 private:
-    std::vector<Task> queue_;
-    std::mutex mutex_;
-    std::condition_variable notEmpty_, notFull_;
-    int front_;
-    int rear_;
-    int size_;
-    int count_;
-    bool running_;
+    static constexpr int SPIN_ROUNDS = 64;
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Task task;
+    };
+
+    /**
+     * An atomic that threads park on, and a count of the threads that
+     * are parked (so that waking is free if no one is waiting).
+     */
+    struct alignas(64) Signal
+    {
+        std::atomic<uint32_t> epoch { 0 };
+        std::atomic<uint32_t> sleeperCount { 0 };
+
+        /**
+         * Spins briefly until `ready` returns true; otherwise, parks
+         * until woken. May return spuriously; callers must retry.
+         */
+        template <typename Ready>
+        void park(Ready ready)
+        {
+            for (int i = 0; i < SPIN_ROUNDS; i++)
+            {
+                if (ready()) return;
+                std::this_thread::yield();
+            }
+            // Register as a sleeper, then check once more, so the other
+            // side either sees us or we see the state it changed
+            uint32_t e = epoch.load(std::memory_order_seq_cst);
+            sleeperCount.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ready()) epoch.wait(e, std::memory_order_seq_cst);
+            sleeperCount.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        void wake(int count)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleeperCount.load(std::memory_order_seq_cst) > 0)
+            {
+                epoch.fetch_add(1, std::memory_order_seq_cst);
+                if (count == 1)
+                {
+                    epoch.notify_one();
+                }
+                else
+                {
+                    epoch.notify_all();
+                }
+            }
+        }
+    };
+
+    static void addTime(std::atomic<uint64_t>& total,
+        std::chrono::steady_clock::time_point start)
+    {
+        total.fetch_add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count()),
+            std::memory_order_relaxed);
+    }
+
+    static uint32_t roundUpToPowerOf2(uint32_t n)
+    {
+        uint32_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    size_t size() const
+    {
+        size_t dequeuePos = dequeuePos_.load(std::memory_order_seq_cst);
+        size_t enqueuePos = enqueuePos_.load(std::memory_order_seq_cst);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    bool hasSpace() const
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+    bool hasTask() const
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    bool push(Task& task)
+    {
+        return pushBatch(&task, 1) == 1;
+    }
+
+    /**
+     * Claims up to `count` consecutive free cells, and moves the tasks
+     * into them. Returns the number of tasks moved.
+     */
+    int pushBatch(Task* tasks, int count)
+    {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            intptr_t diff = static_cast<intptr_t>(
+                cells_[pos & mask_].sequence.load(std::memory_order_acquire)) -
+                static_cast<intptr_t>(pos);
+            if (diff < 0) return 0;     // full
+            if (diff > 0)
+            {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            int n = 1;
+            while (n < count && cells_[(pos + n) & mask_].sequence.load(
+                std::memory_order_acquire) == pos + n)
+            {
+                n++;
+            }
+            if (enqueuePos_.compare_exchange_weak(pos, pos + n,
+                std::memory_order_relaxed))
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    Cell& cell = cells_[(pos + i) & mask_];
+                    cell.task = std::move(tasks[i]);
+                    cell.sequence.store(pos + i + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+    }
+
+    /**
+     * Claims up to `max` consecutive cells that hold tasks, and moves
+     * the tasks out of them. Returns the number of tasks moved.
+     */
+    int popBatch(Task* tasks, int max)
+    {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            intptr_t diff = static_cast<intptr_t>(
+                cells_[pos & mask_].sequence.load(std::memory_order_acquire)) -
+                static_cast<intptr_t>(pos + 1);
+            if (diff < 0) return 0;     // empty
+            if (diff > 0)
+            {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            int n = 1;
+            while (n < max && cells_[(pos + n) & mask_].sequence.load(
+                std::memory_order_acquire) == pos + n + 1)
+            {
+                n++;
+            }
+            if (dequeuePos_.compare_exchange_weak(pos, pos + n,
+                std::memory_order_relaxed))
+            {
+                for (int i = 0; i < n; i++)
+                {
+                    Cell& cell = cells_[(pos + i) & mask_];
+                    tasks[i] = std::move(cell.task);
+                    cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+                }
+                return n;
+            }
+        }
+    }
+
+    uint32_t capacity_;
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) std::atomic<size_t> dequeuePos_;
+    alignas(64) std::atomic<bool> running_;
+    std::atomic<bool> cancelled_ = false;
+    std::atomic<uint64_t> blockedNanos_ = 0;
+    std::atomic<uint64_t> idleNanos_ = 0;
+    Signal notEmpty_;
+    /**
+     * Producers waiting for space and threads in awaitCompletion()
+     * park here, so consumers always wake all of them
+     */
+    Signal notFull_;
 };
 
 } // namespace clarisma
@@ -5,6 +5,7 @@
 #include <sstream>
 #include <thread>
 #include <string>
+#include <vector>
 
 namespace clarisma {
 
@@ -16,5 +17,27 @@ namespace Threads
 		ss << std::this_thread::get_id();
 		return ss.str();
 	}
+
+	/// Returns the number of hardware threads, or a reasonable
+	/// default if the platform can't tell (hardware_concurrency()
+	/// is allowed to return 0)
+	inline int hardwareConcurrency()
+	{
+		unsigned int n = std::thread::hardware_concurrency();
+		return n ? static_cast<int>(n) : 4;
+	}
+
+	/// Restricts the current thread to the given logical CPU.
+	/// Only advisory: returns false if the platform doesn't
+	/// support it or the call failed.
+	bool pinCurrentThread(int cpu);
+
+	/// Restricts the current thread to the given set of logical CPUs.
+	bool pinCurrentThread(const std::vector<int>& cpus);
+
+	/// Returns the logical CPUs of each NUMA node. On platforms without
+	/// NUMA support (or if the topology can't be determined), all CPUs
+	/// are reported as a single node.
+	std::vector<std::vector<int>> numaNodes();
 }
 } // namespace clarisma
@@ -0,0 +1,527 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <clarisma/thread/Threads.h>
+#include <clarisma/util/Metrics.h>
+#include <clarisma/util/Tracer.h>
+
+namespace clarisma {
+
+/**
+ * A thread pool in which each worker owns a bounded lock-free queue.
+ * Tasks are distributed round-robin across the worker queues; a worker
+ * first drains its own queue, then steals from its peers. Idle workers
+ * spin briefly, then park on an atomic (futex-backed on Linux/Windows)
+ * instead of a shared condition variable.
+ *
+ * Drop-in replacement for ThreadPool: same tryPost() / post() /
+ * minimumRemainingCapacity() contract, plus tryPostBatch().
+ *
+ * If `pinThreads` is set, worker i is bound to logical CPU i (modulo
+ * the number of CPUs), which keeps each worker's caches warm when
+ * the pool is the only busy one in the process.
+ *
+ * If given the CPU sets of several NUMA nodes, the workers are split
+ * into one group per node, each pinned to the CPUs of its node. A task
+ * that has an `affinity()` key is queued in the group picked by hashing
+ * that key, so tasks with the same key keep running on the same node
+ * (and workers only steal from other groups once their own is empty).
+ *
+ * Tasks whose `lane()` returns 1 are low-priority: each lane has its
+ * own set of queues, and workers only pick up a low-priority task once
+ * there are no high-priority tasks left anywhere (Tasks without a
+ * lane() are high-priority). Capacity is tracked per lane, so a flood
+ * of low-priority tasks never keeps high-priority ones from being queued.
+ *
+ * Each worker records how long it spends running tasks and parked
+ * (see metrics()).
+ *
+ * TaskType must be default-constructible and copy-assignable.
+ */
+template <typename TaskType>
+class WorkStealingPool
+{
+public:
+    using CpuSets = std::vector<std::vector<int>>;
+
+    static constexpr int LANE_COUNT = 2;
+
+    struct Metrics
+    {
+        Counter tasksRun;
+        Histogram busyTime;     // per task
+        Histogram idleTime;     // per stretch of being parked
+    };
+
+    WorkStealingPool(int numberOfThreads, int queueSize, bool pinThreads = false,
+        const CpuSets& numaNodes = {}) :
+        threadCount_(numberOfThreads == 0 ? 1 : numberOfThreads),
+        nextQueue_(0),
+        wakeEpoch_(0),
+        sleeperCount_(0),
+        running_(true),
+        pinThreads_(pinThreads)
+    {
+        capacity_ = queueSize == 0 ? (threadCount_ * 4) : queueSize;
+        uint32_t perQueue = roundUpToPowerOf2(
+            std::max((capacity_ + threadCount_ - 1) / threadCount_, 2));
+        queues_.reserve(threadCount_ * LANE_COUNT);
+        for (int i = 0; i < threadCount_ * LANE_COUNT; i++)
+        {
+            queues_.emplace_back(std::make_unique<WorkQueue>(perQueue));
+        }
+        initGroups(numaNodes);
+        threads_.reserve(threadCount_);
+        for (int i = 0; i < threadCount_; i++)
+        {
+            threads_.emplace_back(&WorkStealingPool::worker, this, i);
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        shutdown();
+    }
+
+    bool tryPost(const TaskType& task)
+    {
+        if (!enqueue(task)) return false;
+        wakeOne();
+        return true;
+    }
+
+    void post(const TaskType& task)
+    {
+        while (!enqueue(task)) std::this_thread::yield();
+        wakeOne();
+    }
+
+    /**
+     * Posts up to `count` tasks in order, stopping at the first task
+     * that cannot be accepted because all queues are full.
+     *
+     * @return the number of tasks that were posted
+     */
+    int tryPostBatch(const TaskType* tasks, int count)
+    {
+        int posted = 0;
+        while (posted < count)
+        {
+            if (!enqueue(tasks[posted])) break;
+            posted++;
+        }
+        if (posted) wakeAll(posted);
+        return posted;
+    }
+
+    int minimumRemainingCapacity(int lane = 0) const
+    {
+        return std::max(capacity_ -
+            pending_[lane].count.load(std::memory_order_relaxed), 0);
+    }
+
+    int threadCount() const { return threadCount_; }
+
+    /// The number of tasks that are queued (in all lanes), but not
+    /// yet picked up by a worker
+    int pendingTasks() const
+    {
+        int count = 0;
+        for (const PendingCount& pending : pending_)
+        {
+            count += pending.count.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    const Metrics& metrics() const { return metrics_; }
+
+    /// Returns the index of the calling thread among the workers of
+    /// its pool, or -1 if it isn't a worker of any pool of this type
+    static int currentWorker() { return currentWorker_; }
+    int groupCount() const { return static_cast<int>(groups_.size()); }
+
+    void shutdown()
+    {
+        running_.store(false, std::memory_order_seq_cst);
+        wakeEpoch_.fetch_add(1, std::memory_order_seq_cst);
+        wakeEpoch_.notify_all();
+        for (auto& th : threads_)
+        {
+            if (th.joinable())
+            {
+                th.join();
+            }
+        }
+    }
+
+private:
+    static constexpr int SPIN_ROUNDS = 64;
+
+    /// A range of workers (and their queues) that live on the same node
+    struct Group
+    {
+        int first;
+        int count;
+        std::vector<int> cpus;
+    };
+
+    static constexpr bool HAS_LANE = requires(const TaskType& task)
+    {
+        { task.lane() } -> std::convertible_to<int>;
+    };
+
+    static int laneOf(const TaskType& task)
+    {
+        if constexpr (HAS_LANE)
+        {
+            return std::clamp(static_cast<int>(task.lane()), 0, LANE_COUNT - 1);
+        }
+        return 0;
+    }
+
+    static constexpr bool HAS_AFFINITY = requires(const TaskType& task)
+    {
+        { task.affinity() } -> std::convertible_to<uint32_t>;
+    };
+
+    void initGroups(const CpuSets& numaNodes)
+    {
+        int nodeCount = std::min(static_cast<int>(numaNodes.size()), threadCount_);
+        if (nodeCount < 2)
+        {
+            groups_.push_back({ 0, threadCount_, {} });
+        }
+        else
+        {
+            int first = 0;
+            for (int i = 0; i < nodeCount; i++)
+            {
+                int count = threadCount_ / nodeCount + (i < threadCount_ % nodeCount);
+                groups_.push_back({ first, count, numaNodes[i] });
+                first += count;
+            }
+        }
+        workerGroups_.resize(threadCount_);
+        for (int g = 0; g < static_cast<int>(groups_.size()); g++)
+        {
+            for (int i = 0; i < groups_[g].count; i++)
+            {
+                workerGroups_[groups_[g].first + i] = g;
+            }
+        }
+    }
+
+    const Group& preferredGroup(const TaskType& task) const
+    {
+        if constexpr (HAS_AFFINITY)
+        {
+            if (groups_.size() > 1)
+            {
+                // Fibonacci hash, so neighbouring keys spread across nodes
+                uint64_t h = static_cast<uint64_t>(task.affinity()) * 0x9E37'79B9'7F4A'7C15ULL;
+                return groups_[(h >> 32) % groups_.size()];
+            }
+        }
+        return groups_[0];
+    }
+
+    static uint32_t roundUpToPowerOf2(uint32_t n)
+    {
+        uint32_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    /**
+     * A bounded multi-producer, multi-consumer ring
+     * (D. Vyukov's sequence-numbered cell design). The owner worker
+     * and any thief consume from the same end, so tasks are still
+     * picked up in roughly FIFO order.
+     */
+    class alignas(64) WorkQueue
+    {
+    public:
+        explicit WorkQueue(uint32_t size) :
+            cells_(new Cell[size]),
+            mask_(size - 1),
+            enqueuePos_(0),
+            dequeuePos_(0)
+        {
+            assert((size & (size - 1)) == 0);
+            for (uint32_t i = 0; i < size; i++)
+            {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(const TaskType& task)
+        {
+            size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;)
+            {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (enqueuePos_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;       // full
+                }
+                else
+                {
+                    pos = enqueuePos_.load(std::memory_order_relaxed);
+                }
+            }
+            cell->task = task;
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(TaskType& task)
+        {
+            size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;)
+            {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (dequeuePos_.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;       // empty
+                }
+                else
+                {
+                    pos = dequeuePos_.load(std::memory_order_relaxed);
+                }
+            }
+            task = std::move(cell->task);
+            cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            TaskType task;
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_;
+        alignas(64) std::atomic<size_t> enqueuePos_;
+        alignas(64) std::atomic<size_t> dequeuePos_;
+    };
+
+    /// The queues of each lane are stored consecutively
+    WorkQueue& queue(int lane, int worker)
+    {
+        return *queues_[lane * threadCount_ + worker];
+    }
+
+    bool enqueue(const TaskType& task)
+    {
+        // Count the task before it becomes visible, so a worker that
+        // dequeues it can never drive the counter negative
+        int lane = laneOf(task);
+        std::atomic<int>& pendingCount = pending_[lane].count;
+        pendingCount.fetch_add(1, std::memory_order_relaxed);
+        uint32_t start = nextQueue_.fetch_add(1, std::memory_order_relaxed);
+        const Group& group = preferredGroup(task);
+        for (int i = 0; i < group.count; i++)
+        {
+            if (queue(lane, group.first + (start + i) % group.count).push(task)) return true;
+        }
+        if (group.count < threadCount_)
+        {
+            // The preferred node is saturated; any other will do
+            for (int i = 0; i < threadCount_; i++)
+            {
+                if (queue(lane, (start + i) % threadCount_).push(task)) return true;
+            }
+        }
+        pendingCount.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool tryTake(int self, TaskType& task)
+    {
+        for (int lane = 0; lane < LANE_COUNT; lane++)
+        {
+            if (tryTake(self, lane, task))
+            {
+                pending_[lane].count.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool tryTake(int self, int lane, TaskType& task)
+    {
+        // Own queue first, then the other queues of our node,
+        // then everyone else's
+        const Group& group = groups_[workerGroups_[self]];
+        for (int i = 0; i < group.count; i++)
+        {
+            if (queue(lane, group.first + (self - group.first + i) % group.count).pop(task))
+            {
+                return true;
+            }
+        }
+        if (group.count == threadCount_) return false;
+        for (int i = 0; i < threadCount_; i++)
+        {
+            if (queue(lane, (self + i) % threadCount_).pop(task)) return true;
+        }
+        return false;
+    }
+
+    void wakeOne()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeperCount_.load(std::memory_order_seq_cst) > 0)
+        {
+            wakeEpoch_.fetch_add(1, std::memory_order_seq_cst);
+            wakeEpoch_.notify_one();
+        }
+    }
+
+    void wakeAll(int count)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeperCount_.load(std::memory_order_seq_cst) > 0)
+        {
+            wakeEpoch_.fetch_add(1, std::memory_order_seq_cst);
+            if (count == 1)
+            {
+                wakeEpoch_.notify_one();
+            }
+            else
+            {
+                wakeEpoch_.notify_all();
+            }
+        }
+    }
+
+    void runTask(TaskType& task)
+    {
+        auto start = std::chrono::steady_clock::now();
+        task();
+        metrics_.busyTime.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        metrics_.tasksRun.add();
+    }
+
+    void worker(int self)
+    {
+        currentWorker_ = self;
+        if (Tracer::COMPILED_IN)
+        {
+            Tracer::setThreadName(("worker " + std::to_string(self)).c_str());
+        }
+        const Group& group = groups_[workerGroups_[self]];
+        if (!group.cpus.empty())
+        {
+            Threads::pinCurrentThread(group.cpus);
+        }
+        else if (pinThreads_)
+        {
+            Threads::pinCurrentThread(self % Threads::hardwareConcurrency());
+        }
+        TaskType task;
+        for (;;)
+        {
+            if (tryTake(self, task))
+            {
+                runTask(task);
+                continue;
+            }
+            bool found = false;
+            for (int i = 0; i < SPIN_ROUNDS && !found; i++)
+            {
+                std::this_thread::yield();
+                found = tryTake(self, task);
+            }
+            if (found)
+            {
+                runTask(task);
+                continue;
+            }
+
+            // Park: register as a sleeper, then check once more, so
+            // a producer either sees us or we see its task
+            uint32_t epoch = wakeEpoch_.load(std::memory_order_seq_cst);
+            sleeperCount_.fetch_add(1, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!running_.load(std::memory_order_seq_cst))
+            {
+                sleeperCount_.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+            if (tryTake(self, task))
+            {
+                sleeperCount_.fetch_sub(1, std::memory_order_relaxed);
+                runTask(task);
+                continue;
+            }
+            {
+                GEODESK_TRACE_SPAN("parked", self);
+                wakeEpoch_.wait(epoch, std::memory_order_seq_cst);
+            }
+            sleeperCount_.fetch_sub(1, std::memory_order_relaxed);
+            if (!running_.load(std::memory_order_acquire)) return;
+        }
+    }
+
+    int threadCount_;
+    int capacity_;
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    std::vector<Group> groups_;
+    std::vector<int> workerGroups_;
+    std::vector<std::thread> threads_;
+    alignas(64) std::atomic<uint32_t> nextQueue_;
+    struct alignas(64) PendingCount
+    {
+        std::atomic<int> count {0};
+    };
+    PendingCount pending_[LANE_COUNT];
+    alignas(64) std::atomic<uint32_t> wakeEpoch_;
+    std::atomic<int> sleeperCount_;
+    std::atomic<bool> running_;
+    bool pinThreads_;
+    Metrics metrics_;
+
+    static inline thread_local int currentWorker_ = -1;
+};
+
+} // namespace clarisma
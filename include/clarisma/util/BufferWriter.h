@@ -13,6 +13,7 @@
 #include <Python.h>
 #endif
 #include <clarisma/data/Span.h>
+#include <clarisma/text/Format.h>
 
 namespace clarisma {
 
@@ -242,6 +243,13 @@ public:
 	void formatUnsignedInt(uint64_t v);
 	void formatDouble(double d, int precision = 15, bool zeroFill = false);
 
+	/// Writes `value / 10^precision` as a decimal number, omitting
+	/// trailing zeroes of the fraction (and the decimal point, if the
+	/// fraction is zero). Unlike formatDouble(), this only uses integer
+	/// arithmetic, so it is cheap for callers that already have a
+	/// scaled value.
+	void formatScaled(int64_t value, int precision);
+
 	void writeJsonEscapedString(const char* s, size_t len);
 	void writeJsonEscapedString(std::string_view sv)
 	{
@@ -275,14 +283,7 @@ public:
 protected:
 	static char* formatUnsignedLongReverse(unsigned long long d, char* end)
 	{
-		do
-		{
-			lldiv_t result = lldiv(d, 10);
-			*(--end) = static_cast<char>('0' + result.rem);
-			d = result.quot;
-		} 
-		while (d != 0);
-		return end;
+		return Format::unsignedIntegerReverse(d, end);
 	}
 
 	static char* formatFractionalReverse(unsigned long long d, char** pEnd, int precision, bool zeroFill)
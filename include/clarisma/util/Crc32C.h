@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace clarisma {
+
+/**
+ * CRC-32C (Castagnoli), as used by iSCSI, ext4 and SSE4.2/ARMv8.
+ * Uses the CPU's CRC instructions where available (selected at
+ * runtime), falling back to a slicing-by-8 table implementation.
+ *
+ * Note that this is a different checksum than Crc32; the two
+ * are not interchangeable.
+ */
+class Crc32C
+{
+public:
+    void update(const void* data, size_t size)
+    {
+        crc_ = compute(data, size, crc_);
+    }
+
+    uint32_t get() const noexcept { return crc_; }
+
+    /**
+     * Returns the CRC-32C of `data`, continuing from `crc` (which is
+     * the result of a previous call, or 0 for a new checksum).
+     */
+    static uint32_t compute(const void* data, size_t size, uint32_t crc = 0);
+
+    /**
+     * Returns true if compute() uses hardware instructions.
+     */
+    static bool isHardwareAccelerated();
+
+private:
+    uint32_t crc_ = 0;
+};
+
+} // namespace clarisma
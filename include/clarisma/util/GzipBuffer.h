@@ -0,0 +1,89 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#ifdef GEODESK_WITH_ZLIB
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <clarisma/util/Buffer.h>
+
+namespace clarisma {
+
+/// A Buffer that gzip-compresses what is written to it, and passes
+/// the compressed bytes on to another Buffer (e.g. a FileBuffer2).
+///
+/// Each block of `blockSize` bytes is compressed as a separate gzip
+/// member. Concatenated members form a valid gzip stream (gunzip and
+/// zlib's gz* functions read them in one pass), which lets us compress
+/// the blocks on multiple threads while the caller keeps writing; the
+/// compressed blocks are written in order. With a `threadCount` of 1,
+/// blocks are compressed on the calling thread.
+///
+/// flush() doesn't force out a partial block (that would hurt the
+/// compression ratio of writers that flush often); call finish() once
+/// all data has been written (or let the destructor do it).
+///
+/// Only available if built with zlib (GEODESK_WITH_ZLIB).
+///
+class GzipBuffer : public Buffer
+{
+public:
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 1024 * 1024;
+
+	/// @param threadCount  0 = one thread per core
+	explicit GzipBuffer(Buffer* out, int level = 6, int threadCount = 0,
+		size_t blockSize = DEFAULT_BLOCK_SIZE);
+	~GzipBuffer() override;
+
+	void filled(char* p) override;
+	void flush(char* p) override;
+
+	/// Compresses the remaining data, writes it, and flushes the
+	/// output Buffer. Nothing can be written afterwards.
+	void finish();
+
+private:
+	struct Job
+	{
+		std::unique_ptr<char[]> input;
+		size_t inputLength;
+		std::vector<char> output;
+		bool done = false;
+		bool failed = false;
+	};
+
+	void nextBlock();
+	void submit(size_t length);
+	void compress(Job& job) const;
+	void writeNext();
+	void writeOutput(Job& job);
+	void work();
+	void stopThreads();
+
+	Buffer* out_;
+	int level_;
+	size_t blockSize_;
+	bool finished_;
+	bool anyWritten_;
+	std::unique_ptr<char[]> block_;				// (buf_ points to it)
+	std::vector<std::unique_ptr<char[]>> spareBlocks_;
+	size_t maxPending_;
+
+	std::mutex mutex_;
+	std::condition_variable workAvailable_;
+	std::condition_variable jobDone_;
+	std::deque<std::unique_ptr<Job>> pending_;	// in output order
+	std::deque<Job*> queue_;					// not yet picked up
+	bool stopping_;
+	std::vector<std::thread> threads_;
+};
+
+} // namespace clarisma
+
+#endif // GEODESK_WITH_ZLIB
@@ -0,0 +1,198 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace clarisma {
+
+namespace metrics {
+
+/// The number of shards of a Counter or Histogram; threads are
+/// assigned to shards round-robin, so up to this many threads can
+/// update a metric without sharing a cache line
+static constexpr uint32_t SHARD_COUNT = 16;
+
+inline uint32_t currentShard() noexcept
+{
+    static std::atomic<uint32_t> nextShard = 0;
+    static thread_local uint32_t shard =
+        nextShard.fetch_add(1, std::memory_order_relaxed) % SHARD_COUNT;
+    return shard;
+}
+
+} // namespace metrics
+
+/**
+ * A monotonic counter that any thread can increment without a lock.
+ * Reading its value sums the shards, so it's meant for occasional
+ * snapshots rather than for hot paths.
+ */
+class Counter
+{
+public:
+    void add(uint64_t n = 1) noexcept
+    {
+        shards_[metrics::currentShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const noexcept
+    {
+        uint64_t total = 0;
+        for (const Shard& shard : shards_) total += shard.value.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> value = 0;
+    };
+
+    Shard shards_[metrics::SHARD_COUNT];
+};
+
+/**
+ * A histogram of durations, in buckets whose upper bounds are powers
+ * of 2 nanoseconds from about 1 µs (2^10 ns) to about 1 s (2^30 ns),
+ * plus a bucket for anything longer. Lock-free like Counter.
+ */
+class Histogram
+{
+public:
+    static constexpr int MIN_BITS = 10;
+    static constexpr int BUCKET_COUNT = 22;     // the last one is unbounded
+
+    void record(uint64_t nanos) noexcept
+    {
+        int bucket = std::clamp(static_cast<int>(std::bit_width(nanos)) - MIN_BITS,
+            0, BUCKET_COUNT - 1);
+        Shard& shard = shards_[metrics::currentShard()];
+        shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(nanos, std::memory_order_relaxed);
+    }
+
+    /// The upper bound (exclusive) of the given bucket, in nanoseconds
+    static uint64_t bucketBound(int bucket)
+    {
+        return bucket < BUCKET_COUNT - 1 ? (1ULL << (MIN_BITS + bucket)) : UINT64_MAX;
+    }
+
+    struct Snapshot
+    {
+        uint64_t buckets[BUCKET_COUNT] = {};
+        uint64_t count = 0;
+        uint64_t sum = 0;       // nanoseconds
+    };
+
+    Snapshot snapshot() const noexcept
+    {
+        Snapshot s;
+        for (const Shard& shard : shards_)
+        {
+            for (int i = 0; i < BUCKET_COUNT; i++)
+            {
+                uint64_t n = shard.buckets[i].load(std::memory_order_relaxed);
+                s.buckets[i] += n;
+                s.count += n;
+            }
+            s.sum += shard.sum.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> buckets[BUCKET_COUNT] = {};
+        std::atomic<uint64_t> sum = 0;
+    };
+
+    Shard shards_[metrics::SHARD_COUNT];
+};
+
+/**
+ * The values of the metrics of a MetricsRegistry at one point in time.
+ */
+struct MetricsSnapshot
+{
+    enum class Kind { COUNTER, GAUGE };
+
+    struct Value
+    {
+        std::string name;
+        std::string help;
+        Kind kind;
+        double value;
+    };
+
+    struct Distribution
+    {
+        std::string name;
+        std::string help;
+        Histogram::Snapshot histogram;
+    };
+
+    std::vector<Value> values;
+    std::vector<Distribution> distributions;
+
+    /// Returns the value of the given counter or gauge (0 if there
+    /// is no such metric)
+    double valueOf(std::string_view name) const;
+
+    /// Appends the metrics in the Prometheus text exposition format.
+    /// `labels` (e.g. `store="world.gol"`) are added to every sample;
+    /// histograms are in seconds.
+    void writePrometheus(std::string& out, std::string_view labels = {}) const;
+};
+
+/**
+ * A named set of metrics. The metrics themselves are owned by the
+ * objects that update them; the registry only knows how to read them.
+ * Registration takes a lock, but reading a snapshot doesn't block
+ * the threads that update the metrics.
+ */
+class MetricsRegistry
+{
+public:
+    void addCounter(std::string name, std::string help, const Counter* counter);
+    void addCounter(std::string name, std::string help, std::function<uint64_t()> read);
+    void addGauge(std::string name, std::string help, std::function<double()> read);
+    /// `read` returns the histogram to sample (which may change over
+    /// time, e.g. if a store switches executors)
+    void addHistogram(std::string name, std::string help,
+        std::function<const Histogram*()> read);
+
+    MetricsSnapshot snapshot() const;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string help;
+        MetricsSnapshot::Kind kind;
+        std::function<double()> read;
+    };
+
+    struct HistogramEntry
+    {
+        std::string name;
+        std::string help;
+        std::function<const Histogram*()> read;
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+    std::vector<HistogramEntry> histograms_;
+};
+
+} // namespace clarisma
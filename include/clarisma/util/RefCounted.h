@@ -25,8 +25,12 @@ public:
 
 	void release() const
 	{
-		if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		// Only the thread that drops the last reference needs to see the
+		// writes of the others (acquire), so we don't pay for acq_rel on
+		// every release (which matters on weakly-ordered CPUs)
+		if (refcount_.fetch_sub(1, std::memory_order_release) == 1)
 		{
+			std::atomic_thread_fence(std::memory_order_acquire);
 			delete this;
 		}
 	}
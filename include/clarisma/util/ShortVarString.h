@@ -156,10 +156,48 @@ public:
 
     const uint8_t* rawBytes() const { return bytes_; }
 
+    class Probe;
+
 private:
     // static constexpr uint8_t EMPTY_BYTES[2] = {0, 0};
 
     uint8_t bytes_[1];
 };
 
+///
+/// Tests ShortVarStrings for equality with a given string, for scans
+/// that compare many strings (such as local keys) against the same one.
+/// The encoded length byte and the last character are checked first,
+/// which rules out most strings without comparing their contents.
+///
+class ShortVarString::Probe
+{
+public:
+    Probe(const char* str, size_t len) :
+        str_(str),
+        len_(static_cast<uint32_t>(len)),
+        lead_(static_cast<uint8_t>(len < 128 ? len : ((len & 0x7F) | 0x80))),
+        last_(len ? static_cast<uint8_t>(str[len-1]) : 0)
+    {
+    }
+
+    explicit Probe(std::string_view s) : Probe(s.data(), s.size()) {}
+
+    bool matches(const ShortVarString* s) const noexcept
+    {
+        const uint8_t* bytes = s->bytes_;
+        if (bytes[0] != lead_) return false;
+        if (len_ >= 128) [[unlikely]] return s->equals(str_, len_);
+        // For short strings, the lead byte is the length itself
+        if (len_ == 0) return true;
+        return bytes[len_] == last_ && memcmp(&bytes[1], str_, len_ - 1) == 0;
+    }
+
+private:
+    const char* str_;
+    uint32_t len_;
+    uint8_t lead_;
+    uint8_t last_;
+};
+
 } // namespace clarisma
@@ -42,6 +42,14 @@ namespace Strings
     {
         return hash(str.data(), str.length());
     }
+
+    /**
+     * Returns the length of the longest prefix of `str` that can be
+     * placed in a JSON string literal as is (i.e. which contains no
+     * quotes, backslashes or control characters). Scans 16 bytes at
+     * a time (using SSE2 if available).
+     */
+    size_t jsonSafePrefix(const char* str, size_t length);
 }
 
 /**
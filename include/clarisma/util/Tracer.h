@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace clarisma {
+
+/**
+ * Collects timed spans and instant events of the threads of this
+ * process, for viewing in chrome://tracing or the Perfetto UI
+ * (ui.perfetto.dev), both of which read the Chrome trace JSON
+ * produced by writeChromeJson().
+ *
+ * Instrumentation points use the GEODESK_TRACE_SPAN and
+ * GEODESK_TRACE_EVENT macros, which compile to nothing unless
+ * GEODESK_TRACING is defined (CMake option of the same name). Even
+ * in a tracing build, nothing is recorded until start() is called.
+ *
+ * Each thread records into a ring buffer of its own (created on its
+ * first event, and kept after the thread exits), so recording never
+ * takes a lock; once a buffer is full, the oldest events of that
+ * thread are overwritten. Names must be string literals (only the
+ * pointer is stored).
+ */
+class Tracer
+{
+public:
+    static constexpr bool COMPILED_IN =
+    #ifdef GEODESK_TRACING
+        true;
+    #else
+        false;
+    #endif
+
+    /// Events per thread; must be a power of 2
+    static constexpr uint32_t BUFFER_CAPACITY = 1 << 16;
+
+    /// Discards all recorded events and begins recording. Must not be
+    /// called while other threads are recording.
+    static void start();
+    static void stop();
+    static bool isEnabled() noexcept
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    static uint64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void record(const char* name, uint64_t start, uint64_t duration, uint64_t arg) noexcept;
+    static void instant(const char* name, uint64_t arg) noexcept
+    {
+        if (isEnabled()) record(name, now(), INSTANT, arg);
+    }
+
+    /// Names the calling thread in the trace (the name is copied)
+    static void setThreadName(const char* name);
+
+    /// Appends the events of all threads as Chrome trace JSON. Should
+    /// only be called while no other thread is recording (events that
+    /// are written during the dump may be garbled).
+    static void writeChromeJson(std::string& out);
+
+    /// Writes the Chrome trace JSON to the given file
+    ///
+    /// @throws IOException if the file can't be written
+    static void writeChromeJson(const char* fileName);
+
+    struct Buffer;      // the events of one thread
+
+private:
+    static constexpr uint64_t INSTANT = ~0ULL;
+
+    static Buffer* currentBuffer();
+
+    static std::atomic<bool> enabled_;
+};
+
+/**
+ * Records the lifetime of this object as a span (if tracing has been
+ * started when it is created).
+ */
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name, uint64_t arg) noexcept :
+        name_(name),
+        arg_(arg),
+        start_(Tracer::isEnabled() ? Tracer::now() : 0)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (start_) Tracer::record(name_, start_, Tracer::now() - start_, arg_);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name_;
+    uint64_t arg_;
+    uint64_t start_;
+};
+
+} // namespace clarisma
+
+#ifdef GEODESK_TRACING
+#define GEODESK_TRACE_CONCAT_(a, b) a##b
+#define GEODESK_TRACE_CONCAT(a, b) GEODESK_TRACE_CONCAT_(a, b)
+/// Traces the rest of the enclosing scope
+#define GEODESK_TRACE_SPAN(name, arg) \
+    clarisma::TraceSpan GEODESK_TRACE_CONCAT(traceSpan_, __LINE__)(name, arg)
+#define GEODESK_TRACE_EVENT(name, arg) clarisma::Tracer::instant(name, arg)
+#else
+#define GEODESK_TRACE_SPAN(name, arg) ((void)0)
+#define GEODESK_TRACE_EVENT(name, arg) ((void)0)
+#endif
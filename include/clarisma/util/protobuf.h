@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <vector>
 #include <clarisma/data/Span.h>
 #include <clarisma/util/varint.h>
 
@@ -35,6 +36,12 @@ namespace protobuf
 
 	using Field = uint32_t;
 
+	/// Returns the key of a field with the given number and wire type
+	constexpr Field field(int number, Type type)
+	{
+		return (static_cast<Field>(number) << 3) | type;
+	}
+
 	inline ByteSpan readMessage(const uint8_t*& p)
 	{
 		uint32_t size = readVarint32(p);
@@ -70,6 +77,56 @@ namespace protobuf
 		}
 	}
 
+	/// Decodes the varints in [p, end) into `out`, which must have room
+	/// for one value per byte, and returns their number. A truncated
+	/// varint at the end is ignored.
+	///
+	/// Runs of 16 single-byte varints (the common case for packed
+	/// keys, roles and small deltas) are detected with one SIMD compare;
+	/// otherwise, all varints that end within the next 8 bytes are
+	/// located via their stop bits and unpacked with shifts and masks.
+	///
+	size_t decodeVarints(const uint8_t* p, const uint8_t* end, uint64_t* out);
+
+	/// Turns the zigzag-encoded values into signed values (in place).
+	/// If `delta` is true, each value is the difference to the previous
+	/// one, and the running sums are stored instead.
+	void decodeZigzag(uint64_t* values, size_t count, bool delta);
+
+	/// Decodes a packed field of uint32, uint64 or enum values
+	template<typename T>
+	void readPackedVarints(ByteSpan packed, std::vector<T>& out)
+	{
+		if constexpr (sizeof(T) == 8)
+		{
+			out.resize(packed.size());
+			out.resize(decodeVarints(packed.data(), packed.data() + packed.size(),
+				reinterpret_cast<uint64_t*>(out.data())));
+		}
+		else
+		{
+			std::vector<uint64_t> values;
+			readPackedVarints(packed, values);
+			out.assign(values.begin(), values.end());
+		}
+	}
+
+	/// Decodes a packed field of sint64 values. If `delta` is true, the
+	/// values are delta-encoded (like the IDs and coordinates of
+	/// DenseNodes, the node IDs of ways and the member IDs of relations),
+	/// and `out` receives their running sums. `T` must be a 64-bit
+	/// integer type.
+	template<typename T>
+	void readPackedSInt64(ByteSpan packed, std::vector<T>& out, bool delta = false)
+	{
+		static_assert(sizeof(T) == 8);
+		out.resize(packed.size());
+		uint64_t* values = reinterpret_cast<uint64_t*>(out.data());
+		size_t count = decodeVarints(packed.data(), packed.data() + packed.size(), values);
+		decodeZigzag(values, count, delta);
+		out.resize(count);
+	}
+
 } // end namespace
 
 
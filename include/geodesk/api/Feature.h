@@ -23,6 +23,13 @@ namespace geodesk {
 ///
 /// @brief A geographic feature.
 ///
+/// A Feature is a lightweight handle (a pointer to the feature's
+/// data, and a non-owning pointer to its FeatureStore). Copying it
+/// costs no more than copying two pointers, even if GeoDesk is built
+/// with `GEODESK_MULTITHREADED`: it doesn't hold a reference to the
+/// store, so it must not be used after every @ref Features object
+/// of that store has been destroyed.
+///
 class Feature
 {
 public:
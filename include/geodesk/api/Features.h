@@ -144,6 +144,11 @@ public:
 
     /// @brief Checks if the specified Feature exists in this collection.
     ///
+    /// For collections of features in a GOL (as opposed to the members,
+    /// parents or nodes of a feature), this doesn't run a query; the
+    /// feature's type, bounding box, tags and any spatial filters are
+    /// checked directly, making this cheap enough for tight loops.
+    ///
     bool contains(const Feature& feature) const;
 
     /// @}
@@ -223,6 +228,69 @@ public:
     ///
     Feature one() const;
 
+    /// @brief Returns the Feature with the given type and ID, or `std::nullopt`
+    /// if this collection contains no such Feature.
+    ///
+    /// Features are located via an index of IDs, which is built on first
+    /// use and saved alongside the GOL (as `<gol-file>.ids`), so later
+    /// lookups don't need to scan the tiles:
+    ///
+    /// ```
+    /// std::optional<Feature> way = world.byId(FeatureType::WAY, 123);
+    /// ```
+    ///
+    /// @param type the type of the Feature
+    /// @param id its OSM ID
+    ///
+    std::optional<Feature> byId(FeatureType type, uint64_t id) const;
+
+    /// @brief Returns the Features with the given typed IDs that are
+    /// part of this collection.
+    ///
+    /// Lookups are grouped by tile, so each tile is fetched only once.
+    /// The Features are returned in tile order rather than in the order
+    /// of `ids`; IDs that aren't found are skipped.
+    ///
+    /// @param ids the typed IDs (see TypedFeatureId::ofTypeAndId())
+    ///
+    std::vector<Feature> byIds(std::span<const TypedFeatureId> ids) const;
+
+    /// @brief Returns the Features in this collection whose name
+    /// (the value of `name`, or of any `name:*` tag) contains the
+    /// given text, ignoring case.
+    ///
+    /// ```
+    /// std::vector<Feature> stations = world("n[railway=station]").searchNames("bahnhof");
+    /// ```
+    ///
+    /// If the store has a name index (see FeatureStore::buildNameIndex()),
+    /// only the features whose names have all trigrams (runs of three
+    /// bytes) of the text are checked; otherwise, or if the text is
+    /// shorter than three bytes, all Features are scanned. The Features
+    /// are returned in tile order.
+    ///
+    /// @param text the text to look for
+    ///
+    std::vector<Feature> searchNames(std::string_view text) const;
+
+    /// @brief Returns the Features in this collection whose value for
+    /// the given key is a number between `min` and `max` (inclusive).
+    ///
+    /// ```
+    /// std::vector<Feature> peaks = world("n[natural=peak]").searchRange("ele", 3000, 5000);
+    /// ```
+    ///
+    /// If the store has a numeric index for the key (see
+    /// FeatureStore::buildNumericIndex()), only the Features whose
+    /// values lie within the range are looked at; otherwise, all
+    /// Features are scanned. The Features are returned in tile order.
+    ///
+    /// @param key the key whose values to check
+    /// @param min the smallest value
+    /// @param max the largest value
+    ///
+    std::vector<Feature> searchRange(std::string_view key, double min, double max) const;
+
     /// @brief Returns a `std::vector` with the Feature objects in this collection.
     ///
     operator std::vector<Feature>() const;
@@ -250,6 +318,115 @@ public:
     ///
     uint64_t count() const;
 
+    /// @brief Estimates the number of features in this collection,
+    /// scanning only a sample of its tiles.
+    ///
+    /// Tiles are sampled evenly across the query area, and the number of
+    /// features found in them is scaled to all tiles. Collections that
+    /// aren't based on a bounding-box query (such as the nodes of a way)
+    /// are always counted exactly.
+    ///
+    /// ```
+    /// CountEstimate e = world("a[building]").within(germany).estimateCount(0.02);
+    /// std::cout << "About " << e.count << " (" << e.lower << " to " << e.upper << ")";
+    /// ```
+    ///
+    /// @param sampleFraction the approximate share of tiles to scan
+    ///   (1 or more counts all features)
+    ///
+    CountEstimate estimateCount(double sampleFraction = 0.05) const;
+
+    /// @brief Looks up the values of the given tags for all features
+    /// in this collection, and returns them column by column.
+    ///
+    /// Each key is resolved only once, and the tag table of each
+    /// feature is scanned only once for all keys. For collections that
+    /// are backed by a spatial query, the lookups run on the threads
+    /// that scan the tiles. Rows are in no particular order.
+    ///
+    /// ```
+    /// TagColumns t = world("w[highway]").select({"name", "highway", "maxspeed"});
+    /// for (size_t i = 0; i < t.size(); i++)
+    /// {
+    ///     std::cout << t(i, 0) << ": " << t(i, 1) << '\n';
+    /// }
+    /// ```
+    ///
+    TagColumns select(std::initializer_list<std::string_view> keys) const;
+
+    /// @brief Groups the features in this collection by the value
+    /// of the given tag.
+    ///
+    /// The resulting GroupBy counts the features with each value
+    /// (or adds up their length, area or any other measure). For
+    /// collections that are backed by a spatial query, the features are
+    /// tallied on the threads that scan the tiles, and strings are only
+    /// created for the final groups. Groups with the most features
+    /// come first; features without the tag are not counted.
+    ///
+    /// ```
+    /// for (const TagGroup& g : world("w[highway]").groupBy("highway").length())
+    /// {
+    ///     std::cout << g.value << ": " << g.count << " ways, "
+    ///         << g.sum / 1000 << " km\n";
+    /// }
+    /// ```
+    ///
+    GroupBy groupBy(std::string_view key) const;
+
+    /// @brief Builds the network formed by the ways in this collection.
+    ///
+    /// The resulting WayGraph is an adjacency list in compressed sparse
+    /// row form: its vertices are the end points of the ways and the
+    /// nodes they share, and its edges are the stretches of ways between
+    /// them (with the ID of the way and the length in meters). Ways are
+    /// joined wherever they share a node, even across tile boundaries.
+    /// Nodes and relations in this collection are ignored. For
+    /// collections that are backed by a spatial query, the ways are
+    /// decoded and measured on the threads that scan the tiles.
+    ///
+    /// ```
+    /// WayGraph graph = world("w[highway]")(bounds).graph();
+    /// size_t v = 0;  // the first vertex
+    /// for (uint32_t e = graph.edgesStart(v); e < graph.edgesEnd(v); e++)
+    /// {
+    ///     std::cout << "to " << graph.target(e) << " via way/"
+    ///         << graph.way(e) << ": " << graph.length(e) << " m\n";
+    /// }
+    /// ```
+    ///
+    WayGraph graph() const;
+
+    /// @brief Places the coordinates of all features in this collection
+    /// into a single contiguous buffer.
+    ///
+    /// The resulting FlatCoordinates holds `int32_t` (Mercator) or `double`
+    /// (longitude/latitude) pairs, with offsets into these for each part
+    /// (point, line or ring) and into the parts for each feature, ready
+    /// to be handed to a GPU or an array library. No Feature or geometry
+    /// objects are created along the way; for collections that are backed
+    /// by a spatial query, the coordinates are decoded on the threads that
+    /// scan the tiles (hence, the features are in no particular order).
+    ///
+    /// ```
+    /// FlatCoordinates flat = world("a[building]")(bounds).coordinates();
+    /// glBufferData(GL_ARRAY_BUFFER, flat.mercator().size_bytes(),
+    ///     flat.mercator().data(), GL_STATIC_DRAW);
+    /// ```
+    ///
+    /// For low-zoom maps, pass a `tolerance` (in Mercator units): if the
+    /// store has generalized geometries (see
+    /// FeatureStore::buildGeneralizedGeometry()), the ways and area
+    /// relations are then taken from the coarsest level of simplified
+    /// geometry that doesn't exceed this tolerance, rather than at full
+    /// resolution.
+    ///
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    ///
+    FlatCoordinates coordinates(CoordinateFormat format = CoordinateFormat::MERCATOR,
+        double tolerance = 0) const;
+
     /// @brief Computes the total length (in meters) of the features
     /// in this collection.
     ///
@@ -266,6 +443,155 @@ public:
     ///
     double area() const;
 
+    /// @brief Maps each feature to a value and combines these values
+    /// into a single result, using all available threads.
+    ///
+    /// ```
+    /// // Longest highway segment in Paris
+    /// double longest = roads.within(paris).reduce(0.0,
+    ///     [](Feature f) { return f.length(); },
+    ///     [](double a, double b) { return std::max(a, b); });
+    /// ```
+    ///
+    /// `map` and `combine` are called concurrently from the threads
+    /// that execute the query, in no particular order. They must be
+    /// thread-safe, `combine` must be associative and commutative,
+    /// and `init` must be its identity value.
+    ///
+    /// @param init the initial value of the result
+    /// @param map a function that turns a Feature into a value of type `R`
+    /// @param combine a function that merges two values of type `R`
+    ///
+    template <typename R, typename Map, typename Combine>
+    R reduce(R init, Map map, Combine combine) const;
+
+    /// @brief Calls a function for each feature in this collection,
+    /// using all available threads.
+    ///
+    /// Unlike iterating with `for`, which hands every feature to the
+    /// calling thread, the callback is invoked directly by the threads
+    /// that execute the query. It must therefore be thread-safe, and
+    /// features are visited in no particular order. The function returns
+    /// once every feature has been visited.
+    ///
+    /// ```
+    /// std::atomic<uint64_t> named = 0;
+    /// world("na[amenity=restaurant]").parallelForEach([&](Feature f)
+    ///     { if(f["name"]) named++; });
+    /// ```
+    ///
+    /// @param fn a function that accepts a Feature
+    ///
+    template <typename Fn>
+    void parallelForEach(Fn fn) const;
+
+    /// @brief Calls a function for each feature that intersects any
+    /// of the given bounding boxes, along with the index of the box.
+    ///
+    /// A feature that intersects several boxes is passed once for each
+    /// of them. This is much cheaper than running a separate query for
+    /// each box, since every tile is fetched and scanned only once,
+    /// which makes it well-suited for many small, overlapping areas
+    /// (such as map tiles):
+    ///
+    /// ```
+    /// std::vector<Box> boxes = { ... };
+    /// world("w[highway]").forEachInBoxes(boxes,
+    ///     [&](Feature f, uint32_t box) { render(box, f); });
+    /// ```
+    ///
+    /// @param boxes bounding boxes that don't cross the Antimeridian
+    /// @param fn a function that accepts a Feature and a `uint32_t` box index
+    ///
+    template <typename Fn>
+    void forEachInBoxes(const std::vector<Box>& boxes, Fn fn) const;
+
+    /// @brief Calls `fn` for each area in this collection that
+    /// contains one of the given points (a point on an area's boundary
+    /// counts as contained).
+    ///
+    /// This is much faster than looking up the areas of each point
+    /// separately: the tile index is walked only once, and each area
+    /// is prepared once and tested against all the points that lie
+    /// in its bounding box. `fn` is called on the calling thread, in
+    /// order of point index:
+    ///
+    /// ```
+    /// std::vector<Coordinate> fixes = ...;
+    /// world("a[boundary=administrative][admin_level=8]").forEachContainingArea(fixes,
+    ///     [&](size_t i, Feature area) { city[i] = area["name"]; });
+    /// ```
+    ///
+    /// @param points the points to locate
+    /// @param fn a function that accepts a `size_t` point index and a Feature
+    ///
+    template <typename Fn>
+    void forEachContainingArea(std::span<const Coordinate> points, Fn fn) const;
+
+    /// @brief Returns the `k` features closest to the given
+    /// Coordinate, nearest first.
+    ///
+    /// The distance of a feature is measured to its closest point;
+    /// it is zero if `xy` lies inside an area. Tiles and index branches
+    /// are visited in order of distance, so only the tiles around `xy`
+    /// are read, no matter how large the collection:
+    ///
+    /// ```
+    /// std::vector<Feature> cafes = world("na[amenity=cafe]").nearest(xy, 5, 2000);
+    /// ```
+    ///
+    /// @param xy the point from which distances are measured
+    /// @param k the maximum number of features to return
+    /// @param maxMeters only consider features within this
+    ///   distance (in meters)
+    ///
+    std::vector<Feature> nearest(Coordinate xy, size_t k,
+        double maxMeters = std::numeric_limits<double>::infinity()) const;
+
+    /// @brief Returns a description of how this collection is queried:
+    /// the kind of view, its bounding box, the index bits used by the
+    /// tag matcher, and the chain of spatial filters (if any).
+    ///
+    std::string explain() const;
+
+    /// @brief Runs the query and returns its execution statistics,
+    /// without creating any Feature objects.
+    ///
+    /// The statistics include the number of tiles visited and skipped,
+    /// index branches and leaves scanned, candidate features tested by
+    /// the matcher and filters, and the time spent by the calling thread
+    /// and the worker threads.
+    ///
+    /// ```
+    /// std::cout << world("w[highway]").within(paris).profile().toString();
+    /// ```
+    ///
+    QueryStats profile() const;
+
+    /// @brief Returns an AsyncFeatures that retrieves the features in
+    /// batches, without blocking the calling thread while tiles are
+    /// being scanned -- e.g. from a coroutine on an event loop:
+    ///
+    /// ```
+    /// auto features = world("na[amenity]").async(
+    ///     [&loop](std::function<void()> job) { loop.post(std::move(job)); });
+    /// for (;;)
+    /// {
+    ///     std::vector<Feature> batch = co_await features.nextBatch();
+    ///     if (batch.empty()) break;
+    ///     ...
+    /// }
+    /// ```
+    ///
+    /// Event loops without coroutines can call `tryNextBatch()` and
+    /// use `onReady()` to be notified once more features are available.
+    ///
+    /// @param scheduler a thread-safe function that runs a job on
+    ///   the caller's event loop (required for `nextBatch()`)
+    ///
+    AsyncFeatures<Feature> async(
+        std::function<void(std::function<void()>)> scheduler = nullptr) const;
+
     /// @}
     /// @name Spatial Filters
     /// @{
@@ -349,6 +675,17 @@ public:
     ///
     Features maxMetersFrom(double distance, double lon, double lat) const;
 
+    /// @brief Only features whose closest point lies within
+    /// `distance` meters of the geometry of the given Feature.
+    ///
+    /// @param distance the maximum distance (in meters)
+    /// @param feature the feature to measure from
+    ///
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    ///
+    Features maxMetersFrom(double distance, const Feature& feature) const;
+
     /// @}
     /// @name Topological Filters
     /// @{
@@ -383,7 +720,9 @@ public:
     ///  Feature and return a `bool`.
     ///
     /// **Important:** The provided predicate must be
-    /// thread-safe, as it may be invoked concurrently.
+    /// thread-safe: it is evaluated by the query's worker
+    /// threads, several of which may invoke it at the
+    /// same time.
     ///
     /// ```
     /// // Find all parks whose area is at least 1 km²
@@ -396,6 +735,32 @@ public:
     template <typename Predicate>
     Features filter(Predicate predicate) const;
 
+    /// @brief Only features that match the given predicate,
+    /// which receives a per-thread scratch object.
+    ///
+    /// Each worker thread gets its own default-constructed
+    /// `Context`, which it passes to the predicate along with
+    /// each Feature. This allows the predicate to reuse
+    /// buffers (or other state) without allocating or
+    /// locking for every feature.
+    ///
+    /// @tparam Context the type of the scratch object
+    /// @param predicate A callable object that accepts a
+    ///  Feature and a `Context&`, and returns a `bool`
+    ///
+    /// ```
+    /// struct Scratch { std::vector<Coordinate> coords; };
+    ///
+    /// Features zigzags = roads.filter<Scratch>(
+    ///     [](Feature road, Scratch& scratch)
+    ///     {
+    ///         scratch.coords.clear();
+    ///         // ... collect and inspect the road's coordinates
+    ///     });
+    /// ```
+    template <typename Context, typename Predicate>
+    Features filter(Predicate predicate) const;
+
     /// @}
     /// @name Metadata
     /// @{
@@ -0,0 +1,111 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/ZoomLevels.h>
+
+namespace geodesk {
+
+///
+/// \cond lowlevel
+///
+/// Builds a GOL from an .osm.pbf file, without the need for the
+/// GOL Tool.
+///
+/// The input is read several times; in each pass, its blocks are
+/// decoded in parallel:
+///
+/// 1. The locations of all nodes are stored in a sparse file indexed
+///    by node ID, while the nodes of each area are counted (to lay out
+///    the tile pyramid) and strings are counted (to pick the global
+///    strings). Members of relations are noted in IndexFiles, since
+///    untagged nodes and ways that belong to relations are features
+///    (as are tagged nodes, which ways list in their way-node tables).
+/// 2. Nodes and ways that are features are sorted into piles (one per
+///    tile) of a PileFile. The bounding boxes of ways are kept, so
+///    relations can be placed. Ways tell their feature nodes that
+///    they belong to a way.
+/// 3. The bounding boxes of relations are determined (including those
+///    of nested relations).
+/// 4. Relations are added to the piles of their tiles; their members
+///    are told which relations they belong to.
+///
+/// The tiles are then encoded in parallel: first, each is laid out to
+/// determine the offsets of its features (which are stored in IndexFiles,
+/// since features refer to members and parent relations in other tiles),
+/// then each is encoded and written, in the order of the tile index.
+///
+/// Memory use is bounded: locations, bounding boxes and offsets live in
+/// memory-mapped files in the work directory (which are removed once
+/// the GOL has been written), and only one tile per thread is held in
+/// memory at a time.
+///
+/// A tile whose area contains more than `minTileDensity` nodes is split
+/// into tiles at the next zoom level. Each feature is placed into the
+/// tiles at the highest zoom level at which its bounding box spans at
+/// most 2 x 2 tiles.
+///
+/// Not supported (yet): updates.
+/// Relations whose members are all missing (as is common at the edges
+/// of regional extracts) are omitted; so are ways that have fewer than
+/// two nodes with known locations.
+///
+class GEODESK_API GolBuilder
+{
+public:
+    struct Settings
+    {
+        uint32_t zoomLevels = ZoomLevels::DEFAULT;
+        /// The number of worker threads (0 = one per core)
+        int threads = 0;
+        /// Tiles with more nodes are split into smaller tiles
+        uint32_t minTileDensity = 75'000;
+        /// The maximum number of global strings
+        uint32_t maxStrings = 32'000;
+        /// Strings must be used at least this often to be global
+        uint32_t minStringUsage = 300;
+        /// The keys that are indexed; keys joined by `/` share a category
+        std::vector<std::string> indexedKeys =
+        {
+            "place", "highway", "railway", "aeroway", "aerialway", "tourism",
+            "amenity", "shop", "craft", "power", "industrial", "man_made",
+            "leisure", "landuse", "waterway", "natural/geological", "military",
+            "historic", "healthcare", "office", "emergency", "building",
+            "boundary", "building:part", "telecom", "communication", "route"
+        };
+        /// Where the temporary files go (the folder of the GOL if empty)
+        std::string workPath;
+    };
+
+    struct Stats
+    {
+        uint64_t nodes = 0;         // nodes that are features
+        uint64_t ways = 0;
+        uint64_t relations = 0;
+        uint32_t tiles = 0;
+        uint32_t strings = 0;       // global strings
+        uint64_t fileSize = 0;
+    };
+
+    explicit GolBuilder(const Settings& settings) : settings_(settings) {}
+
+    /// Builds the GOL, replacing any existing file.
+    ///
+    /// @throws ValueException if the settings are invalid, or the
+    ///   input isn't a valid .osm.pbf file
+    /// @throws IOException if a file can't be read or written
+    ///
+    Stats build(const char* pbfFile, const char* golFile) const;
+
+private:
+    Settings settings_;
+};
+
+// \endcond
+
+} // namespace geodesk
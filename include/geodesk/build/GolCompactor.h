@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <geodesk/export.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+///
+/// \cond lowlevel
+///
+/// Writes a compacted copy of a GOL: all tile blobs are laid out
+/// back-to-back in a fresh file, in the order of the Hilbert curve
+/// (so that tiles which are close to each other on the map are also
+/// close to each other in the file, which is the order in which
+/// queries visit them), or in the order of their TIPs. The pages that
+/// were left empty by updates or removed tiles are dropped, which also
+/// leaves the copy without any free pages.
+///
+/// The tile index keeps its layout (the TIPs of all tiles stay the
+/// same, only their pages change), and so do the string table and the
+/// index schema; the copy has the same creation timestamp as the
+/// original, but since sidecar files also check the size of the GOL,
+/// they have to be rebuilt (except for the dictionary of compressed
+/// tiles, which is copied).
+///
+/// Optionally, tiles are compressed or decompressed along the way
+/// (see TileCompression; requires zlib). This work is spread across
+/// multiple threads, while the blobs are written in order.
+///
+class GEODESK_API GolCompactor
+{
+public:
+    enum class Order
+    {
+        HILBERT,    // by the Hilbert distance of the tile centers
+        TIP         // in the order of the tile index
+    };
+
+    enum class Compression
+    {
+        KEEP,       // tiles are copied as they are
+        COMPRESS,   // tiles are compressed (if this makes them smaller)
+        DECOMPRESS  // compressed tiles are decompressed
+    };
+
+    struct Settings
+    {
+        Order order = Order::HILBERT;
+        Compression compression = Compression::KEEP;
+        /// The zlib compression level (1 - 9)
+        int compressionLevel = 9;
+        /// The number of worker threads (0 = one per core)
+        int threads = 0;
+    };
+
+    struct Stats
+    {
+        uint32_t tiles = 0;
+        uint32_t compressedTiles = 0;   // tiles that are compressed in the copy
+        uint64_t sourceSize = 0;        // size of the original GOL
+        uint64_t fileSize = 0;          // size of the copy
+    };
+
+    explicit GolCompactor(const Settings& settings) : settings_(settings) {}
+
+    /// Writes a compacted copy of the store, replacing any existing file.
+    ///
+    /// @throws ValueException if the settings are invalid, compression
+    ///   isn't supported, or the copy would replace the store itself
+    /// @throws IOException if the file can't be written
+    ///
+    Stats compact(FeatureStore* store, const char* golFile) const;
+
+private:
+    Settings settings_;
+};
+
+// \endcond
+
+} // namespace geodesk
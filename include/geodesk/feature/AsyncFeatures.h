@@ -0,0 +1,172 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <geodesk/feature/FeatureIterator.h>
+#include <geodesk/feature/View.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Retrieves the features of a collection in batches, without blocking
+/// the calling thread while tiles are being scanned. Results can be
+/// consumed by polling (tryNextBatch() and onReady()), or from a
+/// coroutine:
+///
+/// ```
+/// AsyncFeatures<Feature> features = world("na[amenity]").async(postToLoop);
+/// for (;;)
+/// {
+///     std::vector<Feature> batch = co_await features.nextBatch();
+///     if (batch.empty()) break;
+///     ...
+/// }
+/// ```
+///
+/// Only world views are queried asynchronously; other collections
+/// (nodes of a way, members of a relation, etc.) yield all of their
+/// features as a single batch. An AsyncFeatures must not be moved
+/// while a coroutine is waiting on it.
+///
+template<typename T>
+class AsyncFeatures
+{
+public:
+    using Status = Query::Status;
+
+    /// Runs a job on the caller's event loop. It is called from the
+    /// query's worker threads, so it must be thread-safe (and should
+    /// merely enqueue the job).
+    using Scheduler = std::function<void(std::function<void()>)>;
+
+    AsyncFeatures(const View& view, Scheduler scheduler = nullptr) :
+        view_(view),
+        scheduler_(std::move(scheduler)),
+        done_(false)
+    {
+        if (view.view() == View::WORLD)
+        {
+            query_ = std::make_unique<Query>(view.store(), view.bounds(),
+                view.types(), view.matcher(), view.filter());
+        }
+    }
+
+    /// Appends the features that are available right now to `batch`.
+    ///
+    Status tryNextBatch(std::vector<T>& batch)
+    {
+        if (done_) return Status::DONE;
+        if (!query_)
+        {
+            done_ = true;
+            size_t startSize = batch.size();
+            for (FeatureIterator<T> iter(view_); iter != nullptr; ++iter)
+            {
+                batch.push_back(*iter);
+            }
+            return batch.size() > startSize ? Status::READY : Status::DONE;
+        }
+        ptrs_.clear();
+        Status status = query_->poll(ptrs_);
+        for (FeaturePtr p : ptrs_) batch.push_back(T(view_.store(), p));
+        if (status == Status::DONE) done_ = true;
+        return status;
+    }
+
+    /// Calls `callback(context)` (from a worker thread) once
+    /// tryNextBatch() has something new to return.
+    ///
+    /// @return false if results are available already (the callback
+    ///   won't be called)
+    ///
+    bool onReady(Query::ReadyCallback callback, void* context)
+    {
+        if (done_ || !query_) return false;
+        return query_->onReady(callback, context);
+    }
+
+    class NextBatch
+    {
+    public:
+        explicit NextBatch(AsyncFeatures* features) : features_(features) {}
+
+        bool await_ready()
+        {
+            return features_->tryNextBatch(features_->batch_) != Status::PENDING;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            features_->waiting_ = handle;
+            for (;;)
+            {
+                if (features_->onReady(&AsyncFeatures::ready, features_)) return true;
+                // Something arrived in the meantime; no need to suspend
+                // unless it was only empty tiles
+                if (features_->tryNextBatch(features_->batch_) != Status::PENDING) return false;
+            }
+        }
+
+        std::vector<T> await_resume()
+        {
+            std::vector<T> batch = std::move(features_->batch_);
+            features_->batch_.clear();
+            return batch;
+        }
+
+    private:
+        AsyncFeatures* features_;
+    };
+
+    /// Returns an awaitable that yields the next batch of features
+    /// (an empty batch once all features have been returned). Requires
+    /// a Scheduler, which is used to resume the coroutine on the
+    /// caller's event loop.
+    ///
+    NextBatch nextBatch()
+    {
+        assert(scheduler_);
+        return NextBatch(this);
+    }
+
+private:
+    static void ready(void* context)
+    {
+        AsyncFeatures* self = static_cast<AsyncFeatures*>(context);
+        self->scheduler_([self]() { self->resume(); });
+    }
+
+    /// Runs on the event loop: collects the new features, and resumes
+    /// the coroutine unless they turned out to be only empty tiles
+    void resume()
+    {
+        for (;;)
+        {
+            if (tryNextBatch(batch_) != Status::PENDING)
+            {
+                waiting_.resume();
+                return;
+            }
+            if (onReady(&AsyncFeatures::ready, this)) return;
+        }
+    }
+
+    View view_;
+    Scheduler scheduler_;
+    std::unique_ptr<Query> query_;
+    std::vector<FeaturePtr> ptrs_;
+    std::vector<T> batch_;
+    std::coroutine_handle<> waiting_;
+    bool done_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TileCache.h>
 
 namespace geodesk {
 
@@ -12,17 +13,24 @@ namespace geodesk {
 class FastMemberIterator
 {
 public:
-	FastMemberIterator(FeatureStore* store, RelationPtr relation);
+	FastMemberIterator(FeatureStore* store, RelationPtr relation,
+		TileCache* tiles = nullptr);
 
 	FeatureStore* store() const { return store_; }
 	FeaturePtr next();
 
+	/// The cache used to resolve foreign tiles (if none was passed
+	/// to the constructor, each iterator uses its own)
+	TileCache& tiles() { return sharedTiles_ ? *sharedTiles_ : ownTiles_; }
+
 private:
 	FeatureStore* store_;
 	Tip currentTip_;
 	int32_t currentMember_;
 	DataPtr p_;
 	DataPtr pForeignTile_;
+	TileCache* sharedTiles_;
+	TileCache ownTiles_;
 };
 
 // \endcond
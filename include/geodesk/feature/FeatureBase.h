@@ -15,6 +15,7 @@
 #include <geodesk/geom/Centroid.h>
 #include <geodesk/geom/Length.h>
 #include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/polygon/LabelPoint.h>
 
 #ifdef GEODESK_WITH_GEOS
 #include <geos_c.h>
@@ -332,6 +333,20 @@ public:
         return Centroid::ofRelation(store_.ptr(), RelationPtr(feature_.ptr));
     }
 
+    /// Finds the place for the label of this Feature: for an area, the
+    /// point inside it that lies farthest from its boundary (unlike
+    /// the centroid, this point never lies outside a concave area);
+    /// for any other feature, its centroid.
+    ///
+    /// @return the label point (in Mercator projection)
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    [[nodiscard]] Coordinate labelPoint() const
+    {
+        if (isNode()) return xy();
+        return LabelPoint::ofFeature(store_.ptr(), FeaturePtr(feature_.ptr));
+    }
+
     /// @brief Measures the area of a feature
     ///
     /// @return area (in square meters), or `0` if the feature is not polygonal
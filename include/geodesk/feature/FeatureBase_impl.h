@@ -6,6 +6,9 @@
 #include <geodesk/feature/FeatureBase.h>
 #include <geodesk/feature/Features.h>
 #include <geodesk/feature/Nodes.h>
+#ifdef GEODESK_WITH_GEOS
+#include <geodesk/geom/GeometryBuilder.h>
+#endif
 
 // \cond
 
@@ -13,6 +16,19 @@ namespace geodesk {
 
 // TODO: Add type constraints to nodes/members
 
+#ifdef GEODESK_WITH_GEOS
+template<typename T>
+GEOSGeometry* FeatureBase<T>::toGeometry(GEOSContextHandle_t geosContext) const
+{
+    if(isAnonymousNode())
+    {
+        return GeometryBuilder::buildPointGeometry(
+            anonymousNode_.xy.x, anonymousNode_.xy.y, geosContext);
+    }
+    return GeometryBuilder::buildFeatureGeometry(store(), ptr(), geosContext);
+}
+#endif
+
 template<typename T>
 Nodes FeatureBase<T>::nodes() const
 {
@@ -13,8 +13,8 @@ template<typename T>
 class FeatureIterator : protected FeatureIteratorBase
 {
 public:
-    explicit FeatureIterator(const View& view) :
-        FeatureIteratorBase(view) {}
+    explicit FeatureIterator(const View& view, bool record = false) :
+        FeatureIteratorBase(view, record) {}
 
     // Dereference operator
     T operator*() const noexcept
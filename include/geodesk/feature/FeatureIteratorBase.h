@@ -20,7 +20,10 @@ namespace geodesk {
 class GEODESK_API FeatureIteratorBase
 {
 public:
-    explicit FeatureIteratorBase(const View& view);
+    /// If `record` is true and the store has a QueryRecorder, the
+    /// query is recorded once this iterator is destroyed (internal
+    /// iterations, e.g. for counting, are not recorded)
+    explicit FeatureIteratorBase(const View& view, bool record = false);
     ~FeatureIteratorBase();
 
 protected:
@@ -28,6 +31,12 @@ protected:
 	void fetchNext();
 
 private:
+	struct Recording;
+
+	void advance();
+	void startRecording(const View& view, QueryRecorder* recorder);
+	void finishRecording();
+
 	void initNodeIterator(const View& view);
 	void initParentWaysIterator(const View& view);
 	void destroyParentWaysIterator();
@@ -70,6 +79,7 @@ private:
 	    ~Storage() {}
 	}
 	storage_;
+	Recording* recording_ = nullptr;
 };
 
 
@@ -0,0 +1,255 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <geodesk/feature/FeaturesBase.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A chain of stages (created by map() and where()) that is applied to
+/// each feature of a collection, much like `std::views::transform` and
+/// `std::views::filter`. Nothing happens until the pipeline ends in a
+/// terminal stage (collect() or fold()), which runs the whole chain on
+/// the worker threads that scan the tiles -- each worker pushes the
+/// features of a tile through all stages and gathers the values that
+/// come out into a partial result, and the partial results are
+/// combined once the query is done.
+///
+/// The functions of all stages must therefore be thread-safe, and
+/// values come out in no particular order. For collections that aren't
+/// backed by a spatial query (e.g. the members of a relation), the
+/// pipeline runs on the calling thread.
+///
+/// `Push` is a function `void(T feature, Sink& sink)` that calls
+/// `sink(value)` for each value of type V that the stages produce for
+/// the given feature.
+///
+template<typename T, typename V, typename Push>
+class FeaturePipeline
+{
+public:
+    using value_type = V;
+
+    FeaturePipeline(const FeaturesBase<T>& features, Push push) :
+        features_(features),
+        push_(std::move(push))
+    {
+    }
+
+    template<typename Fn>
+    auto map(Fn fn) const
+    {
+        using R = std::decay_t<std::invoke_result_t<const Fn&, V>>;
+        auto push = [prev = push_, fn = std::move(fn)](T feature, auto& sink)
+        {
+            auto next = [&sink, &fn](auto&& value)
+            {
+                sink(fn(std::forward<decltype(value)>(value)));
+            };
+            prev(feature, next);
+        };
+        return FeaturePipeline<T, R, decltype(push)>(features_, std::move(push));
+    }
+
+    template<typename Pred>
+    auto where(Pred pred) const
+    {
+        auto push = [prev = push_, pred = std::move(pred)](T feature, auto& sink)
+        {
+            auto next = [&sink, &pred](auto&& value)
+            {
+                if (pred(std::as_const(value))) sink(std::forward<decltype(value)>(value));
+            };
+            prev(feature, next);
+        };
+        return FeaturePipeline<T, V, decltype(push)>(features_, std::move(push));
+    }
+
+    /// Runs the pipeline and returns all values that come out of it
+    std::vector<V> collect() const
+    {
+        Collector collector(push_);
+        features_.reduceWith(collector);
+        return std::move(collector.values_);
+    }
+
+    /// Runs the pipeline and combines all values that come out of it
+    /// into a single result; `init` must be the identity of `combine`,
+    /// which must be associative and commutative.
+    template<typename R, typename Combine>
+    R fold(R init, Combine combine) const
+    {
+        Folder<R, Combine> folder(push_, init, combine);
+        features_.reduceWith(folder);
+        return folder.total_;
+    }
+
+private:
+    /// Gathers the values of each batch, then appends them to the
+    /// result under a lock
+    class Collector : public TileReducer
+    {
+    public:
+        explicit Collector(const Push& push) : push_(push) {}
+
+        void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+        {
+            std::vector<V> partial;
+            auto sink = [&partial](auto&& value)
+            {
+                partial.push_back(std::forward<decltype(value)>(value));
+            };
+            for (size_t i = 0; i < count; i++)
+            {
+                push_(T(store, features[i]), sink);
+            }
+            if (partial.empty()) return;
+            std::lock_guard lock(mutex_);
+            // (not insert(), since features can't be assigned)
+            for (V& value : partial) values_.push_back(std::move(value));
+        }
+
+        const Push& push_;
+        std::mutex mutex_;
+        std::vector<V> values_;
+    };
+
+    /// Folds the values of each batch into a partial result, which is
+    /// then combined with the total under a lock
+    template<typename R, typename Combine>
+    class Folder : public TileReducer
+    {
+    public:
+        Folder(const Push& push, R init, Combine combine) :
+            push_(push), init_(init), combine_(combine), total_(init) {}
+
+        void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+        {
+            R partial = init_;
+            auto sink = [this, &partial](auto&& value)
+            {
+                partial = combine_(partial, std::forward<decltype(value)>(value));
+            };
+            for (size_t i = 0; i < count; i++)
+            {
+                push_(T(store, features[i]), sink);
+            }
+            std::lock_guard lock(mutex_);
+            total_ = combine_(total_, partial);
+        }
+
+        const Push& push_;
+        const R init_;
+        Combine combine_;
+        std::mutex mutex_;
+        R total_;
+    };
+
+    FeaturesBase<T> features_;
+    Push push_;
+};
+
+template<typename T>
+auto pipeline(const FeaturesBase<T>& features)
+{
+    auto push = [](T feature, auto& sink) { sink(feature); };
+    return FeaturePipeline<T, T, decltype(push)>(features, push);
+}
+
+template<typename Fn>
+struct MapStage { Fn fn; };
+
+template<typename Pred>
+struct WhereStage { Pred pred; };
+
+struct CollectStage {};
+
+template<typename R, typename Combine>
+struct FoldStage { R init; Combine combine; };
+
+// \endcond
+
+/// @brief A pipeline stage that turns each value (initially, each
+/// feature) into the result of `fn(value)`.
+///
+/// ```
+/// std::vector<double> lengths = world("w[highway]")
+///     | geodesk::map([](Feature f) { return f.length(); })
+///     | geodesk::where([](double len) { return len > 1000; })
+///     | geodesk::collect();
+/// ```
+///
+/// Unlike the views of `std::ranges`, the stages of a feature pipeline
+/// run on the threads that execute the query, so `fn` must be
+/// thread-safe (see FeaturePipeline).
+///
+template<typename Fn>
+MapStage<Fn> map(Fn fn) { return { std::move(fn) }; }
+
+/// @brief A pipeline stage that drops the values (or features)
+/// for which `pred(value)` returns `false` (see map()).
+///
+template<typename Pred>
+WhereStage<Pred> where(Pred pred) { return { std::move(pred) }; }
+
+/// @brief Ends a pipeline, returning the values that come out of
+/// its stages as a `std::vector`, in no particular order (see map()).
+///
+inline CollectStage collect() { return {}; }
+
+/// @brief Ends a pipeline, combining the values that come out of its
+/// stages into a single result. Each worker thread combines the values
+/// of the tiles it scans, and their partial results are combined at the
+/// end -- hence, `combine` must be thread-safe, associative and
+/// commutative, and `init` must be its identity (e.g. `0` for addition).
+///
+template<typename R, typename Combine>
+FoldStage<R, Combine> fold(R init, Combine combine)
+{
+    return { std::move(init), std::move(combine) };
+}
+
+/// \cond lowlevel
+
+template<typename T, typename V, typename Push, typename Fn>
+auto operator|(const FeaturePipeline<T, V, Push>& pipeline, MapStage<Fn> stage)
+{
+    return pipeline.map(std::move(stage.fn));
+}
+
+template<typename T, typename V, typename Push, typename Pred>
+auto operator|(const FeaturePipeline<T, V, Push>& pipeline, WhereStage<Pred> stage)
+{
+    return pipeline.where(std::move(stage.pred));
+}
+
+template<typename T, typename V, typename Push>
+std::vector<V> operator|(const FeaturePipeline<T, V, Push>& pipeline, CollectStage)
+{
+    return pipeline.collect();
+}
+
+template<typename T, typename V, typename Push, typename R, typename Combine>
+R operator|(const FeaturePipeline<T, V, Push>& pipeline, FoldStage<R, Combine> stage)
+{
+    return pipeline.fold(std::move(stage.init), std::move(stage.combine));
+}
+
+template<typename T, typename Stage>
+    requires requires(Stage stage) { pipeline(std::declval<FeaturesBase<T>>()) | stage; }
+auto operator|(const FeaturesBase<T>& features, Stage stage)
+{
+    return pipeline(features) | std::move(stage);
+}
+
+// \endcond
+
+} // namespace geodesk
@@ -28,6 +28,7 @@ public:
 	FeaturePtr() {}
 	FeaturePtr(const uint8_t* p) : p_(p) {}
 	FeaturePtr(const FeaturePtr& other) : p_(other.p_) {}
+	FeaturePtr& operator=(const FeaturePtr& other) = default;
 
 	operator DataPtr () const noexcept { return p_; }
 
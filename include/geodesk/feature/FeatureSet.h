@@ -0,0 +1,212 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeaturesBase.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class View;
+
+/// \cond lowlevel
+///
+/// A compact set of features of a single FeatureStore, meant for
+/// large query results that are combined with each other.
+///
+/// Each feature is identified by a 64-bit key made up of the tip of
+/// its tile and its offset within that tile (features are 4-byte
+/// aligned, so the key has 24 + 28 significant bits). As in a
+/// Roaring Bitmap, the keys are grouped by their upper 48 bits into
+/// containers, each of which holds the lower 16 bits either as a
+/// sorted array (sparse containers) or as a 65,536-bit bitmap (dense
+/// containers). A set therefore needs at most 2 bytes per feature,
+/// plus about 40 bytes per container.
+///
+/// Union, intersection and difference work container by container.
+/// Iteration returns the features in key order (i.e. tile by tile),
+/// fetching each tile once.
+///
+/// The set holds a reference to its store.
+///
+class GEODESK_API FeatureSet
+{
+public:
+    FeatureSet() : store_(nullptr), size_(0) {}
+    explicit FeatureSet(FeatureStore* store);
+
+    /// Creates a set from the results of a query.
+    ///
+    /// @throws QueryException if `view` isn't a world view
+    explicit FeatureSet(const View& view);
+
+    template<typename T>
+    explicit FeatureSet(const FeaturesBase<T>& features) :
+        FeatureSet(features.view_)
+    {
+    }
+
+    FeatureSet(const FeatureSet& other);
+    FeatureSet(FeatureSet&& other) noexcept;
+    ~FeatureSet();
+
+    FeatureSet& operator=(const FeatureSet& other);
+    FeatureSet& operator=(FeatureSet&& other) noexcept;
+
+    static uint64_t keyOf(Tip tip, uint32_t offset)
+    {
+        assert((offset & 3) == 0);
+        return (static_cast<uint64_t>(tip) << 28) | (offset >> 2);
+    }
+
+    static Tip tipOf(uint64_t key) { return Tip(static_cast<uint32_t>(key >> 28)); }
+    static uint32_t offsetOf(uint64_t key)
+    {
+        return static_cast<uint32_t>(key & 0x0fff'ffff) << 2;
+    }
+
+    FeatureStore* store() const { return store_; }
+    uint64_t size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+    /// The number of bytes used by the set's containers
+    size_t memoryUsage() const;
+
+    /// Adds the feature at `offset` within tile `tip`; returns `false`
+    /// if it was already present
+    bool add(Tip tip, uint32_t offset) { return addKey(keyOf(tip, offset)); }
+    bool addKey(uint64_t key);
+    bool contains(Tip tip, uint32_t offset) const { return containsKey(keyOf(tip, offset)); }
+    bool containsKey(uint64_t key) const;
+
+    /// Calls `fn` with each key, in ascending order
+    template<typename Fn>
+    void forEachKey(Fn fn) const
+    {
+        for (const Container& c : containers_)
+        {
+            uint64_t high = c.high << 16;
+            if (c.isBitmap())
+            {
+                for (uint32_t i = 0; i < BITMAP_WORDS; i++)
+                {
+                    uint64_t word = c.bits[i];
+                    while (word)
+                    {
+                        int bit = std::countr_zero(word);
+                        fn(high | (i * 64 + bit));
+                        word &= word - 1;
+                    }
+                }
+            }
+            else
+            {
+                for (uint16_t low : c.values) fn(high | low);
+            }
+        }
+    }
+
+    FeatureSet& operator|=(const FeatureSet& other);
+    FeatureSet& operator&=(const FeatureSet& other);
+    FeatureSet& operator-=(const FeatureSet& other);
+
+    [[nodiscard]] FeatureSet operator|(const FeatureSet& other) const
+    {
+        FeatureSet result(*this);
+        result |= other;
+        return result;
+    }
+
+    [[nodiscard]] FeatureSet operator&(const FeatureSet& other) const
+    {
+        FeatureSet result(*this);
+        result &= other;
+        return result;
+    }
+
+    [[nodiscard]] FeatureSet operator-(const FeatureSet& other) const
+    {
+        FeatureSet result(*this);
+        result -= other;
+        return result;
+    }
+
+    bool operator==(const FeatureSet& other) const;
+
+    class GEODESK_API Iterator
+    {
+    public:
+        Iterator(const FeatureSet* set, bool atEnd);
+
+        FeaturePtr operator*() const { return FeaturePtr(pTile_ + offsetOf(key_)); }
+        uint64_t key() const { return key_; }
+        Iterator& operator++();
+        bool operator==(const Iterator& other) const
+        {
+            return container_ == other.container_ && pos_ == other.pos_;
+        }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+    private:
+        void fetch();
+
+        const FeatureSet* set_;
+        size_t container_;
+        uint32_t pos_;          // index into values, or bit number
+        uint64_t key_;
+        Tip tip_;
+        DataPtr pTile_;
+    };
+
+    Iterator begin() const { return Iterator(this, false); }
+    Iterator end() const { return Iterator(this, true); }
+
+private:
+    static constexpr uint32_t BITMAP_WORDS = 1024;
+    /// A sparse container never holds more than this many values
+    /// (at which point an array is as large as a bitmap)
+    static constexpr uint32_t MAX_ARRAY_SIZE = 4096;
+
+    struct Container
+    {
+        uint64_t high;
+        uint32_t count;
+        std::vector<uint16_t> values;
+        std::unique_ptr<uint64_t[]> bits;
+
+        explicit Container(uint64_t h) : high(h), count(0) {}
+        Container(const Container& other);
+        Container(Container&&) noexcept = default;
+        Container& operator=(Container&&) noexcept = default;
+
+        bool isBitmap() const { return bits != nullptr; }
+        bool contains(uint16_t low) const;
+        bool add(uint16_t low);
+        void toBitmap();
+        void normalize();
+        size_t memoryUsage() const;
+    };
+
+    static void unite(Container& a, const Container& b);
+    static void intersect(Container& a, const Container& b);
+    static void subtract(Container& a, const Container& b);
+    void checkStore(const FeatureSet& other);
+    void build(std::vector<uint64_t>& keys);
+    void removeEmpty();
+
+    FeatureStore* store_;
+    uint64_t size_;
+    std::vector<Container> containers_;     // sorted by high
+};
+
+// \endcond
+
+} // namespace geodesk
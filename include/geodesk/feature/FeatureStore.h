@@ -3,23 +3,53 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #ifdef GEODESK_PYTHON
 #include <Python.h>
 #endif
 #include <clarisma/store/BlobStore.h>
-#include <clarisma/thread/ThreadPool.h>
+#include <clarisma/thread/Lazy.h>
+#include <clarisma/thread/ProgressReporter.h>
+#include <clarisma/thread/WorkStealingPool.h>
+#include <clarisma/util/Metrics.h>
 #include <geodesk/export.h>
 #include <geodesk/feature/Key.h>
 #include <geodesk/feature/StringTable.h>
 #include <geodesk/match/Matcher.h>
 #include <geodesk/match/MatcherCompiler.h>
+#include <geodesk/query/QueryPriority.h>
 #include <geodesk/query/TileQueryTask.h>
 
 class PyFeatures;       // not namespaced for now
 
 namespace geodesk {
 
+class Filter;
+class GeneralizedGeometry;
+class IdIndex;
+class LabelPointCache;
+class MeasureCache;
+class NameIndex;
+class NumericIndex;
+class PreparedFilterCache;
+class QueryCache;
+class QueryRecorder;
+class RelationTreeCache;
+class RingCache;
+class RingStore;
+class StoreVerifier;
+class StringIndex;
+class TagSummary;
+class TileCompression;
+class TileStatistics;
+class TileReader;
+class TileScanCache;
+class WayNodeIndex;
 class MatcherHolder;
 
 //  Possible threadpool alternatives:
@@ -27,6 +57,8 @@ class MatcherHolder;
 
 using clarisma::DataPtr;
 
+using QueryExecutor = clarisma::WorkStealingPool<TileQueryTask>;
+
 /// @brief A Geographic Object Library.
 ///
 /// This class if part of the **Low-Level API**. It is not intended to
@@ -35,13 +67,82 @@ using clarisma::DataPtr;
 class GEODESK_API FeatureStore final : public clarisma::BlobStore
 {
 public:
-    using IndexedKeyMap = std::unordered_map<uint16_t, uint16_t>;
+    /// Settings of the executor that runs the tile scans of queries
+    ///
+    struct ExecutorSettings
+    {
+        int threadCount = 0;        // 0 = one per hardware thread
+        int queueSize = 0;          // 0 = 4 tasks per thread
+        bool pinThreads = false;    // bind each worker to a CPU
+        bool numa = false;          // one worker group per NUMA node,
+                                    // tiles routed to a node by TIP
+    };
+
+    /// Hints that tell the OS how the file of a store will be read.
+    /// They only affect performance (e.g. RANDOM avoids needless
+    /// readahead for small queries on a cold store).
+    ///
+    struct AccessHints
+    {
+        clarisma::MappedFile::AccessPattern pattern =
+            clarisma::MappedFile::AccessPattern::NORMAL;
+        bool populateIndexes = false;   // read the tile index and string
+                                        // table into memory up front
+        bool hugePages = false;         // ask for transparent huge pages
+    };
+
+    /// How long it took to open a store, in nanoseconds
+    ///
+    struct OpenTimes
+    {
+        uint64_t resolveNanos = 0;      // finding the file
+        uint64_t mapNanos = 0;          // opening and mapping it
+        uint64_t stringsNanos = 0;      // setting up the string table
+        uint64_t schemaNanos = 0;       // reading the index schema
+        uint64_t hintsNanos = 0;        // applying the access hints
+        uint64_t totalNanos = 0;
+    };
 
     FeatureStore();
     ~FeatureStore() override;
 
     static FeatureStore* openSingle(std::string_view fileName);
 
+    /// Options for hotSwap()
+    ///
+    struct HotSwapOptions
+    {
+        /// Read the tiles that the replaced store has in memory (as
+        /// far as the new store has tiles at the same locations)
+        bool warmHotTiles = true;
+    };
+
+    /// Replaces the store that openSingle() returns for `fileName` with
+    /// the GOL in `newFileName` (which may be the same file, if it has
+    /// been replaced since the store was opened). `fileName` is only
+    /// a logical name; it need not refer to an existing file, and keeps
+    /// referring to `newFileName` for the rest of the process (or until
+    /// the next swap).
+    ///
+    /// The new store is opened, and its tile index and string table
+    /// (and optionally the tiles that are hot in the replaced store) are
+    /// read into memory before it becomes visible, so queries against
+    /// it don't stall. Collections that refer to the replaced store keep
+    /// using it until they are gone; the store is closed once its last
+    /// reference is released.
+    ///
+    /// @return the new store (with a reference owned by the caller,
+    ///   as for openSingle())
+    ///
+    static FeatureStore* hotSwap(std::string_view fileName,
+        std::string_view newFileName, const HotSwapOptions& options);
+
+    static FeatureStore* hotSwap(std::string_view fileName,
+        std::string_view newFileName)
+    {
+        return hotSwap(fileName, newFileName, HotSwapOptions());
+    }
+
     void open(const char* fileName)
     {
         BlobStore::open(fileName, 0);   // TODO: open mode
@@ -55,8 +156,9 @@ public:
 
     void release()
     {
-        if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        if (refcount_.fetch_sub(1, std::memory_order_release) == 1)
         {
+            std::atomic_thread_fence(std::memory_order_acquire);
             delete this;
         }
     }
@@ -73,9 +175,31 @@ public:
 
     uint32_t zoomLevels() const { return zoomLevels_; }
     StringTable& strings() { return strings_; }
-    const IndexedKeyMap& keysToCategories() const { return keysToCategories_; }
-    int getIndexCategory(int keyCode) const;
+    /// The index category of the given global key (0 if the key
+    /// isn't indexed), looked up in a flat table built at open
+    int getIndexCategory(int keyCode) const
+    {
+        return static_cast<uint32_t>(keyCode) < keyCategories_.size() ?
+            keyCategories_[keyCode] : 0;
+    }
+    /// The index bits of the given global key (see IndexBits), for
+    /// code that combines the categories of many keys
+    uint32_t keyIndexBits(int keyCode) const
+    {
+        return IndexBits::fromCategory(getIndexCategory(keyCode));
+    }
     const MatcherHolder* getMatcher(const char* query);
+    /// Combines two matchers (see MatcherCompiler::combine())
+    const MatcherHolder* combineMatchers(const MatcherHolder* a, const MatcherHolder* b)
+    {
+        return matchers_.combine(a, b);
+    }
+    MatcherCompiler::CacheStats matcherCacheStats() { return matchers_.cacheStats(); }
+    /// The GOQL query of the given matcher (see MatcherCompiler::queryOf())
+    std::string matcherQuery(const MatcherHolder* matcher)
+    {
+        return matchers_.queryOf(matcher);
+    }
 
     const MatcherHolder* borrowAllMatcher() const { return &allMatcher_; }
     const MatcherHolder* getAllMatcher() 
@@ -100,10 +224,437 @@ public:
     PyFeatures* getEmptyFeatures();
     #endif
 
-    clarisma::ThreadPool<TileQueryTask>& executor() { return executor_; }
+    /// Returns the executor of this store. Its threads are started
+    /// (or the shared executor is obtained) the first time this is
+    /// called, so a store that only runs queries on the calling
+    /// thread never starts any.
+    ///
+    QueryExecutor& executor()
+    {
+        QueryExecutor* executor = runningExecutor_.load(std::memory_order_acquire);
+        if (!executor) [[unlikely]] executor = startExecutor();
+        return *executor;
+    }
 
+    /// Counters updated by the queries of this store (safe to update
+    /// from any thread)
+    ///
+    struct Counters
+    {
+        clarisma::Counter queriesStarted;
+        clarisma::Counter queriesFinished;
+        clarisma::Counter tilesScanned;
+        clarisma::Counter tileBytes;        // size of the scanned tiles
+    };
+
+    Counters& counters() { return counters_; }
+
+    /// The bytes held by the queries of this store (their result
+    /// buckets and deduplication sets). Queries update it as they
+    /// allocate, from any thread.
+    ///
+    std::atomic<size_t>& queryMemory() { return queryMemory_; }
+
+    /// The memory the queries of this store may use in total (0 = no
+    /// limit). Once they exceed it, each query stops requesting more
+    /// tiles than the one it needs to make progress, and a query whose
+    /// deduplication set has to grow fails with a QueryException
+    /// (see also QueryOptions::memoryLimit).
+    ///
+    size_t queryMemoryLimit() const
+    {
+        return queryMemoryLimit_.load(std::memory_order_relaxed);
+    }
+
+    void setQueryMemoryLimit(size_t maxBytes)
+    {
+        queryMemoryLimit_.store(maxBytes, std::memory_order_relaxed);
+    }
+
+    /// The approximate memory used by this store's queries and caches,
+    /// in bytes
+    ///
+    struct MemoryUsage
+    {
+        size_t queries = 0;
+        size_t queryCache = 0;
+        size_t ringCache = 0;
+        size_t measureCache = 0;
+        size_t labelPointCache = 0;
+        size_t relationTreeCache = 0;
+        size_t preparedFilterCache = 0;
+        size_t wayNodeIndex = 0;
+        size_t tileReader = 0;
+        size_t tileScanCache = 0;
+
+        size_t total() const
+        {
+            return queries + queryCache + ringCache + measureCache +
+                labelPointCache + relationTreeCache + preparedFilterCache + wayNodeIndex + tileReader +
+                tileScanCache;
+        }
+    };
+
+    MemoryUsage memoryUsage();
+
+    /// The runtime metrics of this store: its Counters, the hits and
+    /// misses of its matcher cache, and the queue depth and worker
+    /// busy/idle times of its executor (which is usually shared with
+    /// other stores), the OpenTimes (as `geodesk_open_*_seconds`
+    /// gauges), and the MemoryUsage of its queries and caches.
+    /// Take a snapshot() to read them.
+    ///
+    const clarisma::MetricsRegistry& metrics() const { return metrics_; }
+
+    /// The time spent in each phase of opening this store
+    /// (only measured if it was opened via openSingle())
+    ///
+    const OpenTimes& openTimes() const { return openTimes_; }
+
+    /// Makes this store run its queries on the given executor instead
+    /// of the shared one. Must not be called while queries are active.
+    ///
+    void setExecutor(std::shared_ptr<QueryExecutor> executor);
+
+    /// Records every query of this store (as it is consumed) to the
+    /// given recorder; pass nullptr to stop recording. Must not be
+    /// called while queries are active.
+    ///
+    void setRecorder(std::shared_ptr<QueryRecorder> recorder)
+    {
+        recorder_ = std::move(recorder);
+    }
+
+    QueryRecorder* recorder() const { return recorder_.get(); }
+
+    /// Returns the executor shared by all stores in this process,
+    /// starting it on first use.
+    ///
+    static std::shared_ptr<QueryExecutor> sharedExecutor();
+
+    /// Changes the settings of the shared executor. If the executor
+    /// is already running, stores that start using it from now on
+    /// get a new one with these settings (stores that have already
+    /// obtained the shared executor keep theirs).
+    ///
+    static void configureSharedExecutor(const ExecutorSettings& settings);
+
+    /// Returns a pointer to the given tile. If the tile is compressed
+    /// (see TileCompression), it is decompressed on first access, and
+    /// then stays in memory as long as the store is open (since its
+    /// features may be referenced from anywhere).
+    ///
     DataPtr fetchTile(Tip tip);
 
+    /// Hints to the OS that the given tile will be read soon, so it can
+    /// start loading its pages in the background. Only advisory:
+    /// any errors are ignored
+    ///
+    void prefetchTile(Tip tip) noexcept;
+
+    /// Hints to the OS how the given tile will be read (e.g. SEQUENTIAL
+    /// for a tile that is scanned in its entirety). Only advisory.
+    ///
+    void adviseTile(Tip tip, clarisma::MappedFile::AccessPattern pattern) noexcept;
+
+    /// Returns the size (in bytes) of the given tile as it is stored
+    /// in the file (for a compressed tile, its compressed size),
+    /// without fetching the tile
+    ///
+    uint32_t tileBlobSize(Tip tip)
+    {
+        return mappedTile(tip).getUnsignedInt() & 0x3fff'ffff;
+    }
+
+    /// The creation timestamp and the true size of the GOL, which
+    /// together identify its contents (used to check that state saved
+    /// by an earlier session, such as a QueryCheckpoint, still applies)
+    uint64_t creationTimestamp() const { return getLocalCreationTimestamp(); }
+    uint64_t trueSize() const { return getTrueSize(); }
+
+    /// Applies the given access hints to the entire file of this store.
+    /// Only advisory: any errors are ignored.
+    ///
+    void setAccessHints(const AccessHints& hints) noexcept;
+
+    /// Sets the access hints that are applied to stores opened from
+    /// now on (stores that are already open keep theirs).
+    ///
+    static void configureAccessHints(const AccessHints& hints);
+
+    /// Reads the tiles that intersect `box` (and are accepted by
+    /// `filter`, if any) into memory, so queries in this region don't
+    /// have to wait for I/O. With INTERACTIVE priority, the tiles are
+    /// read by as many threads as the executor has; with BATCH, only
+    /// by the calling thread. Reports the number of tiles read to
+    /// `progress` (calling start(), but not end()).
+    ///
+    /// @return the number of tiles
+    ///
+    uint64_t warm(const Box& box, const Filter* filter = nullptr,
+        QueryPriority priority = QueryPriority::BATCH,
+        clarisma::ProgressReporter* progress = nullptr);
+
+    /// Tells the OS that the tiles that intersect `box` (and are
+    /// accepted by `filter`, if any) won't be needed soon, so their
+    /// memory is reclaimed first. Only advisory.
+    ///
+    /// @return the number of tiles
+    ///
+    uint64_t evict(const Box& box, const Filter* filter = nullptr);
+
+    /// How much of each region of the store is in physical memory
+    ///
+    struct ResidencyReport
+    {
+        static constexpr int MAX_ZOOM = 12;
+
+        clarisma::MappedFile::Residency tileIndex;
+        clarisma::MappedFile::Residency strings;
+        clarisma::MappedFile::Residency tiles;
+        clarisma::MappedFile::Residency tilesByZoom[MAX_ZOOM + 1];
+        uint64_t tileCount = 0;
+        uint64_t tileCountByZoom[MAX_ZOOM + 1] = {};
+    };
+
+    /// Checks which pages of the tile index, the string table and the
+    /// tiles that intersect `box` (and are accepted by `filter`, if any)
+    /// are in memory, without reading any pages that aren't. Meant for
+    /// diagnostics (it makes a system call per tile).
+    ///
+    ResidencyReport residency(const Box& box = Box::ofWorld(), const Filter* filter = nullptr);
+
+    /// The outcome of verify()
+    ///
+    struct VerifyResult
+    {
+        uint64_t tilesVerified = 0;
+        std::vector<std::string> errors;    // one message per defect
+
+        bool isValid() const { return errors.empty(); }
+    };
+
+    /// Checks the structure of the string table and of the tiles that
+    /// intersect `box` (the entire store by default): every tile must
+    /// lie within the file, and the pointers of its spatial indexes,
+    /// index entries and tag tables must stay inside the tile.
+    /// Compressed tiles are decompressed (if built with zlib) and then
+    /// checked like any other tile. Tiles are checked by `threads`
+    /// threads (0 = one per hardware thread); the number of tiles
+    /// checked is reported to `progress` (calling start(), but not end()).
+    ///
+    /// This only finds damage that breaks the structure of a tile
+    /// (a GOL has no per-tile checksums).
+    ///
+    VerifyResult verify(int threads = 0, const Box& box = Box::ofWorld(),
+        clarisma::ProgressReporter* progress = nullptr);
+
+    /// Returns the index of feature IDs, opening (or building)
+    /// it on first use. Safe to call from any thread.
+    ///
+    const IdIndex& idIndex();
+
+    /// Returns the per-tile tag summary, or nullptr if the store has
+    /// none (or it is out of date). Safe to call from any thread.
+    ///
+    const TagSummary* tagSummary();
+
+    /// Creates (or replaces) the tag summary of this store. Queries use
+    /// it once the store is opened the next time, unless no query has
+    /// called tagSummary() yet.
+    ///
+    void buildTagSummary();
+
+    /// Returns the per-tile feature statistics, or nullptr if the store
+    /// has none (or they are out of date). Safe to call from any thread.
+    ///
+    const TileStatistics* tileStatistics();
+
+    /// Creates (or replaces) the tile statistics of this store, counting
+    /// the features of its tiles on the given number of threads (0 = as
+    /// many as the query executor). As with the tag summary, queries
+    /// only see statistics that existed when they were first requested.
+    ///
+    void buildTileStatistics(int threads = 0);
+
+    /// Returns the precomputed rings of the area relations, or nullptr
+    /// if the store has none (or they are out of date). Safe to call
+    /// from any thread.
+    ///
+    const RingStore* ringStore();
+
+    /// Creates (or replaces) the precomputed rings of this store,
+    /// polygonizing its area relations on the given number of threads
+    /// (0 = as many as the query executor). As with the tile statistics,
+    /// only rings that existed when they were first requested are used.
+    ///
+    void buildRingStore(int threads = 0);
+
+    /// Returns the pre-simplified geometries of the ways and area
+    /// relations, or nullptr if the store has none (or they are out of
+    /// date). Safe to call from any thread.
+    ///
+    const GeneralizedGeometry* generalizedGeometry();
+
+    /// Creates (or replaces) the generalized geometries of this store,
+    /// simplifying its ways and area relations on the given number of
+    /// threads (0 = as many as the query executor). As with the rings,
+    /// only geometries that existed when they were first requested are
+    /// used.
+    ///
+    void buildGeneralizedGeometry(int threads = 0);
+
+    /// Returns the trigram index of feature names, or nullptr if the
+    /// store has none (or it is out of date). Safe to call from any
+    /// thread.
+    ///
+    const NameIndex* nameIndex();
+
+    /// Creates (or replaces) the name index of this store, scanning its
+    /// tiles on the given number of threads (0 = as many as the query
+    /// executor). As with the tile statistics, searches only use an
+    /// index that existed when it was first requested.
+    ///
+    void buildNameIndex(int threads = 0);
+
+    /// Returns the index of numeric tag values, or nullptr if the store
+    /// has none (or it is out of date). Safe to call from any thread.
+    ///
+    const NumericIndex* numericIndex();
+
+    /// Creates (or replaces) the numeric index of this store for the
+    /// given keys, scanning its tiles on the given number of threads
+    /// (0 = as many as the query executor). As with the tile statistics,
+    /// queries only use an index that existed when it was first
+    /// requested.
+    ///
+    void buildNumericIndex(const std::vector<std::string>& keys, int threads = 0);
+
+    /// Creates (or replaces) the string index of this store, which
+    /// lets it look up global strings without building a hash table
+    /// when it is opened the next time.
+    ///
+    /// @return false if the index could not be built
+    ///   (which is practically impossible)
+    ///
+    bool buildStringIndex();
+
+    /// Enables caching of per-tile query results, using up to (about)
+    /// `maxBytes` of memory, or disables the cache if `maxBytes` is 0.
+    /// Must not be called while queries are active.
+    ///
+    void enableQueryCache(size_t maxBytes);
+
+    /// Enables the reverse index of way nodes (which speeds up finding
+    /// the parent ways of anonymous nodes), using up to (about)
+    /// `maxBytes` of memory, or disables it if `maxBytes` is 0.
+    /// Must not be called while queries are active.
+    ///
+    void enableWayNodeIndex(size_t maxBytes);
+
+    /// Returns the reverse index of way nodes (emptied if the store has
+    /// changed since its tiles were indexed), or nullptr if disabled.
+    ///
+    WayNodeIndex* wayNodeIndex();
+
+    /// Enables caching of the assembled rings of area relations, using
+    /// up to (about) `maxBytes` of memory, or disables the cache if
+    /// `maxBytes` is 0. Must not be called while queries are active.
+    ///
+    void enableRingCache(size_t maxBytes);
+
+    /// Returns the cache of relation rings (emptied if the store has
+    /// changed since the rings were assembled), or nullptr if disabled.
+    ///
+    RingCache* ringCache();
+
+    /// Enables memoization of the lengths and areas of relations
+    /// (used by size filters), using up to (about) `maxBytes` of memory,
+    /// or disables it if `maxBytes` is 0. Must not be called while
+    /// queries are active.
+    ///
+    void enableMeasureCache(size_t maxBytes);
+
+    /// Returns the memo of relation lengths and areas (emptied if the
+    /// store has changed since they were measured), or nullptr if
+    /// disabled.
+    ///
+    MeasureCache* measureCache();
+
+    /// Enables memoization of the label points of areas (see
+    /// LabelPoint::ofFeature()), using up to (about) `maxBytes` of
+    /// memory, or disables it if `maxBytes` is 0. Must not be called
+    /// while queries are active.
+    ///
+    void enableLabelPointCache(size_t maxBytes);
+
+    /// Returns the memo of label points (emptied if the store has
+    /// changed since they were found), or nullptr if disabled.
+    ///
+    LabelPointCache* labelPointCache();
+
+    /// Enables caching of the flattened member trees of relations that
+    /// have at least `minLeaves` nodes and ways (including those of their
+    /// sub-relations), using up to (about) `maxBytes` of memory, or
+    /// disables the cache if `maxBytes` is 0. Lengths, centroids and
+    /// `within()` tests of such relations then walk their members (and
+    /// resolve foreign members) only once. Must not be called while
+    /// queries are active.
+    ///
+    void enableRelationTreeCache(size_t maxBytes, size_t minLeaves = 64);
+
+    /// Returns the cache of relation trees (emptied if the store has
+    /// changed since the trees were walked), or nullptr if disabled.
+    ///
+    RelationTreeCache* relationTreeCache();
+
+    /// Enables sharing of prepared spatial filters (such as those of
+    /// `within()`) that were created for the same feature, using up to
+    /// (about) `maxBytes` of memory, or disables the cache if `maxBytes`
+    /// is 0. Must not be called while queries are active.
+    ///
+    void enablePreparedFilterCache(size_t maxBytes);
+
+    /// Returns the cache of prepared filters (emptied if the store has
+    /// changed since the filters were prepared), or nullptr if disabled.
+    ///
+    PreparedFilterCache* preparedFilterCache();
+
+    /// Makes queries that use a TileReducer read their tiles into a
+    /// cache of up to (about) `maxBytes` of memory, instead of
+    /// accessing them via the memory mapping of the store's file, or
+    /// disables the TileReader if `maxBytes` is 0. Must not be called
+    /// while queries are active.
+    ///
+    void enableTileReader(size_t maxBytes);
+
+    /// Returns the TileReader of this store, or nullptr if disabled.
+    ///
+    TileReader* tileReader() { return tileReader_.get(); }
+
+    /// Enables the transcoding of frequently scanned tiles into a form
+    /// that queries can scan more quickly (see TileScanCache), using up
+    /// to (about) `maxBytes` of memory, or disables it if `maxBytes` is
+    /// 0. A tile is transcoded once it has been scanned `minScans` times.
+    /// Must not be called while queries are active.
+    ///
+    void enableTileScanCache(size_t maxBytes, uint32_t minScans = 4);
+
+    /// Returns the cache of transcoded tiles (emptied if the store has
+    /// changed since they were transcoded), or nullptr if disabled.
+    ///
+    TileScanCache* tileScanCache();
+
+    /// Returns the query result cache (emptied if the store has changed
+    /// since the results were cached), or nullptr if disabled.
+    ///
+    QueryCache* queryCache();
+
+    /// Returns the bounding box of all tiles in this store,
+    /// computing it on first use. Safe to call from any thread.
+    ///
+    const Box& coverage();
+
 protected:
     void initialize() override;
 
@@ -121,20 +672,100 @@ private:
     static const uint32_t INDEX_SCHEMA_PTR_OFS = 56;
 
     void readIndexSchema();
+    /// Reads the tile index and the string table into memory
+    void populateIndexes() noexcept;
+    /// Reads the tiles that are (mostly) in memory in `other`
+    void warmTilesHotIn(FeatureStore* other);
+    QueryExecutor* startExecutor();
+    /// The executor, or nullptr if it has not been started yet
+    QueryExecutor* runningExecutor() const
+    {
+        return runningExecutor_.load(std::memory_order_acquire);
+    }
 
     void readTileSchema();
 
+    /// The file offset of the given tile's blob
+    uint64_t tileOffset(Tip tip);
+
+    /// The tile's blob as it is stored in the file (which may be
+    /// compressed)
+    DataPtr mappedTile(Tip tip);
+    uint64_t tileIndexSize() const;
+    uint64_t stringTableSize() const;
+
+    DataPtr fetchCompressedTile(Tip tip);
+
+    #ifdef GEODESK_WITH_ZLIB
+    /// The dictionary for compressed tiles (read from the sidecar
+    /// file on first use)
+    const TileCompression& tileCompression();
+    #endif
+
+    friend class GolCompactorTask;
+    friend class GolDiff;
+    friend class StoreVerifier;
+    friend class TileReader;
+
+    /// Adds a reference unless the store is already being destroyed
+    /// (its last reference was released, but it has not yet removed
+    /// itself from the open stores)
+    bool tryAddref()
+    {
+        #ifdef GEODESK_MULTITHREADED
+        size_t count = refcount_.load(std::memory_order_relaxed);
+        do
+        {
+            if (count == 0) return false;
+        }
+        while (!refcount_.compare_exchange_weak(count, count + 1,
+            std::memory_order_relaxed));
+        return true;
+        #else
+        if (refcount_ == 0) return false;
+        ++refcount_;
+        return true;
+        #endif
+    }
+
+    /// The absolute path of a GOL (adding the .gol extension if
+    /// missing), which is the key of its store in the open stores
+    static std::string resolvePath(std::string_view relativeFileName);
     static std::unordered_map<std::string, FeatureStore*>& getOpenStores();
+    /// The files that hotSwap() has put in place of other files
+    /// (by name); guarded by the same mutex as the open stores
+    static std::unordered_map<std::string, std::string>& getSwappedFiles();
     static std::mutex& getOpenStoresMutex();
 
+    struct SharedExecutor
+    {
+        std::mutex mutex;
+        ExecutorSettings settings;
+        std::shared_ptr<QueryExecutor> executor;
+    };
+
+    static SharedExecutor& getSharedExecutor();
+
+    struct DefaultAccessHints
+    {
+        std::mutex mutex;
+        AccessHints hints;
+    };
+
+    static DefaultAccessHints& getDefaultAccessHints();
+
 #ifdef GEODESK_MULTITHREADED
     std::atomic_size_t refcount_;
 #else
     std::size_t refcount_;
 #endif
 
+    std::unique_ptr<StringIndex> stringIndex_;
+        // (declared before strings_, which refers to it)
     StringTable strings_;
-    IndexedKeyMap keysToCategories_;
+    std::vector<uint8_t> keyCategories_;
+        // index category of each key code (0 if not indexed), up to
+        // the highest indexed key code
     MatcherCompiler matchers_;
     MatcherHolder allMatcher_;
     #ifdef GEODESK_PYTHON
@@ -146,8 +777,41 @@ private:
         // but PyFeatures requires a non-null MatcherHolder, which in turn
         // requires a FeatureStore
     #endif
-    clarisma::ThreadPool<TileQueryTask> executor_;
+    std::shared_ptr<QueryExecutor> executor_;
+    std::atomic<QueryExecutor*> runningExecutor_{nullptr};
+    std::mutex executorMutex_;
+    std::shared_ptr<QueryRecorder> recorder_;
+    Counters counters_;
+    std::atomic<size_t> queryMemory_{0};
+    std::atomic<size_t> queryMemoryLimit_{0};
+    clarisma::MetricsRegistry metrics_;
     uint32_t zoomLevels_;
+    OpenTimes openTimes_;
+    std::string openName_;
+        // the key of this store in the open stores (usually the
+        // path of its file, unless it was opened via hotSwap())
+    clarisma::Lazy<std::unique_ptr<IdIndex>> idIndex_;
+    clarisma::Lazy<std::unique_ptr<TagSummary>> tagSummary_;
+    clarisma::Lazy<std::unique_ptr<TileStatistics>> tileStatistics_;
+    clarisma::Lazy<std::unique_ptr<RingStore>> ringStore_;
+    clarisma::Lazy<std::unique_ptr<GeneralizedGeometry>> generalizedGeometry_;
+    clarisma::Lazy<std::unique_ptr<NameIndex>> nameIndex_;
+    clarisma::Lazy<std::unique_ptr<NumericIndex>> numericIndex_;
+    clarisma::Lazy<Box> coverage_;
+    std::unique_ptr<WayNodeIndex> wayNodeIndex_;
+    std::unique_ptr<RingCache> ringCache_;
+    std::unique_ptr<MeasureCache> measureCache_;
+    std::unique_ptr<LabelPointCache> labelPointCache_;
+    std::unique_ptr<RelationTreeCache> relationTreeCache_;
+    std::unique_ptr<PreparedFilterCache> preparedFilterCache_;
+    std::unique_ptr<TileReader> tileReader_;
+    std::unique_ptr<TileScanCache> tileScanCache_;
+    clarisma::Lazy<std::unique_ptr<TileCompression>> tileCompression_;
+    /// The compressed tiles that have been decompressed by fetchTile()
+    std::unordered_map<uint32_t, std::unique_ptr<uint8_t[]>> residentTiles_;
+    std::mutex residentTilesMutex_;
+    std::unique_ptr<QueryCache> queryCache_;
+        // (declared last, since cached entries hold references to matchers)
 };
 
 
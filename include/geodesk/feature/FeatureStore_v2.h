@@ -3,16 +3,25 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #ifdef GEODESK_PYTHON
 #include <Python.h>
 #endif
 #include <clarisma/store/BlobStore_v2.h>
+#include <clarisma/thread/EpochManager.h>
 #include <clarisma/thread/ThreadPool.h>
 #include <clarisma/util/DateTime.h>
 #include <clarisma/util/UUID.h>
 #include <geodesk/export.h>
 #include <geodesk/feature/StringTable.h>
+#include <geodesk/feature/TileSource.h>
 #include <geodesk/feature/ZoomLevels.h>
 #include <geodesk/match/Matcher.h>
 #include <geodesk/match/MatcherCompiler.h>
@@ -46,6 +55,7 @@ public:
 
     TileIndexEntry(clarisma::v2::BlobStore::PageNum page, Status status) :
         data_((page << 2) | status) {}
+    explicit TileIndexEntry(uint32_t data) : data_(data) {}
 
     clarisma::v2::BlobStore::PageNum page() const { return data_ >> 2; }
     Status status() const { return static_cast<Status>(data_ & 3); }
@@ -58,8 +68,6 @@ private:
 class GEODESK_API FeatureStore final : public clarisma::v2::BlobStore
 {
 public:
-    using IndexedKeyMap = std::unordered_map<uint16_t, uint16_t>;
-
     struct Header : BlobStore::Header
     {
         uint32_t subtypeMagic;
@@ -87,6 +95,13 @@ public:
     {
         BlobStore::open(fileName, 0);   // TODO: open mode
     }
+
+    /// Opens the store with the given Store::OpenMode (a store that
+    /// loads tiles from a TileSource must be opened with WRITE)
+    void open(const char* fileName, int mode)
+    {
+        BlobStore::open(fileName, mode);
+    }
     
     void addref()  { ++refcount_;  }
     void release() { if (--refcount_ == 0) delete this;  }
@@ -99,8 +114,11 @@ public:
 
     uint32_t zoomLevels() const { return zoomLevels_; }
     StringTable& strings() { return strings_; }
-    const IndexedKeyMap& keysToCategories() const { return keysToCategories_; }
-    int getIndexCategory(int keyCode) const;
+    int getIndexCategory(int keyCode) const
+    {
+        return static_cast<uint32_t>(keyCode) < keyCategories_.size() ?
+            keyCategories_[keyCode] : 0;
+    }
     const Header* header() const
     {
         return reinterpret_cast<Header*>(mainMapping());
@@ -127,8 +145,73 @@ public:
 
     clarisma::ThreadPool<TileQueryTask>& executor() { return executor_; }
 
+    /// Returns a pointer to the given tile. If the tile is missing or
+    /// stale, and the store has a TileSource, the tile is fetched from
+    /// the source and added to the store first (the calling thread
+    /// waits until it has been installed). The caller must hold a
+    /// ReadGuard for as long as it uses the tile.
+    ///
     DataPtr fetchTile(Tip tip);
 
+    /// Returns the entry of the given tile in the tile index. The
+    /// entry is read with acquire semantics, so the tile it points
+    /// to is fully visible to the caller.
+    ///
+    TileIndexEntry tileIndexEntry(Tip tip) const
+    {
+        uint32_t* p = reinterpret_cast<uint32_t*>((tileIndex() + (tip * 4)).ptr());
+        return TileIndexEntry(std::atomic_ref<uint32_t>(*p).load(
+            std::memory_order_acquire));
+    }
+
+    /// Keeps the tiles that a reader (such as a query) can see from
+    /// being reclaimed while tiles are replaced concurrently. Readers
+    /// must hold a ReadGuard while they look up and scan tiles; the
+    /// blobs of tiles that are replaced in the meantime are freed only
+    /// once all readers that could have seen them have released their
+    /// guards. Acquiring and releasing a guard is lock-free.
+    ///
+    class ReadGuard : public clarisma::EpochManager::Guard
+    {
+    public:
+        explicit ReadGuard(FeatureStore* store) :
+            Guard(store->epochs_) {}
+    };
+
+    /// Makes the store fetch missing or stale tiles from `source`,
+    /// with at most `maxConcurrentFetches` requests in flight at any
+    /// time. The store must have been opened for writing. Must not be
+    /// called while queries are active.
+    ///
+    void setTileSource(std::shared_ptr<TileSource> source,
+        int maxConcurrentFetches = 8);
+
+    /// Fetches the given tiles (those that are missing or stale) ahead
+    /// of the queries that will need them, in the given order (which
+    /// should be the order of the tile walk), using as many threads as
+    /// concurrent fetches are allowed. Returns once all tiles have
+    /// been installed.
+    ///
+    /// @return the number of tiles that were fetched
+    ///
+    size_t prefetchTiles(const std::vector<Tip>& tips);
+
+    /// Adds the given tile (which must be missing or stale) to the
+    /// store, and returns once it has been committed. Tiles that other
+    /// threads install at the same time are added in the same
+    /// transaction: whichever thread finds no commit in progress
+    /// commits all tiles submitted up to that point, while the others
+    /// wait for it (and their tiles go into the next group, if they
+    /// arrived too late). This way, threads that fetch or encode tiles
+    /// in parallel share the cost of journaling and syncing, instead
+    /// of taking turns at committing one tile each.
+    ///
+    /// If the transaction fails, every thread whose tile was part of
+    /// it receives the exception. The store must have been opened for
+    /// writing, and `data` must remain valid until this call returns.
+    ///
+    void installTile(Tip tip, clarisma::ByteSpan data);
+
     class Transaction : public BlobStore::Transaction
     {
     public:
@@ -140,7 +223,8 @@ public:
         {
             BlobStore::Transaction::begin(lockLevel);
             const Header* header = store()->header();
-            tileIndexOfs_ = header->tileIndexPtr + offsetof(Header, tileIndexPtr);
+            // (The same offset from which tileIndex() reads the entries)
+            tileIndexOfs_ = header->tileIndexPtr;
         }
 
         FeatureStore* store() const
@@ -148,10 +232,19 @@ public:
             return reinterpret_cast<FeatureStore*>(store_);
         }
 
+        /// Adds the given tile, which must be missing or stale. The
+        /// blob of a stale tile is freed once no reader can see it
+        /// anymore.
+        ///
         void addTile(Tip tip, clarisma::ByteSpan data);
 
+        /// Publishes the new tiles, and frees the blobs of replaced
+        /// tiles that are no longer visible to any reader.
+        void commit();
+
     protected:
         uint32_t tileIndexOfs_;
+        std::vector<PageNum> replacedBlobs_;
     };
 
     class CreateTransaction;
@@ -173,10 +266,31 @@ private:
 
     static std::unordered_map<std::string, FeatureStore*>& getOpenStores();
     static std::mutex& getOpenStoresMutex();
+
+    DataPtr loadTile(Tip tip);
+
+    /// A tile waiting in installTile() to be committed
+    struct PendingTile
+    {
+        Tip tip;
+        clarisma::ByteSpan data;
+        bool committed = false;
+        std::exception_ptr error;
+    };
+
+    void commitPendingTiles(std::unique_lock<std::mutex>& lock);
+    void freeRetiredBlobs() noexcept;
+
+    struct RetiredBlob
+    {
+        PageNum page;
+        clarisma::EpochManager::Epoch epoch;
+    };
     
     size_t refcount_;
     StringTable strings_;
-    IndexedKeyMap keysToCategories_;
+    std::vector<uint8_t> keyCategories_;
+        // index category of each key code (0 if not indexed)
     // MatcherCompiler matchers_;       // TODO: RE-enable
     // MatcherHolder allMatcher_;
     #ifdef GEODESK_PYTHON
@@ -191,6 +305,30 @@ private:
     clarisma::ThreadPool<TileQueryTask> executor_;
     uint32_t zoomLevels_;
 
+    std::shared_ptr<TileSource> tileSource_;
+    int maxConcurrentFetches_ = 0;
+    /// Guards the state of tile loading below
+    std::mutex loadMutex_;
+    /// Signalled whenever a fetch completes
+    std::condition_variable fetchDone_;
+    /// The tiles being fetched right now
+    std::unordered_set<uint32_t> tilesInFlight_;
+    /// Guards the tiles waiting to be committed
+    std::mutex commitMutex_;
+    /// Signalled whenever a group of tiles has been committed
+    std::condition_variable tilesCommitted_;
+    /// The tiles submitted since the current commit (if any) started
+    std::vector<PendingTile*> pendingTiles_;
+    /// Whether a thread is committing a group of tiles (at most
+    /// one transaction is open at any time)
+    bool committing_ = false;
+
+    clarisma::EpochManager epochs_;
+    /// Blobs of replaced tiles that readers may still be scanning
+    /// (only accessed by a Transaction, of which at most one is
+    /// open at any time); any left are freed when the store is closed
+    std::vector<RetiredBlob> retiredBlobs_;
+
     friend class Transaction;
 };
 
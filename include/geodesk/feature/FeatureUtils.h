@@ -3,13 +3,35 @@
 
 #pragma once
 #include <cstdint>
+#include <functional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/forward.h>
+#include <geodesk/feature/TypedFeatureId.h>
+#include <geodesk/query/CountEstimate.h>
+#include <geodesk/query/QueryStats.h>
+
+namespace clarisma {
+class StringBuilder;
+}
 
 namespace geodesk {
 
+class FeatureStore;
+class FlatCoordinates;
+class MergedLines;
+enum class CoordinateFormat;
+class Filter;
+class QueryRecorder;
+class TagColumns;
+struct TagGroup;
 class Tags;
 class View;
+class WayGraph;
 
 /// \cond internal
 ///
@@ -17,13 +39,35 @@ class GEODESK_API FeatureUtils
 {
 public:
     static uint64_t count(const View& view);
+    static CountEstimate estimateCount(const View& view, double sampleFraction);
     static bool isEmpty(const View& view);
+    static bool contains(const View& view, FeatureStore* store, FeaturePtr feature);
     static char* format(char* buf, const char* type, int64_t id);
     static std::string label(const Tags& tags);
+    static std::string explain(const View& view);
+    static QueryStats profile(const View& view);
+    static TagColumns select(const View& view, std::span<const std::string_view> keys);
+    static std::vector<TagGroup> groupBy(const View& view, std::string_view key,
+        const std::function<double(const Feature&)>* measure);
+    static WayGraph graph(const View& view);
+    static MergedLines mergeLines(const View& view, std::string_view key, bool directed);
+    static FlatCoordinates coordinates(const View& view,
+        CoordinateFormat format, double tolerance);
+    static FeaturePtr byId(const View& view, TypedFeatureId id);
+    static void byIds(const View& view, std::span<const TypedFeatureId> ids,
+        std::vector<FeaturePtr>& results);
+    static void searchNames(const View& view, std::string_view text,
+        std::vector<FeaturePtr>& results);
+    static void searchRange(const View& view, std::string_view key,
+        double min, double max, std::vector<FeaturePtr>& results);
 
 private:
+    static uint64_t countView(const View& view);
+    static uint64_t countRecorded(const View& view, QueryRecorder* recorder);
     static uint64_t countWorld(const View& view);
     static uint64_t countGeneric(const View& view);
+    static bool isInWorld(const View& view, FeaturePtr feature);
+    static void explainFilter(clarisma::StringBuilder& s, const Filter* filter, int indent);
 };
 
 // \endcond
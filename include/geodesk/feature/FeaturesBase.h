@@ -3,11 +3,26 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <optional>
 #include <geodesk/filter/Filters.h>
 #include <geodesk/feature/FeatureUtils.h>
+#include <geodesk/feature/FlatCoordinates.h>
+#include <geodesk/feature/GroupBy.h>
+#include <geodesk/feature/MergedLines.h>
+#include <geodesk/feature/TagColumns.h>
 #include <geodesk/feature/QueryException.h>
 #include <geodesk/feature/View.h>
+#include <geodesk/feature/WayGraph.h>
 #include <geodesk/filter/PredicateFilter.h>
+#include <geodesk/geom/BinGrid.h>
+#include <geodesk/match/Goql.h>
+#include <geodesk/query/MapMatcher.h>
+#include <geodesk/query/PointClusters.h>
+#include <geodesk/query/SpatialJoin.h>
+#include <geodesk/query/SpilledFeatures.h>
 
 namespace geodesk {
 
@@ -16,10 +31,17 @@ namespace geodesk {
 template<typename P>
 class FeatureBase;
 template<typename T>
+class AsyncFeatures;
+template<typename T>
 class FeatureIterator;
+template<typename T, typename V, typename Push>
+class FeaturePipeline;
+template<typename T>
+class MultiFeatures;
 class Filter;
 class MatcherHolder;
 class PreparedFilterFactory;
+class TileReducer;
 
 // forward-declare the derived classes, so we can declare them as friends
 // (otherwise, the derived classes can only access the base class of the 
@@ -41,6 +63,11 @@ public:
     {
     }
 
+    FeaturesBase(FeaturesBase<T>&& other) noexcept :
+        view_(std::move(other.view_))
+    {
+    }
+
     static FeaturesBase empty(FeatureStore* store) noexcept
     {
         return FeaturesBase(View(store));
@@ -52,6 +79,12 @@ public:
         return *this;
     }
 
+    FeaturesBase& operator=(FeaturesBase&& other) noexcept
+    {
+        view_ = std::move(other.view_);
+        return *this;
+    }
+
     // NOLINTNEXTLINE(google-explicit-constructor)
     operator bool() const { return !FeatureUtils::isEmpty(view_); }
     bool operator !() const {return FeatureUtils::isEmpty(view_); }
@@ -59,6 +92,31 @@ public:
     template<typename T2>
     [[nodiscard]] FeaturesBase operator&(const FeaturesBase<T2>& other) const;
 
+    /// @name Set operations
+    /// The result is retrieved in a single pass over the tiles
+    /// covered by the operands, without deduplication. Both operands
+    /// must be world views (not the nodes of a way, the members of a
+    /// relation etc.) of the same GOL.
+    /// @{
+
+    /// @brief Returns the features that are in this set, or in `other`.
+    ///
+    /// @throws QueryException if the sets can't be combined
+    [[nodiscard]] FeaturesBase operator|(const FeaturesBase& other) const;
+
+    /// @brief Returns the features that are in this set, but not in `other`.
+    ///
+    /// @throws QueryException if the sets can't be combined
+    [[nodiscard]] FeaturesBase operator-(const FeaturesBase& other) const;
+
+    /// @brief Returns the features that are in either this set or
+    /// `other`, but not in both.
+    ///
+    /// @throws QueryException if the sets can't be combined
+    [[nodiscard]] FeaturesBase operator^(const FeaturesBase& other) const;
+
+    /// @}
+
     
     /// @name Query by type & tags
     /// @{
@@ -68,6 +126,14 @@ public:
         return FeaturesBase(view_.withQuery(query));
     }
 
+    /// @brief Same as the query string, but parsed at compile time
+    /// (see GOQL())
+    template<GoqlLiteral Q>
+    [[nodiscard]] FeaturesBase operator()(CompiledQuery<Q>) const
+    {
+        return FeaturesBase(view_.withMatcher(CompiledQuery<Q>::bind(view_.store())));
+    }
+
     [[nodiscard]] FeaturesBase operator()(const Feature& feature) const
     {
         return intersecting(feature);
@@ -98,11 +164,95 @@ public:
     [[nodiscard]] std::optional<T> first() const;
     [[nodiscard]] T one() const;
 
+    /// @brief Returns the feature with the given type and ID, if
+    /// it is part of this collection.
+    ///
+    /// Features are located via the store's ID index, which is
+    /// built (and saved next to the GOL) on first use.
+    ///
+    [[nodiscard]] std::optional<T> byId(FeatureType type, uint64_t id) const
+    {
+        FeaturePtr feature = FeatureUtils::byId(view_,
+            TypedFeatureId::ofTypeAndId(type, id));
+        if (feature.isNull()) return std::nullopt;
+        return T(view_.store(), feature);
+    }
+
+    /// @brief Returns the features with the given typed IDs that
+    /// are part of this collection.
+    ///
+    /// Lookups are grouped by tile, so each tile is fetched only
+    /// once; features are returned in tile order (not in the order
+    /// of `ids`). IDs that are not found are skipped.
+    ///
+    [[nodiscard]] std::vector<T> byIds(std::span<const TypedFeatureId> ids) const
+    {
+        std::vector<FeaturePtr> found;
+        FeatureUtils::byIds(view_, ids, found);
+        std::vector<T> results;
+        results.reserve(found.size());
+        for (FeaturePtr feature : found) results.push_back(T(view_.store(), feature));
+        return results;
+    }
+
+    /// @brief Returns the features in this collection whose name
+    /// (the value of `name`, or of any `name:*` tag) contains the
+    /// given text, ignoring case.
+    ///
+    /// If the store has a name index (see FeatureStore::buildNameIndex()),
+    /// only the features that have all trigrams of the text are checked;
+    /// otherwise (or if the text is shorter than 3 bytes), all features
+    /// of the collection are scanned. Features are returned in tile order.
+    ///
+    [[nodiscard]] std::vector<T> searchNames(std::string_view text) const
+    {
+        std::vector<FeaturePtr> found;
+        FeatureUtils::searchNames(view_, text, found);
+        std::vector<T> results;
+        results.reserve(found.size());
+        for (FeaturePtr feature : found) results.push_back(T(view_.store(), feature));
+        return results;
+    }
+
+    /// @brief Returns the features in this collection whose value for
+    /// the given key is a number between `min` and `max` (inclusive).
+    ///
+    /// If the store has a numeric index for the key (see
+    /// FeatureStore::buildNumericIndex()), only the features in the
+    /// range are looked at; otherwise, all features of the collection
+    /// are scanned. Features are returned in tile order.
+    ///
+    [[nodiscard]] std::vector<T> searchRange(std::string_view key,
+        double min, double max) const
+    {
+        std::vector<FeaturePtr> found;
+        FeatureUtils::searchRange(view_, key, min, max, found);
+        std::vector<T> results;
+        results.reserve(found.size());
+        for (FeaturePtr feature : found) results.push_back(T(view_.store(), feature));
+        return results;
+    }
+
     // NOLINTNEXTLINE(google-explicit-constructor)
     [[nodiscard]] operator std::vector<T>() const;
 
+    /// Appends the features to `v`. The features don't hold a
+    /// reference to the store (see Feature), so this never touches
+    /// the store's reference count, no matter how many features
+    /// are added.
+    ///
     void addTo(std::vector<T>& v) const;
 
+    /// Adds the features to `spilled`, which writes them to a
+    /// temporary file once they exceed its memory budget. Only
+    /// features of the store (rather than the members or nodes of
+    /// a feature) can be added this way.
+    ///
+    /// @throws QueryException if this collection isn't a query of
+    ///   the store
+    ///
+    void addTo(SpilledFeatures& spilled) const;
+
     /// @}
     /// @name Scalar queries
     /// @{
@@ -114,6 +264,87 @@ public:
         return FeatureUtils::count(view_);
     }
 
+    /// Estimates the number of features in this collection by scanning
+    /// only a sample of its tiles.
+    ///
+    /// @param sampleFraction the approximate share of tiles to scan
+    ///
+    [[nodiscard]] CountEstimate estimateCount(double sampleFraction = 0.05) const
+    {
+        return FeatureUtils::estimateCount(view_, sampleFraction);
+    }
+
+    /// Looks up the values of the given tags for all features in
+    /// this collection, column by column (in a single pass over the
+    /// tags of each feature, on the query's worker threads).
+    ///
+    [[nodiscard]] TagColumns select(std::initializer_list<std::string_view> keys) const
+    {
+        return FeatureUtils::select(view_,
+            std::span<const std::string_view>(keys.begin(), keys.size()));
+    }
+
+    /// Groups the features in this collection by the value of the
+    /// given tag, for counting (or measuring) each group.
+    ///
+    [[nodiscard]] GroupBy groupBy(std::string_view key) const
+    {
+        return GroupBy(view_, key);
+    }
+
+    /// Builds the network formed by the ways in this collection
+    /// (stitched together at the nodes they share).
+    ///
+    [[nodiscard]] WayGraph graph() const
+    {
+        return FeatureUtils::graph(view_);
+    }
+
+    /// Joins the (non-area) ways in this collection into the longest
+    /// possible lines, at the locations where exactly two of them end.
+    /// If a `key` is given, only ways that have the same value for
+    /// this tag (e.g. "name" or "ref") are joined.
+    ///
+    /// @param directed if true, ways are never reversed (only a way
+    ///   that starts where another ends is joined with it)
+    ///
+    [[nodiscard]] MergedLines mergedLines(std::string_view key = {},
+        bool directed = false) const
+    {
+        return FeatureUtils::mergeLines(view_, key, directed);
+    }
+
+    /// Snaps GPS traces to the (non-area) ways in this collection,
+    /// picking for each point the way that best fits the trace as a
+    /// whole (see MapMatcher). All traces are matched in one batch,
+    /// with the ways around their points fetched in a single query.
+    ///
+    /// @return the matched points, by trace (in the order of `traces`)
+    ///
+    [[nodiscard]] std::vector<MapMatcher::MatchedTrace> matchTraces(
+        const std::vector<MapMatcher::Trace>& traces,
+        const MapMatcher::Settings& settings = {}) const;
+
+    /// Places the coordinates of all features in this collection into
+    /// a single flat buffer (with offsets for each feature and part).
+    /// If `tolerance` (in Mercator units) is given and the store has
+    /// generalized geometries, ways and area relations are taken from
+    /// the coarsest level that doesn't exceed it.
+    ///
+    [[nodiscard]] FlatCoordinates coordinates(
+        CoordinateFormat format = CoordinateFormat::MERCATOR,
+        double tolerance = 0) const
+    {
+        return FeatureUtils::coordinates(view_, format, tolerance);
+    }
+
+    /// Returns `true` if the given feature belongs to this collection.
+    /// For a collection based on a bounding-box query, the feature's
+    /// type, bounds, tags and geometry are checked directly, without
+    /// running the query.
+    ///
+    [[nodiscard]] bool contains(const Feature& feature) const;
+
     /// Returns `true` if this collection contains no features.
     ///
     bool isEmpty() const
@@ -131,6 +362,219 @@ public:
     ///
     [[nodiscard]] double area() const;
 
+    /// @brief Calculates the total area (in square meters) of the parts
+    /// of the features in this collection that lie within the given
+    /// area (e.g. the share of a district that is covered by forest).
+    ///
+    /// The intersections are measured natively (see AreaClipper), on
+    /// the worker threads that scan the tiles.
+    ///
+    /// @return the area, or `0` if `region` is not an area
+    ///
+    [[nodiscard]] double areaWithin(const Feature& region) const;
+
+    /// @brief Maps each feature in this collection to a value and
+    /// combines these values into a single result.
+    ///
+    /// For collections that are backed by a spatial query, `map` and
+    /// `combine` run on the worker threads that scan the tiles, in no
+    /// particular order -- they must therefore be thread-safe, `combine`
+    /// must be associative and commutative, and `init` must be its
+    /// identity value (e.g. `0` for addition).
+    ///
+    /// @param init the initial value of the accumulator
+    /// @param map a function `R(T feature)`
+    /// @param combine a function `R(R a, R b)`
+    ///
+    template <typename R, typename Map, typename Combine>
+    [[nodiscard]] R reduce(R init, Map map, Combine combine) const;
+
+    /// @brief Calls `fn` for each feature in this collection,
+    /// directly from the threads that execute the query.
+    ///
+    /// `fn` must be thread-safe; features are visited in no
+    /// particular order. Returns once all features have been visited.
+    ///
+    /// @param fn a function `void(T feature)`
+    ///
+    template <typename Fn>
+    void parallelForEach(Fn fn) const;
+
+    /// @brief Calls `fn(feature, point)` for each feature in this
+    /// collection, with the point where its label should be placed
+    /// (see Feature::labelPoint()).
+    ///
+    /// The label points are found by the threads that execute the
+    /// query, from which `fn` is called as well; it must therefore be
+    /// thread-safe. Features are visited in no particular order.
+    ///
+    /// @param fn a function `void(T feature, Coordinate point)`
+    ///
+    template <typename Fn>
+    void parallelForEachLabelPoint(Fn fn) const;
+
+    /// @brief Counts the features in each cell of `grid` (e.g. to
+    /// render a heatmap).
+    ///
+    /// A feature belongs to the cell that contains its location --
+    /// its coordinate if it is a node, otherwise its centroid.
+    /// Features located outside the grid aren't counted. For collections
+    /// that are backed by a spatial query, the worker threads that scan
+    /// the tiles bin the features into arrays of their own, which are
+    /// added up once the query is done.
+    ///
+    /// @return the number of features in each cell, indexed by
+    ///   the cell numbers of `grid`
+    ///
+    [[nodiscard]] std::vector<uint64_t> binCount(const BinGrid& grid) const;
+
+    /// @brief Adds up a value for the features in each cell of `grid`
+    /// (see binCount()).
+    ///
+    /// @param value a thread-safe function `double(T feature)`
+    /// @return the sum for each cell, indexed by the cell numbers of `grid`
+    ///
+    template <typename ValueFn>
+    [[nodiscard]] std::vector<double> binSum(const BinGrid& grid, ValueFn value) const;
+
+    /// @brief Groups the locations of the features in this collection
+    /// (nodes, or the centroids of other features) into clusters for
+    /// each zoom level, for display on a map.
+    ///
+    /// The worker threads that scan the tiles collect the points;
+    /// they are then sorted and clustered on multiple threads.
+    ///
+    /// @throws ValueException if the settings are invalid
+    ///
+    [[nodiscard]] PointClusters clusters(const PointClusters::Settings& settings = {}) const;
+
+    /// @brief Calls `fn` for as many features in this collection as
+    /// can be retrieved before `deadline`, starting with the features
+    /// in the tiles nearest to `focus`.
+    ///
+    /// Meant for interactive clients that would rather show a partial
+    /// result than keep the user waiting: once the deadline has passed,
+    /// the query stops scanning and iteration ends. Features are visited
+    /// on the calling thread, roughly in order of distance (tile by tile,
+    /// not feature by feature).
+    ///
+    /// @param deadline the point in time at which iteration stops
+    /// @param focus the point (typically the center of the map view)
+    ///   whose surroundings are retrieved first
+    /// @param fn a function `void(T feature)`
+    /// @return true if all features were visited, false if
+    ///   the deadline cut the iteration short
+    ///
+    template <typename Fn>
+    bool forEachUntil(std::chrono::steady_clock::time_point deadline,
+        Coordinate focus, Fn fn) const;
+
+    #ifdef GEODESK_WITH_GEOS
+    /// @brief Calls `fn(feature, geometry, context)` for each feature in
+    /// this collection, with the feature's GEOS geometry, which is built
+    /// by the threads that execute the query.
+    ///
+    /// Each thread uses a GEOS context of its own, which `fn` must use
+    /// for any operations on the geometry. `fn` takes ownership of the
+    /// geometry, and must be thread-safe; features are visited in no
+    /// particular order. Returns once all features have been visited.
+    ///
+    /// @param fn a function `void(T feature, GEOSGeometry* geometry,
+    ///   GEOSContextHandle_t context)`
+    ///
+    template <typename Fn>
+    void parallelForEachGeometry(Fn fn) const;
+    #endif
+
+    /// @brief Calls `fn(feature, boxIndex)` for each feature in this
+    /// collection that intersects one of the given bounding boxes
+    /// (once for each box it intersects).
+    ///
+    /// For a world view, all boxes are queried in a single pass
+    /// over the tile index, so each tile is scanned only once.
+    ///
+    /// @param boxes simple (non-Antimeridian-crossing) bounding boxes
+    /// @param fn a function `void(T feature, uint32_t boxIndex)`
+    ///
+    template <typename Fn>
+    void forEachInBoxes(const std::vector<Box>& boxes, Fn fn) const;
+
+    /// @brief Calls `fn(pointIndex, area)` for each area in this
+    /// collection that contains one of the given points (a point on
+    /// the boundary of an area counts as contained).
+    ///
+    /// For a world view, the tile index is walked only once, and each
+    /// area is tested against all the points in its bounding box at
+    /// once (see PointAreaLocator). `fn` is called on the calling
+    /// thread, in order of `pointIndex`.
+    ///
+    /// @param points the points to locate
+    /// @param fn a function `void(size_t pointIndex, T area)`
+    ///
+    template <typename Fn>
+    void forEachContainingArea(std::span<const Coordinate> points, Fn fn) const;
+
+    /// @brief Calls `fn(feature, other)` for each pair of a feature in
+    /// this collection and a feature in `others` that are in the given
+    /// spatial relationship (e.g. each building and the landuse area
+    /// it lies WITHIN).
+    ///
+    /// Instead of querying `others` once per feature, both collections
+    /// are processed tile by tile on multiple threads (see SpatialJoin).
+    /// `fn` is called from a single thread, with the pairs in no
+    /// particular order.
+    ///
+    /// @param others the features to pair with
+    /// @param predicate how `feature` relates to `other`
+    /// @param fn a function `void(T feature, T2 other)`
+    /// @param maxMeters the maximum distance between the features
+    ///   (MAX_DISTANCE only)
+    /// @throws QueryException if either collection isn't a world view
+    ///
+    template <typename T2, typename Fn>
+    void join(const FeaturesBase<T2>& others, SpatialPredicate predicate,
+        Fn fn, double maxMeters = 0) const;
+
+    /// @brief Returns the `k` features closest to the given
+    /// Coordinate, nearest first.
+    ///
+    /// The distance of a feature is measured to its closest point
+    /// (or is zero if `xy` lies inside an area). For a world view, the
+    /// tile index and the spatial indexes of the tiles are searched in
+    /// order of distance, so only the tiles around `xy` are read.
+    ///
+    /// @param xy the point from which distances are measured
+    /// @param k the maximum number of features to return
+    /// @param maxMeters only consider features within this distance
+    ///
+    [[nodiscard]] std::vector<T> nearest(Coordinate xy, size_t k,
+        double maxMeters = std::numeric_limits<double>::infinity()) const;
+
+    /// @brief Describes how this collection will be queried: the kind
+    /// of view, its bounds, the matcher's index bits and the filter chain.
+    ///
+    [[nodiscard]] std::string explain() const
+    {
+        return FeatureUtils::explain(view_);
+    }
+
+    /// @brief Runs the query (without materializing any features) and
+    /// returns counters and timings of its execution.
+    ///
+    [[nodiscard]] QueryStats profile() const
+    {
+        return FeatureUtils::profile(view_);
+    }
+
+    /// @brief Returns an AsyncFeatures that retrieves the features of
+    /// this collection in batches, without blocking the calling thread.
+    ///
+    /// @param scheduler posts a job to the caller's event loop
+    ///   (required for `co_await nextBatch()`)
+    ///
+    [[nodiscard]] AsyncFeatures<T> async(
+        std::function<void(std::function<void()>)> scheduler = nullptr) const;
+
     FeatureIterator<T> begin() const;
 
     std::nullptr_t end() const
@@ -158,6 +602,65 @@ public:
         return {view_.withFilter(Filters::within(feature))};
     }
 
+    /// @brief Returns all features whose geometry intersects with the
+    /// polygon formed by the given rings (in Mercator coordinates),
+    /// such as a polygon that was sent along with a request.
+    ///
+    /// The rings need not be closed, and are copied, so the caller
+    /// retains ownership. The query runs as fast as one against the
+    /// geometry of a Feature, and doesn't require GEOS.
+    ///
+    /// @param shell the outer ring (at least 3 coordinates)
+    /// @param holes the inner rings, if any
+    ///
+    /// @throws QueryException if the shell has fewer than 3 coordinates
+    ///
+    [[nodiscard]] FeaturesBase intersecting(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes = {}) const
+    {
+        return {view_.withFilter(Filters::intersects(shell, holes))};
+    }
+
+    /// @brief Returns all features that lie entirely inside the polygon
+    /// formed by the given rings. See intersecting().
+    ///
+    [[nodiscard]] FeaturesBase within(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes = {}) const
+    {
+        return {view_.withFilter(Filters::within(shell, holes))};
+    }
+
+    #ifdef GEODESK_WITH_GEOS
+    /// @brief Returns all features whose geometry intersects with the
+    /// given GEOS geometry (in Mercator coordinates), such as a buffer
+    /// or a union built with GEOS.
+    ///
+    /// Points, linestrings and (multi)polygons are turned into the same
+    /// filters as the geometry of a Feature; any other geometry is
+    /// tested with a GEOS prepared geometry. The geometry is copied,
+    /// so the caller retains ownership.
+    ///
+    /// @param context the GEOS context that created `geom`
+    /// @param geom the geometry to test against
+    ///
+    [[nodiscard]] FeaturesBase intersecting(GEOSContextHandle_t context,
+        const GEOSGeometry* geom) const
+    {
+        return {view_.withFilter(Filters::intersects(context, geom,
+            view_.store()->executor().threadCount()))};
+    }
+
+    /// @brief Returns all features that lie entirely inside the given
+    /// GEOS geometry (in Mercator coordinates). See intersecting().
+    ///
+    [[nodiscard]] FeaturesBase within(GEOSContextHandle_t context,
+        const GEOSGeometry* geom) const
+    {
+        return {view_.withFilter(Filters::within(context, geom,
+            view_.store()->executor().threadCount()))};
+    }
+    #endif
+
     /// @brief Only features whose geometry contains the
     /// given Coordinate.
     ///
@@ -213,6 +716,45 @@ public:
             Coordinate::ofLonLat(lon, lat)))};
     }
 
+    /// @brief Only features whose closest point lies within
+    /// `distance` meters of the geometry of the given Feature.
+    ///
+    /// @param distance the maximum distance (in meters)
+    /// @param feature the feature to measure from
+    ///
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    ///
+    [[nodiscard]] FeaturesBase maxMetersFrom(double distance, const Feature& feature) const
+    {
+        return {view_.withFilter(Filters::maxMetersFrom(distance, feature))};
+    }
+
+    /// @brief Only features whose area (in square meters) lies
+    /// within the given range. Features that aren't areas have an
+    /// area of 0.
+    ///
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    ///
+    [[nodiscard]] FeaturesBase areaBetween(double minArea,
+        double maxArea = std::numeric_limits<double>::infinity()) const
+    {
+        return {view_.withFilter(Filters::area(minArea, maxArea))};
+    }
+
+    /// @brief Only features whose length (in meters) lies within the
+    /// given range. Nodes have a length of 0.
+    ///
+    /// @throws QueryException if one or more tiles that contain
+    ///   the geometry of a Relation are missing
+    ///
+    [[nodiscard]] FeaturesBase lengthBetween(double minLength,
+        double maxLength = std::numeric_limits<double>::infinity()) const
+    {
+        return {view_.withFilter(Filters::length(minLength, maxLength))};
+    }
+
     /// @}
     /// @name Topological filters
     /// @{
@@ -244,13 +786,22 @@ public:
 
     /// @}
 
-    template <typename Predicate>
+    template <ThreadSafePredicate Predicate>
     [[nodiscard]] FeaturesBase filter(Predicate predicate) const
     {
         return FeaturesBase(view_.withFilter(
             new PredicateFilter<Predicate>(predicate)));
     }
 
+    template <typename Context, typename Predicate>
+        requires ContextPredicate<Predicate, Context>
+    [[nodiscard]] FeaturesBase filter(Predicate predicate) const
+    {
+        return FeaturesBase(view_.withFilter(
+            new PredicateWithContextFilter<Predicate, Context>(predicate,
+                view_.store()->executor().threadCount())));
+    }
+
     /// @brief Obtains a Key for the given string, which can be
     /// used for fast tag-value lookups.
     ///
@@ -272,6 +823,10 @@ protected:
     {
     }
 
+    FeaturesBase(View&& view) noexcept : view_(std::move(view))
+    {
+    }
+
     View empty() const
     {
         return view_.empty();
@@ -289,6 +844,15 @@ protected:
 
     FeaturesBase withFilter(PreparedFilterFactory& factory, Feature feature) const;
 
+    template <typename V, typename ValueFn>
+    std::vector<V> bin(const BinGrid& grid, ValueFn value) const;
+
+    /// Passes all features in this collection to `reducer` -- for a
+    /// world view, from the worker threads that scan the tiles (plus
+    /// the features that need deduplication, from this thread);
+    /// otherwise, in batches from this thread.
+    void reduceWith(TileReducer& reducer) const;
+
     View view_;
 
     friend class FeatureBase<FeaturePtr>;
@@ -299,6 +863,14 @@ protected:
     friend class Nodes;
     friend class Ways;
     friend class Relations;
+    template<typename T2>
+    friend class MultiFeatures;
+    friend class PreparedQuery;
+    friend class FeatureSet;
+    template<typename T2>
+    friend class FeaturesBase;
+    template<typename T2, typename V, typename Push>
+    friend class FeaturePipeline;
 };
 
 // \endcond
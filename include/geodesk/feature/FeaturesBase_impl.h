@@ -4,7 +4,19 @@
 #pragma once
 
 #include <geodesk/feature/FeaturesBase.h>
+#include <algorithm>
+#include <cmath>
+#include <geodesk/feature/AsyncFeatures.h>
 #include <geodesk/feature/FeatureIterator.h>
+#include <geodesk/filter/PointDistanceFilter.h>
+#include <geodesk/filter/SetFilter.h>
+#include <geodesk/geom/polygon/AreaClipper.h>
+#ifdef GEODESK_WITH_GEOS
+#include <geodesk/geom/geos/ParallelGeometryVisitor.h>
+#endif
+#include <geodesk/query/BinReducer.h>
+#include <geodesk/query/NearestQuery.h>
+#include <geodesk/query/PointAreaLocator.h>
 
 // \cond
 
@@ -13,20 +25,48 @@ namespace geodesk {
 template<typename T>
 FeatureIterator<T> FeaturesBase<T>::query() const
 {
-    return FeatureIterator<T>(view_);
+    return FeatureIterator<T>(view_, true);
+}
+
+template<typename T>
+FeaturesBase<T> FeaturesBase<T>::operator|(const FeaturesBase& other) const
+{
+    return FeaturesBase(SetFilter::combine(
+        SetFilter::Operation::UNION, view_, other.view_));
+}
+
+template<typename T>
+FeaturesBase<T> FeaturesBase<T>::operator-(const FeaturesBase& other) const
+{
+    return FeaturesBase(SetFilter::combine(
+        SetFilter::Operation::DIFFERENCE, view_, other.view_));
+}
+
+template<typename T>
+FeaturesBase<T> FeaturesBase<T>::operator^(const FeaturesBase& other) const
+{
+    return FeaturesBase(SetFilter::combine(
+        SetFilter::Operation::SYMMETRIC_DIFFERENCE, view_, other.view_));
 }
 
 template<typename T>
 FeatureIterator<T> FeaturesBase<T>::begin() const
 {
-    return FeatureIterator<T>(view_);
+    return FeatureIterator<T>(view_, true);
 }
 
 
+template<typename T>
+AsyncFeatures<T> FeaturesBase<T>::async(
+    std::function<void(std::function<void()>)> scheduler) const
+{
+    return AsyncFeatures<T>(view_, std::move(scheduler));
+}
+
 template<typename T>
 [[nodiscard]] std::optional<T> FeaturesBase<T>::first() const
 {
-    FeatureIterator<T> query(view_);
+    FeatureIterator<T> query(view_, true);
     if(query != nullptr) return std::optional<T>(*query);
     return std::nullopt;
 }
@@ -34,7 +74,7 @@ template<typename T>
 template<typename T>
 [[nodiscard]] T FeaturesBase<T>::one() const
 {
-    FeatureIterator<T> query(view_);
+    FeatureIterator<T> query(view_, true);
     if(query != nullptr)
     {
         T feature = *query;
@@ -48,6 +88,22 @@ template<typename T>
     throw QueryException("No feature found");
 }
 
+template<typename T>
+bool FeaturesBase<T>::contains(const Feature& feature) const
+{
+    if (feature.isAnonymousNode())
+    {
+        // Anonymous nodes can only belong to the nodes of a way
+        if (view_.view() != View::WAY_NODES) return false;
+        for (FeatureIterator<Feature> iter(view_); iter != nullptr; ++iter)
+        {
+            if (*iter == feature) return true;
+        }
+        return false;
+    }
+    return FeatureUtils::contains(view_, feature.store(), feature.ptr());
+}
+
 template<typename T>
 void FeaturesBase<T>::addTo(std::vector<T>& v) const
 {
@@ -55,19 +111,363 @@ void FeaturesBase<T>::addTo(std::vector<T>& v) const
 }
 
 template<typename T>
-[[nodiscard]] double FeaturesBase<T>::area() const
+void FeaturesBase<T>::addTo(SpilledFeatures& spilled) const
+{
+    if (view_.view() != View::WORLD)
+    {
+        throw QueryException("Only the features of a store can be spilled");
+    }
+    assert(spilled.store() == view_.store());
+    Query query(view_.store(), view_.bounds(), view_.types(),
+        view_.matcher(), view_.filter());
+    for (;;)
+    {
+        FeaturePtr next = query.next();
+        if (next.isNull()) break;
+        spilled.add(query.currentTip(), query.currentTile(), next);
+    }
+}
+
+template<typename T>
+void FeaturesBase<T>::reduceWith(TileReducer& reducer) const
 {
-    double total = 0;
-    for(auto f: *this) total += f.area();
+    FeatureStore* store = view_.store();
+    if (view_.view() == View::WORLD)
+    {
+        Query query(store, view_.bounds(), view_.types(),
+            view_.matcher(), view_.filter(), &reducer);
+        // Only features that require deduplication come back to
+        // this thread; everything else has already been reduced
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            reducer.reduce(store, &next, 1);
+        }
+        return;
+    }
+    FeaturePtr batch[TileReducer::MAX_BATCH_SIZE];
+    size_t count = 0;
+    for (T f : *this)
+    {
+        batch[count++] = f.ptr();
+        if (count == TileReducer::MAX_BATCH_SIZE)
+        {
+            reducer.reduce(store, batch, count);
+            count = 0;
+        }
+    }
+    if (count > 0) reducer.reduce(store, batch, count);
+}
+
+template<typename T>
+template <typename R, typename Map, typename Combine>
+[[nodiscard]] R FeaturesBase<T>::reduce(R init, Map map, Combine combine) const
+{
+    if (view_.view() == View::WORLD)
+    {
+        ParallelReducer<T,R,Map,Combine> reducer(init, map, combine);
+        reduceWith(reducer);
+        return reducer.result();
+    }
+    R total = init;
+    for(T f: *this) total = combine(total, map(f));
     return total;
 }
 
+template<typename T>
+template <typename Fn>
+void FeaturesBase<T>::parallelForEach(Fn fn) const
+{
+    if (view_.view() == View::WORLD)
+    {
+        ParallelVisitor<T,Fn> visitor(fn);
+        reduceWith(visitor);
+        return;
+    }
+    for(T f: *this) fn(f);
+}
+
+template<typename T>
+template <typename Fn>
+void FeaturesBase<T>::parallelForEachLabelPoint(Fn fn) const
+{
+    parallelForEach([&fn](T f) { fn(f, f.labelPoint()); });
+}
+
+template<typename T>
+template <typename V, typename ValueFn>
+std::vector<V> FeaturesBase<T>::bin(const BinGrid& grid, ValueFn value) const
+{
+    if (view_.view() == View::WORLD)
+    {
+        FeatureStore* store = view_.store();
+        // A feature's location lies within its bounding box, so only
+        // features that intersect the grid can fall into one of its cells
+        Box bounds = Box::simpleIntersection(view_.bounds(), grid.bounds());
+        if (bounds.isEmpty()) return std::vector<V>(grid.cellCount());
+        BinReducer<T,V,ValueFn> reducer(store->executor().threadCount(), grid, value);
+        Query query(store, bounds, view_.types(),
+            view_.matcher(), view_.filter(), &reducer);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            reducer.reduce(store, &next, 1);
+        }
+        return reducer.result();
+    }
+    std::vector<V> bins(grid.cellCount());
+    for (T f : *this)
+    {
+        int64_t cell = grid.cellOf(f.isNode() ? f.xy() : f.centroid());
+        if (cell >= 0) bins[cell] += value(f);
+    }
+    return bins;
+}
+
+template<typename T>
+std::vector<uint64_t> FeaturesBase<T>::binCount(const BinGrid& grid) const
+{
+    return bin<uint64_t>(grid, [](T) { return uint64_t{1}; });
+}
+
+template<typename T>
+template <typename ValueFn>
+std::vector<double> FeaturesBase<T>::binSum(const BinGrid& grid, ValueFn value) const
+{
+    return bin<double>(grid, value);
+}
+
+template<typename T>
+PointClusters FeaturesBase<T>::clusters(const PointClusters::Settings& settings) const
+{
+    int threads = view_.store()->executor().threadCount();
+    PointClusters::Collector collector(view_.store(), threads, settings);
+    reduceWith(collector);
+    return PointClusters(collector, threads);
+}
+
+template<typename T>
+template <typename Fn>
+bool FeaturesBase<T>::forEachUntil(std::chrono::steady_clock::time_point deadline,
+    Coordinate focus, Fn fn) const
+{
+    if (view_.view() == View::WORLD)
+    {
+        FeatureStore* store = view_.store();
+        QueryOptions options;
+        options.deadline = deadline;
+        options.focus = focus;
+        Query query(store, view_.bounds(), view_.types(),
+            view_.matcher(), view_.filter(), nullptr, nullptr, options);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            fn(T(store, next));
+        }
+        return query.isComplete();
+    }
+    // Other views are small; checking the clock every so often will do
+    uint32_t n = 0;
+    for (T f : *this)
+    {
+        if ((++n & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        fn(f);
+    }
+    return true;
+}
+
+#ifdef GEODESK_WITH_GEOS
+template<typename T>
+template <typename Fn>
+void FeaturesBase<T>::parallelForEachGeometry(Fn fn) const
+{
+    if (view_.view() == View::WORLD)
+    {
+        FeatureStore* store = view_.store();
+        ParallelGeometryVisitor<T,Fn> visitor(store->executor().threadCount(), fn);
+        Query query(store, view_.bounds(), view_.types(),
+            view_.matcher(), view_.filter(), &visitor);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            visitor.reduce(store, &next, 1);
+        }
+        return;
+    }
+    GEOSContextHandle_t context = GEOS_init_r();
+    for(T f: *this) fn(f, f.toGeometry(context), context);
+    GEOS_finish_r(context);
+}
+#endif
+
+template<typename T>
+template<typename Fn>
+void FeaturesBase<T>::forEachInBoxes(const std::vector<Box>& boxes, Fn fn) const
+{
+    if (boxes.empty()) return;
+    if (view_.view() == View::WORLD)
+    {
+        // Clip the boxes to the view's own bounds; indexes stay the same
+        std::vector<Box> clipped;
+        clipped.reserve(boxes.size());
+        bool anyBox = false;
+        for (const Box& box : boxes)
+        {
+            clipped.push_back(Box::simpleIntersection(box, view_.bounds()));
+            anyBox |= !clipped.back().isEmpty();
+        }
+        if (!anyBox) return;
+
+        FeatureStore* store = view_.store();
+        Query query(store, clipped.data(), static_cast<uint32_t>(clipped.size()),
+            view_.types(), view_.matcher(), view_.filter());
+        for (;;)
+        {
+            uint32_t boxIndex;
+            FeaturePtr next = query.next(&boxIndex);
+            if (next.isNull()) break;
+            fn(T(store, next), boxIndex);
+        }
+        return;
+    }
+    for (T f : *this)
+    {
+        Box bounds = f.bounds();
+        for (uint32_t i = 0; i < boxes.size(); i++)
+        {
+            if (boxes[i].intersects(bounds)) fn(f, i);
+        }
+    }
+}
+
+template<typename T>
+std::vector<MapMatcher::MatchedTrace> FeaturesBase<T>::matchTraces(
+    const std::vector<MapMatcher::Trace>& traces,
+    const MapMatcher::Settings& settings) const
+{
+    MapMatcher matcher(traces, settings);
+    forEachInBoxes(matcher.cellBoxes(), [&matcher](T f, uint32_t cell)
+    {
+        FeaturePtr p = f.ptr();
+        if (p.isWay() && !p.isArea()) matcher.addWay(cell, WayPtr(p));
+    });
+    return matcher.match(view_.store()->executor().threadCount());
+}
+
+template<typename T>
+template<typename Fn>
+void FeaturesBase<T>::forEachContainingArea(std::span<const Coordinate> points, Fn fn) const
+{
+    PointAreaLocator locator(points);
+    FeatureStore* store = view_.store();
+    if (view_.view() == View::WORLD)
+    {
+        locator.query(store, view_.bounds(), view_.types(),
+            view_.matcher(), view_.filter());
+    }
+    else
+    {
+        for (T f : *this) locator.addArea(store, f.ptr());
+        locator.finish();
+    }
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        for (FeaturePtr area : locator.areas(i)) fn(i, T(store, area));
+    }
+}
+
+template<typename T>
+template <typename T2, typename Fn>
+void FeaturesBase<T>::join(const FeaturesBase<T2>& others,
+    SpatialPredicate predicate, Fn fn, double maxMeters) const
+{
+    FeatureStore* store = view_.store();
+    SpatialJoin join(view_, others.view_, predicate, maxMeters);
+    join.run([store, &fn](FeaturePtr a, FeaturePtr b)
+    {
+        fn(T(store, a), T2(store, b));
+    });
+}
+
+template<typename T>
+[[nodiscard]] std::vector<T> FeaturesBase<T>::nearest(
+    Coordinate xy, size_t k, double maxMeters) const
+{
+    std::vector<T> results;
+    if (k == 0) return results;
+    FeatureStore* store = view_.store();
+    if (view_.view() == View::WORLD)
+    {
+        NearestQuery query(store, view_.bounds(), view_.types(),
+            view_.matcher(), view_.filter(), xy, maxMeters);
+        while (results.size() < k)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            results.push_back(T(store, next));
+        }
+        return results;
+    }
+
+    // Other views have no spatial index, so we measure every feature
+    // and keep the k closest in a max-heap
+    using Candidate = std::pair<double,FeaturePtr>;
+    auto further = [](const Candidate& a, const Candidate& b)
+    {
+        return a.first < b.first;
+    };
+    std::vector<Candidate> best;
+    FeaturesBase candidates = std::isfinite(maxMeters) ?
+        maxMetersFrom(maxMeters, xy) : *this;
+    for (T f : candidates)
+    {
+        double d = PointDistanceFilter::distanceSquared(store, f.ptr(), xy);
+        if (best.size() == k)
+        {
+            if (d >= best.front().first) continue;
+            std::pop_heap(best.begin(), best.end(), further);
+            best.pop_back();
+        }
+        best.emplace_back(d, f.ptr());
+        std::push_heap(best.begin(), best.end(), further);
+    }
+    std::sort_heap(best.begin(), best.end(), further);
+    results.reserve(best.size());
+    for (const Candidate& c : best) results.push_back(T(store, c.second));
+    return results;
+}
+
+template<typename T>
+[[nodiscard]] double FeaturesBase<T>::area() const
+{
+    return reduce(0.0,
+        [](const T& f) { return f.area(); },
+        [](double a, double b) { return a + b; });
+}
+
+template<typename T>
+[[nodiscard]] double FeaturesBase<T>::areaWithin(const Feature& region) const
+{
+    if (!region.isArea()) return 0;
+    AreaClipper clipper(region.store(), region.ptr());
+    return intersecting(region).reduce(0.0,
+        [&clipper](const T& f) { return clipper.areaOf(f.store(), f.ptr()); },
+        [](double a, double b) { return a + b; });
+}
+
 template<typename T>
 [[nodiscard]] double FeaturesBase<T>::length() const
 {
-    double total = 0;
-    for(auto f: *this) total += f.length();
-    return total;
+    return reduce(0.0,
+        [](const T& f) { return f.length(); },
+        [](double a, double b) { return a + b; });
 }
 
 template<typename T>
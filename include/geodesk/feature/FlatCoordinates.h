@@ -0,0 +1,94 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace geodesk {
+
+/// @brief How Features::coordinates() represents coordinates
+///
+enum class CoordinateFormat
+{
+    MERCATOR,       ///< `int32_t` x/y pairs (Mercator-projected)
+    LONLAT          ///< `double` longitude/latitude pairs (WGS-84)
+};
+
+/// @brief The coordinates of a set of features, in a single flat buffer
+/// (see Features::coordinates()).
+///
+/// The geometry of each feature consists of parts: a node has a single
+/// point, a way is a single line (or a closed ring, if it is an area),
+/// and an area relation is a sequence of rings, each outer ring followed
+/// by its inner rings. Other relations have no parts. The parts of
+/// feature `i` are those from `featureOffsets()[i]` to
+/// `featureOffsets()[i+1]`; the coordinates of part `j` are the pairs
+/// from `partOffsets()[j]` to `partOffsets()[j+1]` (so the values at
+/// twice these offsets in mercator() or lonLat()).
+///
+class FlatCoordinates
+{
+public:
+    enum PartType : uint8_t
+    {
+        POINT,
+        LINE,
+        OUTER_RING,
+        INNER_RING
+    };
+
+    explicit FlatCoordinates(CoordinateFormat format = CoordinateFormat::MERCATOR) :
+        format_(format),
+        featureOffsets_(1, 0),
+        partOffsets_(1, 0)
+    {
+    }
+
+    CoordinateFormat format() const noexcept { return format_; }
+
+    /// @brief The number of features
+    size_t featureCount() const noexcept { return ids_.size(); }
+
+    /// @brief The total number of parts (points, lines and rings)
+    size_t partCount() const noexcept { return partTypes_.size(); }
+
+    /// @brief The total number of coordinate pairs
+    size_t coordinateCount() const noexcept { return partOffsets_.back(); }
+
+    /// @brief The typed ID of each feature (the ID shifted left by
+    /// two bits, with the FeatureType in the lowest two bits)
+    std::span<const uint64_t> typedIds() const noexcept { return ids_; }
+
+    /// @brief The first part of each feature, followed by the
+    /// total number of parts (featureCount() + 1 entries)
+    std::span<const uint32_t> featureOffsets() const noexcept { return featureOffsets_; }
+
+    /// @brief The first coordinate pair of each part, followed by
+    /// the total number of pairs (partCount() + 1 entries)
+    std::span<const uint32_t> partOffsets() const noexcept { return partOffsets_; }
+
+    /// @brief The type of each part
+    std::span<const PartType> partTypes() const noexcept { return partTypes_; }
+
+    /// @brief The x/y pairs (empty unless the format is MERCATOR)
+    std::span<const int32_t> mercator() const noexcept { return mercator_; }
+
+    /// @brief The lon/lat pairs (empty unless the format is LONLAT)
+    std::span<const double> lonLat() const noexcept { return lonLat_; }
+
+private:
+    CoordinateFormat format_;
+    std::vector<uint64_t> ids_;
+    std::vector<uint32_t> featureOffsets_;
+    std::vector<uint32_t> partOffsets_;
+    std::vector<PartType> partTypes_;
+    std::vector<int32_t> mercator_;
+    std::vector<double> lonLat_;
+
+    friend class CoordinateCollector;
+};
+
+} // namespace geodesk
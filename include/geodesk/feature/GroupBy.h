@@ -0,0 +1,91 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/feature/FeatureBase.h>
+#include <geodesk/feature/FeatureUtils.h>
+#include <geodesk/feature/View.h>
+
+namespace geodesk {
+
+/// @brief The features of a collection that share the same value
+/// of a tag (see GroupBy).
+///
+struct TagGroup
+{
+    /// @brief The value of the tag
+    std::string value;
+
+    /// @brief The number of features with this value
+    uint64_t count = 0;
+
+    /// @brief The total of the measured quantity (0 for GroupBy::count())
+    double sum = 0;
+};
+
+/// @brief The features of a collection, grouped by the value of a
+/// tag (see Features::groupBy()).
+///
+/// Each of the aggregate functions runs the query once and returns the
+/// groups with the most features first. For collections that are backed
+/// by a spatial query, features are tallied by the threads that scan
+/// the tiles, with values identified by their string codes (or hashes);
+/// strings are only created for the final groups. Features that don't
+/// have the tag are not counted.
+///
+class GroupBy
+{
+public:
+    GroupBy(const View& view, std::string_view key) :
+        view_(view), key_(key) {}
+
+    /// @brief Counts the features with each value of the tag.
+    ///
+    [[nodiscard]] std::vector<TagGroup> count() const
+    {
+        return FeatureUtils::groupBy(view_, key_, nullptr);
+    }
+
+    /// @brief Counts the features with each value of the tag, and
+    /// calculates their total length (in meters).
+    ///
+    [[nodiscard]] std::vector<TagGroup> length() const
+    {
+        return sum([](const Feature& f) { return f.length(); });
+    }
+
+    /// @brief Counts the features with each value of the tag, and
+    /// calculates their total area (in square meters).
+    ///
+    [[nodiscard]] std::vector<TagGroup> area() const
+    {
+        return sum([](const Feature& f) { return f.area(); });
+    }
+
+    /// @brief Counts the features with each value of the tag, and
+    /// adds up the given measure of each feature.
+    ///
+    /// `measure` is called concurrently from the threads that execute
+    /// the query, and must therefore be thread-safe.
+    ///
+    /// @param measure a function `double(Feature feature)`
+    ///
+    template <typename Fn>
+    [[nodiscard]] std::vector<TagGroup> sum(Fn measure) const
+    {
+        std::function<double(const Feature&)> fn(measure);
+        return FeatureUtils::groupBy(view_, key_, &fn);
+    }
+
+private:
+    View view_;
+    std::string key_;
+};
+
+} // namespace geodesk
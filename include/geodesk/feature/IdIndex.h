@@ -0,0 +1,86 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/TypedFeatureId.h>
+#include <geodesk/feature/types.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A table that maps the typed IDs of all features in a FeatureStore to
+/// their tiles, sorted by typed ID. It is kept in a sidecar file next to
+/// the GOL (`<gol>.ids`) and memory-mapped; if the file is missing or
+/// belongs to a different version of the GOL, the index is rebuilt by
+/// scanning all tiles (If the sidecar cannot be written, the index is
+/// simply held in memory).
+///
+/// A feature that spans several tiles is indexed only once.
+///
+class GEODESK_API IdIndex
+{
+public:
+    struct Entry
+    {
+        uint64_t typedId;
+        Tip tip;
+        uint32_t offset;        // of the feature, relative to the tile
+    };
+
+    IdIndex(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    IdIndex(const IdIndex&) = delete;
+    IdIndex& operator=(const IdIndex&) = delete;
+
+    size_t size() const { return count_; }
+
+    /// Returns the index entry of the given feature, or nullptr if
+    /// the store contains no such feature.
+    const Entry* find(TypedFeatureId id) const;
+
+    /// Looks up the given feature (fetching its tile).
+    ///
+    /// @return the feature, or a null pointer if not found
+    FeaturePtr get(TypedFeatureId id) const;
+
+private:
+    static constexpr uint32_t MAGIC = 0x1D5E1DE5;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint64_t count;
+    };
+
+    bool tryOpen(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+    void build();
+    void save(const std::string& fileName, const Header& header);
+    static void addTile(DataPtr pTile, Tip tip, std::vector<Entry>& entries);
+
+    FeatureStore* store_;
+    SidecarFile file_;
+    const Entry* entries_;
+    size_t count_;
+    std::vector<Entry> memEntries_;     // if the sidecar could not be written
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <string_view>
 #include <utility>
 #include <geodesk/feature/TagValue.h>
 
@@ -91,4 +92,30 @@ Stream& operator<<(Stream& out, const Key& k)
 	return static_cast<Stream&>(out);
 }
 
+/// @brief Literals for key strings.
+///
+/// Looking up a tag by a string (rather than a Key) resolves the
+/// string's global-string code via a small per-thread cache, keyed
+/// by the address of the string. A string literal never moves, so
+/// a key written as a `_key` literal is resolved once (per thread
+/// and GOL), and costs about the same as a Key afterwards (unlike a
+/// plain `const char*`, its length is known at compile time):
+///
+/// ```
+/// using namespace geodesk::keys;
+/// for(Feature street: streets)
+/// {
+///     TagValue name = street["name"_key];
+/// }
+/// ```
+///
+namespace keys {
+
+constexpr std::string_view operator""_key(const char* str, size_t len) noexcept
+{
+    return { str, len };
+}
+
+} // namespace keys
+
 } // namespace geodesk
@@ -3,8 +3,8 @@
 
 #pragma once
 
-#include <unordered_map>
 #include <stdint.h>
+#include <vector>
 #include <clarisma/data/Span.h>
 
 namespace geodesk {
@@ -16,12 +16,12 @@ class KeyIndexSchema
 public:
 	int getCategory(int keyCode) const
 	{
-		auto it = keysToCategories_.find(keyCode);
-		return (it != keysToCategories_.end()) ? it->second : 0;
+		return static_cast<uint32_t>(keyCode) < keyCategories_.size() ?
+			keyCategories_[keyCode] : 0;
 	}
 
 private:
-	std::unordered_map<uint16_t, uint16_t> keysToCategories_;
+	std::vector<uint8_t> keyCategories_;	// indexed by key code
 };
 
 // \endcond
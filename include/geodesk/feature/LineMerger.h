@@ -0,0 +1,124 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/MergedLines.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Joins ways into linestrings at the locations where exactly two of
+/// them (of the same group) end. Like the WayGraphBuilder, it gathers
+/// ways from multiple threads: each thread takes a Batch from the pool,
+/// adds the coordinates of its ways and returns the batch.
+///
+/// merge() first counts the ends that meet at each location (sharded
+/// by hash, one shard per thread). Each batch then joins its own ways
+/// into chains (in parallel), which leaves only the ends of chains that
+/// continue in other batches (typically, ways that cross the borders of
+/// the tiles that were scanned by different threads). These are
+/// stitched together in a final pass over the chains.
+///
+class GEODESK_API LineMerger
+{
+private:
+    /// A location where lines of a given group end
+    struct End
+    {
+        uint64_t xy;
+        uint32_t group;
+        uint32_t ref;       // piece * 2 + (1 if end, 0 if start)
+
+        bool operator<(const End& other) const
+        {
+            return xy != other.xy ? xy < other.xy : group < other.group;
+        }
+        bool sameLocation(const End& other) const
+        {
+            return xy == other.xy && group == other.group;
+        }
+    };
+
+public:
+    /// @param directed if true, ways are never reversed, i.e. a way
+    ///   is only joined with one that starts where it ends
+    explicit LineMerger(bool directed = false) : directed_(directed) {}
+
+    class Batch
+    {
+    public:
+        /// Adds a way (its group is typically the value of a tag)
+        void addWay(uint64_t id, std::string_view group,
+            const Coordinate* coords, size_t count);
+
+    private:
+        struct Piece
+        {
+            uint32_t group;
+            uint32_t coordsStart;
+            uint32_t coordsEnd;
+            uint32_t waysStart;
+            uint32_t waysEnd;
+        };
+
+        struct Pieces
+        {
+            std::vector<Piece> pieces;
+            std::vector<Coordinate> coords;
+            std::vector<uint64_t> ways;
+        };
+
+        Pieces input_;
+        Pieces chains_;
+        std::unordered_map<std::string, uint32_t> groupCodes_;
+        std::vector<uint32_t> globalGroups_;    // local group -> merged
+        std::vector<std::vector<End>> shardEnds_;
+
+        friend class LineMerger;
+    };
+
+    /// Thread-safe
+    Batch* acquire();
+
+    /// Thread-safe
+    void release(Batch* batch);
+
+    /// Must be called once all batches have been released
+    ///
+    /// @param threads  the number of threads to use (including the
+    ///                 calling thread)
+    MergedLines merge(int threads);
+
+private:
+    using Piece = Batch::Piece;
+    using Pieces = Batch::Pieces;
+
+    class EndCounts;
+
+    static uint64_t key(Coordinate c)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) |
+            static_cast<uint32_t>(c.y);
+    }
+
+    void chain(const Pieces& in, const EndCounts& counts, Pieces& out) const;
+
+    bool directed_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Batch>> batches_;
+    std::vector<Batch*> idle_;
+};
+
+// \endcond
+
+} // namespace geodesk
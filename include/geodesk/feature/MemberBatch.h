@@ -0,0 +1,65 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <clarisma/util/ShortVarString.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/RelationPtr.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Resolves the members of many relations (or the parent relations of
+/// many features) at once, rather than setting up a MemberIterator
+/// (or ParentRelationIterator) for each.
+///
+/// The member tables are decoded in parallel. Members that live in
+/// the same tile as their relation are resolved right away; foreign
+/// members are collected as (TIP, offset) pairs, which are then
+/// grouped by TIP, so each foreign tile is fetched only once no matter
+/// how many relations refer to it. The groups are resolved in
+/// parallel as well.
+///
+/// The result is a flat array, ordered by the index of the relation
+/// (or feature) in the input, then by the order of the members (or
+/// parents) in their table.
+///
+class GEODESK_API MemberBatch
+{
+public:
+    struct Entry
+    {
+        /// The member (or parent relation)
+        FeaturePtr feature;
+        /// The index of the relation (or feature) in the input
+        uint32_t parent;
+        /// The global string code of the role, or -1 if the role
+        /// is a local string (see `localRole`). Parent relations
+        /// have no role (the relation tables don't record them),
+        /// so their code is -1 and their `localRole` is null.
+        int32_t roleCode;
+        const clarisma::ShortVarString* localRole;
+    };
+
+    /// Resolves the members of the given relations, using up to
+    /// `threads` threads (by default, as many as the store's
+    /// executor has)
+    static std::vector<Entry> membersOf(FeatureStore* store,
+        std::span<const RelationPtr> relations, int threads = 0);
+
+    /// Resolves the parent relations of the given features (features
+    /// that don't belong to any relation have none)
+    static std::vector<Entry> parentsOf(FeatureStore* store,
+        std::span<const FeaturePtr> features, int threads = 0);
+};
+
+// \endcond
+
+} // namespace geodesk
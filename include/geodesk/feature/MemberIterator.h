@@ -6,6 +6,7 @@
 #include <clarisma/util/ShortVarString.h>
 #include <geodesk/feature/FeaturePtr.h>
 #include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileCache.h>
 
 namespace geodesk {
 
@@ -28,7 +29,8 @@ class MemberIterator
 {
 public:
 	MemberIterator(FeatureStore* store, DataPtr pMembers,
-		FeatureTypes types, const MatcherHolder* matcher, const Filter* filter);
+		FeatureTypes types, const MatcherHolder* matcher, const Filter* filter,
+		TileCache* tiles = nullptr);
 
 	~MemberIterator()
 	{
@@ -46,6 +48,10 @@ public:
 	}
 	Tip currentTip() const { return currentTip_; }
 
+	/// The cache used to resolve foreign tiles (if none was passed
+	/// to the constructor, each iterator uses its own)
+	TileCache& tiles() { return sharedTiles_ ? *sharedTiles_ : ownTiles_; }
+
 	std::string_view currentRole() const
 	{
 		if (currentRoleCode_ >= 0)
@@ -121,9 +127,12 @@ private:
 	#endif
 	Tip currentTip_;
 	int32_t currentMember_;
-	const Matcher* currentMatcher_;
+	const Matcher* currentMatcher_;     // null if current role is not accepted
+	const RoleMatcher* roleMatcher_;    // null if all roles are accepted
 	DataPtr p_;
 	DataPtr pForeignTile_;
+	TileCache* sharedTiles_;
+	TileCache ownTiles_;
 };
 
 // \endcond
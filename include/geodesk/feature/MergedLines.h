@@ -0,0 +1,79 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// @brief The linestrings formed by joining ways at their end points
+/// (see Features::mergedLines()).
+///
+/// Two ways are joined if they belong to the same group (e.g. have the
+/// same name) and their ends meet at a location where no other way of
+/// that group starts or ends. A line whose first and last coordinates
+/// are the same is closed. The coordinates of line `i` are those from
+/// lineStart(i) to lineEnd(i).
+///
+class MergedLines
+{
+public:
+    MergedLines() : offsets_(1, 0), wayOffsets_(1, 0) {}
+
+    /// @brief The number of lines
+    size_t lineCount() const noexcept { return lineGroups_.size(); }
+
+    /// @brief The coordinates of a line
+    std::span<const Coordinate> line(size_t i) const noexcept
+    {
+        return { coords_.data() + offsets_[i], coords_.data() + offsets_[i + 1] };
+    }
+
+    /// @brief The IDs of the ways that form a line, in the order
+    /// in which they were joined
+    std::span<const uint64_t> ways(size_t i) const noexcept
+    {
+        return { ways_.data() + wayOffsets_[i], ways_.data() + wayOffsets_[i + 1] };
+    }
+
+    /// @brief The group of a line (e.g. its name), or an empty string
+    /// if the ways weren't grouped (or didn't have the grouping tag)
+    std::string_view group(size_t i) const noexcept
+    {
+        return groups_[lineGroups_[i]];
+    }
+
+    /// @brief Returns true if the line forms a ring
+    bool isClosed(size_t i) const noexcept
+    {
+        std::span<const Coordinate> c = line(i);
+        return c.size() > 2 && c.front() == c.back();
+    }
+
+    /// @brief The index of the first coordinate of line `i`
+    uint32_t lineStart(size_t i) const noexcept { return offsets_[i]; }
+
+    /// @brief The index past the last coordinate of line `i`
+    uint32_t lineEnd(size_t i) const noexcept { return offsets_[i + 1]; }
+
+    /// @brief The coordinates of all lines
+    std::span<const Coordinate> coordinates() const noexcept { return coords_; }
+
+private:
+    std::vector<Coordinate> coords_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint64_t> ways_;
+    std::vector<uint32_t> wayOffsets_;
+    std::vector<uint32_t> lineGroups_;
+    std::vector<std::string> groups_;
+
+    friend class LineMerger;
+};
+
+} // namespace geodesk
@@ -0,0 +1,128 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include <geodesk/feature/FeaturesBase.h>
+#include <geodesk/query/FederatedQuery.h>
+
+namespace geodesk {
+
+/// \cond
+///
+/// A collection of features that spans several FeatureStores, such as
+/// a set of regional GOLs, and behaves like a single collection:
+///
+/// ```
+/// MultiFeatures<Feature> europe({ Features("france.gol"), Features("germany.gol") });
+/// for (Feature f : europe("na[amenity=pub]"))
+/// {
+///     ...
+/// }
+/// ```
+///
+/// The queries of all stores run concurrently and their results are
+/// merged as they arrive (see FederatedQuery); a feature that lies on
+/// the border of two regions (and hence is stored in both GOLs) is
+/// returned only once. The order of features is unspecified.
+///
+template<typename T>
+class MultiFeatures
+{
+public:
+    MultiFeatures(std::initializer_list<FeaturesBase<T>> parts) :
+        parts_(parts)
+    {
+    }
+
+    explicit MultiFeatures(std::vector<FeaturesBase<T>> parts) :
+        parts_(std::move(parts))
+    {
+    }
+
+    /// Returns the features in all stores that match the given query.
+    ///
+    [[nodiscard]] MultiFeatures operator()(const char* query) const
+    {
+        std::vector<FeaturesBase<T>> parts;
+        parts.reserve(parts_.size());
+        for (const FeaturesBase<T>& part : parts_) parts.push_back(part(query));
+        return MultiFeatures(std::move(parts));
+    }
+
+    /// Returns the features in all stores whose bounding box
+    /// intersects the given box.
+    ///
+    [[nodiscard]] MultiFeatures operator()(const Box& box) const
+    {
+        std::vector<FeaturesBase<T>> parts;
+        parts.reserve(parts_.size());
+        for (const FeaturesBase<T>& part : parts_) parts.push_back(part(box));
+        return MultiFeatures(std::move(parts));
+    }
+
+    const std::vector<FeaturesBase<T>>& parts() const { return parts_; }
+
+    [[nodiscard]] uint64_t count() const
+    {
+        uint64_t count = 0;
+        for (Iterator iter = begin(); iter != nullptr; ++iter) count++;
+        return count;
+    }
+
+    class Iterator
+    {
+    public:
+        explicit Iterator(std::vector<View>&& views) :
+            views_(std::move(views)),
+            query_(std::make_unique<FederatedQuery>(views_)),
+            store_(nullptr)
+        {
+            pFeature_ = query_->next(&store_);
+        }
+
+        T operator*() const
+        {
+            Feature feature(store_, pFeature_);
+            return reinterpret_cast<const T&>(feature);
+        }
+
+        Iterator& operator++()
+        {
+            pFeature_ = query_->next(&store_);
+            return *this;
+        }
+
+        bool operator!=(std::nullptr_t) const { return !pFeature_.isNull(); }
+        bool operator==(std::nullptr_t) const { return pFeature_.isNull(); }
+
+    private:
+        std::vector<View> views_;       // keep matchers and filters alive
+        std::unique_ptr<FederatedQuery> query_;
+        FeatureStore* store_;
+        FeaturePtr pFeature_;
+    };
+
+    Iterator begin() const
+    {
+        std::vector<View> views;
+        views.reserve(parts_.size());
+        for (const FeaturesBase<T>& part : parts_) views.push_back(part.view_);
+        return Iterator(std::move(views));
+    }
+
+    std::nullptr_t end() const
+    {
+        return nullptr;
+    }
+
+private:
+    std::vector<FeaturesBase<T>> parts_;
+};
+
+// \endcond
+
+} // namespace geodesk
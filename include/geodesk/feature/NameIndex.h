@@ -0,0 +1,115 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// An inverted index of the trigrams (runs of three bytes) of the
+/// normalized `name` and `name:*` values of all features, which lets a
+/// substring search over names look at only the features that have all
+/// of the search text's trigrams, instead of scanning every tile. The
+/// index is kept in an optional sidecar file next to the GOL
+/// (`<gol>.names`), created by build(); it is only used if it belongs
+/// to the same version of the GOL.
+///
+/// Each trigram has a posting list of the features whose names contain
+/// it, as references (TIP and offset of the feature within its tile)
+/// that are sorted and delta-encoded as varints. A feature that lives
+/// in multiple tiles is indexed only once.
+///
+class GEODESK_API NameIndex
+{
+public:
+    NameIndex(const NameIndex&) = delete;
+    NameIndex& operator=(const NameIndex&) = delete;
+
+    /// Maps the trigram postings that build() wrote to the given file.
+    ///
+    /// @return the index, or nullptr if not available
+    static std::unique_ptr<NameIndex> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Scans all tiles of the store (on multiple threads) and writes
+    /// the trigrams of their features' names to the given file.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   store's query executor)
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize, int threads = 0);
+
+    /// The number of distinct trigrams in the index
+    uint64_t trigramCount() const { return trigramCount_; }
+
+    /// Appends the features whose names may contain the given text
+    /// (which must have been normalized) to `features`, sorted by tile.
+    /// Each candidate has all trigrams of the text, but must still be
+    /// checked via namesContain().
+    ///
+    /// @return false if the text is too short to have any trigrams
+    ///   (in which case nothing is appended)
+    bool candidates(FeatureStore* store, std::string_view text,
+        std::vector<FeaturePtr>& features) const;
+
+    /// Lowercases the ASCII and Latin-1 letters of a name (other
+    /// characters are left as they are)
+    static std::string normalize(std::string_view s);
+
+    /// Returns true if the value of the feature's `name` tag, or of any
+    /// of its `name:*` tags, contains the given (normalized) text,
+    /// ignoring case
+    static bool namesContain(FeatureStore* store, FeaturePtr feature,
+        std::string_view text);
+
+private:
+    NameIndex() : entries_(nullptr),
+        trigramCount_(0), postings_(nullptr) {}
+
+    class Builder;
+
+    static constexpr uint32_t MAGIC = 0x7A3E'1D0C;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint64_t trigramCount;
+        uint64_t postingsSize;
+    };
+
+    struct Entry
+    {
+        uint32_t trigram;
+        uint32_t count;         // number of features in the posting list
+        uint64_t offset;        // relative to the start of the postings
+    };
+
+    const Entry* find(uint32_t trigram) const;
+    void decode(const Entry* entry, std::vector<uint64_t>& refs) const;
+
+    SidecarFile file_;
+    const Entry* entries_;
+    uint64_t trigramCount_;
+    const uint8_t* postings_;
+};
+
+// \endcond
+
+} // namespace geodesk
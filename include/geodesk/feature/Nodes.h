@@ -17,8 +17,8 @@ public:
 	Nodes(const FeaturesBase<Feature>& other) : 
 		FeaturesBase(View(other.view_ & FeatureTypes::NODES)) {}
 	Nodes(const FeaturesBase<Node>& other) : FeaturesBase(other.view_) {}
-	Nodes(const FeaturesBase<Way>& other) : FeaturesBase(empty()) {}
-	Nodes(const FeaturesBase<Relation>& other) : FeaturesBase(empty()) {}
+	Nodes(const FeaturesBase<Way>& /* other */) : FeaturesBase(empty()) {}
+	Nodes(const FeaturesBase<Relation>& /* other */) : FeaturesBase(empty()) {}
 
 };
 
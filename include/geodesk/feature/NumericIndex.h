@@ -0,0 +1,165 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/Key.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// An index of the numeric values of a few chosen keys (e.g. `ele`,
+/// `population` or `building:levels`), which speeds up queries for
+/// features whose value lies within a range, such as `[ele>3000]`.
+/// The index is kept in an optional sidecar file next to the GOL
+/// (`<gol>.numbers`), created by build(); it is only used if it belongs
+/// to the same version of the GOL.
+///
+/// For each key, the index holds:
+///
+/// - the smallest and largest value of each tile that has any features
+///   with a numeric value for the key, which lets a query skip the tiles
+///   whose values lie entirely outside of the range it is looking for
+///   (the matcher tells the query which range it needs, see
+///   MatcherHolder::requiredRange())
+///
+/// - the values of all features, sorted along with references to their
+///   features (TIP and offset within the tile), which lets a lookup go
+///   straight to the features in a given range (see candidates()).
+///   A feature that lives in multiple tiles is listed only once.
+///
+/// A value is numeric if it is stored as a number, or if it is a string
+/// that starts with a number (the same rule that the matcher uses for
+/// comparisons).
+///
+class GEODESK_API NumericIndex
+{
+public:
+    NumericIndex(const NumericIndex&) = delete;
+    NumericIndex& operator=(const NumericIndex&) = delete;
+
+    /// Maps the sorted values that build() wrote to the given file.
+    ///
+    /// @return the index, or nullptr if not available
+    static std::unique_ptr<NumericIndex> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Scans all tiles of the store (on multiple threads) and writes
+    /// the values of the given keys to the given file.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   store's query executor)
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize,
+        const std::vector<std::string>& keys, int threads = 0);
+
+    /// The number of indexed keys
+    uint32_t keyCount() const { return keyCount_; }
+
+    /// The name of the n-th indexed key
+    std::string_view keyName(int n) const;
+
+    /// The number of values of the n-th indexed key (one for each
+    /// feature that has a numeric value)
+    uint64_t valueCount(int n) const;
+
+    /// Returns the number of the given key within the index, or -1
+    /// if it isn't indexed
+    int findKey(std::string_view key) const;
+
+    /// Returns the number of the key with the given global-string code,
+    /// or -1 if it isn't indexed
+    int findGlobalKey(int keyCode) const;
+
+    /// Returns false if none of the features in the given tile has a
+    /// value for the n-th key that lies within `min` and `max`
+    /// (inclusive)
+    bool mayMatchTile(int n, Tip tip, double min, double max) const;
+
+    /// Appends the features whose value for the n-th key lies within
+    /// `min` and `max` (inclusive) to `features`, sorted by tile.
+    void candidates(FeatureStore* store, int n, double min, double max,
+        std::vector<FeaturePtr>& features) const;
+
+    /// Returns the value of the given key as a number, or NaN if the
+    /// feature doesn't have the key or its value isn't numeric
+    static double numericValue(FeatureStore* store, FeaturePtr feature, Key key);
+
+private:
+    NumericIndex() : keys_(nullptr),
+        keyCount_(0) {}
+
+    class Builder;
+
+    static constexpr uint32_t MAGIC = 0x4E75'6D49;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint32_t keyCount;
+        uint32_t reserved;
+    };
+
+    /// Offsets are relative to the start of the file
+    struct KeyEntry
+    {
+        int32_t keyCode;        // -1 if not a global string
+        uint32_t nameLength;
+        uint64_t nameOffset;
+        uint64_t tileCount;
+        uint64_t tilesOffset;
+        uint64_t valueCount;
+        uint64_t valuesOffset;
+    };
+
+    /// The range of values of the features in one tile (sorted by TIP)
+    struct TileRange
+    {
+        uint32_t tip;
+        uint32_t count;         // number of features with a value
+        double min;
+        double max;
+    };
+
+    /// A feature's value (sorted by value, then TIP and offset)
+    struct Value
+    {
+        double value;
+        uint32_t tip;
+        uint32_t offset;
+    };
+
+    const uint8_t* data() const { return file_.data(); }
+    const TileRange* tiles(const KeyEntry& key) const
+    {
+        return reinterpret_cast<const TileRange*>(data() + key.tilesOffset);
+    }
+    const Value* values(const KeyEntry& key) const
+    {
+        return reinterpret_cast<const Value*>(data() + key.valuesOffset);
+    }
+
+    SidecarFile file_;
+    const KeyEntry* keys_;
+    uint32_t keyCount_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TileCache.h>
 
 namespace geodesk {
 
@@ -13,11 +14,16 @@ class ParentRelationIterator
 {
 public:
 	ParentRelationIterator(FeatureStore* store, DataPtr pRelTable,
-		const MatcherHolder* matcher, const Filter* filter);
+		const MatcherHolder* matcher, const Filter* filter,
+		TileCache* tiles = nullptr);
 
 	FeatureStore* store() const { return store_; }
 	RelationPtr next();
 
+	/// The cache used to resolve foreign tiles (if none was passed
+	/// to the constructor, each iterator uses its own)
+	TileCache& tiles() { return sharedTiles_ ? *sharedTiles_ : ownTiles_; }
+
 private:
 	FeatureStore* store_;
 	const MatcherHolder* matcher_;
@@ -26,6 +32,8 @@ private:
 	int32_t currentRel_;
 	DataPtr p_;
 	DataPtr pForeignTile_;
+	TileCache* sharedTiles_;
+	TileCache ownTiles_;
 };
 
 // \endcond
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <unordered_set>
 #include <geodesk/feature/FeaturePtr.h>
 
@@ -45,17 +47,29 @@ public:
 	{
 		uint64_t childIdBits = child.idBits();
 		if (childIdBits == parent_) return false;
-		if (childRelations_.find(childIdBits) != childRelations_.end())
+		if (overflow_) return overflow_->insert(childIdBits).second;
+		uint64_t* end = inlineChildren_ + inlineCount_;
+		if (std::find(inlineChildren_, end, childIdBits) != end) return false;
+		if (inlineCount_ < INLINE_CAPACITY)
 		{
-			return false;
+			inlineChildren_[inlineCount_++] = childIdBits;
+			return true;
 		}
-		childRelations_.insert(childIdBits);
+		overflow_ = std::make_unique<std::unordered_set<uint64_t>>(
+			inlineChildren_, end);
+		overflow_->insert(childIdBits);
 		return true;
 	}
 
 private:
+	// Most relations have few (if any) sub-relations, so we only
+	// allocate a hash set if there are more than this many
+	static constexpr int INLINE_CAPACITY = 8;
+
 	uint64_t parent_;
-	std::unordered_set<int64_t> childRelations_;
+	int inlineCount_ = 0;
+	uint64_t inlineChildren_[INLINE_CAPACITY];
+	std::unique_ptr<std::unordered_set<uint64_t>> overflow_;
 };
 
 // \endcond
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TileCache.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A cache of flattened relation trees: for each relation, the nodes
+/// and ways found by walking its members and, recursively, those of its
+/// sub-relations (in the order of a depth-first walk, with foreign
+/// members resolved and placeholders left out). Each sub-relation is
+/// entered once, even if it is reachable via several paths (as with a
+/// RecursionGuard).
+///
+/// Route masters, super-relations and nested multipolygons are then
+/// walked only once, instead of each time their length or centroid is
+/// computed, or their members are tested by a spatial filter.
+///
+/// Only trees with at least `minLeaves` nodes and ways are kept, since
+/// walking a small relation costs little more than a lookup. Like the
+/// MeasureCache, the cache is simply cleared once it is full.
+///
+/// Enabled via FeatureStore::enableRelationTreeCache().
+///
+class GEODESK_API RelationTreeCache
+{
+public:
+    using Leaves = std::vector<FeaturePtr>;
+
+    RelationTreeCache(size_t maxBytes, size_t minLeaves);
+
+    RelationTreeCache(const RelationTreeCache&) = delete;
+    RelationTreeCache& operator=(const RelationTreeCache&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    size_t minLeaves() const { return minLeaves_; }
+    /// The approximate number of bytes occupied by the cached trees
+    size_t bytes();
+
+    /// Returns the flattened tree of the given relation, walking it if
+    /// it isn't cached. Safe to call from any thread.
+    std::shared_ptr<const Leaves> leaves(FeatureStore* store, RelationPtr relation);
+
+    /// Drops all trees if the store has changed since they were walked.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Returns the flattened tree of the given relation from the store's
+    /// cache, or nullptr if the cache isn't enabled (in which case the
+    /// caller should walk the relation itself).
+    static std::shared_ptr<const Leaves> leavesOf(FeatureStore* store, RelationPtr relation);
+
+    /// Appends the nodes and ways of the given relation tree to `leaves`.
+    static void collect(FeatureStore* store, RelationPtr relation, Leaves& leaves);
+
+private:
+    /// The approximate overhead of an entry (map node, vector and
+    /// control block of the shared pointer), not including its leaves
+    static constexpr size_t BYTES_PER_ENTRY = 96;
+
+    static void collect(FeatureStore* store, RelationPtr relation,
+        RecursionGuard& guard, TileCache& tiles, Leaves& leaves);
+
+    size_t maxBytes_;
+    size_t minLeaves_;
+    size_t bytes_;
+    std::mutex mutex_;
+    std::unordered_map<uint64_t, std::shared_ptr<const Leaves>> entries_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
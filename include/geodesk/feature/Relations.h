@@ -16,8 +16,8 @@ public:
 	using FeaturesBase::FeaturesBase;
 	Relations(const FeaturesBase<Feature>& other) :
 		FeaturesBase(View(other.view_& FeatureTypes::RELATIONS)) {}
-	Relations(const FeaturesBase<Node>& other) : FeaturesBase(empty()) {}
-	Relations(const FeaturesBase<Way>& other) : FeaturesBase(empty()) {}
+	Relations(const FeaturesBase<Node>& /* other */) : FeaturesBase(empty()) {}
+	Relations(const FeaturesBase<Way>& /* other */) : FeaturesBase(empty()) {}
 	Relations(const FeaturesBase<Relation>& other) : FeaturesBase(other.view_) {}
 
 	template<typename P>
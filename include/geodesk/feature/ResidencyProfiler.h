@@ -0,0 +1,82 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <chrono>
+#include <clarisma/sys/ProcessCounters.h>
+#include <geodesk/feature/FeatureStore.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Tells whether a query was CPU-bound or waited for tiles to be read
+/// from disk. Create it right before running the query; it checks
+/// which pages of the tiles the query will touch (those intersecting
+/// its bounding box and accepted by its filter) are in memory. finish()
+/// checks again, and reports the page faults and CPU time of the
+/// process in between.
+///
+/// The faults and CPU time are those of the whole process, so they
+/// can only be attributed to the query if nothing else runs at the
+/// same time.
+///
+class ResidencyProfiler
+{
+public:
+    struct Report
+    {
+        uint64_t tiles = 0;
+        uint64_t tileBytes = 0;
+        uint64_t residentBefore = 0;    // bytes of the tiles in memory
+        uint64_t residentAfter = 0;
+        uint64_t majorFaults = 0;       // 0 on Windows
+        uint64_t minorFaults = 0;
+        double cpuSeconds = 0;          // of all threads
+        double wallSeconds = 0;
+
+        /// The bytes of tile data that were read from disk
+        uint64_t bytesLoaded() const
+        {
+            return residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+        }
+    };
+
+    ResidencyProfiler(FeatureStore* store, const Box& box, const Filter* filter = nullptr) :
+        store_(store),
+        box_(box),
+        filter_(filter)
+    {
+        FeatureStore::ResidencyReport residency = store->residency(box, filter);
+        report_.tiles = residency.tileCount;
+        report_.tileBytes = residency.tiles.bytes;
+        report_.residentBefore = residency.tiles.residentBytes;
+        startCounters_ = clarisma::ProcessCounters::current();
+        startTime_ = std::chrono::steady_clock::now();
+    }
+
+    Report finish()
+    {
+        report_.wallSeconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - startTime_).count();
+        clarisma::ProcessCounters used = clarisma::ProcessCounters::current() - startCounters_;
+        report_.cpuSeconds = used.cpuSeconds;
+        report_.majorFaults = used.majorFaults;
+        report_.minorFaults = used.minorFaults;
+        report_.residentAfter = store_->residency(box_, filter_).tiles.residentBytes;
+        return report_;
+    }
+
+private:
+    FeatureStore* store_;
+    Box box_;
+    const Filter* filter_;
+    Report report_;
+    clarisma::ProcessCounters startCounters_;
+    std::chrono::steady_clock::time_point startTime_;
+};
+
+// \endcond
+
+} // namespace geodesk
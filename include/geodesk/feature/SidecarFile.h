@@ -0,0 +1,86 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <clarisma/io/MappedFile.h>
+#include <geodesk/export.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// A memory-mapped file next to a GOL that holds data derived from it
+/// (such as an index). Every sidecar file starts with a Header, which
+/// names the version of the GOL from which it was built (its creation
+/// timestamp and size); a sidecar built from a different version of
+/// the GOL is ignored.
+///
+class GEODESK_API SidecarFile
+{
+public:
+    /// The start of the header of every sidecar file
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+    };
+
+    SidecarFile() = default;
+    ~SidecarFile() { close(); }
+
+    SidecarFile(const SidecarFile&) = delete;
+    SidecarFile& operator=(const SidecarFile&) = delete;
+
+    /// Maps the given file, provided it exists and starts with a header
+    /// of type H whose first fields match `expected`. A file that cannot
+    /// be read is logged (`what` describes its contents).
+    ///
+    /// @return the header, or nullptr if the file is not available
+    template<typename H>
+    const H* open(const std::string& fileName, const Header& expected, const char* what)
+    {
+        return static_cast<const H*>(map(fileName, expected, sizeof(H), what));
+    }
+
+    /// Unmaps and closes the file (which the caller may want to do if
+    /// the rest of its header doesn't check out)
+    void close();
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(mapping_); }
+    uint64_t size() const { return size_; }
+
+    /// Writes a sidecar file: a temporary file, which replaces the
+    /// actual file once commit() is called (so a concurrent reader
+    /// never sees a partial file), or is removed otherwise.
+    ///
+    class GEODESK_API Writer : public clarisma::File
+    {
+    public:
+        explicit Writer(const std::string& fileName);
+        ~Writer();
+
+        void commit();
+
+    private:
+        std::string fileName_;
+        std::string tempFileName_;
+        bool committed_ = false;
+    };
+
+private:
+    const void* map(const std::string& fileName, const Header& expected,
+        size_t headerSize, const char* what);
+
+    clarisma::MappedFile file_;
+    void* mapping_ = nullptr;
+    uint64_t size_ = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
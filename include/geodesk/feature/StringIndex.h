@@ -0,0 +1,93 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <clarisma/data/PerfectHash.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/SidecarFile.h>
+
+namespace geodesk {
+
+class StringTable;
+
+/// \cond lowlevel
+///
+/// A prebuilt lookup index of the global strings of a GOL, kept in an
+/// optional sidecar file next to it (`<gol>.strings`), created by
+/// build(). It holds the offset of each string and a minimal perfect
+/// hash over all strings, so the StringTable can be opened without
+/// scanning the strings, and getCode() takes a single hash and a
+/// single string comparison. The index is only used if it belongs to
+/// the same version of the GOL.
+///
+class GEODESK_API StringIndex
+{
+public:
+    StringIndex(const StringIndex&) = delete;
+    StringIndex& operator=(const StringIndex&) = delete;
+
+    /// Maps the hash table that build() wrote to the given file.
+    ///
+    /// @return the index, or nullptr if not available
+    static std::unique_ptr<StringIndex> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Writes the index of the given string table to the given file.
+    ///
+    /// @return false if no perfect hash could be found for the strings
+    ///   (in which case no file is written)
+    static bool build(const StringTable& strings, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    uint32_t stringCount() const { return stringCount_; }
+
+    /// The offset of each string (relative to the start of the
+    /// string table); entry 0 ("") is unused
+    const uint32_t* relPointers() const { return relPointers_; }
+
+    /// The code of the string that occupies each slot of hash()
+    const uint16_t* slots() const { return slots_; }
+
+    const clarisma::PerfectHash& hash() const { return hash_; }
+
+private:
+    StringIndex() : stringCount_(0),
+        relPointers_(nullptr), slots_(nullptr) {}
+
+    static constexpr uint32_t MAGIC = 0x57A1'1DE5;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint32_t stringCount;
+        uint32_t bucketCount;
+    };
+
+    // The header is followed by the string offsets (stringCount),
+    // the bucket displacements (bucketCount) and the slots
+    // (stringCount - 1, padded to 4 bytes)
+    static uint64_t fileSize(uint32_t stringCount, uint32_t bucketCount)
+    {
+        return sizeof(Header) + (static_cast<uint64_t>(stringCount) +
+            bucketCount) * sizeof(uint32_t) +
+            ((static_cast<uint64_t>(stringCount - 1) * sizeof(uint16_t) + 3) & ~3ULL);
+    }
+
+    SidecarFile file_;
+    uint32_t stringCount_;
+    const uint32_t* relPointers_;
+    const uint16_t* slots_;
+    clarisma::PerfectHash hash_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -6,11 +6,18 @@
 #ifdef GEODESK_PYTHON
 #include <Python.h>
 #endif
+#include <atomic>
+#include <bit>
+#include <mutex>
+#include <string_view>
+#include <clarisma/data/PerfectHash.h>
 #include <clarisma/util/ShortVarString.h>
 #include <geodesk/feature/types.h>
 
 namespace geodesk {
 
+class StringIndex;
+
 /// The Global string Table of a GOL.
 ///
 /// \cond lowlevel
@@ -31,7 +38,13 @@ public:
     using HashCode = size_t;
     #endif
 
-    void create(const uint8_t* pStrings);
+    /// Sets up the table for the strings at `pStrings`. If a matching
+    /// `index` is given, the table uses its string offsets and perfect
+    /// hash (which must stay open for the lifetime of the table) instead
+    /// of hashing every string. (Without an index, the strings are
+    /// hashed by the first call to getCode().)
+    ///
+    void create(const uint8_t* pStrings, const StringIndex* index = nullptr);
 
     #ifdef GEODESK_PYTHON
     /**
@@ -53,10 +66,74 @@ public:
             //  so we won't need this check
             return clarisma::ShortVarString::empty();
         }
-        return reinterpret_cast<const clarisma::ShortVarString*>(stringBase_ + entries_[code].relPointer);
+        return reinterpret_cast<const clarisma::ShortVarString*>(stringBase_ + relPointers_[code]);
     }
     bool isValidCode(int code);
+
+    /// Obtains the numeric value of the global string with the given
+    /// code. Each string is only parsed the first time its value is
+    /// requested. Thread-safe.
+    ///
+    /// @return false if the string is not a number (in which case
+    ///   the result is NaN)
+    ///
+    bool getGlobalNumber(int code, double* pResult) const noexcept
+    {
+        assert(code >= 0 && code < static_cast<int>(stringCount_));
+        uint64_t bits = std::atomic_ref<uint64_t>(numbers_[code])
+            .load(std::memory_order_relaxed);
+        if (bits == 0) [[unlikely]]
+        {
+            bits = parseNumber(&numbers_[code], getGlobalString(code)->toStringView());
+        }
+        double value = std::bit_cast<double>(~bits);
+        *pResult = value;
+        return value == value;
+    }
+
+    /// Returns the address of the cached numeric value of the global
+    /// string with the given code (always 8-byte aligned). A TagValue
+    /// holds on to it so it can use the cache without a reference to
+    /// the table (see cachedNumber()).
+    ///
+    uint64_t* numberSlot(int code) const noexcept
+    {
+        assert(code >= 0 && code < static_cast<int>(stringCount_));
+        return &numbers_[code];
+    }
+
+    /// Returns the numeric value cached in `slot` (NaN if `str` is
+    /// not a number), parsing `str` if it hasn't been parsed yet.
+    ///
+    static double cachedNumber(uint64_t* slot, std::string_view str) noexcept
+    {
+        uint64_t bits = std::atomic_ref<uint64_t>(*slot).load(std::memory_order_relaxed);
+        if (bits == 0) [[unlikely]] bits = parseNumber(slot, str);
+        return std::bit_cast<double>(~bits);
+    }
+
+    /// Checks whether the global string with the given code can be
+    /// written into a JSON string as is (i.e. it has no characters
+    /// that need escaping). Each string is only checked once.
+    /// Thread-safe.
+    ///
+    bool isJsonSafe(int code) const noexcept
+    {
+        assert(code >= 0 && code < static_cast<int>(stringCount_));
+        uint8_t safety = std::atomic_ref<uint8_t>(jsonSafety_[code])
+            .load(std::memory_order_relaxed);
+        if (safety == 0) [[unlikely]] safety = checkJsonSafe(code);
+        return safety == JSON_SAFE;
+    }
+
     int getCode(const char* str, size_t len) const;
+
+    /// Like getCode(), but remembers the codes of the most recently
+    /// looked-up strings by their address (per thread), so code that
+    /// looks up the same key string over and over (a literal, or a
+    /// `std::string` that lives for the duration of a loop) only
+    /// resolves it once.
+    int getKeyCode(const char* str, size_t len) const;
 #ifdef GEODESK_PYTHON
     int getCode(PyObject* strObj) const
     {
@@ -78,24 +155,36 @@ public:
     };
 
 private:
-    struct Entry
-    {
-        uint32_t relPointer;
-        uint32_t next;
-    };
-
     int getCode(size_t hash, const char* str, size_t len) const;
+    void buildChains() const;
+    static uint64_t parseNumber(uint64_t* slot, std::string_view str) noexcept;
+    uint8_t checkJsonSafe(int code) const noexcept;
+
+    static constexpr uint8_t JSON_SAFE = 1;
+    static constexpr uint8_t JSON_UNSAFE = 2;
 
     uint32_t stringCount_;
     uint32_t lookupMask_;
     const uint8_t* stringBase_;
     uint8_t* arena_;
+    const uint32_t* relPointers_;
     uint16_t* buckets_;
-    Entry* entries_;
+    uint16_t* next_;
+        // hash chains (only used if there is no perfect hash)
+    mutable std::once_flag chainsOnce_;
+    const uint16_t* slots_;
+    clarisma::PerfectHash perfectHash_;
+    uint64_t* numbers_;
+        // inverted bits of the numeric value of each string (NaN if
+        // not a number), or 0 if the string has not been parsed yet
+    uint8_t* jsonSafety_;
+        // JSON_SAFE / JSON_UNSAFE for each string, or 0 if not checked yet
     #ifdef GEODESK_PYTHON
     PyObject** stringObjects_;
     #endif
     // beware of alignment!
+
+    friend class StringIndex;
 };
 
 // \endcond
@@ -0,0 +1,83 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cassert>
+#include <string>
+#include <vector>
+#include <geodesk/feature/FeatureBase.h>
+#include <geodesk/feature/TagValue.h>
+
+namespace geodesk {
+
+/// @brief The values of a set of tags for each feature of a
+/// collection, stored column by column (see Features::select()).
+///
+/// Row `i` holds the tags of feature(i); column `k` holds the values
+/// of the `k`-th key passed to select(), with empty strings for
+/// features that don't have that tag. Rows are in no
+/// particular order.
+///
+/// **Warning**: Like a Feature, a TagColumns object refers to data
+/// in its FeatureStore, and becomes invalid once that store is closed.
+///
+class TagColumns
+{
+public:
+    TagColumns() = default;
+
+    /// @brief The number of features (rows)
+    size_t size() const noexcept { return features_.size(); }
+
+    /// @brief `true` if there are no rows
+    bool isEmpty() const noexcept { return features_.empty(); }
+
+    /// @brief The number of keys (columns)
+    size_t columnCount() const noexcept { return keys_.size(); }
+
+    /// @brief The key of the given column
+    const std::string& key(size_t col) const noexcept { return keys_[col]; }
+
+    /// @brief The feature of the given row
+    const Feature& feature(size_t row) const noexcept { return features_[row]; }
+
+    /// @brief All features, in row order
+    const std::vector<Feature>& features() const noexcept { return features_; }
+
+    /// @brief The values of the given column, in row order
+    const std::vector<TagValue>& column(size_t col) const noexcept
+    {
+        return columns_[col];
+    }
+
+    /// @brief The value of a single cell
+    TagValue operator()(size_t row, size_t col) const noexcept
+    {
+        assert(row < size() && col < columnCount());
+        return columns_[col][row];
+    }
+
+    /// @brief A column whose values have been replaced by indexes
+    /// into a dictionary of its distinct values (see encode())
+    struct DictionaryColumn
+    {
+        std::vector<int32_t> indexes;       ///< -1 if the feature lacks the tag
+        std::vector<TagValue> dictionary;   ///< in order of first use
+    };
+
+    /// @brief Dictionary-encodes the given column. Values are compared
+    /// by their text, so a number and the string that spells it share
+    /// a dictionary entry.
+    DictionaryColumn encode(size_t col) const;
+
+private:
+    std::vector<std::string> keys_;
+    std::vector<Feature> features_;
+    std::vector<std::vector<TagValue>> columns_;
+
+    friend class FeatureUtils;
+    friend class TagProjector;
+};
+
+} // namespace geodesk
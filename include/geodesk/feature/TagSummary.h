@@ -0,0 +1,111 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A per-tile Bloom filter over the global-string tags (pairs of global
+/// key and value codes) of each tile's features, which lets a query for
+/// specific tags (such as `na[shop=bicycle]`) skip tiles that cannot
+/// contain any matches, without reading them. The summary is kept in an
+/// optional sidecar file next to the GOL (`<gol>.tags`), created by
+/// build(); it is only used if it belongs to the same version of
+/// the GOL.
+///
+class GEODESK_API TagSummary
+{
+public:
+    TagSummary(const TagSummary&) = delete;
+    TagSummary& operator=(const TagSummary&) = delete;
+
+    /// Maps the per-tile Bloom filters that build() wrote to the given file.
+    ///
+    /// @return the summary, or nullptr if not available
+    static std::unique_ptr<TagSummary> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Scans all tiles of the store and writes their summaries to
+    /// the given file.
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Returns false if the given tile definitely has no feature
+    /// with the tag `key=value` (key and value are global-string codes)
+    bool mayContain(Tip tip, uint32_t key, uint32_t value) const
+    {
+        if (tip >= tileCount_) return true;
+        return mayContain(bits_ + tip * WORDS_PER_TILE, key, value);
+    }
+
+    static bool mayContain(const uint64_t* bits, uint32_t key, uint32_t value)
+    {
+        uint64_t h = hash(key, value);
+        for (int i = 0; i < HASH_COUNT; i++)
+        {
+            uint32_t bit = static_cast<uint32_t>(h >> (64 - (i + 1) * BITS_PER_HASH)) & (BITS_PER_TILE - 1);
+            if ((bits[bit >> 6] & (1ULL << (bit & 63))) == 0) return false;
+        }
+        return true;
+    }
+
+    static void add(uint64_t* bits, uint32_t key, uint32_t value)
+    {
+        uint64_t h = hash(key, value);
+        for (int i = 0; i < HASH_COUNT; i++)
+        {
+            uint32_t bit = static_cast<uint32_t>(h >> (64 - (i + 1) * BITS_PER_HASH)) & (BITS_PER_TILE - 1);
+            bits[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+
+    static constexpr int BITS_PER_HASH = 11;
+    static constexpr int BITS_PER_TILE = 1 << BITS_PER_HASH;
+    static constexpr int WORDS_PER_TILE = BITS_PER_TILE / 64;
+    static constexpr int HASH_COUNT = 3;
+
+private:
+    TagSummary() : bits_(nullptr), tileCount_(0) {}
+
+    static uint64_t hash(uint32_t key, uint32_t value)
+    {
+        return ((static_cast<uint64_t>(key) << 32) | value) * 0x9E37'79B9'7F4A'7C15ULL;
+    }
+
+    static void addTile(DataPtr pTile, uint64_t* bits);
+    static void addFeature(FeaturePtr pFeature, uint64_t* bits);
+
+    static constexpr uint32_t MAGIC = 0x7A65'5E11;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint32_t tileCount;
+        uint32_t bitsPerTile;
+    };
+
+    SidecarFile file_;
+    const uint64_t* bits_;
+    uint32_t tileCount_;
+};
+
+// \endcond
+
+} // namespace geodesk
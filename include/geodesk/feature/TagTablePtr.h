@@ -75,6 +75,7 @@ public:
 	TagBits getKeyValue(Key key) const;
 	TagBits getGlobalKeyValue(int keyCode) const;
 	TagBits getLocalKeyValue(const char* key, size_t len) const;
+	void getKeyValues(const Key* keys, size_t count, TagBits* values) const;
 	bool hasLocalKeys() const
 	{
 		return taggedPtr_.flags();
@@ -112,7 +113,8 @@ public:
 		case 0:	// narrow number
 			return TagValue((rawNarrowValue(value) << 2) | TagValueType::NARROW_NUMBER);
 		case 1:	// global string
-			return TagValue(TagValueType::GLOBAL_STRING, globalString(value, strings));
+			return TagValue(reinterpret_cast<uint64_t>(strings.numberSlot(rawNarrowValue(value)))
+				| TagValueType::GLOBAL_STRING, globalString(value, strings));
 		case 2: // wide number
 		{
 			DataPtr pValue = valuePtr(value);
@@ -195,7 +197,11 @@ private:
 
 	friend class TagIterator;
 	friend class ::PyTagIterator;
+	friend class ArrowExport;
+	friend class CsvWriter;
 	friend class FeatureWriter;
+	friend class FlatGeobufWriter;
+	friend class MvtTileBuilder;
 };
 
 // \endcond
@@ -6,6 +6,7 @@
 #include <clarisma/text/Format.h>
 #include <clarisma/compile/unreachable.h>
 #include <clarisma/math/Math.h>
+#include <geodesk/feature/StringTable.h>
 #include <geodesk/feature/StringValue.h>
 #include <geodesk/feature/TagValues.h>
 
@@ -70,7 +71,13 @@ public:
         switch (type())
         {
         case 1:     // global string
-        case 3:     // local string (fall through)
+            if (taggedNumberValue_ != 1)
+            {
+                return StringTable::cachedNumber(
+                    reinterpret_cast<uint64_t*>(taggedNumberValue_ ^ 1), stringValue_);
+            }
+            [[fallthrough]];
+        case 3:     // local string
             clarisma::Math::parseDouble(stringValue_, &val);
             return val;
         case 0:     // narrow number
@@ -242,6 +249,31 @@ public:
         return static_cast<int>(*this) >= val;
     }
 
+    /// @brief Returns the value as text, without allocating: strings
+    /// are returned as they are stored, and numbers are formatted into
+    /// `buf` (which must have room for 32 characters).
+    ///
+    std::string_view toStringView(char* buf) const noexcept
+    {
+        char* end;
+        switch (type())
+        {
+        case 1:     // global string
+        case 3:     // local string (fall through)
+            return stringValue_;
+        case 0:     // narrow number
+            end = clarisma::Format::integer(buf,
+                TagValues::intFromNarrowNumber(rawNumberValue()));
+            return std::string_view(buf, end-buf);
+        case 2:     // wide number
+            end = TagValues::decimalFromWideNumber(rawNumberValue()).format(buf);
+            return std::string_view(buf, end-buf);
+        default:
+            UNREACHABLE_CASE
+        }
+        return {};  // suppress warning
+    }
+
 private:
     int type() const { return taggedNumberValue_ & 3; }
     uint_fast32_t rawNumberValue() const
@@ -250,10 +282,14 @@ private:
     }
 
     uint64_t taggedNumberValue_;
+        // For a global string, the bits above the type may hold the
+        // address of its slot in the StringTable's cache of numeric
+        // values (see StringTable::numberSlot())
     StringValue stringValue_;
 
     template<typename Stream>
     friend Stream& operator<<(Stream& out, const TagValue& v);
+    friend class TagGrouper;
 };
 
 template<typename Stream>
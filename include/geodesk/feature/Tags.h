@@ -4,6 +4,8 @@
 #pragma once
 
 #include <map>
+#include <span>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <geodesk/feature/forward.h>
@@ -11,6 +13,10 @@
 #include <geodesk/feature/TagIterator.h>
 #include <geodesk/feature/Tag.h>
 
+namespace clarisma {
+class Arena;
+}
+
 namespace geodesk {
 
 /// @brief An object describing the key/value attributes
@@ -200,6 +206,18 @@ public:
         return map;
     }
 
+    /// @brief Places the key/value pairs into the given Arena, as
+    /// views of their text (in storage order). Only numeric values
+    /// are copied (formatted as text); the keys and string values
+    /// point directly into the FeatureStore. To materialize the tags
+    /// of many features, use one Arena and clear it after each batch.
+    ///
+    /// The views remain valid until the Arena is cleared (and as
+    /// long as the FeatureStore is open).
+    ///
+    std::span<const std::pair<std::string_view, std::string_view>>
+        toViews(clarisma::Arena& arena) const;
+
     /// @brief Creates a vector containing the key/value pairs
     ///
     /// @param T  Tag or `std::pair<K,V>` (where `K` can be
@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Remembers the tiles of the last few TIPs resolved by the iterators
+/// over members and parent relations. The members of a large relation
+/// tend to alternate between a handful of tiles, so this saves most of
+/// the tile-index lookups (and touching their pages). Code that walks
+/// a relation tree (such as the geometry builders) can pass one cache
+/// to all of its iterators. Not thread-safe.
+///
+class TileCache
+{
+public:
+    TileCache() : count_(0) {}
+
+    clarisma::DataPtr get(FeatureStore* store, Tip tip)
+    {
+        for (int i = 0; i < count_; i++)
+        {
+            if (tips_[i] == tip)
+            {
+                clarisma::DataPtr pTile = tiles_[i];
+                moveToFront(i, tip, pTile);
+                return pTile;
+            }
+        }
+        return fetch(store, tip);
+    }
+
+    static constexpr int SIZE = 4;
+
+private:
+    clarisma::DataPtr fetch(FeatureStore* store, Tip tip);
+
+    // Shifts the entries before `i` back by one (dropping entry `i`),
+    // and places the given tile at the front
+    void moveToFront(int i, Tip tip, clarisma::DataPtr pTile)
+    {
+        for (; i > 0; i--)
+        {
+            tips_[i] = tips_[i - 1];
+            tiles_[i] = tiles_[i - 1];
+        }
+        tips_[0] = tip;
+        tiles_[0] = pTile;
+    }
+
+    int count_;
+    Tip tips_[SIZE];
+    clarisma::DataPtr tiles_[SIZE];
+};
+
+// \endcond
+
+} // namespace geodesk
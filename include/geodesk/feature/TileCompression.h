@@ -0,0 +1,94 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/export.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Compression of individual tiles. A compressed tile is a blob whose
+/// header word has COMPRESSED_FLAG set (its size bits hold the size of
+/// the compressed payload); the payload starts with the size of the
+/// uncompressed blob (including its header), followed by a zlib stream
+/// of the uncompressed blob. Everything else in the GOL (header, tile
+/// index, string table) stays uncompressed, so the tile walk of a
+/// query never has to decompress anything.
+///
+/// Tiles may be compressed with a preset dictionary (built from
+/// samples of typical tiles by buildDictionary()), which makes the
+/// compression of small tiles far more effective. The dictionary is
+/// kept in a sidecar file next to the GOL (`<gol>.zdict`); a store
+/// whose tiles need a dictionary can't be read without it.
+///
+/// FeatureStore::fetchTile() decompresses tiles transparently, using
+/// its TileReader (see FeatureStore::enableTileReader()).
+///
+/// Only available if built with zlib (GEODESK_WITH_ZLIB), except for
+/// the flag test.
+///
+class GEODESK_API TileCompression
+{
+public:
+    static constexpr uint32_t COMPRESSED_FLAG = 0x4000'0000;
+    static constexpr uint32_t PAYLOAD_SIZE_MASK = 0x3fff'ffff;
+
+    static bool isCompressed(clarisma::DataPtr pBlob)
+    {
+        return pBlob.getUnsignedInt() & COMPRESSED_FLAG;
+    }
+
+    /// The size of the decompressed blob (including its header)
+    static uint32_t uncompressedSize(const uint8_t* pBlob)
+    {
+        return clarisma::DataPtr(pBlob + 4).getUnsignedInt();
+    }
+
+#ifdef GEODESK_WITH_ZLIB
+    explicit TileCompression(std::vector<uint8_t> dictionary = {});
+
+    /// Reads the dictionary from the given sidecar file.
+    ///
+    /// @return the TileCompression (without a dictionary if the
+    ///   file doesn't exist)
+    static std::unique_ptr<TileCompression> open(const std::string& fileName);
+
+    /// Writes the dictionary to the given sidecar file
+    void save(const std::string& fileName) const;
+
+    /// Builds a dictionary of up to `maxSize` bytes from samples of
+    /// the tiles of the given store (zlib only looks back 32 KB, so
+    /// there's no point in a larger dictionary)
+    static std::vector<uint8_t> buildDictionary(FeatureStore* store,
+        size_t maxSize = 32 * 1024);
+
+    const std::vector<uint8_t>& dictionary() const { return dictionary_; }
+
+    /// Compresses the given tile blob (header and payload).
+    ///
+    /// @return the compressed blob (header and payload)
+    std::vector<uint8_t> compress(const uint8_t* pBlob, int level = 9) const;
+
+    /// Decompresses the given compressed blob into `dest`, which must
+    /// have room for uncompressedSize() bytes. Throws an IOException
+    /// if the blob is corrupt, or requires a dictionary other than
+    /// ours.
+    void decompress(const uint8_t* pBlob, uint8_t* dest) const;
+
+private:
+    std::vector<uint8_t> dictionary_;
+#endif
+};
+
+// \endcond
+
+} // namespace geodesk
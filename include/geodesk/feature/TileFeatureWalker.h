@@ -0,0 +1,124 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/types.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Visits the features in the spatial indexes of a tile, in the
+/// same order as a TileQueryTask (nodes, ways, areas, relations).
+///
+/// Features that live in multiple tiles are stored in each of them;
+/// only the first copy (the one in the tile that contains the
+/// feature's top-left corner) has neither MULTITILE_WEST nor
+/// MULTITILE_NORTH set. Visitors that need each feature once should
+/// use forEachFirstCopy().
+///
+class TileFeatureWalker
+{
+public:
+    static bool isFirstCopy(FeaturePtr pFeature)
+    {
+        return (pFeature.flags() &
+            (FeatureFlags::MULTITILE_WEST | FeatureFlags::MULTITILE_NORTH)) == 0;
+    }
+
+    /// Calls `fn(FeaturePtr, FeatureIndexType)` for every feature
+    /// in the tile (including the copies of features that live in
+    /// multiple tiles)
+    template<typename Fn>
+    static void forEachFeature(DataPtr pTile, Fn&& fn)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            FeatureIndexType index = static_cast<FeatureIndexType>(i);
+            forEachRoot(pTile, index, [index, &fn](DataPtr ppRoot, uint32_t, bool)
+            {
+                forEachRecord(ppRoot, index == FeatureIndexType::NODES,
+                    [index, &fn](DataPtr, FeaturePtr pFeature)
+                    {
+                        fn(pFeature, index);
+                    });
+            });
+        }
+    }
+
+    /// Like forEachFeature(), but skips the copies of features
+    /// whose first copy lives in another tile
+    template<typename Fn>
+    static void forEachFirstCopy(DataPtr pTile, Fn&& fn)
+    {
+        forEachFeature(pTile, [&fn](FeaturePtr pFeature, FeatureIndexType index)
+        {
+            if (isFirstCopy(pFeature)) fn(pFeature, index);
+        });
+    }
+
+    /// Calls `fn(DataPtr ppRoot, uint32_t keys, bool hasKeys)` for each
+    /// root of the given index. An index whose features have been
+    /// sorted by key category has one root per group of categories
+    /// (`keys`); each feature lives under exactly one of them.
+    /// An index without categories has a single root (for which
+    /// `hasKeys` is false).
+    template<typename Fn>
+    static void forEachRoot(DataPtr pTile, FeatureIndexType index, Fn&& fn)
+    {
+        DataPtr ppRoot = pTile + 8 + index * 4;
+        int32_t ptr = ppRoot.getInt();
+        if (ptr == 0) return;
+        if ((ptr & 1) == 0)
+        {
+            fn(ppRoot, 0, false);
+            return;
+        }
+        DataPtr p = ppRoot + (ptr ^ 1);
+        for (;;)
+        {
+            int32_t last = p.getInt() & 1;
+            fn(p, static_cast<uint32_t>((p+4).getInt()), true);
+            if (last != 0) break;
+            p += 8;
+        }
+    }
+
+    /// Calls `fn(DataPtr pRecord, FeaturePtr)` for each feature below
+    /// the given index entry (a root pointer or a branch entry).
+    /// `pRecord` points to the feature's bounds (its coordinates,
+    /// in the case of a node).
+    template<typename Fn>
+    static void forEachRecord(DataPtr pEntry, bool isNodeIndex, Fn&& fn)
+    {
+        int32_t ptr = pEntry.getInt();
+        if (ptr == 0) return;
+        DataPtr p = pEntry + (ptr & 0xffff'fffc);
+        if ((ptr & 2) == 0)
+        {
+            for (;;)
+            {
+                forEachRecord(p, isNodeIndex, fn);     // NOLINT recursion
+                if (p.getInt() & 1) break;
+                p += 20;
+            }
+            return;
+        }
+        for (;;)
+        {
+            FeaturePtr pFeature(p + (isNodeIndex ? 8 : 16));
+            fn(p, pFeature);
+            int32_t flags = pFeature.flags();
+            if (flags & 1) break;
+            p += isNodeIndex ? (20 + (flags & 4)) : 32;
+        }
+    }
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Reads tiles from the file of a FeatureStore into memory of its
+/// own (using positional reads, rather than the store's memory
+/// mapping), and keeps them in a cache of bounded size. This makes the
+/// memory used for tiles explicit (which matters in containers with
+/// tight memory limits, where the pages of a mapped file compete
+/// with the heap), and turns page faults into reads that are issued
+/// before a tile is scanned.
+///
+/// A tile stays in memory as long as it is pinned (even if this
+/// means the cache exceeds its size limit); tiles that are no longer
+/// pinned are evicted in least-recently-used order. Compressed tiles
+/// (see TileCompression) are decompressed as they are read, and
+/// cached in decompressed form. Thread-safe.
+///
+/// Only queries with a TileReducer read their tiles through the
+/// TileReader of their store (see FeatureStore::enableTileReader()),
+/// since the features they pass to the reducer are not used after
+/// the tile's scan. Features that are returned by Query::next() keep
+/// their tile pinned until the Query is destroyed.
+///
+class TileReader
+{
+    struct Entry;
+
+public:
+    TileReader(FeatureStore* store, size_t maxBytes);
+    ~TileReader();
+
+    /// Keeps a tile in memory while it exists
+    class Pin
+    {
+    public:
+        Pin() : reader_(nullptr), entry_(nullptr) {}
+        Pin(const Pin&) = delete;
+        Pin(Pin&& other) noexcept :
+            reader_(other.reader_),
+            entry_(other.entry_)
+        {
+            other.entry_ = nullptr;
+        }
+        ~Pin() { release(); }
+
+        Pin& operator=(const Pin&) = delete;
+        Pin& operator=(Pin&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                reader_ = other.reader_;
+                entry_ = other.entry_;
+                other.entry_ = nullptr;
+            }
+            return *this;
+        }
+
+        explicit operator bool() const noexcept { return entry_ != nullptr; }
+        clarisma::DataPtr data() const noexcept;
+        void release() noexcept;
+
+    private:
+        Pin(TileReader* reader, Entry* entry) :
+            reader_(reader), entry_(entry) {}
+
+        TileReader* reader_;
+        Entry* entry_;
+
+        friend class TileReader;
+    };
+
+    /// Returns the given tile, reading it if it isn't in the cache
+    Pin pin(Tip tip);
+
+    size_t maxBytes() const { return maxBytes_; }
+    /// The number of bytes occupied by the cached tiles
+    size_t bytesCached();
+    /// The number of tiles that have been read (rather than found
+    /// in the cache)
+    uint64_t tilesRead();
+
+private:
+    struct Entry
+    {
+        Tip tip;
+        uint32_t pinCount;
+        size_t size;
+        std::unique_ptr<uint8_t[]> data;
+        Entry* prev;        // (only for entries that aren't pinned:
+        Entry* next;        //  the LRU list, most recent first)
+    };
+
+    void read(uint64_t ofs, uint8_t* buf, size_t size);
+    void unpin(Entry* entry) noexcept;
+    void unlink(Entry* entry) noexcept;
+    void evictUnpinned() noexcept;
+
+    FeatureStore* store_;
+    size_t maxBytes_;
+    std::mutex mutex_;
+    std::unordered_map<uint32_t, std::unique_ptr<Entry>> entries_;
+    Entry* head_ = nullptr;     // most recently used unpinned tile
+    Entry* tail_ = nullptr;     // least recently used unpinned tile
+    size_t bytesCached_ = 0;
+    uint64_t tilesRead_ = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
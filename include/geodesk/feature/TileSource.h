@@ -0,0 +1,39 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <clarisma/alloc/Block.h>
+#include <geodesk/feature/Tip.h>
+
+// \cond
+
+namespace geodesk::v2 {
+
+/// Supplies the tiles that are missing from a FeatureStore (or whose
+/// copy in the store is stale), e.g. by issuing range requests to a
+/// tile server. This lets a store start out empty and fill itself in
+/// as queries touch its tiles (see FeatureStore::setTileSource()).
+///
+/// The transport is up to the implementation (e.g. an HTTP/2 client
+/// that multiplexes its requests over a single connection). The store
+/// limits how many tiles are fetched at the same time, and never
+/// fetches the same tile twice concurrently, but fetchTile() must be
+/// safe to call from multiple threads.
+///
+class TileSource
+{
+public:
+    virtual ~TileSource() = default;
+
+    /// Returns the data of the given tile (in the form that
+    /// FeatureStore::Transaction::addTile() expects). Throws an
+    /// exception if the tile can't be fetched; the query that needed
+    /// the tile fails with this exception.
+    ///
+    virtual clarisma::ByteBlock fetchTile(Tip tip) = 0;
+};
+
+} // namespace geodesk::v2
+
+// \endcond
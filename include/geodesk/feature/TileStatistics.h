@@ -0,0 +1,160 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// Per-tile feature counts, which answer questions like "how many
+/// buildings are there in this region?" without scanning any tiles.
+/// The statistics are kept in an optional sidecar file next to the GOL
+/// (`<gol>.stats`), created by build(); they are only used if they
+/// belong to the same version of the GOL.
+///
+/// A feature that lives in multiple tiles is counted only once, in
+/// the tile that holds its north-western-most copy (the one without
+/// multi-tile flags). For each tile, the statistics hold:
+///
+/// - the number of features in each of the four spatial indexes
+/// - the number of features with a key in each index category
+/// - the number of features with each of the POPULAR_KEYS most common
+///   global keys (global-string codes below POPULAR_KEYS)
+/// - a histogram of the bounding-box sizes of ways and relations
+/// - for each index, the categories of all its features (including
+///   copies), which lets a query skip tiles that cannot contain
+///   any matches
+///
+class GEODESK_API TileStatistics
+{
+public:
+    static constexpr int POPULAR_KEYS = 64;
+    static constexpr int CATEGORIES = 32;
+    /// Size class `n` holds the features whose bounding box is less than
+    /// 2^(n+8) imps on its longer side (the last class holds all larger
+    /// features)
+    static constexpr int SIZE_CLASSES = 16;
+
+    struct TileCounts
+    {
+        uint32_t features[4];           // by FeatureIndexType
+        uint32_t categoryMasks[4];      // IndexBits of all features, by FeatureIndexType
+        uint32_t categories[CATEGORIES];    // [0] = category 1
+        uint32_t keys[POPULAR_KEYS];
+        uint32_t sizes[SIZE_CLASSES];
+    };
+
+    /// The counts of the tiles that intersect a bounding box. Each
+    /// tile's counts are scaled by the share of its area that lies
+    /// within the box, so the totals are exact only for boxes that
+    /// cover their tiles in full (see `exact`).
+    struct Totals
+    {
+        double features[4] = {};
+        double categories[CATEGORIES] = {};
+        double keys[POPULAR_KEYS] = {};
+        double sizes[SIZE_CLASSES] = {};
+        bool exact = true;
+
+        /// The number of features of the given types (counting a whole
+        /// index if the types include only some of its features)
+        double count(FeatureTypes types) const;
+    };
+
+
+    TileStatistics(const TileStatistics&) = delete;
+    TileStatistics& operator=(const TileStatistics&) = delete;
+
+    /// Maps the per-tile feature counts that build() wrote to the given file.
+    ///
+    /// @return the statistics, or nullptr if not available
+    static std::unique_ptr<TileStatistics> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Scans all tiles of the store (on multiple threads) and writes
+    /// their statistics to the given file.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   store's query executor)
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize, int threads = 0);
+
+    /// Returns the counts of the given tile, or nullptr if
+    /// the statistics don't cover it
+    const TileCounts* tile(Tip tip) const
+    {
+        return tip < tileCount_ ? &tiles_[tip] : nullptr;
+    }
+
+    /// Adds up the counts of the tiles that intersect `box`
+    Totals sum(FeatureStore* store, const Box& box) const;
+
+    /// Returns the exact number of features of the given types in the
+    /// entire store, or nothing if `types` includes only some of the
+    /// features in one of the indexes (e.g. areas that are ways, but
+    /// not areas that are relations)
+    std::optional<uint64_t> count(FeatureTypes types) const;
+
+    /// Determines, for each index, the categories that every feature
+    /// of the given types accepted by `matcher` must have at least one
+    /// of (0 for indexes that hold no features of these types).
+    ///
+    /// @return false if the matcher may accept features that have
+    ///   none of the categories (so no tile can be ruled out)
+    static bool requiredCategories(const MatcherHolder* matcher,
+        FeatureTypes types, uint32_t required[4]);
+
+    /// Returns false if the given tile definitely has no feature with
+    /// a key in any of the required categories (see requiredCategories())
+    bool mayMatchTile(Tip tip, const uint32_t required[4]) const
+    {
+        if (tip >= tileCount_) return true;
+        const uint32_t* masks = tiles_[tip].categoryMasks;
+        return ((masks[0] & required[0]) | (masks[1] & required[1]) |
+            (masks[2] & required[2]) | (masks[3] & required[3])) != 0;
+    }
+
+private:
+    TileStatistics() : tiles_(nullptr),
+        tileCount_(0), totals_{} {}
+
+    class Builder;
+
+    static constexpr uint32_t MAGIC = 0x57A7'5CA7;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint32_t tileCount;
+        uint32_t bytesPerTile;
+        uint64_t totals[4];     // features per index, in all tiles
+    };
+
+    SidecarFile file_;
+    const TileCounts* tiles_;
+    uint32_t tileCount_;
+    uint64_t totals_[4];
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <utility>
 #include <geodesk/filter/ComboFilter.h>
 #include <geodesk/feature/QueryException.h>
 #include <geodesk/feature/FeatureStore.h>
@@ -63,7 +64,7 @@ public:
 
     explicit View(FeatureStore* store) :
         view_(EMPTY), flags_(0), types_(0), store_(store),
-        matcher_(store->getAllMatcher()), filter_(nullptr)
+        matcher_(store->getAllMatcher()), filter_(nullptr), context_()
     {
         store->addref();
         // TODO: this differs from other cons that steal the ref
@@ -122,12 +123,27 @@ public:
         //fflush(stdout);
     }
 
+    /// Takes over the references of `other`, which may only be
+    /// destroyed or assigned to afterwards (Fluent chains create
+    /// many temporary views; moving them avoids an addref/release
+    /// pair for each reference, which is costly if refcounts are
+    /// atomic).
+    View(View&& other) noexcept :
+        view_(other.view_), flags_(other.flags_), types_(other.types_),
+        store_(other.store_), matcher_(other.matcher_),
+        filter_(other.filter_), context_(other.context_)
+    {
+        other.store_ = nullptr;
+        other.matcher_ = nullptr;
+        other.filter_ = nullptr;
+    }
+
     ~View()
     {
         //printf("Destroying view, store refcount before = %llu\n", store_->refcount());
         //fflush(stdout);
-        store_->release();
-        matcher_->release();
+        if (store_) store_->release();      // null if moved from
+        if (matcher_) matcher_->release();
         if (filter_) filter_->release();
     }
 
@@ -140,14 +156,14 @@ public:
         types_ = other.types_;
         if(store_ != other.store_)
         {
-            store_->release();
+            if(store_) store_->release();
             other.store_->addref();
             store_ = other.store_;
         }
         context_ = other.context_;
         if(matcher_ != other.matcher_)
         {
-            matcher_->release();
+            if(matcher_) matcher_->release();
             other.matcher_->addref();
             matcher_ = other.matcher_;
         }
@@ -162,6 +178,20 @@ public:
         return *this; // Return the current object
     }
 
+    View& operator=(View&& other) noexcept
+    {
+        // The old references of this view are released
+        // once `other` is destroyed
+        std::swap(view_, other.view_);
+        std::swap(flags_, other.flags_);
+        std::swap(types_, other.types_);
+        std::swap(store_, other.store_);
+        std::swap(context_, other.context_);
+        std::swap(matcher_, other.matcher_);
+        std::swap(filter_, other.filter_);
+        return *this;
+    }
+
     static View related(int view, FeatureTypes types, FeatureStore* store, FeaturePtr ptr, const char* query)
     {
         const MatcherHolder* matcher;
@@ -372,35 +402,31 @@ public:
     View withQuery(const char* query, FeatureTypes newTypes = FeatureTypes::ALL) const
     {
         // TODO: Turn ParseException into QueryException
-        //try
-        //{
-            const MatcherHolder* newMatcher = store_->getMatcher(query);
-            newTypes &= types_ & newMatcher->acceptedTypes();
-            if (newTypes == 0)
-            {
-                newMatcher->release();
-                return empty();
-            }
-            if (flags_ & USES_MATCHER)
-            {
-                matcher_->addref();
-                newMatcher = MatcherHolder::combine(matcher_, newMatcher);
-                // combine() steals references
-            }
+        return withMatcher(store_->getMatcher(query), newTypes);
+    }
 
-            if (filter_) filter_->addref();     
-            store_->addref();
-            return View(view_, flags_ | USES_MATCHER, newTypes, store_,
-                context_, newMatcher, filter_);
-        // }
-        /*
-        catch (const ParseException& ex)
+    /// Narrows this view to features accepted by the given matcher,
+    /// whose reference is stolen (see CompiledQuery::bind())
+    View withMatcher(const MatcherHolder* newMatcher,
+        FeatureTypes newTypes = FeatureTypes::ALL) const
+    {
+        newTypes &= types_ & newMatcher->acceptedTypes();
+        if (newTypes == 0)
+        {
+            newMatcher->release();
+            return empty();
+        }
+        if (flags_ & USES_MATCHER)
         {
-            // Environment::get().raiseQueryException("Bad query: %s", ex.what());
-            Environment::get().raiseQueryException(ex.what());
-            return NULL;
+            matcher_->addref();
+            newMatcher = store_->combineMatchers(matcher_, newMatcher);
+            // combineMatchers() steals references
         }
-        */
+
+        if (filter_) filter_->addref();     
+        store_->addref();
+        return View(view_, flags_ | USES_MATCHER, newTypes, store_,
+            context_, newMatcher, filter_);
     }
 
     View withFilter(const Filter* newFilter) const
@@ -516,6 +542,8 @@ private:
     const MatcherHolder* matcher_;
     const Filter* filter_;
     Context context_;
+
+    friend class SetFilter;
 };
 
 // \endcond lowlevel
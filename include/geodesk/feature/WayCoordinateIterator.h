@@ -25,6 +25,24 @@ public:
     void start(FeaturePtr way, int flags);
     Coordinate next();
 
+    /// Places up to `maxCount` of the next coordinates into `out`
+    /// (decoding them in bulk, which is considerably faster than
+    /// calling next() for each), and returns the number of coordinates
+    /// placed, or 0 once there are no more. Can be mixed with next().
+    ///
+    int decode(Coordinate* out, int maxCount);
+
+    /// A good size for a buffer that is filled by decode()
+    static constexpr int BATCH_SIZE = 64;
+
+    /// Places all remaining coordinates into `out`, which must have
+    /// room for coordinatesRemaining() entries, and returns their number.
+    ///
+    int decodeAll(Coordinate* out)
+    {
+        return decode(out, coordinatesRemaining());
+    }
+
     // does not include any duplicated last coordinate
     int storedCoordinatesRemaining() const { return remaining_; }
     // This one includes any duplicate last coordinate for areas, based on flags:
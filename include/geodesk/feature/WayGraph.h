@@ -0,0 +1,78 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// @brief The network formed by a collection of ways, in compressed
+/// sparse row (CSR) form (see Features::graph()).
+///
+/// The vertices are the end points of the ways, and the nodes that
+/// are shared by two or more ways (or visited twice by the same way).
+/// Each stretch of a way between two vertices is an edge, which is
+/// stored twice (once in each direction). The edges that leave vertex
+/// `v` are those from edgesStart(v) to edgesEnd(v).
+///
+class WayGraph
+{
+public:
+    WayGraph() : offsets_(1, 0) {}
+
+    /// @brief The number of vertices
+    size_t vertexCount() const noexcept { return coords_.size(); }
+
+    /// @brief The number of (directed) edges -- twice the
+    /// number of way segments between vertices
+    size_t edgeCount() const noexcept { return targets_.size(); }
+
+    /// @brief The location of a vertex
+    Coordinate vertex(size_t v) const noexcept { return coords_[v]; }
+
+    /// @brief The index of the first edge leaving vertex `v`
+    uint32_t edgesStart(size_t v) const noexcept { return offsets_[v]; }
+
+    /// @brief The index past the last edge leaving vertex `v`
+    uint32_t edgesEnd(size_t v) const noexcept { return offsets_[v + 1]; }
+
+    /// @brief The vertex reached by an edge
+    uint32_t target(size_t edge) const noexcept { return targets_[edge]; }
+
+    /// @brief The ID of the way an edge belongs to
+    uint64_t way(size_t edge) const noexcept { return ways_[edge]; }
+
+    /// @brief The length of an edge (in meters)
+    double length(size_t edge) const noexcept { return lengths_[edge]; }
+
+    /// @brief The coordinates of all vertices
+    std::span<const Coordinate> vertices() const noexcept { return coords_; }
+
+    /// @brief The start of the edges of each vertex, followed by the
+    /// total number of edges (vertexCount() + 1 entries)
+    std::span<const uint32_t> offsets() const noexcept { return offsets_; }
+
+    /// @brief The target vertex of each edge
+    std::span<const uint32_t> targets() const noexcept { return targets_; }
+
+    /// @brief The way ID of each edge
+    std::span<const uint64_t> ways() const noexcept { return ways_; }
+
+    /// @brief The length of each edge (in meters)
+    std::span<const double> lengths() const noexcept { return lengths_; }
+
+private:
+    std::vector<Coordinate> coords_;
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> targets_;
+    std::vector<uint64_t> ways_;
+    std::vector<double> lengths_;
+
+    friend class WayGraphBuilder;
+};
+
+} // namespace geodesk
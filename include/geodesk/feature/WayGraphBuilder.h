@@ -0,0 +1,74 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/WayGraph.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Assembles a WayGraph from ways that are gathered by multiple
+/// threads. Each thread takes a Batch from the pool, adds the
+/// coordinates of its ways (and the running distance along each way,
+/// which is the costly part), and returns the batch. build() then
+/// stitches the ways together at the nodes they share: since a way
+/// is always stored with all of its nodes (even if it crosses tile
+/// boundaries), shared locations are found by coordinate, regardless
+/// of which tile (or thread) produced each way.
+///
+class GEODESK_API WayGraphBuilder
+{
+public:
+    class Batch
+    {
+    public:
+        void addWay(uint64_t id, const Coordinate* coords, size_t count);
+
+    private:
+        std::vector<uint64_t> ids_;
+        std::vector<uint32_t> ends_;        // end of the nodes of each way
+        std::vector<Coordinate> coords_;
+        std::vector<double> distances_;     // meters from start of way
+
+        friend class WayGraphBuilder;
+    };
+
+    /// Thread-safe
+    Batch* acquire();
+
+    /// Thread-safe
+    void release(Batch* batch);
+
+    /// Must be called once all batches have been released
+    WayGraph build();
+
+private:
+    struct Edge
+    {
+        uint32_t from;
+        uint32_t to;
+        uint64_t way;
+        double length;
+    };
+
+    static uint64_t key(Coordinate c)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) |
+            static_cast<uint32_t>(c.y);
+    }
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Batch>> batches_;
+    std::vector<Batch*> idle_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,123 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/data/FlatHashSet.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A reverse index of the nodes of ways, which lets the parent ways of
+/// an anonymous node be found with a hash probe per candidate way
+/// (instead of decoding the coordinates of every way whose bounding
+/// box contains the node). The index of a tile is built the first time
+/// one of its ways is checked, and is kept in memory until evicted
+/// (least recently used first) to stay within a budget of bytes.
+///
+/// Enabled via FeatureStore::enableWayNodeIndex().
+///
+class GEODESK_API WayNodeIndex
+{
+public:
+    /// The coordinates of all ways in a single tile
+    class TileIndex
+    {
+    public:
+        explicit TileIndex(DataPtr pTile);
+
+        DataPtr tile() const { return pTile_; }
+        size_t bytes() const { return slots_.size() * sizeof(Slot); }
+
+        /// Returns true if the way (which must belong to this
+        /// tile) has a node at the given coordinate
+        bool contains(FeaturePtr way, Coordinate xy) const
+        {
+            uint32_t ofs = static_cast<uint32_t>(way.ptr() - pTile_);
+            for (size_t i = hash(xy, ofs) & mask_; ; i = (i + 1) & mask_)
+            {
+                const Slot& slot = slots_[i];
+                if (slot.way == ofs && slot.x == xy.x && slot.y == xy.y) return true;
+                if (slot.way == 0) return false;
+            }
+        }
+
+    private:
+        struct Slot
+        {
+            int32_t x;
+            int32_t y;
+            uint32_t way;       // offset of the way in the tile (0 = empty)
+        };
+
+        static size_t hash(Coordinate xy, uint32_t ofs)
+        {
+            uint64_t h = (static_cast<uint64_t>(static_cast<uint32_t>(xy.x)) << 32) |
+                static_cast<uint32_t>(xy.y);
+            h = (h ^ ofs) * 0x9E37'79B9'7F4A'7C15ULL;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+
+        void addIndex(DataPtr ppRoot, std::vector<Slot>& entries);
+        void addBranch(DataPtr pEntry, std::vector<Slot>& entries);
+        void addWay(FeaturePtr way, std::vector<Slot>& entries);
+        void insert(const Slot& entry);
+
+        DataPtr pTile_;
+        size_t mask_;
+        std::vector<Slot> slots_;
+    };
+
+    using TileIndexRef = std::shared_ptr<const TileIndex>;
+
+    explicit WayNodeIndex(size_t maxBytes);
+
+    WayNodeIndex(const WayNodeIndex&) = delete;
+    WayNodeIndex& operator=(const WayNodeIndex&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    /// The number of bytes occupied by the tile indexes
+    size_t bytes();
+
+    /// Returns the index of the given tile, building it if necessary,
+    /// or nullptr if it would not fit within the budget.
+    /// Safe to call from any thread.
+    TileIndexRef get(FeatureStore* store, Tip tip);
+
+    /// Drops all tile indexes if the store has changed since they
+    /// were built.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+private:
+    struct Entry
+    {
+        Tip tip;
+        TileIndexRef index;
+    };
+
+    size_t maxBytes_;
+    std::mutex mutex_;
+    std::list<Entry> entries_;          // most recently used first
+    std::unordered_map<uint32_t, std::list<Entry>::iterator> tips_;
+    clarisma::FlatHashSet<uint32_t> tooLarge_;  // TIPs of tiles never indexed
+    size_t bytes_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
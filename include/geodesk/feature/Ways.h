@@ -16,9 +16,9 @@ public:
 	using FeaturesBase::FeaturesBase;
 	Ways(const FeaturesBase<Feature>& other) :
 		FeaturesBase(View(other.view_& FeatureTypes::WAYS)) {}
-	Ways(const FeaturesBase<Node>& other) : FeaturesBase(empty()) {}
+	Ways(const FeaturesBase<Node>& /* other */) : FeaturesBase(empty()) {}
 	Ways(const FeaturesBase<Way>& other) : FeaturesBase(other.view_) {}
-	Ways(const FeaturesBase<Relation>& other) : FeaturesBase(empty()) {}
+	Ways(const FeaturesBase<Relation>& /* other */) : FeaturesBase(empty()) {}
 
 	/*
 	template<typename P>
@@ -2,6 +2,7 @@
 
 #include <geodesk/filter/Filter.h>
 #include <geodesk/geom/Area.h>
+#include <geodesk/geom/MeasureCache.h>
 
 namespace geodesk {
 
@@ -15,11 +16,16 @@ public:
 	{
 	}
 
-	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override
+	const char* name() const override { return "area"; }
+	double cost() const override { return 16; }    // relations are polygonized
+	// An area is never larger than its bbox (see Area::maxOfBounds)
+	BoxLimits boxLimits() const override { return { minArea_ }; }
+	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint /* fast */) const override
 	{
 		double a;
 		if (feature.isArea())
 		{
+			if (Area::maxOfBounds(feature.bounds()) < minArea_) return false;
 			if (feature.isWay())
 			{
 				a = Area::ofWay(WayPtr(feature));
@@ -27,7 +33,7 @@ public:
 			else
 			{
 				assert(feature.isRelation());
-				a = Area::ofRelation(store, RelationPtr(feature));
+				a = MeasureCache::areaOf(store, RelationPtr(feature));
 			}
 		}
 		else
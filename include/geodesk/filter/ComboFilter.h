@@ -16,8 +16,13 @@ public:
     ComboFilter(const Filter* a, const Filter* b);
     ~ComboFilter();
 
+    const char* name() const override { return "combo"; }
     bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
     int acceptTile(Tile tile) const override;
+    bool acceptsAllInTile(uint32_t turboFlags) const override;
+    double cost() const override;
+    BoxLimits boxLimits() const override;
+    const std::vector<const Filter*>& filters() const { return filters_; }
 
 private:
     void add(const Filter* f);
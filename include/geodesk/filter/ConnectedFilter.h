@@ -4,6 +4,7 @@
 #pragma once
 
 #include <geodesk/filter/SpatialFilter.h>
+#include <geodesk/geom/CoordinateSet.h>
 
 namespace geodesk {
 
@@ -12,6 +13,7 @@ class ConnectedFilter : public SpatialFilter
 public:
 	ConnectedFilter(FeatureStore* store, FeaturePtr feature);
 
+	const char* name() const override { return "connected_to"; }
 	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 
 protected:
@@ -24,7 +26,7 @@ private:
 	void collectMemberPoints(FeatureStore* store, RelationPtr relation, RecursionGuard& guard);
 
 	uint64_t self_;
-	std::unordered_set<Coordinate> points_;
+	CoordinateSet points_;
 };
 
 } // namespace geodesk
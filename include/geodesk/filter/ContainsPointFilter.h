@@ -11,8 +11,12 @@ namespace geodesk {
 class ContainsPointFilter : public SpatialFilter
 {
 public:
-	ContainsPointFilter(Coordinate pt) : SpatialFilter(Box(pt)), point_(pt)	{}
+	ContainsPointFilter(Coordinate pt) : SpatialFilter(Box(pt)), point_(pt)
+	{
+		source_.xy = pt;
+	}
 
+	const char* name() const override { return "containing"; }
 	bool accept(FeatureStore* store, const FeaturePtr feature, FastFilterHint fast) const override;
 
 private:
@@ -20,6 +20,7 @@ public:
 		acceptedTypes_ = accepted;
 	}
 
+	const char* name() const override { return "crossing"; }
 	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 	int acceptTile(Tile tile) const override;
 
@@ -34,6 +35,8 @@ protected:
 class CrossesFilterFactory : public PreparedFilterFactory
 {
 public:
+	CrossesFilterFactory() : PreparedFilterFactory(CROSSES) {}
+
 	const Filter* forPolygonal() override
 	{ 
 		return new CrossesFilter(FeatureTypes::ALL & 
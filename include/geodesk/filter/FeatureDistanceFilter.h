@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <geodesk/filter/PointDistanceFilter.h>
+#include <geodesk/filter/PreparedSpatialFilter.h>
+#include <geodesk/filter/PreparedFilterFactory.h>
+
+namespace geodesk {
+
+/**
+ * Accepts all features that are within the given distance from the
+ * geometry of a way or relation (a point that lies inside an area has
+ * a distance of zero).
+ *
+ * The boundary of the reference feature is indexed as monotone chains;
+ * only chains whose bounding boxes lie within the distance of a
+ * candidate segment are measured, using the exact segment-to-segment
+ * distance. Like PointDistanceFilter, distances are measured in
+ * Mercator units, scaled at the center of the reference feature.
+ */
+class FeatureDistanceFilter : public PreparedSpatialFilter
+{
+public:
+	FeatureDistanceFilter(double meters, const Box& bounds, MCIndex&& index, bool polygonal);
+
+	const char* name() const override { return "max_meters_from"; }
+	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
+	int acceptTile(Tile tile) const override;
+
+protected:
+	bool acceptWay(WayPtr way) const override;
+	bool acceptNode(NodePtr node) const override;
+	bool acceptAreaRelation(FeatureStore* store, RelationPtr relation) const override;
+
+private:
+	struct SegmentClosure
+	{
+		Coordinate start;
+		Coordinate end;
+		double distanceSquared;
+	};
+
+	struct AreaClosure
+	{
+		FeatureStore* store;
+		FeaturePtr area;
+		Box bounds;
+	};
+
+	bool segmentWithinDistance(Coordinate start, Coordinate end) const;
+	bool segmentsWithinDistance(WayPtr way, int areaFlag) const;
+	bool anyChainsNear(const Box& bounds) const;
+	bool containsAnyChain(FeatureStore* store, FeaturePtr area) const;
+	static bool chainWithinDistance(const RTree<const MonotoneChain>::Node* node,
+		const SegmentClosure* segment);
+	static bool chainInsideArea(const RTree<const MonotoneChain>::Node* node,
+		const AreaClosure* closure);
+	static bool anyChain(const RTree<const MonotoneChain>::Node* node, const Box* bounds);
+
+	double distanceSquared_;
+	int32_t margin_;
+	bool polygonal_;
+};
+
+
+class DistanceFilterFactory : public PreparedFilterFactory
+{
+public:
+	explicit DistanceFilterFactory(double meters) : meters_(meters) {}
+
+	const Filter* forPolygonal() override
+	{
+		return new FeatureDistanceFilter(meters_, bounds(), buildIndex(), true);
+	}
+
+	const Filter* forLineal() override
+	{
+		return new FeatureDistanceFilter(meters_, bounds(), buildIndex(), false);
+	}
+
+	const Filter* forNonAreaRelation(FeatureStore* store, RelationPtr relation) override
+	{
+		// Node members are measured like zero-length segments
+		indexMemberNodes(store, relation);
+		if (!hasChains()) return nullptr;
+		return new FeatureDistanceFilter(meters_, bounds(), buildIndex(), false);
+	}
+
+	const Filter* forCoordinate(Coordinate point) override
+	{
+		return new PointDistanceFilter(meters_, point);
+	}
+
+private:
+	double meters_;
+};
+
+} // namespace geodesk
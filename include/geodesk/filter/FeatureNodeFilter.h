@@ -26,6 +26,7 @@ public:
     NodePtr node() const { return node_; }
     const Filter* secondaryFilter() const { return secondaryFilter_; }
 
+    const char* name() const override { return "parent_ways_of"; }
     bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 
 private:
@@ -3,8 +3,10 @@
 
 #pragma once
 
+#include <limits>
 #include <clarisma/util/RefCounted.h>
 #include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/Tip.h>
 #include <geodesk/geom/Tile.h>
 
 namespace geodesk {
@@ -61,9 +63,11 @@ struct FastFilterHint
 {
     uint32_t turboFlags;
     Tile tile;
+    Tip tip;        // null if the feature isn't being checked by a tile scan
 
     FastFilterHint() : turboFlags(0) {}
-    FastFilterHint(uint32_t f, Tile t) : turboFlags(f), tile(t) {}
+    FastFilterHint(uint32_t f, Tile t, Tip tip = Tip()) :
+        turboFlags(f), tile(t), tip(tip) {}
 };
 
 
@@ -80,6 +84,9 @@ public:
     Box getBounds() const;
     FeatureTypes acceptedTypes() const { return acceptedTypes_; }
 
+    /// A short name that describes this kind of filter (for diagnostics)
+    virtual const char* name() const { return "filter"; }
+
     virtual bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
     {
         return false;
@@ -101,9 +108,70 @@ public:
         return 0;
     }
 
+    /**
+     * Returns true if, given the turbo flags returned by acceptTile(),
+     * accept() would return true for every feature in the tile (in
+     * which case the query doesn't call the filter at all).
+     */
+    virtual bool acceptsAllInTile(uint32_t /* turboFlags */) const
+    {
+        return false;
+    }
+
+    /**
+     * The approximate cost of a call to accept(), relative to that of
+     * a Matcher (used by QueryPlanner to order the two).
+     */
+    virtual double cost() const
+    {
+        return DEFAULT_COST;
+    }
+
+    static constexpr double DEFAULT_COST = 8;
+
+    /// Limits on the bounding box of any feature the filter accepts,
+    /// which let a tile scan reject features by their bbox alone,
+    /// before calling the matcher. The limits are conservative: a
+    /// feature that violates them is certain to be rejected by accept().
+    struct BoxLimits
+    {
+        /// The smallest possible area of the bbox (in square meters)
+        double minArea = 0;
+        /// The longest possible way, measured as Length::minOfWay()
+        /// (in meters; relations are not limited)
+        double maxWayLength = std::numeric_limits<double>::infinity();
+
+        bool isNone() const
+        {
+            return minArea <= 0 &&
+                maxWayLength == std::numeric_limits<double>::infinity();
+        }
+    };
+
+    virtual BoxLimits boxLimits() const
+    {
+        return {};
+    }
+
+    /// The arguments a filter was created with, as far as they can be
+    /// told apart after the fact (used by QueryRecorder to describe
+    /// filters so they can be re-created)
+    struct Source
+    {
+        uint64_t typedId = 0;       // the feature (0 if a coordinate or none)
+        Coordinate xy;              // the coordinate (if typedId is 0)
+        double meters = 0;          // the distance, if any
+    };
+
+    const Source& source() const { return source_; }
+
+    /// Must be set before the filter is shared with other threads
+    void setSource(const Source& source) { source_ = source; }
+
 protected:
     int flags_;
 	FeatureTypes acceptedTypes_;
+    Source source_;
 };
 
 // \endcond
@@ -3,6 +3,11 @@
 
 #pragma once
 
+#ifdef GEODESK_WITH_GEOS
+#include <geos_c.h>
+#endif
+#include <span>
+#include <vector>
 #include <geodesk/export.h>
 #include <geodesk/feature/forward.h>
 #include <geodesk/geom/Coordinate.h>
@@ -17,9 +22,22 @@ class GEODESK_API Filters
 public:
     static const Filter* intersects(Feature feature);
     static const Filter* within(Feature feature);
+    static const Filter* intersects(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes);
+    static const Filter* within(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes);
     static const Filter* containsPoint(Coordinate xy);
     static const Filter* crossing(Feature feature);
     static const Filter* maxMetersFrom(double meters, Coordinate xy);
+    static const Filter* maxMetersFrom(double meters, Feature feature);
+    static const Filter* area(double minArea, double maxArea);
+    static const Filter* length(double minLength, double maxLength);
+    #ifdef GEODESK_WITH_GEOS
+    static const Filter* intersects(GEOSContextHandle_t context,
+        const GEOSGeometry* geom, int workerCount);
+    static const Filter* within(GEOSContextHandle_t context,
+        const GEOSGeometry* geom, int workerCount);
+    #endif
 };
 
 // \endcond
@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#ifdef GEODESK_WITH_GEOS
+
+#include <memory>
+#include <mutex>
+#include <geos_c.h>
+#include <geodesk/filter/SpatialFilter.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A filter that tests features against an arbitrary GEOS geometry
+/// (in Mercator coordinates) by way of a GEOS prepared geometry.
+/// Filters::intersects() and Filters::within() use it only for
+/// geometries that PreparedFilterFactory can't turn into one of the
+/// native filters (e.g. collections), since it converts every
+/// candidate feature into a GEOS geometry.
+///
+/// The GEOS C API is only thread-safe with separate contexts, and
+/// a prepared geometry builds its indexes lazily, so each worker
+/// has a context and a prepared copy of the geometry of its own;
+/// any other thread uses a shared copy, guarded by a mutex.
+///
+class GeosPreparedFilter : public SpatialFilter
+{
+public:
+    enum Predicate
+    {
+        INTERSECTS,     ///< feature intersects the geometry
+        WITHIN          ///< feature lies within the geometry
+    };
+
+    GeosPreparedFilter(GEOSContextHandle_t context, const GEOSGeometry* geom,
+        Predicate predicate, int workerCount);
+
+    const char* name() const override
+    {
+        return predicate_ == WITHIN ? "within" : "intersecting";
+    }
+
+    bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
+    int acceptTile(Tile tile) const override;
+    bool acceptsAllInTile(uint32_t turboFlags) const override
+    {
+        return predicate_ == INTERSECTS && turboFlags != 0;
+    }
+
+private:
+    struct alignas(64) Slot     // (padded to avoid false sharing)
+    {
+        Slot() : context(GEOS_init_r()), geometry(nullptr), prepared(nullptr) {}
+        ~Slot();
+
+        GEOSContextHandle_t context;
+        GEOSGeometry* geometry;
+        const GEOSPreparedGeometry* prepared;
+    };
+
+    template <typename Fn>
+    auto withSlot(Fn fn) const;
+
+    Predicate predicate_;
+    int workerCount_;
+    std::unique_ptr<Slot[]> slots_;         // workerCount_ + 1 (the shared one)
+    mutable std::mutex sharedMutex_;
+};
+
+// \endcond
+
+} // namespace geodesk
+
+#endif // GEODESK_WITH_GEOS
@@ -22,10 +22,13 @@ public:
 		PreparedSpatialFilter(bounds, std::move(index))
 	{
 		flags_ |= FilterFlags::FAST_TILE_FILTER;
+		buildCoverage();
 	}
 
+	const char* name() const override { return "intersecting"; }
 	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 	int acceptTile(Tile tile) const override;
+	bool acceptsAllInTile(uint32_t turboFlags) const override { return turboFlags != 0; }
 
 protected:
 	bool acceptWay(WayPtr way) const override;
@@ -40,6 +43,7 @@ public:
 	IntersectsLinealFilter(const Box& bounds, MCIndex&& index) :
 		PreparedSpatialFilter(bounds, std::move(index)) {}
 
+	const char* name() const override { return "intersecting"; }
 	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 
 protected:
@@ -52,6 +56,8 @@ protected:
 class IntersectsFilterFactory : public PreparedFilterFactory
 {
 public:
+	IntersectsFilterFactory() : PreparedFilterFactory(INTERSECTS) {}
+
 	const Filter* forPolygonal() override
 	{ 
 		return new IntersectsPolygonFilter(bounds(), buildIndex()); 
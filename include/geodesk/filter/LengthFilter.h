@@ -2,6 +2,7 @@
 
 #include <geodesk/filter/Filter.h>
 #include <geodesk/geom/Length.h>
+#include <geodesk/geom/MeasureCache.h>
 
 namespace geodesk {
 
@@ -15,16 +16,23 @@ public:
 	{
 	}
 
-	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override
+	const char* name() const override { return "length"; }
+	double cost() const override { return 12; }
+	// A minimum length can't limit the bbox (a winding way may be far
+	// longer than its bbox is wide), but a maximum length can
+	BoxLimits boxLimits() const override { return { 0, maxLen_ }; }
+	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint /* fast */) const override
 	{
 		double len;
 		if (feature.isWay())
 		{
-			len = Length::ofWay(WayPtr(feature));
+			WayPtr way(feature);
+			if (Length::minOfWay(way) > maxLen_) return false;
+			len = Length::ofWay(way);
 		}
 		else if(feature.isRelation())
 		{
-			len = Length::ofRelation(store, RelationPtr(feature));
+			len = MeasureCache::lengthOf(store, RelationPtr(feature));
 		}
 		else
 		{
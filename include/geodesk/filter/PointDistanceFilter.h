@@ -17,13 +17,32 @@ class PointDistanceFilter : public SpatialFilter
 public:
 	PointDistanceFilter(double meters, Coordinate point);
 
+	const char* name() const override { return "max_meters_from"; }
 	virtual bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const;
+	int acceptTile(Tile tile) const override;
+
+	/// Most candidates are rejected by their bounding box alone
+	double cost() const override { return 4; }
+
+	/**
+	 * Calculates the squared distance (in Mercator units) between the
+	 * point and the closest part of the feature (0 if the point lies
+	 * within an area). Stops as soon as it finds a distance below
+	 * `limit`, in which case the result is an upper bound.
+	 *
+	 * @return the distance squared, or infinity if the feature has no geometry
+	 */
+	static double distanceSquared(FeatureStore* store, FeaturePtr feature,
+		Coordinate point, double limit = 0);
 
 private:
-	bool segmentsWithinDistance(WayPtr way, int areaFlag) const;
-	bool isWithinDistance(WayPtr way) const;
-	bool isAreaWithinDistance(FeatureStore* store, RelationPtr relation) const;
-	bool areMembersWithinDistance(FeatureStore* store, RelationPtr relation, RecursionGuard& guard) const;
+	static double segmentsDistanceSquared(WayPtr way, int areaFlag,
+		Coordinate point, double limit);
+	static double wayDistanceSquared(WayPtr way, Coordinate point, double limit);
+	static double areaDistanceSquared(FeatureStore* store, RelationPtr relation,
+		Coordinate point, double limit);
+	static double membersDistanceSquared(FeatureStore* store, RelationPtr relation,
+		Coordinate point, double limit, RecursionGuard& guard);
 
 	Coordinate point_;
 	double distanceSquared_;
@@ -1,13 +1,38 @@
 #pragma once
 
+#include <concepts>
+#include <memory>
+#include <mutex>
 #include <geodesk/filter/Filter.h>
 #include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureStore.h>
 
 namespace geodesk {
 
 ///
 /// \cond lowlevel
 ///
+
+/// A predicate that can be used by `Features::filter()`. Predicates are
+/// evaluated by the query's worker threads (several at once), so they
+/// must be callable as `const` and must not modify shared state without
+/// synchronizing it.
+///
+template <typename P>
+concept ThreadSafePredicate = std::copy_constructible<P> &&
+	std::predicate<const P&, Feature>;
+
+/// A predicate that receives a scratch object of type `Context` along
+/// with each feature. Each worker thread has its own `Context`, which
+/// lives as long as the query's filter, so the predicate can reuse
+/// buffers without allocating or locking.
+///
+template <typename P, typename Context>
+concept ContextPredicate = std::copy_constructible<P> &&
+	std::default_initializable<Context> &&
+	std::predicate<const P&, Feature, Context&>;
+
+
 template <typename Predicate>
 class GEODESK_API PredicateFilter : public Filter
 {
@@ -17,6 +42,7 @@ public:
 	{
 	}
 
+	const char* name() const override { return "predicate"; }
 	bool accept(FeatureStore* store, FeaturePtr ptr, FastFilterHint fast) const override
 	{
 		geodesk::Feature feature(store, FeaturePtr(ptr.ptr()));
@@ -27,6 +53,49 @@ protected:
 	Predicate predicate_;
 };
 
+
+/// Calls a ContextPredicate with the Context of the calling worker.
+/// Threads that are not workers of the store's executor (such as the
+/// thread that iterates a query's results) share one Context, which
+/// is guarded by a lock.
+///
+template <typename Predicate, typename Context>
+class PredicateWithContextFilter : public Filter
+{
+public:
+	PredicateWithContextFilter(Predicate predicate, int workerCount) :
+		predicate_(predicate),
+		workerCount_(workerCount),
+		contexts_(new Slot[workerCount])
+	{
+	}
+
+	const char* name() const override { return "predicate"; }
+	bool accept(FeatureStore* store, FeaturePtr ptr, FastFilterHint fast) const override
+	{
+		geodesk::Feature feature(store, FeaturePtr(ptr.ptr()));
+		int worker = QueryExecutor::currentWorker();
+		if (worker >= 0 && worker < workerCount_)
+		{
+			return predicate_(feature, contexts_[worker].context);
+		}
+		std::lock_guard lock(sharedMutex_);
+		return predicate_(feature, sharedContext_);
+	}
+
+private:
+	struct alignas(64) Slot		// (padded to avoid false sharing)
+	{
+		Context context;
+	};
+
+	Predicate predicate_;
+	int workerCount_;
+	std::unique_ptr<Slot[]> contexts_;
+	mutable std::mutex sharedMutex_;
+	mutable Context sharedContext_;
+};
+
 // \endcond
 
 
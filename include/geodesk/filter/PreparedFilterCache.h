@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+
+namespace geodesk {
+
+class Filter;
+
+/// \cond lowlevel
+///
+/// A cache of prepared spatial filters (such as those created by
+/// `within()` or `intersects()`), keyed by the kind of filter and the
+/// feature it was prepared for, so that repeated uses of the same
+/// boundary share a single filter (and its index of monotone chains)
+/// instead of building it each time. Filters are kept until evicted,
+/// least recently used first, to stay within a budget of bytes.
+///
+/// Enabled via FeatureStore::enablePreparedFilterCache().
+///
+class GEODESK_API PreparedFilterCache
+{
+public:
+    /// Creates the filter, and sets `bytes` to its approximate size
+    using Builder = std::function<const Filter*(size_t& bytes)>;
+
+    explicit PreparedFilterCache(size_t maxBytes);
+    ~PreparedFilterCache();
+
+    PreparedFilterCache(const PreparedFilterCache&) = delete;
+    PreparedFilterCache& operator=(const PreparedFilterCache&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    /// The approximate number of bytes occupied by the cached filters
+    size_t bytes();
+
+    /// Returns a reference to the filter of the given kind for the
+    /// given feature, calling `build` to create it if necessary.
+    /// Safe to call from any thread.
+    const Filter* get(int kind, FeaturePtr feature, const Builder& build);
+
+    /// Drops all filters if the store has changed since they were
+    /// prepared.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        const Filter* filter;
+        size_t bytes;
+    };
+
+    void clear();
+
+    size_t maxBytes_;
+    std::mutex mutex_;
+    std::list<Entry> entries_;          // most recently used first
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> keys_;
+    size_t bytes_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
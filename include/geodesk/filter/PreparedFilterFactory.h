@@ -6,6 +6,8 @@
 #ifdef GEODESK_WITH_GEOS
 #include <geos_c.h>
 #endif
+#include <span>
+#include <vector>
 #include <geodesk/feature/RelationPtr.h>
 #include <geodesk/geom/index/MCIndexBuilder.h>
 
@@ -15,15 +17,47 @@ namespace geodesk {
 class PreparedFilterFactory
 {
 public:
+	/// The kind of filter a factory creates; filters of the same kind
+	/// prepared for the same feature are shared via the store's
+	/// PreparedFilterCache (unless the kind is UNCACHED)
+	enum Kind
+	{
+		UNCACHED,
+		INTERSECTS,
+		WITHIN,
+		CROSSES
+	};
+
+	explicit PreparedFilterFactory(Kind kind = UNCACHED) : kind_(kind) {}
+
+	Kind kind() const { return kind_; }
+
+	/// Returns a filter for the given feature, taken from the store's
+	/// PreparedFilterCache if it is enabled (the caller receives a
+	/// reference to the filter either way)
 	const Filter* forFeature(FeatureStore* store, FeaturePtr feature);
 	#ifdef GEODESK_WITH_GEOS
 	const Filter* forGeometry(GEOSContextHandle_t geosContext, GEOSGeometry* geom);
 	#endif
 	const Filter* forBox(const Box& box);
+	/// Returns a filter for a polygon given as rings of coordinates
+	/// (which need not be closed), or nullptr if the shell has fewer
+	/// than 3 coordinates. The coordinates are copied into the filter's
+	/// index, so the caller retains ownership.
+	const Filter* forPolygon(std::span<const Coordinate> shell,
+		std::span<const std::vector<Coordinate>> holes);
 	virtual const Filter* forCoordinate(Coordinate point) { return nullptr; };
 
 	const Box& bounds() const { return bounds_; }
 	MCIndex buildIndex() { return indexBuilder_.build(bounds_); }
+	bool hasChains() const { return indexBuilder_.chainCount() > 0; }
+	/// Adds the node members of a relation (see
+	/// MCIndexBuilder::segmentizeMemberNodes())
+	void indexMemberNodes(FeatureStore* store, RelationPtr relation)
+	{
+		RecursionGuard guard(relation);
+		indexBuilder_.segmentizeMemberNodes(store, relation, guard);
+	}
 
 protected:
 	virtual const Filter* forPolygonal() { return nullptr; };
@@ -46,6 +80,10 @@ protected:
 	#endif
 
 private:
+	const Filter* prepare(FeatureStore* store, FeaturePtr feature);
+	const Filter* prepareWithSource(FeatureStore* store, FeaturePtr feature);
+
+	Kind kind_;
 	Box bounds_;
 	MCIndexBuilder indexBuilder_;
 };
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <geodesk/filter/SpatialFilter.h>
+#include <geodesk/geom/index/CoverageGrid.h>
 #include <geodesk/geom/index/MCIndex.h>
 
 namespace geodesk {
@@ -20,6 +21,9 @@ public:
 	{
 	}
 
+	/// Each vertex of a candidate is located against the index
+	double cost() const override { return 24; }
+
 protected:
 	static const int MAX_CANDIDATE_MC_LENGTH = 32;
 	
@@ -27,6 +31,28 @@ protected:
 	bool anySegmentsCross(WayPtr way) const;
 	bool wayIntersectsPolygon(WayPtr way) const;
 
+	/// Builds the coverage grid (used by filters whose test polygon
+	/// has an interior)
+	void buildCoverage()
+	{
+		coverage_ = CoverageGrid(index_, bounds_);
+	}
+
+	/// Locates a bounding box without testing any geometry, first via
+	/// the coverage grid, then via the bounding boxes of the monotone
+	/// chains (see MCIndex::maybeLocateBox()). Lets the members of a
+	/// relation (or the entire relation) be accepted or rejected based
+	/// on their bounding boxes alone.
+	///
+	/// @returns -1 = box lies fully outside, 1 = box lies fully inside,
+	///           0 = unknown (the geometry must be tested)
+	int locateBounds(const Box& box) const
+	{
+		int loc = coverage_.locateBox(box);
+		return loc != 0 ? loc : index_.maybeLocateBox(box);
+	}
+
 	MCIndex index_;
+	CoverageGrid coverage_;
 };
 } // namespace geodesk
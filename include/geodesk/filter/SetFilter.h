@@ -0,0 +1,70 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <geodesk/filter/SpatialFilter.h>
+#include <geodesk/feature/View.h>
+
+namespace geodesk {
+
+class MatcherHolder;
+
+///
+/// \cond lowlevel
+///
+/// Combines two world views of the same store by union, difference
+/// or symmetric difference, so the combination can be retrieved by
+/// a single query: the query walks the union of the views' bounds
+/// and accepts all of their types, and the filter then decides for
+/// each feature which of the views it belongs to (by checking each
+/// view's types, bounds, matcher and filter in turn).
+///
+/// Since each feature is checked only once, nothing needs to be
+/// deduplicated.
+///
+class SetFilter : public SpatialFilter
+{
+public:
+    enum class Operation
+    {
+        UNION,
+        DIFFERENCE,
+        SYMMETRIC_DIFFERENCE
+    };
+
+    SetFilter(Operation op, const View& a, const View& b);
+    ~SetFilter();
+
+    /// Returns a world view of the features that result from applying
+    /// `op` to the features of `a` and `b`.
+    ///
+    /// @throws QueryException if the views aren't world views
+    ///   of the same store
+    static View combine(Operation op, const View& a, const View& b);
+
+    const char* name() const override { return "set"; }
+    bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
+    int acceptTile(Tile tile) const override;
+    double cost() const override;
+
+private:
+    struct Branch
+    {
+        FeatureTypes types;
+        Box bounds;
+        const MatcherHolder* matcher;
+        const Filter* filter;
+
+        explicit Branch(const View& view);
+        bool contains(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const;
+        bool mayContain(Tile tile) const;
+    };
+
+    Operation op_;
+    Branch a_;
+    Branch b_;
+};
+
+// \endcond
+} // namespace geodesk
@@ -22,6 +22,7 @@ public:
     {
     }
 
+    const char* name() const override { return "parent_ways_at"; }
     bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 
 private:
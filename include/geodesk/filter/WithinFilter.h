@@ -21,6 +21,7 @@ public:
 			FilterFlags::FAST_TILE_FILTER |
 			FilterFlags::MUST_ACCEPT_ALL_MEMBERS | 
 			FilterFlags::STRICT_BBOX;
+		buildCoverage();
 	}
 
 	WithinPolygonFilter(FeatureStore* store, RelationPtr areaRelation) :
@@ -28,8 +29,10 @@ public:
 			areaRelation.bounds(),
 			MCIndexBuilder::buildFromAreaRelation(store, areaRelation))
 	{
+		buildCoverage();
 	}
 
+	const char* name() const override { return "within"; }
 	bool accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const override;
 	int acceptTile(Tile tile) const override;
 	
@@ -40,6 +43,7 @@ protected:
 	bool acceptMembers(FeatureStore* store, RelationPtr relation, RecursionGuard* guard) const override;
 	int locateMembers(FeatureStore* store, RelationPtr relation, RecursionGuard* guard) const;
 
+	int locateWay(WayPtr way) const;
 	int locateWayNodes(WayPtr way) const;
 	bool containsWay(WayPtr way) const;
 };
@@ -48,6 +52,8 @@ protected:
 class WithinFilterFactory : public PreparedFilterFactory
 {
 public:
+	WithinFilterFactory() : PreparedFilterFactory(WITHIN) {}
+
 	const Filter* forPolygonal() override
 	{
 		return new WithinPolygonFilter(bounds(), buildIndex());
@@ -0,0 +1,128 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/feature/Key.h>
+#include <geodesk/format/ArrowAbi.h>
+#include <geodesk/format/WkbWriter.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// Exports the results of a query as Arrow record batches, via the
+/// Arrow C Data Interface (see ArrowAbi.h). Each row is a feature:
+///
+/// - `id` (int64) and `type` (int8: 0 = node, 1 = way, 2 = relation)
+/// - one column per requested tag key: dictionary-encoded strings
+///   (int32 indexes into a per-batch dictionary; global strings are
+///   looked up by their code, numbers are written as text), null if
+///   the feature doesn't have the tag
+/// - `geometry`: WKB (binary, with the `geoarrow.wkb` extension type)
+///
+/// Batches are built by the worker threads that scan the tiles (a
+/// batch is handed off once it has at least `minBatchRows` rows)
+/// and passed to the consumer. To keep a batch beyond the call, the
+/// consumer must move it (copy the struct, then set the release
+/// callback of the original to `nullptr`); otherwise, the batch is
+/// released once the consumer returns. The consumer is never called
+/// by more than one thread at a time, but it may be called by any
+/// thread, and the order of the batches is not defined.
+///
+class GEODESK_API ArrowExport : public TileReducer
+{
+public:
+	using BatchConsumer = std::function<void(ArrowArray* batch)>;
+
+	static constexpr int64_t DEFAULT_MIN_BATCH_ROWS = 64 * 1024;
+
+	ArrowExport(std::vector<std::string> tagKeys,
+		int64_t minBatchRows = DEFAULT_MIN_BATCH_ROWS);
+
+	/// Fills in the schema of the record batches (a struct); the
+	/// caller must call its release callback
+	void exportSchema(ArrowSchema* out) const;
+
+	void run(FeatureStore* store, const Box& bounds, FeatureTypes types,
+		const MatcherHolder* matcher, const Filter* filter,
+		BatchConsumer consumer);
+
+	/// The number of features exported by run()
+	uint64_t featureCount() const { return featureCount_; }
+
+	void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override;
+	void endTile(uint64_t count) override;
+
+private:
+	/// A batch is handed off early if its WKB reaches this size
+	/// (The offsets of the binary column are 32-bit)
+	static constexpr size_t MAX_GEOMETRY_BYTES = 1 << 30;
+
+	/// A dictionary-encoded string column
+	struct TagColumn
+	{
+		std::vector<int32_t> indexes;
+		std::vector<uint8_t> validity;
+		int64_t nullCount = 0;
+		std::vector<int32_t> dictOffsets{ 0 };
+		std::string dictData;
+		std::unordered_map<uint32_t, int32_t> globalStrings;	// code -> index
+		std::unordered_map<std::string, int32_t> otherStrings;
+	};
+
+	/// The rows of a batch being built
+	struct BatchBuilder
+	{
+		explicit BatchBuilder(size_t tagCount);
+
+		std::vector<int64_t> ids;
+		std::vector<int8_t> types;
+		std::vector<TagColumn> tags;
+		std::vector<int32_t> geomOffsets{ 0 };
+		clarisma::DynamicBuffer geometries;
+		WkbWriter geometryWriter;
+	};
+
+	struct alignas(64) Slot      // (padded to avoid false sharing)
+	{
+		std::unique_ptr<BatchBuilder> batch;
+	};
+
+	Slot& currentSlot();
+	void addFeature(BatchBuilder& batch, FeatureStore* store, FeaturePtr feature);
+	static int32_t dictionaryIndex(TagColumn& col, TagTablePtr tags, TagBits value,
+		StringTable& strings);
+	ArrowArray* finishBatch(BatchBuilder& batch);
+	void emit(Slot& slot);
+
+	std::vector<std::string> tagKeys_;
+	std::vector<Key> keys_;				// (resolved by run())
+	int64_t minBatchRows_;
+	FeatureStore* store_;
+	int workerCount_;
+	std::unique_ptr<Slot[]> slots_;		// one per worker, plus one
+	std::mutex outputMutex_;
+	BatchConsumer consumer_;
+	uint64_t featureCount_;
+};
+
+// \endcond
+
+} // namespace geodesk
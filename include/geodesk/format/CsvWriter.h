@@ -0,0 +1,65 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <geodesk/feature/Key.h>
+#include <geodesk/format/WktWriter.h>
+
+namespace geodesk {
+
+///
+/// \cond lowlevel
+///
+/// Writes features as rows of a CSV (or TSV) table, with a column for
+/// the ID (e.g. `N123`), the geometry (optional: `lon` and `lat` of the
+/// centroid, or WKT), and a column for each of the given keys (empty if
+/// the feature doesn't have the tag). Each row ends with a newline;
+/// writeHeader() writes the row with the column names.
+///
+/// Fields that contain the delimiter, a quote or a line break are
+/// quoted (RFC 4180), all others are written as-is.
+///
+/// The keys must belong to the FeatureStore of the written features.
+/// Since each row is self-contained, a CsvWriter can be used by
+/// ParallelExport (with one writer per thread, sharing the same keys).
+///
+class CsvWriter : public WktWriter
+{
+public:
+	enum class GeometryColumns
+	{
+		NONE,		///< no geometry
+		CENTROID,	///< `lon` and `lat` of the feature's centroid
+		WKT			///< `geometry` in Well-Known Text
+	};
+
+	CsvWriter(clarisma::Buffer* buf, std::vector<Key> keys,
+		GeometryColumns geometry = GeometryColumns::CENTROID, char delimiter = ',');
+
+	std::string_view featureSeparator() const override { return {}; }
+
+	void writeFeature(FeatureStore* store, FeaturePtr feature) override;
+	void writeAnonymousNodeNode(Coordinate point) override;
+	void writeHeader() override;
+	void writeFooter() override {}
+
+private:
+	void writeGeometryFields(FeatureStore* store, FeaturePtr feature);
+	void writeField(std::string_view s);
+
+	std::vector<Key> keys_;
+	/// The distinct keys, ordered the way TagTablePtr::getKeyValues()
+	/// expects them (global keys by code, then local keys)
+	std::vector<Key> sortedKeys_;
+	/// For each column, the index of its key in `sortedKeys_`
+	std::vector<uint32_t> keyIndexes_;
+	std::vector<TagBits> values_;
+	GeometryColumns geometry_;
+	char delimiter_;
+};
+
+// \endcond
+} // namespace geodesk
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <span>
+#include <string_view>
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/format/GeometryWriter.h>
 #include <geodesk/geom/Coordinate.h>
@@ -34,10 +36,19 @@ public:
 	}
 	char quoteChar() const { return quoteChar_; }
 	void pretty(bool b) { pretty_ = b; }
+	/// Sets whether the next feature is the first one (which isn't
+	/// preceded by a separator)
+	void firstFeature(bool b) { firstFeature_ = b; }
+	/// The text written between two features
+	virtual std::string_view featureSeparator() const { return ","; }
 	void flush() { GeometryWriter::flush(); }	// TODO: needed?
 
 	virtual void writeFeature(FeatureStore* store, FeaturePtr feature) = 0;
 	virtual void writeAnonymousNodeNode(Coordinate point) = 0;
+	/// Writes a line that isn't a feature (e.g. one of MergedLines),
+	/// whose only property is `key`=`value` (none if `key` is empty)
+	virtual void writeAnonymousLine(std::span<const Coordinate> coords,
+		std::string_view key, std::string_view value) = 0;
 	virtual void writeHeader() {}
 	virtual void writeFooter() {}
 
@@ -0,0 +1,125 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <clarisma/io/File.h>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/feature/Key.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// Writes the results of a query as FlatGeobuf (version 3), with a
+/// packed Hilbert R-tree index, so clients can fetch the features of
+/// an area with HTTP range requests. Coordinates are WGS-84
+/// longitude/latitude (EPSG:4326). The columns are:
+///
+/// - `id` (Long) and `type` (Byte: 0 = node, 1 = way, 2 = relation)
+/// - one String column per requested tag key (numbers are written as
+///   text; the column is omitted for features that lack the tag)
+///
+/// The worker threads that scan the tiles encode each feature and
+/// compute the Hilbert distance of the center of its bounding box
+/// (relative to the query bounds, so tight bounds give a better
+/// ordering). Each thread sorts its own features; once a thread holds
+/// more than its share of `maxMemory`, it writes them to a temporary
+/// file as a sorted run. The runs are then merged, which yields the
+/// order of the index and of the features. Only the index entries
+/// (about 100 bytes per feature) are held in memory for the whole
+/// export.
+///
+class GEODESK_API FlatGeobufWriter : public TileReducer
+{
+public:
+	static constexpr int DEFAULT_INDEX_NODE_SIZE = 16;
+	static constexpr size_t DEFAULT_MAX_MEMORY = size_t(512) * 1024 * 1024;
+
+	explicit FlatGeobufWriter(std::vector<std::string> tagKeys);
+	~FlatGeobufWriter();
+
+	/// The name of the layer (stored in the header)
+	void layerName(std::string_view name) { layerName_ = name; }
+	/// The number of entries per index node (0 = no index)
+	void indexNodeSize(int size) { indexNodeSize_ = size; }
+	/// The number of bytes of encoded features that can be held in
+	/// memory before they are written to a temporary file
+	void maxMemory(size_t bytes) { maxMemory_ = bytes; }
+	/// Where to put the temporary file (default: the system's temp folder)
+	void tempDirectory(std::filesystem::path dir) { tempDir_ = std::move(dir); }
+
+	void write(FeatureStore* store, const Box& bounds, FeatureTypes types,
+		const MatcherHolder* matcher, const Filter* filter, clarisma::Buffer* out);
+
+	/// The number of features written by write()
+	uint64_t featureCount() const { return featureCount_; }
+
+	void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override;
+	void endTile(uint64_t count) override;
+
+private:
+	/// An encoded feature; its bounds are in degrees
+	struct Entry
+	{
+		uint64_t offset;		// into the run's data, or the temp file
+		double minX, minY, maxX, maxY;
+		uint32_t hilbert;
+		uint32_t size;
+	};
+
+	/// A sequence of features, sorted by Hilbert distance
+	struct Run
+	{
+		std::vector<Entry> entries;
+		std::vector<uint8_t> data;		// empty if the run has been spilled
+	};
+
+	struct Slot;
+
+	Slot& currentSlot();
+	void addFeature(Slot& slot, FeatureStore* store, FeaturePtr feature);
+	void spill(Slot& slot);
+	static void sortEntries(std::vector<Entry>& entries);
+	void writeHeader(clarisma::Buffer* out, const double* envelope, uint64_t count) const;
+	void writeOutput(clarisma::Buffer* out);
+	void cleanup();
+	static std::string_view tagText(TagTablePtr tags, TagBits value,
+		StringTable& strings, char* buf);
+
+	std::vector<std::string> tagKeys_;
+	std::vector<Key> keys_;				// (resolved by write())
+	std::string layerName_;
+	int indexNodeSize_;
+	size_t maxMemory_;
+	std::filesystem::path tempDir_;
+
+	Box bounds_;
+	size_t maxSlotBytes_;
+	int workerCount_;
+	std::unique_ptr<Slot[]> slots_;		// one per worker, plus one
+	std::mutex spillMutex_;
+	std::filesystem::path spillPath_;
+	clarisma::File spillFile_;
+	uint64_t spillSize_;
+	std::vector<Run> runs_;				// (guarded by spillMutex_)
+	uint64_t featureCount_;
+};
+
+// \endcond
+
+} // namespace geodesk
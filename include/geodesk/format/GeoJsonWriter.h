@@ -16,14 +16,37 @@ class GeoJsonWriter : public FeatureWriter
 public:
 	explicit GeoJsonWriter(clarisma::Buffer* buf) :
 		FeatureWriter(buf),
-		linewise_(false)
+		linewise_(false),
+		sequence_(false)
 	{
 	}
 
 	void linewise(bool b) { linewise_ = b; }
 
+	/// Writes GeoJSON Text Sequences (RFC 8142, "GeoJSONSeq"): each
+	/// feature is written as compact JSON, preceded by an ASCII
+	/// Record Separator and followed by a newline, so a consumer can
+	/// process every feature as soon as its line arrives. There is no
+	/// header or footer (and hence nothing to undo if the output is
+	/// cut short). Turns off pretty-printing.
+	void sequence(bool b)
+	{
+		sequence_ = b;
+		linewise_ = b;
+		if (b) pretty_ = false;
+	}
+
+	std::string_view featureSeparator() const override
+	{
+		// (In sequence mode, each feature brings its own delimiters)
+		if (sequence_) return {};
+		return pretty_ ? ",\n" : (linewise_ ? "\n" : ",");
+	}
+
 	void writeFeature(FeatureStore* store, FeaturePtr feature) override;
 	void writeAnonymousNodeNode(Coordinate point) override;
+	void writeAnonymousLine(std::span<const Coordinate> coords,
+		std::string_view key, std::string_view value) override;
 	void writeHeader() override;
 	void writeFooter() override;
 
@@ -36,7 +59,10 @@ protected:
 	void writeAreaRelationGeometry(FeatureStore* store, RelationPtr relation) override;
 	void writeCollectionRelationGeometry(FeatureStore* store, RelationPtr relation) override;
 
+	static constexpr char RECORD_SEPARATOR = 0x1e;
+
 	bool linewise_;
+	bool sequence_;
 };
 
 // \endcond
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <cmath>
+#include <clarisma/math/Math.h>
 #include <clarisma/util/BufferWriter.h>
 #ifdef GEODESK_WITH_GEOS
 #include <geos_c.h>
@@ -10,11 +12,18 @@
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/feature/RelationPtr.h>
 #include <geodesk/geom/Coordinate.h>
+#include <geodesk/geom/CoordinateFilter.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include <functional>
+#include <span>
+#include <vector>
 
 namespace geodesk {
 
-class Polygonizer;
+class FeatureStore;
+class GeneralizedGeometry;
 
 ///
 /// \cond lowlevel
@@ -22,17 +31,74 @@ class Polygonizer;
 class GeometryWriter : public clarisma::BufferWriter
 {
 public:
-	explicit GeometryWriter(clarisma::Buffer* buf) : BufferWriter(buf) {}
+	explicit GeometryWriter(clarisma::Buffer* buf) : BufferWriter(buf)
+	{
+		clearLatitudeCache();
+	}
 	
 	void precision(int precision) 
 	{ 
 		assert(precision >= 0);
 		assert(precision <= 15);
 		precision_ = precision;
+		clearLatitudeCache();
 	}
 
+	/// Simplifies the lines and rings of feature geometries, with the
+	/// given tolerance in Mercator units (0 = don't simplify). If the
+	/// store has generalized geometries (see GeneralizedGeometry), ways
+	/// and area relations start out with their coarsest level that
+	/// doesn't exceed the tolerance.
+	void simplify(double tolerance) { filter_.simplify(tolerance); }
+
+	/// Clips the lines and rings of feature geometries to the given
+	/// box (see CoordinateFilter)
+	void clip(const Box& box) { filter_.clip(box); }
+
 protected:
-	void writeCoordinate(Coordinate c);
+	void writeCoordinate(Coordinate c)
+	{
+		writeScaledCoordinate(scaledLon(c.x), scaledLat(c.y));
+	}
+
+	/// Writes `count` coordinates, preceded by a comma unless `isFirst`.
+	/// Converts the coordinates in blocks, which lets the compiler
+	/// vectorize the conversion of longitudes.
+	void writeCoordinateBlock(bool isFirst, const Coordinate* coords, size_t count);
+
+	/// Returns the longitude of `x`, in units of 10^-precision degrees
+	int64_t scaledLon(int32_t x) const
+	{
+		return static_cast<int64_t>(std::round(
+			Mercator::lonFromX(x) * clarisma::Math::POWERS_OF_10[precision_]));
+	}
+
+	/// Returns the latitude of `y`, in units of 10^-precision degrees.
+	/// Recent latitudes are cached by Y-coordinate, since ways often
+	/// have multiple vertexes with the same Y (e.g. rectangular
+	/// buildings, or the closing vertex of a ring), and the inverse
+	/// projection involves `atan` and `exp`.
+	int64_t scaledLat(int32_t y)
+	{
+		CachedLatitude& entry = latCache_[
+			(static_cast<uint32_t>(y) * 0x9E3779B1u) >> (32 - LAT_CACHE_BITS)];
+		if (entry.y != y)
+		{
+			entry.y = y;
+			entry.scaledLat = static_cast<int64_t>(std::round(
+				Mercator::latFromY(y) * clarisma::Math::POWERS_OF_10[precision_]));
+		}
+		return entry.scaledLat;
+	}
+
+	void writeScaledCoordinate(int64_t lon, int64_t lat)
+	{
+		if (coordStartChar_) writeByte(coordStartChar_);
+		formatScaled(latitudeFirst_ ? lat : lon, precision_);
+		writeByte(coordValueSeparatorChar_);
+		formatScaled(latitudeFirst_ ? lon : lat, precision_);
+		if (coordEndChar_) writeByte(coordEndChar_);
+	}
 	
 	template<typename Iter>
 	void writeCoordinates(Iter& iter)
@@ -79,8 +145,46 @@ protected:
 	// ==== Feature Geometries ====
 
 	void writeWayCoordinates(WayPtr way, bool group);
+	void writeLineCoordinates(std::span<const Coordinate> coords);
+	void writeRingCoordinates(const Polygonizer::Ring* ring);
 	void writePolygonizedCoordinates(const Polygonizer& polygonizer);
 
+	/// Returns the rings of an area relation, pre-simplified if the
+	/// writer simplifies and the store has generalized geometries
+	RingCache::RingsRef areaRings(FeatureStore* store, RelationPtr relation);
+
+	/// Returns the coordinates of a way, clipped and/or simplified
+	/// (only if the filter is active)
+	const std::vector<Coordinate>& filteredCoordinates(WayPtr way);
+	/// Returns the coordinates of a ring, clipped and/or simplified
+	/// (only if the filter is active)
+	const std::vector<Coordinate>& filteredCoordinates(const Polygonizer::Ring* ring);
+	/// Returns the coordinates of a line, clipped and/or simplified
+	/// (only if the filter is active)
+	std::span<const Coordinate> filteredCoordinates(std::span<const Coordinate> coords);
+	/// Filters coordinates that have already been simplified with
+	/// the given tolerance (so only the rest of the writer's tolerance
+	/// is applied)
+	void applyFilter(std::vector<Coordinate>& coords, bool isRing, double presimplified);
+
+	void clearLatitudeCache()
+	{
+		for (CachedLatitude& entry : latCache_) entry.y = INT64_MIN;
+	}
+
+	struct CachedLatitude
+	{
+		int64_t y;				// INT64_MIN = empty
+		int64_t scaledLat;
+	};
+
+	static constexpr int LAT_CACHE_BITS = 6;
+
+	CachedLatitude latCache_[1 << LAT_CACHE_BITS];
+	CoordinateFilter filter_;
+	std::vector<Coordinate> filtered_;
+	const GeneralizedGeometry* generalized_ = nullptr;
+	double presimplified_ = 0;		// tolerance of the rings from areaRings()
 	int precision_ = 7;
 	bool latitudeFirst_ = false;
 	char coordValueSeparatorChar_ = ',';
@@ -0,0 +1,80 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <functional>
+#include <span>
+#include <string>
+#include <vector>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/format/MvtTileBuilder.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// A layer of the vector tiles created by MvtGenerator: the features
+/// of the given types that match the matcher (all features if
+/// `nullptr`) and the filter (if any).
+///
+struct MvtLayerSpec
+{
+	std::string name;
+	FeatureTypes types = FeatureTypes::ALL;
+	const MatcherHolder* matcher = nullptr;
+	const Filter* filter = nullptr;
+};
+
+/// Creates Mapbox Vector Tiles straight from tile queries: for each
+/// tile, runs a layered query for all layers at once (bounded by the
+/// tile and its buffer), and feeds the results into an MvtTileBuilder.
+///
+/// The matchers and filters must remain valid for the lifetime of
+/// the generator.
+///
+class GEODESK_API MvtGenerator
+{
+public:
+	/// Receives a finished tile (the bytes are only valid for the
+	/// duration of the call)
+	using Consumer = std::function<void(Tile tile, const uint8_t* data, size_t size)>;
+
+	MvtGenerator(FeatureStore* store, std::vector<MvtLayerSpec> layers,
+		uint32_t extent = MvtTileBuilder::DEFAULT_EXTENT,
+		uint32_t buffer = MvtTileBuilder::DEFAULT_BUFFER);
+
+	/// Lets the tiles use pre-simplified geometries within the given
+	/// tolerance (see MvtTileBuilder::simplify()). Must not be called
+	/// while tiles are being generated.
+	void simplify(double tolerance) { tolerance_ = tolerance; }
+
+	/// Writes the encoded tile to `out`. Thread-safe.
+	void generate(Tile tile, clarisma::Buffer* out) const;
+
+	/// Generates the given tiles using `threadCount` threads (by
+	/// default, one per worker of the store's QueryExecutor), calling
+	/// `consumer` for each tile as soon as it is done. The consumer is
+	/// called from multiple threads at once, in no particular order.
+	void generate(std::span<const Tile> tiles, const Consumer& consumer,
+		int threadCount = 0) const;
+
+private:
+	void buildTile(MvtTileBuilder& builder, Tile tile) const;
+	MvtTileBuilder createBuilder(Tile tile) const;
+
+	FeatureStore* store_;
+	std::vector<MvtLayerSpec> layers_;
+	uint32_t extent_;
+	uint32_t buffer_;
+	double tolerance_ = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,167 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/geom/Tile.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class WayPtr;
+class RelationPtr;
+
+/// \cond lowlevel
+///
+/// Builds a single Mapbox Vector Tile (MVT 2.1). Features are clipped
+/// to the tile (plus a buffer), quantized to tile-local integer
+/// coordinates and encoded as they are added; encode() then writes the
+/// Protocol Buffers message of the whole tile.
+///
+/// Keys and values are deduplicated per layer: global strings by their
+/// code in the StringTable, local strings by their content. Strings
+/// are not copied (they point into the FeatureStore, which must stay
+/// open until encode() has been called).
+///
+/// Nodes become points, ways become linestrings or polygons (if they
+/// are areas), and area relations become (multi)polygons. Relations
+/// that aren't areas have no MVT equivalent and are skipped.
+///
+/// The feature ID is the OSM ID, shifted left by 2 bits with the type
+/// code in the lower bits (so nodes, ways and relations with the same
+/// ID remain distinct).
+///
+/// Not thread-safe; use one builder per thread (call reset() to
+/// reuse a builder for another tile).
+///
+class GEODESK_API MvtTileBuilder
+{
+public:
+	static constexpr uint32_t DEFAULT_EXTENT = 4096;
+	static constexpr uint32_t DEFAULT_BUFFER = 64;
+
+	explicit MvtTileBuilder(Tile tile, uint32_t extent = DEFAULT_EXTENT,
+		uint32_t buffer = DEFAULT_BUFFER);
+
+	/// Clears all features (but keeps the layers) and starts a new tile
+	void reset(Tile tile);
+
+	/// Adds a layer and returns its index
+	int addLayer(std::string_view name);
+
+	Tile tile() const { return tile_; }
+
+	/// Lets ways and area relations use the pre-simplified geometries
+	/// of the store (see GeneralizedGeometry), at the coarsest level
+	/// whose tolerance doesn't exceed the given tolerance (in units of
+	/// the tile's extent). The default is 0 (always use the full
+	/// geometry).
+	void simplify(double tolerance) { tolerance_ = tolerance; }
+
+	/// The bounding box of features that may appear in the tile
+	/// (its bounds, widened by the buffer)
+	Box queryBounds() const;
+
+	/// Adds a feature to the given layer (ignored if its geometry
+	/// lies entirely outside the tile and its buffer)
+	void addFeature(FeatureStore* store, FeaturePtr feature, int layer);
+
+	/// Writes the encoded tile (Layers without features are omitted)
+	void encode(clarisma::Buffer* out) const;
+
+	enum GeometryType
+	{
+		POINT = 1,
+		LINESTRING = 2,
+		POLYGON = 3
+	};
+
+private:
+	/// A vertex in tile-local coordinates (y pointing down)
+	struct Point
+	{
+		double x;
+		double y;
+	};
+
+	struct Value
+	{
+		enum Type { STRING, INTEGER, DOUBLE };
+
+		Type type;
+		union
+		{
+			int64_t intValue;
+			double doubleValue;
+		};
+		std::string_view stringValue;
+	};
+
+	struct Layer
+	{
+		std::string name;
+		clarisma::DynamicBuffer features{ 4096 };
+		uint32_t featureCount = 0;
+		std::vector<std::string_view> keys;
+		std::unordered_map<std::string_view, uint32_t> keyIndexes;
+		std::vector<Value> values;
+		std::unordered_map<uint32_t, uint32_t> globalStringIndexes;	// by code
+		std::unordered_map<std::string_view, uint32_t> localStringIndexes;
+		std::unordered_map<int64_t, uint32_t> integerIndexes;
+		std::unordered_map<uint64_t, uint32_t> doubleIndexes;		// by bits
+	};
+
+	Point toTile(Coordinate c) const
+	{
+		return { (static_cast<double>(c.x) - leftX_) * scale_,
+			(topY_ - static_cast<double>(c.y)) * scale_ };
+	}
+
+	/// The level of generalized geometry to use (-1 = none)
+	int generalizedLevel() const;
+	void addPoint(Coordinate c);
+	void addLine();
+	bool addRing(bool isOuter);
+	void addWayGeometry(FeatureStore* store, WayPtr way);
+	void addAreaRelationGeometry(FeatureStore* store, RelationPtr relation);
+	void clipRing();
+	void quantize(const std::vector<Point>& points);
+	void writePath(bool isRing);
+	void addTags(FeatureStore* store, FeaturePtr feature, Layer& layer);
+	static uint32_t keyIndex(Layer& layer, std::string_view key);
+	static uint32_t valueIndex(Layer& layer, TagTablePtr tags, TagBits value,
+		StringTable& strings);
+	void writeFeature(Layer& layer, uint64_t id, GeometryType type);
+	static size_t valueSize(const Value& value);
+
+	Tile tile_;
+	uint32_t extent_;
+	uint32_t buffer_;
+	double leftX_;
+	double topY_;
+	double scale_;				// tile-local units per map unit
+	double tolerance_;			// in tile-local units
+	std::vector<Layer> layers_;
+
+	// Scratch space for the feature being encoded
+	std::vector<uint32_t> geometry_;
+	std::vector<uint32_t> tags_;
+	std::vector<Point> points_;
+	std::vector<Point> clipped_;
+	std::vector<Coordinate> quantized_;
+	int32_t cursorX_;
+	int32_t cursorY_;
+};
+
+// \endcond
+
+} // namespace geodesk
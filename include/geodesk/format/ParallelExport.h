@@ -0,0 +1,102 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <clarisma/io/StreamBuffer.h>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/format/FeatureWriter.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+
+///
+/// \cond lowlevel
+///
+/// Writes the results of a query using all worker threads: each
+/// thread that scans a tile serializes the tile's features into a
+/// buffer of its own (using a FeatureWriter created by `createWriter`),
+/// and the finished buffers are copied to the output writer (which
+/// only ever receives whole tiles, plus the separators between them).
+///
+/// If `ordered` is set, tiles are scanned and written in a fixed
+/// order (see QueryOptions::ordered), so the output is the same every
+/// time; otherwise, tiles are written as soon as they are done.
+/// Features that live in multiple tiles are written at the end,
+/// in the order in which the query returns them.
+///
+/// The output writer's header and footer are written by run().
+///
+class GEODESK_API ParallelExport : public TileReducer
+{
+public:
+    using WriterFactory =
+        std::function<std::unique_ptr<FeatureWriter>(clarisma::Buffer* buf)>;
+
+    ParallelExport(FeatureWriter* out, WriterFactory createWriter, bool ordered);
+
+    /// Lets the output writer's buffer send each finished tile
+    /// directly (see clarisma::StreamBuffer::write()) instead of
+    /// having it copied, and sends all remaining output at the end
+    /// of run(). `stream` must be the output writer's buffer.
+    void streamTo(clarisma::StreamBuffer* stream) { stream_ = stream; }
+
+    void run(FeatureStore* store, const Box& bounds, FeatureTypes types,
+        const MatcherHolder* matcher, const Filter* filter);
+
+    /// The number of features written by run()
+    uint64_t featureCount() const { return featureCount_; }
+
+    void beginTile(uint32_t sequence) override;
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override;
+    void endTile(uint64_t count) override;
+
+private:
+    static constexpr size_t CHUNK_CAPACITY = 64 * 1024;
+
+    /// The buffer and writer of a thread that scans tiles
+    struct alignas(64) Slot      // (padded to avoid false sharing)
+    {
+        Slot() : buffer(CHUNK_CAPACITY) {}
+
+        clarisma::DynamicBuffer buffer;
+        std::unique_ptr<FeatureWriter> writer;
+        uint32_t sequence = 0;
+    };
+
+    Slot& currentSlot();
+    void initSlot(Slot& slot);
+    void writeChunk(const clarisma::DynamicBuffer& chunk);
+    void writePending();
+
+    FeatureWriter* out_;
+    clarisma::StreamBuffer* stream_;
+    WriterFactory createWriter_;
+    bool ordered_;
+    bool anyWritten_;
+    int workerCount_;
+    /// One slot per worker, plus one for the thread that calls run()
+    /// (which scans tiles itself if the workers are saturated)
+    std::unique_ptr<Slot[]> slots_;
+    std::mutex outputMutex_;
+    /// Finished tiles of an ordered export, waiting for the tiles
+    /// before them (nullptr = tile had no features)
+    std::map<uint32_t, std::unique_ptr<clarisma::DynamicBuffer>> pending_;
+    uint32_t nextSequence_;
+    uint64_t featureCount_;
+};
+
+// \endcond
+
+} // namespace geodesk
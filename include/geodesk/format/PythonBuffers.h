@@ -0,0 +1,61 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#ifdef GEODESK_PYTHON
+
+#include <memory>
+#include <Python.h>
+#include <geodesk/feature/FlatCoordinates.h>
+#include <geodesk/feature/TagColumns.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Exposes the arrays of a FlatCoordinates or a dictionary-encoded
+/// tag column to Python through the buffer protocol, so numpy (and
+/// pandas/geopandas, by way of numpy) can use them without a copy,
+/// e.g. `numpy.asarray(coords)`.
+///
+/// Each function returns a read-only `memoryview` (a new reference),
+/// or NULL with a Python exception set. The memoryview keeps the
+/// object that owns the array alive, so the caller may drop its own
+/// reference to it at any time. Must be called with the GIL held.
+///
+class PythonBuffers
+{
+public:
+    /// The typed IDs of the features (uint64)
+    static PyObject* typedIds(std::shared_ptr<const FlatCoordinates> coords);
+    /// The first part of each feature, plus the total (uint32)
+    static PyObject* featureOffsets(std::shared_ptr<const FlatCoordinates> coords);
+    /// The first coordinate pair of each part, plus the total (uint32)
+    static PyObject* partOffsets(std::shared_ptr<const FlatCoordinates> coords);
+    /// The FlatCoordinates::PartType of each part (uint8)
+    static PyObject* partTypes(std::shared_ptr<const FlatCoordinates> coords);
+    /// The coordinate pairs, with a shape of (count, 2): int32 for
+    /// CoordinateFormat::MERCATOR, float64 for LONLAT
+    static PyObject* coordinates(std::shared_ptr<const FlatCoordinates> coords);
+
+    /// Returns a tuple `(indexes, values)`, where `indexes` is a
+    /// memoryview of the column's int32 indexes (-1 for features that
+    /// lack the tag) and `values` is a list of its distinct values as
+    /// Python strings. Global strings are taken from the store's cache
+    /// of string objects (see StringTable::getStringObject()).
+    static PyObject* tagColumn(FeatureStore* store,
+        std::shared_ptr<const TagColumns::DictionaryColumn> column);
+
+private:
+    static PyObject* wrap(std::shared_ptr<const void> owner, const void* data,
+        Py_ssize_t rows, Py_ssize_t columns, const char* format, Py_ssize_t itemSize);
+};
+
+// \endcond
+
+} // namespace geodesk
+
+#endif // GEODESK_PYTHON
@@ -0,0 +1,51 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <geodesk/format/WkbWriter.h>
+
+namespace geodesk {
+
+///
+/// \cond lowlevel
+///
+/// Writes the geometries of features as Tiny WKB (TWKB): coordinates
+/// are scaled to integers (see precision()) and stored as varint-encoded
+/// deltas from the previous coordinate, and counts are varints.
+/// Each feature becomes a separate TWKB geometry.
+///
+/// TWKB can't store more than 7 decimal places; a higher precision
+/// is reduced to 7.
+///
+class TwkbWriter : public WkbWriter
+{
+public:
+	explicit TwkbWriter(clarisma::Buffer* buf) : WkbWriter(buf) {}
+
+	static constexpr int MAX_PRECISION = 7;
+
+	void writeFeature(FeatureStore* store, FeaturePtr feature) override;
+	void writeAnonymousNodeNode(Coordinate point) override;
+
+protected:
+	void writeGeometryHeader(GeometryType type) override;
+	void writeEmptyGeometry(GeometryType type) override;
+	void writeCount(uint32_t count) override;
+	void writePoints(const Coordinate* coords, size_t count) override;
+	bool partsHaveHeaders() const override { return false; }
+
+private:
+	void checkPrecision()
+	{
+		if (precision_ > MAX_PRECISION) precision(MAX_PRECISION);
+	}
+
+	/// The previous coordinate (scaled); deltas start over with
+	/// each geometry header
+	int64_t prevLon_ = 0;
+	int64_t prevLat_ = 0;
+};
+
+// \endcond
+} // namespace geodesk
@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <geodesk/format/FeatureWriter.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+
+namespace geodesk {
+
+///
+/// \cond lowlevel
+///
+/// Writes the geometries of features as Well-Known Binary (WKB), with
+/// coordinates as WGS-84 longitude/latitude (EPSG:4326) in the byte
+/// order of the host. Each feature becomes a separate WKB geometry;
+/// since WKB geometries are self-delimiting, a reader can consume the
+/// output one geometry at a time.
+///
+/// Coordinates are written straight from the encoded ways and the
+/// rings of the Polygonizer, without any text conversion.
+///
+class WkbWriter : public FeatureWriter
+{
+public:
+	explicit WkbWriter(clarisma::Buffer* buf) : FeatureWriter(buf) {}
+
+	enum GeometryType
+	{
+		POINT = 1,
+		LINESTRING = 2,
+		POLYGON = 3,
+		MULTIPOLYGON = 6,
+		GEOMETRYCOLLECTION = 7
+	};
+
+	std::string_view featureSeparator() const override { return {}; }
+
+	void writeFeature(FeatureStore* store, FeaturePtr feature) override;
+	void writeAnonymousNodeNode(Coordinate point) override;
+	void writeAnonymousLine(std::span<const Coordinate> coords,
+		std::string_view key, std::string_view value) override;
+
+protected:
+	void writeNodeGeometry(NodePtr node) override;
+	void writeWayGeometry(WayPtr way) override;
+	void writeAreaRelationGeometry(FeatureStore* store, RelationPtr relation) override;
+	void writeCollectionRelationGeometry(FeatureStore* store, RelationPtr relation) override;
+
+	// The encoding primitives (overridden by TwkbWriter)
+
+	virtual void writeGeometryHeader(GeometryType type);
+	virtual void writeEmptyGeometry(GeometryType type);
+	virtual void writeCount(uint32_t count);
+	virtual void writePoints(const Coordinate* coords, size_t count);
+	/// Whether each polygon of a multipolygon starts with a header
+	virtual bool partsHaveHeaders() const { return true; }
+
+private:
+	void writeWayPoints(WayPtr way);
+	void writeRingPoints(const Polygonizer::Ring* ring);
+	void writePolygonBody(const Polygonizer::Ring* outer);
+	void writeCollection(FeatureStore* store, RelationPtr relation, RecursionGuard& guard);
+};
+
+// \endcond
+} // namespace geodesk
@@ -15,8 +15,12 @@ class WktWriter : public FeatureWriter
 public:
 	explicit WktWriter(clarisma::Buffer* buf);
 
+	std::string_view featureSeparator() const override { return ", "; }
+
 	void writeFeature(FeatureStore* store, FeaturePtr feature) override;
 	void writeAnonymousNodeNode(Coordinate point) override;
+	void writeAnonymousLine(std::span<const Coordinate> coords,
+		std::string_view key, std::string_view value) override;
 	void writeHeader() override;
 	void writeFooter() override;
 
@@ -7,5 +7,6 @@
 #include <geodesk/feature/FeatureBase_impl.h>
 #include <geodesk/feature/Features.h>
 #include <geodesk/feature/FeaturesBase_impl.h>
+#include <geodesk/feature/FeaturePipeline.h>
 #include <geodesk/feature/Tags.h>
 
@@ -35,6 +35,19 @@ public:
         return std::abs(signedMercatorOfRing(ring));
     }
 
+    /**
+     * Returns an upper bound for the area (in square meters) of an
+     * area with the given bounding box (consistent with ofWay() and
+     * ofRelation(), which apply the scale at the center of the box).
+     */
+    static double maxOfBounds(const Box& bounds)
+    {
+        int32_t avgY = clarisma::Math::avg(bounds.minY(), bounds.maxY());
+        double scale = Mercator::metersPerUnitAtY(avgY);
+        return (static_cast<double>(bounds.maxX()) - bounds.minX()) *
+            (static_cast<double>(bounds.maxY()) - bounds.minY()) * scale * scale;
+    }
+
     /**
      * Returns the area (in square meters) of the given relation.
      * Assumes that the relation is an area.
@@ -42,6 +55,9 @@ public:
     static double ofRelation(FeatureStore* store, RelationPtr relation);
 
 private:
+    static double doubleSignedMercatorOfCoords(const Coordinate* coords,
+        int count, Coordinate origin);
+
 	template<typename Iter>
 	static double signedMercatorOfAbstractRing(Iter& iter)
 	{
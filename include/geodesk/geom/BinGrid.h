@@ -0,0 +1,91 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <geodesk/export.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// A grid of cells that features can be binned into (e.g. to build
+/// a heatmap), laid out in Mercator space over a bounding box.
+///
+/// Cells are numbered row by row, starting at the top-left (north-west)
+/// corner, so the result of FeaturesBase::binCount() can be turned into
+/// an image without reordering. A grid is either:
+///
+/// - a regular grid of rectangular cells (ofCells()),
+/// - the grid of tiles at a zoom level (ofTiles()), cropped to the
+///   tiles that intersect a bounding box, or
+/// - a grid of "pointy-top" hexagons of a given size (ofHexagons()).
+///   Odd rows are shifted half a cell to the right; a point belongs
+///   to the hexagon whose center is closest.
+///
+/// Points outside the grid's bounds don't belong to any cell.
+///
+class GEODESK_API BinGrid
+{
+public:
+	enum class Shape { RECTANGLE, HEXAGON };
+
+	/// A grid of `columns` x `rows` cells of equal size that
+	/// covers `bounds`
+	static BinGrid ofCells(const Box& bounds, uint32_t columns, uint32_t rows);
+
+	/// The tiles at `zoom` (0 to 24) that intersect `bounds`
+	static BinGrid ofTiles(int zoom, const Box& bounds);
+
+	/// Hexagons whose corners lie `meters` from their center (measured
+	/// at the center of `bounds`), covering `bounds`
+	static BinGrid ofHexagons(const Box& bounds, double meters);
+
+	Shape shape() const { return shape_; }
+	const Box& bounds() const { return bounds_; }
+	uint32_t columns() const { return columns_; }
+	uint32_t rows() const { return rows_; }
+	uint32_t cellCount() const { return columns_ * rows_; }
+
+	/// Returns the number of the cell that contains `c`,
+	/// or -1 if `c` lies outside the grid
+	int64_t cellOf(Coordinate c) const
+	{
+		if (!bounds_.contains(c)) return -1;
+		return shape_ == Shape::RECTANGLE ? rectangleOf(c) : hexagonOf(c);
+	}
+
+	/// Returns the center of the given cell
+	Coordinate centerOf(uint32_t cell) const;
+
+	/// The largest number of cells a grid may have
+	static constexpr uint32_t MAX_CELLS = 1 << 28;
+
+private:
+	BinGrid(Shape shape, const Box& bounds, double originX, double originY,
+		double cellWidth, double cellHeight, uint32_t columns, uint32_t rows);
+
+	int64_t rectangleOf(Coordinate c) const
+	{
+		uint32_t col = static_cast<uint32_t>((c.x - originX_) / cellWidth_);
+		uint32_t row = static_cast<uint32_t>((originY_ - c.y) / cellHeight_);
+		// (guard against rounding at the far edges)
+		if (col >= columns_) col = columns_ - 1;
+		if (row >= rows_) row = rows_ - 1;
+		return static_cast<int64_t>(row) * columns_ + col;
+	}
+
+	int64_t hexagonOf(Coordinate c) const;
+
+	Shape shape_;
+	Box bounds_;
+	double originX_;
+	double originY_;
+	double cellWidth_;		// hexagons: the distance between two centers in a row
+	double cellHeight_;		// hexagons: the distance between rows
+	uint32_t columns_;
+	uint32_t rows_;
+};
+
+} // namespace geodesk
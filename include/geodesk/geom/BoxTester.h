@@ -0,0 +1,204 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <geodesk/geom/Box.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>  // Header for SSE2 intrinsics
+    #define GEODESK_BOX_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define GEODESK_BOX_NEON
+#endif
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Tests up to BATCH_SIZE bounding boxes (or points) against a query
+/// box at once, returning a bitmask of the candidates (bit `i` is set
+/// if the i-th box intersects). Each box is read from memory as four
+/// int32 values (minX, minY, maxX, maxY), each point as two (x, y),
+/// which matches the layout of the spatial index records in a tile.
+///
+/// Uses SSE2 (baseline on x86-64) or NEON (baseline on AArch64),
+/// with a portable fallback. Callers with fewer than BATCH_SIZE boxes
+/// should repeat the last pointer and mask off the surplus bits.
+///
+/// Point tests assume the query box is *simple* (see Box).
+///
+class BoxTester
+{
+public:
+    static constexpr int BATCH_SIZE = 4;
+
+    explicit BoxTester(const Box& box) :
+        box_(box)
+    {
+    #if defined(GEODESK_BOX_SSE2)
+        minX_ = _mm_set1_epi32(box.minX());
+        minY_ = _mm_set1_epi32(box.minY());
+        maxX_ = _mm_set1_epi32(box.maxX());
+        maxY_ = _mm_set1_epi32(box.maxY());
+    #elif defined(GEODESK_BOX_NEON)
+        minX_ = vdupq_n_s32(box.minX());
+        minY_ = vdupq_n_s32(box.minY());
+        maxX_ = vdupq_n_s32(box.maxX());
+        maxY_ = vdupq_n_s32(box.maxY());
+    #endif
+    }
+
+    uint32_t intersects(const uint8_t* const* boxes) const
+    {
+    #if defined(GEODESK_BOX_SSE2)
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(boxes[0]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(boxes[1]));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(boxes[2]));
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(boxes[3]));
+
+        // Transpose into one vector per coordinate
+        __m128i abLow = _mm_unpacklo_epi32(a, b);
+        __m128i cdLow = _mm_unpacklo_epi32(c, d);
+        __m128i abHigh = _mm_unpackhi_epi32(a, b);
+        __m128i cdHigh = _mm_unpackhi_epi32(c, d);
+        __m128i minX = _mm_unpacklo_epi64(abLow, cdLow);
+        __m128i minY = _mm_unpackhi_epi64(abLow, cdLow);
+        __m128i maxX = _mm_unpacklo_epi64(abHigh, cdHigh);
+        __m128i maxY = _mm_unpackhi_epi64(abHigh, cdHigh);
+
+        __m128i reject = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(minX, maxX_), _mm_cmpgt_epi32(minY, maxY_)),
+            _mm_or_si128(_mm_cmpgt_epi32(minX_, maxX), _mm_cmpgt_epi32(minY_, maxY)));
+        return ~_mm_movemask_ps(_mm_castsi128_ps(reject)) & 0xf;
+    #elif defined(GEODESK_BOX_NEON)
+        int32x4x2_t ab = vzipq_s32(load(boxes[0]), load(boxes[1]));
+        int32x4x2_t cd = vzipq_s32(load(boxes[2]), load(boxes[3]));
+        int32x4_t minX = vcombine_s32(vget_low_s32(ab.val[0]), vget_low_s32(cd.val[0]));
+        int32x4_t minY = vcombine_s32(vget_high_s32(ab.val[0]), vget_high_s32(cd.val[0]));
+        int32x4_t maxX = vcombine_s32(vget_low_s32(ab.val[1]), vget_low_s32(cd.val[1]));
+        int32x4_t maxY = vcombine_s32(vget_high_s32(ab.val[1]), vget_high_s32(cd.val[1]));
+
+        uint32x4_t reject = vorrq_u32(
+            vorrq_u32(vcgtq_s32(minX, maxX_), vcgtq_s32(minY, maxY_)),
+            vorrq_u32(vcgtq_s32(minX_, maxX), vcgtq_s32(minY_, maxY)));
+        return ~toMask(reject) & 0xf;
+    #else
+        uint32_t mask = 0;
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            int32_t b[4];
+            memcpy(b, boxes[i], sizeof(b));
+            mask |= static_cast<uint32_t>(!(b[0] > box_.maxX() ||
+                b[1] > box_.maxY() || b[2] < box_.minX() ||
+                b[3] < box_.minY())) << i;
+        }
+        return mask;
+    #endif
+    }
+
+    /// Tests four boxes whose coordinates are stored in separate
+    /// arrays (struct-of-arrays), as in the node groups of PackedRTree
+    uint32_t intersects(const int32_t* minX, const int32_t* minY,
+        const int32_t* maxX, const int32_t* maxY) const
+    {
+    #if defined(GEODESK_BOX_SSE2)
+        __m128i reject = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(minX)), maxX_),
+                _mm_cmpgt_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(minY)), maxY_)),
+            _mm_or_si128(
+                _mm_cmpgt_epi32(minX_, _mm_loadu_si128(reinterpret_cast<const __m128i*>(maxX))),
+                _mm_cmpgt_epi32(minY_, _mm_loadu_si128(reinterpret_cast<const __m128i*>(maxY)))));
+        return ~_mm_movemask_ps(_mm_castsi128_ps(reject)) & 0xf;
+    #elif defined(GEODESK_BOX_NEON)
+        uint32x4_t reject = vorrq_u32(
+            vorrq_u32(vcgtq_s32(vld1q_s32(minX), maxX_), vcgtq_s32(vld1q_s32(minY), maxY_)),
+            vorrq_u32(vcgtq_s32(minX_, vld1q_s32(maxX)), vcgtq_s32(minY_, vld1q_s32(maxY))));
+        return ~toMask(reject) & 0xf;
+    #else
+        uint32_t mask = 0;
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            mask |= static_cast<uint32_t>(!(minX[i] > box_.maxX() ||
+                minY[i] > box_.maxY() || maxX[i] < box_.minX() ||
+                maxY[i] < box_.minY())) << i;
+        }
+        return mask;
+    #endif
+    }
+
+    uint32_t containsSimple(const uint8_t* const* points) const
+    {
+    #if defined(GEODESK_BOX_SSE2)
+        __m128i a = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(points[0]));
+        __m128i b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(points[1]));
+        __m128i c = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(points[2]));
+        __m128i d = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(points[3]));
+        __m128i ab = _mm_unpacklo_epi32(a, b);
+        __m128i cd = _mm_unpacklo_epi32(c, d);
+        __m128i x = _mm_unpacklo_epi64(ab, cd);
+        __m128i y = _mm_unpackhi_epi64(ab, cd);
+
+        __m128i reject = _mm_or_si128(
+            _mm_or_si128(_mm_cmpgt_epi32(x, maxX_), _mm_cmpgt_epi32(y, maxY_)),
+            _mm_or_si128(_mm_cmpgt_epi32(minX_, x), _mm_cmpgt_epi32(minY_, y)));
+        return ~_mm_movemask_ps(_mm_castsi128_ps(reject)) & 0xf;
+    #elif defined(GEODESK_BOX_NEON)
+        int32x2x2_t ab = vzip_s32(loadPoint(points[0]), loadPoint(points[1]));
+        int32x2x2_t cd = vzip_s32(loadPoint(points[2]), loadPoint(points[3]));
+        int32x4_t x = vcombine_s32(ab.val[0], cd.val[0]);
+        int32x4_t y = vcombine_s32(ab.val[1], cd.val[1]);
+
+        uint32x4_t reject = vorrq_u32(
+            vorrq_u32(vcgtq_s32(x, maxX_), vcgtq_s32(y, maxY_)),
+            vorrq_u32(vcgtq_s32(minX_, x), vcgtq_s32(minY_, y)));
+        return ~toMask(reject) & 0xf;
+    #else
+        uint32_t mask = 0;
+        for (int i = 0; i < BATCH_SIZE; i++)
+        {
+            int32_t xy[2];
+            memcpy(xy, points[i], sizeof(xy));
+            mask |= static_cast<uint32_t>(box_.containsSimple(xy[0], xy[1])) << i;
+        }
+        return mask;
+    #endif
+    }
+
+private:
+#if defined(GEODESK_BOX_SSE2)
+    __m128i minX_;
+    __m128i minY_;
+    __m128i maxX_;
+    __m128i maxY_;
+#elif defined(GEODESK_BOX_NEON)
+    static int32x4_t load(const uint8_t* p)
+    {
+        return vld1q_s32(reinterpret_cast<const int32_t*>(p));
+    }
+
+    static int32x2_t loadPoint(const uint8_t* p)
+    {
+        return vld1_s32(reinterpret_cast<const int32_t*>(p));
+    }
+
+    static uint32_t toMask(uint32x4_t v)
+    {
+        static const uint32_t BITS[4] = { 1, 2, 4, 8 };
+        return vaddvq_u32(vandq_u32(v, vld1q_u32(BITS)));
+    }
+
+    int32x4_t minX_;
+    int32x4_t minY_;
+    int32x4_t maxX_;
+    int32x4_t maxY_;
+#endif
+    Box box_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -6,6 +6,7 @@
 #include <geodesk/geom/Coordinate.h>
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TileCache.h>
 
 namespace geodesk {
 
@@ -25,8 +26,12 @@ private:
 	class Areal
 	{
 	public:
-		Areal() : areaSum_(0), areaCentroidX_(0), areaCentroidY_(0) {}
+		Areal() : areaSum_(0), areaCentroidX_(0), areaCentroidY_(0),
+			hasOrigin_(false), originX_(0), originY_(0) {}
 
+		/// The coordinates are taken relative to the first vertex of
+		/// the first ring; with absolute Mercator coordinates, the cross
+		/// products of small rings lose most of their precision
 		template<typename Iter>
 		void addRing(Iter& iter, bool isShell)
 		{
@@ -35,13 +40,19 @@ private:
 			double ringCentroidY = 0;
 
 			Coordinate c = iter.next();
-			double x1 = c.x;
-			double y1 = c.y;
+			if (!hasOrigin_)
+			{
+				originX_ = c.x;
+				originY_ = c.y;
+				hasOrigin_ = true;
+			}
+			double x1 = c.x - originX_;
+			double y1 = c.y - originY_;
 			for (int count = iter.coordinatesRemaining(); count > 0; count--)
 			{
 				c = iter.next();
-				double x2 = c.x;
-				double y2 = c.y;
+				double x2 = c.x - originX_;
+				double y2 = c.y - originY_;
 				double a = x1 * y2 - x2 * y1;
 				ringSum += a;
 				ringCentroidX += (x1 + x2) * a;
@@ -60,14 +71,17 @@ private:
 		Coordinate centroid() const
 		{
 			return Coordinate(
-				static_cast<int32_t>(round(areaCentroidX_ / (3.0 * areaSum_))),
-				static_cast<int32_t>(round(areaCentroidY_ / (3.0 * areaSum_))));
+				static_cast<int32_t>(round(originX_ + areaCentroidX_ / (3.0 * areaSum_))),
+				static_cast<int32_t>(round(originY_ + areaCentroidY_ / (3.0 * areaSum_))));
 		}
 
 	private:
 		double areaSum_;
 		double areaCentroidX_;
 		double areaCentroidY_;
+		bool hasOrigin_;
+		double originX_;
+		double originY_;
 	};
 
 	class Lineal
@@ -113,7 +127,8 @@ private:
 
 private:
 	void addWay(WayPtr way);
-	void addRelation(FeatureStore* store, RelationPtr rel, RecursionGuard& guard);
+	void addRelation(FeatureStore* store, RelationPtr rel,
+		RecursionGuard& guard, TileCache& tiles);
 	
 	Areal areal_;
 	Lineal lineal_;
@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <vector>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Clips and/or simplifies the coordinates of a line or ring, so
+/// writers can drop the vertexes a map at low zoom (or a viewport)
+/// has no use for, without building GEOS geometries.
+///
+/// - Clipping uses Sutherland-Hodgman, for both rings and lines, so
+///   a geometry keeps its type: parts of a line that leave and
+///   re-enter the box are joined along the boundary of the box (which
+///   is invisible if the box has a margin around the viewport). If
+///   nothing is left, the vertexes are clamped to the box instead,
+///   so the geometry degenerates rather than becoming empty.
+///
+/// - Simplification uses Douglas-Peucker, with a tolerance in
+///   Mercator units (see Mercator::unitsFromMeters). It keeps the end
+///   points of lines, and at least a triangle of each ring.
+///
+/// Rings are closed (their last coordinate equals the first), and
+/// stay closed.
+///
+class CoordinateFilter
+{
+public:
+	bool isActive() const { return clipping_ || tolerance_ > 0; }
+	double tolerance() const { return tolerance_; }
+
+	/// Sets the simplification tolerance (0 = don't simplify)
+	void simplify(double tolerance) { tolerance_ = tolerance; }
+	void clip(const Box& box) { clipBox_ = box; clipping_ = true; }
+	void noClip() { clipping_ = false; }
+
+	/// Filters the coordinates in place
+	void apply(std::vector<Coordinate>& coords, bool isRing);
+
+	/// Clips coordinates to a box (see above)
+	void clip(std::vector<Coordinate>& coords, bool isRing, const Box& box);
+	/// Removes vertexes that deviate less than `tolerance` from the
+	/// simplified line
+	void simplify(std::vector<Coordinate>& coords, bool isRing, double tolerance);
+
+private:
+	void simplifyRange(const std::vector<Coordinate>& coords, size_t start, size_t end,
+		double toleranceSquared);
+	void keepOnly(std::vector<Coordinate>& coords);
+
+	double tolerance_ = 0;
+	Box clipBox_;
+	bool clipping_ = false;
+	std::vector<Coordinate> original_;
+	std::vector<Coordinate> temp_;
+	std::vector<uint8_t> keep_;
+	std::vector<std::pair<size_t, size_t>> stack_;
+};
+
+// \endcond
+
+} // namespace geodesk
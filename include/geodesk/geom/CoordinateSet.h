@@ -0,0 +1,115 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <vector>
+#include <clarisma/data/FlatHashSet.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// A set of coordinates, stored in an open-addressing hash table,
+/// along with a coarse occupancy grid (GRID_SIZE x GRID_SIZE cells,
+/// one bit each) that lets callers skip bounding boxes and points
+/// that cannot possibly match without probing the table.
+///
+/// The null coordinate (0,0) cannot be stored, consistent with
+/// WayCoordinateIterator, which uses it to mark the end of a way.
+///
+/// Coordinates are collected by insert(); call build() once all
+/// have been inserted, before calling contains() or mayContainAny().
+///
+class CoordinateSet
+{
+public:
+    static constexpr int GRID_SIZE = 64;
+
+    CoordinateSet() : cellWidth_(1), cellHeight_(1), rows_{} {}
+
+    size_t size() const { return points_.size(); }
+    bool isEmpty() const { return points_.isEmpty(); }
+    const Box& bounds() const { return bounds_; }
+
+    void insert(Coordinate c)
+    {
+        if (c.isNull()) return;
+        pending_.push_back(c);
+        bounds_.expandToInclude(c);
+    }
+
+    /// Fills the hash table, sizes the occupancy grid to the bounds
+    /// of the coordinates and marks the occupied cells
+    void build()
+    {
+        int64_t width = static_cast<int64_t>(bounds_.maxX()) - bounds_.minX();
+        int64_t height = static_cast<int64_t>(bounds_.maxY()) - bounds_.minY();
+        cellWidth_ = width / GRID_SIZE + 1;
+        cellHeight_ = height / GRID_SIZE + 1;
+        points_.reserve(pending_.size());
+        for (Coordinate c : pending_)
+        {
+            points_.insert(key(c));
+            rows_[row(c)] |= 1ULL << col(c);
+        }
+        pending_.clear();
+        pending_.shrink_to_fit();
+    }
+
+    bool contains(Coordinate c) const
+    {
+        if (!bounds_.containsSimple(c)) return false;
+        if ((rows_[row(c)] & (1ULL << col(c))) == 0) return false;
+        return points_.contains(key(c));
+    }
+
+    /// Returns false if no coordinate can lie within the given box
+    bool mayContainAny(const Box& box) const
+    {
+        if (!box.intersects(bounds_)) return false;
+        int64_t minX = std::max(box.minX(), bounds_.minX());
+        int64_t minY = std::max(box.minY(), bounds_.minY());
+        int64_t maxX = std::min(box.maxX(), bounds_.maxX());
+        int64_t maxY = std::min(box.maxY(), bounds_.maxY());
+        int startCol = static_cast<int>((minX - bounds_.minX()) / cellWidth_);
+        int endCol = static_cast<int>((maxX - bounds_.minX()) / cellWidth_);
+        int startRow = static_cast<int>((minY - bounds_.minY()) / cellHeight_);
+        int endRow = static_cast<int>((maxY - bounds_.minY()) / cellHeight_);
+        uint64_t colMask = (~0ULL >> (GRID_SIZE - 1 - endCol)) & (~0ULL << startCol);
+        for (int r = startRow; r <= endRow; r++)
+        {
+            if (rows_[r] & colMask) return true;
+        }
+        return false;
+    }
+
+private:
+    int col(Coordinate c) const
+    {
+        return static_cast<int>((static_cast<int64_t>(c.x) - bounds_.minX()) / cellWidth_);
+    }
+
+    int row(Coordinate c) const
+    {
+        return static_cast<int>((static_cast<int64_t>(c.y) - bounds_.minY()) / cellHeight_);
+    }
+
+    static uint64_t key(Coordinate c)
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) |
+            static_cast<uint32_t>(c.y);
+    }
+
+    std::vector<Coordinate> pending_;           // (until build())
+    clarisma::FlatHashSet<uint64_t> points_;    // 0 = null coordinate
+    Box bounds_;
+    int64_t cellWidth_;
+    int64_t cellHeight_;
+    uint64_t rows_[GRID_SIZE];    // bit n = column n
+};
+
+// \endcond
+
+} // namespace geodesk
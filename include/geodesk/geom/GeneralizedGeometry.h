@@ -0,0 +1,136 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/feature/WayPtr.h>
+#include <geodesk/geom/Coordinate.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Pre-simplified geometries of ways and area relations at several
+/// levels of detail, kept in an optional sidecar file next to the GOL
+/// (`<gol>.generalized`), created by build(). Like the RingStore, the
+/// geometries are only used if they belong to the same version of the
+/// GOL.
+///
+/// Level 0 is simplified (using Douglas-Peucker, see CoordinateFilter)
+/// with a tolerance of one pixel of a 256-pixel tile at zoom 12; each
+/// further level is meant for two zoom levels less (hence, its tolerance
+/// is 4 times larger). A writer that simplifies with a given tolerance
+/// starts with the coarsest level whose tolerance doesn't exceed it
+/// (see levelFor()), so at low zoom it only has to read a fraction of
+/// the coordinates.
+///
+/// A feature is only stored if it loses vertexes at one or more
+/// levels; a level at which it loses none (compared to the next finer
+/// level) shares that level's coordinates. If a feature (or a level)
+/// isn't stored, callers must use its full geometry.
+///
+/// Coordinates are delta-encoded as signed varints: a way is its
+/// vertex count followed by its coordinates, the rings of a relation
+/// are stored the same way as in the RingStore.
+///
+class GEODESK_API GeneralizedGeometry
+{
+public:
+    static constexpr int LEVEL_COUNT = 5;
+
+
+    GeneralizedGeometry(const GeneralizedGeometry&) = delete;
+    GeneralizedGeometry& operator=(const GeneralizedGeometry&) = delete;
+
+    /// Maps the simplified geometries that build() wrote to the given file.
+    ///
+    /// @return the geometries, or nullptr if not available
+    static std::unique_ptr<GeneralizedGeometry> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Simplifies every way and area relation in the store (on multiple
+    /// threads) and writes their geometries to the given file.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   store's query executor)
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize, int threads = 0);
+
+    /// The tolerance (in Mercator units) of the given level
+    static double levelTolerance(int level)
+    {
+        return static_cast<double>(1 << (12 + level * 2));
+    }
+
+    /// The zoom level the given level is meant for
+    static int levelZoom(int level) { return 12 - level * 2; }
+
+    /// Returns the coarsest level whose tolerance is no larger than
+    /// the given tolerance (in Mercator units), or -1 if there is none
+    static int levelFor(double tolerance);
+
+    /// The number of features that have generalized geometries
+    uint64_t featureCount() const { return featureCount_; }
+
+    /// Places the coordinates of a way at the given level into `coords`.
+    /// Safe to call from any thread.
+    ///
+    /// @return false if the sidecar doesn't have them (in which case
+    ///   `coords` is left unchanged)
+    bool wayCoordinates(WayPtr way, int level, std::vector<Coordinate>& coords) const;
+
+    /// Returns the rings of an area relation at the given level, or
+    /// nullptr if the sidecar doesn't have them. Safe to call from
+    /// any thread.
+    std::shared_ptr<const Polygonizer> relationRings(RelationPtr relation, int level) const;
+
+private:
+    GeneralizedGeometry() : entries_(nullptr),
+        featureCount_(0), data_(nullptr) {}
+
+    class Encoder;
+
+    static constexpr uint32_t MAGIC = 0x4765'6E5A;
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t NO_LEVEL = UINT64_MAX;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint64_t featureCount;
+        uint64_t dataSize;
+    };
+
+    struct Entry
+    {
+        uint64_t typedId;
+        uint64_t offsets[LEVEL_COUNT];  // relative to the start of the data,
+                                        // NO_LEVEL = full geometry
+    };
+
+    /// Returns the encoded geometry of a feature at the given level,
+    /// or nullptr if there is none
+    const uint8_t* find(FeaturePtr feature, int level) const;
+
+    SidecarFile file_;
+    const Entry* entries_;
+    uint64_t featureCount_;
+    const uint8_t* data_;
+};
+
+// \endcond
+
+} // namespace geodesk
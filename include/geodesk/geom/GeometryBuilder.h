@@ -5,10 +5,12 @@
 
 #ifdef GEODESK_WITH_GEOS
 
+#include <vector>
 #include <geos_c.h>
 #include <geodesk/feature/RelationPtr.h>
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
 
 namespace geodesk {
 
@@ -24,6 +26,16 @@ public:
 	static GEOSGeometry* buildRelationGeometry(FeatureStore *store, RelationPtr relation, GEOSContextHandle_t geosContext);
 	static GEOSGeometry* buildPointGeometry(int32_t x, int32_t y, GEOSContextHandle_t geosContext);
 	static GEOSGeometry* buildBoxGeometry(const Box& box, GEOSContextHandle_t geosContext);
+
+	/// Creates a 2D coordinate sequence in one call (rather than setting
+	/// each coordinate through the C API), using a per-thread buffer
+	/// for the conversion to `double` (requires GEOS 3.10 or above)
+	static GEOSCoordSequence* createCoordSequence(const Coordinate* coords,
+		size_t count, GEOSContextHandle_t geosContext);
+
+	/// A per-thread buffer for assembling the coordinates of a
+	/// geometry before calling createCoordSequence()
+	static std::vector<Coordinate>& scratchCoordinates();
 };
 
 
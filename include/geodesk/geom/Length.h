@@ -5,20 +5,52 @@
 
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TileCache.h>
 
 namespace geodesk {
 
 ///
 /// \cond lowlevel
 ///
+/// Measures the length (in meters) of ways and relations. Each segment
+/// is measured in Mercator units and scaled by the number of meters per
+/// unit at the latitude of its midpoint. By default, this scale is
+/// interpolated from a table of 1024 latitude bands (the scale only
+/// depends on the distance from the equator), which saves a cosh() per
+/// segment; since 1/cosh is smooth, linear interpolation between the
+/// band boundaries is off by at most MAX_TABLE_ERROR (relative), or
+/// about 1.2 millimeters per kilometer. Scale::EXACT calculates the
+/// scale of each segment instead.
+///
+/// The segments of a way are measured in blocks, as they come from the
+/// bulk decoder of WayCoordinateIterator, two at a time (using SSE2 on
+/// x86-64, with a portable fallback).
+///
 class GEODESK_API Length
 {
 public:
-	static double ofWay(WayPtr way);
-	static double ofRelation(FeatureStore* store, RelationPtr relation);
+	enum class Scale
+	{
+		FAST,		///< Interpolated from the table of latitude bands
+		EXACT		///< Calculated for each segment
+	};
+
+	/// The greatest relative error of Scale::FAST
+	static constexpr double MAX_TABLE_ERROR = 1.2e-6;
+
+	static double ofWay(WayPtr way, Scale scale = Scale::FAST);
+	static double minOfWay(WayPtr way);
+	static double ofRelation(FeatureStore* store, RelationPtr relation,
+		Scale scale = Scale::FAST);
+
+	/// Returns the length (in meters) of the polyline formed by the
+	/// given coordinates
+	static double ofCoords(const Coordinate* coords, int count,
+		Scale scale = Scale::FAST);
 
 private:
-	static double ofRelation(FeatureStore* store, RelationPtr rel, RecursionGuard& guard);
+	static double ofRelation(FeatureStore* store, RelationPtr rel,
+		RecursionGuard& guard, TileCache& tiles, Scale scale);
 };
 
 // \endcond
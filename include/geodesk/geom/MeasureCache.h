@@ -0,0 +1,83 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <geodesk/export.h>
+#include <geodesk/feature/RelationPtr.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A memo of the lengths and areas of relations, so that size filters
+/// used by repeated queries don't have to measure the same relations
+/// over and over (measuring a relation requires a walk of all its
+/// members, and polygonizing it in the case of areas). Ways are not
+/// memoized, since measuring a way is cheaper than a locked lookup.
+///
+/// An entry is only a few bytes, so rather than tracking the recency
+/// of each entry, the memo is simply cleared once it is full.
+///
+/// Enabled via FeatureStore::enableMeasureCache().
+///
+class GEODESK_API MeasureCache
+{
+public:
+    explicit MeasureCache(size_t maxBytes);
+
+    MeasureCache(const MeasureCache&) = delete;
+    MeasureCache& operator=(const MeasureCache&) = delete;
+
+    size_t maxBytes() const { return maxEntries_ * BYTES_PER_ENTRY; }
+    /// The approximate number of bytes occupied by the memo
+    size_t bytes();
+
+    /// Returns the length (in meters) of the given relation, measuring
+    /// it if necessary. Safe to call from any thread.
+    double length(FeatureStore* store, RelationPtr relation);
+
+    /// Returns the area (in square meters) of the given area relation,
+    /// measuring it if necessary. Safe to call from any thread.
+    double area(FeatureStore* store, RelationPtr relation);
+
+    /// Drops all values if the store has changed since they were
+    /// measured.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Returns the length of the given relation, taken from the
+    /// store's memo if it is enabled
+    static double lengthOf(FeatureStore* store, RelationPtr relation);
+
+    /// Returns the area of the given area relation, taken from the
+    /// store's memo if it is enabled
+    static double areaOf(FeatureStore* store, RelationPtr relation);
+
+private:
+    struct Entry
+    {
+        double length;      // NaN if not measured
+        double area;        // NaN if not measured
+    };
+
+    /// (including the approximate overhead of the map node)
+    static constexpr size_t BYTES_PER_ENTRY = sizeof(Entry) + 48;
+
+    template<typename Measure>
+    double get(int64_t id, double Entry::* field, Measure measure);
+
+    size_t maxEntries_;
+    std::mutex mutex_;
+    std::unordered_map<int64_t, Entry> entries_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
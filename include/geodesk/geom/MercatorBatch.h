@@ -0,0 +1,58 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <span>
+#include <geodesk/export.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Converts batches of WGS-84 coordinates into Mercator coordinates,
+/// and builds the bounding boxes for radius queries around batches of
+/// points.
+///
+/// Converting a latitude takes a log() and a tan(), which can cost more
+/// than the query it feeds. If the caller tolerates an error of a few
+/// imps, latitudes are instead interpolated (as a cubic Hermite spline)
+/// from a table of the projection at intervals of 0.1 degrees, with
+/// known error bounds for each interval. A latitude is only taken from
+/// the table if the bound of its interval lies within the tolerance, so
+/// a tolerance of 3 imps (about 3 cm at the equator) covers the full
+/// range of the projection (converting about 4 times as fast), while a
+/// tolerance below 1 imp always uses the exact formula. Pairs of points
+/// are converted with SSE2 on x86-64, with a portable fallback.
+///
+class GEODESK_API MercatorBatch
+{
+public:
+    /// Converts pairs of longitude and latitude (in degrees, interleaved
+    /// as lon, lat, lon, lat...) into coordinates, which are placed into
+    /// `out` (which must have room for half as many items as `lonLat`).
+    /// Latitudes are clamped to the range of the projection.
+    ///
+    /// @param maxError the greatest tolerated difference (in imps)
+    ///   from the result of Coordinate::ofLonLat()
+    ///
+    static void coordsFromLonLat(std::span<const double> lonLat,
+        std::span<Coordinate> out, double maxError = 0);
+
+    /// Places a box into `out` for each point, extending `units` imps
+    /// in each direction (like Box::unitsAroundXY())
+    static void boxesAroundXY(std::span<const Coordinate> points,
+        int32_t units, std::span<Box> out);
+
+    /// Places a box into `out` for each point, which covers all
+    /// locations within `meters` of the point (as PointDistanceFilter
+    /// does, the distance is converted at the point's latitude)
+    static void boxesAroundMeters(std::span<const Coordinate> points,
+        double meters, std::span<Box> out);
+};
+
+// \endcond
+
+} // namespace geodesk
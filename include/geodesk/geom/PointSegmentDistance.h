@@ -0,0 +1,172 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <limits>
+#include <geodesk/geom/Coordinate.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>  // Header for SSE2 intrinsics
+    #define GEODESK_DISTANCE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define GEODESK_DISTANCE_NEON
+#endif
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Measures the squared distance between a point and the segments of
+/// a polyline (such as a block of coordinates from the bulk decoder of
+/// WayCoordinateIterator), BATCH_SIZE segments at a time.
+///
+/// Uses SSE2 (baseline on x86-64) or NEON (baseline on AArch64),
+/// with a portable fallback. The segment is measured via the clamped
+/// projection of the point, which agrees with
+/// Distance::pointSegmentSquared() up to rounding.
+///
+class PointSegmentDistance
+{
+public:
+    static constexpr int BATCH_SIZE = 4;
+
+    explicit PointSegmentDistance(Coordinate point) :
+        px_(point.x),
+        py_(point.y)
+    {
+    #if defined(GEODESK_DISTANCE_SSE2)
+        pxv_ = _mm_set1_pd(px_);
+        pyv_ = _mm_set1_pd(py_);
+    #elif defined(GEODESK_DISTANCE_NEON)
+        pxv_ = vdupq_n_f64(px_);
+        pyv_ = vdupq_n_f64(py_);
+    #endif
+    }
+
+    /// Returns the smallest squared distance between the point and
+    /// the `count - 1` segments formed by consecutive coordinates,
+    /// or infinity if there are fewer than two coordinates. Stops as
+    /// soon as it finds a batch with a distance below `limit`, in
+    /// which case the result is an upper bound.
+    ///
+    double minSquared(const Coordinate* coords, int count, double limit = 0) const
+    {
+        double minDistance = std::numeric_limits<double>::infinity();
+        int segmentCount = count - 1;
+        int i = 0;
+        for (; i + BATCH_SIZE <= segmentCount; i += BATCH_SIZE)
+        {
+            minDistance = std::min(minDistance, batchSquared(coords + i));
+            if (minDistance < limit) return minDistance;
+        }
+        for (; i < segmentCount; i++)
+        {
+            minDistance = std::min(minDistance, segmentSquared(
+                coords[i].x, coords[i].y, coords[i+1].x, coords[i+1].y));
+        }
+        return minDistance;
+    }
+
+private:
+    /// Smallest distance to the BATCH_SIZE segments that start at `p`
+    double batchSquared(const Coordinate* p) const
+    {
+    #if defined(GEODESK_DISTANCE_SSE2)
+        __m128d d = _mm_min_pd(pairSquared(p), pairSquared(p + 2));
+        return std::min(_mm_cvtsd_f64(d), _mm_cvtsd_f64(_mm_unpackhi_pd(d, d)));
+    #elif defined(GEODESK_DISTANCE_NEON)
+        return vminvq_f64(vminq_f64(pairSquared(p), pairSquared(p + 2)));
+    #else
+        double d = segmentSquared(p[0].x, p[0].y, p[1].x, p[1].y);
+        for (int i = 1; i < BATCH_SIZE; i++)
+        {
+            d = std::min(d, segmentSquared(p[i].x, p[i].y, p[i+1].x, p[i+1].y));
+        }
+        return d;
+    #endif
+    }
+
+    double segmentSquared(double ax, double ay, double bx, double by) const
+    {
+        double dx = bx - ax;
+        double dy = by - ay;
+        double wx = px_ - ax;
+        double wy = py_ - ay;
+        double t = (wx * dx + wy * dy) / std::max(dx * dx + dy * dy, DBL_MIN);
+        t = std::min(std::max(t, 0.0), 1.0);
+        double ex = wx - t * dx;
+        double ey = wy - t * dy;
+        return ex * ex + ey * ey;
+    }
+
+#if defined(GEODESK_DISTANCE_SSE2)
+    /// Distances to the segments p[0]-p[1] and p[1]-p[2]
+    __m128d pairSquared(const Coordinate* p) const
+    {
+        // [x0 y0 x1 y1] and [x1 y1 x2 y2] --> [x0 x1 y0 y1] etc.
+        __m128i a = _mm_shuffle_epi32(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(p)), _MM_SHUFFLE(3,1,2,0));
+        __m128i b = _mm_shuffle_epi32(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(p + 1)), _MM_SHUFFLE(3,1,2,0));
+        __m128d ax = _mm_cvtepi32_pd(a);
+        __m128d ay = _mm_cvtepi32_pd(_mm_unpackhi_epi64(a, a));
+        __m128d bx = _mm_cvtepi32_pd(b);
+        __m128d by = _mm_cvtepi32_pd(_mm_unpackhi_epi64(b, b));
+
+        __m128d dx = _mm_sub_pd(bx, ax);
+        __m128d dy = _mm_sub_pd(by, ay);
+        __m128d wx = _mm_sub_pd(pxv_, ax);
+        __m128d wy = _mm_sub_pd(pyv_, ay);
+        __m128d lenSquared = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+        __m128d dot = _mm_add_pd(_mm_mul_pd(wx, dx), _mm_mul_pd(wy, dy));
+        __m128d t = _mm_div_pd(dot, _mm_max_pd(lenSquared, _mm_set1_pd(DBL_MIN)));
+        t = _mm_min_pd(_mm_max_pd(t, _mm_setzero_pd()), _mm_set1_pd(1.0));
+        __m128d ex = _mm_sub_pd(wx, _mm_mul_pd(t, dx));
+        __m128d ey = _mm_sub_pd(wy, _mm_mul_pd(t, dy));
+        return _mm_add_pd(_mm_mul_pd(ex, ex), _mm_mul_pd(ey, ey));
+    }
+
+    __m128d pxv_;
+    __m128d pyv_;
+#elif defined(GEODESK_DISTANCE_NEON)
+    static float64x2_t toDouble(int32x4_t v)
+    {
+        return vcvtq_f64_s64(vmovl_s32(vget_low_s32(v)));
+    }
+
+    /// Distances to the segments p[0]-p[1] and p[1]-p[2]
+    float64x2_t pairSquared(const Coordinate* p) const
+    {
+        int32x4_t a = vld1q_s32(reinterpret_cast<const int32_t*>(p));
+        int32x4_t b = vld1q_s32(reinterpret_cast<const int32_t*>(p + 1));
+        float64x2_t ax = toDouble(vuzp1q_s32(a, a));
+        float64x2_t ay = toDouble(vuzp2q_s32(a, a));
+        float64x2_t bx = toDouble(vuzp1q_s32(b, b));
+        float64x2_t by = toDouble(vuzp2q_s32(b, b));
+
+        float64x2_t dx = vsubq_f64(bx, ax);
+        float64x2_t dy = vsubq_f64(by, ay);
+        float64x2_t wx = vsubq_f64(pxv_, ax);
+        float64x2_t wy = vsubq_f64(pyv_, ay);
+        float64x2_t lenSquared = vaddq_f64(vmulq_f64(dx, dx), vmulq_f64(dy, dy));
+        float64x2_t dot = vaddq_f64(vmulq_f64(wx, dx), vmulq_f64(wy, dy));
+        float64x2_t t = vdivq_f64(dot, vmaxq_f64(lenSquared, vdupq_n_f64(DBL_MIN)));
+        t = vminq_f64(vmaxq_f64(t, vdupq_n_f64(0.0)), vdupq_n_f64(1.0));
+        float64x2_t ex = vsubq_f64(wx, vmulq_f64(t, dx));
+        float64x2_t ey = vsubq_f64(wy, vmulq_f64(t, dy));
+        return vaddq_f64(vmulq_f64(ex, ex), vmulq_f64(ey, ey));
+    }
+
+    float64x2_t pxv_;
+    float64x2_t pyv_;
+#endif
+    double px_;
+    double py_;
+};
+
+// \endcond
+
+} // namespace geodesk
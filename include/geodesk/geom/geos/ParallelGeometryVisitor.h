@@ -0,0 +1,69 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#ifdef GEODESK_WITH_GEOS
+
+#include <memory>
+#include <geos_c.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A TileReducer that builds the GEOS geometry of each feature on
+/// the worker thread that scans its tile, and passes it to a
+/// (thread-safe) callback as `fn(T feature, GEOSGeometry* geom,
+/// GEOSContextHandle_t context)`. The callback takes ownership of
+/// the geometry.
+///
+/// Each worker has a GEOS context of its own (the C API is only
+/// thread-safe with separate contexts), plus one for the thread
+/// that iterates the query (which is passed the features that
+/// live in multiple tiles). The contexts live as long as the visitor.
+///
+template <typename T, typename Fn>
+class ParallelGeometryVisitor : public TileReducer
+{
+public:
+    ParallelGeometryVisitor(int workerCount, Fn fn) :
+        fn_(fn),
+        workerCount_(workerCount),
+        contexts_(new Slot[workerCount + 1])
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        int worker = QueryExecutor::currentWorker();
+        GEOSContextHandle_t context = contexts_[
+            (worker >= 0 && worker < workerCount_) ? worker : workerCount_].context;
+        for (size_t i = 0; i < count; i++)
+        {
+            T feature(store, features[i]);
+            fn_(feature, feature.toGeometry(context), context);
+        }
+    }
+
+private:
+    struct alignas(64) Slot     // (padded to avoid false sharing)
+    {
+        Slot() : context(GEOS_init_r()) {}
+        ~Slot() { GEOS_finish_r(context); }
+
+        GEOSContextHandle_t context;
+    };
+
+    Fn fn_;
+    int workerCount_;
+    std::unique_ptr<Slot[]> contexts_;
+};
+
+// \endcond
+
+} // namespace geodesk
+
+#endif // GEODESK_WITH_GEOS
@@ -0,0 +1,46 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <span>
+#include <geodesk/geom/index/MonotoneChain.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+// TODO: Make this a template: Source, Iter
+//  template<typename Source, typename Iter>
+class CoordSpanSlicer
+{
+public:
+	CoordSpanSlicer(std::span<const Coordinate> coords);
+	bool hasMore() const { return hasMore_; }
+	void slice(MonotoneChain* chain, int maxVertexes);
+
+private:
+	class Iterator
+	{
+	public:
+		explicit Iterator(std::span<const Coordinate> coords) :
+			p_(coords.data()),
+			end_(coords.data() + coords.size())
+		{
+		}
+
+		int coordinatesRemaining() const { return static_cast<int>(end_ - p_); }
+		Coordinate next() { return *p_++; }
+
+	private:
+		const Coordinate* p_;
+		const Coordinate* end_;
+	};
+
+	// keep this order!
+	Iterator iter_;
+	Coordinate first_;
+	Coordinate second_;
+	bool hasMore_;
+};
+
+} // namespace geodesk
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/index/MCIndex.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// A grid laid over the bounds of a polygon, which labels each cell
+/// as lying inside, outside or on the boundary of the polygon. Used
+/// by prepared filters to accept or reject features whose bounding
+/// box falls into interior or exterior cells, without testing their
+/// geometry against the monotone chains of the polygon.
+///
+/// Cells are classified conservatively: any cell whose bounds intersect
+/// the bounding box of a chain counts as a boundary cell.
+///
+class CoverageGrid
+{
+public:
+    /// Creates an empty grid, for which locateBox() always returns 0
+    CoverageGrid() : cols_(0), rows_(0), cellWidth_(1), cellHeight_(1) {}
+
+    /// Builds a grid over the polygon represented by the index, if it
+    /// has enough chains to make the grid worthwhile (otherwise, the
+    /// grid is empty)
+    CoverageGrid(const MCIndex& index, const Box& bounds);
+
+    bool isEmpty() const { return cols_ == 0; }
+
+    /// Checks where the given box lies in respect to the polygon,
+    /// based on the cells it overlaps.
+    ///
+    /// @returns -1 = box definitely lies fully outside
+    ///           0 = unknown (box overlaps a boundary cell, or too many cells)
+    ///           1 = box definitely lies fully inside
+    ///
+    int locateBox(const Box& box) const;
+
+    /// Polygons with fewer chains don't get a grid
+    static constexpr size_t MIN_CHAIN_COUNT = 64;
+    /// The largest number of cells (in each direction) that
+    /// locateBox() checks
+    static constexpr int MAX_CELL_SPAN = 4;
+
+private:
+    enum Cell : int8_t
+    {
+        OUTSIDE = -1,
+        BOUNDARY = 0,
+        INSIDE = 1
+    };
+
+    Box cellBounds(int col, int row) const;
+    static bool anyChain(const RTree<const MonotoneChain>::Node* node, const Box* cell);
+
+    Box bounds_;
+    int cols_;
+    int rows_;
+    int64_t cellWidth_;
+    int64_t cellHeight_;
+    std::vector<Cell> cells_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,48 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+class MCIndex;
+
+/// \cond lowlevel
+///
+/// The monotone chains of an MCIndex as plain arrays (no pointers, no
+/// tree), so they can be copied to a device (such as a GPU) in one go
+/// and tested against many points in parallel. The vertexes of chain
+/// `i` are those from chainStarts[i] up to chainStarts[i + 1]; all
+/// chains are normalized (their Y-coordinates increase).
+///
+/// containsPoint() is the reference for device kernels: it counts
+/// crossings exactly like MCIndex::containsPoint() (so points on the
+/// boundary are inside), but tests every chain instead of descending
+/// the R-tree, which is what a device does best.
+///
+struct FlatChains
+{
+    std::vector<uint32_t> chainStarts;      // chain count + 1
+    std::vector<int32_t> minX;              // bounds of each chain
+    std::vector<int32_t> minY;
+    std::vector<int32_t> maxX;
+    std::vector<int32_t> maxY;
+    std::vector<int32_t> x;                 // vertexes of all chains
+    std::vector<int32_t> y;
+
+    size_t chainCount() const { return minX.size(); }
+
+    static FlatChains fromIndex(const MCIndex& index);
+
+    bool containsPoint(Coordinate c) const;
+    void containsPoints(std::span<const Coordinate> points, bool* results) const;
+};
+
+// \endcond
+
+} // namespace geodesk
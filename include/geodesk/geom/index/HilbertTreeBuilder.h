@@ -4,6 +4,7 @@
 #pragma once
 
 #include <vector>
+#include <geodesk/geom/index/PackedRTree.h>
 #include <geodesk/geom/index/RTree.h>
 #include <geodesk/geom/Box.h>
 #include <clarisma/alloc/Arena.h>
@@ -28,6 +29,18 @@ public:
 				buildNodes(items, itemCount, maxItemsPerNode, totalBounds)));
 	}
 
+	/// Builds a PackedRTree; `totalBounds` may be empty, in which case
+	/// it is calculated from the items
+	const PackedRTreeGroup* buildGroups(const BoundedItem* items, size_t itemCount,
+		Box totalBounds);
+
+	template <typename IT>
+	PackedRTree<IT> buildPacked(const BoundedItem* items, size_t itemCount,
+		Box totalBounds)
+	{
+		return PackedRTree<IT>(buildGroups(items, itemCount, totalBounds));
+	}
+
 private:
 	typedef std::pair<uint32_t, const BoundedItem*> HilbertItem;
 	
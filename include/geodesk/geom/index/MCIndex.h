@@ -2,7 +2,8 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
-#include <geodesk/geom/index/RTree.h>
+#include <span>
+#include <geodesk/geom/index/PackedRTree.h>
 
 namespace geodesk {
 
@@ -81,14 +82,14 @@ private:
 class MCIndex
 {
 public:
-	MCIndex() : data_(nullptr) {}
+	MCIndex() : data_(nullptr), chainCount_(0) {}
 	~MCIndex()
 	{
 		if (data_) delete[] data_;
 	}
 
-	MCIndex(const uint8_t* data, RTree<const MonotoneChain>&& index) : 
-		data_(data), index_(std::move(index))
+	MCIndex(const uint8_t* data, PackedRTree<const MonotoneChain>&& index, size_t chainCount) :
+		index_(std::move(index)), data_(data), chainCount_(chainCount)
 	{
 		assert(data);
 	}
@@ -97,8 +98,9 @@ public:
 	MCIndex(const MCIndex& other) = delete;
 	MCIndex& operator=(const MCIndex& other) = delete;
 	MCIndex(MCIndex&& other) noexcept : 
+		index_(std::move(other.index_)),
 		data_(other.data_), 
-		index_(std::move(other.index_))
+		chainCount_(other.chainCount_)
 	{
 		other.data_ = nullptr; // Prevent other from deallocating the memory
 	}
@@ -108,13 +110,28 @@ public:
 		index_ = std::move(other.index_);
 		if (this != &other && data_) delete data_; // Release currently owned memory (if any)
 		data_ = other.data_;
+		chainCount_ = other.chainCount_;
 		other.data_ = nullptr;
 		return *this;
 	}
 
+	size_t chainCount() const { return chainCount_; }
+
 	bool properlyContainsPoint(Coordinate c) const;
 	bool containsPoint(Coordinate c) const;	
 	bool pointOnBoundary(Coordinate c) const;
+
+	/**
+	 * Performs containsPoint() for each of the given points, storing
+	 * the results in `results` (which must have room for as many
+	 * values as there are points).
+	 *
+	 * Points are visited in Hilbert order and tested in groups, so
+	 * the R-tree is descended once per group of nearby points instead
+	 * of once per point. Much cheaper than testing points one by one
+	 * if they are clustered.
+	 */
+	void containsPoints(std::span<const Coordinate> points, bool* results) const;
 	bool intersects(const MonotoneChain* mc) const;
 
 	/**
@@ -147,6 +164,16 @@ public:
 	 */
 	int maybeLocateBox(const Box& box) const;
 
+	/**
+	 * Returns the squared distance between the given point and the
+	 * nearest segment of the indexed chains (infinity if the index is
+	 * empty). Only the chains near the point are measured: the search
+	 * starts with a box that extends `radius` units around the point
+	 * and widens until it is certain to contain the nearest segment
+	 * (a good guess for the radius saves searches).
+	 */
+	double distanceSquared(Coordinate c, double radius = 1) const;
+
 	// bool intersectsLineSegment(Coordinate start, Coordinate end) const;
 	
 	// -1 outside, 0 = boundary, 1 = inside
@@ -176,6 +203,16 @@ private:
 		PointLocation location;
 	};
 
+	struct DistanceClosure;
+
+	struct PointBatchClosure
+	{
+		const Coordinate* points;
+		const uint32_t* indexes;
+		PointLocation* locations;
+		int count;
+	};
+
 	static bool intersectsChain(const RTree<const MonotoneChain>::Node* node,
 		const MonotoneChain* candidate);
 	static bool intersectsBoxBoundary(const RTree<const MonotoneChain>::Node* node,
@@ -189,9 +226,16 @@ private:
 	*/
 	static bool countCrossings(const RTree<const MonotoneChain>::Node* node,
 		PointLocationClosure* closure);
-
-	RTree<const MonotoneChain> index_;
+	static bool measureChain(const RTree<const MonotoneChain>::Node* node,
+		DistanceClosure* closure);
+	static bool countBatchCrossings(const RTree<const MonotoneChain>::Node* node,
+		PointBatchClosure* closure);
+	static bool locateAgainstChain(const RTree<const MonotoneChain>::Node* node,
+		Coordinate c, PointLocation& location);
+
+	PackedRTree<const MonotoneChain> index_;
 	const uint8_t* data_;
+	size_t chainCount_;
 };
 
 
@@ -11,6 +11,9 @@
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/feature/RelationPtr.h>
 #include <clarisma/alloc/Arena.h>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace geodesk {
 
@@ -20,13 +23,28 @@ public:
 	MCIndexBuilder();
 	void addLineSegment(Coordinate start, Coordinate end);
 	void segmentizeWay(WayPtr way);
+	void segmentizeCoords(std::span<const Coordinate> coords);
 	#ifdef GEODESK_WITH_GEOS
 	void segmentizeCoords(GEOSContextHandle_t context, const GEOSCoordSequence* coords);
 	void segmentizePolygon(GEOSContextHandle_t context, const GEOSGeometry* polygon);
 	#endif
 	void segmentizeAreaRelation(FeatureStore* store, RelationPtr rel);
 	void segmentizeMembers(FeatureStore* store, RelationPtr rel, RecursionGuard& guard);
+	/// Adds the node members of the relation (and of its child relations)
+	/// as zero-length segments
+	void segmentizeMemberNodes(FeatureStore* store, RelationPtr rel, RecursionGuard& guard);
 	MCIndex build(Box bounds);
+
+	size_t chainCount() const { return chainCount_; }
+
+	/// The approximate number of bytes used by the index that build()
+	/// creates (chains, plus the node groups of the R-tree, which
+	/// number about 1/7 of the chains)
+	size_t indexSize() const
+	{
+		return totalChainSize_ + (chainCount_ / 7 + 1) * sizeof(PackedRTreeGroup);
+	}
+
 	static MCIndex buildFromAreaRelation(FeatureStore* store, RelationPtr rel)
 	{
 		MCIndexBuilder builder;
@@ -38,6 +56,13 @@ private:
 	// static const size_t CHUNK_SIZE = 32 * 1024;
 	static const int MAX_VERTEX_COUNT = 256;
 
+	/// Relations with at least this many member ways have their ways
+	/// sliced into chains on multiple threads
+	static const size_t MIN_PARALLEL_WAY_COUNT = 256;
+	static const size_t MIN_WAYS_PER_THREAD = 64;
+
+	void segmentizeWaysParallel(const std::vector<WayPtr>& ways, int threadCount);
+
 	class MCHolder 
 	{
 	public:
@@ -56,6 +81,8 @@ private:
 	size_t totalChainSize_;
 	const MCHolder* first_;
 	clarisma::Arena arena_;
+	std::vector<std::unique_ptr<MCIndexBuilder>> parts_;
+		// (builders whose chains were created by other threads)
 };
 
 } // namespace geodesk
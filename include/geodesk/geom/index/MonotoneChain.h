@@ -60,6 +60,7 @@ public:
 
     Coordinate first() const { return coords[0]; }
     Coordinate last() const  { return coords[coordCount-1]; }
+    const Coordinate* coordinates() const { return coords; }
 
 private:
     void copyCoordinates(Coordinate* dest, int direction) const;
@@ -69,6 +70,7 @@ private:
 
     friend class WaySlicer;
     friend class CoordSequenceSlicer;
+    friend class CoordSpanSlicer;
 };
 
 } // namespace geodesk
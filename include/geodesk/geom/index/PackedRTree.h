@@ -0,0 +1,141 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+#include <cstdint>
+#include <clarisma/util/Bits.h>
+#include <geodesk/geom/BoxTester.h>
+#include <geodesk/geom/index/RTree.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// The children of a node of a PackedRTree. Their bounds are stored
+/// as separate arrays of minX, minY, maxX and maxY (rather than as an
+/// array of Box), so a query can test all children at once.
+///
+struct alignas(16) PackedRTreeGroup
+{
+	static constexpr int SIZE = 8;
+
+	int32_t minX[SIZE];
+	int32_t minY[SIZE];
+	int32_t maxX[SIZE];
+	int32_t maxY[SIZE];
+	const void* children[SIZE];		// child groups, or items if leaf
+	uint32_t count;
+	uint32_t isLeaf;
+
+	Box bounds(int i) const
+	{
+		return Box(minX[i], minY[i], maxX[i], maxY[i]);
+	}
+};
+
+/// A read-only R-tree with the same search interface as RTree, but
+/// with a fixed fan-out of 8 and bounds stored in struct-of-arrays
+/// form, which lets each step of a search test 8 children using
+/// two vectorized compares (see BoxTester).
+///
+/// The search function receives an RTree<IT>::Node that is filled in
+/// for each matching item, so it can be shared with RTree searches
+/// (Don't hold on to the Node after the function returns).
+///
+/// Built by HilbertTreeBuilder::buildPacked().
+///
+template <typename IT>
+class PackedRTree
+{
+public:
+	using Node = typename RTree<IT>::Node;
+	using Group = PackedRTreeGroup;
+
+	template <typename QT>
+	using SearchFunction = typename RTree<IT>::template SearchFunction<QT>;
+
+	PackedRTree() : root_(nullptr) {}
+	~PackedRTree() { if (root_) delete[] root_; }		// root_ is an array
+
+	explicit PackedRTree(const Group* root) : root_(root) {}
+
+	// Disable copy semantics as PackedRTree owns resources
+	PackedRTree(const PackedRTree& other) = delete;
+	PackedRTree& operator=(const PackedRTree& other) = delete;
+	PackedRTree(PackedRTree&& other) noexcept : root_(other.root_)
+	{
+		other.root_ = nullptr; // Prevent other from deallocating the memory
+	}
+
+	PackedRTree& operator=(PackedRTree&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (root_) delete[] root_;
+			root_ = other.root_;
+			other.root_ = nullptr;
+		}
+		return *this;
+	}
+
+	const Group* root() const { return root_; }
+
+	template <typename QT>
+	bool search(const Box& box, SearchFunction<QT> func, QT closure) const
+	{
+		if (!root_) return false;
+		Query<QT> query(box, func, closure);
+		return searchGroup(query, root_);
+	}
+
+private:
+	template <typename QT>
+	struct Query
+	{
+		Query(const Box& box, SearchFunction<QT> func, QT closure) :
+			tester(box),
+			func(func),
+			closure(closure)
+		{
+		}
+
+		BoxTester tester;
+		SearchFunction<QT> func;
+		QT closure;
+	};
+
+	template <typename QT>
+	static bool searchGroup(const Query<QT>& query, const Group* g)
+	{
+		static_assert(Group::SIZE == BoxTester::BATCH_SIZE * 2);
+		uint32_t candidates =
+			query.tester.intersects(g->minX, g->minY, g->maxX, g->maxY) |
+			(query.tester.intersects(g->minX + 4, g->minY + 4,
+				g->maxX + 4, g->maxY + 4) << 4);
+		candidates &= (1u << g->count) - 1;
+		while (candidates)
+		{
+			int i = clarisma::Bits::countTrailingZerosInNonZero(candidates);
+			candidates &= candidates - 1;
+			if (g->isLeaf)
+			{
+				Node node;
+				node.init(g->bounds(i), g->children[i], 0);
+				if ((*query.func)(&node, query.closure)) return true;
+			}
+			else
+			{
+				if (searchGroup(query, static_cast<const Group*>(g->children[i])))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	const Group* root_;
+};
+
+// \endcond
+} // namespace geodesk
@@ -0,0 +1,103 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/geom/index/MCIndex.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Measures the area of the intersection between polygons and a
+/// fixed region (e.g. "the share of a district that is covered by
+/// forest"), without building GEOS geometries.
+///
+/// The region is prepared once, as an MCIndex of its rings. For each
+/// polygon, rings that lie entirely inside the region count with their
+/// full area; the others are clipped against the region, segment by
+/// segment. By Green's theorem, the area of the intersection is the
+/// sum of the boundary pieces of the polygon that lie inside the
+/// region, plus the boundary pieces of the region that lie inside the
+/// polygon (where boundaries coincide, they count once if the two
+/// interiors are on the same side, otherwise not at all).
+///
+/// An AreaClipper is immutable once constructed; its methods can be
+/// called from multiple threads at once (e.g. from the map function
+/// of Features::reduce(), which runs on the worker threads that scan
+/// the tiles).
+///
+class GEODESK_API AreaClipper
+{
+public:
+    /// Uses the given area (way or relation) as the region. If the
+    /// feature isn't an area, the region is empty.
+    AreaClipper(FeatureStore* store, FeaturePtr region);
+
+    /// Uses the polygon formed by the given rings as the region (the
+    /// rings need not be closed; the caller retains ownership)
+    explicit AreaClipper(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes = {});
+
+    const Box& bounds() const { return bounds_; }
+    bool isEmpty() const { return bounds_.isEmpty(); }
+
+    /// Returns the area (in square meters) of the part of the given
+    /// feature that lies within the region, or 0 if the feature is
+    /// not an area. The scale is applied at the center of the
+    /// feature's bounding box, consistent with Area::ofWay() and
+    /// Area::ofRelation().
+    double areaOf(FeatureStore* store, FeaturePtr feature) const;
+
+    /// Returns the area (in squared Mercator units) of the part of the
+    /// given feature that lies within the region.
+    double mercatorAreaOf(FeatureStore* store, FeaturePtr feature) const;
+
+    /// Returns the area (in squared Mercator units) of the part of the
+    /// polygon formed by the given rings that lies within the region.
+    double mercatorAreaOf(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes = {}) const;
+
+private:
+    /// Closed rings, oriented so that the interior lies to the left
+    /// (outer rings counter-clockwise, holes clockwise)
+    struct Rings
+    {
+        void add(std::vector<Coordinate>& ring, bool isOuter);
+        size_t count() const { return ends.size(); }
+        std::span<const Coordinate> ring(size_t i) const
+        {
+            uint32_t start = i == 0 ? 0 : ends[i - 1];
+            return { coords.data() + start, ends[i] - start };
+        }
+
+        std::vector<Coordinate> coords;
+        std::vector<uint32_t> ends;
+        Box bounds;
+    };
+
+    static Rings ringsOf(FeatureStore* store, FeaturePtr feature);
+    static Rings ringsOf(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes);
+    void prepare(Rings&& region);
+    double clip(const Rings& rings) const;
+    bool isReversed(const MonotoneChain* chain) const;
+
+    Box bounds_;
+    MCIndex index_;
+    /// The chains of the index that run against the orientation of
+    /// their ring (MCIndex normalizes all chains to run northward),
+    /// sorted by address
+    std::vector<const MonotoneChain*> reversedChains_;
+};
+
+// \endcond
+
+} // namespace geodesk
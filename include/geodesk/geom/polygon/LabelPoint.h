@@ -0,0 +1,65 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <span>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class MCIndex;
+
+/// \cond lowlevel
+///
+/// Finds the place for the label of an area: its pole of
+/// inaccessibility, i.e. the point inside the area that lies farthest
+/// from its boundary. Unlike the centroid, this point lies inside even
+/// if the area is concave or has holes.
+///
+/// The rings of the area (as assembled by the Polygonizer) are indexed
+/// as an MCIndex, which measures the distance from a point to the
+/// nearest boundary segment. The search (the "polylabel" algorithm)
+/// covers the area's bounds with square cells and keeps splitting the
+/// most promising one, skipping any cell that can't contain a point
+/// that is farther from the boundary (by more than the precision) than
+/// the best point found so far.
+///
+class GEODESK_API LabelPoint
+{
+public:
+    /// The precision (in meters) used by ofFeature()
+    static constexpr double DEFAULT_PRECISION = 1.0;
+
+    /// Returns the label point of the given feature: the pole of
+    /// inaccessibility of an area (taken from the store's
+    /// LabelPointCache, if enabled), the location of a node, or the
+    /// centroid of any other feature.
+    static Coordinate ofFeature(FeatureStore* store, FeaturePtr feature);
+
+    /// Finds the pole of inaccessibility of the given area (way or
+    /// relation), to within `precision` meters. Returns the area's
+    /// centroid if it has no rings.
+    static Coordinate ofArea(FeatureStore* store, FeaturePtr area,
+        double precision = DEFAULT_PRECISION);
+
+    /// Finds the pole of inaccessibility of the polygon formed by the
+    /// given rings, to within `precision` Mercator units (the rings
+    /// need not be closed).
+    static Coordinate ofRings(std::span<const Coordinate> shell,
+        std::span<const std::vector<Coordinate>> holes = {},
+        double precision = 1);
+
+private:
+    static Coordinate search(const MCIndex& index, const Box& bounds,
+        Coordinate guess, double precision);
+};
+
+// \endcond
+
+} // namespace geodesk
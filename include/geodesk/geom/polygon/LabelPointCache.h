@@ -0,0 +1,59 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A memo of the label points of areas (see LabelPoint), so that maps
+/// that are rendered over and over don't have to search for the same
+/// points again. Like MeasureCache, the memo is simply cleared once it
+/// is full.
+///
+/// Enabled via FeatureStore::enableLabelPointCache().
+///
+class GEODESK_API LabelPointCache
+{
+public:
+    explicit LabelPointCache(size_t maxBytes);
+
+    LabelPointCache(const LabelPointCache&) = delete;
+    LabelPointCache& operator=(const LabelPointCache&) = delete;
+
+    size_t maxBytes() const { return maxEntries_ * BYTES_PER_ENTRY; }
+    /// The approximate number of bytes occupied by the memo
+    size_t bytes();
+
+    /// Returns the label point of the given area (way or relation),
+    /// finding it if necessary. Safe to call from any thread.
+    Coordinate get(FeatureStore* store, FeaturePtr area);
+
+    /// Drops all points if the store has changed since they were
+    /// found.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+private:
+    /// (including the approximate overhead of the map node)
+    static constexpr size_t BYTES_PER_ENTRY = sizeof(Coordinate) + 48;
+
+    size_t maxEntries_;
+    std::mutex mutex_;
+    std::unordered_map<int64_t, Coordinate> entries_;    // keyed by idBits
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -3,9 +3,17 @@
 
 #pragma once
 
+#include <clarisma/util/Bits.h>
 #include <geodesk/feature/FastMemberIterator.h>
 #include <geodesk/feature/WayCoordinateIterator.h>
 #include <geodesk/geom/LineSegment.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>  // Header for SSE2 intrinsics
+    #define GEODESK_PIP_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #include <arm_neon.h>
+    #define GEODESK_PIP_NEON
+#endif
 
 namespace geodesk {
 
@@ -46,27 +54,49 @@ public:
 			return false;
 		}
 		WayCoordinateIterator iter(way);
-		Coordinate prev = iter.next();
+		Coordinate coords[WayCoordinateIterator::BATCH_SIZE + 1];
+		int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE + 1);
+		if (count == 0) return false;
 		for (;;)
 		{
-			Coordinate next = iter.next();
-			if (next.isNull()) break;
+			if (testAgainstCoordinates(coords, count)) return true;
+			coords[0] = coords[count - 1];
+				// (the next batch starts with the last coordinate of this one)
+			int n = iter.decode(coords + 1, WayCoordinateIterator::BATCH_SIZE);
+			if (n == 0) break;
+			count = n + 1;
+		}
+		return false;
+	}
 
-			// we normalize the vector so it always points upwards
-			Coordinate start = prev.y < next.y ? prev : next;
-			Coordinate end = prev.y < next.y ? next : prev;
-			
-			if (point_.y >= start.y && point_.y <= end.y)
+	/**
+	 * Adds the number of times a ray cast from the test point crosses
+	 * the segments formed by consecutive coordinates. Segments are
+	 * screened four at a time (using SSE2 or NEON, where available),
+	 * and only those that span the point's Y-coordinate are tested
+	 * further.
+	 *
+	 * @return true if point lies on boundary, else false.
+	 */
+	bool testAgainstCoordinates(const Coordinate* coords, int count)
+	{
+		int segmentCount = count - 1;
+		int i = 0;
+	#if defined(GEODESK_PIP_SSE2) || defined(GEODESK_PIP_NEON)
+		for (; i + 4 <= segmentCount; i += 4)
+		{
+			uint32_t candidates = spanningSegments(coords + i);
+			while (candidates)
 			{
-				// TODO: this could be more efficient
-
-				int orientation = LineSegment::orientation(start, end, point_);
-				if (orientation == 0) return true;
-				crossingCount_ += orientation > 0 ?
-					((point_.y == start.y || point_.y == end.y) ? 1 : 2) : 0;
-				// We count a ray crossing through a vertex as one-half
+				int n = clarisma::Bits::countTrailingZerosInNonZero(candidates);
+				candidates &= candidates - 1;
+				if (testAgainstSegment(coords[i + n], coords[i + n + 1])) return true;
 			}
-			prev = next;
+		}
+	#endif
+		for (; i < segmentCount; i++)
+		{
+			if (testAgainstSegment(coords[i], coords[i + 1])) return true;
 		}
 		return false;
 	}
@@ -90,6 +120,59 @@ public:
 	}
 
 private:
+	bool testAgainstSegment(Coordinate prev, Coordinate next)
+	{
+		// we normalize the vector so it always points upwards
+		Coordinate start = prev.y < next.y ? prev : next;
+		Coordinate end = prev.y < next.y ? next : prev;
+
+		if (point_.y >= start.y && point_.y <= end.y)
+		{
+			// TODO: this could be more efficient
+
+			int orientation = LineSegment::orientation(start, end, point_);
+			if (orientation == 0) return true;
+			crossingCount_ += orientation > 0 ?
+				((point_.y == start.y || point_.y == end.y) ? 1 : 2) : 0;
+			// We count a ray crossing through a vertex as one-half
+		}
+		return false;
+	}
+
+#if defined(GEODESK_PIP_SSE2)
+	/// Returns a bit mask of the 4 segments starting at `p` whose
+	/// Y-range includes the point's Y-coordinate
+	uint32_t spanningSegments(const Coordinate* p) const
+	{
+		__m128i starts1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i starts2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2));
+		__m128i ends1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+		__m128i ends2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 3));
+		// [x0 y0 x1 y1] and [x2 y2 x3 y3] --> [y0 y1 y2 y3]
+		__m128i startY = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(starts1),
+			_mm_castsi128_ps(starts2), _MM_SHUFFLE(3,1,3,1)));
+		__m128i endY = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(ends1),
+			_mm_castsi128_ps(ends2), _MM_SHUFFLE(3,1,3,1)));
+		__m128i y = _mm_set1_epi32(point_.y);
+		__m128i above = _mm_and_si128(_mm_cmpgt_epi32(startY, y), _mm_cmpgt_epi32(endY, y));
+		__m128i below = _mm_and_si128(_mm_cmplt_epi32(startY, y), _mm_cmplt_epi32(endY, y));
+		return ~_mm_movemask_ps(_mm_castsi128_ps(_mm_or_si128(above, below))) & 0xf;
+	}
+#elif defined(GEODESK_PIP_NEON)
+	/// Returns a bit mask of the 4 segments starting at `p` whose
+	/// Y-range includes the point's Y-coordinate
+	uint32_t spanningSegments(const Coordinate* p) const
+	{
+		int32x4_t startY = vld2q_s32(reinterpret_cast<const int32_t*>(p)).val[1];
+		int32x4_t endY = vld2q_s32(reinterpret_cast<const int32_t*>(p + 1)).val[1];
+		int32x4_t y = vdupq_n_s32(point_.y);
+		uint32x4_t above = vandq_u32(vcgtq_s32(startY, y), vcgtq_s32(endY, y));
+		uint32x4_t below = vandq_u32(vcltq_s32(startY, y), vcltq_s32(endY, y));
+		static const uint32_t BITS[4] = { 1, 2, 4, 8 };
+		return vaddvq_u32(vandq_u32(vmvnq_u32(vorrq_u32(above, below)), vld1q_u32(BITS)));
+	}
+#endif
+
 	Coordinate point_;
 	uint32_t crossingCount_;
 };
@@ -65,6 +65,14 @@ public:
     /// have been called.
     ///
     void assignAndMergeHoles();
+
+    /// @brief Calls `fn(ring, isOuter)` for each outer and inner ring,
+    /// whether or not the inner rings have been assigned to their
+    /// outer rings (defined in Ring.h).
+    ///
+    template<typename Fn>
+    void forEachRing(Fn&& fn) const;
+
     #ifdef GEODESK_WITH_GEOS
     GEOSGeometry* createPolygonal(GEOSContextHandle_t context);
     #endif
@@ -85,6 +93,8 @@ private:
     Ring* outerRings_;
     Ring* innerRings_;
 
+    friend class RingCache;
+    friend class RingStore;
     friend class RingCoordinateIterator;
 };
 
@@ -0,0 +1,84 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <geodesk/export.h>
+#include <geodesk/feature/RelationPtr.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// A cache of the assembled rings of area relations, so that repeated
+/// operations on the same relation (area, centroid, export as GeoJSON
+/// or WKT, etc.) don't have to polygonize it each time. Rings are kept
+/// (with inner rings assigned to their outer rings, and touching holes
+/// merged) until evicted, least recently used first, to stay within
+/// a budget of bytes.
+///
+/// Enabled via FeatureStore::enableRingCache().
+///
+class GEODESK_API RingCache
+{
+public:
+    using RingsRef = std::shared_ptr<const Polygonizer>;
+
+    explicit RingCache(size_t maxBytes);
+
+    RingCache(const RingCache&) = delete;
+    RingCache& operator=(const RingCache&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    /// The approximate number of bytes occupied by the cached rings
+    size_t bytes();
+
+    /// Returns the rings of the given area relation, assembling them
+    /// if necessary. Safe to call from any thread.
+    RingsRef get(FeatureStore* store, RelationPtr relation);
+
+    /// Drops all rings if the store has changed since they were
+    /// assembled.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Returns the rings of the given area relation, taken from the
+    /// store's ring cache if it is enabled. Otherwise, the rings are
+    /// decoded from the store's RingStore (if it has one) or assembled
+    /// anew; in the latter case, inner rings are only assigned to
+    /// their outer rings if `assignHoles` is true (callers that don't
+    /// need this must visit the rings via Polygonizer::forEachRing()).
+    static RingsRef polygonize(FeatureStore* store, RelationPtr relation,
+        bool assignHoles = true);
+
+private:
+    struct Entry
+    {
+        int64_t id;
+        RingsRef rings;
+        size_t bytes;
+    };
+
+    static RingsRef assemble(FeatureStore* store, RelationPtr relation,
+        bool assignHoles);
+    static size_t bytesOf(const Polygonizer& rings);
+
+    size_t maxBytes_;
+    std::mutex mutex_;
+    std::list<Entry> entries_;          // most recently used first
+    std::unordered_map<int64_t, std::list<Entry>::iterator> ids_;
+    size_t bytes_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
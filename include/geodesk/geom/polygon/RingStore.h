@@ -0,0 +1,98 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <geodesk/export.h>
+#include <geodesk/feature/SidecarFile.h>
+#include <geodesk/geom/polygon/Polygonizer.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// The assembled rings of all area relations, kept in an optional
+/// sidecar file next to the GOL (`<gol>.rings`), created by build().
+/// Like the tile statistics, the rings are only used if they belong
+/// to the same version of the GOL.
+///
+/// The rings of each relation are stored the way RingCache would hold
+/// them (inner rings assigned to their outer rings, touching holes
+/// merged), so operations like area, centroid or export as GeoJSON/WKT
+/// only need to decode the coordinates instead of polygonizing the
+/// relation's member ways. Coordinates are delta-encoded as signed
+/// varints; relations are found via a table of IDs, sorted so they
+/// can be looked up with a binary search.
+///
+class GEODESK_API RingStore
+{
+public:
+    RingStore(const RingStore&) = delete;
+    RingStore& operator=(const RingStore&) = delete;
+
+    /// Maps the assembled rings that build() wrote to the given file.
+    ///
+    /// @return the rings, or nullptr if not available
+    static std::unique_ptr<RingStore> open(const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize);
+
+    /// Polygonizes every area relation in the store (on multiple
+    /// threads) and writes their rings to the given file.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   store's query executor)
+    static void build(FeatureStore* store, const std::string& fileName,
+        uint64_t storeTimestamp, uint64_t storeSize, int threads = 0);
+
+    /// The number of relations whose rings are stored
+    uint64_t relationCount() const { return relationCount_; }
+
+    /// Returns the rings of the area relation with the given ID, or
+    /// nullptr if the sidecar doesn't have them. Safe to call from
+    /// any thread.
+    std::shared_ptr<const Polygonizer> get(uint64_t relationId) const;
+
+    /// Decodes rings that were stored in the format of this sidecar
+    /// (see Decoder), which GeneralizedGeometry uses as well.
+    static std::shared_ptr<const Polygonizer> decode(const uint8_t* data);
+
+private:
+    RingStore() : entries_(nullptr),
+        relationCount_(0), data_(nullptr) {}
+
+    class Encoder;
+    class Decoder;
+
+    static constexpr uint32_t MAGIC = 0x2196'5C0D;
+    static constexpr uint32_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t storeTimestamp;
+        uint64_t storeSize;
+        uint64_t relationCount;
+        uint64_t dataSize;
+    };
+
+    struct Entry
+    {
+        uint64_t id;
+        uint64_t offset;        // relative to the start of the ring data
+    };
+
+    SidecarFile file_;
+    const Entry* entries_;
+    uint64_t relationCount_;
+    const uint8_t* data_;
+};
+
+// \endcond
+
+} // namespace geodesk
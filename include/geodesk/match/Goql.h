@@ -0,0 +1,441 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/match/Matcher.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A GOQL query used as a template argument (see GOQL())
+template<size_t N>
+struct GoqlLiteral
+{
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    consteval GoqlLiteral(const char (&s)[N])
+    {
+        for (size_t i = 0; i < N; i++) chars[i] = s[i];
+    }
+
+    constexpr std::string_view view() const { return { chars, N - 1 }; }
+
+    char chars[N];
+};
+
+/// A single GOQL selector, parsed at compile time. Strings are
+/// stored as ranges of the query text, since they can only be turned
+/// into global-string codes once the query is bound to a FeatureStore.
+///
+/// Only the shapes that account for nearly all queries are parsed:
+/// one selector whose clauses are `[k]`, `[!k]`, `[k=v,...]` or
+/// `[k!=v,...]`, with plain (non-numeric, non-wildcard) values. Any
+/// other query (several selectors, comparisons, regexes, numbers)
+/// sets `runtimeOnly`, which leaves it to the MatcherCompiler.
+/// Malformed queries are rejected at compile time.
+///
+struct GoqlSelector
+{
+    static constexpr int MAX_CLAUSES = 8;
+    static constexpr int MAX_VALUES = 8;
+
+    enum class Op : uint8_t
+    {
+        HAS_KEY,        // [k]      key present, value not "no"
+        LACKS_KEY,      // [!k]     key absent, or value "no"
+        EQ,             // [k=v]    value is one of the given strings
+        NE              // [k!=v]   key absent, or value none of these
+    };
+
+    struct Range
+    {
+        uint16_t start = 0;
+        uint16_t len = 0;
+    };
+
+    struct Clause
+    {
+        Op op = Op::HAS_KEY;
+        uint8_t valueCount = 0;
+        Range key;
+        Range values[MAX_VALUES];
+    };
+
+    uint32_t types = FeatureTypes::ALL;
+    bool runtimeOnly = false;
+    int clauseCount = 0;
+    Clause clauses[MAX_CLAUSES];
+};
+
+/// The consteval counterpart of the MatcherParser. A syntax error
+/// turns into a compile error (throwing during constant evaluation
+/// is ill-formed), whose diagnostic includes the message.
+///
+class GoqlParser
+{
+public:
+    consteval explicit GoqlParser(std::string_view query) :
+        s_(query), pos_(0) {}
+
+    consteval GoqlSelector parse()
+    {
+        GoqlSelector sel;
+        skipWhitespace();
+        uint32_t types = matchTypes();
+        if (types == 0)
+        {
+            if (peek() != '[') error("Expected selector");
+            types = FeatureTypes::ALL;
+        }
+        sel.types = types;
+        while (accept('['))
+        {
+            if (!expectClause(sel)) return runtimeOnly(sel);
+        }
+        if (peek() == ',') return runtimeOnly(sel);     // several selectors
+        if (pos_ != s_.size()) error("Expected [ or ,");
+        return sel;
+    }
+
+private:
+    // Not constexpr, so calling it stops constant evaluation
+    static void error(const char* msg)
+    {
+        throw std::invalid_argument(msg);
+    }
+
+    static consteval GoqlSelector runtimeOnly(GoqlSelector sel)
+    {
+        sel.runtimeOnly = true;
+        sel.clauseCount = 0;
+        return sel;
+    }
+
+    consteval char peek() const
+    {
+        return pos_ < s_.size() ? s_[pos_] : 0;
+    }
+
+    consteval void skipWhitespace()
+    {
+        while (peek() == ' ' || peek() == '\t' || peek() == '\n' || peek() == '\r') pos_++;
+    }
+
+    consteval bool accept(char ch)
+    {
+        if (peek() != ch) return false;
+        pos_++;
+        skipWhitespace();
+        return true;
+    }
+
+    static consteval bool isIdentifierChar(char ch)
+    {
+        return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') ||
+            (ch >= '0' && ch <= '9') || ch == '_' || ch == ':' ||
+            static_cast<unsigned char>(ch) >= 0x80;
+    }
+
+    consteval uint32_t matchTypes()
+    {
+        if (peek() == '*')
+        {
+            pos_++;
+            skipWhitespace();
+            return FeatureTypes::ALL;
+        }
+        uint32_t types = 0;
+        for (;;)
+        {
+            uint32_t t;
+            switch (peek())
+            {
+            case 'n': t = FeatureTypes::NODES; break;
+            case 'w': t = FeatureTypes::NONAREA_WAYS; break;
+            case 'a': t = FeatureTypes::AREAS; break;
+            case 'r': t = FeatureTypes::NONAREA_RELATIONS; break;
+            default:
+                skipWhitespace();
+                return types;
+            }
+            if (types & t) error("Type specified more than once");
+            types |= t;
+            pos_++;
+        }
+    }
+
+    /// Parses a key or value (an identifier or a quoted string).
+    /// Returns false if the string has escapes or wildcards, which
+    /// the MatcherCompiler must handle.
+    consteval bool expectString(GoqlSelector::Range& range, const char* what)
+    {
+        size_t start = pos_;
+        char quote = peek();
+        if (quote == '\'' || quote == '\"')
+        {
+            pos_++;
+            start = pos_;
+            while (peek() != quote)
+            {
+                if (pos_ >= s_.size()) error("Unterminated string");
+                if (peek() == '\\') return false;
+                pos_++;
+            }
+            range = { static_cast<uint16_t>(start), static_cast<uint16_t>(pos_ - start) };
+            pos_++;
+        }
+        else
+        {
+            while (isIdentifierChar(peek())) pos_++;
+            if (pos_ == start)
+            {
+                if (peek() == '*') return false;
+                error(what);
+            }
+            if (peek() == '*') return false;    // wildcard
+            range = { static_cast<uint16_t>(start), static_cast<uint16_t>(pos_ - start) };
+        }
+        skipWhitespace();
+        return true;
+    }
+
+    consteval bool expectValues(GoqlSelector::Clause& clause)
+    {
+        do
+        {
+            char first = peek();
+            if ((first >= '0' && first <= '9') || first == '-' ||
+                first == '+' || first == '.')
+            {
+                return false;       // numbers are compared by value
+            }
+            if (clause.valueCount == GoqlSelector::MAX_VALUES) return false;
+            GoqlSelector::Range& value = clause.values[clause.valueCount++];
+            if (!expectString(value, "Expected value")) return false;
+            if (value.len > 0 && (s_[value.start] == '*' ||
+                s_[value.start + value.len - 1] == '*'))
+            {
+                return false;       // wildcard
+            }
+            if (isIdentifierChar(peek())) return false;     // several words
+        }
+        while (accept(','));
+        return true;
+    }
+
+    consteval bool expectClause(GoqlSelector& sel)
+    {
+        if (sel.clauseCount == GoqlSelector::MAX_CLAUSES) return false;
+        GoqlSelector::Clause& clause = sel.clauses[sel.clauseCount++];
+        if (accept('!'))
+        {
+            clause.op = GoqlSelector::Op::LACKS_KEY;
+            if (!expectString(clause.key, "Expected key")) return false;
+        }
+        else
+        {
+            if (!expectString(clause.key, "Expected key")) return false;
+            switch (peek())
+            {
+            case ']':
+                clause.op = GoqlSelector::Op::HAS_KEY;
+                break;
+            case '=':
+                pos_++;
+                if (peek() == '=') pos_++;
+                skipWhitespace();
+                clause.op = GoqlSelector::Op::EQ;
+                if (!expectValues(clause)) return false;
+                break;
+            case '!':
+                pos_++;
+                if (peek() != '=')
+                {
+                    if (peek() == '~') return false;
+                    error("Expected != or !~");
+                }
+                pos_++;
+                skipWhitespace();
+                clause.op = GoqlSelector::Op::NE;
+                if (!expectValues(clause)) return false;
+                break;
+            case '<':
+            case '>':
+            case '~':
+                return false;
+            default:
+                error("Expected ]");
+            }
+        }
+        if (!accept(']')) error("Expected ]");
+        return true;
+    }
+
+    std::string_view s_;
+    size_t pos_;
+};
+
+
+/// A query parsed at compile time (see GOQL()). Binding it to a
+/// FeatureStore resolves its keys and values to global-string codes
+/// and yields a native matcher whose evaluation is specialized for
+/// the query's clauses: the clause count, operators and number of
+/// values are constants, so the tag scan is unrolled and free of
+/// opcode dispatch. If the query uses GOQL beyond the compile-time
+/// subset, or refers to strings that aren't global in this store,
+/// bind() falls back to the store's (cached) MatcherCompiler, so
+/// the result is always the same as for the query string.
+///
+template<GoqlLiteral Q>
+class CompiledQuery
+{
+public:
+    static constexpr GoqlSelector SELECTOR = GoqlParser(Q.view()).parse();
+    static constexpr int CLAUSE_COUNT = SELECTOR.clauseCount;
+
+    static constexpr const char* text() { return Q.chars; }
+
+    /// Returns a matcher for this query (the caller owns the reference)
+    static const MatcherHolder* bind(FeatureStore* store)
+    {
+        if constexpr (!SELECTOR.runtimeOnly && CLAUSE_COUNT > 0)
+        {
+            SpecializedMatcher matcher;
+            uint32_t indexBits = 0;
+            if (matcher.resolve(store, indexBits))
+            {
+                return MatcherHolder::createNative(SELECTOR.types, indexBits, matcher, true);
+            }
+        }
+        else if constexpr (!SELECTOR.runtimeOnly)
+        {
+            return MatcherHolder::createMatchAll(SELECTOR.types);
+        }
+        return store->getMatcher(Q.chars);
+    }
+
+private:
+    class SpecializedMatcher : public Matcher
+    {
+    public:
+        SpecializedMatcher() : Matcher(&match, nullptr) {}
+
+        bool resolve(FeatureStore* store, uint32_t& indexBits)
+        {
+            StringTable& strings = store->strings();
+            std::string_view text = Q.view();
+            int codeNo = strings.getCode("no", 2);
+            codeNo_ = codeNo < 0 ? NO_CODE : static_cast<uint32_t>(codeNo);
+            maxKeyBits_ = 0;
+            for (int i = 0; i < CLAUSE_COUNT; i++)
+            {
+                const GoqlSelector::Clause& clause = SELECTOR.clauses[i];
+                int key = strings.getCode(text.data() + clause.key.start, clause.key.len);
+                if (key <= 0 || key > FeatureConstants::MAX_COMMON_KEY) return false;
+                keyBits_[i] = static_cast<uint32_t>(key) << 2;
+                if (keyBits_[i] > maxKeyBits_) maxKeyBits_ = keyBits_[i];
+                if (clause.op == GoqlSelector::Op::HAS_KEY || clause.op == GoqlSelector::Op::EQ)
+                {
+                    indexBits |= store->keyIndexBits(key);
+                }
+                for (int j = 0; j < clause.valueCount; j++)
+                {
+                    const GoqlSelector::Range& v = clause.values[j];
+                    int code = strings.getCode(text.data() + v.start, v.len);
+                    if (code < 0) return false;     // a local string
+                    values_[i][j] = static_cast<uint32_t>(code);
+                }
+            }
+            return true;
+        }
+
+    private:
+        static constexpr uint32_t NO_CODE = 0xffff'ffff;
+        static constexpr uint32_t NOT_FOUND = 0xffff'ffff;
+
+        /// Returns true if the tag is a global string with one
+        /// of the values of clause I
+        template<int I>
+        bool hasValue(uint32_t tag) const
+        {
+            if ((tag & 3) != 1) return false;
+            uint32_t code = tag >> 16;
+            return [this, code]<size_t... J>(std::index_sequence<J...>)
+            {
+                return ((values_[I][J] == code) || ...);
+            }(std::make_index_sequence<SELECTOR.clauses[I].valueCount>());
+        }
+
+        bool isNo(uint32_t tag) const
+        {
+            return (tag & 3) == 1 && (tag >> 16) == codeNo_;
+        }
+
+        template<int I>
+        bool accept(uint32_t tag) const
+        {
+            constexpr GoqlSelector::Op op = SELECTOR.clauses[I].op;
+            bool found = tag != NOT_FOUND;
+            if constexpr (op == GoqlSelector::Op::HAS_KEY)
+            {
+                return found && !isNo(tag);
+            }
+            else if constexpr (op == GoqlSelector::Op::LACKS_KEY)
+            {
+                return !found || isNo(tag);
+            }
+            else if constexpr (op == GoqlSelector::Op::EQ)
+            {
+                return found && hasValue<I>(tag);
+            }
+            else
+            {
+                return !found || !hasValue<I>(tag);
+            }
+        }
+
+        /// Scans the global tags once, noting the tag of each clause's
+        /// key, then checks all clauses
+        static bool match(const Matcher* matcher, FeaturePtr feature)
+        {
+            const SpecializedMatcher* self = static_cast<const SpecializedMatcher*>(matcher);
+            return [self, feature]<size_t... I>(std::index_sequence<I...>)
+            {
+                uint32_t tags[CLAUSE_COUNT] = { (static_cast<void>(I), NOT_FOUND)... };
+                DataPtr p(feature.ptr() + 8);
+                p = p.followTagged(~1);
+                for (;;)
+                {
+                    uint32_t tag = p.getUnsignedIntUnaligned();
+                    uint32_t keyBits = tag & 0x7ffc;
+                    ((tags[I] = keyBits == self->keyBits_[I] ? tag : tags[I]), ...);
+                    if (keyBits >= self->maxKeyBits_ || (tag & 0x8000)) break;
+                    p += 4 + (tag & 2);
+                }
+                return (self->template accept<I>(tags[I]) && ...);
+            }(std::make_index_sequence<CLAUSE_COUNT>());
+        }
+
+        uint32_t keyBits_[CLAUSE_COUNT];
+        uint32_t maxKeyBits_;
+        uint32_t codeNo_;
+        uint32_t values_[CLAUSE_COUNT][GoqlSelector::MAX_VALUES];
+    };
+};
+
+/// Parses a GOQL query at compile time, e.g.
+/// `world(GOQL("na[amenity=pub][name]"))`
+///
+#define GOQL(query) ::geodesk::CompiledQuery<query>()
+
+// \endcond
+
+} // namespace geodesk
@@ -5,6 +5,9 @@
 
 #include <cassert>
 #include <cstdint>
+#include <new>
+#include <type_traits>
+#include <clarisma/util/ShortVarString.h>
 #include <geodesk/feature/types.h>
 #include <geodesk/feature/FeaturePtr.h>
 
@@ -14,11 +17,13 @@ class FeatureStore;
 class Matcher;
 class MatcherHolder;
 class RoleMatcher;
+class TagSummary;
 
 /// \cond lowlevel
 
 typedef bool (*MatcherMethod)(const Matcher*, FeaturePtr);
-typedef const Matcher* (*RoleMatcherMethod)(const RoleMatcher*, FeaturePtr);
+typedef const Matcher* (*RoleMatcherMethod)(const RoleMatcher*,
+    int roleCode, const clarisma::ShortVarString* roleStr);
 
 // MatcherHolder is a variable-length structure that bundles one or more Matchers,
 // a RoleMatcher and their associated resources (pointers to other MatcherHolder
@@ -50,6 +55,7 @@ public:
     }
 
     FeatureStore* store() const { return store_; }
+    MatcherMethod method() const { return function_; }
     
 private:
     MatcherMethod function_;
@@ -61,11 +67,16 @@ class RoleMatcher
 public:
     RoleMatcher(RoleMatcherMethod func, FeatureStore* store) : function_(func), store_(store) {}
 
-    const Matcher* accept(FeaturePtr feature) const
+    /// Returns the Matcher to apply to members with the given role
+    /// (a global-string code, or -1 with `roleStr` pointing to a
+    /// local string), or nullptr if no member with that role can match
+    const Matcher* accept(int roleCode, const clarisma::ShortVarString* roleStr) const
     {
-        return function_(this, feature);
+        return function_(this, roleCode, roleStr);
     }
 
+    RoleMatcherMethod method() const { return function_; }
+
 private:
     RoleMatcherMethod function_;
     FeatureStore* store_;           // not refcounted
@@ -78,6 +89,19 @@ struct IndexMask
     uint32_t keyMin;
 };
 
+/// The range of numbers into which the value of a global key must fall
+/// for a feature to be accepted (e.g. `[ele>3000]`); a range whose
+/// `keyCode` is negative imposes no requirement. The bounds are
+/// inclusive, even if the query's comparison is not.
+struct NumericRange
+{
+    int keyCode;
+    double min;
+    double max;
+
+    bool isRequired() const { return keyCode >= 0; }
+};
+
 class GEODESK_API MatcherHolder
 {
 public:
@@ -86,11 +110,54 @@ public:
     MatcherHolder(FeatureTypes types, uint32_t keyMask, uint32_t keyMin);
 
     static const MatcherHolder* createMatchAll(FeatureTypes types);
+    /// A matcher that accepts every feature of the given types, but lets
+    /// a query skip the index roots ruled out by `masks` (one for each
+    /// FeatureIndexType)
+    static const MatcherHolder* createMatchAll(FeatureTypes types,
+        const IndexMask* masks);
     static const MatcherHolder* createMatchKey(FeatureTypes types, 
         uint32_t indexBits, int keyCode, int codeNo);
     static const MatcherHolder* createMatchKeyValue(FeatureTypes types, 
         uint32_t indexBits, int keyCode, int valueCode);
 
+    /// A native (non-interpreted) matcher for a conjunction of up to
+    /// MAX_NATIVE_CLAUSES clauses, each of which requires a global key
+    /// to have one of up to MAX_NATIVE_VALUES global-string values,
+    /// e.g. `w[highway=primary,secondary][surface=asphalt]`
+    ///
+    /// @param keyCodes     global-string codes of the keys, in ascending order
+    /// @param valueCodes   for each key, `valueCount[i]` consecutive value codes
+    ///
+    static const MatcherHolder* createMatchKeyValueSets(FeatureTypes types,
+        uint32_t indexBits, int clauseCount, const uint16_t* keyCodes,
+        const uint8_t* valueCounts, const uint16_t* valueCodes);
+
+    /// A native matcher whose main Matcher is a copy of `matcher`, a
+    /// trivially destructible subclass of Matcher (see CompiledQuery)
+    ///
+    /// @param tagsOnly true if `matcher` looks at nothing but the tags
+    ///   of a feature (see dependsOnlyOnTags())
+    ///
+    template<typename M>
+    static const MatcherHolder* createNative(FeatureTypes types,
+        uint32_t indexBits, const M& matcher, bool tagsOnly = false)
+    {
+        static_assert(std::is_base_of_v<Matcher, M> &&
+            std::is_trivially_destructible_v<M>);
+        MatcherHolder* self = reinterpret_cast<MatcherHolder*>(
+            alloc(sizeof(MatcherHolder) + sizeof(M) - sizeof(Matcher)));
+        new (self) MatcherHolder(types, indexBits, indexBits == 0 ? 0 : 1);
+        // The allocation extends past mainMatcher_ to fit the subclass,
+        // which the compiler can't see from its declared type
+        void* main = &self->mainMatcher_;
+        new (main) M(matcher);
+        self->tagsOnly_ = tagsOnly;
+        return self;
+    }
+
+    static constexpr int MAX_NATIVE_CLAUSES = 4;
+    static constexpr int MAX_NATIVE_VALUES = 8;
+
     /**
      * Returns a matcher that must match both a and b.
      * (This function steals the references to a and b, which means
@@ -108,8 +175,9 @@ public:
 
     void release() const
     {
-        if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        if (refcount_.fetch_sub(1, std::memory_order_release) == 1)
         {
+            std::atomic_thread_fence(std::memory_order_acquire);
             dealloc();
         }
     }
@@ -119,7 +187,54 @@ public:
 #endif
 
     const Matcher& mainMatcher() const { return mainMatcher_; }
+    const RoleMatcher& roleMatcher() const
+    {
+        return *reinterpret_cast<const RoleMatcher*>(
+            reinterpret_cast<const uint8_t*>(this) + roleMatcherOffset_);
+    }
+    /// Returns true if members are matched the same way regardless
+    /// of their roles (in which case roleMatcher() need not be called)
+    bool acceptsAllRoles() const
+    {
+        return roleMatcher().method() == &defaultRoleMethod;
+    }
     FeatureTypes acceptedTypes() const { return acceptedTypes_; }
+    /// Returns true if the main matcher accepts every feature
+    /// (of the accepted types)
+    bool isMatchAll() const { return mainMatcher_.method() == &matchAllMethod; }
+
+    /// Checks up to MAX_BATCH_SIZE features against the main matcher
+    /// (same as calling accept() for each, but dispatched only once)
+    ///
+    /// @return a bitmask of the accepted features (bit 0 = features[0])
+    ///
+    uint64_t accept(const FeaturePtr* features, int count) const;
+
+    static constexpr int MAX_BATCH_SIZE = 64;
+
+    /// Returns true if the main matcher only accepts features with
+    /// certain global-string tags, which a TagSummary can rule out
+    bool requiresTags() const { return nativeKind_ != NativeKind::NONE; }
+
+    /// Returns true if the result of the main matcher depends on nothing
+    /// but the tags of a feature (not its type, for example), so all
+    /// features that share a tag table are either accepted or rejected
+    bool dependsOnlyOnTags() const { return tagsOnly_; }
+
+    /// Returns false if the TagSummary shows that the given tile has no
+    /// features with the tags required by this matcher
+    bool mayMatchTile(const TagSummary& summary, Tip tip) const;
+
+    /// Returns the range of numbers that the value of a key must fall
+    /// into, which a NumericIndex can use to rule out tiles (see
+    /// NumericRange::isRequired())
+    const NumericRange& requiredRange() const { return requiredRange_; }
+
+    const IndexMask& indexMask(FeatureIndexType index) const
+    {
+        assert(index >= 0 && index < 4);
+        return indexMasks_[index];
+    }
 
     bool acceptIndex(FeatureIndexType index, uint32_t keys) const
     {
@@ -129,7 +244,15 @@ public:
     }
 
 private:
-    static const Matcher* defaultRoleMethod(const RoleMatcher* matcher, FeaturePtr);
+    enum class NativeKind : uint8_t
+    {
+        NONE,
+        KEY_VALUE,          // GlobalTagMatcher
+        KEY_VALUE_SETS      // GlobalTagSetMatcher
+    };
+
+    static const Matcher* defaultRoleMethod(const RoleMatcher* matcher,
+        int roleCode, const clarisma::ShortVarString* roleStr);
     static bool matchAllMethod(const Matcher*, FeaturePtr);
     static uint8_t* alloc(size_t size) { return new uint8_t[size]; };
 
@@ -148,6 +271,9 @@ private:
     uint32_t regexCount_;           // number of regexes in resources
     uint32_t roleMatcherOffset_;    // where to find role Matcher
     IndexMask indexMasks_[4];       // one for each: Nodes, Ways, areas, Relations
+    NativeKind nativeKind_;
+    bool tagsOnly_;                 // see dependsOnlyOnTags()
+    NumericRange requiredRange_;
     RoleMatcher defaultRoleMatcher_;
     Matcher mainMatcher_;
 
@@ -6,12 +6,20 @@
 // #define ASMJIT_STATIC 
 // #include <asmjit/asmjit.h>
 #include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace geodesk {
 
 class FeatureStore;
 class MatcherHolder;
+class MatcherParser;
 class OpGraph;
+struct NumericRange;
 struct Selector;
 
 /// \cond lowlevel
@@ -19,19 +27,75 @@ struct Selector;
 class MatcherCompiler
 {
 public:
-	explicit MatcherCompiler(FeatureStore* store) :
-		store_(store)
+	struct CacheStats
+	{
+		uint64_t hits;
+		uint64_t misses;
+		size_t size;
+	};
+
+	static constexpr size_t DEFAULT_CACHE_CAPACITY = 256;
+
+	explicit MatcherCompiler(FeatureStore* store,
+		size_t cacheCapacity = DEFAULT_CACHE_CAPACITY) :
+		store_(store),
+		cacheCapacity_(cacheCapacity),
+		hits_(0),
+		misses_(0)
 	{
 		// TODO: fix this dependency, store not initialized yet
 	}
 
+	~MatcherCompiler();
+
+	/// Returns the matcher for the given GOQL query (the caller receives
+	/// a reference). Matchers of recently used queries are cached, so
+	/// requesting the same query again (spelled exactly the same way)
+	/// does not recompile it.
+	/// Thread-safe.
 	const MatcherHolder* getMatcher(const char* query);
 
+	/// Returns a matcher that accepts only the features accepted by
+	/// both `a` and `b` (stealing the caller's references to them).
+	/// If both came from this compiler, their queries are compiled into
+	/// a single matcher, which checks all tag clauses in one pass over
+	/// a feature's tags; otherwise, the two are called in turn.
+	/// Thread-safe.
+	const MatcherHolder* combine(const MatcherHolder* a, const MatcherHolder* b);
+	CacheStats cacheStats();
+	void clearCache();
+
+	/// Returns the query the given matcher was compiled from
+	/// (for a fused intersection, its queries separated by null
+	/// characters), or an empty string if the matcher is no longer
+	/// cached or did not come from this compiler. Thread-safe.
+	std::string queryOf(const MatcherHolder* matcher);
+
 private:
-	const MatcherHolder* compileMatcher(OpGraph& graph, Selector* firstSel, uint32_t indexBits);
+	using LruList = std::list<std::pair<std::string, const MatcherHolder*>>;
+
+	const MatcherHolder* lookup(std::string&& key, const char* query);
+	const MatcherHolder* compile(const char* query);
+	const MatcherHolder* compile(MatcherParser& parser, Selector* sel);
+	static const MatcherHolder* compileNative(Selector* sel, uint32_t indexBits);
+	static NumericRange requiredRange(const Selector* sel);
+	const MatcherHolder* compileMatcher(OpGraph& graph, Selector* firstSel,
+		uint32_t indexBits, std::vector<uint16_t>* origins = nullptr);
 
 	FeatureStore* store_;
 	// asmjit::JitRuntime runtime_;
+
+	std::mutex cacheMutex_;
+	size_t cacheCapacity_;
+	LruList lru_;                   // most recently used first
+	std::unordered_map<std::string_view, LruList::iterator> cache_;
+		// keys point into the strings held by lru_
+	std::unordered_map<const MatcherHolder*, LruList::iterator> sources_;
+		// the query of each cached matcher
+	uint64_t hits_;
+	uint64_t misses_;
+
+	friend class MatcherProfiler;
 };
 
 // \endcond
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/Features.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class MatcherHolder;
+
+/// \cond lowlevel
+
+/// Shows which parts of a GOQL query are expensive to match. The query
+/// is compiled into bytecode (even if it would normally get a native
+/// matcher), and run by an instrumented MatcherEngine that counts how
+/// often each instruction executes and the cycles it takes. These
+/// counts are attributed to the selector or tag clause each
+/// instruction was generated for (load and type-conversion ops count
+/// towards their clause; local-key checks and the final RETURN of a
+/// selector towards the selector).
+///
+/// The cycles are those of the CPU's time-stamp counter (on non-x86
+/// platforms, nanoseconds), less the measured cost of reading it.
+/// They are only indicative: the counter is read before every
+/// instruction, which disturbs the pipeline.
+///
+/// Not thread-safe.
+///
+class GEODESK_API MatcherProfiler
+{
+public:
+    /// A selector or tag clause of the query
+    struct Origin
+    {
+        std::string_view text;      // points into query()
+        uint32_t position;          // of text within query()
+        bool isSelector;
+        uint64_t executions;        // instructions run on its behalf
+        uint64_t cycles;
+    };
+
+    struct OpcodeCounts
+    {
+        const char* name;
+        uint64_t executions;
+        uint64_t cycles;
+    };
+
+    /// @throws QueryException if the query is malformed, or if
+    ///   it has a selector without tag clauses (which has no
+    ///   bytecode to profile)
+    MatcherProfiler(FeatureStore* store, const char* query);
+    ~MatcherProfiler();
+
+    const std::string& query() const { return query_; }
+    FeatureTypes acceptedTypes() const;
+
+    /// Checks a feature (which must be of one of the acceptedTypes())
+    /// against the query, and adds to the counts
+    bool accept(FeaturePtr feature);
+
+    /// Checks each feature of the given collection that is of one of
+    /// the acceptedTypes(), and returns how many were accepted. (The
+    /// query engine itself would skip index buckets that can't have
+    /// any matches, so it would check fewer features.)
+    uint64_t run(const Features& features);
+
+    uint64_t featuresChecked() const { return checked_; }
+    uint64_t featuresAccepted() const { return accepted_; }
+
+    /// The selectors and tag clauses, most expensive first
+    std::vector<Origin> origins() const;
+
+    /// The counts of each opcode that ran, most expensive first
+    std::vector<OpcodeCounts> opcodes() const;
+
+    /// Appends a table of the most expensive clauses (at most
+    /// `maxRows`) and opcodes to `out`
+    void report(std::string& out, int maxRows = 10) const;
+
+    void reset();
+
+private:
+    uint64_t netCycles(size_t word) const
+    {
+        uint64_t overhead = executions_[word] * overhead_;
+        return cycles_[word] > overhead ? cycles_[word] - overhead : 0;
+    }
+
+    struct OriginText
+    {
+        uint32_t position;
+        uint32_t length;
+        bool isSelector;
+    };
+
+    std::string query_;
+    const MatcherHolder* matcher_;
+    const uint16_t* code_;
+    std::vector<uint16_t> instructionOrigins_;  // by word offset
+    std::vector<OriginText> origins_;           // [0] is unknown
+    std::vector<uint64_t> executions_;          // by word offset
+    std::vector<uint64_t> cycles_;
+    uint64_t overhead_;         // cycles taken by the probe itself
+    uint64_t checked_ = 0;
+    uint64_t accepted_ = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
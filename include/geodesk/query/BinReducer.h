@@ -0,0 +1,92 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/geom/BinGrid.h>
+#include <geodesk/geom/Centroid.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A TileReducer that adds `value(T feature)` to the cell of a BinGrid
+/// that contains the feature's location (its coordinate if it is a
+/// node, otherwise its centroid).
+///
+/// Each worker adds into a dense array of its own, so the workers
+/// never wait for each other; the thread that iterates the query
+/// (which is passed the features that live in multiple tiles) has
+/// an extra array. result() merges the arrays once the query is done.
+///
+template <typename T, typename V, typename ValueFn>
+class BinReducer : public TileReducer
+{
+public:
+    BinReducer(int workerCount, const BinGrid& grid, ValueFn value) :
+        grid_(grid),
+        value_(value),
+        workerCount_(workerCount),
+        slots_(new Slot[workerCount + 1])
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        int worker = QueryExecutor::currentWorker();
+        std::vector<V>& bins = slots_[
+            (worker >= 0 && worker < workerCount_) ? worker : workerCount_].bins;
+        if (bins.empty()) bins.resize(grid_.cellCount());
+        for (size_t i = 0; i < count; i++)
+        {
+            FeaturePtr feature = features[i];
+            Coordinate c = feature.isNode() ? NodePtr(feature).xy() :
+                Centroid::ofFeature(store, feature);
+            int64_t cell = grid_.cellOf(c);
+            if (cell >= 0) bins[cell] += value_(T(store, feature));
+        }
+    }
+
+    /// Merges the per-thread arrays (call only after the query
+    /// has been consumed)
+    std::vector<V> result()
+    {
+        std::vector<V> total;
+        for (int i = 0; i <= workerCount_; i++)
+        {
+            std::vector<V>& bins = slots_[i].bins;
+            if (bins.empty()) continue;
+            if (total.empty())
+            {
+                total = std::move(bins);
+                continue;
+            }
+            for (size_t cell = 0; cell < total.size(); cell++)
+            {
+                total[cell] += bins[cell];
+            }
+        }
+        if (total.empty()) total.resize(grid_.cellCount());
+        return total;
+    }
+
+private:
+    struct alignas(64) Slot     // (padded to avoid false sharing)
+    {
+        std::vector<V> bins;    // allocated on first use
+    };
+
+    const BinGrid& grid_;
+    ValueFn value_;
+    int workerCount_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+// \endcond
+
+} // namespace geodesk
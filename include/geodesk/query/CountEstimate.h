@@ -0,0 +1,19 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+namespace geodesk {
+
+/// The estimated number of features in a collection, based on
+/// a sample of its tiles (see Features::estimateCount()).
+///
+struct CountEstimate
+{
+    double count = 0;       ///< the estimate
+    double lower = 0;       ///< lower bound of the 95% confidence interval
+    double upper = 0;       ///< upper bound of the 95% confidence interval
+    bool exact = false;     ///< true if all features were counted
+};
+
+} // namespace geodesk
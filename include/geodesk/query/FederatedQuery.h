@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <span>
+#include <vector>
+#include <clarisma/data/FlatHashSet.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/View.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Runs the same query against several FeatureStores at once (e.g.
+/// regional GOLs), merging their results as they become available. The
+/// queries of all stores are in flight together, so their tiles are
+/// scanned in parallel (on a shared executor, by default); the consumer
+/// takes whatever batch is ready, visiting the stores round-robin.
+///
+/// A feature that lies on the border between two regions is present in
+/// both stores; such features are deduplicated by ID. Only features whose
+/// bounds intersect the overlap of two stores' coverage are checked.
+///
+/// Views that aren't world views are simply read in sequence.
+///
+class GEODESK_API FederatedQuery
+{
+public:
+    explicit FederatedQuery(std::span<const View> views);
+
+    /// Returns the next feature (and stores its FeatureStore in
+    /// `*pStore`), or a null pointer once all stores are done.
+    FeaturePtr next(FeatureStore** pStore);
+
+private:
+    struct Source
+    {
+        FeatureStore* store;
+        std::unique_ptr<Query> query;       // only for world views
+        std::vector<FeaturePtr> features;   // for all other views
+        bool done = false;
+    };
+
+    bool fill();
+    bool isDuplicate(FeaturePtr pFeature);
+    static void ready(void* context);
+
+    std::vector<Box> borders_;
+    clarisma::FlatHashSet<uint64_t> seen_;
+    std::vector<FeaturePtr> batch_;
+    size_t batchPos_;
+    size_t current_;
+    std::atomic<uint32_t> readyEpoch_;
+    std::vector<Source> sources_;
+        // (declared last, since the queries signal readyEpoch_
+        // until they have been destroyed)
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,125 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/WayPtr.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Snaps GPS traces to ways (map matching). Instead of issuing a
+/// distance query per point, the points of all traces are bucketed
+/// into cells (sorted along a Hilbert curve, so nearby points share
+/// a cell), and the ways around the points of each cell are collected
+/// in a single pass over the tile index (see
+/// FeaturesBase::forEachInBoxes()). Each cell then slices its ways into
+/// monotone chains, indexes them in a PackedRTree and measures its
+/// points against the nearby chains (see PointSegmentDistance), which
+/// yields up to `maxCandidates` candidate ways per point. Finally, each
+/// trace picks the most likely sequence of candidates using a hidden
+/// Markov model (Viterbi).
+///
+/// The emission probability of a candidate drops off with its distance
+/// from the GPS point (Gaussian noise with deviation `sigmaMeters`); the
+/// transition probability between the candidates of consecutive points
+/// drops off with the difference between the distance of the points and
+/// the distance of the candidates (exponential, with scale `betaMeters`).
+/// In the absence of a routing graph, the distance along the road is
+/// approximated by the straight-line distance between the candidates.
+///
+/// Cells are processed in parallel, and so are traces. A point without
+/// any way within `searchMeters` is left unmatched, and splits the trace.
+///
+class GEODESK_API MapMatcher
+{
+public:
+    struct Settings
+    {
+        /// Ways further away from a point are not considered
+        double searchMeters = 50;
+        /// The standard deviation of the GPS error
+        double sigmaMeters = 10;
+        /// How much the distance between candidates may differ from
+        /// the distance between their points
+        double betaMeters = 20;
+        /// The number of candidate ways per point (at most 255)
+        int maxCandidates = 8;
+    };
+
+    struct MatchedPoint
+    {
+        /// The ID of the way, or 0 if the point wasn't matched
+        uint64_t way = 0;
+        /// The location on the way closest to the GPS point
+        Coordinate location;
+        /// The distance between the GPS point and `location`
+        double meters = 0;
+
+        bool isMatched() const noexcept { return way != 0; }
+    };
+
+    using Trace = std::vector<Coordinate>;
+    using MatchedTrace = std::vector<MatchedPoint>;
+
+    MapMatcher(const std::vector<Trace>& traces, const Settings& settings);
+    ~MapMatcher();
+
+    /// The (padded) bounds of the points of each cell; ways that
+    /// intersect a box must be passed to addWay()
+    const std::vector<Box>& cellBoxes() const { return cellBoxes_; }
+
+    /// Adds a way to the given cell (not thread-safe)
+    void addWay(uint32_t cell, WayPtr way);
+
+    /// Matches the traces against the ways that have been added
+    ///
+    /// @param threads  the number of threads to use (including the
+    ///                 calling thread)
+    /// @return the matched points, by trace
+    std::vector<MatchedTrace> match(int threads);
+
+private:
+    /// Ways are sliced into chains of at most this many vertexes
+    static constexpr int MAX_CHAIN_VERTEXES = 16;
+    /// The side of a cell is at most 1/2^CELL_ZOOM of the map width
+    static constexpr int CELL_ZOOM = 14;
+
+    struct Candidate
+    {
+        uint64_t way;
+        Coordinate location;
+        float meters;
+    };
+
+    struct Cell
+    {
+        uint32_t pointsStart;       // into cellPoints_
+        uint32_t pointsEnd;
+    };
+
+    void buildCells();
+    void findCandidates(uint32_t cell);
+    void matchTrace(size_t trace, MatchedTrace& matched) const;
+
+    Settings settings_;
+    std::vector<uint32_t> traceStarts_;     // into points_, by trace
+    std::vector<Coordinate> points_;        // the points of all traces
+    std::vector<uint32_t> cellPoints_;      // point indexes, in Hilbert order
+    std::vector<Cell> cells_;
+    std::vector<Box> cellBoxes_;
+    std::vector<std::vector<WayPtr>> cellWays_;
+    std::unique_ptr<Candidate[]> candidates_;   // maxCandidates per point
+    std::unique_ptr<uint8_t[]> candidateCounts_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,109 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <queue>
+#include <vector>
+#include <clarisma/data/FlatHashSet.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/types.h>
+#include <geodesk/filter/Filter.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// Retrieves features in order of their distance from a point, using a
+/// best-first traversal: tiles, index branches, leaves and candidate
+/// features share a single priority queue, ordered by the distance of
+/// their bounding box (a lower bound of the distance of anything they
+/// contain). A feature is returned once its exact distance is closer than
+/// everything still in the queue, so only as much of the index is read as
+/// is needed for the features actually retrieved.
+///
+/// Distances are measured in Mercator units and scaled to meters at the
+/// latitude of the point (like PointDistanceFilter), so the ordering is
+/// exact for the map projection. Unlike Query, this runs entirely on the
+/// calling thread.
+///
+class GEODESK_API NearestQuery
+{
+public:
+    NearestQuery(FeatureStore* store, const Box& bounds, FeatureTypes types,
+        const MatcherHolder* matcher, const Filter* filter,
+        Coordinate xy, double maxMeters);
+
+    /// Returns the closest feature not yet returned, or a null
+    /// pointer if there are no more features within range.
+    FeaturePtr next();
+
+    /// The distance (in meters) of the feature last returned by next()
+    double meters() const;
+
+private:
+    enum Kind : uint32_t
+    {
+        TILE,
+        BRANCH,
+        LEAF,
+        NODE_BRANCH,
+        NODE_LEAF,
+        CANDIDATE,          // bbox distance only, not yet matched/filtered
+        NODE_CANDIDATE,     // exact distance, not yet filtered
+        FEATURE             // exact distance, accepted
+    };
+
+    struct Entry
+    {
+        double distanceSquared;
+        const uint8_t* p;
+        uint32_t tile;      // index into tiles_
+        Kind kind;
+
+        bool operator>(const Entry& other) const
+        {
+            return distanceSquared > other.distanceSquared;
+        }
+    };
+
+    struct TileEntry
+    {
+        Tip tip;
+        FastFilterHint hint;
+    };
+
+    void push(double distanceSquared, const uint8_t* p, uint32_t tile, Kind kind);
+    void pushChild(DataPtr pEntry, double distanceSquared, uint32_t tile, bool isNodeIndex);
+    void expandTile(const Entry& entry);
+    void expandRoots(DataPtr ppRoot, FeatureIndexType indexType, double distanceSquared,
+        uint32_t tile, bool isNodeIndex);
+    void expandBranch(const Entry& entry, bool isNodeIndex);
+    void expandLeaf(const Entry& entry);
+    void expandNodeLeaf(const Entry& entry);
+    bool acceptFilter(FeaturePtr pFeature, uint32_t tile) const;
+    double boxDistanceSquared(const Box& box) const;
+
+    FeatureStore* store_;
+    Box bounds_;
+    FeatureTypes types_;
+    const MatcherHolder* matcher_;
+    const Filter* filter_;
+    Coordinate xy_;
+    double maxDistanceSquared_;
+    double metersPerUnit_;
+    double lastDistanceSquared_;
+    std::vector<TileEntry> tiles_;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue_;
+    clarisma::FlatHashSet<uint64_t> multiTileFeatures_;
+};
+
+// \endcond
+
+} // namespace geodesk
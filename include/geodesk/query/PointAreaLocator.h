@@ -0,0 +1,125 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/PointInPolygonAccelerator.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+class MCIndex;
+
+/// \cond lowlevel
+///
+/// Assigns a large batch of points to the areas that contain them
+/// (reverse geocoding). Rather than running a query for each point,
+/// the points are bucketed into a grid, the tile index is walked once
+/// for the areas that intersect the points, and each area's MCIndex
+/// is built once and tested against all the points that lie within
+/// its bounding box (see MCIndex::containsPoints()).
+///
+/// Areas that live in a single tile are processed by the query's
+/// worker threads; areas that span multiple tiles (which are usually
+/// the large ones) are processed once the query is done, with their
+/// points split among several threads. If a PointInPolygonAccelerator
+/// has been installed, areas with enough candidate points are tested
+/// on its device instead.
+///
+/// Points on the boundary of an area are considered to be inside it.
+/// The points must remain valid for the lifetime of the locator.
+///
+class GEODESK_API PointAreaLocator : public TileReducer
+{
+public:
+    explicit PointAreaLocator(std::span<const Coordinate> points);
+
+    /// Tests the points against all areas of the given types that
+    /// match the matcher and filter, then calls finish()
+    void query(FeatureStore* store, const Box& bounds, FeatureTypes types,
+        const MatcherHolder* matcher, const Filter* filter);
+
+    /// Tests the points against a single area (ignored if it is not
+    /// an area). Thread-safe.
+    void addArea(FeatureStore* store, FeaturePtr area);
+
+    /// Groups the results by point; call once all areas have been
+    /// added, before calling areas()
+    void finish();
+
+    /// The store of the areas, or `nullptr` if none were added
+    FeatureStore* store() const { return store_; }
+
+    /// Returns the areas that contain the given point, in no
+    /// particular order
+    std::span<const FeaturePtr> areas(size_t point) const
+    {
+        return { areas_.data() + offsets_[point],
+            static_cast<size_t>(offsets_[point + 1] - offsets_[point]) };
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override;
+
+    /// Offloads large batches of tests of all locators from now on to
+    /// the given device (pass nullptr to test all points on the CPU)
+    static void setAccelerator(std::shared_ptr<PointInPolygonAccelerator> accelerator);
+
+    static std::shared_ptr<PointInPolygonAccelerator> accelerator();
+
+private:
+    struct Hit
+    {
+        uint32_t point;
+        FeaturePtr area;
+    };
+
+    /// Areas with at least this many candidate points have their
+    /// points tested on multiple threads (if they were not already
+    /// processed by a worker thread)
+    static constexpr size_t MIN_PARALLEL_POINT_COUNT = 16 * 1024;
+    static constexpr size_t MIN_POINTS_PER_THREAD = 4 * 1024;
+
+    void buildGrid();
+    void collectCandidates(const Box& box, std::vector<uint32_t>& candidates) const;
+    void testArea(FeatureStore* store, FeaturePtr area, int threadCount,
+        std::vector<Hit>& hits) const;
+    static void testPoints(const MCIndex& index, const Coordinate* coords,
+        size_t count, int threadCount, bool* results);
+
+    struct SharedAccelerator
+    {
+        std::mutex mutex;
+        std::shared_ptr<PointInPolygonAccelerator> accelerator;
+    };
+
+    static SharedAccelerator& getSharedAccelerator();
+
+    std::span<const Coordinate> points_;
+    Box bounds_;
+    int gridSize_;          // (cells per side)
+    int64_t cellWidth_;
+    int64_t cellHeight_;
+    std::unique_ptr<uint32_t[]> cellStarts_;    // gridSize_ * gridSize_ + 1
+    std::unique_ptr<uint32_t[]> cellPoints_;    // point indexes, by cell
+    FeatureStore* store_;
+    std::shared_ptr<PointInPolygonAccelerator> accelerator_;
+    std::mutex mutex_;
+    std::vector<Hit> hits_;
+    std::vector<uint64_t> offsets_;             // (after finish())
+    std::vector<FeaturePtr> areas_;             // (after finish())
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,184 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/Key.h>
+#include <geodesk/geom/Coordinate.h>
+#include <geodesk/geom/Tile.h>
+#include <geodesk/query/TileReducer.h>
+
+namespace geodesk {
+
+/// @brief The points of a set of features (nodes, or the centroids of
+/// other features), grouped into clusters for each zoom level, so a
+/// map can show a large number of points (see Features::clusters()).
+///
+/// Each tile is divided into a grid of `cellsPerTile` by `cellsPerTile`
+/// cells; the points in a cell form a cluster, located at their
+/// centroid. Since the cells of a tile are exactly the union of the
+/// cells of its four child tiles, the clusters form a hierarchy: a
+/// cluster at one zoom level consists of up to four clusters at the
+/// next zoom level.
+///
+/// The points are sorted along a Z-order curve, which places the points
+/// of each cell (and hence each cluster) next to each other; the
+/// clusters of each zoom level are sorted the same way, so the clusters
+/// of a tile are found with a binary search. Sorting and clustering are
+/// split by tile (at a low zoom level) across multiple threads.
+///
+/// For each cluster, the number of its points that have each of the
+/// `countedTags` is kept as well (e.g. how many are restaurants).
+///
+class GEODESK_API PointClusters
+{
+public:
+    struct Settings
+    {
+        /// The lowest zoom level with clusters (tiles at lower zoom
+        /// levels get the clusters of this level)
+        int minZoom = 0;
+        /// The highest zoom level with clusters (tiles at higher zoom
+        /// levels get individual points)
+        int maxZoom = 16;
+        /// The number of cells across a tile (a power of 2 between 2
+        /// and 256); 16 groups points that lie within about 16 pixels
+        /// of each other on a tile with 256 pixels
+        int cellsPerTile = 16;
+        /// Cells with fewer points yield their individual points
+        /// instead of a cluster
+        int minPoints = 2;
+        /// The tags to count (at most 64), each given as `key`
+        /// (for any value other than `no`) or `key=value`
+        std::vector<std::string> countedTags;
+    };
+
+    /// A cluster of points, or a single point
+    class Cluster
+    {
+    public:
+        /// The centroid of the points (or the location of the point)
+        Coordinate xy;
+        /// The number of points
+        uint32_t count;
+        /// The typed ID of the feature, if the cluster consists of
+        /// a single point (otherwise 0)
+        uint64_t typedId;
+
+        bool isPoint() const noexcept { return count == 1; }
+
+        /// The number of points that have the n-th of the counted tags
+        uint32_t tagCount(size_t n) const noexcept
+        {
+            return tagCounts_ ? tagCounts_[n] :
+                static_cast<uint32_t>((tagBits_ >> n) & 1);
+        }
+
+    private:
+        const uint32_t* tagCounts_;     // nullptr for a single point
+        uint64_t tagBits_;
+
+        friend class PointClusters;
+    };
+
+    /// \cond lowlevel
+
+    /// A TileReducer that gathers the points of the features (each
+    /// worker into a list of its own)
+    class Collector : public TileReducer
+    {
+    public:
+        /// @throws ValueException if the settings are invalid
+        Collector(FeatureStore* store, int workerCount, const Settings& settings);
+
+        void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override;
+
+    private:
+        struct CountedTag
+        {
+            Key key;
+            std::string value;      // empty if any value counts
+        };
+
+        struct Point
+        {
+            uint64_t key;           // position along the Z-order curve
+            Coordinate xy;
+            uint64_t typedId;
+            uint64_t tagBits;       // bit n set if point has counted tag n
+        };
+
+        struct alignas(64) Slot     // (padded to avoid false sharing)
+        {
+            std::vector<Point> points;
+        };
+
+        Settings settings_;
+        std::vector<CountedTag> countedTags_;
+        int workerCount_;
+        std::unique_ptr<Slot[]> slots_;
+
+        friend class PointClusters;
+    };
+
+    /// Clusters the points that were gathered by the Collector
+    ///
+    /// @param threads the number of threads to use (including the
+    ///   calling thread)
+    PointClusters(Collector& collector, int threads);
+
+    /// \endcond
+
+    /// The number of points
+    size_t pointCount() const noexcept { return points_.size(); }
+
+    /// Returns the clusters (and individual points) whose cell lies
+    /// within the given tile. Safe to call from any thread.
+    std::vector<Cluster> clusters(Tile tile) const
+    {
+        return clusters(tile.column(), tile.row(), tile.zoom());
+    }
+
+    /// Returns the clusters (and individual points) whose cell lies
+    /// within the tile at the given position (unlike Tile, this
+    /// supports zoom levels above 12, up to 31)
+    std::vector<Cluster> clusters(int column, int row, int zoom) const;
+
+    /// The number of counted tags
+    size_t countedTagCount() const noexcept { return settings_.countedTags.size(); }
+
+private:
+    using Point = Collector::Point;
+
+    struct Cell
+    {
+        uint64_t key;               // the Z-order position of the cell
+        uint32_t first;             // the first of its points
+        uint32_t count;
+        Coordinate xy;
+    };
+
+    struct Level
+    {
+        std::vector<Cell> cells;
+        std::vector<uint32_t> tagCounts;    // countedTagCount() per cell
+    };
+
+    class Partition;
+
+    /// The number of bits per axis of the cells at the given zoom level
+    int cellBits(int zoom) const noexcept { return zoom + cellsPerTileBits_; }
+    void addPoint(std::vector<Cluster>& clusters, const Point& point) const;
+
+    Settings settings_;
+    int cellsPerTileBits_;
+    std::vector<Point> points_;
+    std::vector<Level> levels_;     // from minZoom to maxZoom
+};
+
+} // namespace geodesk
@@ -0,0 +1,49 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <span>
+#include <geodesk/geom/Coordinate.h>
+#include <geodesk/geom/index/FlatChains.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// A device (such as a GPU) to which PointAreaLocator offloads large
+/// batches of point-in-polygon tests. The library ships no device
+/// backend of its own; an application that has one (CUDA, OpenCL,
+/// SYCL, ...) implements this interface and installs it via
+/// PointAreaLocator::setAccelerator().
+///
+/// For each area that has at least minBatchSize() candidate points,
+/// the chains of its polygon are flattened (see FlatChains) and passed
+/// to containsPoints() along with the points, so both can be copied to
+/// the device once. The results must be the same as those of
+/// FlatChains::containsPoint() (which is the reference kernel).
+///
+/// Calls may come from multiple threads at once.
+///
+class PointInPolygonAccelerator
+{
+public:
+    virtual ~PointInPolygonAccelerator() = default;
+
+    /// Batches of fewer points are tested on the CPU, as copying
+    /// them to the device would take longer than testing them
+    virtual size_t minBatchSize() const = 0;
+
+    /// Tests each point against the polygon, storing the results in
+    /// `results` (true if the point lies inside or on the boundary).
+    ///
+    /// @return false if the device couldn't run the batch (in which
+    ///   case the points are tested on the CPU)
+    ///
+    virtual bool containsPoints(const FlatChains& polygon,
+        std::span<const Coordinate> points, bool* results) = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
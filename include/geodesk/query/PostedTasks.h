@@ -0,0 +1,121 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <geodesk/query/TileQueryTask.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// The tasks a Query has posted to the executor that no worker has
+/// picked up yet, so the consumer can run one of them itself while it
+/// waits for results (see Query::helpWorkers()).
+///
+/// Each recorded task is given a ticket, which it carries into the
+/// executor's queue. Whoever first swaps the ticket out of its slot
+/// runs the task: the worker that dequeues it, or the consumer. The
+/// other party drops its copy. Tasks of other queries are never
+/// touched, and the executor's queues are never reshuffled.
+///
+/// Every task that carries a ticket holds a reference, so a worker
+/// can check the ticket of a task that the consumer already ran
+/// even after its Query is gone.
+///
+class PostedTasks
+{
+public:
+    /// A task that can't be given a slot (because all slots hold
+    /// tickets that have not been claimed yet) is posted as usual,
+    /// but only a worker can run it
+    static constexpr uint32_t CAPACITY = 64;
+
+    PostedTasks() :
+        refcount_(1),
+        nextTicket_(1),
+        oldestTicket_(1)
+    {
+        for (std::atomic<uint32_t>& ticket : tickets_)
+        {
+            ticket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void addref() { refcount_.fetch_add(1, std::memory_order_relaxed); }
+
+    void release()
+    {
+        if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    /// Gives the task a ticket (if a slot is free), before it is
+    /// posted. Only called by the consumer.
+    void add(TileQueryTask& task)
+    {
+        uint32_t ticket = nextTicket_;
+        uint32_t slot = ticket % CAPACITY;
+        if (tickets_[slot].load(std::memory_order_acquire) != 0) return;
+        nextTicket_++;
+        addref();
+        task.setTicket(this, ticket);
+        tasks_[slot] = task;
+        // (The executor's queue publishes the ticket to the workers)
+        tickets_[slot].store(ticket, std::memory_order_relaxed);
+    }
+
+    /// Claims the task with the given ticket on behalf of a worker
+    /// (or the consumer, if it couldn't post the task), and drops the
+    /// reference held by the task.
+    ///
+    /// @return true if the caller should run the task, false if
+    ///   the consumer has already run it
+    ///
+    bool claim(uint32_t ticket)
+    {
+        uint32_t expected = ticket;
+        bool claimed = tickets_[ticket % CAPACITY].compare_exchange_strong(
+            expected, 0, std::memory_order_acq_rel);
+        release();
+        return claimed;
+    }
+
+    /// Claims the oldest task that no worker has picked up yet. Only
+    /// called by the consumer.
+    ///
+    /// @return true if a task was claimed (and placed into `task`)
+    ///
+    bool claimOldest(TileQueryTask& task)
+    {
+        for (; oldestTicket_ != nextTicket_; oldestTicket_++)
+        {
+            uint32_t ticket = oldestTicket_;
+            uint32_t slot = ticket % CAPACITY;
+            uint32_t expected = ticket;
+            if (tickets_[slot].compare_exchange_strong(
+                expected, 0, std::memory_order_acq_rel))
+            {
+                oldestTicket_++;
+                task = tasks_[slot];
+                task.setTicket(nullptr, 0);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::atomic<uint32_t> refcount_;
+    uint32_t nextTicket_;           // only used by the consumer
+    uint32_t oldestTicket_;         // only used by the consumer
+    /// The ticket of the task in each slot, or 0 once it has been claimed
+    std::atomic<uint32_t> tickets_[CAPACITY];
+    /// The consumer's copy of each task (only used by the consumer)
+    TileQueryTask tasks_[CAPACITY];
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,90 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturesBase.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// A world view whose setup work has been done once, so it can be
+/// executed many times at little cost: it holds on to the view's
+/// matcher and filter, and remembers its tile cover (the tiles that
+/// intersect the bounds, pass the filter's tile test and may contain
+/// the tags the matcher needs), sorted along a Hilbert curve.
+/// A Query created from it submits these tiles directly, without
+/// walking the tile index.
+///
+/// The PreparedQuery must outlive any Query created from it.
+///
+/// For distributed execution, the tile cover can be divided into
+/// shards: runs of consecutive tiles along the Hilbert curve whose
+/// total size (that of the tiles' blobs in the file) is roughly equal.
+/// Each machine prepares the same view with its own shard number and
+/// scans only that shard. Since the partition depends only on the
+/// GOL and the view, the shards of machines that have the same GOL
+/// add up to the full result, without any coordination: a feature
+/// that lives in several tiles is returned only by the shard that owns
+/// the copy the unsharded query would return.
+///
+class GEODESK_API PreparedQuery
+{
+public:
+    /// @throws QueryException if `view` isn't a world view
+    explicit PreparedQuery(const View& view) :
+        PreparedQuery(view, 0, 1)
+    {
+    }
+
+    /// Prepares only the tiles of the given shard (0 to shardCount - 1)
+    ///
+    /// @throws QueryException if `view` isn't a world view, or the
+    ///   shard number is out of range
+    PreparedQuery(const View& view, uint32_t shard, uint32_t shardCount);
+
+    template<typename T>
+    explicit PreparedQuery(const FeaturesBase<T>& features) :
+        PreparedQuery(features.view_)
+    {
+    }
+
+    template<typename T>
+    PreparedQuery(const FeaturesBase<T>& features, uint32_t shard, uint32_t shardCount) :
+        PreparedQuery(features.view_, shard, shardCount)
+    {
+    }
+
+    const View& view() const { return view_; }
+    FeatureStore* store() const { return view_.store(); }
+    /// The number of tiles that intersect the bounds and pass the
+    /// filter's tile test (including any ruled out by the TagSummary),
+    /// in all shards
+    uint32_t tileCount() const { return tileCount_; }
+    /// The tiles to be scanned, in Hilbert order
+    const std::vector<Query::OrderedTile>& tiles() const { return tiles_; }
+    /// The total size of the tiles to be scanned (only measured if
+    /// the tiles are divided into shards, otherwise 0)
+    uint64_t tileBytes() const { return tileBytes_; }
+    uint32_t shard() const { return shard_; }
+    uint32_t shardCount() const { return shardCount_; }
+    bool isShard() const { return shardCount_ > 1; }
+
+private:
+    void selectShard();
+
+    View view_;
+    uint32_t tileCount_;
+    uint32_t shard_;
+    uint32_t shardCount_;
+    uint64_t tileBytes_;
+    std::vector<Query::OrderedTile> tiles_;
+};
+
+// \endcond
+
+} // namespace geodesk
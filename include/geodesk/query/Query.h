@@ -4,16 +4,88 @@
 #pragma once
 
 #include "AbstractQuery.h"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
-#include <unordered_set>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <clarisma/data/FlatHashSet.h>
+#include <geodesk/query/QueryCheckpoint.h>
+#include <geodesk/query/QueryLayer.h>
+#include <geodesk/query/QueryPlanner.h>
+#include <geodesk/query/QueryPriority.h>
 #include <geodesk/query/QueryResults.h>
+#include <geodesk/query/QueryResultsPool.h>
+#include <geodesk/query/QueryStats.h>
 #include <geodesk/query/TileIndexWalker.h>
+#include <geodesk/query/TileReducer.h>
 #include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileReader.h>
 #include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
 
 namespace geodesk {
 
 class Filter;
+class NumericIndex;
+class PostedTasks;
+class PreparedQuery;
+class QueryCache;
+class ReorderWindow;
+class TagSummary;
+class TileScanCache;
+class TileStatistics;
+
+struct QueryOptions
+{
+    QueryPriority priority = QueryPriority::INTERACTIVE;
+    /// The maximum number of tiles of the query that may be queued
+    /// or in progress at any time (0 = no limit), which keeps a large
+    /// query from monopolizing the executor
+    uint32_t maxTilesInFlight = 0;
+    /// If set, the results of tiles are returned in the order of the
+    /// tiles along a Hilbert curve (rather than in the order in which
+    /// they complete), so the output of a query is reproducible and
+    /// spatially clustered; tiles are still scanned in parallel, but
+    /// no more than ReorderWindow::SIZE at a time
+    bool ordered = false;
+    /// If less than 1, only about this fraction of the tiles is
+    /// scanned: they are chosen by systematic sampling along the tile
+    /// walk (one tile per stratum of 1/sampleFraction consecutive tiles),
+    /// starting at an offset derived from `sampleSeed`
+    double sampleFraction = 1.0;
+    uint32_t sampleSeed = 0;
+    /// If set, each tile is marked for sequential access before it is
+    /// scanned, so the OS reads ahead aggressively within the tile
+    /// (helps large scans of a cold store; see FeatureStore::adviseTile)
+    bool sequential = false;
+    /// The approximate number of bytes the query may use for results
+    /// that have not been consumed yet and for deduplication (0 = no
+    /// limit, other than that of the store). Once its pending results
+    /// reach the limit, the query only keeps one tile in flight until
+    /// the consumer catches up; if its deduplication set grows while
+    /// the query is over the limit, next() throws a QueryException.
+    size_t memoryLimit = 0;
+    /// If set, the query stops once this point in time has passed: no
+    /// further tiles are submitted, tiles in flight are cancelled, and
+    /// next() returns no more features (results that have not been
+    /// retrieved by then are discarded; see Query::isComplete())
+    std::chrono::steady_clock::time_point deadline = {};
+    /// If set, tiles are scanned in order of their distance from this
+    /// point (rather than in the order of the tile index, or along the
+    /// Hilbert curve for an ordered query), so a query that is cut
+    /// short by its deadline returns the features closest to it
+    std::optional<Coordinate> focus;
+    /// If set, the query resumes from this checkpoint (taken by
+    /// Query::checkpoint()), rather than starting from the beginning.
+    /// Only ordered single-box queries without layers can be resumed;
+    /// the checkpoint need not remain valid once the query has been
+    /// constructed.
+    const QueryCheckpoint* resume = nullptr;
+};
 
 // TODO: Maybe call this a "Cursor"
 
@@ -21,46 +93,368 @@ class Query : public AbstractQuery
 {
 public:
     Query(FeatureStore* store, const Box& box, FeatureTypes types, 
-        const MatcherHolder* matcher, const Filter* filter); 
+        const MatcherHolder* matcher, const Filter* filter,
+        TileReducer* reducer = nullptr, QueryStats* stats = nullptr,
+        const QueryOptions& options = {}) :
+        Query(store, box, types, matcher, filter, reducer, nullptr, 0,
+            stats, options)
+    {
+    }
+
+    /// Creates a query that looks for features in several (simple)
+    /// bounding boxes at once, walking the tile index only once for
+    /// their union. Results must be retrieved using next(uint32_t*),
+    /// which yields a feature once for every box it intersects.
+    /// The boxes must remain valid for the lifetime of the query.
+    ///
+    Query(FeatureStore* store, const Box* boxes, uint32_t boxCount,
+        FeatureTypes types, const MatcherHolder* matcher, const Filter* filter,
+        const QueryOptions& options = {}) :
+        Query(store, unionOf(boxes, boxCount), types, matcher, filter,
+            nullptr, boxes, boxCount, nullptr, options)
+    {
+    }
+
+    /// Creates a query that finds the features of several layers
+    /// (e.g. roads, buildings and water for a map tile) in one pass:
+    /// each tile is scanned once, its candidates are checked against
+    /// every layer whose types they match, and each feature is
+    /// routed to the layers that accept it. Index roots are pruned by
+    /// the union of the layers' key masks. Results must be retrieved
+    /// using next(uint32_t*), which yields a feature once for every
+    /// layer it belongs to. The layers (and their matchers and filters)
+    /// must remain valid for the lifetime of the query.
+    ///
+    Query(FeatureStore* store, const Box& box, const QueryLayer* layers,
+        uint32_t layerCount, QueryStats* stats = nullptr,
+        const QueryOptions& options = {});
+
+    /// Creates a query from a PreparedQuery, which must remain valid
+    /// for the lifetime of the query. Its tiles are submitted as-is,
+    /// without walking the tile index.
+    ///
+    Query(const PreparedQuery& prepared, TileReducer* reducer = nullptr,
+        QueryStats* stats = nullptr, const QueryOptions& options = {});
+
     ~Query();
     const Box& bounds() const { return tileIndexWalker_.bounds(); }
     FeatureTypes types() const { return types_; }
     const MatcherHolder* matcher() const { return matcher_; }
     const Filter* filter() const { return filter_; }
+    TileReducer* reducer() const { return reducer_; }
     FeatureStore* store() const { return store_; }
-    void offer(QueryResults* results);
+    const Box* boxes() const { return boxes_; }
+    uint32_t boxCount() const { return boxCount_; }
+    const QueryLayer* layers() const { return layers_; }
+    uint32_t layerCount() const { return layerCount_; }
+    const QueryOptions& options() const { return options_; }
+    /// Whether the query scans only one shard of the tile cover of
+    /// a PreparedQuery (see PreparedQuery)
+    bool isShard() const { return isShard_; }
+    /// For a sampled query: the number of tiles that intersect the
+    /// bounds and pass the filter's tile test
+    uint32_t tileCount() const { return tileCount_; }
+    /// For a sampled query: the number of tiles in the sample (including
+    /// any that were skipped based on the TagSummary or TileStatistics)
+    uint32_t sampledTileCount() const { return sampledTileCount_; }
+    /// The TileQueryTask::LeafMode for the given index
+    uint8_t leafMode(FeatureIndexType indexType) const { return leafModes_[indexType]; }
+    QueryPlanner& planner() { return planner_; }
+    /// The cache of per-tile results, or nullptr if not used
+    QueryCache* cache() const { return cache_; }
+    /// The TileReader used to load tiles, or nullptr if tiles are
+    /// accessed via the store's memory mapping (only queries with a
+    /// TileReducer use the store's TileReader)
+    TileReader* tileReader() const { return tileReader_; }
+    /// The cache of transcoded hot tiles, or nullptr if not used
+    TileScanCache* scanCache() const { return scanCache_; }
+    /// Keeps a tile loaded by the TileReader in memory until the query
+    /// is destroyed (safe to call from any thread)
+    void retainTile(TileReader::Pin&& pin);
+    /// The statistics collected by this query, or nullptr if disabled
+    QueryStats* stats() const { return stats_; }
+    /// Merges the statistics of a tile scan (safe to call from any thread)
+    void addStats(const QueryStats& tileStats);
+    /// Posts the results of a tile (`sequence` is the tile's position
+    /// in the output, only used by ordered queries)
+    void offer(QueryResults* results, uint32_t sequence);
+    QueryResults* allocResults(uint32_t capacity) { return resultsPool_.alloc(capacity); }
+    /// The bytes currently allocated by this query (for result
+    /// buckets and its deduplication set)
+    size_t memoryUsed() const
+    {
+        return resultsPool_.allocatedBytes() + dedupBytes_;
+    }
+    uint32_t firstBucketSize() const
+    {
+        return firstBucketSize_.load(std::memory_order_relaxed);
+    }
+    /// Whether a TileQueryTask may split a large tile among several
+    /// tasks (not if the results of a tile must stay together, as
+    /// they must for ordered, cached and reduced queries)
+    bool maySplitTiles() const
+    {
+        return !options_.ordered && !cache_ && !reducer_;
+    }
+    /// Records that a TileQueryTask has handed part of its tile to
+    /// another task (which will post its results separately). Must
+    /// be called before the part is posted.
+    void addTilePart()
+    {
+        tileParts_.fetch_add(1, std::memory_order_release);
+    }
+    /// Records the size of a scanned tile, which is used to decide
+    /// how many tiles each task should scan
+    void addScannedTile(uint32_t bytes)
+    {
+        scannedBytes_.fetch_add(bytes, std::memory_order_relaxed);
+        scannedTiles_.fetch_add(1, std::memory_order_relaxed);
+    }
+    /// Stops the query: no further tiles are submitted, tiles that
+    /// have not started yet are discarded without being scanned, tiles
+    /// in progress stop at their next index branch, and next() returns
+    /// no more features. Safe to call from any thread.
     void cancel();
+    /// Records an exception thrown while scanning a tile (e.g. by a
+    /// TileReducer), which can't propagate on a worker thread, and
+    /// cancels the query. The consumer rethrows it from next().
+    /// Safe to call from any thread (only the first exception is kept).
+    void fail(std::exception_ptr error);
+    bool isCancelled() const
+    {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+    /// Whether the query has returned (or is still able to return) all
+    /// of its features, i.e. it has been neither cancelled nor stopped
+    /// at its deadline
+    bool isComplete() const { return !isCancelled(); }
 
     FeaturePtr next();
 
+    /// Captures the position of the query after the feature most
+    /// recently returned by next() (or poll()), so an equivalent query
+    /// can resume from there via QueryOptions::resume
+    ///
+    /// @throws QueryException if the query isn't ordered, or
+    ///   has multiple boxes
+    ///
+    QueryCheckpoint checkpoint() const;
+
+    /// The tip of the tile that holds the feature most recently
+    /// returned by next()
+    Tip currentTip() const { return Tip(currentResults_->tip); }
+    /// The start of the tile that holds the feature most recently
+    /// returned by next()
+    clarisma::DataPtr currentTile() const { return currentResults_->pTile; }
+
+    /// For a multi-box query, returns the next feature and stores the
+    /// index of the box it intersects in `*pBoxIndex`. A feature that
+    /// intersects several boxes is returned once for each of them
+    /// (consecutively). For a layered query, `*pBoxIndex` receives
+    /// the index of the feature's layer instead.
+    ///
+    FeaturePtr next(uint32_t* pBoxIndex);
+
+    enum class Status
+    {
+        READY,      // features were returned
+        PENDING,    // waiting for tiles to complete
+        DONE        // no more features
+    };
+
+    /// Appends all features that are available right now to `batch`,
+    /// without waiting for tiles in progress (single-box queries
+    /// without layers only).
+    ///
+    Status poll(std::vector<FeaturePtr>& batch);
+
+    using ReadyCallback = void (*)(void* context);
+
+    /// Arranges for `callback` to be called once more results (or the
+    /// end of the query) become available. The callback is called at
+    /// most once per call to onReady(), from a worker thread, so it
+    /// should only schedule a call to poll() rather than call it itself.
+    ///
+    /// @return false if results are already available, in which case
+    ///   the callback won't be called (i.e. the caller should poll now)
+    ///
+    bool onReady(ReadyCallback callback, void* context);
+
     static constexpr uint32_t REQUIRES_DEDUP = 0x8000'0000;
+    static constexpr int MAX_BATCH_SIZE = 64;
+    static constexpr int TAKE_SPIN_COUNT = 16;
+    /// Once tiles turn out to be smaller than this on average (in bytes),
+    /// runs of tiles are scanned by a single task
+    static constexpr uint32_t COALESCE_TILE_SIZE = 16 * 1024;
+    static constexpr int MAX_TILES_PER_TASK = 8;
+
+    /// For ordered, sampled or prepared queries: a tile to be scanned,
+    /// and its key for sorting (the Hilbert distance of its center, or
+    /// its distance from the focus point)
+    struct OrderedTile
+    {
+        uint32_t key;
+        uint32_t tipAndFlags;
+        uint32_t turboFlags;
+        Tile tile;
+    };
 
 private:
+    Query(FeatureStore* store, const Box& box, FeatureTypes types, 
+        const MatcherHolder* matcher, const Filter* filter,
+        TileReducer* reducer, const Box* boxes, uint32_t boxCount,
+        QueryStats* stats, const QueryOptions& options,
+        const PreparedQuery* prepared = nullptr,
+        const QueryLayer* layers = nullptr, uint32_t layerCount = 0);
+
+    static Box unionOf(const Box* boxes, uint32_t count);
+    /// Whether each result is a group of items (see next(uint32_t*))
+    bool hasGroupedResults() const { return boxCount_ || layerCount_; }
+    bool nextItem(uint32_t* pItem, bool wait = true);
+    void checkFailed();
+    bool isDuplicate(FeaturePtr pFeature);
+    bool isOverMemoryBudget() const;
+    void dedupSetGrown();
+    bool hasCompletedTile() const;
     const QueryResults* take();
+    const QueryResults* takeOrdered();
+    template<typename Ready>
+    bool waitForResults(Ready isReady);
+    bool waitForTile(int32_t completed);
+    bool helpWorkers();
+    bool mayMatchCurrentTile();
+    bool usesTileList() const { return tileList_ != nullptr; }
+    static OrderedTile currentTile(const TileIndexWalker& walker);
+    static void sortTiles(std::vector<OrderedTile>& tiles);
+    void sortTilesByFocus();
+    bool hasDeadline() const
+    {
+        return options_.deadline != std::chrono::steady_clock::time_point();
+    }
+    bool isPastDeadline() const
+    {
+        return hasDeadline() && std::chrono::steady_clock::now() >= options_.deadline;
+    }
+    bool isSampled(uint32_t n) const;
+    void collectTiles();
+    void samplePreparedTiles(const PreparedQuery& prepared);
+    bool nextTile(TileQueryTask* task);
+    int tilesPerTask() const;
     void requestTiles();
-    static void deleteResults(const QueryResults* res);
+    void recycleResults(const QueryResults* res);
+    void adaptBucketSize();
+    void resume(const QueryCheckpoint& checkpoint);
+    void skipResumedItems();
 
     // FeatureStore* store_;  // moved to AbstractQuery
     FeatureTypes types_;
     const MatcherHolder* matcher_;
     const Filter* filter_;
+    TileReducer* reducer_;
+    const Box* boxes_;
+    uint32_t boxCount_;
+    const QueryLayer* layers_;
+    uint32_t layerCount_;       // if non-zero, `matcher_` is owned by the query
+    QueryStats* stats_;
+    QueryOptions options_;
+    uint8_t leafModes_[4];
+    QueryPlanner planner_;
+    /// Used to skip tiles that lack the tags required by the
+    /// matcher (nullptr if the store has no summary)
+    const TagSummary* tagSummary_;
+    /// Used to skip tiles without features in any of the index
+    /// categories the matcher requires (nullptr if the matcher doesn't
+    /// require any, or the store has no statistics)
+    uint32_t requiredCategories_[4];
+    const TileStatistics* tileStatistics_;
+    /// Used to skip tiles whose values for the key of the matcher's
+    /// required numeric range all lie outside of it (nullptr if the
+    /// matcher requires no range, or the key isn't indexed)
+    const NumericIndex* numericIndex_;
+    int numericKey_;            // the key's number within the index
+    /// Multi-box, layered and reduced queries aren't cached
+    QueryCache* cache_;
+    TileReader* tileReader_;
+    TileScanCache* scanCache_;
+    /// Statistics of the tile walk and the consumer thread (merged into
+    /// `stats_` when the query is destroyed, only used if enabled)
+    QueryStats consumerStats_;
+    std::chrono::steady_clock::time_point startTime_;
+    /// For multi-box queries: the current feature, and the number of
+    /// its matching box indexes that have not been returned yet
+    FeaturePtr multiBoxFeature_;
+    uint32_t multiBoxRemaining_;
     int32_t pendingTiles_;      // TODO: rearrange to avoid needless gaps
     const QueryResults* currentResults_;
-    int32_t currentPos_;
+    uint32_t currentPos_;
     bool allTilesRequested_;
-    std::unordered_set<uint64_t> potentialDupes_;
+    bool isShard_;
+    clarisma::FlatHashSet<uint64_t> potentialDupes_;     // idBits are never 0
+    size_t dedupBytes_;         // memory of potentialDupes_
+    uint64_t consumedResults_;
+    uint64_t consumedTiles_;
+    QueryResultsPool resultsPool_;
     TileIndexWalker tileIndexWalker_;
 
-    // these are used by multiple threads:
-    // TODO: padding to avoid false sharing
-    // maybe use TileIndexWalker for padding as it has lots
-    // of unused entries?
+    /// All tiles of an ordered or sampled query, in output order
+    std::vector<OrderedTile> orderedTiles_;
+    /// The tiles to submit: `orderedTiles_`, the tiles of a
+    /// PreparedQuery, or nullptr if the query walks the tile index
+    const std::vector<OrderedTile>* tileList_;
+    uint32_t tileCount_;
+    uint32_t sampledTileCount_;
+    uint32_t nextOrderedTile_;      // next tile to request
+    /// The completed tiles of an ordered query that wait for their
+    /// turn (nullptr if the query isn't ordered)
+    std::unique_ptr<ReorderWindow> reorder_;
+    /// The tasks we have posted, which the consumer can claim while
+    /// they are queued (created when the first task is posted)
+    PostedTasks* postedTasks_;
+
+    // these are used by multiple threads (kept on separate cache lines
+    // to avoid false sharing between workers and the consumer):
+
+    /// Lock-free stack of result buckets posted by worker threads
+    /// (terminated by QueryResults::EMPTY). Buckets of one tile stay
+    /// in order; the order of tiles is not preserved.
+    alignas(64) std::atomic<QueryResults*> queuedResults_;
+    /// Number of tiles completed since the consumer last called take();
+    /// the consumer parks on this counter when there is nothing to do
+    /// (or on `tileCompleted_`, if the query has a deadline).
+    alignas(64) std::atomic<int32_t> completedTiles_;
+    std::mutex completionMutex_;
+    std::condition_variable tileCompleted_;
+    /// Capacity of the first bucket allocated by each tile; starts small
+    /// and grows once tiles turn out to yield many results (read by workers,
+    /// written by the consumer)
+    std::atomic<uint32_t> firstBucketSize_;
+    std::atomic<bool> cancelled_;
+    /// Number of extra results posted because tiles were split
+    /// (added to pendingTiles_ by the consumer)
+    std::atomic<int32_t> tileParts_;
+    std::atomic<uint64_t> scannedBytes_;
+    std::atomic<uint32_t> scannedTiles_;
+    /// Set while the consumer waits for a ReadyCallback
+    std::atomic<bool> readyArmed_;
+    /// Number of offer() calls in progress; the Query can't be
+    /// destroyed until they have all returned
+    std::atomic<int32_t> offersInFlight_;
+    ReadyCallback readyCallback_;
+    void* readyContext_;
+    /// Set by nextItem() if it returned false because it would
+    /// have had to wait
+    bool wouldBlock_;
+    /// Set once a worker has called fail()
+    std::atomic<bool> failed_;
+    std::exception_ptr workerError_;        // requires errorMutex_
+    std::mutex errorMutex_;
+    std::mutex statsMutex_;
+    /// The tiles loaded by the TileReader whose features have been
+    /// posted to the consumer (released when the query is destroyed)
+    std::vector<TileReader::Pin> retainedTiles_;
+    std::mutex retainedTilesMutex_;
 
-    std::mutex mutex_;
-    std::condition_variable resultsReady_;  // requires mutex_
-    QueryResults* queuedResults_;           // requires mutex_
-    int32_t completedTiles_;                // requires mutex_
-    // bool isCancelled_;                      // requires mutex_
+    friend class PreparedQuery;
 };
 
 
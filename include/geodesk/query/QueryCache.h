@@ -0,0 +1,111 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+class Filter;
+class MatcherHolder;
+
+/// \cond lowlevel
+///
+/// Remembers the results of tile scans (the relative pointers a
+/// TileQueryTask would add to its QueryResults), so queries that are
+/// repeated with the same bounds, types, matcher and filter can skip
+/// scanning tiles whose results are cached. Matchers and filters are
+/// identified by address; each entry holds a reference to them, so the
+/// address cannot be reused by a different object while it is cached.
+///
+/// The cache is bounded by an approximate number of bytes, evicting
+/// the least recently used tiles first. It is split into shards to
+/// keep worker threads from contending on a single lock.
+///
+class GEODESK_API QueryCache
+{
+public:
+    struct Key
+    {
+        uint32_t tipAndFlags;       // includes the north/west flags
+        uint32_t types;
+        const MatcherHolder* matcher;
+        const Filter* filter;
+        Box bounds;
+
+        bool operator==(const Key& other) const
+        {
+            return tipAndFlags == other.tipAndFlags &&
+                types == other.types && matcher == other.matcher &&
+                filter == other.filter && bounds == other.bounds;
+        }
+    };
+
+    using Items = std::shared_ptr<const std::vector<uint32_t>>;
+
+    explicit QueryCache(size_t maxBytes);
+    ~QueryCache();
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    /// The number of bytes occupied by the cached results
+    size_t bytes();
+
+    /// Returns the cached results of a tile, or nullptr if not cached.
+    Items lookup(const Key& key);
+
+    /// Adds the results of a tile scan, evicting older tiles as needed.
+    void insert(const Key& key, std::vector<uint32_t>&& items);
+
+    /// Drops all cached tiles if the store has changed since they
+    /// were cached.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+    void clear();
+
+    static constexpr int SHARD_COUNT = 16;
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        Items items;
+        size_t bytes;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;       // most recently used first
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    Shard& shard(const Key& key);
+    static void releaseEntry(const Entry& entry);
+
+    size_t maxBytes_;
+    std::unique_ptr<Shard[]> shards_;
+    std::mutex versionMutex_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureTypes.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+
+/**
+ * The position of an ordered Query, from which an equivalent query
+ * can resume later (in another process, even) without returning any
+ * feature twice or skipping one: the tile it was in (its sequence in
+ * the Hilbert order of the tile walk), the number of items of that
+ * tile that were consumed, and the features that were returned and
+ * may appear again in tiles that haven't been scanned yet.
+ *
+ * Because the tiles and their items are identified by position, a
+ * checkpoint is only valid for the same GOL (identified by its creation
+ * timestamp and size), bounds, types, matcher and filter; Query checks
+ * all but the matcher and filter, which are up to the caller.
+ *
+ * Checkpoints also allow keyset pagination of large results: each
+ * page is a query that resumes from the checkpoint taken at the end
+ * of the previous page.
+ */
+struct GEODESK_API QueryCheckpoint
+{
+    uint64_t storeTimestamp = 0;
+    uint64_t storeSize = 0;
+    Box bounds;
+    FeatureTypes types = 0;
+    /// The number of tiles the query scans
+    uint32_t tileCount = 0;
+    /// The sequence of the tile in which to resume
+    uint32_t tile = 0;
+    /// The number of items of that tile that have been consumed
+    uint32_t items = 0;
+    /// The idBits of the returned features that live in multiple tiles
+    /// (sorted)
+    std::vector<uint64_t> dedupKeys;
+
+    bool operator==(const QueryCheckpoint& other) const = default;
+
+    /// Returns the checkpoint at the start of a query of the given
+    /// store, bounds and types that scans `tileCount` tiles
+    static QueryCheckpoint start(const FeatureStore* store, const Box& bounds,
+        FeatureTypes types, uint32_t tileCount);
+
+    /// @throws QueryException if the checkpoint wasn't taken by a
+    ///   query of the given store, bounds and types that scans
+    ///   `tileCount` tiles
+    void checkQuery(const FeatureStore* store, const Box& bounds,
+        FeatureTypes types, uint32_t tileCount) const;
+
+    std::vector<uint8_t> serialize() const;
+
+    /// @throws QueryException if `data` isn't a valid checkpoint
+    static QueryCheckpoint deserialize(std::span<const uint8_t> data);
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,38 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureTypes.h>
+
+namespace geodesk {
+
+class FeatureStore;
+class Filter;
+class MatcherHolder;
+struct FastFilterHint;
+
+/// One of the layers of a layered query: the features of the given
+/// types that match the matcher and the filter (if any)
+struct QueryLayer
+{
+    FeatureTypes types = FeatureTypes::ALL;
+    const MatcherHolder* matcher = nullptr;     // nullptr = all features
+    const Filter* filter = nullptr;
+
+    /// Checks whether the layer accepts the given feature (which has
+    /// already passed the query's bbox test)
+    bool accept(FeatureStore* store, FeaturePtr pFeature,
+        const FastFilterHint& fastFilterHint) const;
+
+    /// The types accepted by any of the layers
+    static FeatureTypes typesOf(const QueryLayer* layers, uint32_t count);
+
+    /// Creates the matcher of a layered query (the caller receives
+    /// a reference to it)
+    static const MatcherHolder* createMatcher(const QueryLayer* layers, uint32_t count);
+};
+
+} // namespace geodesk
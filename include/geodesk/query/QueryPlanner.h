@@ -0,0 +1,70 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Decides, based on the selectivity observed in the tiles scanned so
+/// far, whether a query's Filter should be evaluated before or after its
+/// Matcher. Each predicate is ranked by its cost per rejected candidate
+/// (cost / (1 - selectivity)), and the one with the lower rank runs first
+/// (the classic ordering for independent predicates). Until enough
+/// candidates have been sampled, the Matcher runs first.
+///
+/// Costs are expressed in units of a Matcher call.
+///
+class QueryPlanner
+{
+public:
+    /// Candidate counts collected by a TileQueryTask for one tile
+    struct Sample
+    {
+        uint32_t matcherCalls = 0;
+        uint32_t matcherAccepts = 0;
+        uint32_t filterCalls = 0;
+        uint32_t filterAccepts = 0;
+
+        bool isEmpty() const { return matcherCalls == 0 && filterCalls == 0; }
+    };
+
+    explicit QueryPlanner(double filterCost) :
+        filterCost_(filterCost),
+        matcherCalls_(0),
+        matcherAccepts_(0),
+        filterCalls_(0),
+        filterAccepts_(0),
+        filterFirst_(false)
+    {
+    }
+
+    bool filterFirst() const
+    {
+        return filterFirst_.load(std::memory_order_relaxed);
+    }
+
+    /// Adds the counts of a tile and re-evaluates the plan
+    /// (safe to call from any thread).
+    void addSample(const Sample& sample);
+
+    static constexpr uint32_t MIN_SAMPLE_SIZE = 256;
+
+private:
+    static double rank(double cost, uint64_t calls, uint64_t accepts);
+
+    double filterCost_;
+    std::atomic<uint64_t> matcherCalls_;
+    std::atomic<uint64_t> matcherAccepts_;
+    std::atomic<uint64_t> filterCalls_;
+    std::atomic<uint64_t> filterAccepts_;
+    std::atomic<bool> filterFirst_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,19 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+
+namespace geodesk {
+
+/// How urgently the tiles of a query are scanned: the executor only
+/// picks up tiles of BATCH queries if no INTERACTIVE tiles are waiting.
+///
+enum class QueryPriority : uint8_t
+{
+    INTERACTIVE = 0,
+    BATCH = 1
+};
+
+} // namespace geodesk
@@ -0,0 +1,155 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <clarisma/io/File.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/View.h>
+#include <geodesk/filter/Filter.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/**
+ * A query as captured by a QueryRecorder: the View it ran on (types,
+ * bounds or related feature, GOQL, filters), how the caller consumed
+ * it and how long that took. Everything that identifies a feature is
+ * kept as a typed ID, so a RecordedQuery can be replayed against any
+ * build that opens the same GOL (or a newer one of the same area).
+ */
+struct GEODESK_API RecordedQuery
+{
+    enum class Consumption : uint8_t
+    {
+        ITERATE,        // via FeatureIterator (begin(), first(), one(), vectors)
+        COUNT
+    };
+
+    struct FilterArgs
+    {
+        std::string name;           // Filter::name()
+        Filter::Source source;
+    };
+
+    uint64_t start = 0;             // microseconds since recording started
+    uint32_t thread = 0;            // in the order threads first recorded
+    Consumption consumption = Consumption::ITERATE;
+    bool complete = true;           // false if iteration stopped early
+    uint64_t results = 0;           // features iterated or counted
+    uint64_t nanos = 0;             // from begin() until the iterator was
+                                    // discarded (includes the caller's work)
+    int view = View::WORLD;
+    FeatureTypes types = FeatureTypes::ALL;
+    Box bounds = Box::ofWorld();    // WORLD views only
+    uint64_t relatedId = 0;         // typed ID (0 for an anonymous node)
+    Coordinate relatedXY;           // the anonymous node (PARENTS only)
+    std::vector<FilterArgs> filters;
+    bool usesMatcher = false;
+    bool queryKnown = true;         // false if the matcher's GOQL was
+                                    // no longer in the matcher cache
+    std::string query;              // normalized GOQL (the queries of an
+                                    // intersection are separated by '\0')
+
+    /// Describes the given view (without its consumption)
+    static RecordedQuery of(const View& view);
+
+    /// Returns true if replay() can reproduce this query: its GOQL is
+    /// known, and all its filters can be re-created (only those created
+    /// by Filters can be)
+    bool isReplayable() const;
+
+    /// Re-creates the view of this query
+    ///
+    /// @throws QueryException if the query isn't replayable, or if
+    ///   a feature it refers to is not in the store
+    View toView(FeatureStore* store) const;
+
+    /// Consumes the given view (created by toView()) the way this query
+    /// was consumed (an iteration that was stopped early stops after the
+    /// same number of features), and returns the number of features
+    /// retrieved
+    uint64_t replay(const View& view) const;
+
+    /// Appends this query as a line of the log format (see QueryRecorder)
+    void format(std::string& out) const;
+
+    /// Parses a line of the log format (without the line break)
+    ///
+    /// @throws clarisma::ParseException if the line is malformed
+    static RecordedQuery parse(std::string_view line);
+};
+
+/**
+ * Captures the queries of the stores it has been installed on (via
+ * FeatureStore::setRecorder()) into a log with one tab-separated line
+ * per query:
+ *
+ *   start thread consumption results complete nanos view types
+ *   context filters query
+ *
+ * `context` is the bounding box of a world view (`-` if unbounded),
+ * or the related feature (`way/123`, or `@x,y` for an anonymous node);
+ * `filters` are `name:ref` or `name:ref:meters`, separated by `;` (or
+ * `-` if none), where `ref` is a typed ID or `@x,y`. `query` is empty
+ * if the view has no matcher, `?` if its GOQL is unknown; tabs, line
+ * breaks, backslashes and nulls in it are escaped.
+ *
+ * A query is recorded once it has been consumed (i.e. when a
+ * FeatureIterator is discarded, or a count has been taken). Lines are
+ * buffered and written in batches, and on destruction. Thread-safe.
+ */
+class GEODESK_API QueryRecorder
+{
+public:
+    static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    /// @throws IOException if the log can't be created
+    explicit QueryRecorder(const char* fileName);
+    ~QueryRecorder();
+
+    /// Sets the thread number of the query (that of the calling
+    /// thread) and appends it to the log
+    void record(RecordedQuery& query);
+    void flush();
+
+    uint64_t queryCount() const noexcept
+    {
+        return queryCount_.load(std::memory_order_relaxed);
+    }
+
+    /// Microseconds since this recorder was created
+    uint64_t elapsedMicros() const noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - started_).count();
+    }
+
+    /// Reads a query log (blank lines and lines starting with `#`
+    /// are skipped)
+    ///
+    /// @throws IOException if the file can't be read
+    /// @throws clarisma::ParseException if the log is malformed
+    static std::vector<RecordedQuery> load(const char* fileName);
+
+private:
+    void writeBuffer();
+
+    std::chrono::steady_clock::time_point started_;
+    std::mutex mutex_;
+    clarisma::File file_;
+    std::string buffer_;
+    std::atomic<uint64_t> queryCount_ = 0;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <clarisma/util/DataPtr.h>
 
@@ -17,11 +18,14 @@ struct QueryResultsHeader
     QueryResults* next;
     clarisma::DataPtr pTile;
     uint32_t count;
+    uint32_t capacity;
+    uint32_t tip;       // the tile that pTile points to
 };
 
 struct QueryResults : public QueryResultsHeader
 {
     static const uint32_t DEFAULT_BUCKET_SIZE = 256;
+    static const uint32_t SMALL_BUCKET_SIZE = 32;
     static const uint32_t POTENTIAL_DUPLICATE = 0x8000'0000;
 
     static QueryResultsHeader EMPTY_HEADER;
@@ -29,7 +33,19 @@ struct QueryResults : public QueryResultsHeader
 
     bool isFull() const
     {
-        return count == DEFAULT_BUCKET_SIZE;
+        return count == capacity;
+    }
+
+    /// Number of bytes needed for a bucket that holds `capacity` items
+    /// (Buckets are allocated at their actual capacity, which may be
+    /// less than the declared length of `items`)
+    ///
+    static size_t allocSize(uint32_t capacity)
+    {
+        // (offsetof isn't valid for a type that isn't standard-layout;
+        // `items` comes last, so this is at least its offset)
+        return sizeof(QueryResults) - sizeof(QueryResults::items) +
+            capacity * sizeof(uint32_t);
     }
 
     uint32_t items[DEFAULT_BUCKET_SIZE];
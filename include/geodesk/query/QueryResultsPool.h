@@ -0,0 +1,153 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <geodesk/query/QueryResults.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A recycling allocator for QueryResults buckets, owned by a Query.
+/// Worker threads draw buckets from it, the consumer returns them once
+/// it has iterated their items, so a long-running query reaches a steady
+/// state in which no bucket is allocated from the heap at all.
+///
+/// Buckets come in two size classes; the freelists are guarded by
+/// a spinlock, which is held only for a pointer swap.
+///
+/// The pool keeps track of the bytes it has allocated from the heap,
+/// and of the bytes of the buckets that are currently handed out
+/// (i.e. results that have not been consumed yet). The heap bytes
+/// are also added to `account` (if given), which tallies the memory
+/// of all queries of a store.
+///
+class QueryResultsPool
+{
+public:
+    explicit QueryResultsPool(std::atomic<size_t>* account = nullptr) :
+        account_(account)
+    {
+        freeLists_[0] = nullptr;
+        freeLists_[1] = nullptr;
+    }
+
+    ~QueryResultsPool()
+    {
+        for (QueryResults* res : freeLists_)
+        {
+            while (res)
+            {
+                QueryResults* next = res->next;
+                destroy(res);
+                res = next;
+            }
+        }
+        if (account_)
+        {
+            account_->fetch_sub(allocatedBytes_.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+        }
+    }
+
+    /// The bytes of all buckets allocated by this pool
+    size_t allocatedBytes() const
+    {
+        return allocatedBytes_.load(std::memory_order_relaxed);
+    }
+
+    /// The bytes of the buckets that have been obtained via alloc(),
+    /// but not yet returned
+    size_t bytesInUse() const
+    {
+        return bytesInUse_.load(std::memory_order_relaxed);
+    }
+
+    /// Obtains an empty bucket that can hold `capacity` items, which
+    /// must be either QueryResults::SMALL_BUCKET_SIZE or
+    /// QueryResults::DEFAULT_BUCKET_SIZE.
+    ///
+    QueryResults* alloc(uint32_t capacity)
+    {
+        int sizeClass = sizeClassOf(capacity);
+        lock();
+        QueryResults* res = freeLists_[sizeClass];
+        if (res) freeLists_[sizeClass] = res->next;
+        unlock();
+        size_t size = QueryResults::allocSize(capacity);
+        if (!res)
+        {
+            res = reinterpret_cast<QueryResults*>(new uint8_t[size]);
+            res->capacity = capacity;
+            allocatedBytes_.fetch_add(size, std::memory_order_relaxed);
+            if (account_) account_->fetch_add(size, std::memory_order_relaxed);
+        }
+        bytesInUse_.fetch_add(size, std::memory_order_relaxed);
+        res->count = 0;
+        return res;
+    }
+
+    /// Returns a chain of buckets (terminated by QueryResults::EMPTY)
+    /// to the pool.
+    ///
+    void free(const QueryResults* res)
+    {
+        while (res != QueryResults::EMPTY)
+        {
+            QueryResults* bucket = const_cast<QueryResults*>(res);
+            res = res->next;
+            free(bucket);
+        }
+    }
+
+    void free(QueryResults* bucket)
+    {
+        int sizeClass = sizeClassOf(bucket->capacity);
+        bytesInUse_.fetch_sub(QueryResults::allocSize(bucket->capacity),
+            std::memory_order_relaxed);
+        lock();
+        bucket->next = freeLists_[sizeClass];
+        freeLists_[sizeClass] = bucket;
+        unlock();
+    }
+
+private:
+    static int sizeClassOf(uint32_t capacity)
+    {
+        assert(capacity == QueryResults::SMALL_BUCKET_SIZE ||
+            capacity == QueryResults::DEFAULT_BUCKET_SIZE);
+        return capacity == QueryResults::DEFAULT_BUCKET_SIZE ? 1 : 0;
+    }
+
+    static void destroy(QueryResults* res)
+    {
+        delete[] reinterpret_cast<uint8_t*>(res);
+    }
+
+    void lock()
+    {
+        while (lock_.test_and_set(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock()
+    {
+        lock_.clear(std::memory_order_release);
+    }
+
+    std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+    QueryResults* freeLists_[2];
+    std::atomic<size_t> allocatedBytes_{0};
+    std::atomic<size_t> bytesInUse_{0};
+    std::atomic<size_t>* account_;
+};
+
+// \endcond
+
+} // namespace geodesk
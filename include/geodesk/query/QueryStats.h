@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <geodesk/export.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// Execution statistics of a query. Collection is opt-in: a Query only
+/// updates its counters if it was given a QueryStats object. Each
+/// TileQueryTask counts into a QueryStats of its own and merges it into
+/// the query's once the tile is done, so workers don't contend on the
+/// counters.
+///
+struct GEODESK_API QueryStats
+{
+    static constexpr int MAX_LEVELS = 13;
+
+    // Tile index walk (consumer thread)
+    uint64_t tilesVisited = 0;
+    uint64_t tilesRejected[MAX_LEVELS] = {};    // by Filter::acceptTile(), per level
+    uint64_t tilesSkipped = 0;                  // ruled out by the TagSummary, TileStatistics or NumericIndex
+
+    // Tile scans (worker threads)
+    uint64_t tilesScanned = 0;
+    uint64_t tilesCancelled = 0;
+    uint64_t tilesFromCache = 0;                // served by the QueryCache
+    uint64_t tilesCounted = 0;                  // counted without checking features
+    uint64_t tilesTranscoded = 0;               // scanned in the form held by the TileScanCache
+    uint64_t tilesSplit = 0;                    // indexes scanned by separate tasks
+    uint64_t tilesCoalesced = 0;                // scanned by the task of another tile
+    uint64_t tasksHelped = 0;                   // run by the consumer while it waited
+    uint64_t indexRootsSearched = 0;
+    uint64_t indexRootsPruned = 0;              // rejected by the matcher's key mask
+    uint64_t branchesScanned = 0;
+    uint64_t leavesScanned = 0;
+    uint64_t bboxCandidates = 0;                // leaf features within the bbox
+    uint64_t boxLimitRejects = 0;               // too small or large for the filter
+    uint64_t matcherCalls = 0;
+    uint64_t matcherAccepts = 0;
+    uint64_t matcherMemoHits = 0;               // verdicts reused for a shared tag table
+    uint64_t filterCalls = 0;
+    uint64_t filterAccepts = 0;
+    uint64_t results = 0;
+
+    // Deduplication (consumer thread)
+    uint64_t dedupLookups = 0;
+    uint64_t duplicates = 0;
+
+    // Timing, in nanoseconds
+    uint64_t wallTime = 0;              // lifetime of the query
+    uint64_t workerTime = 0;            // sum of all tile scans
+    uint64_t consumerWaitTime = 0;      // consumer blocked on workers
+
+    void add(const QueryStats& other);
+    std::string toString() const;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,138 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <geodesk/query/QueryResults.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// The completed tiles of an ordered Query that wait for their turn:
+/// each tile is parked in the slot for its sequence (modulo SIZE) until
+/// the consumer takes it, so results come out in the order of the
+/// query's tile list. An ordered query never has more than SIZE tiles
+/// in flight.
+///
+/// Also tracks the position of the consumer within the current tile,
+/// which is what a QueryCheckpoint records.
+///
+class ReorderWindow
+{
+public:
+    static constexpr uint32_t SIZE = 256;
+
+    ReorderWindow() :
+        slots_(new std::atomic<QueryResults*>[SIZE]),
+        nextSequence_(0),
+        itemsBefore_(0),
+        skipItems_(0)
+    {
+        for (uint32_t i = 0; i < SIZE; i++)
+        {
+            slots_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /// Parks the results of a tile (`res` is the last bucket of its
+    /// circular list, or QueryResults::EMPTY if the tile had no
+    /// results). Called by workers, before they count the tile as
+    /// completed.
+    void put(uint32_t sequence, QueryResults* res)
+    {
+        // Unlink the tile's chain of buckets from its circular list
+        QueryResults* first = res;
+        if (res != QueryResults::EMPTY)
+        {
+            first = res->next;
+            res->next = QueryResults::EMPTY;
+        }
+        slots_[sequence % SIZE].store(first, std::memory_order_seq_cst);
+    }
+
+    bool isNextReady() const
+    {
+        return slots_[nextSequence_ % SIZE].load(std::memory_order_seq_cst) != nullptr;
+    }
+
+    /// Takes the chain of buckets of the next tile (terminated by
+    /// QueryResults::EMPTY), or returns nullptr if the tile hasn't
+    /// completed yet
+    QueryResults* takeNext()
+    {
+        QueryResults* res = slots_[nextSequence_ % SIZE].exchange(
+            nullptr, std::memory_order_acquire);
+        if (res)
+        {
+            nextSequence_++;
+            itemsBefore_ = 0;
+        }
+        return res;
+    }
+
+    /// The sequence of the next tile to be taken
+    uint32_t nextSequence() const { return nextSequence_; }
+
+    /// Records that the consumer is done with a bucket of the current tile
+    void consumed(uint32_t itemCount) { itemsBefore_ += itemCount; }
+
+    /// Returns the position of the consumer as the sequence of a tile
+    /// and the number of its items that have been consumed, given the
+    /// consumer's position within its current bucket (`tileDone` if it
+    /// has consumed all items of the current tile)
+    void position(uint32_t pos, bool tileDone, uint32_t* pTile, uint32_t* pItems) const
+    {
+        if (tileDone)
+        {
+            // (or a resumed query hasn't taken its first tile yet)
+            *pTile = nextSequence_;
+            *pItems = skipItems_;
+        }
+        else
+        {
+            *pTile = nextSequence_ - 1;
+            *pItems = itemsBefore_ + pos;
+        }
+    }
+
+    /// Moves the window of a query that resumes from a checkpoint to
+    /// its tile; `items` of that tile are skipped once it is taken
+    void resumeAt(uint32_t tile, uint32_t items)
+    {
+        nextSequence_ = tile;
+        skipItems_ = items;
+    }
+
+    bool hasItemsToSkip() const { return skipItems_ != 0; }
+
+    /// Returns the number of items of the current tile to skip (and
+    /// clears it, since they are skipped only once)
+    uint32_t takeItemsToSkip()
+    {
+        uint32_t skip = skipItems_;
+        skipItems_ = 0;
+        return skip;
+    }
+
+private:
+    /// The completed tiles, indexed by their sequence modulo SIZE
+    /// (nullptr = not yet completed, QueryResults::EMPTY = tile had
+    /// no results)
+    std::unique_ptr<std::atomic<QueryResults*>[]> slots_;
+    // The remaining members are only used by the consumer
+    uint32_t nextSequence_;
+    /// The number of items in the buckets of the current tile that
+    /// have been consumed
+    uint32_t itemsBefore_;
+    /// The items of the first tile taken by a resumed query that had
+    /// already been consumed when the checkpoint was taken
+    uint32_t skipItems_;
+};
+
+// \endcond
+
+} // namespace geodesk
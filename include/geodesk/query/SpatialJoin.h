@@ -0,0 +1,74 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <functional>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/View.h>
+
+namespace geodesk {
+
+/// The spatial relationship that SpatialJoin (and FeaturesBase::join())
+/// looks for between a feature `a` of the outer set and a feature `b`
+/// of the inner set.
+///
+enum class SpatialPredicate
+{
+    INTERSECTS,     ///< `a` intersects `b`
+    WITHIN,         ///< `a` lies within `b`
+    CONTAINS,       ///< `a` contains `b`
+    MAX_DISTANCE    ///< the closest points of `a` and `b` lie within a given distance
+};
+
+/// \cond lowlevel
+///
+/// Finds the pairs of features of two world views that are in a given
+/// spatial relationship, without running a query for each feature.
+///
+/// The outer features are retrieved by a single query and grouped by
+/// the tile they come from. Each group is handed to a worker thread,
+/// which runs one query for the inner features in the group's bounding
+/// box, indexes their bounding boxes in a PackedRTree (built by
+/// HilbertTreeBuilder), and tests each outer feature against the inner
+/// features whose bounding boxes intersect its own. The prepared filter
+/// used for the exact test is created at most once per feature and
+/// group (and is shared across groups via the PreparedFilterCache,
+/// if the store has one).
+///
+/// The pairs are delivered by a single output thread, so the consumer
+/// is never called concurrently; pairs arrive in no particular order.
+///
+class GEODESK_API SpatialJoin
+{
+public:
+    using Consumer = std::function<void(FeaturePtr outer, FeaturePtr inner)>;
+
+    /// @param meters the maximum distance (used by MAX_DISTANCE only)
+    /// @throws QueryException if the views aren't world views
+    ///   of the same store
+    SpatialJoin(const View& outer, const View& inner,
+        SpatialPredicate predicate, double meters = 0);
+
+    /// Calls `consumer` for each matching pair, then returns. If
+    /// `consumer` throws, the join is stopped and the exception is
+    /// rethrown.
+    ///
+    /// @param threads the number of worker threads
+    ///   (0 = as many as the store's query executor)
+    void run(Consumer consumer, int threads = 0);
+
+    /// The maximum number of outer features handled by one worker task
+    static constexpr size_t MAX_BATCH_SIZE = 4096;
+
+private:
+    View outer_;
+    View inner_;
+    SpatialPredicate predicate_;
+    double meters_;
+};
+
+// \endcond
+
+} // namespace geodesk
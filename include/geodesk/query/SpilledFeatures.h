@@ -0,0 +1,118 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include <clarisma/io/File.h>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/feature/forward.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Holds the results of a query that may be too large to fit into
+/// memory. Each feature is kept as a packed reference (the tip of its
+/// tile and its offset within the tile, plus its key for sorting),
+/// 16 bytes in all. Once the references take up more than `maxMemory`,
+/// they are sorted and written to a temporary file as a run. When the
+/// features are read back, the runs are merged (each run is read
+/// through a buffer, so the memory stays within the budget).
+///
+/// Features can be kept in the order in which they were added, or
+/// sorted by typed ID or by the Hilbert distance of their center
+/// (which keeps features that lie close to each other together).
+///
+/// Tiles are referenced by tip, so the features remain valid as long
+/// as the store is open (compressed tiles stay in memory once
+/// decompressed).
+///
+class GEODESK_API SpilledFeatures
+{
+public:
+    enum class Order
+    {
+        NONE,       ///< The order in which features were added
+        ID,         ///< By typed ID (see FeaturePtr::typedId())
+        HILBERT     ///< By Hilbert distance of the center of their bounds
+    };
+
+    static constexpr size_t DEFAULT_MAX_MEMORY = size_t(64) * 1024 * 1024;
+
+    explicit SpilledFeatures(FeatureStore* store, Order order = Order::NONE,
+        size_t maxMemory = DEFAULT_MAX_MEMORY);
+    ~SpilledFeatures();
+
+    SpilledFeatures(const SpilledFeatures&) = delete;
+    SpilledFeatures& operator=(const SpilledFeatures&) = delete;
+
+    /// Where to put the temporary file (default: the system's temp folder)
+    void tempDirectory(std::filesystem::path dir) { tempDir_ = std::move(dir); }
+
+    /// Adds a feature that lies in the tile with the given tip,
+    /// which starts at `pTile` (see Query::currentTip() and
+    /// Query::currentTile())
+    void add(Tip tip, clarisma::DataPtr pTile, FeaturePtr feature);
+
+    FeatureStore* store() const { return store_; }
+    Order order() const { return order_; }
+    uint64_t size() const { return size_; }
+    bool isEmpty() const { return size_ == 0; }
+    /// The number of runs that have been written to the temporary file
+    size_t spilledRuns() const { return runs_.size(); }
+
+    /// Calls `fn` for each feature, in the requested order
+    void forEach(const std::function<void(Feature)>& fn);
+
+    /// Removes all features (and the temporary file)
+    void clear();
+
+private:
+    struct Ref
+    {
+        uint64_t key;
+        uint32_t tip;
+        uint32_t offset;
+    };
+
+    static_assert(sizeof(Ref) == 16);
+
+    /// A sorted sequence of refs in the temporary file
+    struct Run
+    {
+        uint64_t start;     // offset of the first Ref
+        uint64_t count;
+    };
+
+    class RunReader;
+
+    uint64_t keyOf(FeaturePtr feature);
+    void sortRefs();
+    void spill();
+    FeaturePtr resolve(Ref ref);
+
+    FeatureStore* store_;
+    Order order_;
+    size_t maxRefs_;
+    uint64_t size_ = 0;
+    std::vector<Ref> refs_;             // not yet spilled
+    std::vector<Run> runs_;
+    std::filesystem::path tempDir_;
+    std::filesystem::path spillPath_;
+    clarisma::File spillFile_;
+    uint64_t spillSize_ = 0;
+    Tip currentTip_;                    // the most recently resolved tile
+    clarisma::DataPtr currentTile_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -3,11 +3,13 @@
 
 #pragma once
 
-#include <unordered_set>
+#include <memory>
+#include <clarisma/data/FlatHashSet.h>
 #include <geodesk/feature/FeatureStore.h>
 #include <geodesk/feature/Tip.h>
 #include <geodesk/geom/Box.h>
 #include <geodesk/geom/Tile.h>
+#include <geodesk/query/QueryStats.h>
 
 namespace geodesk {
 
@@ -18,18 +20,30 @@ class Filter;
 class TileIndexWalker
 {
 public:
+    /// If `boxes` are given (`box` being their union), tiles that
+    /// intersect none of them are skipped
     TileIndexWalker(DataPtr pIndex, uint32_t zoomLevels,
-        const Box& box, const Filter* filter);
+        const Box& box, const Filter* filter, QueryStats* stats = nullptr,
+        const Box* boxes = nullptr, uint32_t boxCount = 0);
 
     bool next();
     Tip currentTip() const { return Tip(currentTip_); }
     Tile currentTile() const { return currentTile_; }
     uint32_t northwestFlags() const { return northwestFlags_; }
+    /// Set in northwestFlags() if the query has accepted the tile that
+    /// lies diagonally to the north-west, which holds a copy of any
+    /// feature that extends into the tiles to the north and west (even
+    /// if neither of those has been accepted)
+    static constexpr uint32_t MULTITILE_NORTHWEST = 1 << 4;
+    /// Set in northwestFlags() if the query has accepted the tile that
+    /// lies diagonally to the north-east (only tracked tile sets can
+    /// accept it without also accepting the tile to the north)
+    static constexpr uint32_t MULTITILE_NORTHEAST = 1 << 5;
     uint32_t turboFlags() const { return turboFlags_; }
     const Box& bounds() const { return box_; }
 
 private:
-    static const int MAX_LEVELS = 13;   // currently 0 - 12
+    static const int MAX_LEVELS = QueryStats::MAX_LEVELS;   // currently 0 - 12
         // TODO: GOL 2.0 has max 8 levels
 
     // TODO: uint16 supports max level 15 (not 16, because of sign;
@@ -48,11 +62,34 @@ private:
         uint32_t turboFlags;
 	};
 
+    /// The tiles accepted so far at one level of the tile tree, as a
+    /// dense bitmap over the columns and rows covered by the query's
+    /// bounding box. If the range is too large for a bitmap, the level
+    /// falls back to the walker's sparse set of accepted tiles.
+    struct AcceptedTiles
+    {
+        std::unique_ptr<uint64_t[]> bits;
+        int32_t left = 0;
+        int32_t top = 0;
+        int32_t width = 0;      // 0 = not yet initialized
+        int32_t height = 0;
+        bool isSparse = false;
+    };
+
+    static constexpr int64_t MAX_DENSE_TILES = 1 << 22;    // 512 KB per level
+
     void startLevel(Level* level, int tip);
     void startRoot();
+    bool isAccepted(const AcceptedTiles& accepted, int col, int row) const;
+    void accept(AcceptedTiles& accepted, Tile tile);
+    void initAccepted(AcceptedTiles& accepted, int zoom);
+    bool intersectsAnyBox(const Box& bounds) const;
     
     Box box_;
     const Filter* filter_;
+    QueryStats* stats_;
+    const Box* boxes_;
+    uint32_t boxCount_;
     DataPtr pIndex_;
     int currentLevel_;
     Tile currentTile_;
@@ -61,8 +98,9 @@ private:
     uint32_t turboFlags_;
     bool tileBasedAcceleration_;
     bool trackAcceptedTiles_;
-    std::unordered_set<Tile> acceptedTiles_;
+    clarisma::FlatHashSet<uint32_t, 0xffff'ffff> sparseAcceptedTiles_;    // 0xffff'ffff = empty Tile
     Level levels_[MAX_LEVELS];
+    AcceptedTiles acceptedTiles_[MAX_LEVELS];
 };
 
 // \endcond
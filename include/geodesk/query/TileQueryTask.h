@@ -3,15 +3,23 @@
 
 #pragma once
 
+#include <vector>
 #include <clarisma/util/DataPtr.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/query/QueryPlanner.h>
 #include <geodesk/query/QueryResults.h>
+#include <geodesk/query/QueryStats.h>
+#include <geodesk/query/TileReducer.h>
+#include <geodesk/query/TileScanCache.h>
 #include <geodesk/feature/types.h>
 #include <geodesk/filter/Filter.h>
 #include <geodesk/match/Matcher.h>
 
 namespace geodesk {
 
+class PostedTasks;
 class Query;
+struct QueryLayer;
 
 /// \cond lowlevel
 ///
@@ -22,7 +30,25 @@ public:
         query_(query),
         tipAndFlags_(tipAndFlags),
         fastFilterHint_(fastFilterHint),     
-        results_(QueryResults::EMPTY)
+        lookaheadTip_(NO_PREFETCH),
+        prefetchOwn_(false),
+        lane_(0),
+        sequence_(0),
+        results_(QueryResults::EMPTY),
+        batch_(nullptr),
+        multiBox_(nullptr),
+        layerScan_(nullptr),
+        tagMemo_(nullptr),
+        stats_(nullptr),
+        leafMethod_(nullptr),
+        tileMode_(0),
+        hasBoxLimits_(false),
+        countOnly_(false),
+        indexes_(ALL_INDEXES),
+        followerCount_(0),
+        followers_(nullptr),
+        posted_(nullptr),
+        ticket_(0)
     {
     }
 
@@ -31,22 +57,267 @@ public:
 
     void operator()();
 
+    uint32_t tip() const { return tipAndFlags_ >> 8; }
+
+    /// Lets a NUMA-aware executor scan a tile on the same node every
+    /// time, so its pages stay in that node's memory
+    uint32_t affinity() const { return tip(); }
+
+    /// The executor lane of the task's query (see QueryPriority)
+    int lane() const { return lane_; }
+    void setLane(int lane) { lane_ = static_cast<uint8_t>(lane); }
+
+    /// The position of the tile's results in the output of an
+    /// ordered query
+    uint32_t sequence() const { return sequence_; }
+    void setSequence(uint32_t sequence) { sequence_ = sequence; }
+
+    /// Asks the task to prefetch its own tile and/or another tile (one
+    /// that is queued to be scanned later) before it starts scanning,
+    /// so the I/O for cold tiles overlaps with the scanning of warm ones
+    ///
+    void setPrefetch(bool own, uint32_t lookaheadTip)
+    {
+        prefetchOwn_ = own;
+        lookaheadTip_ = lookaheadTip;
+    }
+
+    static constexpr uint32_t NO_PREFETCH = 0xffff'ffff;
+
+    /// Lets the consumer of the task's query claim the task while it
+    /// sits in the executor's queue (see PostedTasks); a task that
+    /// has been claimed that way does nothing when it is run
+    void setTicket(PostedTasks* posted, uint32_t ticket)
+    {
+        posted_ = posted;
+        ticket_ = ticket;
+    }
+
+    /// Makes this task scan the given tiles after its own (so a run
+    /// of small tiles costs only one task). The task takes ownership
+    /// of the array, which must have been allocated with new[].
+    ///
+    void setFollowers(TileQueryTask* followers, int count)
+    {
+        followers_ = followers;
+        followerCount_ = static_cast<uint8_t>(count);
+    }
+
+    /// A tile whose blob is at least this large (in bytes) is split
+    /// into one task per index, provided its query allows it (see
+    /// Query::maySplitTiles())
+    static constexpr uint32_t SPLIT_TILE_SIZE = 512 * 1024;
+
+    /// Flags that select a specialized leaf loop for one of the
+    /// indexes (the commonest queries need neither matcher calls,
+    /// filter calls nor type checks)
+    enum LeafMode : uint8_t
+    {
+        MATCH_ALL = 1,      // matcher accepts everything
+        NO_FILTER = 2,      // no filter, or filter accepts the whole tile
+        ALL_TYPES = 4,      // every feature type in the index is accepted
+        FILTER_FIRST = 8,   // call the filter before the matcher
+        LEAF_MODE_COUNT = 16
+    };
+
+    static uint8_t leafMode(FeatureIndexType indexType, FeatureTypes types,
+        const MatcherHolder* matcher, const Filter* filter);
+
+    /// The types of the features in each index (by FeatureIndexType)
+    static constexpr uint32_t INDEX_TYPES[4] =
+    {
+        FeatureTypes::NODES, FeatureTypes::NONAREA_WAYS,
+        FeatureTypes::AREAS, FeatureTypes::NONAREA_RELATIONS
+    };
+
 private:
+    static uint8_t indexesOf(uint32_t types);
+    void scan();
+    void run();
+    void split(uint32_t types);
     void searchNodeIndexes();
     void searchNodeRoot(DataPtr ppRoot);
     void searchNodeBranch(DataPtr p);
+    template<int Mode>
     void searchNodeLeaf(DataPtr p);
     void searchIndexes(FeatureIndexType indexType);
     void searchRoot(DataPtr ppRoot);
     void searchBranch(DataPtr p);
+    template<int Mode>
     void searchLeaf(DataPtr p);
+    struct MatcherBatch;
+    template<int Mode>
+    void checkLeafFeature(DataPtr p, MatcherBatch& pending);
+    template<int Mode>
+    void checkNodeFeature(DataPtr p, MatcherBatch& pending);
+    void searchScanTile(const TileScanCache::Tile& tile, uint8_t indexes);
+    template<int Mode>
+    void scanFeatures(const TileScanCache::Index& index, FeatureIndexType indexType,
+        uint32_t start, uint32_t end);
+    template<int Mode>
+    void scanNodes(const TileScanCache::Index& index, FeatureIndexType indexType,
+        uint32_t start, uint32_t end);
+    template<int Mode>
+    void acceptBatch(MatcherBatch& pending);
+    template<bool AllTypes>
+    void countNodeLeaf(DataPtr p);
+    template<bool AllTypes>
+    void countLeaf(DataPtr p);
+    bool isCountOnly() const;
+    void prepareBoxLimits(const Filter* filter);
+    bool violatesBoxLimits(DataPtr p, int32_t flags) const;
+    bool checkMultiTile(int32_t flags, DataPtr pBounds) const;
+    template<int Mode>
+    bool acceptFeature(FeaturePtr pFeature);
+    template<bool Sample>
+    bool acceptMatcher(FeaturePtr pFeature);
+    template<bool Sample>
+    bool acceptFilter(FeaturePtr pFeature);
     void addResult(uint32_t item);
+    void addFeature(FeaturePtr pFeature);
+    void flushReduction();
+    std::vector<uint32_t> resultItems() const;
+
+    using LeafMethod = void (TileQueryTask::*)(DataPtr p);
+    static const LeafMethod LEAF_METHODS[LEAF_MODE_COUNT];
+    static const LeafMethod NODE_LEAF_METHODS[LEAF_MODE_COUNT];
+    static const LeafMethod COUNT_LEAF_METHODS[2];       // by ALL_TYPES
+    static const LeafMethod COUNT_NODE_LEAF_METHODS[2];
+
+    using ScanMethod = void (TileQueryTask::*)(const TileScanCache::Index& index,
+        FeatureIndexType indexType, uint32_t start, uint32_t end);
+    static const ScanMethod SCAN_METHODS[LEAF_MODE_COUNT];
+    static const ScanMethod NODE_SCAN_METHODS[LEAF_MODE_COUNT];
+
+    /// The number of features of a TileScanCache::Index whose bboxes
+    /// are tested in one go
+    static constexpr uint32_t SCAN_BLOCK_SIZE = 32;
+
+    struct ReductionBatch
+    {
+        TileReducer* reducer;
+        size_t count;
+        uint64_t counted;       // features counted, but not in `features`
+        uint64_t total;         // features of the tile reduced so far
+        FeaturePtr features[TileReducer::MAX_BATCH_SIZE];
+    };
+
+    /// Features of a leaf that have passed the bbox and type checks,
+    /// waiting to be checked against the matcher all at once
+    struct MatcherBatch
+    {
+        int count = 0;
+        FeaturePtr features[MatcherHolder::MAX_BATCH_SIZE];
+    };
+
+    /// A direct-mapped cache of the matcher's verdicts for the tag tables
+    /// of the tile being scanned (many features, such as buildings or
+    /// street lamps, share a tag table). Only used if the matcher looks
+    /// at nothing but tags. Each slot holds the offset of a tag table
+    /// within the tile (shifted left by one) and the verdict (bit 0);
+    /// 0 marks an empty slot, since no tag table starts at the
+    /// beginning of a tile.
+    struct TagMemo
+    {
+        static constexpr uint32_t SLOT_COUNT = 256;
+
+        uint32_t slots[SLOT_COUNT] = {};
+
+        static uint32_t slotOf(uint32_t offset)
+        {
+            return ((offset >> 2) ^ (offset >> 10)) & (SLOT_COUNT - 1);
+        }
+
+        /// @return 1 or 0 if the verdict for the tag table is known,
+        ///   otherwise -1
+        int lookup(uint32_t offset) const
+        {
+            uint32_t slot = slots[slotOf(offset)];
+            return (slot >> 1) == offset ? static_cast<int>(slot & 1) : -1;
+        }
+
+        void store(uint32_t offset, bool accepted)
+        {
+            slots[slotOf(offset)] = (offset << 1) | static_cast<uint32_t>(accepted);
+        }
+    };
+
+    uint32_t tagTableOffset(FeaturePtr pFeature) const
+    {
+        return static_cast<uint32_t>(pFeature.tags().ptr().ptr() - pTile_.ptr());
+    }
+
+    uint64_t acceptMemoized(const FeaturePtr* features, int count);
+
+    /// Leaf loops call the matcher in batches, unless it accepts
+    /// everything or the filter is called first
+    static constexpr bool isBatched(int mode)
+    {
+        return !(mode & MATCH_ALL) &&
+            ((mode & NO_FILTER) || !(mode & FILTER_FIRST));
+    }
+
+    /// State for scanning a tile on behalf of a multi-box query
+    struct MultiBoxScan
+    {
+        const Box* boxes;
+        uint32_t boxCount;
+        Box tileBounds;
+        std::vector<uint32_t> tileBoxes;    // boxes that intersect the tile
+        std::vector<uint32_t> matches;      // boxes matched by current feature
+
+        MultiBoxScan(const Box* boxes, uint32_t boxCount, const Box& tileBounds);
+        bool matchBounds(const Box& bounds);
+        bool matchPoint(int32_t x, int32_t y);
+    };
+
+    /// State for scanning a tile on behalf of a layered query
+    struct LayerScan
+    {
+        const QueryLayer* layers;
+        uint32_t layerCount;
+        std::vector<uint32_t> matches;      // layers that accept current feature
+
+        bool match(FeatureStore* store, FeaturePtr pFeature,
+            const FastFilterHint& fastFilterHint);
+    };
 
     Query* query_;
     uint32_t tipAndFlags_;
     FastFilterHint fastFilterHint_;
+    uint32_t lookaheadTip_;
+    bool prefetchOwn_;
+    uint8_t lane_;
+    uint32_t sequence_;
     DataPtr pTile_;
     QueryResults* results_;
+    ReductionBatch* batch_;     // only valid while the task is running
+    MultiBoxScan* multiBox_;    // only valid while the task is running
+    LayerScan* layerScan_;      // only valid while the task is running
+    TagMemo* tagMemo_;          // only valid while the task is running,
+                                // null unless the matcher depends only on tags
+    QueryStats* stats_;         // only valid while the task is running,
+                                // null unless the query collects stats
+    LeafMethod leafMethod_;     // for the index currently being searched
+    uint8_t tileMode_;          // LeafMode flags that apply to the whole tile
+    bool hasBoxLimits_;         // check leaf features against the limits below
+    /// The filter's BoxLimits in imps, valid for features whose bbox
+    /// lies within the tile's rows (see prepareBoxLimits())
+    double minBoxArea_;
+    double maxWayDiagonalSquared_;
+    int32_t limitsMinY_;
+    int32_t limitsMaxY_;
+    bool countOnly_;            // count the tile's features without checking them
+    /// The indexes to search (bit i = FeatureIndexType i); fewer than
+    /// all if the tile has been split among several tasks
+    uint8_t indexes_;
+    uint8_t followerCount_;
+    TileQueryTask* followers_;  // tiles to scan after this one (owned)
+    PostedTasks* posted_;       // null unless the consumer can claim the task
+    uint32_t ticket_;
+    QueryPlanner::Sample sample_;
+
+    static constexpr uint8_t ALL_INDEXES = 0x0f;
 };
 
 // \endcond
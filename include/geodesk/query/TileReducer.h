@@ -0,0 +1,120 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <geodesk/feature/FeaturePtr.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+
+/// A sink for query results that is fed directly by the worker
+/// threads that scan the tiles, bypassing the result buckets that
+/// Query::next() normally hands to the consumer.
+///
+/// reduce() is called concurrently from multiple threads, with
+/// batches of features that belong to the same tile. Features that
+/// require deduplication are not passed to the TileReducer; they are
+/// returned by Query::next() instead, and the consumer is
+/// responsible for feeding them to reduce() itself.
+///
+class TileReducer
+{
+public:
+    static constexpr size_t MAX_BATCH_SIZE = 64;
+
+    virtual ~TileReducer() = default;
+    virtual void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) = 0;
+
+    /// Returns true if the reducer only needs to know how many features
+    /// there are. For such a reducer, tiles that lie entirely within the
+    /// query bounds and need no matcher or filter are counted without
+    /// looking at their features, and the count is passed to
+    /// reduceCount() instead of reduce().
+    virtual bool countsOnly() const { return false; }
+    virtual void reduceCount(uint64_t /* count */) {}
+
+    /// Called before a tile is scanned, on the thread that scans it;
+    /// the calls to reduce() and endTile() for this tile follow on the
+    /// same thread. `sequence` is the tile's position in the output
+    /// order of an ordered query (see QueryOptions), otherwise 0.
+    virtual void beginTile(uint32_t /* sequence */) {}
+
+    /// Called once a tile has been scanned, with the number of its
+    /// features that were passed to reduce() or reduceCount().
+    virtual void endTile(uint64_t /* count */) {}
+};
+
+/// A TileReducer that folds features into a single value of type R.
+/// Each batch is folded into a partial value starting from `init`,
+/// which is then merged into the running total under a lock -- hence
+/// `init` must be the identity of `combine`, and both `map` and
+/// `combine` must be safe to call from multiple threads at once.
+///
+template <typename T, typename R, typename Map, typename Combine>
+class ParallelReducer : public TileReducer
+{
+public:
+    ParallelReducer(R init, Map map, Combine combine) :
+        init_(init),
+        map_(map),
+        combine_(combine),
+        total_(init)
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        R partial = init_;
+        for (size_t i = 0; i < count; i++)
+        {
+            partial = combine_(partial, map_(T(store, features[i])));
+        }
+        std::lock_guard lock(mutex_);
+        total_ = combine_(total_, partial);
+    }
+
+    R result()
+    {
+        std::lock_guard lock(mutex_);
+        return total_;
+    }
+
+private:
+    const R init_;
+    Map map_;
+    Combine combine_;
+    std::mutex mutex_;
+    R total_;
+};
+
+/// A TileReducer that simply invokes a (thread-safe) callback for
+/// each feature.
+///
+template <typename T, typename Fn>
+class ParallelVisitor : public TileReducer
+{
+public:
+    explicit ParallelVisitor(Fn fn) : fn_(fn) {}
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            fn_(T(store, features[i]));
+        }
+    }
+
+private:
+    Fn fn_;
+};
+
+// \endcond
+
+} // namespace geodesk
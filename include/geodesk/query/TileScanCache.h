@@ -0,0 +1,136 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/export.h>
+#include <geodesk/feature/Tip.h>
+
+namespace geodesk {
+
+class FeatureStore;
+using clarisma::DataPtr;
+
+/// \cond lowlevel
+///
+/// Holds the most frequently scanned tiles in a form that is quicker
+/// to scan than their stored layout. Instead of walking the R-tree of
+/// each spatial index and reading the interleaved 32-byte leaf records,
+/// a TileQueryTask checks flat arrays of bounding-box coordinates (one
+/// array per coordinate, so the compiler can test many features at
+/// once), and rejects features that don't have any of the keys required
+/// by the query's matcher without touching their tag tables. Features
+/// that pass these checks are taken from the tile as usual.
+///
+/// A tile is transcoded once it has been scanned `minScans` times;
+/// the cache is bounded by an approximate number of bytes, evicting
+/// the least recently used tiles first. It is split into shards to
+/// keep worker threads from contending on a single lock.
+///
+/// Enabled via FeatureStore::enableTileScanCache().
+///
+class GEODESK_API TileScanCache
+{
+public:
+    /// The features of one spatial index, in the order in which a
+    /// walk of its R-tree would visit them
+    struct Index
+    {
+        /// A root of the index (an index with multiple roots has one
+        /// per group of key categories); its features are those from
+        /// `start` up to `end`
+        struct Root
+        {
+            uint32_t keys;          // IndexBits of the root
+            bool checkKeys;         // false for the only root of an index
+            uint32_t start;
+            uint32_t end;
+        };
+
+        std::vector<Root> roots;
+        std::vector<int32_t> minX;      // for nodes, the same as maxX
+        std::vector<int32_t> minY;      // for nodes, the same as maxY
+        std::vector<int32_t> maxX;
+        std::vector<int32_t> maxY;
+        std::vector<int32_t> flags;
+        /// IndexBits of the global keys of each feature
+        std::vector<uint32_t> keys;
+        /// The offset of each feature's leaf record within the tile
+        std::vector<uint32_t> records;
+
+        size_t size() const { return records.size(); }
+    };
+
+    struct Tile
+    {
+        Index indexes[4];           // by FeatureIndexType
+        size_t bytes;
+    };
+
+    using TileRef = std::shared_ptr<const Tile>;
+
+    static constexpr int SHARD_COUNT = 16;
+    static constexpr uint32_t DEFAULT_MIN_SCANS = 4;
+
+    explicit TileScanCache(size_t maxBytes, uint32_t minScans = DEFAULT_MIN_SCANS);
+
+    TileScanCache(const TileScanCache&) = delete;
+    TileScanCache& operator=(const TileScanCache&) = delete;
+
+    size_t maxBytes() const { return maxBytes_; }
+    uint32_t minScans() const { return minScans_; }
+    /// The approximate number of bytes occupied by the cached tiles
+    size_t bytes();
+
+    /// Records a scan of the given tile, and returns its transcoded
+    /// form if the tile is hot (transcoding it if necessary), or
+    /// nullptr if it is not. Safe to call from any thread.
+    TileRef get(FeatureStore* store, Tip tip, DataPtr pTile);
+
+    /// Drops all tiles if the store has changed since they were
+    /// transcoded.
+    void validate(uint64_t storeTimestamp, uint64_t storeSize);
+
+    void clear();
+
+    /// Creates the scan-optimized form of a tile
+    static std::unique_ptr<Tile> transcode(FeatureStore* store, DataPtr pTile);
+
+private:
+    class Transcoder;
+
+    struct Entry
+    {
+        Tip tip;
+        TileRef tile;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;       // most recently used first
+        std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+        std::unordered_map<uint32_t, uint32_t> scans;   // of tiles not (yet) cached
+        size_t bytes = 0;
+    };
+
+    Shard& shard(Tip tip) { return shards_[tip % SHARD_COUNT]; }
+
+    size_t maxBytes_;
+    uint32_t minScans_;
+    std::unique_ptr<Shard[]> shards_;
+    std::mutex versionMutex_;
+    uint64_t storeTimestamp_;
+    uint64_t storeSize_;
+};
+
+// \endcond
+
+} // namespace geodesk
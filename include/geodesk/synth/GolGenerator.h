@@ -0,0 +1,102 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <geodesk/export.h>
+#include <geodesk/feature/ZoomLevels.h>
+#include <geodesk/geom/Box.h>
+
+namespace geodesk {
+
+///
+/// \cond lowlevel
+///
+/// Writes a GOL filled with synthetic features, so benchmarks and
+/// tests can run against data of a known shape without depending on
+/// a GOL built from real OSM data.
+///
+/// Every leaf tile that intersects the Settings' bounds receives the
+/// same mix of features:
+///
+/// - tagged nodes (amenities, shops, crossings, places),
+/// - streets (non-area ways), a share of which cross into the tile
+///   to the east or south (and hence live in two tiles),
+/// - buildings (area ways),
+/// - multipolygon relations (landuse, natural and administrative
+///   areas), whose outer rings are split into several untagged member
+///   ways and which may have inner rings,
+/// - route relations, whose members are streets and stop nodes.
+///
+/// Tags are drawn from a fixed vocabulary with skewed frequencies
+/// (the first values of each key are the most common). Names and
+/// house numbers are stored as local strings, everything else as
+/// global strings or numbers. Relations and their members always
+/// live in the same tile.
+///
+/// The output depends only on the Settings: generating twice with the
+/// same settings yields identical files.
+///
+class GEODESK_API GolGenerator
+{
+public:
+    struct Settings
+    {
+        /// The area to cover; all leaf tiles that intersect it are filled
+        Box bounds = Box::ofWSEN(7.40, 43.70, 7.48, 43.76);
+        uint32_t zoomLevels = ZoomLevels::DEFAULT;
+        uint64_t seed = 1;
+
+        // The number of features generated for each leaf tile
+        int nodesPerTile = 2000;
+        int streetsPerTile = 800;
+        int buildingsPerTile = 2500;
+        int multipolygonsPerTile = 20;
+        int routesPerTile = 4;
+
+        /// The share of streets that extend into neighboring tiles
+        double multiTileShare = 0.05;
+
+        /// The range of the number of vertices of a street
+        int minStreetLength = 2;
+        int maxStreetLength = 40;
+
+        /// The range of the number of members of a relation
+        int minRelationMembers = 2;
+        int maxRelationMembers = 12;
+
+        /// The likelihood of each optional tag (such as `name` or
+        /// `maxspeed`); 0 yields features with only their primary tag
+        double optionalTagShare = 0.4;
+    };
+
+    /// The number of distinct features in a generated GOL, by the
+    /// types that queries use (`n`, `w`, `a` and `r`)
+    struct Stats
+    {
+        uint64_t nodes = 0;
+        uint64_t ways = 0;          // non-area ways
+        uint64_t areas = 0;         // area ways and area relations
+        uint64_t relations = 0;     // non-area relations
+        uint64_t multiTileWays = 0;
+        uint32_t tiles = 0;         // including the empty parent tiles
+        uint64_t fileSize = 0;
+    };
+
+    explicit GolGenerator(const Settings& settings) : settings_(settings) {}
+
+    /// Writes the GOL, replacing any existing file.
+    ///
+    /// @throws ValueException if the settings are invalid
+    /// @throws IOException if the file can't be written
+    ///
+    Stats generate(const char* golFile) const;
+
+private:
+    Settings settings_;
+};
+
+// \endcond
+
+} // namespace geodesk
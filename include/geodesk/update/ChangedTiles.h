@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/update/OsmChange.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Determines which tiles of a FeatureStore have to be re-encoded to
+/// apply an OsmChange. A tile is affected if it intersects:
+///
+/// - the old or new location of a changed feature (for ways and
+///   relations, their bounding box), or of a feature that refers
+///   to one via its parent-relation table,
+/// - the parents of a changed feature (whose geometry or member tables
+///   may change as a result),
+/// - the old and new members of a changed relation (whose
+///   parent-relation tables change).
+///
+/// The result is conservative (it includes every tile that intersects
+/// one of these bounding boxes, at every zoom level). The old location
+/// of an anonymous node isn't recorded in the store; if such a node is
+/// moved, its tiles are only found if the change also contains the
+/// ways that use the node.
+///
+class GEODESK_API ChangedTiles
+{
+public:
+    /// @return the TIPs of the affected tiles, in ascending order
+    static std::vector<Tip> find(FeatureStore* store, const OsmChange& change);
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,60 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/TypedFeatureId.h>
+
+namespace geodesk {
+
+class FeatureStore;
+
+/// \cond lowlevel
+///
+/// Determines which features were created, modified or deleted between
+/// two versions of a GOL, without looking at most of their tiles.
+///
+/// The tiles of both versions are matched by their position in the
+/// tile pyramid (their TIPs may differ). Tiles whose stored blobs are
+/// identical are skipped; only the tiles that differ (or that exist in
+/// just one of the versions) are decoded, on multiple threads.
+///
+/// Each feature is looked at only in the tile that holds its primary
+/// copy (the one not flagged as a duplicate of a tile to the west or
+/// north). Since every copy of a feature is complete, a feature whose
+/// primary tile is identical in both versions is unchanged.
+///
+/// A feature counts as modified if its tags, its geometry (for nodes
+/// and ways, its coordinates) or its members (for relations, their
+/// IDs and roles) have changed. A way whose nodes were moved is
+/// therefore modified as well, while a relation whose members were
+/// changed (but not replaced) isn't.
+///
+class GEODESK_API GolDiff
+{
+public:
+    struct Result
+    {
+        /// The features of each kind, in ascending order of their
+        /// typed IDs
+        std::vector<TypedFeatureId> created;
+        std::vector<TypedFeatureId> modified;
+        std::vector<TypedFeatureId> deleted;
+
+        uint32_t tiles = 0;             // in either version
+        uint32_t unchangedTiles = 0;    // skipped because their blobs are identical
+    };
+
+    /// Compares two versions of a GOL.
+    ///
+    /// @param threads the number of threads (0 = as many as the
+    ///   query executor of the newer store)
+    static Result compare(FeatureStore* oldStore, FeatureStore* newStore, int threads = 0);
+};
+
+// \endcond
+
+} // namespace geodesk
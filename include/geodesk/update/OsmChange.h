@@ -0,0 +1,71 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <geodesk/export.h>
+#include <geodesk/feature/FeatureType.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+///
+/// The contents of an OSM change file (`.osc`), i.e. the elements that
+/// were created, modified or deleted, in the order in which they appear
+/// in the file.
+///
+/// Only the parts of the format that matter for updating a GOL are kept
+/// (no versions, timestamps, users or changesets).
+///
+class GEODESK_API OsmChange
+{
+public:
+    enum class Action
+    {
+        CREATE,
+        MODIFY,
+        DELETE
+    };
+
+    struct Member
+    {
+        FeatureType type;
+        uint64_t id;
+        std::string role;
+    };
+
+    struct Element
+    {
+        Action action;
+        FeatureType type;
+        uint64_t id;
+        Coordinate xy;              // nodes only (0,0 if deleted)
+        std::vector<std::pair<std::string,std::string>> tags;
+        std::vector<uint64_t> nodeIds;      // ways only
+        std::vector<Member> members;        // relations only
+    };
+
+    /// Reads the given `.osc` file. Throws a ParseException if it is
+    /// malformed.
+    static OsmChange read(const char* fileName);
+
+    /// Parses the given OSC document. Throws a ParseException if it is
+    /// malformed.
+    static OsmChange parse(std::string_view xml);
+
+    const std::vector<Element>& elements() const { return elements_; }
+
+private:
+    class Parser;
+
+    std::vector<Element> elements_;
+};
+
+// \endcond
+
+} // namespace geodesk
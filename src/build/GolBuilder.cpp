@@ -0,0 +1,1620 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/build/GolBuilder.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/alloc/ReusableBlock.h>
+#include <clarisma/math/Decimal.h>
+#include <clarisma/io/ExpandableMappedFile.h>
+#include <clarisma/store/IndexFile.h>
+#include <clarisma/store/PileFile.h>
+#include <clarisma/thread/TaskEngine.h>
+#include <clarisma/thread/Threads.h>
+#include <clarisma/text/Format.h>
+#include <clarisma/util/varint.h>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/feature/TagValues.h>
+#include <geodesk/feature/types.h>
+#include <geodesk/geom/Mercator.h>
+#include "build/GolWriter.h"
+#include "build/PbfReader.h"
+#include "build/TileEncoder.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// The highest zoom level supported (The node counts of the cells at
+/// this level are kept in memory)
+constexpr int MAX_ZOOM = 12;
+
+/// Longer strings are never global
+constexpr size_t MAX_GLOBAL_STRING_LENGTH = 64;
+
+/// How deeply relations can be nested (deeper nesting, or a cycle
+/// that keeps growing, is cut off when calculating bounding boxes)
+constexpr int MAX_NESTING = 64;
+
+/// The IDs of members and parents are combined with their type
+uint64_t typedId(FeatureType type, uint64_t id)
+{
+    return (id << 2) | static_cast<uint64_t>(type);
+}
+
+/// Projects a location in 100-nanodegree units, clamping it to the
+/// range of the map; y never becomes INT_MIN, so the packed location
+/// of a node is never 0
+Coordinate project(int32_t lon100nd, int32_t lat100nd)
+{
+    lat100nd = std::clamp(lat100nd, Mercator::MIN_LAT_100ND, Mercator::MAX_LAT_100ND);
+    double x = std::round(Mercator::MAP_WIDTH * (lon100nd / 1e7) / 360.0);
+    double y = Mercator::yFromLat(lat100nd / 1e7);
+    return Coordinate(
+        static_cast<int32_t>(std::clamp(x, -2147483648.0, 2147483647.0)),
+        static_cast<int32_t>(std::clamp(y, -2147483647.0, 2147483647.0)));
+}
+
+uint64_t packLocation(Coordinate c)
+{
+    return static_cast<uint32_t>(c.x) |
+        (static_cast<uint64_t>(static_cast<uint32_t>(c.y) ^ 0x8000'0000) << 32);
+}
+
+Coordinate unpackLocation(uint64_t v)
+{
+    return Coordinate(static_cast<int32_t>(v),
+        static_cast<int32_t>(static_cast<uint32_t>(v >> 32) ^ 0x8000'0000));
+}
+
+/// The bounding box of a way or relation, as it is stored in a SlotFile
+/// (maxY has its sign bit flipped, so an empty slot means "not present")
+struct StoredBounds
+{
+    int32_t minX;
+    int32_t minY;
+    int32_t maxX;
+    uint32_t maxY;
+
+    bool isPresent() const { return maxY != 0; }
+
+    Box box() const
+    {
+        return Box(minX, minY, maxX, static_cast<int32_t>(maxY ^ 0x8000'0000));
+    }
+
+    void set(const Box& b)
+    {
+        minX = b.minX();
+        minY = b.minY();
+        maxX = b.maxX();
+        maxY = static_cast<uint32_t>(b.maxY()) ^ 0x8000'0000;
+    }
+};
+
+/// A sparse array of fixed-size slots in a memory-mapped file, indexed
+/// by ID. Slots of different IDs can be written by different threads.
+///
+template<typename T>
+class SlotFile : public ExpandableMappedFile
+{
+public:
+    static_assert((sizeof(T) & (sizeof(T) - 1)) == 0,
+        "Slots must not straddle the segments of the file");
+
+    T* slot(uint64_t id)
+    {
+        return reinterpret_cast<T*>(translate(id * sizeof(T)));
+    }
+
+    void close()
+    {
+        unmapSegments();
+        File::close();
+    }
+};
+
+/// Hashes strings and string views alike, so maps keyed by strings
+/// can be looked up without copying the key
+struct StringHash
+{
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const
+    {
+        return std::hash<std::string_view>()(s);
+    }
+};
+
+template<typename V>
+using StringMap = std::unordered_map<std::string, V, StringHash, std::equal_to<>>;
+
+/// Counts how often strings are used, in bounded memory: once the
+/// table grows too large, the rarest strings are dropped (and strings
+/// must be used more often to stay), which can only undercount
+/// strings that are too rare to become global anyway
+///
+class StringCounter
+{
+public:
+    void add(std::string_view s, uint64_t n = 1)
+    {
+        if (s.size() > MAX_GLOBAL_STRING_LENGTH) return;
+        auto it = counts_.find(s);
+        if (it != counts_.end())
+        {
+            it->second += n;
+            return;
+        }
+        counts_.emplace(std::string(s), n);
+        if (counts_.size() > MAX_ENTRIES) prune();
+    }
+
+    void merge(const StringCounter& other)
+    {
+        for (const auto& [s, n] : other.counts_) add(s, n);
+    }
+
+    const StringMap<uint64_t>& counts() const { return counts_; }
+
+private:
+    static constexpr size_t MAX_ENTRIES = 1 << 20;
+
+    void prune()
+    {
+        while (counts_.size() > MAX_ENTRIES / 2)
+        {
+            std::erase_if(counts_, [this](const auto& e) { return e.second < minCount_; });
+            minCount_ *= 2;
+        }
+    }
+
+    StringMap<uint64_t> counts_;
+    uint64_t minCount_ = 2;
+};
+
+/// Parses a tag value that is an integer in canonical form (no sign
+/// unless negative, no leading zeroes), within the range of the
+/// numbers that a GOL can store
+bool parseNumber(std::string_view s, int32_t& value)
+{
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    size_t digits = s.size() - i;
+    if (digits == 0 || digits > 10) return false;
+    if (s[i] == '0' && (digits > 1 || i == 1)) return false;
+    int64_t n = 0;
+    for (; i < s.size(); i++)
+    {
+        if (s[i] < '0' || s[i] > '9') return false;
+        n = n * 10 + (s[i] - '0');
+    }
+    if (s[0] == '-') n = -n;
+    if (n < TagValues::MIN_NUMBER || n > TagValues::MAX_WIDE_NUMBER) return false;
+    value = static_cast<int32_t>(n);
+    return true;
+}
+
+/// Parses a tag value that is a number with 1 to 3 decimal places in
+/// canonical form (which it must reproduce exactly, so the value reads
+/// back the same), within the range of the numbers that a GOL can store
+bool parseDecimal(std::string_view s, int32_t& mantissa, int& scale)
+{
+    Decimal d(s, true);
+    if (!d.isValid() || d.scale() < 1 || d.scale() > 3) return false;
+    if (!TagValues::isNumericValue(d) || static_cast<std::string>(d) != s) return false;
+    mantissa = static_cast<int32_t>(d.mantissa());
+    scale = d.scale();
+    return true;
+}
+
+/// Tags that make a closed way an area, unless their value is "no"
+/// (a simplified form of the default area rules of the GOL Tool)
+///
+struct AreaRule
+{
+    const char* key;
+    bool only;                  // if true, only the listed values;
+                                // otherwise, all but the listed values
+    std::initializer_list<const char*> values;
+};
+
+const AreaRule AREA_RULES[] =
+{
+    { "building", false, {} },
+    { "building:part", false, {} },
+    { "landuse", false, {} },
+    { "amenity", false, {} },
+    { "leisure", false, { "track", "slipway" } },
+    { "shop", false, {} },
+    { "tourism", false, {} },
+    { "place", false, {} },
+    { "historic", false, {} },
+    { "military", false, {} },
+    { "office", false, {} },
+    { "craft", false, {} },
+    { "boundary", false, {} },
+    { "area:highway", false, {} },
+    { "man_made", false, { "cutline", "embankment", "pipeline" } },
+    { "natural", false, { "coastline", "cliff", "ridge", "arete", "tree_row" } },
+    { "aeroway", false, { "taxiway" } },
+    { "waterway", true, { "riverbank", "dock", "boatyard", "dam" } },
+    { "highway", true, { "services", "rest_area", "escape", "elevator" } },
+    { "railway", true, { "station", "turntable", "roundhouse", "platform" } },
+    { "power", true, { "plant", "substation", "generator", "transformer" } },
+    { "barrier", true, { "city_wall", "ditch", "hedge", "retaining_wall", "spikes" } },
+};
+
+bool isArea(const std::vector<PbfTag>& tags)
+{
+    for (const PbfTag& tag : tags)
+    {
+        if (tag.key == "area") return tag.value != "no";
+    }
+    for (const PbfTag& tag : tags)
+    {
+        if (tag.value == "no") continue;
+        for (const AreaRule& rule : AREA_RULES)
+        {
+            if (tag.key != rule.key) continue;
+            bool listed = std::find(rule.values.begin(), rule.values.end(),
+                tag.value) != rule.values.end();
+            if (listed == rule.only) return true;
+        }
+    }
+    return false;
+}
+
+bool isAreaRelation(const std::vector<PbfTag>& tags)
+{
+    for (const PbfTag& tag : tags)
+    {
+        if (tag.key == "type")
+        {
+            return tag.value == "multipolygon" || tag.value == "boundary";
+        }
+    }
+    return false;
+}
+
+enum RecordKind : uint8_t
+{
+    NODE_RECORD,
+    WAY_RECORD,
+    RELATION_RECORD,
+    PARENT_RECORD,      // a member and one of its relations
+    WAYNODE_RECORD      // a feature node that belongs to a way
+};
+
+/// A record that is appended to a pile (strings are stored as a
+/// varint header, which includes their length, followed by their bytes)
+///
+class Record
+{
+public:
+    void clear() { buf_.clear(); }
+    void putByte(uint8_t b) { buf_.push_back(b); }
+
+    void putVarint(uint64_t v)
+    {
+        uint8_t tmp[10];
+        uint8_t* p = tmp;
+        writeVarint(p, v);
+        buf_.insert(buf_.end(), tmp, p);
+    }
+
+    void putSignedVarint(int64_t v)
+    {
+        uint8_t tmp[10];
+        uint8_t* p = tmp;
+        writeSignedVarint(p, v);
+        buf_.insert(buf_.end(), tmp, p);
+    }
+
+    void putString(uint64_t header, std::string_view s)
+    {
+        putVarint(header);
+        buf_.insert(buf_.end(), s.begin(), s.end());
+    }
+
+    const uint8_t* data() const { return buf_.data(); }
+    uint32_t size() const { return static_cast<uint32_t>(buf_.size()); }
+
+private:
+    std::vector<uint8_t> buf_;
+};
+
+std::string readString(const uint8_t*& p, size_t len)
+{
+    std::string s(reinterpret_cast<const char*>(p), len);
+    p += len;
+    return s;
+}
+
+class Build;
+
+enum class Phase
+{
+    SCAN,
+    FEATURES,
+    RELATION_BOUNDS,
+    RELATIONS,
+    LAYOUT,
+    ENCODE
+};
+
+struct BlockTask
+{
+    std::vector<uint8_t> blob;
+};
+
+struct NoOutput
+{
+};
+
+class BlockPass;
+
+/// Decodes the blocks of the input on a worker thread
+///
+class BlockContext
+{
+public:
+    explicit BlockContext(BlockPass* pass) : pass_(pass) {}
+
+    void processTask(BlockTask& task);
+    void afterTasks();
+    void harvestResults();
+
+    void node(uint64_t id, int32_t lon100nd, int32_t lat100nd,
+        const std::vector<PbfTag>& tags);
+    void way(uint64_t id, const std::vector<uint64_t>& nodeIds,
+        const std::vector<PbfTag>& tags);
+    void relation(uint64_t id, const std::vector<PbfMember>& members,
+        const std::vector<PbfTag>& tags);
+
+private:
+    static constexpr size_t MAX_PENDING_ENTRIES = 1 << 20;
+
+    void flushMembers();
+    void countStrings(const std::vector<PbfTag>& tags);
+    void append(const Tile* tiles, int count);
+
+    BlockPass* pass_;
+    Build* build_ = nullptr;
+    Phase phase_ = Phase::SCAN;
+    PrimitiveBlockDecoder decoder_;
+    std::vector<uint8_t> inflated_;
+    std::unique_ptr<PileFile::Writer> piles_;
+    StringCounter strings_;
+    std::vector<IndexFile::Entry> featureNodes_;
+    std::vector<IndexFile::Entry> memberWays_;
+    std::vector<std::pair<uint64_t, uint64_t>> childRelations_;
+    std::vector<Coordinate> coords_;
+    std::vector<uint64_t> wayNodeIds_;
+    std::vector<Coordinate> wayNodeCoords_;
+    std::vector<PbfMember> members_;
+    std::vector<uint64_t> parentLinks_;
+    Record record_;
+};
+
+class BlockPass : public TaskEngine<BlockPass, BlockContext, BlockTask, NoOutput>
+{
+public:
+    BlockPass(Build& build, Phase phase, int threads) :
+        TaskEngine(threads),
+        build_(build),
+        phase_(phase)
+    {
+    }
+
+    void run(const char* pbfFile)
+    {
+        PbfReader reader(pbfFile);
+        start();
+        std::vector<uint8_t> blob;
+        while (!hasFailed() && reader.next(blob))
+        {
+            postWork(BlockTask{ std::move(blob) });
+        }
+        end();
+    }
+
+    void processTask(NoOutput&) {}
+
+    Build& build() const { return build_; }
+    Phase phase() const { return phase_; }
+
+private:
+    Build& build_;
+    Phase phase_;
+};
+
+struct TileTask
+{
+    uint32_t index;         // of the tile in TIP order (its pile is index + 1)
+};
+
+struct TileOutput
+{
+    Tip tip;
+    std::vector<uint8_t> blob;
+};
+
+class TilePass;
+
+/// Lays out or encodes tiles on a worker thread
+///
+class TileContext
+{
+public:
+    explicit TileContext(TilePass* pass) : pass_(pass) {}
+
+    void processTask(TileTask& task);
+    void afterTasks();
+    void harvestResults();
+
+private:
+    struct Item
+    {
+        uint64_t typedId;
+        TileFeature feature;
+        std::vector<uint64_t> memberIds;
+        std::vector<uint64_t> nodeIds;      // feature nodes of a way
+    };
+
+    void decode(Tile tile);
+    void decodeTags(const uint8_t*& p, TileFeature& f);
+    void resolve(bool encoding);
+    void flushOffsets();
+
+    TilePass* pass_;
+    Build* build_ = nullptr;
+    ReusableBlock block_;
+    std::vector<Item> items_;
+    std::vector<TileFeature> features_;
+    std::vector<std::pair<uint64_t, uint64_t>> links_;
+    std::vector<uint64_t> wayNodes_;        // nodes that belong to ways
+    std::unordered_map<uint64_t, uint32_t> local_;
+    std::vector<IndexFile::Entry> offsets_[3];
+    uint64_t counts_[3] = {};
+};
+
+class TilePass : public TaskEngine<TilePass, TileContext, TileTask, TileOutput>
+{
+public:
+    TilePass(Build& build, Phase phase, int threads, GolWriter* writer = nullptr) :
+        TaskEngine(threads),
+        build_(build),
+        phase_(phase),
+        writer_(writer)
+    {
+        if (phase == Phase::ENCODE) enableOrderedOutput();
+    }
+
+    void run(uint32_t tileCount)
+    {
+        start();
+        for (uint32_t i = 0; i < tileCount && !hasFailed(); i++)
+        {
+            postWork(TileTask{ i });
+        }
+        end();
+    }
+
+    void processTask(TileOutput& output)
+    {
+        writer_->writeTile(output.tip, output.blob);
+    }
+
+    Build& build() const { return build_; }
+    Phase phase() const { return phase_; }
+
+private:
+    Build& build_;
+    Phase phase_;
+    GolWriter* writer_;
+};
+
+/// The state of a build, which the passes share
+///
+class Build
+{
+public:
+    Build(const GolBuilder::Settings& settings, const char* pbfFile, const char* golFile);
+    ~Build();
+
+    GolBuilder::Stats run();
+
+private:
+    std::string workFile(const char* suffix) const;
+    void openWorkFiles();
+    void closeWorkFiles();
+    void layoutTiles();
+    void chooseStrings();
+    void growRelationBounds();
+
+    /// The global-string code of a string, or -1 if it isn't global
+    int code(std::string_view s) const
+    {
+        if (s.empty()) return 0;
+        auto it = codes_.find(s);
+        return it == codes_.end() ? -1 : it->second;
+    }
+
+    void encodeTags(const std::vector<PbfTag>& tags, Record& rec) const;
+    void encodeRole(std::string_view role, Record& rec) const;
+
+    /// Places a feature into the tiles at the highest zoom level at which
+    /// its bounding box spans at most 2 x 2 tiles that all exist (as the
+    /// GOL Tool does); the first tile is its home (the top-left tile).
+    /// Returns the number of tiles (up to 4).
+    int place(const Box& bounds, Tile* tiles) const;
+
+    int pileOf(Tile tile) const { return tilePiles_.at(tile); }
+    void countNode(Coordinate c);
+
+    bool hasLocation(uint64_t id) { return *locations_.slot(id) != 0; }
+    StoredBounds* wayBounds(uint64_t id) { return wayBounds_.slot(id); }
+    StoredBounds* relationBounds(uint64_t id) { return relationBounds_.slot(id); }
+
+    /// The bounding box of a feature that is present
+    Box boundsOf(uint64_t typedId);
+    bool isPresent(uint64_t typedId);
+    TileFeature::ForeignRef homeOf(uint64_t typedId);
+
+    void addMembers(IndexFile& index, std::vector<IndexFile::Entry>& entries);
+    void addOffsets(int type, std::vector<IndexFile::Entry>& entries);
+
+    const GolBuilder::Settings& settings_;
+    std::string pbfFile_;
+    std::string golFile_;
+    std::filesystem::path workPath_;
+    int threads_;
+    ZoomLevels zoomLevels_;
+    std::vector<int> zooms_;
+    int leafZoom_;
+    std::unique_ptr<std::atomic<uint32_t>[]> nodeCounts_;
+    TilePyramid pyramid_;
+    std::unordered_map<Tile, int> tilePiles_;
+
+    SlotFile<uint64_t> locations_;
+    SlotFile<StoredBounds> wayBounds_;
+    SlotFile<StoredBounds> relationBounds_;
+    IndexFile featureNodes_;                // tagged nodes and members of relations
+    IndexFile memberWays_;
+    IndexFile offsets_[3];
+    std::mutex indexMutex_;
+    PileFile piles_;
+    bool pilesOpen_ = false;
+    bool workFilesOpen_ = false;
+
+    StringCounter strings_;
+    std::vector<std::string> globalStrings_;
+    StringMap<uint16_t> codes_;
+    std::vector<uint8_t> categories_;       // of each global string (if it is an indexed key)
+    std::vector<std::pair<uint16_t, uint16_t>> indexSchema_;
+
+    std::vector<std::pair<uint64_t, uint64_t>> childRelations_;
+    uint64_t counts_[3] = {};
+
+    friend class BlockContext;
+    friend class TileContext;
+};
+
+
+Build::Build(const GolBuilder::Settings& settings, const char* pbfFile, const char* golFile) :
+    settings_(settings),
+    pbfFile_(pbfFile),
+    golFile_(golFile),
+    zoomLevels_(settings.zoomLevels),
+    pyramid_(ZoomLevels(settings.zoomLevels))
+{
+    zoomLevels_.check();
+    ZoomLevels::Iterator it = zoomLevels_.iter();
+    for (;;)
+    {
+        int zoom = it.next();
+        if (zoom < 0) break;
+        zooms_.push_back(zoom);
+    }
+    leafZoom_ = zooms_.back();
+    if (leafZoom_ > MAX_ZOOM)
+    {
+        throw ValueException(Format::format("Maximum zoom level is %d", MAX_ZOOM));
+    }
+    if (settings.maxStrings > 65'534)
+    {
+        throw ValueException("Maximum number of global strings is 65534");
+    }
+    if (settings.indexedKeys.size() > 30)
+    {
+        throw ValueException("Maximum 30 indexed keys");
+    }
+    threads_ = settings.threads > 0 ? settings.threads : Threads::hardwareConcurrency();
+    workPath_ = settings.workPath.empty() ?
+        std::filesystem::absolute(golFile_).parent_path() :
+        std::filesystem::path(settings.workPath);
+}
+
+
+Build::~Build()
+{
+    closeWorkFiles();
+}
+
+
+std::string Build::workFile(const char* suffix) const
+{
+    std::string name = std::filesystem::path(golFile_).stem().string();
+    return (workPath_ / (name + suffix)).string();
+}
+
+
+void Build::openWorkFiles()
+{
+    int mode = File::OpenMode::READ | File::OpenMode::WRITE |
+        File::OpenMode::CREATE | File::OpenMode::REPLACE_EXISTING;
+    locations_.open(workFile("-locations.tmp").c_str(), mode);
+    wayBounds_.open(workFile("-way-bounds.tmp").c_str(), mode);
+    relationBounds_.open(workFile("-relation-bounds.tmp").c_str(), mode);
+    featureNodes_.bits(1);
+    featureNodes_.open(workFile("-feature-nodes.tmp").c_str(), mode);
+    memberWays_.bits(1);
+    memberWays_.open(workFile("-member-ways.tmp").c_str(), mode);
+    const char* offsetFiles[] =
+    {
+        "-node-offsets.tmp", "-way-offsets.tmp", "-relation-offsets.tmp"
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        offsets_[i].bits(24);
+        offsets_[i].open(workFile(offsetFiles[i]).c_str(), mode);
+    }
+    workFilesOpen_ = true;
+}
+
+
+void Build::closeWorkFiles()
+{
+    if (!workFilesOpen_) return;
+    workFilesOpen_ = false;
+    locations_.close();
+    wayBounds_.close();
+    relationBounds_.close();
+    featureNodes_.close();
+    memberWays_.close();
+    for (IndexFile& offsets : offsets_) offsets.close();
+    if (pilesOpen_) piles_.close();
+    for (const char* suffix : { "-locations.tmp", "-way-bounds.tmp",
+        "-relation-bounds.tmp", "-feature-nodes.tmp", "-member-ways.tmp",
+        "-node-offsets.tmp", "-way-offsets.tmp", "-relation-offsets.tmp",
+        "-features.tmp" })
+    {
+        std::error_code error;
+        std::filesystem::remove(workFile(suffix), error);
+    }
+}
+
+
+void Build::countNode(Coordinate c)
+{
+    uint32_t col = static_cast<uint32_t>(Tile::columnFromXZ(c.x, leafZoom_));
+    uint32_t row = static_cast<uint32_t>(Tile::rowFromYZ(c.y, leafZoom_));
+    nodeCounts_[(row << leafZoom_) | col].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/// Builds the tile pyramid top-down: a tile whose area holds more than
+/// `minTileDensity` nodes is split into the tiles at the next zoom level
+/// (except those without any nodes)
+void Build::layoutTiles()
+{
+    std::vector<std::vector<uint64_t>> counts(zooms_.size());
+    for (size_t i = 0; i < zooms_.size(); i++)
+    {
+        counts[i].assign(size_t(1) << (zooms_[i] * 2), 0);
+    }
+    uint32_t leafMask = (1u << leafZoom_) - 1;
+    size_t cells = size_t(1) << (leafZoom_ * 2);
+    for (size_t cell = 0; cell < cells; cell++)
+    {
+        uint32_t n = nodeCounts_[cell].load(std::memory_order_relaxed);
+        if (n == 0) continue;
+        uint32_t col = static_cast<uint32_t>(cell) & leafMask;
+        uint32_t row = static_cast<uint32_t>(cell >> leafZoom_);
+        for (size_t i = 0; i < zooms_.size(); i++)
+        {
+            int shift = leafZoom_ - zooms_[i];
+            counts[i][((row >> shift) << zooms_[i]) | (col >> shift)] += n;
+        }
+    }
+    nodeCounts_.reset();
+
+    auto split = [&](auto& self, size_t level, int col, int row) -> void
+    {
+        int zoom = zooms_[level];
+        if (level + 1 == zooms_.size() ||
+            counts[level][(static_cast<size_t>(row) << zoom) | col] <= settings_.minTileDensity)
+        {
+            return;
+        }
+        int childZoom = zooms_[level + 1];
+        int step = childZoom - zoom;
+        for (int r = row << step; r < (row + 1) << step; r++)
+        {
+            for (int c = col << step; c < (col + 1) << step; c++)
+            {
+                if (counts[level + 1][(static_cast<size_t>(r) << childZoom) | c] == 0) continue;
+                pyramid_.add(Tile::fromColumnRowZoom(c, r, childZoom));
+                self(self, level + 1, c, r);
+            }
+        }
+    };
+    pyramid_.add(Tile::fromColumnRowZoom(0, 0, 0));
+    split(split, 0, 0, 0);
+    pyramid_.layout();
+
+    const std::vector<Tile>& tiles = pyramid_.tiles();
+    for (size_t i = 0; i < tiles.size(); i++)
+    {
+        tilePiles_[tiles[i]] = static_cast<int>(i + 1);
+    }
+}
+
+
+/// The global strings are "no", "yes", "outer" and "inner" (whose codes
+/// are fixed by the GOL format), the indexed keys, then the strings that
+/// are used most often
+void Build::chooseStrings()
+{
+    auto intern = [this](std::string_view s)
+    {
+        if (code(s) >= 0) return static_cast<uint16_t>(code(s));
+        globalStrings_.emplace_back(s);
+        uint16_t code = static_cast<uint16_t>(globalStrings_.size());
+        codes_.emplace(std::string(s), code);
+        return code;
+    };
+
+    for (const char* s : { "no", "yes", "outer", "inner" }) intern(s);
+    uint16_t category = 0;
+    for (const std::string& keys : settings_.indexedKeys)
+    {
+        category++;
+        size_t start = 0;
+        for (;;)
+        {
+            size_t end = keys.find('/', start);
+            std::string_view key = std::string_view(keys).substr(start,
+                end == std::string::npos ? std::string::npos : end - start);
+            indexSchema_.emplace_back(intern(key), category);
+            if (end == std::string::npos) break;
+            start = end + 1;
+        }
+    }
+
+    std::vector<std::pair<std::string_view, uint64_t>> candidates;
+    for (const auto& [s, n] : strings_.counts())
+    {
+        if (n >= settings_.minStringUsage && !s.empty()) candidates.emplace_back(s, n);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b)
+    {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    for (const auto& [s, n] : candidates)
+    {
+        if (globalStrings_.size() >= settings_.maxStrings) break;
+        intern(s);
+    }
+    strings_ = StringCounter();
+
+    categories_.assign(globalStrings_.size() + 1, 0);
+    for (auto [key, cat] : indexSchema_) categories_[key] = static_cast<uint8_t>(cat);
+}
+
+
+void Build::encodeTags(const std::vector<PbfTag>& tags, Record& rec) const
+{
+    rec.putVarint(tags.size());
+    for (const PbfTag& tag : tags)
+    {
+        int key = code(tag.key);
+        if (key >= 0 && key <= TagValues::MAX_COMMON_KEY)
+        {
+            rec.putVarint(static_cast<uint64_t>(key) << 1);
+        }
+        else
+        {
+            rec.putString((tag.key.size() << 1) | 1, tag.key);
+        }
+
+        int32_t number;
+        int scale;
+        int value;
+        if (parseNumber(tag.value, number))
+        {
+            int type = number <= TagValues::MAX_NARROW_NUMBER ?
+                TagValueType::NARROW_NUMBER : TagValueType::WIDE_NUMBER;
+            uint64_t n = static_cast<uint64_t>(number - TagValues::MIN_NUMBER);
+            if (type == TagValueType::WIDE_NUMBER) n <<= 2;     // scale 0
+            rec.putVarint((n << 2) | type);
+        }
+        else if (parseDecimal(tag.value, number, scale))
+        {
+            // Wide numbers carry their scale in the lowest 2 bits
+            uint64_t n = (static_cast<uint64_t>(number - TagValues::MIN_NUMBER) << 2) |
+                static_cast<uint64_t>(scale);
+            rec.putVarint((n << 2) | TagValueType::WIDE_NUMBER);
+        }
+        else if ((value = code(tag.value)) >= 0)
+        {
+            rec.putVarint((static_cast<uint64_t>(value) << 2) | TagValueType::GLOBAL_STRING);
+        }
+        else
+        {
+            rec.putString((tag.value.size() << 2) | TagValueType::LOCAL_STRING, tag.value);
+        }
+    }
+}
+
+
+void Build::encodeRole(std::string_view role, Record& rec) const
+{
+    int roleCode = code(role);
+    if (roleCode >= 0)
+    {
+        rec.putVarint(static_cast<uint64_t>(roleCode) << 1);
+    }
+    else
+    {
+        rec.putString((role.size() << 1) | 1, role);
+    }
+}
+
+
+int Build::place(const Box& bounds, Tile* tiles) const
+{
+    for (auto it = zooms_.rbegin(); it != zooms_.rend(); ++it)
+    {
+        int zoom = *it;
+        int left = Tile::columnFromXZ(bounds.minX(), zoom);
+        int right = Tile::columnFromXZ(bounds.maxX(), zoom);
+        int top = Tile::rowFromYZ(bounds.maxY(), zoom);
+        int bottom = Tile::rowFromYZ(bounds.minY(), zoom);
+        if (right - left > 1 || bottom - top > 1) continue;
+        int count = 0;
+        for (int row = top; row <= bottom && count >= 0; row++)
+        {
+            for (int col = left; col <= right; col++)
+            {
+                Tile tile = Tile::fromColumnRowZoom(col, row, zoom);
+                if (!pyramid_.contains(tile))
+                {
+                    count = -1;
+                    break;
+                }
+                tiles[count++] = tile;
+            }
+        }
+        if (count > 0) return count;
+    }
+    tiles[0] = Tile::fromColumnRowZoom(0, 0, 0);
+    return 1;
+}
+
+
+Box Build::boundsOf(uint64_t typedId)
+{
+    uint64_t id = typedId >> 2;
+    switch (static_cast<FeatureType>(typedId & 3))
+    {
+    case FeatureType::NODE:
+        return Box(unpackLocation(*locations_.slot(id)));
+    case FeatureType::WAY:
+        return wayBounds(id)->box();
+    default:
+        return relationBounds(id)->box();
+    }
+}
+
+
+bool Build::isPresent(uint64_t typedId)
+{
+    uint64_t id = typedId >> 2;
+    switch (static_cast<FeatureType>(typedId & 3))
+    {
+    case FeatureType::NODE:
+        return hasLocation(id);
+    case FeatureType::WAY:
+        return wayBounds(id)->isPresent();
+    default:
+        return relationBounds(id)->isPresent();
+    }
+}
+
+
+TileFeature::ForeignRef Build::homeOf(uint64_t typedId)
+{
+    Tile tiles[4];
+    place(boundsOf(typedId), tiles);
+    uint32_t ofs = offsets_[typedId & 3].get(typedId >> 2) << 2;
+    return { pyramid_.tipOf(tiles[0]), ofs };
+}
+
+
+void Build::addMembers(IndexFile& index, std::vector<IndexFile::Entry>& entries)
+{
+    std::lock_guard lock(indexMutex_);
+    index.putAll(entries);
+    entries.clear();
+}
+
+
+void Build::addOffsets(int type, std::vector<IndexFile::Entry>& entries)
+{
+    std::lock_guard lock(indexMutex_);
+    offsets_[type].putAll(entries);
+    entries.clear();
+}
+
+
+/// Expands the bounding boxes of relations by those of their child
+/// relations, until nothing changes
+void Build::growRelationBounds()
+{
+    std::sort(childRelations_.begin(), childRelations_.end());
+    childRelations_.erase(std::unique(childRelations_.begin(), childRelations_.end()),
+        childRelations_.end());
+    bool changed = true;
+    for (int round = 0; changed && round < MAX_NESTING; round++)
+    {
+        changed = false;
+        for (auto [parent, child] : childRelations_)
+        {
+            StoredBounds* childBounds = relationBounds(child);
+            if (!childBounds->isPresent()) continue;
+            StoredBounds* parentBounds = relationBounds(parent);
+            Box box = parentBounds->isPresent() ? parentBounds->box() : Box();
+            Box grown = box;
+            grown.expandToIncludeSimple(childBounds->box());
+            if (grown != box)
+            {
+                parentBounds->set(grown);
+                changed = true;
+            }
+        }
+    }
+    childRelations_.clear();
+    childRelations_.shrink_to_fit();
+}
+
+
+GolBuilder::Stats Build::run()
+{
+    openWorkFiles();
+    nodeCounts_.reset(new std::atomic<uint32_t>[size_t(1) << (leafZoom_ * 2)]());
+
+    BlockPass(*this, Phase::SCAN, threads_).run(pbfFile_.c_str());
+    layoutTiles();
+    chooseStrings();
+
+    const std::vector<Tile>& tiles = pyramid_.tiles();
+    piles_.create(workFile("-features.tmp").c_str(), static_cast<uint32_t>(tiles.size()));
+    pilesOpen_ = true;
+    BlockPass(*this, Phase::FEATURES, threads_).run(pbfFile_.c_str());
+    BlockPass(*this, Phase::RELATION_BOUNDS, threads_).run(pbfFile_.c_str());
+    growRelationBounds();
+    BlockPass(*this, Phase::RELATIONS, threads_).run(pbfFile_.c_str());
+
+    int tileThreads = std::min(threads_, static_cast<int>(tiles.size()));
+    TilePass(*this, Phase::LAYOUT, tileThreads).run(static_cast<uint32_t>(tiles.size()));
+
+    GolWriter writer(golFile_.c_str(), pyramid_, globalStrings_, indexSchema_);
+    TilePass(*this, Phase::ENCODE, tileThreads, &writer).run(static_cast<uint32_t>(tiles.size()));
+
+    GolBuilder::Stats stats;
+    stats.nodes = counts_[0];
+    stats.ways = counts_[1];
+    stats.relations = counts_[2];
+    stats.tiles = static_cast<uint32_t>(tiles.size());
+    stats.strings = static_cast<uint32_t>(globalStrings_.size());
+    // The timestamp identifies the GOL to its sidecar files, so any
+    // value will do as long as builds of different content differ
+    uint64_t timestamp = static_cast<uint64_t>(std::chrono::duration_cast<
+        std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    stats.fileSize = writer.finish(timestamp);
+    closeWorkFiles();
+    return stats;
+}
+
+
+void BlockContext::processTask(BlockTask& task)
+{
+    if (!build_)
+    {
+        build_ = &pass_->build();
+        phase_ = pass_->phase();
+        if (phase_ == Phase::FEATURES || phase_ == Phase::RELATIONS)
+        {
+            piles_ = std::make_unique<PileFile::Writer>(build_->piles_);
+        }
+    }
+    int types;
+    switch (phase_)
+    {
+    case Phase::SCAN:
+        types = PrimitiveBlockDecoder::ALL;
+        break;
+    case Phase::FEATURES:
+        types = PrimitiveBlockDecoder::NODES | PrimitiveBlockDecoder::WAYS;
+        break;
+    default:
+        types = PrimitiveBlockDecoder::RELATIONS;
+        break;
+    }
+    ByteSpan block = PbfReader::inflate(ByteSpan(task.blob.data(), task.blob.size()), inflated_);
+    decoder_.decode(block, *this, types);
+}
+
+
+void BlockContext::afterTasks()
+{
+    if (!build_) return;
+    flushMembers();
+    if (piles_) piles_->flush();
+}
+
+
+void BlockContext::harvestResults()
+{
+    if (!build_) return;
+    build_->strings_.merge(strings_);
+    build_->childRelations_.insert(build_->childRelations_.end(),
+        childRelations_.begin(), childRelations_.end());
+}
+
+
+void BlockContext::flushMembers()
+{
+    if (!featureNodes_.empty()) build_->addMembers(build_->featureNodes_, featureNodes_);
+    if (!memberWays_.empty()) build_->addMembers(build_->memberWays_, memberWays_);
+}
+
+
+void BlockContext::countStrings(const std::vector<PbfTag>& tags)
+{
+    int32_t number;
+    int scale;
+    for (const PbfTag& tag : tags)
+    {
+        strings_.add(tag.key);
+        if (!parseNumber(tag.value, number) && !parseDecimal(tag.value, number, scale))
+        {
+            strings_.add(tag.value);
+        }
+    }
+}
+
+
+void BlockContext::append(const Tile* tiles, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        piles_->append(build_->pileOf(tiles[i]), record_.data(), record_.size());
+    }
+}
+
+
+void BlockContext::node(uint64_t id, int32_t lon100nd, int32_t lat100nd,
+    const std::vector<PbfTag>& tags)
+{
+    Coordinate c = project(lon100nd, lat100nd);
+    if (phase_ == Phase::SCAN)
+    {
+        *build_->locations_.slot(id) = packLocation(c);
+        build_->countNode(c);
+        countStrings(tags);
+        if (!tags.empty())
+        {
+            featureNodes_.emplace_back(id, 1);
+            if (featureNodes_.size() >= MAX_PENDING_ENTRIES) flushMembers();
+        }
+        return;
+    }
+    if (tags.empty() && !build_->featureNodes_.get(id)) return;
+    record_.clear();
+    record_.putByte(NODE_RECORD);
+    record_.putVarint(id);
+    record_.putSignedVarint(c.x);
+    record_.putSignedVarint(c.y);
+    build_->encodeTags(tags, record_);
+    Tile tile;
+    build_->place(Box(c), &tile);
+    append(&tile, 1);
+}
+
+
+void BlockContext::way(uint64_t id, const std::vector<uint64_t>& nodeIds,
+    const std::vector<PbfTag>& tags)
+{
+    if (phase_ == Phase::SCAN)
+    {
+        countStrings(tags);
+        return;
+    }
+    bool isMember = build_->memberWays_.get(id);
+    if (tags.empty() && !isMember) return;
+
+    coords_.clear();
+    wayNodeIds_.clear();
+    wayNodeCoords_.clear();
+    Box bounds;
+    for (uint64_t nodeId : nodeIds)
+    {
+        uint64_t loc = *build_->locations_.slot(nodeId);
+        if (loc == 0) continue;
+        Coordinate c = unpackLocation(loc);
+        coords_.push_back(c);
+        bounds.expandToInclude(c);
+        if (build_->featureNodes_.get(nodeId))
+        {
+            wayNodeIds_.push_back(nodeId);
+            wayNodeCoords_.push_back(c);
+        }
+    }
+    if (coords_.size() < 2) return;
+    int flags = 0;
+    if (coords_.size() >= 4 && nodeIds.front() == nodeIds.back() &&
+        coords_.front() == coords_.back() && isArea(tags))
+    {
+        flags = FeatureFlags::AREA;
+        coords_.pop_back();
+        // An area lists the node that closes it only once
+        if (wayNodeIds_.size() > 1 && wayNodeIds_.back() == nodeIds.back())
+        {
+            wayNodeIds_.pop_back();
+            wayNodeCoords_.pop_back();
+        }
+    }
+    if (!wayNodeIds_.empty()) flags |= FeatureFlags::WAYNODE;
+
+    record_.clear();
+    record_.putByte(WAY_RECORD);
+    record_.putVarint(id);
+    record_.putVarint(flags);
+    record_.putVarint(coords_.size());
+    Coordinate prev(0, 0);
+    for (Coordinate c : coords_)
+    {
+        record_.putSignedVarint(static_cast<int64_t>(c.x) - prev.x);
+        record_.putSignedVarint(static_cast<int64_t>(c.y) - prev.y);
+        prev = c;
+    }
+    record_.putVarint(wayNodeIds_.size());
+    for (uint64_t nodeId : wayNodeIds_) record_.putVarint(nodeId);
+    build_->encodeTags(tags, record_);
+    Tile tiles[4];
+    append(tiles, build_->place(bounds, tiles));
+    if (isMember) build_->wayBounds(id)->set(bounds);
+
+    // Each feature node learns that it belongs to a way
+    for (size_t i = 0; i < wayNodeIds_.size(); i++)
+    {
+        record_.clear();
+        record_.putByte(WAYNODE_RECORD);
+        record_.putVarint(wayNodeIds_[i]);
+        Tile tile;
+        build_->place(Box(wayNodeCoords_[i]), &tile);
+        append(&tile, 1);
+    }
+}
+
+
+void BlockContext::relation(uint64_t id, const std::vector<PbfMember>& members,
+    const std::vector<PbfTag>& tags)
+{
+    switch (phase_)
+    {
+    case Phase::SCAN:
+        countStrings(tags);
+        for (const PbfMember& m : members)
+        {
+            strings_.add(m.role);
+            if (m.type == FeatureType::NODE)
+            {
+                featureNodes_.emplace_back(m.id, 1);
+            }
+            else if (m.type == FeatureType::WAY)
+            {
+                memberWays_.emplace_back(m.id, 1);
+            }
+        }
+        if (featureNodes_.size() + memberWays_.size() >= MAX_PENDING_ENTRIES) flushMembers();
+        return;
+
+    case Phase::RELATION_BOUNDS:
+    {
+        Box bounds;
+        for (const PbfMember& m : members)
+        {
+            uint64_t member = typedId(m.type, m.id);
+            if (m.type == FeatureType::RELATION)
+            {
+                childRelations_.emplace_back(id, m.id);
+            }
+            else if (build_->isPresent(member))
+            {
+                bounds.expandToIncludeSimple(build_->boundsOf(member));
+            }
+        }
+        if (!bounds.isEmpty()) build_->relationBounds(id)->set(bounds);
+        return;
+    }
+
+    default:
+        break;
+    }
+
+    StoredBounds* stored = build_->relationBounds(id);
+    if (!stored->isPresent()) return;
+    Box bounds = stored->box();
+
+    members_.clear();
+    for (const PbfMember& m : members)
+    {
+        if (build_->isPresent(typedId(m.type, m.id))) members_.push_back(m);
+    }
+    record_.clear();
+    record_.putByte(RELATION_RECORD);
+    record_.putVarint(id);
+    record_.putVarint(isAreaRelation(tags) ? FeatureFlags::AREA : 0);
+    record_.putSignedVarint(bounds.minX());
+    record_.putSignedVarint(bounds.minY());
+    record_.putSignedVarint(bounds.maxX());
+    record_.putSignedVarint(bounds.maxY());
+    record_.putVarint(members_.size());
+    for (const PbfMember& m : members_)
+    {
+        record_.putVarint(typedId(m.type, m.id));
+        build_->encodeRole(m.role, record_);
+    }
+    build_->encodeTags(tags, record_);
+    Tile tiles[4];
+    append(tiles, build_->place(bounds, tiles));
+
+    // Each copy of a member learns that it belongs to this relation
+    // (once, even if it is listed more than once)
+    parentLinks_.clear();
+    for (const PbfMember& m : members_) parentLinks_.push_back(typedId(m.type, m.id));
+    std::sort(parentLinks_.begin(), parentLinks_.end());
+    parentLinks_.erase(std::unique(parentLinks_.begin(), parentLinks_.end()),
+        parentLinks_.end());
+    for (uint64_t member : parentLinks_)
+    {
+        record_.clear();
+        record_.putByte(PARENT_RECORD);
+        record_.putVarint(member);
+        record_.putVarint(id);
+        append(tiles, build_->place(build_->boundsOf(member), tiles));
+    }
+}
+
+
+void TileContext::processTask(TileTask& task)
+{
+    if (!build_) build_ = &pass_->build();
+    bool encoding = pass_->phase() == Phase::ENCODE;
+    Tile tile = build_->pyramid_.tiles()[task.index];
+    build_->piles_.load(static_cast<int>(task.index + 1), block_);
+    decode(tile);
+    resolve(encoding);
+
+    TileEncoder encoder(features_);
+    const std::vector<uint32_t>& offsets = encoder.layout();
+    if (encoding)
+    {
+        pass_->postOutput(task.index, TileOutput{
+            build_->pyramid_.tipOf(tile), encoder.encode() });
+        return;
+    }
+
+    // The home copy of a feature is the one in its top-left tile
+    for (uint32_t i = 0; i < features_.size(); i++)
+    {
+        const TileFeature& f = features_[i];
+        if (f.flags & (FeatureFlags::MULTITILE_WEST | FeatureFlags::MULTITILE_NORTH)) continue;
+        int type = static_cast<int>(f.type);
+        counts_[type]++;
+        // Relations, and nodes and ways that are referenced by others
+        if (f.type == FeatureType::WAY && !f.isRelationMember()) continue;
+        if (f.type == FeatureType::NODE && !f.isRelationMember() &&
+            (f.flags & FeatureFlags::WAYNODE) == 0)
+        {
+            continue;
+        }
+        if (offsets[i] >= (1u << 26))
+        {
+            throw ValueException(Format::format("Tile %s is too large",
+                tile.toString().c_str()));
+        }
+        offsets_[type].emplace_back(f.id, offsets[i] >> 2);
+    }
+    for (int type = 0; type < 3; type++)
+    {
+        if (offsets_[type].size() >= (1 << 20)) build_->addOffsets(type, offsets_[type]);
+    }
+}
+
+
+void TileContext::afterTasks()
+{
+    if (!build_) return;
+    for (int type = 0; type < 3; type++)
+    {
+        if (!offsets_[type].empty()) build_->addOffsets(type, offsets_[type]);
+    }
+}
+
+
+void TileContext::harvestResults()
+{
+    if (!build_) return;
+    for (int type = 0; type < 3; type++) build_->counts_[type] += counts_[type];
+}
+
+
+void TileContext::decode(Tile tile)
+{
+    items_.clear();
+    links_.clear();
+    wayNodes_.clear();
+    Box tileBounds = tile.bounds();
+    const uint8_t* p = block_.data();
+    const uint8_t* end = p + block_.size();
+    while (p < end)
+    {
+        uint8_t kind = *p++;
+        if (kind == PARENT_RECORD)
+        {
+            uint64_t member = readVarint64(p);
+            uint64_t relation = readVarint64(p);
+            links_.emplace_back(member, relation);
+            continue;
+        }
+        if (kind == WAYNODE_RECORD)
+        {
+            wayNodes_.push_back(readVarint64(p));
+            continue;
+        }
+        Item& item = items_.emplace_back();
+        TileFeature& f = item.feature;
+        f.id = readVarint64(p);
+        switch (kind)
+        {
+        case NODE_RECORD:
+        {
+            f.type = FeatureType::NODE;
+            int32_t x = static_cast<int32_t>(readSignedVarint64(p));
+            int32_t y = static_cast<int32_t>(readSignedVarint64(p));
+            f.coords.emplace_back(x, y);
+            f.bounds = Box(f.coords[0]);
+            break;
+        }
+        case WAY_RECORD:
+        {
+            f.type = FeatureType::WAY;
+            f.flags = static_cast<int>(readVarint32(p));
+            uint32_t count = readVarint32(p);
+            int64_t x = 0;
+            int64_t y = 0;
+            for (uint32_t i = 0; i < count; i++)
+            {
+                x += readSignedVarint64(p);
+                y += readSignedVarint64(p);
+                Coordinate c(static_cast<int32_t>(x), static_cast<int32_t>(y));
+                f.coords.push_back(c);
+                f.bounds.expandToInclude(c);
+            }
+            count = readVarint32(p);
+            for (uint32_t i = 0; i < count; i++) item.nodeIds.push_back(readVarint64(p));
+            break;
+        }
+        default:
+        {
+            f.type = FeatureType::RELATION;
+            f.flags = static_cast<int>(readVarint32(p));
+            int32_t minX = static_cast<int32_t>(readSignedVarint64(p));
+            int32_t minY = static_cast<int32_t>(readSignedVarint64(p));
+            int32_t maxX = static_cast<int32_t>(readSignedVarint64(p));
+            int32_t maxY = static_cast<int32_t>(readSignedVarint64(p));
+            f.bounds = Box(minX, minY, maxX, maxY);
+            uint32_t count = readVarint32(p);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                item.memberIds.push_back(readVarint64(p));
+                TileFeature::Member& m = f.members.emplace_back();
+                uint64_t role = readVarint64(p);
+                if (role & 1)
+                {
+                    m.localRole = readString(p, role >> 1);
+                }
+                else
+                {
+                    m.role = static_cast<uint16_t>(role >> 1);
+                }
+            }
+            break;
+        }
+        }
+        decodeTags(p, f);
+        item.typedId = typedId(f.type, f.id);
+        if (f.type != FeatureType::NODE)
+        {
+            if (f.bounds.minX() < tileBounds.minX()) f.flags |= FeatureFlags::MULTITILE_WEST;
+            if (f.bounds.maxY() > tileBounds.maxY()) f.flags |= FeatureFlags::MULTITILE_NORTH;
+        }
+    }
+
+    // The order of the records depends on the timing of the threads
+    // that wrote them, but the tile mustn't
+    std::sort(items_.begin(), items_.end(),
+        [](const Item& a, const Item& b) { return a.typedId < b.typedId; });
+}
+
+
+void TileContext::decodeTags(const uint8_t*& p, TileFeature& f)
+{
+    uint32_t count = readVarint32(p);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        TileFeature::Tag& tag = f.tags.emplace_back();
+        uint64_t key = readVarint64(p);
+        if (key & 1)
+        {
+            tag.key = 0;
+            tag.localKey = readString(p, key >> 1);
+        }
+        else
+        {
+            tag.key = static_cast<uint16_t>(key >> 1);
+            f.indexBits |= IndexBits::fromCategory(build_->categories_[tag.key]);
+        }
+        uint64_t value = readVarint64(p);
+        tag.type = static_cast<uint8_t>(value & 3);
+        switch (tag.type)
+        {
+        case TagValueType::LOCAL_STRING:
+            tag.value = 0;
+            tag.local = readString(p, value >> 2);
+            break;
+        case TagValueType::GLOBAL_STRING:
+            tag.value = static_cast<uint32_t>(value >> 2);
+            break;
+        case TagValueType::NARROW_NUMBER:
+            tag.value = static_cast<uint32_t>(value >> 2) + TagValues::MIN_NUMBER;
+            break;
+        default:
+            tag.value = static_cast<uint32_t>(value >> 4) + TagValues::MIN_NUMBER;
+            tag.scale = static_cast<uint8_t>((value >> 2) & 3);
+            break;
+        }
+    }
+    // Global keys in ascending order, followed by the local keys
+    std::sort(f.tags.begin(), f.tags.end(),
+        [](const TileFeature::Tag& a, const TileFeature::Tag& b)
+        {
+            if (a.localKey.empty() != b.localKey.empty()) return a.localKey.empty();
+            return a.localKey.empty() ? a.key < b.key : a.localKey < b.localKey;
+        });
+}
+
+
+/// Links members and parents: to their copies in this tile if there
+/// are any, otherwise to their home copies (whose offsets are only
+/// known once all tiles have been laid out, so references to other
+/// tiles stay blank during layout, which doesn't depend on them)
+void TileContext::resolve(bool encoding)
+{
+    features_.clear();
+    local_.clear();
+    for (uint32_t i = 0; i < items_.size(); i++)
+    {
+        local_[items_[i].typedId] = i;
+        features_.push_back(std::move(items_[i].feature));
+    }
+    for (uint32_t i = 0; i < items_.size(); i++)
+    {
+        const std::vector<uint64_t>& memberIds = items_[i].memberIds;
+        for (size_t n = 0; n < memberIds.size(); n++)
+        {
+            TileFeature::Member& m = features_[i].members[n];
+            auto it = local_.find(memberIds[n]);
+            if (it != local_.end())
+            {
+                m.feature = it->second;
+            }
+            else
+            {
+                m.feature = TileFeature::FOREIGN;
+                if (encoding) m.foreign = build_->homeOf(memberIds[n]);
+            }
+        }
+
+        // Feature nodes are always in the tile of their location, but
+        // they may live in a different tile than their ways
+        for (uint64_t nodeId : items_[i].nodeIds)
+        {
+            uint64_t node = typedId(FeatureType::NODE, nodeId);
+            TileFeature::NodeRef& ref = features_[i].featureNodes.emplace_back();
+            auto it = local_.find(node);
+            if (it != local_.end())
+            {
+                ref.feature = it->second;
+            }
+            else
+            {
+                ref.feature = TileFeature::FOREIGN;
+                if (encoding) ref.foreign = build_->homeOf(node);
+            }
+        }
+    }
+    for (uint64_t nodeId : wayNodes_)
+    {
+        auto it = local_.find(typedId(FeatureType::NODE, nodeId));
+        if (it != local_.end()) features_[it->second].flags |= FeatureFlags::WAYNODE;
+    }
+
+    std::sort(links_.begin(), links_.end());
+    links_.erase(std::unique(links_.begin(), links_.end()), links_.end());
+    for (auto [member, relation] : links_)
+    {
+        auto it = local_.find(member);
+        if (it == local_.end()) continue;
+        TileFeature& f = features_[it->second];
+        uint64_t parent = typedId(FeatureType::RELATION, relation);
+        auto itParent = local_.find(parent);
+        if (itParent != local_.end())
+        {
+            f.parents.push_back(itParent->second);
+        }
+        else
+        {
+            f.foreignParents.push_back(encoding ?
+                build_->homeOf(parent) : TileFeature::ForeignRef{});
+        }
+    }
+    for (TileFeature& f : features_)
+    {
+        std::sort(f.parents.begin(), f.parents.end());
+        std::sort(f.foreignParents.begin(), f.foreignParents.end(),
+            [](const TileFeature::ForeignRef& a, const TileFeature::ForeignRef& b)
+            {
+                uint32_t tipA = a.tip;
+                uint32_t tipB = b.tip;
+                return tipA != tipB ? tipA < tipB : a.ofs < b.ofs;
+            });
+    }
+}
+
+} // namespace
+
+
+GolBuilder::Stats GolBuilder::build(const char* pbfFile, const char* golFile) const
+{
+    Build build(settings_, pbfFile, golFile);
+    return build.run();
+}
+
+} // namespace geodesk
@@ -0,0 +1,263 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/build/GolCompactor.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <clarisma/thread/Threads.h>
+#include <clarisma/util/DataPtr.h>
+#include <clarisma/util/varint.h>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileCompression.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <geodesk/query/TileIndexWalker.h>
+#include "build/GolWriter.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// The number of tiles that are prepared (in parallel) per thread
+/// before they are written
+constexpr size_t TILES_PER_THREAD = 16;
+
+struct TileEntry
+{
+    uint64_t order;     // Hilbert distance or TIP
+    Tip tip;
+
+    bool operator<(const TileEntry& other) const
+    {
+        return order != other.order ? order < other.order : tip < other.tip;
+    }
+};
+
+/// The Hilbert distance of the tile's center (the same key by which
+/// queries order the tiles they visit)
+uint64_t hilbertDistance(Tile tile)
+{
+    Box bounds = tile.bounds();
+    uint32_t x = static_cast<uint32_t>((static_cast<int64_t>(bounds.minX()) +
+        bounds.maxX()) / 2 + (1LL << 31)) >> 16;
+    uint32_t y = static_cast<uint32_t>((static_cast<int64_t>(bounds.minY()) +
+        bounds.maxY()) / 2 + (1LL << 31)) >> 16;
+    return hilbert::calculateHilbertDistance(x, y);
+}
+
+/// The size of a tile blob as stored (header and payload)
+size_t blobSize(const uint8_t* pBlob)
+{
+    return (DataPtr(pBlob).getUnsignedInt() & TileCompression::PAYLOAD_SIZE_MASK) + 4;
+}
+
+} // namespace
+
+
+/// Has access to the raw blobs and metadata of the store
+class GolCompactorTask
+{
+public:
+    GolCompactorTask(FeatureStore* store, const GolCompactor::Settings& settings) :
+        store_(store),
+        settings_(settings)
+    {
+    }
+
+    GolCompactor::Stats run(const char* golFile);
+
+private:
+    /// The encoded string table (a count followed by the strings,
+    /// each prefixed with its length)
+    std::vector<uint8_t> stringTable() const
+    {
+        const uint8_t* pStart = store_->getPointer(
+            FeatureStore::STRING_TABLE_PTR_OFS).ptr();
+        const uint8_t* p = pStart;
+        uint32_t count = readVarint32(p);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint32_t len = readVarint32(p);
+            p += len;
+        }
+        return std::vector<uint8_t>(pStart, p);
+    }
+
+    /// The encoded index schema (a count followed by pairs of key
+    /// and category)
+    std::vector<uint8_t> indexSchema() const
+    {
+        DataPtr pSchema = store_->getPointer(FeatureStore::INDEX_SCHEMA_PTR_OFS);
+        int32_t count = pSchema.getInt();
+        const uint8_t* p = pSchema.ptr();
+        return std::vector<uint8_t>(p, p + 4 + count * 4);
+    }
+
+    std::vector<uint32_t> tileIndex() const
+    {
+        DataPtr pIndex = store_->tileIndex();
+        uint32_t size = pIndex.getUnsignedInt() + 1;
+        std::vector<uint32_t> index(size);
+        memcpy(index.data(), pIndex.ptr(), size * 4);
+        return index;
+    }
+
+    /// Places the blob of the given tile into `blob` (compressed or
+    /// decompressed as required by the settings), unless it can be
+    /// written as it is stored.
+    ///
+    /// @return the blob to be written
+    const uint8_t* prepare(Tip tip, std::vector<uint8_t>& blob);
+
+    FeatureStore* store_;
+    const GolCompactor::Settings& settings_;
+};
+
+
+const uint8_t* GolCompactorTask::prepare(Tip tip,
+    [[maybe_unused]] std::vector<uint8_t>& blob)
+{
+    const uint8_t* pBlob = store_->mappedTile(tip).ptr();
+    #ifdef GEODESK_WITH_ZLIB
+    bool compressed = TileCompression::isCompressed(DataPtr(pBlob));
+    if (settings_.compression == GolCompactor::Compression::COMPRESS && !compressed)
+    {
+        std::vector<uint8_t> result = store_->tileCompression().compress(
+            pBlob, settings_.compressionLevel);
+        if (result.size() < blobSize(pBlob))
+        {
+            blob = std::move(result);
+            return blob.data();
+        }
+    }
+    else if (settings_.compression == GolCompactor::Compression::DECOMPRESS && compressed)
+    {
+        blob.resize(TileCompression::uncompressedSize(pBlob));
+        store_->tileCompression().decompress(pBlob, blob.data());
+        return blob.data();
+    }
+    #endif
+    return pBlob;
+}
+
+
+GolCompactor::Stats GolCompactorTask::run(const char* golFile)
+{
+    namespace fs = std::filesystem;
+    GolCompactor::Compression compression = settings_.compression;
+
+    #ifndef GEODESK_WITH_ZLIB
+    if (compression != GolCompactor::Compression::KEEP)
+    {
+        throw ValueException("Tile compression requires zlib");
+    }
+    #endif
+    if (settings_.compressionLevel < 1 || settings_.compressionLevel > 9)
+    {
+        throw ValueException("Compression level must be 1 to 9");
+    }
+    std::string sourceFile = store_->fileName();
+    std::error_code error;
+    if (fs::equivalent(sourceFile, golFile, error))
+    {
+        throw ValueException("Can't compact a GOL into itself");
+    }
+
+    std::vector<TileEntry> tiles;
+    TileIndexWalker walker(store_->tileIndex(), store_->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    bool anyCompressed = false;
+    while (walker.next())
+    {
+        Tip tip = walker.currentTip();
+        tiles.push_back({ settings_.order == GolCompactor::Order::HILBERT ?
+            hilbertDistance(walker.currentTile()) : tip, tip });
+        anyCompressed |= TileCompression::isCompressed(store_->mappedTile(tip));
+    }
+    std::sort(tiles.begin(), tiles.end());
+
+    GolCompactor::Stats stats;
+    stats.tiles = static_cast<uint32_t>(tiles.size());
+    stats.sourceSize = fs::file_size(sourceFile);
+
+    TilePyramid pyramid(ZoomLevels(store_->zoomLevels()));
+    pyramid.tileIndex() = tileIndex();
+    GolWriter writer(golFile, pyramid, stringTable(), indexSchema());
+
+    auto write = [&writer, &stats](Tip tip, const uint8_t* pBlob)
+    {
+        if (TileCompression::isCompressed(DataPtr(pBlob))) stats.compressedTiles++;
+        writer.writeTile(tip, pBlob, blobSize(pBlob));
+    };
+
+    if (compression == GolCompactor::Compression::KEEP)
+    {
+        // Nothing to prepare, the blobs are copied straight from the store
+        for (const TileEntry& tile : tiles)
+        {
+            write(tile.tip, store_->mappedTile(tile.tip).ptr());
+        }
+    }
+    else
+    {
+        int threads = settings_.threads > 0 ? settings_.threads :
+            Threads::hardwareConcurrency();
+        threads = std::clamp(threads, 1, std::max(static_cast<int>(tiles.size()), 1));
+        size_t batchSize = TILES_PER_THREAD * threads;
+        std::vector<std::vector<uint8_t>> blobs(batchSize);
+        std::vector<const uint8_t*> prepared(batchSize);
+        for (size_t start = 0; start < tiles.size(); start += batchSize)
+        {
+            size_t count = std::min(batchSize, tiles.size() - start);
+            std::atomic<size_t> next(0);
+            auto prepareAll = [this, &tiles, &blobs, &prepared, &next, start, count]()
+            {
+                for (;;)
+                {
+                    size_t n = next.fetch_add(1, std::memory_order_relaxed);
+                    if (n >= count) return;
+                    prepared[n] = prepare(tiles[start + n].tip, blobs[n]);
+                }
+            };
+            std::vector<std::thread> workers;
+            int workerCount = static_cast<int>(std::min<size_t>(threads, count));
+            workers.reserve(workerCount - 1);
+            for (int i = 1; i < workerCount; i++) workers.emplace_back(prepareAll);
+            prepareAll();
+            for (std::thread& worker : workers) worker.join();
+
+            for (size_t n = 0; n < count; n++)
+            {
+                write(tiles[start + n].tip, prepared[n]);
+                blobs[n].clear();
+                blobs[n].shrink_to_fit();
+            }
+        }
+    }
+    stats.fileSize = writer.finish(store_->creationTimestamp());
+
+    // Compressed tiles need the dictionary they were compressed with
+    std::string dictFile = std::string(golFile) + ".zdict";
+    fs::remove(dictFile, error);
+    bool needsDictionary = compression == GolCompactor::Compression::COMPRESS ||
+        (compression == GolCompactor::Compression::KEEP && anyCompressed);
+    if (needsDictionary && fs::exists(sourceFile + ".zdict"))
+    {
+        fs::copy_file(sourceFile + ".zdict", dictFile);
+    }
+    return stats;
+}
+
+
+GolCompactor::Stats GolCompactor::compact(FeatureStore* store, const char* golFile) const
+{
+    return GolCompactorTask(store, settings_).run(golFile);
+}
+
+} // namespace geodesk
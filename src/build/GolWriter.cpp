@@ -0,0 +1,190 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "build/GolWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <clarisma/util/varint.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+void TilePyramid::add(Tile tile)
+{
+    if (!nodes_.try_emplace(tile).second) return;
+    while (tile.zoom() > 0)
+    {
+        Tile parent = tile.zoomedOut(zoomLevels_.parentZoom(tile.zoom()));
+        auto [it, isNew] = nodes_.try_emplace(parent);
+        it->second.children.push_back(tile);
+        // If the parent already exists, so do its ancestors
+        if (!isNew) return;
+        tile = parent;
+    }
+}
+
+
+void TilePyramid::layout()
+{
+    Tile root = Tile::fromColumnRowZoom(0, 0, 0);
+    add(root);
+    tileIndex_ = { 0, 0 };
+    if (nodes_[root].children.empty())
+    {
+        nodes_[root].pageEntry = 1;
+    }
+    else
+    {
+        tileIndex_[1] = (1 << 2) | 1;
+        layoutTile(root);
+    }
+    tileIndex_[0] = static_cast<uint32_t>(tileIndex_.size() - 1);
+
+    tiles_.clear();
+    tiles_.reserve(nodes_.size());
+    for (const auto& [tile, node] : nodes_) tiles_.push_back(tile);
+    std::sort(tiles_.begin(), tiles_.end(), [this](Tile a, Tile b)
+    {
+        return nodes_[a].pageEntry < nodes_[b].pageEntry;
+    });
+}
+
+
+void TilePyramid::layoutTile(Tile tile)
+{
+    Node& node = nodes_[tile];
+    int step = zoomLevels_.skippedAfterLevel(tile.zoom()) + 1;
+    auto childNumber = [tile, step](Tile t)
+    {
+        return ((t.row() - (tile.row() << step)) << step) +
+            (t.column() - (tile.column() << step));
+    };
+    std::sort(node.children.begin(), node.children.end(),
+        [&childNumber](Tile a, Tile b) { return childNumber(a) < childNumber(b); });
+    uint64_t mask = 0;
+    for (Tile c : node.children) mask |= 1ULL << childNumber(c);
+
+    node.pageEntry = static_cast<uint32_t>(tileIndex_.size());
+    tileIndex_.push_back(0);
+    tileIndex_.push_back(static_cast<uint32_t>(mask));
+    if (step == 3) tileIndex_.push_back(static_cast<uint32_t>(mask >> 32));
+    uint32_t entries = static_cast<uint32_t>(tileIndex_.size());
+    tileIndex_.resize(entries + node.children.size());
+    std::vector<Tile> children = node.children;     // node may move
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        uint32_t entry = entries + static_cast<uint32_t>(i);
+        Node& child = nodes_[children[i]];
+        if (child.children.empty())
+        {
+            child.pageEntry = entry;
+        }
+        else
+        {
+            tileIndex_[entry] = ((static_cast<uint32_t>(tileIndex_.size()) - entry) << 2) | 1;
+            layoutTile(children[i]);
+        }
+    }
+}
+
+
+GolWriter::GolWriter(const char* fileName, TilePyramid& tiles,
+    const std::vector<std::string>& strings,
+    const std::vector<std::pair<uint16_t, uint16_t>>& indexSchema) :
+    tiles_(tiles)
+{
+    uint8_t varint[8];
+    uint8_t* p = varint;
+    writeVarint(p, strings.size());
+    stringTable_.insert(stringTable_.end(), varint, p);
+    for (const std::string& str : strings)
+    {
+        p = varint;
+        writeVarint(p, str.size());
+        stringTable_.insert(stringTable_.end(), varint, p);
+        stringTable_.insert(stringTable_.end(), str.begin(), str.end());
+    }
+
+    indexSchema_.resize(4 + indexSchema.size() * 4);
+    int32_t count = static_cast<int32_t>(indexSchema.size());
+    memcpy(indexSchema_.data(), &count, 4);
+    p = indexSchema_.data() + 4;
+    for (auto [key, category] : indexSchema)
+    {
+        memcpy(p, &key, 2);
+        memcpy(p + 2, &category, 2);
+        p += 4;
+    }
+    open(fileName);
+}
+
+
+GolWriter::GolWriter(const char* fileName, TilePyramid& tiles,
+    std::vector<uint8_t> stringTable, std::vector<uint8_t> indexSchema) :
+    tiles_(tiles),
+    stringTable_(std::move(stringTable)),
+    indexSchema_(std::move(indexSchema))
+{
+    open(fileName);
+}
+
+
+void GolWriter::open(const char* fileName)
+{
+    stringTableOfs_ = TILE_INDEX_OFS + static_cast<uint32_t>(tiles_.tileIndex().size() * 4);
+    indexSchemaOfs_ = (stringTableOfs_ + static_cast<uint32_t>(stringTable_.size()) + 3) & ~3u;
+    uint32_t metadataEnd = indexSchemaOfs_ + static_cast<uint32_t>(indexSchema_.size());
+    nextPage_ = (metadataEnd + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    file_.open(fileName, File::WRITE | File::CREATE | File::REPLACE_EXISTING);
+}
+
+
+void GolWriter::writeAt(uint64_t ofs, const void* data, size_t size)
+{
+    file_.seek(ofs);
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (size > 0)
+    {
+        size_t written = file_.write(p, size);
+        p += written;
+        size -= written;
+    }
+}
+
+
+void GolWriter::writeTile(Tip tip, const uint8_t* blob, size_t size)
+{
+    uint32_t page = nextPage_;
+    writeAt(static_cast<uint64_t>(page) * PAGE_SIZE, blob, size);
+    nextPage_ += static_cast<uint32_t>((size + PAGE_SIZE - 1) / PAGE_SIZE);
+    tiles_.tileIndex()[tip] = page << 1;
+}
+
+
+uint64_t GolWriter::finish(uint64_t timestamp)
+{
+    std::vector<uint8_t> header(PAGE_SIZE, 0);
+    auto putHeaderInt = [&header](uint32_t ofs, uint32_t v) { memcpy(&header[ofs], &v, 4); };
+    putHeaderInt(0, 0x7ADA'0BB1);          // BlobStore magic
+    putHeaderInt(4, 1'000'000);             // BlobStore version
+    memcpy(&header[8], &timestamp, 8);
+    putHeaderInt(16, nextPage_);
+    putHeaderInt(40, static_cast<uint32_t>(tiles_.zoomLevels()));
+    putHeaderInt(44, TILE_INDEX_OFS - 44);
+    putHeaderInt(52, stringTableOfs_ - 52);
+    putHeaderInt(56, indexSchemaOfs_ - 56);
+
+    const std::vector<uint32_t>& tileIndex = tiles_.tileIndex();
+    writeAt(0, header.data(), header.size());
+    writeAt(TILE_INDEX_OFS, tileIndex.data(), tileIndex.size() * 4);
+    writeAt(stringTableOfs_, stringTable_.data(), stringTable_.size());
+    writeAt(indexSchemaOfs_, indexSchema_.data(), indexSchema_.size());
+    uint64_t fileSize = static_cast<uint64_t>(nextPage_) * PAGE_SIZE;
+    file_.setSize(fileSize);
+    file_.close();
+    return fileSize;
+}
+
+} // namespace geodesk
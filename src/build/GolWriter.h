@@ -0,0 +1,120 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <clarisma/io/File.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/feature/ZoomLevels.h>
+#include <geodesk/geom/Tile.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// The tiles of a GOL that is being written, and the layout of its
+/// tile index.
+///
+/// Word 0 of the tile index holds the number of the words that follow,
+/// word 1 the entry of the root tile. Each tile with children has a
+/// record: its page, the mask of its children, and the entries of its
+/// children (their page, or a pointer to their own record). The TIP
+/// of a tile is the position of the word that holds its page.
+///
+class TilePyramid
+{
+public:
+    explicit TilePyramid(ZoomLevels zoomLevels) : zoomLevels_(zoomLevels) {}
+
+    /// Adds the given tile (which must lie at one of the zoom levels),
+    /// and all of its ancestors
+    void add(Tile tile);
+    bool contains(Tile tile) const { return nodes_.count(tile) != 0; }
+
+    /// Lays out the tile index; call once all tiles have been added
+    void layout();
+
+    /// The tiles, in the order of their TIPs (once laid out)
+    const std::vector<Tile>& tiles() const { return tiles_; }
+    Tip tipOf(Tile tile) const { return Tip(nodes_.at(tile).pageEntry); }
+    ZoomLevels zoomLevels() const { return zoomLevels_; }
+
+    std::vector<uint32_t>& tileIndex() { return tileIndex_; }
+
+private:
+    struct Node
+    {
+        std::vector<Tile> children;
+        uint32_t pageEntry = 0;
+    };
+
+    void layoutTile(Tile tile);
+
+    ZoomLevels zoomLevels_;
+    std::unordered_map<Tile, Node> nodes_;
+    std::vector<Tile> tiles_;
+    std::vector<uint32_t> tileIndex_;
+};
+
+
+/// Writes a GOL directly in the layout that FeatureStore reads
+/// (BlobStore 1.0): the header on page 0, followed by the tile index,
+/// string table and index schema, followed by one page-aligned blob
+/// per tile. All pointers within the header, the tile index and the
+/// tiles are relative to their own position.
+///
+class GolWriter
+{
+public:
+    static constexpr uint32_t PAGE_SIZE = 4096;
+
+    /// Creates the file (replacing any existing file). The global
+    /// strings must not include the empty string (code 0); the index
+    /// schema lists the indexed keys and their categories.
+    GolWriter(const char* fileName, TilePyramid& tiles,
+        const std::vector<std::string>& strings,
+        const std::vector<std::pair<uint16_t, uint16_t>>& indexSchema);
+
+    /// Creates the file for a copy of an existing GOL (see GolCompactor),
+    /// whose string table and index schema are given in their encoded
+    /// form. The tile index of `tiles` must have been copied as well.
+    GolWriter(const char* fileName, TilePyramid& tiles,
+        std::vector<uint8_t> stringTable, std::vector<uint8_t> indexSchema);
+
+    /// Writes the blob of the given tile at the next free page
+    void writeTile(Tip tip, const std::vector<uint8_t>& blob)
+    {
+        writeTile(tip, blob.data(), blob.size());
+    }
+
+    void writeTile(Tip tip, const uint8_t* blob, size_t size);
+
+    /// Writes the header and metadata, and returns the size of the file.
+    /// The timestamp identifies the GOL to its sidecar files (such as
+    /// the string index).
+    uint64_t finish(uint64_t timestamp);
+
+private:
+    static constexpr uint32_t TILE_INDEX_OFS = PAGE_SIZE;
+
+    /// Places the metadata after the tile index and creates the file
+    void open(const char* fileName);
+    void writeAt(uint64_t ofs, const void* data, size_t size);
+
+    clarisma::File file_;
+    TilePyramid& tiles_;
+    std::vector<uint8_t> stringTable_;
+    std::vector<uint8_t> indexSchema_;
+    uint32_t stringTableOfs_;
+    uint32_t indexSchemaOfs_;
+    uint32_t nextPage_;
+};
+
+// \endcond
+
+} // namespace geodesk
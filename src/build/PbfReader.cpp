@@ -0,0 +1,207 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "build/PbfReader.h"
+#include <cstring>
+#include <clarisma/io/IOException.h>
+#include <clarisma/validate/Validate.h>
+#ifdef GEODESK_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace geodesk {
+
+using namespace clarisma;
+using namespace clarisma::protobuf;
+
+namespace {
+
+/// The largest blocks allowed by the .osm.pbf format
+constexpr uint32_t MAX_HEADER_SIZE = 64 * 1024;
+constexpr uint32_t MAX_BLOB_SIZE = 32 * 1024 * 1024;
+
+} // namespace
+
+
+PbfReader::PbfReader(const char* fileName)
+{
+    file_.open(fileName, File::READ);
+    fileSize_ = file_.size();
+}
+
+
+void PbfReader::read(uint8_t* p, size_t size)
+{
+    while (size > 0)
+    {
+        size_t n = file_.read(p, size);
+        if (n == 0) throw IOException("%s: Unexpected end of file", file_.fileName().c_str());
+        p += n;
+        size -= n;
+        bytesRead_ += n;
+    }
+}
+
+
+bool PbfReader::next(std::vector<uint8_t>& blob)
+{
+    for (;;)
+    {
+        if (bytesRead_ >= fileSize_) return false;
+
+        // Each block starts with the size of its BlobHeader (big-endian),
+        // which tells us the type and size of the Blob that follows
+        uint8_t sizeBytes[4];
+        read(sizeBytes, 4);
+        uint32_t headerSize = (static_cast<uint32_t>(sizeBytes[0]) << 24) |
+            (static_cast<uint32_t>(sizeBytes[1]) << 16) |
+            (static_cast<uint32_t>(sizeBytes[2]) << 8) | sizeBytes[3];
+        if (headerSize > MAX_HEADER_SIZE) throw ValueException("Not a valid .osm.pbf file");
+        buf_.resize(headerSize);
+        read(buf_.data(), headerSize);
+
+        std::string_view type;
+        uint32_t blobSize = 0;
+        const uint8_t* p = buf_.data();
+        const uint8_t* end = p + headerSize;
+        while (p < end)
+        {
+            Field field = readField(p);
+            if (field == protobuf::field(1, STRING))
+            {
+                type = readStringView(p);
+            }
+            else if (field == protobuf::field(3, VARINT))
+            {
+                blobSize = readVarint32(p);
+            }
+            else
+            {
+                skipEntity(p, field);
+            }
+        }
+        if (blobSize > MAX_BLOB_SIZE) throw ValueException("Not a valid .osm.pbf file");
+        bool isData = type == "OSMData";
+        bool isHeader = type == "OSMHeader";
+        blob.resize(blobSize);
+        read(blob.data(), blobSize);
+        if (isData) return true;
+        if (isHeader)
+        {
+            std::vector<uint8_t> header;
+            checkHeader(inflate(ByteSpan(blob.data(), blob.size()), header));
+        }
+        // Blocks of unknown types are skipped, as the format requires
+    }
+}
+
+
+void PbfReader::checkHeader(ByteSpan header)
+{
+    const uint8_t* p = header.data();
+    const uint8_t* end = p + header.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        if (field == protobuf::field(4, STRING))
+        {
+            std::string_view feature = readStringView(p);
+            if (feature != "OsmSchema-V0.6" && feature != "DenseNodes")
+            {
+                throw ValueException("Unsupported feature required by .osm.pbf file: " +
+                    std::string(feature));
+            }
+        }
+        else
+        {
+            skipEntity(p, field);
+        }
+    }
+}
+
+
+ByteSpan PbfReader::inflate(ByteSpan blob, [[maybe_unused]] std::vector<uint8_t>& out)
+{
+    ByteSpan raw;
+    ByteSpan compressed;
+    [[maybe_unused]] uint32_t rawSize = 0;
+    const uint8_t* p = blob.data();
+    const uint8_t* end = p + blob.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, STRING):
+            raw = readMessage(p);
+            break;
+        case protobuf::field(2, VARINT):
+            rawSize = readVarint32(p);
+            break;
+        case protobuf::field(3, STRING):
+            compressed = readMessage(p);
+            break;
+        default:
+            if ((field & 7) == STRING)
+            {
+                throw ValueException("Unsupported compression of .osm.pbf block");
+            }
+            skipEntity(p, field);
+            break;
+        }
+    }
+    if (!compressed.isEmpty())
+    {
+        #ifdef GEODESK_WITH_ZLIB
+        if (rawSize > MAX_BLOB_SIZE) throw ValueException("Not a valid .osm.pbf file");
+        out.resize(rawSize);
+        uLongf size = rawSize;
+        if (uncompress(out.data(), &size, compressed.data(),
+            static_cast<uLong>(compressed.size())) != Z_OK || size != rawSize)
+        {
+            throw ValueException("Corrupt .osm.pbf block");
+        }
+        return ByteSpan(out.data(), rawSize);
+        #else
+        throw ValueException("Compressed .osm.pbf blocks require zlib");
+        #endif
+    }
+    return raw;
+}
+
+
+void PrimitiveBlockDecoder::readStrings(ByteSpan table)
+{
+    const uint8_t* p = table.data();
+    const uint8_t* end = p + table.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        if (field == protobuf::field(1, STRING))
+        {
+            strings_.push_back(readStringView(p));
+        }
+        else
+        {
+            skipEntity(p, field);
+        }
+    }
+}
+
+
+void PrimitiveBlockDecoder::readTags(const uint8_t* pKeys, const uint8_t* pKeysEnd,
+    const uint8_t* pValues, const uint8_t* pValuesEnd)
+{
+    tags_.clear();
+    while (pKeys < pKeysEnd && pValues < pValuesEnd)
+    {
+        uint32_t key = readVarint32(pKeys);
+        uint32_t value = readVarint32(pValues);
+        if (key < strings_.size() && value < strings_.size())
+        {
+            tags_.push_back({ strings_[key], strings_[value] });
+        }
+    }
+}
+
+} // namespace geodesk
@@ -0,0 +1,438 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <clarisma/data/Span.h>
+#include <clarisma/io/File.h>
+#include <clarisma/util/protobuf.h>
+#include <geodesk/feature/FeatureType.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// Reads the blocks of an .osm.pbf file, one at a time (on a single
+/// thread), so they can be decoded in parallel.
+///
+class PbfReader
+{
+public:
+    explicit PbfReader(const char* fileName);
+
+    /// Reads the next data block into `blob` (the encoded Blob message,
+    /// which may be compressed), and returns false at the end of the
+    /// file. Header blocks are checked and skipped.
+    ///
+    /// @throws IOException if the file is truncated
+    /// @throws ValueException if the file isn't a valid .osm.pbf, or
+    ///   requires features that aren't supported
+    ///
+    bool next(std::vector<uint8_t>& blob);
+
+    uint64_t fileSize() const { return fileSize_; }
+    uint64_t bytesRead() const { return bytesRead_; }
+
+    /// Decodes a Blob message into `out` (inflating it if necessary),
+    /// and returns its contents
+    static clarisma::ByteSpan inflate(clarisma::ByteSpan blob, std::vector<uint8_t>& out);
+
+private:
+    void read(uint8_t* p, size_t size);
+    void checkHeader(clarisma::ByteSpan header);
+
+    clarisma::File file_;
+    uint64_t fileSize_;
+    uint64_t bytesRead_ = 0;
+    std::vector<uint8_t> buf_;
+};
+
+
+/// A member of a relation, as it appears in a PrimitiveBlock
+struct PbfMember
+{
+    FeatureType type;
+    uint64_t id;
+    std::string_view role;
+};
+
+/// A tag of a node, way or relation (whose strings point into the
+/// string table of its PrimitiveBlock)
+struct PbfTag
+{
+    std::string_view key;
+    std::string_view value;
+};
+
+
+/// Decodes the nodes, ways and relations of a PrimitiveBlock, and
+/// passes them to a Handler, which must have these methods:
+///
+///   void node(uint64_t id, int32_t lon100nd, int32_t lat100nd,
+///       const std::vector<PbfTag>& tags);
+///   void way(uint64_t id, const std::vector<uint64_t>& nodeIds,
+///       const std::vector<PbfTag>& tags);
+///   void relation(uint64_t id, const std::vector<PbfMember>& members,
+///       const std::vector<PbfTag>& tags);
+///
+/// Coordinates are in 100-nanodegree units (the precision of OSM).
+/// The groups of the types that aren't requested are skipped without
+/// being decoded.
+///
+class PrimitiveBlockDecoder
+{
+public:
+    enum Types
+    {
+        NODES = 1,
+        WAYS = 2,
+        RELATIONS = 4,
+        ALL = 7
+    };
+
+    template<typename Handler>
+    void decode(clarisma::ByteSpan block, Handler& handler, int types = ALL);
+
+private:
+    void readStrings(clarisma::ByteSpan table);
+    void readTags(const uint8_t* pKeys, const uint8_t* pKeysEnd,
+        const uint8_t* pValues, const uint8_t* pValuesEnd);
+    int32_t lon(int64_t raw) const
+    {
+        return static_cast<int32_t>((lonOffset_ + granularity_ * raw) / 100);
+    }
+    int32_t lat(int64_t raw) const
+    {
+        return static_cast<int32_t>((latOffset_ + granularity_ * raw) / 100);
+    }
+
+    template<typename Handler>
+    void decodeGroup(clarisma::ByteSpan group, Handler& handler, int types);
+    template<typename Handler>
+    void decodeNode(clarisma::ByteSpan node, Handler& handler);
+    template<typename Handler>
+    void decodeDenseNodes(clarisma::ByteSpan dense, Handler& handler);
+    template<typename Handler>
+    void decodeWay(clarisma::ByteSpan way, Handler& handler);
+    template<typename Handler>
+    void decodeRelation(clarisma::ByteSpan rel, Handler& handler);
+
+    std::vector<std::string_view> strings_;
+    std::vector<PbfTag> tags_;
+    std::vector<uint64_t> nodeIds_;
+    std::vector<PbfMember> members_;
+    // Decoded packed fields of DenseNodes and relations (kept
+    // to reuse their storage)
+    std::vector<int64_t> ids_;
+    std::vector<int64_t> lats_;
+    std::vector<int64_t> lons_;
+    std::vector<uint64_t> keysValues_;
+    std::vector<uint64_t> roles_;
+    std::vector<uint64_t> memberTypes_;
+    int64_t granularity_ = 100;
+    int64_t latOffset_ = 0;
+    int64_t lonOffset_ = 0;
+};
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decode(clarisma::ByteSpan block, Handler& handler, int types)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    // The string table and the coordinate parameters must be known
+    // before the groups can be decoded, but needn't come first
+    std::vector<ByteSpan> groups;
+    granularity_ = 100;
+    latOffset_ = 0;
+    lonOffset_ = 0;
+    strings_.clear();
+    const uint8_t* p = block.data();
+    const uint8_t* end = p + block.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, STRING):
+            readStrings(readMessage(p));
+            break;
+        case protobuf::field(2, STRING):
+            groups.push_back(readMessage(p));
+            break;
+        case protobuf::field(17, VARINT):
+            granularity_ = static_cast<int64_t>(readVarint64(p));
+            break;
+        case protobuf::field(19, VARINT):
+            latOffset_ = static_cast<int64_t>(readVarint64(p));
+            break;
+        case protobuf::field(20, VARINT):
+            lonOffset_ = static_cast<int64_t>(readVarint64(p));
+            break;
+        default:
+            skipEntity(p, field);
+            break;
+        }
+    }
+    for (ByteSpan group : groups) decodeGroup(group, handler, types);
+}
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decodeGroup(clarisma::ByteSpan group, Handler& handler, int types)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    const uint8_t* p = group.data();
+    const uint8_t* end = p + group.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, STRING):
+            if (!(types & NODES)) return;
+            decodeNode(readMessage(p), handler);
+            break;
+        case protobuf::field(2, STRING):
+            if (!(types & NODES)) return;
+            decodeDenseNodes(readMessage(p), handler);
+            break;
+        case protobuf::field(3, STRING):
+            if (!(types & WAYS)) return;
+            decodeWay(readMessage(p), handler);
+            break;
+        case protobuf::field(4, STRING):
+            if (!(types & RELATIONS)) return;
+            decodeRelation(readMessage(p), handler);
+            break;
+        default:
+            // (A group holds only one kind of primitive, so
+            // we can skip it as soon as we know its kind)
+            skipEntity(p, field);
+            break;
+        }
+    }
+}
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decodeNode(clarisma::ByteSpan node, Handler& handler)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    uint64_t id = 0;
+    int64_t rawLat = 0;
+    int64_t rawLon = 0;
+    ByteSpan keys;
+    ByteSpan values;
+    const uint8_t* p = node.data();
+    const uint8_t* end = p + node.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, VARINT):
+            id = static_cast<uint64_t>(readSignedVarint64(p));
+            break;
+        case protobuf::field(2, STRING):
+            keys = readMessage(p);
+            break;
+        case protobuf::field(3, STRING):
+            values = readMessage(p);
+            break;
+        case protobuf::field(8, VARINT):
+            rawLat = readSignedVarint64(p);
+            break;
+        case protobuf::field(9, VARINT):
+            rawLon = readSignedVarint64(p);
+            break;
+        default:
+            skipEntity(p, field);
+            break;
+        }
+    }
+    readTags(keys.data(), keys.data() + keys.size(),
+        values.data(), values.data() + values.size());
+    handler.node(id, lon(rawLon), lat(rawLat), tags_);
+}
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decodeDenseNodes(clarisma::ByteSpan dense, Handler& handler)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    ByteSpan ids;
+    ByteSpan lats;
+    ByteSpan lons;
+    ByteSpan keysValues;
+    const uint8_t* p = dense.data();
+    const uint8_t* end = p + dense.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, STRING):
+            ids = readMessage(p);
+            break;
+        case protobuf::field(8, STRING):
+            lats = readMessage(p);
+            break;
+        case protobuf::field(9, STRING):
+            lons = readMessage(p);
+            break;
+        case protobuf::field(10, STRING):
+            keysValues = readMessage(p);
+            break;
+        default:
+            skipEntity(p, field);
+            break;
+        }
+    }
+
+    // IDs and coordinates are delta-encoded; the packed arrays are
+    // decoded in bulk, and may be shorter than the IDs if malformed
+    readPackedSInt64(ids, ids_, true);
+    readPackedSInt64(lats, lats_, true);
+    readPackedSInt64(lons, lons_, true);
+    readPackedVarints(keysValues, keysValues_);
+    size_t count = std::min(ids_.size(), std::min(lats_.size(), lons_.size()));
+    const uint64_t* pTags = keysValues_.data();
+    const uint64_t* pTagsEnd = pTags + keysValues_.size();
+    for (size_t i = 0; i < count; i++)
+    {
+        // The tags of all nodes, as pairs of key and value, each
+        // node's list terminated by a 0 (absent if no node has tags)
+        tags_.clear();
+        while (pTags < pTagsEnd)
+        {
+            uint64_t key = *pTags++;
+            if (key == 0 || pTags == pTagsEnd) break;
+            uint64_t value = *pTags++;
+            if (key < strings_.size() && value < strings_.size())
+            {
+                tags_.push_back({ strings_[key], strings_[value] });
+            }
+        }
+        handler.node(static_cast<uint64_t>(ids_[i]), lon(lons_[i]), lat(lats_[i]), tags_);
+    }
+}
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decodeWay(clarisma::ByteSpan way, Handler& handler)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    uint64_t id = 0;
+    ByteSpan keys;
+    ByteSpan values;
+    nodeIds_.clear();
+    const uint8_t* p = way.data();
+    const uint8_t* end = p + way.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, VARINT):
+            id = readVarint64(p);
+            break;
+        case protobuf::field(2, STRING):
+            keys = readMessage(p);
+            break;
+        case protobuf::field(3, STRING):
+            values = readMessage(p);
+            break;
+        case protobuf::field(8, STRING):
+            readPackedSInt64(readMessage(p), nodeIds_, true);
+            break;
+        default:
+            skipEntity(p, field);
+            break;
+        }
+    }
+    readTags(keys.data(), keys.data() + keys.size(),
+        values.data(), values.data() + values.size());
+    handler.way(id, nodeIds_, tags_);
+}
+
+
+template<typename Handler>
+void PrimitiveBlockDecoder::decodeRelation(clarisma::ByteSpan rel, Handler& handler)
+{
+    using namespace clarisma;
+    using namespace clarisma::protobuf;
+
+    uint64_t id = 0;
+    ByteSpan keys;
+    ByteSpan values;
+    ByteSpan roles;
+    ByteSpan memberIds;
+    ByteSpan memberTypes;
+    const uint8_t* p = rel.data();
+    const uint8_t* end = p + rel.size();
+    while (p < end)
+    {
+        Field field = readField(p);
+        switch (field)
+        {
+        case protobuf::field(1, VARINT):
+            id = readVarint64(p);
+            break;
+        case protobuf::field(2, STRING):
+            keys = readMessage(p);
+            break;
+        case protobuf::field(3, STRING):
+            values = readMessage(p);
+            break;
+        case protobuf::field(8, STRING):
+            roles = readMessage(p);
+            break;
+        case protobuf::field(9, STRING):
+            memberIds = readMessage(p);
+            break;
+        case protobuf::field(10, STRING):
+            memberTypes = readMessage(p);
+            break;
+        default:
+            skipEntity(p, field);
+            break;
+        }
+    }
+
+    readPackedVarints(roles, roles_);
+    readPackedSInt64(memberIds, ids_, true);
+    readPackedVarints(memberTypes, memberTypes_);
+    size_t count = std::min(ids_.size(),
+        std::min(roles_.size(), memberTypes_.size()));
+    members_.clear();
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t role = roles_[i];
+        uint64_t type = memberTypes_[i];
+        if (type > 2) continue;
+        members_.push_back({ static_cast<FeatureType>(type),
+            static_cast<uint64_t>(ids_[i]),
+            role < strings_.size() ? strings_[role] : std::string_view() });
+    }
+    readTags(keys.data(), keys.data() + keys.size(),
+        values.data(), values.data() + values.size());
+    handler.relation(id, members_, tags_);
+}
+
+// \endcond
+
+} // namespace geodesk
@@ -0,0 +1,662 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include "build/TileEncoder.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/FeatureHeader.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/feature/TagValues.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+TileEncoder::TileEncoder(const std::vector<TileFeature>& features) :
+    features_(features),
+    featureOfs_(features.size(), 0)
+{
+}
+
+
+const std::vector<uint32_t>& TileEncoder::layout()
+{
+    assert(!laidOut_);
+    buf_.assign(24, 0);
+    std::vector<uint32_t> byIndex[4];
+    for (uint32_t i = 0; i < features_.size(); i++)
+    {
+        byIndex[features_[i].indexType()].push_back(i);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+        if (!byIndex[i].empty()) writeIndex(8 + i * 4, byIndex[i]);
+    }
+    laidOut_ = true;
+    return featureOfs_;
+}
+
+
+std::vector<uint8_t> TileEncoder::encode()
+{
+    if (!laidOut_) layout();
+    for (uint32_t i = 0; i < features_.size(); i++)
+    {
+        uint32_t table = tagTable(features_[i].tags);
+        uint32_t ppTags = featureOfs_[i] + 8;
+        putInt(ppTags, static_cast<int32_t>(table - ppTags) | (table & 1));
+    }
+    for (uint32_t i = 0; i < features_.size(); i++)
+    {
+        if (features_[i].type == FeatureType::WAY) writeWayBody(i);
+        if (features_[i].type == FeatureType::RELATION) writeMembers(i);
+    }
+    for (uint32_t i = 0; i < features_.size(); i++)
+    {
+        if (features_[i].isRelationMember()) writeRelationTable(i);
+    }
+    putInt(0, static_cast<int32_t>(buf_.size() - 4));
+    return std::move(buf_);
+}
+
+
+uint32_t TileEncoder::alloc(size_t size)
+{
+    size_t ofs = (buf_.size() + 3) & ~size_t(3);
+    buf_.resize(ofs + size);
+    return static_cast<uint32_t>(ofs);
+}
+
+void TileEncoder::putInt(uint32_t ofs, int32_t v)
+{
+    memcpy(&buf_[ofs], &v, 4);
+}
+
+void TileEncoder::putShort(uint32_t ofs, uint16_t v)
+{
+    memcpy(&buf_[ofs], &v, 2);
+}
+
+void TileEncoder::putBox(uint32_t ofs, const Box& box)
+{
+    putInt(ofs, box.minX());
+    putInt(ofs + 4, box.minY());
+    putInt(ofs + 8, box.maxX());
+    putInt(ofs + 12, box.maxY());
+}
+
+void TileEncoder::append(const uint8_t* p, size_t size)
+{
+    buf_.insert(buf_.end(), p, p + size);
+}
+
+
+/// Writes the spatial index of one type of feature. Features with
+/// indexed keys are placed under separate roots (one for each
+/// combination of index bits), which lets queries skip those
+/// whose keys they don't look for.
+void TileEncoder::writeIndex(uint32_t ppRoot, const std::vector<uint32_t>& items)
+{
+    std::map<uint32_t, std::vector<uint32_t>> roots;
+    for (uint32_t item : items) roots[features_[item].indexBits].push_back(item);
+    if (roots.size() == 1 && roots.begin()->first == 0)
+    {
+        Box bounds;
+        uint32_t root = writeTree(roots.begin()->second, bounds);
+        putInt(ppRoot, static_cast<int32_t>((root & ~3u) - ppRoot) | (root & 2));
+        return;
+    }
+    uint32_t table = alloc(roots.size() * 8);
+    putInt(ppRoot, static_cast<int32_t>(table - ppRoot) | 1);
+    uint32_t entry = table;
+    for (auto& [indexBits, rootItems] : roots)
+    {
+        Box bounds;
+        uint32_t root = writeTree(rootItems, bounds);
+        bool last = entry == table + (roots.size() - 1) * 8;
+        putInt(entry, static_cast<int32_t>((root & ~3u) - entry) |
+            (root & 2) | (last ? 1 : 0));
+        putInt(entry + 4, static_cast<int32_t>(indexBits));
+        entry += 8;
+    }
+}
+
+namespace {
+
+Coordinate center(const Box& b)
+{
+    return Coordinate(
+        static_cast<int32_t>((static_cast<int64_t>(b.minX()) + b.maxX()) / 2),
+        static_cast<int32_t>((static_cast<int64_t>(b.minY()) + b.maxY()) / 2));
+}
+
+} // namespace
+
+
+/// Writes an R-tree of the given features (packed by sort-tile-
+/// recursive partitioning), and returns the offset of its root,
+/// with bit 1 set if the root is a leaf
+uint32_t TileEncoder::writeTree(std::vector<uint32_t>& items, Box& bounds)
+{
+    if (items.size() <= LEAF_CAPACITY) return writeLeaf(items, bounds) | 2;
+
+    size_t childCount = std::min(BRANCH_CAPACITY,
+        (items.size() + LEAF_CAPACITY - 1) / LEAF_CAPACITY);
+    size_t sliceCount = static_cast<size_t>(
+        std::ceil(std::sqrt(static_cast<double>(childCount))));
+    size_t childrenPerSlice = (childCount + sliceCount - 1) / sliceCount;
+    size_t perSlice = (items.size() + sliceCount - 1) / sliceCount;
+    size_t perChild = (perSlice + childrenPerSlice - 1) / childrenPerSlice;
+
+    auto byX = [this](uint32_t a, uint32_t b)
+    {
+        return center(features_[a].bounds).x < center(features_[b].bounds).x;
+    };
+    auto byY = [this](uint32_t a, uint32_t b)
+    {
+        return center(features_[a].bounds).y < center(features_[b].bounds).y;
+    };
+    std::stable_sort(items.begin(), items.end(), byX);
+    std::vector<std::vector<uint32_t>> children;
+    for (size_t start = 0; start < items.size(); start += perSlice)
+    {
+        auto first = items.begin() + start;
+        auto end = items.begin() + std::min(start + perSlice, items.size());
+        std::stable_sort(first, end, byY);
+        for (auto p = first; p < end; p += std::min<ptrdiff_t>(perChild, end - p))
+        {
+            children.emplace_back(p, p + std::min<ptrdiff_t>(perChild, end - p));
+        }
+    }
+
+    uint32_t branch = alloc(children.size() * 20);
+    for (size_t i = 0; i < children.size(); i++)
+    {
+        Box childBounds;
+        uint32_t child = writeTree(children[i], childBounds);
+        uint32_t entry = branch + static_cast<uint32_t>(i * 20);
+        putInt(entry, static_cast<int32_t>((child & ~3u) - entry) |
+            (child & 2) | (i == children.size() - 1 ? 1 : 0));
+        putBox(entry + 4, childBounds);
+        bounds.expandToIncludeSimple(childBounds);
+    }
+    return branch;
+}
+
+
+uint32_t TileEncoder::writeLeaf(const std::vector<uint32_t>& items, Box& bounds)
+{
+    uint32_t leaf = 0;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        const TileFeature& f = features_[items[i]];
+        int flags = f.flags | (f.isRelationMember() ? FeatureFlags::RELATION_MEMBER : 0) |
+            (i == items.size() - 1 ? FeatureFlags::LAST_SPATIAL_ITEM : 0);
+        uint32_t feature;
+        if (f.type == FeatureType::NODE)
+        {
+            // Nodes that belong to relations have a relation-table pointer
+            uint32_t record = alloc(f.isRelationMember() ? 24 : 20);
+            putInt(record, f.coords[0].x);
+            putInt(record + 4, f.coords[0].y);
+            feature = record + 8;
+        }
+        else
+        {
+            uint32_t record = alloc(32);
+            putBox(record, f.bounds);
+            feature = record + 16;
+        }
+        if (i == 0) leaf = feature - (f.type == FeatureType::NODE ? 8 : 16);
+        uint64_t header = FeatureHeader::forTypeAndId(f.type, f.id).bits() |
+            static_cast<uint64_t>(flags);
+        memcpy(&buf_[feature], &header, 8);
+        featureOfs_[items[i]] = feature;
+        bounds.expandToIncludeSimple(f.bounds);
+    }
+    return leaf;
+}
+
+
+/// Returns the offset of the given local string, writing it if it
+/// hasn't been written yet (local keys must be 4-byte aligned)
+uint32_t TileEncoder::localString(const std::string& s, uint32_t alignment)
+{
+    auto it = localStrings_.find(s);
+    if (it != localStrings_.end() && (it->second & (alignment - 1)) == 0)
+    {
+        return it->second;
+    }
+    buf_.resize((buf_.size() + alignment - 1) & ~size_t(alignment - 1));
+    uint32_t ofs = static_cast<uint32_t>(buf_.size());
+    uint8_t len[4];
+    uint8_t* p = len;
+    writeVarint(p, s.size());
+    append(len, p - len);
+    append(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    localStrings_[s] = ofs;
+    return ofs;
+}
+
+
+/// Returns the offset of the table for the given tags, writing it
+/// if no other feature of the tile has the same tags. Bit 0 of the
+/// result is set if the table has local keys (which precede the
+/// table, while its global keys follow it).
+uint32_t TileEncoder::tagTable(const std::vector<TileFeature::Tag>& tags)
+{
+    std::string signature;
+    std::vector<uint32_t> strings;
+    std::vector<uint32_t> keyStrings;
+    for (const TileFeature::Tag& tag : tags)
+    {
+        signature.append(reinterpret_cast<const char*>(&tag.key), 2);
+        signature.push_back(static_cast<char>(tag.type));
+        signature.push_back(static_cast<char>(tag.scale));
+        signature.append(reinterpret_cast<const char*>(&tag.value), 4);
+        signature.append(tag.local);
+        signature.push_back(0);
+        signature.append(tag.localKey);
+        signature.push_back(0);
+        if (tag.type == TagValueType::LOCAL_STRING)
+        {
+            strings.push_back(localString(tag.local));
+        }
+        if (!tag.localKey.empty()) keyStrings.push_back(localString(tag.localKey, 4));
+    }
+    auto it = tagTables_.find(signature);
+    if (it != tagTables_.end()) return it->second;
+
+    size_t globalSize = 0;
+    size_t localSize = 0;
+    for (const TileFeature::Tag& tag : tags)
+    {
+        if (tag.localKey.empty())
+        {
+            globalSize += (tag.type & 2) ? 6 : 4;
+        }
+        else
+        {
+            localSize += (tag.type & 2) ? 8 : 6;
+        }
+    }
+    if (globalSize == 0) globalSize = 4;    // room for the empty-table marker
+    uint32_t pad = static_cast<uint32_t>((4 - (localSize & 3)) & 3);
+    uint32_t table = alloc(pad + localSize + globalSize) + pad +
+        static_cast<uint32_t>(localSize);
+    putInt(table, static_cast<int32_t>(TagValues::EMPTY_TABLE_MARKER));
+
+    // Global tags (in the given order, which must be by ascending key)
+    size_t globalCount = 0;
+    for (const TileFeature::Tag& tag : tags) globalCount += tag.localKey.empty();
+    uint32_t p = table;
+    size_t nextString = 0;
+    size_t n = 0;
+    for (const TileFeature::Tag& tag : tags)
+    {
+        if (!tag.localKey.empty())
+        {
+            if (tag.type == TagValueType::LOCAL_STRING) nextString++;
+            continue;
+        }
+        putShort(p, static_cast<uint16_t>((tag.key << 2) | tag.type |
+            (++n == globalCount ? 0x8000 : 0)));
+        p += 2;
+        switch (tag.type)
+        {
+        case TagValueType::NARROW_NUMBER:
+            putShort(p, static_cast<uint16_t>(tag.value - TagValues::MIN_NUMBER));
+            p += 2;
+            break;
+        case TagValueType::GLOBAL_STRING:
+            putShort(p, static_cast<uint16_t>(tag.value));
+            p += 2;
+            break;
+        case TagValueType::WIDE_NUMBER:
+            putInt(p, static_cast<int32_t>(
+                ((tag.value - TagValues::MIN_NUMBER) << 2) | tag.scale));
+            p += 4;
+            break;
+        default:
+            putInt(p, static_cast<int32_t>(strings[nextString++] - p));
+            p += 4;
+            break;
+        }
+    }
+
+    // Local tags, each a value followed by a pointer to its key (relative
+    // to the table), running backwards from the table; the last is flagged
+    p = table;
+    nextString = 0;
+    size_t nextKey = 0;
+    for (const TileFeature::Tag& tag : tags)
+    {
+        if (tag.localKey.empty())
+        {
+            if (tag.type == TagValueType::LOCAL_STRING) nextString++;
+            continue;
+        }
+        p -= 4;
+        int32_t keyDelta = static_cast<int32_t>(keyStrings[nextKey++] - table);
+        int flags = tag.type | (nextKey == keyStrings.size() ? 4 : 0);
+        putInt(p, static_cast<int32_t>(static_cast<uint32_t>(keyDelta) << 1) | flags);
+        switch (tag.type)
+        {
+        case TagValueType::NARROW_NUMBER:
+            p -= 2;
+            putShort(p, static_cast<uint16_t>(tag.value - TagValues::MIN_NUMBER));
+            break;
+        case TagValueType::GLOBAL_STRING:
+            p -= 2;
+            putShort(p, static_cast<uint16_t>(tag.value));
+            break;
+        case TagValueType::WIDE_NUMBER:
+            p -= 4;
+            putInt(p, static_cast<int32_t>(
+                ((tag.value - TagValues::MIN_NUMBER) << 2) | tag.scale));
+            break;
+        default:
+            p -= 4;
+            putInt(p, static_cast<int32_t>(strings[nextString++] - p));
+            break;
+        }
+    }
+    uint32_t result = table | (keyStrings.empty() ? 0 : 1);
+    tagTables_[signature] = result;
+    return result;
+}
+
+
+/// The size of the table of a way's feature nodes (the first foreign
+/// node always has a TIP delta, since it makes the iterator look up
+/// its tile)
+uint32_t TileEncoder::featureNodeTableSize(const TileFeature& way) const
+{
+    uint32_t size = 0;
+    Tip tip = FeatureConstants::START_TIP;
+    bool anyForeign = false;
+    for (const TileFeature::NodeRef& node : way.featureNodes)
+    {
+        size += 4;
+        if (node.feature == TileFeature::FOREIGN &&
+            (!anyForeign || node.foreign.tip != tip))
+        {
+            size += tipDeltaSize(tip, node.foreign.tip);
+            tip = node.foreign.tip;
+            anyForeign = true;
+        }
+    }
+    return size;
+}
+
+
+/// Writes the body of a way: its coordinates, preceded by its
+/// relation-table pointer (if it belongs to relations), which in turn
+/// is preceded by the table of its feature nodes. The node table runs
+/// backwards, so the iterator reads the nodes in way order.
+void TileEncoder::writeWayBody(uint32_t i)
+{
+    const TileFeature& way = features_[i];
+    uint32_t tableSize = featureNodeTableSize(way);
+    uint32_t body;
+    if (tableSize == 0 && !way.isRelationMember())
+    {
+        body = static_cast<uint32_t>(buf_.size());
+    }
+    else
+    {
+        // The top of the node table must be 4-byte aligned
+        uint32_t pad = (4 - (tableSize & 3)) & 3;
+        uint32_t top = alloc(pad + tableSize + (way.isRelationMember() ? 4 : 0)) +
+            pad + tableSize;
+        body = top;
+        if (way.isRelationMember())
+        {
+            relTablePtrs_[i] = top;
+            body += 4;
+        }
+        uint32_t p = top;
+        Tip tip = FeatureConstants::START_TIP;
+        bool anyForeign = false;
+        for (size_t n = 0; n < way.featureNodes.size(); n++)
+        {
+            const TileFeature::NodeRef& node = way.featureNodes[n];
+            int32_t last = n == way.featureNodes.size() - 1 ? MemberFlags::LAST : 0;
+            p -= 4;
+            uint32_t pEntry = p;
+            if (node.feature == TileFeature::FOREIGN)
+            {
+                int32_t flags = MemberFlags::FOREIGN | last;
+                if (!anyForeign || node.foreign.tip != tip)
+                {
+                    flags |= MemberFlags::DIFFERENT_TILE;
+                    int32_t delta = node.foreign.tip - tip;
+                    if (tipDeltaSize(tip, node.foreign.tip) == 2)
+                    {
+                        p -= 2;
+                        putShort(p, static_cast<uint16_t>(delta << 1));
+                    }
+                    else
+                    {
+                        // Low half first (going backwards), flagged as wide
+                        uint32_t wide = (static_cast<uint32_t>(delta) << 1) | 1;
+                        p -= 2;
+                        putShort(p, static_cast<uint16_t>(wide));
+                        p -= 2;
+                        putShort(p, static_cast<uint16_t>(wide >> 16));
+                    }
+                    tip = node.foreign.tip;
+                    anyForeign = true;
+                }
+                putInt(pEntry, static_cast<int32_t>(node.foreign.ofs << 2) | flags);
+            }
+            else
+            {
+                int32_t delta = static_cast<int32_t>(featureOfs_[node.feature] - pEntry);
+                putInt(pEntry, (delta << 1) | last);
+            }
+        }
+        assert(p == top - tableSize);
+    }
+    uint8_t varints[32];
+    uint8_t* p = varints;
+    writeVarint(p, way.coords.size());
+    int32_t prevX = way.bounds.minX();
+    int32_t prevY = way.bounds.minY();
+    append(varints, p - varints);
+    for (Coordinate c : way.coords)
+    {
+        p = varints;
+        writeSignedVarint(p, static_cast<int64_t>(c.x) - prevX);
+        writeSignedVarint(p, static_cast<int64_t>(c.y) - prevY);
+        append(varints, p - varints);
+        prevX = c.x;
+        prevY = c.y;
+    }
+    uint32_t ppBody = featureOfs_[i] + 12;
+    putInt(ppBody, static_cast<int32_t>(body - ppBody));
+}
+
+
+/// The size of the TIP delta that precedes a reference to a feature
+/// in another tile (narrow deltas take 2 bytes, wide ones 4)
+uint32_t TileEncoder::tipDeltaSize(Tip from, Tip to) const
+{
+    int32_t delta = to - from;
+    return (delta >= -(1 << 14) && delta < (1 << 14)) ? 2 : 4;
+}
+
+uint32_t TileEncoder::putTipDelta(uint32_t p, Tip from, Tip to)
+{
+    int32_t delta = to - from;
+    if (tipDeltaSize(from, to) == 2)
+    {
+        putShort(p, static_cast<uint16_t>(delta << 1));
+        return p + 2;
+    }
+    uint32_t wide = (static_cast<uint32_t>(delta) << 1) | 1;
+    putShort(p, static_cast<uint16_t>(wide));
+    putShort(p + 2, static_cast<uint16_t>(wide >> 16));
+    return p + 4;
+}
+
+
+void TileEncoder::writeMembers(uint32_t i)
+{
+    const TileFeature& rel = features_[i];
+    std::vector<uint32_t> roleStrings;
+    size_t size = 0;
+    uint16_t role = 0;
+    const std::string* localRole = nullptr;
+    Tip tip = FeatureConstants::START_TIP;
+    for (const TileFeature::Member& m : rel.members)
+    {
+        size += 4;
+        if (m.feature == TileFeature::FOREIGN && m.foreign.tip != tip)
+        {
+            size += tipDeltaSize(tip, m.foreign.tip);
+            tip = m.foreign.tip;
+        }
+        bool sameRole = m.localRole.empty() ?
+            (localRole == nullptr && m.role == role) :
+            (localRole != nullptr && m.localRole == *localRole);
+        if (!sameRole)
+        {
+            if (m.localRole.empty())
+            {
+                size += 2;
+                localRole = nullptr;
+            }
+            else
+            {
+                size += 4;
+                roleStrings.push_back(localString(m.localRole));
+                localRole = &m.localRole;
+            }
+            role = m.role;
+        }
+    }
+
+    // The relation-table pointer of a relation that belongs to other
+    // relations precedes the member table
+    uint32_t table;
+    if (rel.isRelationMember())
+    {
+        relTablePtrs_[i] = alloc(size + 4);
+        table = relTablePtrs_[i] + 4;
+    }
+    else
+    {
+        table = alloc(size);
+    }
+    uint32_t p = table;
+    role = 0;
+    localRole = nullptr;
+    tip = FeatureConstants::START_TIP;
+    size_t nextRoleString = 0;
+    for (size_t n = 0; n < rel.members.size(); n++)
+    {
+        const TileFeature::Member& m = rel.members[n];
+        bool sameRole = m.localRole.empty() ?
+            (localRole == nullptr && m.role == role) :
+            (localRole != nullptr && m.localRole == *localRole);
+        int32_t flags = (n == rel.members.size() - 1 ? MemberFlags::LAST : 0) |
+            (sameRole ? 0 : MemberFlags::DIFFERENT_ROLE);
+        uint32_t pMember = p;
+        p += 4;
+        if (m.feature == TileFeature::FOREIGN)
+        {
+            flags |= MemberFlags::FOREIGN;
+            if (m.foreign.tip != tip)
+            {
+                flags |= MemberFlags::DIFFERENT_TILE;
+                p = putTipDelta(p, tip, m.foreign.tip);
+                tip = m.foreign.tip;
+            }
+            putInt(pMember, static_cast<int32_t>(m.foreign.ofs << 2) | flags);
+        }
+        else
+        {
+            int32_t delta = static_cast<int32_t>(featureOfs_[m.feature] - (pMember & ~3u));
+            putInt(pMember, (delta << 1) | flags);
+        }
+        if (!sameRole)
+        {
+            if (m.localRole.empty())
+            {
+                putShort(p, static_cast<uint16_t>((m.role << 1) | 1));
+                p += 2;
+                localRole = nullptr;
+            }
+            else
+            {
+                uint32_t raw = static_cast<uint32_t>(
+                    static_cast<int32_t>(roleStrings[nextRoleString++] - p) << 1);
+                putShort(p, static_cast<uint16_t>(raw));
+                putShort(p + 2, static_cast<uint16_t>(raw >> 16));
+                p += 4;
+                localRole = &m.localRole;
+            }
+            role = m.role;
+        }
+    }
+    uint32_t ppBody = featureOfs_[i] + 12;
+    putInt(ppBody, static_cast<int32_t>(table - ppBody));
+}
+
+
+/// Writes the table of the relations to which a feature belongs: those
+/// in the same tile first, followed by those in other tiles (which
+/// should be sorted by TIP, so their TIP deltas stay small)
+void TileEncoder::writeRelationTable(uint32_t i)
+{
+    const TileFeature& f = features_[i];
+    size_t size = f.parents.size() * 4;
+    Tip tip = FeatureConstants::START_TIP;
+    for (size_t n = 0; n < f.foreignParents.size(); n++)
+    {
+        size += 4;
+        // The first foreign relation always has a TIP delta, since it
+        // makes the iterator look up its tile
+        if (n == 0 || f.foreignParents[n].tip != tip)
+        {
+            size += tipDeltaSize(tip, f.foreignParents[n].tip);
+            tip = f.foreignParents[n].tip;
+        }
+    }
+    uint32_t table = alloc(size);
+    uint32_t p = table;
+    size_t count = f.parents.size() + f.foreignParents.size();
+    for (size_t n = 0; n < f.parents.size(); n++)
+    {
+        int32_t delta = static_cast<int32_t>(featureOfs_[f.parents[n]] - p);
+        putInt(p, (delta << 1) | (n == count - 1 ? MemberFlags::LAST : 0));
+        p += 4;
+    }
+    tip = FeatureConstants::START_TIP;
+    for (size_t n = 0; n < f.foreignParents.size(); n++)
+    {
+        const TileFeature::ForeignRef& parent = f.foreignParents[n];
+        int32_t flags = MemberFlags::FOREIGN |
+            (f.parents.size() + n == count - 1 ? MemberFlags::LAST : 0);
+        uint32_t pEntry = p;
+        p += 4;
+        if (n == 0 || parent.tip != tip)
+        {
+            flags |= MemberFlags::DIFFERENT_TILE;
+            p = putTipDelta(p, tip, parent.tip);
+            tip = parent.tip;
+        }
+        putInt(pEntry, static_cast<int32_t>(parent.ofs << 2) | flags);
+    }
+    // For nodes, the relation-table pointer takes the place of the body
+    uint32_t ppTable = f.type == FeatureType::NODE ?
+        featureOfs_[i] + 12 : relTablePtrs_[i];
+    putInt(ppTable, static_cast<int32_t>(table - ppTable));
+}
+
+} // namespace geodesk
@@ -0,0 +1,145 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <geodesk/feature/FeatureType.h>
+#include <geodesk/feature/Tip.h>
+#include <geodesk/feature/types.h>
+#include <geodesk/geom/Box.h>
+#include <geodesk/geom/Coordinate.h>
+
+namespace geodesk {
+
+/// \cond lowlevel
+
+/// A feature as it is written into a tile blob
+///
+struct TileFeature
+{
+    struct Tag
+    {
+        uint16_t key;           // global-string code (unless localKey is set)
+        uint8_t type;           // TagValueType
+        uint8_t scale;          // decimal places of a WIDE_NUMBER (0 to 3)
+        uint32_t value;         // global-string code or number (for decimals,
+                                // the number without its decimal point)
+        std::string local;      // value of a local string
+        std::string localKey;   // key that isn't a global string
+    };
+
+    /// A feature that lives in another tile: the TIP of that tile, and
+    /// the offset of the feature (its header) within the tile blob
+    struct ForeignRef
+    {
+        Tip tip;
+        uint32_t ofs;
+    };
+
+    static constexpr uint32_t FOREIGN = 0xffff'ffff;
+
+    struct Member
+    {
+        uint32_t feature;       // index of the member within its tile, or FOREIGN
+        uint16_t role;          // global-string code (unless localRole is set)
+        ForeignRef foreign = {};
+        std::string localRole;
+    };
+
+    /// A feature node of a way
+    struct NodeRef
+    {
+        uint32_t feature;       // index of the node within its tile, or FOREIGN
+        ForeignRef foreign = {};
+    };
+
+    FeatureType type;
+    int flags = 0;
+    uint64_t id = 0;
+    Box bounds;
+    /// For ways, the coordinates as they are stored (areas omit the
+    /// closing coordinate); for nodes, its location
+    std::vector<Coordinate> coords;
+    std::vector<Tag> tags;
+    std::vector<Member> members;
+    /// For ways, the nodes that are features in their own right, in
+    /// the order in which they appear in the way (the WAYNODE flag must
+    /// be set if there are any)
+    std::vector<NodeRef> featureNodes;
+    /// The relations in the same tile to which the feature belongs
+    std::vector<uint32_t> parents;
+    /// The relations in other tiles to which the feature belongs
+    std::vector<ForeignRef> foreignParents;
+    uint32_t indexBits = 0;
+
+    bool isRelationMember() const
+    {
+        return !parents.empty() || !foreignParents.empty();
+    }
+
+    FeatureIndexType indexType() const
+    {
+        if (type == FeatureType::NODE) return FeatureIndexType::NODES;
+        if (flags & FeatureFlags::AREA) return FeatureIndexType::AREAS;
+        return type == FeatureType::WAY ?
+            FeatureIndexType::WAYS : FeatureIndexType::RELATIONS;
+    }
+};
+
+/// Encodes the features of a tile into a tile blob (without the
+/// compression flags, which are set by the caller if needed).
+///
+/// The features are laid out first (spatial index and feature
+/// records); their offsets are known once layout() has been called,
+/// which lets a builder resolve references to them from other tiles
+/// before any tile is encoded.
+///
+class TileEncoder
+{
+public:
+    explicit TileEncoder(const std::vector<TileFeature>& features);
+
+    /// Writes the spatial indexes and feature records, and returns
+    /// the offset of each feature (its header) within the blob
+    const std::vector<uint32_t>& layout();
+
+    /// Returns the tile blob (the encoder can't be used afterwards)
+    std::vector<uint8_t> encode();
+
+private:
+    static constexpr size_t LEAF_CAPACITY = 16;
+    static constexpr size_t BRANCH_CAPACITY = 16;
+
+    uint32_t alloc(size_t size);
+    void putInt(uint32_t ofs, int32_t v);
+    void putShort(uint32_t ofs, uint16_t v);
+    void putBox(uint32_t ofs, const Box& box);
+    void append(const uint8_t* p, size_t size);
+    void writeIndex(uint32_t ppRoot, const std::vector<uint32_t>& items);
+    uint32_t writeTree(std::vector<uint32_t>& items, Box& bounds);
+    uint32_t writeLeaf(const std::vector<uint32_t>& items, Box& bounds);
+    uint32_t localString(const std::string& s, uint32_t alignment = 1);
+    uint32_t tagTable(const std::vector<TileFeature::Tag>& tags);
+    uint32_t featureNodeTableSize(const TileFeature& way) const;
+    void writeWayBody(uint32_t i);
+    void writeMembers(uint32_t i);
+    void writeRelationTable(uint32_t i);
+    uint32_t tipDeltaSize(Tip from, Tip to) const;
+    uint32_t putTipDelta(uint32_t p, Tip from, Tip to);
+
+    const std::vector<TileFeature>& features_;
+    std::vector<uint32_t> featureOfs_;
+    std::vector<uint8_t> buf_;
+    bool laidOut_ = false;
+    std::unordered_map<std::string, uint32_t> localStrings_;
+    std::unordered_map<std::string, uint32_t> tagTables_;
+    std::unordered_map<uint32_t, uint32_t> relTablePtrs_;
+};
+
+// \endcond
+
+} // namespace geodesk
@@ -5,6 +5,109 @@
 
 namespace clarisma {
 
+namespace {
+
+/**
+ * The chunks that were freed by Arenas on the current thread, by size.
+ */
+class ChunkCache
+{
+public:
+	static constexpr int MIN_SIZE_SHIFT = 12;		// 4 KB
+	static constexpr int MAX_SIZE_SHIFT = 16;		// 64 KB
+	static constexpr int MAX_CHUNKS_PER_SIZE = 8;
+
+	~ChunkCache()
+	{
+		for (Entry* entry : free_)
+		{
+			while (entry)
+			{
+				Entry* next = entry->next;
+				delete[] reinterpret_cast<uint8_t*>(entry);
+				entry = next;
+			}
+		}
+	}
+
+	/// Returns a free chunk with the given usable size (excluding
+	/// the chunk header), or nullptr if there is none
+	uint8_t* take(size_t size)
+	{
+		int n = slot(size);
+		if (n < 0 || !free_[n]) return nullptr;
+		Entry* entry = free_[n];
+		free_[n] = entry->next;
+		count_[n]--;
+		return reinterpret_cast<uint8_t*>(entry);
+	}
+
+	/// Keeps the given chunk for reuse, or returns false if we
+	/// don't keep chunks of its size (or already have enough)
+	bool give(uint8_t* chunk, size_t size)
+	{
+		int n = slot(size);
+		if (n < 0 || count_[n] == MAX_CHUNKS_PER_SIZE) return false;
+		Entry* entry = reinterpret_cast<Entry*>(chunk);
+		entry->next = free_[n];
+		free_[n] = entry;
+		count_[n]++;
+		return true;
+	}
+
+private:
+	struct Entry
+	{
+		Entry* next;
+	};
+
+	static int slot(size_t size)
+	{
+		for (int shift = MIN_SIZE_SHIFT; shift <= MAX_SIZE_SHIFT; shift++)
+		{
+			if (size == (size_t(1) << shift)) return shift - MIN_SIZE_SHIFT;
+		}
+		return -1;
+	}
+
+	Entry* free_[MAX_SIZE_SHIFT - MIN_SIZE_SHIFT + 1] = {};
+	int count_[MAX_SIZE_SHIFT - MIN_SIZE_SHIFT + 1] = {};
+};
+
+// Set once the cache of this thread has been destroyed (Arenas that
+// are themselves thread-local may outlive it)
+thread_local bool chunkCacheDestroyed = false;
+
+struct ThreadChunkCache : ChunkCache
+{
+	~ThreadChunkCache() { chunkCacheDestroyed = true; }
+};
+
+ChunkCache* chunkCache()
+{
+	if (chunkCacheDestroyed) return nullptr;
+	thread_local ThreadChunkCache cache;
+	return &cache;
+}
+
+} // namespace
+
+
+void Arena::freeChunks(Chunk* chunk)
+{
+	ChunkCache* cache = chunk ? chunkCache() : nullptr;
+	while (chunk)
+	{
+		Chunk* next = chunk->next;
+		uint8_t* raw = reinterpret_cast<uint8_t*>(chunk);
+		if (!cache || !cache->give(raw, chunk->size))
+		{
+			delete[] raw;
+		}
+		chunk = next;
+	}
+}
+
 // TODO: The handling of whales looks problematic,
 // we'll use a simpler approach for now
 
@@ -79,9 +182,12 @@ void Arena::allocChunk(size_t size)
 		nextSize_ += nextSize_ >> (intialSizeAndPolicy_ & 0xff);
 		// TODO: nextSize_ = nextSize(nextSize_);
 	}
-	uint8_t* newChunkRaw = new uint8_t[sizeof(Chunk) + size];
+	ChunkCache* cache = chunkCache();
+	uint8_t* newChunkRaw = cache ? cache->take(size) : nullptr;
+	if (!newChunkRaw) newChunkRaw = new uint8_t[sizeof(Chunk) + size];
 	Chunk* newChunk = reinterpret_cast<Chunk*>(newChunkRaw);
 	newChunk->next = current_;
+	newChunk->size = size;
 	current_ = newChunk;
 	p_ = newChunkRaw + sizeof(Chunk);
 	end_ = p_ + size;
@@ -115,13 +115,14 @@ void ExpandableMappedFile::unmapSegments()
 		mainMapping_ = nullptr;
 	}
 
-	uint64_t mappingSize = SEGMENT_LENGTH;
 	for (int slot = 0; slot < EXTENDED_MAPPINGS_SLOT_COUNT; slot++)
 	{
 		if (extendedMappings_[slot])
 		{
+			// Each slot is twice the size of the previous one; unmapping
+			// fewer bytes would leave the remainder of the range mapped
 			byte* mapping = extendedMappings_[slot].load();
-			unmap(mapping, mappingSize);
+			unmap(mapping, SEGMENT_LENGTH << slot);
 			extendedMappings_[slot].store(nullptr);
 		}
 	}
@@ -103,6 +103,19 @@ void File::force()
     }
 }
 
+void File::forceData()
+{
+#ifdef __APPLE__
+    int res = fsync(fileHandle_);
+#else
+    int res = fdatasync(fileHandle_);
+#endif
+    if (res != 0)
+    {
+        IOException::checkAndThrow();
+    }
+}
+
 
 void File::seek(uint64_t posAbsolute)
 {
@@ -116,6 +116,11 @@ void File::force()
     }
 }
 
+void File::forceData()
+{
+    force();
+}
+
 
 void File::seek(uint64_t posAbsolute)
 {
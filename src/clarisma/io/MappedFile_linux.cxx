@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <clarisma/io/MappedFile.h>
+#include <algorithm>
 #include <stdexcept>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -23,11 +24,14 @@ void* MappedFile::map(uint64_t offset, uint64_t length, int mode)
 }
 
 
-void MappedFile::sync(const void* addr, uint64_t length)
+void MappedFile::sync(const void* addr, uint64_t length, bool invalidate)
 {
-    // TODO: Check if we should make MS_INVALIDATE optional
-
-    if (msync(const_cast<void*>(addr), length, MS_SYNC | MS_INVALIDATE) == -1)
+    // msync() requires a page-aligned address
+    uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(addr) + length;
+    if (msync(reinterpret_cast<void*>(start), end - start,
+        invalidate ? (MS_SYNC | MS_INVALIDATE) : MS_SYNC) == -1)
     {
         IOException::checkAndThrow();
     }
@@ -46,5 +50,99 @@ void MappedFile::prefetch(void* address, uint64_t length)
     }
 }
 
+namespace {
+
+/// Calls madvise() for all pages that overlap the given range
+int advisePages(const void* address, uint64_t length, int advice) noexcept
+{
+    uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(address) + length;
+    return madvise(reinterpret_cast<void*>(start), end - start, advice);
+}
+
+} // namespace
+
+void MappedFile::advise(const void* address, uint64_t length, AccessPattern pattern) noexcept
+{
+    int advice;
+    switch (pattern)
+    {
+    case AccessPattern::RANDOM:
+        advice = MADV_RANDOM;
+        break;
+    case AccessPattern::SEQUENTIAL:
+        advice = MADV_SEQUENTIAL;
+        break;
+    default:
+        advice = MADV_NORMAL;
+        break;
+    }
+    advisePages(address, length, advice);
+}
+
+void MappedFile::adviseHugePages(const void* address, uint64_t length) noexcept
+{
+    #ifdef MADV_HUGEPAGE
+    advisePages(address, length, MADV_HUGEPAGE);
+    #endif
+}
+
+void MappedFile::populate(const void* address, uint64_t length) noexcept
+{
+    // MADV_POPULATE_READ (Linux 5.14) faults the pages in, like
+    // MAP_POPULATE does for a new mapping; older kernels (and macOS)
+    // fall back to asynchronous readahead
+    #ifdef MADV_POPULATE_READ
+    if (advisePages(address, length, MADV_POPULATE_READ) == 0) return;
+    #endif
+    advisePages(address, length, MADV_WILLNEED);
+}
+
+void MappedFile::evict(const void* address, uint64_t length) noexcept
+{
+    // MADV_COLD (Linux 5.4) moves the pages to the inactive list, but
+    // keeps them cached; otherwise, we simply drop them from this
+    // process (pages of a shared file mapping stay in the page cache
+    // until the kernel needs the memory)
+    #ifdef MADV_COLD
+    if (advisePages(address, length, MADV_COLD) == 0) return;
+    #endif
+    advisePages(address, length, MADV_DONTNEED);
+}
+
+MappedFile::Residency MappedFile::residency(const void* address, uint64_t length) noexcept
+{
+    #ifdef __APPLE__
+    using Vec = char;
+    #else
+    using Vec = unsigned char;
+    #endif
+    constexpr uintptr_t CHUNK_PAGES = 1024;
+
+    uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(address) + length;
+    uintptr_t pages = (end - start + pageSize - 1) / pageSize;
+
+    Residency result;
+    result.bytes = pages * pageSize;
+    Vec vec[CHUNK_PAGES];
+    for (uintptr_t first = 0; first < pages; first += CHUNK_PAGES)
+    {
+        uintptr_t count = std::min(pages - first, CHUNK_PAGES);
+        if (mincore(reinterpret_cast<void*>(start + first * pageSize),
+            count * pageSize, vec) != 0)
+        {
+            continue;
+        }
+        for (uintptr_t i = 0; i < count; i++)
+        {
+            if (vec[i] & 1) result.residentBytes += pageSize;
+        }
+    }
+    return result;
+}
+
 } // namespace clarisma
 
@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <clarisma/io/MappedFile.h>
+#include <algorithm>
 #include <memoryapi.h>
+#include <psapi.h>
 
 namespace clarisma {
 
@@ -42,7 +44,7 @@ void MappedFile::unmap(void* mappedAddress, uint64_t /* length */)
     UnmapViewOfFile(mappedAddress);
 }
 
-void MappedFile::sync(const void* address, uint64_t length)
+void MappedFile::sync(const void* address, uint64_t length, bool /* invalidate */)
 {
     if (!FlushViewOfFile(address, length)) IOException::checkAndThrow();
     if (!FlushFileBuffers(handle())) IOException::checkAndThrow();
@@ -56,5 +58,64 @@ void MappedFile::prefetch(void* address, uint64_t length)
     PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
 }
 
+void MappedFile::advise(const void* address, uint64_t length, AccessPattern pattern) noexcept
+{
+    // Windows has no per-range readahead hints for mapped views
+}
+
+void MappedFile::adviseHugePages(const void* address, uint64_t length) noexcept
+{
+    // Large pages are not available for file mappings
+}
+
+void MappedFile::populate(const void* address, uint64_t length) noexcept
+{
+    WIN32_MEMORY_RANGE_ENTRY entry;
+    entry.VirtualAddress = const_cast<void*>(address);
+    entry.NumberOfBytes = length;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+}
+
+void MappedFile::evict(const void* address, uint64_t length) noexcept
+{
+    // Unlocking pages that aren't locked removes them from the
+    // working set (the call itself reports an error, which we ignore)
+    VirtualUnlock(const_cast<void*>(address), length);
+}
+
+MappedFile::Residency MappedFile::residency(const void* address, uint64_t length) noexcept
+{
+    constexpr uintptr_t CHUNK_PAGES = 1024;
+
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    uintptr_t pageSize = info.dwPageSize;
+    uintptr_t start = reinterpret_cast<uintptr_t>(address) & ~(pageSize - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(address) + length;
+    uintptr_t pages = (end - start + pageSize - 1) / pageSize;
+
+    Residency result;
+    result.bytes = pages * pageSize;
+    PSAPI_WORKING_SET_EX_INFORMATION entries[CHUNK_PAGES];
+    for (uintptr_t first = 0; first < pages; first += CHUNK_PAGES)
+    {
+        uintptr_t count = std::min(pages - first, CHUNK_PAGES);
+        for (uintptr_t i = 0; i < count; i++)
+        {
+            entries[i].VirtualAddress = reinterpret_cast<void*>(start + (first + i) * pageSize);
+        }
+        if (!QueryWorkingSetEx(GetCurrentProcess(), entries,
+            static_cast<DWORD>(count * sizeof(entries[0]))))
+        {
+            continue;
+        }
+        for (uintptr_t i = 0; i < count; i++)
+        {
+            if (entries[i].VirtualAttributes.Valid) result.residentBytes += pageSize;
+        }
+    }
+    return result;
+}
+
 } // namespace clarisma
 
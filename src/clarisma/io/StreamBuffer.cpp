@@ -0,0 +1,147 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/io/StreamBuffer.h>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <clarisma/io/IOException.h>
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace clarisma {
+
+StreamBuffer::StreamBuffer(int fd, const Settings& settings) :
+	fd_(fd),
+	flushBytes_(settings.flushBytes),
+	maxDelay_(settings.maxDelay),
+	bytesSent_(0),
+	anySent_(false)
+{
+	buf_ = new char[settings.capacity];
+	p_ = buf_;
+	end_ = buf_ + settings.capacity;
+}
+
+
+StreamBuffer::~StreamBuffer()
+{
+	// Like FileBuffer2, we write out what remains (but a destructor
+	// must not throw, so errors are ignored at this point)
+	try
+	{
+		finish();
+	}
+	catch (const IOException&)
+	{
+	}
+	delete[] buf_;
+}
+
+
+bool StreamBuffer::isDue() const
+{
+	return !anySent_ || length() >= flushBytes_ ||
+		Clock::now() - pendingSince_ >= maxDelay_;
+}
+
+
+void StreamBuffer::markPending()
+{
+	if (p_ == buf_) pendingSince_ = Clock::now();
+}
+
+
+void StreamBuffer::filled(char* p)
+{
+	assert(p >= buf_ && p <= end_);
+	p_ = p;
+	send(nullptr, 0);
+}
+
+
+void StreamBuffer::flush(char* p)
+{
+	assert(p >= buf_ && p <= end_);
+	if (p != p_)
+	{
+		markPending();
+		p_ = p;
+	}
+	if (p_ > buf_ && isDue()) send(nullptr, 0);
+}
+
+
+void StreamBuffer::write(const char* data, size_t len)
+{
+	if (len == 0) return;
+	markPending();
+	if (length() + len < flushBytes_ && anySent_ &&
+		Clock::now() - pendingSince_ < maxDelay_ &&
+		len <= static_cast<size_t>(end_ - p_))
+	{
+		memcpy(p_, data, len);
+		p_ += len;
+		return;
+	}
+	send(data, len);
+}
+
+
+void StreamBuffer::finish()
+{
+	if (p_ > buf_) send(nullptr, 0);
+}
+
+
+/// Writes the buffered bytes, followed by `extraLen` bytes at
+/// `extra`, retrying until all have been written
+void StreamBuffer::send(const char* extra, size_t extraLen)
+{
+	const char* parts[2] = { buf_, extra };
+	size_t lengths[2] = { length(), extraLen };
+	int first = lengths[0] ? 0 : 1;
+	int count = extraLen ? 2 : 1;
+	while (first < count)
+	{
+		#if defined(_WIN32)
+		int written = _write(fd_, parts[first],
+			static_cast<unsigned int>(lengths[first]));
+		#else
+		iovec vecs[2];
+		for (int i = first; i < count; i++)
+		{
+			vecs[i - first].iov_base = const_cast<char*>(parts[i]);
+			vecs[i - first].iov_len = lengths[i];
+		}
+		ssize_t written = ::writev(fd_, vecs, count - first);
+		#endif
+		if (written < 0)
+		{
+			if (errno == EINTR) continue;
+			throw IOException("Failed to write to stream: %s", strerror(errno));
+		}
+		bytesSent_ += written;
+		// Skip past what was written (a partial write may end
+		// anywhere, including in the middle of a part)
+		size_t remaining = static_cast<size_t>(written);
+		while (first < count && remaining >= lengths[first])
+		{
+			remaining -= lengths[first];
+			first++;
+		}
+		if (first < count)
+		{
+			parts[first] += remaining;
+			lengths[first] -= remaining;
+		}
+	}
+	p_ = buf_;
+	anySent_ = true;
+}
+
+} // namespace clarisma
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <clarisma/math/Math.h>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <limits>
 
 namespace clarisma {
@@ -27,6 +30,52 @@ double Math::POWERS_OF_10[] =
 };	// 15 digits max
 
 
+namespace {
+
+/// Appends the run of decimal digits at `s` to `*pValue`, and returns
+/// the number of digits consumed. Up to 8 digits at a time are located
+/// and converted with plain 64-bit arithmetic (SWAR), which handles
+/// typical tag values ("50", "2.5", "1250000") in one or two steps.
+size_t parseDigits(const char*& s, const char* end, double* pValue)
+{
+    const char* start = s;
+    double value = *pValue;
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        while (end - s >= 8)
+        {
+            uint64_t chunk;
+            memcpy(&chunk, s, 8);
+            // The high bit of each byte that is not '0'..'9' is set
+            // (borrows and carries only propagate towards later bytes,
+            // so the first such byte is always flagged correctly)
+            uint64_t nonDigits = ((chunk + 0x4646'4646'4646'4646ULL) |
+                (chunk - 0x3030'3030'3030'3030ULL)) & 0x8080'8080'8080'8080ULL;
+            int n = nonDigits ? (std::countr_zero(nonDigits) >> 3) : 8;
+            if (n == 0) break;
+            // Move the digits to the top, so the vacated bytes become
+            // leading zeroes, then combine pairs, quads and octets
+            uint64_t digits = (chunk - 0x3030'3030'3030'3030ULL) << (8 * (8 - n));
+            digits = (digits * 10) + (digits >> 8);
+            digits = (((digits & 0x0000'00FF'0000'00FFULL) * (100 + (1000000ULL << 32))) +
+                (((digits >> 16) & 0x0000'00FF'0000'00FFULL) * (1 + (10000ULL << 32)))) >> 32;
+            value = value * Math::POWERS_OF_10[n] + static_cast<double>(digits);
+            s += n;
+            if (n < 8) break;
+        }
+    }
+    for (; s < end; s++)
+    {
+        char ch = *s;
+        if (ch < '0' || ch > '9') break;
+        value = value * 10 + (ch - '0');
+    }
+    *pValue = value;
+    return s - start;
+}
+
+} // namespace
+
 bool Math::parseDouble(const char* s, size_t len, double* pResult)
 {
     const char* end = s + len;
@@ -36,8 +85,6 @@ bool Math::parseDouble(const char* s, size_t len, double* pResult)
         if (*s > 32)
         {
             bool negative = false;
-            bool seenDigit = false;
-            const char* decimal = nullptr;
             double value = 0;
 
             if (*s == '-')
@@ -45,27 +92,18 @@ bool Math::parseDouble(const char* s, size_t len, double* pResult)
                 negative = true;
                 s++;
             }
-            for (; s < end; s++)
+            size_t digits = parseDigits(s, end, &value);
+            size_t decimals = 0;
+            if (s < end && *s == '.')
             {
-                char ch = *s;
-                if (ch >= '0' && ch <= '9')
-                {
-                    value = value * 10 + (ch - '0');
-                    seenDigit = true;
-                    continue;
-                }
-                if (ch == '.')
-                {
-                    if (decimal) break;
-                    decimal = s + 1;
-                    continue;
-                }
-                break;
+                s++;
+                decimals = parseDigits(s, end, &value);
             }
-            if (seenDigit)
+            if (digits + decimals > 0)
             {
                 value = negative ? (-value) : value;
-                *pResult = value / POWERS_OF_10[decimal ? (s - decimal) : 0];
+                *pResult = decimals < 16 ? (value / POWERS_OF_10[decimals]) :
+                    (value / std::pow(10.0, static_cast<double>(decimals)));
                 // TODO: use multiplication (factors) instead? Faster?
                 return true;
             }
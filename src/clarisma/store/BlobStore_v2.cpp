@@ -59,178 +59,76 @@ BlobStore::PageNum BlobStore::Transaction::alloc(uint32_t payloadSize)
     // int precedingBlobFreeFlag = 0;
     uint32_t requiredPages = store()->pagesForPayloadSize(payloadSize);
     HeaderBlock* rootBlock = getRootBlock();
-    uint32_t trunkRanges = rootBlock->trunkFreeTableRanges;
-    if (trunkRanges != 0)
-    {
-        // If there are free blobs, check if there is one large enough
-        // to accommodate the requested size
-
-        // The first slot in the trunk FT worth checking
-        uint32_t trunkSlot = (requiredPages - 1) / 512;
-        uint32_t trunkSlotEnd = (trunkSlot & 0x1f0) + 16;
-
-        // The first slot in the leaf FT to check (for subsequent
-        // leaf FTs, we need to start at 0
-        uint32_t leafSlot = (requiredPages - 1) % 512;
-        // int trunkOfs = TRUNK_FREE_TABLE_OFS + trunkSlot * 4;
-        // int trunkEnd = (trunkOfs & 0xffff'ffc0) + 64;
 
-        // We don't care about ranges that cover page counts that are less
-        // than the number of pages we require, so shift off those bits
-        trunkRanges >>= trunkSlot / 16;
+    // Find the smallest size class with a free blob large enough to
+    // accommodate the requested size
 
-        for (;;)
+    int sizeClass = freeSizes().findFirst(requiredPages - 1);
+    if (sizeClass >= 0)
+    {
+        uint32_t trunkSlot = sizeClass / 512;
+        uint32_t leafSlot = sizeClass % 512;
+        PageNum leafTableBlob = rootBlock->trunkFreeTable[trunkSlot];
+        Blob* leafBlock = getBlobBlock(leafTableBlob);
+        assert(leafBlock->isFree);
+        PageNum freeBlob = leafBlock->leafFreeTable[leafSlot];
+        assert(freeBlob != 0);
+
+        // TODO: Do not re-allocate blobs from freedBlobs_
+
+        uint32_t freePages = sizeClass + 1;
+        if (freeBlob == leafTableBlob)
         {
-            if ((trunkRanges & 1) == 0)
-            {
-                // There are no free blobs in the target range, so let's
-                // check free blobs in the next-larger range; if there
-                // aren't any, we quit
-
-                if (trunkRanges == 0) break;
+            // If the free blob is the same blob that holds
+            // the leaf free-table, check if there is another
+            // free blob of the same size
 
-                // If a range does not contain any free blobs, no need
-                // to check each of its 16 entries individually. The number
-                // of zero bits tells us how many ranges we can skip
-
-                int rangesToSkip = Bits::countTrailingZerosInNonZero(trunkRanges);
-                trunkSlotEnd += rangesToSkip * 16;
-                trunkSlot = trunkSlotEnd - 16;
-                // trunkEnd += rangesToSkip * 64;
-                // trunkOfs = trunkEnd - 64;
-
-                // for any range other than the first, we check all leaf slots
-
-                leafSlot = 0;
+            PageNum nextFreeBlob = leafBlock->nextFreeBlob;
+            if (nextFreeBlob != 0)
+            {
+                // If so, we'll use that blob instead
+                freeBlob = nextFreeBlob;
             }
-            // assert(trunkOfs < TRUNK_FREE_TABLE_OFS + FREE_TABLE_LEN);
+        }
 
-            for (; trunkSlot < trunkSlotEnd; trunkSlot++)
-            {
-                PageNum leafTableBlob = rootBlock->trunkFreeTable[trunkSlot];
-                if (leafTableBlob == 0) continue;
+        // We remove the entire blob first, and then add back the
+        // remaining part (otherwise, if this blob is the last one of its
+        // size and the remainder falls into the same leaf FT, the FT
+        // would not be moved and end up in the allocated portion)
 
-                // There are one or more free blobs within the
-                // 512-page size range indicated by trunkOfs
+        Blob* freeBlock = getBlobBlock(freeBlob);
+        assert(freeBlock->isFree);
+        assert((freeBlock->payloadSize + BLOB_HEADER_SIZE) >>
+            store()->pageSizeShift_ == freePages);
+        assert (freePages >= requiredPages);
+        removeFreeBlob(freeBlock);
 
-                Blob* leafBlock = getBlobBlock(leafTableBlob);
-                int leafRanges = leafBlock->leafFreeTableRanges;
-                uint32_t leafSlotEnd = (leafSlot & 0x1f0) + 16;
-                assert(leafBlock->isFree);
+        if (freeBlob == leafTableBlob)
+        {
+            // We need to move the freetable to another free blob
+            // (If it is no longer needed, this is a no-op;
+            // removeFreeBlob has already set the trunk slot to 0)
 
-                leafRanges >>= leafSlot / 16;
+            [[maybe_unused]] PageNum newLeafBlob = relocateFreeTable(freeBlob, freePages);
+            assert(rootBlock->trunkFreeTable[trunkSlot] == newLeafBlob);
+        }
 
-                for (; ; )
-                {
-                    if ((leafRanges & 1) == 0)
-                    {
-                        if (leafRanges == 0) break;
-                        int rangesToSkip = Bits::countTrailingZerosInNonZero(leafRanges);
-                        leafSlotEnd += rangesToSkip * 16;
-                        leafSlot = leafSlotEnd - 16;
-                    }
-                    for (; leafSlot < leafSlotEnd; leafSlot++)
-                    {
-                        PageNum freeBlob = leafBlock->leafFreeTable[leafSlot];
-                        if (freeBlob == 0) continue;
-
-                        // Found a free blob of sufficient size
-
-                        // TODO: Do not re-allocate blobs from freedBlobs_
-
-                        uint32_t freePages = trunkSlot * 512 + leafSlot + 1;
-                        if (freeBlob == leafTableBlob)
-                        {
-                            // If the free blob is the same blob that holds
-                            // the leaf free-table, check if there is another
-                            // free blob of the same size
-
-                            // log.debug("    Candidate free blob {} holds leaf FT", freeBlob);
-
-                            PageNum nextFreeBlob = leafBlock->nextFreeBlob;
-                            if (nextFreeBlob != 0)
-                            {
-                                // If so, we'll use that blob instead
-
-                                // log.debug("    Using next free blob at {}", nextFreeBlob);
-                                freeBlob = nextFreeBlob;
-                            }
-                        }
-
-                        // TODO!!!!!
-                        // TODO: bug: we need to relocate ft after we
-                        //  add the remaining part
-                        //  free blob is last of size, remaining is in same leaf FT
-                        //  won't move the FT, FT ends up in allocated portion
-                        //  OR: remove entire blob first,then add remaining?
-                        //  Solution: reverse sequence: remove whole blob first,
-                        //  then add back the remaining part
-
-                        Blob* freeBlock = getBlobBlock(freeBlob);
-                        assert(freeBlock->isFree);
-                        uint32_t freeBlobPayloadSize = freeBlock->payloadSize;
-                        assert((freeBlobPayloadSize + BLOB_HEADER_SIZE) >> 
-                            store()->pageSizeShift_ == freePages);
-                        assert (freePages >= requiredPages);
-                        removeFreeBlob(freeBlock);
-
-                        if (freeBlob == leafTableBlob)
-                        {
-                            // We need to move the freetable to another free blob
-                            // (If it is no longer needed, this is a no-op;
-                            // removeFreeBlob has already set the trunk slot to 0)
-                            // TODO: consolidate with removeFreeBlob?
-                            //  We only separate this step because in freeBlob
-                            //  we are potentially removing preceding/following
-                            //  blob of same size range, which means we'd have
-                            //  to move FT twice
-
-                            PageNum newLeafBlob = relocateFreeTable(freeBlob, freePages);
-                            if (newLeafBlob != 0)
-                            {
-                                // log.debug("    Moved leaf FT to {}", newLeafBlob);
-                                assert (rootBlock->trunkFreeTable[trunkSlot] == newLeafBlob);
-                            }
-                            else
-                            {
-                                // log.debug("    Leaf FT no longer needed");
-                                assert (rootBlock->trunkFreeTable[trunkSlot] == 0);
-                            }
-                        }
-
-                        if (freePages > requiredPages)
-                        {
-                            // If the free blob is larger than needed, mark the
-                            // remainder as free and add it to its respective free list;
-                            // we always do this before we remove the reused blob, since
-                            // we may needlessly remove and reallocate the free table
-                            // if the reused is the last blob in the table, but the
-                            // remainder is in the same 512-page range
-
-                            // We won't need to touch the preceding-free flag of the
-                            // successor blob, since it is already set
-
-                            addFreeBlob(freeBlob + requiredPages, freePages - requiredPages, 0);
-                        }
-                        Blob* nextBlock = getBlobBlock(freeBlob + freePages);
-                        nextBlock->precedingFreeBlobPages = freePages - requiredPages;
-
-                        freeBlock->isFree = false;
-                        freeBlock->payloadSize = payloadSize;
-                        // debugCheckRootFT();
-                        return freeBlob;
-                    }
-                    leafRanges >>= 1;
-                    leafSlotEnd += 16;
-                }
-                leafSlot = 0;
-            }
+        if (freePages > requiredPages)
+        {
+            // If the free blob is larger than needed, mark the
+            // remainder as free and add it to its respective free list
 
-            // Check the next range
+            // We won't need to touch the preceding-free flag of the
+            // successor blob, since it is already set
 
-            trunkRanges >>= 1;
-            trunkSlotEnd += 16;
+            addFreeBlob(freeBlob + requiredPages, freePages - requiredPages, 0);
         }
+        Blob* nextBlock = getBlobBlock(freeBlob + freePages);
+        nextBlock->precedingFreeBlobPages = freePages - requiredPages;
+
+        freeBlock->isFree = false;
+        freeBlock->payloadSize = payloadSize;
+        return freeBlob;
     }
 
     // If we weren't able to find a suitable free blob,
@@ -305,6 +203,7 @@ void BlobStore::Transaction::removeFreeBlob(Blob* freeBlock)
     int pages = (payloadSize + BLOB_HEADER_SIZE) >> store()->pageSizeShift_;
     int trunkSlot = (pages - 1) / 512;
     int leafSlot = (pages - 1) % 512;
+    FreeSizeMap& freeSizes = this->freeSizes();
 
     // log.debug("     Removing blob with {} pages", pages);
 
@@ -325,18 +224,13 @@ void BlobStore::Transaction::removeFreeBlob(Blob* freeBlock)
     Blob* leafBlock = getBlobBlock(leafBlob);
     leafBlock->leafFreeTable[leafSlot] = nextBlob;
     if (nextBlob != 0) return;
+    freeSizes.clear(pages - 1);
 
     // Check if there are any other free blobs in the same size range
 
     uint32_t leafRange = leafSlot / 16;
     assert (leafRange >= 0 && leafRange < 32);
-
-    uint32_t startLeafSlot = leafRange * 16;
-    uint32_t endLeafSlot = startLeafSlot + 16;
-    for (uint32_t slot = startLeafSlot; slot<endLeafSlot; slot++)
-    {
-        if (leafBlock->leafFreeTable[slot] != 0) return;
-    }
+    if (freeSizes.hasLeafRange(trunkSlot, leafRange)) return;
 
     // The range has no free blobs, clear its range bit
 
@@ -352,12 +246,7 @@ void BlobStore::Transaction::removeFreeBlob(Blob* freeBlock)
 
     uint32_t trunkRange = trunkSlot / 16;
     assert (trunkRange >= 0 && trunkRange < 32);
-    uint32_t startTrunkSlot = trunkRange * 16;
-    uint32_t endTrunkSlot = startTrunkSlot + 16;
-    for (uint32_t slot = startTrunkSlot; slot < endTrunkSlot; slot++)
-    {
-        if (rootBlock->trunkFreeTable[slot] != 0) return;
-    }
+    if (freeSizes.hasTrunkRange(trunkRange)) return;
 
     // The trunk range has no leaf tables, clear its range bit
     rootBlock->trunkFreeTableRanges &= ~(1 << trunkRange);
@@ -423,6 +312,7 @@ void BlobStore::Transaction::addFreeBlob(PageNum firstPage, uint32_t pages, uint
 
     leafBlock->leafFreeTable[leafSlot] = firstPage;
     leafBlock->leafFreeTableRanges |= 1 << (leafSlot / 16);
+    freeSizes().set(pages - 1);
 }
 
 
@@ -588,45 +478,94 @@ void BlobStore::Transaction::free(PageNum firstPage)
 BlobStore::PageNum BlobStore::Transaction::relocateFreeTable(PageNum page, int sizeInPages)
 {
     Blob* block = getBlobBlock(page);
-    uint32_t ranges = block->leafFreeTableRanges;
-    // Make a copy of ranges, because we will modify it during search
-    uint32_t originalRanges = ranges;
-    uint32_t slot = 0;
-    while (ranges != 0)
+    FreeSizeMap& freeSizes = this->freeSizes();
+    uint32_t trunkSlot = (sizeInPages - 1) / 512;
+    int endSizeClass = static_cast<int>((trunkSlot + 1) * 512);
+    int sizeClass = freeSizes.findFirst(trunkSlot * 512);
+    while (sizeClass >= 0 && sizeClass < endSizeClass)
     {
-        if ((ranges & 1) != 0)
+        PageNum otherPage = block->leafFreeTable[sizeClass % 512];
+        assert(otherPage != 0);
+        if (otherPage != page)
         {
-            uint32_t endSlot = slot + 16;
-            for (; slot < endSlot; slot++)
+            Blob* otherBlock = getBlobBlock(otherPage);
+            assert(otherBlock->isFree);
+
+            memcpy(otherBlock->leafFreeTable, block->leafFreeTable, sizeof(block->leafFreeTable));
+            otherBlock->leafFreeTableRanges = block->leafFreeTableRanges;
+            HeaderBlock* rootBlock = getRootBlock();
+            rootBlock->trunkFreeTable[trunkSlot] = otherPage;
+
+            // log.debug("      Moved free table from {} to {}", page, otherPage);
+            return otherPage;
+        }
+        sizeClass = freeSizes.findFirst(sizeClass + 1);
+    }
+    return 0;
+}
+
+
+/// Populates the summary of non-empty size classes from the
+/// free-tables, as they appear to this transaction. Only reads
+/// the tables, so it doesn't cause any blocks to be journaled.
+///
+void BlobStore::Transaction::buildFreeSizes()
+{
+    freeSizes_ = std::make_unique<FreeSizeMap>();
+    const HeaderBlock* rootBlock = reinterpret_cast<const HeaderBlock*>(
+        getConstBlock(0));
+    uint32_t trunkRanges = rootBlock->trunkFreeTableRanges;
+    while (trunkRanges)
+    {
+        uint32_t trunkRange = Bits::countTrailingZerosInNonZero(trunkRanges);
+        trunkRanges &= trunkRanges - 1;
+        for (uint32_t trunkSlot = trunkRange * 16; trunkSlot < trunkRange * 16 + 16; trunkSlot++)
+        {
+            PageNum leafTableBlob = rootBlock->trunkFreeTable[trunkSlot];
+            if (leafTableBlob == 0) continue;
+            const Blob* leafBlock = getConstBlobBlock(leafTableBlob);
+            uint32_t leafRanges = leafBlock->leafFreeTableRanges;
+            while (leafRanges)
             {
-                PageNum otherPage = block->leafFreeTable[slot];
-                if (otherPage != 0 && otherPage != page)
+                uint32_t leafRange = Bits::countTrailingZerosInNonZero(leafRanges);
+                leafRanges &= leafRanges - 1;
+                for (uint32_t leafSlot = leafRange * 16; leafSlot < leafRange * 16 + 16; leafSlot++)
                 {
-                    Blob* otherBlock = getBlobBlock(otherPage);
-                    assert(otherBlock->isFree);
-
-                    memcpy(otherBlock->leafFreeTable, block->leafFreeTable, sizeof(block->leafFreeTable));
-                    otherBlock->leafFreeTableRanges = originalRanges;
-                    // don't use `ranges`; search consumes the bits
-                    HeaderBlock* rootBlock = getRootBlock();
-                    uint32_t trunkSlot = (sizeInPages - 1) / 512;
-                    rootBlock->trunkFreeTable[trunkSlot] = otherPage;
-
-                    // log.debug("      Moved free table from {} to {}", page, otherPage);
-                    return otherPage;
+                    if (leafBlock->leafFreeTable[leafSlot] != 0)
+                    {
+                        freeSizes_->set(trunkSlot * 512 + leafSlot);
+                    }
                 }
             }
-            slot = endSlot;
-            ranges >>= 1;
         }
-        else
+    }
+}
+
+
+int BlobStore::FreeSizeMap::findFirst(uint32_t sizeClass) const
+{
+    if (sizeClass >= SIZE_CLASSES) return -1;
+    uint32_t word = sizeClass >> 6;
+    uint64_t bits = bits_[word] & (~0ULL << (sizeClass & 63));
+    if (bits == 0)
+    {
+        // Look for the next non-empty word in the same group of 64
+        uint32_t group = word >> 6;
+        uint32_t nextWord = (word & 63) + 1;
+        uint64_t words = nextWord < 64 ? (middle_[group] & (~0ULL << nextWord)) : 0;
+        if (words == 0)
         {
-            int rangesToSkip = Bits::countTrailingZerosInNonZero(ranges);
-            ranges >>= rangesToSkip;
-            slot += rangesToSkip * 16;
+            // Look for the next non-empty group
+            uint32_t nextGroup = group + 1;
+            uint64_t groups = nextGroup < 64 ? (top_ & (~0ULL << nextGroup)) : 0;
+            if (groups == 0) return -1;
+            group = Bits::countTrailingZerosInNonZero(groups);
+            words = middle_[group];
         }
+        word = (group << 6) + Bits::countTrailingZerosInNonZero(words);
+        bits = bits_[word];
     }
-    return 0;
+    return static_cast<int>((word << 6) + Bits::countTrailingZerosInNonZero(bits));
 }
 
 
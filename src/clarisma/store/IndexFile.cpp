@@ -2,10 +2,33 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <clarisma/store/IndexFile.h>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+#include <vector>
 #include <clarisma/util/pointer.h>
 
 namespace clarisma {
 
+uint32_t IndexFile::getInBlock(const byte* block, uint32_t slot) const
+{
+	SlotPosition pos(slot, bits_);
+	pointer p(block + pos.byteOffset);
+	return (p.getUnalignedUnsignedInt() >> pos.bitShift) & mask_;
+}
+
+void IndexFile::putInBlock(byte* block, uint32_t slot, uint32_t value) const
+{
+	assert((value & mask_) == value);	// value must fit in range
+	SlotPosition pos(slot, bits_);
+	byte* pRaw = block + pos.byteOffset;
+	pointer p(pRaw);
+	uint32_t oldValue = p.getUnalignedUnsignedInt();
+	// TOOD: make this safe for architectures that don't allow unaligned writes
+	*reinterpret_cast<uint32_t*>(pRaw) =
+		(oldValue & ~(mask_ << pos.bitShift)) | (value << pos.bitShift);
+}
+
 uint32_t IndexFile::get(uint64_t key)
 {
 	assert(isOpen());
@@ -14,56 +37,119 @@ uint32_t IndexFile::get(uint64_t key)
 	uint64_t block = key / slotsPerBlock_;
 	// The slot within the block
 	uint32_t slot = static_cast<uint32_t>(key % slotsPerBlock_);
-	// The byte within the block where the value starts
-	uint32_t byteOffset = slot * bits_ / 8;
-	// The bit within the first byte where the value starts
-	uint32_t bitShift = slot * bits_ - byteOffset * 8;
-	// Since we always read a full uint32_t even though the value takes up
-	// fewer bits, we may run into a situation where we read bytes beyond 
-	// the block, which may result in a segfault; to avoid this, we start 
-	// reading at the offset that is <overrun> bytes earlier, and right-shift 
-	// the value by 8 * <overrun> bits to compensate
-	uint32_t overrun = std::max(
-		static_cast<int32_t>(byteOffset) - 
-		static_cast<int32_t>(BLOCK_SIZE - 4), 0);
-	assert(overrun <= 3);
-	byteOffset -= overrun;
-	bitShift += overrun * 8;
-	pointer p(translate(block * BLOCK_SIZE + byteOffset));
-	return (p.getUnalignedUnsignedInt() >> bitShift) & mask_;
+	return getInBlock(translate(block * BLOCK_SIZE), slot);
 }
 
 void IndexFile::put(uint64_t key, uint32_t value)
 {
 	assert(isOpen());
 	assert(bits_);		// Index width must have been set
-	assert((value & mask_) == value);	// value must fit in range
 	// The block where the value is located
 	uint64_t block = key / slotsPerBlock_;
 	// The slot within the block
 	uint32_t slot = static_cast<uint32_t>(key % slotsPerBlock_);
-	// The byte within the block where the value starts
-	uint32_t byteOffset = slot * bits_ / 8;
-	// The bit within the first byte where the value starts
-	uint32_t bitShift = slot * bits_ - byteOffset * 8;
-	// See above -- start reading earlier if the memory access would 
-	// otherwise exceed the block length (potential segfault!), and 
-	// shift the value to compensate
-	uint32_t overrun = std::max(
-		static_cast<int32_t>(byteOffset) -
-		static_cast<int32_t>(BLOCK_SIZE - 4), 0);
-	assert(overrun <= 3);
-	byteOffset -= overrun;
-	bitShift += overrun * 8;
-	void* pRaw = translate(block * BLOCK_SIZE + byteOffset);
-
-	// printf("Putting %llu=%d at %p...\n", key, value, pRaw);
+	// printf("Putting %llu=%d...\n", key, value);
+	putInBlock(translate(block * BLOCK_SIZE), slot, value);
+}
 
-	pointer p(pRaw);
-	uint32_t oldValue = p.getUnalignedUnsignedInt();
-	// TOOD: make this safe for architectures that don't allow unaligned writes
-	*reinterpret_cast<uint32_t*>(pRaw) = 
-		(oldValue & ~(mask_ << bitShift)) | (value << bitShift);
+
+void IndexFile::putSorted(std::span<const Entry> entries)
+{
+	size_t i = 0;
+	while (i < entries.size())
+	{
+		uint64_t block = entries[i].first / slotsPerBlock_;
+		uint64_t blockStart = block * slotsPerBlock_;
+		uint64_t blockEnd = blockStart + slotsPerBlock_;
+		byte* p = translate(block * BLOCK_SIZE);
+		do
+		{
+			putInBlock(p, static_cast<uint32_t>(entries[i].first - blockStart),
+				entries[i].second);
+			i++;
+		}
+		while (i < entries.size() && entries[i].first < blockEnd);
+	}
+}
+
+
+void IndexFile::putAll(std::span<Entry> entries, int threads)
+{
+	assert(isOpen());
+	assert(bits_);		// Index width must have been set
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) { return a.first < b.first; });
+
+	// Not worth starting threads for fewer than a few blocks per thread
+	size_t maxThreads = entries.size() / slotsPerBlock_ + 1;
+	threads = static_cast<int>(std::min(static_cast<size_t>(std::max(threads, 1)), maxThreads));
+	if (threads == 1)
+	{
+		putSorted(entries);
+		return;
+	}
+
+	// Divide the entries into shards of roughly equal size, and move
+	// each boundary forward so that no block is shared by two shards
+	std::vector<size_t> bounds;
+	bounds.push_back(0);
+	for (int t = 1; t < threads; t++)
+	{
+		size_t n = std::max(entries.size() * t / threads, bounds.back());
+		if (n < entries.size() && n > 0)
+		{
+			uint64_t block = entries[n - 1].first / slotsPerBlock_;
+			while (n < entries.size() && entries[n].first / slotsPerBlock_ == block) n++;
+		}
+		bounds.push_back(n);
+	}
+	bounds.push_back(entries.size());
+
+	std::vector<std::thread> workers;
+	for (int t = 1; t < threads; t++)
+	{
+		workers.emplace_back([this, entries, &bounds, t]()
+		{
+			putSorted(entries.subspan(bounds[t], bounds[t + 1] - bounds[t]));
+		});
+	}
+	putSorted(entries.subspan(0, bounds[1]));
+	for (std::thread& worker : workers) worker.join();
+}
+
+
+void IndexFile::getAll(std::span<const uint64_t> keys, std::span<uint32_t> values)
+{
+	assert(isOpen());
+	assert(bits_);		// Index width must have been set
+	assert(keys.size() == values.size());
+
+	// Visit the keys in ascending order (unless they already are)
+	std::vector<uint32_t> order;
+	bool sorted = std::is_sorted(keys.begin(), keys.end());
+	if (!sorted)
+	{
+		assert(keys.size() <= UINT32_MAX);
+		order.resize(keys.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(),
+			[keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+	}
+
+	uint64_t currentBlock = UINT64_MAX;
+	const byte* p = nullptr;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		size_t n = sorted ? i : order[i];
+		uint64_t key = keys[n];
+		uint64_t block = key / slotsPerBlock_;
+		if (block != currentBlock)
+		{
+			currentBlock = block;
+			p = translate(block * BLOCK_SIZE);
+		}
+		values[n] = getInBlock(p, static_cast<uint32_t>(key - block * slotsPerBlock_));
+	}
 }
 
 } // namespace clarisma
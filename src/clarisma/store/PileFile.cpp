@@ -3,6 +3,8 @@
 
 #include <clarisma/store/PileFile.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <clarisma/util/Bits.h>
 #include <clarisma/util/Bytes.h>
@@ -22,7 +24,7 @@ void PileFile::openExisting(const char* fileName)
 	// Open mode is implicitly sparse
 	Metadata* meta = metadata();
 	pageSizeShift_ = meta->pageSizeShift;
-	pageSize_ = pageSizeShift_;
+	pageSize_ = 1 << pageSizeShift_;
 }
 
 
@@ -202,15 +204,49 @@ void PileFile::load(int pile, ReusableBlock& block)
 }
 
 
+void PileFile::loadAll(const std::function<void(int pile, ReusableBlock& block)>& consumer)
+{
+	ReusableBlock block;
+	int pileCount = static_cast<int>(metadata()->pileCount);
+	prefetchPile(1);
+	for (int pile = 1; pile <= pileCount; pile++)
+	{
+		// Let the OS read the next pile while this one is consumed
+		if (pile < pileCount) prefetchPile(pile + 1);
+		if (metadata()->index[pile - 1].lastPage == 0) continue;
+		load(pile, block);
+		consumer(pile, block);
+	}
+}
+
+
+void PileFile::prefetchPile(int pile)
+{
+	const IndexEntry* indexEntry = &metadata()->index[pile - 1];
+	uint32_t page = indexEntry->firstPage;
+	uint32_t lastPage = indexEntry->lastPage;
+	if (lastPage == 0) return;
+	for (;;)
+	{
+		Chunk* chunk = getChunk(page);
+		if (page == lastPage)
+		{
+			file_.prefetch(chunk, CHUNK_HEADER_SIZE +
+				chunk->payloadSize - chunk->remainingSize);
+			break;
+		}
+		file_.prefetch(chunk, CHUNK_HEADER_SIZE + chunk->payloadSize);
+		page = chunk->nextPage;
+	}
+}
+
+
 PileFile::ChunkAllocation PileFile::allocChunk(uint32_t minPayload)
 {
 	assert(minPayload > 0);
-	uint32_t firstPage = metadata()->pageCount;
-	uint32_t pages =
-		static_cast<uint32_t>(
-			(minPayload + pageSize_ - CHUNK_HEADER_SIZE - 1)
-			/ (pageSize_ - CHUNK_HEADER_SIZE));
-	metadata()->pageCount = firstPage + pages;
+	uint32_t pages = static_cast<uint32_t>(
+		(minPayload + CHUNK_HEADER_SIZE + pageSize_ - 1) >> pageSizeShift_);
+	uint32_t firstPage = allocPages(pages);
 	// Console::msg("Allocated %d pages", pages);
 	Chunk* chunk = getChunk(firstPage);
 	chunk->payloadSize = static_cast<uint32_t>(pages << pageSizeShift_) - CHUNK_HEADER_SIZE;
@@ -218,6 +254,116 @@ PileFile::ChunkAllocation PileFile::allocChunk(uint32_t minPayload)
 	return ChunkAllocation{ chunk, firstPage };
 }
 
+/// Allocates a run of pages, which never straddles a 1-GB segment
+/// (since ExpandableMappedFile may map segments at different
+/// addresses). Safe to call from multiple threads.
+///
+uint32_t PileFile::allocPages(uint32_t pages)
+{
+	uint32_t pagesPerSegment = static_cast<uint32_t>(
+		ExpandableMappedFile::SEGMENT_LENGTH >> pageSizeShift_);
+	assert(pages <= pagesPerSegment);
+	std::atomic_ref<uint32_t> pageCount(metadata()->pageCount);
+	uint32_t current = pageCount.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		uint32_t firstPage = current;
+		uint32_t segmentEnd = (firstPage / pagesPerSegment + 1) * pagesPerSegment;
+		if (firstPage + pages > segmentEnd) firstPage = segmentEnd;
+		if (pageCount.compare_exchange_weak(current, firstPage + pages,
+			std::memory_order_relaxed))
+		{
+			return firstPage;
+		}
+	}
+}
+
+
+/// Appends a chunk whose first `len` bytes have been written to the
+/// given pile. If the last chunk of the pile isn't full (because of an
+/// earlier partial flush), it is filled first; all chunks other than
+/// the last must be full.
+///
+void PileFile::linkChunk(int pile, uint32_t page, uint32_t len)
+{
+	std::lock_guard lock(linkLocks_[pile % LINK_LOCK_COUNT]);
+	IndexEntry* indexEntry = &metadata()->index[pile - 1];
+	Chunk* chunk = getChunk(page);
+	if (indexEntry->lastPage == 0)
+	{
+		if (indexEntry->firstPage == 0)
+		{
+			indexEntry->firstPage = page;
+			indexEntry->lastPage = page;
+			chunk->remainingSize = chunk->payloadSize - len;
+			indexEntry->totalPayloadSize = len;
+			return;
+		}
+		// Pre-allocated chunk (see preallocate()), which we
+		// initialize and fill below
+		Chunk* first = getChunk(indexEntry->firstPage);
+		uint32_t chunkSize = static_cast<uint32_t>(indexEntry->totalPayloadSize);
+		first->payloadSize = chunkSize;
+		first->remainingSize = chunkSize;
+		indexEntry->totalPayloadSize = 0;
+		indexEntry->lastPage = indexEntry->firstPage;
+	}
+
+	Chunk* last = getChunk(indexEntry->lastPage);
+	uint32_t n = std::min(len, last->remainingSize);
+	if (n > 0)
+	{
+		memcpy(&last->data[last->payloadSize - last->remainingSize], chunk->data, n);
+		last->remainingSize -= n;
+		memmove(chunk->data, &chunk->data[n], len - n);
+	}
+	indexEntry->totalPayloadSize += len;
+	len -= n;
+	if (len == 0) return;		// the new chunk stays unused
+	assert(last->remainingSize == 0);
+	last->nextPage = page;
+	indexEntry->lastPage = page;
+	chunk->remainingSize = chunk->payloadSize - len;
+}
+
+
+void PileFile::Writer::append(int pile, const uint8_t* data, uint32_t len)
+{
+	assert (pile > 0 && pile <= file_.metadata()->pileCount);
+	Buffer& buf = buffers_[pile];
+	uint32_t capacity = (buf.chunkPages << file_.pageSizeShift_) -
+		CHUNK_HEADER_SIZE;
+	// An append is never split across flushes (data that doesn't fit
+	// into a single chunk gets a larger chunk of its own), since the
+	// chunks of other Writers could otherwise end up in its middle
+	if (buf.data.size() + len > capacity) flush(pile, buf);
+	buf.data.insert(buf.data.end(), data, data + len);
+	if (buf.data.size() >= capacity) flush(pile, buf);
+}
+
+
+void PileFile::Writer::flush(int pile, Buffer& buf)
+{
+	if (buf.data.empty()) return;
+	uint32_t len = static_cast<uint32_t>(buf.data.size());
+	ChunkAllocation alloc = file_.allocChunk(len);
+	memcpy(alloc.chunk->data, buf.data.data(), len);
+	file_.linkChunk(pile, alloc.firstPage, len);
+	buf.data.clear();
+	buf.chunkPages = std::min(buf.chunkPages * 2, maxChunkPages_);
+}
+
+
+void PileFile::Writer::flush()
+{
+	for (auto& [pile, buf] : buffers_)
+	{
+		flush(pile, buf);
+	}
+	buffers_.clear();
+}
+
+
 PileFile::Chunk* PileFile::getChunk(uint32_t page)
 {
 	return reinterpret_cast<Chunk*>(file_.translate(
@@ -6,6 +6,7 @@
 #include <clarisma/util/log.h>
 #include <clarisma/util/Crc32.h>
 #include <clarisma/util/pointer.h>
+#include <algorithm>
 #include <cassert>
 #include <filesystem>
 
@@ -308,48 +309,55 @@ const byte* Store::Transaction::getConstBlock(uint64_t pos)
 
 void Store::Transaction::commit()
 {
-    // TODO
+    if (++pendingCommits_ < groupSize_) return;
+    flush();
+}
+
+
+void Store::Transaction::flush()
+{
+    pendingCommits_ = 0;
+    uint64_t newStoreSize = store_->getTrueSize();
+    if (blocks_.empty() && newStoreSize == preCommitStoreSize_) return;
+
+    // We process the blocks in the order of their file offsets, so the
+    // journal and the syncing of the store touch the disk sequentially
+    SortedBlocks blocks(blocks_.begin(), blocks_.end());
+    std::sort(blocks.begin(), blocks.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
 
     // Save the rollback instructions and make sure the journal file
     // is safely written to disk
-    saveJournal();
-
-    // TODO: order matters! Possible race condition where index blocks
-    //  are written before tile contents -- make sure to write blocks
-    //  that are part of metadata *last*
+    saveJournal(blocks);
 
-    uint32_t dirtyMappings = 0;
-    for (const auto& it : blocks_)
+    // We apply the changes in descending order of their offsets: the
+    // metadata of a store (such as the Tile Index of a FeatureStore)
+    // lies at the start of its file, so other processes won't see a
+    // pointer to data that hasn't been written yet
+    for (auto it = blocks.rbegin(); it != blocks.rend(); ++it)
     {
-        uint64_t ofs = it.first;
-        TransactionBlock* block = it.second;
+        TransactionBlock* block = it->second;
         memcpy(block->original(), block->current(), TransactionBlock::SIZE);
-        dirtyMappings |= 1 << store_->mappingNumber(ofs);
     }
 
-    // Blocks that are appended to the file during the transaction are
-    // not journaled (they are simply truncated in case of a rollback);
-    // nevertheless, we need to record their segments as well, so we
-    // can force them to be written to disk
-
-    uint64_t newStoreSize = store_->getTrueSize();
-    if (newStoreSize > preCommitStoreSize_)
+    // Sync the modified blocks (adjacent blocks as a single range), as
+    // well as the blocks that were appended to the file during the
+    // transaction (they are not journaled, since they are simply
+    // truncated in case of a rollback)
+    size_t i = 0;
+    while (i < blocks.size())
     {
-        int start = store_->mappingNumber(preCommitStoreSize_);
-        int end = store_->mappingNumber(newStoreSize-1);
-        for (int n = start; n <= end; n++)
+        uint64_t start = blocks[i].first;
+        uint64_t end = start + TransactionBlock::SIZE;
+        for (i++; i < blocks.size() && blocks[i].first == end; i++)
         {
-            dirtyMappings |= 1 << n;
+            end += TransactionBlock::SIZE;
         }
+        syncRange(start, end);
     }
-
-    // Ensure that the modified mappings are written to disk
-    BitIterator<uint32_t> iter(dirtyMappings);
-    for (;;)
+    if (newStoreSize > preCommitStoreSize_)
     {
-        int n = iter.next();
-        if (n < 0) break;
-        store_->sync(store_->mapping(n), store_->mappingSize(n));
+        syncRange(preCommitStoreSize_, newStoreSize);
     }
     
     clearJournal();
@@ -358,20 +366,41 @@ void Store::Transaction::commit()
 }
 
 
-void Store::Transaction::saveJournal()
+/// Syncs the given range of the store, which may span multiple
+/// segments (each of which may live in a different mapping)
+void Store::Transaction::syncRange(uint64_t start, uint64_t end)
+{
+    while (start < end)
+    {
+        uint64_t segmentEnd = (start & ~SEGMENT_LENGTH_MASK) + SEGMENT_LENGTH;
+        uint64_t len = std::min(end, segmentEnd) - start;
+        store_->sync(store_->translate(start), len, store_->invalidateOnSync_);
+        start += len;
+    }
+}
+
+
+void Store::Transaction::saveJournal(const SortedBlocks& blocks)
 {
     if (!journalFile_.isOpen())
     {
         journalFile_.open(store_->getJournalFileName().c_str(),
             File::OpenMode::READ | File::OpenMode::WRITE | File::OpenMode::CREATE);
     }
-    journalFile_.seek(0);
+
+    // We assemble the journal in memory, so it takes a single write
+    std::vector<uint8_t> journal;
+    auto append = [&journal](const void* p, size_t len)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(p);
+        journal.insert(journal.end(), bytes, bytes + len);
+    };
     uint32_t command = 1;
-    journalFile_.write(&command, 4);
+    append(&command, 4);
     uint64_t timestamp = store_->getLocalCreationTimestamp();
-    journalFile_.write(&timestamp, 8);
+    append(&timestamp, 8);
     Crc32 crc;  // Initialize the CRC
-    for (const auto& it: blocks_)
+    for (const auto& it: blocks)
     {
         uint64_t baseWordAddress = it.first / 4;
         TransactionBlock* block = it.second;
@@ -391,8 +420,8 @@ void Store::Transaction::saveJournal()
                 }
                 int patchLen = n - start;
                 uint64_t patch = ((baseWordAddress + start) << 10) | (patchLen - 1);
-                journalFile_.write(&patch, 8);
-                journalFile_.write(&original[start], patchLen * 4);
+                append(&patch, 8);
+                append(&original[start], patchLen * 4);
                 crc.update(&patch, 8);
                 crc.update(&original[start], patchLen * 4);
             }
@@ -400,10 +429,12 @@ void Store::Transaction::saveJournal()
         }
     }
     uint64_t trailer = JOURNAL_END_MARKER;
-    journalFile_.write(&trailer, 8);
+    append(&trailer, 8);
     uint32_t checksum = crc.get();
-    journalFile_.write(&checksum, 4);
-    journalFile_.force();
+    append(&checksum, 4);
+    journalFile_.seek(0);
+    journalFile_.write(journal.data(), journal.size());
+    journalFile_.forceData();
 }
 
 
@@ -413,7 +444,7 @@ void Store::Transaction::clearJournal()
     uint32_t command = 0;
     journalFile_.write(&command, 4);
     journalFile_.setSize(4);   // TODO: just trim to 0 instead?
-    journalFile_.force();
+    journalFile_.forceData();
 }
 
 } // namespace clarisma
@@ -5,9 +5,13 @@
 #include <clarisma/util/BitIterator.h>
 #include <clarisma/util/log.h>
 #include <clarisma/util/Crc32.h>
+#include <clarisma/util/Crc32C.h>
 #include <clarisma/util/DataPtr.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <filesystem>
+#include <memory>
 
 namespace clarisma::v2 {
 
@@ -232,19 +236,33 @@ bool Store::Journal::isValid(DateTime storeCreationTimestamp)
 
     // TODO: Here, we assume Little-Endian byte order, which differs from Java
 
+    uint32_t instruction;
     uint64_t timestamp;
-    seek(4);
+    seek(0);
+    read(&instruction, 4);
     read(&timestamp, 8);
     if (timestamp != storeCreationTimestamp) return false;
 
-    Crc32 crc;  // Initialize the CRC
-    uint32_t patchWordsRemaining = (journalSize - 24) / 4;
-    while (patchWordsRemaining)
+    // Journals written by older versions use CRC-32
+    Crc32 crc;
+    Crc32C crcC;
+    bool isCrc32C = instruction == JOURNAL_PATCHES_CRC32C;
+    std::unique_ptr<byte[]> buf(new byte[JOURNAL_READ_BUFFER_SIZE]);
+    uint64_t bytesRemaining = journalSize - 24;
+    while (bytesRemaining)
     {
-        uint32_t patchWord;
-        read(&patchWord, 4);
-        crc.update(&patchWord, 4);
-        patchWordsRemaining--;
+        size_t chunkSize = static_cast<size_t>(
+            std::min<uint64_t>(bytesRemaining, JOURNAL_READ_BUFFER_SIZE));
+        read(buf.get(), chunkSize);
+        if (isCrc32C)
+        {
+            crcC.update(buf.get(), chunkSize);
+        }
+        else
+        {
+            crc.update(buf.get(), chunkSize);
+        }
+        bytesRemaining -= chunkSize;
     }
 
     uint64_t endMarker;
@@ -253,7 +271,7 @@ bool Store::Journal::isValid(DateTime storeCreationTimestamp)
 
     uint32_t journalCrc;
     read(&journalCrc, 4);
-    return journalCrc == crc.get();
+    return journalCrc == (isCrc32C ? crcC.get() : crc.get());
 }
 
 /*
@@ -423,18 +441,40 @@ void Store::Transaction::commit()
     // is safely written to disk
     store_->journal_.save(store_->getLocalCreationTimestamp(), blocks_);
 
-    // TODO: order matters! Possible race condition where index blocks
-    //  are written before tile contents -- make sure to write blocks
-    //  that are part of metadata *last*
+    // Order matters: Readers may be active while we commit, so we
+    // write the regular blocks first, and only then publish the changes
+    // to metadata (e.g. the tile index entries that point to newly
+    // written tiles). Metadata is written a word at a time with release
+    // semantics, so a reader that loads a pointer with acquire semantics
+    // also sees the data it points to (and never a torn value)
 
+    uint64_t metadataSize = store_->getMetadataSize();
     uint32_t dirtyMappings = 0;
     for (const auto& it : blocks_)
     {
         uint64_t ofs = it.first;
+        if (ofs < metadataSize) continue;
         JournaledBlock* block = it.second.get();
         memcpy(block->original(), block->current(), JournaledBlock::SIZE);
         dirtyMappings |= 1 << store_->mappingNumber(ofs);
     }
+    for (const auto& it : blocks_)
+    {
+        uint64_t ofs = it.first;
+        if (ofs >= metadataSize) continue;
+        JournaledBlock* block = it.second.get();
+        uint32_t* original = reinterpret_cast<uint32_t*>(block->original());
+        const uint32_t* current = reinterpret_cast<const uint32_t*>(block->current());
+        for (int i = 0; i < JournaledBlock::SIZE / 4; i++)
+        {
+            std::atomic_ref<uint32_t> word(original[i]);
+            if (word.load(std::memory_order_relaxed) != current[i])
+            {
+                word.store(current[i], std::memory_order_release);
+            }
+        }
+        dirtyMappings |= 1 << store_->mappingNumber(ofs);
+    }
 
     // Blocks that are appended to the file during the transaction are
     // not journaled (they are simply truncated in case of a rollback);
@@ -474,11 +514,11 @@ void Store::Journal::save(DateTime timestamp, const JournaledBlocks& blocks)
         open(File::OpenMode::READ | File::OpenMode::WRITE | File::OpenMode::CREATE);
     }
     seek(0);
-    uint32_t command = 1;
+    uint32_t command = JOURNAL_PATCHES_CRC32C;
     write(&command, 4);
     int64_t ts = timestamp;
     write(&ts, 8);
-    Crc32 crc;  // Initialize the CRC
+    Crc32C crc;  // Initialize the CRC
     for (const auto& it: blocks)
     {
         uint64_t baseWordAddress = it.first / 4;
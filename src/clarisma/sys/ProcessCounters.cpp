@@ -0,0 +1,46 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/sys/ProcessCounters.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace clarisma {
+
+ProcessCounters ProcessCounters::current() noexcept
+{
+	ProcessCounters counters;
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+	{
+		auto seconds = [](FILETIME t)
+		{
+			return ((static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 1e7;
+		};
+		counters.cpuSeconds = seconds(kernel) + seconds(user);
+	}
+	PROCESS_MEMORY_COUNTERS memory;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+	{
+		counters.minorFaults = memory.PageFaultCount;
+	}
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+	{
+		counters.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+			(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+		counters.majorFaults = usage.ru_majflt;
+		counters.minorFaults = usage.ru_minflt;
+	}
+#endif
+	return counters;
+}
+
+} // namespace clarisma
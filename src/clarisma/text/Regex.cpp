@@ -0,0 +1,662 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/text/Regex.h>
+#include <algorithm>
+#include <cassert>
+#include <map>
+
+namespace clarisma {
+
+/// Parses a pattern into a syntax tree, which is then turned into a
+/// Thompson NFA. Throws Unsupported for anything the automaton can't
+/// handle (including syntax errors, which std::regex then reports).
+///
+class Regex::Compiler
+{
+public:
+    Compiler(Regex& regex, std::string_view pattern) :
+        regex_(regex),
+        pattern_(pattern),
+        pos_(0)
+    {
+    }
+
+    /// @return false if the pattern must be handled by std::regex
+    bool compile()
+    {
+        try
+        {
+            int32_t root = parseAlternatives();
+            if (pos_ != pattern_.size()) return false;  // unbalanced ')'
+            extractLiterals(root);
+            regex_.minLength_ = minLength(root);
+            regex_.nfa_.push_back({ NfaState::MATCH, 0, -1, -1 });
+            regex_.nfaStart_ = build(root, 0);
+            return true;
+        }
+        catch (const Unsupported&)
+        {
+            return false;
+        }
+    }
+
+private:
+    struct Unsupported {};
+
+    struct Node
+    {
+        enum Kind : uint8_t { EMPTY, SET, CONCAT, ALTERNATIVES, REPEAT };
+        Kind kind;
+        uint32_t set;                   // SET only
+        uint32_t min;                   // REPEAT only
+        uint32_t max;
+        std::vector<int32_t> children;
+    };
+
+    static constexpr uint32_t UNBOUNDED = 0xffff'ffff;
+    static constexpr uint32_t MAX_REPEAT = 1000;
+
+    bool atEnd() const { return pos_ == pattern_.size(); }
+    char peek() const { return pattern_[pos_]; }
+
+    int32_t addNode(Node::Kind kind)
+    {
+        nodes_.push_back({ kind, 0, 0, 0, {} });
+        return static_cast<int32_t>(nodes_.size() - 1);
+    }
+
+    int32_t addSetNode(const ByteSet& set)
+    {
+        int32_t node = addNode(Node::SET);
+        nodes_[node].set = static_cast<uint32_t>(regex_.sets_.size());
+        regex_.sets_.push_back(set);
+        return node;
+    }
+
+    static void add(ByteSet& set, uint8_t ch)
+    {
+        set[ch >> 6] |= 1ULL << (ch & 63);
+    }
+
+    static void addRange(ByteSet& set, uint8_t first, uint8_t last)
+    {
+        for (int ch = first; ch <= last; ch++) add(set, static_cast<uint8_t>(ch));
+    }
+
+    static void invert(ByteSet& set)
+    {
+        for (uint64_t& word : set) word = ~word;
+    }
+
+    int32_t parseAlternatives()
+    {
+        int32_t first = parseSequence();
+        if (atEnd() || peek() != '|') return first;
+        int32_t node = addNode(Node::ALTERNATIVES);
+        nodes_[node].children.push_back(first);
+        while (!atEnd() && peek() == '|')
+        {
+            pos_++;
+            int32_t next = parseSequence();
+            nodes_[node].children.push_back(next);
+        }
+        return node;
+    }
+
+    int32_t parseSequence()
+    {
+        std::vector<int32_t> children;
+        while (!atEnd() && peek() != '|' && peek() != ')')
+        {
+            children.push_back(parseRepeat());
+        }
+        if (children.empty()) return addNode(Node::EMPTY);
+        if (children.size() == 1) return children[0];
+        int32_t node = addNode(Node::CONCAT);
+        nodes_[node].children = std::move(children);
+        return node;
+    }
+
+    int32_t parseRepeat()
+    {
+        int32_t atom = parseAtom();
+        if (atEnd()) return atom;
+        uint32_t min, max;
+        switch (peek())
+        {
+        case '*':
+            min = 0;
+            max = UNBOUNDED;
+            break;
+        case '+':
+            min = 1;
+            max = UNBOUNDED;
+            break;
+        case '?':
+            min = 0;
+            max = 1;
+            break;
+        case '{':
+            pos_++;
+            min = parseNumber();
+            max = min;
+            if (!atEnd() && peek() == ',')
+            {
+                pos_++;
+                max = (!atEnd() && peek() == '}') ? UNBOUNDED : parseNumber();
+            }
+            if (atEnd() || peek() != '}' || max < min) throw Unsupported();
+            break;
+        default:
+            return atom;
+        }
+        pos_++;
+        // Laziness doesn't matter if we only match entire strings
+        if (!atEnd() && peek() == '?') pos_++;
+        if (!atEnd() && (peek() == '*' || peek() == '+' ||
+            peek() == '?' || peek() == '{'))
+        {
+            throw Unsupported();
+        }
+        int32_t node = addNode(Node::REPEAT);
+        nodes_[node].min = min;
+        nodes_[node].max = max;
+        nodes_[node].children.push_back(atom);
+        return node;
+    }
+
+    uint32_t parseNumber()
+    {
+        uint32_t n = 0;
+        size_t start = pos_;
+        while (!atEnd() && peek() >= '0' && peek() <= '9')
+        {
+            n = n * 10 + (peek() - '0');
+            if (n > MAX_REPEAT) throw Unsupported();
+            pos_++;
+        }
+        if (pos_ == start) throw Unsupported();
+        return n;
+    }
+
+    int32_t parseAtom()
+    {
+        char ch = pattern_[pos_++];
+        ByteSet set = {};
+        switch (ch)
+        {
+        case '(':
+        {
+            if (!atEnd() && peek() == '?')
+            {
+                // Only non-capturing groups; no lookahead
+                if (pos_ + 1 >= pattern_.size() || pattern_[pos_ + 1] != ':')
+                {
+                    throw Unsupported();
+                }
+                pos_ += 2;
+            }
+            int32_t inner = parseAlternatives();
+            if (atEnd() || peek() != ')') throw Unsupported();
+            pos_++;
+            return inner;
+        }
+        case '[':
+            parseClass(set);
+            return addSetNode(set);
+        case '.':
+            invert(set);
+            set[0] &= ~((1ULL << '\n') | (1ULL << '\r'));
+            return addSetNode(set);
+        case '^':
+            // Anchors are implied, but only allowed where they are no-ops
+            if (pos_ != 1) throw Unsupported();
+            return addNode(Node::EMPTY);
+        case '$':
+            if (!atEnd()) throw Unsupported();
+            return addNode(Node::EMPTY);
+        case '\\':
+            parseEscape(set, false);
+            return addSetNode(set);
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+            throw Unsupported();        // nothing to repeat
+        default:
+            add(set, static_cast<uint8_t>(ch));
+            return addSetNode(set);
+        }
+    }
+
+    /// Parses an escape sequence (after the backslash) and adds the
+    /// characters it stands for to `set`.
+    ///
+    /// @return true if the sequence is a single character
+    ///
+    bool parseEscape(ByteSet& set, bool inClass)
+    {
+        if (atEnd()) throw Unsupported();
+        char ch = pattern_[pos_++];
+        ByteSet classSet = {};
+        bool negate = false;
+        switch (ch)
+        {
+        case 'D':
+            negate = true;
+            [[fallthrough]];
+        case 'd':
+            addRange(classSet, '0', '9');
+            break;
+        case 'W':
+            negate = true;
+            [[fallthrough]];
+        case 'w':
+            addRange(classSet, '0', '9');
+            addRange(classSet, 'A', 'Z');
+            addRange(classSet, 'a', 'z');
+            add(classSet, '_');
+            break;
+        case 'S':
+            negate = true;
+            [[fallthrough]];
+        case 's':
+            addRange(classSet, '\t', '\r');     // \t \n \v \f \r
+            add(classSet, ' ');
+            break;
+        case 'n': add(set, '\n'); return true;
+        case 'r': add(set, '\r'); return true;
+        case 't': add(set, '\t'); return true;
+        case 'v': add(set, '\v'); return true;
+        case 'f': add(set, '\f'); return true;
+        case '0': add(set, 0); return true;
+        case 'b':
+            if (!inClass) throw Unsupported();  // word boundary
+            add(set, '\b');
+            return true;
+        case 'x':
+        {
+            if (pos_ + 2 > pattern_.size()) throw Unsupported();
+            int value = 0;
+            for (int i = 0; i < 2; i++)
+            {
+                char digit = pattern_[pos_++];
+                int n;
+                if (digit >= '0' && digit <= '9') n = digit - '0';
+                else if (digit >= 'a' && digit <= 'f') n = digit - 'a' + 10;
+                else if (digit >= 'A' && digit <= 'F') n = digit - 'A' + 10;
+                else throw Unsupported();
+                value = value * 16 + n;
+            }
+            add(set, static_cast<uint8_t>(value));
+            return true;
+        }
+        default:
+            // Backreferences, \B, \c, \u and unknown letter escapes
+            if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') ||
+                (ch >= '1' && ch <= '9'))
+            {
+                throw Unsupported();
+            }
+            add(set, static_cast<uint8_t>(ch));     // escaped punctuation
+            return true;
+        }
+        if (negate) invert(classSet);
+        for (int i = 0; i < 4; i++) set[i] |= classSet[i];
+        return false;
+    }
+
+    /// Parses a character class (after the opening bracket).
+    void parseClass(ByteSet& set)
+    {
+        bool negate = false;
+        if (!atEnd() && peek() == '^')
+        {
+            negate = true;
+            pos_++;
+        }
+        // ECMAScript treats [] and [^] specially; leave those to std::regex
+        if (atEnd() || peek() == ']') throw Unsupported();
+        while (!atEnd() && peek() != ']')
+        {
+            ByteSet item = {};
+            int first = parseClassChar(item);
+            if (first >= 0 && pos_ + 1 < pattern_.size() &&
+                peek() == '-' && pattern_[pos_ + 1] != ']')
+            {
+                pos_++;
+                ByteSet lastItem = {};
+                int last = parseClassChar(lastItem);
+                if (last < first) throw Unsupported();
+                addRange(item, static_cast<uint8_t>(first), static_cast<uint8_t>(last));
+            }
+            for (int i = 0; i < 4; i++) set[i] |= item[i];
+        }
+        if (atEnd()) throw Unsupported();
+        pos_++;     // skip ']'
+        if (negate) invert(set);
+    }
+
+    /// @return the character, or -1 if the item is a class escape (\d etc.)
+    int parseClassChar(ByteSet& set)
+    {
+        char ch = pattern_[pos_++];
+        if (ch != '\\')
+        {
+            add(set, static_cast<uint8_t>(ch));
+            return static_cast<uint8_t>(ch);
+        }
+        if (!parseEscape(set, true)) return -1;
+        for (int i = 0; i < 256; i++)
+        {
+            if (contains(set, static_cast<uint8_t>(i))) return i;
+        }
+        assert(false);
+        return -1;
+    }
+
+    /// @return the character, or -1 if the node isn't a single character
+    int singleChar(int32_t node) const
+    {
+        if (nodes_[node].kind != Node::SET) return -1;
+        const ByteSet& set = regex_.sets_[nodes_[node].set];
+        int found = -1;
+        for (int i = 0; i < 256; i++)
+        {
+            if (contains(set, static_cast<uint8_t>(i)))
+            {
+                if (found >= 0) return -1;
+                found = i;
+            }
+        }
+        return found;
+    }
+
+    /// Finds the literal characters every match must start and end with
+    void extractLiterals(int32_t root)
+    {
+        std::vector<int32_t> items;
+        if (nodes_[root].kind == Node::CONCAT)
+        {
+            for (int32_t child : nodes_[root].children)
+            {
+                // Anchors don't consume characters
+                if (nodes_[child].kind != Node::EMPTY) items.push_back(child);
+            }
+        }
+        else if (nodes_[root].kind == Node::SET)
+        {
+            items.push_back(root);
+        }
+        size_t start = 0;
+        while (start < items.size())
+        {
+            int ch = singleChar(items[start]);
+            if (ch < 0) break;
+            regex_.prefix_.push_back(static_cast<char>(ch));
+            start++;
+        }
+        size_t end = items.size();
+        while (end > 0)
+        {
+            int ch = singleChar(items[end - 1]);
+            if (ch < 0) break;
+            end--;
+        }
+        for (size_t i = end; i < items.size(); i++)
+        {
+            regex_.suffix_.push_back(static_cast<char>(singleChar(items[i])));
+        }
+    }
+
+    size_t minLength(int32_t node) const
+    {
+        const Node& n = nodes_[node];
+        switch (n.kind)
+        {
+        case Node::SET:
+            return 1;
+        case Node::CONCAT:
+        {
+            size_t len = 0;
+            for (int32_t child : n.children) len += minLength(child);
+            return len;
+        }
+        case Node::ALTERNATIVES:
+        {
+            size_t len = SIZE_MAX;
+            for (int32_t child : n.children) len = std::min(len, minLength(child));
+            return len;
+        }
+        case Node::REPEAT:
+            return n.min * minLength(n.children[0]);
+        default:
+            return 0;
+        }
+    }
+
+    int32_t addState(NfaState::Kind kind, uint32_t set, int32_t out, int32_t out2)
+    {
+        if (regex_.nfa_.size() >= MAX_NFA_STATES) throw Unsupported();
+        regex_.nfa_.push_back({ kind, set, out, out2 });
+        return static_cast<int32_t>(regex_.nfa_.size() - 1);
+    }
+
+    /// Creates the states for `node`, which continue with state
+    /// `next` (States are built back to front).
+    ///
+    /// @return the entry state
+    ///
+    int32_t build(int32_t node, int32_t next)      // NOLINT recursion
+    {
+        const Node& n = nodes_[node];
+        switch (n.kind)
+        {
+        case Node::EMPTY:
+            return next;
+        case Node::SET:
+            return addState(NfaState::SET, n.set, next, -1);
+        case Node::CONCAT:
+            for (size_t i = n.children.size(); i > 0; i--)
+            {
+                next = build(n.children[i - 1], next);
+            }
+            return next;
+        case Node::ALTERNATIVES:
+        {
+            int32_t state = build(n.children.back(), next);
+            for (size_t i = n.children.size() - 1; i > 0; i--)
+            {
+                int32_t alternative = build(n.children[i - 1], next);
+                state = addState(NfaState::SPLIT, 0, alternative, state);
+            }
+            return state;
+        }
+        case Node::REPEAT:
+        {
+            int32_t child = n.children[0];
+            int32_t state = next;
+            if (n.max == UNBOUNDED)
+            {
+                // The loop state comes first, so the body can refer to it
+                int32_t loop = addState(NfaState::SPLIT, 0, -1, next);
+                int32_t body = build(child, loop);
+                regex_.nfa_[loop].out = body;
+                state = loop;
+            }
+            else
+            {
+                for (uint32_t i = n.min; i < n.max; i++)
+                {
+                    state = addState(NfaState::SPLIT, 0, build(child, state), next);
+                }
+            }
+            for (uint32_t i = 0; i < n.min; i++) state = build(child, state);
+            return state;
+        }
+        }
+        return next;
+    }
+
+    Regex& regex_;
+    std::string_view pattern_;
+    size_t pos_;
+    std::vector<Node> nodes_;
+};
+
+
+Regex::Regex(std::string_view pattern)
+{
+    if (!Compiler(*this, pattern).compile())
+    {
+        prefix_.clear();
+        suffix_.clear();
+        minLength_ = 0;
+        nfa_.clear();
+        sets_.clear();
+        fallback_ = std::make_unique<std::regex>(
+            pattern.begin(), pattern.end());     // throws if invalid
+        return;
+    }
+    buildDfa();
+}
+
+/**
+ * Replaces `states` with the NFA states reachable from them without
+ * consuming a character (sorted, and excluding SPLIT states).
+ */
+void Regex::closure(std::vector<int32_t>& states) const
+{
+    std::vector<int32_t> stack(states);
+    std::vector<bool> seen(nfa_.size());
+    states.clear();
+    while (!stack.empty())
+    {
+        int32_t s = stack.back();
+        stack.pop_back();
+        if (seen[s]) continue;
+        seen[s] = true;
+        const NfaState& state = nfa_[s];
+        if (state.kind == NfaState::SPLIT)
+        {
+            stack.push_back(state.out2);
+            stack.push_back(state.out);
+        }
+        else
+        {
+            states.push_back(s);
+        }
+    }
+    std::sort(states.begin(), states.end());
+}
+
+/**
+ * Builds the DFA by subset construction, over classes of bytes that
+ * no character set of the pattern tells apart. If the DFA would have
+ * more than MAX_DFA_STATES states, we keep the NFA instead.
+ */
+void Regex::buildDfa()
+{
+    // Refine the partition of bytes by each character set
+    classCount_ = 1;
+    for (const ByteSet& set : sets_)
+    {
+        int remap[2][256];
+        std::fill(&remap[0][0], &remap[0][0] + 512, -1);
+        uint32_t count = 0;
+        for (int ch = 0; ch < 256; ch++)
+        {
+            int& cls = remap[contains(set, static_cast<uint8_t>(ch))][classes_[ch]];
+            if (cls < 0) cls = static_cast<int>(count++);
+            classes_[ch] = static_cast<uint8_t>(cls);
+        }
+        classCount_ = count;
+        if (count == 256) break;
+    }
+    uint8_t representatives[256];
+    for (int ch = 255; ch >= 0; ch--) representatives[classes_[ch]] = static_cast<uint8_t>(ch);
+
+    std::map<std::vector<int32_t>, uint32_t> stateIds;
+    std::vector<std::vector<int32_t>> states;
+    states.emplace_back();                  // DEAD
+    stateIds[states[0]] = DEAD;
+    std::vector<int32_t> start = { nfaStart_ };
+    closure(start);
+    stateIds[start] = START;
+    states.push_back(std::move(start));
+
+    std::vector<uint16_t> dfa;
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        for (uint32_t cls = 0; cls < classCount_; cls++)
+        {
+            std::vector<int32_t> next;
+            for (int32_t s : states[i])
+            {
+                const NfaState& state = nfa_[s];
+                if (state.kind == NfaState::SET &&
+                    contains(sets_[state.set], representatives[cls]))
+                {
+                    next.push_back(state.out);
+                }
+            }
+            closure(next);
+            auto it = stateIds.find(next);
+            uint32_t id;
+            if (it == stateIds.end())
+            {
+                id = static_cast<uint32_t>(states.size());
+                if (id >= MAX_DFA_STATES) return;   // too large; use the NFA
+                stateIds.emplace(next, id);
+                states.push_back(std::move(next));
+            }
+            else
+            {
+                id = it->second;
+            }
+            dfa.push_back(static_cast<uint16_t>(id));
+        }
+    }
+    accepting_.resize(states.size());
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        // The MATCH state is always state 0 of the NFA, hence first if present
+        accepting_[i] = !states[i].empty() && states[i][0] == 0;
+    }
+    dfa_ = std::move(dfa);
+    nfa_.clear();
+    nfa_.shrink_to_fit();
+    sets_.clear();
+    sets_.shrink_to_fit();
+}
+
+/**
+ * Simulates the NFA, tracking all states it can be in at once
+ * (used only for patterns with a very large DFA).
+ */
+bool Regex::matchNfa(std::string_view s) const
+{
+    std::vector<int32_t> current = { nfaStart_ };
+    closure(current);
+    std::vector<int32_t> next;
+    for (char ch : s)
+    {
+        next.clear();
+        for (int32_t i : current)
+        {
+            const NfaState& state = nfa_[i];
+            if (state.kind == NfaState::SET &&
+                contains(sets_[state.set], static_cast<uint8_t>(ch)))
+            {
+                next.push_back(state.out);
+            }
+        }
+        closure(next);
+        if (next.empty()) return false;
+        std::swap(current, next);
+    }
+    return !current.empty() && current[0] == 0;
+}
+
+} // namespace clarisma
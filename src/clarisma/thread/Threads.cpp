@@ -0,0 +1,10 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#if defined(_WIN32)
+#include "Threads_windows.cxx"
+#elif defined(__linux__) || defined(__APPLE__)
+#include "Threads_linux.cxx"
+#else
+#error "Platform not supported"
+#endif
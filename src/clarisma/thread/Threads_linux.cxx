@@ -0,0 +1,95 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/thread/Threads.h>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace clarisma {
+
+bool Threads::pinCurrentThread(int cpu)
+{
+    return pinCurrentThread(std::vector<int>{ cpu });
+}
+
+bool Threads::pinCurrentThread(const std::vector<int>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    // macOS has no API to bind a thread to specific cores
+    return false;
+#endif
+}
+
+#ifdef __linux__
+// Parses a CPU list such as "0-3,8-11"
+static std::vector<int> parseCpuList(const std::string& s)
+{
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < s.size())
+    {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) end = s.size();
+        std::string range = s.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        try
+        {
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        }
+        catch (const std::exception&)
+        {
+            // ignore malformed ranges (e.g. trailing newline)
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+#endif
+
+std::vector<std::vector<int>> Threads::numaNodes()
+{
+    std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+    std::error_code error;
+    std::vector<std::pair<int,std::vector<int>>> found;
+    for (const auto& entry : std::filesystem::directory_iterator(
+        "/sys/devices/system/node", error))
+    {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4) continue;
+        if (!std::all_of(name.begin() + 4, name.end(), ::isdigit)) continue;
+        std::ifstream in(entry.path() / "cpulist");
+        std::string list;
+        if (!std::getline(in, list)) continue;
+        std::vector<int> cpus = parseCpuList(list);
+        if (!cpus.empty()) found.emplace_back(std::stoi(name.substr(4)), std::move(cpus));
+    }
+    std::sort(found.begin(), found.end());
+    for (auto& node : found) nodes.push_back(std::move(node.second));
+#endif
+    if (nodes.empty())
+    {
+        std::vector<int> all;
+        for (int i = 0; i < hardwareConcurrency(); i++) all.push_back(i);
+        nodes.push_back(std::move(all));
+    }
+    return nodes;
+}
+
+} // namespace clarisma
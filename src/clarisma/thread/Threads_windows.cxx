@@ -0,0 +1,54 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/thread/Threads.h>
+#include <windows.h>
+
+namespace clarisma {
+
+static constexpr int MAX_CPUS = static_cast<int>(sizeof(DWORD_PTR) * 8);
+
+bool Threads::pinCurrentThread(int cpu)
+{
+    return pinCurrentThread(std::vector<int>{ cpu });
+}
+
+bool Threads::pinCurrentThread(const std::vector<int>& cpus)
+{
+    // Only the first processor group (64 CPUs) is supported
+    DWORD_PTR mask = 0;
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < MAX_CPUS) mask |= static_cast<DWORD_PTR>(1) << cpu;
+    }
+    return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+std::vector<std::vector<int>> Threads::numaNodes()
+{
+    std::vector<std::vector<int>> nodes;
+    ULONG highestNode;
+    if (GetNumaHighestNodeNumber(&highestNode))
+    {
+        for (ULONG node = 0; node <= highestNode; node++)
+        {
+            ULONGLONG mask;
+            if (!GetNumaNodeProcessorMask(static_cast<UCHAR>(node), &mask)) continue;
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < MAX_CPUS; cpu++)
+            {
+                if (mask & (1ULL << cpu)) cpus.push_back(cpu);
+            }
+            if (!cpus.empty()) nodes.push_back(std::move(cpus));
+        }
+    }
+    if (nodes.empty())
+    {
+        std::vector<int> all;
+        for (int i = 0; i < hardwareConcurrency(); i++) all.push_back(i);
+        nodes.push_back(std::move(all));
+    }
+    return nodes;
+}
+
+} // namespace clarisma
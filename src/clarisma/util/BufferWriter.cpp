@@ -5,8 +5,10 @@
 #include <cassert>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <clarisma/text/Format.h>
 #include <clarisma/util/log.h>
+#include <clarisma/util/Strings.h>
 #include <clarisma/math/Math.h>
 
 namespace clarisma {
@@ -31,6 +33,48 @@ void BufferWriter::formatDouble(double d, int precision, bool zeroFill)
 	writeBytes(start, end - start);
 }
 
+void BufferWriter::formatScaled(int64_t value, int precision)
+{
+	static constexpr uint64_t POWERS_OF_10[] =
+	{
+		1ULL, 10ULL, 100ULL, 1'000ULL, 10'000ULL, 100'000ULL, 1'000'000ULL,
+		10'000'000ULL, 100'000'000ULL, 1'000'000'000ULL, 10'000'000'000ULL,
+		100'000'000'000ULL, 1'000'000'000'000ULL, 10'000'000'000'000ULL,
+		100'000'000'000'000ULL, 1'000'000'000'000'000ULL
+	};
+	assert(precision >= 0 && precision <= 15);
+	char buf[48];
+	char* end = buf + sizeof(buf);
+	char* p = end;
+	bool negative = value < 0;
+	uint64_t v = negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+	uint64_t intPart = v / POWERS_OF_10[precision];
+	uint64_t frac = v - intPart * POWERS_OF_10[precision];
+	if (frac)
+	{
+		int digits = precision;
+		while (frac % 10 == 0)
+		{
+			frac /= 10;
+			digits--;
+		}
+		// Leading zeroes of the fraction are written as well,
+		// since we count down the digits
+		for (; digits >= 2; digits -= 2)
+		{
+			uint64_t quot = frac / 100;
+			p -= 2;
+			memcpy(p, &Format::DIGIT_PAIRS[(frac - quot * 100) * 2], 2);
+			frac = quot;
+		}
+		if (digits) *(--p) = static_cast<char>('0' + frac);
+		*(--p) = '.';
+	}
+	p = Format::unsignedIntegerReverse(intPart, p);
+	if (negative) *(--p) = '-';
+	writeBytes(p, end - p);
+}
+
 // rename to formatLong
 void BufferWriter::formatInt(int64_t d)
 {
@@ -72,6 +116,14 @@ void BufferWriter::writeJsonEscapedString(const char* s, size_t len)
 	const char* end = s + len;
 	while (s < end)
 	{
+		// Copy the run of characters that need no escaping in one go
+		size_t safeLen = Strings::jsonSafePrefix(s, end - s);
+		if (safeLen)
+		{
+			writeBytes(s, safeLen);
+			s += safeLen;
+			if (s == end) break;
+		}
 		unsigned char ch = static_cast<unsigned char>(*s++);
 		if (ch == '\"' || ch == '\\')
 		{
@@ -0,0 +1,256 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/util/Crc32C.h>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CLARISMA_CRC32C_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <nmmintrin.h>
+#define CLARISMA_CRC32C_TARGET
+#else
+#include <cpuid.h>
+#include <nmmintrin.h>
+#define CLARISMA_CRC32C_TARGET __attribute__((target("sse4.2")))
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+// On ARM, we rely on the compiler target (always true for Apple
+// Silicon and for builds with -march=armv8.1-a or later)
+#define CLARISMA_CRC32C_ARM
+#include <arm_acle.h>
+#define CLARISMA_CRC32C_TARGET
+#endif
+
+namespace clarisma {
+
+namespace {
+
+constexpr uint32_t POLYNOMIAL = 0x82F63B78;     // reversed Castagnoli
+
+struct SoftwareTables
+{
+    uint32_t table[8][256];
+
+    constexpr SoftwareTables() : table{}
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            for (int t = 1; t < 8; t++)
+            {
+                uint32_t prev = table[t - 1][i];
+                table[t][i] = (prev >> 8) ^ table[0][prev & 0xff];
+            }
+        }
+    }
+};
+
+constexpr SoftwareTables SOFTWARE_TABLES;
+
+inline uint64_t load64(const uint8_t* p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);       // TODO: assumes Little-Endian
+    return v;
+}
+
+/**
+ * Slicing-by-8; `crc` is the raw (non-inverted) register state.
+ */
+uint32_t softwareUpdate(uint32_t crc, const uint8_t* p, size_t size)
+{
+    const auto& t = SOFTWARE_TABLES.table;
+    while (size >= 8)
+    {
+        uint64_t v = load64(p) ^ crc;
+        crc = t[7][v & 0xff] ^
+            t[6][(v >> 8) & 0xff] ^
+            t[5][(v >> 16) & 0xff] ^
+            t[4][(v >> 24) & 0xff] ^
+            t[3][(v >> 32) & 0xff] ^
+            t[2][(v >> 40) & 0xff] ^
+            t[1][(v >> 48) & 0xff] ^
+            t[0][v >> 56];
+        p += 8;
+        size -= 8;
+    }
+    while (size)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+        size--;
+    }
+    return crc;
+}
+
+#ifdef CLARISMA_CRC32C_TARGET
+
+#ifdef CLARISMA_CRC32C_X86
+CLARISMA_CRC32C_TARGET inline uint32_t crcByte(uint32_t crc, uint8_t v)
+{
+    return _mm_crc32_u8(crc, v);
+}
+
+CLARISMA_CRC32C_TARGET inline uint32_t crcWord(uint32_t crc, uint64_t v)
+{
+    return static_cast<uint32_t>(_mm_crc32_u64(crc, v));
+}
+#else
+inline uint32_t crcByte(uint32_t crc, uint8_t v)
+{
+    return __crc32cb(crc, v);
+}
+
+inline uint32_t crcWord(uint32_t crc, uint64_t v)
+{
+    return __crc32cd(crc, v);
+}
+#endif
+
+/**
+ * The hardware path runs three independent CRCs over adjacent lanes
+ * of LANE_SIZE bytes, so the CPU can overlap the latency of the
+ * crc32 instruction (3 cycles, but one issued per cycle). The lane
+ * results are then combined by shifting one CRC past the length of
+ * the next lane, which is a linear map that we evaluate by table.
+ */
+constexpr size_t LANE_SIZE = 512;
+
+struct LaneShift
+{
+    uint32_t table[4][256];
+
+    LaneShift()
+    {
+        // Shifting through zero bytes is linear in the CRC state, so
+        // we only need to determine the image of each of the 32 bits
+        uint8_t zeroes[LANE_SIZE] = {};
+        uint32_t basis[32];
+        for (int bit = 0; bit < 32; bit++)
+        {
+            basis[bit] = softwareUpdate(uint32_t(1) << bit, zeroes, LANE_SIZE);
+        }
+        for (int n = 0; n < 4; n++)
+        {
+            for (uint32_t b = 0; b < 256; b++)
+            {
+                uint32_t v = 0;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    if (b & (1 << bit)) v ^= basis[n * 8 + bit];
+                }
+                table[n][b] = v;
+            }
+        }
+    }
+
+    uint32_t operator()(uint32_t crc) const
+    {
+        return table[0][crc & 0xff] ^
+            table[1][(crc >> 8) & 0xff] ^
+            table[2][(crc >> 16) & 0xff] ^
+            table[3][crc >> 24];
+    }
+};
+
+const LaneShift* laneShift = nullptr;
+
+CLARISMA_CRC32C_TARGET
+uint32_t hardwareUpdate(uint32_t crc, const uint8_t* p, size_t size)
+{
+    while (size && (reinterpret_cast<uintptr_t>(p) & 7))
+    {
+        crc = crcByte(crc, *p++);
+        size--;
+    }
+    const LaneShift& shift = *laneShift;
+    while (size >= LANE_SIZE * 3)
+    {
+        uint32_t a = crc;
+        uint32_t b = 0;
+        uint32_t c = 0;
+        for (size_t i = 0; i < LANE_SIZE; i += 8)
+        {
+            a = crcWord(a, load64(p + i));
+            b = crcWord(b, load64(p + LANE_SIZE + i));
+            c = crcWord(c, load64(p + LANE_SIZE * 2 + i));
+        }
+        crc = shift(shift(a) ^ b) ^ c;
+        p += LANE_SIZE * 3;
+        size -= LANE_SIZE * 3;
+    }
+    while (size >= 8)
+    {
+        crc = crcWord(crc, load64(p));
+        p += 8;
+        size -= 8;
+    }
+    while (size)
+    {
+        crc = crcByte(crc, *p++);
+        size--;
+    }
+    return crc;
+}
+
+bool cpuHasCrc32C()
+{
+#if defined(CLARISMA_CRC32C_ARM)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    return (ecx & bit_SSE4_2) != 0;
+#endif
+}
+
+#endif
+
+using UpdateFunction = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+UpdateFunction selectImplementation()
+{
+#ifdef CLARISMA_CRC32C_TARGET
+    if (cpuHasCrc32C())
+    {
+        static const LaneShift shift;
+        laneShift = &shift;
+        return hardwareUpdate;
+    }
+#endif
+    return softwareUpdate;
+}
+
+UpdateFunction implementation()
+{
+    static const UpdateFunction func = selectImplementation();
+    return func;
+}
+
+} // namespace
+
+
+uint32_t Crc32C::compute(const void* data, size_t size, uint32_t crc)
+{
+    return ~implementation()(~crc, static_cast<const uint8_t*>(data), size);
+}
+
+bool Crc32C::isHardwareAccelerated()
+{
+    return implementation() != softwareUpdate;
+}
+
+} // namespace clarisma
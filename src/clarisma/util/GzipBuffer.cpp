@@ -0,0 +1,194 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_WITH_ZLIB
+
+#include <clarisma/util/GzipBuffer.h>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+#include <clarisma/util/BufferWriter.h>
+
+namespace clarisma {
+
+GzipBuffer::GzipBuffer(Buffer* out, int level, int threadCount, size_t blockSize) :
+	out_(out),
+	level_(level),
+	blockSize_(blockSize),
+	finished_(false),
+	anyWritten_(false),
+	stopping_(false)
+{
+	if (threadCount <= 0)
+	{
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+	maxPending_ = threadCount * 2;
+	nextBlock();
+	if (threadCount > 1)
+	{
+		threads_.reserve(threadCount);
+		for (int i = 0; i < threadCount; i++) threads_.emplace_back(&GzipBuffer::work, this);
+	}
+}
+
+
+GzipBuffer::~GzipBuffer()
+{
+	// Like FileBuffer2, we write out what remains
+	finish();
+	stopThreads();
+}
+
+
+void GzipBuffer::nextBlock()
+{
+	if (spareBlocks_.empty())
+	{
+		block_.reset(new char[blockSize_]);
+	}
+	else
+	{
+		block_ = std::move(spareBlocks_.back());
+		spareBlocks_.pop_back();
+	}
+	buf_ = block_.get();
+	p_ = buf_;
+	end_ = buf_ + blockSize_;
+}
+
+
+void GzipBuffer::filled(char* p)
+{
+	submit(p - buf_);
+	nextBlock();
+}
+
+
+void GzipBuffer::flush(char* p)
+{
+	p_ = p;
+}
+
+
+void GzipBuffer::compress(Job& job) const
+{
+	z_stream stream = {};
+	if (deflateInit2(&stream, level_, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		job.failed = true;
+		return;
+	}
+	job.output.resize(deflateBound(&stream, static_cast<uLong>(job.inputLength)));
+	stream.next_in = reinterpret_cast<Bytef*>(job.input.get());
+	stream.avail_in = static_cast<uInt>(job.inputLength);
+	stream.next_out = reinterpret_cast<Bytef*>(job.output.data());
+	stream.avail_out = static_cast<uInt>(job.output.size());
+	job.failed = deflate(&stream, Z_FINISH) != Z_STREAM_END;
+	job.output.resize(stream.total_out);
+	deflateEnd(&stream);
+}
+
+
+void GzipBuffer::submit(size_t length)
+{
+	std::unique_ptr<Job> job = std::make_unique<Job>();
+	job->input = std::move(block_);
+	job->inputLength = length;
+	anyWritten_ = true;
+
+	if (threads_.empty())
+	{
+		compress(*job);
+		writeOutput(*job);
+		return;
+	}
+	size_t pendingCount;
+	{
+		std::lock_guard lock(mutex_);
+		queue_.push_back(job.get());
+		pending_.push_back(std::move(job));
+		pendingCount = pending_.size();
+	}
+	workAvailable_.notify_one();
+	// Don't let the writer get too far ahead of the compressors
+	if (pendingCount >= maxPending_) writeNext();
+}
+
+
+/**
+ * Waits for the oldest pending block to be compressed, and writes it.
+ */
+void GzipBuffer::writeNext()
+{
+	std::unique_ptr<Job> job;
+	{
+		std::unique_lock lock(mutex_);
+		jobDone_.wait(lock, [this] { return pending_.front()->done; });
+		job = std::move(pending_.front());
+		pending_.pop_front();
+	}
+	writeOutput(*job);
+}
+
+
+void GzipBuffer::writeOutput(Job& job)
+{
+	if (job.failed) throw std::runtime_error("gzip compression failed");
+	BufferWriter writer(out_);
+	writer.writeBytes(job.output.data(), job.output.size());
+	writer.flush();
+	spareBlocks_.push_back(std::move(job.input));
+}
+
+
+void GzipBuffer::work()
+{
+	for (;;)
+	{
+		Job* job;
+		{
+			std::unique_lock lock(mutex_);
+			workAvailable_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+			if (queue_.empty()) return;
+			job = queue_.front();
+			queue_.pop_front();
+		}
+		compress(*job);
+		{
+			std::lock_guard lock(mutex_);
+			job->done = true;
+		}
+		jobDone_.notify_all();
+	}
+}
+
+
+void GzipBuffer::finish()
+{
+	if (finished_) return;
+	finished_ = true;
+	// An empty input still yields a (valid) gzip member
+	if (p_ > buf_ || !anyWritten_) submit(p_ - buf_);
+	while (!pending_.empty()) writeNext();
+	stopThreads();
+	buf_ = p_ = end_ = nullptr;
+	spareBlocks_.clear();
+	out_->flush(out_->pos());
+}
+
+
+void GzipBuffer::stopThreads()
+{
+	{
+		std::lock_guard lock(mutex_);
+		stopping_ = true;
+	}
+	workAvailable_.notify_all();
+	for (std::thread& thread : threads_) thread.join();
+	threads_.clear();
+}
+
+} // namespace clarisma
+
+#endif // GEODESK_WITH_ZLIB
@@ -0,0 +1,132 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/util/Metrics.h>
+#include <cstdio>
+
+namespace clarisma {
+
+void MetricsRegistry::addCounter(std::string name, std::string help, const Counter* counter)
+{
+    addCounter(std::move(name), std::move(help),
+        [counter]() { return counter->value(); });
+}
+
+void MetricsRegistry::addCounter(std::string name, std::string help,
+    std::function<uint64_t()> read)
+{
+    std::lock_guard lock(mutex_);
+    entries_.push_back({ std::move(name), std::move(help), MetricsSnapshot::Kind::COUNTER,
+        [read = std::move(read)]() { return static_cast<double>(read()); } });
+}
+
+void MetricsRegistry::addGauge(std::string name, std::string help,
+    std::function<double()> read)
+{
+    std::lock_guard lock(mutex_);
+    entries_.push_back({ std::move(name), std::move(help),
+        MetricsSnapshot::Kind::GAUGE, std::move(read) });
+}
+
+void MetricsRegistry::addHistogram(std::string name, std::string help,
+    std::function<const Histogram*()> read)
+{
+    std::lock_guard lock(mutex_);
+    histograms_.push_back({ std::move(name), std::move(help), std::move(read) });
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const
+{
+    std::lock_guard lock(mutex_);
+    MetricsSnapshot snapshot;
+    snapshot.values.reserve(entries_.size());
+    for (const Entry& e : entries_)
+    {
+        snapshot.values.push_back({ e.name, e.help, e.kind, e.read() });
+    }
+    for (const HistogramEntry& e : histograms_)
+    {
+        const Histogram* histogram = e.read();
+        snapshot.distributions.push_back({ e.name, e.help,
+            histogram ? histogram->snapshot() : Histogram::Snapshot() });
+    }
+    return snapshot;
+}
+
+double MetricsSnapshot::valueOf(std::string_view name) const
+{
+    for (const Value& v : values)
+    {
+        if (v.name == name) return v.value;
+    }
+    return 0;
+}
+
+namespace {
+
+void appendSample(std::string& out, std::string_view name, std::string_view suffix,
+    std::string_view labels, std::string_view extraLabel, double value)
+{
+    out += name;
+    out += suffix;
+    if (!labels.empty() || !extraLabel.empty())
+    {
+        out += '{';
+        out += labels;
+        if (!labels.empty() && !extraLabel.empty()) out += ',';
+        out += extraLabel;
+        out += '}';
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), " %.17g\n", value);
+    out += buf;
+}
+
+void appendHeader(std::string& out, const std::string& name,
+    const std::string& help, const char* type)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+} // namespace
+
+void MetricsSnapshot::writePrometheus(std::string& out, std::string_view labels) const
+{
+    for (const Value& v : values)
+    {
+        appendHeader(out, v.name, v.help, v.kind == Kind::COUNTER ? "counter" : "gauge");
+        appendSample(out, v.name, {}, labels, {}, v.value);
+    }
+    for (const Distribution& d : distributions)
+    {
+        appendHeader(out, d.name, d.help, "histogram");
+        uint64_t cumulative = 0;
+        for (int i = 0; i < Histogram::BUCKET_COUNT; i++)
+        {
+            cumulative += d.histogram.buckets[i];
+            char le[40];
+            if (i < Histogram::BUCKET_COUNT - 1)
+            {
+                snprintf(le, sizeof(le), "le=\"%.9g\"",
+                    static_cast<double>(Histogram::bucketBound(i)) / 1e9);
+            }
+            else
+            {
+                snprintf(le, sizeof(le), "le=\"+Inf\"");
+            }
+            appendSample(out, d.name, "_bucket", labels, le, static_cast<double>(cumulative));
+        }
+        appendSample(out, d.name, "_sum", labels, {}, d.histogram.sum / 1e9);
+        appendSample(out, d.name, "_count", labels, {}, static_cast<double>(d.histogram.count));
+    }
+}
+
+} // namespace clarisma
@@ -1,8 +1,61 @@
 // Copyright (c) 2024 Clarisma / GeoDesk contributors
 // SPDX-License-Identifier: LGPL-3.0-only
 
-#include <clarisma/util/ShortVarString.h>
+#include <clarisma/util/Strings.h>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLARISMA_STRINGS_SSE2
+#endif
 
 namespace clarisma {
 
+size_t Strings::jsonSafePrefix(const char* str, size_t length)
+{
+	const char* p = str;
+	const char* end = str + length;
+	#ifdef CLARISMA_STRINGS_SSE2
+	const __m128i quote = _mm_set1_epi8('\"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	// SSE2 only compares signed bytes; flipping the sign bit maps
+	// 0..255 to -128..127 in order, so we can test for bytes below ' '
+	const __m128i signBit = _mm_set1_epi8(static_cast<char>(0x80));
+	const __m128i space = _mm_set1_epi8(static_cast<char>(' ' ^ 0x80));
+	while (end - p >= 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+			_mm_cmplt_epi8(_mm_xor_si128(chunk, signBit), space));
+		int mask = _mm_movemask_epi8(special);
+		if (mask) return (p - str) + std::countr_zero(static_cast<unsigned>(mask));
+		p += 16;
+	}
+	#else
+	while (end - p >= 8)
+	{
+		uint64_t chunk;
+		memcpy(&chunk, p, 8);
+		constexpr uint64_t ONES = 0x0101'0101'0101'0101ULL;
+		constexpr uint64_t HIGH = 0x8080'8080'8080'8080ULL;
+		// A byte is flagged if it is zero after XOR with '"' or '\\',
+		// or if it is below ' ' (only exact for bytes < 0x80)
+		uint64_t q = chunk ^ (ONES * '\"');
+		uint64_t b = chunk ^ (ONES * '\\');
+		uint64_t flagged = (((q - ONES) & ~q) | ((b - ONES) & ~b) |
+			((chunk - ONES * ' ') & ~chunk)) & HIGH;
+		if (flagged) break;		// let the loop below find the exact position
+		p += 8;
+	}
+	#endif
+	for (; p < end; p++)
+	{
+		unsigned char ch = static_cast<unsigned char>(*p);
+		if (ch == '\"' || ch == '\\' || ch < ' ') break;
+	}
+	return p - str;
+}
+
 } // namespace clarisma
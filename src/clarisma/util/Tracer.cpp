@@ -0,0 +1,174 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/util/Tracer.h>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <clarisma/io/File.h>
+
+namespace clarisma {
+
+struct Tracer::Buffer
+{
+    struct Event
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t duration;      // INSTANT for instant events
+        uint64_t arg;
+    };
+
+    explicit Buffer(uint32_t id) : threadId(id) {}
+
+    Event events[BUFFER_CAPACITY];
+    // Only written by the owning thread; release, so a dump sees
+    // the events up to the count it reads
+    std::atomic<uint64_t> count = 0;
+    uint32_t threadId;
+    std::string threadName;
+};
+
+std::atomic<bool> Tracer::enabled_ = false;
+
+namespace {
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Tracer::Buffer>> buffers;
+};
+
+Registry& registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+thread_local Tracer::Buffer* tlsBuffer = nullptr;
+
+} // namespace
+
+Tracer::Buffer* Tracer::currentBuffer()
+{
+    if (!tlsBuffer) [[unlikely]]
+    {
+        Registry& reg = registry();
+        std::lock_guard lock(reg.mutex);
+        reg.buffers.push_back(std::make_unique<Buffer>(
+            static_cast<uint32_t>(reg.buffers.size() + 1)));
+        tlsBuffer = reg.buffers.back().get();
+    }
+    return tlsBuffer;
+}
+
+void Tracer::record(const char* name, uint64_t start, uint64_t duration, uint64_t arg) noexcept
+{
+    Buffer* buf;
+    try
+    {
+        buf = currentBuffer();
+    }
+    catch (...)
+    {
+        return;     // out of memory: lose the event rather than the query
+    }
+    uint64_t n = buf->count.load(std::memory_order_relaxed);
+    buf->events[n & (BUFFER_CAPACITY - 1)] = { name, start, duration, arg };
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+void Tracer::start()
+{
+    Registry& reg = registry();
+    {
+        std::lock_guard lock(reg.mutex);
+        for (auto& buf : reg.buffers) buf->count.store(0, std::memory_order_relaxed);
+    }
+    enabled_.store(true, std::memory_order_release);
+}
+
+void Tracer::stop()
+{
+    enabled_.store(false, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name)
+{
+    if (!COMPILED_IN) return;
+    Buffer* buf = currentBuffer();
+    std::lock_guard lock(registry().mutex);
+    buf->threadName = name;
+}
+
+void Tracer::writeChromeJson(std::string& out)
+{
+    Registry& reg = registry();
+    std::lock_guard lock(reg.mutex);
+
+    // Timestamps are relative to the earliest event
+    uint64_t origin = UINT64_MAX;
+    for (auto& buf : reg.buffers)
+    {
+        uint64_t count = buf->count.load(std::memory_order_acquire);
+        uint64_t first = count > BUFFER_CAPACITY ? count - BUFFER_CAPACITY : 0;
+        for (uint64_t i = first; i < count; i++)
+        {
+            origin = std::min(origin, buf->events[i & (BUFFER_CAPACITY - 1)].start);
+        }
+    }
+
+    char line[256];
+    bool firstEvent = true;
+    auto append = [&out, &firstEvent](const char* s)
+    {
+        out += firstEvent ? "\n" : ",\n";
+        out += s;
+        firstEvent = false;
+    };
+
+    out += "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (auto& buf : reg.buffers)
+    {
+        if (!buf->threadName.empty())
+        {
+            snprintf(line, sizeof(line), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                buf->threadId, buf->threadName.c_str());
+            append(line);
+        }
+        uint64_t count = buf->count.load(std::memory_order_acquire);
+        uint64_t first = count > BUFFER_CAPACITY ? count - BUFFER_CAPACITY : 0;
+        for (uint64_t i = first; i < count; i++)
+        {
+            const Buffer::Event& e = buf->events[i & (BUFFER_CAPACITY - 1)];
+            double ts = (e.start - origin) / 1000.0;
+            if (e.duration == INSTANT)
+            {
+                snprintf(line, sizeof(line), "{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\","
+                    "\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{\"arg\":%llu}}",
+                    e.name, buf->threadId, ts, static_cast<unsigned long long>(e.arg));
+            }
+            else
+            {
+                snprintf(line, sizeof(line), "{\"ph\":\"X\",\"name\":\"%s\","
+                    "\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"arg\":%llu}}",
+                    e.name, buf->threadId, ts, e.duration / 1000.0,
+                    static_cast<unsigned long long>(e.arg));
+            }
+            append(line);
+        }
+    }
+    out += "\n]}\n";
+}
+
+void Tracer::writeChromeJson(const char* fileName)
+{
+    std::string json;
+    writeChromeJson(json);
+    File::writeAll(fileName, json.data(), json.size());
+}
+
+} // namespace clarisma
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <clarisma/util/protobuf.h>
+#include <bit>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLARISMA_PROTOBUF_SSE2
+#endif
+
+namespace clarisma::protobuf {
+
+size_t decodeVarints(const uint8_t* p, const uint8_t* end, uint64_t* out)
+{
+	uint64_t* pOut = out;
+
+	// A varint is at most 10 bytes long, so as long as 16 bytes remain,
+	// we can load a full word (and decode a long varint) without
+	// reading past the end
+	while (end - p >= 16)
+	{
+		#ifdef CLARISMA_PROTOBUF_SSE2
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		if (_mm_movemask_epi8(chunk) == 0)
+		{
+			for (int i = 0; i < 16; i++) pOut[i] = p[i];
+			pOut += 16;
+			p += 16;
+			continue;
+		}
+		#endif
+		uint64_t word;
+		memcpy(&word, p, 8);
+		uint64_t stops = ~word & 0x8080'8080'8080'8080ULL;
+		if (stops == 0)
+		{
+			// Longer than 8 bytes
+			*pOut++ = readVarint64(p);
+			continue;
+		}
+		int start = 0;
+		do
+		{
+			int stop = std::countr_zero(stops) + 1;
+			int bits = stop - start;
+			uint64_t v = (word >> start) & (bits == 64 ? ~0ULL : (1ULL << bits) - 1);
+			*pOut++ = (v & 0x7f) |
+				((v >> 1) & 0x3f80) |
+				((v >> 2) & 0x1f'c000) |
+				((v >> 3) & 0xfe0'0000) |
+				((v >> 4) & 0x7'f000'0000ULL) |
+				((v >> 5) & 0x3f8'0000'0000ULL) |
+				((v >> 6) & 0x1'fc00'0000'0000ULL) |
+				((v >> 7) & 0xfe'0000'0000'0000ULL);
+			start = stop;
+			stops &= stops - 1;
+		}
+		while (stops);
+		p += start >> 3;
+	}
+
+	while (p < end)
+	{
+		uint64_t val = 0;
+		int shift = 0;
+		for (;;)
+		{
+			if (p == end) return pOut - out;      // truncated
+			uint8_t b = *p++;
+			if (shift < 64) val |= static_cast<uint64_t>(b & 0x7f) << shift;
+			shift += 7;
+			if ((b & 0x80) == 0) break;
+		}
+		*pOut++ = val;
+	}
+	return pOut - out;
+}
+
+
+void decodeZigzag(uint64_t* values, size_t count, bool delta)
+{
+	uint64_t* p = values;
+	uint64_t* end = values + count;
+	uint64_t sum = 0;
+	#ifdef CLARISMA_PROTOBUF_SSE2
+	const __m128i one = _mm_set1_epi64x(1);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i carry = zero;       // the previous sum, in both lanes
+	while (end - p >= 2)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		v = _mm_xor_si128(_mm_srli_epi64(v, 1),
+			_mm_sub_epi64(zero, _mm_and_si128(v, one)));
+		if (delta)
+		{
+			// [a, b] + [0, a] + carry = running sums of the pair
+			v = _mm_add_epi64(_mm_add_epi64(v, _mm_slli_si128(v, 8)), carry);
+			carry = _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+		p += 2;
+	}
+	sum = static_cast<uint64_t>(_mm_cvtsi128_si64(carry));
+	#endif
+	for (; p < end; p++)
+	{
+		uint64_t v = (*p >> 1) ^ (0 - (*p & 1));
+		if (delta)
+		{
+			sum += v;
+			v = sum;
+		}
+		*p = v;
+	}
+}
+
+} // namespace clarisma::protobuf
@@ -7,10 +7,12 @@
 namespace geodesk {
 
 
-FastMemberIterator::FastMemberIterator(FeatureStore* store, RelationPtr relation) :
+FastMemberIterator::FastMemberIterator(FeatureStore* store, RelationPtr relation,
+    TileCache* tiles) :
     store_(store),
     p_(relation.bodyptr()),
-    currentTip_(FeatureConstants::START_TIP)
+    currentTip_(FeatureConstants::START_TIP),
+    sharedTiles_(tiles)
     // pForeignTile_(nullptr)  // null by default
 {
     // check for empty relation
@@ -56,7 +58,7 @@ FeaturePtr FastMemberIterator::next()
         if (!pForeignTile_)
         {
             // foreign tile not resolved yet
-            pForeignTile_ = store_->fetchTile(currentTip_);
+            pForeignTile_ = tiles().get(store_, currentTip_);
         }
         feature = FeaturePtr(pForeignTile_ +
             ((currentMember_ & 0xffff'fff0) >> 2));
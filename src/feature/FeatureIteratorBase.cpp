@@ -3,6 +3,7 @@
 
 #include <geodesk/feature/FeatureIteratorBase.h>
 #include <geodesk/feature/View.h>
+#include <geodesk/query/QueryRecorder.h>
 
 namespace geodesk {
 
@@ -19,9 +20,21 @@ enum IterType
 };
 
 
-FeatureIteratorBase::FeatureIteratorBase(const View& view) :
+struct FeatureIteratorBase::Recording
+{
+    QueryRecorder* recorder;
+    RecordedQuery query;
+    std::chrono::steady_clock::time_point started;
+};
+
+FeatureIteratorBase::FeatureIteratorBase(const View& view, bool record) :
     current_(view.store())
 {
+    if (record)
+    {
+        QueryRecorder* recorder = view.store()->recorder();
+        if (recorder) [[unlikely]] startRecording(view, recorder);
+    }
     switch (view.view())
     {
     case View::EMPTY:
@@ -128,8 +141,33 @@ void FeatureIteratorBase::destroyParentWaysIterator()
         // since they do not require any cleanup
 }
 
+void FeatureIteratorBase::startRecording(const View& view, QueryRecorder* recorder)
+{
+    recording_ = new Recording{ recorder, RecordedQuery::of(view),
+        std::chrono::steady_clock::now() };
+    recording_->query.start = recorder->elapsedMicros();
+}
+
+void FeatureIteratorBase::finishRecording()
+{
+    RecordedQuery& query = recording_->query;
+    query.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - recording_->started).count();
+    query.complete = current_.isNull();
+    try
+    {
+        recording_->recorder->record(query);
+    }
+    catch (...)
+    {
+        // A failure to write the log must not fail the query
+    }
+    delete recording_;
+}
+
 FeatureIteratorBase::~FeatureIteratorBase()
 {
+    if (recording_) [[unlikely]] finishRecording();
     switch (type_)
     {
     case EMPTY:
@@ -196,6 +234,12 @@ void FeatureIteratorBase::switchToParentRelationsIterator()
 }
 
 void FeatureIteratorBase::fetchNext()
+{
+    advance();
+    if (recording_ && !current_.isNull()) [[unlikely]] recording_->query.results++;
+}
+
+void FeatureIteratorBase::advance()
 {
     switch (type_)
     {
@@ -0,0 +1,448 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/FeatureSet.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/feature/View.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+FeatureSet::Container::Container(const Container& other) :
+    high(other.high),
+    count(other.count),
+    values(other.values)
+{
+    if (other.bits)
+    {
+        bits.reset(new uint64_t[BITMAP_WORDS]);
+        memcpy(bits.get(), other.bits.get(), BITMAP_WORDS * sizeof(uint64_t));
+    }
+}
+
+bool FeatureSet::Container::contains(uint16_t low) const
+{
+    if (bits) return (bits[low >> 6] >> (low & 63)) & 1;
+    return std::binary_search(values.begin(), values.end(), low);
+}
+
+bool FeatureSet::Container::add(uint16_t low)
+{
+    if (bits)
+    {
+        uint64_t mask = uint64_t{1} << (low & 63);
+        if (bits[low >> 6] & mask) return false;
+        bits[low >> 6] |= mask;
+    }
+    else
+    {
+        auto it = std::lower_bound(values.begin(), values.end(), low);
+        if (it != values.end() && *it == low) return false;
+        values.insert(it, low);
+        if (values.size() > MAX_ARRAY_SIZE) toBitmap();
+    }
+    count++;
+    return true;
+}
+
+void FeatureSet::Container::toBitmap()
+{
+    if (bits) return;
+    bits.reset(new uint64_t[BITMAP_WORDS]());
+    for (uint16_t low : values) bits[low >> 6] |= uint64_t{1} << (low & 63);
+    values.clear();
+    values.shrink_to_fit();
+}
+
+/// Recounts the values of a bitmap container and turns it into an
+/// array if that's smaller (and an array into a bitmap if it's larger)
+///
+void FeatureSet::Container::normalize()
+{
+    if (bits)
+    {
+        count = 0;
+        for (uint32_t i = 0; i < BITMAP_WORDS; i++)
+        {
+            count += std::popcount(bits[i]);
+        }
+        if (count > MAX_ARRAY_SIZE) return;
+        values.reserve(count);
+        for (uint32_t i = 0; i < BITMAP_WORDS; i++)
+        {
+            uint64_t word = bits[i];
+            while (word)
+            {
+                values.push_back(static_cast<uint16_t>(i * 64 + std::countr_zero(word)));
+                word &= word - 1;
+            }
+        }
+        bits.reset();
+    }
+    else
+    {
+        count = static_cast<uint32_t>(values.size());
+        if (count > MAX_ARRAY_SIZE) toBitmap();
+    }
+}
+
+size_t FeatureSet::Container::memoryUsage() const
+{
+    return sizeof(Container) + (bits ? BITMAP_WORDS * sizeof(uint64_t) :
+        values.capacity() * sizeof(uint16_t));
+}
+
+FeatureSet::FeatureSet(FeatureStore* store) :
+    store_(store),
+    size_(0)
+{
+    if (store) store->addref();
+}
+
+FeatureSet::FeatureSet(const View& view) :
+    FeatureSet(view.store())
+{
+    if (view.view() == View::EMPTY) return;
+    if (view.view() != View::WORLD)
+    {
+        throw QueryException("Only world views can be turned into a FeatureSet");
+    }
+    std::vector<uint64_t> keys;
+    Query query(store_, view.bounds(), view.types(), view.matcher(), view.filter());
+    for (;;)
+    {
+        FeaturePtr feature = query.next();
+        if (feature.isNull()) break;
+        keys.push_back(keyOf(query.currentTip(),
+            static_cast<uint32_t>(feature.ptr() - query.currentTile())));
+    }
+    build(keys);
+}
+
+FeatureSet::FeatureSet(const FeatureSet& other) :
+    store_(other.store_),
+    size_(other.size_),
+    containers_(other.containers_)
+{
+    if (store_) store_->addref();
+}
+
+FeatureSet::FeatureSet(FeatureSet&& other) noexcept :
+    store_(other.store_),
+    size_(other.size_),
+    containers_(std::move(other.containers_))
+{
+    other.store_ = nullptr;
+    other.size_ = 0;
+}
+
+FeatureSet::~FeatureSet()
+{
+    if (store_) store_->release();
+}
+
+FeatureSet& FeatureSet::operator=(const FeatureSet& other)
+{
+    if (this != &other)
+    {
+        FeatureSet copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+FeatureSet& FeatureSet::operator=(FeatureSet&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (store_) store_->release();
+        store_ = other.store_;
+        size_ = other.size_;
+        containers_ = std::move(other.containers_);
+        other.store_ = nullptr;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+/// Sorts the keys and appends them (the set must be empty)
+///
+void FeatureSet::build(std::vector<uint64_t>& keys)
+{
+    assert(containers_.empty());
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    for (uint64_t key : keys)
+    {
+        uint64_t high = key >> 16;
+        if (containers_.empty() || containers_.back().high != high)
+        {
+            containers_.emplace_back(high);
+        }
+        containers_.back().add(static_cast<uint16_t>(key));
+    }
+    size_ = keys.size();
+}
+
+size_t FeatureSet::memoryUsage() const
+{
+    size_t total = 0;
+    for (const Container& c : containers_) total += c.memoryUsage();
+    return total + (containers_.capacity() - containers_.size()) * sizeof(Container);
+}
+
+bool FeatureSet::addKey(uint64_t key)
+{
+    uint64_t high = key >> 16;
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), high,
+        [](const Container& c, uint64_t h) { return c.high < h; });
+    if (it == containers_.end() || it->high != high)
+    {
+        it = containers_.emplace(it, high);
+    }
+    if (!it->add(static_cast<uint16_t>(key))) return false;
+    size_++;
+    return true;
+}
+
+bool FeatureSet::containsKey(uint64_t key) const
+{
+    uint64_t high = key >> 16;
+    auto it = std::lower_bound(containers_.begin(), containers_.end(), high,
+        [](const Container& c, uint64_t h) { return c.high < h; });
+    return it != containers_.end() && it->high == high &&
+        it->contains(static_cast<uint16_t>(key));
+}
+
+void FeatureSet::unite(Container& a, const Container& b)
+{
+    if (!a.isBitmap() && !b.isBitmap())
+    {
+        std::vector<uint16_t> merged;
+        merged.reserve(a.values.size() + b.values.size());
+        std::set_union(a.values.begin(), a.values.end(),
+            b.values.begin(), b.values.end(), std::back_inserter(merged));
+        a.values = std::move(merged);
+    }
+    else
+    {
+        a.toBitmap();
+        if (b.isBitmap())
+        {
+            for (uint32_t i = 0; i < BITMAP_WORDS; i++) a.bits[i] |= b.bits[i];
+        }
+        else
+        {
+            for (uint16_t low : b.values) a.bits[low >> 6] |= uint64_t{1} << (low & 63);
+        }
+    }
+    a.normalize();
+}
+
+void FeatureSet::intersect(Container& a, const Container& b)
+{
+    if (a.isBitmap() && b.isBitmap())
+    {
+        for (uint32_t i = 0; i < BITMAP_WORDS; i++) a.bits[i] &= b.bits[i];
+    }
+    else if (a.isBitmap())
+    {
+        std::vector<uint16_t> common;
+        for (uint16_t low : b.values)
+        {
+            if (a.contains(low)) common.push_back(low);
+        }
+        a.bits.reset();
+        a.values = std::move(common);
+    }
+    else if (b.isBitmap())
+    {
+        std::erase_if(a.values, [&b](uint16_t low) { return !b.contains(low); });
+    }
+    else
+    {
+        std::vector<uint16_t> common;
+        std::set_intersection(a.values.begin(), a.values.end(),
+            b.values.begin(), b.values.end(), std::back_inserter(common));
+        a.values = std::move(common);
+    }
+    a.normalize();
+}
+
+void FeatureSet::subtract(Container& a, const Container& b)
+{
+    if (a.isBitmap())
+    {
+        if (b.isBitmap())
+        {
+            for (uint32_t i = 0; i < BITMAP_WORDS; i++) a.bits[i] &= ~b.bits[i];
+        }
+        else
+        {
+            for (uint16_t low : b.values) a.bits[low >> 6] &= ~(uint64_t{1} << (low & 63));
+        }
+    }
+    else
+    {
+        std::erase_if(a.values, [&b](uint16_t low) { return b.contains(low); });
+    }
+    a.normalize();
+}
+
+void FeatureSet::checkStore(const FeatureSet& other)
+{
+    if (other.store_ == store_ || other.store_ == nullptr) return;
+    if (store_ == nullptr)
+    {
+        store_ = other.store_;
+        store_->addref();
+        return;
+    }
+    throw QueryException("Can't combine sets of features from different stores");
+}
+
+void FeatureSet::removeEmpty()
+{
+    std::erase_if(containers_, [](const Container& c) { return c.count == 0; });
+    size_ = 0;
+    for (const Container& c : containers_) size_ += c.count;
+}
+
+FeatureSet& FeatureSet::operator|=(const FeatureSet& other)
+{
+    checkStore(other);
+    std::vector<Container> result;
+    result.reserve(containers_.size() + other.containers_.size());
+    auto a = containers_.begin();
+    auto b = other.containers_.begin();
+    while (a != containers_.end() || b != other.containers_.end())
+    {
+        if (b == other.containers_.end() || (a != containers_.end() && a->high < b->high))
+        {
+            result.push_back(std::move(*a++));
+        }
+        else if (a == containers_.end() || b->high < a->high)
+        {
+            result.push_back(*b++);
+        }
+        else
+        {
+            unite(*a, *b++);
+            result.push_back(std::move(*a++));
+        }
+    }
+    containers_ = std::move(result);
+    removeEmpty();
+    return *this;
+}
+
+FeatureSet& FeatureSet::operator&=(const FeatureSet& other)
+{
+    checkStore(other);
+    auto b = other.containers_.begin();
+    for (Container& a : containers_)
+    {
+        while (b != other.containers_.end() && b->high < a.high) b++;
+        if (b != other.containers_.end() && b->high == a.high)
+        {
+            intersect(a, *b);
+        }
+        else
+        {
+            a.count = 0;
+        }
+    }
+    removeEmpty();
+    return *this;
+}
+
+FeatureSet& FeatureSet::operator-=(const FeatureSet& other)
+{
+    checkStore(other);
+    auto b = other.containers_.begin();
+    for (Container& a : containers_)
+    {
+        while (b != other.containers_.end() && b->high < a.high) b++;
+        if (b != other.containers_.end() && b->high == a.high) subtract(a, *b);
+    }
+    removeEmpty();
+    return *this;
+}
+
+bool FeatureSet::operator==(const FeatureSet& other) const
+{
+    if (size_ != other.size_ || containers_.size() != other.containers_.size())
+    {
+        return false;
+    }
+    // Containers are normalized, so equal sets have the same representation
+    for (size_t i = 0; i < containers_.size(); i++)
+    {
+        const Container& a = containers_[i];
+        const Container& b = other.containers_[i];
+        if (a.high != b.high || a.count != b.count || a.values != b.values) return false;
+        if (a.isBitmap() && memcmp(a.bits.get(), b.bits.get(),
+            BITMAP_WORDS * sizeof(uint64_t)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+FeatureSet::Iterator::Iterator(const FeatureSet* set, bool atEnd) :
+    set_(set),
+    container_(atEnd ? set->containers_.size() : 0),
+    pos_(0),
+    key_(0)
+{
+    if (!atEnd) fetch();
+}
+
+FeatureSet::Iterator& FeatureSet::Iterator::operator++()
+{
+    pos_++;
+    fetch();
+    return *this;
+}
+
+/// Moves to the first value at or after the current position, and
+/// fetches its tile if it differs from the previous value's
+///
+void FeatureSet::Iterator::fetch()
+{
+    const std::vector<Container>& containers = set_->containers_;
+    for (; container_ < containers.size(); container_++, pos_ = 0)
+    {
+        const Container& c = containers[container_];
+        if (c.isBitmap())
+        {
+            uint32_t word = pos_ >> 6;
+            if (word >= BITMAP_WORDS) continue;
+            uint64_t bits = c.bits[word] & (~uint64_t{0} << (pos_ & 63));
+            while (bits == 0 && ++word < BITMAP_WORDS) bits = c.bits[word];
+            if (bits == 0) continue;
+            pos_ = word * 64 + std::countr_zero(bits);
+            key_ = (c.high << 16) | pos_;
+        }
+        else
+        {
+            if (pos_ >= c.values.size()) continue;
+            key_ = (c.high << 16) | c.values[pos_];
+        }
+        Tip tip = tipOf(key_);
+        if (tip != tip_)
+        {
+            pTile_ = set_->store_->fetchTile(tip);
+            tip_ = tip;
+        }
+        return;
+    }
+    pos_ = 0;
+}
+
+} // namespace geodesk
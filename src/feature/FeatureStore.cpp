@@ -2,9 +2,36 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/feature/FeatureStore.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <filesystem>
+#include <thread>
+#include <unordered_set>
+#include <clarisma/thread/GilRelease.h>
+#include <clarisma/thread/Threads.h>
 #include <clarisma/util/log.h>
 #include <clarisma/util/PbfDecoder.h>
+#include <clarisma/util/Tracer.h>
+#include <geodesk/feature/IdIndex.h>
+#include <geodesk/feature/NameIndex.h>
+#include <geodesk/feature/NumericIndex.h>
+#include <geodesk/feature/RelationTreeCache.h>
+#include <geodesk/feature/StringIndex.h>
+#include <geodesk/feature/TagSummary.h>
+#include <geodesk/feature/TileCompression.h>
+#include <geodesk/feature/TileReader.h>
+#include <geodesk/feature/TileStatistics.h>
+#include <geodesk/feature/WayNodeIndex.h>
+#include <geodesk/filter/PreparedFilterCache.h>
+#include <geodesk/geom/GeneralizedGeometry.h>
+#include <geodesk/geom/MeasureCache.h>
+#include <geodesk/geom/polygon/LabelPointCache.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include <geodesk/geom/polygon/RingStore.h>
+#include <geodesk/query/QueryCache.h>
+#include <geodesk/query/TileScanCache.h>
+#include <geodesk/query/TileIndexWalker.h>
 #ifdef GEODESK_PYTHON
 #include "python/feature/PyTags.h"
 #include "python/query/PyFeatures.h"
@@ -15,9 +42,6 @@ namespace geodesk {
 
 using namespace clarisma;
 
-// TODO: std::thread::hardware_concurrency() can return 0, so use
-// a default value in that case (e.g. 4 threads)
-
 // std::unordered_map<std::string, FeatureStore*> FeatureStore::openStores_;
 
 FeatureStore::FeatureStore()
@@ -27,24 +51,113 @@ FeatureStore::FeatureStore()
 	emptyTags_(nullptr),
 	emptyFeatures_(nullptr),
 	#endif
-	executor_(/* 1 */ std::thread::hardware_concurrency(), 0)  // TODO: disabled for testing
+	zoomLevels_(0)
 {
-}
+	metrics_.addCounter("geodesk_queries_started_total",
+		"Queries started", &counters_.queriesStarted);
+	metrics_.addCounter("geodesk_queries_finished_total",
+		"Queries finished (or abandoned)", &counters_.queriesFinished);
+	metrics_.addCounter("geodesk_tiles_scanned_total",
+		"Tiles scanned by queries", &counters_.tilesScanned);
+	metrics_.addCounter("geodesk_tile_bytes_total",
+		"Bytes of tile data scanned by queries", &counters_.tileBytes);
+	metrics_.addCounter("geodesk_matcher_cache_hits_total",
+		"Queries whose matcher was found in the cache",
+		[this]() { return matchers_.cacheStats().hits; });
+	metrics_.addCounter("geodesk_matcher_cache_misses_total",
+		"Queries whose matcher had to be compiled",
+		[this]() { return matchers_.cacheStats().misses; });
+	metrics_.addGauge("geodesk_executor_queue_depth",
+		"Tile scans waiting for an executor thread",
+		[this]()
+		{
+			QueryExecutor* executor = runningExecutor();
+			return executor ? static_cast<double>(executor->pendingTasks()) : 0.0;
+		});
+	metrics_.addCounter("geodesk_executor_tasks_total",
+		"Tasks run by the executor",
+		[this]()
+		{
+			QueryExecutor* executor = runningExecutor();
+			return executor ? executor->metrics().tasksRun.value() : 0;
+		});
+	metrics_.addHistogram("geodesk_executor_busy_seconds",
+		"Time an executor thread spent on a task",
+		[this]() -> const Histogram*
+		{
+			QueryExecutor* executor = runningExecutor();
+			return executor ? &executor->metrics().busyTime : nullptr;
+		});
+	metrics_.addHistogram("geodesk_executor_idle_seconds",
+		"Time an executor thread spent parked between tasks",
+		[this]() -> const Histogram*
+		{
+			QueryExecutor* executor = runningExecutor();
+			return executor ? &executor->metrics().idleTime : nullptr;
+		});
+	metrics_.addGauge("geodesk_query_memory_bytes",
+		"Memory held by active queries (result buckets and dedup sets)",
+		[this]() { return static_cast<double>(queryMemory_.load(std::memory_order_relaxed)); });
+	metrics_.addGauge("geodesk_cache_memory_bytes",
+		"Memory held by the caches of the store",
+		[this]()
+		{
+			MemoryUsage usage = memoryUsage();
+			return static_cast<double>(usage.total() - usage.queries);
+		});
 
-FeatureStore* FeatureStore::openSingle(std::string_view relativeFileName)
-{
-	std::filesystem::path path;
-	try
+	struct OpenPhase
 	{
-		path = std::filesystem::canonical(
-			(*File::extension(relativeFileName) != 0) ? relativeFileName :
-			std::string(relativeFileName) + ".gol");
-	}
-	catch (const std::filesystem::filesystem_error&)
+		const char* name;
+		const char* help;
+		uint64_t OpenTimes::* nanos;
+	};
+	static const OpenPhase OPEN_PHASES[] =
 	{
-		throw FileNotFoundException(std::string(relativeFileName));
+		{ "geodesk_open_seconds", "Time taken to open the store",
+			&OpenTimes::totalNanos },
+		{ "geodesk_open_resolve_seconds", "Time taken to find the file",
+			&OpenTimes::resolveNanos },
+		{ "geodesk_open_map_seconds", "Time taken to open and map the file",
+			&OpenTimes::mapNanos },
+		{ "geodesk_open_strings_seconds", "Time taken to set up the string table",
+			&OpenTimes::stringsNanos },
+		{ "geodesk_open_schema_seconds", "Time taken to read the index schema",
+			&OpenTimes::schemaNanos },
+		{ "geodesk_open_hints_seconds", "Time taken to apply the access hints",
+			&OpenTimes::hintsNanos },
+	};
+	for (const OpenPhase& phase : OPEN_PHASES)
+	{
+		uint64_t OpenTimes::* nanos = phase.nanos;
+		metrics_.addGauge(phase.name, phase.help,
+			[this, nanos]() { return static_cast<double>(openTimes_.*nanos) / 1e9; });
 	}
-	std::string fileName = path.string();
+}
+
+namespace {
+
+/// Returns the nanoseconds since `start`, and moves `start` to now
+uint64_t lap(std::chrono::steady_clock::time_point& start)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		now - start).count();
+	start = now;
+	return nanos;
+}
+
+} // namespace
+
+FeatureStore* FeatureStore::openSingle(std::string_view relativeFileName)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point phaseStart = start;
+	std::string fileName = resolvePath(relativeFileName);
+
+	// Opening a store (and waiting for another thread to do so) doesn't
+	// touch any Python objects, so let other Python threads run
+	GilRelease gil;
 
 	// The try-block must enclose the lock of the openStores mutex
 	// If creation of the new store fails, the FeatureStore object
@@ -56,18 +169,35 @@ FeatureStore* FeatureStore::openSingle(std::string_view relativeFileName)
 	try
 	{
 		std::lock_guard lock(getOpenStoresMutex());
-		auto openStores = getOpenStores();
+		auto& openStores = getOpenStores();
 
 		auto it = openStores.find(fileName);
-		if (it != openStores.end())
+		if (it != openStores.end() && it->second->tryAddref())
+		{
+			return it->second;
+		}
+		// If the name was given to another file by hotSwap(),
+		// we open that file instead
+		auto& swappedFiles = getSwappedFiles();
+		auto swapped = swappedFiles.find(fileName);
+		const std::string& path = swapped != swappedFiles.end() ?
+			swapped->second : fileName;
+		if (!std::filesystem::exists(path))
 		{
-			store = it->second;
-			store->addref();
-			return store;
+			throw FileNotFoundException(std::string(relativeFileName));
 		}
+		uint64_t resolveNanos = lap(phaseStart);
 		store = new FeatureStore();
-		store->open(fileName.data());
+		store->open(path.data());
+		store->openName_ = fileName;
 		openStores[fileName] = store;
+
+		OpenTimes& times = store->openTimes_;
+		times.resolveNanos = resolveNanos;
+		times.totalNanos = lap(start);
+		times.mapNanos = times.totalNanos - times.resolveNanos -
+			times.stringsNanos - times.schemaNanos - times.hintsNanos;
+			// (everything not measured by initialize())
 		return store;
 	}
 	catch (...)
@@ -77,11 +207,138 @@ FeatureStore* FeatureStore::openSingle(std::string_view relativeFileName)
 	}
 }
 
+std::string FeatureStore::resolvePath(std::string_view relativeFileName)
+{
+	try
+	{
+		// (weakly_canonical, as the name of a hot-swapped store
+		// need not exist)
+		return std::filesystem::weakly_canonical(
+			(*File::extension(relativeFileName) != 0) ? relativeFileName :
+			std::string(relativeFileName) + ".gol").string();
+	}
+	catch (const std::filesystem::filesystem_error&)
+	{
+		throw FileNotFoundException(std::string(relativeFileName));
+	}
+}
+
+
+/**
+ * The new store is opened and warmed without holding the lock of the
+ * open stores, so other threads can keep opening stores (including
+ * the one that is being replaced) in the meantime.
+ */
+FeatureStore* FeatureStore::hotSwap(std::string_view name,
+	std::string_view newFileName, const HotSwapOptions& options)
+{
+	std::string key = resolvePath(name);
+	std::string fileName = resolvePath(newFileName);
+	if (!std::filesystem::exists(fileName))
+	{
+		throw FileNotFoundException(std::string(newFileName));
+	}
+
+	GilRelease gil;
+	FeatureStore* store = new FeatureStore();
+	try
+	{
+		store->open(fileName.data());
+		store->populateIndexes();
+		if (options.warmHotTiles)
+		{
+			FeatureStore* old = nullptr;
+			{
+				std::lock_guard lock(getOpenStoresMutex());
+				auto& openStores = getOpenStores();
+				auto it = openStores.find(key);
+				if (it != openStores.end() && it->second->tryAddref())
+				{
+					old = it->second;
+				}
+			}
+			if (old)
+			{
+				store->warmTilesHotIn(old);
+				old->release();
+			}
+		}
+	}
+	catch (...)
+	{
+		delete store;
+		throw;
+	}
+
+	// From now on, openSingle() returns the new store (or opens its
+	// file once it has been closed); the old one
+	// stays open for as long as it is referenced (its destructor
+	// only unregisters itself if it is still the registered store)
+	std::lock_guard lock(getOpenStoresMutex());
+	store->openName_ = key;
+	getOpenStores()[key] = store;
+	if (key == fileName)
+	{
+		getSwappedFiles().erase(key);
+	}
+	else
+	{
+		getSwappedFiles()[key] = fileName;
+	}
+	return store;
+}
+
+
+void FeatureStore::warmTilesHotIn(FeatureStore* other)
+{
+	std::unordered_set<uint32_t> hotTiles;
+	TileIndexWalker otherWalker(other->tileIndex(), other->zoomLevels(),
+		Box::ofWorld(), nullptr);
+	while (otherWalker.next())
+	{
+		DataPtr pTile = other->mappedTile(otherWalker.currentTip());
+		MappedFile::Residency residency = MappedFile::residency(
+			pTile.ptr(), pTile.getUnsignedInt() & 0x3fff'ffff);
+		if (residency.residentBytes * 2 > residency.bytes)
+		{
+			hotTiles.insert(static_cast<uint32_t>(otherWalker.currentTile()));
+		}
+	}
+	if (hotTiles.empty()) return;
+
+	TileIndexWalker walker(tileIndex(), zoomLevels(), Box::ofWorld(), nullptr);
+	while (walker.next())
+	{
+		if (!hotTiles.contains(static_cast<uint32_t>(walker.currentTile()))) continue;
+		DataPtr pTile = mappedTile(walker.currentTip());
+		MappedFile::populate(pTile.ptr(), pTile.getUnsignedInt() & 0x3fff'ffff);
+	}
+}
+
+
 void FeatureStore::initialize()
 {
-	strings_.create(getPointer(STRING_TABLE_PTR_OFS));
+	std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+	stringIndex_ = StringIndex::open(fileName() + ".strings",
+		getLocalCreationTimestamp(), getTrueSize());
+	strings_.create(getPointer(STRING_TABLE_PTR_OFS), stringIndex_.get());
+	openTimes_.stringsNanos = lap(phaseStart);
 	zoomLevels_ = DataPtr(mainMapping() + ZOOM_LEVELS_OFS).getUnsignedInt();
 	readIndexSchema();
+	openTimes_.schemaNanos = lap(phaseStart);
+
+	AccessHints hints;
+	{
+		DefaultAccessHints& defaults = getDefaultAccessHints();
+		std::lock_guard lock(defaults.mutex);
+		hints = defaults.hints;
+	}
+	if (hints.pattern != MappedFile::AccessPattern::NORMAL ||
+		hints.populateIndexes || hints.hugePages)
+	{
+		setAccessHints(hints);
+	}
+	openTimes_.hintsNanos = lap(phaseStart);
 }
 
 FeatureStore::~FeatureStore()
@@ -94,46 +351,529 @@ FeatureStore::~FeatureStore()
 	LOG("Destroyed FeatureStore.");
 
 	std::lock_guard lock(getOpenStoresMutex());
-	auto openStores = getOpenStores();
-	openStores.erase(fileName());
+	auto& openStores = getOpenStores();
+	auto it = openStores.find(openName_);
+	if (it != openStores.end() && it->second == this) openStores.erase(it);
+		// (if openSingle() found this store while it was being
+		// destroyed, it will have replaced it with a new instance;
+		// likewise if the store has been replaced by hotSwap())
 }
 
 // TODO: Return TilePtr
 DataPtr FeatureStore::fetchTile(Tip tip)
+{
+	GEODESK_TRACE_SPAN("fetchTile", tip);
+	DataPtr pTile = mappedTile(tip);
+	if (TileCompression::isCompressed(pTile)) [[unlikely]]
+	{
+		return fetchCompressedTile(tip);
+	}
+	return pTile;
+}
+
+DataPtr FeatureStore::mappedTile(Tip tip)
 {
 	uint32_t pageEntry = (tileIndex() + (tip * 4)).getUnsignedInt();
 	// Bit 0 is a flag bit (page vs. child pointer)
-	// TODO: load tiles
-
 	return pagePointer(pageEntry >> 1);
 }
 
+DataPtr FeatureStore::fetchCompressedTile([[maybe_unused]] Tip tip)
+{
+	#ifdef GEODESK_WITH_ZLIB
+	{
+		std::lock_guard lock(residentTilesMutex_);
+		auto it = residentTiles_.find(tip);
+		if (it != residentTiles_.end()) return DataPtr(it->second.get());
+	}
 
+	// We decompress without holding the lock; if another thread
+	// decompresses the same tile in the meantime, we use its copy
+	const uint8_t* pBlob = mappedTile(tip).ptr();
+	std::unique_ptr<uint8_t[]> data(new uint8_t[TileCompression::uncompressedSize(pBlob)]);
+	tileCompression().decompress(pBlob, data.get());
+	std::lock_guard lock(residentTilesMutex_);
+	auto [it, inserted] = residentTiles_.try_emplace(tip, std::move(data));
+	return DataPtr(it->second.get());
+	#else
+	throw StoreException(fileName(), "Compressed tiles require zlib");
+	#endif
+}
 
-void FeatureStore::readIndexSchema()
+#ifdef GEODESK_WITH_ZLIB
+const TileCompression& FeatureStore::tileCompression()
+{
+	return *tileCompression_.get([this]()
+	{
+		return TileCompression::open(fileName() + ".zdict");
+	});
+}
+#endif
+
+uint64_t FeatureStore::tileOffset(Tip tip)
+{
+	uint32_t pageEntry = (tileIndex() + (tip * 4)).getUnsignedInt();
+	return pageOffset(pageEntry >> 1);
+}
+
+void FeatureStore::prefetchTile(Tip tip) noexcept
+{
+	try
+	{
+		prefetchBlob(mappedTile(tip));
+	}
+	catch (const IOException&)
+	{
+		// ignore, the tile will simply be paged in on demand
+	}
+}
+
+
+
+void FeatureStore::adviseTile(Tip tip, MappedFile::AccessPattern pattern) noexcept
+{
+	try
+	{
+		DataPtr pTile = mappedTile(tip);
+		uint32_t size = pTile.getUnsignedInt() & 0x3fff'ffff;
+		MappedFile::advise(pTile.ptr(), size, pattern);
+	}
+	catch (const IOException&)
+	{
+		// ignore, the hint is optional
+	}
+}
+
+
+void FeatureStore::setAccessHints(const AccessHints& hints) noexcept
+{
+	// A read-only store has a single mapping, which covers the whole
+	// file; the mappings that a writable store adds as it grows are
+	// left alone
+	MappedFile::advise(mainMapping(), mappingSize(0), hints.pattern);
+	if (hints.hugePages) MappedFile::adviseHugePages(mainMapping(), mappingSize(0));
+	if (hints.populateIndexes) populateIndexes();
+}
+
+void FeatureStore::populateIndexes() noexcept
 {
-	DataPtr p = getPointer(INDEX_SCHEMA_PTR_OFS);
-	int32_t count = p.getInt();
-	keysToCategories_.reserve(count);
-	for (int i = 0; i < count; i++)
+	MappedFile::populate(tileIndex().ptr(), tileIndexSize());
+	MappedFile::populate(getPointer(STRING_TABLE_PTR_OFS).ptr(), stringTableSize());
+}
+
+uint64_t FeatureStore::tileIndexSize() const
+{
+	// The tile index starts with the number of its entries
+	return (static_cast<uint64_t>(tileIndex().getUnsignedInt()) + 1) * 4;
+}
+
+uint64_t FeatureStore::stringTableSize() const
+{
+	uint32_t stringCount = strings_.stringCount();
+	if (stringCount <= 1) return 0;
+	const uint8_t* pStrings = getPointer(STRING_TABLE_PTR_OFS).ptr();
+	const ShortVarString* last = strings_.getGlobalString(
+		static_cast<int>(stringCount - 1));
+	return reinterpret_cast<const uint8_t*>(last->data()) + last->length() - pStrings;
+}
+
+
+uint64_t FeatureStore::warm(const Box& box, const Filter* filter,
+	QueryPriority priority, ProgressReporter* progress)
+{
+	// The tile index is tiny compared to the tiles, so we gather
+	// the tiles first; this way, we know how many there are
+	std::vector<Tip> tips;
+	TileIndexWalker walker(tileIndex(), zoomLevels(), box, filter);
+	while (walker.next()) tips.push_back(walker.currentTip());
+	if (tips.empty()) return 0;
+	if (progress) progress->start(tips.size());
+
+	std::atomic<size_t> nextTile = 0;
+	// Reads the next tile, returns false once all tiles are taken
+	auto readNext = [this, &tips, &nextTile](ProgressReporter::Batch& batch)
 	{
-		p += 4;
-		keysToCategories_.insert({ p.getUnsignedShort(), (p+2).getUnsignedShort() });
+		size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+		if (n >= tips.size()) return false;
+		try
+		{
+			DataPtr pTile = mappedTile(tips[n]);
+			MappedFile::populate(pTile.ptr(), pTile.getUnsignedInt() & 0x3fff'ffff);
+		}
+		catch (const IOException&)
+		{
+			// ignore, the tile will simply be paged in on demand
+		}
+		batch.progress(1);
+		return true;
+	};
+	auto readAll = [&readNext, progress]()
+	{
+		ProgressReporter::Batch batch(progress);
+		while (readNext(batch)) {}
+	};
+
+	int threadCount = priority == QueryPriority::INTERACTIVE ?
+		std::min(executor().threadCount(), static_cast<int>(tips.size())) : 1;
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (int i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back(readAll);
 	}
+	readAll();
+	for (std::thread& thread : threads) thread.join();
+	return tips.size();
 }
 
-int FeatureStore::getIndexCategory(int keyCode) const
+
+FeatureStore::ResidencyReport FeatureStore::residency(const Box& box, const Filter* filter)
 {
-	auto it = keysToCategories_.find(keyCode);
-	if (it != keysToCategories_.end())
+	ResidencyReport report;
+	report.tileIndex = MappedFile::residency(tileIndex().ptr(), tileIndexSize());
+	report.strings = MappedFile::residency(
+		getPointer(STRING_TABLE_PTR_OFS).ptr(), stringTableSize());
+	TileIndexWalker walker(tileIndex(), zoomLevels(), box, filter);
+	while (walker.next())
 	{
-		return it->second;
+		DataPtr pTile = mappedTile(walker.currentTip());
+		MappedFile::Residency tile = MappedFile::residency(
+			pTile.ptr(), pTile.getUnsignedInt() & 0x3fff'ffff);
+		int zoom = walker.currentTile().zoom();
+		report.tiles += tile;
+		report.tilesByZoom[zoom] += tile;
+		report.tileCount++;
+		report.tileCountByZoom[zoom]++;
+	}
+	return report;
+}
+
+
+uint64_t FeatureStore::evict(const Box& box, const Filter* filter)
+{
+	uint64_t count = 0;
+	TileIndexWalker walker(tileIndex(), zoomLevels(), box, filter);
+	while (walker.next())
+	{
+		DataPtr pTile = mappedTile(walker.currentTip());
+		MappedFile::evict(pTile.ptr(), pTile.getUnsignedInt() & 0x3fff'ffff);
+		count++;
+	}
+	return count;
+}
+
+
+FeatureStore::DefaultAccessHints& FeatureStore::getDefaultAccessHints()
+{
+	static DefaultAccessHints defaults;
+	return defaults;
+}
+
+
+void FeatureStore::configureAccessHints(const AccessHints& hints)
+{
+	DefaultAccessHints& defaults = getDefaultAccessHints();
+	std::lock_guard lock(defaults.mutex);
+	defaults.hints = hints;
+}
+
+
+const IdIndex& FeatureStore::idIndex()
+{
+	return *idIndex_.get([this]()
+	{
+		return std::make_unique<IdIndex>(this, fileName() + ".ids",
+			getLocalCreationTimestamp(), getTrueSize());
+	});
+}
+
+
+const TagSummary* FeatureStore::tagSummary()
+{
+	return tagSummary_.get([this]()
+	{
+		return TagSummary::open(fileName() + ".tags",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildTagSummary()
+{
+	TagSummary::build(this, fileName() + ".tags",
+		getLocalCreationTimestamp(), getTrueSize());
+}
+
+
+const TileStatistics* FeatureStore::tileStatistics()
+{
+	return tileStatistics_.get([this]()
+	{
+		return TileStatistics::open(fileName() + ".stats",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildTileStatistics(int threads)
+{
+	TileStatistics::build(this, fileName() + ".stats",
+		getLocalCreationTimestamp(), getTrueSize(), threads);
+}
+
+
+const RingStore* FeatureStore::ringStore()
+{
+	return ringStore_.get([this]()
+	{
+		return RingStore::open(fileName() + ".rings",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildRingStore(int threads)
+{
+	RingStore::build(this, fileName() + ".rings",
+		getLocalCreationTimestamp(), getTrueSize(), threads);
+}
+
+
+const GeneralizedGeometry* FeatureStore::generalizedGeometry()
+{
+	return generalizedGeometry_.get([this]()
+	{
+		return GeneralizedGeometry::open(fileName() + ".generalized",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildGeneralizedGeometry(int threads)
+{
+	GeneralizedGeometry::build(this, fileName() + ".generalized",
+		getLocalCreationTimestamp(), getTrueSize(), threads);
+}
+
+
+const NameIndex* FeatureStore::nameIndex()
+{
+	return nameIndex_.get([this]()
+	{
+		return NameIndex::open(fileName() + ".names",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildNameIndex(int threads)
+{
+	NameIndex::build(this, fileName() + ".names",
+		getLocalCreationTimestamp(), getTrueSize(), threads);
+}
+
+
+const NumericIndex* FeatureStore::numericIndex()
+{
+	return numericIndex_.get([this]()
+	{
+		return NumericIndex::open(fileName() + ".numbers",
+			getLocalCreationTimestamp(), getTrueSize());
+	}).get();
+}
+
+
+void FeatureStore::buildNumericIndex(const std::vector<std::string>& keys, int threads)
+{
+	NumericIndex::build(this, fileName() + ".numbers",
+		getLocalCreationTimestamp(), getTrueSize(), keys, threads);
+}
+
+
+bool FeatureStore::buildStringIndex()
+{
+	return StringIndex::build(strings_, fileName() + ".strings",
+		getLocalCreationTimestamp(), getTrueSize());
+}
+
+
+void FeatureStore::enableQueryCache(size_t maxBytes)
+{
+	queryCache_.reset(maxBytes ? new QueryCache(maxBytes) : nullptr);
+}
+
+
+void FeatureStore::enableTileReader(size_t maxBytes)
+{
+	tileReader_.reset(maxBytes ? new TileReader(this, maxBytes) : nullptr);
+}
+
+
+void FeatureStore::enableTileScanCache(size_t maxBytes, uint32_t minScans)
+{
+	tileScanCache_.reset(maxBytes ? new TileScanCache(maxBytes, minScans) : nullptr);
+}
+
+
+TileScanCache* FeatureStore::tileScanCache()
+{
+	if (!tileScanCache_) return nullptr;
+	tileScanCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return tileScanCache_.get();
+}
+
+
+void FeatureStore::enableWayNodeIndex(size_t maxBytes)
+{
+	wayNodeIndex_.reset(maxBytes ? new WayNodeIndex(maxBytes) : nullptr);
+}
+
+
+WayNodeIndex* FeatureStore::wayNodeIndex()
+{
+	if (!wayNodeIndex_) return nullptr;
+	wayNodeIndex_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return wayNodeIndex_.get();
+}
+
+
+void FeatureStore::enableRingCache(size_t maxBytes)
+{
+	ringCache_.reset(maxBytes ? new RingCache(maxBytes) : nullptr);
+}
+
+
+RingCache* FeatureStore::ringCache()
+{
+	if (!ringCache_) return nullptr;
+	ringCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return ringCache_.get();
+}
+
+
+void FeatureStore::enableMeasureCache(size_t maxBytes)
+{
+	measureCache_.reset(maxBytes ? new MeasureCache(maxBytes) : nullptr);
+}
+
+
+MeasureCache* FeatureStore::measureCache()
+{
+	if (!measureCache_) return nullptr;
+	measureCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return measureCache_.get();
+}
+
+
+void FeatureStore::enableLabelPointCache(size_t maxBytes)
+{
+	labelPointCache_.reset(maxBytes ? new LabelPointCache(maxBytes) : nullptr);
+}
+
+
+LabelPointCache* FeatureStore::labelPointCache()
+{
+	if (!labelPointCache_) return nullptr;
+	labelPointCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return labelPointCache_.get();
+}
+
+
+void FeatureStore::enableRelationTreeCache(size_t maxBytes, size_t minLeaves)
+{
+	relationTreeCache_.reset(maxBytes ? new RelationTreeCache(maxBytes, minLeaves) : nullptr);
+}
+
+
+RelationTreeCache* FeatureStore::relationTreeCache()
+{
+	if (!relationTreeCache_) return nullptr;
+	relationTreeCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return relationTreeCache_.get();
+}
+
+
+void FeatureStore::enablePreparedFilterCache(size_t maxBytes)
+{
+	preparedFilterCache_.reset(maxBytes ? new PreparedFilterCache(maxBytes) : nullptr);
+}
+
+
+PreparedFilterCache* FeatureStore::preparedFilterCache()
+{
+	if (!preparedFilterCache_) return nullptr;
+	preparedFilterCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return preparedFilterCache_.get();
+}
+
+
+QueryCache* FeatureStore::queryCache()
+{
+	if (!queryCache_) return nullptr;
+	queryCache_->validate(getLocalCreationTimestamp(), getTrueSize());
+	return queryCache_.get();
+}
+
+
+FeatureStore::MemoryUsage FeatureStore::memoryUsage()
+{
+	MemoryUsage usage;
+	usage.queries = queryMemory_.load(std::memory_order_relaxed);
+	if (queryCache_) usage.queryCache = queryCache_->bytes();
+	if (ringCache_) usage.ringCache = ringCache_->bytes();
+	if (measureCache_) usage.measureCache = measureCache_->bytes();
+	if (labelPointCache_) usage.labelPointCache = labelPointCache_->bytes();
+	if (relationTreeCache_) usage.relationTreeCache = relationTreeCache_->bytes();
+	if (preparedFilterCache_) usage.preparedFilterCache = preparedFilterCache_->bytes();
+	if (wayNodeIndex_) usage.wayNodeIndex = wayNodeIndex_->bytes();
+	if (tileReader_) usage.tileReader = tileReader_->bytesCached();
+	if (tileScanCache_) usage.tileScanCache = tileScanCache_->bytes();
+	return usage;
+}
+
+
+const Box& FeatureStore::coverage()
+{
+	return coverage_.get([this]()
+	{
+		Box coverage;
+		TileIndexWalker walker(tileIndex(), zoomLevels(), Box::ofWorld(), nullptr);
+		if (walker.next())
+		{
+			do
+			{
+				coverage.expandToIncludeSimple(walker.currentTile().bounds());
+			}
+			while (walker.next());
+		}
+		return coverage;
+	});
+}
+
+
+void FeatureStore::readIndexSchema()
+{
+	DataPtr pSchema = getPointer(INDEX_SCHEMA_PTR_OFS);
+	int32_t count = pSchema.getInt();
+	uint32_t maxKey = 0;
+	for (int i = 1; i <= count; i++)
+	{
+		maxKey = std::max<uint32_t>(maxKey, (pSchema + i * 4).getUnsignedShort());
+	}
+	// Index categories (at most 30) fit into a byte, so the table
+	// of a typical schema spans only a few cache lines
+	keyCategories_.assign(count > 0 ? maxKey + 1 : 0, 0);
+	for (int i = 1; i <= count; i++)
+	{
+		DataPtr p = pSchema + i * 4;
+		keyCategories_[p.getUnsignedShort()] =
+			static_cast<uint8_t>((p+2).getUnsignedShort());
 	}
-	return 0;
 }
 
 const MatcherHolder* FeatureStore::getMatcher(const char* query)
 {
+	GilRelease gil;		// (compiling doesn't touch any Python objects)
 	return matchers_.getMatcher(query);
 }
 
@@ -169,10 +909,60 @@ std::unordered_map<std::string, FeatureStore*>& FeatureStore::getOpenStores()
 	return openStores;
 }
 
+std::unordered_map<std::string, std::string>& FeatureStore::getSwappedFiles()
+{
+	static std::unordered_map<std::string, std::string> swappedFiles;
+	return swappedFiles;
+}
+
 std::mutex& FeatureStore::getOpenStoresMutex()
 {
 	static std::mutex openStoresMutex;
 	return openStoresMutex;
 }
 
+FeatureStore::SharedExecutor& FeatureStore::getSharedExecutor()
+{
+	static SharedExecutor sharedExecutor;
+	return sharedExecutor;
+}
+
+std::shared_ptr<QueryExecutor> FeatureStore::sharedExecutor()
+{
+	SharedExecutor& shared = getSharedExecutor();
+	std::lock_guard lock(shared.mutex);
+	if (!shared.executor)
+	{
+		const ExecutorSettings& settings = shared.settings;
+		shared.executor = std::make_shared<QueryExecutor>(
+			settings.threadCount ? settings.threadCount : Threads::hardwareConcurrency(),
+			settings.queueSize, settings.pinThreads,
+			settings.numa ? Threads::numaNodes() : QueryExecutor::CpuSets());
+	}
+	return shared.executor;
+}
+
+QueryExecutor* FeatureStore::startExecutor()
+{
+	std::lock_guard lock(executorMutex_);
+	if (!executor_) executor_ = sharedExecutor();
+	runningExecutor_.store(executor_.get(), std::memory_order_release);
+	return executor_.get();
+}
+
+void FeatureStore::setExecutor(std::shared_ptr<QueryExecutor> executor)
+{
+	std::lock_guard lock(executorMutex_);
+	executor_ = std::move(executor);
+	runningExecutor_.store(executor_.get(), std::memory_order_release);
+}
+
+void FeatureStore::configureSharedExecutor(const ExecutorSettings& settings)
+{
+	SharedExecutor& shared = getSharedExecutor();
+	std::lock_guard lock(shared.mutex);
+	shared.settings = settings;
+	shared.executor.reset();	// started lazily with the new settings
+}
+
 } // namespace geodesk
@@ -2,7 +2,11 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/feature/FeatureStore_v2.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <filesystem>
+#include <thread>
 #include <clarisma/util/log.h>
 #include <clarisma/util/PbfDecoder.h>
 #ifdef GEODESK_PYTHON
@@ -89,6 +93,7 @@ void FeatureStore::initialize()
 FeatureStore::~FeatureStore()
 {
 	LOG("Destroying FeatureStore...");
+	freeRetiredBlobs();
 	#ifdef GEODESK_PYTHON
 	Py_XDECREF(emptyTags_);
 	Py_XDECREF(emptyFeatures_);
@@ -100,38 +105,204 @@ FeatureStore::~FeatureStore()
 	openStores.erase(fileName());
 }
 
+/// Frees the blobs of replaced tiles that are still retired when the
+/// store is closed. The list of retired blobs only lives in memory, so
+/// they would otherwise leak in the file; since no reader is left, the
+/// commit reclaims all of them.
+///
+void FeatureStore::freeRetiredBlobs() noexcept
+{
+	if (retiredBlobs_.empty()) return;
+	try
+	{
+		Transaction tx(this);
+		tx.begin();
+		tx.commit();
+		tx.end();
+	}
+	catch (const std::exception& ex)
+	{
+		LOG("Failed to free retired blobs: %s", ex.what());
+	}
+}
+
 // TODO: Return TilePtr
 DataPtr FeatureStore::fetchTile(Tip tip)
 {
-	uint32_t pageEntry = (tileIndex() + (tip * 4)).getUnsignedInt();
-	// Bit 0 is a flag bit (page vs. child pointer)
-	// TODO: load tiles
+	TileIndexEntry entry = tileIndexEntry(tip);
+	if (entry.status() == TileIndexEntry::MISSING_OR_STALE && tileSource_)
+	{
+		return loadTile(tip);
+	}
+	return pagePointer(entry.page());
+}
+
 
-	return pagePointer(pageEntry >> 1);
+void FeatureStore::setTileSource(std::shared_ptr<TileSource> source,
+	int maxConcurrentFetches)
+{
+	tileSource_ = std::move(source);
+	maxConcurrentFetches_ = std::max(maxConcurrentFetches, 1);
 }
 
 
+DataPtr FeatureStore::loadTile(Tip tip)
+{
+	{
+		std::unique_lock lock(loadMutex_);
+		for (;;)
+		{
+			TileIndexEntry entry = tileIndexEntry(tip);
+			if (entry.status() != TileIndexEntry::MISSING_OR_STALE)
+			{
+				// Another thread has installed the tile in the meantime
+				return pagePointer(entry.page());
+			}
+			if (!tilesInFlight_.contains(tip) &&
+				tilesInFlight_.size() < static_cast<size_t>(maxConcurrentFetches_))
+			{
+				tilesInFlight_.insert(tip);
+				break;
+			}
+			fetchDone_.wait(lock);
+		}
+	}
 
-void FeatureStore::readIndexSchema()
+	// Whether the fetch succeeds or not, we let the threads
+	// that wait for a slot (or for this tile) try again
+	struct FetchSlot
+	{
+		FeatureStore* store;
+		Tip tip;
+
+		~FetchSlot()
+		{
+			std::lock_guard lock(store->loadMutex_);
+			store->tilesInFlight_.erase(tip);
+			store->fetchDone_.notify_all();
+		}
+	};
+	FetchSlot slot{ this, tip };
+
+	ByteBlock data = tileSource_->fetchTile(tip);
+	installTile(tip, ByteSpan(data.data(), data.size()));
+	return pagePointer(tileIndexEntry(tip).page());
+}
+
+
+void FeatureStore::installTile(Tip tip, ByteSpan data)
 {
-	DataPtr p(mainMapping() + header()->indexSchemaPtr);
-	int32_t count = p.getInt();
-	keysToCategories_.reserve(count);
-	for (int i = 0; i < count; i++)
+	PendingTile tile{ tip, data, false, nullptr };
+	std::unique_lock lock(commitMutex_);
+	pendingTiles_.push_back(&tile);
+	while (!tile.committed)
 	{
-		p += 4;
-		keysToCategories_.insert({ p.getUnsignedShort(), (p+2).getUnsignedShort() });
+		if (committing_)
+		{
+			tilesCommitted_.wait(lock);
+		}
+		else
+		{
+			commitPendingTiles(lock);
+		}
+	}
+	if (tile.error) std::rethrow_exception(tile.error);
+}
+
+
+/// Commits all pending tiles in a single transaction. Must be called
+/// with the lock on commitMutex_ held; the lock is released while the
+/// transaction is open, so other threads can submit further tiles.
+///
+void FeatureStore::commitPendingTiles(std::unique_lock<std::mutex>& lock)
+{
+	std::vector<PendingTile*> group;
+	group.swap(pendingTiles_);
+	committing_ = true;
+	lock.unlock();
+
+	std::exception_ptr error;
+	try
+	{
+		Transaction tx(this);
+		tx.begin();
+		for (PendingTile* tile : group)
+		{
+			tx.addTile(tile->tip, tile->data);
+		}
+		tx.commit();
+		tx.end();
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	lock.lock();
+	committing_ = false;
+	for (PendingTile* tile : group)
+	{
+		tile->error = error;
+		tile->committed = true;
 	}
+	tilesCommitted_.notify_all();
+}
+
+
+size_t FeatureStore::prefetchTiles(const std::vector<Tip>& tips)
+{
+	if (!tileSource_) return 0;
+	std::atomic<size_t> next = 0;
+	std::atomic<size_t> fetched = 0;
+	std::exception_ptr error;
+	std::mutex errorMutex;
+
+	// Each thread takes the next tile in walk order, so the tiles
+	// arrive roughly in the order in which a query will scan them
+	auto work = [this, &tips, &next, &fetched, &error, &errorMutex]()
+	{
+		for (;;)
+		{
+			size_t n = next.fetch_add(1, std::memory_order_relaxed);
+			if (n >= tips.size()) return;
+			if (tileIndexEntry(tips[n]).status() != TileIndexEntry::MISSING_OR_STALE) continue;
+			try
+			{
+				loadTile(tips[n]);
+				fetched.fetch_add(1, std::memory_order_relaxed);
+			}
+			catch (...)
+			{
+				std::lock_guard lock(errorMutex);
+				if (!error) error = std::current_exception();
+				next.store(tips.size(), std::memory_order_relaxed);
+			}
+		}
+	};
+
+	int threadCount = std::min(maxConcurrentFetches_, static_cast<int>(tips.size()));
+	std::vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++) threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads) thread.join();
+	if (error) std::rethrow_exception(error);
+	return fetched;
 }
 
-int FeatureStore::getIndexCategory(int keyCode) const
+
+
+void FeatureStore::readIndexSchema()
 {
-	auto it = keysToCategories_.find(keyCode);
-	if (it != keysToCategories_.end())
+	DataPtr p(mainMapping() + header()->indexSchemaPtr);
+	int32_t count = p.getInt();
+	keyCategories_.clear();
+	for (int i = 0; i < count; i++)
 	{
-		return it->second;
+		p += 4;
+		uint16_t key = p.getUnsignedShort();
+		if (key >= keyCategories_.size()) keyCategories_.resize(key + 1);
+		keyCategories_[key] = static_cast<uint8_t>((p+2).getUnsignedShort());
 	}
-	return 0;
 }
 
 /* // TODO: re-enable
@@ -187,8 +358,51 @@ void FeatureStore::Transaction::addTile(Tip tip, ByteSpan data)
 {
 	PageNum page = addBlob(data);
 	MutableDataPtr ptr = dataPtr(tileIndexOfs_ + tip * 4);
-	assert(ptr.getUnsignedInt() == 0);
-	ptr.putUnsignedInt(TileIndexEntry(page, TileIndexEntry::CURRENT));
+	TileIndexEntry oldEntry(ptr.getUnsignedInt());
+	assert(oldEntry.status() == TileIndexEntry::MISSING_OR_STALE);
+	// Queries may still be reading the blob of a stale tile,
+	// so we can't free it right away
+	if (oldEntry.page() != 0) replacedBlobs_.push_back(oldEntry.page());
+	// commit() publishes the journaled copy of the entry, but readers
+	// see the entry right away if its block isn't journaled, so it must
+	// never become visible before the tile it points to
+	std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t*>(ptr.ptr())).store(
+		TileIndexEntry(page, TileIndexEntry::CURRENT), std::memory_order_release);
+}
+
+
+void FeatureStore::Transaction::commit()
+{
+	// Free the blobs retired by earlier transactions whose readers
+	// have all finished
+	std::vector<RetiredBlob>& retired = store()->retiredBlobs_;
+	if (!retired.empty())
+	{
+		clarisma::EpochManager::Epoch oldest = store()->epochs_.oldestActive();
+		auto reclaimable = std::partition(retired.begin(), retired.end(),
+			[oldest](const RetiredBlob& blob) { return blob.epoch >= oldest; });
+		for (auto it = reclaimable; it != retired.end(); ++it)
+		{
+			free(it->page);
+		}
+		retired.erase(reclaimable, retired.end());
+	}
+
+	// This publishes the updated tile index entries (with release
+	// semantics) after the tiles themselves have been written
+	BlobStore::Transaction::commit();
+
+	// Readers that pinned the current (or an earlier) epoch may have
+	// found the replaced blobs before we published the new entries
+	if (!replacedBlobs_.empty())
+	{
+		clarisma::EpochManager::Epoch epoch = store()->epochs_.retire();
+		for (PageNum page : replacedBlobs_)
+		{
+			retired.push_back({ page, epoch });
+		}
+		replacedBlobs_.clear();
+	}
 }
 
 
@@ -209,13 +423,15 @@ void FeatureStore::CreateTransaction::begin(const char* filename,
 	memcpy(mainMapping + tileIndexOfs, tileIndex, tileIndexSize);
 	size_t stringTableOfs = HEADER_BLOCK_SIZE + tileIndexSize;
 	memcpy(mainMapping + stringTableOfs, stringTable, stringTableSize);
+	// The index schema is empty (no keys are indexed)
+	size_t indexSchemaOfs = (stringTableOfs + stringTableSize + 3) & ~3;
+	memset(mainMapping + indexSchemaOfs, 0, 4);
 
 	header->tileIndexPtr = static_cast<int>(tileIndexOfs);
 	header->stringTablePtr = static_cast<int>(stringTableOfs);
-	header->tileIndexPtr = static_cast<int>(tileIndexOfs);
+	header->indexSchemaPtr = static_cast<int>(indexSchemaOfs);
 	tileIndexOfs_ = static_cast<uint32_t>(tileIndexOfs);
-	setMetadataSize(header, HEADER_BLOCK_SIZE +
-		tileIndexSize + stringTableSize);
+	setMetadataSize(header, indexSchemaOfs + 4);
 }
 
 } // namespace geodesk
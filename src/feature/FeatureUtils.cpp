@@ -4,21 +4,678 @@
 #include <geodesk/feature/FeatureUtils.h>
 #include <clarisma/text/Format.h>
 #include <clarisma/util/StringBuilder.h>
+#include <clarisma/util/Strings.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <geodesk/feature/FeatureIterator.h>
+#include <geodesk/feature/FlatCoordinates.h>
+#include <geodesk/feature/GroupBy.h>
+#include <geodesk/feature/IdIndex.h>
+#include <geodesk/feature/LineMerger.h>
+#include <geodesk/feature/NameIndex.h>
+#include <geodesk/feature/NumericIndex.h>
+#include <geodesk/feature/TagColumns.h>
 #include <geodesk/feature/Tags.h>
+#include <geodesk/feature/TileStatistics.h>
 #include <geodesk/feature/View.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/feature/WayGraphBuilder.h>
+#include <geodesk/filter/ComboFilter.h>
+#include <geodesk/geom/GeneralizedGeometry.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include <geodesk/query/QueryRecorder.h>
+#include "geom/polygon/Ring.h"
+#include "geom/polygon/RingCoordinateIterator.h"
 
 using namespace clarisma;
 
 namespace geodesk {
 
+/// Counts features as the worker threads find them, without
+/// creating any result buckets (except for potential duplicates,
+/// which the Query returns to us after deduplication)
+///
+class CountingReducer : public TileReducer
+{
+public:
+    void reduce(FeatureStore*, const FeaturePtr*, size_t count) override
+    {
+        count_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    bool countsOnly() const override { return true; }
+
+    void reduceCount(uint64_t count) override
+    {
+        count_.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> count_ {0};
+};
+
+/// Collects the number of features of each sampled tile, so we can
+/// estimate both the total and its variance
+///
+class EstimatingReducer : public TileReducer
+{
+public:
+    void reduce(FeatureStore*, const FeaturePtr*, size_t) override {}
+    bool countsOnly() const override { return true; }
+
+    void endTile(uint64_t count) override
+    {
+        double n = static_cast<double>(count);
+        std::lock_guard lock(mutex_);
+        sum_ += n;
+        sumSquares_ += n * n;
+    }
+
+    double sum() const { return sum_; }
+    double sumSquares() const { return sumSquares_; }
+
+private:
+    std::mutex mutex_;
+    double sum_ = 0;
+    double sumSquares_ = 0;
+};
+
+/// Looks up the tags selected by Features::select() on the worker
+/// threads, with one pass over the tag table of each feature. Keys are
+/// resolved once, deduplicated and sorted the way
+/// TagTablePtr::getKeyValues() expects them.
+///
+class TagProjector : public TileReducer
+{
+public:
+    TagProjector(FeatureStore* store, TagColumns& result) :
+        result_(result)
+    {
+        size_t columnCount = result.keys_.size();
+        std::vector<Key> keys;
+        for (const std::string& k : result.keys_) keys.push_back(store->key(k));
+        std::vector<Key> sorted = keys;
+        std::sort(sorted.begin(), sorted.end(), [](const Key& a, const Key& b)
+        {
+            // global keys (in order of their codes) before local keys
+            if ((a.code() < 0) != (b.code() < 0)) return a.code() >= 0;
+            if (a.code() >= 0) return a.code() < b.code();
+            return std::string_view(a) < std::string_view(b);
+        });
+        sorted.erase(std::unique(sorted.begin(), sorted.end(),
+            [](const Key& a, const Key& b)
+            {
+                return a.code() == b.code() &&
+                    std::string_view(a) == std::string_view(b);
+            }), sorted.end());
+        keys_ = std::move(sorted);
+        valueOf_.resize(columnCount);
+        for (size_t col = 0; col < columnCount; col++)
+        {
+            const Key& key = keys[col];
+            valueOf_[col] = static_cast<uint32_t>(std::find_if(keys_.begin(), keys_.end(),
+                [&key](const Key& k)
+                {
+                    return k.code() == key.code() &&
+                        std::string_view(k) == std::string_view(key);
+                }) - keys_.begin());
+        }
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        size_t columnCount = valueOf_.size();
+        std::vector<TagValue> cells(count * columnCount);
+        for (size_t i = 0; i < count; i++)
+        {
+            project(store, features[i], &cells[i * columnCount]);
+        }
+        std::lock_guard lock(mutex_);
+        for (size_t i = 0; i < count; i++)
+        {
+            result_.features_.emplace_back(store, features[i]);
+            for (size_t col = 0; col < columnCount; col++)
+            {
+                result_.columns_[col].push_back(cells[i * columnCount + col]);
+            }
+        }
+    }
+
+    /// Adds a feature from the calling thread (which must not
+    /// run concurrently with the workers)
+    void add(const Feature& feature)
+    {
+        size_t columnCount = valueOf_.size();
+        result_.features_.push_back(feature);
+        if (feature.isAnonymousNode())
+        {
+            for (size_t col = 0; col < columnCount; col++)
+            {
+                result_.columns_[col].emplace_back();
+            }
+            return;
+        }
+        std::vector<TagValue> cells(columnCount);
+        project(feature.store(), feature.ptr(), cells.data());
+        for (size_t col = 0; col < columnCount; col++)
+        {
+            result_.columns_[col].push_back(cells[col]);
+        }
+    }
+
+private:
+    static constexpr size_t MAX_STACK_KEYS = 32;
+
+    void project(FeatureStore* store, FeaturePtr feature, TagValue* row) const
+    {
+        TagTablePtr tags = feature.tags();
+        size_t keyCount = keys_.size();
+        TagBits stackValues[MAX_STACK_KEYS];
+        std::vector<TagBits> heapValues;
+        TagBits* values = stackValues;
+        if (keyCount > MAX_STACK_KEYS) [[unlikely]]
+        {
+            heapValues.resize(keyCount);
+            values = heapValues.data();
+        }
+        tags.getKeyValues(keys_.data(), keyCount, values);
+        for (size_t col = 0; col < valueOf_.size(); col++)
+        {
+            row[col] = tags.tagValue(values[valueOf_[col]], store->strings());
+        }
+    }
+
+    TagColumns& result_;
+    std::vector<Key> keys_;             // deduplicated and sorted
+    std::vector<uint32_t> valueOf_;     // column -> index into keys_
+    std::mutex mutex_;
+};
+
+/// Tallies the features of Features::groupBy() by the value of a tag,
+/// on the worker threads. Values are identified by a 64-bit ID: the
+/// global-string code or the raw number (tagged with its type, like a
+/// TagValue), or the hash of a local string (whose first occurrence is
+/// remembered, so colliding strings can be told apart). Each worker
+/// takes a partial tally from a pool for the duration of a batch, so
+/// tallies are only shared at the end, when merge() creates the
+/// strings of the final groups.
+///
+class TagGrouper : public TileReducer
+{
+public:
+    TagGrouper(FeatureStore* store, std::string_view key,
+        const std::function<double(const Feature&)>* measure) :
+        key_(store->key(key)),
+        measure_(measure)
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        Tally* tally = acquire();
+        for (size_t i = 0; i < count; i++)
+        {
+            add(*tally, store, features[i]);
+        }
+        release(tally);
+    }
+
+    /// Adds a feature from the calling thread (which must not
+    /// run concurrently with the workers)
+    void add(const Feature& feature)
+    {
+        if (feature.isAnonymousNode()) return;
+        Tally* tally = acquire();
+        add(*tally, feature.store(), feature.ptr());
+        release(tally);
+    }
+
+    std::vector<TagGroup> merge(FeatureStore* store)
+    {
+        std::unordered_map<std::string, TagGroup> merged;
+        for (const std::unique_ptr<Tally>& tally : tallies_)
+        {
+            for (const auto& [id, group] : tally->groups)
+            {
+                mergeGroup(merged, valueString(store, id, group.localString), group);
+            }
+            for (const auto& [value, group] : tally->collisions)
+            {
+                mergeGroup(merged, value, group);
+            }
+        }
+        std::vector<TagGroup> groups;
+        groups.reserve(merged.size());
+        for (auto& [value, group] : merged) groups.push_back(std::move(group));
+        std::sort(groups.begin(), groups.end(), [](const TagGroup& a, const TagGroup& b)
+        {
+            return a.count != b.count ? a.count > b.count : a.value < b.value;
+        });
+        return groups;
+    }
+
+private:
+    struct Group
+    {
+        std::string_view localString;
+        uint64_t count = 0;
+        double sum = 0;
+    };
+
+    struct Tally
+    {
+        std::unordered_map<uint64_t, Group> groups;
+        std::unordered_map<std::string, Group> collisions;
+    };
+
+    Tally* acquire()
+    {
+        std::lock_guard lock(mutex_);
+        if (idle_.empty())
+        {
+            tallies_.push_back(std::make_unique<Tally>());
+            return tallies_.back().get();
+        }
+        Tally* tally = idle_.back();
+        idle_.pop_back();
+        return tally;
+    }
+
+    void release(Tally* tally)
+    {
+        std::lock_guard lock(mutex_);
+        idle_.push_back(tally);
+    }
+
+    void add(Tally& tally, FeatureStore* store, FeaturePtr feature) const
+    {
+        TagTablePtr tags = feature.tags();
+        TagBits value = tags.getKeyValue(key_);
+        if (value == 0) return;
+        double amount = measure_ ? (*measure_)(Feature(store, feature)) : 0;
+        int type = static_cast<int>(value) & 3;
+        Group* group;
+        if (type == TagValueType::LOCAL_STRING)
+        {
+            TagValue v = tags.tagValue(value, store->strings());
+            std::string_view str = v.stringValue_;
+            uint64_t id = (static_cast<uint64_t>(Strings::hash(str.data(),
+                str.size())) << 2) | TagValueType::LOCAL_STRING;
+            auto [it, isNew] = tally.groups.try_emplace(id);
+            group = &it->second;
+            if (isNew)
+            {
+                group->localString = str;
+            }
+            else if (group->localString != str) [[unlikely]]
+            {
+                group = &tally.collisions[std::string(str)];
+            }
+        }
+        else if (type == TagValueType::WIDE_NUMBER)
+        {
+            group = &tally.groups[tags.tagValue(value, store->strings()).taggedNumberValue_];
+        }
+        else
+        {
+            // global-string code or narrow number
+            group = &tally.groups[((static_cast<uint32_t>(value) >> 16) << 2) | type];
+        }
+        group->count++;
+        group->sum += amount;
+    }
+
+    static std::string valueString(FeatureStore* store, uint64_t id,
+        std::string_view localString)
+    {
+        switch (id & 3)
+        {
+        case TagValueType::GLOBAL_STRING:
+            return store->strings().getGlobalString(static_cast<int>(id >> 2))->toString();
+        case TagValueType::LOCAL_STRING:
+            return std::string(localString);
+        default:
+            return TagValue(id);
+        }
+    }
+
+    static void mergeGroup(std::unordered_map<std::string, TagGroup>& merged,
+        const std::string& value, const Group& group)
+    {
+        TagGroup& g = merged[value];
+        g.count += group.count;
+        g.sum += group.sum;
+    }
+
+    Key key_;
+    const std::function<double(const Feature&)>* measure_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Tally>> tallies_;
+    std::vector<Tally*> idle_;
+};
+
+/// Decodes the coordinates of ways (and measures their segments)
+/// on the worker threads, leaving only the stitching to the end
+///
+class WayGraphReducer : public TileReducer
+{
+public:
+    void reduce(FeatureStore* /* store */, const FeaturePtr* features, size_t count) override
+    {
+        WayGraphBuilder::Batch* batch = builder_.acquire();
+        for (size_t i = 0; i < count; i++)
+        {
+            add(*batch, features[i]);
+        }
+        builder_.release(batch);
+    }
+
+    /// Adds a feature from the calling thread (which must not
+    /// run concurrently with the workers)
+    void add(const Feature& feature)
+    {
+        WayGraphBuilder::Batch* batch = builder_.acquire();
+        add(*batch, feature.ptr());
+        builder_.release(batch);
+    }
+
+    WayGraph build() { return builder_.build(); }
+
+private:
+    void add(WayGraphBuilder::Batch& batch, FeaturePtr feature)
+    {
+        if (!feature.isWay()) return;
+        WayPtr way(feature);
+        if (way.isPlaceholder()) return;
+        WayCoordinateIterator iter(way);
+        coords_.resize(iter.coordinatesRemaining());
+        int count = iter.decodeAll(coords_.data());
+        batch.addWay(way.id(), coords_.data(), count);
+    }
+
+    WayGraphBuilder builder_;
+    static thread_local std::vector<Coordinate> coords_;
+};
+
+thread_local std::vector<Coordinate> WayGraphReducer::coords_;
+
+/// Decodes the coordinates of linear ways (and looks up the tag that
+/// groups them) on the worker threads, leaving the joining to the end
+///
+class LineMergeReducer : public TileReducer
+{
+public:
+    LineMergeReducer(FeatureStore* store, std::string_view key, bool directed) :
+        merger_(directed),
+        key_(store->key(key)),
+        grouped_(!key.empty())
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        LineMerger::Batch* batch = merger_.acquire();
+        for (size_t i = 0; i < count; i++)
+        {
+            add(*batch, store, features[i]);
+        }
+        merger_.release(batch);
+    }
+
+    /// Adds a feature from the calling thread (which must not
+    /// run concurrently with the workers)
+    void add(const Feature& feature)
+    {
+        LineMerger::Batch* batch = merger_.acquire();
+        add(*batch, feature.store(), feature.ptr());
+        merger_.release(batch);
+    }
+
+    MergedLines merge(int threads) { return merger_.merge(threads); }
+
+private:
+    void add(LineMerger::Batch& batch, FeatureStore* store, FeaturePtr feature)
+    {
+        if (!feature.isWay() || feature.isArea()) return;
+        WayPtr way(feature);
+        if (way.isPlaceholder()) return;
+        char buf[32];
+        std::string_view group;
+        if (grouped_) group = Feature(store, feature)[key_].toStringView(buf);
+        WayCoordinateIterator iter(way);
+        coords_.resize(iter.coordinatesRemaining());
+        int count = iter.decodeAll(coords_.data());
+        batch.addWay(way.id(), group, coords_.data(), count);
+    }
+
+    LineMerger merger_;
+    Key key_;
+    bool grouped_;
+    static thread_local std::vector<Coordinate> coords_;
+};
+
+thread_local std::vector<Coordinate> LineMergeReducer::coords_;
+
+/// Gathers the coordinates of features on the worker threads, each
+/// of which appends to a partial FlatCoordinates taken from a pool
+/// for the duration of a batch; merge() concatenates them
+///
+class CoordinateCollector : public TileReducer
+{
+public:
+    /// @param generalized the store's generalized geometries (or nullptr)
+    /// @param level the level of generalized geometries to use
+    CoordinateCollector(CoordinateFormat format,
+        const GeneralizedGeometry* generalized, int level) :
+        format_(format),
+        generalized_(generalized),
+        level_(level)
+    {
+    }
+
+    void reduce(FeatureStore* store, const FeaturePtr* features, size_t count) override
+    {
+        FlatCoordinates* part = acquire();
+        for (size_t i = 0; i < count; i++)
+        {
+            add(*part, store, features[i]);
+        }
+        release(part);
+    }
+
+    /// Adds a feature from the calling thread (which must not
+    /// run concurrently with the workers)
+    void add(FeatureStore* store, FeaturePtr feature)
+    {
+        FlatCoordinates* part = acquire();
+        add(*part, store, feature);
+        release(part);
+    }
+
+    FlatCoordinates merge()
+    {
+        FlatCoordinates result(format_);
+        size_t featureCount = 0;
+        size_t partCount = 0;
+        size_t valueCount = 0;
+        for (const std::unique_ptr<FlatCoordinates>& part : parts_)
+        {
+            featureCount += part->featureCount();
+            partCount += part->partCount();
+            valueCount += part->coordinateCount() * 2;
+        }
+        result.ids_.reserve(featureCount);
+        result.featureOffsets_.reserve(featureCount + 1);
+        result.partTypes_.reserve(partCount);
+        result.partOffsets_.reserve(partCount + 1);
+        if (format_ == CoordinateFormat::MERCATOR)
+        {
+            result.mercator_.reserve(valueCount);
+        }
+        else
+        {
+            result.lonLat_.reserve(valueCount);
+        }
+        for (std::unique_ptr<FlatCoordinates>& part : parts_)
+        {
+            uint32_t partBase = static_cast<uint32_t>(result.partCount());
+            uint32_t coordBase = static_cast<uint32_t>(result.coordinateCount());
+            result.ids_.insert(result.ids_.end(), part->ids_.begin(), part->ids_.end());
+            for (size_t i = 1; i < part->featureOffsets_.size(); i++)
+            {
+                result.featureOffsets_.push_back(partBase + part->featureOffsets_[i]);
+            }
+            result.partTypes_.insert(result.partTypes_.end(),
+                part->partTypes_.begin(), part->partTypes_.end());
+            for (size_t i = 1; i < part->partOffsets_.size(); i++)
+            {
+                result.partOffsets_.push_back(coordBase + part->partOffsets_[i]);
+            }
+            result.mercator_.insert(result.mercator_.end(),
+                part->mercator_.begin(), part->mercator_.end());
+            result.lonLat_.insert(result.lonLat_.end(),
+                part->lonLat_.begin(), part->lonLat_.end());
+            part.reset();
+        }
+        return result;
+    }
+
+private:
+    FlatCoordinates* acquire()
+    {
+        std::lock_guard lock(mutex_);
+        if (idle_.empty())
+        {
+            parts_.push_back(std::make_unique<FlatCoordinates>(format_));
+            return parts_.back().get();
+        }
+        FlatCoordinates* part = idle_.back();
+        idle_.pop_back();
+        return part;
+    }
+
+    void release(FlatCoordinates* part)
+    {
+        std::lock_guard lock(mutex_);
+        idle_.push_back(part);
+    }
+
+    void add(FlatCoordinates& out, FeatureStore* store, FeaturePtr feature) const
+    {
+        out.ids_.push_back(feature.typedId());
+        if (feature.isNode())
+        {
+            Coordinate xy = NodePtr(feature).xy();
+            addCoordinates(out, &xy, 1);
+            endPart(out, FlatCoordinates::POINT);
+        }
+        else if (feature.isWay())
+        {
+            std::vector<Coordinate> generalized;
+            if (generalized_ && generalized_->wayCoordinates(
+                WayPtr(feature), level_, generalized))
+            {
+                addCoordinates(out, generalized.data(),
+                    static_cast<int>(generalized.size()));
+                endPart(out, feature.isArea() ?
+                    FlatCoordinates::OUTER_RING : FlatCoordinates::LINE);
+                out.featureOffsets_.push_back(static_cast<uint32_t>(out.partCount()));
+                return;
+            }
+            WayCoordinateIterator iter((WayPtr(feature)));
+            Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+            for (;;)
+            {
+                int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+                if (count == 0) break;
+                addCoordinates(out, coords, count);
+            }
+            endPart(out, feature.isArea() ?
+                FlatCoordinates::OUTER_RING : FlatCoordinates::LINE);
+        }
+        else if (feature.isArea())
+        {
+            RingCache::RingsRef rings;
+            if (generalized_) rings = generalized_->relationRings(RelationPtr(feature), level_);
+            if (!rings) rings = RingCache::polygonize(store, RelationPtr(feature));
+            for (const Polygonizer::Ring* ring = rings->outerRings();
+                ring; ring = ring->next())
+            {
+                addRing(out, ring, FlatCoordinates::OUTER_RING);
+                for (const Polygonizer::Ring* inner = ring->firstInner();
+                    inner; inner = inner->next())
+                {
+                    addRing(out, inner, FlatCoordinates::INNER_RING);
+                }
+            }
+        }
+        out.featureOffsets_.push_back(static_cast<uint32_t>(out.partCount()));
+    }
+
+    void addRing(FlatCoordinates& out, const Polygonizer::Ring* ring,
+        FlatCoordinates::PartType type) const
+    {
+        RingCoordinateIterator iter(ring);
+        Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+        while (iter.coordinatesRemaining() > 0)
+        {
+            int count = std::min(iter.coordinatesRemaining(),
+                WayCoordinateIterator::BATCH_SIZE);
+            for (int i = 0; i < count; i++) coords[i] = iter.next();
+            addCoordinates(out, coords, count);
+        }
+        endPart(out, type);
+    }
+
+    void addCoordinates(FlatCoordinates& out, const Coordinate* coords, int count) const
+    {
+        if (format_ == CoordinateFormat::MERCATOR)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                out.mercator_.push_back(coords[i].x);
+                out.mercator_.push_back(coords[i].y);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                out.lonLat_.push_back(coords[i].lon());
+                out.lonLat_.push_back(coords[i].lat());
+            }
+        }
+    }
+
+    static void endPart(FlatCoordinates& out, FlatCoordinates::PartType type)
+    {
+        size_t values = out.mercator_.size() + out.lonLat_.size();
+        out.partTypes_.push_back(type);
+        out.partOffsets_.push_back(static_cast<uint32_t>(values / 2));
+    }
+
+    CoordinateFormat format_;
+    const GeneralizedGeometry* generalized_;
+    int level_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<FlatCoordinates>> parts_;
+    std::vector<FlatCoordinates*> idle_;
+};
+
 uint64_t FeatureUtils::countWorld(const View &view)
 {
-    uint64_t count = 0;
+    CountingReducer reducer;
+    uint64_t dupeCount = 0;
     Query query(view.store(), view.bounds(),
-        view.types(), view.matcher(), view.filter());
-    while (!query.next().isNull()) count++;
-    return count;
+        view.types(), view.matcher(), view.filter(), &reducer);
+    while (!query.next().isNull()) dupeCount++;
+    return reducer.count() + dupeCount;
 }
 
 uint64_t FeatureUtils::countGeneric(const View &view)
@@ -34,6 +691,33 @@ uint64_t FeatureUtils::countGeneric(const View &view)
 }
 
 uint64_t FeatureUtils::count(const View &view)
+{
+    QueryRecorder* recorder = view.store()->recorder();
+    if (recorder) [[unlikely]] return countRecorded(view, recorder);
+    return countView(view);
+}
+
+uint64_t FeatureUtils::countRecorded(const View& view, QueryRecorder* recorder)
+{
+    RecordedQuery query = RecordedQuery::of(view);
+    query.consumption = RecordedQuery::Consumption::COUNT;
+    query.start = recorder->elapsedMicros();
+    auto started = std::chrono::steady_clock::now();
+    query.results = countView(view);
+    query.nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    try
+    {
+        recorder->record(query);
+    }
+    catch (...)
+    {
+        // A failure to write the log must not fail the query
+    }
+    return query.results;
+}
+
+uint64_t FeatureUtils::countView(const View& view)
 {
     switch (view.view())
     {
@@ -46,6 +730,19 @@ uint64_t FeatureUtils::count(const View &view)
         }
         break;
     case View::WORLD:
+        if (!view.filter() && view.matcher()->isMatchAll() &&
+            view.bounds() == Box::ofWorld())
+        {
+            // All features of the given types: the tile statistics
+            // (if any) have the answer
+            const TileStatistics* stats = view.store()->tileStatistics();
+            if (stats)
+            {
+                std::optional<uint64_t> count = stats->count(
+                    view.types() & view.matcher()->acceptedTypes());
+                if (count) return *count;
+            }
+        }
         return countWorld(view);
     default:
         break;
@@ -53,6 +750,461 @@ uint64_t FeatureUtils::count(const View &view)
     return countGeneric(view);
 }
 
+/// Scans a systematic sample of tiles and scales the number of
+/// features found to all tiles; the confidence interval is based on
+/// the variance of the per-tile counts (with the finite population
+/// correction, so it narrows to the exact count as the sample grows).
+/// Features that straddle tiles may be counted in more than one of
+/// them, so the estimate is slightly high for queries that yield many
+/// large features.
+///
+CountEstimate FeatureUtils::estimateCount(const View& view, double sampleFraction)
+{
+    CountEstimate estimate;
+    if (view.view() != View::WORLD || sampleFraction >= 1)
+    {
+        estimate.count = static_cast<double>(countView(view));
+        estimate.lower = estimate.upper = estimate.count;
+        estimate.exact = true;
+        return estimate;
+    }
+    EstimatingReducer reducer;
+    QueryOptions options;
+    options.sampleFraction = sampleFraction;
+    uint64_t dupeCount = 0;
+    Query query(view.store(), view.bounds(), view.types(),
+        view.matcher(), view.filter(), &reducer, nullptr, options);
+    while (!query.next().isNull()) dupeCount++;
+
+    double tiles = query.tileCount();
+    double sampled = query.sampledTileCount();
+    double found = reducer.sum() + static_cast<double>(dupeCount);
+    if (sampled == 0 && tiles > 0)
+    {
+        // The fraction is too small to pick even a single tile
+        return estimateCount(view, 1);
+    }
+    if (sampled >= tiles)
+    {
+        estimate.count = estimate.lower = estimate.upper = found;
+        estimate.exact = true;
+        return estimate;
+    }
+    double mean = reducer.sum() / sampled;
+    double variance = sampled > 1 ?
+        std::max(reducer.sumSquares() - sampled * mean * mean, 0.0) / (sampled - 1) : 0;
+    double error = tiles * std::sqrt((1 - sampled / tiles) * variance / sampled);
+    estimate.count = found * tiles / sampled;
+    estimate.lower = std::max(estimate.count - 1.96 * error, found);
+    estimate.upper = estimate.count + 1.96 * error;
+    return estimate;
+}
+
+/// Runs the query to completion (without creating features) and
+/// returns its execution statistics
+///
+QueryStats FeatureUtils::profile(const View& view)
+{
+    QueryStats stats;
+    if (view.view() != View::WORLD)
+    {
+        stats.results = countGeneric(view);
+        return stats;
+    }
+    CountingReducer reducer;
+    {
+        Query query(view.store(), view.bounds(),
+            view.types(), view.matcher(), view.filter(), &reducer, &stats);
+        while (!query.next().isNull());
+    }
+    // Features that required deduplication are counted as results
+    // by the workers, but duplicates are only discovered afterwards
+    stats.results -= stats.duplicates;
+    return stats;
+}
+
+std::string FeatureUtils::explain(const View& view)
+{
+    static const char* VIEW_NAMES[] =
+        { "empty", "world", "way nodes", "members", "parents" };
+    static const char* INDEX_NAMES[] = { "nodes", "ways", "areas", "relations" };
+
+    StringBuilder s;
+    s << "view:      " << VIEW_NAMES[view.view()] << "\n";
+    if (view.view() == View::EMPTY) return s.toString();
+    s << "types:     " << Format::format("0x%08X", static_cast<uint32_t>(view.types()))
+        << "\n";
+    if (view.view() == View::WORLD)
+    {
+        s << "bounds:    " << view.bounds().toString() << "\n";
+    }
+    const MatcherHolder* matcher = view.matcher();
+    if (!view.usesMatcher())
+    {
+        s << "matcher:   all\n";
+    }
+    else
+    {
+        s << "matcher:   index bits (key mask / min)\n";
+        for (int i = 0; i < 4; i++)
+        {
+            const IndexMask& mask = matcher->indexMask(static_cast<FeatureIndexType>(i));
+            s << Format::format("  %-10s0x%08X / %u\n", INDEX_NAMES[i],
+                mask.keyMask, mask.keyMin);
+        }
+    }
+    if (view.filter())
+    {
+        s << "filter:\n";
+        explainFilter(s, view.filter(), 2);
+    }
+    return s.toString();
+}
+
+void FeatureUtils::explainFilter(StringBuilder& s, const Filter* filter, int indent)
+{
+    int flags = filter->flags();
+    s << std::string(indent, ' ') << filter->name();
+    if (flags & FilterFlags::USES_BBOX)
+    {
+        s << (flags & FilterFlags::STRICT_BBOX ? " [strict bbox]" : " [bbox]");
+    }
+    if (flags & FilterFlags::FAST_TILE_FILTER) s << " [tile acceleration]";
+    s << "\n";
+    if (filter->isCombo())
+    {
+        for (const Filter* child : static_cast<const ComboFilter*>(filter)->filters())
+        {
+            explainFilter(s, child, indent + 2);
+        }
+    }
+}
+
+/// Checks whether a feature of the store belongs to a world view
+///
+bool FeatureUtils::isInWorld(const View& view, FeaturePtr feature)
+{
+    if (!view.types().acceptFlags(feature.flags())) return false;
+    Box bounds = feature.isNode() ? NodePtr(feature).bounds() : feature.bounds();
+    if (!view.bounds().intersects(bounds)) return false;
+    if (!view.matcher()->mainMatcher().accept(feature)) return false;
+    return view.filter() == nullptr ||
+        view.filter()->accept(view.store(), feature, FastFilterHint());
+}
+
+FeaturePtr FeatureUtils::byId(const View& view, TypedFeatureId id)
+{
+    switch (view.view())
+    {
+    case View::EMPTY:
+        return FeaturePtr();
+    case View::WORLD:
+    {
+        FeaturePtr feature = view.store()->idIndex().get(id);
+        if (feature.isNull() || !isInWorld(view, feature)) return FeaturePtr();
+        return feature;
+    }
+    default:
+        break;
+    }
+    // Related-feature views are small, so we simply scan them
+    uint64_t typedId = static_cast<uint64_t>(id);
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        FeaturePtr feature = (*iter).ptr();
+        if (feature.typedId() == typedId) return feature;
+    }
+    return FeaturePtr();
+}
+
+/// Looks up the index entries of all IDs first, then fetches each
+/// tile once and retrieves all of its features together
+///
+void FeatureUtils::byIds(const View& view, std::span<const TypedFeatureId> ids,
+    std::vector<FeaturePtr>& results)
+{
+    if (view.view() != View::WORLD)
+    {
+        for (TypedFeatureId id : ids)
+        {
+            FeaturePtr feature = byId(view, id);
+            if (!feature.isNull()) results.push_back(feature);
+        }
+        return;
+    }
+    const IdIndex& index = view.store()->idIndex();
+    std::vector<const IdIndex::Entry*> entries;
+    entries.reserve(ids.size());
+    for (TypedFeatureId id : ids)
+    {
+        const IdIndex::Entry* entry = index.find(id);
+        if (entry) entries.push_back(entry);
+    }
+    // Entries are sorted by ID, so equal pointers mean duplicate IDs
+    std::sort(entries.begin(), entries.end(),
+        [](const IdIndex::Entry* a, const IdIndex::Entry* b)
+        {
+            return a->tip != b->tip ? a->tip < b->tip : a < b;
+        });
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    DataPtr pTile;
+    Tip currentTip;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const IdIndex::Entry* entry = entries[i];
+        if (i == 0 || entry->tip != currentTip)
+        {
+            currentTip = entry->tip;
+            pTile = view.store()->fetchTile(currentTip);
+        }
+        FeaturePtr feature(pTile + entry->offset);
+        if (isInWorld(view, feature)) results.push_back(feature);
+    }
+}
+
+/// Uses the store's name index to narrow down the features of a world
+/// view; candidates are checked against the view like in byIds()
+///
+void FeatureUtils::searchNames(const View& view, std::string_view text,
+    std::vector<FeaturePtr>& results)
+{
+    if (view.view() == View::EMPTY) return;
+    std::string normalized = NameIndex::normalize(text);
+    FeatureStore* store = view.store();
+    if (view.view() == View::WORLD)
+    {
+        const NameIndex* index = store->nameIndex();
+        std::vector<FeaturePtr> candidates;
+        if (index && index->candidates(store, normalized, candidates))
+        {
+            for (FeaturePtr feature : candidates)
+            {
+                if (isInWorld(view, feature) &&
+                    NameIndex::namesContain(store, feature, normalized))
+                {
+                    results.push_back(feature);
+                }
+            }
+            return;
+        }
+    }
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        FeaturePtr feature = (*iter).ptr();
+        if (NameIndex::namesContain(store, feature, normalized))
+        {
+            results.push_back(feature);
+        }
+    }
+}
+
+/// Uses the store's numeric index (if it covers the key) to narrow down
+/// the features of a world view, like searchNames()
+///
+void FeatureUtils::searchRange(const View& view, std::string_view key,
+    double min, double max, std::vector<FeaturePtr>& results)
+{
+    if (view.view() == View::EMPTY) return;
+    FeatureStore* store = view.store();
+    if (view.view() == View::WORLD)
+    {
+        const NumericIndex* index = store->numericIndex();
+        int n = index ? index->findKey(key) : -1;
+        if (n >= 0)
+        {
+            std::vector<FeaturePtr> candidates;
+            index->candidates(store, n, min, max, candidates);
+            for (FeaturePtr feature : candidates)
+            {
+                if (isInWorld(view, feature)) results.push_back(feature);
+            }
+            return;
+        }
+    }
+    Key k = store->key(key);
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        FeaturePtr feature = (*iter).ptr();
+        double value = NumericIndex::numericValue(store, feature, k);
+        if (value >= min && value <= max) results.push_back(feature);
+    }
+}
+
+/// Checks a feature of a world view in place; the members and parents
+/// of a feature are few, so we simply look for it among them
+///
+bool FeatureUtils::contains(const View& view, FeatureStore* store, FeaturePtr feature)
+{
+    switch (view.view())
+    {
+    case View::EMPTY:
+        return false;
+    case View::WORLD:
+        return store == view.store() && isInWorld(view, feature);
+    default:
+        break;
+    }
+    if (store != view.store()) return false;
+    int64_t idBits = feature.idBits();
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        const Feature& f = *iter;
+        if (!f.isAnonymousNode() && f.ptr().idBits() == idBits) return true;
+    }
+    return false;
+}
+
+/// For a world view, the tags are looked up by the threads that
+/// scan the tiles; all other views are projected by the calling thread
+///
+TagColumns FeatureUtils::select(const View& view, std::span<const std::string_view> keys)
+{
+    TagColumns result;
+    result.keys_.assign(keys.begin(), keys.end());
+    result.columns_.resize(keys.size());
+    if (view.view() == View::EMPTY) return result;
+    TagProjector projector(view.store(), result);
+    if (view.view() == View::WORLD)
+    {
+        FeatureStore* store = view.store();
+        Query query(store, view.bounds(), view.types(),
+            view.matcher(), view.filter(), &projector);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            projector.add(Feature(store, next));
+        }
+        return result;
+    }
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        projector.add(*iter);
+    }
+    return result;
+}
+
+/// For a world view, features are tallied by the threads that scan
+/// the tiles; all other views are tallied by the calling thread
+///
+std::vector<TagGroup> FeatureUtils::groupBy(const View& view, std::string_view key,
+    const std::function<double(const Feature&)>* measure)
+{
+    if (view.view() == View::EMPTY) return {};
+    FeatureStore* store = view.store();
+    TagGrouper grouper(store, key, measure);
+    if (view.view() == View::WORLD)
+    {
+        Query query(store, view.bounds(), view.types(),
+            view.matcher(), view.filter(), &grouper);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            grouper.add(Feature(store, next));
+        }
+    }
+    else
+    {
+        for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+        {
+            grouper.add(*iter);
+        }
+    }
+    return grouper.merge(store);
+}
+
+/// For a world view, the ways are decoded by the threads that scan
+/// the tiles; all other views are decoded by the calling thread
+///
+WayGraph FeatureUtils::graph(const View& view)
+{
+    if (view.view() == View::EMPTY) return {};
+    WayGraphReducer reducer;
+    if (view.view() == View::WORLD)
+    {
+        FeatureStore* store = view.store();
+        Query query(store, view.bounds(), view.types() & FeatureTypes::WAYS,
+            view.matcher(), view.filter(), &reducer);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            reducer.add(Feature(store, next));
+        }
+    }
+    else
+    {
+        for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+        {
+            reducer.add(*iter);
+        }
+    }
+    return reducer.build();
+}
+
+/// For a world view, the ways are decoded by the threads that scan
+/// the tiles, and joined by as many threads as the query executor has
+///
+MergedLines FeatureUtils::mergeLines(const View& view, std::string_view key, bool directed)
+{
+    if (view.view() == View::EMPTY) return {};
+    FeatureStore* store = view.store();
+    LineMergeReducer reducer(store, key, directed);
+    if (view.view() == View::WORLD)
+    {
+        Query query(store, view.bounds(), view.types() & FeatureTypes::NONAREA_WAYS,
+            view.matcher(), view.filter(), &reducer);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            reducer.add(Feature(store, next));
+        }
+    }
+    else
+    {
+        for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+        {
+            reducer.add(*iter);
+        }
+    }
+    return reducer.merge(store->executor().threadCount());
+}
+
+/// For a world view, the coordinates are gathered by the threads that
+/// scan the tiles; all other views are handled by the calling thread
+///
+FlatCoordinates FeatureUtils::coordinates(const View& view,
+    CoordinateFormat format, double tolerance)
+{
+    if (view.view() == View::EMPTY) return FlatCoordinates(format);
+    FeatureStore* store = view.store();
+    int level = GeneralizedGeometry::levelFor(tolerance);
+    CoordinateCollector collector(format,
+        level >= 0 ? store->generalizedGeometry() : nullptr, level);
+    if (view.view() == View::WORLD)
+    {
+        Query query(store, view.bounds(), view.types(),
+            view.matcher(), view.filter(), &collector);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            collector.add(store, next);
+        }
+    }
+    else
+    {
+        for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+        {
+            collector.add(store, (*iter).ptr());
+        }
+    }
+    return collector.merge();
+}
+
 bool FeatureUtils::isEmpty(const View& view)
 {
     if(view.view() == View::EMPTY) return true;
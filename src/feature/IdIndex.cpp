@@ -0,0 +1,123 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/IdIndex.h>
+#include <algorithm>
+#include <clarisma/util/log.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+static_assert(sizeof(IdIndex::Entry) == 16);
+
+IdIndex::IdIndex(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize) :
+    store_(store),
+    entries_(nullptr),
+    count_(0)
+{
+    if (tryOpen(fileName, storeTimestamp, storeSize)) return;
+    build();
+    save(fileName, { MAGIC, VERSION, storeTimestamp, storeSize, count_ });
+}
+
+
+/**
+ * Maps an existing sidecar file, provided it was built for the
+ * same version of the store.
+ */
+bool IdIndex::tryOpen(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    const Header* header = file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "ID index");
+    if (!header) return false;
+    if (file_.size() != sizeof(Header) + header->count * sizeof(Entry))
+    {
+        file_.close();
+        return false;
+    }
+    entries_ = reinterpret_cast<const Entry*>(header + 1);
+    count_ = header->count;
+    return true;
+}
+
+
+void IdIndex::build()
+{
+    TileIndexWalker walker(store_->tileIndex(), store_->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    if (walker.next())
+    {
+        do
+        {
+            Tip tip = walker.currentTip();
+            addTile(store_->fetchTile(tip), tip, memEntries_);
+        }
+        while (walker.next());
+    }
+    std::sort(memEntries_.begin(), memEntries_.end(),
+        [](const Entry& a, const Entry& b) { return a.typedId < b.typedId; });
+    // Features that span tiles have been added once for each tile
+    memEntries_.erase(std::unique(memEntries_.begin(), memEntries_.end(),
+        [](const Entry& a, const Entry& b) { return a.typedId == b.typedId; }),
+        memEntries_.end());
+    memEntries_.shrink_to_fit();
+    entries_ = memEntries_.data();
+    count_ = memEntries_.size();
+}
+
+
+/**
+ * Writes the index to the sidecar file. Failure is not an error;
+ * we'll simply rebuild the index next time.
+ */
+void IdIndex::save(const std::string& fileName, const Header& header)
+{
+    try
+    {
+        SidecarFile::Writer file(fileName);
+        file.write(&header, sizeof(header));
+        file.write(memEntries_);
+        file.commit();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG("Failed to save ID index %s: %s", fileName.c_str(), ex.what());
+    }
+}
+
+
+void IdIndex::addTile(DataPtr pTile, Tip tip, std::vector<Entry>& entries)
+{
+    TileFeatureWalker::forEachFeature(pTile,
+        [pTile, tip, &entries](FeaturePtr pFeature, FeatureIndexType)
+        {
+            entries.push_back({ pFeature.typedId(), tip,
+                static_cast<uint32_t>(pFeature.ptr().ptr() - pTile.ptr()) });
+        });
+}
+
+
+const IdIndex::Entry* IdIndex::find(TypedFeatureId id) const
+{
+    uint64_t typedId = static_cast<uint64_t>(id);
+    const Entry* end = entries_ + count_;
+    const Entry* p = std::lower_bound(entries_, end, typedId,
+        [](const Entry& e, uint64_t key) { return e.typedId < key; });
+    return (p != end && p->typedId == typedId) ? p : nullptr;
+}
+
+
+FeaturePtr IdIndex::get(TypedFeatureId id) const
+{
+    const Entry* entry = find(id);
+    if (!entry) return FeaturePtr();
+    return FeaturePtr(store_->fetchTile(entry->tip) + entry->offset);
+}
+
+} // namespace geodesk
@@ -0,0 +1,345 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/LineMerger.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <thread>
+
+namespace geodesk {
+
+namespace {
+
+constexpr uint32_t NO_LINK = 0xffff'ffff;
+
+/// Runs `job` for each number up to `jobCount`, on up to `threads`
+/// threads (including the calling thread)
+void runParallel(int threads, size_t jobCount, const std::function<void(size_t)>& job)
+{
+    std::atomic<size_t> next = 0;
+    auto work = [&next, jobCount, &job]()
+    {
+        for (;;)
+        {
+            size_t n = next.fetch_add(1, std::memory_order_relaxed);
+            if (n >= jobCount) break;
+            job(n);
+        }
+    };
+    int threadCount = static_cast<int>(std::min<size_t>(
+        std::max(threads, 1), std::max<size_t>(jobCount, 1)));
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+}
+
+} // namespace
+
+
+/// The locations where exactly two lines of a group end (and can
+/// therefore be joined), sharded by hash
+///
+class LineMerger::EndCounts
+{
+public:
+    explicit EndCounts(size_t shardCount) : joints_(shardCount) {}
+
+    size_t shardCount() const { return joints_.size(); }
+
+    size_t shardOf(const End& end) const
+    {
+        uint64_t h = (end.xy ^ (static_cast<uint64_t>(end.group) << 17)) *
+            0x9E37'79B9'7F4A'7C15ull;
+        return (h >> 32) % joints_.size();
+    }
+
+    /// Counts the ends in a shard (sorting them in the process)
+    void count(size_t shard, std::vector<End>& ends, bool directed)
+    {
+        std::sort(ends.begin(), ends.end());
+        std::vector<End>& joints = joints_[shard];
+        size_t i = 0;
+        while (i < ends.size())
+        {
+            size_t j = i + 1;
+            while (j < ends.size() && ends[j].sameLocation(ends[i])) j++;
+            // When directed, one line must end where the other starts
+            if (j - i == 2 && (!directed || ((ends[i].ref ^ ends[i + 1].ref) & 1)))
+            {
+                joints.push_back(ends[i]);
+            }
+            i = j;
+        }
+        joints.shrink_to_fit();
+    }
+
+    bool isJoint(const End& end) const
+    {
+        const std::vector<End>& joints = joints_[shardOf(end)];
+        return std::binary_search(joints.begin(), joints.end(), end);
+    }
+
+private:
+    std::vector<std::vector<End>> joints_;
+};
+
+
+void LineMerger::Batch::addWay(uint64_t id, std::string_view group,
+    const Coordinate* coords, size_t count)
+{
+    if (count < 2) return;
+    auto [it, added] = groupCodes_.try_emplace(std::string(group),
+        static_cast<uint32_t>(groupCodes_.size()));
+    Piece& piece = input_.pieces.emplace_back();
+    piece.group = it->second;
+    piece.coordsStart = static_cast<uint32_t>(input_.coords.size());
+    input_.coords.insert(input_.coords.end(), coords, coords + count);
+    piece.coordsEnd = static_cast<uint32_t>(input_.coords.size());
+    piece.waysStart = static_cast<uint32_t>(input_.ways.size());
+    input_.ways.push_back(id);
+    piece.waysEnd = piece.waysStart + 1;
+}
+
+
+LineMerger::Batch* LineMerger::acquire()
+{
+    std::lock_guard lock(mutex_);
+    if (idle_.empty())
+    {
+        batches_.push_back(std::make_unique<Batch>());
+        return batches_.back().get();
+    }
+    Batch* batch = idle_.back();
+    idle_.pop_back();
+    return batch;
+}
+
+
+void LineMerger::release(Batch* batch)
+{
+    std::lock_guard lock(mutex_);
+    idle_.push_back(batch);
+}
+
+
+/**
+ * Joins the pieces into chains, linking the ends that meet at a joint
+ * (if both are among the given pieces). Every chain starts at a piece
+ * with an unlinked end; the pieces that are left over form rings.
+ */
+void LineMerger::chain(const Pieces& in, const EndCounts& counts, Pieces& out) const
+{
+    size_t pieceCount = in.pieces.size();
+    std::vector<End> ends;
+    ends.reserve(pieceCount * 2);
+    for (size_t i = 0; i < pieceCount; i++)
+    {
+        const Piece& piece = in.pieces[i];
+        uint32_t ref = static_cast<uint32_t>(i * 2);
+        ends.push_back({ key(in.coords[piece.coordsStart]), piece.group, ref });
+        ends.push_back({ key(in.coords[piece.coordsEnd - 1]), piece.group, ref + 1 });
+    }
+    std::sort(ends.begin(), ends.end());
+
+    std::vector<uint32_t> links(pieceCount * 2, NO_LINK);
+    size_t i = 0;
+    while (i < ends.size())
+    {
+        size_t j = i + 1;
+        while (j < ends.size() && ends[j].sameLocation(ends[i])) j++;
+        if (j - i == 2 && counts.isJoint(ends[i]))
+        {
+            links[ends[i].ref] = ends[i + 1].ref;
+            links[ends[i + 1].ref] = ends[i].ref;
+        }
+        i = j;
+    }
+    ends.clear();
+    ends.shrink_to_fit();
+
+    std::vector<bool> done(pieceCount);
+    auto walk = [&in, &out, &links, &done](uint32_t p, bool forward)
+    {
+        Piece& chain = out.pieces.emplace_back();
+        chain.group = in.pieces[p].group;
+        chain.coordsStart = static_cast<uint32_t>(out.coords.size());
+        chain.waysStart = static_cast<uint32_t>(out.ways.size());
+        bool first = true;
+        for (;;)
+        {
+            done[p] = true;
+            const Piece& piece = in.pieces[p];
+            const Coordinate* coords = in.coords.data();
+            const uint64_t* ways = in.ways.data();
+            // (The first coordinate of a joined piece is the last
+            // coordinate of the previous one)
+            if (forward)
+            {
+                out.coords.insert(out.coords.end(),
+                    coords + piece.coordsStart + (first ? 0 : 1), coords + piece.coordsEnd);
+                out.ways.insert(out.ways.end(),
+                    ways + piece.waysStart, ways + piece.waysEnd);
+            }
+            else
+            {
+                for (uint32_t n = piece.coordsEnd - (first ? 0 : 1); n > piece.coordsStart; n--)
+                {
+                    out.coords.push_back(coords[n - 1]);
+                }
+                for (uint32_t n = piece.waysEnd; n > piece.waysStart; n--)
+                {
+                    out.ways.push_back(ways[n - 1]);
+                }
+            }
+            first = false;
+            uint32_t next = links[p * 2 + (forward ? 1 : 0)];
+            if (next == NO_LINK || done[next >> 1]) break;
+            p = next >> 1;
+            forward = (next & 1) == 0;      // entered at its start
+        }
+        chain.coordsEnd = static_cast<uint32_t>(out.coords.size());
+        chain.waysEnd = static_cast<uint32_t>(out.ways.size());
+    };
+
+    for (uint32_t p = 0; p < pieceCount; p++)
+    {
+        if (done[p]) continue;
+        if (links[p * 2] == NO_LINK)
+        {
+            walk(p, true);
+        }
+        else if (!directed_ && links[p * 2 + 1] == NO_LINK)
+        {
+            walk(p, false);
+        }
+    }
+    for (uint32_t p = 0; p < pieceCount; p++)
+    {
+        if (!done[p]) walk(p, true);
+    }
+}
+
+
+MergedLines LineMerger::merge(int threads)
+{
+    MergedLines result;
+    threads = std::max(threads, 1);
+
+    // Number the groups of all batches
+    std::unordered_map<std::string, uint32_t> groupCodes;
+    for (const std::unique_ptr<Batch>& batch : batches_)
+    {
+        batch->globalGroups_.resize(batch->groupCodes_.size());
+        for (auto& [group, code] : batch->groupCodes_)
+        {
+            auto [it, added] = groupCodes.try_emplace(group,
+                static_cast<uint32_t>(result.groups_.size()));
+            if (added) result.groups_.push_back(group);
+            batch->globalGroups_[code] = it->second;
+        }
+        batch->groupCodes_.clear();
+    }
+
+    // Gather the ends of the ways of each batch by shard, then count
+    // how many ends meet at each location
+    EndCounts counts(threads);
+    runParallel(threads, batches_.size(), [this, &counts](size_t n)
+    {
+        Batch& batch = *batches_[n];
+        batch.shardEnds_.resize(counts.shardCount());
+        for (Piece& piece : batch.input_.pieces)
+        {
+            piece.group = batch.globalGroups_[piece.group];
+            const Coordinate* coords = batch.input_.coords.data();
+            End start { key(coords[piece.coordsStart]), piece.group, 0 };
+            End end { key(coords[piece.coordsEnd - 1]), piece.group, 1 };
+            batch.shardEnds_[counts.shardOf(start)].push_back(start);
+            batch.shardEnds_[counts.shardOf(end)].push_back(end);
+        }
+    });
+    runParallel(threads, counts.shardCount(), [this, &counts](size_t shard)
+    {
+        std::vector<End> ends;
+        for (const std::unique_ptr<Batch>& batch : batches_)
+        {
+            std::vector<End>& part = batch->shardEnds_[shard];
+            ends.insert(ends.end(), part.begin(), part.end());
+            std::vector<End>().swap(part);
+        }
+        counts.count(shard, ends, directed_);
+    });
+
+    // Join the ways of each batch, then stitch the chains of all batches
+    runParallel(threads, batches_.size(), [this, &counts](size_t n)
+    {
+        Batch& batch = *batches_[n];
+        chain(batch.input_, counts, batch.chains_);
+        batch.input_ = {};
+    });
+
+    Pieces all;
+    for (const std::unique_ptr<Batch>& batch : batches_)
+    {
+        Pieces& chains = batch->chains_;
+        uint32_t coordsBase = static_cast<uint32_t>(all.coords.size());
+        uint32_t waysBase = static_cast<uint32_t>(all.ways.size());
+        for (Piece piece : chains.pieces)
+        {
+            piece.coordsStart += coordsBase;
+            piece.coordsEnd += coordsBase;
+            piece.waysStart += waysBase;
+            piece.waysEnd += waysBase;
+            all.pieces.push_back(piece);
+        }
+        all.coords.insert(all.coords.end(), chains.coords.begin(), chains.coords.end());
+        all.ways.insert(all.ways.end(), chains.ways.begin(), chains.ways.end());
+        chains = {};
+    }
+    Pieces lines;
+    chain(all, counts, lines);
+    all = {};
+
+    // Order the lines by group and lowest way ID, so the result
+    // doesn't depend on how the ways were spread across batches
+    std::vector<uint64_t> lowestIds(lines.pieces.size());
+    for (size_t i = 0; i < lines.pieces.size(); i++)
+    {
+        const Piece& line = lines.pieces[i];
+        lowestIds[i] = *std::min_element(lines.ways.begin() + line.waysStart,
+            lines.ways.begin() + line.waysEnd);
+    }
+    std::vector<uint32_t> order(lines.pieces.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&lines, &lowestIds, &result](uint32_t a, uint32_t b)
+    {
+        const std::string& groupA = result.groups_[lines.pieces[a].group];
+        const std::string& groupB = result.groups_[lines.pieces[b].group];
+        return groupA != groupB ? groupA < groupB : lowestIds[a] < lowestIds[b];
+    });
+
+    result.coords_.reserve(lines.coords.size());
+    result.ways_.reserve(lines.ways.size());
+    result.offsets_.reserve(order.size() + 1);
+    result.wayOffsets_.reserve(order.size() + 1);
+    result.lineGroups_.reserve(order.size());
+    for (uint32_t n : order)
+    {
+        const Piece& line = lines.pieces[n];
+        result.coords_.insert(result.coords_.end(),
+            lines.coords.begin() + line.coordsStart, lines.coords.begin() + line.coordsEnd);
+        result.ways_.insert(result.ways_.end(),
+            lines.ways.begin() + line.waysStart, lines.ways.begin() + line.waysEnd);
+        result.offsets_.push_back(static_cast<uint32_t>(result.coords_.size()));
+        result.wayOffsets_.push_back(static_cast<uint32_t>(result.ways_.size()));
+        result.lineGroups_.push_back(line.group);
+    }
+    batches_.clear();
+    idle_.clear();
+    return result;
+}
+
+} // namespace geodesk
@@ -0,0 +1,237 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/MemberBatch.h>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <geodesk/feature/FeatureStore.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+using Entry = MemberBatch::Entry;
+
+/// A foreign feature that has yet to be resolved
+struct Pending
+{
+    uint32_t tip;
+    uint32_t offset;            // within the tile
+    uint64_t pos;               // of the entry (within its chunk, then overall)
+};
+
+/// The inputs are decoded in chunks of this many
+constexpr size_t CHUNK_SIZE = 256;
+
+struct Chunk
+{
+    std::vector<Entry> entries;
+    std::vector<Pending> pending;
+};
+
+/// Runs `job` for each number up to `jobCount`, on up to `threads`
+/// threads (including the calling thread)
+void runParallel(int threads, size_t jobCount, const std::function<void(size_t)>& job)
+{
+    std::atomic<size_t> next(0);
+    auto runAll = [&next, jobCount, &job]()
+    {
+        for (;;)
+        {
+            size_t n = next.fetch_add(1, std::memory_order_relaxed);
+            if (n >= jobCount) return;
+            job(n);
+        }
+    };
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(
+        std::min(jobCount, size_t(INT32_MAX))), 1));
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(runAll);
+    }
+    runAll();
+    for (std::thread& worker : workers) worker.join();
+}
+
+/// Advances `tip` by the TIP delta that follows a foreign entry
+/// that lies in a different tile than the previous one
+void readTipDelta(DataPtr& p, Tip& tip)
+{
+    int32_t tipDelta = p.getShort();
+    p += 2;
+    if (tipDelta & 1)
+    {
+        // wide TIP delta
+        tipDelta = (tipDelta & 0xffff) |
+            (static_cast<int32_t>(p.getShort()) << 16);
+        p += 2;
+    }
+    tipDelta >>= 1;     // signed
+    tip += tipDelta;
+}
+
+void decodeMembers(RelationPtr relation, uint32_t parent, Chunk& chunk)
+{
+    DataPtr p = relation.bodyptr();
+    if (p.getIntUnaligned() == 0) return;       // empty relation
+    Tip tip = FeatureConstants::START_TIP;
+    int32_t roleCode = 0;                       // members start out with the empty role
+    const ShortVarString* localRole = nullptr;
+    int32_t member;
+    do
+    {
+        DataPtr pCurrent = p;
+        member = p.getIntUnaligned();
+        p += 4;
+        if ((member & MemberFlags::FOREIGN) && (member & MemberFlags::DIFFERENT_TILE))
+        {
+            readTipDelta(p, tip);
+        }
+        if (member & MemberFlags::DIFFERENT_ROLE)
+        {
+            int rawRole = p.getUnsignedShort();
+            p += 2;
+            if (rawRole & 1)
+            {
+                roleCode = rawRole >> 1;
+                localRole = nullptr;
+            }
+            else
+            {
+                rawRole |= static_cast<int>(p.getShort()) << 16;
+                roleCode = -1;
+                localRole = reinterpret_cast<const ShortVarString*>(
+                    p.ptr() + ((rawRole >> 1) - 2)); // signed
+                p += 2;
+            }
+        }
+        if (member & MemberFlags::FOREIGN)
+        {
+            chunk.pending.push_back({ tip,
+                static_cast<uint32_t>((member & 0xffff'fff0) >> 2),
+                chunk.entries.size() });
+            chunk.entries.push_back({ FeaturePtr(nullptr), parent, roleCode, localRole });
+        }
+        else
+        {
+            FeaturePtr feature(pCurrent.andMask(0xffff'ffff'ffff'fffc) +
+                ((int32_t)(member & 0xffff'fff8) >> 1));
+            chunk.entries.push_back({ feature, parent, roleCode, localRole });
+        }
+    }
+    while ((member & MemberFlags::LAST) == 0);
+}
+
+void decodeParents(FeaturePtr feature, uint32_t parent, Chunk& chunk)
+{
+    if (!feature.isRelationMember()) return;
+    DataPtr p = feature.relationTableFast();
+    Tip tip = FeatureConstants::START_TIP;
+    int32_t rel;
+    do
+    {
+        DataPtr pCurrent = p;
+        rel = p.getInt();
+        p += 4;
+        if (rel & MemberFlags::FOREIGN)
+        {
+            if (rel & MemberFlags::DIFFERENT_TILE) readTipDelta(p, tip);
+            chunk.pending.push_back({ tip,
+                static_cast<uint32_t>((rel & 0xffff'fff0) >> 2),
+                chunk.entries.size() });
+            chunk.entries.push_back({ FeaturePtr(nullptr), parent, -1, nullptr });
+        }
+        else
+        {
+            FeaturePtr relation(pCurrent + ((int32_t)(rel & 0xffff'fffc) >> 1));
+            chunk.entries.push_back({ relation, parent, -1, nullptr });
+        }
+    }
+    while ((rel & MemberFlags::LAST) == 0);
+}
+
+template<typename T, typename Decode>
+std::vector<Entry> resolveAll(FeatureStore* store, std::span<const T> items,
+    int threads, Decode decode)
+{
+    if (threads <= 0) threads = store->executor().threadCount();
+    size_t chunkCount = (items.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<Chunk> chunks(chunkCount);
+    runParallel(threads, chunkCount, [&chunks, items, &decode](size_t n)
+    {
+        size_t end = std::min((n + 1) * CHUNK_SIZE, items.size());
+        for (size_t i = n * CHUNK_SIZE; i < end; i++)
+        {
+            decode(items[i], static_cast<uint32_t>(i), chunks[n]);
+        }
+    });
+
+    size_t entryCount = 0;
+    size_t pendingCount = 0;
+    for (const Chunk& chunk : chunks)
+    {
+        entryCount += chunk.entries.size();
+        pendingCount += chunk.pending.size();
+    }
+    std::vector<Entry> entries;
+    entries.reserve(entryCount);
+    std::vector<Pending> pending;
+    pending.reserve(pendingCount);
+    for (Chunk& chunk : chunks)
+    {
+        uint64_t start = entries.size();
+        entries.insert(entries.end(), chunk.entries.begin(), chunk.entries.end());
+        for (Pending item : chunk.pending)
+        {
+            item.pos += start;
+            pending.push_back(item);
+        }
+        chunk = Chunk();
+    }
+    if (pending.empty()) return entries;
+
+    // Group the foreign features by tile
+    std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b)
+    {
+        return a.tip < b.tip;
+    });
+    std::vector<size_t> groups;         // the start of each group
+    for (size_t i = 0; i < pending.size(); i++)
+    {
+        if (i == 0 || pending[i].tip != pending[i-1].tip) groups.push_back(i);
+    }
+    groups.push_back(pending.size());
+    runParallel(threads, groups.size() - 1, [store, &pending, &groups, &entries](size_t n)
+    {
+        DataPtr pTile = store->fetchTile(Tip(pending[groups[n]].tip));
+        for (size_t i = groups[n]; i < groups[n+1]; i++)
+        {
+            entries[pending[i].pos].feature = FeaturePtr(pTile + pending[i].offset);
+        }
+    });
+    return entries;
+}
+
+} // namespace
+
+
+std::vector<Entry> MemberBatch::membersOf(FeatureStore* store,
+    std::span<const RelationPtr> relations, int threads)
+{
+    return resolveAll(store, relations, threads, decodeMembers);
+}
+
+
+std::vector<Entry> MemberBatch::parentsOf(FeatureStore* store,
+    std::span<const FeaturePtr> features, int threads)
+{
+    return resolveAll(store, features, threads, decodeParents);
+}
+
+} // namespace geodesk
@@ -15,7 +15,8 @@ extern volatile uint32_t performance_blackhole;
 using namespace clarisma;
 
 MemberIterator::MemberIterator(FeatureStore* store, DataPtr pMembers,
-    FeatureTypes types, const MatcherHolder* matcher, const Filter* filter) : 
+    FeatureTypes types, const MatcherHolder* matcher, const Filter* filter,
+    TileCache* tiles) :
     store_(store),
     types_(types),
     matcher_(matcher),
@@ -23,12 +24,25 @@ MemberIterator::MemberIterator(FeatureStore* store, DataPtr pMembers,
     p_(pMembers),
     currentTip_(FeatureConstants::START_TIP),
     currentRoleCode_(0),
-    currentRoleStr_(nullptr)
+    currentRoleStr_(nullptr),
     // pForeignTile_(nullptr)   // null by default
+    sharedTiles_(tiles)
 {
     // check for empty relation
     currentMember_ = p_.getIntUnaligned() == 0 ? MemberFlags::LAST : 0;
-    currentMatcher_ = &matcher->mainMatcher(); // TODO: select based on role
+    // Members are grouped by role, so the role matcher is only
+    // consulted whenever the role changes (members start out with
+    // the empty role)
+    if (matcher->acceptsAllRoles())
+    {
+        roleMatcher_ = nullptr;
+        currentMatcher_ = &matcher->mainMatcher();
+    }
+    else
+    {
+        roleMatcher_ = &matcher->roleMatcher();
+        currentMatcher_ = roleMatcher_->accept(0, nullptr);
+    }
     #ifdef GEODESK_PYTHON
     // currentRoleObject_ = store->strings().getStringObject(0);
         // TODO: this bumps the refcount; let's use a "borrow" function instead!
@@ -110,9 +124,14 @@ FeaturePtr MemberIterator::next()
             // TODO: we may increase efficiency by only fetching the currentRoleStr_
             // if the role is accepted by the matcher, but this design is simpler
              
-            // TODO: get matcher for this new role
-            // (null if role is not accepted)
-            // currentMatcher = matcher.acceptRole(role, roleString);
+            if (roleMatcher_)
+            {
+                // null if role is not accepted, in which case all
+                // members up to the next role change are skipped
+                // without being decoded
+                currentMatcher_ = roleMatcher_->accept(
+                    currentRoleCode_, currentRoleStr_);
+            }
         }
         
         if (currentMatcher_ != nullptr)
@@ -126,7 +145,7 @@ FeaturePtr MemberIterator::next()
                 if (!pForeignTile_)
                 {
                     // foreign tile not resolved yet
-                    pForeignTile_ = store_->fetchTile(currentTip_);
+                    pForeignTile_ = tiles().get(store_, currentTip_);
                 }
                 feature = FeaturePtr(pForeignTile_ +
                     ((currentMember_ & 0xffff'fff0) >> 2));
@@ -0,0 +1,311 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/NameIndex.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/Tags.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// A reference to a feature: its TIP in the upper 32 bits, and its
+/// offset within the tile in the lower 32 bits (so references sort
+/// by tile)
+uint64_t featureRef(Tip tip, uint32_t offset)
+{
+    return (static_cast<uint64_t>(tip) << 32) | offset;
+}
+
+bool isNameKey(std::string_view key)
+{
+    return key.starts_with("name") && (key.size() == 4 || key[4] == ':');
+}
+
+/// Adds the trigrams of a normalized string
+void addTrigrams(std::string_view s, std::vector<uint32_t>& trigrams)
+{
+    for (size_t i = 0; i + 3 <= s.size(); i++)
+    {
+        trigrams.push_back(
+            (static_cast<uint32_t>(static_cast<uint8_t>(s[i])) << 16) |
+            (static_cast<uint32_t>(static_cast<uint8_t>(s[i + 1])) << 8) |
+            static_cast<uint8_t>(s[i + 2]));
+    }
+}
+
+} // namespace
+
+
+/// Collects the trigrams of the names of each feature of a tile
+/// (skipping the copies of features that live in multiple tiles)
+class NameIndex::Builder
+{
+public:
+    Builder(FeatureStore* store, std::vector<std::pair<uint32_t, uint64_t>>& postings) :
+        store_(store), postings_(postings) {}
+
+    void addTile(Tip tip)
+    {
+        tip_ = tip;
+        pTile_ = store_->fetchTile(tip);
+        TileFeatureWalker::forEachFirstCopy(pTile_,
+            [this](FeaturePtr pFeature, FeatureIndexType)
+            {
+                addFeature(pFeature);
+            });
+    }
+
+private:
+    void addFeature(FeaturePtr pFeature)
+    {
+        trigrams_.clear();
+        for (Tag tag : Tags(store_, pFeature))
+        {
+            if (!isNameKey(tag.key())) continue;
+            addTrigrams(normalize(static_cast<std::string>(tag.value())), trigrams_);
+        }
+        if (trigrams_.empty()) return;
+        std::sort(trigrams_.begin(), trigrams_.end());
+        trigrams_.erase(std::unique(trigrams_.begin(), trigrams_.end()), trigrams_.end());
+        uint64_t ref = featureRef(tip_, static_cast<uint32_t>(
+            pFeature.ptr().ptr() - pTile_.ptr()));
+        for (uint32_t trigram : trigrams_) postings_.emplace_back(trigram, ref);
+    }
+
+    FeatureStore* store_;
+    std::vector<std::pair<uint32_t, uint64_t>>& postings_;
+    std::vector<uint32_t> trigrams_;
+    Tip tip_;
+    DataPtr pTile_;
+};
+
+
+std::unique_ptr<NameIndex> NameIndex::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<NameIndex> index(new NameIndex());
+    const Header* header = index->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "name index");
+    if (!header) return nullptr;
+    uint64_t size = index->file_.size();
+    if (size != sizeof(Header) + header->trigramCount * sizeof(Entry) +
+            header->postingsSize)
+    {
+        return nullptr;
+    }
+    index->entries_ = reinterpret_cast<const Entry*>(header + 1);
+    index->trigramCount_ = header->trigramCount;
+    index->postings_ = reinterpret_cast<const uint8_t*>(
+        index->entries_ + header->trigramCount);
+    return index;
+}
+
+
+/**
+ * Each thread claims the next tile in turn and collects pairs of
+ * trigram and feature reference; once all tiles have been scanned,
+ * the pairs are sorted, grouped into posting lists and written to the
+ * sidecar.
+ */
+void NameIndex::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize, int threads)
+{
+    std::vector<Tip> tips;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        tips.push_back(walker.currentTip());
+    }
+
+    if (threads <= 0) threads = store->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tips.size()), 1));
+    std::vector<std::vector<std::pair<uint32_t, uint64_t>>> batches(threadCount);
+    std::atomic<size_t> nextTile(0);
+    auto scanAll = [store, &tips, &nextTile](std::vector<std::pair<uint32_t, uint64_t>>* postings)
+    {
+        Builder builder(store, *postings);
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tips.size()) return;
+            builder.addTile(tips[n]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(scanAll, &batches[i]);
+    }
+    scanAll(&batches[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    std::vector<std::pair<uint32_t, uint64_t>> postings = std::move(batches[0]);
+    for (int i = 1; i < threadCount; i++)
+    {
+        postings.insert(postings.end(), batches[i].begin(), batches[i].end());
+        batches[i].clear();
+        batches[i].shrink_to_fit();
+    }
+    std::sort(postings.begin(), postings.end());
+
+    std::vector<Entry> entries;
+    std::vector<uint8_t> data;
+    uint8_t buf[16];
+    for (size_t i = 0; i < postings.size(); )
+    {
+        uint32_t trigram = postings[i].first;
+        Entry entry = { trigram, 0, data.size() };
+        uint64_t prevRef = 0;
+        for (; i < postings.size() && postings[i].first == trigram; i++)
+        {
+            uint8_t* p = buf;
+            writeVarint(p, postings[i].second - prevRef);
+            data.insert(data.end(), buf, p);
+            prevRef = postings[i].second;
+            entry.count++;
+        }
+        entries.push_back(entry);
+    }
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        entries.size(), data.size() };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(entries.data(), entries.size() * sizeof(Entry));
+    file.write(data.data(), data.size());
+    file.commit();
+}
+
+
+const NameIndex::Entry* NameIndex::find(uint32_t trigram) const
+{
+    const Entry* end = entries_ + trigramCount_;
+    const Entry* entry = std::lower_bound(entries_, end, trigram,
+        [](const Entry& e, uint32_t t) { return e.trigram < t; });
+    return (entry == end || entry->trigram != trigram) ? nullptr : entry;
+}
+
+
+void NameIndex::decode(const Entry* entry, std::vector<uint64_t>& refs) const
+{
+    refs.clear();
+    refs.reserve(entry->count);
+    const uint8_t* p = postings_ + entry->offset;
+    uint64_t ref = 0;
+    for (uint32_t i = 0; i < entry->count; i++)
+    {
+        ref += readVarint64(p);
+        refs.push_back(ref);
+    }
+}
+
+
+/**
+ * The posting lists are intersected shortest first, so the candidates
+ * only ever shrink.
+ */
+bool NameIndex::candidates(FeatureStore* store, std::string_view text,
+    std::vector<FeaturePtr>& features) const
+{
+    std::vector<uint32_t> trigrams;
+    addTrigrams(text, trigrams);
+    if (trigrams.empty()) return false;
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::vector<const Entry*> lists;
+    for (uint32_t trigram : trigrams)
+    {
+        const Entry* entry = find(trigram);
+        if (!entry) return true;        // no name has this trigram
+        lists.push_back(entry);
+    }
+    std::sort(lists.begin(), lists.end(),
+        [](const Entry* a, const Entry* b) { return a->count < b->count; });
+
+    std::vector<uint64_t> refs;
+    std::vector<uint64_t> other;
+    std::vector<uint64_t> common;
+    decode(lists[0], refs);
+    for (size_t i = 1; i < lists.size() && !refs.empty(); i++)
+    {
+        decode(lists[i], other);
+        common.clear();
+        std::set_intersection(refs.begin(), refs.end(),
+            other.begin(), other.end(), std::back_inserter(common));
+        refs.swap(common);
+    }
+
+    DataPtr pTile;
+    Tip currentTip;
+    for (size_t i = 0; i < refs.size(); i++)
+    {
+        Tip tip(static_cast<uint32_t>(refs[i] >> 32));
+        if (i == 0 || tip != currentTip)
+        {
+            currentTip = tip;
+            pTile = store->fetchTile(tip);
+        }
+        features.push_back(FeaturePtr(pTile + static_cast<uint32_t>(refs[i])));
+    }
+    return true;
+}
+
+
+/**
+ * Lowercases A-Z, as well as the uppercase letters of Latin-1
+ * (U+00C0 to U+00DE, except U+00D7), which are encoded in UTF-8
+ * as 0xC3 0x80 to 0xC3 0x9E.
+ */
+std::string NameIndex::normalize(std::string_view s)
+{
+    std::string normalized(s);
+    for (size_t i = 0; i < normalized.size(); i++)
+    {
+        char& ch = normalized[i];
+        if (ch >= 'A' && ch <= 'Z')
+        {
+            ch += 'a' - 'A';
+        }
+        else if (static_cast<uint8_t>(ch) == 0xC3 && i + 1 < normalized.size())
+        {
+            uint8_t next = static_cast<uint8_t>(normalized[i + 1]);
+            if (next >= 0x80 && next <= 0x9E && next != 0x97)
+            {
+                normalized[i + 1] = static_cast<char>(next + 0x20);
+            }
+            i++;
+        }
+    }
+    return normalized;
+}
+
+
+bool NameIndex::namesContain(FeatureStore* store, FeaturePtr feature,
+    std::string_view text)
+{
+    for (Tag tag : Tags(store, feature))
+    {
+        if (!isNameKey(tag.key())) continue;
+        if (normalize(static_cast<std::string>(tag.value())).find(text) !=
+            std::string::npos)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace geodesk
@@ -0,0 +1,325 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/NumericIndex.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// Returns the value of a key as a number (NaN if the tags don't have
+/// the key, or its value isn't numeric)
+double numberOf(FeatureStore* store, TagTablePtr tags, Key key)
+{
+    TagBits value = tags.getKeyValue(key);
+    if (value == 0) return std::numeric_limits<double>::quiet_NaN();
+    return static_cast<double>(tags.tagValue(value, store->strings()));
+}
+
+uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+} // namespace
+
+
+/// Collects the values of the indexed keys of the features of a tile.
+/// Every feature counts towards the value range of the tile, but the
+/// copies of features that live in multiple tiles are left out of the
+/// sorted values.
+class NumericIndex::Builder
+{
+public:
+    struct Batch
+    {
+        std::vector<TileRange> tiles;
+        std::vector<Value> values;
+    };
+
+    Builder(FeatureStore* store, const std::vector<Key>& keys, std::vector<Batch>& batches) :
+        store_(store), keys_(keys), batches_(batches) {}
+
+    void addTile(Tip tip)
+    {
+        tip_ = tip;
+        pTile_ = store_->fetchTile(tip);
+        ranges_.assign(keys_.size(), TileRange{ tip, 0,
+            std::numeric_limits<double>::infinity(),
+            -std::numeric_limits<double>::infinity() });
+        TileFeatureWalker::forEachFeature(pTile_,
+            [this](FeaturePtr pFeature, FeatureIndexType)
+            {
+                addFeature(pFeature, TileFeatureWalker::isFirstCopy(pFeature));
+            });
+        for (size_t i = 0; i < keys_.size(); i++)
+        {
+            if (ranges_[i].count) batches_[i].tiles.push_back(ranges_[i]);
+        }
+    }
+
+private:
+    void addFeature(FeaturePtr pFeature, bool isFirstCopy)
+    {
+        TagTablePtr tags = pFeature.tags();
+        for (size_t i = 0; i < keys_.size(); i++)
+        {
+            double value = numberOf(store_, tags, keys_[i]);
+            if (std::isnan(value)) continue;
+            TileRange& range = ranges_[i];
+            range.count++;
+            range.min = std::min(range.min, value);
+            range.max = std::max(range.max, value);
+            if (isFirstCopy)
+            {
+                batches_[i].values.push_back({ value, tip_,
+                    static_cast<uint32_t>(pFeature.ptr().ptr() - pTile_.ptr()) });
+            }
+        }
+    }
+
+    FeatureStore* store_;
+    const std::vector<Key>& keys_;
+    std::vector<Batch>& batches_;       // one per key
+    std::vector<TileRange> ranges_;     // of the current tile, one per key
+    Tip tip_;
+    DataPtr pTile_;
+};
+
+
+std::unique_ptr<NumericIndex> NumericIndex::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<NumericIndex> index(new NumericIndex());
+    const Header* header = index->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "numeric index");
+    if (!header) return nullptr;
+    uint64_t size = index->file_.size();
+    bool valid = size >= sizeof(Header) + header->keyCount * sizeof(KeyEntry);
+    const KeyEntry* keys = reinterpret_cast<const KeyEntry*>(header + 1);
+    for (uint32_t i = 0; valid && i < header->keyCount; i++)
+    {
+        const KeyEntry& key = keys[i];
+        valid = key.nameOffset + key.nameLength <= size &&
+            key.tilesOffset + key.tileCount * sizeof(TileRange) <= size &&
+            key.valuesOffset + key.valueCount * sizeof(Value) <= size;
+    }
+    if (!valid) return nullptr;
+    index->keys_ = keys;
+    index->keyCount_ = header->keyCount;
+    return index;
+}
+
+
+/**
+ * Each thread claims the next tile in turn and collects the tile ranges
+ * and values of each key; once all tiles have been scanned, the batches
+ * of each key are merged and sorted, and written to the sidecar.
+ */
+void NumericIndex::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize,
+    const std::vector<std::string>& keyNames, int threads)
+{
+    std::vector<Key> keys;
+    keys.reserve(keyNames.size());
+    for (const std::string& name : keyNames) keys.push_back(store->key(name));
+
+    std::vector<Tip> tips;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        tips.push_back(walker.currentTip());
+    }
+
+    if (threads <= 0) threads = store->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tips.size()), 1));
+    std::vector<std::vector<Builder::Batch>> batches(threadCount,
+        std::vector<Builder::Batch>(keys.size()));
+    std::atomic<size_t> nextTile(0);
+    auto scanAll = [store, &keys, &tips, &nextTile](std::vector<Builder::Batch>* batch)
+    {
+        Builder builder(store, keys, *batch);
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tips.size()) return;
+            builder.addTile(tips[n]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(scanAll, &batches[i]);
+    }
+    scanAll(&batches[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    std::vector<Builder::Batch> merged(keys.size());
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        Builder::Batch& m = merged[k];
+        for (int i = 0; i < threadCount; i++)
+        {
+            Builder::Batch& b = batches[i][k];
+            m.tiles.insert(m.tiles.end(), b.tiles.begin(), b.tiles.end());
+            m.values.insert(m.values.end(), b.values.begin(), b.values.end());
+            b = Builder::Batch();
+        }
+        std::sort(m.tiles.begin(), m.tiles.end(),
+            [](const TileRange& a, const TileRange& b) { return a.tip < b.tip; });
+        std::sort(m.values.begin(), m.values.end(),
+            [](const Value& a, const Value& b)
+            {
+                if (a.value != b.value) return a.value < b.value;
+                if (a.tip != b.tip) return a.tip < b.tip;
+                return a.offset < b.offset;
+            });
+    }
+
+    std::vector<KeyEntry> entries(keys.size());
+    uint64_t pos = sizeof(Header) + keys.size() * sizeof(KeyEntry);
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        KeyEntry& entry = entries[k];
+        entry.keyCode = keys[k].code();
+        entry.nameLength = static_cast<uint32_t>(keyNames[k].size());
+        entry.nameOffset = pos;
+        pos = align8(pos + entry.nameLength);
+    }
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        KeyEntry& entry = entries[k];
+        entry.tileCount = merged[k].tiles.size();
+        entry.tilesOffset = pos;
+        pos += entry.tileCount * sizeof(TileRange);
+        entry.valueCount = merged[k].values.size();
+        entry.valuesOffset = pos;
+        pos += entry.valueCount * sizeof(Value);
+    }
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        static_cast<uint32_t>(keys.size()), 0 };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(entries.data(), entries.size() * sizeof(KeyEntry));
+    static const char PADDING[8] = {};
+    for (size_t k = 0; k < keys.size(); k++)
+    {
+        file.write(keyNames[k].data(), keyNames[k].size());
+        size_t end = entries[k].nameOffset + entries[k].nameLength;
+        file.write(PADDING, align8(end) - end);
+    }
+    for (const Builder::Batch& m : merged)
+    {
+        file.write(m.tiles.data(), m.tiles.size() * sizeof(TileRange));
+        file.write(m.values.data(), m.values.size() * sizeof(Value));
+    }
+    file.commit();
+}
+
+
+std::string_view NumericIndex::keyName(int n) const
+{
+    const KeyEntry& key = keys_[n];
+    return { reinterpret_cast<const char*>(data() + key.nameOffset), key.nameLength };
+}
+
+
+uint64_t NumericIndex::valueCount(int n) const
+{
+    return keys_[n].valueCount;
+}
+
+
+int NumericIndex::findKey(std::string_view key) const
+{
+    for (uint32_t i = 0; i < keyCount_; i++)
+    {
+        if (keyName(static_cast<int>(i)) == key) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+
+int NumericIndex::findGlobalKey(int keyCode) const
+{
+    if (keyCode < 0) return -1;
+    for (uint32_t i = 0; i < keyCount_; i++)
+    {
+        if (keys_[i].keyCode == keyCode) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+
+bool NumericIndex::mayMatchTile(int n, Tip tip, double min, double max) const
+{
+    const KeyEntry& key = keys_[n];
+    const TileRange* begin = tiles(key);
+    const TileRange* end = begin + key.tileCount;
+    const TileRange* range = std::lower_bound(begin, end, static_cast<uint32_t>(tip),
+        [](const TileRange& r, uint32_t t) { return r.tip < t; });
+    if (range == end || range->tip != static_cast<uint32_t>(tip)) return false;
+    return range->min <= max && range->max >= min;
+}
+
+
+/**
+ * The references of the values in the range are sorted by tile
+ * first, so each tile is fetched only once.
+ */
+void NumericIndex::candidates(FeatureStore* store, int n, double min, double max,
+    std::vector<FeaturePtr>& features) const
+{
+    const KeyEntry& key = keys_[n];
+    const Value* begin = values(key);
+    const Value* end = begin + key.valueCount;
+    const Value* first = std::lower_bound(begin, end, min,
+        [](const Value& v, double x) { return v.value < x; });
+    const Value* last = std::upper_bound(first, end, max,
+        [](double x, const Value& v) { return x < v.value; });
+    if (first >= last) return;
+
+    std::vector<uint64_t> refs;
+    refs.reserve(last - first);
+    for (const Value* p = first; p < last; p++)
+    {
+        refs.push_back((static_cast<uint64_t>(p->tip) << 32) | p->offset);
+    }
+    std::sort(refs.begin(), refs.end());
+
+    DataPtr pTile;
+    Tip currentTip;
+    for (size_t i = 0; i < refs.size(); i++)
+    {
+        Tip tip(static_cast<uint32_t>(refs[i] >> 32));
+        if (i == 0 || tip != currentTip)
+        {
+            currentTip = tip;
+            pTile = store->fetchTile(tip);
+        }
+        features.push_back(FeaturePtr(pTile + static_cast<uint32_t>(refs[i])));
+    }
+}
+
+
+double NumericIndex::numericValue(FeatureStore* store, FeaturePtr feature, Key key)
+{
+    return numberOf(store, feature.tags(), key);
+}
+
+} // namespace geodesk
@@ -9,14 +9,16 @@ namespace geodesk {
 
 
 ParentRelationIterator::ParentRelationIterator(FeatureStore* store, DataPtr pRelTable,
-    const MatcherHolder* matcher, const Filter* filter) :
+    const MatcherHolder* matcher, const Filter* filter,
+    TileCache* tiles) :
     store_(store),
     matcher_(matcher),
     filter_(filter),
     p_(pRelTable),
     currentTip_(FeatureConstants::START_TIP),
     // pForeignTile_(nullptr),  // defaults to nullptr
-    currentRel_(0)
+    currentRel_(0),
+    sharedTiles_(tiles)
 {
 }
 
@@ -43,7 +45,7 @@ RelationPtr ParentRelationIterator::next()
                 }
                 tipDelta >>= 1;     // signed
                 currentTip_ += tipDelta;
-                pForeignTile_ = store_->fetchTile(currentTip_);
+                pForeignTile_ = tiles().get(store_, currentTip_);
             }
             rel = RelationPtr(pForeignTile_ + ((currentRel_ & 0xffff'fff0) >> 2));
         }
@@ -0,0 +1,115 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/RelationTreeCache.h>
+#include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/feature/WayPtr.h>
+
+namespace geodesk {
+
+RelationTreeCache::RelationTreeCache(size_t maxBytes, size_t minLeaves) :
+    maxBytes_(maxBytes),
+    minLeaves_(minLeaves),
+    bytes_(0),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+/**
+ * The tree is walked without holding the lock, so two threads that
+ * need the same relation at the same time may both walk it.
+ */
+std::shared_ptr<const RelationTreeCache::Leaves> RelationTreeCache::leaves(
+    FeatureStore* store, RelationPtr relation)
+{
+    uint64_t id = relation.idBits();
+    {
+        std::lock_guard lock(mutex_);
+        auto it = entries_.find(id);
+        if (it != entries_.end()) return it->second;
+    }
+    auto leaves = std::make_shared<Leaves>();
+    collect(store, relation, *leaves);
+    if (leaves->size() < minLeaves_) return leaves;
+
+    size_t size = BYTES_PER_ENTRY + leaves->capacity() * sizeof(FeaturePtr);
+    std::lock_guard lock(mutex_);
+    if (bytes_ + size > maxBytes_)
+    {
+        entries_.clear();
+        bytes_ = 0;
+        if (size > maxBytes_) return leaves;
+    }
+    if (entries_.emplace(id, leaves).second) bytes_ += size;
+    return leaves;
+}
+
+
+void RelationTreeCache::collect(FeatureStore* store, RelationPtr relation, Leaves& leaves)
+{
+    RecursionGuard guard(relation);
+    TileCache tiles;
+    collect(store, relation, guard, tiles, leaves);
+}
+
+
+// All members of the relation tree share one TileCache
+void RelationTreeCache::collect(FeatureStore* store, RelationPtr relation,
+    RecursionGuard& guard, TileCache& tiles, Leaves& leaves)
+{
+    FastMemberIterator iter(store, relation, &tiles);
+    for (;;)
+    {
+        FeaturePtr member = iter.next();
+        if (member.isNull()) break;
+        int memberType = member.typeCode();
+        if (memberType == 1)
+        {
+            if (!WayPtr(member).isPlaceholder()) leaves.push_back(member);
+        }
+        else if (memberType == 0)
+        {
+            if (!NodePtr(member).isPlaceholder()) leaves.push_back(member);
+        }
+        else
+        {
+            RelationPtr childRel(member);
+            if (!childRel.isPlaceholder() && guard.checkAndAdd(childRel))
+            {
+                collect(store, childRel, guard, tiles, leaves);
+            }
+        }
+    }
+}
+
+
+size_t RelationTreeCache::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+void RelationTreeCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    entries_.clear();
+    bytes_ = 0;
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+
+std::shared_ptr<const RelationTreeCache::Leaves> RelationTreeCache::leavesOf(
+    FeatureStore* store, RelationPtr relation)
+{
+    RelationTreeCache* cache = store->relationTreeCache();
+    if (!cache) return nullptr;
+    return cache->leaves(store, relation);
+}
+
+} // namespace geodesk
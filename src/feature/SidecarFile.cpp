@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/SidecarFile.h>
+#include <filesystem>
+#include <clarisma/io/IOException.h>
+#include <clarisma/util/log.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+const void* SidecarFile::map(const std::string& fileName, const Header& expected,
+    size_t headerSize, const char* what)
+{
+    if (!File::exists(fileName.c_str())) return nullptr;
+    try
+    {
+        file_.open(fileName.c_str(), File::OpenMode::READ);
+        uint64_t size = file_.size();
+        if (size < headerSize)
+        {
+            file_.close();
+            return nullptr;
+        }
+        mapping_ = file_.map(0, size, MappedFile::MappingMode::READ);
+        size_ = size;
+        const Header* header = reinterpret_cast<const Header*>(mapping_);
+        if (header->magic != expected.magic ||
+            header->version != expected.version ||
+            header->storeTimestamp != expected.storeTimestamp ||
+            header->storeSize != expected.storeSize)
+        {
+            close();
+            return nullptr;
+        }
+        return mapping_;
+    }
+    catch (const IOException& ex)
+    {
+        LOG("Failed to open %s %s: %s", what, fileName.c_str(), ex.what());
+        close();
+        return nullptr;
+    }
+}
+
+
+void SidecarFile::close()
+{
+    if (mapping_)
+    {
+        MappedFile::unmap(mapping_, size_);
+        mapping_ = nullptr;
+        size_ = 0;
+    }
+    if (file_.isOpen()) file_.close();
+}
+
+
+SidecarFile::Writer::Writer(const std::string& fileName) :
+    fileName_(fileName),
+    tempFileName_(fileName + ".tmp")
+{
+    open(tempFileName_.c_str(), OpenMode::WRITE |
+        OpenMode::CREATE | OpenMode::REPLACE_EXISTING);
+}
+
+
+SidecarFile::Writer::~Writer()
+{
+    if (committed_) return;
+    if (isOpen()) close();
+    std::error_code error;
+    std::filesystem::remove(tempFileName_, error);
+}
+
+
+void SidecarFile::Writer::commit()
+{
+    close();
+    std::filesystem::rename(tempFileName_, fileName_);
+    committed_ = true;
+}
+
+} // namespace geodesk
@@ -0,0 +1,349 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/FeatureStore.h>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <clarisma/thread/TaskEngine.h>
+#include <clarisma/util/DataPtr.h>
+#include <geodesk/feature/TileCompression.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/**
+ * Walks the spatial indexes of a single tile, checking that every
+ * pointer it follows stays within the tile. Stops at the first defect.
+ */
+class TileChecker
+{
+public:
+    TileChecker(const uint8_t* pTile, uint32_t payloadSize) :
+        start_(pTile),
+        size_(static_cast<int64_t>(payloadSize) + 4)
+    {
+    }
+
+    /// @return nullptr if the tile is intact, otherwise a description
+    ///   of the first defect
+    const char* check()
+    {
+        if (size_ < 24) return "Tile is too small";
+        if (!checkIndex(8, true)) return error_;
+        for (int i = 1; i <= 3; i++)
+        {
+            if (!checkIndex(8 + i * 4, false)) return error_;
+        }
+        return nullptr;
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 32;
+
+    bool fail(const char* msg)
+    {
+        error_ = msg;
+        return false;
+    }
+
+    bool isValid(int64_t ofs, int64_t len) const
+    {
+        return ofs >= 0 && ofs + len <= size_ && (ofs & 3) == 0;
+    }
+
+    int32_t intAt(int64_t ofs) const
+    {
+        return DataPtr(start_ + ofs).getInt();
+    }
+
+    bool checkIndex(int64_t ofsRoot, bool isNodes)
+    {
+        int32_t ptr = intAt(ofsRoot);
+        if (ptr == 0) return true;
+        if ((ptr & 1) == 0) return checkRoot(ofsRoot, isNodes);
+
+        // Multiple roots, one per key category
+        int64_t ofs = ofsRoot + (ptr ^ 1);
+        for (;;)
+        {
+            if (!isValid(ofs, 8)) return fail("Bad index root pointer");
+            if (!checkRoot(ofs, isNodes)) return false;
+            if (intAt(ofs) & 1) return true;
+            ofs += 8;
+        }
+    }
+
+    bool checkRoot(int64_t ofsEntry, bool isNodes)
+    {
+        int32_t ptr = intAt(ofsEntry);
+        if (ptr == 0) return true;
+        return checkChild(ofsEntry + (ptr & 0xffff'fffc), (ptr & 2) != 0,
+            isNodes, 0);
+    }
+
+    bool checkChild(int64_t ofs, bool isLeaf, bool isNodes, int depth)
+    {
+        if (isLeaf) return isNodes ? checkNodeLeaf(ofs) : checkLeaf(ofs);
+        return checkBranch(ofs, isNodes, depth + 1);
+    }
+
+    bool checkBranch(int64_t ofs, bool isNodes, int depth)
+    {
+        if (depth > MAX_DEPTH) return fail("Index is too deep (cyclic?)");
+        for (;;)
+        {
+            if (!isValid(ofs, 20)) return fail("Bad branch pointer");
+            if (!checkBox(ofs + 4)) return false;
+            int32_t ptr = intAt(ofs);
+            if (!checkChild(ofs + (ptr & 0xffff'fffc), (ptr & 2) != 0,
+                isNodes, depth))
+            {
+                return false;
+            }
+            if (ptr & 1) return true;
+            ofs += 20;
+        }
+    }
+
+    bool checkNodeLeaf(int64_t ofs)
+    {
+        for (;;)
+        {
+            if (!isValid(ofs, 20)) return fail("Bad node leaf pointer");
+            int32_t flags = intAt(ofs + 8);
+            // Nodes that are relation members have a relation table pointer
+            if (!isValid(ofs, 20 + (flags & 4))) return fail("Node is truncated");
+            if (!checkTags(ofs + 16)) return false;
+            if (flags & 1) return true;
+            ofs += 20 + (flags & 4);
+        }
+    }
+
+    bool checkLeaf(int64_t ofs)
+    {
+        for (;;)
+        {
+            if (!isValid(ofs, 32)) return fail("Bad leaf pointer");
+            if (!checkBox(ofs)) return false;
+            if (!checkTags(ofs + 24)) return false;
+            if (intAt(ofs + 16) & 1) return true;
+            ofs += 32;
+        }
+    }
+
+    bool checkBox(int64_t ofs)
+    {
+        if (intAt(ofs) > intAt(ofs + 8) || intAt(ofs + 4) > intAt(ofs + 12))
+        {
+            return fail("Invalid bounding box");
+        }
+        return true;
+    }
+
+    bool checkTags(int64_t ofsPtr)
+    {
+        int64_t ofsTags = ofsPtr + (intAt(ofsPtr) & ~1);
+        if (ofsTags < 0 || ofsTags >= size_) return fail("Bad tag table pointer");
+        return true;
+    }
+
+    const uint8_t* start_;
+    int64_t size_;
+    const char* error_ = nullptr;
+};
+
+struct TileCheckTask
+{
+    Tip tip;
+};
+
+struct TileCheckResult
+{
+    Tip tip;
+    std::string error;      // empty if the tile is intact
+};
+
+} // namespace
+
+class StoreVerifier;
+
+class StoreVerifierContext
+{
+public:
+    explicit StoreVerifierContext(StoreVerifier* verifier) : verifier_(verifier) {}
+
+    void processTask(TileCheckTask& task);
+    void afterTasks() {}
+    void harvestResults() {}
+
+private:
+    StoreVerifier* verifier_;
+};
+
+/**
+ * Checks tiles on the worker threads of a TaskEngine, which report
+ * their progress directly; the output thread collects the defects.
+ */
+class StoreVerifier : public TaskEngine<StoreVerifier, StoreVerifierContext,
+    TileCheckTask, TileCheckResult>
+{
+public:
+    StoreVerifier(FeatureStore* store, int threads,
+        ProgressReporter* progress, FeatureStore::VerifyResult& result) :
+        TaskEngine(threads),
+        store_(store),
+        progress_(progress),
+        result_(result)
+    {
+    }
+
+    void run(const std::vector<Tip>& tips)
+    {
+        start();
+        for (Tip tip : tips) postWork(TileCheckTask{ tip });
+        end();
+    }
+
+    void processTask(TileCheckResult& result)
+    {
+        if (!result.error.empty())
+        {
+            result_.errors.push_back(
+                "Tile " + result.tip.toString() + ": " + result.error);
+        }
+        result_.tilesVerified++;
+    }
+
+    std::string checkTile(Tip tip)
+    {
+        uint64_t ofs = store_->tileOffset(tip);
+        uint64_t storeSize = store_->getTrueSize();
+        if (ofs == 0 || ofs + 4 > storeSize) return "Tile lies outside of the file";
+        DataPtr pTile = store_->mappedTile(tip);
+        uint32_t payloadSize = pTile.getUnsignedInt() & TileCompression::PAYLOAD_SIZE_MASK;
+        if (ofs + 4 + payloadSize > storeSize) return "Tile extends past the end of the file";
+        if (!TileCompression::isCompressed(pTile))
+        {
+            const char* error = TileChecker(pTile.ptr(), payloadSize).check();
+            return error ? error : "";
+        }
+
+        #ifdef GEODESK_WITH_ZLIB
+        uint32_t size = TileCompression::uncompressedSize(pTile.ptr());
+        if (payloadSize < 4 || size < 4 || size > TileCompression::PAYLOAD_SIZE_MASK)
+        {
+            return "Invalid size of compressed tile";
+        }
+        std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+        store_->tileCompression().decompress(pTile.ptr(), data.get());
+        const char* error = TileChecker(data.get(), size - 4).check();
+        return error ? error : "";
+        #else
+        return "";      // can't check compressed tiles without zlib
+        #endif
+    }
+
+    ProgressReporter* progress() const { return progress_; }
+
+private:
+    FeatureStore* store_;
+    ProgressReporter* progress_;
+    FeatureStore::VerifyResult& result_;
+};
+
+void StoreVerifierContext::processTask(TileCheckTask& task)
+{
+    TileCheckResult result;
+    result.tip = task.tip;
+    try
+    {
+        result.error = verifier_->checkTile(task.tip);
+    }
+    catch (const std::exception& ex)
+    {
+        result.error = ex.what();
+    }
+    verifier_->postOutput(std::move(result));
+    if (verifier_->progress()) verifier_->progress()->progress(1);
+}
+
+namespace {
+
+/**
+ * Checks that the strings of the string table lie within the file
+ * and are well-formed UTF-8.
+ */
+bool isStringTableValid(const uint8_t* p, const uint8_t* end)
+{
+    auto readVarint = [&p, end](uint32_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (p >= end) return false;
+            uint8_t b = *p++;
+            value |= static_cast<uint32_t>(b & 0x7f) << shift;
+            if ((b & 0x80) == 0) return true;
+        }
+        return false;
+    };
+
+    uint32_t count;
+    if (!readVarint(count)) return false;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t len;
+        if (!readVarint(len)) return false;
+        if (len > static_cast<size_t>(end - p)) return false;
+        const uint8_t* strEnd = p + len;
+        while (p < strEnd)
+        {
+            uint8_t b = *p++;
+            int extra = b < 0x80 ? 0 : (b & 0xe0) == 0xc0 ? 1 :
+                (b & 0xf0) == 0xe0 ? 2 : (b & 0xf8) == 0xf0 ? 3 : -1;
+            if (extra < 0 || extra > strEnd - p) return false;
+            for (; extra > 0; extra--)
+            {
+                if ((*p++ & 0xc0) != 0x80) return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+
+FeatureStore::VerifyResult FeatureStore::verify(int threads, const Box& box,
+    ProgressReporter* progress)
+{
+    VerifyResult result;
+    uint64_t storeSize = getTrueSize();
+    const uint8_t* pStrings = getPointer(STRING_TABLE_PTR_OFS).ptr();
+    uint64_t stringsOfs = static_cast<uint64_t>(
+        pStrings - reinterpret_cast<const uint8_t*>(mainMapping()));
+    if (stringsOfs >= storeSize || !isStringTableValid(pStrings,
+        pStrings + (storeSize - stringsOfs)))
+    {
+        result.errors.push_back("String table is corrupt");
+    }
+
+    std::vector<Tip> tips;
+    TileIndexWalker walker(tileIndex(), zoomLevels(), box, nullptr);
+    while (walker.next()) tips.push_back(walker.currentTip());
+    if (tips.empty()) return result;
+    if (progress) progress->start(tips.size());
+
+    if (threads <= 0) threads = static_cast<int>(std::thread::hardware_concurrency());
+    threads = std::clamp(threads, 1, static_cast<int>(tips.size()));
+    StoreVerifier verifier(this, threads, progress, result);
+    verifier.run(tips);
+    return result;
+}
+
+} // namespace geodesk
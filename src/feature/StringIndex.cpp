@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/StringIndex.h>
+#include <vector>
+#include <clarisma/util/Strings.h>
+#include <geodesk/feature/StringTable.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+std::unique_ptr<StringIndex> StringIndex::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<StringIndex> index(new StringIndex());
+    const Header* header = index->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "string index");
+    if (!header) return nullptr;
+    uint64_t size = index->file_.size();
+    if (header->stringCount < 2 ||
+        header->bucketCount != PerfectHash::bucketCountFor(header->stringCount - 1) ||
+        size != fileSize(header->stringCount, header->bucketCount))
+    {
+        return nullptr;
+    }
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(header + 1);
+    index->stringCount_ = header->stringCount;
+    index->relPointers_ = p;
+    index->hash_ = PerfectHash(p + header->stringCount,
+        header->bucketCount, header->stringCount - 1);
+    index->slots_ = reinterpret_cast<const uint16_t*>(
+        p + header->stringCount + header->bucketCount);
+    return index;
+}
+
+
+/**
+ * Hashes every global string (other than "", which getCode() handles
+ * upfront) and writes the resulting perfect hash to a sidecar file.
+ */
+bool StringIndex::build(const StringTable& strings, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    uint32_t stringCount = strings.stringCount();
+    if (stringCount < 2) return false;
+    uint32_t keyCount = stringCount - 1;
+
+    std::vector<uint64_t> hashes(keyCount);
+    for (uint32_t code = 1; code < stringCount; code++)
+    {
+        const ShortVarString* str = strings.getGlobalString(code);
+        hashes[code - 1] = Strings::hashNonEmpty(str->data(), str->length());
+    }
+    std::vector<uint32_t> displacements;
+    if (!PerfectHash::build(hashes.data(), keyCount, displacements)) return false;
+
+    uint32_t bucketCount = static_cast<uint32_t>(displacements.size());
+    PerfectHash hash(displacements.data(), bucketCount, keyCount);
+    std::vector<uint16_t> slots((keyCount + 1) & ~1);
+    for (uint32_t code = 1; code < stringCount; code++)
+    {
+        slots[hash.slot(hashes[code - 1])] = static_cast<uint16_t>(code);
+    }
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        stringCount, bucketCount };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(strings.relPointers_, stringCount * sizeof(uint32_t));
+    file.write(displacements);
+    file.write(slots);
+    file.commit();
+    return true;
+}
+
+} // namespace geodesk
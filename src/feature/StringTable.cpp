@@ -3,7 +3,12 @@
 
 #include <geodesk/feature/StringTable.h>
 
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <geodesk/feature/StringIndex.h>
 #include <geodesk/feature/StringValue.h>
+#include <clarisma/math/Math.h>
 #include <clarisma/util/Bits.h>
 #include <clarisma/util/PbfDecoder.h>
 #include <clarisma/util/Strings.h>
@@ -42,54 +47,89 @@ using namespace clarisma;
 
 
 StringTable::StringTable() :
-	arena_(nullptr)
+	arena_(nullptr),
+	slots_(nullptr)
 {
 	// TODO: clear all other members?
 }
 
-void StringTable::create(const uint8_t* pStrings)
+/**
+ * The arena is allocated with calloc(): its tables start out zeroed,
+ * and the OS only commits the pages that are actually used, so opening
+ * a table that has a StringIndex does not touch memory per string.
+ */
+void StringTable::create(const uint8_t* pStrings, const StringIndex* index)
 {
 	stringBase_ = pStrings;
 	PbfDecoder data(pStrings);
 	stringCount_ = data.readVarint32() + 1;
 	// currently, "" is not stored in string table
-	unsigned long leadingZeroes;
+	if (index && index->stringCount() != stringCount_) index = nullptr;
 
-	// Round up string count to next-highest power-of-2, then double it
-	// to get a decent hashtable size
-	leadingZeroes = Bits::countLeadingZerosInNonZero32(stringCount_);
-	uint32_t bucketCount = 1U << (32 - leadingZeroes);
+	uint32_t bucketCount = 0;
+	if (!index)
+	{
+		// Round up string count to next-highest power-of-2, then double it
+		// to get a decent hashtable size
+		unsigned long leadingZeroes = Bits::countLeadingZerosInNonZero32(stringCount_);
+		bucketCount = 1U << (32 - leadingZeroes);
+	}
 	lookupMask_ = bucketCount - 1;
 
 	#ifdef GEODESK_PYTHON
-	int stringObjectTableSize = stringCount_ * sizeof(PyObject*);
+	size_t stringObjectTableSize = stringCount_ * sizeof(PyObject*);
 	#else
-	int stringObjectTableSize = 0;
+	size_t stringObjectTableSize = 0;
 	#endif
-	int entryTableSize = stringCount_ * sizeof(Entry*);
-	int arenaSize =
-		stringObjectTableSize +
-		entryTableSize +
-		bucketCount * sizeof(uint16_t);
-	arena_ = new uint8_t[arenaSize];
+	size_t numberTableSize = stringCount_ * sizeof(uint64_t);
+	size_t relPointerTableSize = index ? 0 : stringCount_ * sizeof(uint32_t);
+	size_t chainTableSize = index ? 0 :
+		(stringCount_ + bucketCount) * sizeof(uint16_t);
+	size_t jsonTableSize = stringCount_;
+	arena_ = static_cast<uint8_t*>(std::calloc(1, stringObjectTableSize +
+		numberTableSize + relPointerTableSize + chainTableSize + jsonTableSize));
+	if (!arena_) throw std::bad_alloc();
 	#ifdef GEODESK_PYTHON
 	stringObjects_ = reinterpret_cast<PyObject**>(arena_);
 	#endif
-	entries_ = reinterpret_cast<Entry*>(arena_ + stringObjectTableSize);
-	buckets_ = reinterpret_cast<uint16_t*>(arena_
-		+ stringObjectTableSize + entryTableSize);
+	numbers_ = reinterpret_cast<uint64_t*>(arena_ + stringObjectTableSize);
+	jsonSafety_ = arena_ + stringObjectTableSize + numberTableSize +
+		relPointerTableSize + chainTableSize;
+
+	if (index)
+	{
+		relPointers_ = index->relPointers();
+		slots_ = index->slots();
+		perfectHash_ = index->hash();
+		buckets_ = nullptr;
+		next_ = nullptr;
+		return;
+	}
 
-	// clear the entire arena
-	std::memset(arena_, 0, arenaSize);
+	uint32_t* relPointers = reinterpret_cast<uint32_t*>(
+		arena_ + stringObjectTableSize + numberTableSize);
+	relPointers_ = relPointers;
+	next_ = reinterpret_cast<uint16_t*>(arena_ + stringObjectTableSize +
+		numberTableSize + relPointerTableSize);
+	buckets_ = next_ + stringCount_;
 
 	for (uint32_t i = 1; i < stringCount_; i++)
 	{
-		entries_[i].relPointer = static_cast<uint32_t>(data.pointer() - pStrings);
-		// next has already been initialized with 0
+		relPointers[i] = static_cast<uint32_t>(data.pointer() - pStrings);
 		uint32_t len = data.readVarint32();
 		data.skip(len);
 	}
+	// The hash chains are built by the first getCode()
+}
 
+/**
+ * Hashes every string into the chains used by getCode() if there is
+ * no StringIndex. This is the most expensive part of opening a store
+ * without an index, yet many short-lived processes never look up a
+ * string by its text, so we defer it until it is needed.
+ */
+void StringTable::buildChains() const
+{
 	// We'll index strings starting with highest numbers first,
 	// so more commonly used strings will be placed towards the head
 	// of the collision list
@@ -99,16 +139,9 @@ void StringTable::create(const uint8_t* pStrings)
 		const ShortVarString* str = getGlobalString(i);
 		size_t hash = Strings::hashNonEmpty(str->data(), str->length());
 		int bucket = hash & lookupMask_;
-		uint16_t oldEntry = buckets_[bucket];
-		if (oldEntry) entries_[i].next = oldEntry;
+		next_[i] = buckets_[bucket];
 		buckets_[bucket] = i;
 	}
-
-	#ifdef GEODESK_PYTHON
-	// TODO: This may change if we store "" in the GOL's global strings
-	// PyObject* emptyStr = PyUnicode_NewEmptyUnicodeObject();
-	stringObjects_[0] = PyUnicode_InternFromString("");
-	#endif
 }
 
 
@@ -123,7 +156,7 @@ StringTable::~StringTable()
 			if (strObj) Py_DECREF(strObj);
 		}
 		#endif
-		delete[] arena_;
+		std::free(arena_);
 	}
 }
 
@@ -133,6 +166,29 @@ bool StringTable::isValidCode(int code)
 	return code >= 0 && code < static_cast<int>(stringCount_);
 }
 
+/**
+ * Parses a global string as a number and caches the result in its
+ * slot. If two threads parse the same string at the same time, they
+ * simply store the same value.
+ */
+uint64_t StringTable::parseNumber(uint64_t* slot, std::string_view str) noexcept
+{
+	double value;
+	Math::parseDouble(str, &value);
+	uint64_t bits = ~std::bit_cast<uint64_t>(value);
+	std::atomic_ref<uint64_t>(*slot).store(bits, std::memory_order_relaxed);
+	return bits;
+}
+
+uint8_t StringTable::checkJsonSafe(int code) const noexcept
+{
+	const ShortVarString* str = getGlobalString(code);
+	uint8_t safety = Strings::jsonSafePrefix(str->data(), str->length()) ==
+		str->length() ? JSON_SAFE : JSON_UNSAFE;
+	std::atomic_ref<uint8_t>(jsonSafety_[code]).store(safety, std::memory_order_relaxed);
+	return safety;
+}
+
 // TODO: toStringObject() may return NULL in case of failure!
 #ifdef GEODESK_PYTHON
 PyObject* StringTable::getStringObject(int code)
@@ -141,8 +197,17 @@ PyObject* StringTable::getStringObject(int code)
 	PyObject* strObj = stringObjects_[code];
 	if (!strObj)
 	{
-		geodesk::StringValue str(stringBase_ + entries_[code].relPointer);
-		strObj = Python::toStringObject(str);
+		// (Created lazily, since the table is created without the GIL)
+		// TODO: This may change if we store "" in the GOL's global strings
+		if (code == 0)
+		{
+			strObj = PyUnicode_InternFromString("");
+		}
+		else
+		{
+			geodesk::StringValue str(stringBase_ + relPointers_[code]);
+			strObj = Python::toStringObject(str);
+		}
 		assert(strObj);
 		stringObjects_[code] = strObj;
 	}
@@ -153,19 +218,67 @@ PyObject* StringTable::getStringObject(int code)
 
 int StringTable::getCode(size_t hash, const char* str, size_t len) const
 {
+	if (slots_)
+	{
+		int code = slots_[perfectHash_.slot(hash)];
+		return getGlobalString(code)->equals(str, len) ? code : -1;
+	}
+	std::call_once(chainsOnce_, [this]() { buildChains(); });
 	int bucket = hash & lookupMask_;
 	uint16_t code = buckets_[bucket];
 	while (code)
 	{
-		const Entry& entry = entries_[code];
-		const ShortVarString* candidate =
-			reinterpret_cast<const ShortVarString*>(stringBase_ + entry.relPointer);
+		const ShortVarString* candidate = getGlobalString(code);
 		if (candidate->equals(str, len)) return code;
-		code = entry.next;
+		code = next_[code];
 	}
 	return -1;
 }
 
+namespace {
+
+/// A direct-mapped cache of the codes of key strings, by the address
+/// of the string and the table that resolved it. A hit is confirmed
+/// by comparing the string with the global string of the cached code,
+/// so a buffer that has since been reused for a different key (or a
+/// table at the address of a closed one) can't produce a wrong code.
+/// Strings that aren't global strings aren't cached.
+struct KeyCodeCache
+{
+	struct Entry
+	{
+		const StringTable* table;
+		const char* str;
+		size_t len;
+		int code;
+	};
+
+	static constexpr int SIZE_BITS = 6;
+	Entry entries[1 << SIZE_BITS] = {};
+};
+
+thread_local KeyCodeCache keyCodeCache;
+
+} // namespace
+
+int StringTable::getKeyCode(const char* str, size_t len) const
+{
+	uint64_t hash = (static_cast<uint64_t>(reinterpret_cast<uintptr_t>(str)) ^
+		static_cast<uint64_t>(reinterpret_cast<uintptr_t>(this))) * 0x9E37'79B9'7F4A'7C15ULL;
+	KeyCodeCache::Entry& entry = keyCodeCache.entries[hash >> (64 - KeyCodeCache::SIZE_BITS)];
+	if (entry.table == this && entry.str == str && entry.len == len)
+	{
+		const ShortVarString* cached = getGlobalString(entry.code);
+		if (cached->length() == len && std::memcmp(cached->data(), str, len) == 0)
+		{
+			return entry.code;
+		}
+	}
+	int code = getCode(str, len);
+	if (code >= 0) entry = { this, str, len, code };
+	return code;
+}
+
 int StringTable::getCode(const char* str, size_t len) const
 {
 	if (len == 0) return 0;		
@@ -0,0 +1,31 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/TagColumns.h>
+#include <unordered_map>
+
+namespace geodesk {
+
+TagColumns::DictionaryColumn TagColumns::encode(size_t col) const
+{
+    const std::vector<TagValue>& values = columns_[col];
+    DictionaryColumn result;
+    result.indexes.reserve(values.size());
+    std::unordered_map<std::string, int32_t> entries;
+    for (const TagValue& value : values)
+    {
+        std::string text = value;
+        if (text.empty())
+        {
+            result.indexes.push_back(-1);
+            continue;
+        }
+        auto [it, isNew] = entries.try_emplace(std::move(text),
+            static_cast<int32_t>(result.dictionary.size()));
+        if (isNew) result.dictionary.push_back(value);
+        result.indexes.push_back(it->second);
+    }
+    return result;
+}
+
+} // namespace geodesk
@@ -0,0 +1,97 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/TagSummary.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+std::unique_ptr<TagSummary> TagSummary::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<TagSummary> summary(new TagSummary());
+    const Header* header = summary->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "tag summary");
+    if (!header) return nullptr;
+    uint64_t size = summary->file_.size();
+    if (header->bitsPerTile != BITS_PER_TILE ||
+        size != sizeof(Header) + static_cast<uint64_t>(header->tileCount) *
+            WORDS_PER_TILE * sizeof(uint64_t))
+    {
+        return nullptr;
+    }
+    summary->bits_ = reinterpret_cast<const uint64_t*>(header + 1);
+    summary->tileCount_ = header->tileCount;
+    return summary;
+}
+
+
+/**
+ * Builds the summary of every tile and writes it to a sidecar file.
+ * Tiles are stored in the order of their TIPs; TIPs without a tile
+ * have an empty summary.
+ */
+void TagSummary::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::vector<uint64_t> bits;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    if (walker.next())
+    {
+        do
+        {
+            uint32_t tip = walker.currentTip();
+            size_t end = (static_cast<size_t>(tip) + 1) * WORDS_PER_TILE;
+            if (bits.size() < end) bits.resize(end);
+            addTile(store->fetchTile(Tip(tip)), &bits[tip * WORDS_PER_TILE]);
+        }
+        while (walker.next());
+    }
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        static_cast<uint32_t>(bits.size() / WORDS_PER_TILE), BITS_PER_TILE };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(bits);
+    file.commit();
+}
+
+
+void TagSummary::addTile(DataPtr pTile, uint64_t* bits)
+{
+    TileFeatureWalker::forEachFeature(pTile,
+        [bits](FeaturePtr pFeature, FeatureIndexType)
+        {
+            addFeature(pFeature, bits);
+        });
+}
+
+
+/**
+ * Adds the feature's global tags whose values are global strings
+ * (the only kind of tag a native matcher can require).
+ */
+void TagSummary::addFeature(FeaturePtr pFeature, uint64_t* bits)
+{
+    DataPtr p(pFeature.ptr() + 8);
+    p = p.followTagged(~1);
+    for (;;)
+    {
+        uint32_t tag = p.getUnsignedIntUnaligned();
+        uint32_t keyBits = tag & 0xffff;
+        if ((keyBits & 3) == 1)
+        {
+            add(bits, (keyBits >> 2) & 0x1fff, tag >> 16);
+        }
+        // (The empty tag table consists of a single 0xffff key)
+        if (keyBits & 0x8000) break;
+        p += 4 + (tag & 2);
+    }
+}
+
+} // namespace geodesk
@@ -43,7 +43,7 @@ int64_t TagTablePtr::getKeyValue(PyObject* key, const StringTable& strings) cons
 TagBits TagTablePtr::getKeyValue(const char* key, size_t len,
 	const StringTable& strings) const
 {
-	int code = strings.getCode(key, len);
+	int code = strings.getKeyCode(key, len);
 	if (code >= 0 && code <= TagValues::MAX_COMMON_KEY)	[[likely]]
 	{
 		return getGlobalKeyValue(code);
@@ -64,6 +64,7 @@ TagBits TagTablePtr::getKeyValue(Key key) const
 TagBits TagTablePtr::getLocalKeyValue(const char* key, size_t len) const
 {
 	if (!hasLocalKeys()) return 0;
+	ShortVarString::Probe probe(key, len);
 	DataPtr p = ptr();
 	DataPtr origin = alignedBasePtr();
 	p -= 6;
@@ -75,7 +76,7 @@ TagBits TagTablePtr::getLocalKeyValue(const char* key, size_t len) const
 		// uncommon keys are relative to the 4-byte-aligned tagtable address
 		const ShortVarString* keyString = reinterpret_cast<const ShortVarString*>
 			(origin.ptr() + ((rawPointer ^ flags) >> 1));
-		if (keyString->equals(key, len))
+		if (probe.matches(keyString))
 		{
 			return (static_cast<TagBits>(pointerOffset(p) - 2) << 32) |
 				((tag & 0xffff) << 16) | flags;
@@ -85,6 +86,39 @@ TagBits TagTablePtr::getLocalKeyValue(const char* key, size_t len) const
 	}
 }
 
+/**
+ * Looks up the values of several keys, visiting each global tag at
+ * most once. `keys` must list the global keys first (in ascending order
+ * of their codes), followed by the local keys.
+ */
+void TagTablePtr::getKeyValues(const Key* keys, size_t count, TagBits* values) const
+{
+	size_t i = 0;
+	DataPtr p = ptr();
+	for (; i < count && keys[i].code() >= 0; i++)
+	{
+		assert(i == 0 || keys[i].code() > keys[i-1].code());
+		uint16_t keyBits = keys[i].code() << 2;
+		for (; ; )
+		{
+			uint32_t tag = p.getUnsignedIntUnaligned();
+			if ((tag & 0xffff) >= keyBits)
+			{
+				// Stay on this tag, since it may belong to the next key
+				// (or is the last tag, which keeps stopping the scan)
+				values[i] = ((tag & 0x7ffc) == keyBits) ?
+					((static_cast<TagBits>(pointerOffset(p) + 2) << 32) | tag) : 0;
+				break;
+			}
+			p += 4 + (tag & 2);
+		}
+	}
+	for (; i < count; i++)
+	{
+		values[i] = getLocalKeyValue(keys[i].data(), keys[i].size());
+	}
+}
+
 TagBits TagTablePtr::getGlobalKeyValue(int key) const
 {
 	uint16_t keyBits = key << 2;
@@ -193,7 +227,7 @@ PyObject* TagTablePtr::valueAsNumber(TagBits value, StringTable& strings) const
 	}
 	assert(type == TagValueType::GLOBAL_STRING);
 	double val;
-	if(!Math::parseDouble(globalString(value, strings)->toStringView(), &val)) val = 0.0;
+	if(!strings.getGlobalNumber(static_cast<int>(rawNarrowValue(value)), &val)) val = 0.0;
 	return PyFloat_FromDouble(val);
 }
 
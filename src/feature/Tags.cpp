@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/feature/FeatureBase.h>
+#include <cstring>
+#include <clarisma/alloc/Arena.h>
 
 namespace geodesk {
 
@@ -10,6 +12,33 @@ Tags::Tags(const Feature& feature) :
 {
 }
 
+std::span<const std::pair<std::string_view, std::string_view>>
+    Tags::toViews(clarisma::Arena& arena) const
+{
+    using KeyValue = std::pair<std::string_view, std::string_view>;
+    size_t count = tags_.count();
+    KeyValue* pairs = arena.allocArray<KeyValue>(count);
+    TagIterator iter(tags_, store_->strings());
+    size_t n = 0;
+    for (;;)
+    {
+        auto [key, bits] = iter.next();
+        if (!key) break;
+        assert(n < count);
+        char buf[32];
+        std::string_view value = tags_.tagValue(bits, store_->strings()).toStringView(buf);
+        if (value.data() == buf)
+        {
+            char* copy = reinterpret_cast<char*>(arena.alloc(value.size(), 1));
+            memcpy(copy, buf, value.size());
+            value = std::string_view(copy, value.size());
+        }
+        new(&pairs[n++]) KeyValue(key->toStringView(), value);
+    }
+    return { pairs, n };
+}
+
+
 bool Tags::operator==(const Tags& other) const
 {
     // TODO
@@ -0,0 +1,17 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/TileCache.h>
+#include <geodesk/feature/FeatureStore.h>
+
+namespace geodesk {
+
+DataPtr TileCache::fetch(FeatureStore* store, Tip tip)
+{
+    DataPtr pTile = store->fetchTile(tip);
+    if (count_ < SIZE) count_++;
+    moveToFront(count_ - 1, tip, pTile);
+    return pTile;
+}
+
+} // namespace geodesk
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_WITH_ZLIB
+
+#include <geodesk/feature/TileCompression.h>
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+#include <clarisma/io/File.h>
+#include <clarisma/io/IOException.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+TileCompression::TileCompression(std::vector<uint8_t> dictionary) :
+    dictionary_(std::move(dictionary))
+{
+}
+
+
+std::unique_ptr<TileCompression> TileCompression::open(const std::string& fileName)
+{
+    if (!File::exists(fileName.c_str())) return std::make_unique<TileCompression>();
+    ByteBlock data = File::readAll(fileName.c_str());
+    return std::make_unique<TileCompression>(
+        std::vector<uint8_t>(data.data(), data.data() + data.size()));
+}
+
+
+void TileCompression::save(const std::string& fileName) const
+{
+    File::writeAll(fileName.c_str(), dictionary_.data(), dictionary_.size());
+}
+
+
+std::vector<uint8_t> TileCompression::buildDictionary(FeatureStore* store, size_t maxSize)
+{
+    std::vector<Tip> tips;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(), Box::ofWorld(), nullptr);
+    while (walker.next()) tips.push_back(walker.currentTip());
+
+    // We take a slice from each of up to 64 tiles, spread evenly across
+    // the tile index; zlib favors the strings at the end of the
+    // dictionary, so the slices of the larger tiles go last
+    constexpr size_t MAX_SAMPLES = 64;
+    size_t sampleCount = std::min(tips.size(), MAX_SAMPLES);
+    if (sampleCount == 0) return {};
+    size_t sliceSize = maxSize / sampleCount;
+    std::vector<std::pair<uint32_t,Tip>> samples;
+    for (size_t i = 0; i < sampleCount; i++)
+    {
+        Tip tip = tips[i * tips.size() / sampleCount];
+        uint32_t size = store->fetchTile(tip).getUnsignedInt() & PAYLOAD_SIZE_MASK;
+        samples.emplace_back(size, tip);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    std::vector<uint8_t> dictionary;
+    dictionary.reserve(maxSize);
+    for (auto [size, tip] : samples)
+    {
+        const uint8_t* pPayload = store->fetchTile(tip).ptr() + 4;
+        size_t len = std::min<size_t>(sliceSize, size);
+        dictionary.insert(dictionary.end(), pPayload, pPayload + len);
+    }
+    return dictionary;
+}
+
+
+std::vector<uint8_t> TileCompression::compress(const uint8_t* pBlob, int level) const
+{
+    uint32_t size = (DataPtr(pBlob).getUnsignedInt() & PAYLOAD_SIZE_MASK) + 4;
+    z_stream zs{};
+    if (deflateInit(&zs, level) != Z_OK)
+    {
+        throw std::runtime_error("Failed to initialize zlib");
+    }
+    if (!dictionary_.empty())
+    {
+        deflateSetDictionary(&zs, dictionary_.data(),
+            static_cast<uInt>(dictionary_.size()));
+    }
+    std::vector<uint8_t> out(8 + deflateBound(&zs, size));
+    zs.next_in = const_cast<Bytef*>(pBlob);
+    zs.avail_in = size;
+    zs.next_out = out.data() + 8;
+    zs.avail_out = static_cast<uInt>(out.size() - 8);
+    int res = deflate(&zs, Z_FINISH);
+    size_t compressedSize = zs.total_out;
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END)
+    {
+        throw std::runtime_error("Failed to compress tile");
+    }
+    out.resize(8 + compressedSize);
+    uint32_t header = static_cast<uint32_t>(compressedSize + 4) | COMPRESSED_FLAG;
+    memcpy(out.data(), &header, 4);
+    memcpy(out.data() + 4, &size, 4);
+    return out;
+}
+
+
+void TileCompression::decompress(const uint8_t* pBlob, uint8_t* dest) const
+{
+    uint32_t compressedSize = (DataPtr(pBlob).getUnsignedInt() & PAYLOAD_SIZE_MASK) - 4;
+    uint32_t size = uncompressedSize(pBlob);
+    z_stream zs{};
+    if (inflateInit(&zs) != Z_OK)
+    {
+        throw std::runtime_error("Failed to initialize zlib");
+    }
+    zs.next_in = const_cast<Bytef*>(pBlob + 8);
+    zs.avail_in = compressedSize;
+    zs.next_out = dest;
+    zs.avail_out = size;
+    int res = inflate(&zs, Z_FINISH);
+    if (res == Z_NEED_DICT)
+    {
+        // zlib checks that it's the same dictionary the
+        // tile was compressed with
+        if (dictionary_.empty() || inflateSetDictionary(&zs, dictionary_.data(),
+            static_cast<uInt>(dictionary_.size())) != Z_OK)
+        {
+            inflateEnd(&zs);
+            throw IOException("Tile requires a different compression dictionary");
+        }
+        res = inflate(&zs, Z_FINISH);
+    }
+    bool complete = res == Z_STREAM_END && zs.total_out == size;
+    inflateEnd(&zs);
+    if (!complete) throw IOException("Compressed tile is corrupt");
+}
+
+} // namespace geodesk
+
+#endif // GEODESK_WITH_ZLIB
@@ -0,0 +1,201 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/TileReader.h>
+#include <cstring>
+#include <vector>
+#include <clarisma/store/Store.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileCompression.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+TileReader::TileReader(FeatureStore* store, size_t maxBytes) :
+    store_(store),
+    maxBytes_(maxBytes)
+{
+}
+
+TileReader::~TileReader()
+{
+    // All pins must have been released by now (a Query keeps the
+    // store open while it exists)
+}
+
+
+void TileReader::read(uint64_t ofs, uint8_t* buf, size_t size)
+{
+    // A positional read may return fewer bytes than requested
+    while (size)
+    {
+        size_t bytesRead = store_->read(ofs, buf, size);
+        if (bytesRead == 0)
+        {
+            throw StoreException(store_->fileName(), "Unexpected end of file");
+        }
+        ofs += bytesRead;
+        buf += bytesRead;
+        size -= bytesRead;
+    }
+}
+
+
+DataPtr TileReader::Pin::data() const noexcept
+{
+    assert(entry_);
+    return DataPtr(entry_->data.get());
+}
+
+
+void TileReader::Pin::release() noexcept
+{
+    if (entry_)
+    {
+        reader_->unpin(entry_);
+        entry_ = nullptr;
+    }
+}
+
+
+TileReader::Pin TileReader::pin(Tip tip)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(tip);
+        if (it != entries_.end())
+        {
+            Entry* entry = it->second.get();
+            if (entry->pinCount++ == 0) unlink(entry);
+            return Pin(this, entry);
+        }
+    }
+
+    // Read the tile without holding the lock (the blob header holds
+    // the size of its payload)
+
+    uint64_t ofs = store_->tileOffset(tip);
+    uint32_t header;
+    read(ofs, reinterpret_cast<uint8_t*>(&header), sizeof(header));
+    size_t size = (header & TileCompression::PAYLOAD_SIZE_MASK) + sizeof(header);
+    std::unique_ptr<Entry> newEntry(new Entry);
+    newEntry->tip = tip;
+    newEntry->pinCount = 1;
+    newEntry->prev = nullptr;
+    newEntry->next = nullptr;
+    if (header & TileCompression::COMPRESSED_FLAG)
+    {
+        #ifdef GEODESK_WITH_ZLIB
+        // The compressed blob only lives until it has been decompressed
+        thread_local std::vector<uint8_t> compressed;
+        compressed.resize(size);
+        memcpy(compressed.data(), &header, sizeof(header));
+        read(ofs + sizeof(header), compressed.data() + sizeof(header),
+            size - sizeof(header));
+        size = TileCompression::uncompressedSize(compressed.data());
+        newEntry->data.reset(new uint8_t[size]);
+        store_->tileCompression().decompress(compressed.data(), newEntry->data.get());
+        #else
+        throw StoreException(store_->fileName(), "Compressed tiles require zlib");
+        #endif
+    }
+    else
+    {
+        newEntry->data.reset(new uint8_t[size]);
+        memcpy(newEntry->data.get(), &header, sizeof(header));
+        read(ofs + sizeof(header), newEntry->data.get() + sizeof(header),
+            size - sizeof(header));
+    }
+    newEntry->size = size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = entries_.try_emplace(tip, std::move(newEntry));
+    Entry* entry = it->second.get();
+    if (inserted)
+    {
+        bytesCached_ += size;
+        tilesRead_++;
+        evictUnpinned();
+    }
+    else
+    {
+        // Another thread has read the same tile in the meantime;
+        // we use its copy and discard ours
+        if (entry->pinCount++ == 0) unlink(entry);
+    }
+    return Pin(this, entry);
+}
+
+
+void TileReader::unpin(Entry* entry) noexcept
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(entry->pinCount > 0);
+    if (--entry->pinCount) return;
+
+    // The tile becomes the most recently used of the unpinned tiles
+    entry->prev = nullptr;
+    entry->next = head_;
+    if (head_)
+    {
+        head_->prev = entry;
+    }
+    else
+    {
+        tail_ = entry;
+    }
+    head_ = entry;
+    evictUnpinned();
+}
+
+
+void TileReader::unlink(Entry* entry) noexcept
+{
+    if (entry->prev)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        head_ = entry->next;
+    }
+    if (entry->next)
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        tail_ = entry->prev;
+    }
+    entry->prev = nullptr;
+    entry->next = nullptr;
+}
+
+
+void TileReader::evictUnpinned() noexcept
+{
+    while (bytesCached_ > maxBytes_ && tail_)
+    {
+        Entry* entry = tail_;
+        unlink(entry);
+        bytesCached_ -= entry->size;
+        entries_.erase(entry->tip);
+    }
+}
+
+
+size_t TileReader::bytesCached()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytesCached_;
+}
+
+
+uint64_t TileReader::tilesRead()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tilesRead_;
+}
+
+} // namespace geodesk
@@ -0,0 +1,244 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/TileStatistics.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <thread>
+#include <vector>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/match/Matcher.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// The types of features held by each index
+constexpr uint32_t INDEX_TYPES[4] =
+{
+    FeatureTypes::NODES,
+    FeatureTypes::NONAREA_WAYS,
+    FeatureTypes::AREAS,
+    FeatureTypes::NONAREA_RELATIONS
+};
+
+} // namespace
+
+
+/// Adds up the counts of the features of a tile
+class TileStatistics::Builder
+{
+public:
+    explicit Builder(FeatureStore* store) : store_(store) {}
+
+    void addTile(DataPtr pTile, TileCounts* counts)
+    {
+        TileFeatureWalker::forEachFeature(pTile,
+            [this, counts](FeaturePtr pFeature, FeatureIndexType index)
+            {
+                addFeature(pFeature, index, counts);
+            });
+    }
+
+private:
+    /// Only global keys are considered (local keys are neither indexed
+    /// nor popular)
+    void addFeature(FeaturePtr pFeature, FeatureIndexType index, TileCounts* counts)
+    {
+        bool isPrimary = TileFeatureWalker::isFirstCopy(pFeature);
+        uint32_t categories = 0;
+        DataPtr p(pFeature.ptr() + 8);
+        p = p.followTagged(~1);
+        for (;;)
+        {
+            uint32_t tag = p.getUnsignedIntUnaligned();
+            uint32_t keyBits = tag & 0xffff;
+            // (The empty tag table consists of a single 0xffff key)
+            if (keyBits == 0xffff) break;
+            int key = static_cast<int>((keyBits >> 2) & 0x1fff);
+            categories |= store_->keyIndexBits(key);
+            if (isPrimary && key < POPULAR_KEYS) counts->keys[key]++;
+            if (keyBits & 0x8000) break;
+            p += 4 + (tag & 2);
+        }
+        counts->categoryMasks[index] |= categories;
+        if (!isPrimary) return;
+
+        counts->features[index]++;
+        while (categories)
+        {
+            counts->categories[std::countr_zero(categories)]++;
+            categories &= categories - 1;
+        }
+        if (index != FeatureIndexType::NODES)
+        {
+            Box bounds = pFeature.bounds();
+            uint64_t extent = std::max(
+                static_cast<int64_t>(bounds.maxX()) - bounds.minX(),
+                static_cast<int64_t>(bounds.maxY()) - bounds.minY());
+            int sizeClass = std::min(static_cast<int>(std::bit_width(extent >> 8)),
+                SIZE_CLASSES - 1);
+            counts->sizes[sizeClass]++;
+        }
+    }
+
+    FeatureStore* store_;
+};
+
+
+std::unique_ptr<TileStatistics> TileStatistics::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<TileStatistics> stats(new TileStatistics());
+    const Header* header = stats->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "tile statistics");
+    if (!header) return nullptr;
+    uint64_t size = stats->file_.size();
+    if (header->bytesPerTile != sizeof(TileCounts) ||
+        size != sizeof(Header) + static_cast<uint64_t>(header->tileCount) *
+            sizeof(TileCounts))
+    {
+        return nullptr;
+    }
+    stats->tiles_ = reinterpret_cast<const TileCounts*>(header + 1);
+    stats->tileCount_ = header->tileCount;
+    std::copy_n(header->totals, 4, stats->totals_);
+    return stats;
+}
+
+
+/**
+ * Counts the features of every tile and writes the counts to a sidecar
+ * file. Tiles are stored in the order of their TIPs; TIPs without a
+ * tile have all-zero counts. Each thread claims the next
+ * tile in turn and writes only to that tile's counts.
+ */
+void TileStatistics::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize, int threads)
+{
+    std::vector<Tip> tips;
+    uint32_t tileCount = 0;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        Tip tip = walker.currentTip();
+        tips.push_back(tip);
+        tileCount = std::max(tileCount, static_cast<uint32_t>(tip) + 1);
+    }
+
+    std::vector<TileCounts> tiles(tileCount);   // (value-initialized to 0)
+    std::atomic<size_t> nextTile(0);
+    auto countAll = [store, &tips, &tiles, &nextTile]()
+    {
+        Builder builder(store);
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tips.size()) return;
+            builder.addTile(store->fetchTile(tips[n]), &tiles[tips[n]]);
+        }
+    };
+
+    if (threads <= 0) threads = store->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tips.size()), 1));
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(countAll);
+    }
+    countAll();
+    for (std::thread& worker : workers) worker.join();
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        tileCount, sizeof(TileCounts), {} };
+    for (const TileCounts& counts : tiles)
+    {
+        for (int i = 0; i < 4; i++) header.totals[i] += counts.features[i];
+    }
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(tiles.data(), tiles.size() * sizeof(TileCounts));
+    file.commit();
+}
+
+
+TileStatistics::Totals TileStatistics::sum(FeatureStore* store, const Box& box) const
+{
+    Totals totals;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(), box, nullptr);
+    while (walker.next())
+    {
+        const TileCounts* counts = tile(walker.currentTip());
+        if (!counts) continue;
+        Box tileBounds = walker.currentTile().bounds();
+        Box overlap = Box::simpleIntersection(tileBounds, box);
+        double share = 1;
+        if (overlap != tileBounds)
+        {
+            auto area = [](const Box& b)
+            {
+                return (static_cast<double>(b.maxX()) - b.minX() + 1) *
+                    (static_cast<double>(b.maxY()) - b.minY() + 1);
+            };
+            share = overlap.isEmpty() ? 0 : area(overlap) / area(tileBounds);
+            totals.exact = false;
+        }
+        for (int i = 0; i < 4; i++) totals.features[i] += counts->features[i] * share;
+        for (int i = 0; i < CATEGORIES; i++) totals.categories[i] += counts->categories[i] * share;
+        for (int i = 0; i < POPULAR_KEYS; i++) totals.keys[i] += counts->keys[i] * share;
+        for (int i = 0; i < SIZE_CLASSES; i++) totals.sizes[i] += counts->sizes[i] * share;
+    }
+    return totals;
+}
+
+
+double TileStatistics::Totals::count(FeatureTypes types) const
+{
+    double total = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (static_cast<uint32_t>(types) & INDEX_TYPES[i]) total += features[i];
+    }
+    return total;
+}
+
+
+std::optional<uint64_t> TileStatistics::count(FeatureTypes types) const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t indexTypes = static_cast<uint32_t>(types) & INDEX_TYPES[i];
+        if (indexTypes == 0) continue;
+        if (indexTypes != INDEX_TYPES[i]) return std::nullopt;
+        total += totals_[i];
+    }
+    return total;
+}
+
+
+/// A matcher whose index mask for a given index has a non-zero
+/// `keyMin` only accepts features whose index bits intersect the
+/// mask's `keyMask`, i.e. features with a key in one of these categories
+bool TileStatistics::requiredCategories(const MatcherHolder* matcher,
+    FeatureTypes types, uint32_t required[4])
+{
+    for (int i = 0; i < 4; i++)
+    {
+        required[i] = 0;
+        if ((static_cast<uint32_t>(types) & INDEX_TYPES[i]) == 0) continue;
+        const IndexMask& mask = matcher->indexMask(static_cast<FeatureIndexType>(i));
+        if (mask.keyMin == 0) return false;
+        required[i] = mask.keyMask;
+    }
+    return true;
+}
+
+} // namespace geodesk
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/feature/WayCoordinateIterator.h>
+#include <algorithm>
+#include <clarisma/util/varint.h>
 
 namespace geodesk {
 
@@ -51,4 +53,50 @@ Coordinate WayCoordinateIterator::next()
     return c;
 }
 
+int WayCoordinateIterator::decode(Coordinate* out, int maxCount)
+{
+    int count = std::min(maxCount, coordinatesRemaining());
+    if (count <= 0) return 0;
+    if (remaining_ <= 0)
+    {
+        // only the duplicated first coordinate is left
+        for (int i = 0; i < count; i++) out[i] = next();
+        return count;
+    }
+    int stored = std::min(count, remaining_);
+    int32_t x = x_;
+    int32_t y = y_;
+    out[0] = Coordinate(x, y);
+    Coordinate* pOut = out + 1;
+    bool isY = false;
+    p_ = readSignedVarints32(p_, static_cast<size_t>(stored - 1) * 2,
+        [&x, &y, &pOut, &isY](int32_t delta)
+        {
+            if (isY)
+            {
+                y += delta;
+                *pOut++ = Coordinate(x, y);
+            }
+            else
+            {
+                x += delta;
+            }
+            isY = !isY;
+        });
+    remaining_ -= stored;
+    if (remaining_ > 0)
+    {
+        x_ = x + readSignedVarint32(p_);
+        y_ = y + readSignedVarint32(p_);
+        return count;
+    }
+    // Same state as next() leaves behind after the last stored coordinate
+    x_ = firstX_;
+    y_ = firstY_;
+    firstX_ = 0;
+    firstY_ = 0;
+    if (count > stored) out[stored] = next();
+    return count;
+}
+
 } // namespace geodesk
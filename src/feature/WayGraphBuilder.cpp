@@ -0,0 +1,161 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/WayGraphBuilder.h>
+#include <algorithm>
+#include <geodesk/geom/Distance.h>
+
+namespace geodesk {
+
+void WayGraphBuilder::Batch::addWay(uint64_t id, const Coordinate* coords, size_t count)
+{
+    if (count < 2) return;
+    ids_.push_back(id);
+    double d = 0;
+    coords_.push_back(coords[0]);
+    distances_.push_back(0);
+    for (size_t i = 1; i < count; i++)
+    {
+        d += Distance::metersBetween(coords[i - 1], coords[i]);
+        coords_.push_back(coords[i]);
+        distances_.push_back(d);
+    }
+    ends_.push_back(static_cast<uint32_t>(coords_.size()));
+}
+
+
+WayGraphBuilder::Batch* WayGraphBuilder::acquire()
+{
+    std::lock_guard lock(mutex_);
+    if (idle_.empty())
+    {
+        batches_.push_back(std::make_unique<Batch>());
+        return batches_.back().get();
+    }
+    Batch* batch = idle_.back();
+    idle_.pop_back();
+    return batch;
+}
+
+
+void WayGraphBuilder::release(Batch* batch)
+{
+    std::lock_guard lock(mutex_);
+    idle_.push_back(batch);
+}
+
+
+/**
+ * A location becomes a vertex if it is the end of a way, or if it
+ * is visited more than once (by different ways, or by the same way).
+ * To find them, we sort the locations of all nodes (counting the
+ * end points twice), so the vertices are numbered in coordinate order
+ * -- this makes the result independent of the order in which the
+ * threads delivered the ways. The edges leaving each vertex are
+ * sorted as well, for the same reason.
+ */
+WayGraph WayGraphBuilder::build()
+{
+    WayGraph graph;
+
+    std::vector<uint64_t> keys;
+    size_t nodeCount = 0;
+    for (const std::unique_ptr<Batch>& batch : batches_)
+    {
+        nodeCount += batch->coords_.size() + batch->ids_.size() * 2;
+    }
+    keys.reserve(nodeCount);
+    for (const std::unique_ptr<Batch>& batch : batches_)
+    {
+        uint32_t start = 0;
+        for (uint32_t end : batch->ends_)
+        {
+            for (uint32_t i = start; i < end; i++)
+            {
+                keys.push_back(key(batch->coords_[i]));
+            }
+            keys.push_back(key(batch->coords_[start]));
+            keys.push_back(key(batch->coords_[end - 1]));
+            start = end;
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<uint64_t> vertexKeys;
+    for (size_t i = 0; i < keys.size(); )
+    {
+        size_t j = i + 1;
+        while (j < keys.size() && keys[j] == keys[i]) j++;
+        if (j - i > 1) vertexKeys.push_back(keys[i]);
+        i = j;
+    }
+    std::vector<uint64_t>().swap(keys);
+
+    graph.coords_.reserve(vertexKeys.size());
+    for (uint64_t k : vertexKeys)
+    {
+        graph.coords_.emplace_back(
+            static_cast<int32_t>(static_cast<uint32_t>(k >> 32)),
+            static_cast<int32_t>(static_cast<uint32_t>(k)));
+    }
+
+    auto vertexOf = [&vertexKeys](Coordinate c) -> int64_t
+    {
+        uint64_t k = key(c);
+        auto it = std::lower_bound(vertexKeys.begin(), vertexKeys.end(), k);
+        if (it == vertexKeys.end() || *it != k) return -1;
+        return it - vertexKeys.begin();
+    };
+
+    std::vector<Edge> edges;
+    for (const std::unique_ptr<Batch>& batch : batches_)
+    {
+        uint32_t start = 0;
+        for (size_t w = 0; w < batch->ids_.size(); w++)
+        {
+            uint32_t end = batch->ends_[w];
+            uint32_t from = static_cast<uint32_t>(vertexOf(batch->coords_[start]));
+            double fromDistance = 0;
+            for (uint32_t i = start + 1; i < end; i++)
+            {
+                int64_t to = vertexOf(batch->coords_[i]);
+                if (to < 0) continue;
+                double length = batch->distances_[i] - fromDistance;
+                edges.push_back({ from, static_cast<uint32_t>(to), batch->ids_[w], length });
+                edges.push_back({ static_cast<uint32_t>(to), from, batch->ids_[w], length });
+                from = static_cast<uint32_t>(to);
+                fromDistance = batch->distances_[i];
+            }
+            start = end;
+        }
+    }
+    batches_.clear();
+    idle_.clear();
+
+    std::sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b)
+    {
+        if (a.from != b.from) return a.from < b.from;
+        if (a.to != b.to) return a.to < b.to;
+        if (a.way != b.way) return a.way < b.way;
+        return a.length < b.length;
+    });
+
+    graph.offsets_.assign(graph.coords_.size() + 1, 0);
+    graph.targets_.reserve(edges.size());
+    graph.ways_.reserve(edges.size());
+    graph.lengths_.reserve(edges.size());
+    for (const Edge& edge : edges)
+    {
+        graph.offsets_[edge.from + 1]++;
+        graph.targets_.push_back(edge.to);
+        graph.ways_.push_back(edge.way);
+        graph.lengths_.push_back(edge.length);
+    }
+    for (size_t v = 1; v < graph.offsets_.size(); v++)
+    {
+        graph.offsets_[v] += graph.offsets_[v - 1];
+    }
+    return graph;
+}
+
+} // namespace geodesk
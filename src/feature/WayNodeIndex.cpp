@@ -0,0 +1,186 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/feature/WayNodeIndex.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+
+namespace geodesk {
+
+/**
+ * Decodes the coordinates of every way in the tile (ways and
+ * areas that are ways, whether they are stored in the way or the
+ * area index) and places them in a hash table that is at most
+ * half full.
+ */
+WayNodeIndex::TileIndex::TileIndex(DataPtr pTile) :
+    pTile_(pTile)
+{
+    std::vector<Slot> entries;
+    addIndex(pTile + 8 + FeatureIndexType::WAYS * 4, entries);
+    addIndex(pTile + 8 + FeatureIndexType::AREAS * 4, entries);
+    size_t capacity = 16;
+    while (capacity < entries.size() * 2) capacity *= 2;
+    mask_ = capacity - 1;
+    slots_.resize(capacity);
+    for (const Slot& entry : entries) insert(entry);
+}
+
+
+void WayNodeIndex::TileIndex::addIndex(DataPtr ppRoot, std::vector<Slot>& entries)
+{
+    int32_t ptr = ppRoot.getInt();
+    if (ptr == 0) return;
+    if ((ptr & 1) == 0)
+    {
+        addBranch(ppRoot, entries);
+        return;
+    }
+    DataPtr p = ppRoot + (ptr ^ 1);
+    for (;;)
+    {
+        int32_t last = p.getInt() & 1;
+        addBranch(p, entries);
+        if (last != 0) break;
+        p += 8;
+    }
+}
+
+
+void WayNodeIndex::TileIndex::addBranch(DataPtr pEntry, std::vector<Slot>& entries)
+{
+    int32_t ptr = pEntry.getInt();
+    if (ptr == 0) return;
+    DataPtr p = pEntry + (ptr & 0xffff'fffc);
+    if ((ptr & 2) == 0)
+    {
+        for (;;)
+        {
+            addBranch(p, entries);     // NOLINT recursion
+            if (p.getInt() & 1) break;
+            p += 20;
+        }
+        return;
+    }
+    for (;;)
+    {
+        FeaturePtr pFeature(p + 16);
+        if (pFeature.isWay() && !WayPtr(pFeature).isPlaceholder())
+        {
+            addWay(pFeature, entries);
+        }
+        if (pFeature.flags() & 1) break;
+        p += 32;
+    }
+}
+
+
+void WayNodeIndex::TileIndex::addWay(FeaturePtr way, std::vector<Slot>& entries)
+{
+    uint32_t ofs = static_cast<uint32_t>(way.ptr() - pTile_);
+    WayCoordinateIterator iter;
+    iter.start(way, 0);     // (like WayNodeFilter, no duplicate end node)
+    Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+    for (;;)
+    {
+        int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+        if (count == 0) break;
+        for (int i = 0; i < count; i++)
+        {
+            entries.push_back({ coords[i].x, coords[i].y, ofs });
+        }
+    }
+}
+
+
+void WayNodeIndex::TileIndex::insert(const Slot& entry)
+{
+    for (size_t i = hash(Coordinate(entry.x, entry.y), entry.way) & mask_; ;
+        i = (i + 1) & mask_)
+    {
+        Slot& slot = slots_[i];
+        if (slot.way == 0)
+        {
+            slot = entry;
+            return;
+        }
+        if (slot.way == entry.way && slot.x == entry.x && slot.y == entry.y)
+        {
+            return;     // closed ring, or node visited twice
+        }
+    }
+}
+
+
+WayNodeIndex::WayNodeIndex(size_t maxBytes) :
+    maxBytes_(maxBytes),
+    bytes_(0),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+/**
+ * The index is built without holding the lock, so two threads that
+ * need the same tile at the same time may both build it (the second
+ * one simply uses the index of the first). Tiles whose index would
+ * exceed the entire budget are remembered, so we don't build their
+ * index over and over.
+ */
+WayNodeIndex::TileIndexRef WayNodeIndex::get(FeatureStore* store, Tip tip)
+{
+    {
+        std::lock_guard lock(mutex_);
+        auto it = tips_.find(tip);
+        if (it != tips_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->index;
+        }
+        if (tooLarge_.contains(tip)) return nullptr;
+    }
+    TileIndexRef index = std::make_shared<const TileIndex>(store->fetchTile(tip));
+    size_t bytes = index->bytes() + sizeof(Entry) + 64;
+        // (approximate overhead of the list node and map entry)
+    std::lock_guard lock(mutex_);
+    if (bytes > maxBytes_)
+    {
+        tooLarge_.insert(tip);
+        return nullptr;
+    }
+    auto it = tips_.find(tip);
+    if (it != tips_.end()) return it->second->index;
+    while (bytes_ + bytes > maxBytes_)
+    {
+        const Entry& oldest = entries_.back();
+        bytes_ -= oldest.index->bytes() + sizeof(Entry) + 64;
+        tips_.erase(oldest.tip);
+        entries_.pop_back();
+    }
+    entries_.push_front({ tip, index });
+    tips_.emplace(tip, entries_.begin());
+    bytes_ += bytes;
+    return index;
+}
+
+
+size_t WayNodeIndex::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+void WayNodeIndex::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    entries_.clear();
+    tips_.clear();
+    tooLarge_.clear();
+    bytes_ = 0;
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+} // namespace geodesk
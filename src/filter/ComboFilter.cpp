@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/filter/ComboFilter.h>
+#include <algorithm>
 
 namespace geodesk {
 
@@ -13,6 +14,8 @@ namespace geodesk {
 //   - If STRICT_BBOX, use intersection of all bboxes
 //   - If not STRICT_BBOX, use smallest bbox
 // -  
+// - Child filters are evaluated in the order of their cost (cheapest
+//   first); the turbo flags returned by acceptTile() follow this order
 
 ComboFilter::ComboFilter(const Filter* a, const Filter* b)
 {
@@ -38,6 +41,8 @@ ComboFilter::ComboFilter(const Filter* a, const Filter* b)
     }
     add(a);
     add(b);
+    std::stable_sort(filters_.begin(), filters_.end(),
+        [](const Filter* x, const Filter* y) { return x->cost() < y->cost(); });
 }
 
 
@@ -94,4 +99,38 @@ int ComboFilter::acceptTile(Tile tile) const
     }
     return fast;
 }
+
+bool ComboFilter::acceptsAllInTile(uint32_t turboFlags) const
+{
+    for (auto it = filters_.begin(); it != filters_.end(); ++it)
+    {
+        if (!(*it)->acceptsAllInTile(turboFlags & 1)) return false;
+        turboFlags >>= 1;
+    }
+    return true;
+}
+
+double ComboFilter::cost() const
+{
+    double total = 0;
+    for (auto it = filters_.begin(); it != filters_.end(); ++it)
+    {
+        total += (*it)->cost();
+    }
+    return total;
+}
+
+/// A feature must pass every child filter, so it must also
+/// satisfy the tightest of their limits
+Filter::BoxLimits ComboFilter::boxLimits() const
+{
+    BoxLimits limits;
+    for (auto it = filters_.begin(); it != filters_.end(); ++it)
+    {
+        BoxLimits child = (*it)->boxLimits();
+        limits.minArea = std::max(limits.minArea, child.minArea);
+        limits.maxWayLength = std::min(limits.maxWayLength, child.maxWayLength);
+    }
+    return limits;
+}
 } // namespace geodesk
@@ -37,6 +37,7 @@ ConnectedFilter::ConnectedFilter(FeatureStore* store, FeaturePtr feature)
 		collectMemberPoints(store, relation, guard);
 		bounds_ = relation.bounds();
 	}
+	points_.build();
 }
 
 
@@ -85,20 +86,21 @@ void ConnectedFilter::collectMemberPoints(FeatureStore* store, RelationPtr relat
 
 bool ConnectedFilter::acceptWay(WayPtr way) const
 {
+	if (!points_.mayContainAny(way.bounds())) return false;
 	WayCoordinateIterator iter;
 	iter.start(way, 0);
 	for (;;)
 	{
 		Coordinate c = iter.next();
 		if (c.isNull()) break;
-		if (points_.find(c) != points_.end()) return true;
+		if (points_.contains(c)) return true;
 	}
 	return false;
 }
 
 bool ConnectedFilter::acceptNode(NodePtr node) const
 {
-	return points_.find(node.xy()) != points_.end();
+	return points_.contains(node.xy());
 }
 
 bool ConnectedFilter::acceptAreaRelation(FeatureStore* store, RelationPtr relation) const
@@ -0,0 +1,240 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/filter/FeatureDistanceFilter.h>
+#include <cmath>
+#include <limits>
+#include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Distance.h>
+#include <geodesk/geom/LineSegment.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/PointSegmentDistance.h>
+#include <geodesk/geom/index/MonotoneChain.h>
+#include <geodesk/geom/polygon/PointInPolygon.h>
+
+namespace geodesk {
+
+FeatureDistanceFilter::FeatureDistanceFilter(double meters, const Box& bounds,
+	MCIndex&& index, bool polygonal) :
+	PreparedSpatialFilter(bounds, std::move(index)),
+	polygonal_(polygonal)
+{
+	double d = Mercator::unitsFromMeters(meters, bounds.center().y);
+	margin_ = static_cast<int32_t>(std::ceil(d));
+	distanceSquared_ = d * d;
+	if (polygonal) buildCoverage();
+	bounds_.buffer(margin_);
+	flags_ |= FilterFlags::FAST_TILE_FILTER;
+	source_.meters = meters;
+}
+
+
+bool FeatureDistanceFilter::anyChain(const RTree<const MonotoneChain>::Node* /* node */,
+	const Box* /* bounds */)
+{
+	return true;
+}
+
+
+/// Checks whether any chain's bounding box lies within the distance
+/// of the given box
+bool FeatureDistanceFilter::anyChainsNear(const Box& bounds) const
+{
+	Box searchBounds = bounds;
+	searchBounds.buffer(margin_);
+	if (searchBounds.minX() > searchBounds.maxX())
+	{
+		// Buffering a box that (nearly) spans the width of the map wraps
+		// its X-range around; search the full width instead
+		searchBounds = Box(std::numeric_limits<int32_t>::min(), searchBounds.minY(),
+			std::numeric_limits<int32_t>::max(), searchBounds.maxY());
+	}
+	return index_.findChains<const Box*>(searchBounds, anyChain, &searchBounds);
+}
+
+
+/// The distance between two segments is zero if they intersect;
+/// otherwise, it is the shortest distance between an endpoint of one
+/// and the other segment. The endpoints of the candidate segment are
+/// measured against the whole chain by the vectorized kernel.
+bool FeatureDistanceFilter::chainWithinDistance(
+	const RTree<const MonotoneChain>::Node* node, const SegmentClosure* segment)
+{
+	const MonotoneChain* chain = node->item();
+	const Coordinate* coords = chain->coordinates();
+	int count = chain->vertexCount();
+	double limit = segment->distanceSquared;
+	Coordinate start = segment->start;
+	Coordinate end = segment->end;
+
+	if (PointSegmentDistance(start).minSquared(coords, count, limit) < limit) return true;
+	if (start == end) return false;
+	if (PointSegmentDistance(end).minSquared(coords, count, limit) < limit) return true;
+	for (int i = 0; i < count; i++)
+	{
+		if (Distance::pointSegmentSquared(start.x, start.y, end.x, end.y,
+			coords[i].x, coords[i].y) < limit)
+		{
+			return true;
+		}
+	}
+	for (int i = 1; i < count; i++)
+	{
+		if (LineSegment::linesIntersect(start, end, coords[i-1], coords[i])) return true;
+	}
+	return false;
+}
+
+
+bool FeatureDistanceFilter::segmentWithinDistance(Coordinate start, Coordinate end) const
+{
+	Box searchBounds = Box::normalizedSimple(start, end);
+	searchBounds.buffer(margin_);
+	SegmentClosure closure{ start, end, distanceSquared_ };
+	return index_.findChains<const SegmentClosure*>(searchBounds,
+		chainWithinDistance, &closure);
+}
+
+
+bool FeatureDistanceFilter::segmentsWithinDistance(WayPtr way, int areaFlag) const
+{
+	WayCoordinateIterator iter;
+	iter.start(way, areaFlag);
+	Coordinate coords[WayCoordinateIterator::BATCH_SIZE + 1];
+	int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE + 1);
+	if (count == 0) return false;
+	for (;;)
+	{
+		for (int i = 1; i < count; i++)
+		{
+			if (segmentWithinDistance(coords[i-1], coords[i])) return true;
+		}
+		coords[0] = coords[count - 1];
+		int n = iter.decode(coords + 1, WayCoordinateIterator::BATCH_SIZE);
+		if (n == 0) break;
+		count = n + 1;
+	}
+	return count == 1 && segmentWithinDistance(coords[0], coords[0]);
+}
+
+
+bool FeatureDistanceFilter::chainInsideArea(
+	const RTree<const MonotoneChain>::Node* node, const AreaClosure* closure)
+{
+	Coordinate first = node->item()->first();
+	if (!closure->bounds.contains(first)) return false;
+	PointInPolygon pip(first);
+	bool onBoundary = closure->area.isWay() ?
+		pip.testAgainstWay(WayPtr(closure->area)) :
+		pip.testAgainstRelation(closure->store, RelationPtr(closure->area));
+	return onBoundary || pip.isInside();
+}
+
+
+/// Checks whether the given area contains any part of the reference
+/// feature. Only called once we know that the area's boundary is
+/// farther away than the distance, which means every chain lies
+/// either entirely inside or entirely outside the area; hence, we
+/// only need to test one vertex per chain.
+bool FeatureDistanceFilter::containsAnyChain(FeatureStore* store, FeaturePtr area) const
+{
+	AreaClosure closure{ store, area, area.bounds() };
+	return index_.findChains<const AreaClosure*>(closure.bounds,
+		chainInsideArea, &closure);
+}
+
+
+bool FeatureDistanceFilter::acceptNode(NodePtr node) const
+{
+	Coordinate xy = node.xy();
+	if (polygonal_ && index_.containsPoint(xy)) return true;
+	return segmentWithinDistance(xy, xy);
+}
+
+
+bool FeatureDistanceFilter::acceptWay(WayPtr way) const
+{
+	if (polygonal_)
+	{
+		// If any part of the way lies inside the reference area,
+		// either its first vertex does, or the way crosses the
+		// boundary (which the segment check will find)
+		WayCoordinateIterator iter(way);
+		if (index_.containsPoint(iter.next())) return true;
+	}
+	bool isArea = way.isArea();
+	if (segmentsWithinDistance(way, isArea ? FeatureFlags::AREA : 0)) return true;
+	return isArea && containsAnyChain(nullptr, way);
+}
+
+
+bool FeatureDistanceFilter::acceptAreaRelation(FeatureStore* store, RelationPtr relation) const
+{
+	bool firstWay = true;
+	FastMemberIterator iter(store, relation);
+	for (;;)
+	{
+		FeaturePtr member = iter.next();
+		if (member.isNull()) break;
+		if (!member.isWay()) continue;
+		WayPtr memberWay(member);
+		if (memberWay.isPlaceholder()) continue;
+		if (polygonal_ && firstWay)
+		{
+			WayCoordinateIterator coordIter(memberWay);
+			if (index_.containsPoint(coordIter.next())) return true;
+			firstWay = false;
+		}
+		if (segmentsWithinDistance(memberWay, member.flags())) return true;
+	}
+	return containsAnyChain(store, relation);
+}
+
+
+bool FeatureDistanceFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
+{
+	if (fast.turboFlags)
+	{
+		if ((feature.flags() &
+			(FeatureFlags::MULTITILE_NORTH | FeatureFlags::MULTITILE_WEST)) == 0)
+		{
+			// If feature lies completely within the current tile,
+			// we can fast-accept it
+
+			if (feature.minY() >= fast.tile.bottomY() &&
+				feature.maxX() <= fast.tile.rightX())
+			{
+				return true;
+			}
+		}
+	}
+	Box bounds = feature.isNode() ? NodePtr(feature).bounds() : feature.bounds();
+	if (polygonal_ && coverage_.locateBox(bounds) > 0) return true;
+	if (!anyChainsNear(bounds))
+	{
+		// The feature is farther than the distance from the boundary;
+		// it is only accepted if it lies inside the reference area
+		// (it cannot contain the reference feature, as the bounding
+		// box of any such feature would include the boundary)
+		return polygonal_ && index_.locatePoint(bounds.bottomLeft()) > 0;
+	}
+	return acceptFeature(store, feature);
+}
+
+
+/**
+ * Tiles whose bounding box is farther than the distance from the
+ * reference feature's boundary are skipped (or accelerated, if they
+ * lie inside the reference area).
+ */
+int FeatureDistanceFilter::acceptTile(Tile tile) const
+{
+	Box tileBounds = tile.bounds();
+	if (anyChainsNear(tileBounds)) return 0;
+	if (polygonal_ && index_.locatePoint(tileBounds.bottomLeft()) > 0) return 1;
+		// TODO: Don't use 1 to indicate tile acceleration, use enum constant
+	return -1;
+}
+
+} // namespace geodesk
@@ -4,8 +4,12 @@
 #include <geodesk/filter/Filters.h>
 #include <geodesk/feature/FeatureBase.h>
 #include <geodesk/feature/QueryException.h>
+#include <geodesk/filter/AreaFilter.h>
 #include <geodesk/filter/CrossesFilter.h>
+#include <geodesk/filter/FeatureDistanceFilter.h>
+#include <geodesk/filter/GeosPreparedFilter.h>
 #include <geodesk/filter/IntersectsFilter.h>
+#include <geodesk/filter/LengthFilter.h>
 #include <geodesk/filter/PointDistanceFilter.h>
 #include <geodesk/filter/WithinFilter.h>
 
@@ -40,6 +44,29 @@ const Filter* Filters::within(Feature feature)
     return filter(WithinFilterFactory(), feature);
 }
 
+const Filter* polygonFilter(PreparedFilterFactory&& factory,
+    std::span<const Coordinate> shell, std::span<const std::vector<Coordinate>> holes)
+{
+    const Filter* filter = factory.forPolygon(shell, holes);
+    if(filter == nullptr)
+    {
+        throw QueryException("Polygon must have at least 3 coordinates");
+    }
+    return filter;
+}
+
+const Filter* Filters::intersects(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes)
+{
+    return polygonFilter(IntersectsFilterFactory(), shell, holes);
+}
+
+const Filter* Filters::within(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes)
+{
+    return polygonFilter(WithinFilterFactory(), shell, holes);
+}
+
 const Filter* Filters::containsPoint(Coordinate xy)
 {
     return new ContainsPointFilter(xy);
@@ -55,4 +82,43 @@ const Filter* Filters::maxMetersFrom(double meters, Coordinate xy)
     return new PointDistanceFilter(meters, xy);
 }
 
+const Filter* Filters::maxMetersFrom(double meters, Feature feature)
+{
+    return filter(DistanceFilterFactory(meters), feature);
+}
+
+const Filter* Filters::area(double minArea, double maxArea)
+{
+    return new AreaFilter(minArea, maxArea);
+}
+
+const Filter* Filters::length(double minLength, double maxLength)
+{
+    return new LengthFilter(minLength, maxLength);
+}
+
+#ifdef GEODESK_WITH_GEOS
+// Points, lines and polygons get the same native filters as features;
+// only other geometries (such as collections) fall back to GEOS
+const Filter* Filters::intersects(GEOSContextHandle_t context,
+    const GEOSGeometry* geom, int workerCount)
+{
+    const Filter* filter = IntersectsFilterFactory().forGeometry(
+        context, const_cast<GEOSGeometry*>(geom));
+    if (filter) return filter;
+    return new GeosPreparedFilter(context, geom,
+        GeosPreparedFilter::INTERSECTS, workerCount);
+}
+
+const Filter* Filters::within(GEOSContextHandle_t context,
+    const GEOSGeometry* geom, int workerCount)
+{
+    const Filter* filter = WithinFilterFactory().forGeometry(
+        context, const_cast<GEOSGeometry*>(geom));
+    if (filter) return filter;
+    return new GeosPreparedFilter(context, geom,
+        GeosPreparedFilter::WITHIN, workerCount);
+}
+#endif
+
 } // namespace geodesk
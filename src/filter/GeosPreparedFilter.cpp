@@ -0,0 +1,101 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_WITH_GEOS
+
+#include <geodesk/filter/GeosPreparedFilter.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/geom/GeometryBuilder.h>
+#include <geodesk/geom/geos/Geos.h>
+
+namespace geodesk {
+
+GeosPreparedFilter::Slot::~Slot()
+{
+    if (prepared) GEOSPreparedGeom_destroy_r(context, prepared);
+    if (geometry) GEOSGeom_destroy_r(context, geometry);
+    GEOS_finish_r(context);
+}
+
+
+GeosPreparedFilter::GeosPreparedFilter(GEOSContextHandle_t context,
+    const GEOSGeometry* geom, Predicate predicate, int workerCount) :
+    SpatialFilter(Geos::getEnvelope(context, const_cast<GEOSGeometry*>(geom))),
+    predicate_(predicate),
+    workerCount_(workerCount),
+    slots_(new Slot[workerCount + 1])
+{
+    flags_ |= FilterFlags::FAST_TILE_FILTER;
+    if (predicate == WITHIN) flags_ |= FilterFlags::STRICT_BBOX;
+    for (int i = 0; i <= workerCount; i++)
+    {
+        Slot& slot = slots_[i];
+        slot.geometry = GEOSGeom_clone_r(slot.context, geom);
+        slot.prepared = GEOSPrepare_r(slot.context, slot.geometry);
+    }
+}
+
+
+template <typename Fn>
+auto GeosPreparedFilter::withSlot(Fn fn) const
+{
+    int worker = QueryExecutor::currentWorker();
+    if (worker >= 0 && worker < workerCount_) return fn(slots_[worker]);
+    std::lock_guard lock(sharedMutex_);
+    return fn(slots_[workerCount_]);
+}
+
+
+/// A tile that lies in the interior of the geometry lets an
+/// "intersects" query accept all of its features, and a "within"
+/// query accept those features that lie within the tile; a tile
+/// that doesn't touch the geometry is skipped (like the native
+/// filters, see IntersectsPolygonFilter::acceptTile())
+int GeosPreparedFilter::acceptTile(Tile tile) const
+{
+    return withSlot([tile](const Slot& slot)
+    {
+        GEOSGeometry* box = GeometryBuilder::buildBoxGeometry(tile.bounds(), slot.context);
+        int result = 0;
+        if (GEOSPreparedContainsProperly_r(slot.context, slot.prepared, box) == 1)
+        {
+            result = 1;
+        }
+        else if (GEOSPreparedIntersects_r(slot.context, slot.prepared, box) == 0)
+        {
+            result = -1;
+        }
+        GEOSGeom_destroy_r(slot.context, box);
+        return result;
+    });
+}
+
+
+bool GeosPreparedFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
+{
+    if (fast.turboFlags)
+    {
+        if (predicate_ == INTERSECTS) return true;
+        const Box& tileBounds = fast.tile.bounds();
+        if (feature.isNode() ? tileBounds.contains(NodePtr(feature).xy()) :
+            tileBounds.contains(feature.bounds()))
+        {
+            return true;
+        }
+    }
+    return withSlot([this, store, feature](const Slot& slot)
+    {
+        GEOSGeometry* geom = GeometryBuilder::buildFeatureGeometry(
+            store, feature, slot.context);
+        if (!geom) return false;
+        char result = predicate_ == INTERSECTS ?
+            GEOSPreparedIntersects_r(slot.context, slot.prepared, geom) :
+            GEOSPreparedContains_r(slot.context, slot.prepared, geom);
+        GEOSGeom_destroy_r(slot.context, geom);
+        return result == 1;
+    });
+}
+
+} // namespace geodesk
+
+#endif // GEODESK_WITH_GEOS
@@ -36,7 +36,7 @@ static bool chainContainedByAreaRelation(
 bool IntersectsPolygonFilter::acceptWay(WayPtr way) const
 {
 	Box bounds = way.bounds();
-	int loc = index_.maybeLocateBox(bounds);
+	int loc = locateBounds(bounds);
 	if (loc != 0) return loc > 0;
 
 	if (wayIntersectsPolygon(way)) return true;
@@ -78,6 +78,20 @@ bool IntersectsPolygonFilter::acceptAreaRelation(FeatureStore* store, RelationPt
 bool IntersectsPolygonFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
 {
 	if (fast.turboFlags) return true;
+	int loc = 0;
+	if (feature.isNode())
+	{
+		loc = coverage_.locateBox(NodePtr(feature).bounds());
+	}
+	else if (feature.isRelation())
+	{
+		// A relation whose bbox lies fully inside or outside can be
+		// decided without looking at any of its members
+		loc = locateBounds(feature.bounds());
+	}
+	// (ways are located by acceptWay(), which is also used for
+	// the member ways of relations)
+	if (loc != 0) return loc > 0;
 	return acceptFeature(store, feature);
 }
 
@@ -2,65 +2,93 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/filter/PointDistanceFilter.h>
+#include <algorithm>
+#include <limits>
 #include <geodesk/feature/FeatureStore.h>
 #include <geodesk/feature/FastMemberIterator.h>
 #include <geodesk/feature/WayPtr.h>
 #include <geodesk/geom/polygon/PointInPolygon.h>
 #include <geodesk/geom/Distance.h>
+#include <geodesk/geom/PointSegmentDistance.h>
 
 namespace geodesk {
 
-// TODO: Conditionally accelerate if distance is far enough that
-// some tiles could lie outside the circle
-
 PointDistanceFilter::PointDistanceFilter(double meters, Coordinate point)
 	: point_(point)
 {
 	double d = Mercator::unitsFromMeters(meters, point.y);
 	bounds_ = Box::unitsAroundXY((int32_t)std::ceil(d), point);
 	distanceSquared_ = d * d;
+	flags_ |= FilterFlags::FAST_TILE_FILTER;
+	source_.xy = point;
+	source_.meters = meters;
 }
 
 
-bool PointDistanceFilter::segmentsWithinDistance(WayPtr way, int areaFlag) const
+/**
+ * Tiles that lie entirely inside the circle are accelerated, and
+ * tiles that lie entirely outside are skipped. For small radii, this
+ * applies to few tiles (most tiles merely overlap the circle), but
+ * the check is cheap.
+ */
+int PointDistanceFilter::acceptTile(Tile tile) const
 {
+    Box bounds = tile.bounds();
+    double x = point_.x;
+    double y = point_.y;
+    double nearX = std::clamp(x, static_cast<double>(bounds.minX()),
+        static_cast<double>(bounds.maxX()));
+    double nearY = std::clamp(y, static_cast<double>(bounds.minY()),
+        static_cast<double>(bounds.maxY()));
+    if (Distance::pointsSquared(x, y, nearX, nearY) >= distanceSquared_) return -1;
+    double farX = std::max(x - bounds.minX(), bounds.maxX() - x);
+    double farY = std::max(y - bounds.minY(), bounds.maxY() - y);
+    if (farX * farX + farY * farY < distanceSquared_) return 1;
+        // TODO: Don't use 1 to indicate tile acceleration, use enum constant
+    return 0;
+}
+
+
+double PointDistanceFilter::segmentsDistanceSquared(WayPtr way, int areaFlag,
+    Coordinate point, double limit)
+{
+    // Each batch starts with the last coordinate of the previous
+    // batch, so the kernel sees every segment exactly once
+    PointSegmentDistance kernel(point);
     WayCoordinateIterator iter;
     iter.start(way, areaFlag);
-    Coordinate c = iter.next();
-    double x1 = c.x;
-    double y1 = c.y;
+    Coordinate coords[WayCoordinateIterator::BATCH_SIZE + 1];
+    int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE + 1);
+    double minDistance = std::numeric_limits<double>::infinity();
+    if (count == 0) return minDistance;
     for(;;)
     {
-        c = iter.next();
-        if (c.isNull()) break;
-        double x2 = c.x;
-        double y2 = c.y;
-        if (Distance::pointSegmentSquared(x1, y1, x2, y2,
-            point_.x, point_.y) < distanceSquared_)
-        {
-            return true;
-        }
-        x1 = x2;
-        y1 = y2;
+        minDistance = std::min(minDistance,
+            kernel.minSquared(coords, count, limit));
+        if (minDistance < limit) return minDistance;
+        coords[0] = coords[count - 1];
+        int n = iter.decode(coords + 1, WayCoordinateIterator::BATCH_SIZE);
+        if (n == 0) break;
+        count = n + 1;
     }
-    return false;
+    return minDistance;
 }
 
 
-bool PointDistanceFilter::isWithinDistance(WayPtr way) const
+double PointDistanceFilter::wayDistanceSquared(WayPtr way, Coordinate point, double limit)
 {
     if (way.isArea())
     {
-        if (segmentsWithinDistance(way, FeatureFlags::AREA)) return true;
+        double d = segmentsDistanceSquared(way, FeatureFlags::AREA, point, limit);
+        if (d < limit) return d;
         // The distance of a point that lies within a polygon is zero;
         // we need to perform p-in-p check because the edges themselves
         // may be far away from the comparison point
-        // TODO: check bbox first?
         Box bounds = way.bounds();
-        if (!bounds.contains(point_)) return false;
-        PointInPolygon pip(point_);
+        if (!bounds.contains(point)) return d;
+        PointInPolygon pip(point);
         pip.testAgainstWay(way);
-        return pip.isInside();
+        return pip.isInside() ? 0 : d;
         /*
         if (point_.y >= bounds.minY() && point_.y <= bounds.maxY())
         {
@@ -68,16 +96,17 @@ bool PointDistanceFilter::isWithinDistance(WayPtr way) const
         }
         */
     }
-    return segmentsWithinDistance(way, 0);
+    return segmentsDistanceSquared(way, 0, point, limit);
 }
 
 
-bool PointDistanceFilter::isAreaWithinDistance(FeatureStore* store, RelationPtr relation) const
+double PointDistanceFilter::areaDistanceSquared(FeatureStore* store,
+    RelationPtr relation, Coordinate point, double limit)
 {
     // measure distance to the ways that define shell and holes, and
     // also perform point in polygon test
-    int odd = 0;
-    PointInPolygon pip(point_);
+    double minDistance = std::numeric_limits<double>::infinity();
+    PointInPolygon pip(point);
     FastMemberIterator iter(store, relation);
     for (;;)
     {
@@ -87,51 +116,63 @@ bool PointDistanceFilter::isAreaWithinDistance(FeatureStore* store, RelationPtr
         WayPtr memberWay(member);
         if (memberWay.isPlaceholder()) continue;
         int memberFlags = member.flags();
-        if (segmentsWithinDistance(memberWay, memberFlags)) return true;
-        /*
-        Box bounds = memberWay.bounds();
-        if (point_.y >= bounds.minY() && point_.y <= bounds.maxY())
-        {
-            odd ^= memberWay.containsPointFast(point_.x, point_.y);
-            LOG("odd = %d", odd);
-        }
-        */
+        minDistance = std::min(minDistance, segmentsDistanceSquared(
+            memberWay, memberFlags, point, limit));
+        if (minDistance < limit) return minDistance;
         // No bbox check needed, testAgainstWay() does it
         pip.testAgainstWay(memberWay);
     }
-    // LOG("final odd = %d", odd);
-    // return odd != 0;
-    return pip.isInside();
+    return pip.isInside() ? 0 : minDistance;
 }
 
 
-bool PointDistanceFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
+double PointDistanceFilter::distanceSquared(FeatureStore* store, FeaturePtr feature,
+    Coordinate point, double limit)
 {
     FeatureType type = feature.type();
     if (type == FeatureType::WAY)
     {
-        WayPtr way(feature);
-        return isWithinDistance(way);
+        return wayDistanceSquared(WayPtr(feature), point, limit);
     }
     if (type == FeatureType::NODE)
     {
         NodePtr node(feature);
-        return Distance::pointsSquared(node.x(), node.y(), 
-            point_.x, point_.y) < distanceSquared_;
+        return Distance::pointsSquared(node.x(), node.y(), point.x, point.y);
     }
     assert(type == FeatureType::RELATION);
     if (feature.isArea())
     {
-        return isAreaWithinDistance(store, RelationPtr(feature));
+        return areaDistanceSquared(store, RelationPtr(feature), point, limit);
     }
     RelationPtr relation(feature);
     RecursionGuard guard(relation);
-    return areMembersWithinDistance(store, relation, guard);
+    return membersDistanceSquared(store, relation, point, limit, guard);
+}
+
+
+bool PointDistanceFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
+{
+    if (fast.turboFlags)
+    {
+        // If the feature lies completely within the current tile
+        // (which lies inside the circle), we can fast-accept it
+
+        if ((feature.flags() &
+            (FeatureFlags::MULTITILE_NORTH | FeatureFlags::MULTITILE_WEST)) == 0 &&
+            feature.minY() >= fast.tile.bottomY() &&
+            feature.maxX() <= fast.tile.rightX())
+        {
+            return true;
+        }
+    }
+    return distanceSquared(store, feature, point_, distanceSquared_) < distanceSquared_;
 }
 
 
-bool PointDistanceFilter::areMembersWithinDistance(FeatureStore* store, RelationPtr relation, RecursionGuard& guard) const
+double PointDistanceFilter::membersDistanceSquared(FeatureStore* store,
+    RelationPtr relation, Coordinate point, double limit, RecursionGuard& guard)
 {
+    double minDistance = std::numeric_limits<double>::infinity();
     FastMemberIterator iter(store, relation);
     for (;;)
     {
@@ -141,29 +182,28 @@ bool PointDistanceFilter::areMembersWithinDistance(FeatureStore* store, Relation
         if (typeCode == 1)
         {
             WayPtr memberWay(member);
-            if (!memberWay.isPlaceholder() && isWithinDistance(memberWay)) return true;
+            if (memberWay.isPlaceholder()) continue;
+            minDistance = std::min(minDistance,
+                wayDistanceSquared(memberWay, point, limit));
         }
         else if (typeCode == 0)
         {
             NodePtr memberNode(member);
-            if (!memberNode.isPlaceholder() && Distance::pointsSquared(
-                memberNode.x(), memberNode.y(), point_.x, point_.y) < distanceSquared_)
-            {
-                return true;
-            }
+            if (memberNode.isPlaceholder()) continue;
+            minDistance = std::min(minDistance, Distance::pointsSquared(
+                memberNode.x(), memberNode.y(), point.x, point.y));
         }
         else
         {
             assert(member.isRelation());
             RelationPtr memberRel(member);
-            if (!memberRel.isPlaceholder() && guard.checkAndAdd(memberRel) &&
-                areMembersWithinDistance(store, memberRel, guard))
-            {
-                return true;
-            }
+            if (memberRel.isPlaceholder() || !guard.checkAndAdd(memberRel)) continue;
+            minDistance = std::min(minDistance,
+                membersDistanceSquared(store, memberRel, point, limit, guard));
         }
+        if (minDistance < limit) break;
     }
-    return false;
+    return minDistance;
 }
 
 } // namespace geodesk
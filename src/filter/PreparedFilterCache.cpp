@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/filter/PreparedFilterCache.h>
+#include <geodesk/filter/Filter.h>
+
+namespace geodesk {
+
+PreparedFilterCache::PreparedFilterCache(size_t maxBytes) :
+    maxBytes_(maxBytes),
+    bytes_(0),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+PreparedFilterCache::~PreparedFilterCache()
+{
+    clear();
+}
+
+
+void PreparedFilterCache::clear()
+{
+    for (const Entry& entry : entries_) entry.filter->release();
+    entries_.clear();
+    keys_.clear();
+    bytes_ = 0;
+}
+
+
+/**
+ * The key combines the typed ID of the feature (so a way and a relation
+ * with the same ID don't collide) with the kind of filter.
+ *
+ * The filter is prepared without holding the lock, so two threads that
+ * need the same filter at the same time may both prepare it (the second
+ * one simply uses the filter of the first). Filters that would exceed
+ * the entire budget are returned, but not cached.
+ */
+const Filter* PreparedFilterCache::get(int kind, FeaturePtr feature, const Builder& build)
+{
+    uint64_t key = (feature.typedId() << 2) | kind;
+    {
+        std::lock_guard lock(mutex_);
+        auto it = keys_.find(key);
+        if (it != keys_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            it->second->filter->addref();
+            return it->second->filter;
+        }
+    }
+    size_t bytes = 0;
+    const Filter* filter = build(bytes);
+    if (!filter) return nullptr;
+    bytes += sizeof(Entry) + 64;
+        // (approximate overhead of the list node and map entry)
+    if (bytes > maxBytes_) return filter;
+    std::lock_guard lock(mutex_);
+    auto it = keys_.find(key);
+    if (it != keys_.end())
+    {
+        filter->release();
+        it->second->filter->addref();
+        return it->second->filter;
+    }
+    while (bytes_ + bytes > maxBytes_)
+    {
+        const Entry& oldest = entries_.back();
+        bytes_ -= oldest.bytes;
+        oldest.filter->release();
+        keys_.erase(oldest.key);
+        entries_.pop_back();
+    }
+    entries_.push_front({ key, filter, bytes });
+    keys_.emplace(key, entries_.begin());
+    bytes_ += bytes;
+    filter->addref();       // one reference for the cache, one for the caller
+    return filter;
+}
+
+
+size_t PreparedFilterCache::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+void PreparedFilterCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    clear();
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+} // namespace geodesk
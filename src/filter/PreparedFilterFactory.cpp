@@ -2,12 +2,42 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/filter/PreparedFilterFactory.h>
+#include <geodesk/filter/PreparedFilterCache.h>
+#include <geodesk/feature/FeatureStore.h>
 #include <geodesk/geom/geos/Geos.h>
+#include <clarisma/util/Tracer.h>
 
 namespace geodesk {
 
 const Filter* PreparedFilterFactory::forFeature(FeatureStore* store, FeaturePtr feature)
 {
+	PreparedFilterCache* cache = kind_ == UNCACHED ? nullptr : store->preparedFilterCache();
+	if (!cache) return prepareWithSource(store, feature);
+	return cache->get(kind_, feature, [this, store, feature](size_t& bytes)
+	{
+		const Filter* filter = prepareWithSource(store, feature);
+		bytes = indexBuilder_.indexSize();
+		return filter;
+	});
+}
+
+// The filter has just been created, so nobody else can see it yet
+const Filter* PreparedFilterFactory::prepareWithSource(FeatureStore* store, FeaturePtr feature)
+{
+	Filter* filter = const_cast<Filter*>(prepare(store, feature));
+	if (filter)
+	{
+		Filter::Source source = filter->source();
+		source.typedId = feature.typedId();
+		filter->setSource(source);
+	}
+	return filter;
+}
+
+
+const Filter* PreparedFilterFactory::prepare(FeatureStore* store, FeaturePtr feature)
+{
+	GEODESK_TRACE_SPAN("prepare filter", feature.id());
 	if (feature.isType(FeatureTypes::RELATIONS & FeatureTypes::AREAS))
 	{
 		RelationPtr relation(feature);
@@ -93,6 +123,27 @@ const Filter* PreparedFilterFactory::forGeometry(GEOSContextHandle_t context, GE
 #endif
 
 
+const Filter* PreparedFilterFactory::forPolygon(std::span<const Coordinate> shell,
+	std::span<const std::vector<Coordinate>> holes)
+{
+	if (shell.size() < 3) return nullptr;
+	auto addRing = [this](std::span<const Coordinate> ring)
+	{
+		if (ring.size() < 2) return;
+		indexBuilder_.segmentizeCoords(ring);
+		if (ring.front() != ring.back())
+		{
+			indexBuilder_.addLineSegment(ring.back(), ring.front());
+		}
+	};
+	bounds_ = Box();
+	for (Coordinate c : shell) bounds_.expandToInclude(c);
+	addRing(shell);
+	for (const std::vector<Coordinate>& hole : holes) addRing(hole);
+	return forPolygonal();
+}
+
+
 const Filter* PreparedFilterFactory::forBox(const Box& box)
 {
 	bounds_ = box;
@@ -0,0 +1,130 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/filter/SetFilter.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/match/Matcher.h>
+
+namespace geodesk {
+
+SetFilter::Branch::Branch(const View& view) :
+    types(view.types()),
+    bounds(view.bounds()),
+    matcher(view.matcher()),
+    filter(view.filter())
+{
+    matcher->addref();
+    if (filter) filter->addref();
+}
+
+bool SetFilter::Branch::contains(FeatureStore* store, FeaturePtr feature,
+    FastFilterHint fast) const
+{
+    if (!types.acceptFlags(feature.flags())) return false;
+    if (feature.isNode())
+    {
+        if (!bounds.contains(NodePtr(feature).xy())) return false;
+    }
+    else
+    {
+        if (!feature.intersects(bounds)) return false;
+    }
+    if (!matcher->mainMatcher().accept(feature)) return false;
+    // The turbo flags are ours, not the branch filter's
+    return !filter || filter->accept(store, feature,
+        FastFilterHint(0, fast.tile, fast.tip));
+}
+
+bool SetFilter::Branch::mayContain(Tile tile) const
+{
+    return types != 0 && bounds.intersects(tile.bounds()) &&
+        (!filter || filter->acceptTile(tile) >= 0);
+}
+
+SetFilter::SetFilter(Operation op, const View& a, const View& b) :
+    SpatialFilter(FilterFlags::USES_BBOX | FilterFlags::FAST_TILE_FILTER,
+        op == Operation::DIFFERENCE ? a.types() : (a.types() | b.types()),
+        a.bounds()),
+    op_(op),
+    a_(a),
+    b_(b)
+{
+    if (op != Operation::DIFFERENCE) bounds_.expandToIncludeSimple(b.bounds());
+}
+
+SetFilter::~SetFilter()
+{
+    for (const Branch* branch : { &a_, &b_ })
+    {
+        branch->matcher->release();
+        if (branch->filter) branch->filter->release();
+    }
+}
+
+bool SetFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
+{
+    bool inA = a_.contains(store, feature, fast);
+    switch (op_)
+    {
+    case Operation::UNION:
+        return inA || b_.contains(store, feature, fast);
+    case Operation::DIFFERENCE:
+        return inA && !b_.contains(store, feature, fast);
+    default:
+        return inA != b_.contains(store, feature, fast);
+    }
+}
+
+/**
+ * Skips a tile if it can't contain any feature of the result
+ * (there are no turbo flags, since the branches must always be
+ * told apart feature by feature).
+ */
+int SetFilter::acceptTile(Tile tile) const
+{
+    bool mayBeInA = a_.mayContain(tile);
+    if (op_ == Operation::DIFFERENCE) return mayBeInA ? 0 : -1;
+    return (mayBeInA || b_.mayContain(tile)) ? 0 : -1;
+}
+
+double SetFilter::cost() const
+{
+    // Each branch runs its matcher (about as costly as a simple
+    // filter) and its own filter
+    double cost = 2;
+    for (const Branch* branch : { &a_, &b_ })
+    {
+        if (branch->filter) cost += branch->filter->cost();
+    }
+    return cost;
+}
+
+View SetFilter::combine(Operation op, const View& a, const View& b)
+{
+    if (a.view() == View::EMPTY || b.view() == View::EMPTY)
+    {
+        // (The empty view of a store is also a world view)
+        if (a.view() == View::EMPTY)
+        {
+            return op == Operation::DIFFERENCE ? a : b;
+        }
+        return a;
+    }
+    if (a.view() != View::WORLD || b.view() != View::WORLD ||
+        a.store() != b.store())
+    {
+        throw QueryException("Set operations are only supported for "
+            "world views of the same store");
+    }
+    SetFilter* filter = new SetFilter(op, a, b);
+    FeatureStore* store = a.store();
+    store->addref();
+    // Constructor steals references to the store, matcher and filter
+    const Box& bounds = filter->bounds();
+    int flags = View::USES_FILTER |
+        (bounds == Box::ofWorld() ? 0 : View::BOUNDS_ACTIVE);
+    return View(View::WORLD, flags, filter->acceptedTypes(),
+        store, bounds, store->getAllMatcher(), filter);
+}
+
+} // namespace geodesk
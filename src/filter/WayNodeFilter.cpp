@@ -2,7 +2,9 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/filter/WayNodeFilter.h>
+#include <geodesk/feature/FeatureStore.h>
 #include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/feature/WayNodeIndex.h>
 
 
 namespace geodesk {
@@ -10,6 +12,15 @@ namespace geodesk {
 bool WayNodeFilter::accept(FeatureStore* store, FeaturePtr feature, FastFilterHint fast) const
 {
     assert(feature.isWay());
+    WayNodeIndex* index = fast.tip.isNull() ? nullptr : store->wayNodeIndex();
+    WayNodeIndex::TileIndexRef tileIndex;
+    if (index) tileIndex = index->get(store, fast.tip);
+    if (tileIndex)
+    {
+        // The way belongs to the tile that is being scanned
+        if (!tileIndex->contains(feature, coord_)) return false;
+        return !secondaryFilter_ || secondaryFilter_->accept(store, feature, fast);
+    }
     WayPtr way(feature);
     // LOG("Checking way/%llu", way.id());
     WayCoordinateIterator iter;
@@ -3,6 +3,7 @@
 
 #include <geodesk/filter/WithinFilter.h>
 #include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/RelationTreeCache.h>
 #include <geodesk/geom/Mercator.h>
 #include <geodesk/geom/polygon/PointInPolygon.h>
 #include <geodesk/geom/Centroid.h>
@@ -26,7 +27,7 @@ bool WithinPolygonFilter::acceptWay(WayPtr way) const
 	// (as well as check if way contains the filter polygon)
 
 	Box bounds = way.bounds();
-	int loc = index_.maybeLocateBox(bounds);
+	int loc = locateBounds(bounds);
 	if (loc != 0) return loc > 0;
 
 	// TODO: accept if location >= 0 for area within area
@@ -65,6 +66,23 @@ bool WithinPolygonFilter::acceptNode(NodePtr node) const
 
 bool WithinPolygonFilter::acceptMembers(FeatureStore* store, RelationPtr relation, RecursionGuard* guard) const
 {
+	if (guard)
+	{
+		// The flattened tree holds the same nodes and ways
+		// that locateMembers() visits
+		if (auto leaves = RelationTreeCache::leavesOf(store, relation))
+		{
+			int where = 0;
+			for (FeaturePtr leaf : *leaves)
+			{
+				int location = leaf.isWay() ? locateWay(WayPtr(leaf)) :
+					index_.locatePoint(NodePtr(leaf).xy());
+				if (location < 0) return false;
+				where = std::max(where, location);
+			}
+			return where > 0;
+		}
+	}
 	return locateMembers(store, relation, guard) > 0;
 		// all must lie inide or on boundary, and at least one point
 		// must be inside
@@ -84,7 +102,7 @@ int WithinPolygonFilter::locateMembers(FeatureStore* store, RelationPtr relation
 		{
 			WayPtr memberWay(member);
 			if (memberWay.isPlaceholder()) continue;
-			int wayLocation = locateWayNodes(memberWay);
+			int wayLocation = locateWay(memberWay);
 			if (wayLocation < 0) return -1;
 			where = std::max(where, wayLocation);
 		}
@@ -103,7 +121,8 @@ int WithinPolygonFilter::locateMembers(FeatureStore* store, RelationPtr relation
 			{
 				RelationPtr childRel(member);
 				if (childRel.isPlaceholder() || !guard->checkAndAdd(childRel)) continue;
-				int relLocation = locateMembers(store, childRel, guard);
+				int relLocation = locateBounds(childRel.bounds());
+				if (relLocation == 0) relLocation = locateMembers(store, childRel, guard);
 				if (relLocation < 0) return -1;
 				where = std::max(where, relLocation);
 			}
@@ -126,7 +145,7 @@ bool WithinPolygonFilter::acceptAreaRelation(FeatureStore* store, RelationPtr re
 		{
 			WayPtr memberWay(member);
 			if (memberWay.isPlaceholder()) continue;
-			if (locateWayNodes(memberWay) < 0) return false;
+			if (locateWay(memberWay) < 0) return false;
 		}
 	}
 
@@ -157,6 +176,19 @@ bool WithinPolygonFilter::accept(FeatureStore* store, FeaturePtr feature, FastFi
 			}
 		}
 	}
+	int loc = 0;
+	if (feature.isNode())
+	{
+		loc = coverage_.locateBox(NodePtr(feature).bounds());
+	}
+	else if (feature.isRelation())
+	{
+		// A relation whose bbox lies fully inside or outside can be
+		// decided without looking at any of its members
+		loc = locateBounds(feature.bounds());
+	}
+	// (ways are located by acceptWay())
+	if (loc != 0) return loc > 0;
 	return acceptFeature(store, feature);
 }
 
@@ -232,6 +264,15 @@ bool WithinPolygonFilter::accept(FeatureStore* store, FeatureRef feature, FastFi
 
 */
 
+/// Like locateWayNodes(), but only looks at the nodes of a way if its
+/// bbox can't be located as a whole (so the members of a relation that
+/// lie well inside or outside don't need to be tested one by one)
+int WithinPolygonFilter::locateWay(WayPtr way) const
+{
+	int loc = locateBounds(way.bounds());
+	return loc != 0 ? loc : locateWayNodes(way);
+}
+
 // -1 = outside
 //  0 = completely on boundary
 //  1 = inside
@@ -0,0 +1,404 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/ArrowExport.h>
+#include <clarisma/text/Format.h>
+#include <clarisma/util/ShortVarString.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+// The private data of the schemas and arrays we produce: their
+// children (which we own), and the storage of their strings or buffers
+
+struct SchemaData
+{
+	std::string format;
+	std::string name;
+	std::string metadata;
+	std::vector<ArrowSchema*> children;
+	ArrowSchema* dictionary = nullptr;
+};
+
+struct ArrayData
+{
+	const void* buffers[3] = {};
+	std::vector<ArrowArray*> children;
+	ArrowArray* dictionary = nullptr;
+	std::vector<int64_t> int64s;
+	std::vector<int8_t> int8s;
+	std::vector<int32_t> int32s;
+	std::vector<uint8_t> validity;
+	std::vector<int32_t> offsets;
+	std::string chars;
+	ByteBlock bytes;
+};
+
+void releaseSchema(ArrowSchema* schema)
+{
+	SchemaData* data = static_cast<SchemaData*>(schema->private_data);
+	for (ArrowSchema* child : data->children)
+	{
+		if (child->release) child->release(child);
+		delete child;
+	}
+	if (data->dictionary)
+	{
+		if (data->dictionary->release) data->dictionary->release(data->dictionary);
+		delete data->dictionary;
+	}
+	delete data;
+	schema->release = nullptr;
+}
+
+void releaseArray(ArrowArray* array)
+{
+	ArrayData* data = static_cast<ArrayData*>(array->private_data);
+	for (ArrowArray* child : data->children)
+	{
+		if (child->release) child->release(child);
+		delete child;
+	}
+	if (data->dictionary)
+	{
+		if (data->dictionary->release) data->dictionary->release(data->dictionary);
+		delete data->dictionary;
+	}
+	delete data;
+	array->release = nullptr;
+}
+
+SchemaData* initSchema(ArrowSchema* schema, const char* format,
+	std::string_view name, int64_t flags)
+{
+	SchemaData* data = new SchemaData();
+	data->format = format;
+	data->name = name;
+	schema->format = data->format.c_str();
+	schema->name = data->name.c_str();
+	schema->metadata = nullptr;
+	schema->flags = flags;
+	schema->n_children = 0;
+	schema->children = nullptr;
+	schema->dictionary = nullptr;
+	schema->release = releaseSchema;
+	schema->private_data = data;
+	return data;
+}
+
+ArrowSchema* addChild(ArrowSchema* parent, const char* format,
+	std::string_view name, int64_t flags)
+{
+	SchemaData* parentData = static_cast<SchemaData*>(parent->private_data);
+	ArrowSchema* child = new ArrowSchema();
+	initSchema(child, format, name, flags);
+	parentData->children.push_back(child);
+	parent->n_children = static_cast<int64_t>(parentData->children.size());
+	parent->children = parentData->children.data();
+	return child;
+}
+
+/// Encodes key/value pairs in the format of ArrowSchema::metadata
+std::string encodeMetadata(
+	std::initializer_list<std::pair<std::string_view, std::string_view>> items)
+{
+	std::string s;
+	auto writeInt = [&s](int32_t v)
+	{
+		s.append(reinterpret_cast<const char*>(&v), sizeof(v));
+	};
+	writeInt(static_cast<int32_t>(items.size()));
+	for (const auto& [key, value] : items)
+	{
+		writeInt(static_cast<int32_t>(key.size()));
+		s.append(key);
+		writeInt(static_cast<int32_t>(value.size()));
+		s.append(value);
+	}
+	return s;
+}
+
+ArrayData* initArray(ArrowArray* array, int64_t length, int64_t bufferCount)
+{
+	ArrayData* data = new ArrayData();
+	array->length = length;
+	array->null_count = 0;
+	array->offset = 0;
+	array->n_buffers = bufferCount;
+	array->n_children = 0;
+	array->buffers = data->buffers;
+	array->children = nullptr;
+	array->dictionary = nullptr;
+	array->release = releaseArray;
+	array->private_data = data;
+	return data;
+}
+
+ArrayData* addChild(ArrowArray* parent, int64_t length, int64_t bufferCount)
+{
+	ArrayData* parentData = static_cast<ArrayData*>(parent->private_data);
+	ArrowArray* child = new ArrowArray();
+	ArrayData* data = initArray(child, length, bufferCount);
+	parentData->children.push_back(child);
+	parent->n_children = static_cast<int64_t>(parentData->children.size());
+	parent->children = parentData->children.data();
+	return data;
+}
+
+} // namespace
+
+
+ArrowExport::BatchBuilder::BatchBuilder(size_t tagCount) :
+	tags(tagCount),
+	geometries(64 * 1024),
+	geometryWriter(&geometries)
+{
+}
+
+
+ArrowExport::ArrowExport(std::vector<std::string> tagKeys, int64_t minBatchRows) :
+	tagKeys_(std::move(tagKeys)),
+	minBatchRows_(minBatchRows),
+	store_(nullptr),
+	workerCount_(0),
+	featureCount_(0)
+{
+}
+
+
+void ArrowExport::exportSchema(ArrowSchema* out) const
+{
+	SchemaData* data = initSchema(out, "+s", "", 0);
+	data->children.reserve(tagKeys_.size() + 3);
+	addChild(out, "l", "id", 0);
+	addChild(out, "c", "type", 0);
+	for (const std::string& key : tagKeys_)
+	{
+		ArrowSchema* col = addChild(out, "i", key, ARROW_FLAG_NULLABLE);
+		SchemaData* colData = static_cast<SchemaData*>(col->private_data);
+		colData->dictionary = new ArrowSchema();
+		initSchema(colData->dictionary, "u", "", 0);
+		col->dictionary = colData->dictionary;
+	}
+	ArrowSchema* geom = addChild(out, "z", "geometry", 0);
+	SchemaData* geomData = static_cast<SchemaData*>(geom->private_data);
+	geomData->metadata = encodeMetadata({
+		{ "ARROW:extension:name", "geoarrow.wkb" },
+		{ "ARROW:extension:metadata", "{}" } });
+	geom->metadata = geomData->metadata.data();
+}
+
+
+ArrowExport::Slot& ArrowExport::currentSlot()
+{
+	int worker = QueryExecutor::currentWorker();
+	return slots_[(worker >= 0 && worker < workerCount_) ? worker : workerCount_];
+}
+
+
+int32_t ArrowExport::dictionaryIndex(TagColumn& col, TagTablePtr tags,
+	TagBits value, StringTable& strings)
+{
+	int32_t next = static_cast<int32_t>(col.dictOffsets.size() - 1);
+	std::string_view str;
+	char buf[64];
+	switch (value & 3)
+	{
+	case 0:		// narrow number
+	{
+		char* end = Format::integer(buf, TagTablePtr::narrowNumber(value));
+		str = std::string_view(buf, end - buf);
+		break;
+	}
+	case 1:		// global string
+	{
+		auto [it, isNew] = col.globalStrings.try_emplace(
+			TagTablePtr::rawNarrowValue(value), next);
+		if (!isNew) return it->second;
+		str = TagTablePtr::globalString(value, strings)->toStringView();
+		col.dictData.append(str);
+		col.dictOffsets.push_back(static_cast<int32_t>(col.dictData.size()));
+		return next;
+	}
+	case 2:		// wide number
+	{
+		char* end = tags.wideNumber(value).format(buf);
+		str = std::string_view(buf, end - buf);
+		break;
+	}
+	default:	// local string
+		str = tags.localString(value)->toStringView();
+		break;
+	}
+	auto [it, isNew] = col.otherStrings.try_emplace(std::string(str), next);
+	if (!isNew) return it->second;
+	col.dictData.append(str);
+	col.dictOffsets.push_back(static_cast<int32_t>(col.dictData.size()));
+	return next;
+}
+
+
+void ArrowExport::addFeature(BatchBuilder& batch, FeatureStore* store, FeaturePtr feature)
+{
+	size_t row = batch.ids.size();
+	batch.ids.push_back(feature.id());
+	batch.types.push_back(static_cast<int8_t>(feature.typeCode()));
+
+	TagTablePtr tags = feature.tags();
+	StringTable& strings = store->strings();
+	for (size_t i = 0; i < keys_.size(); i++)
+	{
+		TagColumn& col = batch.tags[i];
+		if ((row & 7) == 0) col.validity.push_back(0);
+		TagBits value = tags.getKeyValue(keys_[i]);
+		if (value == 0)
+		{
+			col.indexes.push_back(0);
+			col.nullCount++;
+		}
+		else
+		{
+			col.indexes.push_back(dictionaryIndex(col, tags, value, strings));
+			col.validity.back() |= static_cast<uint8_t>(1 << (row & 7));
+		}
+	}
+
+	batch.geometryWriter.writeFeature(store, feature);
+	batch.geometryWriter.flush();
+	batch.geomOffsets.push_back(static_cast<int32_t>(batch.geometries.length()));
+}
+
+
+/**
+ * Turns the columns of a batch into a struct array (the vectors are
+ * moved, not copied). The BatchBuilder can't be used afterwards.
+ */
+ArrowArray* ArrowExport::finishBatch(BatchBuilder& batch)
+{
+	int64_t rows = static_cast<int64_t>(batch.ids.size());
+	ArrowArray* root = new ArrowArray();
+	ArrayData* rootData = initArray(root, rows, 1);
+	rootData->children.reserve(keys_.size() + 3);
+
+	ArrayData* ids = addChild(root, rows, 2);
+	ids->int64s = std::move(batch.ids);
+	ids->buffers[1] = ids->int64s.data();
+
+	ArrayData* types = addChild(root, rows, 2);
+	types->int8s = std::move(batch.types);
+	types->buffers[1] = types->int8s.data();
+
+	for (TagColumn& col : batch.tags)
+	{
+		ArrayData* indexes = addChild(root, rows, 2);
+		ArrowArray* colArray = root->children[root->n_children - 1];
+		indexes->int32s = std::move(col.indexes);
+		indexes->validity = std::move(col.validity);
+		indexes->buffers[0] = col.nullCount ? indexes->validity.data() : nullptr;
+		indexes->buffers[1] = indexes->int32s.data();
+		colArray->null_count = col.nullCount;
+
+		indexes->dictionary = new ArrowArray();
+		ArrayData* dict = initArray(indexes->dictionary,
+			static_cast<int64_t>(col.dictOffsets.size() - 1), 3);
+		dict->offsets = std::move(col.dictOffsets);
+		dict->chars = std::move(col.dictData);
+		dict->buffers[1] = dict->offsets.data();
+		dict->buffers[2] = dict->chars.data();
+		colArray->dictionary = indexes->dictionary;
+	}
+
+	ArrayData* geoms = addChild(root, rows, 3);
+	geoms->offsets = std::move(batch.geomOffsets);
+	geoms->bytes = batch.geometries.takeBytes();
+	geoms->buffers[1] = geoms->offsets.data();
+	geoms->buffers[2] = geoms->bytes.data();
+	return root;
+}
+
+
+/**
+ * Hands the slot's batch to the consumer (unless it is empty) and
+ * gives the slot a fresh one. Batches are finished outside of the
+ * lock, so only the consumer itself is serialized.
+ */
+void ArrowExport::emit(Slot& slot)
+{
+	size_t rows = slot.batch->ids.size();
+	if (rows == 0) return;
+	std::unique_ptr<BatchBuilder> batch = std::move(slot.batch);
+	slot.batch = std::make_unique<BatchBuilder>(keys_.size());
+	ArrowArray* array = finishBatch(*batch);
+	batch.reset();
+
+	std::lock_guard lock(outputMutex_);
+	featureCount_ += rows;
+	consumer_(array);
+	// If the consumer didn't move the batch, we release it
+	if (array->release) array->release(array);
+	delete array;
+}
+
+
+void ArrowExport::reduce(FeatureStore* store, const FeaturePtr* features, size_t count)
+{
+	BatchBuilder& batch = *currentSlot().batch;
+	for (size_t i = 0; i < count; i++)
+	{
+		addFeature(batch, store, features[i]);
+	}
+}
+
+
+void ArrowExport::endTile(uint64_t /* count */)
+{
+	Slot& slot = currentSlot();
+	if (static_cast<int64_t>(slot.batch->ids.size()) >= minBatchRows_ ||
+		slot.batch->geometries.length() >= MAX_GEOMETRY_BYTES)
+	{
+		emit(slot);
+	}
+}
+
+
+void ArrowExport::run(FeatureStore* store, const Box& bounds, FeatureTypes types,
+	const MatcherHolder* matcher, const Filter* filter, BatchConsumer consumer)
+{
+	store_ = store;
+	consumer_ = std::move(consumer);
+	featureCount_ = 0;
+	keys_.clear();
+	for (const std::string& key : tagKeys_) keys_.push_back(store->key(key));
+
+	workerCount_ = store->executor().threadCount();
+	slots_.reset(new Slot[workerCount_ + 1]);
+	for (int i = 0; i <= workerCount_; i++)
+	{
+		slots_[i].batch = std::make_unique<BatchBuilder>(keys_.size());
+	}
+
+	{
+		Query query(store, bounds, types, matcher, filter, this);
+		// Features that live in multiple tiles come back to this thread
+		for (;;)
+		{
+			FeaturePtr next = query.next();
+			if (next.isNull()) break;
+			Slot& slot = currentSlot();
+			addFeature(*slot.batch, store, next);
+			if (static_cast<int64_t>(slot.batch->ids.size()) >= minBatchRows_) emit(slot);
+		}
+	}
+
+	// All tiles are done; hand off the partial batches
+	for (int i = 0; i <= workerCount_; i++) emit(slots_[i]);
+	slots_.reset();
+	consumer_ = nullptr;
+}
+
+} // namespace geodesk
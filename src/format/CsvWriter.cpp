@@ -0,0 +1,181 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/CsvWriter.h>
+#include <algorithm>
+#include <clarisma/text/Format.h>
+#include <clarisma/util/ShortVarString.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/geom/Centroid.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+CsvWriter::CsvWriter(Buffer* buf, std::vector<Key> keys,
+	GeometryColumns geometry, char delimiter) :
+	WktWriter(buf),
+	keys_(std::move(keys)),
+	sortedKeys_(keys_),
+	geometry_(geometry),
+	delimiter_(delimiter)
+{
+	auto isBefore = [](const Key& a, const Key& b)
+	{
+		if ((a.code() < 0) != (b.code() < 0)) return a.code() >= 0;
+		if (a.code() >= 0) return a.code() < b.code();
+		return std::string_view(a) < std::string_view(b);
+	};
+	std::sort(sortedKeys_.begin(), sortedKeys_.end(), isBefore);
+	sortedKeys_.erase(std::unique(sortedKeys_.begin(), sortedKeys_.end(),
+		[](const Key& a, const Key& b)
+		{
+			return a.code() == b.code() && std::string_view(a) == std::string_view(b);
+		}), sortedKeys_.end());
+	for (const Key& key : keys_)
+	{
+		keyIndexes_.push_back(static_cast<uint32_t>(
+			std::lower_bound(sortedKeys_.begin(), sortedKeys_.end(), key, isBefore)
+				- sortedKeys_.begin()));
+	}
+	values_.resize(sortedKeys_.size());
+	quoteChar_ = 0;		// IDs are written without quotes
+	pretty_ = false;
+}
+
+
+void CsvWriter::writeField(std::string_view s)
+{
+	// Most values need no quotes, so we check first
+	const char* p = s.data();
+	const char* end = p + s.size();
+	for (; p < end; p++)
+	{
+		char ch = *p;
+		if (ch == delimiter_ || ch == '\"' || ch == '\n' || ch == '\r') break;
+	}
+	if (p == end)
+	{
+		writeBytes(s.data(), s.size());
+		return;
+	}
+
+	writeByte('\"');
+	const char* start = s.data();
+	for (p = start; p < end; p++)
+	{
+		if (*p == '\"')
+		{
+			writeBytes(start, p - start + 1);
+			start = p;		// the quote is written twice
+		}
+	}
+	writeBytes(start, end - start);
+	writeByte('\"');
+}
+
+
+void CsvWriter::writeHeader()
+{
+	writeConstString("id");
+	if (geometry_ == GeometryColumns::CENTROID)
+	{
+		writeByte(delimiter_);
+		writeConstString("lon");
+		writeByte(delimiter_);
+		writeConstString("lat");
+	}
+	else if (geometry_ == GeometryColumns::WKT)
+	{
+		writeByte(delimiter_);
+		writeConstString("geometry");
+	}
+	for (const Key& key : keys_)
+	{
+		writeByte(delimiter_);
+		writeField(key);
+	}
+	writeByte('\n');
+}
+
+
+void CsvWriter::writeGeometryFields(FeatureStore* store, FeaturePtr feature)
+{
+	if (geometry_ == GeometryColumns::CENTROID)
+	{
+		Coordinate c = feature.isNode() ? NodePtr(feature).xy() :
+			Centroid::ofFeature(store, feature);
+		writeByte(delimiter_);
+		formatScaled(scaledLon(c.x), precision_);
+		writeByte(delimiter_);
+		formatScaled(scaledLat(c.y), precision_);
+	}
+	else if (geometry_ == GeometryColumns::WKT)
+	{
+		// WKT contains commas and spaces, but no quotes or tabs
+		bool quoted = delimiter_ != '\t';
+		writeByte(delimiter_);
+		if (quoted) writeByte('\"');
+		writeFeatureGeometry(store, feature);
+		if (quoted) writeByte('\"');
+	}
+}
+
+
+void CsvWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
+{
+	writeId(store, feature);
+	writeGeometryFields(store, feature);
+
+	TagTablePtr tags = feature.tags();
+	StringTable& strings = store->strings();
+	tags.getKeyValues(sortedKeys_.data(), sortedKeys_.size(), values_.data());
+	char buf[64];
+	for (uint32_t index : keyIndexes_)
+	{
+		TagBits value = values_[index];
+		writeByte(delimiter_);
+		switch (value == 0 ? -1 : static_cast<int>(value & 3))
+		{
+		case -1:	// no tag
+			break;
+		case 0:		// narrow number
+			writeBytes(buf, Format::integer(buf, TagTablePtr::narrowNumber(value)) - buf);
+			break;
+		case 1:		// global string
+			writeField(TagTablePtr::globalString(value, strings)->toStringView());
+			break;
+		case 2:		// wide number
+			writeBytes(buf, tags.wideNumber(value).format(buf) - buf);
+			break;
+		default:	// local string
+			writeField(tags.localString(value)->toStringView());
+			break;
+		}
+	}
+	writeByte('\n');
+}
+
+
+void CsvWriter::writeAnonymousNodeNode(Coordinate point)
+{
+	// Anonymous nodes have no ID and no tags
+	if (geometry_ == GeometryColumns::CENTROID)
+	{
+		writeByte(delimiter_);
+		formatScaled(scaledLon(point.x), precision_);
+		writeByte(delimiter_);
+		formatScaled(scaledLat(point.y), precision_);
+	}
+	else if (geometry_ == GeometryColumns::WKT)
+	{
+		writeByte(delimiter_);
+		writeConstString("POINT(");
+		writeCoordinate(point);
+		writeByte(')');
+	}
+	for (size_t i = 0; i < keys_.size(); i++) writeByte(delimiter_);
+	writeByte('\n');
+}
+
+} // namespace geodesk
@@ -22,7 +22,16 @@ void FeatureWriter::writeTagValue(TagTablePtr tags, TagBits value, StringTable&
 		}
 		else
 		{
-			writeJsonEscapedString(tags.globalString(value, strings)->toStringView());
+			int code = static_cast<int>(TagTablePtr::rawNarrowValue(value));
+			std::string_view str = strings.getGlobalString(code)->toStringView();
+			if (strings.isJsonSafe(code))
+			{
+				writeBytes(str.data(), str.size());
+			}
+			else
+			{
+				writeJsonEscapedString(str);
+			}
 		}
 		writeByte('\"');
 	}
@@ -45,6 +54,7 @@ void FeatureWriter::writeTagValue(TagTablePtr tags, TagBits value, StringTable&
 
 void FeatureWriter::writeFeatureGeometry(FeatureStore* store, FeaturePtr feature)
 {
+	generalized_ = filter_.tolerance() > 0 ? store->generalizedGeometry() : nullptr;
 	if (feature.isWay())
 	{
 		writeWayGeometry(WayPtr(feature));
@@ -0,0 +1,884 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/FlatGeobufWriter.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <queue>
+#include <random>
+#include <thread>
+#include <clarisma/text/Format.h>
+#include <clarisma/util/BufferWriter.h>
+#include <clarisma/util/ShortVarString.h>
+#include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include <geodesk/query/Query.h>
+#include "geom/polygon/Ring.h"
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+static_assert(std::endian::native == std::endian::little,
+	"FlatBuffers are little-endian");
+
+enum GeometryType : uint8_t
+{
+	POINT = 1,
+	LINESTRING = 2,
+	POLYGON = 3,
+	MULTIPOLYGON = 6,
+	GEOMETRYCOLLECTION = 7
+};
+
+enum ColumnType : uint8_t
+{
+	BYTE = 0,
+	LONG = 7,
+	STRING = 11
+};
+
+/// Builds a size-prefixed FlatBuffer front to back, appending it to a
+/// vector: every table comes before the vectors and tables it refers
+/// to (so all uoffsets point forward), and is preceded by its vtable.
+/// Offset fields are written as placeholders, and patched once the
+/// object they refer to has been written. Positions are relative to
+/// the start of the buffer (its size prefix), which is also what
+/// alignment is relative to.
+///
+class FlatBufferBuilder
+{
+public:
+	struct Field
+	{
+		uint16_t id;
+		uint8_t size;		// 1, 2, 4 or 8 (offsets are 4)
+		uint64_t value;
+	};
+
+	explicit FlatBufferBuilder(std::vector<uint8_t>& buf) :
+		buf_(buf), base_(buf.size())
+	{
+		put<uint32_t>(0);		// size prefix
+		put<uint32_t>(0);		// offset of the root table
+	}
+
+	size_t pos() const { return buf_.size() - base_; }
+
+	void setRoot(size_t table) { patchOffset(4, table); }
+
+	/// Fills in the size prefix, and returns the size of the buffer
+	size_t finish()
+	{
+		set<uint32_t>(0, static_cast<uint32_t>(pos() - 4));
+		return pos();
+	}
+
+	void patchOffset(size_t at, size_t target)
+	{
+		assert(target > at);
+		set<uint32_t>(at, static_cast<uint32_t>(target - at));
+	}
+
+	/// Writes a table (and its vtable), storing the position of each
+	/// field in `fieldPos`; returns the position of the table
+	size_t table(const Field* fields, size_t count, size_t* fieldPos)
+	{
+		constexpr size_t MAX_FIELDS = 16;
+		assert(count <= MAX_FIELDS);
+		int maxId = -1;
+		size_t maxAlign = 4;
+		for (size_t i = 0; i < count; i++)
+		{
+			maxId = std::max(maxId, static_cast<int>(fields[i].id));
+			maxAlign = std::max(maxAlign, static_cast<size_t>(fields[i].size));
+		}
+
+		// Lay out the fields after the vtable offset, largest first,
+		// so each one is naturally aligned
+		uint16_t fieldOfs[MAX_FIELDS];
+		size_t tableSize = 4;
+		for (size_t size = 8; size > 0; size >>= 1)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				if (fields[i].size != size) continue;
+				tableSize = (tableSize + size - 1) & ~(size - 1);
+				fieldOfs[i] = static_cast<uint16_t>(tableSize);
+				tableSize += size;
+			}
+		}
+
+		pad(2);
+		size_t vtable = pos();
+		put<uint16_t>(static_cast<uint16_t>(4 + 2 * (maxId + 1)));
+		put<uint16_t>(static_cast<uint16_t>(tableSize));
+		for (int id = 0; id <= maxId; id++)
+		{
+			uint16_t ofs = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				if (fields[i].id == id) ofs = fieldOfs[i];
+			}
+			put<uint16_t>(ofs);
+		}
+
+		pad(maxAlign);
+		size_t table = pos();
+		put<int32_t>(static_cast<int32_t>(table - vtable));
+		buf_.resize(base_ + table + tableSize, 0);
+		for (size_t i = 0; i < count; i++)
+		{
+			// (little-endian, so the low bytes of the value come first)
+			memcpy(&buf_[base_ + table + fieldOfs[i]], &fields[i].value, fields[i].size);
+			fieldPos[i] = table + fieldOfs[i];
+		}
+		return table;
+	}
+
+	template<typename T>
+	size_t vector(const T* items, size_t count)
+	{
+		// The elements (which follow the length) must be aligned
+		constexpr size_t align = std::max(sizeof(T), size_t(4));
+		pad(4);
+		while ((pos() + 4) % align) put<uint32_t>(0);
+		size_t p = pos();
+		put<uint32_t>(static_cast<uint32_t>(count));
+		putBytes(items, count * sizeof(T));
+		return p;
+	}
+
+	/// Writes a vector of offsets (which must be patched by the caller),
+	/// and returns its position; item `i` is at `pos + 4 + i * 4`
+	size_t offsetVector(size_t count)
+	{
+		pad(4);
+		size_t p = pos();
+		put<uint32_t>(static_cast<uint32_t>(count));
+		buf_.resize(buf_.size() + count * 4, 0);
+		return p;
+	}
+
+	size_t string(std::string_view s)
+	{
+		pad(4);
+		size_t p = pos();
+		put<uint32_t>(static_cast<uint32_t>(s.size()));
+		putBytes(s.data(), s.size());
+		put<uint8_t>(0);
+		return p;
+	}
+
+private:
+	void pad(size_t alignment)
+	{
+		buf_.resize(base_ + ((pos() + alignment - 1) & ~(alignment - 1)), 0);
+	}
+
+	template<typename T>
+	void put(T v)
+	{
+		putBytes(&v, sizeof(T));
+	}
+
+	void putBytes(const void* p, size_t n)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(p);
+		buf_.insert(buf_.end(), bytes, bytes + n);
+	}
+
+	template<typename T>
+	void set(size_t at, T v)
+	{
+		memcpy(&buf_[base_ + at], &v, sizeof(T));
+	}
+
+	std::vector<uint8_t>& buf_;
+	size_t base_;
+};
+
+
+/// The geometry of a feature, before it is written as a FlatBuffer
+/// (a MultiPolygon or GeometryCollection has parts, all other types
+/// have coordinates; the rings of a Polygon end at the given points)
+struct Geometry
+{
+	void reset(GeometryType t)
+	{
+		type = t;
+		xy.clear();
+		ends.clear();
+		parts.clear();
+	}
+
+	GeometryType type = POINT;
+	std::vector<double> xy;
+	std::vector<uint32_t> ends;
+	std::vector<Geometry> parts;
+};
+
+void addPoints(Geometry& g, const Coordinate* coords, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		g.xy.push_back(Mercator::lonFromX(coords[i].x));
+		g.xy.push_back(Mercator::latFromY(coords[i].y));
+	}
+}
+
+void addWay(Geometry& g, WayPtr way)
+{
+	g.reset(way.isArea() ? POLYGON : LINESTRING);
+	WayCoordinateIterator iter(way);
+	g.xy.reserve(iter.coordinatesRemaining() * 2);
+	Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+	for (;;)
+	{
+		int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+		if (count == 0) break;
+		addPoints(g, coords, count);
+	}
+}
+
+void addRing(Geometry& g, const Polygonizer::Ring* ring)
+{
+	RingCoordinateIterator iter(ring);
+	while (iter.coordinatesRemaining())
+	{
+		Coordinate c = iter.next();
+		addPoints(g, &c, 1);
+	}
+	g.ends.push_back(static_cast<uint32_t>(g.xy.size() / 2));
+}
+
+void addPolygon(Geometry& g, const Polygonizer::Ring* outer)
+{
+	g.reset(POLYGON);
+	addRing(g, outer);
+	for (const Polygonizer::Ring* inner = outer->firstInner(); inner; inner = inner->next())
+	{
+		addRing(g, inner);
+	}
+	if (g.ends.size() == 1) g.ends.clear();		// (implied for a single ring)
+}
+
+void addAreaRelation(Geometry& g, FeatureStore* store, RelationPtr relation)
+{
+	RingCache::RingsRef rings = RingCache::polygonize(store, relation);
+	const Polygonizer::Ring* first = rings->outerRings();
+	if (!first)
+	{
+		g.reset(POLYGON);
+		return;
+	}
+	if (!first->next())
+	{
+		addPolygon(g, first);
+		return;
+	}
+	g.reset(MULTIPOLYGON);
+	for (const Polygonizer::Ring* ring = first; ring; ring = ring->next())
+	{
+		addPolygon(g.parts.emplace_back(), ring);
+	}
+}
+
+void addCollection(Geometry& g, FeatureStore* store, RelationPtr relation,
+	RecursionGuard& guard)
+{
+	g.reset(GEOMETRYCOLLECTION);
+	FastMemberIterator iter(store, relation);
+	for (;;)
+	{
+		FeaturePtr member = iter.next();
+		if (member.isNull()) break;
+		if (member.isWay())
+		{
+			WayPtr memberWay(member);
+			if (memberWay.isPlaceholder()) continue;
+			addWay(g.parts.emplace_back(), memberWay);
+		}
+		else if (member.isNode())
+		{
+			NodePtr memberNode(member);
+			if (memberNode.isPlaceholder()) continue;
+			Geometry& part = g.parts.emplace_back();
+			part.reset(POINT);
+			Coordinate c = memberNode.xy();
+			addPoints(part, &c, 1);
+		}
+		else
+		{
+			RelationPtr childRel(member);
+			if (childRel.isPlaceholder() || !guard.checkAndAdd(childRel)) continue;
+			if (childRel.isArea())
+			{
+				addAreaRelation(g.parts.emplace_back(), store, childRel);
+			}
+			else
+			{
+				addCollection(g.parts.emplace_back(), store, childRel, guard);
+			}
+		}
+	}
+}
+
+void addFeatureGeometry(Geometry& g, FeatureStore* store, FeaturePtr feature)
+{
+	if (feature.isNode())
+	{
+		g.reset(POINT);
+		Coordinate c = NodePtr(feature).xy();
+		addPoints(g, &c, 1);
+	}
+	else if (feature.isWay())
+	{
+		addWay(g, WayPtr(feature));
+	}
+	else
+	{
+		RelationPtr relation(feature);
+		if (relation.isArea())
+		{
+			addAreaRelation(g, store, relation);
+		}
+		else
+		{
+			RecursionGuard guard(relation);
+			addCollection(g, store, relation, guard);
+		}
+	}
+}
+
+/// Writes a Geometry table (and its parts), returning its position
+size_t writeGeometry(FlatBufferBuilder& fb, const Geometry& g)
+{
+	FlatBufferBuilder::Field fields[4];
+	size_t fieldPos[4];
+	size_t count = 0;
+	if (!g.ends.empty()) fields[count++] = { 0, 4, 0 };
+	if (!g.xy.empty()) fields[count++] = { 1, 4, 0 };
+	fields[count++] = { 6, 1, g.type };
+	if (!g.parts.empty()) fields[count++] = { 7, 4, 0 };
+	size_t table = fb.table(fields, count, fieldPos);
+
+	size_t n = 0;
+	if (!g.ends.empty())
+	{
+		fb.patchOffset(fieldPos[n++], fb.vector(g.ends.data(), g.ends.size()));
+	}
+	if (!g.xy.empty())
+	{
+		fb.patchOffset(fieldPos[n++], fb.vector(g.xy.data(), g.xy.size()));
+	}
+	n++;	// type
+	if (!g.parts.empty())
+	{
+		size_t parts = fb.offsetVector(g.parts.size());
+		fb.patchOffset(fieldPos[n], parts);
+		for (size_t i = 0; i < g.parts.size(); i++)
+		{
+			fb.patchOffset(parts + 4 + i * 4, writeGeometry(fb, g.parts[i]));
+		}
+	}
+	return table;
+}
+
+/// A node of the packed R-tree, as stored in the file
+struct NodeItem
+{
+	double minX;
+	double minY;
+	double maxX;
+	double maxY;
+	uint64_t offset;	// leaf: offset of the feature; else: index of first child
+};
+
+static_assert(sizeof(NodeItem) == 40);
+
+/// Reads the features of a spilled run, which lie back to back in
+/// the temporary file
+class RunReader
+{
+public:
+	const uint8_t* read(File& file, uint64_t ofs, uint32_t size, size_t bufferSize)
+	{
+		if (ofs < bufStart_ || ofs + size > bufStart_ + bufLen_)
+		{
+			buf_.resize(std::max(bufferSize, static_cast<size_t>(size)));
+			size_t len = 0;
+			while (len < size)
+			{
+				size_t n = file.read(ofs + len, buf_.data() + len, buf_.size() - len);
+				if (n == 0) throw IOException("Unexpected end of temporary file");
+				len += n;
+			}
+			bufStart_ = ofs;
+			bufLen_ = len;
+		}
+		return buf_.data() + (ofs - bufStart_);
+	}
+
+private:
+	std::vector<uint8_t> buf_;
+	uint64_t bufStart_ = 0;
+	size_t bufLen_ = 0;
+};
+
+void writeFully(File& file, const uint8_t* p, size_t len)
+{
+	while (len)
+	{
+		size_t n = file.write(p, len);
+		p += n;
+		len -= n;
+	}
+}
+
+} // namespace
+
+
+struct alignas(64) FlatGeobufWriter::Slot      // (padded to avoid false sharing)
+{
+	std::vector<Entry> entries;
+	std::vector<uint8_t> data;
+	Geometry geometry;
+	std::vector<uint8_t> properties;
+};
+
+
+FlatGeobufWriter::FlatGeobufWriter(std::vector<std::string> tagKeys) :
+	tagKeys_(std::move(tagKeys)),
+	indexNodeSize_(DEFAULT_INDEX_NODE_SIZE),
+	maxMemory_(DEFAULT_MAX_MEMORY),
+	maxSlotBytes_(0),
+	workerCount_(0),
+	spillSize_(0),
+	featureCount_(0)
+{
+}
+
+
+FlatGeobufWriter::~FlatGeobufWriter()
+{
+	cleanup();
+}
+
+
+FlatGeobufWriter::Slot& FlatGeobufWriter::currentSlot()
+{
+	int worker = QueryExecutor::currentWorker();
+	return slots_[(worker >= 0 && worker < workerCount_) ? worker : workerCount_];
+}
+
+
+std::string_view FlatGeobufWriter::tagText(TagTablePtr tags, TagBits value,
+	StringTable& strings, char* buf)
+{
+	switch (value & 3)
+	{
+	case 0:		// narrow number
+		return std::string_view(buf,
+			Format::integer(buf, TagTablePtr::narrowNumber(value)) - buf);
+	case 1:		// global string
+		return TagTablePtr::globalString(value, strings)->toStringView();
+	case 2:		// wide number
+		return std::string_view(buf, tags.wideNumber(value).format(buf) - buf);
+	default:	// local string
+		return tags.localString(value)->toStringView();
+	}
+}
+
+
+void FlatGeobufWriter::addFeature(Slot& slot, FeatureStore* store, FeaturePtr feature)
+{
+	Box bounds = feature.isNode() ? NodePtr(feature).bounds() : feature.bounds();
+	Coordinate center(
+		static_cast<int32_t>(std::clamp(
+			(static_cast<int64_t>(bounds.minX()) + bounds.maxX()) / 2,
+			static_cast<int64_t>(bounds_.minX()), static_cast<int64_t>(bounds_.maxX()))),
+		static_cast<int32_t>(std::clamp(
+			(static_cast<int64_t>(bounds.minY()) + bounds.maxY()) / 2,
+			static_cast<int64_t>(bounds_.minY()), static_cast<int64_t>(bounds_.maxY()))));
+
+	Entry& entry = slot.entries.emplace_back();
+	entry.offset = slot.data.size();
+	entry.minX = Mercator::lonFromX(bounds.minX());
+	entry.minY = Mercator::latFromY(bounds.minY());
+	entry.maxX = Mercator::lonFromX(bounds.maxX());
+	entry.maxY = Mercator::latFromY(bounds.maxY());
+	entry.hilbert = hilbert::calculateHilbertDistance(center, bounds_);
+
+	// Properties: the index of the column, followed by its value
+	std::vector<uint8_t>& props = slot.properties;
+	props.clear();
+	auto putProperty = [&props](uint16_t column, const void* p, size_t len)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(p);
+		props.insert(props.end(), reinterpret_cast<const uint8_t*>(&column),
+			reinterpret_cast<const uint8_t*>(&column) + 2);
+		props.insert(props.end(), bytes, bytes + len);
+	};
+	int64_t id = static_cast<int64_t>(feature.id());
+	putProperty(0, &id, sizeof(id));
+	int8_t type = static_cast<int8_t>(feature.typeCode());
+	putProperty(1, &type, sizeof(type));
+	TagTablePtr tags = feature.tags();
+	StringTable& strings = store->strings();
+	char buf[64];
+	for (size_t i = 0; i < keys_.size(); i++)
+	{
+		TagBits value = tags.getKeyValue(keys_[i]);
+		if (value == 0) continue;
+		std::string_view text = tagText(tags, value, strings, buf);
+		uint32_t len = static_cast<uint32_t>(text.size());
+		putProperty(static_cast<uint16_t>(i + 2), &len, sizeof(len));
+		props.insert(props.end(), text.begin(), text.end());
+	}
+
+	addFeatureGeometry(slot.geometry, store, feature);
+
+	FlatBufferBuilder fb(slot.data);
+	FlatBufferBuilder::Field fields[2] = { { 0, 4, 0 }, { 1, 4, 0 } };
+	size_t fieldPos[2];
+	fb.setRoot(fb.table(fields, 2, fieldPos));
+	fb.patchOffset(fieldPos[0], writeGeometry(fb, slot.geometry));
+	fb.patchOffset(fieldPos[1], fb.vector(props.data(), props.size()));
+	entry.size = static_cast<uint32_t>(fb.finish());
+}
+
+
+void FlatGeobufWriter::sortEntries(std::vector<Entry>& entries)
+{
+	std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b)
+	{
+		return a.hilbert < b.hilbert ||
+			(a.hilbert == b.hilbert && a.offset < b.offset);
+	});
+}
+
+
+/**
+ * Sorts the slot's features (on the calling worker thread) and
+ * appends them to the temporary file as a new run.
+ */
+void FlatGeobufWriter::spill(Slot& slot)
+{
+	constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+	sortEntries(slot.entries);
+	Run run;
+	run.entries = std::move(slot.entries);
+	std::vector<uint8_t> chunk;
+	chunk.reserve(CHUNK_SIZE);
+
+	std::lock_guard lock(spillMutex_);
+	if (!spillFile_.isOpen())
+	{
+		std::filesystem::path dir = tempDir_.empty() ?
+			std::filesystem::temp_directory_path() : tempDir_;
+		spillPath_ = dir / ("geodesk-fgb-" + std::to_string(std::random_device()()) + ".tmp");
+		spillFile_.open(spillPath_,
+			File::READ | File::WRITE | File::CREATE | File::REPLACE_EXISTING);
+	}
+	uint64_t pos = spillSize_;
+	for (Entry& entry : run.entries)
+	{
+		if (chunk.size() + entry.size > CHUNK_SIZE && !chunk.empty())
+		{
+			writeFully(spillFile_, chunk.data(), chunk.size());
+			chunk.clear();
+		}
+		const uint8_t* p = slot.data.data() + entry.offset;
+		chunk.insert(chunk.end(), p, p + entry.size);
+		entry.offset = pos;
+		pos += entry.size;
+	}
+	writeFully(spillFile_, chunk.data(), chunk.size());
+	spillSize_ = pos;
+	runs_.push_back(std::move(run));
+	slot.entries.clear();
+	slot.data.clear();
+}
+
+
+void FlatGeobufWriter::reduce(FeatureStore* store, const FeaturePtr* features, size_t count)
+{
+	Slot& slot = currentSlot();
+	for (size_t i = 0; i < count; i++)
+	{
+		addFeature(slot, store, features[i]);
+	}
+}
+
+
+void FlatGeobufWriter::endTile(uint64_t /* count */)
+{
+	Slot& slot = currentSlot();
+	if (slot.data.size() >= maxSlotBytes_) spill(slot);
+}
+
+
+void FlatGeobufWriter::writeHeader(Buffer* out, const double* envelope, uint64_t count) const
+{
+	static constexpr uint8_t MAGIC[8] = { 'f', 'g', 'b', 3, 'f', 'g', 'b', 0 };
+
+	std::vector<uint8_t> buf;
+	FlatBufferBuilder fb(buf);
+	FlatBufferBuilder::Field fields[6];
+	size_t fieldPos[6];
+	size_t n = 0;
+	if (!layerName_.empty()) fields[n++] = { 0, 4, 0 };			// name
+	if (count) fields[n++] = { 1, 4, 0 };						// envelope
+	fields[n++] = { 7, 4, 0 };									// columns
+	fields[n++] = { 8, 8, count };								// features_count
+	fields[n++] = { 9, 2, static_cast<uint64_t>(count ? indexNodeSize_ : 0) };
+	fields[n++] = { 10, 4, 0 };									// crs
+	fb.setRoot(fb.table(fields, n, fieldPos));
+
+	size_t i = 0;
+	if (!layerName_.empty()) fb.patchOffset(fieldPos[i++], fb.string(layerName_));
+	if (count) fb.patchOffset(fieldPos[i++], fb.vector(envelope, 4));
+
+	size_t columnCount = keys_.size() + 2;
+	size_t columns = fb.offsetVector(columnCount);
+	fb.patchOffset(fieldPos[i++], columns);
+	for (size_t col = 0; col < columnCount; col++)
+	{
+		std::string_view name;
+		FlatBufferBuilder::Field colFields[3];
+		size_t colFieldPos[3];
+		size_t colFieldCount;
+		if (col < 2)
+		{
+			name = col == 0 ? "id" : "type";
+			colFields[0] = { 0, 4, 0 };
+			colFields[1] = { 1, 1, static_cast<uint64_t>(col == 0 ? LONG : BYTE) };
+			colFields[2] = { 7, 1, 0 };			// not nullable
+			colFieldCount = 3;
+		}
+		else
+		{
+			name = tagKeys_[col - 2];
+			colFields[0] = { 0, 4, 0 };
+			colFields[1] = { 1, 1, STRING };
+			colFieldCount = 2;
+		}
+		size_t column = fb.table(colFields, colFieldCount, colFieldPos);
+		fb.patchOffset(columns + 4 + col * 4, column);
+		fb.patchOffset(colFieldPos[0], fb.string(name));
+	}
+	i += 2;		// features_count, index_node_size
+
+	FlatBufferBuilder::Field crsFields[2] = { { 0, 4, 0 }, { 1, 4, 4326 } };
+	size_t crsFieldPos[2];
+	size_t crs = fb.table(crsFields, 2, crsFieldPos);
+	fb.patchOffset(fieldPos[i], crs);
+	fb.patchOffset(crsFieldPos[0], fb.string("EPSG"));
+	fb.finish();
+
+	BufferWriter writer(out);
+	writer.writeBytes(MAGIC, sizeof(MAGIC));
+	writer.writeBytes(buf.data(), buf.size());
+	writer.flush();
+}
+
+
+/**
+ * Merges the runs (by Hilbert distance, ties broken by run), then
+ * writes the header, the index and the features in merged order.
+ */
+void FlatGeobufWriter::writeOutput(Buffer* out)
+{
+	size_t count = 0;
+	for (const Run& run : runs_) count += run.entries.size();
+
+	using Head = std::pair<uint32_t, uint32_t>;		// hilbert, run
+	std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+	std::vector<size_t> next(runs_.size(), 0);
+	for (uint32_t r = 0; r < runs_.size(); r++)
+	{
+		if (!runs_[r].entries.empty()) heads.emplace(runs_[r].entries[0].hilbert, r);
+	}
+	std::vector<uint32_t> order;
+	order.reserve(count);
+	while (!heads.empty())
+	{
+		uint32_t r = heads.top().second;
+		heads.pop();
+		order.push_back(r);
+		const std::vector<Entry>& entries = runs_[r].entries;
+		if (++next[r] < entries.size()) heads.emplace(entries[next[r]].hilbert, r);
+	}
+
+	// The levels of the tree, leaves first; the root is stored first
+	std::vector<std::pair<size_t, size_t>> levels;
+	std::vector<NodeItem> nodes;
+	if (count && indexNodeSize_ > 0)
+	{
+		std::vector<size_t> levelSizes;
+		size_t n = count;
+		size_t nodeCount = n;
+		levelSizes.push_back(n);
+		do
+		{
+			n = (n + indexNodeSize_ - 1) / indexNodeSize_;
+			nodeCount += n;
+			levelSizes.push_back(n);
+		}
+		while (n != 1);
+		size_t end = nodeCount;
+		for (size_t size : levelSizes)
+		{
+			levels.emplace_back(end - size, end);
+			end -= size;
+		}
+		nodes.resize(nodeCount);
+	}
+
+	double envelope[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+	std::fill(next.begin(), next.end(), 0);
+	uint64_t featureOfs = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t r = order[i];
+		const Entry& e = runs_[r].entries[next[r]++];
+		envelope[0] = std::min(envelope[0], e.minX);
+		envelope[1] = std::min(envelope[1], e.minY);
+		envelope[2] = std::max(envelope[2], e.maxX);
+		envelope[3] = std::max(envelope[3], e.maxY);
+		if (!nodes.empty())
+		{
+			nodes[levels[0].first + i] = { e.minX, e.minY, e.maxX, e.maxY, featureOfs };
+		}
+		featureOfs += e.size;
+	}
+
+	for (size_t level = 0; level + 1 < levels.size(); level++)
+	{
+		size_t child = levels[level].first;
+		size_t end = levels[level].second;
+		size_t parent = levels[level + 1].first;
+		while (child < end)
+		{
+			NodeItem node = { INFINITY, INFINITY, -INFINITY, -INFINITY, child };
+			for (int j = 0; j < indexNodeSize_ && child < end; j++, child++)
+			{
+				node.minX = std::min(node.minX, nodes[child].minX);
+				node.minY = std::min(node.minY, nodes[child].minY);
+				node.maxX = std::max(node.maxX, nodes[child].maxX);
+				node.maxY = std::max(node.maxY, nodes[child].maxY);
+			}
+			nodes[parent++] = node;
+		}
+	}
+
+	writeHeader(out, envelope, count);
+	BufferWriter writer(out);
+	writer.writeBytes(nodes.data(), nodes.size() * sizeof(NodeItem));
+	std::vector<NodeItem>().swap(nodes);
+
+	size_t spilledRuns = 0;
+	for (const Run& run : runs_) spilledRuns += run.data.empty() ? 1 : 0;
+	size_t readBufferSize = spilledRuns ? std::clamp(maxMemory_ / spilledRuns,
+		size_t(64 * 1024), size_t(1024 * 1024)) : 0;
+	std::vector<RunReader> readers(runs_.size());
+
+	std::fill(next.begin(), next.end(), 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t r = order[i];
+		Run& run = runs_[r];
+		const Entry& e = run.entries[next[r]++];
+		const uint8_t* p = run.data.empty() ?
+			readers[r].read(spillFile_, e.offset, e.size, readBufferSize) :
+			run.data.data() + e.offset;
+		writer.writeBytes(p, e.size);
+	}
+	writer.flush();
+	featureCount_ = count;
+}
+
+
+void FlatGeobufWriter::cleanup()
+{
+	slots_.reset();
+	runs_.clear();
+	if (spillFile_.isOpen())
+	{
+		spillFile_.close();
+		File::remove(spillPath_.string().c_str());
+	}
+	spillSize_ = 0;
+}
+
+
+void FlatGeobufWriter::write(FeatureStore* store, const Box& bounds, FeatureTypes types,
+	const MatcherHolder* matcher, const Filter* filter, Buffer* out)
+{
+	featureCount_ = 0;
+	keys_.clear();
+	for (const std::string& key : tagKeys_) keys_.push_back(store->key(key));
+	// The Hilbert distances are relative to the query bounds
+	bounds_ = (bounds.widthSimple() > 0 && bounds.height() > 0) ? bounds : Box::ofWorld();
+
+	workerCount_ = store->executor().threadCount();
+	slots_.reset(new Slot[workerCount_ + 1]);
+	maxSlotBytes_ = std::max(maxMemory_ / (workerCount_ + 1), size_t(1024 * 1024));
+
+	try
+	{
+		{
+			Query query(store, bounds, types, matcher, filter, this);
+			// Features that live in multiple tiles come back to this thread
+			for (;;)
+			{
+				FeaturePtr next = query.next();
+				if (next.isNull()) break;
+				Slot& slot = currentSlot();
+				addFeature(slot, store, next);
+				if (slot.data.size() >= maxSlotBytes_) spill(slot);
+			}
+		}
+
+		// What remains in the slots becomes in-memory runs, which
+		// we sort in parallel
+		std::vector<std::thread> threads;
+		for (int i = 0; i <= workerCount_; i++)
+		{
+			Slot& slot = slots_[i];
+			if (slot.entries.empty()) continue;
+			threads.emplace_back([&slot]() { sortEntries(slot.entries); });
+		}
+		for (std::thread& thread : threads) thread.join();
+		for (int i = 0; i <= workerCount_; i++)
+		{
+			Slot& slot = slots_[i];
+			if (slot.entries.empty()) continue;
+			Run& run = runs_.emplace_back();
+			run.entries = std::move(slot.entries);
+			run.data = std::move(slot.data);
+		}
+		slots_.reset();
+
+		writeOutput(out);
+	}
+	catch (...)
+	{
+		cleanup();
+		throw;
+	}
+	cleanup();
+}
+
+} // namespace geodesk
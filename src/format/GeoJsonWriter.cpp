@@ -4,7 +4,7 @@
 #include <geodesk/format/GeoJsonWriter.h>
 #include <geodesk/version.h>
 #include <geodesk/feature/FeatureStore.h>
-#include <geodesk/geom/polygon/Polygonizer.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include "geom/polygon/Ring.h"
 
 using namespace clarisma;
@@ -165,10 +165,8 @@ void GeoJsonWriter::writeWayGeometry(WayPtr way)
 
 void GeoJsonWriter::writeAreaRelationGeometry(FeatureStore* store, RelationPtr relation)
 {
-	Polygonizer polygonizer;
-	polygonizer.createRings(store, relation);
-	polygonizer.assignAndMergeHoles();
-	const Polygonizer::Ring* ring = polygonizer.outerRings();
+	RingCache::RingsRef rings = areaRings(store, relation);
+	const Polygonizer::Ring* ring = rings->outerRings();
 	int count = ring ? (ring->next() ? 2 : 1) : 0;
 	if (count > 1)
 	{
@@ -198,7 +196,7 @@ void GeoJsonWriter::writeAreaRelationGeometry(FeatureStore* store, RelationPtr r
 	}
 	else
 	{
-		writePolygonizedCoordinates(polygonizer);
+		writePolygonizedCoordinates(*rings);
 	}
 	writeByte('}');
 }
@@ -226,7 +224,7 @@ void GeoJsonWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
 	TagIterator tagIter(feature.tags(), store->strings());
 	if (pretty_)
 	{
-		if (!firstFeature_) writeConstString(",\n");
+		if (!firstFeature_) writeString(featureSeparator());
 		writeConstString(
 			"\t\t{\n"
 			"\t\t\t\"type\": \"Feature\",\n"
@@ -245,7 +243,14 @@ void GeoJsonWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
 	}
 	else
 	{
-		if (!firstFeature_) writeByte(linewise_ ? '\n' : ',');
+		if (sequence_)
+		{
+			writeByte(RECORD_SEPARATOR);
+		}
+		else if (!firstFeature_)
+		{
+			writeString(featureSeparator());
+		}
 		writeConstString("{\"type\":\"Feature\",\"id\":");
 		writeId(store, feature);
 		// TODO: bbox?
@@ -254,6 +259,7 @@ void GeoJsonWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
 		writeConstString(",\"properties\":");
 		writeTags(tagIter);
 		writeByte('}');
+		if (sequence_) writeByte('\n');
 	}
 	firstFeature_ = false;
 }
@@ -262,7 +268,7 @@ void GeoJsonWriter::writeAnonymousNodeNode(Coordinate point)
 {
 	if (pretty_)
 	{
-		if (!firstFeature_) writeConstString(",\n");
+		if (!firstFeature_) writeString(featureSeparator());
 		writeConstString(
 			"\t\t{\n"
 			"\t\t\t\"type\": \"Feature\",\n\t\t\t"
@@ -274,12 +280,73 @@ void GeoJsonWriter::writeAnonymousNodeNode(Coordinate point)
 	}
 	else
 	{
-		if (!firstFeature_) writeByte(',');
+		if (sequence_)
+		{
+			writeByte(RECORD_SEPARATOR);
+		}
+		else if (!firstFeature_)
+		{
+			writeString(featureSeparator());
+		}
 		writeConstString(
 			"{\"type\":\"Feature\",\"geometry\":"
 			"{\"type\":\"Point\",\"coordinates\":");
 		writeCoordinate(point);
 		writeConstString("}}");
+		if (sequence_) writeByte('\n');
+	}
+	firstFeature_ = false;
+}
+
+
+void GeoJsonWriter::writeAnonymousLine(std::span<const Coordinate> coords,
+	std::string_view key, std::string_view value)
+{
+	if (pretty_)
+	{
+		if (!firstFeature_) writeString(featureSeparator());
+		writeConstString(
+			"\t\t{\n"
+			"\t\t\t\"type\": \"Feature\",\n"
+			"\t\t\t\"geometry\": "
+			"{ \"type\": \"LineString\", \"coordinates\": ");
+		writeLineCoordinates(coords);
+		writeConstString("},\n\t\t\t\"properties\": {");
+		if (!key.empty())
+		{
+			writeConstString("\n\t\t\t\t\"");
+			writeJsonEscapedString(key);
+			writeConstString("\": \"");
+			writeJsonEscapedString(value);
+			writeConstString("\"\n\t\t\t");
+		}
+		writeConstString("}\n\t\t}");
+	}
+	else
+	{
+		if (sequence_)
+		{
+			writeByte(RECORD_SEPARATOR);
+		}
+		else if (!firstFeature_)
+		{
+			writeString(featureSeparator());
+		}
+		writeConstString(
+			"{\"type\":\"Feature\",\"geometry\":"
+			"{\"type\":\"LineString\",\"coordinates\":");
+		writeLineCoordinates(coords);
+		writeConstString("},\"properties\":{");
+		if (!key.empty())
+		{
+			writeByte('\"');
+			writeJsonEscapedString(key);
+			writeConstString("\":\"");
+			writeJsonEscapedString(value);
+			writeByte('\"');
+		}
+		writeConstString("}}");
+		if (sequence_) writeByte('\n');
 	}
 	firstFeature_ = false;
 }
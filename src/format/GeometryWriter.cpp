@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/format/GeometryWriter.h>
+#include <algorithm>
+#include <geodesk/geom/GeneralizedGeometry.h>
 #include <geodesk/geom/polygon/Polygonizer.h>
 #include "geom/polygon/Ring.h"
 #include "geom/polygon/RingCoordinateIterator.h"
@@ -10,28 +12,41 @@
 
 namespace geodesk {
 
-void GeometryWriter::writeCoordinate(Coordinate c)
+void GeometryWriter::writeCoordinateBlock(bool isFirst, const Coordinate* coords, size_t count)
 {
-	if (coordStartChar_) writeByte(coordStartChar_);
-	double lon = Mercator::lonFromX(c.x);
-	double lat = Mercator::latFromY(c.y);
-	formatDouble(latitudeFirst_ ? lat : lon, precision_);
-	writeByte(coordValueSeparatorChar_);
-	formatDouble(latitudeFirst_ ? lon : lat, precision_);
-	if (coordEndChar_) writeByte(coordEndChar_);
+	constexpr size_t BLOCK_SIZE = 64;
+	int64_t lons[BLOCK_SIZE];
+	int64_t lats[BLOCK_SIZE];
+	double scale = clarisma::Math::POWERS_OF_10[precision_];
+	while (count)
+	{
+		size_t n = std::min(count, BLOCK_SIZE);
+		// Longitude is a linear function of X, so this loop
+		// has no dependencies and no calls
+		for (size_t i = 0; i < n; i++)
+		{
+			lons[i] = static_cast<int64_t>(std::round(
+				Mercator::lonFromX(coords[i].x) * scale));
+		}
+		for (size_t i = 0; i < n; i++)
+		{
+			lats[i] = scaledLat(coords[i].y);
+		}
+		for (size_t i = 0; i < n; i++)
+		{
+			if (!isFirst) writeByte(',');  // TODO: always comma for all formats?
+			isFirst = false;
+			writeScaledCoordinate(lons[i], lats[i]);
+		}
+		coords += n;
+		count -= n;
+	}
 }
 
 
 void GeometryWriter::writeCoordinateSegment(bool isFirst, const Coordinate* p, size_t count)
 {
-	const Coordinate* end;
-	end = p + count;
-	while (p < end)
-	{
-		if (!isFirst) writeByte(',');  // TODO: always comma for all formats?
-		isFirst = false;
-		writeCoordinate(*p++);
-	}
+	writeCoordinateBlock(isFirst, p, count);
 }
 
 #ifdef GEODESK_WITH_GEOS
@@ -122,26 +137,124 @@ void GeometryWriter::writeGeometryCoordinates(
 #endif
 
 
-void GeometryWriter::writeWayCoordinates(WayPtr way, bool group)
+void GeometryWriter::applyFilter(std::vector<Coordinate>& coords,
+    bool isRing, double presimplified)
+{
+    double tolerance = filter_.tolerance();
+    filter_.simplify(tolerance - presimplified);
+    filter_.apply(coords, isRing);
+    filter_.simplify(tolerance);
+}
+
+
+const std::vector<Coordinate>& GeometryWriter::filteredCoordinates(WayPtr way)
 {
+    int level = generalized_ ? GeneralizedGeometry::levelFor(filter_.tolerance()) : -1;
+    if (level >= 0 && generalized_->wayCoordinates(way, level, filtered_))
+    {
+        applyFilter(filtered_, way.isArea(), GeneralizedGeometry::levelTolerance(level));
+        return filtered_;
+    }
     WayCoordinateIterator iter(way);
+    filtered_.resize(iter.coordinatesRemaining());
+    iter.decodeAll(filtered_.data());
+    filter_.apply(filtered_, way.isArea());
+    return filtered_;
+}
+
+
+const std::vector<Coordinate>& GeometryWriter::filteredCoordinates(const Polygonizer::Ring* ring)
+{
+    RingCoordinateIterator iter(ring);
+    filtered_.clear();
+    for (int count = iter.coordinatesRemaining(); count > 0; count--)
+    {
+        filtered_.push_back(iter.next());
+    }
+    applyFilter(filtered_, true, presimplified_);
+    return filtered_;
+}
+
+
+std::span<const Coordinate> GeometryWriter::filteredCoordinates(
+    std::span<const Coordinate> coords)
+{
+    if (!filter_.isActive()) return coords;
+    filtered_.assign(coords.begin(), coords.end());
+    filter_.apply(filtered_, false);
+    return filtered_;
+}
+
+
+void GeometryWriter::writeLineCoordinates(std::span<const Coordinate> coords)
+{
+    coords = filteredCoordinates(coords);
+    writeByte(coordGroupStartChar_);
+    writeCoordinateBlock(true, coords.data(), coords.size());
+    writeByte(coordGroupEndChar_);
+}
+
+
+void GeometryWriter::writeWayCoordinates(WayPtr way, bool group)
+{
     // TODO: Leaflet doesn't need duplicate end coordinate for polygons
-    bool isFirst = true;
     if(group) writeByte(coordGroupStartChar_);
     writeByte(coordGroupStartChar_);
-    for (;;)
+    if (filter_.isActive())
     {
-        Coordinate c = iter.next();
-        if (c.isNull()) break;
-        if (!isFirst) writeByte(',');  // TODO: always comma for all formats?
-        isFirst = false;
-        writeCoordinate(c);
+        const std::vector<Coordinate>& coords = filteredCoordinates(way);
+        writeCoordinateBlock(true, coords.data(), coords.size());
+    }
+    else
+    {
+        WayCoordinateIterator iter(way);
+        bool isFirst = true;
+        Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+        for (;;)
+        {
+            int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+            if (count == 0) break;
+            writeCoordinateBlock(isFirst, coords, count);
+            isFirst = false;
+        }
     }
     writeByte(coordGroupEndChar_);
     if (group) writeByte(coordGroupEndChar_);
 }
 
 
+void GeometryWriter::writeRingCoordinates(const Polygonizer::Ring* ring)
+{
+    if (filter_.isActive())
+    {
+        const std::vector<Coordinate>& coords = filteredCoordinates(ring);
+        writeByte(coordGroupStartChar_);
+        writeCoordinateBlock(true, coords.data(), coords.size());
+        writeByte(coordGroupEndChar_);
+        return;
+    }
+    RingCoordinateIterator iter(ring);
+    writeCoordinates(iter);
+}
+
+
+
+RingCache::RingsRef GeometryWriter::areaRings(FeatureStore* store, RelationPtr relation)
+{
+    presimplified_ = 0;
+    int level = generalized_ ? GeneralizedGeometry::levelFor(filter_.tolerance()) : -1;
+    if (level >= 0)
+    {
+        RingCache::RingsRef rings = generalized_->relationRings(relation, level);
+        if (rings)
+        {
+            presimplified_ = GeneralizedGeometry::levelTolerance(level);
+            return rings;
+        }
+    }
+    return RingCache::polygonize(store, relation);
+}
+
 
 void GeometryWriter::writePolygonizedCoordinates(const Polygonizer& polygonizer)
 {
@@ -155,14 +268,12 @@ void GeometryWriter::writePolygonizedCoordinates(const Polygonizer& polygonizer)
         if (!isFirst) writeByte(',');  // TODO: always comma for all formats?
         isFirst = false;
         writeByte(coordGroupStartChar_);
-        RingCoordinateIterator iter(ring);
-        writeCoordinates(iter);
+        writeRingCoordinates(ring);
         const Polygonizer::Ring* inner = ring->firstInner();
         while (inner)
         {
             writeByte(',');  // TODO: always comma for all formats?
-            RingCoordinateIterator iterInner(inner);
-            writeCoordinates(iterInner);
+            writeRingCoordinates(inner);
             inner = inner->next();
         }
         writeByte(coordGroupEndChar_);
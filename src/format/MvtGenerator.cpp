@@ -0,0 +1,121 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/MvtGenerator.h>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <clarisma/util/BufferWriter.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+MvtGenerator::MvtGenerator(FeatureStore* store, std::vector<MvtLayerSpec> layers,
+	uint32_t extent, uint32_t buffer) :
+	store_(store),
+	layers_(std::move(layers)),
+	extent_(extent),
+	buffer_(buffer)
+{
+}
+
+
+MvtTileBuilder MvtGenerator::createBuilder(Tile tile) const
+{
+	MvtTileBuilder builder(tile, extent_, buffer_);
+	builder.simplify(tolerance_);
+	for (const MvtLayerSpec& layer : layers_) builder.addLayer(layer.name);
+	return builder;
+}
+
+
+/**
+ * Finds the features of all layers with a single layered query, so each
+ * tile of the store is scanned only once, rather than once per layer.
+ */
+void MvtGenerator::buildTile(MvtTileBuilder& builder, Tile tile) const
+{
+	builder.reset(tile);
+	std::vector<QueryLayer> queryLayers;
+	queryLayers.reserve(layers_.size());
+	for (const MvtLayerSpec& layer : layers_)
+	{
+		queryLayers.push_back({ layer.types, layer.matcher, layer.filter });
+	}
+	Query query(store_, builder.queryBounds(), queryLayers.data(),
+		static_cast<uint32_t>(queryLayers.size()));
+	for (;;)
+	{
+		uint32_t layer;
+		FeaturePtr feature = query.next(&layer);
+		if (feature.isNull()) break;
+		builder.addFeature(store_, feature, static_cast<int>(layer));
+	}
+}
+
+
+void MvtGenerator::generate(Tile tile, Buffer* out) const
+{
+	MvtTileBuilder builder = createBuilder(tile);
+	buildTile(builder, tile);
+	builder.encode(out);
+}
+
+
+/**
+ * Each thread builds whole tiles (taking the next tile from the list
+ * once it is done), so the clipping and encoding of tiles proceeds
+ * in parallel, while the queries themselves are spread across the
+ * workers of the executor.
+ */
+void MvtGenerator::generate(std::span<const Tile> tiles, const Consumer& consumer,
+	int threadCount) const
+{
+	if (tiles.empty()) return;
+	if (threadCount <= 0) threadCount = store_->executor().threadCount();
+	threadCount = std::max(1, std::min(threadCount, static_cast<int>(tiles.size())));
+
+	std::atomic<size_t> nextTile = 0;
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto work = [this, tiles, &consumer, &nextTile, &errorMutex, &error]()
+	{
+		try
+		{
+			MvtTileBuilder builder = createBuilder(tiles[0]);
+			DynamicBuffer buf(64 * 1024);
+			for (;;)
+			{
+				size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+				if (n >= tiles.size()) break;
+				buildTile(builder, tiles[n]);
+				BufferWriter out(&buf);
+				out.clear();
+				out.flush();
+				builder.encode(&buf);
+				consumer(tiles[n], reinterpret_cast<const uint8_t*>(buf.data()), buf.length());
+			}
+		}
+		catch (...)
+		{
+			// Stop the other threads, and report the first error
+			nextTile = tiles.size();
+			std::lock_guard lock(errorMutex);
+			if (!error) error = std::current_exception();
+		}
+	};
+
+	// The calling thread does its share
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount - 1);
+	for (int i = 1; i < threadCount; i++) threads.emplace_back(work);
+	work();
+	for (std::thread& thread : threads) thread.join();
+	if (error) std::rethrow_exception(error);
+}
+
+} // namespace geodesk
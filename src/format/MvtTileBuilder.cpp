@@ -0,0 +1,630 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/MvtTileBuilder.h>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <clarisma/util/BufferWriter.h>
+#include <clarisma/util/protobuf.h>
+#include <clarisma/util/ShortVarString.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/TagIterator.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/feature/WayPtr.h>
+#include <geodesk/geom/GeneralizedGeometry.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include "geom/polygon/Ring.h"
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+using protobuf::field;
+
+namespace {
+
+enum Command
+{
+	MOVE_TO = 1,
+	LINE_TO = 2,
+	CLOSE_PATH = 7
+};
+
+constexpr uint32_t command(Command cmd, uint32_t count)
+{
+	return (count << 3) | cmd;
+}
+
+/// Clips the segment a-b to the square [lo, hi] (Liang-Barsky);
+/// returns false if it lies entirely outside
+template<typename P>
+bool clipSegment(P a, P b, double lo, double hi, double& t0, double& t1)
+{
+	double dx = b.x - a.x;
+	double dy = b.y - a.y;
+	double p[4] = { -dx, dx, -dy, dy };
+	double q[4] = { a.x - lo, hi - a.x, a.y - lo, hi - a.y };
+	t0 = 0;
+	t1 = 1;
+	for (int i = 0; i < 4; i++)
+	{
+		if (p[i] == 0)
+		{
+			if (q[i] < 0) return false;
+			continue;
+		}
+		double t = q[i] / p[i];
+		if (p[i] < 0)
+		{
+			t0 = std::max(t0, t);
+		}
+		else
+		{
+			t1 = std::min(t1, t);
+		}
+	}
+	return t0 <= t1;
+}
+
+} // namespace
+
+MvtTileBuilder::MvtTileBuilder(Tile tile, uint32_t extent, uint32_t buffer) :
+	extent_(extent),
+	buffer_(buffer),
+	tolerance_(0),
+	cursorX_(0),
+	cursorY_(0)
+{
+	reset(tile);
+}
+
+
+void MvtTileBuilder::reset(Tile tile)
+{
+	tile_ = tile;
+	double tileSize = static_cast<double>(1LL << (32 - tile.zoom()));
+	leftX_ = static_cast<double>(INT32_MIN) + tile.column() * tileSize;
+	topY_ = static_cast<double>(INT32_MAX) - tile.row() * tileSize;
+	scale_ = extent_ / tileSize;
+
+	for (Layer& layer : layers_)
+	{
+		BufferWriter out(&layer.features);
+		out.clear();
+		out.flush();
+		layer.featureCount = 0;
+		layer.keys.clear();
+		layer.keyIndexes.clear();
+		layer.values.clear();
+		layer.globalStringIndexes.clear();
+		layer.localStringIndexes.clear();
+		layer.integerIndexes.clear();
+		layer.doubleIndexes.clear();
+	}
+}
+
+
+int MvtTileBuilder::addLayer(std::string_view name)
+{
+	layers_.emplace_back();
+	layers_.back().name = name;
+	return static_cast<int>(layers_.size() - 1);
+}
+
+
+Box MvtTileBuilder::queryBounds() const
+{
+	double tileSize = extent_ / scale_;
+	double margin = std::ceil(buffer_ / scale_);
+	auto clamp = [](double v)
+	{
+		return static_cast<int32_t>(std::clamp(v,
+			static_cast<double>(INT32_MIN), static_cast<double>(INT32_MAX)));
+	};
+	return Box(
+		clamp(leftX_ - margin),
+		clamp(topY_ - tileSize + 1 - margin),
+		clamp(leftX_ + tileSize - 1 + margin),
+		clamp(topY_ + margin));
+}
+
+
+void MvtTileBuilder::addFeature(FeatureStore* store, FeaturePtr feature, int layerIndex)
+{
+	assert(layerIndex >= 0 && static_cast<size_t>(layerIndex) < layers_.size());
+	Layer& layer = layers_[layerIndex];
+	geometry_.clear();
+	cursorX_ = 0;
+	cursorY_ = 0;
+
+	GeometryType type;
+	if (feature.isNode())
+	{
+		addPoint(NodePtr(feature).xy());
+		type = POINT;
+	}
+	else if (feature.isWay())
+	{
+		addWayGeometry(store, WayPtr(feature));
+		type = feature.isArea() ? POLYGON : LINESTRING;
+	}
+	else
+	{
+		if (!feature.isArea()) return;
+		addAreaRelationGeometry(store, RelationPtr(feature));
+		type = POLYGON;
+	}
+	if (geometry_.empty()) return;
+
+	tags_.clear();
+	addTags(store, feature, layer);
+	writeFeature(layer, (static_cast<uint64_t>(feature.id()) << 2) |
+		feature.typeCode(), type);
+}
+
+
+int MvtTileBuilder::generalizedLevel() const
+{
+	if (tolerance_ <= 0) return -1;
+	return GeneralizedGeometry::levelFor(tolerance_ / scale_);
+}
+
+
+void MvtTileBuilder::addPoint(Coordinate c)
+{
+	Point p = toTile(c);
+	double lo = -static_cast<double>(buffer_);
+	double hi = static_cast<double>(extent_ + buffer_);
+	if (p.x < lo || p.x > hi || p.y < lo || p.y > hi) return;
+	geometry_.push_back(command(MOVE_TO, 1));
+	geometry_.push_back(toZigzag(static_cast<int32_t>(std::lround(p.x))));
+	geometry_.push_back(toZigzag(static_cast<int32_t>(std::lround(p.y))));
+}
+
+
+void MvtTileBuilder::addWayGeometry(FeatureStore* store, WayPtr way)
+{
+	int level = generalizedLevel();
+	const GeneralizedGeometry* generalized = level >= 0 ?
+		store->generalizedGeometry() : nullptr;
+	if (!generalized || !generalized->wayCoordinates(way, level, quantized_))
+	{
+		WayCoordinateIterator iter(way);
+		quantized_.resize(iter.coordinatesRemaining());
+		iter.decodeAll(quantized_.data());
+	}
+	points_.clear();
+	for (Coordinate c : quantized_) points_.push_back(toTile(c));
+	if (way.isArea())
+	{
+		addRing(true);
+	}
+	else
+	{
+		addLine();
+	}
+}
+
+
+void MvtTileBuilder::addAreaRelationGeometry(FeatureStore* store, RelationPtr relation)
+{
+	RingCache::RingsRef rings;
+	int level = generalizedLevel();
+	const GeneralizedGeometry* generalized = level >= 0 ?
+		store->generalizedGeometry() : nullptr;
+	if (generalized) rings = generalized->relationRings(relation, level);
+	if (!rings) rings = RingCache::polygonize(store, relation);
+	auto loadRing = [this](const Polygonizer::Ring* ring)
+	{
+		points_.clear();
+		RingCoordinateIterator iter(ring);
+		for (int n = iter.coordinatesRemaining(); n > 0; n--)
+		{
+			points_.push_back(toTile(iter.next()));
+		}
+	};
+
+	for (const Polygonizer::Ring* outer = rings->outerRings(); outer; outer = outer->next())
+	{
+		loadRing(outer);
+		if (!addRing(true)) continue;	// (so are its holes)
+		for (const Polygonizer::Ring* inner = outer->firstInner(); inner; inner = inner->next())
+		{
+			loadRing(inner);
+			addRing(false);
+		}
+	}
+}
+
+
+/**
+ * Clips the polyline in points_ to the buffered tile, writing each
+ * part that lies within it as a separate path.
+ */
+void MvtTileBuilder::addLine()
+{
+	double lo = -static_cast<double>(buffer_);
+	double hi = static_cast<double>(extent_ + buffer_);
+	clipped_.clear();
+	for (size_t i = 1; i < points_.size(); i++)
+	{
+		Point a = points_[i - 1];
+		Point b = points_[i];
+		double t0, t1;
+		if (!clipSegment(a, b, lo, hi, t0, t1))
+		{
+			if (!clipped_.empty())
+			{
+				quantize(clipped_);
+				writePath(false);
+				clipped_.clear();
+			}
+			continue;
+		}
+		double dx = b.x - a.x;
+		double dy = b.y - a.y;
+		if (clipped_.empty()) clipped_.push_back({ a.x + dx * t0, a.y + dy * t0 });
+		clipped_.push_back({ a.x + dx * t1, a.y + dy * t1 });
+		if (t1 < 1)
+		{
+			// The line leaves the tile
+			quantize(clipped_);
+			writePath(false);
+			clipped_.clear();
+		}
+	}
+	if (!clipped_.empty())
+	{
+		quantize(clipped_);
+		writePath(false);
+	}
+}
+
+
+/**
+ * Clips the closed ring in points_ to the buffered tile
+ * (Sutherland-Hodgman), leaving the result in points_. Where the ring
+ * runs outside the tile, the result follows the tile's edge (which
+ * is invisible, since it lies within the buffer).
+ */
+void MvtTileBuilder::clipRing()
+{
+	double lo = -static_cast<double>(buffer_);
+	double hi = static_cast<double>(extent_ + buffer_);
+	double minX = std::numeric_limits<double>::infinity();
+	double minY = minX;
+	double maxX = -minX;
+	double maxY = -minX;
+	for (const Point& p : points_)
+	{
+		minX = std::min(minX, p.x);
+		minY = std::min(minY, p.y);
+		maxX = std::max(maxX, p.x);
+		maxY = std::max(maxY, p.y);
+	}
+	if (minX >= lo && minY >= lo && maxX <= hi && maxY <= hi) return;
+	if (maxX < lo || maxY < lo || minX > hi || minY > hi)
+	{
+		points_.clear();
+		return;
+	}
+
+	// The clipper works with implicit closure
+	if (points_.size() > 1 && points_.front().x == points_.back().x &&
+		points_.front().y == points_.back().y)
+	{
+		points_.pop_back();
+	}
+
+	auto clipEdge = [this](auto inside, auto intersect)
+	{
+		clipped_.clear();
+		size_t n = points_.size();
+		for (size_t i = 0; i < n; i++)
+		{
+			Point a = points_[(i + n - 1) % n];
+			Point b = points_[i];
+			bool aInside = inside(a);
+			bool bInside = inside(b);
+			if (bInside)
+			{
+				if (!aInside) clipped_.push_back(intersect(a, b));
+				clipped_.push_back(b);
+			}
+			else if (aInside)
+			{
+				clipped_.push_back(intersect(a, b));
+			}
+		}
+		std::swap(points_, clipped_);
+	};
+	auto atX = [](Point a, Point b, double x) -> Point
+	{
+		return { x, a.y + (b.y - a.y) * (x - a.x) / (b.x - a.x) };
+	};
+	auto atY = [](Point a, Point b, double y) -> Point
+	{
+		return { a.x + (b.x - a.x) * (y - a.y) / (b.y - a.y), y };
+	};
+
+	clipEdge([lo](Point p) { return p.x >= lo; },
+		[lo, atX](Point a, Point b) { return atX(a, b, lo); });
+	clipEdge([hi](Point p) { return p.x <= hi; },
+		[hi, atX](Point a, Point b) { return atX(a, b, hi); });
+	clipEdge([lo](Point p) { return p.y >= lo; },
+		[lo, atY](Point a, Point b) { return atY(a, b, lo); });
+	clipEdge([hi](Point p) { return p.y <= hi; },
+		[hi, atY](Point a, Point b) { return atY(a, b, hi); });
+	if (!points_.empty()) points_.push_back(points_.front());
+}
+
+
+/**
+ * Clips the closed ring in points_ and writes it as a path, oriented
+ * as MVT requires (exterior rings clockwise, interior rings
+ * counter-clockwise, with y pointing down).
+ *
+ * @return false if nothing is left of the ring after clipping
+ *   and quantizing
+ */
+bool MvtTileBuilder::addRing(bool isOuter)
+{
+	clipRing();
+	quantize(points_);
+	// ClosePath implies the closing vertex
+	if (quantized_.size() > 1 && quantized_.back() == quantized_.front())
+	{
+		quantized_.pop_back();
+	}
+	if (quantized_.size() < 3) return false;
+
+	int64_t area = 0;
+	size_t n = quantized_.size();
+	for (size_t i = 0; i < n; i++)
+	{
+		Coordinate a = quantized_[i];
+		Coordinate b = quantized_[(i + 1) % n];
+		area += static_cast<int64_t>(a.x) * b.y - static_cast<int64_t>(b.x) * a.y;
+	}
+	if (area == 0) return false;
+	if ((area > 0) != isOuter) std::reverse(quantized_.begin(), quantized_.end());
+	writePath(true);
+	return true;
+}
+
+
+/**
+ * Rounds the points to integer tile coordinates, dropping
+ * consecutive duplicates.
+ */
+void MvtTileBuilder::quantize(const std::vector<Point>& points)
+{
+	quantized_.clear();
+	for (const Point& p : points)
+	{
+		Coordinate c(static_cast<int32_t>(std::lround(p.x)),
+			static_cast<int32_t>(std::lround(p.y)));
+		if (quantized_.empty() || quantized_.back() != c) quantized_.push_back(c);
+	}
+}
+
+
+void MvtTileBuilder::writePath(bool isRing)
+{
+	size_t n = quantized_.size();
+	if (n < 2) return;
+	for (size_t i = 0; i < n; i++)
+	{
+		if (i == 0)
+		{
+			geometry_.push_back(command(MOVE_TO, 1));
+		}
+		else if (i == 1)
+		{
+			geometry_.push_back(command(LINE_TO, static_cast<uint32_t>(n - 1)));
+		}
+		Coordinate c = quantized_[i];
+		geometry_.push_back(toZigzag(c.x - cursorX_));
+		geometry_.push_back(toZigzag(c.y - cursorY_));
+		cursorX_ = c.x;
+		cursorY_ = c.y;
+	}
+	if (isRing) geometry_.push_back(command(CLOSE_PATH, 1));
+}
+
+
+void MvtTileBuilder::addTags(FeatureStore* store, FeaturePtr feature, Layer& layer)
+{
+	StringTable& strings = store->strings();
+	TagTablePtr tags = feature.tags();
+	TagIterator iter(tags, strings);
+	for (;;)
+	{
+		auto [key, value] = iter.next();
+		if (!key) break;
+		tags_.push_back(keyIndex(layer, key->toStringView()));
+		tags_.push_back(valueIndex(layer, tags, value, strings));
+	}
+}
+
+
+uint32_t MvtTileBuilder::keyIndex(Layer& layer, std::string_view key)
+{
+	auto [it, isNew] = layer.keyIndexes.try_emplace(key,
+		static_cast<uint32_t>(layer.keys.size()));
+	if (isNew) layer.keys.push_back(key);
+	return it->second;
+}
+
+
+uint32_t MvtTileBuilder::valueIndex(Layer& layer, TagTablePtr tags,
+	TagBits value, StringTable& strings)
+{
+	uint32_t next = static_cast<uint32_t>(layer.values.size());
+	Value v;
+	switch (value & 3)
+	{
+	case 0:		// narrow number
+	{
+		v.type = Value::INTEGER;
+		v.intValue = TagTablePtr::narrowNumber(value);
+		auto [it, isNew] = layer.integerIndexes.try_emplace(v.intValue, next);
+		if (!isNew) return it->second;
+		break;
+	}
+	case 1:		// global string
+	{
+		auto [it, isNew] = layer.globalStringIndexes.try_emplace(
+			TagTablePtr::rawNarrowValue(value), next);
+		if (!isNew) return it->second;
+		v.type = Value::STRING;
+		v.stringValue = TagTablePtr::globalString(value, strings)->toStringView();
+		break;
+	}
+	case 2:		// wide number
+	{
+		Decimal d = tags.wideNumber(value);
+		if (d.scale() == 0)
+		{
+			v.type = Value::INTEGER;
+			v.intValue = d.mantissa();
+			auto [it, isNew] = layer.integerIndexes.try_emplace(v.intValue, next);
+			if (!isNew) return it->second;
+		}
+		else
+		{
+			v.type = Value::DOUBLE;
+			v.doubleValue = static_cast<double>(d);
+			auto [it, isNew] = layer.doubleIndexes.try_emplace(
+				std::bit_cast<uint64_t>(v.doubleValue), next);
+			if (!isNew) return it->second;
+		}
+		break;
+	}
+	default:	// local string
+	{
+		v.type = Value::STRING;
+		v.stringValue = tags.localString(value)->toStringView();
+		auto [it, isNew] = layer.localStringIndexes.try_emplace(v.stringValue, next);
+		if (!isNew) return it->second;
+		break;
+	}
+	}
+	layer.values.push_back(v);
+	return next;
+}
+
+
+void MvtTileBuilder::writeFeature(Layer& layer, uint64_t id, GeometryType type)
+{
+	size_t tagsSize = 0;
+	for (uint32_t v : tags_) tagsSize += varintSize(v);
+	size_t geometrySize = 0;
+	for (uint32_t v : geometry_) geometrySize += varintSize(v);
+
+	size_t size = 1 + varintSize(id) +
+		2 + 1 + varintSize(geometrySize) + geometrySize;
+	if (!tags_.empty()) size += 1 + varintSize(tagsSize) + tagsSize;
+
+	BufferWriter out(&layer.features);
+	out.writeVarint(field(2, protobuf::STRING));		// Layer.features
+	out.writeVarint(size);
+	out.writeVarint(field(1, protobuf::VARINT));		// Feature.id
+	out.writeVarint(id);
+	if (!tags_.empty())
+	{
+		out.writeVarint(field(2, protobuf::STRING));	// Feature.tags (packed)
+		out.writeVarint(tagsSize);
+		for (uint32_t v : tags_) out.writeVarint(v);
+	}
+	out.writeVarint(field(3, protobuf::VARINT));		// Feature.type
+	out.writeVarint(type);
+	out.writeVarint(field(4, protobuf::STRING));		// Feature.geometry (packed)
+	out.writeVarint(geometrySize);
+	for (uint32_t v : geometry_) out.writeVarint(v);
+	out.flush();
+	layer.featureCount++;
+}
+
+
+size_t MvtTileBuilder::valueSize(const Value& value)
+{
+	switch (value.type)
+	{
+	case Value::STRING:
+		return 1 + varintSize(value.stringValue.size()) + value.stringValue.size();
+	case Value::INTEGER:
+		return 1 + varintSize(toZigzag(value.intValue));
+	default:
+		return 1 + 8;
+	}
+}
+
+
+void MvtTileBuilder::encode(Buffer* buf) const
+{
+	BufferWriter out(buf);
+	for (const Layer& layer : layers_)
+	{
+		if (layer.featureCount == 0) continue;
+
+		size_t size = 2 +											// version
+			1 + varintSize(layer.name.size()) + layer.name.size() +
+			layer.features.length() +
+			1 + varintSize(extent_);
+		for (std::string_view key : layer.keys)
+		{
+			size += 1 + varintSize(key.size()) + key.size();
+		}
+		for (const Value& value : layer.values)
+		{
+			size_t valueLen = valueSize(value);
+			size += 1 + varintSize(valueLen) + valueLen;
+		}
+
+		out.writeVarint(field(3, protobuf::STRING));	// Tile.layers
+		out.writeVarint(size);
+		out.writeVarint(field(15, protobuf::VARINT));	// Layer.version
+		out.writeVarint(2);
+		out.writeVarint(field(1, protobuf::STRING));	// Layer.name
+		out.writeVarint(layer.name.size());
+		out.writeString(layer.name);
+		out.writeBytes(layer.features.data(), layer.features.length());
+		for (std::string_view key : layer.keys)
+		{
+			out.writeVarint(field(3, protobuf::STRING));	// Layer.keys
+			out.writeVarint(key.size());
+			out.writeString(key);
+		}
+		for (const Value& value : layer.values)
+		{
+			out.writeVarint(field(4, protobuf::STRING));	// Layer.values
+			out.writeVarint(valueSize(value));
+			switch (value.type)
+			{
+			case Value::STRING:
+				out.writeVarint(field(1, protobuf::STRING));
+				out.writeVarint(value.stringValue.size());
+				out.writeString(value.stringValue);
+				break;
+			case Value::INTEGER:
+				out.writeVarint(field(6, protobuf::VARINT));	// sint_value
+				out.writeVarint(toZigzag(value.intValue));
+				break;
+			default:
+				out.writeVarint(field(3, protobuf::FIXED64));	// double_value
+				out.writeBinary(value.doubleValue);			// (little-endian)
+				break;
+			}
+		}
+		out.writeVarint(field(5, protobuf::VARINT));	// Layer.extent
+		out.writeVarint(extent_);
+	}
+	out.flush();
+}
+
+} // namespace geodesk
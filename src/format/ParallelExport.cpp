@@ -0,0 +1,179 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/ParallelExport.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/Query.h>
+
+using namespace clarisma;
+
+namespace geodesk {
+
+ParallelExport::ParallelExport(FeatureWriter* out, WriterFactory createWriter, bool ordered) :
+    out_(out),
+    stream_(nullptr),
+    createWriter_(std::move(createWriter)),
+    ordered_(ordered),
+    anyWritten_(false),
+    workerCount_(0),
+    nextSequence_(0),
+    featureCount_(0)
+{
+}
+
+
+void ParallelExport::initSlot(Slot& slot)
+{
+    slot.writer = createWriter_(&slot.buffer);
+}
+
+
+ParallelExport::Slot& ParallelExport::currentSlot()
+{
+    int worker = QueryExecutor::currentWorker();
+    return slots_[(worker >= 0 && worker < workerCount_) ? worker : workerCount_];
+}
+
+
+void ParallelExport::run(FeatureStore* store, const Box& bounds, FeatureTypes types,
+    const MatcherHolder* matcher, const Filter* filter)
+{
+    workerCount_ = store->executor().threadCount();
+    slots_.reset(new Slot[workerCount_ + 1]);
+    for (int i = 0; i <= workerCount_; i++) initSlot(slots_[i]);
+
+    out_->writeHeader();
+
+    // Features that live in multiple tiles come back to this thread
+    DynamicBuffer tail(CHUNK_CAPACITY);
+    std::unique_ptr<FeatureWriter> tailWriter = createWriter_(&tail);
+    uint64_t tailCount = 0;
+    QueryOptions options;
+    options.ordered = ordered_;
+    {
+        Query query(store, bounds, types, matcher, filter, this, nullptr, options);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            tailWriter->writeFeature(store, next);
+            tailCount++;
+            if (!ordered_ && tailWriter->length() >= CHUNK_CAPACITY)
+            {
+                tailWriter->flush();
+                std::lock_guard lock(outputMutex_);
+                writeChunk(tail);
+                tailWriter->clear();
+                tailWriter->firstFeature(true);
+            }
+        }
+    }
+    tailWriter->flush();
+
+    // All tiles are done, so the output stage is ours alone;
+    // write whatever tiles are left (only if there are gaps in the
+    // sequence, which happens if the query was cancelled)
+    for (auto& [sequence, chunk] : pending_)
+    {
+        if (chunk) writeChunk(*chunk);
+    }
+    pending_.clear();
+    writeChunk(tail);
+    featureCount_ += tailCount;
+
+    out_->writeFooter();
+    out_->flush();
+    if (stream_)
+    {
+        stream_->finish();
+        out_->setBuffer(stream_);
+    }
+    slots_.reset();
+}
+
+
+void ParallelExport::beginTile(uint32_t sequence)
+{
+    Slot& slot = currentSlot();
+    slot.sequence = sequence;
+    slot.writer->firstFeature(true);
+}
+
+
+void ParallelExport::reduce(FeatureStore* store, const FeaturePtr* features, size_t count)
+{
+    FeatureWriter* writer = currentSlot().writer.get();
+    for (size_t i = 0; i < count; i++)
+    {
+        writer->writeFeature(store, features[i]);
+    }
+}
+
+
+/**
+ * Hands the tile's buffer to the output stage. Whichever thread
+ * completes the tile that is next in line writes it (along with any
+ * tiles after it that are already done) while holding the output lock.
+ */
+void ParallelExport::endTile(uint64_t count)
+{
+    Slot& slot = currentSlot();
+    slot.writer->flush();
+    std::lock_guard lock(outputMutex_);
+    featureCount_ += count;
+    if (!ordered_ || slot.sequence == nextSequence_)
+    {
+        writeChunk(slot.buffer);
+        if (ordered_)
+        {
+            nextSequence_++;
+            writePending();
+        }
+    }
+    else if (count)
+    {
+        // Park the buffer until the tiles before it are written,
+        // and give the slot a fresh one
+        pending_[slot.sequence] = std::make_unique<DynamicBuffer>(std::move(slot.buffer));
+        slot.buffer = DynamicBuffer(CHUNK_CAPACITY);
+        slot.writer->setBuffer(&slot.buffer);
+    }
+    else
+    {
+        pending_[slot.sequence] = nullptr;
+    }
+    slot.writer->clear();
+}
+
+
+void ParallelExport::writeChunk(const DynamicBuffer& chunk)
+{
+    if (chunk.isEmpty()) return;
+    if (anyWritten_) out_->writeString(out_->featureSeparator());
+    if (stream_)
+    {
+        out_->flush();
+        stream_->write(chunk.data(), chunk.length());
+        out_->setBuffer(stream_);
+    }
+    else
+    {
+        out_->writeBytes(chunk.data(), chunk.length());
+    }
+    anyWritten_ = true;
+}
+
+
+void ParallelExport::writePending()
+{
+    for (;;)
+    {
+        auto it = pending_.begin();
+        if (it == pending_.end() || it->first != nextSequence_) break;
+        if (it->second) writeChunk(*it->second);
+        pending_.erase(it);
+        nextSequence_++;
+    }
+}
+
+} // namespace geodesk
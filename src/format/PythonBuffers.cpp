@@ -0,0 +1,185 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_PYTHON
+
+#include <geodesk/format/PythonBuffers.h>
+#include <new>
+#include <geodesk/feature/FeatureStore.h>
+
+namespace geodesk {
+
+namespace {
+
+/// A read-only array of up to two dimensions, owned by `owner`
+struct ArrayBuffer
+{
+    PyObject_HEAD
+    std::shared_ptr<const void> owner;
+    const void* data;
+    const char* format;
+    Py_ssize_t itemSize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+};
+
+int getBuffer(PyObject* self, Py_buffer* view, int flags)
+{
+    if (flags & PyBUF_WRITABLE)
+    {
+        PyErr_SetString(PyExc_BufferError, "buffer is read-only");
+        view->obj = NULL;
+        return -1;
+    }
+    ArrayBuffer* array = reinterpret_cast<ArrayBuffer*>(self);
+    Py_INCREF(self);
+    view->obj = self;
+    view->buf = const_cast<void*>(array->data);
+    view->len = array->shape[0] * array->shape[1] * array->itemSize;
+    view->readonly = 1;
+    view->itemsize = array->itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(array->format) : NULL;
+    view->ndim = array->ndim;
+    // (Without PyBUF_ND, the consumer sees the array as flat bytes,
+    // which is fine, since it is contiguous)
+    view->shape = (flags & PyBUF_ND) ? array->shape : NULL;
+    view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? array->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+void deallocate(PyObject* self)
+{
+    ArrayBuffer* array = reinterpret_cast<ArrayBuffer*>(self);
+    array->owner.~shared_ptr();
+    Py_TYPE(self)->tp_free(self);
+}
+
+PyBufferProcs BUFFER_PROCS = { getBuffer, nullptr };
+
+PyTypeObject* arrayBufferType()
+{
+    static PyTypeObject type = []()
+    {
+        PyTypeObject t = { PyVarObject_HEAD_INIT(NULL, 0) };
+        t.tp_name = "geodesk.ArrayBuffer";
+        t.tp_basicsize = sizeof(ArrayBuffer);
+        t.tp_flags = Py_TPFLAGS_DEFAULT;
+        t.tp_dealloc = deallocate;
+        t.tp_as_buffer = &BUFFER_PROCS;
+        t.tp_doc = "A read-only array exported by GeoDesk";
+        return t;
+    }();
+    static bool ready = PyType_Ready(&type) == 0;
+    return ready ? &type : nullptr;
+}
+
+} // namespace
+
+
+PyObject* PythonBuffers::wrap(std::shared_ptr<const void> owner, const void* data,
+    Py_ssize_t rows, Py_ssize_t columns, const char* format, Py_ssize_t itemSize)
+{
+    PyTypeObject* type = arrayBufferType();
+    if (!type) return NULL;
+    ArrayBuffer* array = PyObject_New(ArrayBuffer, type);
+    if (!array) return NULL;
+    new(&array->owner) std::shared_ptr<const void>(std::move(owner));
+    // An empty vector may not have a buffer, but a Py_buffer must
+    static const uint64_t EMPTY = 0;
+    array->data = data ? data : &EMPTY;
+    array->format = format;
+    array->itemSize = itemSize;
+    array->ndim = columns == 1 ? 1 : 2;
+    array->shape[0] = rows;
+    array->shape[1] = columns;
+    array->strides[0] = columns * itemSize;
+    array->strides[1] = itemSize;
+    PyObject* self = reinterpret_cast<PyObject*>(array);
+    PyObject* view = PyMemoryView_FromObject(self);
+    Py_DECREF(self);
+    return view;
+}
+
+
+PyObject* PythonBuffers::typedIds(std::shared_ptr<const FlatCoordinates> coords)
+{
+    std::span<const uint64_t> ids = coords->typedIds();
+    return wrap(std::move(coords), ids.data(),
+        static_cast<Py_ssize_t>(ids.size()), 1, "Q", sizeof(uint64_t));
+}
+
+PyObject* PythonBuffers::featureOffsets(std::shared_ptr<const FlatCoordinates> coords)
+{
+    std::span<const uint32_t> offsets = coords->featureOffsets();
+    return wrap(std::move(coords), offsets.data(),
+        static_cast<Py_ssize_t>(offsets.size()), 1, "I", sizeof(uint32_t));
+}
+
+PyObject* PythonBuffers::partOffsets(std::shared_ptr<const FlatCoordinates> coords)
+{
+    std::span<const uint32_t> offsets = coords->partOffsets();
+    return wrap(std::move(coords), offsets.data(),
+        static_cast<Py_ssize_t>(offsets.size()), 1, "I", sizeof(uint32_t));
+}
+
+PyObject* PythonBuffers::partTypes(std::shared_ptr<const FlatCoordinates> coords)
+{
+    static_assert(sizeof(FlatCoordinates::PartType) == 1);
+    std::span<const FlatCoordinates::PartType> types = coords->partTypes();
+    return wrap(std::move(coords), types.data(),
+        static_cast<Py_ssize_t>(types.size()), 1, "B", 1);
+}
+
+PyObject* PythonBuffers::coordinates(std::shared_ptr<const FlatCoordinates> coords)
+{
+    Py_ssize_t count = static_cast<Py_ssize_t>(coords->coordinateCount());
+    if (coords->format() == CoordinateFormat::LONLAT)
+    {
+        const double* data = coords->lonLat().data();
+        return wrap(std::move(coords), data, count, 2, "d", sizeof(double));
+    }
+    const int32_t* data = coords->mercator().data();
+    return wrap(std::move(coords), data, count, 2, "i", sizeof(int32_t));
+}
+
+
+PyObject* PythonBuffers::tagColumn(FeatureStore* store,
+    std::shared_ptr<const TagColumns::DictionaryColumn> column)
+{
+    StringTable& strings = store->strings();
+    const std::vector<TagValue>& dictionary = column->dictionary;
+    PyObject* values = PyList_New(static_cast<Py_ssize_t>(dictionary.size()));
+    if (!values) return NULL;
+    for (size_t i = 0; i < dictionary.size(); i++)
+    {
+        std::string text = dictionary[i];
+        int code = strings.getCode(text.data(), text.size());
+        PyObject* str = code >= 0 ? strings.getStringObject(code) :
+            PyUnicode_FromStringAndSize(text.data(), static_cast<Py_ssize_t>(text.size()));
+        if (!str)
+        {
+            Py_DECREF(values);
+            return NULL;
+        }
+        PyList_SET_ITEM(values, static_cast<Py_ssize_t>(i), str);    // steals ref
+    }
+    const std::vector<int32_t>& indexes = column->indexes;
+    PyObject* indexView = wrap(std::move(column), indexes.data(),
+        static_cast<Py_ssize_t>(indexes.size()), 1, "i", sizeof(int32_t));
+    if (!indexView)
+    {
+        Py_DECREF(values);
+        return NULL;
+    }
+    PyObject* result = PyTuple_Pack(2, indexView, values);
+    Py_DECREF(indexView);
+    Py_DECREF(values);
+    return result;
+}
+
+} // namespace geodesk
+
+#endif // GEODESK_PYTHON
@@ -0,0 +1,72 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/TwkbWriter.h>
+#include <algorithm>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+void TwkbWriter::writeGeometryHeader(GeometryType type)
+{
+	// Type in the lower 4 bits, zigzag-encoded precision in the upper
+	// 4 bits, followed by the metadata byte (no bbox, size, ID list
+	// or extended dimensions)
+	writeByte(static_cast<char>(type | ((precision_ << 1) << 4)));
+	writeByte(0);
+	prevLon_ = 0;
+	prevLat_ = 0;
+}
+
+
+void TwkbWriter::writeEmptyGeometry(GeometryType type)
+{
+	writeByte(static_cast<char>(type | ((precision_ << 1) << 4)));
+	writeByte(0x10);		// empty geometry
+}
+
+
+void TwkbWriter::writeCount(uint32_t count)
+{
+	writeVarint(count);
+}
+
+
+void TwkbWriter::writePoints(const Coordinate* coords, size_t count)
+{
+	constexpr size_t BLOCK_SIZE = 64;
+	int64_t lons[BLOCK_SIZE];
+	int64_t lats[BLOCK_SIZE];
+	while (count)
+	{
+		size_t n = std::min(count, BLOCK_SIZE);
+		for (size_t i = 0; i < n; i++) lons[i] = scaledLon(coords[i].x);
+		for (size_t i = 0; i < n; i++) lats[i] = scaledLat(coords[i].y);
+		for (size_t i = 0; i < n; i++)
+		{
+			writeSignedVarint(lons[i] - prevLon_);
+			writeSignedVarint(lats[i] - prevLat_);
+			prevLon_ = lons[i];
+			prevLat_ = lats[i];
+		}
+		coords += n;
+		count -= n;
+	}
+}
+
+
+void TwkbWriter::writeAnonymousNodeNode(Coordinate point)
+{
+	checkPrecision();
+	WkbWriter::writeAnonymousNodeNode(point);
+}
+
+
+void TwkbWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
+{
+	checkPrecision();
+	WkbWriter::writeFeature(store, feature);
+}
+
+} // namespace geodesk
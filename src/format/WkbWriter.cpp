@@ -0,0 +1,264 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/format/WkbWriter.h>
+#include <algorithm>
+#include <bit>
+#include <vector>
+#include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include "geom/polygon/Ring.h"
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+void WkbWriter::writeGeometryHeader(GeometryType type)
+{
+	writeByte(std::endian::native == std::endian::little ? 1 : 0);
+	writeBinary(static_cast<uint32_t>(type));
+}
+
+
+void WkbWriter::writeEmptyGeometry(GeometryType type)
+{
+	assert(type != POINT);
+	writeGeometryHeader(type);
+	writeCount(0);
+}
+
+
+void WkbWriter::writeCount(uint32_t count)
+{
+	writeBinary(count);
+}
+
+
+void WkbWriter::writePoints(const Coordinate* coords, size_t count)
+{
+	constexpr size_t BLOCK_SIZE = 64;
+	double values[BLOCK_SIZE * 2];
+	while (count)
+	{
+		size_t n = std::min(count, BLOCK_SIZE);
+		for (size_t i = 0; i < n; i++)
+		{
+			values[i * 2] = Mercator::lonFromX(coords[i].x);
+			values[i * 2 + 1] = Mercator::latFromY(coords[i].y);
+		}
+		writeBytes(values, n * 2 * sizeof(double));
+		coords += n;
+		count -= n;
+	}
+}
+
+
+void WkbWriter::writeWayPoints(WayPtr way)
+{
+	if (filter_.isActive())
+	{
+		const std::vector<Coordinate>& coords = filteredCoordinates(way);
+		writeCount(static_cast<uint32_t>(coords.size()));
+		writePoints(coords.data(), coords.size());
+		return;
+	}
+	WayCoordinateIterator iter(way);
+	writeCount(iter.coordinatesRemaining());
+	Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+	for (;;)
+	{
+		int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+		if (count == 0) break;
+		writePoints(coords, count);
+	}
+}
+
+
+void WkbWriter::writeRingPoints(const Polygonizer::Ring* ring)
+{
+	if (filter_.isActive())
+	{
+		const std::vector<Coordinate>& coords = filteredCoordinates(ring);
+		writeCount(static_cast<uint32_t>(coords.size()));
+		writePoints(coords.data(), coords.size());
+		return;
+	}
+	RingCoordinateIterator iter(ring);
+	int remaining = iter.coordinatesRemaining();
+	writeCount(remaining);
+	Coordinate coords[WayCoordinateIterator::BATCH_SIZE];
+	while (remaining)
+	{
+		int count = std::min(remaining, WayCoordinateIterator::BATCH_SIZE);
+		for (int i = 0; i < count; i++) coords[i] = iter.next();
+		writePoints(coords, count);
+		remaining -= count;
+	}
+}
+
+
+void WkbWriter::writePolygonBody(const Polygonizer::Ring* outer)
+{
+	uint32_t ringCount = 1;
+	for (const Polygonizer::Ring* inner = outer->firstInner(); inner; inner = inner->next())
+	{
+		ringCount++;
+	}
+	writeCount(ringCount);
+	writeRingPoints(outer);
+	for (const Polygonizer::Ring* inner = outer->firstInner(); inner; inner = inner->next())
+	{
+		writeRingPoints(inner);
+	}
+}
+
+
+void WkbWriter::writeAnonymousNodeNode(Coordinate point)
+{
+	writeGeometryHeader(POINT);
+	writePoints(&point, 1);
+}
+
+
+void WkbWriter::writeAnonymousLine(std::span<const Coordinate> coords,
+	std::string_view, std::string_view)
+{
+	coords = filteredCoordinates(coords);
+	writeGeometryHeader(LINESTRING);
+	writeCount(static_cast<uint32_t>(coords.size()));
+	writePoints(coords.data(), coords.size());
+}
+
+
+void WkbWriter::writeNodeGeometry(NodePtr node)
+{
+	Coordinate point = node.xy();
+	writeGeometryHeader(POINT);
+	writePoints(&point, 1);
+}
+
+
+void WkbWriter::writeWayGeometry(WayPtr way)
+{
+	if (way.isArea())
+	{
+		writeGeometryHeader(POLYGON);
+		writeCount(1);
+	}
+	else
+	{
+		writeGeometryHeader(LINESTRING);
+	}
+	writeWayPoints(way);
+}
+
+
+void WkbWriter::writeAreaRelationGeometry(FeatureStore* store, RelationPtr relation)
+{
+	RingCache::RingsRef rings = areaRings(store, relation);
+	const Polygonizer::Ring* first = rings->outerRings();
+	if (!first)
+	{
+		writeEmptyGeometry(POLYGON);
+		return;
+	}
+	if (!first->next())
+	{
+		writeGeometryHeader(POLYGON);
+		writePolygonBody(first);
+		return;
+	}
+	uint32_t polygonCount = 0;
+	for (const Polygonizer::Ring* ring = first; ring; ring = ring->next())
+	{
+		polygonCount++;
+	}
+	writeGeometryHeader(MULTIPOLYGON);
+	writeCount(polygonCount);
+	for (const Polygonizer::Ring* ring = first; ring; ring = ring->next())
+	{
+		if (partsHaveHeaders()) writeGeometryHeader(POLYGON);
+		writePolygonBody(ring);
+	}
+}
+
+
+void WkbWriter::writeCollectionRelationGeometry(FeatureStore* store, RelationPtr relation)
+{
+	RecursionGuard guard(relation);
+	writeCollection(store, relation, guard);
+}
+
+
+/**
+ * Writes a relation as a GEOMETRYCOLLECTION. Unlike in text formats,
+ * the number of members comes first, so we gather the members that
+ * have geometries before writing any of them.
+ */
+void WkbWriter::writeCollection(FeatureStore* store, RelationPtr relation, RecursionGuard& guard)
+{
+	std::vector<FeaturePtr> members;
+	FastMemberIterator iter(store, relation);
+	for (;;)
+	{
+		FeaturePtr member = iter.next();
+		if (member.isNull()) break;
+		if (member.isWay())
+		{
+			if (WayPtr(member).isPlaceholder()) continue;
+		}
+		else if (member.isNode())
+		{
+			if (NodePtr(member).isPlaceholder()) continue;
+		}
+		else
+		{
+			RelationPtr childRel(member);
+			if (childRel.isPlaceholder() || !guard.checkAndAdd(childRel)) continue;
+		}
+		members.push_back(member);
+	}
+	if (members.empty())
+	{
+		writeEmptyGeometry(GEOMETRYCOLLECTION);
+		return;
+	}
+	writeGeometryHeader(GEOMETRYCOLLECTION);
+	writeCount(static_cast<uint32_t>(members.size()));
+	for (FeaturePtr member : members)
+	{
+		if (member.isWay())
+		{
+			writeWayGeometry(WayPtr(member));
+		}
+		else if (member.isNode())
+		{
+			writeNodeGeometry(NodePtr(member));
+		}
+		else
+		{
+			RelationPtr childRel(member);
+			if (childRel.isArea())
+			{
+				writeAreaRelationGeometry(store, childRel);
+			}
+			else
+			{
+				writeCollection(store, childRel, guard);
+			}
+		}
+	}
+}
+
+
+void WkbWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
+{
+	writeFeatureGeometry(store, feature);
+	firstFeature_ = false;
+}
+
+} // namespace geodesk
@@ -3,7 +3,7 @@
 
 #include <geodesk/format/WktWriter.h>
 #include <geodesk/feature/FeatureStore.h>
-#include <geodesk/geom/polygon/Polygonizer.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include "geom/polygon/Ring.h"
 
 namespace geodesk {
@@ -22,7 +22,7 @@ WktWriter::WktWriter(Buffer* buf) : FeatureWriter(buf)
 
 void WktWriter::writeAnonymousNodeNode(Coordinate point)
 {
-	if (!firstFeature_) writeConstString(", ");
+	if (!firstFeature_) writeString(featureSeparator());
 	writeConstString("POINT(");
 	writeCoordinate(point);
 	writeByte(')');
@@ -30,6 +30,16 @@ void WktWriter::writeAnonymousNodeNode(Coordinate point)
 }
 
 
+void WktWriter::writeAnonymousLine(std::span<const Coordinate> coords,
+	std::string_view, std::string_view)
+{
+	if (!firstFeature_) writeString(featureSeparator());
+	writeConstString("LINESTRING");
+	writeLineCoordinates(coords);
+	firstFeature_ = false;
+}
+
+
 void WktWriter::writeNodeGeometry(NodePtr node)
 {
 	writeConstString("POINT(");
@@ -52,10 +62,8 @@ void WktWriter::writeWayGeometry(WayPtr way)
 
 void WktWriter::writeAreaRelationGeometry(FeatureStore* store, RelationPtr relation)
 {
-	Polygonizer polygonizer;
-	polygonizer.createRings(store, relation);
-	polygonizer.assignAndMergeHoles();
-	const Polygonizer::Ring* ring = polygonizer.outerRings();
+	RingCache::RingsRef rings = areaRings(store, relation);
+	const Polygonizer::Ring* ring = rings->outerRings();
 	int count = ring ? (ring->next() ? 2 : 1) : 0;
 	if (count > 1)
 	{
@@ -71,7 +79,7 @@ void WktWriter::writeAreaRelationGeometry(FeatureStore* store, RelationPtr relat
 	}
 	else
 	{
-		writePolygonizedCoordinates(polygonizer);
+		writePolygonizedCoordinates(*rings);
 	}
 }
 
@@ -86,7 +94,7 @@ void WktWriter::writeCollectionRelationGeometry(FeatureStore* store, RelationPtr
 
 void WktWriter::writeFeature(FeatureStore* store, FeaturePtr feature)
 {
-	if (!firstFeature_) writeConstString(", ");
+	if (!firstFeature_) writeString(featureSeparator());
 	writeFeatureGeometry(store, feature); 
 	firstFeature_ = false;
 }
@@ -2,7 +2,12 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/geom/Area.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include "geom/polygon/RingCoordinateIterator.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define GEODESK_AREA_SSE2
+#endif
 
 namespace geodesk {
 
@@ -33,12 +38,66 @@ double Area::ofWaySigned(const WayRef way)
 */
 
 
+// Twice the signed area of the polygon formed by the given coordinates
+// and `origin` (the sum of the cross products of consecutive
+// coordinates, relative to the origin to retain precision)
+double Area::doubleSignedMercatorOfCoords(const Coordinate* coords,
+    int count, Coordinate origin)
+{
+    double x0 = origin.x;
+    double y0 = origin.y;
+    double sum = 0;
+    int i = 0;
+#if defined(GEODESK_AREA_SSE2)
+    // Each lane holds one of the two products of the cross product
+    // (x1 * y2 and y1 * x2), which are subtracted at the end
+    const __m128d o = _mm_set_pd(y0, x0);
+    __m128d products = _mm_setzero_pd();
+    __m128d a = _mm_sub_pd(_mm_cvtepi32_pd(_mm_loadl_epi64(
+        reinterpret_cast<const __m128i*>(coords))), o);
+    for (i = 1; i < count; i++)
+    {
+        __m128d b = _mm_sub_pd(_mm_cvtepi32_pd(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i*>(coords + i))), o);
+        products = _mm_add_pd(products,
+            _mm_mul_pd(a, _mm_shuffle_pd(b, b, 1)));
+        a = b;
+    }
+    sum = _mm_cvtsd_f64(products) - _mm_cvtsd_f64(_mm_unpackhi_pd(products, products));
+#else
+    for (i = 1; i < count; i++)
+    {
+        double x1 = coords[i-1].x - x0;
+        double y1 = coords[i-1].y - y0;
+        double x2 = coords[i].x - x0;
+        double y2 = coords[i].y - y0;
+        sum += x1 * y2 - x2 * y1;
+    }
+#endif
+    return sum;
+}
+
+
+// Like signedMercatorOfAbstractRing(), but decodes the coordinates
+// in blocks (carrying the last coordinate of each block over to the
+// next one), and measures each block in bulk
 double Area::signedMercatorOfWay(const WayPtr way)
 {
     assert(way.isArea());
     WayCoordinateIterator iter;
     iter.start(way, FeatureFlags::AREA);
-    return signedMercatorOfAbstractRing(iter);
+    Coordinate coords[WayCoordinateIterator::BATCH_SIZE + 1];
+    int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+    assert(count >= 2);
+    Coordinate origin = coords[0];
+    double sum = 0.0;
+    while (count > 1)
+    {
+        sum += doubleSignedMercatorOfCoords(coords, count, origin);
+        coords[0] = coords[count-1];
+        count = iter.decode(coords + 1, WayCoordinateIterator::BATCH_SIZE) + 1;
+    }
+    return sum / 2.0;
 }
 
 
@@ -57,20 +116,12 @@ double Area::ofRelation(FeatureStore* store, const RelationPtr relation)
     scale *= scale;     // squared for square meters
     double totalArea = 0;
 
-    Polygonizer polygonizer;
-    polygonizer.createRings(store, relation);
-    const Polygonizer::Ring* ring = polygonizer.outerRings();
-    while (ring)
-    {
-        totalArea += mercatorOfRing(ring) * scale;
-        ring = ring->next();
-    }
-    ring = polygonizer.innerRings();
-    while (ring)
+    RingCache::RingsRef rings = RingCache::polygonize(store, relation, false);
+    rings->forEachRing([&](const Polygonizer::Ring* ring, bool isOuter)
     {
-        totalArea -= mercatorOfRing(ring) * scale;
-        ring = ring->next();
-    }
+        double area = mercatorOfRing(ring) * scale;
+        totalArea += isOuter ? area : -area;
+    });
 
     // TODO: could apply scale at end; but we may also calculate
     // scale for each ring separately?
@@ -0,0 +1,165 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/BinGrid.h>
+#include <cmath>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/geom/Mercator.h>
+
+using namespace clarisma;
+
+namespace geodesk {
+
+namespace {
+
+constexpr double SQRT_3 = 1.7320508075688772;
+
+void checkCellCount(uint64_t columns, uint64_t rows)
+{
+	if (columns * rows > BinGrid::MAX_CELLS)
+	{
+		throw ValueException("Grid has too many cells");
+	}
+}
+
+} // namespace
+
+
+BinGrid::BinGrid(Shape shape, const Box& bounds, double originX, double originY,
+	double cellWidth, double cellHeight, uint32_t columns, uint32_t rows) :
+	shape_(shape),
+	bounds_(bounds),
+	originX_(originX),
+	originY_(originY),
+	cellWidth_(cellWidth),
+	cellHeight_(cellHeight),
+	columns_(columns),
+	rows_(rows)
+{
+}
+
+
+BinGrid BinGrid::ofCells(const Box& bounds, uint32_t columns, uint32_t rows)
+{
+	if (bounds.isEmpty()) throw ValueException("Bounds must not be empty");
+	if (columns == 0 || rows == 0) throw ValueException("Grid must have at least one cell");
+	checkCellCount(columns, rows);
+	double width = static_cast<double>(bounds.maxX()) - bounds.minX() + 1;
+	double height = static_cast<double>(bounds.maxY()) - bounds.minY() + 1;
+	return BinGrid(Shape::RECTANGLE, bounds, bounds.minX(), bounds.maxY(),
+		width / columns, height / rows, columns, rows);
+}
+
+
+BinGrid BinGrid::ofTiles(int zoom, const Box& bounds)
+{
+	if (bounds.isEmpty()) throw ValueException("Bounds must not be empty");
+	if (zoom < 0 || zoom > 24) throw ValueException("Zoom level must be 0 to 24");
+	int shift = 32 - zoom;
+	// Same as Tile::columnFromXZ() and Tile::rowFromYZ(), which are
+	// limited to the zoom levels of a tile pyramid
+	int64_t left = (int64_t{bounds.minX()} + (1LL << 31)) >> shift;
+	int64_t right = (int64_t{bounds.maxX()} + (1LL << 31)) >> shift;
+	int64_t top = (0x7fff'ffffLL - bounds.maxY()) >> shift;
+	int64_t bottom = (0x7fff'ffffLL - bounds.minY()) >> shift;
+	int64_t columns = right - left + 1;
+	int64_t rows = bottom - top + 1;
+	checkCellCount(columns, rows);
+
+	int64_t extent = 1LL << shift;
+	int64_t minX = (left << shift) - (1LL << 31);
+	int64_t maxY = 0x7fff'ffffLL - (top << shift);
+	Box tileBounds(static_cast<int32_t>(minX),
+		static_cast<int32_t>(maxY - rows * extent + 1),
+		static_cast<int32_t>(minX + columns * extent - 1),
+		static_cast<int32_t>(maxY));
+	return BinGrid(Shape::RECTANGLE, tileBounds,
+		static_cast<double>(minX), static_cast<double>(maxY),
+		static_cast<double>(extent), static_cast<double>(extent),
+		static_cast<uint32_t>(columns), static_cast<uint32_t>(rows));
+}
+
+
+/// The origin lies half a hexagon (horizontally and vertically) beyond
+/// the top-left corner of the bounds, so every point within the
+/// bounds is closer to a hexagon in row 0 or column 0 (or beyond)
+/// than to any hexagon in a (non-existent) row or column -1
+BinGrid BinGrid::ofHexagons(const Box& bounds, double meters)
+{
+	if (bounds.isEmpty()) throw ValueException("Bounds must not be empty");
+	if (!(meters > 0)) throw ValueException("Hexagon size must be positive");
+	double centerY = (static_cast<double>(bounds.minY()) + bounds.maxY()) / 2;
+	double size = Mercator::unitsFromMeters(meters, centerY);
+	double spacingX = SQRT_3 * size;
+	double spacingY = 1.5 * size;
+	double width = static_cast<double>(bounds.maxX()) - bounds.minX();
+	double height = static_cast<double>(bounds.maxY()) - bounds.minY();
+	double columns = std::floor((width + spacingX / 2) / spacingX) + 2;
+	double rows = std::floor((height + spacingY / 2) / spacingY) + 2;
+	if (columns * rows > MAX_CELLS) throw ValueException("Grid has too many cells");
+	return BinGrid(Shape::HEXAGON, bounds,
+		bounds.minX() - spacingX / 2, bounds.maxY() + spacingY / 2,
+		spacingX, spacingY,
+		static_cast<uint32_t>(columns), static_cast<uint32_t>(rows));
+}
+
+
+/// Converts the point to fractional axial coordinates, rounds them to
+/// the nearest hexagon in cube coordinates (x + y + z = 0), then turns
+/// these into the "odd-r" offset coordinates used for numbering
+int64_t BinGrid::hexagonOf(Coordinate c) const
+{
+	double size = cellHeight_ / 1.5;
+	double dx = c.x - originX_;
+	double dy = originY_ - c.y;			// rows run southward
+	double q = (SQRT_3 / 3 * dx - dy / 3) / size;
+	double r = (2.0 / 3 * dy) / size;
+	double s = -q - r;
+
+	double rq = std::round(q);
+	double rr = std::round(r);
+	double rs = std::round(s);
+	double dq = std::abs(rq - q);
+	double dr = std::abs(rr - r);
+	double ds = std::abs(rs - s);
+	if (dq > dr && dq > ds)
+	{
+		rq = -rr - rs;
+	}
+	else if (dr > ds)
+	{
+		rr = -rq - rs;
+	}
+
+	int64_t row = static_cast<int64_t>(rr);
+	int64_t col = static_cast<int64_t>(rq) + (row - (row & 1)) / 2;
+	// (guard against rounding at the far edges)
+	if (col < 0) col = 0;
+	if (col >= columns_) col = columns_ - 1;
+	if (row < 0) row = 0;
+	if (row >= rows_) row = rows_ - 1;
+	return row * columns_ + col;
+}
+
+
+Coordinate BinGrid::centerOf(uint32_t cell) const
+{
+	uint32_t row = cell / columns_;
+	uint32_t col = cell % columns_;
+	double x;
+	double y;
+	if (shape_ == Shape::HEXAGON)
+	{
+		x = originX_ + (col + 0.5 * (row & 1)) * cellWidth_;
+		y = originY_ - row * cellHeight_;
+	}
+	else
+	{
+		x = originX_ + (col + 0.5) * cellWidth_;
+		y = originY_ - (row + 0.5) * cellHeight_;
+	}
+	return Coordinate(static_cast<int32_t>(std::round(x)),
+		static_cast<int32_t>(std::round(y)));
+}
+
+} // namespace geodesk
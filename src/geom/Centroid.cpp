@@ -3,7 +3,8 @@
 
 #include <geodesk/geom/Centroid.h>
 #include <geodesk/feature/FeatureStore.h>
-#include <geodesk/geom/polygon/Polygonizer.h>
+#include <geodesk/feature/RelationTreeCache.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include "geom/polygon/RingCoordinateIterator.h"
 
 namespace geodesk {
@@ -30,22 +31,12 @@ Coordinate Centroid::ofWay(WayPtr way)
 
 void Centroid::Areal::addAreaRelation(FeatureStore* store, RelationPtr relation)
 {
-	Polygonizer polygonizer;
-	polygonizer.createRings(store, relation);
-	const Polygonizer::Ring* ring = polygonizer.outerRings();
-	while (ring)
+	RingCache::RingsRef rings = RingCache::polygonize(store, relation, false);
+	rings->forEachRing([this](const Polygonizer::Ring* ring, bool isOuter)
 	{
 		RingCoordinateIterator iter(ring);
-		addRing(iter, true);
-		ring = ring->next();
-	}
-	ring = polygonizer.innerRings();
-	while (ring)
-	{
-		RingCoordinateIterator iter(ring);
-		addRing(iter, false);
-		ring = ring->next();
-	}
+		addRing(iter, isOuter);
+	});
 }
 
 
@@ -64,8 +55,26 @@ Coordinate Centroid::ofRelation(FeatureStore* store, RelationPtr relation)
 	else
 	{
 		Centroid centroid;
-		RecursionGuard guard(relation);
-		centroid.addRelation(store, relation, guard);
+		if (auto leaves = RelationTreeCache::leavesOf(store, relation))
+		{
+			for (FeaturePtr leaf : *leaves)
+			{
+				if (leaf.isWay())
+				{
+					centroid.addWay(WayPtr(leaf));
+				}
+				else
+				{
+					centroid.puntal_.addPoint(NodePtr(leaf).xy());
+				}
+			}
+		}
+		else
+		{
+			RecursionGuard guard(relation);
+			TileCache tiles;
+			centroid.addRelation(store, relation, guard, tiles);
+		}
 		if (!centroid.areal_.isEmpty()) return centroid.areal_.centroid();
 		if (!centroid.lineal_.isEmpty()) return centroid.lineal_.centroid();
 		if (!centroid.puntal_.isEmpty()) return centroid.puntal_.centroid();
@@ -88,9 +97,10 @@ void Centroid::addWay(WayPtr way)
 }
 
 
-void Centroid::addRelation(FeatureStore* store, RelationPtr rel, RecursionGuard& guard)
+void Centroid::addRelation(FeatureStore* store, RelationPtr rel,
+	RecursionGuard& guard, TileCache& tiles)
 {
-	FastMemberIterator iter(store, rel);
+	FastMemberIterator iter(store, rel, &tiles);
 	for (;;)
 	{
 		FeaturePtr member = iter.next();
@@ -113,7 +123,7 @@ void Centroid::addRelation(FeatureStore* store, RelationPtr rel, RecursionGuard&
 			RelationPtr childRel(member);
 			if (!childRel.isPlaceholder() && guard.checkAndAdd(childRel))
 			{
-				addRelation(store, childRel, guard);
+				addRelation(store, childRel, guard, tiles);
 			}
 		}
 	}
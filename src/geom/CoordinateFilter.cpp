@@ -0,0 +1,224 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/CoordinateFilter.h>
+#include <algorithm>
+#include <cmath>
+#include <geodesk/geom/Distance.h>
+
+namespace geodesk {
+
+void CoordinateFilter::apply(std::vector<Coordinate>& coords, bool isRing)
+{
+	// Clip first, so we simplify fewer vertexes
+	if (clipping_) clip(coords, isRing, clipBox_);
+	if (tolerance_ > 0) simplify(coords, isRing, tolerance_);
+}
+
+
+namespace {
+
+/// One pass of Sutherland-Hodgman: keeps the part of `in` on the inner
+/// side of a single edge of the box
+template<typename Inside, typename Intersect>
+void clipEdge(const std::vector<Coordinate>& in, std::vector<Coordinate>& out,
+	bool isRing, Inside inside, Intersect intersect)
+{
+	out.clear();
+	if (in.empty()) return;
+	// (For a ring, `in` is open, so its first segment starts at the end)
+	Coordinate prev = isRing ? in.back() : in[0];
+	bool prevInside = inside(prev);
+	size_t i = 0;
+	if (!isRing)
+	{
+		if (prevInside) out.push_back(prev);
+		i = 1;
+	}
+	for (; i < in.size(); i++)
+	{
+		Coordinate c = in[i];
+		bool cInside = inside(c);
+		if (cInside != prevInside) out.push_back(intersect(prev, c));
+		if (cInside) out.push_back(c);
+		prev = c;
+		prevInside = cInside;
+	}
+}
+
+Coordinate atX(Coordinate a, Coordinate b, int32_t x)
+{
+	double t = (static_cast<double>(x) - a.x) / (static_cast<double>(b.x) - a.x);
+	return Coordinate(x, static_cast<int32_t>(std::round(a.y + t * (static_cast<double>(b.y) - a.y))));
+}
+
+Coordinate atY(Coordinate a, Coordinate b, int32_t y)
+{
+	double t = (static_cast<double>(y) - a.y) / (static_cast<double>(b.y) - a.y);
+	return Coordinate(static_cast<int32_t>(std::round(a.x + t * (static_cast<double>(b.x) - a.x))), y);
+}
+
+void removeRepeated(std::vector<Coordinate>& coords)
+{
+	coords.erase(std::unique(coords.begin(), coords.end()), coords.end());
+}
+
+} // namespace
+
+
+void CoordinateFilter::clip(std::vector<Coordinate>& coords, bool isRing, const Box& box)
+{
+	if (coords.empty()) return;
+	if (isRing) coords.pop_back();		// (closed again at the end)
+	original_ = coords;
+
+	// Alternate between the two vectors, one edge at a time
+	int32_t minX = box.minX();
+	int32_t minY = box.minY();
+	int32_t maxX = box.maxX();
+	int32_t maxY = box.maxY();
+	clipEdge(coords, temp_, isRing,
+		[minX](Coordinate c) { return c.x >= minX; },
+		[minX](Coordinate p, Coordinate q) { return atX(p, q, minX); });
+	clipEdge(temp_, coords, isRing,
+		[maxX](Coordinate c) { return c.x <= maxX; },
+		[maxX](Coordinate p, Coordinate q) { return atX(p, q, maxX); });
+	clipEdge(coords, temp_, isRing,
+		[minY](Coordinate c) { return c.y >= minY; },
+		[minY](Coordinate p, Coordinate q) { return atY(p, q, minY); });
+	clipEdge(temp_, coords, isRing,
+		[maxY](Coordinate c) { return c.y <= maxY; },
+		[maxY](Coordinate p, Coordinate q) { return atY(p, q, maxY); });
+	removeRepeated(coords);
+	if (isRing && coords.size() > 1 && coords.back() == coords.front()) coords.pop_back();
+
+	size_t minCount = isRing ? 3 : 2;
+	if (coords.size() < minCount)
+	{
+		// The geometry lies outside the box (or merely touches it),
+		// so we clamp its vertexes instead
+		coords.clear();
+		for (Coordinate c : original_)
+		{
+			coords.emplace_back(std::clamp(c.x, minX, maxX), std::clamp(c.y, minY, maxY));
+		}
+		removeRepeated(coords);
+		while (coords.size() < minCount) coords.push_back(coords.back());
+	}
+	if (isRing) coords.push_back(coords.front());
+}
+
+
+void CoordinateFilter::simplify(std::vector<Coordinate>& coords, bool isRing, double tolerance)
+{
+	size_t n = coords.size();
+	if (n < (isRing ? 5 : 3)) return;
+	double toleranceSquared = tolerance * tolerance;
+	keep_.assign(n, 0);
+	keep_[0] = 1;
+	keep_[n - 1] = 1;
+	if (!isRing)
+	{
+		simplifyRange(coords, 0, n - 1, toleranceSquared);
+		keepOnly(coords);
+		return;
+	}
+
+	// A ring's end points are the same, so we split it at the vertex
+	// that is farthest from them, and simplify both halves
+	Coordinate first = coords[0];
+	size_t far = 0;
+	double maxDist = -1;
+	for (size_t i = 1; i < n - 1; i++)
+	{
+		double dx = static_cast<double>(coords[i].x) - first.x;
+		double dy = static_cast<double>(coords[i].y) - first.y;
+		double dist = dx * dx + dy * dy;
+		if (dist > maxDist)
+		{
+			maxDist = dist;
+			far = i;
+		}
+	}
+	keep_[far] = 1;
+	simplifyRange(coords, 0, far, toleranceSquared);
+	simplifyRange(coords, far, n - 1, toleranceSquared);
+
+	size_t keptCount = 0;
+	for (uint8_t k : keep_) keptCount += k;
+	if (keptCount < 4)
+	{
+		// Keep a triangle: add the vertex farthest from the line
+		// between the first and the farthest vertex
+		size_t third = 0;
+		maxDist = -1;
+		for (size_t i = 1; i < n - 1; i++)
+		{
+			if (i == far) continue;
+			double dist = Distance::pointSegmentSquared(
+				first.x, first.y, coords[far].x, coords[far].y,
+				coords[i].x, coords[i].y);
+			if (dist > maxDist)
+			{
+				maxDist = dist;
+				third = i;
+			}
+		}
+		keep_[third] = 1;
+	}
+	keepOnly(coords);
+}
+
+
+/**
+ * Douglas-Peucker, with an explicit stack (ways can have thousands
+ * of vertexes). Marks the vertexes between `start` and `end` that
+ * must be kept.
+ */
+void CoordinateFilter::simplifyRange(const std::vector<Coordinate>& coords,
+	size_t start, size_t end, double toleranceSquared)
+{
+	stack_.clear();
+	stack_.emplace_back(start, end);
+	while (!stack_.empty())
+	{
+		auto [a, b] = stack_.back();
+		stack_.pop_back();
+		if (b - a < 2) continue;
+		double ax = coords[a].x;
+		double ay = coords[a].y;
+		double bx = coords[b].x;
+		double by = coords[b].y;
+		size_t farthest = 0;
+		double maxDist = toleranceSquared;
+		for (size_t i = a + 1; i < b; i++)
+		{
+			double dist = Distance::pointSegmentSquared(ax, ay, bx, by,
+				coords[i].x, coords[i].y);
+			if (dist > maxDist)
+			{
+				maxDist = dist;
+				farthest = i;
+			}
+		}
+		if (farthest)
+		{
+			keep_[farthest] = 1;
+			stack_.emplace_back(a, farthest);
+			stack_.emplace_back(farthest, b);
+		}
+	}
+}
+
+
+void CoordinateFilter::keepOnly(std::vector<Coordinate>& coords)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < coords.size(); i++)
+	{
+		if (keep_[i]) coords[count++] = coords[i];
+	}
+	coords.resize(count);
+}
+
+} // namespace geodesk
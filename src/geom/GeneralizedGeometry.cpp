@@ -0,0 +1,380 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/GeneralizedGeometry.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/CoordinateFilter.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include <geodesk/geom/polygon/RingStore.h>
+#include <geodesk/query/TileIndexWalker.h>
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+/// Simplifies the geometry of a feature at each level, and encodes
+/// the levels that lose vertexes (see GeneralizedGeometry)
+class GeneralizedGeometry::Encoder
+{
+public:
+    explicit Encoder(std::vector<uint8_t>& data) : data_(data) {}
+
+    /// @return false if the way doesn't lose any vertexes at any level
+    bool encode(WayPtr way, Entry& entry)
+    {
+        WayCoordinateIterator iter(way);
+        rings_.resize(1);
+        std::vector<Coordinate>& original = rings_[0];
+        original.resize(iter.coordinatesRemaining());
+        iter.decodeAll(original.data());
+        return encodeLevels(entry, way.isArea(),
+            [this](const std::vector<std::vector<Coordinate>>& rings)
+        {
+            Coordinate prev(0, 0);
+            writeRing(rings[0], prev);
+        });
+    }
+
+    /// @return false if the relation doesn't lose any vertexes at any level
+    bool encode(const Polygonizer& polygonizer, Entry& entry)
+    {
+        // Collect the rings in the order they are written (see
+        // RingStore::Decoder for the format)
+        rings_.clear();
+        auto collect = [this](const Polygonizer::Ring* ring)
+        {
+            std::vector<Coordinate>& coords = rings_.emplace_back();
+            RingCoordinateIterator iter(ring);
+            for (int count = iter.coordinatesRemaining(); count > 0; count--)
+            {
+                coords.push_back(iter.next());
+            }
+        };
+        for (const Polygonizer::Ring* ring = polygonizer.outerRings(); ring; ring = ring->next())
+        {
+            collect(ring);
+            for (const Polygonizer::Ring* inner = ring->firstInner(); inner; inner = inner->next())
+            {
+                collect(inner);
+            }
+        }
+        for (const Polygonizer::Ring* ring = polygonizer.innerRings(); ring; ring = ring->next())
+        {
+            collect(ring);
+        }
+
+        return encodeLevels(entry, true,
+            [this, &polygonizer](const std::vector<std::vector<Coordinate>>& rings)
+        {
+            Coordinate prev(0, 0);
+            size_t n = 0;
+            writeVarint(countRings(polygonizer.outerRings()));
+            for (const Polygonizer::Ring* ring = polygonizer.outerRings(); ring; ring = ring->next())
+            {
+                writeRing(rings[n++], prev);
+                writeVarint(countRings(ring->firstInner()));
+                for (const Polygonizer::Ring* inner = ring->firstInner(); inner; inner = inner->next())
+                {
+                    writeRing(rings[n++], prev);
+                }
+            }
+            writeVarint(countRings(polygonizer.innerRings()));
+            while (n < rings.size()) writeRing(rings[n++], prev);
+        });
+    }
+
+private:
+    /// Simplifies the collected rings (or the line of a way) from their
+    /// original coordinates at each level, and writes the level if it
+    /// has fewer vertexes than the next finer one
+    template<typename Write>
+    bool encodeLevels(Entry& entry, bool isRing, Write&& write)
+    {
+        size_t prevCount = 0;
+        for (const std::vector<Coordinate>& ring : rings_) prevCount += ring.size();
+        uint64_t prevOffset = NO_LEVEL;
+        simplified_.resize(rings_.size());
+        for (int level = 0; level < LEVEL_COUNT; level++)
+        {
+            size_t count = 0;
+            for (size_t i = 0; i < rings_.size(); i++)
+            {
+                simplified_[i] = rings_[i];
+                filter_.simplify(simplified_[i], isRing, levelTolerance(level));
+                count += simplified_[i].size();
+            }
+            if (count < prevCount)
+            {
+                prevOffset = data_.size();
+                prevCount = count;
+                write(simplified_);
+            }
+            entry.offsets[level] = prevOffset;
+        }
+        return entry.offsets[LEVEL_COUNT - 1] != NO_LEVEL;
+    }
+
+    static int countRings(const Polygonizer::Ring* ring)
+    {
+        int count = 0;
+        for (; ring; ring = ring->next()) count++;
+        return count;
+    }
+
+    void writeRing(const std::vector<Coordinate>& coords, Coordinate& prev)
+    {
+        writeVarint(coords.size());
+        for (Coordinate c : coords)
+        {
+            writeVarint(toZigzag(static_cast<int64_t>(c.x) - prev.x));
+            writeVarint(toZigzag(static_cast<int64_t>(c.y) - prev.y));
+            prev = c;
+        }
+    }
+
+    void writeVarint(uint64_t v)
+    {
+        uint8_t buf[16];
+        uint8_t* p = buf;
+        clarisma::writeVarint(p, v);
+        data_.insert(data_.end(), buf, p);
+    }
+
+    std::vector<uint8_t>& data_;
+    CoordinateFilter filter_;
+    std::vector<std::vector<Coordinate>> rings_;
+    std::vector<std::vector<Coordinate>> simplified_;
+};
+
+
+std::unique_ptr<GeneralizedGeometry> GeneralizedGeometry::open(
+    const std::string& fileName, uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<GeneralizedGeometry> geometry(new GeneralizedGeometry());
+    const Header* header = geometry->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "generalized geometry");
+    if (!header) return nullptr;
+    uint64_t size = geometry->file_.size();
+    if (size != sizeof(Header) + header->featureCount * sizeof(Entry) +
+            header->dataSize)
+    {
+        return nullptr;
+    }
+    geometry->entries_ = reinterpret_cast<const Entry*>(header + 1);
+    geometry->featureCount_ = header->featureCount;
+    geometry->data_ = reinterpret_cast<const uint8_t*>(
+        geometry->entries_ + header->featureCount);
+    return geometry;
+}
+
+
+int GeneralizedGeometry::levelFor(double tolerance)
+{
+    for (int level = LEVEL_COUNT - 1; level >= 0; level--)
+    {
+        if (levelTolerance(level) <= tolerance) return level;
+    }
+    return -1;
+}
+
+
+const uint8_t* GeneralizedGeometry::find(FeaturePtr feature, int level) const
+{
+    assert(level >= 0 && level < LEVEL_COUNT);
+    uint64_t typedId = feature.typedId();
+    const Entry* end = entries_ + featureCount_;
+    const Entry* entry = std::lower_bound(entries_, end, typedId,
+        [](const Entry& e, uint64_t id) { return e.typedId < id; });
+    if (entry == end || entry->typedId != typedId) return nullptr;
+    uint64_t offset = entry->offsets[level];
+    return offset == NO_LEVEL ? nullptr : data_ + offset;
+}
+
+
+bool GeneralizedGeometry::wayCoordinates(WayPtr way, int level,
+    std::vector<Coordinate>& coords) const
+{
+    const uint8_t* p = find(way, level);
+    if (!p) return false;
+    size_t count = readVarint64(p);
+    coords.resize(count);
+    Coordinate prev(0, 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t x = static_cast<int32_t>(prev.x + readSignedVarint64(p));
+        int32_t y = static_cast<int32_t>(prev.y + readSignedVarint64(p));
+        prev = Coordinate(x, y);
+        coords[i] = prev;
+    }
+    return true;
+}
+
+
+std::shared_ptr<const Polygonizer> GeneralizedGeometry::relationRings(
+    RelationPtr relation, int level) const
+{
+    const uint8_t* p = find(relation, level);
+    return p ? RingStore::decode(p) : nullptr;
+}
+
+
+namespace {
+
+/// Calls `fn` for each feature in the given index of a tile (only for
+/// the copy without multi-tile flags, so each feature is visited once).
+/// Walks the index the same way as RingStore.
+template<typename Fn>
+void forEachFeature(DataPtr pTile, FeatureIndexType indexType, Fn&& fn)
+{
+    auto walkBranch = [&fn](DataPtr pEntry, auto& self) -> void
+    {
+        int32_t ptr = pEntry.getInt();
+        if (ptr == 0) return;
+        DataPtr p = pEntry + (ptr & 0xffff'fffc);
+        if ((ptr & 2) == 0)
+        {
+            for (;;)
+            {
+                self(p, self);
+                if (p.getInt() & 1) break;
+                p += 20;
+            }
+            return;
+        }
+        for (;;)
+        {
+            FeaturePtr pFeature(p + 16);
+            int32_t flags = pFeature.flags();
+            if ((flags & (FeatureFlags::MULTITILE_WEST | FeatureFlags::MULTITILE_NORTH)) == 0)
+            {
+                fn(pFeature);
+            }
+            if (flags & 1) break;
+            p += 32;
+        }
+    };
+
+    DataPtr ppRoot = pTile + 8 + static_cast<int>(indexType) * 4;
+    int32_t ptr = ppRoot.getInt();
+    if (ptr == 0) return;
+    if ((ptr & 1) == 0)
+    {
+        walkBranch(ppRoot, walkBranch);
+        return;
+    }
+    DataPtr p = ppRoot + (ptr ^ 1);
+    for (;;)
+    {
+        int32_t last = p.getInt() & 1;
+        walkBranch(p, walkBranch);
+        if (last != 0) break;
+        p += 8;
+    }
+}
+
+} // namespace
+
+
+/**
+ * Works like RingStore::build(): each thread claims the next tile in
+ * turn and encodes the levels of its ways and area relations into a
+ * buffer of its own; the buffers are then written one after the other,
+ * followed by the sorted table of entries.
+ */
+void GeneralizedGeometry::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize, int threads)
+{
+    struct Batch
+    {
+        std::vector<uint8_t> data;
+        std::vector<Entry> entries;
+    };
+
+    std::vector<Tip> tips;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        tips.push_back(walker.currentTip());
+    }
+
+    if (threads <= 0) threads = store->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tips.size()), 1));
+    std::vector<Batch> batches(threadCount);
+    std::atomic<size_t> nextTile(0);
+    auto encodeAll = [store, &tips, &nextTile](Batch* batch)
+    {
+        Encoder encoder(batch->data);
+        auto encodeFeature = [store, batch, &encoder](FeaturePtr feature)
+        {
+            Entry entry;
+            entry.typedId = feature.typedId();
+            bool stored;
+            if (feature.isWay())
+            {
+                stored = encoder.encode(WayPtr(feature), entry);
+            }
+            else
+            {
+                RingCache::RingsRef rings = RingCache::polygonize(
+                    store, RelationPtr(feature));
+                stored = encoder.encode(*rings, entry);
+            }
+            if (stored) batch->entries.push_back(entry);
+        };
+
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tips.size()) return;
+            DataPtr pTile = store->fetchTile(tips[n]);
+            forEachFeature(pTile, FeatureIndexType::WAYS, encodeFeature);
+            forEachFeature(pTile, FeatureIndexType::AREAS, encodeFeature);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(encodeAll, &batches[i]);
+    }
+    encodeAll(&batches[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    std::vector<Entry> entries;
+    uint64_t dataSize = 0;
+    for (const Batch& batch : batches)
+    {
+        for (Entry entry : batch.entries)
+        {
+            for (uint64_t& offset : entry.offsets)
+            {
+                if (offset != NO_LEVEL) offset += dataSize;
+            }
+            entries.push_back(entry);
+        }
+        dataSize += batch.data.size();
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.typedId < b.typedId; });
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        entries.size(), dataSize };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(entries.data(), entries.size() * sizeof(Entry));
+    for (const Batch& batch : batches)
+    {
+        file.write(batch.data.data(), batch.data.size());
+    }
+    file.commit();
+}
+
+} // namespace geodesk
@@ -9,18 +9,53 @@
 
 namespace geodesk {
 
+namespace {
+
+/// Per-thread scratch space, so building a geometry doesn't allocate
+/// anything but the GEOS objects themselves
+struct Scratch
+{
+	std::vector<Coordinate> coords;
+	std::vector<double> xy;
+};
+
+thread_local Scratch scratch;
+
+} // namespace
+
+
+std::vector<Coordinate>& GeometryBuilder::scratchCoordinates()
+{
+	return scratch.coords;
+}
+
+
+GEOSCoordSequence* GeometryBuilder::createCoordSequence(
+	const Coordinate* coords, size_t count, GEOSContextHandle_t geosContext)
+{
+	std::vector<double>& xy = scratch.xy;
+	if (xy.size() < count * 2) xy.resize(count * 2);
+	double* p = xy.data();
+	for (size_t i = 0; i < count; i++)
+	{
+		p[i * 2] = coords[i].x;
+		p[i * 2 + 1] = coords[i].y;
+	}
+	return GEOSCoordSeq_copyFromBuffer_r(geosContext, p,
+		static_cast<unsigned int>(count), 0, 0);	// no Z, no M
+}
+
+
 GEOSGeometry* GeometryBuilder::buildWayGeometry(const FeaturePtr way, GEOSContextHandle_t geosContext)
 {
 	WayCoordinateIterator iter;
 	int areaFlag = way.flags() & FeatureFlags::AREA;
 	iter.start(way, areaFlag);
-	int count = iter.storedCoordinatesRemaining() + (areaFlag ? 1 : 0);
-	GEOSCoordSequence* coordSeq = GEOSCoordSeq_create_r(geosContext, count, 2);  // 2D points
-	for (int i=0; i<count; i++)
-	{
-		Coordinate c = iter.next();
-		GEOSCoordSeq_setXY_r(geosContext, coordSeq, i, c.x, c.y);
-	}
+	std::vector<Coordinate>& coords = scratch.coords;
+	size_t count = iter.coordinatesRemaining();
+	if (coords.size() < count) coords.resize(count);
+	iter.decodeAll(coords.data());
+	GEOSCoordSequence* coordSeq = createCoordSequence(coords.data(), count, geosContext);
 	if (areaFlag)
 	{
 		GEOSGeometry* exteriorRing = GEOSGeom_createLinearRing_r(geosContext, coordSeq);
@@ -32,31 +67,29 @@ GEOSGeometry* GeometryBuilder::buildWayGeometry(const FeaturePtr way, GEOSContex
 	}
 }
 
-// TODO: consolidate with buildPointGeometry
 GEOSGeometry* GeometryBuilder::buildNodeGeometry(const NodePtr node, GEOSContextHandle_t geosContext)
 {
-	GEOSCoordSequence* coordSeq = GEOSCoordSeq_create_r(geosContext, 1, 2);  // 1 point, 2D (X and Y)
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 0, node.x(), node.y());
-	return GEOSGeom_createPoint_r(geosContext, coordSeq);
+	return buildPointGeometry(node.x(), node.y(), geosContext);
 }
 
 GEOSGeometry* GeometryBuilder::buildPointGeometry(int32_t x, int32_t y, GEOSContextHandle_t geosContext)
 {
-	GEOSCoordSequence* coordSeq = GEOSCoordSeq_create_r(geosContext, 1, 2);  // 1 point, 2D (X and Y)
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 0, x, y);
-	return GEOSGeom_createPoint_r(geosContext, coordSeq);
+	return GEOSGeom_createPointFromXY_r(geosContext, x, y);
 }
 
 
 GEOSGeometry* GeometryBuilder::buildBoxGeometry(const Box& box, GEOSContextHandle_t geosContext)
 {
-	GEOSCoordSequence* coordSeq = GEOSCoordSeq_create_r(geosContext, 5, 2);  // 5 points, 2D
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 0, box.minX(), box.minY());
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 1, box.minX(), box.maxY());
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 2, box.maxX(), box.maxY());
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 3, box.maxX(), box.minY());
-	GEOSCoordSeq_setXY_r(geosContext, coordSeq, 4, box.minX(), box.minY());
-	GEOSGeometry* exteriorRing = GEOSGeom_createLinearRing_r(geosContext, coordSeq);
+	Coordinate coords[5] =
+	{
+		{ box.minX(), box.minY() },
+		{ box.minX(), box.maxY() },
+		{ box.maxX(), box.maxY() },
+		{ box.maxX(), box.minY() },
+		{ box.minX(), box.minY() }
+	};
+	GEOSGeometry* exteriorRing = GEOSGeom_createLinearRing_r(geosContext,
+		createCoordSequence(coords, 5, geosContext));
 	return GEOSGeom_createPolygon_r(geosContext, exteriorRing, NULL, 0);
 }
 
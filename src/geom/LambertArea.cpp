@@ -3,6 +3,7 @@
 
 #include "geom/LambertArea.h"
 #include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/polygon/RingCache.h>
 #include "geom/polygon/RingCoordinateIterator.h"
 
 namespace geodesk {
@@ -29,20 +30,12 @@ double LambertArea::ofRelation(FeatureStore* store, const RelationPtr relation)
     assert(relation.isArea());
     double totalArea = 0;
 
-    Polygonizer polygonizer;
-    polygonizer.createRings(store, relation);
-    const Polygonizer::Ring* ring = polygonizer.outerRings();
-    while (ring)
+    RingCache::RingsRef rings = RingCache::polygonize(store, relation, false);
+    rings->forEachRing([&totalArea](const Polygonizer::Ring* ring, bool isOuter)
     {
-        totalArea += LambertArea::ofRing(ring);
-        ring = ring->next();
-    }
-    ring = polygonizer.innerRings();
-    while (ring)
-    {
-        totalArea -= LambertArea::ofRing(ring);
-        ring = ring->next();
-    }
+        double area = LambertArea::ofRing(ring);
+        totalArea += isOuter ? area : -area;
+    });
     return totalArea;
 }
 
@@ -2,40 +2,193 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/geom/Length.h>
+#include <algorithm>
+#include <cmath>
 #include <geodesk/feature/FastMemberIterator.h>
+#include <geodesk/feature/RelationTreeCache.h>
 #include <geodesk/feature/WayCoordinateIterator.h>
 #include <geodesk/geom/Distance.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define GEODESK_LENGTH_SSE2
+#endif
 
 namespace geodesk {
 
-double Length::ofWay(WayPtr way)
+namespace {
+
+/// The scale (meters per Mercator unit) at the boundaries of the
+/// latitude bands, by distance from the equator (|y|)
+class ScaleTable
+{
+public:
+    static constexpr int BAND_BITS = 21;
+    static constexpr int BAND_COUNT = 1 << (31 - BAND_BITS);
+    static constexpr double BANDS_PER_UNIT = 1.0 / (1 << BAND_BITS);
+
+    ScaleTable()
+    {
+        // The boundaries of all bands, plus one more, since |y|
+        // reaches 2^31 (the upper boundary of the last band)
+        for (int i = 0; i < BAND_COUNT + 2; i++)
+        {
+            scales_[i] = Mercator::metersPerUnitAtY(
+                static_cast<double>(i) * (1 << BAND_BITS));
+        }
+    }
+
+    /// `band` is |y| * BANDS_PER_UNIT
+    double scale(double band) const
+    {
+        int i = static_cast<int>(band);
+        double lower = scales_[i];
+        return lower + (scales_[i+1] - lower) * (band - i);
+    }
+
+    const double* scales() const { return scales_; }
+
+    static const ScaleTable& get()
+    {
+        static const ScaleTable table;
+        return table;
+    }
+
+private:
+    double scales_[BAND_COUNT + 2];
+};
+
+} // namespace
+
+
+double Length::ofCoords(const Coordinate* coords, int count, Scale scale)
+{
+    double d = 0;
+    if (scale == Scale::EXACT)
+    {
+        for (int i = 1; i < count; i++)
+        {
+            d += Distance::metersBetween(coords[i-1], coords[i]);
+        }
+        return d;
+    }
+
+    const ScaleTable& table = ScaleTable::get();
+    int segmentCount = count - 1;
+    int i = 0;
+#if defined(GEODESK_LENGTH_SSE2)
+    // Measures segments i and i+1, whose ends are loaded as
+    // (x0,y0,x1,y1) and (x1,y1,x2,y2)
+    const __m128d half = _mm_set1_pd(0.5 * ScaleTable::BANDS_PER_UNIT);
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    __m128d sum = _mm_setzero_pd();
+    for (; i + 2 <= segmentCount; i += 2)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coords + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(coords + i + 1));
+        __m128d a0 = _mm_cvtepi32_pd(a);                             // x0, y0
+        __m128d a1 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(a, a));      // x1, y1
+        __m128d b0 = _mm_cvtepi32_pd(b);                             // x1, y1
+        __m128d b1 = _mm_cvtepi32_pd(_mm_unpackhi_epi64(b, b));      // x2, y2
+        __m128d d0 = _mm_sub_pd(b0, a0);
+        __m128d d1 = _mm_sub_pd(b1, a1);
+        d0 = _mm_mul_pd(d0, d0);
+        d1 = _mm_mul_pd(d1, d1);
+        __m128d lengths = _mm_sqrt_pd(_mm_add_pd(
+            _mm_unpacklo_pd(d0, d1), _mm_unpackhi_pd(d0, d1)));
+        __m128d band = _mm_mul_pd(_mm_add_pd(
+            _mm_unpackhi_pd(a0, a1), _mm_unpackhi_pd(b0, b1)), half);
+        band = _mm_andnot_pd(signMask, band);
+        __m128i index = _mm_cvttpd_epi32(band);
+        __m128d fraction = _mm_sub_pd(band, _mm_cvtepi32_pd(index));
+        const double* p0 = table.scales() + _mm_cvtsi128_si32(index);
+        const double* p1 = table.scales() + _mm_cvtsi128_si32(
+            _mm_shuffle_epi32(index, 1));
+        __m128d lower = _mm_set_pd(p1[0], p0[0]);
+        __m128d upper = _mm_set_pd(p1[1], p0[1]);
+        __m128d scales = _mm_add_pd(lower,
+            _mm_mul_pd(_mm_sub_pd(upper, lower), fraction));
+        sum = _mm_add_pd(sum, _mm_mul_pd(lengths, scales));
+    }
+    d = _mm_cvtsd_f64(sum) + _mm_cvtsd_f64(_mm_unpackhi_pd(sum, sum));
+#endif
+    for (; i < segmentCount; i++)
+    {
+        Coordinate p1 = coords[i];
+        Coordinate p2 = coords[i+1];
+        double xDelta = static_cast<double>(p1.x) - p2.x;
+        double yDelta = static_cast<double>(p1.y) - p2.y;
+        double band = std::abs((static_cast<double>(p1.y) + p2.y) *
+            (0.5 * ScaleTable::BANDS_PER_UNIT));
+        d += std::sqrt(xDelta * xDelta + yDelta * yDelta) * table.scale(band);
+    }
+    return d;
+}
+
+
+double Length::ofWay(WayPtr way, Scale scale)
 {
+    // The last coordinate of each block is carried over as the
+    // first of the next, so the segment between them is measured
     double d = 0;
     WayCoordinateIterator iter(way);
-    Coordinate p1 = iter.next();
-    for (;;)
+    Coordinate coords[WayCoordinateIterator::BATCH_SIZE + 1];
+    int count = iter.decode(coords, WayCoordinateIterator::BATCH_SIZE);
+    while (count > 1)
     {
-        Coordinate p2 = iter.next();
-        if (p2.isNull()) break;
-        d += Distance::metersBetween(p1, p2);
-        p1 = p2;
+        d += ofCoords(coords, count, scale);
+        coords[0] = coords[count-1];
+        count = iter.decode(coords + 1, WayCoordinateIterator::BATCH_SIZE) + 1;
     }
     return d;
 }
 
+/**
+ * Returns a lower bound for the length of a way, based on its bounding
+ * box: a line that touches all four sides of the box is at least as
+ * long as the box's diagonal (twice that if the line is closed). The
+ * scale is taken at the latitude that is farthest from the equator,
+ * where a Mercator unit represents the fewest meters (less the
+ * greatest error of the interpolated scale, so the bound holds for
+ * Scale::FAST as well).
+ */
+double Length::minOfWay(WayPtr way)
+{
+    Box bounds = way.bounds();
+    double width = static_cast<double>(bounds.maxX()) - bounds.minX();
+    double height = static_cast<double>(bounds.maxY()) - bounds.minY();
+    double y = std::max(std::abs(static_cast<double>(bounds.minY())),
+        std::abs(static_cast<double>(bounds.maxY())));
+    double d = std::sqrt(width * width + height * height) *
+        Mercator::metersPerUnitAtY(y);
+    d *= 1 - MAX_TABLE_ERROR;
+    return way.isArea() ? d * 2 : d;
+}
+
 // TODO: Define in spec: what's the "length" of an Area-Relation?
 // Circumference without holes? Right now, we simply add up all the ways
 
-double Length::ofRelation(FeatureStore* store, RelationPtr relation)
+double Length::ofRelation(FeatureStore* store, RelationPtr relation, Scale scale)
 {
+	if (auto leaves = RelationTreeCache::leavesOf(store, relation))
+	{
+		double totalLength = 0;
+		for (FeaturePtr leaf : *leaves)
+		{
+			if (leaf.isWay()) totalLength += ofWay(WayPtr(leaf), scale);
+		}
+		return totalLength;
+	}
 	RecursionGuard guard(relation);
-	return ofRelation(store, relation, guard);
+	TileCache tiles;
+	return ofRelation(store, relation, guard, tiles, scale);
 }
 
-double Length::ofRelation(FeatureStore *store, RelationPtr rel, RecursionGuard &guard)
+// All members of the relation tree share one TileCache
+double Length::ofRelation(FeatureStore *store, RelationPtr rel,
+	RecursionGuard &guard, TileCache& tiles, Scale scale)
 {
 	double totalLength = 0;
-	FastMemberIterator iter(store, rel);
+	FastMemberIterator iter(store, rel, &tiles);
 	for (;;)
 	{
 		FeaturePtr member = iter.next();
@@ -43,14 +196,14 @@ double Length::ofRelation(FeatureStore *store, RelationPtr rel, RecursionGuard &
 		int memberType = member.typeCode();
 		if (memberType == 1)
 		{
-			totalLength += ofWay(WayPtr(member));		// This is placeholder-safe
+			totalLength += ofWay(WayPtr(member), scale);		// This is placeholder-safe
 		}
 		else if (memberType == 2)
 		{
 			RelationPtr childRel(member);
 			if (guard.checkAndAdd(childRel))
 			{
-				totalLength += ofRelation(store, childRel, guard);		// This is placeholder-safe
+				totalLength += ofRelation(store, childRel, guard, tiles, scale);		// This is placeholder-safe
 			}
 		}
 	}
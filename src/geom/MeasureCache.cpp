@@ -0,0 +1,100 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/MeasureCache.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/geom/Area.h>
+#include <geodesk/geom/Length.h>
+
+namespace geodesk {
+
+MeasureCache::MeasureCache(size_t maxBytes) :
+    maxEntries_(std::max<size_t>(maxBytes / BYTES_PER_ENTRY, 1)),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+/**
+ * The value is measured without holding the lock, so two threads that
+ * need the same relation at the same time may both measure it.
+ */
+template<typename Measure>
+double MeasureCache::get(int64_t id, double Entry::* field, Measure measure)
+{
+    {
+        std::lock_guard lock(mutex_);
+        auto it = entries_.find(id);
+        if (it != entries_.end() && !std::isnan(it->second.*field))
+        {
+            return it->second.*field;
+        }
+    }
+    double value = measure();
+    std::lock_guard lock(mutex_);
+    auto it = entries_.find(id);
+    if (it == entries_.end())
+    {
+        if (entries_.size() >= maxEntries_) entries_.clear();
+        constexpr double NONE = std::numeric_limits<double>::quiet_NaN();
+        it = entries_.emplace(id, Entry{ NONE, NONE }).first;
+    }
+    it->second.*field = value;
+    return value;
+}
+
+
+double MeasureCache::length(FeatureStore* store, RelationPtr relation)
+{
+    return get(relation.idBits(), &Entry::length, [store, relation]()
+    {
+        return Length::ofRelation(store, relation);
+    });
+}
+
+
+double MeasureCache::area(FeatureStore* store, RelationPtr relation)
+{
+    return get(relation.idBits(), &Entry::area, [store, relation]()
+    {
+        return Area::ofRelation(store, relation);
+    });
+}
+
+
+size_t MeasureCache::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return entries_.size() * BYTES_PER_ENTRY;
+}
+
+void MeasureCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    entries_.clear();
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+
+double MeasureCache::lengthOf(FeatureStore* store, RelationPtr relation)
+{
+    MeasureCache* cache = store->measureCache();
+    if (cache) return cache->length(store, relation);
+    return Length::ofRelation(store, relation);
+}
+
+
+double MeasureCache::areaOf(FeatureStore* store, RelationPtr relation)
+{
+    MeasureCache* cache = store->measureCache();
+    if (cache) return cache->area(store, relation);
+    return Area::ofRelation(store, relation);
+}
+
+} // namespace geodesk
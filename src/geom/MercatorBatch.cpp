@@ -0,0 +1,181 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/MercatorBatch.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define GEODESK_MERCATOR_SSE2
+#endif
+
+namespace geodesk {
+
+namespace {
+
+/// The unrounded Y-coordinate of the given latitude
+double exactY(double lat)
+{
+    return std::log(std::tan((lat + 90.0) * M_PI / 360.0)) *
+        (Mercator::MAP_WIDTH / 2.0 / M_PI);
+}
+
+/// The Y-coordinate (and its slope) at every 0.1 degrees of latitude,
+/// by distance from the equator (the projection is symmetric)
+class LatitudeTable
+{
+public:
+    static constexpr int STEPS_PER_DEGREE = 10;
+    static constexpr int BAND_COUNT = 852;       // up to 85.2 degrees
+
+    LatitudeTable()
+    {
+        constexpr double h = M_PI / 180.0 / STEPS_PER_DEGREE;   // in radians
+        for (int i = 0; i <= BAND_COUNT; i++)
+        {
+            double lat = static_cast<double>(i) / STEPS_PER_DEGREE;
+            double phi = lat * M_PI / 180.0;
+            double sec = 1 / std::cos(phi);
+            double tan = std::tan(phi);
+            y_[i] = exactY(lat);
+            // dy/dphi is sec(phi), scaled to the width of a band
+            slope_[i] = sec * h * (Mercator::MAP_WIDTH / 2.0 / M_PI);
+            if (i > 0)
+            {
+                // The error of cubic Hermite interpolation is at most
+                // h^4/384 times the largest 4th derivative in the band,
+                // which is sec*tan*(tan^2 + 5*sec^2) at its upper end
+                // (plus a little, for rounding)
+                double d4 = sec * tan * (tan * tan + 5 * sec * sec);
+                maxError_[i-1] = h * h * h * h / 384 * d4 *
+                    (Mercator::MAP_WIDTH / 2.0 / M_PI) + 1e-6;
+            }
+        }
+    }
+
+    /// The number of bands (starting at the equator) whose
+    /// interpolation error lies within the given bound
+    int bandsWithin(double error) const
+    {
+        // The error grows with the latitude
+        return static_cast<int>(std::upper_bound(maxError_, maxError_ + BAND_COUNT,
+            error) - maxError_);
+    }
+
+    /// `band` is |lat| * STEPS_PER_DEGREE, within the first BAND_COUNT bands
+    double y(double band) const
+    {
+        int i = static_cast<int>(band);
+        double u = band - i;
+        double u2 = u * u;
+        double u3 = u2 * u;
+        return (2 * u3 - 3 * u2 + 1) * y_[i] + (u3 - 2 * u2 + u) * slope_[i] +
+            (3 * u2 - 2 * u3) * y_[i+1] + (u3 - u2) * slope_[i+1];
+    }
+
+    static const LatitudeTable& get()
+    {
+        static const LatitudeTable table;
+        return table;
+    }
+
+private:
+    double y_[BAND_COUNT + 1];
+    double slope_[BAND_COUNT + 1];
+    double maxError_[BAND_COUNT];
+};
+
+double clampedLat(double lat)
+{
+    return std::clamp(lat, Mercator::MIN_LAT, Mercator::MAX_LAT);
+}
+
+} // namespace
+
+
+void MercatorBatch::coordsFromLonLat(std::span<const double> lonLat,
+    std::span<Coordinate> out, double maxError)
+{
+    size_t count = lonLat.size() / 2;
+    assert(out.size() >= count);
+    const double* p = lonLat.data();
+    Coordinate* pOut = out.data();
+
+    // Rounding the interpolated value may add another imp of error
+    const LatitudeTable& table = LatitudeTable::get();
+    double fastLimit = maxError < 1 ? -1 : static_cast<double>(
+        table.bandsWithin(maxError - 1)) / LatitudeTable::STEPS_PER_DEGREE;
+
+    constexpr double X_PER_DEGREE = Mercator::MAP_WIDTH / 360.0;
+    size_t i = 0;
+#if defined(GEODESK_MERCATOR_SSE2)
+    if (fastLimit > 0)
+    {
+        const __m128d xPerDegree = _mm_set1_pd(X_PER_DEGREE);
+        for (; i + 2 <= count; i += 2)
+        {
+            double lat0 = clampedLat(p[i * 2 + 1]);
+            double lat1 = clampedLat(p[i * 2 + 3]);
+            double absLat0 = std::abs(lat0);
+            double absLat1 = std::abs(lat1);
+            if (absLat0 >= fastLimit || absLat1 >= fastLimit) [[unlikely]]
+            {
+                pOut[i] = Coordinate::ofLonLat(p[i * 2], lat0);
+                pOut[i+1] = Coordinate::ofLonLat(p[i * 2 + 2], lat1);
+                continue;
+            }
+            __m128d lons = _mm_unpacklo_pd(_mm_loadu_pd(p + i * 2),
+                _mm_loadu_pd(p + i * 2 + 2));
+            __m128i x = _mm_cvtpd_epi32(_mm_mul_pd(lons, xPerDegree));
+            double y0 = table.y(absLat0 * LatitudeTable::STEPS_PER_DEGREE);
+            double y1 = table.y(absLat1 * LatitudeTable::STEPS_PER_DEGREE);
+            __m128i y = _mm_cvtpd_epi32(_mm_set_pd(
+                lat1 < 0 ? -y1 : y1, lat0 < 0 ? -y0 : y0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + i),
+                _mm_unpacklo_epi32(x, y));
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        double lon = p[i * 2];
+        double lat = clampedLat(p[i * 2 + 1]);
+        double absLat = std::abs(lat);
+        if (absLat < fastLimit)
+        {
+            double y = table.y(absLat * LatitudeTable::STEPS_PER_DEGREE);
+            pOut[i] = Coordinate(lon * X_PER_DEGREE, lat < 0 ? -y : y);
+        }
+        else
+        {
+            pOut[i] = Coordinate::ofLonLat(lon, lat);
+        }
+    }
+}
+
+
+void MercatorBatch::boxesAroundXY(std::span<const Coordinate> points,
+    int32_t units, std::span<Box> out)
+{
+    assert(out.size() >= points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        out[i] = Box::unitsAroundXY(units, points[i]);
+    }
+}
+
+
+void MercatorBatch::boxesAroundMeters(std::span<const Coordinate> points,
+    double meters, std::span<Box> out)
+{
+    assert(out.size() >= points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        Coordinate pt = points[i];
+        double d = Mercator::unitsFromMeters(meters, pt.y);
+        out[i] = Box::unitsAroundXY(static_cast<int32_t>(std::ceil(d)), pt);
+    }
+}
+
+} // namespace geodesk
@@ -0,0 +1,94 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/index/CoverageGrid.h>
+#include <algorithm>
+#include <cmath>
+
+namespace geodesk {
+
+/**
+ * The grid has about 4 cells per chain in each direction (between
+ * 32 and 128). Two neighbouring cells that don't touch any chain lie
+ * on the same side of the boundary, so we only need to locate a single
+ * point for each run of such cells within a row.
+ */
+CoverageGrid::CoverageGrid(const MCIndex& index, const Box& bounds) :
+    CoverageGrid()
+{
+    if (index.chainCount() < MIN_CHAIN_COUNT || bounds.isEmpty()) return;
+    int size = std::clamp(static_cast<int>(std::sqrt(
+        static_cast<double>(index.chainCount()))) * 4, 32, 128);
+    bounds_ = bounds;
+    cols_ = size;
+    rows_ = size;
+    cellWidth_ = (bounds.widthSimple() + size) / size;
+    cellHeight_ = (static_cast<int64_t>(bounds.height()) + size) / size;
+    cells_.resize(static_cast<size_t>(cols_) * rows_);
+
+    Cell* p = cells_.data();
+    for (int row = 0; row < rows_; row++)
+    {
+        Cell run = BOUNDARY;
+        for (int col = 0; col < cols_; col++)
+        {
+            Box cell = cellBounds(col, row);
+            if (index.findChains<const Box*>(cell, anyChain, &cell))
+            {
+                run = BOUNDARY;
+            }
+            else if (run == BOUNDARY)
+            {
+                run = index.locatePoint(cell.bottomLeft()) > 0 ? INSIDE : OUTSIDE;
+            }
+            *p++ = run;
+        }
+    }
+}
+
+
+bool CoverageGrid::anyChain(const RTree<const MonotoneChain>::Node* /* node */,
+    const Box* /* cell */)
+{
+    return true;
+}
+
+
+Box CoverageGrid::cellBounds(int col, int row) const
+{
+    int64_t minX = bounds_.minX() + col * cellWidth_;
+    int64_t minY = bounds_.minY() + row * cellHeight_;
+    return Box(
+        static_cast<int32_t>(minX),
+        static_cast<int32_t>(minY),
+        static_cast<int32_t>(std::min<int64_t>(minX + cellWidth_ - 1, bounds_.maxX())),
+        static_cast<int32_t>(std::min<int64_t>(minY + cellHeight_ - 1, bounds_.maxY())));
+}
+
+
+int CoverageGrid::locateBox(const Box& box) const
+{
+    if (isEmpty()) return 0;
+    if (!box.intersects(bounds_)) return OUTSIDE;
+        // (the polygon lies within the bounds of the grid)
+    if (!bounds_.containsSimple(box)) return 0;
+    int colStart = static_cast<int>((box.minX() - static_cast<int64_t>(bounds_.minX())) / cellWidth_);
+    int colEnd = static_cast<int>((box.maxX() - static_cast<int64_t>(bounds_.minX())) / cellWidth_);
+    int rowStart = static_cast<int>((box.minY() - static_cast<int64_t>(bounds_.minY())) / cellHeight_);
+    int rowEnd = static_cast<int>((box.maxY() - static_cast<int64_t>(bounds_.minY())) / cellHeight_);
+    if (colEnd - colStart >= MAX_CELL_SPAN || rowEnd - rowStart >= MAX_CELL_SPAN) return 0;
+
+    Cell first = cells_[static_cast<size_t>(rowStart) * cols_ + colStart];
+    if (first == BOUNDARY) return 0;
+    for (int row = rowStart; row <= rowEnd; row++)
+    {
+        const Cell* p = &cells_[static_cast<size_t>(row) * cols_];
+        for (int col = colStart; col <= colEnd; col++)
+        {
+            if (p[col] != first) return 0;
+        }
+    }
+    return first;
+}
+
+} // namespace geodesk
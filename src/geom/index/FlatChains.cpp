@@ -0,0 +1,104 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/index/FlatChains.h>
+#include <geodesk/geom/index/MCIndex.h>
+#include <geodesk/geom/index/MonotoneChain.h>
+
+namespace geodesk {
+
+namespace {
+
+bool appendChain(const RTree<const MonotoneChain>::Node* node, FlatChains* flat)
+{
+    const MonotoneChain* chain = node->item();
+    flat->minX.push_back(node->bounds.minX());
+    flat->minY.push_back(node->bounds.minY());
+    flat->maxX.push_back(node->bounds.maxX());
+    flat->maxY.push_back(node->bounds.maxY());
+    const Coordinate* coords = chain->coordinates();
+    for (int i = 0; i < chain->vertexCount(); i++)
+    {
+        flat->x.push_back(coords[i].x);
+        flat->y.push_back(coords[i].y);
+    }
+    flat->chainStarts.push_back(static_cast<uint32_t>(flat->x.size()));
+    return false;
+}
+
+} // namespace
+
+
+FlatChains FlatChains::fromIndex(const MCIndex& index)
+{
+    FlatChains flat;
+    flat.chainStarts.push_back(0);
+    index.findChains(Box::ofWorld(), appendChain, &flat);
+    return flat;
+}
+
+
+/**
+ * Follows MCIndex::locateAgainstChain() step by step, so the result
+ * is the same as that of MCIndex::containsPoint().
+ */
+bool FlatChains::containsPoint(Coordinate c) const
+{
+    uint32_t crossings = 0;
+    size_t count = chainCount();
+    for (size_t i = 0; i < count; i++)
+    {
+        // Only the chains that a ray to the east would hit
+        if (c.y < minY[i] || c.y > maxY[i] || c.x > maxX[i]) continue;
+        uint32_t start = chainStarts[i];
+        uint32_t end = chainStarts[i + 1];
+        if (c.y == maxY[i])
+        {
+            // On a horizontal chain, or on the end vertex of the chain
+            // (a ray through the end vertex is disregarded, as it is
+            // counted by the chain that starts there)
+            if (c.y == minY[i] && c.x >= minX[i]) return true;
+            if (c.x == x[end - 1]) return true;
+            continue;
+        }
+        if (c.x < minX[i])
+        {
+            crossings++;
+            continue;
+        }
+
+        // Find the first segment that ends at or above the point
+        uint32_t lo = start + 1;
+        uint32_t hi = end - 1;
+        while (lo < hi)
+        {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (y[mid] < c.y)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        double x1 = x[lo - 1];
+        double y1 = y[lo - 1];
+        double crossProduct =
+            (c.y - y1) * (x[lo] - x1) - (c.x - x1) * (y[lo] - y1);
+        if (crossProduct == 0) return true;
+        if (crossProduct > 0) crossings++;
+    }
+    return crossings & 1;
+}
+
+
+void FlatChains::containsPoints(std::span<const Coordinate> points, bool* results) const
+{
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        results[i] = containsPoint(points[i]);
+    }
+}
+
+} // namespace geodesk
@@ -4,6 +4,7 @@
 #include <geodesk/geom/index/HilbertTreeBuilder.h>
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <utility>
 #include <geodesk/geom/index/hilbert.h>
 
@@ -118,6 +119,87 @@ const HilbertTreeBuilder::Node* HilbertTreeBuilder::buildNodes(
 }
 
 
+const PackedRTreeGroup* HilbertTreeBuilder::buildGroups(
+	const BoundedItem* items, size_t itemCount, Box totalBounds)
+{
+	typedef PackedRTreeGroup Group;
+
+	if (itemCount == 0) return nullptr;
+	if (totalBounds.isEmpty())
+	{
+		for (const BoundedItem* p = items; p < items + itemCount; p++)
+		{
+			totalBounds.expandToIncludeSimple(p->bounds);
+		}
+	}
+
+	HilbertItem* hilbertItems = buildHilbertIndex(items, itemCount, totalBounds);
+
+	size_t groupCount = calculateTotalNodeCount(itemCount, Group::SIZE) - itemCount;
+	Group* groups = new Group[groupCount];
+
+	// The bounds and pointers of the current level's children
+	// (items at first, then the groups of the level below)
+	std::vector<BoundedItem> children(itemCount);
+	for (size_t i = 0; i < itemCount; i++)
+	{
+		children[i] = *hilbertItems[i].second;
+	}
+	std::vector<BoundedItem> parents;
+
+	// As in buildNodes(), parents are placed before children,
+	// so the root ends up as the first group
+	Group* pLevelEnd = groups + groupCount;
+	uint32_t isLeaf = 1;
+	for (;;)
+	{
+		size_t parentCount = (children.size() + Group::SIZE - 1) / Group::SIZE;
+		Group* pGroup = pLevelEnd - parentCount;
+		Group* pLevelStart = pGroup;
+		parents.clear();
+		for (size_t start = 0; start < children.size(); start += Group::SIZE)
+		{
+			int count = static_cast<int>(std::min<size_t>(Group::SIZE, children.size() - start));
+			Box groupBounds;
+			for (int i = 0; i < Group::SIZE; i++)
+			{
+				if (i < count)
+				{
+					const BoundedItem& child = children[start + i];
+					pGroup->minX[i] = child.bounds.minX();
+					pGroup->minY[i] = child.bounds.minY();
+					pGroup->maxX[i] = child.bounds.maxX();
+					pGroup->maxY[i] = child.bounds.maxY();
+					pGroup->children[i] = child.item;
+					groupBounds.expandToIncludeSimple(child.bounds);
+				}
+				else
+				{
+					// Unused slots are masked off by the search; we
+					// give them empty bounds regardless
+					pGroup->minX[i] = std::numeric_limits<int32_t>::max();
+					pGroup->minY[i] = std::numeric_limits<int32_t>::max();
+					pGroup->maxX[i] = std::numeric_limits<int32_t>::min();
+					pGroup->maxY[i] = std::numeric_limits<int32_t>::min();
+					pGroup->children[i] = nullptr;
+				}
+			}
+			pGroup->count = count;
+			pGroup->isLeaf = isLeaf;
+			parents.push_back({ groupBounds, pGroup });
+			pGroup++;
+		}
+		assert(pGroup == pLevelEnd);
+		pLevelEnd = pLevelStart;
+		isLeaf = 0;
+		if (parentCount == 1) break;
+		std::swap(children, parents);
+	}
+	assert(pLevelEnd == groups);
+	return groups;
+}
+
+
 HilbertTreeBuilder::HilbertItem* HilbertTreeBuilder::buildHilbertIndex(
 	const BoundedItem* items, size_t itemCount, const Box& totalBounds)
 {
@@ -3,7 +3,12 @@
 
 #include <geodesk/geom/index/MCIndex.h>
 #include <geodesk/geom/index/MonotoneChain.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
 #include <clarisma/util/log.h>
+#include <geodesk/geom/PointSegmentDistance.h>
 
 namespace geodesk {
 
@@ -56,23 +61,146 @@ bool MCIndex::pointOnBoundary(Coordinate c) const
 }
 
 
+void MCIndex::containsPoints(std::span<const Coordinate> points, bool* results) const
+{
+	// A group must be small enough so the rays of its points don't
+	// pick up many chains that are irrelevant to most of them
+	constexpr int GROUP_SIZE = 32;
+
+	size_t count = points.size();
+	if (count == 0) return;
+	std::unique_ptr<uint32_t[]> order(new uint32_t[count]);
+	Box bounds;
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = static_cast<uint32_t>(i);
+		bounds.expandToInclude(points[i]);
+	}
+	if (bounds.widthSimple() > 0 && bounds.height() > 0)
+	{
+		std::unique_ptr<uint32_t[]> distances(new uint32_t[count]);
+		for (size_t i = 0; i < count; i++)
+		{
+			distances[i] = hilbert::calculateHilbertDistance(points[i], bounds);
+		}
+		std::sort(order.get(), order.get() + count, [&distances](uint32_t a, uint32_t b)
+		{
+			return distances[a] < distances[b];
+		});
+	}
+	// (If all points lie on a horizontal or vertical line, we keep
+	// them in their original order)
+
+	PointLocation locations[GROUP_SIZE];
+	for (size_t start = 0; start < count; start += GROUP_SIZE)
+	{
+		int groupCount = static_cast<int>(std::min<size_t>(GROUP_SIZE, count - start));
+		PointBatchClosure closure{ points.data(), &order[start], locations, groupCount };
+		Box rays;
+		for (int i = 0; i < groupCount; i++)
+		{
+			locations[i] = PointLocation();
+			rays.expandToInclude(points[closure.indexes[i]]);
+		}
+		index_.search(
+			Box(rays.minX(), rays.minY(), std::numeric_limits<int32_t>::max(), rays.maxY()),
+			countBatchCrossings, &closure);
+		for (int i = 0; i < groupCount; i++)
+		{
+			results[closure.indexes[i]] =
+				locations[i].isInside() || locations[i].isOnBoundary();
+		}
+	}
+}
+
+
+struct MCIndex::DistanceClosure
+{
+	explicit DistanceClosure(Coordinate c) : measure(c),
+		minDistance(std::numeric_limits<double>::infinity()) {}
+
+	PointSegmentDistance measure;
+	double minDistance;
+};
+
+
+double MCIndex::distanceSquared(Coordinate c, double radius) const
+{
+	constexpr double MAX_RADIUS = 4294967296.0;
+	DistanceClosure closure(c);
+	double r = std::max(std::ceil(radius), 1.0);
+	for (;;)
+	{
+		closure.minDistance = std::numeric_limits<double>::infinity();
+		Box box(
+			static_cast<int32_t>(std::max(c.x - r, -2147483648.0)),
+			static_cast<int32_t>(std::max(c.y - r, -2147483648.0)),
+			static_cast<int32_t>(std::min(c.x + r, 2147483647.0)),
+			static_cast<int32_t>(std::min(c.y + r, 2147483647.0)));
+		index_.search(box, measureChain, &closure);
+		// Any segment closer than `r` has a point in the box, and
+		// hence a chain whose bounds intersect it
+		if (closure.minDistance <= r * r || r >= MAX_RADIUS) break;
+		// If we found a segment, the box around it catches all
+		// segments that are closer still; if not, keep widening
+		r = std::isinf(closure.minDistance) ? r * 4 :
+			std::ceil(std::sqrt(closure.minDistance));
+	}
+	return closure.minDistance;
+}
+
+
+bool MCIndex::measureChain(const RTree<const MonotoneChain>::Node* node,
+	DistanceClosure* closure)
+{
+	const MonotoneChain* chain = node->item();
+	closure->minDistance = std::min(closure->minDistance,
+		closure->measure.minSquared(chain->coordinates(), chain->vertexCount()));
+	return false;
+}
+
+
+bool MCIndex::countBatchCrossings(const RTree<const MonotoneChain>::Node* node,
+	PointBatchClosure* closure)
+{
+	const Box& bounds = node->bounds;
+	for (int i = 0; i < closure->count; i++)
+	{
+		PointLocation& location = closure->locations[i];
+		if (location.isOnBoundary()) continue;
+		Coordinate c = closure->points[closure->indexes[i]];
+		// Only consider the chains that the point's own ray
+		// would have found
+		if (c.y < bounds.minY() || c.y > bounds.maxY() || c.x > bounds.maxX()) continue;
+		locateAgainstChain(node, c, location);
+	}
+	return false; // keep going
+}
+
+
 bool MCIndex::countCrossings(const RTree<const MonotoneChain>::Node* node,
 	PointLocationClosure* closure)
 {
-	Coordinate c = closure->point;
+	return locateAgainstChain(node, closure->point, closure->location);
+}
+
+
+bool MCIndex::locateAgainstChain(const RTree<const MonotoneChain>::Node* node,
+	Coordinate c, PointLocation& location)
+{
 	if (c.y == node->bounds.maxY())
 	{
 		if (c.y == node->bounds.minY() && c.x >= node->bounds.minX())
 		{
 			// The point lies on a horizontal segment
-			closure->location.setOnBoundary();
+			location.setOnBoundary();
 			return true;	// stop r-tree search
 		}
 
 		// Check if point is coincident with the end vertex of the chain
 		if (c.x == node->item()->last().x)
 		{
-			closure->location.setOnBoundary();
+			location.setOnBoundary();
 			return true;    // stop r-tree search
 		}
 
@@ -92,7 +220,7 @@ bool MCIndex::countCrossings(const RTree<const MonotoneChain>::Node* node,
 		{
 			// If point lies to the left of the MC's bounding box,
 			// it is guaranteed to cross the MC
-			closure->location.addCrossing();
+			location.addCrossing();
 		}
 		else
 		{
@@ -106,12 +234,12 @@ bool MCIndex::countCrossings(const RTree<const MonotoneChain>::Node* node,
 
 			if (crossProduct == 0)
 			{
-				closure->location.setOnBoundary();
+				location.setOnBoundary();
 				return true;
 			}
 			else if (crossProduct > 0)
 			{
-				closure->location.addCrossing();
+				location.addCrossing();
 			}
 		}
 	}
@@ -2,10 +2,14 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/geom/index/MCIndexBuilder.h>
+#include <algorithm>
+#include <thread>
 #include <geodesk/geom/index/WaySlicer.h>
+#include <geodesk/geom/index/CoordSpanSlicer.h>
 #include <geodesk/geom/index/CoordSequenceSlicer.h>
 #include <geodesk/feature/FeatureStore.h>
 #include <geodesk/feature/MemberIterator.h>
+#include <geodesk/feature/NodePtr.h>
 #include <geodesk/feature/FastMemberIterator.h>
 #include <geodesk/geom/index/HilbertTreeBuilder.h>
 
@@ -41,8 +45,70 @@ void MCIndexBuilder::segmentizeWay(WayPtr way)
 	while (slicer.hasMore());
 }
 
+/**
+ * Slices a sequence of at least 2 coordinates (such as a ring that
+ * didn't come from a feature) into chains.
+ */
+void MCIndexBuilder::segmentizeCoords(std::span<const Coordinate> coords)
+{
+	assert(coords.size() >= 2);
+	CoordSpanSlicer slicer(coords);
+	do
+	{
+		MCHolder* holder = arena_.allocWithExplicitSize<MCHolder>(
+			MCHolder::storageSize(MAX_VERTEX_COUNT));
+		slicer.slice(&holder->chain, MAX_VERTEX_COUNT);
+		// Give back the unused space to the Arena
+		int unusedVertexes = MAX_VERTEX_COUNT - holder->chain.vertexCount();
+		arena_.reduceLastAlloc(unusedVertexes * sizeof(Coordinate));
+		holder->next = first_;
+		first_ = holder;
+		chainCount_++;
+		totalChainSize_ += holder->chain.storageSize();
+	}
+	while (slicer.hasMore());
+}
+
+/**
+ * Splits the ways into runs of roughly equal length, each of which
+ * is sliced by its own builder (the first on the calling thread);
+ * build() then collects the chains of all builders.
+ */
+void MCIndexBuilder::segmentizeWaysParallel(const std::vector<WayPtr>& ways, int threadCount)
+{
+	size_t partCount = std::min(static_cast<size_t>(threadCount),
+		ways.size() / MIN_WAYS_PER_THREAD);
+	for (size_t i = 0; i < partCount; i++)
+	{
+		parts_.push_back(std::make_unique<MCIndexBuilder>());
+	}
+	auto slice = [&ways, partCount](MCIndexBuilder* part, size_t n)
+	{
+		size_t start = ways.size() * n / partCount;
+		size_t end = ways.size() * (n + 1) / partCount;
+		for (size_t i = start; i < end; i++) part->segmentizeWay(ways[i]);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(partCount - 1);
+	for (size_t n = 1; n < partCount; n++)
+	{
+		threads.emplace_back(slice, parts_[n].get(), n);
+	}
+	slice(parts_[0].get(), 0);
+	for (std::thread& thread : threads) thread.join();
+
+	for (const std::unique_ptr<MCIndexBuilder>& part : parts_)
+	{
+		chainCount_ += part->chainCount_;
+		totalChainSize_ += part->totalChainSize_;
+	}
+}
+
+
 void MCIndexBuilder::segmentizeAreaRelation(FeatureStore* store, RelationPtr rel)
 {
+	std::vector<WayPtr> ways;
 	FastMemberIterator iter(store, rel);
 	for (;;)
 	{
@@ -51,10 +117,20 @@ void MCIndexBuilder::segmentizeAreaRelation(FeatureStore* store, RelationPtr rel
 		if (member.isWay())
 		{
 			WayPtr way(member);
-			if(!way.isPlaceholder()) segmentizeWay(way);
+			if(!way.isPlaceholder()) ways.push_back(way);
 		}
 	}
 
+	int threadCount = store->executor().threadCount();
+	if (ways.size() >= MIN_PARALLEL_WAY_COUNT && threadCount > 1)
+	{
+		segmentizeWaysParallel(ways, threadCount);
+	}
+	else
+	{
+		for (WayPtr way : ways) segmentizeWay(way);
+	}
+
 	// If no ways were extracted, attempt to extract any features
 	// (i.e. treat like non-area relation)
 
@@ -92,6 +168,29 @@ void MCIndexBuilder::segmentizeMembers(FeatureStore* store, RelationPtr rel, Rec
 	}
 }
 
+void MCIndexBuilder::segmentizeMemberNodes(FeatureStore* store, RelationPtr rel, RecursionGuard& guard)
+{
+	FastMemberIterator iter(store, rel);
+	for (;;)
+	{
+		FeaturePtr member = iter.next();
+		if (member.isNull()) break;
+		int memberType = member.typeCode();
+		if (memberType == 0)
+		{
+			NodePtr memberNode(member);
+			if (memberNode.isPlaceholder()) continue;
+			addLineSegment(memberNode.xy(), memberNode.xy());
+		}
+		else if (memberType == 2)
+		{
+			RelationPtr childRel(member);
+			if (childRel.isPlaceholder() || !guard.checkAndAdd(childRel)) continue;
+			segmentizeMemberNodes(store, childRel, guard);
+		}
+	}
+}
+
 // TODO: must be able to deal with empty areas (i.e. chainCount_ == 0)
 MCIndex MCIndexBuilder::build(Box bounds)
 {
@@ -99,25 +198,32 @@ MCIndex MCIndexBuilder::build(Box bounds)
 	assert(totalChainSize_ > 0);
 	uint8_t* data = new uint8_t[totalChainSize_];
 	BoundedItem* boundedItems = arena_.allocArray<BoundedItem>(chainCount_);
-	const MCHolder* holder = first_;
 	BoundedItem* p = boundedItems;
 	uint8_t* pNextNormalizedChain = data;
-	while (holder)
-	{
-		MonotoneChain* pNormalizedChain = reinterpret_cast<MonotoneChain*>(pNextNormalizedChain);
-		holder->chain.copyNormalized(pNormalizedChain);
-		pNextNormalizedChain += pNormalizedChain->storageSize();
-		p->item = pNormalizedChain;
-		p->bounds = pNormalizedChain->bounds();
-		p++;
-		holder = holder->next;
+	auto copyChains = [&p, &pNextNormalizedChain](const MCHolder* holder)
+	{
+		while (holder)
+		{
+			MonotoneChain* pNormalizedChain = reinterpret_cast<MonotoneChain*>(pNextNormalizedChain);
+			holder->chain.copyNormalized(pNormalizedChain);
+			pNextNormalizedChain += pNormalizedChain->storageSize();
+			p->item = pNormalizedChain;
+			p->bounds = pNormalizedChain->bounds();
+			p++;
+			holder = holder->next;
+		}
+	};
+	copyChains(first_);
+	for (const std::unique_ptr<MCIndexBuilder>& part : parts_)
+	{
+		copyChains(part->first_);
 	}
 	assert(pNextNormalizedChain == data + totalChainSize_);
 	assert(p == boundedItems + chainCount_);
 
 	HilbertTreeBuilder indexBuilder(&arena_);
-	return MCIndex(data, indexBuilder.build<const MonotoneChain>(
-		boundedItems, chainCount_, 9, bounds));
+	return MCIndex(data, indexBuilder.buildPacked<const MonotoneChain>(
+		boundedItems, chainCount_, bounds), chainCount_);
 }
 
 #ifdef GEODESK_WITH_GEOS
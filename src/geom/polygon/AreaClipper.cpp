@@ -0,0 +1,469 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/polygon/AreaClipper.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+namespace {
+
+using ChainNode = RTree<const MonotoneChain>::Node;
+
+/// A place where a segment meets the boundary of the other polygon,
+/// or a stretch along which the two run on top of each other
+/// (t is the position along the segment, from 0 to 1)
+struct Overlap
+{
+    double start;
+    double end;
+    bool sameDirection;
+};
+
+struct SegmentClosure
+{
+    Coordinate p;
+    Coordinate q;
+    const std::vector<const MonotoneChain*>* reversedChains;
+    std::vector<double>* cuts;
+    std::vector<Overlap>* overlaps;
+};
+
+struct PointClosure
+{
+    double x;
+    double y;
+    int crossings;
+};
+
+inline double cross(double ax, double ay, double bx, double by)
+{
+    return ax * by - ay * bx;
+}
+
+/// Finds the places where the segment p-q meets the chain's segments
+bool cutSegment(const ChainNode* node, SegmentClosure* closure)
+{
+    const MonotoneChain* chain = node->item();
+    const Coordinate* coords = chain->coordinates();
+    int count = chain->vertexCount();
+    Coordinate p = closure->p;
+    Coordinate q = closure->q;
+    Box segBounds = Box::normalizedSimple(p, q);
+    double dx = static_cast<double>(q.x) - p.x;
+    double dy = static_cast<double>(q.y) - p.y;
+    double lenSquared = dx * dx + dy * dy;
+    bool reversed = closure->reversedChains &&
+        std::binary_search(closure->reversedChains->begin(),
+            closure->reversedChains->end(), chain);
+
+    for (int i = 1; i < count; i++)
+    {
+        Coordinate a = coords[i - 1];
+        Coordinate b = coords[i];
+        if (!segBounds.intersects(Box::normalizedSimple(a, b))) continue;
+        double ax = static_cast<double>(a.x) - p.x;
+        double ay = static_cast<double>(a.y) - p.y;
+        double ex = static_cast<double>(b.x) - a.x;
+        double ey = static_cast<double>(b.y) - a.y;
+        double denom = cross(dx, dy, ex, ey);
+        if (denom == 0)
+        {
+            if (cross(ax, ay, dx, dy) != 0) continue;   // parallel
+            double ta = (ax * dx + ay * dy) / lenSquared;
+            double tb = ((ax + ex) * dx + (ay + ey) * dy) / lenSquared;
+            double lo = std::max(0.0, std::min(ta, tb));
+            double hi = std::min(1.0, std::max(ta, tb));
+            if (hi < lo) continue;
+            closure->cuts->push_back(lo);
+            if (hi > lo)
+            {
+                closure->cuts->push_back(hi);
+                bool same = (dx * ex + dy * ey > 0) != reversed;
+                closure->overlaps->push_back({ lo, hi, same });
+            }
+            continue;
+        }
+        double t = cross(ax, ay, ex, ey) / denom;
+        double u = cross(ax, ay, dx, dy) / denom;
+        if (t >= 0 && t <= 1 && u >= 0 && u <= 1) closure->cuts->push_back(t);
+    }
+    return false;
+}
+
+/// Counts the crossings of the chain's segments east of the point
+bool countCrossings(const ChainNode* node, PointClosure* closure)
+{
+    const MonotoneChain* chain = node->item();
+    const Coordinate* coords = chain->coordinates();
+    int count = chain->vertexCount();
+    double x = closure->x;
+    double y = closure->y;
+    for (int i = 1; i < count; i++)
+    {
+        Coordinate a = coords[i - 1];
+        Coordinate b = coords[i];
+        if ((a.y > y) == (b.y > y)) continue;
+        double xCross = a.x + (y - a.y) * (static_cast<double>(b.x) - a.x) /
+            (static_cast<double>(b.y) - a.y);
+        if (xCross > x) closure->crossings++;
+    }
+    return false;
+}
+
+bool collectChain(const ChainNode* node, std::vector<const MonotoneChain*>* chains)
+{
+    chains->push_back(node->item());
+    return false;
+}
+
+/// Point-in-polygon test in floating point (the midpoints of the
+/// pieces of a clipped segment rarely fall on integer coordinates)
+bool containsPoint(const MCIndex& index, double x, double y)
+{
+    PointClosure closure{ x, y, 0 };
+    Box box(static_cast<int32_t>(std::max(std::floor(x), -2147483648.0)),
+        static_cast<int32_t>(std::max(std::floor(y), -2147483648.0)),
+        std::numeric_limits<int32_t>::max(),
+        static_cast<int32_t>(std::min(std::ceil(y), 2147483647.0)));
+    index.findChains(box, countCrossings, &closure);
+    return closure.crossings & 1;
+}
+
+double signedArea(std::span<const Coordinate> ring)
+{
+    double sum = 0;
+    double x0 = ring[0].x;
+    double y0 = ring[0].y;
+    for (size_t i = 1; i < ring.size(); i++)
+    {
+        sum += cross(ring[i - 1].x - x0, ring[i - 1].y - y0,
+            ring[i].x - x0, ring[i].y - y0);
+    }
+    return sum / 2;
+}
+
+/// Clips oriented segments against a polygon, summing the
+/// contributions (x0 * y1 - x1 * y0) / 2 of the pieces that lie inside
+/// it, relative to a common origin. Whether a piece lies inside can
+/// only change where the segment meets the polygon's boundary, so the
+/// point-in-polygon test is only needed after such a place.
+class SegmentClipper
+{
+public:
+    SegmentClipper(const MCIndex& other,
+        const std::vector<const MonotoneChain*>* reversedChains,
+        bool keepSameDirection, double originX, double originY) :
+        other_(other),
+        reversedChains_(reversedChains),
+        keepSameDirection_(keepSameDirection),
+        originX_(originX),
+        originY_(originY),
+        state_(UNKNOWN),
+        sum_(0)
+    {
+    }
+
+    /// Must be called before a segment that doesn't continue the
+    /// previous one
+    void restart() { state_ = UNKNOWN; }
+
+    /// Marks the segment as lying outside the polygon's bounds
+    void skip() { state_ = OUTSIDE; }
+
+    void clip(Coordinate p, Coordinate q)
+    {
+        if (p == q) return;
+        cuts_.clear();
+        overlaps_.clear();
+        SegmentClosure closure{ p, q, reversedChains_, &cuts_, &overlaps_ };
+        other_.findChains(Box::normalizedSimple(p, q), cutSegment, &closure);
+        std::sort(cuts_.begin(), cuts_.end());
+
+        double dx = static_cast<double>(q.x) - p.x;
+        double dy = static_cast<double>(q.y) - p.y;
+        size_t nextCut = 0;
+        double start = 0;
+        for (;;)
+        {
+            if (nextCut < cuts_.size() && cuts_[nextCut] <= start)
+            {
+                // The segment meets the boundary here
+                state_ = UNKNOWN;
+                while (nextCut < cuts_.size() && cuts_[nextCut] <= start) nextCut++;
+            }
+            if (start >= 1) break;
+            double end = nextCut < cuts_.size() ? cuts_[nextCut] : 1;
+            double mid = (start + end) / 2;
+            bool inside;
+            const Overlap* overlap = findOverlap(mid);
+            if (overlap)
+            {
+                inside = keepSameDirection_ && overlap->sameDirection;
+                state_ = UNKNOWN;
+            }
+            else
+            {
+                if (state_ == UNKNOWN)
+                {
+                    state_ = containsPoint(other_, p.x + dx * mid, p.y + dy * mid) ?
+                        INSIDE : OUTSIDE;
+                }
+                inside = state_ == INSIDE;
+            }
+            if (inside)
+            {
+                double x0 = p.x - originX_ + dx * start;
+                double y0 = p.y - originY_ + dy * start;
+                double x1 = p.x - originX_ + dx * end;
+                double y1 = p.y - originY_ + dy * end;
+                sum_ += cross(x0, y0, x1, y1) / 2;
+            }
+            start = end;
+        }
+    }
+
+    double sum() const { return sum_; }
+
+private:
+    enum State { UNKNOWN, OUTSIDE, INSIDE };
+
+    const Overlap* findOverlap(double t) const
+    {
+        for (const Overlap& overlap : overlaps_)
+        {
+            if (t > overlap.start && t < overlap.end) return &overlap;
+        }
+        return nullptr;
+    }
+
+    const MCIndex& other_;
+    const std::vector<const MonotoneChain*>* reversedChains_;
+    bool keepSameDirection_;
+    double originX_;
+    double originY_;
+    State state_;
+    double sum_;
+    std::vector<double> cuts_;
+    std::vector<Overlap> overlaps_;
+};
+
+} // namespace
+
+
+void AreaClipper::Rings::add(std::vector<Coordinate>& ring, bool isOuter)
+{
+    // Drop repeated coordinates, and close the ring
+    ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    if (ring.size() > 1 && ring.front() == ring.back()) ring.pop_back();
+    if (ring.size() < 3) return;
+    ring.push_back(ring.front());
+    double area = signedArea(ring);
+    if (area == 0) return;
+    if ((area > 0) != isOuter) std::reverse(ring.begin(), ring.end());
+    for (Coordinate c : ring) bounds.expandToInclude(c);
+    coords.insert(coords.end(), ring.begin(), ring.end());
+    ends.push_back(static_cast<uint32_t>(coords.size()));
+}
+
+
+AreaClipper::Rings AreaClipper::ringsOf(FeatureStore* store, FeaturePtr feature)
+{
+    Rings rings;
+    std::vector<Coordinate> ring;
+    if (!feature.isArea()) return rings;
+    if (feature.isWay())
+    {
+        WayCoordinateIterator iter;
+        iter.start(feature, FeatureFlags::AREA);
+        ring.resize(iter.coordinatesRemaining());
+        ring.resize(iter.decodeAll(ring.data()));
+        rings.add(ring, true);
+    }
+    else if (feature.isRelation())
+    {
+        RingCache::RingsRef polygon = RingCache::polygonize(
+            store, RelationPtr(feature), false);
+        polygon->forEachRing([&rings, &ring](const Polygonizer::Ring* r, bool isOuter)
+        {
+            RingCoordinateIterator iter(r);
+            ring.clear();
+            while (iter.coordinatesRemaining() > 0) ring.push_back(iter.next());
+            rings.add(ring, isOuter);
+        });
+    }
+    return rings;
+}
+
+
+AreaClipper::Rings AreaClipper::ringsOf(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes)
+{
+    Rings rings;
+    std::vector<Coordinate> ring(shell.begin(), shell.end());
+    rings.add(ring, true);
+    for (const std::vector<Coordinate>& hole : holes)
+    {
+        ring.assign(hole.begin(), hole.end());
+        rings.add(ring, false);
+    }
+    return rings;
+}
+
+
+AreaClipper::AreaClipper(FeatureStore* store, FeaturePtr region)
+{
+    prepare(ringsOf(store, region));
+}
+
+
+AreaClipper::AreaClipper(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes)
+{
+    prepare(ringsOf(shell, holes));
+}
+
+
+/// Builds the index of the region's rings, and notes which of its
+/// chains were reversed when the index normalized them (a chain runs
+/// along its ring if its first segment is one of the ring's edges)
+void AreaClipper::prepare(Rings&& region)
+{
+    if (region.count() == 0) return;
+    MCIndexBuilder builder;
+    std::vector<std::pair<int64_t, int64_t>> edges;
+    for (size_t i = 0; i < region.count(); i++)
+    {
+        std::span<const Coordinate> ring = region.ring(i);
+        builder.segmentizeCoords(ring);
+        for (size_t j = 1; j < ring.size(); j++)
+        {
+            edges.emplace_back(static_cast<int64_t>(ring[j - 1]),
+                static_cast<int64_t>(ring[j]));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    bounds_ = region.bounds;
+    index_ = builder.build(bounds_);
+
+    std::vector<const MonotoneChain*> chains;
+    index_.findChains(bounds_, collectChain, &chains);
+    for (const MonotoneChain* chain : chains)
+    {
+        const Coordinate* coords = chain->coordinates();
+        std::pair<int64_t, int64_t> first(static_cast<int64_t>(coords[0]),
+            static_cast<int64_t>(coords[1]));
+        if (!std::binary_search(edges.begin(), edges.end(), first))
+        {
+            reversedChains_.push_back(chain);
+        }
+    }
+    std::sort(reversedChains_.begin(), reversedChains_.end());
+}
+
+
+bool AreaClipper::isReversed(const MonotoneChain* chain) const
+{
+    return std::binary_search(reversedChains_.begin(), reversedChains_.end(), chain);
+}
+
+
+double AreaClipper::clip(const Rings& rings) const
+{
+    if (rings.count() == 0 || isEmpty()) return 0;
+    int location = index_.locateBox(rings.bounds);
+    if (location < 0) return 0;
+    Coordinate center = rings.bounds.center();
+    double originX = center.x;
+    double originY = center.y;
+
+    // The boundary pieces of the polygon that lie inside the region
+    // (where the two share a boundary, the pieces count if both
+    // interiors lie on the same side)
+    SegmentClipper inner(index_, &reversedChains_, true, originX, originY);
+    double fullRings = 0;
+    for (size_t i = 0; i < rings.count(); i++)
+    {
+        std::span<const Coordinate> ring = rings.ring(i);
+        if (location == 0)
+        {
+            Box ringBounds;
+            for (Coordinate c : ring) ringBounds.expandToInclude(c);
+            int ringLocation = index_.locateBox(ringBounds);
+            if (ringLocation < 0) continue;
+            if (ringLocation == 0)
+            {
+                inner.restart();
+                for (size_t j = 1; j < ring.size(); j++) inner.clip(ring[j - 1], ring[j]);
+                continue;
+            }
+        }
+        // The ring lies entirely inside the region
+        fullRings += signedArea(ring);
+    }
+    if (location > 0) return fullRings;
+
+    // The boundary pieces of the region that lie inside the polygon
+    // (pieces along the polygon's boundary have already been counted)
+    std::vector<const MonotoneChain*> chains;
+    index_.findChains(rings.bounds, collectChain, &chains);
+    double regionPieces = 0;
+    if (!chains.empty())
+    {
+        MCIndexBuilder builder;
+        for (size_t i = 0; i < rings.count(); i++) builder.segmentizeCoords(rings.ring(i));
+        MCIndex polygonIndex = builder.build(rings.bounds);
+        SegmentClipper outer(polygonIndex, nullptr, false, originX, originY);
+        for (const MonotoneChain* chain : chains)
+        {
+            const Coordinate* coords = chain->coordinates();
+            int count = chain->vertexCount();
+            bool reversed = isReversed(chain);
+            outer.restart();
+            for (int j = 1; j < count; j++)
+            {
+                Coordinate p = reversed ? coords[count - j] : coords[j - 1];
+                Coordinate q = reversed ? coords[count - j - 1] : coords[j];
+                if (!rings.bounds.intersects(Box::normalizedSimple(p, q)))
+                {
+                    outer.skip();
+                    continue;
+                }
+                outer.clip(p, q);
+            }
+        }
+        regionPieces = outer.sum();
+    }
+    return fullRings + inner.sum() + regionPieces;
+}
+
+
+double AreaClipper::mercatorAreaOf(FeatureStore* store, FeaturePtr feature) const
+{
+    return clip(ringsOf(store, feature));
+}
+
+
+double AreaClipper::mercatorAreaOf(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes) const
+{
+    return clip(ringsOf(shell, holes));
+}
+
+
+double AreaClipper::areaOf(FeatureStore* store, FeaturePtr feature) const
+{
+    if (!feature.isArea()) return 0;
+    int32_t avgY = clarisma::Math::avg(feature.minY(), feature.maxY());
+    double scale = Mercator::metersPerUnitAtY(avgY);
+    return mercatorAreaOf(store, feature) * scale * scale;
+}
+
+} // namespace geodesk
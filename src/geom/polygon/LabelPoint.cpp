@@ -0,0 +1,195 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/polygon/LabelPoint.h>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Centroid.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+#include <geodesk/geom/polygon/LabelPointCache.h>
+#include <geodesk/geom/polygon/RingCache.h>
+#include "geom/polygon/RingCoordinateIterator.h"
+
+namespace geodesk {
+
+namespace {
+
+/// An initial grid of at most this many cells per side (the cells are
+/// square, so a long, thin area would otherwise need a great many)
+constexpr double MAX_INITIAL_CELLS = 64;
+
+struct Cell
+{
+    double x;
+    double y;
+    double half;            // half the size of the cell
+    double distance;        // from the center to the boundary (negative
+                            // if the center lies outside)
+    double potential;       // the greatest distance of any point in the cell
+
+    bool operator<(const Cell& other) const
+    {
+        return potential < other.potential;
+    }
+};
+
+Cell probe(const MCIndex& index, double x, double y, double half)
+{
+    Coordinate c(
+        static_cast<int32_t>(std::clamp(std::round(x), -2147483648.0, 2147483647.0)),
+        static_cast<int32_t>(std::clamp(std::round(y), -2147483648.0, 2147483647.0)));
+    double distance = std::sqrt(index.distanceSquared(c, half));
+    if (!index.containsPoint(c)) distance = -distance;
+    return { x, y, half, distance, distance + half * 1.4142135623730951 };
+}
+
+/// Adds a ring to the index (closing it if needed)
+void addRing(MCIndexBuilder& builder, Box& bounds, std::vector<Coordinate>& ring)
+{
+    if (ring.size() < 3) return;
+    if (ring.front() != ring.back()) ring.push_back(ring.front());
+    for (Coordinate c : ring) bounds.expandToInclude(c);
+    builder.segmentizeCoords(ring);
+}
+
+/// The centroid of a ring (or its first vertex, if it has no area),
+/// relative to the first vertex to retain precision
+Coordinate centroidOf(std::span<const Coordinate> ring)
+{
+    double x0 = ring[0].x;
+    double y0 = ring[0].y;
+    double sum = 0;
+    double cx = 0;
+    double cy = 0;
+    for (size_t i = 1; i < ring.size(); i++)
+    {
+        double x1 = ring[i - 1].x - x0;
+        double y1 = ring[i - 1].y - y0;
+        double x2 = ring[i].x - x0;
+        double y2 = ring[i].y - y0;
+        double a = x1 * y2 - x2 * y1;
+        sum += a;
+        cx += (x1 + x2) * a;
+        cy += (y1 + y2) * a;
+    }
+    if (sum == 0) return ring[0];
+    return Coordinate(
+        static_cast<int32_t>(std::round(x0 + cx / (3 * sum))),
+        static_cast<int32_t>(std::round(y0 + cy / (3 * sum))));
+}
+
+} // namespace
+
+
+Coordinate LabelPoint::search(const MCIndex& index, const Box& bounds,
+    Coordinate guess, double precision)
+{
+    double width = static_cast<double>(bounds.maxX()) - bounds.minX();
+    double height = static_cast<double>(bounds.maxY()) - bounds.minY();
+    double cellSize = std::max(std::min(width, height),
+        std::max(width, height) / MAX_INITIAL_CELLS);
+    if (cellSize <= 0) return guess;
+    precision = std::max(precision, 1.0);
+
+    std::priority_queue<Cell> queue;
+    double half = cellSize / 2;
+    for (double x = bounds.minX(); x < bounds.maxX(); x += cellSize)
+    {
+        for (double y = bounds.minY(); y < bounds.maxY(); y += cellSize)
+        {
+            queue.push(probe(index, x + half, y + half, half));
+        }
+    }
+
+    Cell best = probe(index, guess.x, guess.y, 0);
+    Coordinate center = bounds.center();
+    Cell centerCell = probe(index, center.x, center.y, 0);
+    if (centerCell.distance > best.distance) best = centerCell;
+
+    while (!queue.empty())
+    {
+        Cell cell = queue.top();
+        queue.pop();
+        if (cell.distance > best.distance) best = cell;
+        // Cells come in order of their potential, so if this one
+        // can't beat the best point, neither can any of the others
+        if (cell.potential - best.distance <= precision) break;
+        half = cell.half / 2;
+        if (half < 0.5) continue;   // below the resolution of coordinates
+        queue.push(probe(index, cell.x - half, cell.y - half, half));
+        queue.push(probe(index, cell.x + half, cell.y - half, half));
+        queue.push(probe(index, cell.x - half, cell.y + half, half));
+        queue.push(probe(index, cell.x + half, cell.y + half, half));
+    }
+    return Coordinate(static_cast<int32_t>(std::round(best.x)),
+        static_cast<int32_t>(std::round(best.y)));
+}
+
+
+Coordinate LabelPoint::ofRings(std::span<const Coordinate> shell,
+    std::span<const std::vector<Coordinate>> holes, double precision)
+{
+    if (shell.empty()) return {};
+    MCIndexBuilder builder;
+    Box bounds;
+    std::vector<Coordinate> ring(shell.begin(), shell.end());
+    addRing(builder, bounds, ring);
+    for (const std::vector<Coordinate>& hole : holes)
+    {
+        ring.assign(hole.begin(), hole.end());
+        addRing(builder, bounds, ring);
+    }
+    Coordinate guess = centroidOf(shell);
+    if (bounds.isEmpty()) return guess;
+    MCIndex index = builder.build(bounds);
+    return search(index, bounds, guess, precision);
+}
+
+
+Coordinate LabelPoint::ofArea(FeatureStore* store, FeaturePtr area, double precision)
+{
+    assert(area.isArea());
+    MCIndexBuilder builder;
+    Box bounds;
+    std::vector<Coordinate> ring;
+    if (area.isWay())
+    {
+        WayCoordinateIterator iter;
+        iter.start(area, FeatureFlags::AREA);
+        ring.resize(iter.coordinatesRemaining());
+        ring.resize(iter.decodeAll(ring.data()));
+        addRing(builder, bounds, ring);
+    }
+    else
+    {
+        RingCache::RingsRef polygon = RingCache::polygonize(
+            store, RelationPtr(area), false);
+        polygon->forEachRing([&builder, &bounds, &ring](const Polygonizer::Ring* r, bool)
+        {
+            RingCoordinateIterator iter(r);
+            ring.clear();
+            while (iter.coordinatesRemaining() > 0) ring.push_back(iter.next());
+            addRing(builder, bounds, ring);
+        });
+    }
+    Coordinate guess = Centroid::ofFeature(store, area);
+    if (bounds.isEmpty()) return guess;
+    MCIndex index = builder.build(bounds);
+    double metersPerUnit = Mercator::metersPerUnitAtY(bounds.center().y);
+    return search(index, bounds, guess, precision / metersPerUnit);
+}
+
+
+Coordinate LabelPoint::ofFeature(FeatureStore* store, FeaturePtr feature)
+{
+    if (!feature.isArea()) return Centroid::ofFeature(store, feature);
+    LabelPointCache* cache = store->labelPointCache();
+    if (cache) return cache->get(store, feature);
+    return ofArea(store, feature);
+}
+
+} // namespace geodesk
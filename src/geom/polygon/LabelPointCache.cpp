@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/polygon/LabelPointCache.h>
+#include <algorithm>
+#include <geodesk/geom/polygon/LabelPoint.h>
+
+namespace geodesk {
+
+LabelPointCache::LabelPointCache(size_t maxBytes) :
+    maxEntries_(std::max<size_t>(maxBytes / BYTES_PER_ENTRY, 1)),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+/**
+ * The point is found without holding the lock, so two threads that
+ * need the same area at the same time may both search for it.
+ */
+Coordinate LabelPointCache::get(FeatureStore* store, FeaturePtr area)
+{
+    int64_t id = area.idBits();
+    {
+        std::lock_guard lock(mutex_);
+        auto it = entries_.find(id);
+        if (it != entries_.end()) return it->second;
+    }
+    Coordinate point = LabelPoint::ofArea(store, area);
+    std::lock_guard lock(mutex_);
+    if (entries_.size() >= maxEntries_) entries_.clear();
+    entries_[id] = point;
+    return point;
+}
+
+
+size_t LabelPointCache::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return entries_.size() * BYTES_PER_ENTRY;
+}
+
+void LabelPointCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    entries_.clear();
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+} // namespace geodesk
@@ -31,13 +31,7 @@ Polygonizer::Segment* Polygonizer::createSegment(WayPtr way, Segment* next)
 	seg->status = Segment::SEGMENT_UNASSIGNED;
 	seg->backward = false;
 	seg->vertexCount = vertexCount;
-	Coordinate* p = seg->coords;
-    Coordinate* end = p + vertexCount;
-	do
-	{
-		*p++ = iter.next();
-	} 
-	while (p < end);
+	iter.decodeAll(seg->coords);
 	return seg;
 }
 
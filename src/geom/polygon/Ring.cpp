@@ -4,29 +4,28 @@
 #include "Ring.h"
 #include <geodesk/geom/polygon/PointInPolygon.h>
 #include "Segment.h"
+#ifdef GEODESK_WITH_GEOS
+#include <geodesk/geom/GeometryBuilder.h>
+#endif
 
 namespace geodesk {
 
 #ifdef GEODESK_WITH_GEOS
 GEOSCoordSequence* Polygonizer::Ring::createCoordSequence(GEOSContextHandle_t context)
 {
-    GEOSCoordSequence* coordSeq = GEOSCoordSeq_create_r(context, vertexCount_, 2);
-    if (coordSeq)
+    std::vector<Coordinate>& coords = GeometryBuilder::scratchCoordinates();
+    if (coords.size() < static_cast<size_t>(vertexCount_)) coords.resize(vertexCount_);
+    Segment* seg = firstSegment_;
+    Coordinate* p = coords.data();
+    *p++ = seg->backward ? seg->coords[seg->vertexCount - 1] : seg->coords[0];
+    do
     {
-        Segment* seg = firstSegment_;
-        Coordinate first = seg->backward ? seg->coords[seg->vertexCount - 1] : seg->coords[0];
-        GEOSCoordSeq_setXY_r(context, coordSeq, 0, first.x, first.y);
-        int pos = 1;
-        do
-        {
-            seg->copyTo(context, coordSeq, pos);
-            pos += seg->vertexCount - 1;
-            seg = seg->next;
-        }
-        while (seg);
-        assert(pos == vertexCount_);
+        p = seg->copyTo(p);
+        seg = seg->next;
     }
-    return coordSeq;
+    while (seg);
+    assert(p - coords.data() == vertexCount_);
+    return GeometryBuilder::createCoordSequence(coords.data(), vertexCount_, context);
 }
 
 GEOSGeometry* Polygonizer::Ring::createLinearRing(GEOSContextHandle_t context)
@@ -72,6 +72,26 @@ private:
     friend class Polygonizer;
     friend class RingAssigner;
     friend class RingMerger;
+    friend class RingCache;
+    friend class RingStore;
     friend class RingCoordinateIterator;
 };
+
+template<typename Fn>
+void Polygonizer::forEachRing(Fn&& fn) const
+{
+    for (const Ring* ring = outerRings_; ring; ring = ring->next())
+    {
+        fn(ring, true);
+        for (const Ring* inner = ring->firstInner(); inner; inner = inner->next())
+        {
+            fn(inner, false);
+        }
+    }
+    for (const Ring* ring = innerRings_; ring; ring = ring->next())
+    {
+        fn(ring, false);
+    }
+}
+
 } // namespace geodesk
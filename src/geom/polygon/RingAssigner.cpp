@@ -2,9 +2,68 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include "RingAssigner.h"
+#include <geodesk/geom/index/HilbertTreeBuilder.h>
 
 namespace geodesk {
 
-// (everything in .h)
+// Same logic as assignRing(), but only for the outer rings whose
+// bounds intersect those of the inner ring
+bool Polygonizer::RingAssigner::checkCandidate(
+    const RTree<Ring>::Node* node, Candidates* candidates)
+{
+    Ring* tryOuter = node->item();
+    if (!tryOuter->containsBoundsOf(candidates->inner)) return false;
+    if (candidates->tentativeOuter &&
+        candidates->tentativeOuter->contains(candidates->inner))
+    {
+        candidates->outer = candidates->tentativeOuter;
+        return true;
+    }
+    candidates->tentativeOuter = tryOuter;
+    return false;
+}
+
+
+/**
+ * Relations such as country boundaries or coastlines may have thousands
+ * of outer rings, which makes testing each inner ring against all of
+ * them quadratic. Instead, we index the bounds of the outer rings
+ * (except the largest, which remains the default) in a Hilbert R-tree.
+ */
+void Polygonizer::RingAssigner::assignRingsIndexed(Ring** outerRings,
+    int outerCount, Ring* firstInner, clarisma::Arena& arena)
+{
+    BoundedItem* items = arena.allocArray<BoundedItem>(outerCount - 1);
+    for (int i = 1; i < outerCount; i++)
+    {
+        items[i - 1].bounds = outerRings[i]->bounds_;
+        items[i - 1].item = outerRings[i];
+    }
+    HilbertTreeBuilder treeBuilder(&arena);
+    RTree<Ring> tree = treeBuilder.build<Ring>(items, outerCount - 1, 9, Box());
+
+    Ring* inner = firstInner;
+    do
+    {
+        inner->calculateBounds();
+        Ring* next = inner->next();
+        Candidates candidates = { inner, nullptr, nullptr };
+        if (!tree.search(inner->bounds_, &checkCandidate, &candidates))
+        {
+            if (candidates.tentativeOuter &&
+                candidates.tentativeOuter->contains(inner))
+            {
+                candidates.outer = candidates.tentativeOuter;
+            }
+            else
+            {
+                candidates.outer = outerRings[0];
+            }
+        }
+        candidates.outer->addInner(inner);
+        inner = next;
+    }
+    while (inner);
+}
 
 } // namespace geodesk
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <geodesk/geom/polygon/Polygonizer.h>
+#include <geodesk/geom/index/RTree.h>
 #include "Ring.h"
 
 namespace geodesk {
@@ -93,6 +94,12 @@ public:
             outerRings[i]->calculateBounds();
         }
         
+        if (outerCount >= MIN_INDEXED_OUTER_COUNT)
+        {
+            assignRingsIndexed(outerRings, outerCount, firstInner, arena);
+            return;
+        }
+
         Ring* inner = firstInner;
         do
         {
@@ -106,6 +113,21 @@ public:
         while (inner);
     }
 
+private:
+    /// With this many outer rings (or more), candidates for each inner
+    /// ring are found via an R-tree instead of checking every outer
+    static constexpr int MIN_INDEXED_OUTER_COUNT = 32;
+
+    struct Candidates
+    {
+        Ring* inner;
+        Ring* tentativeOuter;
+        Ring* outer;
+    };
+
+    static bool checkCandidate(const RTree<Ring>::Node* node, Candidates* candidates);
+    static void assignRingsIndexed(Ring** outerRings, int outerCount,
+        Ring* firstInner, clarisma::Arena& arena);
 };
 
 
@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/polygon/RingCache.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/geom/polygon/RingStore.h>
+#include "Ring.h"
+#include "Segment.h"
+
+namespace geodesk {
+
+RingCache::RingCache(size_t maxBytes) :
+    maxBytes_(maxBytes),
+    bytes_(0),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+/**
+ * Rings taken from the store's RingStore (if it has one) always have
+ * their holes assigned, which is fine for callers that don't need this.
+ */
+RingCache::RingsRef RingCache::assemble(FeatureStore* store,
+    RelationPtr relation, bool assignHoles)
+{
+    const RingStore* ringStore = store->ringStore();
+    if (ringStore)
+    {
+        RingsRef rings = ringStore->get(relation.id());
+        if (rings) return rings;
+    }
+    std::shared_ptr<Polygonizer> rings = std::make_shared<Polygonizer>();
+    rings->createRings(store, relation);
+    if (assignHoles) rings->assignAndMergeHoles();
+    return rings;
+}
+
+
+/**
+ * Estimates the memory used by the assembled rings, based on the
+ * segments they are made of (segments that could not be placed into
+ * any ring, and the arena's unused space, are not counted).
+ */
+size_t RingCache::bytesOf(const Polygonizer& rings)
+{
+    size_t bytes = sizeof(Polygonizer) + sizeof(Entry) + 64;
+        // (approximate overhead of the list node and map entry)
+    rings.forEachRing([&bytes](const Polygonizer::Ring* ring, bool)
+    {
+        bytes += sizeof(Polygonizer::Ring);
+        for (const Polygonizer::Segment* seg = ring->firstSegment_;
+            seg; seg = seg->next)
+        {
+            bytes += Polygonizer::Segment::sizeWithVertexCount(seg->vertexCount);
+        }
+    });
+    return bytes;
+}
+
+
+/**
+ * The rings are assembled without holding the lock, so two threads that
+ * need the same relation at the same time may both polygonize it (the
+ * second one simply uses the rings of the first). Rings that would
+ * exceed the entire budget are returned, but not cached.
+ */
+RingCache::RingsRef RingCache::get(FeatureStore* store, RelationPtr relation)
+{
+    int64_t id = relation.idBits();
+    {
+        std::lock_guard lock(mutex_);
+        auto it = ids_.find(id);
+        if (it != ids_.end())
+        {
+            entries_.splice(entries_.begin(), entries_, it->second);
+            return it->second->rings;
+        }
+    }
+    RingsRef rings = assemble(store, relation, true);
+    size_t bytes = bytesOf(*rings);
+    if (bytes > maxBytes_) return rings;
+    std::lock_guard lock(mutex_);
+    auto it = ids_.find(id);
+    if (it != ids_.end()) return it->second->rings;
+    while (bytes_ + bytes > maxBytes_)
+    {
+        const Entry& oldest = entries_.back();
+        bytes_ -= oldest.bytes;
+        ids_.erase(oldest.id);
+        entries_.pop_back();
+    }
+    entries_.push_front({ id, rings, bytes });
+    ids_.emplace(id, entries_.begin());
+    bytes_ += bytes;
+    return rings;
+}
+
+
+size_t RingCache::bytes()
+{
+    std::lock_guard lock(mutex_);
+    return bytes_;
+}
+
+void RingCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard lock(mutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    entries_.clear();
+    ids_.clear();
+    bytes_ = 0;
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+
+RingCache::RingsRef RingCache::polygonize(FeatureStore* store,
+    RelationPtr relation, bool assignHoles)
+{
+    RingCache* cache = store->ringCache();
+    if (cache) return cache->get(store, relation);
+    return assemble(store, relation, assignHoles);
+}
+
+} // namespace geodesk
@@ -0,0 +1,365 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/geom/polygon/RingStore.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/query/TileIndexWalker.h>
+#include "Ring.h"
+#include "RingCoordinateIterator.h"
+#include "Segment.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+/// Encodes the rings of a relation (see Decoder for the format)
+class RingStore::Encoder
+{
+public:
+    explicit Encoder(std::vector<uint8_t>& data) : data_(data) {}
+
+    void encode(const Polygonizer& rings)
+    {
+        Coordinate prev(0, 0);
+        writeVarint(countRings(rings.outerRings()));
+        for (const Polygonizer::Ring* ring = rings.outerRings(); ring; ring = ring->next())
+        {
+            writeRing(ring, prev);
+            writeRingList(ring->firstInner(), prev);
+        }
+        writeRingList(rings.innerRings(), prev);
+    }
+
+private:
+    static int countRings(const Polygonizer::Ring* ring)
+    {
+        int count = 0;
+        for (; ring; ring = ring->next()) count++;
+        return count;
+    }
+
+    void writeRingList(const Polygonizer::Ring* first, Coordinate& prev)
+    {
+        writeVarint(countRings(first));
+        for (const Polygonizer::Ring* ring = first; ring; ring = ring->next())
+        {
+            writeRing(ring, prev);
+        }
+    }
+
+    void writeRing(const Polygonizer::Ring* ring, Coordinate& prev)
+    {
+        RingCoordinateIterator iter(ring);
+        writeVarint(iter.coordinatesRemaining());
+        while (iter.coordinatesRemaining() > 0)
+        {
+            Coordinate c = iter.next();
+            writeSignedVarint(static_cast<int64_t>(c.x) - prev.x);
+            writeSignedVarint(static_cast<int64_t>(c.y) - prev.y);
+            prev = c;
+        }
+    }
+
+    void writeVarint(uint64_t v)
+    {
+        uint8_t buf[16];
+        uint8_t* p = buf;
+        clarisma::writeVarint(p, v);
+        data_.insert(data_.end(), buf, p);
+    }
+
+    void writeSignedVarint(int64_t v)
+    {
+        writeVarint(toZigzag(v));
+    }
+
+    std::vector<uint8_t>& data_;
+};
+
+
+/// Decodes the rings of a relation into a Polygonizer, so they can
+/// be used by RingCoordinateIterator (and anything else that walks
+/// the segments of a ring). The format is:
+///
+/// - number of outer rings, then for each:
+///   - the ring
+///   - number of its inner rings, then each inner ring
+/// - number of inner rings that have no outer ring, then each ring
+///
+/// Each ring is its vertex count, followed by its coordinates (the
+/// first and last being the same), as pairs of signed varints that
+/// hold the difference to the previous coordinate of the relation.
+///
+class RingStore::Decoder
+{
+public:
+    Decoder(const uint8_t* p, clarisma::Arena& arena) :
+        p_(p), arena_(arena), prev_(0, 0) {}
+
+    Polygonizer::Ring* readOuterRings()
+    {
+        std::vector<Polygonizer::Ring*> rings(readVarint64(p_));
+        for (Polygonizer::Ring*& ring : rings)
+        {
+            ring = readRing();
+            ring->firstInner_ = readRingList();
+        }
+        return link(rings);
+    }
+
+    Polygonizer::Ring* readRingList()
+    {
+        std::vector<Polygonizer::Ring*> rings(readVarint64(p_));
+        for (Polygonizer::Ring*& ring : rings) ring = readRing();
+        return link(rings);
+    }
+
+private:
+    /// Links the rings in the order they were written (numbering
+    /// them the same way as the Polygonizer, i.e. the last is 1)
+    static Polygonizer::Ring* link(const std::vector<Polygonizer::Ring*>& rings)
+    {
+        Polygonizer::Ring* next = nullptr;
+        for (auto it = rings.rbegin(); it != rings.rend(); ++it)
+        {
+            Polygonizer::Ring* ring = *it;
+            ring->next_ = next;
+            ring->number_ = next ? (next->number_ + 1) : 1;
+            next = ring;
+        }
+        return next;
+    }
+
+    /// A Segment holds at most 64K vertexes, so a longer ring is split
+    /// into multiple segments (each starting where the previous ends)
+    Polygonizer::Ring* readRing()
+    {
+        static constexpr int MAX_SEGMENT_VERTEXES = 0xffff;
+
+        int vertexCount = static_cast<int>(readVarint64(p_));
+        Polygonizer::Segment* first = nullptr;
+        Polygonizer::Segment** pNext = &first;
+        Box bounds;
+        int remaining = vertexCount;
+        Coordinate last;
+        while (remaining > 0)
+        {
+            bool isFirst = first == nullptr;
+            int count = std::min(remaining + (isFirst ? 0 : 1), MAX_SEGMENT_VERTEXES);
+            Polygonizer::Segment* seg = arena_.allocWithExplicitSize<Polygonizer::Segment>(
+                Polygonizer::Segment::sizeWithVertexCount(count));
+            seg->next = nullptr;
+            seg->way = WayPtr();
+            seg->backward = false;
+            seg->status = Polygonizer::Segment::SEGMENT_ASSIGNED;
+            seg->vertexCount = static_cast<uint16_t>(count);
+            int i = 0;
+            if (!isFirst) seg->coords[i++] = last;
+            for (; i < count; i++)
+            {
+                int32_t x = static_cast<int32_t>(prev_.x + readSignedVarint64(p_));
+                int32_t y = static_cast<int32_t>(prev_.y + readSignedVarint64(p_));
+                prev_ = Coordinate(x, y);
+                seg->coords[i] = prev_;
+                bounds.expandToInclude(prev_);
+            }
+            remaining -= count - (isFirst ? 0 : 1);
+            last = seg->coords[count - 1];
+            *pNext = seg;
+            pNext = &seg->next;
+        }
+        Polygonizer::Ring* ring = arena_.alloc<Polygonizer::Ring>();
+        new (ring) Polygonizer::Ring(vertexCount, first, nullptr);
+        ring->bounds_ = bounds;
+        return ring;
+    }
+
+    const uint8_t* p_;
+    clarisma::Arena& arena_;
+    Coordinate prev_;
+};
+
+
+std::unique_ptr<RingStore> RingStore::open(const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::unique_ptr<RingStore> store(new RingStore());
+    const Header* header = store->file_.open<Header>(fileName,
+        { MAGIC, VERSION, storeTimestamp, storeSize }, "relation rings");
+    if (!header) return nullptr;
+    uint64_t size = store->file_.size();
+    if (size != sizeof(Header) + header->relationCount * sizeof(Entry) +
+            header->dataSize)
+    {
+        return nullptr;
+    }
+    store->entries_ = reinterpret_cast<const Entry*>(header + 1);
+    store->relationCount_ = header->relationCount;
+    store->data_ = reinterpret_cast<const uint8_t*>(
+        store->entries_ + header->relationCount);
+    return store;
+}
+
+
+std::shared_ptr<const Polygonizer> RingStore::get(uint64_t relationId) const
+{
+    const Entry* end = entries_ + relationCount_;
+    const Entry* entry = std::lower_bound(entries_, end, relationId,
+        [](const Entry& e, uint64_t id) { return e.id < id; });
+    if (entry == end || entry->id != relationId) return nullptr;
+    return decode(data_ + entry->offset);
+}
+
+
+std::shared_ptr<const Polygonizer> RingStore::decode(const uint8_t* data)
+{
+    std::shared_ptr<Polygonizer> rings = std::make_shared<Polygonizer>();
+    Decoder decoder(data, rings->arena_);
+    rings->outerRings_ = decoder.readOuterRings();
+    rings->innerRings_ = decoder.readRingList();
+    return rings;
+}
+
+
+namespace {
+
+/// Calls `fn` for each area relation in a tile (only for the copy
+/// without multi-tile flags, so each relation is visited once).
+/// Walks the tile's area index the same way as TileStatistics.
+template<typename Fn>
+void forEachAreaRelation(DataPtr pTile, Fn&& fn)
+{
+    auto walkBranch = [&fn](DataPtr pEntry, auto& self) -> void
+    {
+        int32_t ptr = pEntry.getInt();
+        if (ptr == 0) return;
+        DataPtr p = pEntry + (ptr & 0xffff'fffc);
+        if ((ptr & 2) == 0)
+        {
+            for (;;)
+            {
+                self(p, self);
+                if (p.getInt() & 1) break;
+                p += 20;
+            }
+            return;
+        }
+        for (;;)
+        {
+            FeaturePtr pFeature(p + 16);
+            int32_t flags = pFeature.flags();
+            if (pFeature.isRelation() && (flags &
+                (FeatureFlags::MULTITILE_WEST | FeatureFlags::MULTITILE_NORTH)) == 0)
+            {
+                fn(RelationPtr(pFeature));
+            }
+            if (flags & 1) break;
+            p += 32;
+        }
+    };
+
+    DataPtr ppRoot = pTile + 8 + static_cast<int>(FeatureIndexType::AREAS) * 4;
+    int32_t ptr = ppRoot.getInt();
+    if (ptr == 0) return;
+    if ((ptr & 1) == 0)
+    {
+        walkBranch(ppRoot, walkBranch);
+        return;
+    }
+    DataPtr p = ppRoot + (ptr ^ 1);
+    for (;;)
+    {
+        int32_t last = p.getInt() & 1;
+        walkBranch(p, walkBranch);
+        if (last != 0) break;
+        p += 8;
+    }
+}
+
+} // namespace
+
+
+/**
+ * Each thread claims the next tile in turn and encodes the rings of
+ * its relations into a buffer of its own; the buffers are then written
+ * one after the other, followed by the sorted table of IDs.
+ */
+void RingStore::build(FeatureStore* store, const std::string& fileName,
+    uint64_t storeTimestamp, uint64_t storeSize, int threads)
+{
+    struct Batch
+    {
+        std::vector<uint8_t> data;
+        std::vector<Entry> entries;
+    };
+
+    std::vector<Tip> tips;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        tips.push_back(walker.currentTip());
+    }
+
+    if (threads <= 0) threads = store->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tips.size()), 1));
+    std::vector<Batch> batches(threadCount);
+    std::atomic<size_t> nextTile(0);
+    auto encodeAll = [store, &tips, &nextTile](Batch* batch)
+    {
+        Encoder encoder(batch->data);
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tips.size()) return;
+            forEachAreaRelation(store->fetchTile(tips[n]), [&](RelationPtr relation)
+            {
+                Polygonizer rings;
+                rings.createRings(store, relation);
+                rings.assignAndMergeHoles();
+                batch->entries.push_back({ relation.id(), batch->data.size() });
+                encoder.encode(rings);
+            });
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(encodeAll, &batches[i]);
+    }
+    encodeAll(&batches[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    std::vector<Entry> entries;
+    uint64_t dataSize = 0;
+    for (const Batch& batch : batches)
+    {
+        for (Entry entry : batch.entries)
+        {
+            entries.push_back({ entry.id, entry.offset + dataSize });
+        }
+        dataSize += batch.data.size();
+    }
+    std::sort(entries.begin(), entries.end(),
+        [](const Entry& a, const Entry& b) { return a.id < b.id; });
+
+    Header header = { MAGIC, VERSION, storeTimestamp, storeSize,
+        entries.size(), dataSize };
+    SidecarFile::Writer file(fileName);
+    file.write(&header, sizeof(header));
+    file.write(entries.data(), entries.size() * sizeof(Entry));
+    for (const Batch& batch : batches)
+    {
+        file.write(batch.data.data(), batch.data.size());
+    }
+    file.commit();
+}
+
+} // namespace geodesk
@@ -7,8 +7,7 @@ namespace geodesk {
 
 using namespace clarisma;
 
-#ifdef GEODESK_WITH_GEOS
-void Polygonizer::Segment::copyTo(GEOSContextHandle_t context, GEOSCoordSequence* seq, int destPos) const
+Coordinate* Polygonizer::Segment::copyTo(Coordinate* dest) const
 {
     // we skip first coordinate because it is already the end coordinate of previous
     // segment (for the first segment, the caller has to place the start coordinate)
@@ -17,18 +16,18 @@ void Polygonizer::Segment::copyTo(GEOSContextHandle_t context, GEOSCoordSequence
     {
         for (int i = vertexCount - 2; i >= 0; i--)
         {
-            GEOSCoordSeq_setXY_r(context, seq, destPos++, coords[i].x, coords[i].y);
+            *dest++ = coords[i];
         }
     }
     else
     {
         for (int i = 1; i < vertexCount; i++)
         {
-            GEOSCoordSeq_setXY_r(context, seq, destPos++, coords[i].x, coords[i].y);
+            *dest++ = coords[i];
         }
     }
+    return dest;
 }
-#endif
 
 Polygonizer::Segment* Polygonizer::Segment::createFragment(int start, int end, Arena& arena) const
 {
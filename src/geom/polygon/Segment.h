@@ -48,9 +48,9 @@ public:
         return way.bounds();
     }
 
-    #ifdef GEODESK_WITH_GEOS
-    void copyTo(GEOSContextHandle_t context, GEOSCoordSequence* seq, int destPos) const;
-    #endif
+    /// Copies all coordinates but the first to `dest` (in ring order),
+    /// and returns a pointer past the last coordinate copied
+    Coordinate* copyTo(Coordinate* dest) const;
     Segment* createFragment(int start, int end, clarisma::Arena& arena) const;
 };
 
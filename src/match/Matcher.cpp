@@ -3,14 +3,16 @@
 
 #include <geodesk/match/Matcher.h>
 #include <cstddef>   // for offsetof
-#include <regex>
+#include <clarisma/text/Regex.h>
 #include <clarisma/util/pointer.h>
+#include <geodesk/feature/TagSummary.h>
 
 namespace geodesk {
 
 using namespace clarisma;
 
-const Matcher* MatcherHolder::defaultRoleMethod(const RoleMatcher* matcher, FeaturePtr)
+const Matcher* MatcherHolder::defaultRoleMethod(const RoleMatcher* matcher,
+	int, const ShortVarString*)
 {
 	// TODO: fix!
 	return (const Matcher*)matcher + (offsetof(MatcherHolder, mainMatcher_) - 
@@ -30,6 +32,9 @@ MatcherHolder::MatcherHolder(FeatureTypes types, uint32_t keyMask, uint32_t keyM
 	referencedMatcherHoldersCount_(0),
 	regexCount_(0),
 	roleMatcherOffset_(offsetof(MatcherHolder, defaultRoleMatcher_)),
+	nativeKind_(NativeKind::NONE),
+	tagsOnly_(true),
+	requiredRange_{ -1, 0, 0 },
 	defaultRoleMatcher_(defaultRoleMethod, nullptr),
 	mainMatcher_(matchAllMethod, nullptr)
 {
@@ -62,15 +67,15 @@ void MatcherHolder::dealloc() const
 	// Destroy regex patterns
 	if (regexCount_)
 	{
-		static_assert(alignof(std::regex) == 8, "std:regex must be 8-byte aligned");
+		static_assert(alignof(clarisma::Regex) == 8, "Regex must be 8-byte aligned");
 		// (all resources are 8-byte aligned to accommodate natural alignment
-		// of pointers, doubes and std::regex)
-		const std::regex* pRegex = reinterpret_cast<const std::regex*>(
+		// of pointers, doubes and Regex)
+		const clarisma::Regex* pRegex = reinterpret_cast<const clarisma::Regex*>(
 			p + sizeof(MatcherHolder*) * referencedMatcherHoldersCount_);
-		const std::regex* pEndRegex = pRegex + regexCount_;
+		const clarisma::Regex* pEndRegex = pRegex + regexCount_;
 		while (pRegex < pEndRegex)
 		{
-			pRegex->std::regex::~regex();
+			pRegex->~Regex();
 			pRegex++;
 		}
 	}
@@ -84,6 +89,14 @@ const MatcherHolder* MatcherHolder::createMatchAll(FeatureTypes types)
 	return new MatcherHolder(types);
 }
 
+const MatcherHolder* MatcherHolder::createMatchAll(FeatureTypes types,
+	const IndexMask* masks)
+{
+	MatcherHolder* self = new MatcherHolder(types);
+	for (int i = 0; i < 4; i++) self->indexMasks_[i] = masks[i];
+	return self;
+}
+
 /**
  * A matcher that checks for [k=v], where k and v are both global strings.
  */
@@ -113,6 +126,11 @@ public:
 		}
 	}
 
+	bool mayMatchTile(const TagSummary& summary, Tip tip) const
+	{
+		return summary.mayContain(tip, (tagBits_ >> 2) & 0x1fff, tagBits_ >> 16);
+	}
+
 private:
     uint32_t tagBits_;
 };
@@ -157,29 +175,176 @@ private:
 const MatcherHolder* MatcherHolder::createMatchKey(
 	FeatureTypes types, uint32_t indexBits, int keyCode, int codeNo)
 {
-	size_t size = sizeof(MatcherHolder) + sizeof(GlobalKeyMatcher) - sizeof(Matcher);
-	MatcherHolder* self = (MatcherHolder*)alloc(size);
-
-	// Since there is only one tag, mask and min are the same
-	new (self) MatcherHolder(types, indexBits, indexBits);
-	new (&self->mainMatcher_)GlobalKeyMatcher(keyCode, codeNo);
-	return self;
+	return createNative(types, indexBits, GlobalKeyMatcher(keyCode, codeNo), true);
 }
 
 
 const MatcherHolder* MatcherHolder::createMatchKeyValue(
 	FeatureTypes types, uint32_t indexBits, int keyCode, int valueCode)
 {
-	size_t size = sizeof(MatcherHolder) + sizeof(GlobalTagMatcher) - sizeof(Matcher);
-	MatcherHolder* self = (MatcherHolder*)alloc(size);
+	MatcherHolder* self = const_cast<MatcherHolder*>(createNative(
+		types, indexBits, GlobalTagMatcher(keyCode, valueCode), true));
+	self->nativeKind_ = NativeKind::KEY_VALUE;
+	return self;
+}
+
+
+/**
+ * A matcher that checks for [k1=a,b,...][k2=c,d,...], where all keys
+ * and values are global strings. Since global tags are sorted by key,
+ * all clauses are checked in a single pass over the tag table.
+ */
+class GlobalTagSetMatcher : public Matcher
+{
+public:
+	GlobalTagSetMatcher(int clauseCount, const uint16_t* keyCodes,
+		const uint8_t* valueCounts, const uint16_t* valueCodes) :
+		Matcher(matchTags, nullptr),	// don't need store access
+		clauseCount_(clauseCount)
+	{
+		assert(clauseCount > 0 && clauseCount <= MatcherHolder::MAX_NATIVE_CLAUSES);
+		for (int i = 0; i < clauseCount; i++)
+		{
+			Clause& clause = clauses_[i];
+			assert(valueCounts[i] > 0 && valueCounts[i] <= MatcherHolder::MAX_NATIVE_VALUES);
+			assert(i == 0 || keyCodes[i] > keyCodes[i-1]);
+			clause.keyBits = static_cast<uint16_t>((keyCodes[i] << 2) | 1);
+			clause.valueCount = valueCounts[i];
+			for (int j = 0; j < clause.valueCount; j++)
+			{
+				clause.values[j] = *valueCodes++;
+			}
+		}
+	}
+
+	static bool matchTags(const Matcher* matcher, FeaturePtr pFeature)
+	{
+		const GlobalTagSetMatcher* self = (const GlobalTagSetMatcher*)matcher;
+		DataPtr p(pFeature.ptr() + 8);
+		p = p.followTagged(~1);
+		const Clause* clause = self->clauses_;
+		const Clause* endClause = clause + self->clauseCount_;
+		for (;;)
+		{
+			uint32_t tag = p.getUnsignedIntUnaligned();
+			uint16_t key = static_cast<uint16_t>(tag);
+			if (key >= clause->keyBits)
+			{
+				// Either we've found the key (as a global-string tag),
+				// or the feature doesn't have it
+				if ((key & 0x7fff) != clause->keyBits) return false;
+				if (!clause->contains(static_cast<uint16_t>(tag >> 16))) return false;
+				clause++;
+				if (clause == endClause) return true;
+				if (key & 0x8000) return false;		// last tag
+			}
+			p += 4 + (tag & 2);
+		}
+	}
+
+	/// Every clause needs at least one of its tags in the tile
+	bool mayMatchTile(const TagSummary& summary, Tip tip) const
+	{
+		for (int i = 0; i < clauseCount_; i++)
+		{
+			const Clause& clause = clauses_[i];
+			uint32_t key = clause.keyBits >> 2;
+			bool found = false;
+			for (int j = 0; j < clause.valueCount && !found; j++)
+			{
+				found = summary.mayContain(tip, key, clause.values[j]);
+			}
+			if (!found) return false;
+		}
+		return true;
+	}
+
+private:
+	struct Clause
+	{
+		uint16_t keyBits;
+		uint16_t valueCount;
+		uint16_t values[MatcherHolder::MAX_NATIVE_VALUES];
 
-	// Since there is only one tag, mask and min are the same
-	new (self) MatcherHolder(types, indexBits, indexBits);
-	new (&self->mainMatcher_)GlobalTagMatcher(keyCode, valueCode);
+		bool contains(uint16_t value) const
+		{
+			for (int i = 0; i < valueCount; i++)
+			{
+				if (values[i] == value) return true;
+			}
+			return false;
+		}
+	};
+
+	int clauseCount_;
+	Clause clauses_[MatcherHolder::MAX_NATIVE_CLAUSES];
+};
+
+const MatcherHolder* MatcherHolder::createMatchKeyValueSets(FeatureTypes types,
+	uint32_t indexBits, int clauseCount, const uint16_t* keyCodes,
+	const uint8_t* valueCounts, const uint16_t* valueCodes)
+{
+	MatcherHolder* self = const_cast<MatcherHolder*>(createNative(types, indexBits,
+		GlobalTagSetMatcher(clauseCount, keyCodes, valueCounts, valueCodes), true));
+	self->nativeKind_ = NativeKind::KEY_VALUE_SETS;
 	return self;
 }
 
 
+bool MatcherHolder::mayMatchTile(const TagSummary& summary, Tip tip) const
+{
+	switch (nativeKind_)
+	{
+	case NativeKind::KEY_VALUE:
+		return static_cast<const GlobalTagMatcher&>(mainMatcher_).mayMatchTile(summary, tip);
+	case NativeKind::KEY_VALUE_SETS:
+		return static_cast<const GlobalTagSetMatcher&>(mainMatcher_).mayMatchTile(summary, tip);
+	default:
+		return true;
+	}
+}
+
+
+/**
+ * Runs a native matcher method over a batch of features. Since the
+ * method is a template argument, its body is inlined into the loop.
+ */
+template<MatcherMethod Method>
+static uint64_t acceptEach(const Matcher* matcher, const FeaturePtr* features, int count)
+{
+	uint64_t accepted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		accepted |= static_cast<uint64_t>(Method(matcher, features[i])) << i;
+	}
+	return accepted;
+}
+
+
+uint64_t MatcherHolder::accept(const FeaturePtr* features, int count) const
+{
+	assert(count >= 0 && count <= MAX_BATCH_SIZE);
+	switch (nativeKind_)
+	{
+	case NativeKind::KEY_VALUE:
+		return acceptEach<&GlobalTagMatcher::matchKeyValue>(
+			&mainMatcher_, features, count);
+	case NativeKind::KEY_VALUE_SETS:
+		return acceptEach<&GlobalTagSetMatcher::matchTags>(
+			&mainMatcher_, features, count);
+	default:
+		break;
+	}
+	MatcherMethod method = mainMatcher_.method();
+	uint64_t accepted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		accepted |= static_cast<uint64_t>(method(&mainMatcher_, features[i])) << i;
+	}
+	return accepted;
+}
+
+
 class ComboMatcher : public Matcher
 {
 public:
@@ -225,6 +390,9 @@ const MatcherHolder* MatcherHolder::combine(
 		a->acceptedTypes() & b->acceptedTypes(), 
 		keyMask, keyMin);
 	new (&self->mainMatcher_)ComboMatcher(a->mainMatcher_.store());
+	self->tagsOnly_ = a->tagsOnly_ && b->tagsOnly_;
+	self->requiredRange_ = a->requiredRange_.isRequired() ?
+		a->requiredRange_ : b->requiredRange_;
 	self->resourcesLength_ = static_cast<uint32_t>(resourceSize);
 	self->referencedMatcherHoldersCount_ = 2;
 	const MatcherHolder** pChildMatcher = 
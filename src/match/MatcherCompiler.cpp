@@ -8,17 +8,160 @@
 #include "match/MatcherEmitter.h"
 #include "match/MatcherParser.h"
 #include "match/MatcherValidator.h"
+#include <algorithm>
+#include <limits>
 #include <clarisma/util/BufferWriter.h>
 #include <clarisma/util/log.h>
+#include <clarisma/util/Tracer.h>
 
 namespace geodesk {
 
 using namespace clarisma;
 
+MatcherCompiler::~MatcherCompiler()
+{
+	clearCache();
+}
+
 const MatcherHolder* MatcherCompiler::getMatcher(const char* query)
 {
+	return lookup(std::string(query), query);
+}
+
+/**
+ * Returns the cached matcher for the given key, or compiles it.
+ * If `query` is null, the key consists of several queries
+ * separated by null characters, whose intersection is compiled (in
+ * which case nullptr is returned if they cannot be fused).
+ */
+const MatcherHolder* MatcherCompiler::lookup(std::string&& key, const char* query)
+{
+	{
+		std::lock_guard lock(cacheMutex_);
+		auto it = cache_.find(key);
+		if (it != cache_.end())
+		{
+			hits_++;
+			lru_.splice(lru_.begin(), lru_, it->second);
+			const MatcherHolder* matcher = it->second->second;
+			matcher->addref();
+			return matcher;
+		}
+		misses_++;
+	}
+
+	// Compile outside of the lock; if another thread compiles the same
+	// query at the same time, the last one to finish wins the cache slot
+	const MatcherHolder* matcher;
+	if (query)
+	{
+		matcher = compile(query);
+	}
+	else
+	{
+		MatcherParser parser(store_, key.c_str());
+		Selector* sel = parser.parseIntersection(key);
+		if (!sel) return nullptr;
+		matcher = compile(parser, sel);
+	}
+	if (cacheCapacity_ == 0) return matcher;
+
+	std::lock_guard lock(cacheMutex_);
+	auto it = cache_.find(key);
+	if (it != cache_.end())
+	{
+		sources_.erase(it->second->second);
+		it->second->second->release();
+		it->second->second = matcher;
+		lru_.splice(lru_.begin(), lru_, it->second);
+		sources_.emplace(matcher, it->second);
+	}
+	else
+	{
+		lru_.emplace_front(std::move(key), matcher);
+		cache_.emplace(lru_.front().first, lru_.begin());
+		sources_.emplace(matcher, lru_.begin());
+		if (lru_.size() > cacheCapacity_)
+		{
+			auto& oldest = lru_.back();
+			cache_.erase(oldest.first);
+			sources_.erase(oldest.second);
+			oldest.second->release();
+			lru_.pop_back();
+		}
+	}
+	matcher->addref();		// reference held by the cache
+	return matcher;
+}
+
+MatcherCompiler::CacheStats MatcherCompiler::cacheStats()
+{
+	std::lock_guard lock(cacheMutex_);
+	return { hits_, misses_, lru_.size() };
+}
+
+/**
+ * Looks up the queries of both matchers, and compiles their
+ * intersection. Matchers that are no longer cached (or not compiled
+ * from GOQL at all), as well as queries that put conditions on the
+ * same key, are chained instead.
+ */
+const MatcherHolder* MatcherCompiler::combine(
+	const MatcherHolder* a, const MatcherHolder* b)
+{
+	std::string key;
+	{
+		std::lock_guard lock(cacheMutex_);
+		auto itA = sources_.find(a);
+		auto itB = sources_.find(b);
+		if (itA != sources_.end() && itB != sources_.end())
+		{
+			const std::string& queryA = itA->second->first;
+			const std::string& queryB = itB->second->first;
+			key.reserve(queryA.size() + queryB.size() + 1);
+			key += queryA;
+			key += '\0';
+			key += queryB;
+		}
+	}
+	if (!key.empty())
+	{
+		const MatcherHolder* fused = lookup(std::move(key), nullptr);
+		if (fused)
+		{
+			a->release();
+			b->release();
+			return fused;
+		}
+	}
+	return MatcherHolder::combine(a, b);
+}
+
+std::string MatcherCompiler::queryOf(const MatcherHolder* matcher)
+{
+	std::lock_guard lock(cacheMutex_);
+	auto it = sources_.find(matcher);
+	return it == sources_.end() ? std::string() : it->second->first;
+}
+
+void MatcherCompiler::clearCache()
+{
+	std::lock_guard lock(cacheMutex_);
+	cache_.clear();
+	sources_.clear();
+	for (auto& entry : lru_) entry.second->release();
+	lru_.clear();
+}
+
+const MatcherHolder* MatcherCompiler::compile(const char* query)
+{
+	GEODESK_TRACE_SPAN("compile matcher", 0);
 	MatcherParser parser(store_, query);
-	Selector* sel = parser.parse();
+	return compile(parser, parser.parse());
+}
+
+const MatcherHolder* MatcherCompiler::compile(MatcherParser& parser, Selector* sel)
+{
 	uint32_t indexBits = parser.indexBits();  // TODO
 	const MatcherHolder* matcher = nullptr;
 
@@ -71,6 +214,10 @@ const MatcherHolder* MatcherCompiler::getMatcher(const char* query)
 			}
 		}
 	}
+	if (!matcher && sel->next == nullptr)
+	{
+		matcher = compileNative(sel, indexBits);
+	}
 	if (!matcher)
 	{
 		matcher = compileMatcher(parser.graph(), sel, indexBits);
@@ -88,8 +235,159 @@ const MatcherHolder* MatcherCompiler::getMatcher(const char* query)
 	return matcher;
 }
 
-const MatcherHolder* MatcherCompiler::compileMatcher(OpGraph& graph, Selector* firstSel, uint32_t indexBits)
+/**
+ * Attempts to turn a single selector into a native matcher, rather
+ * than bytecode for the MatcherEngine. This is possible if every clause
+ * requires a global key to be present with one of a small number of
+ * global-string values (e.g. `w[highway=primary,secondary][oneway=yes]`).
+ * These are the most common queries by far, and the native matcher
+ * evaluates them in a single pass over the feature's global tags,
+ * without dispatching on opcodes.
+ *
+ * Returns nullptr if the selector has any other shape, in which case
+ * the caller falls back to the bytecode interpreter.
+ */
+const MatcherHolder* MatcherCompiler::compileNative(Selector* sel, uint32_t indexBits)
+{
+	uint16_t keyCodes[MatcherHolder::MAX_NATIVE_CLAUSES];
+	uint8_t valueCounts[MatcherHolder::MAX_NATIVE_CLAUSES];
+	uint16_t valueCodes[MatcherHolder::MAX_NATIVE_CLAUSES][MatcherHolder::MAX_NATIVE_VALUES];
+	int clauseCount = 0;
+
+	for (TagClause* clause = sel->firstClause; clause; clause = clause->next)
+	{
+		if (clauseCount == MatcherHolder::MAX_NATIVE_CLAUSES) return nullptr;
+		const OpNode* keyOp = &clause->keyOp;
+		if (keyOp->opcode != Opcode::GLOBAL_KEY || keyOp->isNegated() ||
+			(clause->flags & TagClause::COMPLEX_BOOLEAN_CLAUSE))
+		{
+			return nullptr;
+		}
+
+		// Walk the OR-chain of value ops: each must be a positive EQ_CODE
+		// that returns true on match and moves on to the next alternative
+		// (or returns false after the last)
+		uint16_t values[MatcherHolder::MAX_NATIVE_VALUES];
+		int valueCount = 0;
+		const OpNode* valueOp = keyOp->next[1];
+		for (;;)
+		{
+			if (valueOp->opcode == Opcode::RETURN)
+			{
+				if (valueOp->operand.code != 0 || valueCount == 0) return nullptr;
+				break;
+			}
+			if (valueOp->opcode != Opcode::EQ_CODE || valueOp->isNegated()) return nullptr;
+			const OpNode* onMatch = valueOp->next[1];
+			if (onMatch->opcode != Opcode::RETURN || onMatch->operand.code != 1) return nullptr;
+			if (valueCount == MatcherHolder::MAX_NATIVE_VALUES) return nullptr;
+			values[valueCount++] = valueOp->operand.code;
+			valueOp = valueOp->next[0];
+		}
+
+		// Keep clauses ordered by key, the same order as global tags
+		int pos = clauseCount;
+		uint16_t keyCode = keyOp->operand.code;
+		while (pos > 0 && keyCodes[pos-1] > keyCode)
+		{
+			keyCodes[pos] = keyCodes[pos-1];
+			valueCounts[pos] = valueCounts[pos-1];
+			memcpy(valueCodes[pos], valueCodes[pos-1], sizeof(valueCodes[0]));
+			pos--;
+		}
+		if (pos > 0 && keyCodes[pos-1] == keyCode) return nullptr;
+		keyCodes[pos] = keyCode;
+		valueCounts[pos] = static_cast<uint8_t>(valueCount);
+		memcpy(valueCodes[pos], values, sizeof(values));
+		clauseCount++;
+	}
+	if (clauseCount == 0) return nullptr;
+
+	uint16_t flatValues[MatcherHolder::MAX_NATIVE_CLAUSES * MatcherHolder::MAX_NATIVE_VALUES];
+	int n = 0;
+	for (int i = 0; i < clauseCount; i++)
+	{
+		for (int j = 0; j < valueCounts[i]; j++) flatValues[n++] = valueCodes[i][j];
+	}
+	return MatcherHolder::createMatchKeyValueSets(sel->acceptedTypes,
+		indexBits, clauseCount, keyCodes, valueCounts, flatValues);
+}
+
+/**
+ * Looks for a clause of a single selector that requires the value of a
+ * global key to be a number within a range, e.g. `[ele>3000]` or
+ * `[building:levels>=10][building:levels<20]`, which lets a query skip
+ * the tiles that a NumericIndex rules out. The clause must consist of
+ * nothing but an AND-chain of positive numeric comparisons (an OR-chain
+ * like `[lanes=1,2]` or a negated clause doesn't qualify). If there
+ * are multiple such clauses, the first one is used.
+ */
+NumericRange MatcherCompiler::requiredRange(const Selector* sel)
+{
+	NumericRange range = { -1, 0, 0 };
+	if (sel->next) return range;
+	for (const TagClause* clause = sel->firstClause; clause; clause = clause->next)
+	{
+		const OpNode* keyOp = &clause->keyOp;
+		if (keyOp->opcode != Opcode::GLOBAL_KEY || keyOp->isNegated() ||
+			(clause->flags & TagClause::COMPLEX_BOOLEAN_CLAUSE))
+		{
+			continue;
+		}
+		double min = -std::numeric_limits<double>::infinity();
+		double max = std::numeric_limits<double>::infinity();
+		bool valid = true;
+		const OpNode* valueOp = keyOp->next[1];
+		for (; valueOp->opcode != Opcode::RETURN; valueOp = valueOp->next[1])
+		{
+			const OpNode* onFailure = valueOp->next[0];
+			if (valueOp->isNegated() ||
+				(onFailure && onFailure->opcode != Opcode::RETURN))
+			{
+				valid = false;
+				break;
+			}
+			double n = valueOp->operand.number;
+			switch (valueOp->opcode)
+			{
+			case Opcode::EQ_NUM:
+				min = std::max(min, n);
+				max = std::min(max, n);
+				break;
+			case Opcode::LE:
+			case Opcode::LT:
+				max = std::min(max, n);
+				break;
+			case Opcode::GE:
+			case Opcode::GT:
+				min = std::max(min, n);
+				break;
+			default:
+				valid = false;
+				break;
+			}
+			if (!valid) break;
+		}
+		if (!valid || valueOp == keyOp->next[1]) continue;
+		range.keyCode = keyOp->operand.code;
+		range.min = min;
+		range.max = max;
+		break;
+	}
+	return range;
+}
+
+/**
+ * Compiles the selectors into bytecode for the MatcherEngine. If
+ * `origins` is given, it receives the origin of each instruction
+ * (see MatcherEmitter::traceOrigins()).
+ */
+const MatcherHolder* MatcherCompiler::compileMatcher(OpGraph& graph, Selector* firstSel,
+	uint32_t indexBits, std::vector<uint16_t>* origins)
 {
+	// (The validator rearranges the ops, so we look for a numeric
+	// range beforehand)
+	NumericRange range = requiredRange(firstSel);
 	MatcherValidator validator(graph);
 	OpNode* root = validator.validate(firstSel);
 
@@ -109,10 +407,15 @@ const MatcherHolder* MatcherCompiler::compileMatcher(OpGraph& graph, Selector* f
 	matcherHolder->regexCount_ = validator.regexCount();
 
 	MatcherEmitter emitter(graph, root, matcherData, pCode);
+	emitter.traceOrigins(origins);
 	emitter.emit();
 	emitter.fixJumps();
 
 	new (&matcherHolder->mainMatcher_)Matcher((MatcherMethod)MatcherEngine::accept, store_);
+	// (A query whose selectors accept different types checks the type
+	// of each feature, which makes its result depend on more than tags)
+	matcherHolder->tagsOnly_ = !emitter.checksFeatureTypes();
+	matcherHolder->requiredRange_ = range;
 
 	return matcherHolder;
 }
@@ -126,7 +126,7 @@ void MatcherDecoder::writeBranchingOp(const uint16_t* p)
 		case OperandType::REGEX:
 		{
 			uint16_t ofs = *p;
-			const std::regex* pRegex = reinterpret_cast<const std::regex*>(
+			const clarisma::Regex* pRegex = reinterpret_cast<const clarisma::Regex*>(
 				reinterpret_cast<const uint8_t*>(p) - ofs);
 			out_.writeString(" <regex>");
 			p++;
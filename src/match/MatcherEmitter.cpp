@@ -37,6 +37,12 @@ void MatcherEmitter::emit()
 		p++;
 		assert(node->address == 0);
 		node->address = static_cast<uint32_t>((pOpcode - pCode_) * 2);	// in bytes
+		if (origins_)
+		{
+			size_t word = pOpcode - pCode_;
+			if (origins_->size() <= word) origins_->resize(word + 1);
+			(*origins_)[word] = node->origin;
+		}
 		int opcode = node->opcode;
 		switch (opcode)
 		{
@@ -105,11 +111,13 @@ void MatcherEmitter::emit()
 		case Opcode::LOAD_STRING:
 		case Opcode::LOAD_NUM:
 		case Opcode::STR_TO_NUM:
+		case Opcode::CODE_TO_NUM:
 			// nothing else to do
 			break;
 
 		case Opcode::FEATURE_TYPE:
 		{
+			checksFeatureTypes_ = true;
 			uint32_t types = node->operand.featureTypes;
 			std::memcpy(p, &types, sizeof(uint32_t));
 			p += 2;
@@ -146,7 +154,8 @@ void MatcherEmitter::emit()
 		assert(ifFalse);
 		assert(ifTrue);
 
-		assert(ifTrue != ifFalse || opcode==Opcode::STR_TO_NUM);   // str_to_num can go to same target (because invalid strign becomes NaN)
+		assert(ifTrue != ifFalse || opcode==Opcode::STR_TO_NUM ||
+			opcode==Opcode::CODE_TO_NUM);   // str_to_num can go to same target (because invalid strign becomes NaN)
 
 		*pOpcode = opcode | (node->isNegated() ? 256 : 0);
 		p++;				// slot for the jump address
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
+#include <vector>
 #include "OpGraph.h"
 #include <clarisma/alloc/ArenaPool.h>
 #include <clarisma/alloc/ArenaStack.h>
@@ -34,11 +35,11 @@ public:
 		return (double*)alloc(sizeof(double));
 	}
 
-	std::regex* allocRegex(RegexOperand* pRegexOperand)		
+	clarisma::Regex* allocRegex(RegexOperand* pRegexOperand)		
 	{
 		// TODO: must use a special area at front of resources!
-		std::regex* pRegex = reinterpret_cast<std::regex*>(alloc(sizeof(std::regex)));
-		new (pRegex) std::regex(std::move(pRegexOperand->regex()));
+		clarisma::Regex* pRegex = reinterpret_cast<clarisma::Regex*>(alloc(sizeof(clarisma::Regex)));
+		new (pRegex) clarisma::Regex(std::move(pRegexOperand->regex()));
 		pRegexOperand->setRegexResource(pRegex);
 		return pRegex;
 	}
@@ -72,6 +73,14 @@ public:
 	void emit();
 	void fixJumps();
 
+	/// Makes emit() record the origin (see OpGraph::Origin) of each
+	/// instruction, indexed by the instruction's word offset within
+	/// the code (words that are operands are left as 0)
+	void traceOrigins(std::vector<uint16_t>* origins) { origins_ = origins; }
+
+	/// Returns true if the emitted code checks the types of features
+	bool checksFeatureTypes() const { return checksFeatureTypes_; }
+
 private:
 	inline void defer(OpNode* node)
 	{
@@ -117,6 +126,8 @@ private:
 	OpNodeStack jumps_;
 	MatcherResourceAllocator resources_;
 	uint16_t* pCode_;
+	std::vector<uint16_t>* origins_ = nullptr;
+	bool checksFeatureTypes_ = false;
 };
 
 } // namespace geodesk
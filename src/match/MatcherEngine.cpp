@@ -6,6 +6,12 @@
 #include <geodesk//feature/StringValue.h>
 #include <geodesk/feature/FeatureStore.h>
 #include <clarisma/math/Math.h>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 namespace geodesk {
 
@@ -39,15 +45,15 @@ int MatcherEngine::scanGlobalKeys()
 int MatcherEngine::scanLocalKeys()
 {
     pointer pTagTableAligned = pointer::ofTagged(pTagTable_, -4);
-    std::string_view operand = getStringOperand();
+    ShortVarString::Probe operand(getStringOperand());
     pointer pTagOld = pTag_;
     for (;;)
     {
         int32_t key = pTag_.getUnalignedInt();
         pTag_ -= 6 + (key & 2);
         pointer pKey = pTagTableAligned + ((key >> 3) << 2);
-        geodesk::StringValue keyString(pKey);
-        if (keyString == operand)
+        if (operand.matches(reinterpret_cast<const ShortVarString*>(
+            pKey.asBytePointer())))
         {
             tagKey_ = key;
             return 1;
@@ -77,10 +83,10 @@ inline double MatcherEngine::getDoubleOperand()
     return d;
 }
 
-inline const std::regex *MatcherEngine::getRegexOperand()
+inline const clarisma::Regex *MatcherEngine::getRegexOperand()
 {
     uint16_t opOfs = ip_.getUnsignedShort();
-    std::regex* regex = (std::regex*)(ip_.asBytePointer() - opOfs); // TODO: relative to Matcher*?
+    const clarisma::Regex* regex = (const clarisma::Regex*)(ip_.asBytePointer() - opOfs); // TODO: relative to Matcher*?
     ip_ += 2;
     return regex;
 }
@@ -94,10 +100,76 @@ inline uint32_t MatcherEngine::getFeatureTypeOperand()
     return types;
 }
 
+uint64_t MatcherEngine::readCycles()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+namespace {
+
+// The probes are called before each instruction, and once more
+// before RETURN ends the matcher
+
+struct NoProbe
+{
+    void enter(const uint8_t*) {}
+    void leave() {}
+};
+
+struct CycleProbe
+{
+    CycleProbe(const uint8_t* code, uint64_t* executions, uint64_t* cycles) :
+        code(code), executions(executions), cycles(cycles), current(-1), start(0) {}
+
+    void enter(const uint8_t* ip)
+    {
+        uint64_t now = MatcherEngine::readCycles();
+        if (current >= 0) cycles[current] += now - start;
+        current = static_cast<int>((ip - code) / 2);
+        executions[current]++;
+        start = now;
+    }
+
+    void leave()
+    {
+        cycles[current] += MatcherEngine::readCycles() - start;
+    }
+
+    const uint8_t* code;
+    uint64_t* executions;
+    uint64_t* cycles;
+    int current;
+    uint64_t start;
+};
+
+} // namespace
+
 int MatcherEngine::accept(const Matcher* matcher, FeaturePtr pFeature)
+{
+    NoProbe probe;
+    return execute(matcher, pFeature, probe);
+}
+
+int MatcherEngine::acceptProfiled(const Matcher* matcher, FeaturePtr pFeature,
+    uint64_t* executions, uint64_t* cycles)
+{
+    CycleProbe probe(reinterpret_cast<const uint8_t*>(matcher) + sizeof(Matcher),
+        executions, cycles);
+    return execute(matcher, pFeature, probe);
+}
+
+template<typename Probe>
+int MatcherEngine::execute(const Matcher* matcher, FeaturePtr pFeature, Probe& probe)
 {
     MatcherEngine ctx;
-    uint32_t codeValue;
+    uint32_t codeValue = 0;
     const uint8_t* stringValue;
     double doubleValue;
 
@@ -107,6 +179,7 @@ int MatcherEngine::accept(const Matcher* matcher, FeaturePtr pFeature)
     for (;;)
     {
         int matched;
+        probe.enter(ctx.ip_.asBytePointer());
         int op = ctx.ip_.getUnsignedShort();
         int opcode = op & 0xff;
         ctx.ip_ += 2;   // move to first operand
@@ -146,8 +219,7 @@ int MatcherEngine::accept(const Matcher* matcher, FeaturePtr pFeature)
 
             case REGEX:
             {
-                std::string_view val = asStringView(stringValue);
-                matched = std::regex_match(val.begin(), val.end(), *ctx.getRegexOperand());
+                matched = ctx.getRegexOperand()->match(asStringView(stringValue));
             }
             break;
 
@@ -284,6 +356,11 @@ int MatcherEngine::accept(const Matcher* matcher, FeaturePtr pFeature)
                 matched = Math::parseDouble(asStringView(stringValue), &doubleValue);
                 break;
 
+            case CODE_TO_NUM:
+                matched = matcher->store()->strings().getGlobalNumber(
+                    codeValue, &doubleValue);
+                break;
+
             case FEATURE_TYPE:
             {
                 FeatureTypes types(ctx.getFeatureTypeOperand());
@@ -296,6 +373,7 @@ int MatcherEngine::accept(const Matcher* matcher, FeaturePtr pFeature)
                 continue;
 
             case RETURN:
+                probe.leave();
                 return op >> 8;
 
             default:
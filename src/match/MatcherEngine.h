@@ -3,7 +3,7 @@
 
 #pragma once
 #include <cstdint>
-#include <regex>
+#include <clarisma/text/Regex.h>
 #include <string_view>
 #include <clarisma/util/pointer.h>
 #include <clarisma/util/ShortVarString.h>
@@ -17,7 +17,21 @@ class MatcherEngine
 public:
 	static int accept(const Matcher*, FeaturePtr);
 
+	/// Same as accept(), but also counts how often each instruction
+	/// runs, and the cycles it takes (including the cost of reading
+	/// the cycle counter). Both arrays are indexed by the word offset
+	/// of an instruction within the bytecode, and must cover all of it.
+	static int acceptProfiled(const Matcher*, FeaturePtr,
+		uint64_t* executions, uint64_t* cycles);
+
+	/// Reads the CPU's time-stamp counter (on x86; elsewhere, the
+	/// steady clock in nanoseconds)
+	static uint64_t readCycles();
+
 private:
+	template<typename Probe>
+	static int execute(const Matcher* matcher, FeaturePtr pFeature, Probe& probe);
+
 	void jumpIf(int matched) { ip_ += matched ? ip_.getShort() : 2; }
 	inline int scanGlobalKeys();
 	int scanLocalKeys();	// inline not needed for this
@@ -31,7 +45,7 @@ private:
 		return val->toStringView();
 	}
 	inline double getDoubleOperand();
-	inline const std::regex* getRegexOperand();
+	inline const clarisma::Regex* getRegexOperand();
 	inline uint32_t getFeatureTypeOperand();
 
 	clarisma::pointer ip_;
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include "MatcherParser.h"
+#include <cctype>
 
 namespace geodesk {
 
@@ -34,6 +35,7 @@ Selector* MatcherParser::parse()
 
 Selector* MatcherParser::expectSelector()
 {
+	const char* start = pNext_;
 	FeatureTypes types = matchTypes();
 	if (types == 0)
 	{
@@ -42,15 +44,143 @@ Selector* MatcherParser::expectSelector()
 	}
 	Selector* sel = graph_.arena().alloc<Selector>();
 	new(sel) Selector(types);
+	sel->origin = graph_.addOrigin(true);
+	sel->falseOp.origin = sel->origin;
 	currentSel_ = sel; 
-	while (accept('['))
+	expectClauses(sel, false);
+	graph_.origin(sel->origin).text = sourceSince(start);
+	return sel;
+}
+
+
+/**
+ * Returns the query text from `start` up to the current position,
+ * without trailing whitespace.
+ */
+std::string_view MatcherParser::sourceSince(const char* start) const
+{
+	const char* end = pNext_;
+	while (end > start && std::isspace(static_cast<unsigned char>(end[-1]))) end--;
+	return std::string_view(start, end - start);
+}
+
+
+/**
+ * Parses the tag clauses of a selector and adds them to `sel`.
+ *
+ * @param mustBeDisjoint if true, stops and returns false if a clause
+ *   has the same key as one of the clauses already in `sel`
+ */
+bool MatcherParser::expectClauses(Selector* sel, bool mustBeDisjoint)
+{
+	for (;;)
 	{
+		const char* start = pNext_;
+		if (!accept('[')) break;
+		uint16_t origin = graph_.addOrigin(false);
+		graph_.setOrigin(origin);
 		TagClause* clause = expectTagClause();
 		expect(']');
+		graph_.setOrigin(sel->origin);
+		graph_.origin(origin).text = sourceSince(start);
+		clause->origin = origin;
+		clause->keyOp.origin = origin;
+		clause->trueOp.origin = origin;
+		if (mustBeDisjoint)
+		{
+			for (TagClause* c = sel->firstClause; c; c = c->next)
+			{
+				if (c->keyOp.compareTo(&clause->keyOp) == 0) return false;
+			}
+		}
 		sel->addClause(clause);
 		indexBits_ |= sel->indexBits; // TODO
 	}
-	return sel;
+	return true;
+}
+
+
+/**
+ * Checks the syntax of a query and returns the start of each
+ * of its selectors.
+ */
+std::vector<const char*> MatcherParser::selectorStarts(const char* query)
+{
+	std::vector<const char*> starts;
+	pStart_ = query;
+	pNext_ = query;
+	for (;;)
+	{
+		starts.push_back(pNext_);
+		expectSelector();
+		if (*pNext_ != ',') break;
+		pNext_++;
+		skipWhitespace();
+	}
+	if (*pNext_ != 0) error("Expected [ or ,");
+	return starts;
+}
+
+
+/**
+ * Parses several queries (separated by null characters) into the
+ * selectors of a single query that matches only the features matched
+ * by all of them: every combination of selectors (one from each
+ * query) becomes a selector with all of their clauses and the types
+ * they have in common. Combinations with no types in common are
+ * dropped; if none are left, a single selector that accepts no
+ * types is returned.
+ *
+ * @return the first selector, or nullptr if two of the queries
+ *   have clauses for the same key (which are not merged)
+ */
+Selector* MatcherParser::parseIntersection(std::string_view queries)
+{
+	std::vector<std::vector<const char*>> parts;
+	size_t pos = 0;
+	while (pos < queries.size())
+	{
+		parts.push_back(selectorStarts(queries.data() + pos));
+		pos = queries.find('\0', pos);
+		if (pos == std::string_view::npos) break;
+		pos++;
+	}
+	indexBits_ = 0;
+
+	Selector* firstSel = nullptr;
+	Selector** pNextSel = &firstSel;
+	std::vector<size_t> combo(parts.size(), 0);
+	for (;;)
+	{
+		pStart_ = pNext_ = parts[0][combo[0]];
+		Selector* sel = expectSelector();
+		for (size_t i = 1; i < parts.size(); i++)
+		{
+			pStart_ = pNext_ = parts[i][combo[i]];
+			FeatureTypes types = matchTypes();
+			if (types != 0) sel->acceptedTypes &= types;
+			if (!expectClauses(sel, true)) return nullptr;
+		}
+		if (sel->acceptedTypes != 0)
+		{
+			*pNextSel = sel;
+			pNextSel = &sel->next;
+		}
+
+		// Advance to the next combination of selectors
+		size_t i = parts.size();
+		while (i > 0 && ++combo[i-1] == parts[i-1].size())
+		{
+			combo[--i] = 0;
+		}
+		if (i == 0) break;
+	}
+	if (!firstSel)
+	{
+		firstSel = graph_.arena().alloc<Selector>();
+		new(firstSel) Selector(FeatureTypes(0));
+	}
+	return firstSel;
 }
 
 
@@ -375,7 +505,11 @@ OpNode* MatcherParser::acceptStringOperand()
 
 	OpNode* node;
 	int code;
-	if (op == Opcode::EQ_STR && (code = getStringCode(val)) > 0)
+	// Strings in a GOL are canonical: if the constant is a global string,
+	// a tag can only be equal to it if it has the same global code (and
+	// if it isn't, a global-string value can never be equal to it).
+	// "" is always global string #0
+	if (op == Opcode::EQ_STR && (code = getStringCode(val)) >= 0)
 	{
 		node = graph_.newOp(Opcode::EQ_CODE, code);
 	}
@@ -6,6 +6,7 @@
 #include "OpGraph.h"
 #include "Selector.h"
 #include "TagClause.h"
+#include <vector>
 #include <geodesk/feature/FeatureStore.h>
 #include <clarisma/util/Parser.h>
 
@@ -17,6 +18,7 @@ public:
 	MatcherParser(FeatureStore* store, const char* pInput);
 
 	Selector* parse();
+	Selector* parseIntersection(std::string_view queries);
 	OpGraph& graph() { return graph_; }
 	uint32_t indexBits() const { return indexBits_; }
 	int codeNo() const { return codeNo_; }
@@ -27,6 +29,9 @@ private:
 		return store_->strings().getCode(s.data(), s.length());
 	}
 	Selector* expectSelector();
+	bool expectClauses(Selector* sel, bool mustBeDisjoint);
+	std::vector<const char*> selectorStarts(const char* query);
+	std::string_view sourceSince(const char* start) const;
 	TagClause* expectTagClause();
 	TagClause* expectKey();
 	std::string_view acceptEscapedString();
@@ -0,0 +1,190 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/match/MatcherProfiler.h>
+#include <algorithm>
+#include <cstdio>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/match/MatcherCompiler.h>
+#include "MatcherEngine.h"
+#include "MatcherParser.h"
+
+namespace geodesk {
+
+MatcherProfiler::MatcherProfiler(FeatureStore* store, const char* query) :
+    query_(query),
+    matcher_(nullptr)
+{
+    MatcherParser parser(store, query_.c_str());
+    Selector* firstSel = parser.parse();
+    for (Selector* sel = firstSel; sel; sel = sel->next)
+    {
+        if (!sel->firstClause)
+        {
+            throw QueryException("Nothing to profile in %s (a selector "
+                "has no tag clauses)", query);
+        }
+    }
+    MatcherCompiler compiler(store);
+    matcher_ = compiler.compileMatcher(parser.graph(), firstSel,
+        parser.indexBits(), &instructionOrigins_);
+    code_ = reinterpret_cast<const uint16_t*>(
+        reinterpret_cast<const uint8_t*>(&matcher_->mainMatcher()) + sizeof(Matcher));
+
+    for (const OpGraph::Origin& origin : parser.graph().origins())
+    {
+        origins_.push_back({
+            static_cast<uint32_t>(origin.text.data() ?
+                origin.text.data() - query_.data() : 0),
+            static_cast<uint32_t>(origin.text.size()),
+            origin.isSelector });
+    }
+    executions_.resize(instructionOrigins_.size());
+    cycles_.resize(instructionOrigins_.size());
+
+    // The cheapest back-to-back reading of the counter is the
+    // overhead that each instruction's count includes
+    overhead_ = UINT64_MAX;
+    for (int i = 0; i < 1000; i++)
+    {
+        uint64_t start = MatcherEngine::readCycles();
+        uint64_t end = MatcherEngine::readCycles();
+        overhead_ = std::min(overhead_, end - start);
+    }
+}
+
+MatcherProfiler::~MatcherProfiler()
+{
+    if (matcher_) matcher_->release();
+}
+
+FeatureTypes MatcherProfiler::acceptedTypes() const
+{
+    return matcher_->acceptedTypes();
+}
+
+bool MatcherProfiler::accept(FeaturePtr feature)
+{
+    bool accepted = MatcherEngine::acceptProfiled(&matcher_->mainMatcher(),
+        feature, executions_.data(), cycles_.data());
+    checked_++;
+    accepted_ += accepted;
+    return accepted;
+}
+
+uint64_t MatcherProfiler::run(const Features& features)
+{
+    FeatureTypes types = acceptedTypes();
+    uint64_t accepted = 0;
+    for (Feature f : features)
+    {
+        FeaturePtr p = f.ptr();
+        if (p.isNull() || !types.acceptFlags(p.flags())) continue;
+        accepted += accept(p);
+    }
+    return accepted;
+}
+
+void MatcherProfiler::reset()
+{
+    std::fill(executions_.begin(), executions_.end(), 0);
+    std::fill(cycles_.begin(), cycles_.end(), 0);
+    checked_ = 0;
+    accepted_ = 0;
+}
+
+std::vector<MatcherProfiler::Origin> MatcherProfiler::origins() const
+{
+    std::vector<Origin> origins;
+    for (const OriginText& o : origins_)
+    {
+        origins.push_back({
+            std::string_view(query_).substr(o.position, o.length),
+            o.position, o.isSelector, 0, 0 });
+    }
+    for (size_t i = 0; i < executions_.size(); i++)
+    {
+        if (executions_[i] == 0) continue;
+        Origin& origin = origins[instructionOrigins_[i]];
+        origin.executions += executions_[i];
+        origin.cycles += netCycles(i);
+    }
+    if (origins[0].executions == 0) origins.erase(origins.begin());
+    std::stable_sort(origins.begin(), origins.end(), [](const Origin& a, const Origin& b)
+    {
+        return a.cycles > b.cycles;
+    });
+    return origins;
+}
+
+std::vector<MatcherProfiler::OpcodeCounts> MatcherProfiler::opcodes() const
+{
+    std::vector<OpcodeCounts> opcodes;
+    for (size_t i = 0; i < executions_.size(); i++)
+    {
+        if (executions_[i] == 0) continue;
+        const char* name = OPCODE_NAMES[code_[i] & 0xff];
+        auto it = std::find_if(opcodes.begin(), opcodes.end(),
+            [name](const OpcodeCounts& c) { return c.name == name; });
+        if (it == opcodes.end())
+        {
+            opcodes.push_back({ name, 0, 0 });
+            it = opcodes.end() - 1;
+        }
+        it->executions += executions_[i];
+        it->cycles += netCycles(i);
+    }
+    std::sort(opcodes.begin(), opcodes.end(), [](const OpcodeCounts& a, const OpcodeCounts& b)
+    {
+        return a.cycles > b.cycles;
+    });
+    return opcodes;
+}
+
+void MatcherProfiler::report(std::string& out, int maxRows) const
+{
+    char buf[128];
+    out += query_;
+    snprintf(buf, sizeof(buf), "\n%llu features checked, %llu accepted\n",
+        static_cast<unsigned long long>(checked_),
+        static_cast<unsigned long long>(accepted_));
+    out += buf;
+    if (checked_ == 0) return;
+
+    std::vector<Origin> origins = this->origins();
+    uint64_t total = 0;
+    for (const Origin& o : origins) total += o.cycles;
+    if (total == 0) total = 1;
+    double features = static_cast<double>(checked_);
+
+    out += "\n  cycles/f  share  ops/f   col  clause\n";
+    int rows = std::min(maxRows, static_cast<int>(origins.size()));
+    for (int i = 0; i < rows; i++)
+    {
+        const Origin& o = origins[i];
+        if (o.executions == 0) break;
+        std::string text = o.text.empty() ? "(other)" :
+            (o.isSelector ? "selector " : "") + std::string(o.text);
+        snprintf(buf, sizeof(buf), "  %8.1f %5.1f%% %6.2f %5u  ",
+            o.cycles / features, o.cycles * 100.0 / total,
+            o.executions / features, o.position + 1);
+        out += buf;
+        out += text;
+        out += '\n';
+    }
+
+    out += "\n  cycles/f  share  ops/f  opcode\n";
+    std::vector<OpcodeCounts> opcodes = this->opcodes();
+    rows = std::min(maxRows, static_cast<int>(opcodes.size()));
+    for (int i = 0; i < rows; i++)
+    {
+        const OpcodeCounts& c = opcodes[i];
+        snprintf(buf, sizeof(buf), "  %8.1f %5.1f%% %6.2f  %s\n",
+            c.cycles / features, c.cycles * 100.0 / total,
+            c.executions / features, c.name);
+        out += buf;
+    }
+}
+
+} // namespace geodesk
@@ -23,7 +23,7 @@ OpNode* MatcherValidator::validate(Selector* firstSel)
 	while (pRegex)
 	{
 		regexCount_++;
-		resourceSize_ += (sizeof(std::regex) + 7) & 0xffff'fff8;
+		resourceSize_ += (sizeof(clarisma::Regex) + 7) & 0xffff'fff8;
 		pRegex = pRegex->next();
 	}
 
@@ -86,13 +86,14 @@ OpNode* MatcherValidator::findWrongTypeOp(OpNode* firstValueOp)
 /**
  * Inserts and links up LOAD_CODE, LOAD_STR or LOAD_NUM as needed based
  * on the operand types of the value ops (summarized in flags). Also
- * inserts CODE_TO_STR and STR_TO_NUM, if needed.
+ * inserts CODE_TO_STR, STR_TO_NUM and CODE_TO_NUM, if needed.
  */
 // TODO: Broken; for [k][k!=v], clause *succeeds* if wrong type
 void MatcherValidator::insertLoadOps(TagClause* clause)
 {
 	OpNode* keyOp = &clause->keyOp;
 	bool negated = keyOp->isNegated();
+	graph_.setOrigin(clause->origin);
 
 	// TODO:
 	// Still broken for [k][k!=v]
@@ -119,11 +120,12 @@ void MatcherValidator::insertLoadOps(TagClause* clause)
 	{
 		// For numeric ops, create a chain that first checks for
 		// number, then wide string (converting string to num),
-		// and finally code (converting first to string, then to num)
+		// and finally code (whose numeric value is cached by the
+		// StringTable, so global strings are only parsed once)
 
 		OpNode* strToNumOp = graph_.newOp(Opcode::STR_TO_NUM, wrongTypeOp, firstValueOp);
-		OpNode* codeToStrOp = graph_.newOp(Opcode::CODE_TO_STR, strToNumOp, nullptr);
-		OpNode* loadCodeOp = graph_.newOp(Opcode::LOAD_CODE, wrongTypeOp, codeToStrOp);
+		OpNode* codeToNumOp = graph_.newOp(Opcode::CODE_TO_NUM, wrongTypeOp, firstValueOp);
+		OpNode* loadCodeOp = graph_.newOp(Opcode::LOAD_CODE, wrongTypeOp, codeToNumOp);
 		OpNode* loadStringOp = graph_.newOp(Opcode::LOAD_STRING, loadCodeOp, strToNumOp);
 		loadOp = graph_.newOp(Opcode::LOAD_NUM, loadStringOp, firstValueOp);
 	}
@@ -325,6 +327,7 @@ OpNode* MatcherValidator::validateSelector(Selector* sel)
 		clause = clause->next;
 	}
 
+	graph_.setOrigin(sel->origin);
 	OpNode* op = &sel->firstClause->keyOp;
 	if (seenLocalKeyOp)
 	{
@@ -348,6 +351,7 @@ OpNode* MatcherValidator::validateSelector(Selector* sel)
 				assert(lastGlobalKeyClause);
 				assert(lastGlobalKeyClause->next);
 				lastGlobalKeyClause->trueOp.opcode = Opcode::HAS_LOCAL_KEYS;
+				lastGlobalKeyClause->trueOp.origin = sel->origin;
 				lastGlobalKeyClause->trueOp.next[1] = &lastGlobalKeyClause->next->keyOp;
 			}
 		}
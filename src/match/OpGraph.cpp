@@ -7,7 +7,9 @@ namespace geodesk {
 
 OpGraph::OpGraph() :
 	firstRegex_(nullptr),
-	arena_(1024)		// TODO: size to multiple of OpNode
+	arena_(1024),		// TODO: size to multiple of OpNode
+	origins_(1, { std::string_view(), false }),
+	currentOrigin_(0)
 {
 }
 
@@ -55,6 +57,7 @@ const char* OPCODE_NAMES[] =
 	"LOAD_NUM",
 	"CODE_TO_STR",
 	"STR_TO_NUM",
+	"CODE_TO_NUM",
 	"FEATURE_TYPE",
 	"GOTO",
 	"RETURN"
@@ -85,6 +88,7 @@ uint8_t OPCODE_ARGS[] =
 	1, // LOAD_NUM
 	0, // CODE_TO_STR
 	1, // STR_TO_NUM
+	1, // CODE_TO_NUM
 	3, // FEATURE_TYPE (2-word operand)
 	1, // GOTO
 	0  // RETURN (argument is stored in flags)
@@ -115,6 +119,7 @@ OperandType OPCODE_OPERAND_TYPES[] =
 	OperandType::NONE, // LOAD_NUM
 	OperandType::NONE, // CODE_TO_STR
 	OperandType::NONE, // STR_TO_NUM
+	OperandType::NONE, // CODE_TO_NUM
 	OperandType::FEATURE_TYPES, // FEATURE_TYPE (2-word operand)
 	OperandType::NONE, // GOTO
 	OperandType::NONE  // RETURN (argument is stored in flags)
@@ -126,6 +131,7 @@ OperandType OPCODE_OPERAND_TYPES[] =
 OpNode* OpGraph::createGoto(OpNode* target)
 {
 	OpNode* node = newOp(Opcode::GOTO);
+	node->origin = target->origin;
 	node->next[0] = target;
 	node->next[1] = target;		// TODO: check !!!
 	return node;
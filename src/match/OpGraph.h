@@ -2,8 +2,9 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #pragma once
-#include <regex>
+#include <clarisma/text/Regex.h>
 #include <string_view>
+#include <vector>
 #include <clarisma/alloc/Arena.h>
 #include <geodesk/feature/FeatureTypes.h>
 #include <geodesk/feature/types.h>
@@ -45,6 +46,7 @@ enum Opcode
 	LOAD_NUM,
 	CODE_TO_STR,
 	STR_TO_NUM,
+	CODE_TO_NUM,
 	FEATURE_TYPE,		// 4-word instruction (opcode, int32, jump)
 	GOTO,
 	RETURN,
@@ -94,14 +96,14 @@ class RegexOperand
 {
 public:
 	RegexOperand(const char* s, int len, RegexOperand* next)
-		: next_(next), regexResource_(nullptr), regex_(std::string(s, len)) {}
+		: next_(next), regexResource_(nullptr), regex_(std::string_view(s, len)) {}
 		// Must init next_ first to we have a valid chain in case
 		// regex constructor fails
 	
-	std::regex& regex()  { return regex_; }
+	clarisma::Regex& regex()  { return regex_; }
 	RegexOperand* next() { return next_; }
-	const std::regex* regexResource() const { return regexResource_; }
-	void setRegexResource(const std::regex* pRegex) { regexResource_ = pRegex; }
+	const clarisma::Regex* regexResource() const { return regexResource_; }
+	void setRegexResource(const clarisma::Regex* pRegex) { regexResource_ = pRegex; }
 
 private:
 	/**
@@ -113,14 +115,14 @@ private:
 	 * Pointer to the regex in the MatcherHolder. This is initially null
 	 * and will be assigned an adress by the MatcherEmitter.
 	 */
-	const std::regex* regexResource_;
+	const clarisma::Regex* regexResource_;
 
 	/**
 	 * The compiled regex. Once parsing is successful, this regex will be
 	 * transferred to regexResource_ (using move cosntruction) during 
 	 * opcode generation. 
 	 */
-	std::regex regex_;
+	clarisma::Regex regex_;
 };
 
 struct Operand
@@ -138,6 +140,8 @@ struct Operand
 struct OpNode
 {
 	uint8_t  opcode;
+	uint16_t origin;		// the clause or selector this op belongs to
+							// (see OpGraph::Origin; 0 if unknown)
 	uint16_t operandLen;
 	uint32_t flags;
 	uint32_t address;
@@ -184,11 +188,37 @@ extern OperandType OPCODE_OPERAND_TYPES[];
 class OpGraph
 {
 public:
+	/**
+	 * The part of the query text (a selector or one of its tag
+	 * clauses) that caused an op to be created. Only used for
+	 * diagnostics (see MatcherProfiler); the text points into
+	 * the query, which must outlive the OpGraph if it is used.
+	 */
+	struct Origin
+	{
+		std::string_view text;
+		bool isSelector;
+	};
+
 	OpGraph();
 	~OpGraph();
 
 	clarisma::Arena& arena() { return arena_; }
 
+	/// Adds an origin (its text is filled in once its end has been
+	/// parsed), or returns 0 if there are too many to tell apart
+	uint16_t addOrigin(bool isSelector)
+	{
+		if (origins_.size() > 0xffff) return 0;
+		origins_.push_back({ std::string_view(), isSelector });
+		return static_cast<uint16_t>(origins_.size() - 1);
+	}
+	Origin& origin(uint16_t n) { return origins_[n]; }
+	const std::vector<Origin>& origins() const { return origins_; }
+
+	/// Sets the origin of the ops created from now on
+	void setOrigin(uint16_t n) { currentOrigin_ = n; }
+
 	RegexOperand* addRegex(const char* s, int len);
 	RegexOperand* firstRegex() const { return firstRegex_;  }
 
@@ -241,6 +271,7 @@ public:
 	{
 		OpNode* node = arena_.alloc<OpNode>();
 		new(node)OpNode(op);
+		node->origin = currentOrigin_;
 		return node;
 	}
 
@@ -248,6 +279,7 @@ public:
 	{
 		OpNode* node = arena_.alloc<OpNode>();
 		new(node)OpNode(op);
+		node->origin = currentOrigin_;
 		node->next[0] = falseOp;
 		node->next[1] = trueOp;
 		return node;
@@ -263,6 +295,8 @@ public:
 private:
 	clarisma::Arena arena_;
 	RegexOperand* firstRegex_;
+	std::vector<Origin> origins_;
+	uint16_t currentOrigin_;
 };
 
 
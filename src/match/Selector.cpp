@@ -10,6 +10,7 @@ Selector::Selector(FeatureTypes types) :
 	acceptedTypes(types),
 	indexBits(0),
 	firstClause(nullptr),
+	origin(0),
 	falseOp(Opcode::RETURN)
 {
 }
@@ -20,6 +20,7 @@ public:
 	FeatureTypes acceptedTypes;
 	uint32_t indexBits;
 	TagClause* firstClause;
+	uint16_t origin;		// see OpGraph::Origin
 	OpNode falseOp;
 };
 
@@ -11,7 +11,8 @@ TagClause::TagClause(int keyCode, int cat) :
 	keyOp(Opcode::GLOBAL_KEY),
 	trueOp(Opcode::RETURN),
 	category(cat),
-	flags(0)
+	flags(0),
+	origin(0)
 {
 	keyOp.operand.code = keyCode;
 	trueOp.operand.code = 1;
@@ -23,7 +24,8 @@ TagClause::TagClause(std::string_view key) :
 	keyOp(Opcode::LOCAL_KEY),
 	trueOp(Opcode::RETURN),
 	category(0),
-	flags(0)
+	flags(0),
+	origin(0)
 {
 	keyOp.setStringOperand(key);
 	trueOp.operand.code = 1;
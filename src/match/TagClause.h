@@ -59,6 +59,7 @@ public:
 	TagClause* next;
 	int category;
 	uint32_t flags;
+	uint16_t origin;		// see OpGraph::Origin
 	OpNode keyOp;
 	OpNode trueOp;
 };
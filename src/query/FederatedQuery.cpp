@@ -0,0 +1,148 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/FederatedQuery.h>
+#include <geodesk/feature/FeatureIterator.h>
+#include <geodesk/feature/NodePtr.h>
+
+namespace geodesk {
+
+FederatedQuery::FederatedQuery(std::span<const View> views) :
+    batchPos_(0),
+    current_(0),
+    readyEpoch_(0)
+{
+    sources_.resize(views.size());
+    for (size_t i = 0; i < views.size(); i++)
+    {
+        const View& view = views[i];
+        Source& source = sources_[i];
+        source.store = view.store();
+        if (view.view() == View::WORLD)
+        {
+            source.query = std::make_unique<Query>(view.store(), view.bounds(),
+                view.types(), view.matcher(), view.filter());
+        }
+        else
+        {
+            for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+            {
+                source.features.push_back((*iter).ptr());
+            }
+        }
+    }
+
+    // Features can only be present in more than one store
+    // where the stores' coverage overlaps
+    for (size_t i = 0; i < sources_.size(); i++)
+    {
+        for (size_t j = i + 1; j < sources_.size(); j++)
+        {
+            if (sources_[i].store == sources_[j].store) continue;
+            Box overlap = Box::simpleIntersection(sources_[i].store->coverage(),
+                sources_[j].store->coverage());
+            if (!overlap.isEmpty()) borders_.push_back(overlap);
+        }
+    }
+}
+
+
+FeaturePtr FederatedQuery::next(FeatureStore** pStore)
+{
+    for (;;)
+    {
+        while (batchPos_ < batch_.size())
+        {
+            FeaturePtr pFeature = batch_[batchPos_++];
+            if (isDuplicate(pFeature)) continue;
+            *pStore = sources_[current_].store;
+            return pFeature;
+        }
+        batch_.clear();
+        batchPos_ = 0;
+        if (!fill()) return FeaturePtr();
+    }
+}
+
+
+/**
+ * Fetches the next batch of features from whichever store has any,
+ * starting with the store after the one we took the last batch from
+ * (so no store is starved). If all are still scanning tiles, waits
+ * until one of them has more results.
+ *
+ * @return false if all stores are done
+ */
+bool FederatedQuery::fill()
+{
+    for (;;)
+    {
+        uint32_t epoch = readyEpoch_.load(std::memory_order_acquire);
+        bool pending = false;
+        for (size_t n = 1; n <= sources_.size(); n++)
+        {
+            size_t i = (current_ + n) % sources_.size();
+            Source& source = sources_[i];
+            if (source.done) continue;
+            if (!source.query)
+            {
+                source.done = true;
+                if (source.features.empty()) continue;
+                batch_.swap(source.features);
+                current_ = i;
+                return true;
+            }
+            Query::Status status = source.query->poll(batch_);
+            if (status == Query::Status::READY)
+            {
+                current_ = i;
+                return true;
+            }
+            if (status == Query::Status::DONE)
+            {
+                source.done = true;
+                continue;
+            }
+            pending = true;
+        }
+        if (!pending) return false;
+
+        bool armed = true;
+        for (Source& source : sources_)
+        {
+            if (source.done) continue;
+            if (!source.query->onReady(&FederatedQuery::ready, this))
+            {
+                // Results arrived in the meantime
+                armed = false;
+                break;
+            }
+        }
+        if (armed) readyEpoch_.wait(epoch, std::memory_order_acquire);
+    }
+}
+
+
+void FederatedQuery::ready(void* context)
+{
+    FederatedQuery* self = static_cast<FederatedQuery*>(context);
+    self->readyEpoch_.fetch_add(1, std::memory_order_release);
+    self->readyEpoch_.notify_one();
+}
+
+
+bool FederatedQuery::isDuplicate(FeaturePtr pFeature)
+{
+    if (borders_.empty()) return false;
+    Box bounds = pFeature.isNode() ? NodePtr(pFeature).bounds() : pFeature.bounds();
+    for (const Box& border : borders_)
+    {
+        if (border.intersects(bounds))
+        {
+            return !seen_.insert(static_cast<uint64_t>(pFeature.idBits()));
+        }
+    }
+    return false;
+}
+
+} // namespace geodesk
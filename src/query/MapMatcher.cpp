@@ -0,0 +1,371 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/MapMatcher.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+#include <clarisma/alloc/Arena.h>
+#include <geodesk/geom/Distance.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/PointSegmentDistance.h>
+#include <geodesk/geom/Tile.h>
+#include <geodesk/geom/index/HilbertTreeBuilder.h>
+#include <geodesk/geom/index/MonotoneChain.h>
+#include <geodesk/geom/index/PackedRTree.h>
+#include <geodesk/geom/index/WaySlicer.h>
+#include <geodesk/geom/index/hilbert.h>
+
+namespace geodesk {
+
+namespace {
+
+/// Runs `job` for each number up to `jobCount`, on up to `threads`
+/// threads (including the calling thread)
+void runParallel(int threads, size_t jobCount, const std::function<void(size_t)>& job)
+{
+    std::atomic<size_t> next = 0;
+    auto work = [&next, jobCount, &job]()
+    {
+        for (;;)
+        {
+            size_t n = next.fetch_add(1, std::memory_order_relaxed);
+            if (n >= jobCount) break;
+            job(n);
+        }
+    };
+    int threadCount = static_cast<int>(std::min<size_t>(
+        std::max(threads, 1), std::max<size_t>(jobCount, 1)));
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++) workers.emplace_back(work);
+    work();
+    for (std::thread& worker : workers) worker.join();
+}
+
+/// A monotone chain of a way (variable-length, allocated in an Arena)
+struct WayChain
+{
+    static size_t storageSize(int vertexCount)
+    {
+        return sizeof(WayChain) - sizeof(MonotoneChain) +
+            MonotoneChain::storageSize(vertexCount);
+    }
+
+    uint64_t way;
+    uint32_t padding;     // explicit padding (MC always has an odd number of ints)
+    MonotoneChain chain;
+};
+
+/// The candidates of a point, gathered while searching the chains
+struct CandidateSearch
+{
+    CandidateSearch(Coordinate pt, double maxDistanceSquared,
+        std::vector<std::pair<double,const WayChain*>>& hits) :
+        point(pt),
+        distance(pt),
+        maxDistanceSquared(maxDistanceSquared),
+        hits(hits)
+    {
+    }
+
+    Coordinate point;
+    PointSegmentDistance distance;
+    double maxDistanceSquared;
+    std::vector<std::pair<double,const WayChain*>>& hits;
+};
+
+bool measureChain(const RTree<const WayChain>::Node* node, CandidateSearch* search)
+{
+    const WayChain* wc = node->item();
+    double d = search->distance.minSquared(
+        wc->chain.coordinates(), wc->chain.vertexCount());
+    if (d <= search->maxDistanceSquared) search->hits.emplace_back(d, wc);
+    return false;
+}
+
+/// The point on the chain closest to `pt`
+Coordinate closestPoint(const MonotoneChain& chain, Coordinate pt)
+{
+    const Coordinate* c = chain.coordinates();
+    double bestDistance = std::numeric_limits<double>::infinity();
+    double bestX = c[0].x;
+    double bestY = c[0].y;
+    for (int i = 0; i < chain.vertexCount() - 1; i++)
+    {
+        double x1 = c[i].x;
+        double y1 = c[i].y;
+        double dx = c[i + 1].x - x1;
+        double dy = c[i + 1].y - y1;
+        double lenSquared = dx * dx + dy * dy;
+        double t = lenSquared == 0 ? 0 : std::clamp(
+            ((pt.x - x1) * dx + (pt.y - y1) * dy) / lenSquared, 0.0, 1.0);
+        double x = x1 + t * dx;
+        double y = y1 + t * dy;
+        double d = (pt.x - x) * (pt.x - x) + (pt.y - y) * (pt.y - y);
+        if (d < bestDistance)
+        {
+            bestDistance = d;
+            bestX = x;
+            bestY = y;
+        }
+    }
+    return Coordinate(static_cast<int32_t>(std::round(bestX)),
+        static_cast<int32_t>(std::round(bestY)));
+}
+
+} // namespace
+
+
+MapMatcher::MapMatcher(const std::vector<Trace>& traces, const Settings& settings) :
+    settings_(settings)
+{
+    settings_.maxCandidates = std::clamp(settings_.maxCandidates, 1, 255);
+    traceStarts_.reserve(traces.size() + 1);
+    for (const Trace& trace : traces)
+    {
+        traceStarts_.push_back(static_cast<uint32_t>(points_.size()));
+        points_.insert(points_.end(), trace.begin(), trace.end());
+    }
+    traceStarts_.push_back(static_cast<uint32_t>(points_.size()));
+    assert(points_.size() < UINT32_MAX);
+    buildCells();
+}
+
+
+MapMatcher::~MapMatcher() = default;
+
+
+/**
+ * Sorts the points by the Hilbert distance of the cell in which they
+ * lie, so that neighbouring cells are likely to be processed together,
+ * then determines the padded bounds of the points of each cell.
+ */
+void MapMatcher::buildCells()
+{
+    std::vector<uint64_t> keys(points_.size());
+    for (size_t i = 0; i < points_.size(); i++)
+    {
+        Coordinate c = points_[i];
+        uint32_t col = Tile::columnFromXZ(c.x, CELL_ZOOM);
+        uint32_t row = Tile::rowFromYZ(c.y, CELL_ZOOM);
+        keys[i] = (static_cast<uint64_t>(hilbert::calculateHilbertDistance(col, row)) << 32) | i;
+    }
+    std::sort(keys.begin(), keys.end());
+
+    cellPoints_.resize(keys.size());
+    size_t i = 0;
+    while (i < keys.size())
+    {
+        Cell& cell = cells_.emplace_back();
+        cell.pointsStart = static_cast<uint32_t>(i);
+        Box bounds;
+        uint64_t cellKey = keys[i] >> 32;
+        do
+        {
+            uint32_t point = static_cast<uint32_t>(keys[i]);
+            cellPoints_[i] = point;
+            bounds.expandToInclude(points_[point]);
+            i++;
+        }
+        while (i < keys.size() && (keys[i] >> 32) == cellKey);
+        cell.pointsEnd = static_cast<uint32_t>(i);
+
+        // Pad by the search distance at the latitude furthest from
+        // the equator (where a meter spans the most units)
+        double y = std::max(std::abs(static_cast<double>(bounds.minY())),
+            std::abs(static_cast<double>(bounds.maxY())));
+        bounds.buffer(static_cast<int32_t>(std::ceil(
+            Mercator::unitsFromMeters(settings_.searchMeters, y))));
+        cellBoxes_.push_back(bounds);
+    }
+    cellWays_.resize(cells_.size());
+}
+
+
+void MapMatcher::addWay(uint32_t cell, WayPtr way)
+{
+    cellWays_[cell].push_back(way);
+}
+
+
+/**
+ * Indexes the chains of the ways of a cell, then finds the nearest
+ * ways of each of its points, keeping the closest chain of each way.
+ */
+void MapMatcher::findCandidates(uint32_t cellIndex)
+{
+    const Cell& cell = cells_[cellIndex];
+    std::vector<WayPtr>& ways = cellWays_[cellIndex];
+    if (ways.empty()) return;
+
+    clarisma::Arena arena(16 * 1024, clarisma::Arena::GrowthPolicy::DOUBLE);
+    std::vector<BoundedItem> items;
+    for (WayPtr way : ways)
+    {
+        WaySlicer slicer(way);
+        do
+        {
+            WayChain* wc = arena.allocWithExplicitSize<WayChain>(
+                WayChain::storageSize(MAX_CHAIN_VERTEXES));
+            wc->way = way.id();
+            slicer.slice(&wc->chain, MAX_CHAIN_VERTEXES);
+            // Give back the unused space to the Arena
+            int unusedVertexes = MAX_CHAIN_VERTEXES - wc->chain.vertexCount();
+            arena.reduceLastAlloc(unusedVertexes * sizeof(Coordinate));
+            items.push_back({ wc->chain.bounds(), wc });
+        }
+        while (slicer.hasMore());
+    }
+    std::vector<WayPtr>().swap(ways);
+
+    HilbertTreeBuilder treeBuilder(&arena);
+    PackedRTree<const WayChain> index = treeBuilder.buildPacked<const WayChain>(
+        items.data(), items.size(), Box());
+
+    int maxCandidates = settings_.maxCandidates;
+    std::vector<std::pair<double,const WayChain*>> hits;
+    for (uint32_t i = cell.pointsStart; i < cell.pointsEnd; i++)
+    {
+        uint32_t point = cellPoints_[i];
+        Coordinate pt = points_[point];
+        double metersPerUnit = Mercator::metersPerUnitAtY(pt.y);
+        double radius = settings_.searchMeters / metersPerUnit;
+        hits.clear();
+        CandidateSearch search(pt, radius * radius, hits);
+        index.search(Box::unitsAroundXY(static_cast<int32_t>(std::ceil(radius)), pt),
+            measureChain, &search);
+
+        // Keep the closest chain of each way, nearest ways first
+        std::sort(hits.begin(), hits.end(), [](const auto& a, const auto& b)
+        {
+            return a.first != b.first ? a.first < b.first : a.second->way < b.second->way;
+        });
+        Candidate* candidates = &candidates_[static_cast<size_t>(point) * maxCandidates];
+        int count = 0;
+        for (const auto& [d, wc] : hits)
+        {
+            if (count == maxCandidates) break;
+            bool seen = false;
+            for (int n = 0; n < count; n++) seen |= candidates[n].way == wc->way;
+            if (seen) continue;
+            candidates[count++] = { wc->way, closestPoint(wc->chain, pt),
+                static_cast<float>(std::sqrt(d) * metersPerUnit) };
+        }
+        candidateCounts_[point] = static_cast<uint8_t>(count);
+    }
+}
+
+
+/**
+ * Picks the most likely candidate for each point of a trace (Viterbi).
+ * Scores are log-probabilities (up to a constant), so the score of a
+ * path is the sum of its emission and transition scores.
+ */
+void MapMatcher::matchTrace(size_t trace, MatchedTrace& matched) const
+{
+    uint32_t start = traceStarts_[trace];
+    uint32_t end = traceStarts_[trace + 1];
+    int maxCandidates = settings_.maxCandidates;
+    matched.resize(end - start);
+
+    double emissionFactor = -0.5 / (settings_.sigmaMeters * settings_.sigmaMeters);
+    double transitionFactor = -1.0 / settings_.betaMeters;
+    std::vector<double> scores(maxCandidates);
+    std::vector<double> nextScores(maxCandidates);
+    std::vector<uint8_t> previous(static_cast<size_t>(end - start) * maxCandidates);
+
+    // Walks back along the best path of the run of points that ends
+    // before `runEnd`
+    auto backtrack = [&](uint32_t runStart, uint32_t runEnd)
+    {
+        uint32_t last = runEnd - 1;
+        int best = static_cast<int>(std::max_element(
+            scores.begin(), scores.begin() + candidateCounts_[last]) - scores.begin());
+        for (uint32_t p = runEnd; p > runStart; p--)
+        {
+            uint32_t point = p - 1;
+            const Candidate& c = candidates_[static_cast<size_t>(point) * maxCandidates + best];
+            matched[point - start] = { c.way, c.location, c.meters };
+            best = previous[static_cast<size_t>(point - start) * maxCandidates + best];
+        }
+    };
+
+    uint32_t runStart = start;
+    for (uint32_t point = start; point < end; point++)
+    {
+        int count = candidateCounts_[point];
+        if (count == 0)
+        {
+            // An unmatched point splits the trace
+            if (runStart < point) backtrack(runStart, point);
+            runStart = point + 1;
+            continue;
+        }
+        const Candidate* candidates = &candidates_[static_cast<size_t>(point) * maxCandidates];
+        if (point == runStart)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                double m = candidates[i].meters;
+                scores[i] = emissionFactor * m * m;
+            }
+            continue;
+        }
+        int prevCount = candidateCounts_[point - 1];
+        const Candidate* prevCandidates = &candidates_[static_cast<size_t>(point - 1) * maxCandidates];
+        double pointMeters = Distance::metersBetween(points_[point - 1], points_[point]);
+        uint8_t* prev = &previous[static_cast<size_t>(point - start) * maxCandidates];
+        for (int i = 0; i < count; i++)
+        {
+            double best = -std::numeric_limits<double>::infinity();
+            int bestPrev = 0;
+            for (int j = 0; j < prevCount; j++)
+            {
+                double candidateMeters = Distance::metersBetween(
+                    prevCandidates[j].location, candidates[i].location);
+                double score = scores[j] +
+                    transitionFactor * std::abs(candidateMeters - pointMeters);
+                if (score > best)
+                {
+                    best = score;
+                    bestPrev = j;
+                }
+            }
+            double m = candidates[i].meters;
+            nextScores[i] = best + emissionFactor * m * m;
+            prev[i] = static_cast<uint8_t>(bestPrev);
+        }
+        std::swap(scores, nextScores);
+    }
+    if (runStart < end) backtrack(runStart, end);
+}
+
+
+std::vector<MapMatcher::MatchedTrace> MapMatcher::match(int threads)
+{
+    size_t slotCount = points_.size() * settings_.maxCandidates;
+    candidates_.reset(new Candidate[slotCount]);
+    candidateCounts_.reset(new uint8_t[points_.size()]());
+
+    runParallel(threads, cells_.size(), [this](size_t cell)
+    {
+        findCandidates(static_cast<uint32_t>(cell));
+    });
+
+    size_t traceCount = traceStarts_.size() - 1;
+    std::vector<MatchedTrace> results(traceCount);
+    runParallel(threads, traceCount, [this, &results](size_t trace)
+    {
+        matchTrace(trace, results[trace]);
+    });
+    candidates_.reset();
+    candidateCounts_.reset();
+    return results;
+}
+
+} // namespace geodesk
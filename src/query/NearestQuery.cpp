@@ -0,0 +1,277 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/NearestQuery.h>
+#include <cmath>
+#include <limits>
+#include <geodesk/filter/PointDistanceFilter.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/match/Matcher.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+NearestQuery::NearestQuery(FeatureStore* store, const Box& bounds, FeatureTypes types,
+    const MatcherHolder* matcher, const Filter* filter,
+    Coordinate xy, double maxMeters) :
+    store_(store),
+    bounds_(bounds),
+    types_(types),
+    matcher_(matcher),
+    filter_(filter),
+    xy_(xy),
+    maxDistanceSquared_(std::numeric_limits<double>::infinity()),
+    metersPerUnit_(Mercator::metersPerUnitAtY(xy.y)),
+    lastDistanceSquared_(0)
+{
+    double d = Mercator::unitsFromMeters(maxMeters, xy.y);
+    if (std::isfinite(d))
+    {
+        maxDistanceSquared_ = d * d;
+
+        // Only walk the tiles within range (unless the range crosses
+        // the Antimeridian, in which case we fall back to the view's bounds)
+        int64_t units = static_cast<int64_t>(std::ceil(d));
+        if (xy.x - units >= std::numeric_limits<int32_t>::min() &&
+            xy.x + units <= std::numeric_limits<int32_t>::max() &&
+            bounds_.isSimple())
+        {
+            bounds_ = Box::simpleIntersection(bounds_,
+                Box::unitsAroundXY(static_cast<int32_t>(units), xy));
+        }
+    }
+    if (bounds_.isEmpty()) return;
+
+    // The tile index itself is tiny compared to the tiles, so we
+    // enqueue all tiles within range up front; a tile is only fetched
+    // once it reaches the head of the queue
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(), bounds_, filter);
+    if (!walker.next()) return;
+    do
+    {
+        double distanceSquared = boxDistanceSquared(walker.currentTile().bounds());
+        if (distanceSquared >= maxDistanceSquared_) continue;
+        tiles_.push_back({ walker.currentTip(),
+            FastFilterHint(walker.turboFlags(), walker.currentTile(),
+                walker.currentTip()) });
+        push(distanceSquared, nullptr, static_cast<uint32_t>(tiles_.size() - 1), TILE);
+    }
+    while (walker.next());
+}
+
+
+double NearestQuery::meters() const
+{
+    return std::sqrt(lastDistanceSquared_) * metersPerUnit_;
+}
+
+
+double NearestQuery::boxDistanceSquared(const Box& box) const
+{
+    double dx = std::max({ static_cast<double>(box.minX()) - xy_.x,
+        static_cast<double>(xy_.x) - box.maxX(), 0.0 });
+    double dy = std::max({ static_cast<double>(box.minY()) - xy_.y,
+        static_cast<double>(xy_.y) - box.maxY(), 0.0 });
+    return dx * dx + dy * dy;
+}
+
+
+void NearestQuery::push(double distanceSquared, const uint8_t* p, uint32_t tile, Kind kind)
+{
+    if (distanceSquared >= maxDistanceSquared_) return;
+    queue_.push({ distanceSquared, p, tile, kind });
+}
+
+
+FeaturePtr NearestQuery::next()
+{
+    while (!queue_.empty())
+    {
+        Entry entry = queue_.top();
+        queue_.pop();
+        switch (entry.kind)
+        {
+        case TILE:
+            expandTile(entry);
+            break;
+        case BRANCH:
+            expandBranch(entry, false);
+            break;
+        case NODE_BRANCH:
+            expandBranch(entry, true);
+            break;
+        case LEAF:
+            expandLeaf(entry);
+            break;
+        case NODE_LEAF:
+            expandNodeLeaf(entry);
+            break;
+        case CANDIDATE:
+        {
+            // The bbox distance has brought this feature to the head of
+            // the queue; now check it for real and re-enqueue it with its
+            // exact distance (which can never be smaller)
+            FeaturePtr pFeature(DataPtr(entry.p) + 16);
+            if (!matcher_->mainMatcher().accept(pFeature)) break;
+            if (!acceptFilter(pFeature, entry.tile)) break;
+            double distanceSquared = PointDistanceFilter::distanceSquared(
+                store_, pFeature, xy_);
+            push(std::max(distanceSquared, entry.distanceSquared),
+                pFeature.ptr().ptr(), entry.tile, FEATURE);
+            break;
+        }
+        case NODE_CANDIDATE:
+        {
+            FeaturePtr pFeature(DataPtr(entry.p));
+            if (!matcher_->mainMatcher().accept(pFeature)) break;
+            if (!acceptFilter(pFeature, entry.tile)) break;
+            lastDistanceSquared_ = entry.distanceSquared;
+            return pFeature;
+        }
+        case FEATURE:
+        {
+            // A feature that spans tiles is found in each of them
+            // (with the same distance)
+            FeaturePtr pFeature(DataPtr(entry.p));
+            if ((pFeature.flags() & (FeatureFlags::MULTITILE_NORTH |
+                FeatureFlags::MULTITILE_WEST)) &&
+                !multiTileFeatures_.insert(static_cast<uint64_t>(pFeature.idBits())))
+            {
+                break;
+            }
+            lastDistanceSquared_ = entry.distanceSquared;
+            return pFeature;
+        }
+        }
+    }
+    return FeaturePtr();
+}
+
+
+bool NearestQuery::acceptFilter(FeaturePtr pFeature, uint32_t tile) const
+{
+    return filter_ == nullptr || filter_->accept(store_, pFeature, tiles_[tile].hint);
+}
+
+
+void NearestQuery::expandTile(const Entry& entry)
+{
+    DataPtr pTile = store_->fetchTile(tiles_[entry.tile].tip);
+    if (types_ & FeatureTypes::NODES)
+    {
+        expandRoots(pTile + 8, FeatureIndexType::NODES,
+            entry.distanceSquared, entry.tile, true);
+    }
+    if (types_ & FeatureTypes::NONAREA_WAYS)
+    {
+        expandRoots(pTile + 8 + FeatureIndexType::WAYS * 4, FeatureIndexType::WAYS,
+            entry.distanceSquared, entry.tile, false);
+    }
+    if (types_ & FeatureTypes::AREAS)
+    {
+        expandRoots(pTile + 8 + FeatureIndexType::AREAS * 4, FeatureIndexType::AREAS,
+            entry.distanceSquared, entry.tile, false);
+    }
+    if (types_ & FeatureTypes::NONAREA_RELATIONS)
+    {
+        expandRoots(pTile + 8 + FeatureIndexType::RELATIONS * 4, FeatureIndexType::RELATIONS,
+            entry.distanceSquared, entry.tile, false);
+    }
+}
+
+
+/**
+ * Enqueues the root(s) of one of the tile's indexes. Roots have no
+ * bounding box of their own, so they inherit the distance of the tile.
+ */
+void NearestQuery::expandRoots(DataPtr ppRoot, FeatureIndexType indexType,
+    double distanceSquared, uint32_t tile, bool isNodeIndex)
+{
+    int32_t ptr = ppRoot.getInt();
+    if (ptr == 0) return;
+    if ((ptr & 1) == 0)
+    {
+        pushChild(ppRoot, distanceSquared, tile, isNodeIndex);
+        return;
+    }
+    DataPtr p = ppRoot + (ptr ^ 1);
+    for (;;)
+    {
+        int32_t last = p.getInt() & 1;
+        int32_t keys = (p+4).getInt();
+        if (matcher_->acceptIndex(indexType, keys))
+        {
+            pushChild(p, distanceSquared, tile, isNodeIndex);
+        }
+        if (last != 0) break;
+        p += 8;
+    }
+}
+
+
+void NearestQuery::pushChild(DataPtr pEntry, double distanceSquared,
+    uint32_t tile, bool isNodeIndex)
+{
+    int32_t ptr = pEntry.getInt();
+    if (ptr == 0) return;
+    DataPtr pChild = pEntry + (ptr & 0xffff'fffc);
+    Kind kind = (ptr & 2) ?
+        (isNodeIndex ? NODE_LEAF : LEAF) :
+        (isNodeIndex ? NODE_BRANCH : BRANCH);
+    push(distanceSquared, pChild.ptr(), tile, kind);
+}
+
+
+void NearestQuery::expandBranch(const Entry& entry, bool isNodeIndex)
+{
+    DataPtr p(entry.p);
+    for (;;)
+    {
+        const Box& box = *reinterpret_cast<const Box*>(p.ptr() + 4);
+        if (bounds_.intersects(box))
+        {
+            pushChild(p, boxDistanceSquared(box), entry.tile, isNodeIndex);
+        }
+        if (p.getInt() & 1) break;
+        p += 20;
+    }
+}
+
+
+void NearestQuery::expandLeaf(const Entry& entry)
+{
+    DataPtr p(entry.p);
+    for (;;)
+    {
+        int32_t flags = (p+16).getInt();
+        const Box& box = *reinterpret_cast<const Box*>(p.ptr());
+        if (types_.acceptFlags(flags) && bounds_.intersects(box))
+        {
+            push(boxDistanceSquared(box), p.ptr(), entry.tile, CANDIDATE);
+        }
+        if (flags & 1) break;
+        p += 32;
+    }
+}
+
+
+void NearestQuery::expandNodeLeaf(const Entry& entry)
+{
+    DataPtr p(entry.p);
+    for (;;)
+    {
+        int32_t x = p.getInt();
+        int32_t y = (p+4).getInt();
+        int32_t flags = (p+8).getInt();
+        if (types_.acceptFlags(flags) && bounds_.contains(x, y))
+        {
+            double dx = static_cast<double>(x) - xy_.x;
+            double dy = static_cast<double>(y) - xy_.y;
+            push(dx * dx + dy * dy, (p+8).ptr(), entry.tile, NODE_CANDIDATE);
+        }
+        if (flags & 1) break;
+        p += 20 + (flags & 4);
+    }
+}
+
+} // namespace geodesk
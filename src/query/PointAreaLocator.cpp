@@ -0,0 +1,256 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/PointAreaLocator.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/RelationPtr.h>
+#include <geodesk/feature/WayPtr.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+#include <geodesk/query/Query.h>
+
+namespace geodesk {
+
+PointAreaLocator::PointAreaLocator(std::span<const Coordinate> points) :
+    points_(points),
+    gridSize_(1),
+    cellWidth_(1),
+    cellHeight_(1),
+    store_(nullptr),
+    accelerator_(accelerator())
+{
+    assert(points.size() < UINT32_MAX);
+    buildGrid();
+}
+
+
+/**
+ * Sizes the grid so that each cell holds a handful of points on
+ * average, then sorts the point indexes by cell (a counting sort).
+ */
+void PointAreaLocator::buildGrid()
+{
+    for (Coordinate c : points_) bounds_.expandToInclude(c);
+    size_t count = points_.size();
+    gridSize_ = std::clamp(static_cast<int>(std::sqrt(count / 4.0)), 1, 4096);
+    if (!bounds_.isEmpty())
+    {
+        cellWidth_ = (static_cast<int64_t>(bounds_.maxX()) - bounds_.minX()) / gridSize_ + 1;
+        cellHeight_ = (static_cast<int64_t>(bounds_.maxY()) - bounds_.minY()) / gridSize_ + 1;
+    }
+
+    size_t cellCount = static_cast<size_t>(gridSize_) * gridSize_;
+    cellStarts_.reset(new uint32_t[cellCount + 1]());
+    cellPoints_.reset(new uint32_t[count]);
+    std::unique_ptr<uint32_t[]> cells(new uint32_t[count]);
+    for (size_t i = 0; i < count; i++)
+    {
+        Coordinate c = points_[i];
+        int col = static_cast<int>((static_cast<int64_t>(c.x) - bounds_.minX()) / cellWidth_);
+        int row = static_cast<int>((static_cast<int64_t>(c.y) - bounds_.minY()) / cellHeight_);
+        cells[i] = row * gridSize_ + col;
+        cellStarts_[cells[i] + 1]++;
+    }
+    for (size_t i = 0; i < cellCount; i++) cellStarts_[i + 1] += cellStarts_[i];
+    std::unique_ptr<uint32_t[]> next(new uint32_t[cellCount]);
+    std::copy(cellStarts_.get(), cellStarts_.get() + cellCount, next.get());
+    for (size_t i = 0; i < count; i++)
+    {
+        cellPoints_[next[cells[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+
+void PointAreaLocator::collectCandidates(const Box& box, std::vector<uint32_t>& candidates) const
+{
+    candidates.clear();
+    if (!box.intersects(bounds_)) return;
+    int64_t minX = std::max(box.minX(), bounds_.minX());
+    int64_t minY = std::max(box.minY(), bounds_.minY());
+    int64_t maxX = std::min(box.maxX(), bounds_.maxX());
+    int64_t maxY = std::min(box.maxY(), bounds_.maxY());
+    int startCol = static_cast<int>((minX - bounds_.minX()) / cellWidth_);
+    int endCol = static_cast<int>((maxX - bounds_.minX()) / cellWidth_);
+    int startRow = static_cast<int>((minY - bounds_.minY()) / cellHeight_);
+    int endRow = static_cast<int>((maxY - bounds_.minY()) / cellHeight_);
+    for (int row = startRow; row <= endRow; row++)
+    {
+        // Cells that lie entirely within the box need no
+        // further checks
+        bool rowInside = row > startRow && row < endRow;
+        for (int col = startCol; col <= endCol; col++)
+        {
+            int cell = row * gridSize_ + col;
+            const uint32_t* p = &cellPoints_[cellStarts_[cell]];
+            const uint32_t* end = &cellPoints_[cellStarts_[cell + 1]];
+            if (rowInside && col > startCol && col < endCol)
+            {
+                candidates.insert(candidates.end(), p, end);
+                continue;
+            }
+            for (; p < end; p++)
+            {
+                if (box.containsSimple(points_[*p])) candidates.push_back(*p);
+            }
+        }
+    }
+}
+
+
+void PointAreaLocator::testArea(FeatureStore* store, FeaturePtr area,
+    int threadCount, std::vector<Hit>& hits) const
+{
+    if (!area.isArea()) return;
+    std::vector<uint32_t> candidates;
+    Box areaBounds;
+    if (area.isWay())
+    {
+        areaBounds = WayPtr(area).bounds();
+    }
+    else
+    {
+        areaBounds = RelationPtr(area).bounds();
+    }
+    collectCandidates(areaBounds, candidates);
+    if (candidates.empty()) return;
+
+    MCIndex index;
+    if (area.isWay())
+    {
+        MCIndexBuilder builder;
+        builder.segmentizeWay(WayPtr(area));
+        index = builder.build(areaBounds);
+    }
+    else
+    {
+        index = MCIndexBuilder::buildFromAreaRelation(store, RelationPtr(area));
+    }
+
+    size_t count = candidates.size();
+    std::unique_ptr<Coordinate[]> coords(new Coordinate[count]);
+    for (size_t i = 0; i < count; i++) coords[i] = points_[candidates[i]];
+    std::unique_ptr<bool[]> results(new bool[count]);
+
+    bool offloaded = accelerator_ && count >= accelerator_->minBatchSize() &&
+        accelerator_->containsPoints(FlatChains::fromIndex(index),
+            { coords.get(), count }, results.get());
+    if (!offloaded) testPoints(index, coords.get(), count, threadCount, results.get());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (results[i]) hits.push_back({ candidates[i], area });
+    }
+}
+
+
+void PointAreaLocator::testPoints(const MCIndex& index, const Coordinate* coords,
+    size_t count, int threadCount, bool* results)
+{
+    size_t partCount = count < MIN_PARALLEL_POINT_COUNT ? 1 :
+        std::min(static_cast<size_t>(threadCount), count / MIN_POINTS_PER_THREAD);
+    if (partCount > 1)
+    {
+        // The first part is tested on the calling thread
+        size_t partSize = (count + partCount - 1) / partCount;
+        std::vector<std::thread> threads;
+        threads.reserve(partCount - 1);
+        for (size_t start = partSize; start < count; start += partSize)
+        {
+            size_t n = std::min(partSize, count - start);
+            threads.emplace_back([&index, coords, results, start, n]()
+            {
+                index.containsPoints({ &coords[start], n }, &results[start]);
+            });
+        }
+        index.containsPoints({ &coords[0], partSize }, &results[0]);
+        for (std::thread& thread : threads) thread.join();
+    }
+    else
+    {
+        index.containsPoints({ coords, count }, results);
+    }
+}
+
+
+void PointAreaLocator::addArea(FeatureStore* store, FeaturePtr area)
+{
+    std::vector<Hit> hits;
+    testArea(store, area, store->executor().threadCount(), hits);
+    std::lock_guard lock(mutex_);
+    store_ = store;
+    hits_.insert(hits_.end(), hits.begin(), hits.end());
+}
+
+
+void PointAreaLocator::reduce(FeatureStore* store, const FeaturePtr* features, size_t count)
+{
+    // Called by a worker thread, which may as well do all of the work
+    std::vector<Hit> hits;
+    for (size_t i = 0; i < count; i++)
+    {
+        testArea(store, features[i], 1, hits);
+    }
+    std::lock_guard lock(mutex_);
+    store_ = store;
+    hits_.insert(hits_.end(), hits.begin(), hits.end());
+}
+
+
+void PointAreaLocator::query(FeatureStore* store, const Box& bounds, FeatureTypes types,
+    const MatcherHolder* matcher, const Filter* filter)
+{
+    Box box = Box::simpleIntersection(bounds, bounds_);
+    if (!box.isEmpty())
+    {
+        Query query(store, box, types & FeatureTypes::AREAS, matcher, filter, this);
+        // Areas that span multiple tiles come back to this thread
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            addArea(store, next);
+        }
+    }
+    finish();
+}
+
+
+PointAreaLocator::SharedAccelerator& PointAreaLocator::getSharedAccelerator()
+{
+    static SharedAccelerator shared;
+    return shared;
+}
+
+
+void PointAreaLocator::setAccelerator(std::shared_ptr<PointInPolygonAccelerator> accelerator)
+{
+    SharedAccelerator& shared = getSharedAccelerator();
+    std::lock_guard lock(shared.mutex);
+    shared.accelerator = std::move(accelerator);
+}
+
+
+std::shared_ptr<PointInPolygonAccelerator> PointAreaLocator::accelerator()
+{
+    SharedAccelerator& shared = getSharedAccelerator();
+    std::lock_guard lock(shared.mutex);
+    return shared.accelerator;
+}
+
+
+void PointAreaLocator::finish()
+{
+    offsets_.assign(points_.size() + 1, 0);
+    for (const Hit& hit : hits_) offsets_[hit.point + 1]++;
+    for (size_t i = 0; i < points_.size(); i++) offsets_[i + 1] += offsets_[i];
+    areas_.resize(hits_.size());
+    std::vector<uint64_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (const Hit& hit : hits_) areas_[next[hit.point]++] = hit.area;
+    hits_.clear();
+    hits_.shrink_to_fit();
+}
+
+} // namespace geodesk
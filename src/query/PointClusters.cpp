@@ -0,0 +1,362 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/PointClusters.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <thread>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/feature/FeatureBase.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/geom/Centroid.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// Partitions (which are sorted and clustered independently) are the
+/// tiles of at most this zoom level
+constexpr int MAX_PARTITION_ZOOM = 8;
+
+/// Spreads the bits of `v` to the even bits of the result
+uint64_t spreadBits(uint32_t v)
+{
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000'FFFF'0000'FFFFULL;
+    x = (x | (x << 8)) & 0x00FF'00FF'00FF'00FFULL;
+    x = (x | (x << 4)) & 0x0F0F'0F0F'0F0F'0F0FULL;
+    x = (x | (x << 2)) & 0x3333'3333'3333'3333ULL;
+    x = (x | (x << 1)) & 0x5555'5555'5555'5555ULL;
+    return x;
+}
+
+/// The position of a cell along the Z-order curve; the top bits of the
+/// position of a point are the position of its tile (or cell) at any
+/// zoom level
+uint64_t zOrder(uint32_t column, uint32_t row)
+{
+    return spreadBits(column) | (spreadBits(row) << 1);
+}
+
+/// The Z-order position of a point (with rows counted from the top,
+/// like the rows of tiles)
+uint64_t zOrder(Coordinate c)
+{
+    return zOrder(static_cast<uint32_t>(static_cast<int64_t>(c.x) + (1LL << 31)),
+        static_cast<uint32_t>(0x7fff'ffffLL - c.y));
+}
+
+/// Shifts that may be 64 bits (which is undefined in C++)
+uint64_t shiftRight(uint64_t v, int bits)
+{
+    return bits >= 64 ? 0 : v >> bits;
+}
+
+} // namespace
+
+
+PointClusters::Collector::Collector(FeatureStore* store, int workerCount,
+    const Settings& settings) :
+    settings_(settings),
+    workerCount_(workerCount),
+    slots_(new Slot[workerCount + 1])
+{
+    int cells = settings.cellsPerTile;
+    if (cells < 2 || cells > 256 || (cells & (cells - 1)) != 0)
+    {
+        throw ValueException("cellsPerTile must be a power of 2 between 2 and 256");
+    }
+    int cellBits = std::countr_zero(static_cast<unsigned>(cells));
+    if (settings.minZoom < 0 || settings.maxZoom < settings.minZoom ||
+        settings.maxZoom + cellBits > 32)
+    {
+        throw ValueException("Invalid range of zoom levels");
+    }
+    if (settings.minPoints < 1) throw ValueException("minPoints must be at least 1");
+    if (settings.countedTags.size() > 64)
+    {
+        throw ValueException("At most 64 tags can be counted");
+    }
+    for (const std::string& tag : settings.countedTags)
+    {
+        size_t eq = tag.find('=');
+        std::string key = tag.substr(0, eq);
+        countedTags_.push_back({ store->key(key),
+            eq == std::string::npos ? std::string() : tag.substr(eq + 1) });
+    }
+}
+
+
+void PointClusters::Collector::reduce(FeatureStore* store,
+    const FeaturePtr* features, size_t count)
+{
+    int worker = QueryExecutor::currentWorker();
+    std::vector<Point>& points = slots_[
+        (worker >= 0 && worker < workerCount_) ? worker : workerCount_].points;
+    for (size_t i = 0; i < count; i++)
+    {
+        FeaturePtr feature = features[i];
+        Coordinate xy = feature.isNode() ? NodePtr(feature).xy() :
+            Centroid::ofFeature(store, feature);
+        uint64_t tagBits = 0;
+        if (!countedTags_.empty())
+        {
+            Feature f(store, feature);
+            for (size_t n = 0; n < countedTags_.size(); n++)
+            {
+                const CountedTag& tag = countedTags_[n];
+                bool has = tag.value.empty() ?
+                    (f.hasTag(tag.key) && !(f[tag.key] == std::string_view("no"))) :
+                    f[tag.key] == std::string_view(tag.value);
+                if (has) tagBits |= 1ULL << n;
+            }
+        }
+        points.push_back({ zOrder(xy), xy, feature.typedId(), tagBits });
+    }
+}
+
+
+/// Sorts the points of one partition and clusters them at each zoom
+/// level, from the highest to the lowest. The cells of each level are
+/// formed by merging runs of cells of the next higher level whose keys
+/// share all but their last two bits.
+class PointClusters::Partition
+{
+public:
+    Partition(const PointClusters& clusters, std::vector<Point>& points) :
+        clusters_(clusters),
+        points_(points),
+        tagCount_(clusters.countedTagCount()),
+        levels_(clusters.settings_.maxZoom - clusters.settings_.minZoom + 1)
+    {
+    }
+
+    std::vector<Level>& levels() { return levels_; }
+
+    void build(size_t begin, size_t end)
+    {
+        levels_.assign(levels_.size(), Level());
+        std::sort(points_.begin() + begin, points_.begin() + end,
+            [](const Point& a, const Point& b)
+            {
+                return a.key != b.key ? a.key < b.key : a.typedId < b.typedId;
+            });
+
+        const Settings& settings = clusters_.settings_;
+        Level& finest = levels_.back();
+        int shift = 64 - 2 * clusters_.cellBits(settings.maxZoom);
+        for (size_t i = begin; i < end; )
+        {
+            uint64_t key = shiftRight(points_[i].key, shift);
+            startCell(key, static_cast<uint32_t>(i));
+            for (; i < end && shiftRight(points_[i].key, shift) == key; i++)
+            {
+                const Point& p = points_[i];
+                addToCell(p.xy, 1);
+                for (size_t n = 0; n < tagCount_; n++)
+                {
+                    counts_[n] += (p.tagBits >> n) & 1;
+                }
+            }
+            endCell(finest);
+        }
+
+        for (int level = static_cast<int>(levels_.size()) - 2; level >= 0; level--)
+        {
+            const Level& finer = levels_[level + 1];
+            Level& coarser = levels_[level];
+            for (size_t i = 0; i < finer.cells.size(); )
+            {
+                uint64_t key = finer.cells[i].key >> 2;
+                startCell(key, finer.cells[i].first);
+                for (; i < finer.cells.size() && (finer.cells[i].key >> 2) == key; i++)
+                {
+                    const Cell& cell = finer.cells[i];
+                    addToCell(cell.xy, cell.count);
+                    for (size_t n = 0; n < tagCount_; n++)
+                    {
+                        counts_[n] += finer.tagCounts[i * tagCount_ + n];
+                    }
+                }
+                endCell(coarser);
+            }
+        }
+    }
+
+private:
+    void startCell(uint64_t key, uint32_t first)
+    {
+        cell_ = { key, first, 0, Coordinate() };
+        sumX_ = 0;
+        sumY_ = 0;
+        counts_.assign(tagCount_, 0);
+    }
+
+    void addToCell(Coordinate xy, uint32_t count)
+    {
+        cell_.count += count;
+        sumX_ += static_cast<double>(xy.x) * count;
+        sumY_ += static_cast<double>(xy.y) * count;
+    }
+
+    void endCell(Level& level)
+    {
+        cell_.xy = Coordinate(
+            static_cast<int32_t>(std::round(sumX_ / cell_.count)),
+            static_cast<int32_t>(std::round(sumY_ / cell_.count)));
+        level.cells.push_back(cell_);
+        level.tagCounts.insert(level.tagCounts.end(), counts_.begin(), counts_.end());
+    }
+
+    const PointClusters& clusters_;
+    std::vector<Point>& points_;
+    size_t tagCount_;
+    std::vector<Level> levels_;
+    Cell cell_;
+    double sumX_;
+    double sumY_;
+    std::vector<uint32_t> counts_;
+};
+
+
+/**
+ * Distributes the points among the partitions (the tiles at a low zoom
+ * level, at which each cell of every zoom level lies within a single
+ * partition), then lets each thread claim the next partition in turn
+ * and cluster it. The levels of the partitions are then appended to
+ * each other, in the order of their keys.
+ */
+PointClusters::PointClusters(Collector& collector, int threads) :
+    settings_(collector.settings_),
+    cellsPerTileBits_(std::countr_zero(static_cast<unsigned>(collector.settings_.cellsPerTile))),
+    levels_(collector.settings_.maxZoom - collector.settings_.minZoom + 1)
+{
+    int partitionZoom = std::min(settings_.minZoom + cellsPerTileBits_, MAX_PARTITION_ZOOM);
+    int partitionShift = 64 - 2 * partitionZoom;
+    size_t partitionCount = size_t{1} << (2 * partitionZoom);
+    std::vector<size_t> starts(partitionCount + 1, 0);
+    for (int i = 0; i <= collector.workerCount_; i++)
+    {
+        for (const Point& p : collector.slots_[i].points)
+        {
+            starts[(p.key >> partitionShift) + 1]++;
+        }
+    }
+    for (size_t i = 1; i <= partitionCount; i++) starts[i] += starts[i - 1];
+    points_.resize(starts.back());
+    {
+        std::vector<size_t> next(starts.begin(), starts.end() - 1);
+        for (int i = 0; i <= collector.workerCount_; i++)
+        {
+            std::vector<Point>& points = collector.slots_[i].points;
+            for (const Point& p : points) points_[next[p.key >> partitionShift]++] = p;
+            points = std::vector<Point>();
+        }
+    }
+
+    std::vector<size_t> partitions;
+    for (size_t i = 0; i < partitionCount; i++)
+    {
+        if (starts[i + 1] > starts[i]) partitions.push_back(i);
+    }
+    std::vector<std::vector<Level>> results(partitions.size());
+    std::atomic<size_t> nextPartition(0);
+    auto buildAll = [this, &partitions, &starts, &results, &nextPartition]()
+    {
+        Partition partition(*this, points_);
+        for (;;)
+        {
+            size_t n = nextPartition.fetch_add(1, std::memory_order_relaxed);
+            if (n >= partitions.size()) return;
+            size_t p = partitions[n];
+            partition.build(starts[p], starts[p + 1]);
+            results[n] = std::move(partition.levels());
+            partition.levels().resize(levels_.size());
+        }
+    };
+
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(partitions.size()), 1));
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++) workers.emplace_back(buildAll);
+    buildAll();
+    for (std::thread& worker : workers) worker.join();
+
+    for (size_t level = 0; level < levels_.size(); level++)
+    {
+        Level& merged = levels_[level];
+        for (std::vector<Level>& result : results)
+        {
+            Level& part = result[level];
+            merged.cells.insert(merged.cells.end(), part.cells.begin(), part.cells.end());
+            merged.tagCounts.insert(merged.tagCounts.end(),
+                part.tagCounts.begin(), part.tagCounts.end());
+            part = Level();
+        }
+    }
+}
+
+
+void PointClusters::addPoint(std::vector<Cluster>& clusters, const Point& point) const
+{
+    Cluster& cluster = clusters.emplace_back();
+    cluster.xy = point.xy;
+    cluster.count = 1;
+    cluster.typedId = point.typedId;
+    cluster.tagCounts_ = nullptr;
+    cluster.tagBits_ = point.tagBits;
+}
+
+
+std::vector<PointClusters::Cluster> PointClusters::clusters(int column, int row, int zoom) const
+{
+    std::vector<Cluster> clusters;
+    if (zoom < 0 || zoom > 31) return clusters;
+    uint64_t tileKey = zOrder(static_cast<uint32_t>(column), static_cast<uint32_t>(row));
+
+    if (zoom > settings_.maxZoom)
+    {
+        int shift = 64 - 2 * zoom;
+        auto begin = std::partition_point(points_.begin(), points_.end(),
+            [shift, tileKey](const Point& p) { return shiftRight(p.key, shift) < tileKey; });
+        auto end = std::partition_point(begin, points_.end(),
+            [shift, tileKey](const Point& p) { return shiftRight(p.key, shift) == tileKey; });
+        for (auto it = begin; it != end; ++it) addPoint(clusters, *it);
+        return clusters;
+    }
+
+    int levelZoom = std::max(zoom, settings_.minZoom);
+    const Level& level = levels_[levelZoom - settings_.minZoom];
+    int shift = 2 * (cellBits(levelZoom) - zoom);
+    auto begin = std::partition_point(level.cells.begin(), level.cells.end(),
+        [shift, tileKey](const Cell& c) { return shiftRight(c.key, shift) < tileKey; });
+    auto end = std::partition_point(begin, level.cells.end(),
+        [shift, tileKey](const Cell& c) { return shiftRight(c.key, shift) == tileKey; });
+    size_t tagCount = countedTagCount();
+    for (auto it = begin; it != end; ++it)
+    {
+        const Cell& cell = *it;
+        if (cell.count < static_cast<uint32_t>(settings_.minPoints))
+        {
+            for (uint32_t i = 0; i < cell.count; i++)
+            {
+                addPoint(clusters, points_[cell.first + i]);
+            }
+            continue;
+        }
+        Cluster& cluster = clusters.emplace_back();
+        cluster.xy = cell.xy;
+        cluster.count = cell.count;
+        cluster.typedId = cell.count == 1 ? points_[cell.first].typedId : 0;
+        cluster.tagCounts_ = level.tagCounts.data() + (it - level.cells.begin()) * tagCount;
+        cluster.tagBits_ = 0;
+    }
+    return clusters;
+}
+
+} // namespace geodesk
@@ -0,0 +1,92 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/PreparedQuery.h>
+#include <algorithm>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/feature/TagSummary.h>
+#include <geodesk/feature/TileStatistics.h>
+#include <geodesk/match/Matcher.h>
+
+namespace geodesk {
+
+PreparedQuery::PreparedQuery(const View& view, uint32_t shard, uint32_t shardCount) :
+    view_(view),
+    tileCount_(0),
+    shard_(shard),
+    shardCount_(shardCount),
+    tileBytes_(0)
+{
+    if (view.view() != View::WORLD)
+    {
+        throw QueryException("Only world views can be prepared");
+    }
+    if (shard >= shardCount)
+    {
+        throw QueryException("Invalid shard");
+    }
+    FeatureStore* store = view.store();
+    const MatcherHolder* matcher = view.matcher();
+    const TagSummary* tagSummary = matcher->requiresTags() ?
+        store->tagSummary() : nullptr;
+    uint32_t requiredCategories[4];
+    const TileStatistics* statistics = TileStatistics::requiredCategories(
+        matcher, view.types(), requiredCategories) ?
+        store->tileStatistics() : nullptr;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        view.bounds(), view.filter());
+    walker.next();      // move to the root tile
+    for (;;)
+    {
+        tileCount_++;
+        Tip tip = walker.currentTip();
+        if ((!tagSummary || matcher->mayMatchTile(*tagSummary, tip)) &&
+            (!statistics || statistics->mayMatchTile(tip, requiredCategories)))
+        {
+            tiles_.push_back(Query::currentTile(walker));
+        }
+        if (!walker.next()) break;
+    }
+    Query::sortTiles(tiles_);
+    if (shardCount_ > 1) selectShard();
+}
+
+/**
+ * Keeps only the tiles of this shard. Tile i belongs to the shard in
+ * whose share of the total size the middle of the tile falls, so the
+ * shards are balanced to within the size of a single tile.
+ *
+ * The tiles keep the multi-tile flags of the full cover (which tell
+ * whether the query reaches the tiles to the north and west), so each
+ * shard skips the copies of features that another tile will return,
+ * even if that tile belongs to another shard.
+ */
+void PreparedQuery::selectShard()
+{
+    FeatureStore* store = view_.store();
+    std::vector<uint32_t> sizes;
+    sizes.reserve(tiles_.size());
+    uint64_t totalBytes = 0;
+    for (const Query::OrderedTile& tile : tiles_)
+    {
+        uint32_t size = store->tileBlobSize(Tip(tile.tipAndFlags >> 8));
+        sizes.push_back(size);
+        totalBytes += size;
+    }
+    uint64_t bytesPerShard = std::max<uint64_t>(
+        (totalBytes + shardCount_ - 1) / shardCount_, 1);
+    uint64_t bytesBefore = 0;
+    size_t count = 0;
+    for (size_t i = 0; i < tiles_.size(); i++)
+    {
+        uint64_t middle = bytesBefore + sizes[i] / 2;
+        bytesBefore += sizes[i];
+        uint64_t owner = std::min<uint64_t>(middle / bytesPerShard, shardCount_ - 1);
+        if (owner != shard_) continue;
+        tiles_[count++] = tiles_[i];
+        tileBytes_ += sizes[i];
+    }
+    tiles_.resize(count);
+}
+
+} // namespace geodesk
@@ -2,7 +2,19 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/query/Query.h>
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <clarisma/thread/GilRelease.h>
 #include <clarisma/util/log.h>
+#include <clarisma/util/Tracer.h>
+#include <geodesk/feature/NumericIndex.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/feature/TileStatistics.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <geodesk/query/PostedTasks.h>
+#include <geodesk/query/PreparedQuery.h>
+#include <geodesk/query/ReorderWindow.h>
 #include <geodesk/query/TileQueryTask.h>
 
 namespace geodesk {
@@ -11,18 +23,62 @@ namespace geodesk {
 
 
 Query::Query(FeatureStore* store, const Box& box, FeatureTypes types,
-    const MatcherHolder* matcher, const Filter* filter) :
+    const MatcherHolder* matcher, const Filter* filter, TileReducer* reducer,
+    const Box* boxes, uint32_t boxCount, QueryStats* stats,
+    const QueryOptions& options, const PreparedQuery* prepared,
+    const QueryLayer* layers, uint32_t layerCount) :
     AbstractQuery(store),
     types_(types),
     matcher_(matcher),
     filter_(filter),
+    reducer_(reducer),
+    boxes_(boxes),
+    boxCount_(boxCount),
+    layers_(layers),
+    layerCount_(layerCount),
+    stats_(stats),
+    options_(options),
+    planner_(filter ? filter->cost() : 0),
+    tagSummary_(matcher->requiresTags() ? store->tagSummary() : nullptr),
+    tileStatistics_(TileStatistics::requiredCategories(matcher, types,
+        requiredCategories_) ? store->tileStatistics() : nullptr),
+    numericIndex_(matcher->requiredRange().isRequired() ? store->numericIndex() : nullptr),
+    numericKey_(numericIndex_ ? numericIndex_->findGlobalKey(
+        matcher->requiredRange().keyCode) : -1),
+    cache_((reducer || boxes || layers) ? nullptr : store->queryCache()),
+    tileReader_(reducer ? store->tileReader() : nullptr),
+    scanCache_(store->tileScanCache()),
+    multiBoxRemaining_(0),
     pendingTiles_(0),
     currentResults_(QueryResults::EMPTY),
     currentPos_(QueryResults::EMPTY->count),
     allTilesRequested_(false),
-    tileIndexWalker_(store->tileIndex(), store->zoomLevels(), box, filter),
+    isShard_(prepared && prepared->isShard()),
+    dedupBytes_(0),
+    consumedResults_(0),
+    consumedTiles_(0),
+    resultsPool_(&store->queryMemory()),
+    tileIndexWalker_(store->tileIndex(), store->zoomLevels(), box, filter,
+        stats ? &consumerStats_ : nullptr, boxes, boxCount),
+    tileList_(nullptr),
+    tileCount_(0),
+    sampledTileCount_(0),
+    nextOrderedTile_(0),
+    reorder_(options.ordered ? new ReorderWindow() : nullptr),
+    postedTasks_(nullptr),
     queuedResults_(QueryResults::EMPTY),
-    completedTiles_(0)
+    completedTiles_(0),
+    firstBucketSize_(QueryResults::SMALL_BUCKET_SIZE),
+    cancelled_(false),
+    tileParts_(0),
+    scannedBytes_(0),
+    scannedTiles_(0),
+    readyArmed_(false),
+    offersInFlight_(0),
+    readyCallback_(nullptr),
+    readyContext_(nullptr),
+    wouldBlock_(false),
+    failed_(false)
 {
     /*
     // Don't add refcount to store, wrapper object is responsible for liveness
@@ -33,86 +89,586 @@ Query::Query(FeatureStore* store, const Box& box, FeatureTypes types,
                             // are guaranteed to be kept alive for duration of the
                             // query's lifetime
     */
-    tileIndexWalker_.next();
-        // move the TIW to the root tile (This is not needed in v2,
-        // since next() is called *after* each tile, not before)
+    if (stats) startTime_ = std::chrono::steady_clock::now();
+    for (int i = 0; i < 4; i++)
+    {
+        leafModes_[i] = TileQueryTask::leafMode(
+            static_cast<FeatureIndexType>(i), types, matcher, filter);
+    }
+    if (prepared)
+    {
+        if (options_.sampleFraction < 1)
+        {
+            samplePreparedTiles(*prepared);
+        }
+        else if (options_.focus)
+        {
+            orderedTiles_ = prepared->tiles();
+            tileList_ = &orderedTiles_;
+        }
+        else
+        {
+            tileList_ = &prepared->tiles();
+        }
+    }
+    else
+    {
+        tileIndexWalker_.next();
+            // move the TIW to the root tile (This is not needed in v2,
+            // since next() is called *after* each tile, not before)
+        if (options_.ordered || options_.sampleFraction < 1 || options_.focus)
+        {
+            collectTiles();
+        }
+    }
+    if (options_.focus) sortTilesByFocus();
+    if (options_.resume) resume(*options_.resume);
+    store->counters().queriesStarted.add();
     requestTiles();
 }
 
+Query::Query(FeatureStore* store, const Box& box, const QueryLayer* layers,
+    uint32_t layerCount, QueryStats* stats, const QueryOptions& options) :
+    Query(store, box, QueryLayer::typesOf(layers, layerCount),
+        QueryLayer::createMatcher(layers, layerCount), nullptr, nullptr, nullptr, 0,
+        stats, options, nullptr, layers, layerCount)
+{
+}
+
+Query::Query(const PreparedQuery& prepared, TileReducer* reducer,
+    QueryStats* stats, const QueryOptions& options) :
+    Query(prepared.store(), prepared.view().bounds(), prepared.view().types(),
+        prepared.view().matcher(), prepared.view().filter(), reducer,
+        nullptr, 0, stats, options, &prepared)
+{
+}
+
+
+
+Box Query::unionOf(const Box* boxes, uint32_t count)
+{
+    assert(count > 0);
+    Box bounds;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bounds.expandToIncludeSimple(boxes[i]);
+    }
+    return bounds;
+}
 
 
-// TODO: use a flag that indicates that query finished, which makes the destructor
-//  more efficient
 Query::~Query()
 {
     // LOG("Destroying Query...");
+    // Any tiles still in flight only need to be accounted for,
+    // not scanned (This makes first() and isEmpty() cheap)
+    cancel();
+    readyArmed_.store(false, std::memory_order_relaxed);
     while(pendingTiles_)
     {
-        deleteResults(take());
+        recycleResults(take());
+    }
+    recycleResults(currentResults_);
+    // A worker may still be about to call the ReadyCallback
+    while (offersInFlight_.load(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+    if (stats_)
+    {
+        consumerStats_.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - startTime_).count();
+        addStats(consumerStats_);
     }
-    deleteResults(currentResults_);
+    store_->queryMemory().fetch_sub(dedupBytes_, std::memory_order_relaxed);
+    store_->counters().queriesFinished.add();
+    if (postedTasks_) postedTasks_->release();
+    if (layerCount_) matcher_->release();
     // LOG("Destroyed Query.");
 }
 
 
-void Query::deleteResults(const QueryResults* res)
+void Query::addStats(const QueryStats& tileStats)
+{
+    std::lock_guard lock(statsMutex_);
+    stats_->add(tileStats);
+}
+
+void Query::retainTile(TileReader::Pin&& pin)
+{
+    std::lock_guard lock(retainedTilesMutex_);
+    retainedTiles_.push_back(std::move(pin));
+}
+
+void Query::recycleResults(const QueryResults* res)
+{
+    resultsPool_.free(res);
+}
+
+/**
+ * Picks the capacity of each tile's first result bucket based on the
+ * average number of results per tile seen so far: selective queries
+ * get small buckets (less memory touched per tile), dense queries go
+ * straight to full-sized buckets (fewer buckets per tile).
+ */
+void Query::adaptBucketSize()
+{
+    uint32_t size = consumedResults_ > consumedTiles_ * QueryResults::SMALL_BUCKET_SIZE ?
+        QueryResults::DEFAULT_BUCKET_SIZE : QueryResults::SMALL_BUCKET_SIZE;
+    firstBucketSize_.store(size, std::memory_order_relaxed);
+}
+
+
+void Query::offer(QueryResults* res, uint32_t sequence)
 {
-    while(res != QueryResults::EMPTY)
+    GEODESK_TRACE_EVENT("tile offered", sequence);
+    // LOG("Putting fresh results into the queue...");
+    offersInFlight_.fetch_add(1, std::memory_order_relaxed);
+    if (reorder_)
+    {
+        // Park the tile's results until the consumer gets to it
+        reorder_->put(sequence, res);
+    }
+    else if (res != QueryResults::EMPTY)
+    {
+        // `res` is the last bucket of a circular list; unlink it
+        // and push the whole chain onto the stack in one step
+        QueryResults* first = res->next;
+        QueryResults* head = queuedResults_.load(std::memory_order_relaxed);
+        do
+        {
+            res->next = head;
+        }
+        while (!queuedResults_.compare_exchange_weak(head, first,
+            std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Results must be visible before the tile counts as completed
+    // (seq_cst, so either we see the consumer's readyArmed_, or it
+    // sees our completion; see onReady())
+    completedTiles_.fetch_add(1, std::memory_order_seq_cst);
+    completedTiles_.notify_one();
+    if (hasDeadline())
     {
-        QueryResults* next = res->next;
-        delete res;
-        res = next;
+        // (Taking the lock ensures the consumer is either waiting
+        // already, or will see the new count before it waits)
+        { std::lock_guard lock(completionMutex_); }
+        tileCompleted_.notify_one();
     }
+    if (readyArmed_.load(std::memory_order_seq_cst) &&
+        readyArmed_.exchange(false, std::memory_order_acquire))
+    {
+        readyCallback_(readyContext_);
+    }
+    offersInFlight_.fetch_sub(1, std::memory_order_release);
 }
 
+bool Query::onReady(ReadyCallback callback, void* context)
+{
+    readyCallback_ = callback;
+    readyContext_ = context;
+    readyArmed_.store(true, std::memory_order_seq_cst);
+    if (pendingTiles_ == 0 || currentPos_ != currentResults_->count ||
+        hasCompletedTile())
+    {
+        // Something is available already (or the query is done); unless
+        // a worker has beaten us to it, withdraw the callback
+        return !readyArmed_.exchange(false, std::memory_order_relaxed);
+    }
+    return true;
+}
 
-void Query::offer(QueryResults* res)
+Query::Status Query::poll(std::vector<FeaturePtr>& batch)
 {
-    // LOG("Putting fresh results into the queue...");
-    std::unique_lock lock(mutex_);
-    if (queuedResults_ == QueryResults::EMPTY)
+    assert(!hasGroupedResults());
+    size_t startSize = batch.size();
+    for (;;)
     {
-        queuedResults_ = res;
+        uint32_t item;
+        if (!nextItem(&item, false))
+        {
+            if (batch.size() > startSize) return Status::READY;
+            return wouldBlock_ ? Status::PENDING : Status::DONE;
+        }
+        DataPtr pTile = currentResults_->pTile;
+        FeaturePtr pFeature(pTile + (item & ~REQUIRES_DEDUP));
+        if ((item & REQUIRES_DEDUP) && isDuplicate(pFeature)) continue;
+        batch.push_back(pFeature);
     }
-    else if(res != QueryResults::EMPTY)
+}
+
+/**
+ * Positions a newly created query at the given checkpoint: its tiles
+ * are requested starting with the checkpoint's tile, the items of that
+ * tile that had been consumed are skipped once it completes, and the
+ * dedup set is restored so features that were returned from earlier
+ * tiles aren't returned again.
+ */
+void Query::resume(const QueryCheckpoint& checkpoint)
+{
+    if (!reorder_ || hasGroupedResults())
     {
-        QueryResults* first = queuedResults_->next;
-        queuedResults_->next = res->next;
-        res->next = first;
-        queuedResults_ = res;
+        throw QueryException("Only ordered single-box queries without layers can be resumed");
     }
+    checkpoint.checkQuery(store_, bounds(), types_,
+        static_cast<uint32_t>(tileList_->size()));
+    nextOrderedTile_ = checkpoint.tile;
+    allTilesRequested_ = checkpoint.tile == checkpoint.tileCount;
+    reorder_->resumeAt(checkpoint.tile, checkpoint.items);
+    potentialDupes_.reserve(checkpoint.dedupKeys.size());
+    for (uint64_t key : checkpoint.dedupKeys) potentialDupes_.insert(key);
+    // The memory limit is enforced once the set grows again
+    size_t bytes = potentialDupes_.capacity() * sizeof(uint64_t);
+    store_->queryMemory().fetch_add(bytes, std::memory_order_relaxed);
+    dedupBytes_ = bytes;
+}
 
-    completedTiles_++;
-    resultsReady_.notify_one();
+QueryCheckpoint Query::checkpoint() const
+{
+    if (!reorder_ || hasGroupedResults())
+    {
+        throw QueryException("Only ordered single-box queries without layers can be checkpointed");
+    }
+    QueryCheckpoint checkpoint = QueryCheckpoint::start(store_, bounds(), types_,
+        static_cast<uint32_t>(tileList_->size()));
+    reorder_->position(currentPos_, currentPos_ == currentResults_->count &&
+        currentResults_->next == QueryResults::EMPTY,
+        &checkpoint.tile, &checkpoint.items);
+    checkpoint.dedupKeys.reserve(potentialDupes_.size());
+    potentialDupes_.forEach([&checkpoint](uint64_t key)
+    {
+        checkpoint.dedupKeys.push_back(key);
+    });
+    std::sort(checkpoint.dedupKeys.begin(), checkpoint.dedupKeys.end());
+    return checkpoint;
 }
 
 void Query::cancel()
 {
-    std::unique_lock lock(mutex_);
-    // TODO
+    cancelled_.store(true, std::memory_order_relaxed);
+}
+
+void Query::fail(std::exception_ptr error)
+{
+    {
+        std::lock_guard lock(errorMutex_);
+        if (!workerError_) workerError_ = error;
+    }
+    // (The failed tile is offered afterwards, so the consumer sees
+    // this once it has taken that tile)
+    failed_.store(true, std::memory_order_release);
+    cancel();
+}
+
+/**
+ * Rethrows the exception of a failed worker (if any) on the
+ * consumer's thread.
+ */
+void Query::checkFailed()
+{
+    if (failed_.load(std::memory_order_acquire)) [[unlikely]]
+    {
+        std::exception_ptr error;
+        {
+            std::lock_guard lock(errorMutex_);
+            error = workerError_;
+        }
+        std::rethrow_exception(error);
+    }
+}
+
+/**
+ * Checks whether take() can return without waiting.
+ */
+bool Query::hasCompletedTile() const
+{
+    if (reorder_) return reorder_->isNextReady();
+    return completedTiles_.load(std::memory_order_seq_cst) > 0;
 }
 
 const QueryResults* Query::take()
 {
+    // The span covers the time the consumer is blocked
+    GEODESK_TRACE_SPAN("take", pendingTiles_);
+    if (reorder_) return takeOrdered();
     // LOG("Taking next batch...");
-    std::unique_lock lock(mutex_);
-    while (completedTiles_ == 0)
+    int32_t completed = completedTiles_.exchange(0, std::memory_order_acquire);
+    if (completed == 0)
     {
-        resultsReady_.wait(lock);
+        bool ready = waitForResults([this, &completed]()
+        {
+            completed = completedTiles_.exchange(0, std::memory_order_acquire);
+            return completed != 0;
+        });
+        // Past the deadline (nextItem() stops the query)
+        if (!ready) return QueryResults::EMPTY;
     }
-    QueryResults* res = queuedResults_;
-    queuedResults_ = QueryResults::EMPTY;
-    pendingTiles_ -= completedTiles_;
-    completedTiles_ = 0;
+    // A split tile is counted before its parts can complete, so
+    // having seen a part's completion, we also see its count
+    pendingTiles_ += tileParts_.exchange(0, std::memory_order_acquire);
+    pendingTiles_ -= completed;
+    consumedTiles_ += completed;
+    adaptBucketSize();
+    GEODESK_TRACE_EVENT("tiles consumed", completed);
+
+    // We may pick up buckets of tiles whose completion we'll only see
+    // on the next call; that's fine, since each tile's results are
+    // pushed before its completion is counted
+    return queuedResults_.exchange(QueryResults::EMPTY, std::memory_order_acquire);
+}
 
-    // Turn the circular list into a simple list ending with EMPTY
-    QueryResults* first = res->next;
-    res->next = QueryResults::EMPTY;
-    return first;
+/**
+ * Waits until `isReady()` returns true, running our queued tiles in
+ * the meantime (see helpWorkers()). Once there are none left to run,
+ * we spin briefly (with many small tiles in flight, another one
+ * usually completes before a futex round-trip would), then block
+ * until a worker completes a tile, or until the deadline has passed.
+ *
+ * @return false if the query's deadline passed before `isReady()`
+ *   returned true
+ */
+template<typename Ready>
+bool Query::waitForResults(Ready isReady)
+{
+    std::chrono::steady_clock::time_point waitStart;
+    if (stats_) waitStart = std::chrono::steady_clock::now();
+    // Let other Python threads run while we wait (or help the workers)
+    clarisma::GilRelease gil;
+    bool ready;
+    for (int spins = 0; ; spins++)
+    {
+        // Workers make their results visible before they count their
+        // tile as completed, so a tile that completes after we have
+        // checked changes the count we wait on
+        int32_t completed = completedTiles_.load(std::memory_order_acquire);
+        ready = isReady();
+        if (ready) break;
+        if (helpWorkers())
+        {
+            spins = 0;
+        }
+        else if (spins < TAKE_SPIN_COUNT)
+        {
+            std::this_thread::yield();
+        }
+        else if (!waitForTile(completed))
+        {
+            break;
+        }
+    }
+    if (stats_)
+    {
+        consumerStats_.consumerWaitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - waitStart).count();
+    }
+    return ready;
+}
+
+/**
+ * Blocks until the count of completed tiles differs from `completed`.
+ * A query with a deadline (that hasn't been cancelled yet, since a
+ * cancelled query must still wait for its tiles in flight) only waits
+ * until the deadline.
+ *
+ * @return false if the deadline has passed
+ */
+bool Query::waitForTile(int32_t completed)
+{
+    if (!hasDeadline() || isCancelled())
+    {
+        completedTiles_.wait(completed, std::memory_order_acquire);
+        return true;
+    }
+    std::unique_lock lock(completionMutex_);
+    return tileCompleted_.wait_until(lock, options_.deadline, [this, completed]()
+    {
+        return completedTiles_.load(std::memory_order_acquire) != completed;
+    });
+}
+
+/**
+ * Runs one of our tiles that is still sitting in the executor's
+ * queues, so the consumer does useful work instead of sleeping
+ * while it waits for results. The task is claimed from the list
+ * of tasks we have posted; the copy in the queue is dropped by
+ * the worker that eventually dequeues it.
+ *
+ * @return false if no such tile was found
+ */
+bool Query::helpWorkers()
+{
+    TileQueryTask task;
+    if (!postedTasks_ || !postedTasks_->claimOldest(task)) return false;
+    task();
+    if (stats_) consumerStats_.tasksHelped++;
+    return true;
+}
+
+/**
+ * Retrieves the results of the next tile of an ordered query, waiting
+ * for it to complete if necessary. Tiles that complete ahead of their
+ * turn stay in their slots (counted by `completedTiles_`, which in
+ * ordered mode is decremented as tiles are taken).
+ */
+const QueryResults* Query::takeOrdered()
+{
+    QueryResults* res = reorder_->takeNext();
+    if (!res)
+    {
+        bool ready = waitForResults([this, &res]()
+        {
+            res = reorder_->takeNext();
+            return res != nullptr;
+        });
+        if (!ready) return QueryResults::EMPTY;
+    }
+    completedTiles_.fetch_sub(1, std::memory_order_relaxed);
+    GEODESK_TRACE_EVENT("tiles consumed", 1);
+    pendingTiles_--;
+    consumedTiles_++;
+    adaptBucketSize();
+    return res;
+}
+
+/**
+ * Checks whether the tile at the walker's current position may
+ * contain any features that match the query.
+ */
+bool Query::mayMatchCurrentTile()
+{
+    if (tagSummary_ && !matcher_->mayMatchTile(*tagSummary_,
+        tileIndexWalker_.currentTip()))
+    {
+        // None of the tile's features has the tags we need
+        if (stats_) consumerStats_.tilesSkipped++;
+        return false;
+    }
+    if (tileStatistics_ && !tileStatistics_->mayMatchTile(
+        tileIndexWalker_.currentTip(), requiredCategories_))
+    {
+        // None of the tile's features has a key the matcher requires
+        if (stats_) consumerStats_.tilesSkipped++;
+        return false;
+    }
+    if (numericKey_ >= 0)
+    {
+        const NumericRange& range = matcher_->requiredRange();
+        if (!numericIndex_->mayMatchTile(numericKey_,
+            tileIndexWalker_.currentTip(), range.min, range.max))
+        {
+            // None of the tile's values lies within the required range
+            if (stats_) consumerStats_.tilesSkipped++;
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks whether the n-th tile belongs to the sample: a tile is sampled
+ * if a stratum boundary falls within it.
+ */
+bool Query::isSampled(uint32_t n) const
+{
+    double fraction = std::clamp(options_.sampleFraction, 0.0, 1.0);
+    if (fraction >= 1) return true;
+    double offset = static_cast<double>(options_.sampleSeed * 0x9E37'79B9u) /
+        4294967296.0;
+    double start = n * fraction + offset;
+    return std::floor(start + fraction) != std::floor(start);
+}
+
+/**
+ * Returns the tile at the walker's current position, keyed by the
+ * Hilbert distance of its center.
+ */
+Query::OrderedTile Query::currentTile(const TileIndexWalker& walker)
+{
+    Tile tile = walker.currentTile();
+    Box bounds = tile.bounds();
+    // Map the center from signed 32-bit to 16-bit unsigned
+    uint32_t x = static_cast<uint32_t>((static_cast<int64_t>(bounds.minX()) +
+        bounds.maxX()) / 2 + (1LL << 31)) >> 16;
+    uint32_t y = static_cast<uint32_t>((static_cast<int64_t>(bounds.minY()) +
+        bounds.maxY()) / 2 + (1LL << 31)) >> 16;
+    return { hilbert::calculateHilbertDistance(x, y),
+        (walker.currentTip() << 8) | walker.northwestFlags(),
+        walker.turboFlags(), tile };
+}
+
+/**
+ * Sorts tiles by the Hilbert distance of their centers (with ties
+ * broken by TIP, so the order is deterministic).
+ */
+void Query::sortTiles(std::vector<OrderedTile>& tiles)
+{
+    std::sort(tiles.begin(), tiles.end(),
+        [](const OrderedTile& a, const OrderedTile& b)
+        {
+            return a.key < b.key || (a.key == b.key && a.tipAndFlags < b.tipAndFlags);
+        });
+}
+
+/**
+ * Orders the tiles by their distance from the focus point (nearest
+ * first; any tiles that contain the point come first of all).
+ */
+void Query::sortTilesByFocus()
+{
+    double x = options_.focus->x;
+    double y = options_.focus->y;
+    for (OrderedTile& t : orderedTiles_)
+    {
+        Box bounds = t.tile.bounds();
+        double dx = std::max({ bounds.minX() - x, 0.0, x - bounds.maxX() });
+        double dy = std::max({ bounds.minY() - y, 0.0, y - bounds.maxY() });
+        // Halved, since the distance may exceed the range of a uint32_t
+        t.key = static_cast<uint32_t>(std::sqrt(dx * dx + dy * dy) / 2);
+    }
+    sortTiles(orderedTiles_);
+}
+
+/**
+ * Walks the entire tile index up front, picking the tiles of a sampled
+ * query, and sorts the tiles of an ordered query along the Hilbert curve.
+ */
+void Query::collectTiles()
+{
+    for (;;)
+    {
+        bool sampled = isSampled(tileCount_);
+        tileCount_++;
+        if (sampled) sampledTileCount_++;
+        if (sampled && mayMatchCurrentTile())
+        {
+            orderedTiles_.push_back(currentTile(tileIndexWalker_));
+        }
+        if (!tileIndexWalker_.next()) break;
+    }
+    if (options_.ordered && !options_.focus) sortTiles(orderedTiles_);
+    tileList_ = &orderedTiles_;
+}
+
+/**
+ * Picks the sample of a sampled query from the tiles of a PreparedQuery
+ * (which are already in Hilbert order).
+ */
+void Query::samplePreparedTiles(const PreparedQuery& prepared)
+{
+    tileCount_ = prepared.tileCount();
+    const std::vector<OrderedTile>& tiles = prepared.tiles();
+    for (uint32_t i = 0; i < tiles.size(); i++)
+    {
+        if (!isSampled(i)) continue;
+        sampledTileCount_++;
+        orderedTiles_.push_back(tiles[i]);
+    }
+    tileList_ = &orderedTiles_;
 }
 
 void Query::requestTiles()
 {
+    GEODESK_TRACE_SPAN("requestTiles", pendingTiles_);
 
     // Fill the queue with requests. If the queue is full, submit 1 request
     // (blocking until a spot frees up).
@@ -142,57 +698,182 @@ void Query::requestTiles()
     }
     */
 
-    bool postedAny = false;
-    for (;;)
-    {
-        TileQueryTask task(this,
-            (tileIndexWalker_.currentTip() << 8) |
-            tileIndexWalker_.northwestFlags(),
-            FastFilterHint(tileIndexWalker_.turboFlags(), tileIndexWalker_.currentTile()));
+    // Gather as many tiles as the executor can currently accept and
+    // submit them as one batch. If the executor is saturated, we still
+    // need at least one tile in flight, so next() will work properly;
+    // any tile that was gathered but not accepted runs on this thread.
+    // A query with a tile limit only tops up to that limit; an ordered
+    // query never has more tiles in flight than its reorder window.
 
-        // LOG("Trying to submit %06X...", tileIndexWalker_.currentTip());
+    // Once tiles turn out to be small, each task scans a run of
+    // tiles (with a tile limit, the limit applies to the tiles)
 
-        if (!store_->executor().tryPost(task))
-        {
-            // If the queue is full and we haven't been able to
-            // post at least one task, we'll run the task on the main
-            // thread; otherwise, we'll end up waiting for a tile
-            // that will never arrive = deadlock
+    int lane = static_cast<int>(options_.priority);
+    int batchSize = store_->executor().minimumRemainingCapacity(lane);
+    int tileLimit = INT32_MAX;
+    uint32_t maxTiles = options_.maxTilesInFlight;
+    if (reorder_ && (maxTiles == 0 || maxTiles > ReorderWindow::SIZE))
+    {
+        maxTiles = ReorderWindow::SIZE;
+    }
+    if (maxTiles)
+    {
+        int allowance = static_cast<int>(maxTiles) - pendingTiles_;
+        if (allowance <= 0 && pendingTiles_ > 0) return;
+        tileLimit = std::max(allowance, 1);
+    }
+    if (isOverMemoryBudget())
+    {
+        // Let the consumer catch up before we scan more tiles
+        if (pendingTiles_ > 0) return;
+        tileLimit = 1;
+    }
+    batchSize = std::clamp(batchSize, 1, MAX_BATCH_SIZE);
+    int groupSize = tilesPerTask();
 
-            if (postedAny)  [[likely]]
+    TileQueryTask tasks[MAX_BATCH_SIZE];
+    int count = 0;
+    int tileCount = 0;
+    while (count < batchSize && tileCount < tileLimit && nextTile(&tasks[count]))
+    {
+        tileCount++;
+        int followerCount = std::min(groupSize - 1, tileLimit - tileCount);
+        if (followerCount > 0)
+        {
+            TileQueryTask* followers = new TileQueryTask[followerCount];
+            int n = 0;
+            while (n < followerCount && nextTile(&followers[n])) n++;
+            if (n)
+            {
+                tasks[count].setFollowers(followers, n);
+            }
+            else
             {
-                break;
+                delete[] followers;
             }
-            pendingTiles_++;
-            // LOG("Running %06X on main thread...", tileIndexWalker_.currentTip());
-            task();
+            tileCount += n;
         }
-        else
+        count++;
+    }
+
+    // Each task prefetches the tile that will be scanned threadCount
+    // tasks after it; the first tasks of a batch also prefetch their
+    // own tile, since no earlier task has done so
+    int distance = store_->executor().threadCount();
+    for (int i = 0; i < count; i++)
+    {
+        tasks[i].setPrefetch(i < distance, i + distance < count ?
+            tasks[i + distance].tip() : TileQueryTask::NO_PREFETCH);
+        tasks[i].setLane(lane);
+        GEODESK_TRACE_EVENT("tile submitted", tasks[i].tip());
+    }
+
+    if (!postedTasks_) postedTasks_ = new PostedTasks();
+    for (int i = 0; i < count; i++) postedTasks_->add(tasks[i]);
+
+    pendingTiles_ += tileCount;
+    int posted = store_->executor().tryPostBatch(tasks, count);
+    for (int i = posted; i < count; i++)
+    {
+        // LOG("Running tile on main thread...");
+        // (This claims the task, so it can't be claimed again)
+        tasks[i]();
+    }
+}
+
+/**
+ * Creates the task for the next tile to be scanned.
+ *
+ * @return false if all tiles have been requested
+ */
+bool Query::nextTile(TileQueryTask* task)
+{
+    if (usesTileList())
+    {
+        if (nextOrderedTile_ == tileList_->size())
+        {
+            allTilesRequested_ = true;
+            return false;
+        }
+        const OrderedTile& tile = (*tileList_)[nextOrderedTile_];
+        *task = TileQueryTask(this, tile.tipAndFlags,
+            FastFilterHint(tile.turboFlags, tile.tile, Tip(tile.tipAndFlags >> 8)));
+        task->setSequence(nextOrderedTile_);
+        nextOrderedTile_++;
+        allTilesRequested_ = nextOrderedTile_ == tileList_->size();
+        return true;
+    }
+    while (!allTilesRequested_)
+    {
+        bool accepted = mayMatchCurrentTile();
+        if (accepted)
         {
-            pendingTiles_++;
-            // LOG("  Submitted %06X", tileIndexWalker_.currentTip());
+            *task = TileQueryTask(this,
+                (tileIndexWalker_.currentTip() << 8) |
+                tileIndexWalker_.northwestFlags(),
+                FastFilterHint(tileIndexWalker_.turboFlags(),
+                    tileIndexWalker_.currentTile(), tileIndexWalker_.currentTip()));
         }
-        postedAny = true;
         if (!tileIndexWalker_.next())
         {
             // LOG("All tiles submitted.");
             allTilesRequested_ = true;
-            break;
         }
+        if (accepted) return true;
     }
-    
+    return false;
 }
 
-FeaturePtr Query::next()
+/**
+ * Picks how many tiles each task should scan, based on the average
+ * size of the tiles scanned so far: a task per tile has an overhead
+ * that matters for tiny tiles, but coalescing large ones would leave
+ * fewer tasks to balance among the workers.
+ */
+int Query::tilesPerTask() const
 {
-    for (;;)
+    uint32_t tiles = scannedTiles_.load(std::memory_order_relaxed);
+    if (tiles < MAX_TILES_PER_TASK) return 1;
+    uint64_t averageSize = scannedBytes_.load(std::memory_order_relaxed) / tiles;
+    if (averageSize >= COALESCE_TILE_SIZE) return 1;
+    return static_cast<int>(std::min<uint64_t>(MAX_TILES_PER_TASK,
+        COALESCE_TILE_SIZE / std::max<uint64_t>(averageSize, 1)));
+}
+
+/**
+ * Retrieves the next item from the result buckets, waiting for more
+ * tiles to complete if necessary (unless `wait` is false, in which
+ * case it sets `wouldBlock_` and returns false instead).
+ *
+ * @return false if there are no more items
+ */
+bool Query::nextItem(uint32_t* pItem, bool wait)
+{
+    wouldBlock_ = false;
+    if (isCancelled()) [[unlikely]]
+    {
+        checkFailed();
+        return false;
+    }
+    if (currentPos_ == currentResults_->count)
     {
-        if (currentPos_ == currentResults_->count)
+        for (;;)
         {
+            if ((pendingTiles_ || currentResults_->next != QueryResults::EMPTY) &&
+                isPastDeadline())
+            {
+                cancel();
+                return false;
+            }
             // We're at the end of the current batch;
             // move on to the next
             QueryResults* next = currentResults_->next;
-            if (currentResults_ != QueryResults::EMPTY) delete currentResults_;
+            if (currentResults_ != QueryResults::EMPTY)
+            {
+                consumedResults_ += currentResults_->count;
+                if (reorder_) reorder_->consumed(currentResults_->count);
+                resultsPool_.free(const_cast<QueryResults*>(currentResults_));
+            }
             currentPos_ = 0;
             currentResults_ = next;
             if (next == QueryResults::EMPTY)
@@ -203,35 +884,173 @@ FeaturePtr Query::next()
                     if (pendingTiles_ == 0)
                     {
                         // There are no more tiles: We're done
-                        return nullptr;
+                        return false;
+                    }
+                    if (isPastDeadline())
+                    {
+                        cancel();
+                        return false;
+                    }
+                    if (!wait && !hasCompletedTile())
+                    {
+                        wouldBlock_ = true;
+                        return false;
                     }
                     const QueryResults* res = take();
-                    if (!allTilesRequested_) requestTiles();
+                    if (failed_.load(std::memory_order_relaxed)) [[unlikely]]
+                    {
+                        recycleResults(res);
+                        checkFailed();
+                    }
+                    if (!allTilesRequested_ && !isCancelled()) requestTiles();
                     if (res != QueryResults::EMPTY)
                     {
                         currentResults_ = res;
+                        if (reorder_ && reorder_->hasItemsToSkip()) [[unlikely]]
+                        {
+                            skipResumedItems();
+                        }
                         break;
                     }
                 }
             }
-            else
-            {
-                // LOG("Next batch of current results...");
-            }
+            if (currentPos_ < currentResults_->count) break;
         }
-        uint32_t item = currentResults_->items[currentPos_++];
+    }
+    *pItem = currentResults_->items[currentPos_++];
+    return true;
+}
+
+/**
+ * Skips the items of the first tile of a resumed query that had been
+ * consumed before its checkpoint was taken (the tile yields the same
+ * items in the same order, since the GOL is the same).
+ */
+void Query::skipResumedItems()
+{
+    uint32_t skip = reorder_->takeItemsToSkip();
+    while (skip >= currentResults_->count &&
+        currentResults_->next != QueryResults::EMPTY)
+    {
+        const QueryResults* next = currentResults_->next;
+        skip -= currentResults_->count;
+        consumedResults_ += currentResults_->count;
+        reorder_->consumed(currentResults_->count);
+        resultsPool_.free(const_cast<QueryResults*>(currentResults_));
+        currentResults_ = next;
+    }
+    currentPos_ = std::min(skip, currentResults_->count);
+}
+
+/**
+ * Checks whether a feature that lives in multiple tiles has already
+ * been returned.
+ */
+bool Query::isDuplicate(FeaturePtr pFeature)
+{
+    uint64_t idBits = pFeature.idBits();  // getUnsignedLong() & 0xffff'ffff'ffff'ff18LL;
+    size_t capacity = potentialDupes_.capacity();
+    bool isDupe = !potentialDupes_.insert(idBits);
+    if (potentialDupes_.capacity() != capacity) [[unlikely]] dedupSetGrown();
+    if (stats_)
+    {
+        consumerStats_.dedupLookups++;
+        consumerStats_.duplicates += isDupe;
+    }
+    return isDupe;
+}
+
+/**
+ * Checks whether the results that have not been consumed yet (plus the
+ * dedup set) exceed the memory limit of the query, or whether the
+ * queries of the store as a whole exceed the store's limit.
+ */
+bool Query::isOverMemoryBudget() const
+{
+    size_t storeLimit = store_->queryMemoryLimit();
+    if (storeLimit && store_->queryMemory().load(std::memory_order_relaxed) > storeLimit)
+    {
+        return true;
+    }
+    return options_.memoryLimit &&
+        resultsPool_.bytesInUse() + dedupBytes_ > options_.memoryLimit;
+}
+
+/**
+ * Accounts for the memory of the dedup set after it has grown, and
+ * fails the query if this exceeds its memory limit (or that of the
+ * store).
+ */
+void Query::dedupSetGrown()
+{
+    size_t bytes = potentialDupes_.capacity() * sizeof(uint64_t);
+    size_t storeMemory = store_->queryMemory().fetch_add(
+        bytes - dedupBytes_, std::memory_order_relaxed) + bytes - dedupBytes_;
+    dedupBytes_ = bytes;
+    size_t storeLimit = store_->queryMemoryLimit();
+    if ((options_.memoryLimit && memoryUsed() > options_.memoryLimit) ||
+        (storeLimit && storeMemory > storeLimit))
+    {
+        cancel();
+        throw QueryException("Query exceeded its memory limit (%zu bytes in use)",
+            memoryUsed());
+    }
+}
+
+FeaturePtr Query::next()
+{
+    assert(!hasGroupedResults());
+    for (;;)
+    {
+        uint32_t item;
+        if (!nextItem(&item)) return nullptr;
         DataPtr pTile = currentResults_->pTile;
         if (item & REQUIRES_DEDUP)
         {
             FeaturePtr pFeature (pTile + (item & ~REQUIRES_DEDUP));
-            uint64_t idBits = pFeature.idBits();  // getUnsignedLong() & 0xffff'ffff'ffff'ff18LL;
-            if (potentialDupes_.count(idBits)) continue;
-            potentialDupes_.insert(idBits);
+            if (isDuplicate(pFeature)) continue;
             return pFeature;
         }
         return FeaturePtr(pTile + item);
     }
 }
 
+// The results of a multi-box query consist of a group of items for each
+// feature: its offset (with the optional REQUIRES_DEDUP flag), the number
+// of boxes it intersects, and their indexes (for a layered query, the
+// layers that accept it)
+// (Groups can straddle buckets, but never tiles)
+
+FeaturePtr Query::next(uint32_t* pBoxIndex)
+{
+    assert(hasGroupedResults());
+    for (;;)
+    {
+        if (multiBoxRemaining_)
+        {
+            if (!nextItem(pBoxIndex)) return nullptr;
+            multiBoxRemaining_--;
+            return multiBoxFeature_;
+        }
+        uint32_t item;
+        uint32_t count;
+        if (!nextItem(&item)) return nullptr;
+        DataPtr pTile = currentResults_->pTile;
+        if (!nextItem(&count)) return nullptr;
+        FeaturePtr pFeature (pTile + (item & ~REQUIRES_DEDUP));
+        if ((item & REQUIRES_DEDUP) && isDuplicate(pFeature))
+        {
+            uint32_t boxIndex;
+            while (count--)
+            {
+                if (!nextItem(&boxIndex)) return nullptr;
+            }
+            continue;
+        }
+        multiBoxFeature_ = pFeature;
+        multiBoxRemaining_ = count;
+    }
+}
+
 
 } // namespace geodesk
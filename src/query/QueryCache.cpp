@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryCache.h>
+#include <geodesk/filter/Filter.h>
+#include <geodesk/match/Matcher.h>
+
+namespace geodesk {
+
+QueryCache::QueryCache(size_t maxBytes) :
+    maxBytes_(maxBytes),
+    shards_(new Shard[SHARD_COUNT]),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+QueryCache::~QueryCache()
+{
+    clear();
+}
+
+
+size_t QueryCache::KeyHash::operator()(const Key& key) const
+{
+    uint64_t h = key.tipAndFlags;
+    h = h * 0x9E37'79B9'7F4A'7C15ULL + key.types;
+    h = h * 0x9E37'79B9'7F4A'7C15ULL + reinterpret_cast<uintptr_t>(key.matcher);
+    h = h * 0x9E37'79B9'7F4A'7C15ULL + reinterpret_cast<uintptr_t>(key.filter);
+    h = h * 0x9E37'79B9'7F4A'7C15ULL +
+        ((static_cast<uint64_t>(static_cast<uint32_t>(key.bounds.minX())) << 32) |
+            static_cast<uint32_t>(key.bounds.minY()));
+    h = h * 0x9E37'79B9'7F4A'7C15ULL +
+        ((static_cast<uint64_t>(static_cast<uint32_t>(key.bounds.maxX())) << 32) |
+            static_cast<uint32_t>(key.bounds.maxY()));
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+
+QueryCache::Shard& QueryCache::shard(const Key& key)
+{
+    // Neighboring tiles of the same query spread across shards
+    return shards_[(key.tipAndFlags >> 8) % SHARD_COUNT];
+}
+
+
+QueryCache::Items QueryCache::lookup(const Key& key)
+{
+    Shard& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(key);
+    if (it == s.index.end()) return nullptr;
+    s.entries.splice(s.entries.begin(), s.entries, it->second);
+    return it->second->items;
+}
+
+
+void QueryCache::insert(const Key& key, std::vector<uint32_t>&& items)
+{
+    size_t bytes = items.size() * sizeof(uint32_t) + sizeof(Entry) + 64;
+        // (approximate overhead of the list node and index entry)
+    size_t maxShardBytes = maxBytes_ / SHARD_COUNT;
+    if (bytes > maxShardBytes) return;
+    Items shared = std::make_shared<const std::vector<uint32_t>>(std::move(items));
+
+    Shard& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.index.find(key) != s.index.end()) return;     // another worker was faster
+    while (s.bytes + bytes > maxShardBytes)
+    {
+        const Entry& oldest = s.entries.back();
+        s.bytes -= oldest.bytes;
+        s.index.erase(oldest.key);
+        releaseEntry(oldest);
+        s.entries.pop_back();
+    }
+    key.matcher->addref();
+    if (key.filter) key.filter->addref();
+    s.entries.push_front({ key, std::move(shared), bytes });
+    s.index.emplace(key, s.entries.begin());
+    s.bytes += bytes;
+}
+
+
+void QueryCache::releaseEntry(const Entry& entry)
+{
+    entry.key.matcher->release();
+    if (entry.key.filter) entry.key.filter->release();
+}
+
+
+void QueryCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard<std::mutex> lock(versionMutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    clear();
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+
+size_t QueryCache::bytes()
+{
+    size_t total = 0;
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& s = shards_[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.bytes;
+    }
+    return total;
+}
+
+void QueryCache::clear()
+{
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& s = shards_[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (const Entry& entry : s.entries) releaseEntry(entry);
+        s.entries.clear();
+        s.index.clear();
+        s.bytes = 0;
+    }
+}
+
+} // namespace geodesk
@@ -0,0 +1,142 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryCheckpoint.h>
+#include <algorithm>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/QueryException.h>
+
+namespace geodesk {
+
+namespace {
+
+constexpr uint8_t MAGIC[4] = { 'G', 'Q', 'C', 1 };
+
+// Unlike clarisma::readVarint64(), checks for the end of the data
+// (the bytes of a checkpoint come from outside)
+uint64_t readVarint(const uint8_t*& p, const uint8_t* end)
+{
+    uint64_t val = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p == end) throw QueryException("Truncated query checkpoint");
+        uint8_t b = *p++;
+        val |= static_cast<uint64_t>(b & 0x7f) << shift;
+        if ((b & 0x80) == 0) return val;
+    }
+    throw QueryException("Invalid query checkpoint");
+}
+
+int32_t readSignedVarint(const uint8_t*& p, const uint8_t* end)
+{
+    uint64_t v = readVarint(p, end);
+    return static_cast<int32_t>((v >> 1) ^ (0 - (v & 1)));
+}
+
+uint32_t readVarint32(const uint8_t*& p, const uint8_t* end)
+{
+    uint64_t v = readVarint(p, end);
+    if (v > UINT32_MAX) throw QueryException("Invalid query checkpoint");
+    return static_cast<uint32_t>(v);
+}
+
+} // namespace
+
+// Layout: magic, then varints for the store identity, the bounds
+// (signed), types, tile count, tile and items, followed by the number
+// of dedup keys and the keys themselves (delta-encoded)
+
+QueryCheckpoint QueryCheckpoint::start(const FeatureStore* store, const Box& bounds,
+    FeatureTypes types, uint32_t tileCount)
+{
+    QueryCheckpoint checkpoint;
+    checkpoint.storeTimestamp = store->creationTimestamp();
+    checkpoint.storeSize = store->trueSize();
+    checkpoint.bounds = bounds;
+    checkpoint.types = types;
+    checkpoint.tileCount = tileCount;
+    return checkpoint;
+}
+
+void QueryCheckpoint::checkQuery(const FeatureStore* store, const Box& queryBounds,
+    FeatureTypes queryTypes, uint32_t queryTileCount) const
+{
+    if (storeTimestamp != store->creationTimestamp() ||
+        storeSize != store->trueSize())
+    {
+        throw QueryException("Checkpoint was taken on a different GOL");
+    }
+    if (bounds != queryBounds || types != queryTypes ||
+        tileCount != queryTileCount || tile > tileCount)
+    {
+        throw QueryException("Checkpoint was taken by a different query");
+    }
+}
+
+std::vector<uint8_t> QueryCheckpoint::serialize() const
+{
+    std::vector<uint8_t> data(sizeof(MAGIC) + 12 * 10 + dedupKeys.size() * 10);
+    uint8_t* p = data.data();
+    std::copy(std::begin(MAGIC), std::end(MAGIC), p);
+    p += sizeof(MAGIC);
+    clarisma::writeVarint(p, storeTimestamp);
+    clarisma::writeVarint(p, storeSize);
+    clarisma::writeSignedVarint(p, bounds.minX());
+    clarisma::writeSignedVarint(p, bounds.minY());
+    clarisma::writeSignedVarint(p, bounds.maxX());
+    clarisma::writeSignedVarint(p, bounds.maxY());
+    clarisma::writeVarint(p, static_cast<uint32_t>(types));
+    clarisma::writeVarint(p, tileCount);
+    clarisma::writeVarint(p, tile);
+    clarisma::writeVarint(p, items);
+    clarisma::writeVarint(p, dedupKeys.size());
+    uint64_t prev = 0;
+    for (uint64_t key : dedupKeys)
+    {
+        clarisma::writeVarint(p, key - prev);
+        prev = key;
+    }
+    data.resize(p - data.data());
+    return data;
+}
+
+QueryCheckpoint QueryCheckpoint::deserialize(std::span<const uint8_t> data)
+{
+    if (data.size() < sizeof(MAGIC) ||
+        !std::equal(std::begin(MAGIC), std::end(MAGIC), data.begin()))
+    {
+        throw QueryException("Not a query checkpoint");
+    }
+    const uint8_t* p = data.data() + sizeof(MAGIC);
+    const uint8_t* end = data.data() + data.size();
+    QueryCheckpoint cp;
+    cp.storeTimestamp = readVarint(p, end);
+    cp.storeSize = readVarint(p, end);
+    int32_t minX = readSignedVarint(p, end);
+    int32_t minY = readSignedVarint(p, end);
+    int32_t maxX = readSignedVarint(p, end);
+    int32_t maxY = readSignedVarint(p, end);
+    cp.bounds = Box(minX, minY, maxX, maxY);
+    cp.types = readVarint32(p, end);
+    cp.tileCount = readVarint32(p, end);
+    cp.tile = readVarint32(p, end);
+    cp.items = readVarint32(p, end);
+    uint64_t keyCount = readVarint(p, end);
+    // Each key takes at least one byte
+    if (keyCount > static_cast<uint64_t>(end - p) || cp.tile > cp.tileCount)
+    {
+        throw QueryException("Invalid query checkpoint");
+    }
+    cp.dedupKeys.reserve(keyCount);
+    uint64_t key = 0;
+    for (uint64_t i = 0; i < keyCount; i++)
+    {
+        key += readVarint(p, end);
+        cp.dedupKeys.push_back(key);
+    }
+    if (p != end) throw QueryException("Invalid query checkpoint");
+    return cp;
+}
+
+} // namespace geodesk
@@ -0,0 +1,63 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryLayer.h>
+#include <algorithm>
+#include <geodesk/filter/Filter.h>
+#include <geodesk/match/Matcher.h>
+#include <geodesk/query/TileQueryTask.h>
+
+namespace geodesk {
+
+bool QueryLayer::accept(FeatureStore* store, FeaturePtr pFeature,
+    const FastFilterHint& fastFilterHint) const
+{
+    int flags = pFeature.flags();
+    if (!types.acceptFlags(flags)) return false;
+    if (matcher && !(matcher->acceptedTypes().acceptFlags(flags) &&
+        matcher->mainMatcher().accept(pFeature)))
+    {
+        return false;
+    }
+    return !filter || filter->accept(store, pFeature, fastFilterHint);
+}
+
+FeatureTypes QueryLayer::typesOf(const QueryLayer* layers, uint32_t count)
+{
+    FeatureTypes types = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const QueryLayer& layer = layers[i];
+        types |= layer.matcher ? (layer.types & layer.matcher->acceptedTypes()) :
+            layer.types;
+    }
+    return types;
+}
+
+/**
+ * Creates the matcher of a layered query: it accepts all features (the
+ * layers' matchers are applied by the TileQueryTask), but its index
+ * masks are the union of those of the layers, so an index root is only
+ * skipped if no layer can match any of its features.
+ */
+const MatcherHolder* QueryLayer::createMatcher(const QueryLayer* layers, uint32_t count)
+{
+    IndexMask masks[4];
+    for (int i = 0; i < 4; i++)
+    {
+        masks[i] = { 0, 0xffff'ffff };
+        for (uint32_t n = 0; n < count; n++)
+        {
+            const QueryLayer& layer = layers[n];
+            if ((layer.types & TileQueryTask::INDEX_TYPES[i]) == 0) continue;
+            IndexMask mask = layer.matcher ?
+                layer.matcher->indexMask(static_cast<FeatureIndexType>(i)) :
+                IndexMask{ 0xffff'ffff, 0 };
+            masks[i].keyMask |= mask.keyMask;
+            masks[i].keyMin = std::min(masks[i].keyMin, mask.keyMin);
+        }
+    }
+    return MatcherHolder::createMatchAll(typesOf(layers, count), masks);
+}
+
+} // namespace geodesk
@@ -0,0 +1,41 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryPlanner.h>
+
+namespace geodesk {
+
+void QueryPlanner::addSample(const Sample& sample)
+{
+    uint64_t matcherCalls = matcherCalls_.fetch_add(
+        sample.matcherCalls, std::memory_order_relaxed) + sample.matcherCalls;
+    uint64_t matcherAccepts = matcherAccepts_.fetch_add(
+        sample.matcherAccepts, std::memory_order_relaxed) + sample.matcherAccepts;
+    uint64_t filterCalls = filterCalls_.fetch_add(
+        sample.filterCalls, std::memory_order_relaxed) + sample.filterCalls;
+    uint64_t filterAccepts = filterAccepts_.fetch_add(
+        sample.filterAccepts, std::memory_order_relaxed) + sample.filterAccepts;
+
+    // Whichever predicate runs second only sees the candidates accepted
+    // by the first, so we need enough samples of both
+    if (matcherCalls < MIN_SAMPLE_SIZE || filterCalls < MIN_SAMPLE_SIZE) return;
+    // Concurrent samples may interleave here; the plan is merely
+    // a hint, so the last writer wins
+    filterFirst_.store(rank(filterCost_, filterCalls, filterAccepts) <
+        rank(1, matcherCalls, matcherAccepts), std::memory_order_relaxed);
+}
+
+/**
+ * The expected cost of evaluating a predicate for each candidate
+ * it rejects (lower is better).
+ */
+double QueryPlanner::rank(double cost, uint64_t calls, uint64_t accepts)
+{
+    double rejectRate = static_cast<double>(calls - accepts) /
+        static_cast<double>(calls);
+    // A predicate that never rejects goes last
+    if (rejectRate <= 0) return cost * static_cast<double>(calls + 1);
+    return cost / rejectRate;
+}
+
+} // namespace geodesk
@@ -0,0 +1,544 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryRecorder.h>
+#include <charconv>
+#include <cstring>
+#include <clarisma/util/Parser.h>
+#include <geodesk/feature/FeatureBase.h>
+#include <geodesk/feature/FeatureIterator.h>
+#include <geodesk/feature/FeatureUtils.h>
+#include <geodesk/feature/IdIndex.h>
+#include <geodesk/feature/TypedFeatureId.h>
+#include <geodesk/filter/Filters.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+void addFilters(RecordedQuery& query, const Filter* filter)
+{
+    if (filter->isCombo())
+    {
+        for (const Filter* child : static_cast<const ComboFilter*>(filter)->filters())
+        {
+            addFilters(query, child);
+        }
+        return;
+    }
+    query.filters.push_back({ filter->name(), filter->source() });
+}
+
+bool isRecreatable(const RecordedQuery::FilterArgs& filter)
+{
+    std::string_view name = filter.name;
+    if (filter.source.typedId)
+    {
+        return name == "intersecting" || name == "containing" ||
+            name == "within" || name == "crossing" || name == "max_meters_from";
+    }
+    return name == "containing" || name == "max_meters_from";
+}
+
+FeaturePtr lookup(FeatureStore* store, uint64_t typedId)
+{
+    FeaturePtr feature = store->idIndex().get(TypedFeatureId(typedId));
+    if (feature.isNull())
+    {
+        throw QueryException("%s not found",
+            TypedFeatureId(typedId).toString().c_str());
+    }
+    return feature;
+}
+
+const Filter* createFilter(FeatureStore* store, const RecordedQuery::FilterArgs& filter)
+{
+    std::string_view name = filter.name;
+    const Filter::Source& source = filter.source;
+    if (source.typedId)
+    {
+        Feature feature(store, lookup(store, source.typedId));
+        // Intersecting a node yields a "containing" filter
+        if (name == "intersecting" || name == "containing") return Filters::intersects(feature);
+        if (name == "within") return Filters::within(feature);
+        if (name == "crossing") return Filters::crossing(feature);
+        return Filters::maxMetersFrom(source.meters, feature);
+    }
+    if (name == "containing") return Filters::containsPoint(source.xy);
+    return Filters::maxMetersFrom(source.meters, source.xy);
+}
+
+// -- Log format --------------------------------------------------------
+
+const char* const VIEW_NAMES[] = { "empty", "world", "nodes", "members", "parents" };
+
+void appendNumber(std::string& out, uint64_t n)
+{
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), n).ptr;
+    out.append(buf, end);
+}
+
+void appendSigned(std::string& out, int64_t n)
+{
+    char buf[24];
+    char* end = std::to_chars(buf, buf + sizeof(buf), n).ptr;
+    out.append(buf, end);
+}
+
+void appendCoordinate(std::string& out, Coordinate xy)
+{
+    out += '@';
+    appendSigned(out, xy.x);
+    out += ',';
+    appendSigned(out, xy.y);
+}
+
+void appendRef(std::string& out, uint64_t typedId, Coordinate xy)
+{
+    if (typedId)
+    {
+        out += TypedFeatureId(typedId).toString();
+    }
+    else
+    {
+        appendCoordinate(out, xy);
+    }
+}
+
+void appendEscaped(std::string& out, std::string_view s)
+{
+    for (char ch : s)
+    {
+        switch (ch)
+        {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\0': out += "\\0"; break;
+        default: out += ch; break;
+        }
+    }
+}
+
+class LineReader
+{
+public:
+    explicit LineReader(std::string_view line) : rest_(line) {}
+
+    std::string_view field()
+    {
+        size_t n = rest_.find('\t');
+        std::string_view f = rest_.substr(0, n);
+        rest_ = n == std::string_view::npos ? std::string_view() : rest_.substr(n + 1);
+        return f;
+    }
+
+    bool atEnd() const { return rest_.empty(); }
+
+    template <typename T>
+    static T number(std::string_view s, int base = 10)
+    {
+        T value;
+        auto [end, err] = std::from_chars(s.data(), s.data() + s.size(), value, base);
+        if (err != std::errc() || end != s.data() + s.size() || s.empty())
+        {
+            throw ParseException("Bad number: " + std::string(s));
+        }
+        return value;
+    }
+
+    static Coordinate coordinate(std::string_view s)
+    {
+        size_t comma = s.find(',');
+        if (s.empty() || s[0] != '@' || comma == std::string_view::npos)
+        {
+            throw ParseException("Bad coordinate: " + std::string(s));
+        }
+        return Coordinate(number<int32_t>(s.substr(1, comma - 1)),
+            number<int32_t>(s.substr(comma + 1)));
+    }
+
+    static uint64_t typedId(std::string_view s)
+    {
+        size_t slash = s.find('/');
+        std::string_view type = s.substr(0, slash);
+        if (slash == std::string_view::npos) throw ParseException("Bad feature: " + std::string(s));
+        uint64_t id = number<uint64_t>(s.substr(slash + 1));
+        if (type == "node") return static_cast<uint64_t>(TypedFeatureId::ofTypeAndId(FeatureType::NODE, id));
+        if (type == "way") return static_cast<uint64_t>(TypedFeatureId::ofTypeAndId(FeatureType::WAY, id));
+        if (type == "relation") return static_cast<uint64_t>(TypedFeatureId::ofTypeAndId(FeatureType::RELATION, id));
+        throw ParseException("Bad feature type: " + std::string(type));
+    }
+
+    /// Parses a typed ID or a coordinate
+    static void ref(std::string_view s, uint64_t& typedId, Coordinate& xy)
+    {
+        if (!s.empty() && s[0] == '@')
+        {
+            typedId = 0;
+            xy = coordinate(s);
+        }
+        else
+        {
+            typedId = LineReader::typedId(s);
+        }
+    }
+
+    static std::string unescape(std::string_view s)
+    {
+        std::string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            char ch = s[i];
+            if (ch != '\\' || i + 1 == s.size())
+            {
+                out += ch;
+                continue;
+            }
+            switch (s[++i])
+            {
+            case 't': out += '\t'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case '0': out += '\0'; break;
+            default: out += s[i]; break;
+            }
+        }
+        return out;
+    }
+
+private:
+    std::string_view rest_;
+};
+
+uint32_t currentThreadNumber()
+{
+    static std::atomic<uint32_t> nextThread = 0;
+    static thread_local uint32_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+} // namespace
+
+RecordedQuery RecordedQuery::of(const View& view)
+{
+    RecordedQuery query;
+    query.view = static_cast<int>(view.view());
+    query.types = view.types();
+    switch (view.view())
+    {
+    case View::WORLD:
+        query.bounds = view.bounds();
+        break;
+    case View::WAY_NODES:
+    case View::MEMBERS:
+    case View::PARENTS:
+    {
+        FeaturePtr related = view.relatedFeature();
+        if (related.isNull())
+        {
+            query.relatedXY = view.relatedAnonymousNode();
+        }
+        else
+        {
+            query.relatedId = related.typedId();
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    if (view.usesMatcher())
+    {
+        query.usesMatcher = true;
+        query.query = view.store()->matcherQuery(view.matcher());
+        query.queryKnown = !query.query.empty();
+    }
+    if (view.filter()) addFilters(query, view.filter());
+    return query;
+}
+
+bool RecordedQuery::isReplayable() const
+{
+    if (!queryKnown) return false;
+    for (const FilterArgs& filter : filters)
+    {
+        if (!isRecreatable(filter)) return false;
+    }
+    return true;
+}
+
+View RecordedQuery::toView(FeatureStore* store) const
+{
+    if (!isReplayable()) throw QueryException("Query cannot be replayed");
+    store->addref();
+    View world(View::WORLD, 0, FeatureTypes::ALL, store,
+        Box::ofWorld(), store->getAllMatcher(), nullptr);
+    if (view == View::EMPTY) return world.empty();
+
+    View v = world;
+    if (usesMatcher)
+    {
+        // The queries of a fused intersection are separated by nulls
+        std::string_view rest = query;
+        for (;;)
+        {
+            size_t n = rest.find('\0');
+            std::string single(rest.substr(0, n));
+            v = v.withQuery(single.c_str());
+            if (n == std::string_view::npos) break;
+            rest = rest.substr(n + 1);
+        }
+    }
+    switch (view)
+    {
+    case View::WAY_NODES:
+        v = v.nodesOf(WayPtr(lookup(store, relatedId)));
+        break;
+    case View::MEMBERS:
+        v = v.membersOf(RelationPtr(lookup(store, relatedId)));
+        break;
+    case View::PARENTS:
+        v = relatedId ? v.parentsOf(lookup(store, relatedId)) :
+            v.parentWaysOf(relatedXY);
+        break;
+    default:
+        break;
+    }
+    for (const FilterArgs& filter : filters)
+    {
+        v = v.withFilter(createFilter(store, filter));
+    }
+    // Apply the bounds last, since a filter replaces the bounds
+    // of the view with its own
+    if (view == View::WORLD && !(bounds == Box::ofWorld()))
+    {
+        v = v.withBounds(bounds);
+    }
+    return v & types;
+}
+
+uint64_t RecordedQuery::replay(const View& view) const
+{
+    if (consumption == Consumption::COUNT) return FeatureUtils::count(view);
+    uint64_t n = 0;
+    for (FeatureIterator<Feature> iter(view); iter != nullptr; ++iter)
+    {
+        n++;
+        if (!complete && n == results) break;
+    }
+    return n;
+}
+
+void RecordedQuery::format(std::string& out) const
+{
+    appendNumber(out, start);
+    out += '\t';
+    appendNumber(out, thread);
+    out += consumption == Consumption::COUNT ? "\tcount\t" : "\titerate\t";
+    appendNumber(out, results);
+    out += complete ? "\t1\t" : "\t0\t";
+    appendNumber(out, nanos);
+    out += '\t';
+    out += VIEW_NAMES[view];
+    out += '\t';
+    char buf[32];       // fits ":%.9g" of any double
+    snprintf(buf, sizeof(buf), "%x", static_cast<uint32_t>(types));
+    out += buf;
+    out += '\t';
+    if (view == View::WORLD)
+    {
+        if (bounds == Box::ofWorld())
+        {
+            out += '-';
+        }
+        else
+        {
+            appendSigned(out, bounds.minX());
+            out += ',';
+            appendSigned(out, bounds.minY());
+            out += ',';
+            appendSigned(out, bounds.maxX());
+            out += ',';
+            appendSigned(out, bounds.maxY());
+        }
+    }
+    else if (view == View::EMPTY)
+    {
+        out += '-';
+    }
+    else
+    {
+        appendRef(out, relatedId, relatedXY);
+    }
+    out += '\t';
+    if (filters.empty()) out += '-';
+    for (size_t i = 0; i < filters.size(); i++)
+    {
+        const FilterArgs& filter = filters[i];
+        if (i > 0) out += ';';
+        out += filter.name;
+        out += ':';
+        appendRef(out, filter.source.typedId, filter.source.xy);
+        if (filter.source.meters != 0)
+        {
+            snprintf(buf, sizeof(buf), ":%.9g", filter.source.meters);
+            out += buf;
+        }
+    }
+    out += '\t';
+    if (!queryKnown)
+    {
+        out += '?';
+    }
+    else if (usesMatcher)
+    {
+        appendEscaped(out, query);
+    }
+    out += '\n';
+}
+
+RecordedQuery RecordedQuery::parse(std::string_view line)
+{
+    LineReader reader(line);
+    RecordedQuery q;
+    q.start = LineReader::number<uint64_t>(reader.field());
+    q.thread = LineReader::number<uint32_t>(reader.field());
+    std::string_view consumption = reader.field();
+    if (consumption == "count")
+    {
+        q.consumption = Consumption::COUNT;
+    }
+    else if (consumption != "iterate")
+    {
+        throw ParseException("Bad consumption: " + std::string(consumption));
+    }
+    q.results = LineReader::number<uint64_t>(reader.field());
+    q.complete = reader.field() != "0";
+    q.nanos = LineReader::number<uint64_t>(reader.field());
+    std::string_view viewName = reader.field();
+    q.view = -1;
+    for (int i = 0; i < static_cast<int>(std::size(VIEW_NAMES)); i++)
+    {
+        if (viewName == VIEW_NAMES[i]) q.view = i;
+    }
+    if (q.view < 0) throw ParseException("Bad view: " + std::string(viewName));
+    q.types = LineReader::number<uint32_t>(reader.field(), 16);
+
+    std::string_view context = reader.field();
+    if (q.view == View::WORLD && context != "-")
+    {
+        int32_t v[4];
+        for (int i = 0; i < 4; i++)
+        {
+            size_t n = context.find(',');
+            v[i] = LineReader::number<int32_t>(context.substr(0, n));
+            context = n == std::string_view::npos ? std::string_view() : context.substr(n + 1);
+        }
+        q.bounds = Box(v[0], v[1], v[2], v[3]);
+    }
+    else if (q.view != View::WORLD && q.view != View::EMPTY)
+    {
+        LineReader::ref(context, q.relatedId, q.relatedXY);
+    }
+
+    std::string_view filters = reader.field();
+    while (!filters.empty() && filters != "-")
+    {
+        size_t n = filters.find(';');
+        std::string_view f = filters.substr(0, n);
+        filters = n == std::string_view::npos ? std::string_view() : filters.substr(n + 1);
+        size_t colon = f.find(':');
+        if (colon == std::string_view::npos) throw ParseException("Bad filter: " + std::string(f));
+        FilterArgs filter;
+        filter.name = f.substr(0, colon);
+        f = f.substr(colon + 1);
+        colon = f.find(':');
+        LineReader::ref(f.substr(0, colon), filter.source.typedId, filter.source.xy);
+        if (colon != std::string_view::npos)
+        {
+            filter.source.meters = std::strtod(std::string(f.substr(colon + 1)).c_str(), nullptr);
+        }
+        q.filters.push_back(std::move(filter));
+    }
+
+    std::string_view query = reader.field();
+    if (query == "?")
+    {
+        q.usesMatcher = true;
+        q.queryKnown = false;
+    }
+    else if (!query.empty())
+    {
+        q.usesMatcher = true;
+        q.query = LineReader::unescape(query);
+    }
+    return q;
+}
+
+QueryRecorder::QueryRecorder(const char* fileName) :
+    started_(std::chrono::steady_clock::now())
+{
+    file_.open(fileName, File::OpenMode::WRITE | File::OpenMode::CREATE |
+        File::OpenMode::REPLACE_EXISTING);
+    buffer_ = "# geodesk query log 1\n";
+}
+
+QueryRecorder::~QueryRecorder()
+{
+    try
+    {
+        flush();
+    }
+    catch (...)
+    {
+        // Nothing we can do about a failed write at this point
+    }
+}
+
+void QueryRecorder::record(RecordedQuery& query)
+{
+    query.thread = currentThreadNumber();
+    std::string line;
+    query.format(line);
+    queryCount_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard lock(mutex_);
+    buffer_ += line;
+    if (buffer_.size() >= FLUSH_THRESHOLD) writeBuffer();
+}
+
+void QueryRecorder::flush()
+{
+    std::lock_guard lock(mutex_);
+    writeBuffer();
+}
+
+void QueryRecorder::writeBuffer()
+{
+    file_.write(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+std::vector<RecordedQuery> QueryRecorder::load(const char* fileName)
+{
+    ByteBlock data = File::readAll(fileName);
+    std::string_view text(reinterpret_cast<const char*>(data.data()), data.size());
+    std::vector<RecordedQuery> queries;
+    while (!text.empty())
+    {
+        size_t n = text.find('\n');
+        std::string_view line = text.substr(0, n);
+        text = n == std::string_view::npos ? std::string_view() : text.substr(n + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line.empty() || line[0] == '#') continue;
+        queries.push_back(RecordedQuery::parse(line));
+    }
+    return queries;
+}
+
+} // namespace geodesk
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/QueryStats.h>
+#include <clarisma/text/Format.h>
+#include <clarisma/util/StringBuilder.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+void QueryStats::add(const QueryStats& other)
+{
+    tilesVisited += other.tilesVisited;
+    for (int i = 0; i < MAX_LEVELS; i++) tilesRejected[i] += other.tilesRejected[i];
+    tilesSkipped += other.tilesSkipped;
+    tilesScanned += other.tilesScanned;
+    tilesCancelled += other.tilesCancelled;
+    tilesFromCache += other.tilesFromCache;
+    tilesTranscoded += other.tilesTranscoded;
+    tilesCounted += other.tilesCounted;
+    tilesSplit += other.tilesSplit;
+    tilesCoalesced += other.tilesCoalesced;
+    tasksHelped += other.tasksHelped;
+    indexRootsSearched += other.indexRootsSearched;
+    indexRootsPruned += other.indexRootsPruned;
+    branchesScanned += other.branchesScanned;
+    leavesScanned += other.leavesScanned;
+    bboxCandidates += other.bboxCandidates;
+    boxLimitRejects += other.boxLimitRejects;
+    matcherCalls += other.matcherCalls;
+    matcherAccepts += other.matcherAccepts;
+    matcherMemoHits += other.matcherMemoHits;
+    filterCalls += other.filterCalls;
+    filterAccepts += other.filterAccepts;
+    results += other.results;
+    dedupLookups += other.dedupLookups;
+    duplicates += other.duplicates;
+    wallTime += other.wallTime;
+    workerTime += other.workerTime;
+    consumerWaitTime += other.consumerWaitTime;
+}
+
+std::string QueryStats::toString() const
+{
+    StringBuilder s;
+    s << "tiles:     " << tilesVisited << " visited, "
+        << tilesScanned << " scanned, " << tilesFromCache << " cached, "
+        << tilesCounted << " counted, "
+        << tilesTranscoded << " transcoded, "
+        << tilesCancelled << " cancelled, "
+        << tilesSkipped << " skipped by tag summary, statistics or numeric index\n";
+    if (tilesSplit || tilesCoalesced || tasksHelped)
+    {
+        s << "tasks:     " << tilesSplit << " tiles split, "
+            << tilesCoalesced << " tiles coalesced, "
+            << tasksHelped << " run by consumer\n";
+    }
+    uint64_t rejected = 0;
+    for (int i = 0; i < MAX_LEVELS; i++) rejected += tilesRejected[i];
+    if (rejected)
+    {
+        s << "rejected:  ";
+        for (int i = 0; i < MAX_LEVELS; i++)
+        {
+            if (tilesRejected[i] == 0) continue;
+            s << "level " << i << ": " << tilesRejected[i] << "  ";
+        }
+        s << "\n";
+    }
+    s << "indexes:   " << indexRootsSearched << " searched, "
+        << indexRootsPruned << " pruned by key mask\n"
+        << "index:     " << branchesScanned << " branches, "
+        << leavesScanned << " leaves, " << bboxCandidates << " bbox candidates, "
+        << boxLimitRejects << " rejected by size\n"
+        << "matcher:   " << matcherAccepts << " of " << matcherCalls << " accepted, "
+        << matcherMemoHits << " reused for shared tag tables\n"
+        << "filter:    " << filterAccepts << " of " << filterCalls << " accepted\n"
+        << "results:   " << results << " (" << duplicates << " duplicates in "
+        << dedupLookups << " dedup lookups)\n"
+        << Format::format("time:      %.3f ms wall, %.3f ms in workers, "
+            "%.3f ms waiting for workers\n", wallTime / 1e6,
+            workerTime / 1e6, consumerWaitTime / 1e6);
+    return s.toString();
+}
+
+} // namespace geodesk
@@ -0,0 +1,296 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/SpatialJoin.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <clarisma/thread/TaskEngine.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/filter/FeatureDistanceFilter.h>
+#include <geodesk/filter/IntersectsFilter.h>
+#include <geodesk/filter/WithinFilter.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/geom/index/HilbertTreeBuilder.h>
+#include <geodesk/query/Query.h>
+
+using namespace clarisma;
+
+namespace geodesk {
+
+namespace {
+
+struct JoinBatch
+{
+    std::vector<FeaturePtr> outer;
+};
+
+struct JoinOutput
+{
+    std::vector<std::pair<FeaturePtr,FeaturePtr>> pairs;
+};
+
+Box boundsOf(FeaturePtr feature)
+{
+    return feature.isNode() ? NodePtr(feature).bounds() : feature.bounds();
+}
+
+/// Grows `box` by `units` on each side (without wrapping around
+/// the edges of the map)
+Box expanded(const Box& box, int32_t units)
+{
+    if (units == 0) return box;
+    auto clamped = [](int64_t v)
+    {
+        return static_cast<int32_t>(std::clamp<int64_t>(v,
+            std::numeric_limits<int32_t>::min(),
+            std::numeric_limits<int32_t>::max()));
+    };
+    return Box(clamped(int64_t{box.minX()} - units),
+        clamped(int64_t{box.minY()} - units),
+        clamped(int64_t{box.maxX()} + units),
+        clamped(int64_t{box.maxY()} + units));
+}
+
+/// Releases the prepared filters of a batch once it is done
+class FilterList
+{
+public:
+    ~FilterList()
+    {
+        for (const Filter* filter : filters_) filter->release();
+    }
+
+    const Filter* add(const Filter* filter)
+    {
+        if (filter) filters_.push_back(filter);
+        return filter;
+    }
+
+private:
+    std::vector<const Filter*> filters_;
+};
+
+} // namespace
+
+class SpatialJoinEngine;
+
+class SpatialJoinContext
+{
+public:
+    explicit SpatialJoinContext(SpatialJoinEngine* engine) : engine_(engine) {}
+
+    void processTask(JoinBatch& batch);
+    void afterTasks() {}
+    void harvestResults() {}
+
+private:
+    /// An inner feature, with the filter prepared for it
+    /// (created on demand)
+    struct Candidate
+    {
+        FeaturePtr feature;
+        const Filter* filter;
+        bool isPrepared;
+    };
+
+    static bool collect(const RTree<Candidate>::Node* node,
+        std::vector<Candidate*>* hits)
+    {
+        hits->push_back(node->item());
+        return false;
+    }
+
+    SpatialJoinEngine* engine_;
+};
+
+class SpatialJoinEngine : public TaskEngine<SpatialJoinEngine, SpatialJoinContext,
+    JoinBatch, JoinOutput>
+{
+public:
+    SpatialJoinEngine(int threads, const View& outer, const View& inner,
+        SpatialPredicate predicate, double meters, SpatialJoin::Consumer& consumer) :
+        TaskEngine(threads),
+        outer_(outer),
+        inner_(inner),
+        predicate_(predicate),
+        meters_(meters),
+        consumer_(consumer)
+    {
+    }
+
+    void run()
+    {
+        start();
+        FeatureStore* store = outer_.store();
+        Query query(store, outer_.bounds(), outer_.types(),
+            outer_.matcher(), outer_.filter());
+        JoinBatch batch;
+        Tip tip;
+        while (!hasFailed())
+        {
+            FeaturePtr feature = query.next();
+            if (feature.isNull()) break;
+            if (!batch.outer.empty() && (query.currentTip() != tip ||
+                batch.outer.size() >= SpatialJoin::MAX_BATCH_SIZE))
+            {
+                postWork(std::move(batch));
+                batch = {};
+            }
+            tip = query.currentTip();
+            batch.outer.push_back(feature);
+        }
+        if (!batch.outer.empty() && !hasFailed()) postWork(std::move(batch));
+        if (hasFailed()) query.cancel();
+        end();
+    }
+
+    void processTask(JoinOutput& output)
+    {
+        for (const auto& [a, b] : output.pairs) consumer_(a, b);
+    }
+
+    FeatureStore* store() const { return outer_.store(); }
+    const View& inner() const { return inner_; }
+
+    /// CONTAINS is tested using a filter prepared for the outer feature;
+    /// all other predicates use filters prepared for the inner features
+    bool filtersOuter() const { return predicate_ == SpatialPredicate::CONTAINS; }
+
+    /// Returns the filter for the given feature (or `nullptr` if the
+    /// predicate can never hold for it, e.g. WITHIN a node)
+    const Filter* prepare(FeaturePtr feature) const
+    {
+        FeatureStore* store = outer_.store();
+        switch (predicate_)
+        {
+        case SpatialPredicate::INTERSECTS:
+            return IntersectsFilterFactory().forFeature(store, feature);
+        case SpatialPredicate::MAX_DISTANCE:
+            return DistanceFilterFactory(meters_).forFeature(store, feature);
+        default:
+            return WithinFilterFactory().forFeature(store, feature);
+        }
+    }
+
+    /// The distance (in imps) by which bounding boxes within `bounds`
+    /// must be grown so they cover every feature that may lie within
+    /// the maximum distance
+    int32_t margin(const Box& bounds) const
+    {
+        if (predicate_ != SpatialPredicate::MAX_DISTANCE) return 0;
+        // The scale is largest at the edge farthest from the Equator
+        double units = std::max(
+            Mercator::unitsFromMeters(meters_, bounds.minY()),
+            Mercator::unitsFromMeters(meters_, bounds.maxY()));
+        return static_cast<int32_t>(std::min(std::ceil(units),
+            static_cast<double>(std::numeric_limits<int32_t>::max())));
+    }
+
+private:
+    const View& outer_;
+    const View& inner_;
+    SpatialPredicate predicate_;
+    double meters_;
+    SpatialJoin::Consumer& consumer_;
+};
+
+void SpatialJoinContext::processTask(JoinBatch& batch)
+{
+    if (engine_->hasFailed()) return;
+    FeatureStore* store = engine_->store();
+    const View& inner = engine_->inner();
+
+    Box bounds;
+    for (FeaturePtr a : batch.outer) bounds.expandToIncludeSimple(boundsOf(a));
+    int32_t margin = engine_->margin(bounds);
+    bounds = Box::simpleIntersection(expanded(bounds, margin), inner.bounds());
+    if (bounds.isEmpty()) return;
+
+    std::vector<Candidate> candidates;
+    Query query(store, bounds, inner.types(), inner.matcher(), inner.filter());
+    for (;;)
+    {
+        FeaturePtr b = query.next();
+        if (b.isNull()) break;
+        candidates.push_back({ b, nullptr, false });
+    }
+    if (candidates.empty()) return;
+
+    std::vector<BoundedItem> items;
+    items.reserve(candidates.size());
+    for (Candidate& c : candidates) items.push_back({ boundsOf(c.feature), &c });
+    HilbertTreeBuilder builder(nullptr);
+    PackedRTree<Candidate> tree = builder.buildPacked<Candidate>(
+        items.data(), items.size(), Box());
+
+    FilterList filters;
+    JoinOutput output;
+    std::vector<Candidate*> hits;
+    bool filtersOuter = engine_->filtersOuter();
+    for (FeaturePtr a : batch.outer)
+    {
+        hits.clear();
+        tree.search(expanded(boundsOf(a), margin), &collect, &hits);
+        if (hits.empty()) continue;
+        if (filtersOuter)
+        {
+            const Filter* filter = filters.add(engine_->prepare(a));
+            if (!filter) continue;
+            for (Candidate* c : hits)
+            {
+                if (filter->accept(store, c->feature, FastFilterHint()))
+                {
+                    output.pairs.emplace_back(a, c->feature);
+                }
+            }
+        }
+        else
+        {
+            for (Candidate* c : hits)
+            {
+                if (!c->isPrepared)
+                {
+                    c->filter = filters.add(engine_->prepare(c->feature));
+                    c->isPrepared = true;
+                }
+                if (c->filter && c->filter->accept(store, a, FastFilterHint()))
+                {
+                    output.pairs.emplace_back(a, c->feature);
+                }
+            }
+        }
+    }
+    if (!output.pairs.empty()) engine_->postOutput(std::move(output));
+}
+
+SpatialJoin::SpatialJoin(const View& outer, const View& inner,
+    SpatialPredicate predicate, double meters) :
+    outer_(outer),
+    inner_(inner),
+    predicate_(predicate),
+    meters_(meters)
+{
+    if (outer.view() > View::WORLD || inner.view() > View::WORLD)
+    {
+        throw QueryException("Only world views can be joined");
+    }
+    if (outer.store() != inner.store())
+    {
+        throw QueryException("Can't join features from different stores");
+    }
+}
+
+void SpatialJoin::run(Consumer consumer, int threads)
+{
+    // (EMPTY views are also world views of their store)
+    if (outer_.view() == View::EMPTY || inner_.view() == View::EMPTY) return;
+    if (threads <= 0) threads = outer_.store()->executor().threadCount();
+    SpatialJoinEngine engine(std::max(threads, 1), outer_, inner_,
+        predicate_, meters_, consumer);
+    engine.run();
+}
+
+} // namespace geodesk
@@ -0,0 +1,229 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/SpilledFeatures.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <geodesk/feature/FeatureBase.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/NodePtr.h>
+#include <geodesk/geom/index/hilbert.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+/// Reads the refs of a spilled run, a buffer at a time
+class SpilledFeatures::RunReader
+{
+public:
+    RunReader(const Run& run, size_t bufferRefs) :
+        next_(run.start),
+        remaining_(run.count),
+        buf_(std::min(static_cast<uint64_t>(bufferRefs), run.count))
+    {
+    }
+
+    /// Returns the next ref, or nullptr once the run is exhausted
+    const Ref* next(File& file)
+    {
+        if (pos_ == buf_.size() || pos_ == count_)
+        {
+            if (remaining_ == 0) return nullptr;
+            count_ = static_cast<size_t>(std::min(
+                static_cast<uint64_t>(buf_.size()), remaining_));
+            uint8_t* p = reinterpret_cast<uint8_t*>(buf_.data());
+            size_t len = count_ * sizeof(Ref);
+            size_t read = 0;
+            while (read < len)
+            {
+                size_t n = file.read(next_ + read, p + read, len - read);
+                if (n == 0) throw IOException("Unexpected end of temporary file");
+                read += n;
+            }
+            next_ += len;
+            remaining_ -= count_;
+            pos_ = 0;
+        }
+        return &buf_[pos_++];
+    }
+
+private:
+    uint64_t next_;
+    uint64_t remaining_;
+    std::vector<Ref> buf_;
+    size_t pos_ = 0;
+    size_t count_ = 0;
+};
+
+
+SpilledFeatures::SpilledFeatures(FeatureStore* store, Order order, size_t maxMemory) :
+    store_(store),
+    order_(order),
+    maxRefs_(std::max(maxMemory / sizeof(Ref), size_t(1024)))
+{
+}
+
+
+SpilledFeatures::~SpilledFeatures()
+{
+    clear();
+}
+
+
+uint64_t SpilledFeatures::keyOf(FeaturePtr feature)
+{
+    switch (order_)
+    {
+    case Order::ID:
+        return feature.typedId();
+    case Order::HILBERT:
+    {
+        Coordinate center = feature.isNode() ?
+            NodePtr(feature).xy() : feature.bounds().center();
+        return hilbert::calculateHilbertDistance(center, Box::ofWorld());
+    }
+    default:
+        return size_;
+    }
+}
+
+
+void SpilledFeatures::add(Tip tip, DataPtr pTile, FeaturePtr feature)
+{
+    assert(feature.ptr().ptr() >= pTile.ptr());
+    Ref ref;
+    ref.key = keyOf(feature);
+    ref.tip = tip;
+    ref.offset = static_cast<uint32_t>(feature.ptr().ptr() - pTile.ptr());
+    refs_.push_back(ref);
+    size_++;
+    if (refs_.size() >= maxRefs_) spill();
+}
+
+
+void SpilledFeatures::sortRefs()
+{
+    // Refs that are in order already (which is always the case
+    // for Order::NONE) don't need sorting
+    if (order_ == Order::NONE) return;
+    std::stable_sort(refs_.begin(), refs_.end(), [](const Ref& a, const Ref& b)
+    {
+        return a.key < b.key;
+    });
+}
+
+
+/**
+ * Sorts the refs that are held in memory and appends them to the
+ * temporary file as a new run.
+ */
+void SpilledFeatures::spill()
+{
+    if (refs_.empty()) return;
+    sortRefs();
+    if (!spillFile_.isOpen())
+    {
+        std::filesystem::path dir = tempDir_.empty() ?
+            std::filesystem::temp_directory_path() : tempDir_;
+        spillPath_ = dir / ("geodesk-spill-" + std::to_string(std::random_device()()) + ".tmp");
+        spillFile_.open(spillPath_,
+            File::READ | File::WRITE | File::CREATE | File::REPLACE_EXISTING);
+    }
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(refs_.data());
+    size_t len = refs_.size() * sizeof(Ref);
+    spillFile_.seek(spillSize_);
+    while (len)
+    {
+        size_t n = spillFile_.write(p, len);
+        p += n;
+        len -= n;
+    }
+    runs_.push_back({ spillSize_, refs_.size() });
+    spillSize_ += refs_.size() * sizeof(Ref);
+    refs_.clear();
+}
+
+
+FeaturePtr SpilledFeatures::resolve(Ref ref)
+{
+    if (ref.tip != currentTip_)
+    {
+        currentTip_ = Tip(ref.tip);
+        currentTile_ = store_->fetchTile(currentTip_);
+    }
+    return FeaturePtr(currentTile_ + ref.offset);
+}
+
+
+/**
+ * Merges the spilled runs and the refs held in memory (by key, ties
+ * broken by run, so features with the same key stay in the order in
+ * which they were added). The spilled runs share a read buffer as
+ * large as the memory budget.
+ */
+void SpilledFeatures::forEach(const std::function<void(Feature)>& fn)
+{
+    sortRefs();
+    if (runs_.empty())
+    {
+        for (Ref ref : refs_) fn(Feature(store_, resolve(ref)));
+        return;
+    }
+
+    size_t bufferRefs = std::max(maxRefs_ / runs_.size(), size_t(256));
+    std::vector<RunReader> readers;
+    readers.reserve(runs_.size());
+    for (const Run& run : runs_) readers.emplace_back(run, bufferRefs);
+
+    using Head = std::pair<uint64_t, uint32_t>;        // key, run
+    std::priority_queue<Head, std::vector<Head>, std::greater<>> heads;
+    std::vector<const Ref*> current(runs_.size() + 1);
+    for (uint32_t r = 0; r < runs_.size(); r++)
+    {
+        current[r] = readers[r].next(spillFile_);
+        if (current[r]) heads.emplace(current[r]->key, r);
+    }
+    // The refs in memory come last
+    uint32_t memoryRun = static_cast<uint32_t>(runs_.size());
+    size_t memoryPos = 0;
+    if (!refs_.empty())
+    {
+        current[memoryRun] = &refs_[0];
+        heads.emplace(refs_[0].key, memoryRun);
+    }
+
+    while (!heads.empty())
+    {
+        uint32_t r = heads.top().second;
+        heads.pop();
+        fn(Feature(store_, resolve(*current[r])));
+        if (r == memoryRun)
+        {
+            current[r] = ++memoryPos < refs_.size() ? &refs_[memoryPos] : nullptr;
+        }
+        else
+        {
+            current[r] = readers[r].next(spillFile_);
+        }
+        if (current[r]) heads.emplace(current[r]->key, r);
+    }
+}
+
+
+void SpilledFeatures::clear()
+{
+    refs_.clear();
+    runs_.clear();
+    size_ = 0;
+    if (spillFile_.isOpen())
+    {
+        spillFile_.close();
+        File::remove(spillPath_.string().c_str());
+    }
+    spillSize_ = 0;
+    currentTip_ = Tip();
+}
+
+} // namespace geodesk
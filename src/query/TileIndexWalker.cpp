@@ -10,13 +10,17 @@ namespace geodesk {
 using namespace clarisma;
 
 TileIndexWalker::TileIndexWalker(
-    DataPtr pIndex, uint32_t zoomLevels, const Box& box, const Filter* filter) :
+    DataPtr pIndex, uint32_t zoomLevels, const Box& box, const Filter* filter,
+    QueryStats* stats, const Box* boxes, uint32_t boxCount) :
 	pIndex_(pIndex),
 	currentLevel_(0),
     box_(box),
     filter_(filter),
+    stats_(stats),
+    boxes_(boxes),
+    boxCount_(boxCount),
     tileBasedAcceleration_(false),
-    trackAcceptedTiles_(false)
+    trackAcceptedTiles_(boxCount != 0)
 {
 	int zoom = -1;
     Level* level = levels_;
@@ -108,25 +112,47 @@ bool TileIndexWalker::next()
                 level->currentCol, level->currentRow);
             // Log.debug("TIW: Current tile %s, Filter = %s", Tile.toString(currentTile), filter);
 
-            if (tileBasedAcceleration_)
+            if (tileBasedAcceleration_ || boxCount_)
             {
+                // Tiles that lie between the boxes of a multi-box
+                // query are skipped like tiles rejected by the filter
+                // (which is why the walker tracks accepted tiles for
+                // such a query)
+
+                if (boxCount_ && !intersectsAnyBox(currentTile_.bounds()))
+                {
+                    if (stats_) stats_->tilesRejected[currentLevel_]++;
+                    continue;
+                }
+
                 // TODO: Don't call acceptTile() if all turbo-flags are
                 // set for the current tile
-                
-                int turboFlags = filter_->acceptTile(currentTile_);
-                if (turboFlags < 0) continue;
+
+                int turboFlags = tileBasedAcceleration_ ?
+                    filter_->acceptTile(currentTile_) : 0;
+                if (turboFlags < 0)
+                {
+                    if (stats_) stats_->tilesRejected[currentLevel_]++;
+                    continue;
+                }
                 turboFlags_ = static_cast<uint32_t>(turboFlags);
                 
                 if (trackAcceptedTiles_)
                 {
-                    Tile northTile = currentTile_.neighbor(0, -1);
-                    Tile westTile = currentTile_.neighbor(-1, 0);
+                    AcceptedTiles& accepted = acceptedTiles_[currentLevel_];
+                    if (accepted.width == 0) initAccepted(accepted, currentTile_.zoom());
+                    int col = currentTile_.column();
+                    int row = currentTile_.row();
                     northwestFlags_ =
-                        (acceptedTiles_.find(northTile) != acceptedTiles_.end() ?
+                        (isAccepted(accepted, col, row - 1) ?
                             FeatureFlags::MULTITILE_NORTH : 0) |
-                        (acceptedTiles_.find(westTile) != acceptedTiles_.end() ?
-                            FeatureFlags::MULTITILE_WEST : 0);
-                    acceptedTiles_.insert(currentTile_);
+                        (isAccepted(accepted, col - 1, row) ?
+                            FeatureFlags::MULTITILE_WEST : 0) |
+                        (isAccepted(accepted, col - 1, row - 1) ?
+                            MULTITILE_NORTHWEST : 0) |
+                        (isAccepted(accepted, col + 1, row - 1) ?
+                            MULTITILE_NORTHEAST : 0);
+                    accept(accepted, currentTile_);
                 }
                 else
                 {
@@ -138,7 +164,9 @@ bool TileIndexWalker::next()
                     // (For simplicity, we could track tiles for strict-bbox filters
                     // as well)
 
-                    northwestFlags_ = FeatureFlags::MULTITILE_NORTH | FeatureFlags::MULTITILE_WEST;
+                    northwestFlags_ = FeatureFlags::MULTITILE_NORTH |
+                        FeatureFlags::MULTITILE_WEST | MULTITILE_NORTHWEST |
+                        MULTITILE_NORTHEAST;
                 }
             }
             else
@@ -171,6 +199,7 @@ bool TileIndexWalker::next()
                 startLevel(level+1, tip);
             }
             currentTip_ = tip;
+            if (stats_) stats_->tilesVisited++;
             return true;
         }
     }
@@ -202,6 +231,66 @@ void TileIndexWalker::startLevel(Level* level, int tip)
     level->turboFlags = 0; // TODO
 }
 
+void TileIndexWalker::initAccepted(AcceptedTiles& accepted, int zoom)
+{
+    accepted.left = Tile::columnFromXZ(box_.minX(), zoom);
+    accepted.top = Tile::rowFromYZ(box_.maxY(), zoom);
+    accepted.width = Tile::columnFromXZ(box_.maxX(), zoom) - accepted.left + 1;
+    accepted.height = Tile::rowFromYZ(box_.minY(), zoom) - accepted.top + 1;
+    int64_t tileCount = static_cast<int64_t>(accepted.width) * accepted.height;
+    if (tileCount > MAX_DENSE_TILES)
+    {
+        accepted.isSparse = true;
+        return;
+    }
+    size_t words = static_cast<size_t>((tileCount + 63) / 64);
+    accepted.bits.reset(new uint64_t[words]());
+}
+
+/**
+ * Checks whether the tile at the given column and row (at the level's
+ * zoom) has been accepted. Tiles outside the query's bounding box
+ * are never accepted.
+ */
+bool TileIndexWalker::intersectsAnyBox(const Box& bounds) const
+{
+    for (uint32_t i = 0; i < boxCount_; i++)
+    {
+        if (boxes_[i].intersects(bounds)) return true;
+    }
+    return false;
+}
+
+bool TileIndexWalker::isAccepted(const AcceptedTiles& accepted, int col, int row) const
+{
+    col -= accepted.left;
+    row -= accepted.top;
+    if (col < 0 || row < 0 || col >= accepted.width || row >= accepted.height)
+    {
+        return false;
+    }
+    if (accepted.isSparse)
+    {
+        Tile tile = Tile::fromColumnRowZoom(col + accepted.left,
+            row + accepted.top, currentTile_.zoom());
+        return sparseAcceptedTiles_.contains(static_cast<uint32_t>(tile));
+    }
+    size_t n = static_cast<size_t>(row) * accepted.width + col;
+    return (accepted.bits[n >> 6] & (1ULL << (n & 63))) != 0;
+}
+
+void TileIndexWalker::accept(AcceptedTiles& accepted, Tile tile)
+{
+    if (accepted.isSparse)
+    {
+        sparseAcceptedTiles_.insert(static_cast<uint32_t>(tile));
+        return;
+    }
+    size_t n = static_cast<size_t>(tile.row() - accepted.top) * accepted.width +
+        (tile.column() - accepted.left);
+    accepted.bits[n >> 6] |= 1ULL << (n & 63);
+}
+
 void TileIndexWalker::startRoot()
 {
     // this.filter = filter; // TODO
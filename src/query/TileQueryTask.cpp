@@ -2,13 +2,27 @@
 // SPDX-License-Identifier: LGPL-3.0-only
 
 #include <geodesk/query/TileQueryTask.h>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <optional>
+#include <clarisma/util/Bits.h>
+#include <clarisma/util/Tracer.h>
 #include <geodesk/feature/FeaturePtr.h>
 #include <geodesk/feature/types.h>
+#include <geodesk/geom/BoxTester.h>
+#include <geodesk/geom/Length.h>
+#include <geodesk/geom/Mercator.h>
+#include <geodesk/query/PostedTasks.h>
 #include <geodesk/query/Query.h>
+#include <geodesk/query/QueryCache.h>
+#include <geodesk/query/TileScanCache.h>
 
 namespace geodesk {
 
-QueryResultsHeader QueryResults::EMPTY_HEADER = { EMPTY, DataPtr(), DEFAULT_BUCKET_SIZE };
+QueryResultsHeader QueryResults::EMPTY_HEADER = { EMPTY, DataPtr(), 0, 0, 0 };
 QueryResults* const QueryResults::EMPTY = reinterpret_cast<QueryResults*>(&EMPTY_HEADER);
 
 // TODO: perform type check prior to matcher
@@ -18,24 +32,436 @@ QueryResults* const QueryResults::EMPTY = reinterpret_cast<QueryResults*>(&EMPTY
 	// (No need for AND with 0x1f, as int-shift only considers lower 5 bits)
 	// if (((1 << (flags >> 1)) & acceptedTypes) == 0) break;
 
+const TileQueryTask::LeafMethod TileQueryTask::LEAF_METHODS[LEAF_MODE_COUNT] =
+{
+	&TileQueryTask::searchLeaf<0>, &TileQueryTask::searchLeaf<1>,
+	&TileQueryTask::searchLeaf<2>, &TileQueryTask::searchLeaf<3>,
+	&TileQueryTask::searchLeaf<4>, &TileQueryTask::searchLeaf<5>,
+	&TileQueryTask::searchLeaf<6>, &TileQueryTask::searchLeaf<7>,
+	&TileQueryTask::searchLeaf<8>, &TileQueryTask::searchLeaf<9>,
+	&TileQueryTask::searchLeaf<10>, &TileQueryTask::searchLeaf<11>,
+	&TileQueryTask::searchLeaf<12>, &TileQueryTask::searchLeaf<13>,
+	&TileQueryTask::searchLeaf<14>, &TileQueryTask::searchLeaf<15>
+};
+
+const TileQueryTask::LeafMethod TileQueryTask::NODE_LEAF_METHODS[LEAF_MODE_COUNT] =
+{
+	&TileQueryTask::searchNodeLeaf<0>, &TileQueryTask::searchNodeLeaf<1>,
+	&TileQueryTask::searchNodeLeaf<2>, &TileQueryTask::searchNodeLeaf<3>,
+	&TileQueryTask::searchNodeLeaf<4>, &TileQueryTask::searchNodeLeaf<5>,
+	&TileQueryTask::searchNodeLeaf<6>, &TileQueryTask::searchNodeLeaf<7>,
+	&TileQueryTask::searchNodeLeaf<8>, &TileQueryTask::searchNodeLeaf<9>,
+	&TileQueryTask::searchNodeLeaf<10>, &TileQueryTask::searchNodeLeaf<11>,
+	&TileQueryTask::searchNodeLeaf<12>, &TileQueryTask::searchNodeLeaf<13>,
+	&TileQueryTask::searchNodeLeaf<14>, &TileQueryTask::searchNodeLeaf<15>
+};
+
+const TileQueryTask::LeafMethod TileQueryTask::COUNT_LEAF_METHODS[2] =
+{
+	&TileQueryTask::countLeaf<false>, &TileQueryTask::countLeaf<true>
+};
+
+const TileQueryTask::LeafMethod TileQueryTask::COUNT_NODE_LEAF_METHODS[2] =
+{
+	&TileQueryTask::countNodeLeaf<false>, &TileQueryTask::countNodeLeaf<true>
+};
+
+const TileQueryTask::ScanMethod TileQueryTask::SCAN_METHODS[LEAF_MODE_COUNT] =
+{
+	&TileQueryTask::scanFeatures<0>, &TileQueryTask::scanFeatures<1>,
+	&TileQueryTask::scanFeatures<2>, &TileQueryTask::scanFeatures<3>,
+	&TileQueryTask::scanFeatures<4>, &TileQueryTask::scanFeatures<5>,
+	&TileQueryTask::scanFeatures<6>, &TileQueryTask::scanFeatures<7>,
+	&TileQueryTask::scanFeatures<8>, &TileQueryTask::scanFeatures<9>,
+	&TileQueryTask::scanFeatures<10>, &TileQueryTask::scanFeatures<11>,
+	&TileQueryTask::scanFeatures<12>, &TileQueryTask::scanFeatures<13>,
+	&TileQueryTask::scanFeatures<14>, &TileQueryTask::scanFeatures<15>
+};
+
+const TileQueryTask::ScanMethod TileQueryTask::NODE_SCAN_METHODS[LEAF_MODE_COUNT] =
+{
+	&TileQueryTask::scanNodes<0>, &TileQueryTask::scanNodes<1>,
+	&TileQueryTask::scanNodes<2>, &TileQueryTask::scanNodes<3>,
+	&TileQueryTask::scanNodes<4>, &TileQueryTask::scanNodes<5>,
+	&TileQueryTask::scanNodes<6>, &TileQueryTask::scanNodes<7>,
+	&TileQueryTask::scanNodes<8>, &TileQueryTask::scanNodes<9>,
+	&TileQueryTask::scanNodes<10>, &TileQueryTask::scanNodes<11>,
+	&TileQueryTask::scanNodes<12>, &TileQueryTask::scanNodes<13>,
+	&TileQueryTask::scanNodes<14>, &TileQueryTask::scanNodes<15>
+};
+
+/**
+ * Returns the bits (by FeatureIndexType) of the indexes that
+ * must be searched for the given types.
+ */
+uint8_t TileQueryTask::indexesOf(uint32_t types)
+{
+	uint8_t indexes = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (types & INDEX_TYPES[i]) indexes |= 1 << i;
+	}
+	return indexes;
+}
+
+/**
+ * Determines which leaf loop to use for the given index of a query.
+ */
+uint8_t TileQueryTask::leafMode(FeatureIndexType indexType, FeatureTypes types,
+	const MatcherHolder* matcher, const Filter* filter)
+{
+	uint32_t indexTypes = INDEX_TYPES[indexType];
+	uint8_t mode = 0;
+	if (matcher->isMatchAll()) mode |= MATCH_ALL;
+	if (filter == nullptr) mode |= NO_FILTER;
+	if ((types & indexTypes) == indexTypes) mode |= ALL_TYPES;
+	return mode;
+}
+
 void TileQueryTask::operator()()
 {
+	// The consumer may have run this task already (which it does
+	// with a copy that has no ticket)
+	if (posted_ && !posted_->claim(ticket_)) return;
+	if (followers_)
+	{
+		// Let the OS load the other tiles while we scan our own
+		if (!query_->tileReader())
+		{
+			for (int i = 0; i < followerCount_; i++)
+			{
+				query_->store()->prefetchTile(Tip(followers_[i].tip()));
+			}
+		}
+		// (Before any of the tiles is offered, since the query may be
+		// gone once its last tile has been offered)
+		if (query_->stats())
+		{
+			QueryStats stats;
+			stats.tilesCoalesced = followerCount_;
+			query_->addStats(stats);
+		}
+		scan();
+		for (int i = 0; i < followerCount_; i++) followers_[i].scan();
+		delete[] followers_;
+		return;
+	}
+	scan();
+}
+
+void TileQueryTask::scan()
+{
+	GEODESK_TRACE_SPAN("scan tile", tipAndFlags_ >> 8);
+	QueryStats stats;
+	if (query_->stats()) stats_ = &stats;
+	try
+	{
+		run();
+	}
+	catch (...)
+	{
+		// An exception (e.g. thrown by a TileReducer) can't propagate
+		// on a worker thread; the consumer rethrows it instead. The
+		// tile must still be offered, so the query can complete.
+		batch_ = nullptr;
+		multiBox_ = nullptr;
+		layerScan_ = nullptr;
+		tagMemo_ = nullptr;
+		query_->fail(std::current_exception());
+	}
+	// The consumer may destroy the query as soon as its last tile
+	// has been offered, so the tile's statistics are merged first
+	if (stats_)
+	{
+		query_->addStats(stats);
+		stats_ = nullptr;
+	}
+	query_->offer(results_, sequence_);
+}
+
+void TileQueryTask::run()
+{
+	std::chrono::steady_clock::time_point startTime;
+	if (stats_) startTime = std::chrono::steady_clock::now();
+	if (query_->isCancelled())
+	{
+		// Discard the tile, but we still need to report it
+		// as completed
+		if (stats_) stats_->tilesCancelled++;
+		return;
+	}
 	Tip tip = Tip(tipAndFlags_ >> 8);
-	pTile_ = query_->store()->fetchTile(tip);
+	FeatureStore* store = query_->store();
+	TileReader* reader = query_->tileReader();
+	TileReader::Pin pin;
+	if (reader)
+	{
+		// The tile is read into memory of its own, so hints
+		// about the mapped file would be pointless
+		pin = reader->pin(tip);
+		pTile_ = pin.data();
+	}
+	else
+	{
+		if (query_->options().sequential)
+		{
+			store->adviseTile(tip, clarisma::MappedFile::AccessPattern::SEQUENTIAL);
+		}
+		if (prefetchOwn_) store->prefetchTile(tip);
+		if (lookaheadTip_ != NO_PREFETCH) store->prefetchTile(Tip(lookaheadTip_));
+		pTile_ = store->fetchTile(tip);
+	}
 	uint32_t types = query_->types();
+	bool whole = indexes_ == ALL_INDEXES;
+	if (whole)
+	{
+		uint32_t tileSize = pTile_.getUnsignedInt() & 0x3fff'ffff;
+		store->counters().tilesScanned.add();
+		store->counters().tileBytes.add(tileSize);
+		query_->addScannedTile(tileSize);
+		if (tileSize >= SPLIT_TILE_SIZE && query_->maySplitTiles()) split(types);
+	}
+
+	QueryCache* cache = query_->cache();
+	QueryCache::Key cacheKey;
+	if (cache)
+	{
+		cacheKey = { tipAndFlags_, query_->types(), query_->matcher(),
+			query_->filter(), query_->bounds() };
+		QueryCache::Items items = cache->lookup(cacheKey);
+		if (items)
+		{
+			for (uint32_t item : *items) addResult(item);
+			if (stats_)
+			{
+				stats_->tilesFromCache++;
+				stats_->results += items->size();
+			}
+			return;
+		}
+	}
+
+	// Skip the filter if it accepts the entire tile; otherwise, let
+	// the planner decide whether it is cheaper to call it first
+	const Filter* filter = query_->filter();
+	tileMode_ = 0;
+	if (filter)
+	{
+		if (filter->acceptsAllInTile(fastFilterHint_.turboFlags))
+		{
+			tileMode_ = NO_FILTER;
+		}
+		else if (query_->planner().filterFirst())
+		{
+			tileMode_ = FILTER_FIRST;
+		}
+	}
+	hasBoxLimits_ = false;
+	if (filter && !(tileMode_ & NO_FILTER)) prepareBoxLimits(filter);
 
 	// LOG("Scanning tile %06X", tip);
 
-	if (types & FeatureTypes::NODES) searchNodeIndexes();
-	if (types & FeatureTypes::NONAREA_WAYS) searchIndexes(FeatureIndexType::WAYS);
-	if (types & FeatureTypes::AREAS) searchIndexes(FeatureIndexType::AREAS);
-	if (types & FeatureTypes::NONAREA_RELATIONS) searchIndexes(FeatureIndexType::RELATIONS);
-	query_->offer(results_);
+	ReductionBatch batch;
+	TileReducer* reducer = query_->reducer();
+	if (reducer)
+	{
+		batch.reducer = reducer;
+		batch.count = 0;
+		batch.counted = 0;
+		batch.total = 0;
+		batch_ = &batch;
+		reducer->beginTile(sequence_);
+	}
+
+	std::optional<MultiBoxScan> multiBox;
+	if (query_->boxCount())
+	{
+		multiBox.emplace(query_->boxes(), query_->boxCount(),
+			fastFilterHint_.tile.bounds());
+		multiBox_ = &*multiBox;
+	}
+
+	std::optional<LayerScan> layerScan;
+	if (query_->layerCount())
+	{
+		layerScan.emplace(query_->layers(), query_->layerCount());
+		layerScan_ = &*layerScan;
+	}
+
+	countOnly_ = isCountOnly();
+	if (countOnly_ && stats_) stats_->tilesCounted++;
+
+	// Features with identical tags usually share a tag table, so a
+	// matcher that looks only at tags needs to check each table once
+	const MatcherHolder* matcher = query_->matcher();
+	std::optional<TagMemo> tagMemo;
+	if (!countOnly_ && !matcher->isMatchAll() && matcher->dependsOnlyOnTags())
+	{
+		tagMemo.emplace();
+		tagMemo_ = &*tagMemo;
+	}
+
+	uint8_t indexes = indexes_ & indexesOf(types);
+	// A tile that is scanned often may have been transcoded into
+	// flat arrays, which are quicker to check against a simple box
+	// (A tile that is merely counted doesn't need them)
+	TileScanCache* scanCache = query_->scanCache();
+	TileScanCache::TileRef scanTile;
+	if (scanCache && !countOnly_ && query_->bounds().minX() <= query_->bounds().maxX())
+	{
+		scanTile = scanCache->get(store, tip, pTile_);
+	}
+	if (scanTile)
+	{
+		searchScanTile(*scanTile, indexes);
+		if (stats_) stats_->tilesTranscoded++;
+	}
+	else
+	{
+		if (indexes & (1 << FeatureIndexType::NODES)) searchNodeIndexes();
+		if (indexes & (1 << FeatureIndexType::WAYS)) searchIndexes(FeatureIndexType::WAYS);
+		if (indexes & (1 << FeatureIndexType::AREAS)) searchIndexes(FeatureIndexType::AREAS);
+		if (indexes & (1 << FeatureIndexType::RELATIONS)) searchIndexes(FeatureIndexType::RELATIONS);
+	}
+	if (reducer)
+	{
+		flushReduction();
+		reducer->endTile(batch.total);
+		batch_ = nullptr;
+	}
+	multiBox_ = nullptr;
+	layerScan_ = nullptr;
+	tagMemo_ = nullptr;
+	if (!sample_.isEmpty()) query_->planner().addSample(sample_);
+	// A scan that was cut short by cancel() is incomplete
+	if (cache && !query_->isCancelled()) cache->insert(cacheKey, resultItems());
+	if (stats_)
+	{
+		stats_->tilesScanned += whole;
+		stats_->workerTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - startTime).count();
+	}
+	// Features returned by Query::next() point into the tile
+	if (pin && results_ != QueryResults::EMPTY) query_->retainTile(std::move(pin));
+}
+
+/**
+ * Hands each index of a large tile (other than the first one the query
+ * needs) to a task of its own, so the tile is scanned by several
+ * workers at once. Each part posts its results as if it were a
+ * tile of its own.
+ */
+void TileQueryTask::split(uint32_t types)
+{
+	uint8_t indexes = indexesOf(types);
+	if (std::popcount(indexes) < 2) return;
+	indexes_ = indexes & -indexes;       // we search the first one
+	indexes ^= indexes_;
+
+	QueryExecutor& executor = query_->store()->executor();
+	while (indexes)
+	{
+		// (A fresh copy each time, since a part that runs inline
+		// leaves its results behind)
+		TileQueryTask part = *this;
+		part.setPrefetch(false, NO_PREFETCH);
+		part.setFollowers(nullptr, 0);      // (they remain ours)
+		part.setTicket(nullptr, 0);         // (only workers run parts)
+		part.results_ = QueryResults::EMPTY;
+		part.indexes_ = indexes & -indexes;
+		indexes ^= part.indexes_;
+		// The part must be counted before it can complete
+		query_->addTilePart();
+		if (!executor.tryPost(part)) part.scan();
+	}
+	if (stats_) stats_->tilesSplit++;
+}
+
+TileQueryTask::MultiBoxScan::MultiBoxScan(const Box* boxes_, uint32_t boxCount_,
+	const Box& tileBounds_) :
+	boxes(boxes_),
+	boxCount(boxCount_),
+	tileBounds(tileBounds_)
+{
+	for (uint32_t i = 0; i < boxCount; i++)
+	{
+		if (boxes[i].intersects(tileBounds)) tileBoxes.push_back(i);
+	}
+}
+
+/**
+ * Determines which boxes intersect the given feature bounds. If the
+ * feature lies entirely within the tile, only the boxes that intersect
+ * the tile need to be checked. Otherwise, we check all boxes, so every
+ * copy of a multi-tile feature matches the same set (which lets the
+ * consumer deduplicate by feature).
+ */
+bool TileQueryTask::MultiBoxScan::matchBounds(const Box& bounds)
+{
+	matches.clear();
+	if (tileBounds.containsSimple(bounds))
+	{
+		for (uint32_t i : tileBoxes)
+		{
+			if (boxes[i].intersects(bounds)) matches.push_back(i);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < boxCount; i++)
+		{
+			if (boxes[i].intersects(bounds)) matches.push_back(i);
+		}
+	}
+	return !matches.empty();
+}
+
+bool TileQueryTask::MultiBoxScan::matchPoint(int32_t x, int32_t y)
+{
+	matches.clear();
+	for (uint32_t i : tileBoxes)
+	{
+		if (boxes[i].containsSimple(x, y)) matches.push_back(i);
+	}
+	return !matches.empty();
+}
+
+/**
+ * Determines which layers accept the given feature (which has already
+ * passed the query's bbox and type checks, based on the union of the
+ * layers' types).
+ */
+bool TileQueryTask::LayerScan::match(FeatureStore* store, FeaturePtr pFeature,
+	const FastFilterHint& fastFilterHint)
+{
+	matches.clear();
+	for (uint32_t i = 0; i < layerCount; i++)
+	{
+		if (layers[i].accept(store, pFeature, fastFilterHint)) matches.push_back(i);
+	}
+	return !matches.empty();
+}
+
+/**
+ * Checks whether the features of the tile can simply be counted: the
+ * query's reducer only needs their number, the tile lies entirely within
+ * the query bounds, and every feature passes the matcher and filter
+ * (Only their types and multi-tile flags need to be checked).
+ */
+bool TileQueryTask::isCountOnly() const
+{
+	return batch_ && batch_->reducer->countsOnly() && !multiBox_ &&
+		query_->matcher()->isMatchAll() &&
+		(query_->filter() == nullptr || (tileMode_ & NO_FILTER)) &&
+		query_->bounds().contains(fastFilterHint_.tile.bounds());
 }
 
 void TileQueryTask::searchNodeIndexes()
 {
 	const MatcherHolder* matcher = query_->matcher();
+	uint8_t mode = query_->leafMode(FeatureIndexType::NODES);
+	leafMethod_ = countOnly_ ? COUNT_NODE_LEAF_METHODS[(mode & ALL_TYPES) != 0] :
+		NODE_LEAF_METHODS[mode | tileMode_];
 	DataPtr ppRoot = pTile_ + 8;
 	int32_t ptr = ppRoot.getInt();
 	if (ptr == 0) return;
@@ -55,6 +481,10 @@ void TileQueryTask::searchNodeIndexes()
 		{
 			searchNodeRoot(p);
 		}
+		else if (stats_)
+		{
+			stats_->indexRootsPruned++;
+		}
 		if (last != 0) break;
 		p += 8;
 	}
@@ -65,10 +495,11 @@ void TileQueryTask::searchNodeRoot(DataPtr ppRoot)
 	int32_t ptr = ppRoot.getInt();
 	if (ptr)
 	{
+		if (stats_) stats_->indexRootsSearched++;
 		DataPtr p = ppRoot + (ptr & 0xffff'fffc);
 		if (ptr & 2)
 		{
-			searchNodeLeaf(p);
+			(this->*leafMethod_)(p);
 		}
 		else
 		{
@@ -80,17 +511,37 @@ void TileQueryTask::searchNodeRoot(DataPtr ppRoot)
 void TileQueryTask::searchNodeBranch(DataPtr p)
 {
 	// LOG("Searching branch at %016X", p);
-	Box box = query_->bounds();
+	if (query_->isCancelled()) return;
+	if (stats_) stats_->branchesScanned++;
+	BoxTester tester(query_->bounds());
 	for (;;)
 	{
-		int32_t ptr = p.getInt();
-		int32_t last = ptr & 1;
-		if (box.intersects(*reinterpret_cast<const Box*>((const uint8_t *)p + 4)))
+		// Gather up to BATCH_SIZE entries (pointer + bbox) so we can
+		// test their bounding boxes all at once
+		DataPtr entries[BoxTester::BATCH_SIZE];
+		const uint8_t* boxes[BoxTester::BATCH_SIZE];
+		int count = 0;
+		int32_t last;
+		for (;;)
+		{
+			entries[count] = p;
+			boxes[count] = p.ptr() + 4;
+			count++;
+			last = p.getInt() & 1;
+			if (last || count == BoxTester::BATCH_SIZE) break;
+			p += 20;
+		}
+		for (int i = count; i < BoxTester::BATCH_SIZE; i++) boxes[i] = boxes[count-1];
+
+		uint32_t candidates = tester.intersects(boxes);
+		for (int i = 0; i < count; i++)
 		{
-			DataPtr pChild = p + (ptr & 0xffff'fffc);
+			if ((candidates & (1 << i)) == 0) continue;
+			int32_t ptr = entries[i].getInt();
+			DataPtr pChild = entries[i] + (ptr & 0xffff'fffc);
 			if (ptr & 2)
 			{
-				searchNodeLeaf(pChild);
+				(this->*leafMethod_)(pChild);
 			}
 			else
 			{
@@ -102,37 +553,95 @@ void TileQueryTask::searchNodeBranch(DataPtr p)
 	}
 }
 
+template<int Mode>
 void TileQueryTask::searchNodeLeaf(DataPtr p)
 {
 	// LOG("Searching leaf at %016X", p);
+	if (stats_) stats_->leavesScanned++;
 	Box box = query_->bounds();
-	FeatureTypes acceptedTypes = query_->types();
-	const Matcher& matcher = query_->matcher()->mainMatcher();
+	BoxTester tester(box);
+	bool isSimple = box.minX() <= box.maxX();
+	MatcherBatch pending;
 
 	for (;;)
 	{
-		int32_t flags = (p+8).getInt();
-		if (box.contains(p.getInt(), (p+4).getInt()))
+		DataPtr nodes[BoxTester::BATCH_SIZE];
+		const uint8_t* points[BoxTester::BATCH_SIZE];
+		int count = 0;
+		int32_t flags;
+		for (;;)
+		{
+			nodes[count] = p;
+			points[count] = p.ptr();
+			count++;
+			flags = (p+8).getInt();
+			if ((flags & 1) || count == BoxTester::BATCH_SIZE) break;
+			p += 20 + (flags & 4);
+			// If Node is member of relation (flag bit 2), add
+			// extra 4 bytes for the relation table pointer
+		}
+		for (int i = count; i < BoxTester::BATCH_SIZE; i++) points[i] = points[count-1];
+
+		uint32_t candidates;
+		if (isSimple)
 		{
-			if (acceptedTypes.acceptFlags(flags))
+			candidates = tester.containsSimple(points);
+		}
+		else
+		{
+			candidates = 0;
+			for (int i = 0; i < count; i++)
 			{
-				FeaturePtr pFeature(p + 8);
-				if (matcher.accept(pFeature))
+				candidates |= static_cast<uint32_t>(box.contains(
+					nodes[i].getInt(), (nodes[i]+4).getInt())) << i;
+			}
+		}
+
+		if (stats_) stats_->bboxCandidates += clarisma::Bits::bitCount(candidates & ((1 << count) - 1));
+		for (int i = 0; i < count; i++)
+		{
+			if ((candidates & (1 << i)) == 0) continue;
+			checkNodeFeature<Mode>(nodes[i], pending);
+		}
+		if (flags & 1) break;
+		p += 20 + (flags & 4);
+	}
+	if constexpr (isBatched(Mode)) acceptBatch<Mode>(pending);
+}
+
+
+/**
+ * Checks a node (given by its leaf record) that lies within the query
+ * bounds against the query's types, matcher and filter, and adds it
+ * if accepted (batching the matcher calls like checkLeafFeature()).
+ */
+template<int Mode>
+void TileQueryTask::checkNodeFeature(DataPtr p, MatcherBatch& pending)
+{
+	if (multiBox_ && !multiBox_->matchPoint(p.getInt(), (p+4).getInt()))
+	{
+		return;
+	}
+	if ((Mode & ALL_TYPES) || query_->types().acceptFlags((p+8).getInt()))
+	{
+		FeaturePtr pFeature(p + 8);
+		if constexpr (isBatched(Mode))
+		{
+			if (!multiBox_)
+			{
+				pending.features[pending.count] = pFeature;
+				if (++pending.count == MatcherHolder::MAX_BATCH_SIZE)
 				{
-					const Filter* filter = query_->filter();
-					if (filter == nullptr || filter->accept(query_->store(),
-						pFeature, fastFilterHint_))
-					{
-						// LOG("Found node/%llu", Feature::id(pFeature));
-						addResult(static_cast<uint32_t>(pFeature.ptr() - pTile_));
-					}
+					acceptBatch<Mode>(pending);
 				}
+				return;
 			}
 		}
-		if (flags & 1) break;
-		p += 20 + (flags & 4);	
-		// If Node is member of relation (flag bit 2), add
-		// extra 4 bytes for the relation table pointer
+		if (acceptFeature<Mode>(pFeature))
+		{
+			// LOG("Found node/%llu", Feature::id(pFeature));
+			addFeature(pFeature);
+		}
 	}
 }
 
@@ -141,6 +650,9 @@ void TileQueryTask::searchNodeLeaf(DataPtr p)
 void TileQueryTask::searchIndexes(FeatureIndexType indexType)
 {
 	const MatcherHolder* matcher = query_->matcher();
+	uint8_t mode = query_->leafMode(indexType);
+	leafMethod_ = countOnly_ ? COUNT_LEAF_METHODS[(mode & ALL_TYPES) != 0] :
+		LEAF_METHODS[mode | tileMode_];
 	DataPtr ppRoot = pTile_ + 8 + indexType * 4;
 	int32_t ptr = ppRoot.getInt();
 	if (ptr == 0) return;
@@ -160,6 +672,10 @@ void TileQueryTask::searchIndexes(FeatureIndexType indexType)
 		{
 			searchRoot(p);
 		}
+		else if (stats_)
+		{
+			stats_->indexRootsPruned++;
+		}
 		if (last != 0) break;
 		p += 8;
 	}
@@ -171,10 +687,11 @@ void TileQueryTask::searchRoot(DataPtr ppRoot)
 	int32_t ptr = ppRoot.getInt();
 	if (ptr)
 	{
+		if (stats_) stats_->indexRootsSearched++;
 		DataPtr p = ppRoot + (ptr & 0xffff'fffc);
 		if (ptr & 2)
 		{
-			searchLeaf(p);
+			(this->*leafMethod_)(p);
 		}
 		else
 		{
@@ -185,17 +702,37 @@ void TileQueryTask::searchRoot(DataPtr ppRoot)
 
 void TileQueryTask::searchBranch(DataPtr p)
 {
-	Box box = query_->bounds();
+	if (query_->isCancelled()) return;
+	if (stats_) stats_->branchesScanned++;
+	BoxTester tester(query_->bounds());
 	for (;;)
 	{
-		int32_t ptr = p.getInt();
-		int32_t last = ptr & 1;
-		if (box.intersects(*reinterpret_cast<const Box*>((const uint8_t*)p + 4)))
+		// Gather up to BATCH_SIZE entries (pointer + bbox) so we can
+		// test their bounding boxes all at once
+		DataPtr entries[BoxTester::BATCH_SIZE];
+		const uint8_t* boxes[BoxTester::BATCH_SIZE];
+		int count = 0;
+		int32_t last;
+		for (;;)
+		{
+			entries[count] = p;
+			boxes[count] = p.ptr() + 4;
+			count++;
+			last = p.getInt() & 1;
+			if (last || count == BoxTester::BATCH_SIZE) break;
+			p += 20;
+		}
+		for (int i = count; i < BoxTester::BATCH_SIZE; i++) boxes[i] = boxes[count-1];
+
+		uint32_t candidates = tester.intersects(boxes);
+		for (int i = 0; i < count; i++)
 		{
-			DataPtr pChild = p + (ptr & 0xffff'fffc);
+			if ((candidates & (1 << i)) == 0) continue;
+			int32_t ptr = entries[i].getInt();
+			DataPtr pChild = entries[i] + (ptr & 0xffff'fffc);
 			if (ptr & 2)
 			{
-				searchLeaf(pChild);
+				(this->*leafMethod_)(pChild);
 			}
 			else
 			{
@@ -208,76 +745,590 @@ void TileQueryTask::searchBranch(DataPtr p)
 }
 
 
+template<int Mode>
 void TileQueryTask::searchLeaf(DataPtr p)
 {
-	Box box = query_->bounds();
-	FeatureTypes acceptedTypes = query_->types();
-	const Matcher& matcher = query_->matcher()->mainMatcher();
-
+	if (stats_) stats_->leavesScanned++;
+	BoxTester tester(query_->bounds());
+	MatcherBatch pending;
 	for (;;)
 	{
-		int32_t flags = (p+16).getInt();
-		int32_t multiTileFlags = flags & 
-			(FeatureFlags::MULTITILE_NORTH | FeatureFlags::MULTITILE_WEST);
+		// Leaf records are 32 bytes each, starting with the bbox
+		const uint8_t* boxes[BoxTester::BATCH_SIZE];
+		int count = 0;
+		int32_t last;
 		for (;;)
 		{
-			int32_t dupeFlag = 0;
-			if (multiTileFlags)
-			{
-				if (multiTileFlags == FeatureFlags::MULTITILE_WEST)
-				{
-					// If the feature has a second copy in the tile
-					// to the west, and the query's bounding box
-					// extends into that tile, we skip the feature
+			boxes[count++] = p.ptr();
+			last = (p+16).getInt() & 1;
+			if (last || count == BoxTester::BATCH_SIZE) break;
+			p += 32;
+		}
+		for (int i = count; i < BoxTester::BATCH_SIZE; i++) boxes[i] = boxes[count-1];
 
-					if (tipAndFlags_ & FeatureFlags::MULTITILE_WEST) break;
-				}
-				else if (multiTileFlags == FeatureFlags::MULTITILE_NORTH)
-				{
-					// If the feature has a second copy in the tile
-					// to the north, and the query's bounding box
-					// extends into that tile, we skip the feature
+		uint32_t candidates = tester.intersects(boxes);
+		if (stats_) stats_->bboxCandidates += clarisma::Bits::bitCount(candidates & ((1 << count) - 1));
+		for (int i = 0; i < count; i++)
+		{
+			if (candidates & (1 << i)) checkLeafFeature<Mode>(DataPtr(boxes[i]), pending);
+		}
+		if (last != 0) break;
+		p += 32;
+	}
+	if constexpr (isBatched(Mode)) acceptBatch<Mode>(pending);
+}
 
-					if (tipAndFlags_ & FeatureFlags::MULTITILE_NORTH) break;
-				}
-				else
+
+/**
+ * Checks a feature whose bbox intersects the query bounds against
+ * the query's types, matcher and filter, and adds it if accepted.
+ * In batched modes, the matcher check is deferred until `pending`
+ * is full or the leaf is done (except for multi-box queries, which
+ * need the boxes matched by each feature when it is added).
+ */
+template<int Mode>
+void TileQueryTask::checkLeafFeature(DataPtr p, MatcherBatch& pending)
+{
+	int32_t flags = (p+16).getInt();
+	if (!checkMultiTile(flags, p)) return;
+
+	if (multiBox_ && !multiBox_->matchBounds(
+		*reinterpret_cast<const Box*>(p.ptr())))
+	{
+		return;
+	}
+
+	if ((Mode & ALL_TYPES) || query_->types().acceptFlags(flags))
+	{
+		if (!(Mode & NO_FILTER) && hasBoxLimits_ && violatesBoxLimits(p, flags))
+		{
+			if (stats_) stats_->boxLimitRejects++;
+			return;
+		}
+		FeaturePtr pFeature (p + 16);
+		if constexpr (isBatched(Mode))
+		{
+			if (!multiBox_)
+			{
+				pending.features[pending.count] = pFeature;
+				if (++pending.count == MatcherHolder::MAX_BATCH_SIZE)
 				{
-					// If both flags are set, this means we'll have
-					// to add the feature to the deduplication set
-					// TODO: if query does not extend beyond the
-					// tile boundaries, we don't have to do this
-					dupeFlag = Query::REQUIRES_DEDUP;
+					acceptBatch<Mode>(pending);
 				}
+				return;
 			}
-			if (!(p.getInt() > box.maxX() ||
-				(p+4).getInt() > box.maxY() ||
-				(p+8).getInt() < box.minX() ||
-				(p+12).getInt() < box.minY()))
+		}
+		if (acceptFeature<Mode>(pFeature))
+		{
+			// LOG("Found %s/%llu", Feature::typeName(pFeature), Feature::id(pFeature));
+			addFeature(pFeature);
+		}
+	}
+}
+
+
+/**
+ * Searches the indexes of a tile that has been transcoded by the
+ * TileScanCache. The features of each index root are checked in the
+ * same order as by a walk of the tile's R-trees, so the results are
+ * the same (and come in the same order).
+ */
+void TileQueryTask::searchScanTile(const TileScanCache::Tile& tile, uint8_t indexes)
+{
+	const MatcherHolder* matcher = query_->matcher();
+	for (int i = 0; i < 4; i++)
+	{
+		if ((indexes & (1 << i)) == 0) continue;
+		FeatureIndexType indexType = static_cast<FeatureIndexType>(i);
+		uint8_t mode = query_->leafMode(indexType) | tileMode_;
+		ScanMethod method = indexType == FeatureIndexType::NODES ?
+			NODE_SCAN_METHODS[mode] : SCAN_METHODS[mode];
+		const TileScanCache::Index& index = tile.indexes[i];
+		for (const TileScanCache::Index::Root& root : index.roots)
+		{
+			if (root.checkKeys && !matcher->acceptIndex(indexType, root.keys))
 			{
-				// TODO: replace this branching code with arithmetic?
-				// Useful? https://stackoverflow.com/a/62852710
+				if (stats_) stats_->indexRootsPruned++;
+				continue;
+			}
+			if (query_->isCancelled()) return;
+			if (stats_) stats_->indexRootsSearched++;
+			(this->*method)(index, indexType, root.start, root.end);
+		}
+	}
+}
 
-				if (acceptedTypes.acceptFlags(flags))
-				{
-					FeaturePtr pFeature (p + 16);
-					if (matcher.accept(pFeature))
-					{
-						const Filter* filter = query_->filter();
-						if (filter == nullptr || filter->accept(query_->store(), 
-							pFeature, fastFilterHint_))
-						{
-							// LOG("Found %s/%llu", Feature::typeName(pFeature), Feature::id(pFeature));
-							addResult(static_cast<uint32_t>(pFeature.ptr() - pTile_) | dupeFlag);	// TODO
-						}
-					}
-				}
+
+/**
+ * Checks a range of the features of a transcoded index, a block at a
+ * time: first their bboxes against the (simple) query bounds, in a
+ * loop the compiler can vectorize, then their keys against the
+ * matcher's key mask, which spares us the tag tables of features that
+ * lack the keys the query needs. The remaining ones are checked as in
+ * searchLeaf().
+ */
+template<int Mode>
+void TileQueryTask::scanFeatures(const TileScanCache::Index& index,
+	FeatureIndexType indexType, uint32_t start, uint32_t end)
+{
+	const Box& box = query_->bounds();
+	int32_t qMinX = box.minX();
+	int32_t qMinY = box.minY();
+	int32_t qMaxX = box.maxX();
+	int32_t qMaxY = box.maxY();
+	const int32_t* minX = index.minX.data();
+	const int32_t* minY = index.minY.data();
+	const int32_t* maxX = index.maxX.data();
+	const int32_t* maxY = index.maxY.data();
+	const MatcherHolder* matcher = query_->matcher();
+	MatcherBatch pending;
+	for (uint32_t blockStart = start; blockStart < end; blockStart += SCAN_BLOCK_SIZE)
+	{
+		uint32_t count = std::min(end - blockStart, SCAN_BLOCK_SIZE);
+		uint32_t candidates = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t n = blockStart + i;
+			candidates |= static_cast<uint32_t>(
+				(minX[n] <= qMaxX) & (maxX[n] >= qMinX) &
+				(minY[n] <= qMaxY) & (maxY[n] >= qMinY)) << i;
+		}
+		if (stats_) stats_->bboxCandidates += clarisma::Bits::bitCount(candidates);
+		while (candidates)
+		{
+			uint32_t n = blockStart + clarisma::Bits::countTrailingZerosInNonZero(candidates);
+			candidates &= candidates - 1;
+			if constexpr (!(Mode & MATCH_ALL))
+			{
+				if (!matcher->acceptIndex(indexType, index.keys[n])) continue;
 			}
-			break;
+			checkLeafFeature<Mode>(pTile_ + index.records[n], pending);
+		}
+	}
+	if constexpr (isBatched(Mode)) acceptBatch<Mode>(pending);
+}
+
+
+/**
+ * Like scanFeatures(), but for the node index.
+ */
+template<int Mode>
+void TileQueryTask::scanNodes(const TileScanCache::Index& index,
+	FeatureIndexType indexType, uint32_t start, uint32_t end)
+{
+	const Box& box = query_->bounds();
+	int32_t qMinX = box.minX();
+	int32_t qMinY = box.minY();
+	int32_t qMaxX = box.maxX();
+	int32_t qMaxY = box.maxY();
+	const int32_t* x = index.minX.data();
+	const int32_t* y = index.minY.data();
+	const MatcherHolder* matcher = query_->matcher();
+	MatcherBatch pending;
+	for (uint32_t blockStart = start; blockStart < end; blockStart += SCAN_BLOCK_SIZE)
+	{
+		uint32_t count = std::min(end - blockStart, SCAN_BLOCK_SIZE);
+		uint32_t candidates = 0;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			uint32_t n = blockStart + i;
+			candidates |= static_cast<uint32_t>(
+				(x[n] >= qMinX) & (x[n] <= qMaxX) &
+				(y[n] >= qMinY) & (y[n] <= qMaxY)) << i;
+		}
+		if (stats_) stats_->bboxCandidates += clarisma::Bits::bitCount(candidates);
+		while (candidates)
+		{
+			uint32_t n = blockStart + clarisma::Bits::countTrailingZerosInNonZero(candidates);
+			candidates &= candidates - 1;
+			if constexpr (!(Mode & MATCH_ALL))
+			{
+				if (!matcher->acceptIndex(indexType, index.keys[n])) continue;
+			}
+			checkNodeFeature<Mode>(pTile_ + index.records[n], pending);
+		}
+	}
+	if constexpr (isBatched(Mode)) acceptBatch<Mode>(pending);
+}
+
+
+/**
+ * Converts the filter's BoxLimits from meters into imps for the
+ * current tile. The scale of the Mercator projection varies with
+ * latitude, so the limits use the scale at whichever edge of the tile
+ * makes them least strict, and only hold for features whose bbox lies
+ * within the rows of the tile (features that extend beyond them are
+ * left to the filter).
+ */
+void TileQueryTask::prepareBoxLimits(const Filter* filter)
+{
+	Filter::BoxLimits limits = filter->boxLimits();
+	if (limits.isNone()) return;
+	const Box& bounds = fastFilterHint_.tile.bounds();
+	double nearY = (bounds.minY() <= 0 && bounds.maxY() >= 0) ? 0 :
+		std::min(std::abs(static_cast<double>(bounds.minY())),
+			std::abs(static_cast<double>(bounds.maxY())));
+	double farY = std::max(std::abs(static_cast<double>(bounds.minY())),
+		std::abs(static_cast<double>(bounds.maxY())));
+	// (Shave off a little, so rounding can't reject a feature that the
+	// filter itself would accept)
+	constexpr double MARGIN = 1 - 1e-9;
+	double maxScale = Mercator::metersPerUnitAtY(nearY);
+	minBoxArea_ = limits.minArea / (maxScale * maxScale) * MARGIN;
+	double maxDiagonal = limits.maxWayLength / (Mercator::metersPerUnitAtY(farY) *
+		(1 - Length::MAX_TABLE_ERROR)) / MARGIN;
+	maxWayDiagonalSquared_ = maxDiagonal * maxDiagonal;
+	limitsMinY_ = bounds.minY();
+	limitsMaxY_ = bounds.maxY();
+	hasBoxLimits_ = true;
+}
+
+
+/**
+ * Returns true if the bbox of the given leaf feature (whose flags
+ * have already been read) rules out its acceptance by the filter.
+ * Like Length::minOfWay(), the length of an area-way is taken to be
+ * at least twice its diagonal.
+ */
+bool TileQueryTask::violatesBoxLimits(DataPtr p, int32_t flags) const
+{
+	const Box& box = *reinterpret_cast<const Box*>(p.ptr());
+	if (box.minY() < limitsMinY_ || box.maxY() > limitsMaxY_) return false;
+	double width = static_cast<double>(box.maxX()) - box.minX();
+	double height = static_cast<double>(box.maxY()) - box.minY();
+	if (width * height < minBoxArea_) return true;
+	if (((flags >> 3) & 3) != static_cast<int>(FeatureType::WAY)) return false;
+	double diagonalSquared = width * width + height * height;
+	if (flags & FeatureFlags::AREA) diagonalSquared *= 4;
+	return diagonalSquared > maxWayDiagonalSquared_;
+}
+
+
+/**
+ * Checks the pending features against the matcher (with a single
+ * call), then checks the accepted ones against the filter and adds
+ * them, in their original order.
+ */
+template<int Mode>
+void TileQueryTask::acceptBatch(MatcherBatch& pending)
+{
+	static_assert(isBatched(Mode));
+	constexpr bool SAMPLE = !(Mode & NO_FILTER);
+	int count = pending.count;
+	if (count == 0) return;
+	pending.count = 0;
+	uint64_t accepted = tagMemo_ ? acceptMemoized(pending.features, count) :
+		query_->matcher()->accept(pending.features, count);
+	int acceptedCount = clarisma::Bits::bitCount(accepted);
+	if constexpr (SAMPLE)
+	{
+		sample_.matcherCalls += count;
+		sample_.matcherAccepts += acceptedCount;
+	}
+	if (stats_) [[unlikely]]
+	{
+		stats_->matcherCalls += count;
+		stats_->matcherAccepts += acceptedCount;
+	}
+	while (accepted)
+	{
+		int i = clarisma::Bits::countTrailingZerosInNonZero(accepted);
+		accepted &= accepted - 1;
+		if constexpr (!(Mode & NO_FILTER))
+		{
+			if (!acceptFilter<SAMPLE>(pending.features[i])) continue;
+		}
+		addFeature(pending.features[i]);
+	}
+}
+
+/**
+ * Like MatcherHolder::accept(), but looks up the verdict for each
+ * feature's tag table in the TagMemo first; only the remaining
+ * features are passed to the matcher (in a single call), and their
+ * verdicts are remembered.
+ */
+uint64_t TileQueryTask::acceptMemoized(const FeaturePtr* features, int count)
+{
+	FeaturePtr misses[MatcherHolder::MAX_BATCH_SIZE];
+	uint32_t missOffsets[MatcherHolder::MAX_BATCH_SIZE];
+	uint8_t missPositions[MatcherHolder::MAX_BATCH_SIZE];
+	int missCount = 0;
+	uint64_t accepted = 0;
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t offset = tagTableOffset(features[i]);
+		int verdict = tagMemo_->lookup(offset);
+		if (verdict >= 0)
+		{
+			accepted |= static_cast<uint64_t>(verdict) << i;
+			continue;
+		}
+		misses[missCount] = features[i];
+		missOffsets[missCount] = offset;
+		missPositions[missCount] = static_cast<uint8_t>(i);
+		missCount++;
+	}
+	if (stats_) [[unlikely]] stats_->matcherMemoHits += count - missCount;
+	if (missCount == 0) return accepted;
+	uint64_t missAccepted = query_->matcher()->accept(misses, missCount);
+	for (int i = 0; i < missCount; i++)
+	{
+		bool isAccepted = (missAccepted >> i) & 1;
+		tagMemo_->store(missOffsets[i], isAccepted);
+		accepted |= static_cast<uint64_t>(isAccepted) << missPositions[i];
+	}
+	return accepted;
+}
+
+/**
+ * Checks whether the query will encounter a feature (with the given
+ * flags and bounding box) in another tile, based on its multi-tile
+ * flags. A feature lives in up to 2 x 2 tiles: its copy in the tile
+ * to the east of its home has MULTITILE_WEST, the copy in the tile
+ * to the south has MULTITILE_NORTH, and the copy in the tile
+ * diagonally to the south-east has both.
+ *
+ * @return false if the feature should be skipped, since the query
+ *   returns it from another tile
+ */
+inline bool TileQueryTask::checkMultiTile(int32_t flags, DataPtr pBounds) const
+{
+	int32_t multiTileFlags = flags & 
+		(FeatureFlags::MULTITILE_NORTH | FeatureFlags::MULTITILE_WEST);
+	if (multiTileFlags == FeatureFlags::MULTITILE_WEST)
+	{
+		// If the feature has a second copy in the tile
+		// to the west, and the query's bounding box
+		// extends into that tile, we skip the feature
+
+		if (tipAndFlags_ & FeatureFlags::MULTITILE_WEST) return false;
+	}
+	else if (multiTileFlags == FeatureFlags::MULTITILE_NORTH)
+	{
+		// If the feature has a second copy in the tile
+		// to the north, and the query's bounding box
+		// extends into that tile, we skip the feature
+
+		if (tipAndFlags_ & FeatureFlags::MULTITILE_NORTH) return false;
+
+		// If the feature also extends into the tile to the east, it
+		// has a copy in the tile to the north-east, which the query
+		// returns if it has accepted that tile (since it hasn't
+		// accepted the tile to the west of it, which is ours to the
+		// north). Only a tracked tile set can accept the tile to the
+		// north-east without the one to the north.
+
+		if ((tipAndFlags_ & TileIndexWalker::MULTITILE_NORTHEAST) &&
+			(pBounds + 8).getInt() > fastFilterHint_.tile.rightX())
+		{
+			return false;
+		}
+	}
+	else if (multiTileFlags)
+	{
+		// If both flags are set, the feature also has copies in the
+		// tiles to the north, west and north-west. If the query
+		// reaches any of them, it returns the feature from there:
+		// from the tile to the north-west (the feature's home), or
+		// else from the tile to the north or west. If it reaches none
+		// of them, this is the only copy it can encounter.
+
+		if (tipAndFlags_ & (FeatureFlags::MULTITILE_NORTH |
+			FeatureFlags::MULTITILE_WEST | TileIndexWalker::MULTITILE_NORTHWEST))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Counts the nodes of a leaf in a tile that lies entirely within
+ * the query bounds (see isCountOnly()).
+ */
+template<bool AllTypes>
+void TileQueryTask::countNodeLeaf(DataPtr p)
+{
+	if (stats_) stats_->leavesScanned++;
+	FeatureTypes acceptedTypes = query_->types();
+	uint64_t count = 0;
+	for (;;)
+	{
+		int32_t flags = (p+8).getInt();
+		if (AllTypes || acceptedTypes.acceptFlags(flags)) count++;
+		if (flags & 1) break;
+		p += 20 + (flags & 4);
+	}
+	batch_->counted += count;
+	if (stats_) stats_->results += count;
+}
+
+/**
+ * Counts the features of a leaf in a tile that lies entirely within
+ * the query bounds (see isCountOnly()). Features that the consumer
+ * needs to deduplicate are added to the results instead.
+ */
+template<bool AllTypes>
+void TileQueryTask::countLeaf(DataPtr p)
+{
+	if (stats_) stats_->leavesScanned++;
+	FeatureTypes acceptedTypes = query_->types();
+	uint64_t count = 0;
+	for (;;)
+	{
+		int32_t flags = (p+16).getInt();
+		if ((AllTypes || acceptedTypes.acceptFlags(flags)) &&
+			checkMultiTile(flags, p))
+		{
+			count++;
 		}
 		if (flags & 1) break;
 		p += 32;
 	}
+	batch_->counted += count;
+	if (stats_) stats_->results += count;
+}
 
+/**
+ * Checks a candidate feature against the query's matcher and filter
+ * (skipping whichever of them the leaf mode tells us is a no-op, and
+ * sampling their selectivity for the QueryPlanner if both apply).
+ */
+template<int Mode>
+bool TileQueryTask::acceptFeature(FeaturePtr pFeature)
+{
+	constexpr bool SAMPLE = !(Mode & MATCH_ALL) && !(Mode & NO_FILTER);
+	if constexpr (SAMPLE && (Mode & FILTER_FIRST))
+	{
+		return acceptFilter<SAMPLE>(pFeature) && acceptMatcher<SAMPLE>(pFeature);
+	}
+	if constexpr (!(Mode & MATCH_ALL))
+	{
+		if (!acceptMatcher<SAMPLE>(pFeature)) return false;
+	}
+	else if (stats_) [[unlikely]]
+	{
+		stats_->matcherCalls++;
+		stats_->matcherAccepts++;
+	}
+	if constexpr (!(Mode & NO_FILTER))
+	{
+		if (!acceptFilter<SAMPLE>(pFeature)) return false;
+	}
+	return true;
+}
+
+template<bool Sample>
+bool TileQueryTask::acceptMatcher(FeaturePtr pFeature)
+{
+	if constexpr (Sample) sample_.matcherCalls++;
+	if (stats_) [[unlikely]] stats_->matcherCalls++;
+	bool accepted;
+	if (tagMemo_)
+	{
+		uint32_t offset = tagTableOffset(pFeature);
+		int verdict = tagMemo_->lookup(offset);
+		if (verdict >= 0)
+		{
+			if (stats_) [[unlikely]] stats_->matcherMemoHits++;
+			accepted = verdict;
+		}
+		else
+		{
+			accepted = query_->matcher()->mainMatcher().accept(pFeature);
+			tagMemo_->store(offset, accepted);
+		}
+	}
+	else
+	{
+		accepted = query_->matcher()->mainMatcher().accept(pFeature);
+	}
+	if (!accepted) return false;
+	if constexpr (Sample) sample_.matcherAccepts++;
+	if (stats_) [[unlikely]] stats_->matcherAccepts++;
+	return true;
+}
+
+template<bool Sample>
+bool TileQueryTask::acceptFilter(FeaturePtr pFeature)
+{
+	if constexpr (Sample) sample_.filterCalls++;
+	if (stats_) [[unlikely]] stats_->filterCalls++;
+	if (!query_->filter()->accept(query_->store(), pFeature, fastFilterHint_)) return false;
+	if constexpr (Sample) sample_.filterAccepts++;
+	if (stats_) [[unlikely]] stats_->filterAccepts++;
+	return true;
+}
+
+/**
+ * Passes an accepted feature to the query's TileReducer (if any), or
+ * else adds it to the list of results (for a multi-box query, together
+ * with the boxes it matched; for a layered query, together with the
+ * layers that accept it, unless there are none).
+ */
+void TileQueryTask::addFeature(FeaturePtr pFeature)
+{
+	const std::vector<uint32_t>* matches = nullptr;
+	if (layerScan_)
+	{
+		if (!layerScan_->match(query_->store(), pFeature, fastFilterHint_)) return;
+		matches = &layerScan_->matches;
+	}
+	else if (multiBox_)
+	{
+		matches = &multiBox_->matches;
+	}
+	if (stats_) stats_->results++;
+	if (matches)
+	{
+		// See Query::next(uint32_t*) for the layout of the group
+		addResult(static_cast<uint32_t>(pFeature.ptr() - pTile_));
+		addResult(static_cast<uint32_t>(matches->size()));
+		for (uint32_t match : *matches) addResult(match);
+		return;
+	}
+	if (batch_)
+	{
+		batch_->features[batch_->count++] = pFeature;
+		if (batch_->count == TileReducer::MAX_BATCH_SIZE) flushReduction();
+		return;
+	}
+	addResult(static_cast<uint32_t>(pFeature.ptr() - pTile_));
+}
+
+/**
+ * Returns all items added so far (The first bucket of the circular
+ * list is the one after `results_`).
+ */
+std::vector<uint32_t> TileQueryTask::resultItems() const
+{
+	std::vector<uint32_t> items;
+	if (results_ == QueryResults::EMPTY) return items;
+	const QueryResults* res = results_;
+	do
+	{
+		res = res->next;
+		items.insert(items.end(), res->items, res->items + res->count);
+	}
+	while (res != results_);
+	return items;
+}
+
+void TileQueryTask::flushReduction()
+{
+	if (batch_->count)
+	{
+		batch_->reducer->reduce(query_->store(), batch_->features, batch_->count);
+		batch_->total += batch_->count;
+		batch_->count = 0;
+	}
+	if (batch_->counted)
+	{
+		batch_->reducer->reduceCount(batch_->counted);
+		batch_->total += batch_->counted;
+		batch_->counted = 0;
+	}
 }
 
 /**
@@ -285,15 +1336,27 @@ void TileQueryTask::searchLeaf(DataPtr p)
  * If the current bucket is full, place a new bucket at the end
  * of the circular linked list of buckets.
  * - `results_` always points to the last bucket
+ * - The first bucket of a tile is sized according to the query's
+ *   selectivity so far; any further buckets are full-sized
  */
 void TileQueryTask::addResult(uint32_t item)
 {
 	if (results_->isFull())
 	{
-		QueryResults* next = new QueryResults();
-		QueryResults* last = (results_ == QueryResults::EMPTY) ? next : results_;
-		next->count = 0;
+		QueryResults* next;
+		QueryResults* last;
+		if (results_ == QueryResults::EMPTY)
+		{
+			next = query_->allocResults(query_->firstBucketSize());
+			last = next;
+		}
+		else
+		{
+			next = query_->allocResults(QueryResults::DEFAULT_BUCKET_SIZE);
+			last = results_;
+		}
 		next->pTile = pTile_;
+		next->tip = tip();
 		next->next = last->next;
 		last->next = next;
 		results_ = next;
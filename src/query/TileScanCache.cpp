@@ -0,0 +1,198 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/query/TileScanCache.h>
+#include <algorithm>
+#include <geodesk/feature/FeaturePtr.h>
+#include <geodesk/feature/FeatureStore.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/feature/types.h>
+
+namespace geodesk {
+
+/// Walks the spatial indexes of a tile in the same order as a
+/// TileQueryTask, and appends each feature to the arrays of its index
+class TileScanCache::Transcoder
+{
+public:
+    Transcoder(FeatureStore* store, DataPtr pTile) :
+        store_(store), pTile_(pTile) {}
+
+    void addIndex(FeatureIndexType indexType, Index& index)
+    {
+        bool isNodeIndex = indexType == FeatureIndexType::NODES;
+        TileFeatureWalker::forEachRoot(pTile_, indexType,
+            [this, &index, isNodeIndex](DataPtr ppRoot, uint32_t keys, bool hasKeys)
+            {
+                uint32_t start = static_cast<uint32_t>(index.size());
+                TileFeatureWalker::forEachRecord(ppRoot, isNodeIndex,
+                    [this, &index, isNodeIndex](DataPtr p, FeaturePtr pFeature)
+                    {
+                        if (isNodeIndex)
+                        {
+                            int32_t x = p.getInt();
+                            int32_t y = (p+4).getInt();
+                            addFeature(index, p, pFeature, x, y, x, y);
+                        }
+                        else
+                        {
+                            addFeature(index, p, pFeature, p.getInt(), (p+4).getInt(),
+                                (p+8).getInt(), (p+12).getInt());
+                        }
+                    });
+                index.roots.push_back({ keys, hasKeys, start,
+                    static_cast<uint32_t>(index.size()) });
+            });
+    }
+
+private:
+    void addFeature(Index& index, DataPtr pRecord, FeaturePtr pFeature,
+        int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+    {
+        index.minX.push_back(minX);
+        index.minY.push_back(minY);
+        index.maxX.push_back(maxX);
+        index.maxY.push_back(maxY);
+        index.flags.push_back(pFeature.flags());
+        index.keys.push_back(keysOf(pFeature));
+        index.records.push_back(static_cast<uint32_t>(pRecord.ptr() - pTile_.ptr()));
+    }
+
+    /// Only global keys are considered (like the tile's index roots,
+    /// local keys have no category)
+    uint32_t keysOf(FeaturePtr pFeature) const
+    {
+        uint32_t keys = 0;
+        DataPtr p(pFeature.ptr() + 8);
+        p = p.followTagged(~1);
+        for (;;)
+        {
+            uint32_t tag = p.getUnsignedIntUnaligned();
+            uint32_t keyBits = tag & 0xffff;
+            // (The empty tag table consists of a single 0xffff key)
+            if (keyBits == 0xffff) break;
+            int key = static_cast<int>((keyBits >> 2) & 0x1fff);
+            keys |= store_->keyIndexBits(key);
+            if (keyBits & 0x8000) break;
+            p += 4 + (tag & 2);
+        }
+        return keys;
+    }
+
+    FeatureStore* store_;
+    DataPtr pTile_;
+};
+
+
+TileScanCache::TileScanCache(size_t maxBytes, uint32_t minScans) :
+    maxBytes_(maxBytes),
+    minScans_(std::max(minScans, 1u)),
+    shards_(new Shard[SHARD_COUNT]),
+    storeTimestamp_(0),
+    storeSize_(0)
+{
+}
+
+
+std::unique_ptr<TileScanCache::Tile> TileScanCache::transcode(
+    FeatureStore* store, DataPtr pTile)
+{
+    std::unique_ptr<Tile> tile(new Tile());
+    Transcoder transcoder(store, pTile);
+    size_t bytes = sizeof(Tile) + sizeof(Entry) + 64;
+        // (approximate overhead of the list node and index entry)
+    for (int i = 0; i < 4; i++)
+    {
+        Index& index = tile->indexes[i];
+        transcoder.addIndex(static_cast<FeatureIndexType>(i), index);
+        bytes += index.roots.size() * sizeof(Index::Root) +
+            index.size() * (sizeof(int32_t) * 5 + sizeof(uint32_t) * 2);
+    }
+    tile->bytes = bytes;
+    return tile;
+}
+
+
+/**
+ * Tiles are transcoded without holding the lock, so two workers that
+ * scan the same tile at the same time may both transcode it (the second
+ * one simply uses the tile of the first). A tile that would take up
+ * more than a shard's share of the budget is never cached.
+ */
+TileScanCache::TileRef TileScanCache::get(FeatureStore* store, Tip tip, DataPtr pTile)
+{
+    Shard& s = shard(tip);
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.index.find(tip);
+        if (it != s.index.end())
+        {
+            s.entries.splice(s.entries.begin(), s.entries, it->second);
+            return it->second->tile;
+        }
+        uint32_t& scans = s.scans[tip];
+        if (++scans < minScans_) return nullptr;
+        scans = 0;      // (a tile that is too large is retried only
+                        // after another minScans_ scans)
+    }
+
+    TileRef tile = transcode(store, pTile);
+    size_t bytes = tile->bytes;
+    size_t maxShardBytes = maxBytes_ / SHARD_COUNT;
+    if (bytes > maxShardBytes) return nullptr;
+
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.index.find(tip);
+    if (it != s.index.end()) return it->second->tile;
+    while (s.bytes + bytes > maxShardBytes)
+    {
+        const Entry& oldest = s.entries.back();
+        s.bytes -= oldest.tile->bytes;
+        s.index.erase(oldest.tip);
+        s.entries.pop_back();
+    }
+    s.scans.erase(tip);
+    s.entries.push_front({ tip, tile });
+    s.index.emplace(tip, s.entries.begin());
+    s.bytes += bytes;
+    return tile;
+}
+
+
+void TileScanCache::validate(uint64_t storeTimestamp, uint64_t storeSize)
+{
+    std::lock_guard<std::mutex> lock(versionMutex_);
+    if (storeTimestamp == storeTimestamp_ && storeSize == storeSize_) return;
+    clear();
+    storeTimestamp_ = storeTimestamp;
+    storeSize_ = storeSize;
+}
+
+
+size_t TileScanCache::bytes()
+{
+    size_t total = 0;
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& s = shards_[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.bytes;
+    }
+    return total;
+}
+
+
+void TileScanCache::clear()
+{
+    for (int i = 0; i < SHARD_COUNT; i++)
+    {
+        Shard& s = shards_[i];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.entries.clear();
+        s.index.clear();
+        s.scans.clear();
+        s.bytes = 0;
+    }
+}
+
+} // namespace geodesk
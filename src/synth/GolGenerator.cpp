@@ -0,0 +1,794 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/synth/GolGenerator.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/feature/TagTablePtr.h>
+#include <geodesk/feature/TagValues.h>
+#include <geodesk/feature/types.h>
+#include <geodesk/geom/Tile.h>
+#include "build/GolWriter.h"
+#include "build/TileEncoder.h"
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// SplitMix64. Unlike the distributions of <random>, whose algorithms
+/// differ between standard libraries, this yields the same sequence
+/// everywhere.
+///
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state_ += 0x9E37'79B9'7F4A'7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58'476D'1CE4'E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D0'49BB'1331'11EBULL;
+        return z ^ (z >> 31);
+    }
+
+    /// A number in [0, 1)
+    double uniform()
+    {
+        return static_cast<double>(next() >> 11) * 0x1.0p-53;
+    }
+
+    /// An integer in [lo, hi]
+    int range(int lo, int hi)
+    {
+        return lo + static_cast<int>(next() % static_cast<uint64_t>(hi - lo + 1));
+    }
+
+    bool chance(double p) { return uniform() < p; }
+
+    /// An index in [0, n), where lower indexes are more likely
+    /// (with weights 1, 1/2, 1/3 ...)
+    int skewed(int n)
+    {
+        double total = 0;
+        for (int i = 1; i <= n; i++) total += 1.0 / i;
+        double r = uniform() * total;
+        for (int i = 0; i < n - 1; i++)
+        {
+            r -= 1.0 / (i + 1);
+            if (r < 0) return i;
+        }
+        return n - 1;
+    }
+
+    template<typename T, size_t N>
+    const T& pick(const T (&items)[N])
+    {
+        return items[next() % N];
+    }
+
+private:
+    uint64_t state_;
+};
+
+/// Derives the seed of a separate random sequence (for one tile and
+/// purpose), so the features of a tile don't depend on those of any
+/// other tile
+uint64_t deriveSeed(uint64_t seed, uint64_t a, uint64_t b)
+{
+    Random random(seed ^ (a * 0xD6E8'FEB8'6659'FD93ULL) ^ (b << 56));
+    return random.next();
+}
+
+/// The keys and values used by the generated features, with the
+/// index categories of the keys that are indexed
+///
+class Vocabulary
+{
+public:
+    struct Choice
+    {
+        uint16_t key;
+        std::vector<uint16_t> values;      // most common first
+    };
+
+    Vocabulary()
+    {
+        // The first four global strings are fixed by the GOL format
+        for (const char* s : { "no", "yes", "outer", "inner" }) intern(s);
+
+        highway = choice("highway", 1, { "residential", "service", "footway",
+            "track", "unclassified", "tertiary", "secondary", "path",
+            "primary", "cycleway", "living_street", "trunk" });
+        nodeHighway = choice("highway", 1, { "crossing", "street_lamp",
+            "traffic_signals", "bus_stop", "stop", "turning_circle" });
+        place = choice("place", 2, { "hamlet", "village", "suburb",
+            "town", "city" });
+        amenity = choice("amenity", 3, { "bench", "parking", "restaurant",
+            "waste_basket", "cafe", "bicycle_parking", "school",
+            "pharmacy", "fast_food", "bank", "post_box", "fuel" });
+        shop = choice("shop", 4, { "convenience", "bakery", "supermarket",
+            "hairdresser", "clothes", "butcher", "florist", "kiosk" });
+        building = choice("building", 5, { "yes", "house", "residential",
+            "garage", "apartments", "detached", "shed", "commercial",
+            "industrial", "school" });
+        landuse = choice("landuse", 6, { "residential", "forest",
+            "farmland", "grass", "meadow", "industrial", "retail" });
+        natural = choice("natural", 7, { "tree", "water", "wood",
+            "scrub", "wetland" });
+        boundary = choice("boundary", 8, { "administrative" });
+        route = choice("route", 9, { "bus", "hiking", "bicycle", "tram" });
+        surface = choice("surface", 0, { "asphalt", "unpaved", "paved",
+            "gravel", "ground", "concrete", "paving_stones" });
+        cuisine = choice("cuisine", 0, { "pizza", "italian", "burger",
+            "chinese", "regional", "german", "kebab", "sushi" });
+        type = choice("type", 0, { "multipolygon", "route", "boundary" });
+
+        name = intern("name");
+        maxspeed = intern("maxspeed");
+        oneway = intern("oneway");
+        lanes = intern("lanes");
+        housenumber = intern("addr:housenumber");
+        levels = intern("building:levels");
+        population = intern("population");
+        adminLevel = intern("admin_level");
+        stop = intern("stop");
+        yes = intern("yes");
+    }
+
+    const std::vector<std::string>& strings() const { return strings_; }
+    const std::vector<std::pair<uint16_t, uint16_t>>& indexSchema() const
+    {
+        return indexSchema_;
+    }
+
+    uint32_t indexBits(uint16_t key) const
+    {
+        auto it = std::find_if(indexSchema_.begin(), indexSchema_.end(),
+            [key](const auto& entry) { return entry.first == key; });
+        return it == indexSchema_.end() ? 0 : IndexBits::fromCategory(it->second);
+    }
+
+    Choice highway, nodeHighway, place, amenity, shop, building, landuse,
+        natural, boundary, route, surface, cuisine, type;
+    uint16_t name, maxspeed, oneway, lanes, housenumber, levels, population,
+        adminLevel, stop, yes;
+
+private:
+    uint16_t intern(std::string_view s)
+    {
+        auto it = codes_.find(std::string(s));
+        if (it != codes_.end()) return it->second;
+        // Code 0 is the empty string, which isn't stored
+        uint16_t code = static_cast<uint16_t>(strings_.size() + 1);
+        strings_.emplace_back(s);
+        codes_[std::string(s)] = code;
+        return code;
+    }
+
+    Choice choice(const char* key, int category,
+        std::initializer_list<const char*> values)
+    {
+        Choice c;
+        c.key = intern(key);
+        for (const char* v : values) c.values.push_back(intern(v));
+        if (category && indexBits(c.key) == 0)
+        {
+            indexSchema_.emplace_back(c.key, static_cast<uint16_t>(category));
+        }
+        return c;
+    }
+
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, uint16_t> codes_;
+    std::vector<std::pair<uint16_t, uint16_t>> indexSchema_;
+};
+
+const char* const NAME_STEMS[] =
+{
+    "Linden", "Berg", "Kirch", "Mühlen", "Wald", "Schiller", "Goethe",
+    "Bahnhof", "Garten", "Rosen", "Eichen", "Markt", "Schloss", "Birken",
+    "Hafen", "Sonnen", "Ahorn", "Tannen", "Brunnen", "Feld"
+};
+
+const char* const STREET_SUFFIXES[] =
+{
+    "straße", "weg", "gasse", "allee", "platz", "strasse", "ring", "steig"
+};
+
+const char* const PLACE_SUFFIXES[] =
+{
+    "dorf", "hausen", "feld", "heim", "bach", "burg", "au"
+};
+
+const char* const POI_SUFFIXES[] =
+{
+    " Eck", " Hof", " Stube", " Haus", " Markt", " am Platz"
+};
+
+using Tag = TileFeature::Tag;
+using Member = TileFeature::Member;
+using SynthFeature = TileFeature;
+
+/// Creates the features of one leaf tile
+///
+class FeatureFactory
+{
+public:
+    FeatureFactory(const GolGenerator::Settings& settings,
+        const Vocabulary& vocab, Tile tile, uint64_t seed, uint64_t idBase,
+        std::vector<SynthFeature>& features) :
+        settings_(settings),
+        vocab_(vocab),
+        random_(seed),
+        nextId_(idBase),
+        features_(features)
+    {
+        Box bounds = tile.bounds();
+        extent_ = static_cast<int64_t>(bounds.maxX()) - bounds.minX() + 1;
+        int32_t margin = static_cast<int32_t>(extent_ / 64);
+        interior_ = Box(bounds.minX() + margin, bounds.minY() + margin,
+            bounds.maxX() - margin, bounds.maxY() - margin);
+    }
+
+    void addNodes(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            SynthFeature& node = addFeature(FeatureType::NODE);
+            node.coords.push_back(randomPoint(interior_));
+            int kind = random_.skewed(5);
+            switch (kind)
+            {
+            case 0:
+            {
+                uint16_t value = addChoice(node, vocab_.amenity);
+                if (value == vocab_.amenity.values[2])   // restaurant
+                {
+                    if (optional()) addChoice(node, vocab_.cuisine);
+                    addLocal(node, vocab_.name, poiName());
+                }
+                else if (optional())
+                {
+                    addLocal(node, vocab_.name, poiName());
+                }
+                break;
+            }
+            case 1:
+                addChoice(node, vocab_.nodeHighway);
+                break;
+            case 2:
+                addChoice(node, vocab_.shop);
+                if (optional()) addLocal(node, vocab_.name, poiName());
+                break;
+            case 3:
+                addChoice(node, vocab_.natural, 0);     // tree
+                break;
+            default:
+            {
+                int size = random_.skewed(static_cast<int>(vocab_.place.values.size()));
+                addString(node, vocab_.place.key, vocab_.place.values[size]);
+                addLocal(node, vocab_.name, placeName());
+                // Cities get wide numbers
+                int population = random_.range(20, 300) << (size * 3);
+                addNumber(node, vocab_.population, population);
+                break;
+            }
+            }
+            finish(node);
+        }
+    }
+
+    void addStreets(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int length = random_.range(settings_.minStreetLength,
+                settings_.maxStreetLength);
+            SynthFeature& way = addFeature(FeatureType::WAY);
+            way.coords = walk(randomPoint(interior_), length,
+                extent_ / 400, interior_, false, false);
+            tagStreet(way);
+            finish(way);
+        }
+    }
+
+    /// Adds streets that start in this tile and head into the tile to
+    /// the east or the one to the south (if they exist). A street never
+    /// reaches both, since a feature may live in at most two tiles of
+    /// the same zoom level.
+    void addMultiTileStreets(int count, bool hasEast, bool hasSouth)
+    {
+        int32_t half = static_cast<int32_t>(extent_ / 2);
+        int32_t full = static_cast<int32_t>(extent_);
+        for (int i = 0; i < count; i++)
+        {
+            bool east = hasEast && (!hasSouth || random_.chance(0.5));
+            bool south = hasSouth && !east;
+            Box start(interior_.minX() + (east ? half : 0), interior_.minY(),
+                interior_.maxX(), interior_.maxY() - (south ? half : 0));
+            Box reach(interior_.minX(), interior_.minY() - (south ? full : 0),
+                interior_.maxX() + (east ? full : 0), interior_.maxY());
+            int length = random_.range(std::max(settings_.minStreetLength, 10),
+                std::max(settings_.maxStreetLength, 10));
+            SynthFeature& way = addFeature(FeatureType::WAY);
+            way.coords = walk(randomPoint(start), length,
+                extent_ / 40, reach, east, south);
+            tagStreet(way);
+            finish(way);
+        }
+    }
+
+    void addBuildings(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            SynthFeature& area = addFeature(FeatureType::WAY);
+            area.flags |= FeatureFlags::AREA;
+            // A slightly rotated rectangle
+            int32_t w = random_.range(static_cast<int>(extent_ / 4000),
+                static_cast<int>(extent_ / 600));
+            int32_t h = random_.range(static_cast<int>(extent_ / 4000),
+                static_cast<int>(extent_ / 600));
+            int32_t skew = random_.range(-w / 4, w / 4);
+            int32_t skewH = static_cast<int32_t>(static_cast<int64_t>(skew) * h / w);
+            Coordinate p = randomPoint(Box(interior_.minX(), interior_.minY(),
+                interior_.maxX() - 2 * w, interior_.maxY() - 2 * h));
+            area.coords =
+            {
+                p,
+                Coordinate(p.x + w, p.y + skew),
+                Coordinate(p.x + w - skewH, p.y + skew + h),
+                Coordinate(p.x - skewH, p.y + h)
+            };
+            addChoice(area, vocab_.building);
+            if (optional()) addNumber(area, vocab_.levels, random_.range(1, 8));
+            if (optional())
+            {
+                std::string number = std::to_string(random_.range(1, 150));
+                if (random_.chance(0.1)) number += static_cast<char>('a' + random_.range(0, 3));
+                addLocal(area, vocab_.housenumber, std::move(number));
+            }
+            finish(area);
+        }
+    }
+
+    void addMultipolygons(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int memberCount = random_.range(settings_.minRelationMembers,
+                settings_.maxRelationMembers);
+            int innerCount = std::min(memberCount - 1, random_.range(0, 2));
+            int outerCount = memberCount - innerCount;
+
+            int kind = random_.skewed(3);
+            int64_t radius = kind == 2 ?
+                random_.range(static_cast<int>(extent_ / 8), static_cast<int>(extent_ / 5)) :
+                random_.range(static_cast<int>(extent_ / 60), static_cast<int>(extent_ / 15));
+            Box centers(interior_.minX() + static_cast<int32_t>(radius),
+                interior_.minY() + static_cast<int32_t>(radius),
+                interior_.maxX() - static_cast<int32_t>(radius),
+                interior_.maxY() - static_cast<int32_t>(radius));
+            Coordinate center = randomPoint(centers);
+
+            uint32_t rel = addRelation();
+            std::vector<Coordinate> outer = ring(center, radius, outerCount * 8, 0.8);
+            for (int m = 0; m < outerCount; m++)
+            {
+                auto first = outer.begin() + m * 8;
+                std::vector<Coordinate> coords(first, first + 8);
+                coords.push_back(outer[((m + 1) * 8) % outer.size()]);
+                addMember(rel, std::move(coords), OUTER);
+            }
+            for (int m = 0; m < innerCount; m++)
+            {
+                int64_t offset = (m == 0 ? 2 : -2) * radius / 5;
+                Coordinate innerCenter(static_cast<int32_t>(center.x + offset), center.y);
+                std::vector<Coordinate> coords = ring(innerCenter, radius * 3 / 20, 8, 1.0);
+                coords.push_back(coords.front());
+                addMember(rel, std::move(coords), INNER);
+            }
+
+            SynthFeature& relation = features_[rel];
+            relation.flags |= FeatureFlags::AREA;
+            addString(relation, vocab_.type.key, vocab_.type.values[0]);
+            if (kind == 2)
+            {
+                addString(relation, vocab_.boundary.key, vocab_.boundary.values[0]);
+                addNumber(relation, vocab_.adminLevel, 2 + 2 * random_.range(0, 3));
+                addLocal(relation, vocab_.name, placeName());
+            }
+            else
+            {
+                addChoice(relation, kind == 0 ? vocab_.landuse : vocab_.natural);
+                if (optional()) addLocal(relation, vocab_.name, placeName());
+            }
+            finish(relation);
+        }
+    }
+
+    void addRoutes(int count)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int memberCount = random_.range(settings_.minRelationMembers,
+                settings_.maxRelationMembers);
+            int wayCount = std::max(1, memberCount * 2 / 3);
+            int stopCount = memberCount - wayCount;
+
+            uint32_t rel = addRelation();
+            Coordinate c = randomPoint(interior_);
+            std::vector<uint32_t> ways;
+            for (int m = 0; m < wayCount; m++)
+            {
+                std::vector<Coordinate> coords = walk(c,
+                    random_.range(3, 10), extent_ / 400, interior_, false, false);
+                c = coords.back();
+                ways.push_back(addMember(rel, std::move(coords), 0));
+            }
+            for (uint32_t way : ways)
+            {
+                // Members are finished untagged, so their tags must be
+                // sorted and their index bits set once more
+                tagStreet(features_[way]);
+                finish(features_[way]);
+            }
+            for (int m = 0; m < stopCount; m++)
+            {
+                // Stops are placed on the route's ways
+                const SynthFeature& way = features_[ways[random_.next() % ways.size()]];
+                Coordinate location = way.coords[random_.next() % way.coords.size()];
+                uint32_t stop = static_cast<uint32_t>(features_.size());
+                SynthFeature& node = addFeature(FeatureType::NODE);
+                node.coords.push_back(location);
+                addString(node, vocab_.nodeHighway.key, vocab_.nodeHighway.values[3]);
+                addLocal(node, vocab_.name, poiName());
+                finish(node);
+                linkMember(rel, stop, vocab_.stop);
+            }
+
+            SynthFeature& relation = features_[rel];
+            addString(relation, vocab_.type.key, vocab_.type.values[1]);
+            addChoice(relation, vocab_.route);
+            if (optional()) addLocal(relation, vocab_.name, streetName());
+            finish(relation);
+        }
+    }
+
+private:
+    static constexpr uint16_t OUTER = 3;
+    static constexpr uint16_t INNER = 4;
+
+    SynthFeature& addFeature(FeatureType type)
+    {
+        SynthFeature& f = features_.emplace_back();
+        f.type = type;
+        f.id = nextId_++;
+        return f;
+    }
+
+    uint32_t addRelation()
+    {
+        uint32_t index = static_cast<uint32_t>(features_.size());
+        addFeature(FeatureType::RELATION);
+        return index;
+    }
+
+    /// Adds an untagged way as a member of the given relation
+    uint32_t addMember(uint32_t rel, std::vector<Coordinate> coords, uint16_t role)
+    {
+        uint32_t index = static_cast<uint32_t>(features_.size());
+        SynthFeature& way = addFeature(FeatureType::WAY);
+        way.coords = std::move(coords);
+        finish(way);
+        linkMember(rel, index, role);
+        return index;
+    }
+
+    void linkMember(uint32_t rel, uint32_t member, uint16_t role)
+    {
+        features_[rel].members.push_back({ member, role, {}, {} });
+        features_[member].parents.push_back(rel);
+    }
+
+    /// Sorts the tags and calculates the bounding box (for relations,
+    /// that of their members) and index bits
+    void finish(SynthFeature& f)
+    {
+        std::sort(f.tags.begin(), f.tags.end(),
+            [](const Tag& a, const Tag& b) { return a.key < b.key; });
+        for (const Tag& tag : f.tags) f.indexBits |= vocab_.indexBits(tag.key);
+        for (Coordinate c : f.coords) f.bounds.expandToInclude(c);
+        for (const Member& m : f.members)
+        {
+            f.bounds.expandToIncludeSimple(features_[m.feature].bounds);
+        }
+    }
+
+    void tagStreet(SynthFeature& way)
+    {
+        uint16_t value = addChoice(way, vocab_.highway);
+        bool isRoad = value != vocab_.highway.values[2] &&     // footway
+            value != vocab_.highway.values[7] &&                // path
+            value != vocab_.highway.values[9];                  // cycleway
+        if (optional()) addLocal(way, vocab_.name, streetName());
+        if (optional()) addChoice(way, vocab_.surface);
+        if (isRoad)
+        {
+            if (optional()) addNumber(way, vocab_.maxspeed, 10 * random_.range(2, 13));
+            if (optional()) addNumber(way, vocab_.lanes, random_.range(1, 4));
+            if (random_.chance(0.1)) addString(way, vocab_.oneway, vocab_.yes);
+        }
+    }
+
+    bool optional() { return random_.chance(settings_.optionalTagShare); }
+
+    uint16_t addChoice(SynthFeature& f, const Vocabulary::Choice& choice)
+    {
+        return addChoice(f, choice, random_.skewed(static_cast<int>(choice.values.size())));
+    }
+
+    uint16_t addChoice(SynthFeature& f, const Vocabulary::Choice& choice, int n)
+    {
+        addString(f, choice.key, choice.values[n]);
+        return choice.values[n];
+    }
+
+    static void addString(SynthFeature& f, uint16_t key, uint16_t value)
+    {
+        f.tags.push_back({ key, TagValueType::GLOBAL_STRING, 0, value, {}, {} });
+    }
+
+    static void addNumber(SynthFeature& f, uint16_t key, int value)
+    {
+        f.tags.push_back({ key, static_cast<uint8_t>(
+            value <= TagValues::MAX_NARROW_NUMBER ?
+                TagValueType::NARROW_NUMBER : TagValueType::WIDE_NUMBER),
+            0, static_cast<uint32_t>(value), {}, {} });
+    }
+
+    static void addLocal(SynthFeature& f, uint16_t key, std::string value)
+    {
+        f.tags.push_back({ key, TagValueType::LOCAL_STRING, 0, 0, std::move(value), {} });
+    }
+
+    std::string streetName()
+    {
+        return std::string(random_.pick(NAME_STEMS)) + random_.pick(STREET_SUFFIXES);
+    }
+
+    std::string placeName()
+    {
+        return std::string(random_.pick(NAME_STEMS)) + random_.pick(PLACE_SUFFIXES);
+    }
+
+    std::string poiName()
+    {
+        return std::string(random_.pick(NAME_STEMS)) + random_.pick(POI_SUFFIXES);
+    }
+
+    Coordinate randomPoint(const Box& area)
+    {
+        return Coordinate(
+            static_cast<int32_t>(area.minX() + static_cast<int64_t>(random_.next() %
+                (static_cast<uint64_t>(static_cast<int64_t>(area.maxX()) - area.minX()) + 1))),
+            static_cast<int32_t>(area.minY() + static_cast<int64_t>(random_.next() %
+                (static_cast<uint64_t>(static_cast<int64_t>(area.maxY()) - area.minY()) + 1))));
+    }
+
+    /// A random walk of the given number of vertices that stays within
+    /// `area`; with `east` or `south`, it keeps heading that way
+    std::vector<Coordinate> walk(Coordinate start, int count, int64_t step,
+        const Box& area, bool east, bool south)
+    {
+        std::vector<Coordinate> coords;
+        coords.push_back(start);
+        int64_t dx = east ? step : random_.range(-static_cast<int>(step), static_cast<int>(step));
+        int64_t dy = south ? -step : random_.range(-static_cast<int>(step), static_cast<int>(step));
+        int64_t x = start.x;
+        int64_t y = start.y;
+        while (static_cast<int>(coords.size()) < count)
+        {
+            // Keep most of the previous heading, so streets don't zigzag
+            int jitter = static_cast<int>(step / 2);
+            dx = std::clamp<int64_t>(dx + random_.range(-jitter, jitter), -step, step);
+            dy = std::clamp<int64_t>(dy + random_.range(-jitter, jitter), -step, step);
+            if (east) dx = std::max<int64_t>(dx, step / 4);
+            if (south) dy = std::min<int64_t>(dy, -step / 4);
+            int64_t nextX = std::clamp<int64_t>(x + dx, area.minX(), area.maxX());
+            int64_t nextY = std::clamp<int64_t>(y + dy, area.minY(), area.maxY());
+            if (nextX == x && nextY == y)
+            {
+                // Stuck in a corner of the area
+                if (coords.size() >= 2) break;
+                nextX = x == area.minX() ? x + 1 : x - 1;
+            }
+            x = nextX;
+            y = nextY;
+            coords.emplace_back(static_cast<int32_t>(x), static_cast<int32_t>(y));
+        }
+        return coords;
+    }
+
+    /// A ring of the given number of vertices (without the closing
+    /// vertex) in counter-clockwise order, whose distance from the
+    /// center varies between `radius * minFactor` and `radius`
+    std::vector<Coordinate> ring(Coordinate center, int64_t radius,
+        int vertexCount, double minFactor)
+    {
+        std::vector<Coordinate> coords;
+        for (int i = 0; i < vertexCount; i++)
+        {
+            double angle = 2 * 3.141592653589793 * i / vertexCount;
+            double r = static_cast<double>(radius) *
+                (minFactor + (1 - minFactor) * random_.uniform());
+            coords.emplace_back(
+                static_cast<int32_t>(center.x + std::lround(r * std::cos(angle))),
+                static_cast<int32_t>(center.y + std::lround(r * std::sin(angle))));
+        }
+        return coords;
+    }
+
+    const GolGenerator::Settings& settings_;
+    const Vocabulary& vocab_;
+    Random random_;
+    uint64_t nextId_;
+    std::vector<SynthFeature>& features_;
+    int64_t extent_;
+    Box interior_;
+};
+
+} // namespace
+
+
+GolGenerator::Stats GolGenerator::generate(const char* golFile) const
+{
+    const Settings& s = settings_;
+    ZoomLevels zoomLevels(s.zoomLevels);
+    zoomLevels.check();
+    if (s.bounds.isEmpty()) throw ValueException("Bounds must not be empty");
+    if (s.nodesPerTile < 0 || s.streetsPerTile < 0 || s.buildingsPerTile < 0 ||
+        s.multipolygonsPerTile < 0 || s.routesPerTile < 0)
+    {
+        throw ValueException("Feature counts must not be negative");
+    }
+    if (s.minStreetLength < 2 || s.maxStreetLength < s.minStreetLength)
+    {
+        throw ValueException("Streets must have at least 2 vertices");
+    }
+    if (s.minRelationMembers < 2 || s.maxRelationMembers < s.minRelationMembers ||
+        s.maxRelationMembers > 256)
+    {
+        throw ValueException("Relations must have between 2 and 256 members");
+    }
+
+    std::vector<int> zooms;
+    ZoomLevels::Iterator iter = zoomLevels.iter();
+    for (int zoom = iter.next(); zoom >= 0; zoom = iter.next()) zooms.push_back(zoom);
+    int leafZoom = zooms.back();
+
+    int left = Tile::columnFromXZ(s.bounds.minX(), leafZoom);
+    int right = Tile::columnFromXZ(s.bounds.maxX(), leafZoom);
+    int top = Tile::rowFromYZ(s.bounds.maxY(), leafZoom);
+    int bottom = Tile::rowFromYZ(s.bounds.minY(), leafZoom);
+    int columns = right - left + 1;
+    int rows = bottom - top + 1;
+    if (static_cast<int64_t>(columns) * rows > 65536)
+    {
+        throw ValueException("Bounds cover too many tiles");
+    }
+
+    // Build the tile pyramid: every leaf tile, and all of its ancestors
+    // at the other zoom levels
+
+    TilePyramid pyramid(zoomLevels);
+    for (int row = top; row <= bottom; row++)
+    {
+        for (int col = left; col <= right; col++)
+        {
+            pyramid.add(Tile::fromColumnRowZoom(col, row, leafZoom));
+        }
+    }
+    pyramid.layout();
+
+    // Generate and write the tiles, in the order of the tile index
+
+    Vocabulary vocab;
+    GolWriter writer(golFile, pyramid, vocab.strings(), vocab.indexSchema());
+
+    Stats stats;
+    uint64_t contentHash = 0xCBF2'9CE4'8422'2325ULL;      // FNV-1a of the tiles
+    int multiTileCount = static_cast<int>(std::lround(s.streetsPerTile * s.multiTileShare));
+    int regularStreetCount = s.streetsPerTile - multiTileCount;
+    auto ordinalOf = [left, top, columns](int col, int row)
+    {
+        return static_cast<uint64_t>(row - top) * columns + (col - left);
+    };
+    auto multiTileStreets = [&](int col, int row, std::vector<SynthFeature>& features)
+    {
+        uint64_t ordinal = ordinalOf(col, row);
+        FeatureFactory factory(s, vocab, Tile::fromColumnRowZoom(col, row, leafZoom),
+            deriveSeed(s.seed, ordinal, 1), ((ordinal + 1) << 24) | 0x80'0000, features);
+        factory.addMultiTileStreets(multiTileCount, col < right, row < bottom);
+    };
+
+    for (Tile tile : pyramid.tiles())
+    {
+        std::vector<SynthFeature> features;
+        if (tile.zoom() == leafZoom)
+        {
+            int col = tile.column();
+            int row = tile.row();
+            uint64_t ordinal = ordinalOf(col, row);
+            FeatureFactory factory(s, vocab, tile, deriveSeed(s.seed, ordinal, 0),
+                (ordinal + 1) << 24, features);
+            factory.addNodes(s.nodesPerTile);
+            factory.addStreets(regularStreetCount);
+            factory.addBuildings(s.buildingsPerTile);
+            factory.addMultipolygons(s.multipolygonsPerTile);
+            factory.addRoutes(s.routesPerTile);
+
+            for (const SynthFeature& f : features)
+            {
+                switch (f.indexType())
+                {
+                case FeatureIndexType::NODES: stats.nodes++; break;
+                case FeatureIndexType::WAYS: stats.ways++; break;
+                case FeatureIndexType::AREAS: stats.areas++; break;
+                case FeatureIndexType::RELATIONS: stats.relations++; break;
+                }
+            }
+
+            // Add the multi-tile streets of this tile, and those of the
+            // tiles to the west and north that reach into it
+            Box bounds = tile.bounds();
+            for (int neighbor = 0; neighbor < 3; neighbor++)
+            {
+                int ownerCol = col - (neighbor == 1);
+                int ownerRow = row - (neighbor == 2);
+                if (ownerCol < left || ownerRow < top) continue;
+                std::vector<SynthFeature> streets;
+                multiTileStreets(ownerCol, ownerRow, streets);
+                for (SynthFeature& street : streets)
+                {
+                    if (neighbor == 0)
+                    {
+                        stats.ways++;
+                        if (!bounds.containsSimple(street.bounds)) stats.multiTileWays++;
+                    }
+                    if (!street.bounds.intersects(bounds)) continue;
+                    if (street.bounds.minX() < bounds.minX())
+                    {
+                        street.flags |= FeatureFlags::MULTITILE_WEST;
+                    }
+                    if (street.bounds.maxY() > bounds.maxY())
+                    {
+                        street.flags |= FeatureFlags::MULTITILE_NORTH;
+                    }
+                    features.push_back(std::move(street));
+                }
+            }
+        }
+
+        std::vector<uint8_t> blob = TileEncoder(features).encode();
+        for (uint8_t b : blob) contentHash = (contentHash ^ b) * 0x100'0000'01B3ULL;
+        writer.writeTile(pyramid.tipOf(tile), blob);
+        stats.tiles++;
+    }
+
+    // Stands in for the creation time, which identifies the GOL to its
+    // sidecar files (such as the string index)
+    stats.fileSize = writer.finish(contentHash >> 20);
+    return stats;
+}
+
+} // namespace geodesk
@@ -0,0 +1,128 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/update/ChangedTiles.h>
+#include <algorithm>
+#include <unordered_map>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/IdIndex.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+namespace {
+
+class ChangeScope
+{
+public:
+    ChangeScope(FeatureStore* store, const OsmChange& change) :
+        store_(store),
+        ids_(store->idIndex())
+    {
+        // New and moved nodes of the change, so we can locate the
+        // ways and relations that refer to them
+        for (const OsmChange::Element& e : change.elements())
+        {
+            if (e.type == FeatureType::NODE && e.action != OsmChange::Action::DELETE)
+            {
+                changedNodes_[e.id] = e.xy;
+            }
+        }
+    }
+
+    void addElement(const OsmChange::Element& e)
+    {
+        // The feature as it is now
+        FeaturePtr old = ids_.get(TypedFeatureId::ofTypeAndId(e.type, e.id));
+        if (!old.isNull())
+        {
+            Feature feature(store_, old);
+            add(feature.bounds());
+            for (Feature parent : feature.parents()) add(parent.bounds());
+            if (feature.isRelation())
+            {
+                for (Feature member : feature.members()) add(member.bounds());
+            }
+        }
+
+        // The feature as it will be
+        if (e.action == OsmChange::Action::DELETE) return;
+        switch (e.type)
+        {
+        case FeatureType::NODE:
+            add(Box(e.xy));
+            break;
+        case FeatureType::WAY:
+            for (uint64_t nodeId : e.nodeIds) addNode(nodeId);
+            break;
+        case FeatureType::RELATION:
+            for (const OsmChange::Member& member : e.members)
+            {
+                if (member.type == FeatureType::NODE)
+                {
+                    addNode(member.id);
+                }
+                else
+                {
+                    addExisting(TypedFeatureId::ofTypeAndId(member.type, member.id));
+                }
+            }
+            break;
+        }
+    }
+
+    std::vector<Tip> tiles()
+    {
+        std::vector<Tip> tips;
+        for (const Box& box : boxes_)
+        {
+            TileIndexWalker walker(store_->tileIndex(), store_->zoomLevels(), box, nullptr);
+            while (walker.next()) tips.push_back(walker.currentTip());
+        }
+        std::sort(tips.begin(), tips.end());
+        tips.erase(std::unique(tips.begin(), tips.end()), tips.end());
+        return tips;
+    }
+
+private:
+    void add(const Box& box)
+    {
+        if (!box.isEmpty()) boxes_.push_back(box);
+    }
+
+    void addNode(uint64_t id)
+    {
+        auto it = changedNodes_.find(id);
+        if (it != changedNodes_.end())
+        {
+            add(Box(it->second));
+            return;
+        }
+        // Anonymous nodes aren't indexed; their location is covered
+        // by the bounds of their (old) ways
+        addExisting(TypedFeatureId::ofNode(id));
+    }
+
+    void addExisting(TypedFeatureId id)
+    {
+        FeaturePtr feature = ids_.get(id);
+        if (!feature.isNull()) add(Feature(store_, feature).bounds());
+    }
+
+    FeatureStore* store_;
+    const IdIndex& ids_;
+    std::unordered_map<uint64_t, Coordinate> changedNodes_;
+    std::vector<Box> boxes_;
+};
+
+} // namespace
+
+
+std::vector<Tip> ChangedTiles::find(FeatureStore* store, const OsmChange& change)
+{
+    ChangeScope scope(store, change);
+    for (const OsmChange::Element& e : change.elements()) scope.addElement(e);
+    return scope.tiles();
+}
+
+} // namespace geodesk
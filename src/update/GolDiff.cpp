@@ -0,0 +1,267 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/update/GolDiff.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/TileCompression.h>
+#include <geodesk/feature/TileFeatureWalker.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/query/TileIndexWalker.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+namespace {
+
+/// A feature in one of the versions, along with a hash of its
+/// contents (see Scanner::fingerprint())
+struct Entry
+{
+    uint64_t typedId;
+    uint64_t hash;
+
+    bool operator<(const Entry& other) const
+    {
+        return typedId < other.typedId;
+    }
+};
+
+/// A tile in the old and/or new version (a null TIP if it doesn't
+/// exist in that version)
+struct TilePair
+{
+    Tip oldTip;
+    Tip newTip;
+};
+
+struct Batch
+{
+    std::vector<Entry> oldFeatures;
+    std::vector<Entry> newFeatures;
+    uint32_t unchangedTiles = 0;
+};
+
+/// Returns true if the stored blobs of both tiles are identical
+/// (compressed tiles are compared as they are stored)
+bool isSameBlob(DataPtr pOld, DataPtr pNew)
+{
+    uint32_t header = pOld.getUnsignedInt();
+    if (header != pNew.getUnsignedInt()) return false;
+    size_t size = (header & TileCompression::PAYLOAD_SIZE_MASK) + 4;
+    return memcmp(pOld.ptr(), pNew.ptr(), size) == 0;
+}
+
+/// Takes the fingerprints of the features whose primary copy lives
+/// in a tile.
+class Scanner
+{
+public:
+    void scan(FeatureStore* store, Tip tip, std::vector<Entry>& features)
+    {
+        store_ = store;
+        features_ = &features;
+        TileFeatureWalker::forEachFirstCopy(store->fetchTile(tip),
+            [this](FeaturePtr pFeature, FeatureIndexType)
+            {
+                features_->push_back({ pFeature.typedId(), fingerprint(pFeature) });
+            });
+    }
+
+private:
+    /// Hashes the parts of a feature that don't depend on the layout
+    /// of its GOL: its tags (sorted by key, since the order of keys
+    /// depends on the global strings), its coordinates (nodes and ways)
+    /// or the IDs and roles of its members (relations).
+    uint64_t fingerprint(FeaturePtr ptr)
+    {
+        Feature feature(store_, ptr);
+        buf_.clear();
+        tags_.clear();
+        for (Tag tag : feature.tags())
+        {
+            tags_.emplace_back(std::string(tag.key()), std::string(tag.value()));
+        }
+        std::sort(tags_.begin(), tags_.end());
+        for (const auto& [k, v] : tags_)
+        {
+            putString(k);
+            putString(v);
+        }
+
+        if (feature.isNode())
+        {
+            put(feature.xy());
+        }
+        else if (feature.isWay())
+        {
+            put(static_cast<uint8_t>(feature.isArea()));
+            WayCoordinateIterator iter((WayPtr(ptr)));
+            Coordinate coords[64];
+            for (;;)
+            {
+                int count = iter.decode(coords, 64);
+                if (count == 0) break;
+                buf_.append(reinterpret_cast<const char*>(coords), count * sizeof(Coordinate));
+            }
+        }
+        else
+        {
+            for (Feature member : feature.members())
+            {
+                put(static_cast<uint8_t>(member.type()));
+                put(member.id());
+                putString(std::string_view(member.role()));
+            }
+        }
+        return std::hash<std::string_view>()(buf_);
+    }
+
+    template<typename V>
+    void put(const V& v)
+    {
+        buf_.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+
+    void putString(std::string_view s)
+    {
+        put(static_cast<uint32_t>(s.size()));
+        buf_.append(s);
+    }
+
+    FeatureStore* store_ = nullptr;
+    std::vector<Entry>* features_ = nullptr;
+    std::string buf_;
+    std::vector<std::pair<std::string, std::string>> tags_;
+};
+
+/// Merges the entries of all batches and sorts them by typed ID
+std::vector<Entry> merge(std::vector<Batch>& batches, std::vector<Entry> Batch::*features)
+{
+    std::vector<Entry> merged;
+    for (Batch& batch : batches)
+    {
+        std::vector<Entry>& entries = batch.*features;
+        merged.insert(merged.end(), entries.begin(), entries.end());
+        entries = std::vector<Entry>();
+    }
+    std::sort(merged.begin(), merged.end());
+    return merged;
+}
+
+} // namespace
+
+
+/**
+ * Pairs up the tiles of both versions by their position in the tile
+ * pyramid. Each thread then claims the next pair in turn; a pair whose
+ * blobs are identical is skipped, otherwise the fingerprints of the
+ * features in both tiles are collected into a batch of the thread's
+ * own. Finally, the fingerprints of each version are merged, sorted
+ * and compared.
+ */
+GolDiff::Result GolDiff::compare(FeatureStore* oldStore, FeatureStore* newStore, int threads)
+{
+    std::vector<TilePair> tiles;
+    std::unordered_map<Tile, size_t> tileSlots;
+    TileIndexWalker oldWalker(oldStore->tileIndex(), oldStore->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (oldWalker.next())
+    {
+        tileSlots[oldWalker.currentTile()] = tiles.size();
+        tiles.push_back({ oldWalker.currentTip(), Tip() });
+    }
+    TileIndexWalker newWalker(newStore->tileIndex(), newStore->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (newWalker.next())
+    {
+        auto it = tileSlots.find(newWalker.currentTile());
+        if (it != tileSlots.end())
+        {
+            tiles[it->second].newTip = newWalker.currentTip();
+        }
+        else
+        {
+            tiles.push_back({ Tip(), newWalker.currentTip() });
+        }
+    }
+
+    if (threads <= 0) threads = newStore->executor().threadCount();
+    int threadCount = std::clamp(threads, 1, std::max(static_cast<int>(tiles.size()), 1));
+    std::vector<Batch> batches(threadCount);
+    std::atomic<size_t> nextTile(0);
+    auto scanAll = [oldStore, newStore, &tiles, &nextTile](Batch* batch)
+    {
+        Scanner scanner;
+        for (;;)
+        {
+            size_t n = nextTile.fetch_add(1, std::memory_order_relaxed);
+            if (n >= tiles.size()) return;
+            const TilePair& pair = tiles[n];
+            if (!pair.oldTip.isNull() && !pair.newTip.isNull() &&
+                isSameBlob(oldStore->mappedTile(pair.oldTip),
+                    newStore->mappedTile(pair.newTip)))
+            {
+                batch->unchangedTiles++;
+                continue;
+            }
+            if (!pair.oldTip.isNull())
+            {
+                scanner.scan(oldStore, pair.oldTip, batch->oldFeatures);
+            }
+            if (!pair.newTip.isNull())
+            {
+                scanner.scan(newStore, pair.newTip, batch->newFeatures);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.emplace_back(scanAll, &batches[i]);
+    }
+    scanAll(&batches[0]);
+    for (std::thread& worker : workers) worker.join();
+
+    Result result;
+    result.tiles = static_cast<uint32_t>(tiles.size());
+    for (const Batch& batch : batches) result.unchangedTiles += batch.unchangedTiles;
+    std::vector<Entry> oldFeatures = merge(batches, &Batch::oldFeatures);
+    std::vector<Entry> newFeatures = merge(batches, &Batch::newFeatures);
+
+    auto oldIt = oldFeatures.begin();
+    auto newIt = newFeatures.begin();
+    while (oldIt != oldFeatures.end() || newIt != newFeatures.end())
+    {
+        if (newIt == newFeatures.end() ||
+            (oldIt != oldFeatures.end() && oldIt->typedId < newIt->typedId))
+        {
+            result.deleted.emplace_back(oldIt->typedId);
+            ++oldIt;
+        }
+        else if (oldIt == oldFeatures.end() || newIt->typedId < oldIt->typedId)
+        {
+            result.created.emplace_back(newIt->typedId);
+            ++newIt;
+        }
+        else
+        {
+            if (oldIt->hash != newIt->hash) result.modified.emplace_back(newIt->typedId);
+            ++oldIt;
+            ++newIt;
+        }
+    }
+    return result;
+}
+
+} // namespace geodesk
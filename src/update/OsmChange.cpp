@@ -0,0 +1,334 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <geodesk/update/OsmChange.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <clarisma/io/File.h>
+#include <clarisma/util/Parser.h>
+
+namespace geodesk {
+
+using namespace clarisma;
+
+/// A minimal XML scanner, which only understands what appears in OSC
+/// files: elements with attributes (no text content, no CDATA),
+/// comments, processing instructions and the predefined entities.
+///
+class OsmChange::Parser
+{
+public:
+    explicit Parser(std::string_view xml) :
+        p_(xml.data()),
+        end_(xml.data() + xml.size()),
+        start_(xml.data())
+    {
+    }
+
+    void parse(std::vector<Element>& elements)
+    {
+        Action action = Action::MODIFY;
+        bool inAction = false;
+        Element* current = nullptr;
+        while (nextTag())
+        {
+            if (closing_)
+            {
+                if (name_ == "create" || name_ == "modify" || name_ == "delete")
+                {
+                    inAction = false;
+                }
+                else if (name_ == "node" || name_ == "way" || name_ == "relation")
+                {
+                    current = nullptr;
+                }
+                continue;
+            }
+            if (name_ == "create" || name_ == "modify" || name_ == "delete")
+            {
+                skipAttributes();
+                action = name_ == "create" ? Action::CREATE :
+                    (name_ == "modify" ? Action::MODIFY : Action::DELETE);
+                inAction = !selfClosing_;
+            }
+            else if (name_ == "node" || name_ == "way" || name_ == "relation")
+            {
+                if (!inAction) error("Element outside of <create>, <modify> or <delete>");
+                Element& e = elements.emplace_back();
+                e.action = action;
+                e.type = typeOf(name_);
+                e.id = 0;
+                bool hasId = false;
+                double lon = 0, lat = 0;
+                while (nextAttribute())
+                {
+                    if (attrName_ == "id")
+                    {
+                        e.id = parseId(attrValue_);
+                        hasId = true;
+                    }
+                    else if (attrName_ == "lon")
+                    {
+                        lon = parseDouble(attrValue_);
+                    }
+                    else if (attrName_ == "lat")
+                    {
+                        lat = parseDouble(attrValue_);
+                    }
+                }
+                if (!hasId) error("Missing id");
+                if (e.type == FeatureType::NODE && action != Action::DELETE)
+                {
+                    e.xy = Coordinate::ofLonLat(lon, lat);
+                }
+                current = selfClosing_ ? nullptr : &e;
+            }
+            else if (name_ == "tag")
+            {
+                if (!current) error("<tag> outside of an element");
+                std::string key, value;
+                while (nextAttribute())
+                {
+                    if (attrName_ == "k") key = decode(attrValue_);
+                    else if (attrName_ == "v") value = decode(attrValue_);
+                }
+                current->tags.emplace_back(std::move(key), std::move(value));
+            }
+            else if (name_ == "nd")
+            {
+                if (!current || current->type != FeatureType::WAY)
+                {
+                    error("<nd> outside of a way");
+                }
+                while (nextAttribute())
+                {
+                    if (attrName_ == "ref") current->nodeIds.push_back(parseId(attrValue_));
+                }
+            }
+            else if (name_ == "member")
+            {
+                if (!current || current->type != FeatureType::RELATION)
+                {
+                    error("<member> outside of a relation");
+                }
+                Member& m = current->members.emplace_back();
+                m.type = FeatureType::NODE;
+                m.id = 0;
+                while (nextAttribute())
+                {
+                    if (attrName_ == "type") m.type = typeOf(attrValue_);
+                    else if (attrName_ == "ref") m.id = parseId(attrValue_);
+                    else if (attrName_ == "role") m.role = decode(attrValue_);
+                }
+            }
+            else
+            {
+                // Anything else (<osmChange>, <bounds>, ...) is ignored
+                skipAttributes();
+            }
+        }
+    }
+
+private:
+    /// Moves to the next start or end tag, and reads its name
+    bool nextTag()
+    {
+        for (;;)
+        {
+            p_ = static_cast<const char*>(memchr(p_, '<', end_ - p_));
+            if (!p_) return false;
+            p_++;
+            if (p_ < end_ && (*p_ == '?' || *p_ == '!'))
+            {
+                // Skip declarations, processing instructions and comments
+                const char* close = (end_ - p_ >= 3 && memcmp(p_, "!--", 3) == 0) ?
+                    std::search(p_, end_, "-->", "-->" + 3) :
+                    static_cast<const char*>(memchr(p_, '>', end_ - p_));
+                if (!close || close == end_) error("Unterminated markup");
+                p_ = close + 1;
+                continue;
+            }
+            closing_ = p_ < end_ && *p_ == '/';
+            if (closing_) p_++;
+            const char* nameStart = p_;
+            while (p_ < end_ && !isspace(static_cast<unsigned char>(*p_)) &&
+                *p_ != '>' && *p_ != '/')
+            {
+                p_++;
+            }
+            name_ = std::string_view(nameStart, p_ - nameStart);
+            selfClosing_ = false;
+            if (closing_) skipToTagEnd();
+            return true;
+        }
+    }
+
+    /// Reads the next attribute of the current start tag; returns
+    /// false (and moves past the tag) if there are no more
+    bool nextAttribute()
+    {
+        while (p_ < end_ && isspace(static_cast<unsigned char>(*p_))) p_++;
+        if (p_ >= end_) error("Unterminated tag");
+        if (*p_ == '/' || *p_ == '>')
+        {
+            skipToTagEnd();
+            return false;
+        }
+        const char* nameStart = p_;
+        while (p_ < end_ && *p_ != '=' && !isspace(static_cast<unsigned char>(*p_))) p_++;
+        attrName_ = std::string_view(nameStart, p_ - nameStart);
+        while (p_ < end_ && *p_ != '\"' && *p_ != '\'') p_++;
+        if (p_ >= end_) error("Expected attribute value");
+        char quote = *p_++;
+        const char* valueStart = p_;
+        p_ = static_cast<const char*>(memchr(p_, quote, end_ - p_));
+        if (!p_) error("Unterminated attribute value");
+        attrValue_ = std::string_view(valueStart, p_ - valueStart);
+        p_++;
+        return true;
+    }
+
+    void skipAttributes()
+    {
+        while (nextAttribute()) {}
+    }
+
+    void skipToTagEnd()
+    {
+        const char* close = static_cast<const char*>(memchr(p_, '>', end_ - p_));
+        if (!close) error("Unterminated tag");
+        selfClosing_ = close > p_ && close[-1] == '/';
+        p_ = close + 1;
+    }
+
+    FeatureType typeOf(std::string_view s)
+    {
+        if (s == "node") return FeatureType::NODE;
+        if (s == "way") return FeatureType::WAY;
+        if (s == "relation") return FeatureType::RELATION;
+        error("Invalid type");
+    }
+
+    uint64_t parseId(std::string_view s)
+    {
+        // Negative IDs (placeholders of unuploaded changes) are invalid
+        uint64_t id;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), id);
+        if (ec != std::errc() || ptr != s.data() + s.size()) error("Invalid ID");
+        return id;
+    }
+
+    double parseDouble(std::string_view s)
+    {
+        double d;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), d);
+        if (ec != std::errc() || ptr != s.data() + s.size()) error("Invalid coordinate");
+        return d;
+    }
+
+    static std::string decode(std::string_view s)
+    {
+        std::string result;
+        result.reserve(s.size());
+        size_t i = 0;
+        while (i < s.size())
+        {
+            char ch = s[i];
+            if (ch != '&')
+            {
+                result.push_back(ch);
+                i++;
+                continue;
+            }
+            size_t semi = s.find(';', i);
+            if (semi == std::string_view::npos)
+            {
+                result.push_back(ch);
+                i++;
+                continue;
+            }
+            std::string_view entity = s.substr(i + 1, semi - i - 1);
+            if (entity == "amp") result.push_back('&');
+            else if (entity == "lt") result.push_back('<');
+            else if (entity == "gt") result.push_back('>');
+            else if (entity == "quot") result.push_back('\"');
+            else if (entity == "apos") result.push_back('\'');
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                uint32_t cp = 0;
+                bool hex = entity[1] == 'x' || entity[1] == 'X';
+                std::string_view digits = entity.substr(hex ? 2 : 1);
+                std::from_chars(digits.data(), digits.data() + digits.size(), cp, hex ? 16 : 10);
+                appendUtf8(result, cp);
+            }
+            else
+            {
+                // Unknown entity: keep as-is
+                result.append(s.substr(i, semi - i + 1));
+            }
+            i = semi + 1;
+        }
+        return result;
+    }
+
+    static void appendUtf8(std::string& s, uint32_t cp)
+    {
+        if (cp < 0x80)
+        {
+            s.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800)
+        {
+            s.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            s.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else if (cp < 0x10000)
+        {
+            s.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            s.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            s.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            s.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            s.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            s.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            s.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    [[noreturn]] void error(const char* msg) const
+    {
+        const char* pos = p_ ? p_ : end_;
+        throw ParseException(std::string(msg) + " (at offset " +
+            std::to_string(pos - start_) + ")");
+    }
+
+    const char* p_;
+    const char* end_;
+    const char* start_;
+    std::string_view name_;
+    std::string_view attrName_;
+    std::string_view attrValue_;
+    bool closing_ = false;
+    bool selfClosing_ = false;
+};
+
+
+OsmChange OsmChange::parse(std::string_view xml)
+{
+    OsmChange change;
+    Parser(xml).parse(change.elements_);
+    return change;
+}
+
+
+OsmChange OsmChange::read(const char* fileName)
+{
+    ByteBlock data = File::readAll(fileName);
+    return parse(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+} // namespace geodesk
@@ -1,11 +1,19 @@
 // Copyright (c) 2024 Clarisma / GeoDesk contributors
 // SPDX-License-Identifier: LGPL-3.0-only
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <string_view>
 #include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/protobuf.h>
 #include <geodesk/geodesk.h>
+#include <geodesk/feature/TileReader.h>
+#include <geodesk/format/CsvWriter.h>
+#include <geodesk/format/FlatGeobufWriter.h>
+#include <geodesk/format/MvtGenerator.h>
+#include <geodesk/format/ParallelExport.h>
 
 using namespace geodesk;
 
@@ -140,4 +148,216 @@ TEST_CASE_METHOD(GolFixture, "Iterate tags of anonymous nodes")
 		<< highwayNodeCount << " highway nodes.";
 }
 
+TEST_CASE_METHOD(GolFixture, "Locate areas of many points at once")
+{
+	Features areas = monaco("a");
+	std::vector<Coordinate> points;
+	for (int i = 0; i < 1000; i++)
+	{
+		points.push_back(Coordinate::ofLonLat(
+			7.40 + 0.05 * (i % 40) / 40, 43.71 + 0.05 * (i / 40) / 25));
+	}
+	std::vector<std::vector<Feature>> found(points.size());
+	areas.forEachContainingArea(points, [&found](size_t i, Feature area)
+	{
+		found[i].push_back(area);
+	});
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		std::vector<Feature> expected = areas.containing(points[i]);
+		REQUIRE(found[i].size() == expected.size());
+		for (Feature area : expected)
+		{
+			REQUIRE(std::find(found[i].begin(), found[i].end(), area) != found[i].end());
+		}
+	}
+}
+
+TEST_CASE_METHOD(GolFixture, "Generate a vector tile")
+{
+	Coordinate center = Coordinate::ofLonLat(7.4215, 43.7317);
+	Tile tile = Tile::fromColumnRowZoom(Tile::columnFromXZ(center.x, 14),
+		Tile::rowFromYZ(center.y, 14), 14);
+	MvtGenerator generator(monaco.store(),
+	{
+		{ "points", FeatureTypes::NODES },
+		{ "lines", FeatureTypes::NONAREA_WAYS },
+		{ "areas", FeatureTypes::AREAS }
+	});
+	clarisma::DynamicBuffer buf(64 * 1024);
+	generator.generate(tile, &buf);
+	REQUIRE(!buf.isEmpty());
+
+	// Walk the layers and check that all references and coordinates
+	// are in range
+	using namespace clarisma;
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(buf.data());
+	const uint8_t* end = p + buf.length();
+	int layerCount = 0;
+	while (p < end)
+	{
+		REQUIRE(protobuf::readField(p) == protobuf::field(3, protobuf::STRING));
+		ByteSpan layer = protobuf::readMessage(p);
+		const uint8_t* q = layer.data();
+		uint32_t keyCount = 0;
+		uint32_t valueCount = 0;
+		uint32_t maxTagKey = 0;
+		uint32_t maxTagValue = 0;
+		int featureCount = 0;
+		while (q < layer.data() + layer.size())
+		{
+			protobuf::Field field = protobuf::readField(q);
+			if (field == protobuf::field(2, protobuf::STRING))
+			{
+				ByteSpan feature = protobuf::readMessage(q);
+				const uint8_t* r = feature.data();
+				while (r < feature.data() + feature.size())
+				{
+					protobuf::Field featureField = protobuf::readField(r);
+					if (featureField == protobuf::field(2, protobuf::STRING))
+					{
+						ByteSpan tags = protobuf::readMessage(r);
+						const uint8_t* t = tags.data();
+						while (t < tags.data() + tags.size())
+						{
+							maxTagKey = std::max(maxTagKey, readVarint32(t) + 1);
+							maxTagValue = std::max(maxTagValue, readVarint32(t) + 1);
+						}
+					}
+					else if (featureField == protobuf::field(4, protobuf::STRING))
+					{
+						ByteSpan geom = protobuf::readMessage(r);
+						const uint8_t* g = geom.data();
+						int32_t x = 0;
+						int32_t y = 0;
+						while (g < geom.data() + geom.size())
+						{
+							uint32_t cmd = readVarint32(g);
+							uint32_t id = cmd & 7;
+							REQUIRE((id == 1 || id == 2 || id == 7));
+							if (id == 7) continue;
+							for (uint32_t i = 0; i < (cmd >> 3); i++)
+							{
+								x += fromZigzag(readVarint32(g));
+								y += fromZigzag(readVarint32(g));
+								REQUIRE(x >= -64);
+								REQUIRE(x <= 4096 + 64);
+								REQUIRE(y >= -64);
+								REQUIRE(y <= 4096 + 64);
+							}
+						}
+					}
+					else
+					{
+						protobuf::skipEntity(r, featureField);
+					}
+				}
+				featureCount++;
+			}
+			else if (field == protobuf::field(3, protobuf::STRING))
+			{
+				protobuf::readMessage(q);
+				keyCount++;
+			}
+			else if (field == protobuf::field(4, protobuf::STRING))
+			{
+				protobuf::readMessage(q);
+				valueCount++;
+			}
+			else
+			{
+				protobuf::skipEntity(q, field);
+			}
+		}
+		REQUIRE(featureCount > 0);
+		REQUIRE(maxTagKey <= keyCount);
+		REQUIRE(maxTagValue <= valueCount);
+		layerCount++;
+	}
+	REQUIRE(layerCount == 3);
+}
+
+TEST_CASE_METHOD(GolFixture, "Write FlatGeobuf")
+{
+	FlatGeobufWriter writer({ "name" });
+	writer.maxMemory(1);		// spill after every tile
+	clarisma::DynamicBuffer buf(64 * 1024);
+	writer.write(monaco.store(), Box::ofWorld(), FeatureTypes::ALL,
+		monaco.store()->borrowAllMatcher(), nullptr, &buf);
+	REQUIRE(writer.featureCount() == monaco.count());
+	REQUIRE(buf.length() > 12);
+	REQUIRE(std::string_view(buf.data(), 8) == std::string_view("fgb\x03fgb\0", 8));
+	uint32_t headerSize;
+	memcpy(&headerSize, buf.data() + 8, 4);
+	REQUIRE(12 + headerSize < buf.length());
+}
+
+TEST_CASE_METHOD(GolFixture, "Write CSV")
+{
+	std::vector<Key> keys = { monaco.key("name"), monaco.key("amenity") };
+	clarisma::DynamicBuffer buf(64 * 1024);
+	CsvWriter out(&buf, keys);
+	ParallelExport exporter(&out,
+		[&keys](clarisma::Buffer* b)
+		{
+			return std::make_unique<CsvWriter>(b, keys);
+		}, true);
+	exporter.run(monaco.store(), Box::ofWorld(), FeatureTypes::ALL,
+		monaco.store()->borrowAllMatcher(), nullptr);
+	REQUIRE(exporter.featureCount() == monaco.count());
+	std::string_view csv(buf.data(), buf.length());
+	REQUIRE(csv.starts_with("id,lon,lat,name,amenity\n"));
+	REQUIRE(static_cast<uint64_t>(std::count(csv.begin(), csv.end(), '\n')) == monaco.count() + 1);
+}
+
+TEST_CASE_METHOD(GolFixture, "Warm and evict tiles")
+{
+	FeatureStore* store = monaco.store();
+	uint64_t tileCount = store->warm(Box::ofWorld(), nullptr, QueryPriority::INTERACTIVE);
+	REQUIRE(tileCount > 0);
+	REQUIRE(store->warm(Box::ofWorld()) == tileCount);
+	REQUIRE(store->evict(Box::ofWorld()) == tileCount);
+	REQUIRE(monaco("na[amenity]").count() > 0);
+}
+
+TEST_CASE_METHOD(GolFixture, "Read tiles into a bounded cache")
+{
+	FeatureStore* store = monaco.store();
+	std::atomic<uint64_t> mappedCount = 0;
+	monaco.parallelForEach([&mappedCount](Feature) { mappedCount++; });
+
+	store->enableTileReader(1024 * 1024);
+	std::atomic<uint64_t> readCount = 0;
+	monaco.parallelForEach([&readCount](Feature) { readCount++; });
+	REQUIRE(readCount == mappedCount);
+	TileReader* reader = store->tileReader();
+	REQUIRE(reader->tilesRead() > 0);
+	REQUIRE(reader->bytesCached() <= reader->maxBytes());
+	store->enableTileReader(0);
+}
+
 // TODO: Test if parent relation iterator respect types
+
+TEST_CASE_METHOD(GolFixture, "Moved Features keep their query")
+{
+	Features restaurants = monaco("na[amenity=restaurant]");
+	uint64_t count = restaurants.count();
+	Features moved = std::move(restaurants);
+	REQUIRE(moved.count() == count);
+	Features assigned = monaco("w");
+	assigned = std::move(moved);
+	REQUIRE(assigned.count() == count);
+}
+
+TEST_CASE_METHOD(GolFixture, "Verify the structure of a store")
+{
+	FeatureStore* store = monaco.store();
+	FeatureStore::VerifyResult result = store->verify(4);
+	REQUIRE(result.isValid());
+	REQUIRE(result.tilesVerified > 0);
+
+	FeatureStore::VerifyResult partial = store->verify(2,
+		Box::ofWSEN(7.41, 43.72, 7.43, 43.74));
+	REQUIRE(partial.isValid());
+	REQUIRE(partial.tilesVerified <= result.tilesVerified);
+}
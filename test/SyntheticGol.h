@@ -0,0 +1,96 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <system_error>
+#include <geodesk/geodesk.h>
+#include <geodesk/synth/GolGenerator.h>
+
+namespace geodesk {
+
+/// A GOL generated by GolGenerator in the temporary directory. The file
+/// (and any sidecar files built next to it) is removed when this object
+/// is destroyed.
+///
+class SyntheticGol
+{
+public:
+    explicit SyntheticGol(const GolGenerator::Settings& settings) :
+        fileName_(uniqueFileName())
+    {
+        GolGenerator(settings).generate(fileName_.c_str());
+    }
+
+    ~SyntheticGol()
+    {
+        std::filesystem::path path(fileName_);
+        std::string prefix = path.filename().string() + ".";
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        for (const auto& entry : std::filesystem::directory_iterator(
+            path.parent_path(), error))
+        {
+            if (entry.path().filename().string().starts_with(prefix))
+            {
+                std::filesystem::remove(entry.path(), error);
+            }
+        }
+    }
+
+    SyntheticGol(const SyntheticGol&) = delete;
+    SyntheticGol& operator=(const SyntheticGol&) = delete;
+
+    const std::string& fileName() const { return fileName_; }
+
+    /// The settings shared by most tests (a 1° x 1° area around
+    /// Monaco, with the generator's default density)
+    static GolGenerator::Settings defaultSettings()
+    {
+        GolGenerator::Settings settings;
+        settings.bounds = Box::ofWSEN(7.0, 43.5, 8.0, 44.5);
+        return settings;
+    }
+
+private:
+    static std::string uniqueFileName()
+    {
+        static const unsigned run = std::random_device()();
+        static std::atomic<int> count(0);
+        std::string name = "geodesk-test-" + std::to_string(run) + "-" +
+            std::to_string(count++) + ".gol";
+        return (std::filesystem::temp_directory_path() / name).string();
+    }
+
+    std::string fileName_;
+};
+
+/// A fixture for TEST_CASE_METHOD that opens the world described by
+/// `settings()`. The world is generated only once (the first time a
+/// test needs it), and removed when the test program exits; every test
+/// opens it afresh.
+///
+template<GolGenerator::Settings (*settings)()>
+struct SyntheticGolFixture
+{
+    SyntheticGolFixture() :
+        fileName(gol().fileName()),
+        world(fileName.c_str())
+    {
+    }
+
+    static const SyntheticGol& gol()
+    {
+        static const SyntheticGol gol(settings());
+        return gol;
+    }
+
+    std::string fileName;
+    Features world;
+};
+
+} // namespace geodesk
@@ -0,0 +1,620 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/io/File.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/build/GolBuilder.h>
+
+using namespace geodesk;
+
+namespace {
+
+/// Just enough of a protobuf encoder to write an .osm.pbf file
+/// (with uncompressed blocks)
+class Message
+{
+public:
+    void varint(uint64_t v)
+    {
+        while (v >= 0x80)
+        {
+            buf_.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        buf_.push_back(static_cast<uint8_t>(v));
+    }
+
+    void field(int number, uint64_t v)
+    {
+        varint(static_cast<uint64_t>(number) << 3);
+        varint(v);
+    }
+
+    void field(int number, const std::string& s)
+    {
+        varint((static_cast<uint64_t>(number) << 3) | 2);
+        varint(s.size());
+        buf_.insert(buf_.end(), s.begin(), s.end());
+    }
+
+    void field(int number, const Message& m) { field(number, m.str()); }
+
+    /// A packed field of sint64 values, delta-encoded
+    void deltas(int number, const std::vector<int64_t>& values)
+    {
+        Message packed;
+        int64_t prev = 0;
+        for (int64_t v : values)
+        {
+            int64_t delta = v - prev;
+            packed.varint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+            prev = v;
+        }
+        field(number, packed);
+    }
+
+    void packed(int number, const std::vector<uint32_t>& values)
+    {
+        Message packed;
+        for (uint32_t v : values) packed.varint(v);
+        field(number, packed);
+    }
+
+    std::string str() const { return std::string(buf_.begin(), buf_.end()); }
+
+private:
+    std::vector<uint8_t> buf_;
+};
+
+struct OsmTag
+{
+    std::string key;
+    std::string value;
+};
+
+struct OsmNode
+{
+    uint64_t id;
+    int32_t lon;        // 100-nanodegree units
+    int32_t lat;
+    std::vector<OsmTag> tags;
+};
+
+struct OsmWay
+{
+    uint64_t id;
+    std::vector<uint64_t> nodes;
+    std::vector<OsmTag> tags;
+};
+
+struct OsmMember
+{
+    int type;           // 0 = node, 1 = way, 2 = relation
+    uint64_t id;
+    std::string role;
+};
+
+struct OsmRelation
+{
+    uint64_t id;
+    std::vector<OsmMember> members;
+    std::vector<OsmTag> tags;
+};
+
+/// Writes the nodes, ways and relations as blocks of at most
+/// `blockSize` elements each
+class PbfFile
+{
+public:
+    std::vector<OsmNode> nodes;
+    std::vector<OsmWay> ways;
+    std::vector<OsmRelation> relations;
+
+    void write(const std::string& fileName, size_t blockSize) const
+    {
+        std::string data;
+        Message header;
+        header.field(4, std::string("OsmSchema-V0.6"));
+        header.field(4, std::string("DenseNodes"));
+        appendBlock(data, "OSMHeader", header);
+        for (size_t i = 0; i < nodes.size(); i += blockSize)
+        {
+            appendBlock(data, "OSMData", nodeBlock(i, std::min(i + blockSize, nodes.size())));
+        }
+        for (size_t i = 0; i < ways.size(); i += blockSize)
+        {
+            appendBlock(data, "OSMData", wayBlock(i, std::min(i + blockSize, ways.size())));
+        }
+        for (size_t i = 0; i < relations.size(); i += blockSize)
+        {
+            appendBlock(data, "OSMData", relationBlock(i,
+                std::min(i + blockSize, relations.size())));
+        }
+        clarisma::File file;
+        file.open(fileName.c_str(), clarisma::File::OpenMode::WRITE |
+            clarisma::File::OpenMode::CREATE | clarisma::File::OpenMode::REPLACE_EXISTING);
+        file.write(data.data(), data.size());
+        file.setSize(data.size());
+    }
+
+private:
+    class StringTable
+    {
+    public:
+        StringTable() { strings_.push_back(""); }
+
+        uint32_t code(const std::string& s)
+        {
+            auto [it, isNew] = codes_.try_emplace(s, static_cast<uint32_t>(strings_.size()));
+            if (isNew) strings_.push_back(s);
+            return it->second;
+        }
+
+        Message message() const
+        {
+            Message m;
+            for (const std::string& s : strings_) m.field(1, s);
+            return m;
+        }
+
+    private:
+        std::vector<std::string> strings_;
+        std::unordered_map<std::string, uint32_t> codes_;
+    };
+
+    static Message block(const StringTable& strings, const Message& group)
+    {
+        Message m;
+        m.field(1, strings.message());
+        m.field(2, group);
+        return m;
+    }
+
+    Message nodeBlock(size_t start, size_t end) const
+    {
+        StringTable strings;
+        std::vector<int64_t> ids, lats, lons;
+        std::vector<uint32_t> keysVals;
+        for (size_t i = start; i < end; i++)
+        {
+            const OsmNode& node = nodes[i];
+            ids.push_back(static_cast<int64_t>(node.id));
+            lats.push_back(node.lat);
+            lons.push_back(node.lon);
+            for (const OsmTag& tag : node.tags)
+            {
+                keysVals.push_back(strings.code(tag.key));
+                keysVals.push_back(strings.code(tag.value));
+            }
+            keysVals.push_back(0);
+        }
+        Message dense;
+        dense.deltas(1, ids);
+        dense.deltas(8, lats);
+        dense.deltas(9, lons);
+        dense.packed(10, keysVals);
+        Message group;
+        group.field(2, dense);
+        return block(strings, group);
+    }
+
+    static void addTags(Message& m, StringTable& strings, const std::vector<OsmTag>& tags)
+    {
+        std::vector<uint32_t> keys, values;
+        for (const OsmTag& tag : tags)
+        {
+            keys.push_back(strings.code(tag.key));
+            values.push_back(strings.code(tag.value));
+        }
+        m.packed(2, keys);
+        m.packed(3, values);
+    }
+
+    Message wayBlock(size_t start, size_t end) const
+    {
+        StringTable strings;
+        Message group;
+        for (size_t i = start; i < end; i++)
+        {
+            Message way;
+            way.field(1, ways[i].id);
+            addTags(way, strings, ways[i].tags);
+            way.deltas(8, std::vector<int64_t>(ways[i].nodes.begin(), ways[i].nodes.end()));
+            group.field(3, way);
+        }
+        return block(strings, group);
+    }
+
+    Message relationBlock(size_t start, size_t end) const
+    {
+        StringTable strings;
+        Message group;
+        for (size_t i = start; i < end; i++)
+        {
+            Message rel;
+            rel.field(1, relations[i].id);
+            addTags(rel, strings, relations[i].tags);
+            std::vector<uint32_t> roles, types;
+            std::vector<int64_t> ids;
+            for (const OsmMember& m : relations[i].members)
+            {
+                roles.push_back(strings.code(m.role));
+                ids.push_back(static_cast<int64_t>(m.id));
+                types.push_back(static_cast<uint32_t>(m.type));
+            }
+            rel.packed(8, roles);
+            rel.deltas(9, ids);
+            rel.packed(10, types);
+            group.field(4, rel);
+        }
+        return block(strings, group);
+    }
+
+    static void appendBlock(std::string& data, const char* type, const Message& contents)
+    {
+        Message blob;
+        std::string raw = contents.str();
+        blob.field(1, raw);
+        blob.field(2, raw.size());
+        std::string blobData = blob.str();
+        Message header;
+        header.field(1, std::string(type));
+        header.field(3, blobData.size());
+        std::string headerData = header.str();
+        uint32_t size = static_cast<uint32_t>(headerData.size());
+        data.push_back(static_cast<char>(size >> 24));
+        data.push_back(static_cast<char>(size >> 16));
+        data.push_back(static_cast<char>(size >> 8));
+        data.push_back(static_cast<char>(size));
+        data += headerData;
+        data += blobData;
+    }
+};
+
+std::string tempFile(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+constexpr int GRID = 60;
+
+uint64_t gridNode(int col, int row)
+{
+    return static_cast<uint64_t>(row * GRID + col + 1);
+}
+
+/// A grid of nodes (some of them benches), a street along each row of
+/// the grid (whose widths have decimals), buildings, a multipolygon, a bus route and its route master,
+/// and features that refer to nodes or members that are missing
+PbfFile sampleData()
+{
+    PbfFile pbf;
+    for (int row = 0; row < GRID; row++)
+    {
+        for (int col = 0; col < GRID; col++)
+        {
+            OsmNode node{ gridNode(col, row), 130'000'000 + col * 66'000,
+                523'000'000 + row * 50'000, {} };
+            if (node.id % 7 == 0) node.tags.push_back({ "amenity", "bench" });
+            if (node.id % 50 == 0)
+            {
+                node.tags.push_back({ "name", "Node " + std::to_string(node.id) });
+                node.tags.push_back({ "ele", std::to_string(node.id) });
+            }
+            pbf.nodes.push_back(node);
+        }
+    }
+    pbf.nodes.push_back({ 5001, 131'000'000, 524'000'000, { { "rarekey", "rare value" } } });
+    pbf.nodes.push_back({ 5002, 132'000'000, 524'000'000, { { "place", "city" },
+        { "population", "1000000" } } });
+
+    for (int row = 0; row < GRID; row++)
+    {
+        OsmWay street{ 10'000 + static_cast<uint64_t>(row), {}, { { "highway", "residential" },
+            { "width", std::to_string(row / 10) + ".5" } } };
+        for (int col = 0; col < GRID; col++) street.nodes.push_back(gridNode(col, row));
+        pbf.ways.push_back(street);
+    }
+    for (int row = 0; row < GRID - 1; row += 3)
+    {
+        for (int col = 0; col < GRID - 1; col += 3)
+        {
+            pbf.ways.push_back({ 20'000 + gridNode(col, row),
+                { gridNode(col, row), gridNode(col + 1, row), gridNode(col + 1, row + 1),
+                  gridNode(col, row + 1), gridNode(col, row) },
+                { { "building", "yes" } } });
+        }
+    }
+    pbf.ways.push_back({ 30'000, { gridNode(5, 5), gridNode(6, 6) }, {} });
+    pbf.ways.push_back({ 30'001, { 999'999, 999'998 }, { { "highway", "path" } } });
+    pbf.ways.push_back({ 30'002, { gridNode(10, 10), gridNode(20, 10), gridNode(20, 20),
+        gridNode(10, 20), gridNode(10, 10) }, {} });
+
+    pbf.relations.push_back({ 40'000, { { 1, 30'002, "outer" } },
+        { { "type", "multipolygon" }, { "landuse", "forest" } } });
+    pbf.relations.push_back({ 40'001, { { 0, gridNode(0, 0), "stop" },
+        { 0, gridNode(0, 1), "stop" }, { 1, 10'000, "" }, { 1, 10'001, "" },
+        { 1, 30'000, "" } }, { { "type", "route" }, { "route", "bus" } } });
+    pbf.relations.push_back({ 40'002, { { 2, 40'001, "" } },
+        { { "type", "route_master" }, { "route_master", "bus" } } });
+    pbf.relations.push_back({ 40'003, { { 0, 9'999'999, "" } }, { { "type", "route" } } });
+    pbf.relations.push_back({ 40'004, { { 0, 9'999'999, "" }, { 0, gridNode(1, 0), "" } },
+        { { "type", "site" } } });
+    return pbf;
+}
+
+GolBuilder::Settings smallSettings()
+{
+    GolBuilder::Settings settings;
+    settings.threads = 4;
+    settings.minTileDensity = 200;
+    settings.minStringUsage = 20;
+    return settings;
+}
+
+Feature findFeature(Features features, uint64_t id)
+{
+    for (Feature f : features)
+    {
+        if (f.id() == id) return f;
+    }
+    FAIL("Feature not found");
+    return *features.begin();
+}
+
+} // namespace
+
+TEST_CASE("GolBuilder: features of an .osm.pbf can be queried")
+{
+    std::string pbfFile = tempFile("golbuilder_test.osm.pbf");
+    std::string golFile = tempFile("golbuilder_test.gol");
+    sampleData().write(pbfFile, 1000);
+    GolBuilder::Stats stats = GolBuilder(smallSettings()).build(pbfFile.c_str(), golFile.c_str());
+    REQUIRE(stats.tiles > 10);
+    {
+        Features world(golFile.c_str());
+        REQUIRE(world.store()->verify().isValid());
+
+        // Tagged nodes, and the untagged nodes that are members
+        int benches = 0;
+        for (uint64_t id = 1; id <= GRID * GRID; id++) benches += (id % 7) == 0;
+        REQUIRE(world("n[amenity=bench]").count() == benches);
+        REQUIRE(world("n[name]").count() == GRID * GRID / 50);
+        REQUIRE(world("n[ele=3550]").count() == 1);
+        REQUIRE(world("n[rarekey=\"rare value\"]").count() == 1);
+        REQUIRE(world("n[place=city][population=1000000]").count() == 1);
+        REQUIRE(world("n").count() == stats.nodes);
+
+        // Streets span many tiles, but are only found once; the way
+        // whose nodes are missing is omitted
+        std::unordered_set<uint64_t> streets;
+        for (Feature street : world("w[highway=residential]"))
+        {
+            REQUIRE(street.length() > 0);
+            streets.insert(street.id());
+        }
+        REQUIRE(streets.size() == GRID);
+        REQUIRE(world("w[highway=path]").count() == 0);
+        int buildings = 20 * 20;
+        REQUIRE(world("a[building]").count() == buildings);
+        REQUIRE(world("w").count() + buildings == stats.ways);
+
+        // The relation whose only member is missing is omitted
+        REQUIRE(stats.relations == 4);
+        REQUIRE(world("r").count() + world("a[type=multipolygon]").count() == 4);
+    }
+    clarisma::File::remove(golFile.c_str());
+    clarisma::File::remove(pbfFile.c_str());
+}
+
+TEST_CASE("GolBuilder: members and parents are linked across tiles")
+{
+    std::string pbfFile = tempFile("golbuilder_members_test.osm.pbf");
+    std::string golFile = tempFile("golbuilder_members_test.gol");
+    sampleData().write(pbfFile, 500);
+    GolBuilder(smallSettings()).build(pbfFile.c_str(), golFile.c_str());
+    {
+        Features world(golFile.c_str());
+        REQUIRE(world.store()->verify().isValid());
+
+        Feature route = findFeature(world("r[type=route]"), 40'001);
+        std::vector<uint64_t> memberIds;
+        for (Feature member : route.members())
+        {
+            REQUIRE(member.belongsToRelation());
+            REQUIRE(member.parents().relations().count() == 1);
+            memberIds.push_back(member.id());
+        }
+        std::vector<uint64_t> expected = { gridNode(0, 0), gridNode(0, 1),
+            10'000, 10'001, 30'000 };
+        REQUIRE(memberIds == expected);
+
+        Feature master = findFeature(world("r[type=route_master]"), 40'002);
+        REQUIRE(master.members().count() == 1);
+        REQUIRE((*master.members().begin()).id() == 40'001);
+        REQUIRE(route.parents().count() == 1);
+        REQUIRE(master.bounds().containsSimple(route.bounds()));
+
+        // The untagged outer way of the multipolygon is a feature, but not an area
+        Feature forest = findFeature(world("a[landuse=forest]"), 40'000);
+        REQUIRE(forest.area() > 0);
+        Feature outer = *forest.members().begin();
+        REQUIRE(outer.id() == 30'002);
+        REQUIRE(outer.isWay());
+        REQUIRE(!outer.isArea());
+
+        // Only the member that is present is kept
+        Feature site = findFeature(world("r[type=site]"), 40'004);
+        REQUIRE(site.members().count() == 1);
+    }
+    clarisma::File::remove(golFile.c_str());
+    clarisma::File::remove(pbfFile.c_str());
+}
+
+TEST_CASE("GolBuilder: ways list their feature nodes")
+{
+    std::string pbfFile = tempFile("golbuilder_waynodes_test.osm.pbf");
+    std::string golFile = tempFile("golbuilder_waynodes_test.gol");
+    PbfFile pbf = sampleData();
+    pbf.write(pbfFile, 700);
+    GolBuilder(smallSettings()).build(pbfFile.c_str(), golFile.c_str());
+    {
+        Features world(golFile.c_str());
+        REQUIRE(world.store()->verify().isValid());
+
+        // The nodes of each street, in order: the anonymous ones and
+        // the features (which may live in other tiles)
+        for (Feature street : world("w[highway=residential]"))
+        {
+            int row = static_cast<int>(street.id() - 10'000);
+            int col = 0;
+            for (Feature node : street.nodes())
+            {
+                uint64_t id = gridNode(col++, row);
+                bool isFeature = id % 7 == 0 || id % 50 == 0 ||
+                    id == gridNode(0, 0) || id == gridNode(0, 1) || id == gridNode(1, 0);
+                REQUIRE(node.isAnonymousNode() == !isFeature);
+                if (isFeature) REQUIRE(node.id() == id);
+            }
+            REQUIRE(col == GRID);
+            std::vector<uint64_t> benches;
+            for (Feature node : street.nodes("n[amenity=bench]")) benches.push_back(node.id());
+            std::vector<uint64_t> expected;
+            for (int c = 0; c < GRID; c++)
+            {
+                if (gridNode(c, row) % 7 == 0) expected.push_back(gridNode(c, row));
+            }
+            REQUIRE(benches == expected);
+        }
+
+        // Each feature node knows the ways to which it belongs
+        // (all but one, which is missing its nodes)
+        for (Feature node : world("n[amenity=bench]"))
+        {
+            std::set<uint64_t> expected;
+            for (const OsmWay& way : pbf.ways)
+            {
+                if (way.id == 30'001) continue;
+                if (std::find(way.nodes.begin(), way.nodes.end(), node.id()) != way.nodes.end())
+                {
+                    expected.insert(way.id);
+                }
+            }
+            std::set<uint64_t> parents;
+            for (Feature way : node.parents("w")) parents.insert(way.id());
+            REQUIRE(parents == expected);
+        }
+
+        // Widths with decimals are numbers, and read back unchanged
+        REQUIRE(world("w[width=2.5]").count() == 10);
+        REQUIRE(world("w[width>2]").count() == 40);
+        Feature street = findFeature(world("w[highway=residential]"), 10'042);
+        REQUIRE(std::string(street["width"]) == "4.5");
+        REQUIRE(static_cast<double>(street["width"]) == 4.5);
+    }
+    clarisma::File::remove(golFile.c_str());
+    clarisma::File::remove(pbfFile.c_str());
+}
+
+TEST_CASE("GolBuilder: features that span 2 x 2 tiles are found once")
+{
+    std::string pbfFile = tempFile("golbuilder_quad_test.osm.pbf");
+    std::string golFile = tempFile("golbuilder_quad_test.gol");
+    sampleData().write(pbfFile, 1000);
+    GolBuilder(smallSettings()).build(pbfFile.c_str(), golFile.c_str());
+    {
+        Features world(golFile.c_str());
+        REQUIRE(world.store()->verify().isValid());
+        std::vector<Feature> buildings;
+        for (Feature building : world("a[building]")) buildings.push_back(building);
+
+        int quads = 0;
+        for (Feature building : buildings)
+        {
+            // A query at the building's south-east corner only reaches
+            // the copy in that tile, which has both multi-tile flags
+            // if the building spans 2 x 2 tiles
+            Box b = building.bounds();
+            Box corner(b.maxX(), b.minY(), b.maxX(), b.minY());
+            int copies = 0;
+            for (Feature f : world(corner)("a[building]"))
+            {
+                if (f.id() != building.id()) continue;
+                copies++;
+                int flags = f.ptr().flags();
+                quads += (flags & FeatureFlags::MULTITILE_WEST) &&
+                    (flags & FeatureFlags::MULTITILE_NORTH);
+            }
+            REQUIRE(copies == 1);
+
+            // Queries that reach every tile of the building (and those of
+            // its neighbours) return each building once
+            Box around(b.minX() - 70'000, b.minY() - 70'000,
+                b.maxX() + 70'000, b.maxY() + 70'000);
+            std::unordered_set<uint64_t> ids;
+            uint64_t count = 0;
+            for (Feature f : world(around)("a[building]"))
+            {
+                ids.insert(f.id());
+                count++;
+            }
+            REQUIRE(count == ids.size());
+            REQUIRE(ids.count(building.id()) == 1);
+
+            // A polygon filter only accepts the tiles its polygon covers:
+            // the triangle to the south-east of the building's diagonal
+            // may cover the tiles to the north-east and south-west of
+            // the tile corner, but not the one to the north-west
+            std::vector<Coordinate> triangle =
+                { b.bottomLeft(), b.bottomRight(), b.topRight() };
+            ids.clear();
+            count = 0;
+            for (Feature f : world("a[building]").intersecting(triangle))
+            {
+                ids.insert(f.id());
+                count++;
+            }
+            REQUIRE(count == ids.size());
+            REQUIRE(ids.count(building.id()) == 1);
+        }
+        REQUIRE(quads > 0);
+    }
+    clarisma::File::remove(golFile.c_str());
+    clarisma::File::remove(pbfFile.c_str());
+}
+
+TEST_CASE("GolBuilder: distances to a relation include its node members")
+{
+    std::string pbfFile = tempFile("golbuilder_distance_test.osm.pbf");
+    std::string golFile = tempFile("golbuilder_distance_test.gol");
+    sampleData().write(pbfFile, 1000);
+    GolBuilder(smallSettings()).build(pbfFile.c_str(), golFile.c_str());
+    {
+        Features world(golFile.c_str());
+
+        // The site's only member is a node, so features are measured
+        // against that node
+        Feature site = findFeature(world("r[type=site]"), 40'004);
+        Feature node = *site.members().begin();
+        REQUIRE(node.id() == gridNode(1, 0));
+        for (double meters : { 10.0, 600.0, 2000.0 })
+        {
+            std::set<uint64_t> expected;
+            for (Feature f : world("nw").maxMetersFrom(meters, node)) expected.insert(f.id());
+            std::set<uint64_t> ids;
+            for (Feature f : world("nw").maxMetersFrom(meters, site)) ids.insert(f.id());
+            REQUIRE(!ids.empty());
+            REQUIRE(ids == expected);
+        }
+    }
+    clarisma::File::remove(golFile.c_str());
+    clarisma::File::remove(pbfFile.c_str());
+}
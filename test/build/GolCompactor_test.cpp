@@ -0,0 +1,167 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Buffer.h>
+#include <clarisma/validate/Validate.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/build/GolCompactor.h>
+#include <geodesk/format/GeoJsonWriter.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <geodesk/query/TileIndexWalker.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 5;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+/// Compacted copies are placed next to the generated GOL, so they
+/// are removed along with it
+struct World : SyntheticGolFixture<worldSettings>
+{
+    std::string outputFile(const char* suffix) const
+    {
+        return fileName + suffix;
+    }
+};
+
+/// Writes each feature as GeoJSON, by typed ID (since queries return
+/// features in no particular order)
+std::map<uint64_t, std::string> toGeoJson(const Features& features)
+{
+    std::map<uint64_t, std::string> json;
+    for (Feature f : features)
+    {
+        clarisma::DynamicBuffer buf(4096);
+        {
+            GeoJsonWriter out(&buf);
+            out.writeFeature(features.store(), f.ptr());
+            out.flush();
+        }
+        json[f.ptr().typedId()] = std::string(buf.data(), buf.length());
+    }
+    return json;
+}
+
+/// The tiles of the store, along with their pages
+struct TilePage
+{
+    uint32_t hilbert;
+    Tip tip;
+    uint32_t page;
+};
+
+std::vector<TilePage> tilePages(FeatureStore* store)
+{
+    std::vector<TilePage> tiles;
+    TileIndexWalker walker(store->tileIndex(), store->zoomLevels(),
+        Box::ofWorld(), nullptr);
+    while (walker.next())
+    {
+        Box bounds = walker.currentTile().bounds();
+        uint32_t x = static_cast<uint32_t>((static_cast<int64_t>(bounds.minX()) +
+            bounds.maxX()) / 2 + (1LL << 31)) >> 16;
+        uint32_t y = static_cast<uint32_t>((static_cast<int64_t>(bounds.minY()) +
+            bounds.maxY()) / 2 + (1LL << 31)) >> 16;
+        Tip tip = walker.currentTip();
+        uint32_t page = (store->tileIndex() + tip * 4).getUnsignedInt() >> 1;
+        tiles.push_back({ static_cast<uint32_t>(hilbert::calculateHilbertDistance(x, y)),
+            tip, page });
+    }
+    return tiles;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Compacted GOLs have the same features")
+{
+    std::map<uint64_t, std::string> expected = toGeoJson(world);
+    REQUIRE(expected.size() > 1000);
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    std::map<uint64_t, std::string> expectedInBounds = toGeoJson(world("na[building]")(bounds));
+    REQUIRE(!expectedInBounds.empty());
+
+    for (GolCompactor::Order order : { GolCompactor::Order::HILBERT, GolCompactor::Order::TIP })
+    {
+        GolCompactor::Settings settings;
+        settings.order = order;
+        std::string compactedFile = outputFile(order == GolCompactor::Order::HILBERT ?
+            ".hilbert.gol" : ".tip.gol");
+        GolCompactor::Stats stats = GolCompactor(settings).compact(world.store(), compactedFile.c_str());
+        REQUIRE(stats.tiles == tilePages(world.store()).size());
+        REQUIRE(stats.compressedTiles == 0);
+        REQUIRE(stats.fileSize == std::filesystem::file_size(compactedFile));
+        REQUIRE(stats.fileSize <= stats.sourceSize);
+
+        Features compacted(compactedFile.c_str());
+        REQUIRE(compacted.store()->creationTimestamp() == world.store()->creationTimestamp());
+        REQUIRE(toGeoJson(compacted) == expected);
+        REQUIRE(toGeoJson(compacted("na[building]")(bounds)) == expectedInBounds);
+        REQUIRE(compacted("w[highway]").count() == world("w[highway]").count());
+    }
+}
+
+TEST_CASE_METHOD(World, "Tiles are laid out along the Hilbert curve")
+{
+    std::string compactedFile = outputFile(".hilbert.gol");
+    GolCompactor(GolCompactor::Settings()).compact(world.store(), compactedFile.c_str());
+    Features compacted(compactedFile.c_str());
+
+    auto byHilbert = [](const TilePage& a, const TilePage& b)
+    {
+        return std::tie(a.hilbert, a.tip) < std::tie(b.hilbert, b.tip);
+    };
+    auto byPage = [](const TilePage& a, const TilePage& b)
+    {
+        return a.page < b.page;
+    };
+    std::vector<TilePage> tiles = tilePages(compacted.store());
+    REQUIRE(tiles.size() > 10);
+    std::sort(tiles.begin(), tiles.end(), byHilbert);
+    REQUIRE(std::is_sorted(tiles.begin(), tiles.end(), byPage));
+
+    // In TIP order, the tiles are laid out like in the tile index
+    GolCompactor::Settings settings;
+    settings.order = GolCompactor::Order::TIP;
+    compactedFile = outputFile(".tip.gol");
+    GolCompactor(settings).compact(compacted.store(), compactedFile.c_str());
+    Features byTip(compactedFile.c_str());
+    tiles = tilePages(byTip.store());
+    std::sort(tiles.begin(), tiles.end(), [](const TilePage& a, const TilePage& b)
+    {
+        return a.tip < b.tip;
+    });
+    REQUIRE(std::is_sorted(tiles.begin(), tiles.end(), byPage));
+}
+
+TEST_CASE_METHOD(World, "A GOL can't be compacted into itself")
+{
+    bool thrown = false;
+    try
+    {
+        GolCompactor(GolCompactor::Settings()).compact(world.store(), fileName.c_str());
+    }
+    catch (const clarisma::ValueException&)
+    {
+        thrown = true;
+    }
+    REQUIRE(thrown);
+    REQUIRE(world("w").count() > 0);
+}
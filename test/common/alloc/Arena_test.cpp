@@ -0,0 +1,39 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/alloc/Arena.h>
+
+using namespace clarisma;
+
+TEST_CASE("Arena: chunks are reused by the next Arena")
+{
+    uint8_t* first;
+    {
+        Arena arena(4096);
+        first = arena.alloc(100, 8);
+        memset(first, 0xAB, 100);
+    }
+    Arena arena(4096);
+    uint8_t* p = arena.alloc(100, 8);
+    REQUIRE(p == first);
+
+    // Growth beyond the first chunk, then clear() and reuse
+    for (int i = 0; i < 100; i++) memset(arena.alloc(1000, 8), i, 1000);
+    arena.clear();
+    REQUIRE(arena.alloc(100, 8) == first);
+}
+
+TEST_CASE("Arena: thread-local Arena outlives the chunk cache")
+{
+    std::thread thread([]()
+    {
+        thread_local Arena arena(4096);
+        memset(arena.alloc(5000, 8), 0, 5000);
+        Arena temp(4096);
+        memset(temp.alloc(100, 8), 0, 100);
+    });
+    thread.join();
+}
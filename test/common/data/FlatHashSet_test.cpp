@@ -0,0 +1,43 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <unordered_set>
+#include <clarisma/data/FlatHashSet.h>
+
+using namespace clarisma;
+
+TEST_CASE("FlatHashSet")
+{
+    FlatHashSet<uint64_t> set;
+    REQUIRE(set.isEmpty());
+    REQUIRE(!set.contains(42));
+
+    std::mt19937_64 rng(7);
+    std::unordered_set<uint64_t> expected;
+    for (int i = 0; i < 100000; i++)
+    {
+        // ID-like keys with flag bits, plus plenty of repeats
+        uint64_t key = ((rng() % 50000) + 1) << 8 | 0x10;
+        REQUIRE(set.insert(key) == expected.insert(key).second);
+    }
+    REQUIRE(set.size() == expected.size());
+    for (uint64_t key : expected) REQUIRE(set.contains(key));
+    REQUIRE(!set.contains(0x18));
+
+    set.clear();
+    REQUIRE(set.isEmpty());
+    REQUIRE(!set.contains(*expected.begin()));
+}
+
+TEST_CASE("FlatHashSet with custom empty key")
+{
+    FlatHashSet<uint32_t, 0xffff'ffff> set(1000);
+    size_t capacity = set.capacity();
+    for (uint32_t i = 0; i < 1000; i++) REQUIRE(set.insert(i));
+    REQUIRE(set.capacity() == capacity);     // reserved up front
+    REQUIRE(set.contains(0));
+    REQUIRE(!set.insert(0));
+    REQUIRE(!set.contains(0xffff'ffff));
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <unordered_set>
+#include <vector>
+#include <clarisma/data/PerfectHash.h>
+
+using namespace clarisma;
+
+static void checkPerfect(const std::vector<uint64_t>& hashes)
+{
+    std::vector<uint32_t> displacements;
+    uint32_t count = static_cast<uint32_t>(hashes.size());
+    REQUIRE(PerfectHash::build(hashes.data(), count, displacements));
+    REQUIRE(displacements.size() == PerfectHash::bucketCountFor(count));
+    PerfectHash ph(displacements.data(),
+        static_cast<uint32_t>(displacements.size()), count);
+    std::vector<bool> seen(count);
+    for (uint64_t h : hashes)
+    {
+        uint32_t s = ph.slot(h);
+        REQUIRE(s < count);
+        REQUIRE_FALSE(seen[s]);
+        seen[s] = true;
+    }
+}
+
+TEST_CASE("PerfectHash maps random hashes onto distinct slots")
+{
+    std::mt19937_64 random(42);
+    for (uint32_t n : { 1u, 2u, 7u, 100u, 5000u, 65535u })
+    {
+        std::unordered_set<uint64_t> unique;
+        while (unique.size() < n) unique.insert(random());
+        checkPerfect(std::vector<uint64_t>(unique.begin(), unique.end()));
+    }
+}
+
+TEST_CASE("PerfectHash handles sequential hashes")
+{
+    std::vector<uint64_t> hashes;
+    for (uint64_t i = 1; i <= 10000; i++) hashes.push_back(i);
+    checkPerfect(hashes);
+}
+
+TEST_CASE("PerfectHash rejects duplicate hashes")
+{
+    std::vector<uint64_t> hashes = { 17, 99, 17 };
+    std::vector<uint32_t> displacements;
+    REQUIRE_FALSE(PerfectHash::build(hashes.data(), 3, displacements));
+}
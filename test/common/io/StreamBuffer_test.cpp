@@ -0,0 +1,127 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifndef _WIN32
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/io/StreamBuffer.h>
+#include <clarisma/util/BufferWriter.h>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+using namespace clarisma;
+
+namespace {
+
+struct Pipe
+{
+    Pipe()
+    {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        readEnd = fds[0];
+        writeEnd = fds[1];
+        fcntl(readEnd, F_SETFL, O_NONBLOCK);
+    }
+
+    ~Pipe()
+    {
+        close(readEnd);
+        close(writeEnd);
+    }
+
+    /// Everything that has arrived so far
+    std::string available()
+    {
+        std::string s;
+        char buf[4096];
+        for (;;)
+        {
+            ssize_t n = read(readEnd, buf, sizeof(buf));
+            if (n <= 0) break;
+            s.append(buf, n);
+        }
+        return s;
+    }
+
+    int readEnd;
+    int writeEnd;
+};
+
+} // namespace
+
+TEST_CASE("StreamBuffer sends the first bytes right away")
+{
+    Pipe pipe;
+    StreamBuffer::Settings settings;
+    settings.flushBytes = 1024;
+    settings.maxDelay = std::chrono::hours(1);
+    StreamBuffer stream(pipe.writeEnd, settings);
+    BufferWriter out(&stream);
+    out.writeString("first");
+    out.flush();
+    REQUIRE(pipe.available() == "first");
+
+    // Below both thresholds, bytes are held back
+    out.writeString("second");
+    out.flush();
+    REQUIRE(pipe.available().empty());
+
+    // ... until enough have accumulated
+    out.writeString(std::string(1024, 'x'));
+    out.flush();
+    REQUIRE(pipe.available() == "second" + std::string(1024, 'x'));
+
+    out.writeString("rest");
+    out.flush();
+    stream.finish();
+    REQUIRE(pipe.available() == "rest");
+    REQUIRE(stream.bytesSent() == 5 + 6 + 1024 + 4);
+}
+
+TEST_CASE("StreamBuffer sends bytes that have waited too long")
+{
+    Pipe pipe;
+    StreamBuffer::Settings settings;
+    settings.maxDelay = std::chrono::milliseconds(20);
+    StreamBuffer stream(pipe.writeEnd, settings);
+    BufferWriter out(&stream);
+    out.writeString("a");
+    out.flush();
+    REQUIRE(pipe.available() == "a");
+    out.writeString("b");
+    out.flush();
+    REQUIRE(pipe.available().empty());
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    out.writeString("c");
+    out.flush();
+    REQUIRE(pipe.available() == "bc");
+}
+
+TEST_CASE("StreamBuffer::write() keeps chunks in order")
+{
+    Pipe pipe;
+    StreamBuffer::Settings settings;
+    settings.flushBytes = 100;
+    settings.maxDelay = std::chrono::hours(1);
+    StreamBuffer stream(pipe.writeEnd, settings);
+    BufferWriter out(&stream);
+    std::string expected;
+    for (int i = 0; i < 50; i++)
+    {
+        std::string head = std::to_string(i) + ":";
+        std::string chunk(i * 3, static_cast<char>('a' + i % 26));
+        out.writeString(head);
+        out.flush();
+        stream.write(chunk.data(), chunk.size());
+        out.setBuffer(&stream);
+        expected += head + chunk;
+    }
+    stream.finish();
+    REQUIRE(pipe.available() == expected);
+    REQUIRE(stream.bytesSent() == expected.size());
+}
+
+#endif
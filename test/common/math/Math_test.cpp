@@ -3,10 +3,39 @@
 
 #include <catch2/catch_test_macros.hpp>
 #include <cmath>
+#include <string>
 #include "clarisma/math/Math.h"
 
 using namespace clarisma;
 
+namespace {
+
+// Digit-by-digit reference for the numbers tested below
+double parseSlowly(const std::string& s)
+{
+	double value = 0;
+	int decimals = -1;
+	size_t i = 0;
+	bool negative = !s.empty() && s[0] == '-';
+	if (negative) i++;
+	for (; i < s.size(); i++)
+	{
+		char ch = s[i];
+		if (ch == '.' && decimals < 0)
+		{
+			decimals = 0;
+			continue;
+		}
+		if (ch < '0' || ch > '9') break;
+		value = value * 10 + (ch - '0');
+		if (decimals >= 0) decimals++;
+	}
+	if (negative) value = -value;
+	return decimals > 0 ? value / Math::POWERS_OF_10[decimals] : value;
+}
+
+} // namespace
+
 TEST_CASE("Math::parseDouble")
 {
   	double d;
@@ -50,3 +79,37 @@ TEST_CASE("Math::parseDouble")
 	REQUIRE(!success);
 	REQUIRE(std::isnan(d));
 }
+
+TEST_CASE("Math::parseDouble with digit runs of every length")
+{
+	const char* digits = "9876543210123456";
+	const char* suffixes[] = { "", " km/h", ";60", "x" };
+	for (int whole = 1; whole <= 15; whole++)
+	{
+		for (int frac = 0; whole + frac <= 15; frac++)
+		{
+			std::string s(digits, whole);
+			if (frac) s.append(".").append(digits + whole, frac);
+			for (const char* suffix : suffixes)
+			{
+				std::string text = s + suffix;
+				double d;
+				REQUIRE(Math::parseDouble(text, &d));
+				REQUIRE(d == parseSlowly(text));
+				REQUIRE(Math::parseDouble("-" + text, &d));
+				REQUIRE(d == -parseSlowly(text));
+			}
+		}
+	}
+}
+
+TEST_CASE("Math::parseDouble with many decimals")
+{
+	double d;
+	REQUIRE(Math::parseDouble("0.00000000000000000025", &d));
+	REQUIRE(std::abs(d - 2.5e-19) < 1e-30);
+	REQUIRE(Math::parseDouble(".5", &d));
+	REQUIRE(d == 0.5);
+	REQUIRE(Math::parseDouble("12.", &d));
+	REQUIRE(d == 12);
+}
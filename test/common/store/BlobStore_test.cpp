@@ -1,7 +1,11 @@
 // Copyright (c) 2024 Clarisma / GeoDesk contributors
 // SPDX-License-Identifier: LGPL-3.0-only
 
+#include <filesystem>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <catch2/catch_test_macros.hpp>
 #include "clarisma/store/BlobStore_v2.h"
@@ -94,4 +98,132 @@ TEST_CASE("BlobStore Hole-Punching")
 	store.close();
 }
 
-*/
\ No newline at end of file
+*/
+
+namespace {
+
+constexpr uint32_t PAGE_SIZE = 4096;
+
+// The largest payload that fits into a blob of the given number of pages
+uint32_t payloadForPages(uint32_t pages)
+{
+	return pages * PAGE_SIZE - 8;
+}
+
+std::string createStore(const char* name)
+{
+	std::string fileName = (std::filesystem::temp_directory_path() / name).string();
+	std::filesystem::remove(fileName);
+	BlobStore::CreateTransaction<BlobStore> t;
+	t.begin(fileName.c_str());
+	t.commit();
+	t.end();
+	return fileName;
+}
+
+} // namespace
+
+
+TEST_CASE("BlobStore reuses the smallest free blob that fits")
+{
+	std::string fileName = createStore("blobstore-bestfit.bin");
+	BlobStore store;
+	store.open(fileName.c_str(), Store::WRITE);
+
+	// Separate the blobs with 1-page spacers, so they aren't coalesced
+	BlobStore::Transaction t1(&store);
+	t1.begin();
+	t1.alloc(payloadForPages(1));
+	BlobStore::PageNum a = t1.alloc(payloadForPages(3));
+	t1.alloc(payloadForPages(1));
+	BlobStore::PageNum b = t1.alloc(payloadForPages(5));
+	t1.alloc(payloadForPages(1));
+	BlobStore::PageNum c = t1.alloc(payloadForPages(900));
+	t1.alloc(payloadForPages(1));
+	t1.commit();
+	t1.end();
+
+	BlobStore::Transaction t2(&store);
+	t2.begin();
+	t2.free(c);
+	t2.free(a);
+	t2.free(b);
+	t2.commit();
+	t2.end();
+
+	// A new transaction must find the free blobs left by the previous one
+	BlobStore::Transaction t3(&store);
+	t3.begin();
+	REQUIRE(t3.alloc(payloadForPages(4)) == b);
+	REQUIRE(t3.alloc(payloadForPages(2)) == a);
+	REQUIRE(t3.alloc(payloadForPages(600)) == c);
+	// Only the remainders are left: 1 page after a and after b,
+	// and 300 pages after c
+	BlobStore::PageNum d = t3.alloc(payloadForPages(1));
+	REQUIRE((d == a + 2 || d == b + 4));
+	REQUIRE(t3.alloc(payloadForPages(2)) == c + 600);
+	t3.commit();
+	t3.end();
+	store.close();
+}
+
+
+TEST_CASE("BlobStore coalesces freed blobs and never hands out overlapping blobs")
+{
+	std::string fileName = createStore("blobstore-churn.bin");
+	BlobStore store;
+	store.open(fileName.c_str(), Store::WRITE);
+
+	std::map<BlobStore::PageNum, uint32_t> live;	// first page -> pages
+	uint32_t seed = 12345;
+	auto random = [&seed](uint32_t n)
+	{
+		seed = seed * 1103515245 + 12345;
+		return (seed >> 16) % n;
+	};
+
+	for (int round = 0; round < 8; round++)
+	{
+		BlobStore::Transaction t(&store);
+		t.begin();
+		for (int i = 0; i < 200; i++)
+		{
+			if (!live.empty() && random(3) == 0)
+			{
+				auto it = live.begin();
+				std::advance(it, random(static_cast<uint32_t>(live.size())));
+				t.free(it->first);
+				live.erase(it);
+			}
+			else
+			{
+				// Mostly small blobs, with the occasional large one that
+				// needs a different trunk slot
+				uint32_t pages = random(8) == 0 ? 500 + random(1200) : 1 + random(20);
+				BlobStore::PageNum page = t.alloc(payloadForPages(pages));
+				REQUIRE(page > 0);
+				auto next = live.lower_bound(page);
+				if (next != live.end()) REQUIRE(page + pages <= next->first);
+				if (next != live.begin())
+				{
+					auto prev = std::prev(next);
+					REQUIRE(prev->first + prev->second <= page);
+				}
+				live[page] = pages;
+			}
+		}
+		t.commit();
+		t.end();
+	}
+
+	// Once everything has been freed, the free blobs must have been
+	// merged back into the empty space at the end of the store, so
+	// a new blob is placed right after the header page
+	BlobStore::Transaction t(&store);
+	t.begin();
+	for (const auto& [page, pages] : live) t.free(page);
+	REQUIRE(t.alloc(payloadForPages(1)) == 1);
+	t.commit();
+	t.end();
+	store.close();
+}
@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <filesystem>
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/store/IndexFile.h>
+
+using namespace clarisma;
+
+TEST_CASE("IndexFile: batched puts and gets")
+{
+    std::string fileName = (std::filesystem::temp_directory_path() /
+        "indexfile_test.bin").string();
+    {
+        IndexFile index;
+        index.bits(13);
+        index.open(fileName.c_str(), File::OpenMode::READ |
+            File::OpenMode::WRITE | File::OpenMode::CREATE |
+            File::OpenMode::REPLACE_EXISTING);
+
+        // Keys are unique, spread over many blocks
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> keys;
+        for (uint64_t key = 0; key < 2'000'000; key += 1 + random() % 7)
+        {
+            keys.push_back(key);
+        }
+
+        // First pass on a single thread, then overwrite using 8 threads
+        for (int threads : { 1, 8 })
+        {
+            std::vector<IndexFile::Entry> entries;
+            for (uint64_t key : keys)
+            {
+                entries.emplace_back(key, static_cast<uint32_t>(random() & 0x1fff));
+            }
+            std::shuffle(entries.begin(), entries.end(), random);
+            std::vector<IndexFile::Entry> expected = entries;
+            index.putAll(entries, threads);
+
+            for (const auto& [key, value] : expected)
+            {
+                REQUIRE(index.get(key) == value);
+            }
+
+            std::vector<uint64_t> lookups = keys;
+            std::shuffle(lookups.begin(), lookups.end(), random);
+            std::vector<uint32_t> values(lookups.size());
+            index.getAll(lookups, values);
+            std::sort(expected.begin(), expected.end());
+            for (size_t i = 0; i < lookups.size(); i++)
+            {
+                auto it = std::lower_bound(expected.begin(), expected.end(),
+                    IndexFile::Entry(lookups[i], 0));
+                REQUIRE(values[i] == it->second);
+            }
+        }
+    }
+    std::filesystem::remove(fileName);
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/store/PileFile.h>
+
+using namespace clarisma;
+
+namespace {
+
+// Each record is (thread, sequence number) for the given pile
+struct Record
+{
+    uint32_t thread;
+    uint32_t seq;
+};
+
+}
+
+TEST_CASE("PileFile: concurrent Writers")
+{
+    constexpr int PILES = 50;
+    constexpr int THREADS = 4;
+    constexpr int RECORDS = 20000;      // per thread and pile
+
+    std::string fileName = (std::filesystem::temp_directory_path() /
+        "pilefile_test.bin").string();
+    {
+        PileFile piles;
+        piles.create(fileName.c_str(), PILES, 4096);
+
+        // A pile that also received plain appends before the Writers
+        Record header { 0xffff'ffff, 0 };
+        piles.append(1, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < THREADS; t++)
+        {
+            threads.emplace_back([&piles, t]()
+            {
+                PileFile::Writer writer(piles, 4);
+                for (uint32_t i = 0; i < RECORDS; i++)
+                {
+                    for (int pile = 1; pile <= PILES; pile++)
+                    {
+                        // Odd piles get data from one thread only
+                        if ((pile & 1) && t != 0) continue;
+                        Record rec { t, i };
+                        writer.append(pile, reinterpret_cast<const uint8_t*>(&rec),
+                            sizeof(rec));
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+
+        int loaded = 0;
+        piles.loadAll([&](int pile, ReusableBlock& block)
+        {
+            loaded++;
+            size_t expectedRecords = ((pile & 1) ? 1 : THREADS) * RECORDS +
+                (pile == 1 ? 1 : 0);
+            REQUIRE(block.size() == expectedRecords * sizeof(Record));
+
+            // The records of each thread must be complete and in order
+            const Record* records = reinterpret_cast<const Record*>(block.data());
+            std::vector<uint32_t> next(THREADS, 0);
+            for (size_t i = 0; i < expectedRecords; i++)
+            {
+                if (records[i].thread == 0xffff'ffff)
+                {
+                    REQUIRE(i == 0);
+                    continue;
+                }
+                REQUIRE(records[i].thread < THREADS);
+                REQUIRE(records[i].seq == next[records[i].thread]);
+                next[records[i].thread]++;
+            }
+        });
+        REQUIRE(loaded == PILES);
+        piles.close();
+    }
+    std::filesystem::remove(fileName);
+}
+
+TEST_CASE("PileFile: records of concurrent Writers stay whole")
+{
+    constexpr int THREADS = 4;
+    constexpr int RECORDS = 3000;
+
+    std::string fileName = (std::filesystem::temp_directory_path() /
+        "pilefile_records_test.bin").string();
+    {
+        PileFile piles;
+        piles.create(fileName.c_str(), 1, 4096);
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < THREADS; t++)
+        {
+            threads.emplace_back([&piles, t]()
+            {
+                // Records of varying length (some larger than a chunk),
+                // each filled with its thread number
+                PileFile::Writer writer(piles, 2);
+                std::vector<uint8_t> record;
+                for (uint32_t i = 0; i < RECORDS; i++)
+                {
+                    uint32_t len = 5 + (i * 37) % 700 + (i % 500 == 0 ? 10000 : 0);
+                    record.assign(len, static_cast<uint8_t>(t));
+                    memcpy(record.data(), &len, 4);
+                    writer.append(1, record.data(), len);
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+
+        piles.loadAll([&](int pile, ReusableBlock& block)
+        {
+            const uint8_t* p = block.data();
+            const uint8_t* end = p + block.size();
+            size_t count = 0;
+            while (p < end)
+            {
+                uint32_t len;
+                memcpy(&len, p, 4);
+                REQUIRE(len >= 5);
+                REQUIRE(p + len <= end);
+                for (uint32_t i = 5; i < len; i++) REQUIRE(p[i] == p[4]);
+                p += len;
+                count++;
+            }
+            REQUIRE(count == THREADS * RECORDS);
+        });
+        piles.close();
+    }
+    std::filesystem::remove(fileName);
+}
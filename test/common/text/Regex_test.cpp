@@ -0,0 +1,77 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <regex>
+#include <string>
+#include <clarisma/text/Regex.h>
+
+using namespace clarisma;
+
+TEST_CASE("Regex agrees with std::regex_match")
+{
+    const char* patterns[] =
+    {
+        "", "abc", ".*strasse$", "^Rue .*", "a|b|cd", "(ab)*c", "(?:ab|a)+b?",
+        "[a-c]+x", "[^a-c]*", "\\d{2,4}", "\\w+\\s\\W", "a{3}", "a{2,}b",
+        "colou?r", ".*(street|road|avenue)", "[-a]+", "[a-]+", "x[\\d.]+",
+        "\\.\\*", "(a|ab)(c|bcd)(d*)", "[A-Z][a-z]*( [A-Z][a-z]*)*", "a.c",
+        "(a*)*b", "\\x41+", "[\\]a]+", "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)",
+        // Handled by std::regex
+        "(a)\\1", "a(?=b)b", "\\bword\\b", "[]a]"
+    };
+    const char* strings[] =
+    {
+        "", "a", "b", "ab", "abc", "abcd", "abab", "ababc", "ababb", "cd",
+        "Hauptstrasse", "strasse", "Rue de la Paix", "Rue", "color", "colour",
+        "5", "12", "1234", "12345", "hello world", "w !", "aaa", "aa",
+        "aaaab", "Main street", "Elm road", "---a", "x1.5", ".*", "abcd",
+        "Los Angeles", "los angeles", "a\nc", "abc\r", "AAA", "]a", "aaaaaa",
+        "abaaaa", "bbbbbb", "ba", "word", "aa\x80", "\xc3\xa9"
+    };
+    for (const char* pattern : patterns)
+    {
+        Regex regex(pattern);
+        std::regex expected(pattern);
+        for (const char* s : strings)
+        {
+            INFO("pattern: " << pattern << "  string: " << s);
+            REQUIRE(regex.match(s) == std::regex_match(s, expected));
+        }
+    }
+}
+
+TEST_CASE("Regex extracts literal prefixes and suffixes")
+{
+    Regex regex(".*strasse$");
+    REQUIRE(regex.isLinear());
+    REQUIRE(regex.prefix().empty());
+    REQUIRE(regex.suffix() == "strasse");
+
+    Regex regex2("^Rue .*");
+    REQUIRE(regex2.prefix() == "Rue ");
+    REQUIRE(regex2.suffix().empty());
+
+    REQUIRE(!Regex("(a)\\1").isLinear());
+}
+
+TEST_CASE("Regex rejects invalid patterns")
+{
+    REQUIRE_THROWS_AS(Regex("(ab"), std::regex_error);
+    REQUIRE_THROWS_AS(Regex("*a"), std::regex_error);
+    REQUIRE_THROWS_AS(Regex("[a-"), std::regex_error);
+}
+
+TEST_CASE("Regex falls back to the NFA for patterns with a large DFA")
+{
+    // The DFA must remember the last 12 characters
+    const char* pattern = "(a|b)*a(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)(a|b)";
+    Regex regex(pattern);
+    std::regex expected(pattern);
+    std::string s;
+    for (int i = 0; i < 200; i++)
+    {
+        s += (i * 7919 % 13 < 6) ? 'a' : 'b';
+        REQUIRE(regex.match(s) == std::regex_match(s, expected));
+    }
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/thread/EpochManager.h>
+
+using namespace clarisma;
+
+TEST_CASE("EpochManager: retired epochs wait for older readers")
+{
+    EpochManager epochs;
+    EpochManager::Epoch before = epochs.retire();
+    REQUIRE(epochs.canReclaim(before));
+
+    int reader = epochs.enter();
+    EpochManager::Epoch retired = epochs.retire();
+    REQUIRE_FALSE(epochs.canReclaim(retired));
+
+    // A reader that arrives after the object was retired
+    // can't have seen it
+    {
+        EpochManager::Guard later(epochs);
+        REQUIRE_FALSE(epochs.canReclaim(retired));
+        epochs.exit(reader);
+        REQUIRE(epochs.canReclaim(retired));
+    }
+    REQUIRE(epochs.canReclaim(epochs.retire()));
+}
+
+TEST_CASE("EpochManager: readers never see reclaimed objects")
+{
+    struct Object
+    {
+        std::atomic<int> value { 42 };
+    };
+
+    EpochManager epochs;
+    std::atomic<Object*> current = new Object();
+    std::atomic<bool> done = false;
+    std::atomic<int> errors = 0;
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&]()
+        {
+            while (!done.load())
+            {
+                EpochManager::Guard guard(epochs);
+                Object* obj = current.load(std::memory_order_acquire);
+                if (obj->value.load() != 42) errors++;
+            }
+        });
+    }
+
+    // The writer "reclaims" an object by poisoning it
+    std::vector<std::pair<Object*, EpochManager::Epoch>> retired;
+    std::vector<std::unique_ptr<Object>> reclaimed;
+    for (int i = 0; i < 10000; i++)
+    {
+        Object* old = current.exchange(new Object(), std::memory_order_release);
+        retired.emplace_back(old, epochs.retire());
+        EpochManager::Epoch oldest = epochs.oldestActive();
+        std::erase_if(retired, [&](const auto& entry)
+        {
+            if (entry.second >= oldest) return false;
+            entry.first->value.store(0);
+            reclaimed.emplace_back(entry.first);
+            return true;
+        });
+    }
+    done = true;
+    for (std::thread& t : readers) t.join();
+    for (auto& [obj, epoch] : retired) delete obj;
+    delete current.load();
+    REQUIRE(errors == 0);
+}
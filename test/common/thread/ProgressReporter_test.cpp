@@ -0,0 +1,37 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/thread/ProgressReporter.h>
+
+using namespace clarisma;
+
+TEST_CASE("ProgressReporter: concurrent progress")
+{
+    constexpr int THREADS = 8;
+    constexpr uint64_t UNITS = 200000;     // per thread
+
+    ProgressReporter reporter("Testing");
+    reporter.start(THREADS * UNITS);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; i++)
+    {
+        threads.emplace_back([&reporter, i]()
+        {
+            if (i % 2)
+            {
+                for (uint64_t n = 0; n < UNITS; n++) reporter.progress(1);
+            }
+            else
+            {
+                ProgressReporter::Batch batch(&reporter);
+                for (uint64_t n = 0; n < UNITS; n++) batch.progress(1);
+            }
+        });
+    }
+    for (std::thread& t : threads) t.join();
+    REQUIRE(reporter.unitsCompleted() == THREADS * UNITS);
+    reporter.end("Tested");
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/thread/TaskEngine.h>
+
+using namespace clarisma;
+
+namespace {
+
+class OrderedEngine;
+
+class OrderedContext
+{
+public:
+    explicit OrderedContext(OrderedEngine* engine) : engine_(engine) {}
+    void processTask(uint64_t& seq);
+    void afterTasks() {}
+    void harvestResults() {}
+
+private:
+    OrderedEngine* engine_;
+};
+
+class OrderedEngine : public TaskEngine<OrderedEngine, OrderedContext, uint64_t, uint64_t>
+{
+public:
+    OrderedEngine() : TaskEngine(4, 4, 4)
+    {
+        enableOrderedOutput(2);
+    }
+
+    void run(uint64_t count)
+    {
+        start();
+        for (uint64_t i = 0; i < count; i++) postWork(uint64_t(i));
+        end();
+    }
+
+    void processTask(uint64_t& value)
+    {
+        received.push_back(value);
+    }
+
+    std::vector<uint64_t> received;
+};
+
+void OrderedContext::processTask(uint64_t& seq)
+{
+    // Finish out of order
+    if (seq % 7 == 0) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    if (seq % 5 == 3)
+    {
+        engine_->skipOutput(seq);
+    }
+    else
+    {
+        engine_->postOutput(seq, uint64_t(seq));
+    }
+}
+
+class FailingEngine;
+
+class FailingContext
+{
+public:
+    explicit FailingContext(FailingEngine* engine) : engine_(engine) {}
+    void processTask(uint64_t& seq);
+    void afterTasks() {}
+    void harvestResults() { harvested = true; }
+
+    bool harvested = false;
+
+private:
+    FailingEngine* engine_;
+};
+
+class FailingEngine : public TaskEngine<FailingEngine, FailingContext, uint64_t, uint64_t>
+{
+public:
+    FailingEngine() : TaskEngine(4, 8, 8)
+    {
+        enableOrderedOutput();
+    }
+
+    void run(uint64_t count)
+    {
+        start();
+        for (uint64_t i = 0; i < count && !hasFailed(); i++) postWork(uint64_t(i));
+        end();
+    }
+
+    void processTask(uint64_t&) {}
+
+    std::atomic<uint64_t> processed = 0;
+};
+
+void FailingContext::processTask(uint64_t& seq)
+{
+    engine_->processed++;
+    if (seq == 100) throw std::runtime_error("bad input");
+    engine_->postOutput(seq, uint64_t(seq));
+}
+
+}
+
+TEST_CASE("TaskEngine: ordered output")
+{
+    constexpr uint64_t COUNT = 5000;
+    OrderedEngine engine;
+    engine.run(COUNT);
+
+    uint64_t expected = 0;
+    for (uint64_t value : engine.received)
+    {
+        if (expected % 5 == 3) expected++;
+        REQUIRE(value == expected);
+        expected++;
+    }
+    REQUIRE(engine.received.size() == COUNT - COUNT / 5);
+
+    OrderedEngine::Metrics metrics = engine.metrics();
+    REQUIRE(metrics.reorderPending == 0);
+    REQUIRE(metrics.output.occupancy == 0);
+    REQUIRE(metrics.work.capacity == 4);
+}
+
+TEST_CASE("TaskEngine: first exception is rethrown by end()")
+{
+    constexpr uint64_t COUNT = 10'000'000;
+    FailingEngine engine;
+    REQUIRE_THROWS_AS(engine.run(COUNT), std::runtime_error);
+    REQUIRE(engine.hasFailed());
+    // Work is cancelled as soon as the task fails
+    REQUIRE(engine.processed < 1000);
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/thread/TaskQueue.h>
+
+using namespace clarisma;
+
+namespace {
+
+struct SumContext
+{
+    void processTask(int64_t value)
+    {
+        sum.fetch_add(value, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<int64_t> sum = 0;
+    std::atomic<int64_t> count = 0;
+};
+
+}
+
+TEST_CASE("TaskQueue: multiple producers and consumers")
+{
+    constexpr int PRODUCERS = 4;
+    constexpr int CONSUMERS = 4;
+    constexpr int TASKS = 100000;      // per producer
+
+    TaskQueue<SumContext, int64_t> queue(16);
+    SumContext ctx;
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < CONSUMERS; i++)
+    {
+        consumers.emplace_back([&queue, &ctx]() { queue.process(&ctx); });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++)
+    {
+        producers.emplace_back([&queue, p]()
+        {
+            if (p % 2 == 0)
+            {
+                for (int64_t i = 1; i <= TASKS; i++) queue.post(int64_t(i));
+            }
+            else
+            {
+                // Batches larger than the queue itself
+                std::vector<int64_t> batch;
+                for (int64_t i = 1; i <= TASKS; i++)
+                {
+                    batch.push_back(i);
+                    if (batch.size() == 37 || i == TASKS)
+                    {
+                        queue.postBatch(batch.data(), static_cast<int>(batch.size()));
+                        batch.clear();
+                    }
+                }
+            }
+        });
+    }
+    for (std::thread& t : producers) t.join();
+    queue.awaitCompletion();
+    queue.shutdown();
+    for (std::thread& t : consumers) t.join();
+
+    REQUIRE(ctx.count == int64_t(PRODUCERS) * TASKS);
+    REQUIRE(ctx.sum == int64_t(PRODUCERS) * TASKS * (TASKS + 1) / 2);
+}
+
+TEST_CASE("TaskQueue: batches and fill")
+{
+    TaskQueue<SumContext, int64_t> queue(5);     // rounded up to 8
+    REQUIRE(queue.minimumRemainingCapacity() == 8);
+
+    int64_t next = 1;
+    bool full = queue.fill([&next](int64_t* task)
+    {
+        if (next > 6) return false;
+        *task = next++;
+        return true;
+    });
+    REQUIRE_FALSE(full);
+    REQUIRE(queue.minimumRemainingCapacity() == 2);
+
+    int64_t more[4] = { 7, 8, 9, 10 };
+    REQUIRE(queue.tryPostBatch(more, 4) == 2);
+    int64_t extra = 11;
+    REQUIRE_FALSE(queue.tryPost(std::move(extra)));
+
+    int64_t taken[16];
+    REQUIRE(queue.tryTakeBatch(taken, 3) == 3);
+    REQUIRE(taken[0] == 1);
+    REQUIRE(taken[2] == 3);
+    REQUIRE(queue.tryTakeBatch(taken, 16) == 5);
+    REQUIRE(taken[4] == 8);
+    REQUIRE(queue.tryTakeBatch(taken, 16) == 0);
+    REQUIRE(queue.minimumRemainingCapacity() == 8);
+}
@@ -0,0 +1,213 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/thread/WorkStealingPool.h>
+
+using namespace clarisma;
+
+namespace {
+
+std::atomic<int64_t> taskSum;
+std::atomic<int> tasksRun;
+
+struct SumTask
+{
+    SumTask() : value(0) {}
+    explicit SumTask(int v) : value(v) {}
+
+    void operator()()
+    {
+        taskSum.fetch_add(value, std::memory_order_relaxed);
+        tasksRun.fetch_add(1, std::memory_order_release);
+    }
+
+    int value;
+};
+
+}
+
+TEST_CASE("WorkStealingPool runs every posted task exactly once")
+{
+    taskSum = 0;
+    tasksRun = 0;
+    const int TASK_COUNT = 100'000;
+    int64_t expected = 0;
+    {
+        WorkStealingPool<SumTask> pool(4, 0);
+        SumTask batch[16];
+        int next = 1;
+        while (next <= TASK_COUNT)
+        {
+            int n = 0;
+            while (n < 16 && next + n <= TASK_COUNT)
+            {
+                batch[n] = SumTask(next + n);
+                n++;
+            }
+            int posted = pool.tryPostBatch(batch, n);
+            for (int i = 0; i < posted; i++) expected += next + i;
+            next += posted;
+            if (posted == 0) std::this_thread::yield();
+        }
+        while (tasksRun.load(std::memory_order_acquire) < TASK_COUNT)
+        {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(taskSum == expected);
+}
+
+TEST_CASE("WorkStealingPool with pinned threads")
+{
+    taskSum = 0;
+    tasksRun = 0;
+    {
+        WorkStealingPool<SumTask> pool(Threads::hardwareConcurrency() + 1, 0, true);
+        for (int i = 1; i <= 1000; i++) pool.post(SumTask(i));
+        while (tasksRun.load(std::memory_order_acquire) < 1000)
+        {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(taskSum == 500'500);
+}
+
+namespace {
+
+std::atomic<int> affinityTasksRun;
+
+struct AffinityTask
+{
+    AffinityTask() : key(0) {}
+    explicit AffinityTask(uint32_t k) : key(k) {}
+
+    uint32_t affinity() const { return key; }
+
+    void operator()()
+    {
+        affinityTasksRun.fetch_add(1, std::memory_order_release);
+    }
+
+    uint32_t key;
+};
+
+}
+
+TEST_CASE("WorkStealingPool with NUMA groups")
+{
+    affinityTasksRun = 0;
+    std::vector<std::vector<int>> nodes = Threads::numaNodes();
+    REQUIRE(!nodes.empty());
+    // Pretend there are two nodes, so we exercise the grouped queues
+    // even on single-node machines
+    nodes = { nodes[0], nodes[0] };
+    {
+        WorkStealingPool<AffinityTask> pool(5, 0, false, nodes);
+        REQUIRE(pool.groupCount() == 2);
+        for (uint32_t i = 0; i < 10'000; i++) pool.post(AffinityTask(i));
+        while (affinityTasksRun.load(std::memory_order_acquire) < 10'000)
+        {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(affinityTasksRun == 10'000);
+}
+
+namespace {
+
+std::atomic<bool> blockerStarted;
+std::atomic<bool> blockerReleased;
+std::atomic<int> laneTasksRun;
+std::vector<int> laneOrder;     // only touched by the single worker
+
+struct LaneTask
+{
+    LaneTask() : lane_(0), blocker_(false) {}
+    LaneTask(int lane, bool blocker) : lane_(lane), blocker_(blocker) {}
+
+    int lane() const { return lane_; }
+
+    void operator()()
+    {
+        if (blocker_)
+        {
+            blockerStarted.store(true, std::memory_order_release);
+            while (!blockerReleased.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+        }
+        else
+        {
+            laneOrder.push_back(lane_);
+        }
+        laneTasksRun.fetch_add(1, std::memory_order_release);
+    }
+
+    int lane_;
+    bool blocker_;
+};
+
+}
+
+TEST_CASE("WorkStealingPool runs high-priority lane first")
+{
+    blockerStarted = false;
+    blockerReleased = false;
+    laneTasksRun = 0;
+    laneOrder.clear();
+    {
+        WorkStealingPool<LaneTask> pool(1, 64);
+        pool.post(LaneTask(0, true));
+        while (!blockerStarted.load(std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        for (int i = 0; i < 50; i++) pool.post(LaneTask(1, false));
+        for (int i = 0; i < 50; i++) pool.post(LaneTask(0, false));
+        REQUIRE(pool.minimumRemainingCapacity(0) == pool.minimumRemainingCapacity(1));
+        blockerReleased.store(true, std::memory_order_release);
+        while (laneTasksRun.load(std::memory_order_acquire) < 101)
+        {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(laneOrder.size() == 100);
+    for (int i = 0; i < 100; i++) REQUIRE(laneOrder[i] == (i < 50 ? 0 : 1));
+}
+
+namespace {
+
+std::atomic<int> workerMask;
+std::atomic<int> workerTasksRun;
+
+struct WorkerTask
+{
+    void operator()()
+    {
+        int worker = WorkStealingPool<WorkerTask>::currentWorker();
+        if (worker >= 0) workerMask.fetch_or(1 << worker, std::memory_order_relaxed);
+        workerTasksRun.fetch_add(1, std::memory_order_release);
+    }
+};
+
+}
+
+TEST_CASE("WorkStealingPool reports the index of the current worker")
+{
+    workerMask = 0;
+    workerTasksRun = 0;
+    REQUIRE(WorkStealingPool<WorkerTask>::currentWorker() == -1);
+    {
+        WorkStealingPool<WorkerTask> pool(3, 0);
+        for (int i = 0; i < 1000; i++) pool.post(WorkerTask());
+        while (workerTasksRun.load(std::memory_order_acquire) < 1000)
+        {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(workerMask != 0);
+    REQUIRE((workerMask & ~0b111) == 0);
+}
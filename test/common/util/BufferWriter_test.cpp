@@ -0,0 +1,146 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/math/Math.h>
+#include <clarisma/util/BufferWriter.h>
+#include <clarisma/util/Buffer.h>
+#include <clarisma/util/Strings.h>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+
+using namespace clarisma;
+
+namespace {
+
+std::string formatScaled(int64_t value, int precision)
+{
+    DynamicBuffer buf(64);
+    BufferWriter out(&buf);
+    out.formatScaled(value, precision);
+    out.flush();
+    return std::string(buf.data(), buf.length());
+}
+
+std::string formatDouble(double value, int precision)
+{
+    DynamicBuffer buf(64);
+    BufferWriter out(&buf);
+    out.formatDouble(value, precision);
+    out.flush();
+    return std::string(buf.data(), buf.length());
+}
+
+std::string escape(const std::string& s)
+{
+    DynamicBuffer buf(16);
+    BufferWriter out(&buf);
+    out.writeJsonEscapedString(s);
+    out.flush();
+    return std::string(buf.data(), buf.length());
+}
+
+/// Escapes one character at a time (like the original implementation)
+std::string escapeSlowly(const std::string& s)
+{
+    std::string result;
+    for (char c : s)
+    {
+        unsigned char ch = static_cast<unsigned char>(c);
+        switch (ch)
+        {
+        case '\"': result += "\\\""; break;
+        case '\\': result += "\\\\"; break;
+        case '\b': result += "\\b"; break;
+        case '\f': result += "\\f"; break;
+        case '\n': result += "\\n"; break;
+        case '\r': result += "\\r"; break;
+        case '\t': result += "\\t"; break;
+        default:
+            if (ch < ' ')
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04X", ch);
+                result += buf;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+TEST_CASE("BufferWriter::formatScaled")
+{
+    REQUIRE(formatScaled(0, 7) == "0");
+    REQUIRE(formatScaled(12345, 0) == "12345");
+    REQUIRE(formatScaled(1234567890, 7) == "123.456789");
+    REQUIRE(formatScaled(-1234500000, 7) == "-123.45");
+    REQUIRE(formatScaled(5, 7) == "0.0000005");
+    REQUIRE(formatScaled(-5, 7) == "-0.0000005");
+    REQUIRE(formatScaled(1800000000, 7) == "180");
+    REQUIRE(formatScaled(-1800000000, 7) == "-180");
+}
+
+TEST_CASE("BufferWriter::formatScaled matches formatDouble")
+{
+    std::mt19937_64 rng(62);
+    std::uniform_real_distribution<double> dist(-180, 180);
+    for (int i = 0; i < 100000; i++)
+    {
+        double v = dist(rng);
+        int precision = i % 10;
+        int64_t scaled = static_cast<int64_t>(std::round(v * Math::POWERS_OF_10[precision]));
+        if (scaled == 0) continue;      // (formatDouble may write "-0")
+        REQUIRE(formatScaled(scaled, precision) == formatDouble(v, precision));
+    }
+}
+
+TEST_CASE("Strings::jsonSafePrefix")
+{
+    REQUIRE(Strings::jsonSafePrefix("", 0) == 0);
+    REQUIRE(Strings::jsonSafePrefix("residential", 11) == 11);
+    REQUIRE(Strings::jsonSafePrefix("Stra\xc3\x9f" "e", 7) == 7);
+    std::string text(40, 'a');
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        for (char special : { '"', '\\', '\n', '\x01', '\x1f' })
+        {
+            std::string s = text;
+            s[i] = special;
+            REQUIRE(Strings::jsonSafePrefix(s.data(), s.size()) == i);
+        }
+        // Neither ' ' nor non-ASCII bytes need escaping
+        std::string s = text;
+        s[i] = ' ';
+        REQUIRE(Strings::jsonSafePrefix(s.data(), s.size()) == s.size());
+        s[i] = static_cast<char>(0xe9);
+        REQUIRE(Strings::jsonSafePrefix(s.data(), s.size()) == s.size());
+    }
+}
+
+TEST_CASE("BufferWriter::writeJsonEscapedString")
+{
+    std::mt19937 rng(118);
+    const char alphabet[] = "abc \"\\\n\t\x02\xc3\xa9xyz0123456789";
+    std::uniform_int_distribution<size_t> pick(0, sizeof(alphabet) - 2);
+    for (int len : { 0, 1, 7, 15, 16, 17, 31, 33, 100, 5000 })
+    {
+        for (int round = 0; round < 20; round++)
+        {
+            std::string s;
+            for (int i = 0; i < len; i++)
+            {
+                // mostly plain text, with the odd special character
+                s += (rng() % 8) ? static_cast<char>('a' + rng() % 26) : alphabet[pick(rng)];
+            }
+            REQUIRE(escape(s) == escapeSlowly(s));
+        }
+    }
+}
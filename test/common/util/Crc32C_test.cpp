@@ -0,0 +1,51 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Crc32C.h>
+
+using namespace clarisma;
+
+TEST_CASE("Crc32C: known values")
+{
+    const char* digits = "123456789";
+    REQUIRE(Crc32C::compute(digits, strlen(digits)) == 0xE3069283);
+    REQUIRE(Crc32C::compute(digits, 0) == 0);
+
+    uint8_t zeroes[32] = {};
+    REQUIRE(Crc32C::compute(zeroes, sizeof(zeroes)) == 0x8A9136AA);
+}
+
+TEST_CASE("Crc32C: incremental updates match a single pass")
+{
+    // Long enough to use the interleaved lanes, with odd offsets
+    // and lengths to exercise the unaligned head and tail
+    std::vector<uint8_t> data(10000);
+    uint32_t x = 12345;
+    for (uint8_t& b : data)
+    {
+        x = x * 1103515245 + 12345;
+        b = static_cast<uint8_t>(x >> 16);
+    }
+
+    for (size_t start : { 0, 1, 5 })
+    {
+        for (size_t len : { 0, 7, 1535, 1536, 1537, 4099, 9000 })
+        {
+            uint32_t expected = 0;
+            for (size_t i = 0; i < len; i++)
+            {
+                expected = Crc32C::compute(&data[start + i], 1, expected);
+            }
+            REQUIRE(Crc32C::compute(&data[start], len) == expected);
+
+            Crc32C crc;
+            size_t half = len / 3;
+            crc.update(&data[start], half);
+            crc.update(&data[start + half], len - half);
+            REQUIRE(crc.get() == expected);
+        }
+    }
+}
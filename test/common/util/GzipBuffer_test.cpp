@@ -0,0 +1,71 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_WITH_ZLIB
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/BufferWriter.h>
+#include <clarisma/util/GzipBuffer.h>
+#include <string>
+#include <zlib.h>
+
+using namespace clarisma;
+
+namespace {
+
+/// Decompresses all members of a gzip stream
+std::string gunzip(const char* data, size_t len)
+{
+    std::string result;
+    z_stream stream = {};
+    REQUIRE(inflateInit2(&stream, 15 + 16) == Z_OK);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(len);
+    char out[4096];
+    while (stream.avail_in)
+    {
+        stream.next_out = reinterpret_cast<Bytef*>(out);
+        stream.avail_out = sizeof(out);
+        int res = inflate(&stream, Z_NO_FLUSH);
+        REQUIRE((res == Z_OK || res == Z_STREAM_END));
+        result.append(out, sizeof(out) - stream.avail_out);
+        if (res == Z_STREAM_END) inflateReset(&stream);
+    }
+    inflateEnd(&stream);
+    return result;
+}
+
+std::string compress(const std::string& text, int threadCount, size_t blockSize)
+{
+    DynamicBuffer compressed(1024);
+    {
+        GzipBuffer gzip(&compressed, 6, threadCount, blockSize);
+        BufferWriter out(&gzip);
+        // Write in uneven pieces, flushing now and then
+        for (size_t i = 0; i < text.size(); i += 777)
+        {
+            out.writeBytes(text.data() + i, std::min(size_t(777), text.size() - i));
+            if (i % 7 == 0) out.flush();
+        }
+        out.flush();
+        gzip.finish();
+    }
+    return gunzip(compressed.data(), compressed.length());
+}
+
+} // namespace
+
+TEST_CASE("GzipBuffer")
+{
+    std::string text;
+    for (int i = 0; i < 20000; i++)
+    {
+        text += "{\"type\":\"Feature\",\"id\":" + std::to_string(i * 7919) + "},\n";
+    }
+    REQUIRE(compress(text, 1, 4096) == text);
+    REQUIRE(compress(text, 4, 4096) == text);
+    REQUIRE(compress(text, 0, GzipBuffer::DEFAULT_BLOCK_SIZE) == text);
+    REQUIRE(compress("", 4, 4096).empty());
+}
+
+#endif // GEODESK_WITH_ZLIB
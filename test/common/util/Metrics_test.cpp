@@ -0,0 +1,66 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Metrics.h>
+
+using namespace clarisma;
+
+TEST_CASE("Counter sums the increments of all threads")
+{
+    Counter counter;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&counter]()
+        {
+            for (int n = 0; n < 10000; n++) counter.add();
+        });
+    }
+    for (std::thread& t : threads) t.join();
+    REQUIRE(counter.value() == 80000);
+}
+
+TEST_CASE("Histogram buckets durations by powers of 2")
+{
+    Histogram histogram;
+    histogram.record(0);            // first bucket
+    histogram.record(1023);         // first bucket (< 2^10)
+    histogram.record(1024);         // second bucket
+    histogram.record(1ULL << 40);   // overflow
+    Histogram::Snapshot s = histogram.snapshot();
+    REQUIRE(s.count == 4);
+    REQUIRE(s.buckets[0] == 2);
+    REQUIRE(s.buckets[1] == 1);
+    REQUIRE(s.buckets[Histogram::BUCKET_COUNT - 1] == 1);
+    REQUIRE(s.sum == 1023 + 1024 + (1ULL << 40));
+}
+
+TEST_CASE("MetricsRegistry snapshot and Prometheus output")
+{
+    Counter requests;
+    Histogram latency;
+    MetricsRegistry registry;
+    registry.addCounter("requests_total", "Requests served", &requests);
+    registry.addGauge("queue_depth", "Requests waiting", []() { return 3.0; });
+    registry.addHistogram("latency_seconds", "Request latency",
+        [&latency]() { return &latency; });
+
+    requests.add(5);
+    latency.record(2000);
+    MetricsSnapshot snapshot = registry.snapshot();
+    REQUIRE(snapshot.valueOf("requests_total") == 5);
+    REQUIRE(snapshot.valueOf("queue_depth") == 3);
+    REQUIRE(snapshot.distributions.size() == 1);
+    REQUIRE(snapshot.distributions[0].histogram.count == 1);
+
+    std::string text;
+    snapshot.writePrometheus(text, "store=\"test\"");
+    REQUIRE(text.find("# TYPE requests_total counter\n") != std::string::npos);
+    REQUIRE(text.find("requests_total{store=\"test\"} 5\n") != std::string::npos);
+    REQUIRE(text.find("# TYPE queue_depth gauge\n") != std::string::npos);
+    REQUIRE(text.find("latency_seconds_bucket{store=\"test\",le=\"+Inf\"} 1\n") != std::string::npos);
+    REQUIRE(text.find("latency_seconds_count{store=\"test\"} 1\n") != std::string::npos);
+}
@@ -0,0 +1,47 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/ShortVarString.h>
+#include <string>
+#include <vector>
+
+using namespace clarisma;
+
+namespace {
+
+struct StringBuf
+{
+    explicit StringBuf(const std::string& s) : bytes(s.size() + 2)
+    {
+        reinterpret_cast<ShortVarString*>(bytes.data())->init(s.data(), s.size());
+    }
+
+    const ShortVarString* get() const
+    {
+        return reinterpret_cast<const ShortVarString*>(bytes.data());
+    }
+
+    std::vector<uint8_t> bytes;
+};
+
+} // namespace
+
+TEST_CASE("ShortVarString::Probe")
+{
+    std::vector<std::string> strings =
+    {
+        "", "a", "b", "name", "name:de", "name:fr", "name:d", "ame:de",
+        std::string(127, 'x'), std::string(128, 'x'), std::string(129, 'x'),
+        std::string(128, 'x') + "y", std::string(255, 'z'), std::string(256, 'z')
+    };
+    for (const std::string& a : strings)
+    {
+        ShortVarString::Probe probe(a);
+        for (const std::string& b : strings)
+        {
+            StringBuf buf(b);
+            REQUIRE(probe.matches(buf.get()) == (a == b));
+        }
+    }
+}
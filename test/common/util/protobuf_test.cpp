@@ -0,0 +1,122 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/protobuf.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+using namespace clarisma;
+
+namespace {
+
+void writeVarint(std::vector<uint8_t>& buf, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back(static_cast<uint8_t>(v));
+}
+
+uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+// Values of 1 to 10 bytes, interspersed with long runs of small values
+std::vector<uint64_t> randomValues(std::mt19937_64& rng, size_t count)
+{
+    std::vector<uint64_t> values;
+    while (values.size() < count)
+    {
+        if (rng() % 8 == 0)
+        {
+            size_t run = rng() % 40;
+            for (size_t i = 0; i < run; i++) values.push_back(rng() & 0x7f);
+        }
+        else
+        {
+            int bits = static_cast<int>(rng() % 64) + 1;
+            values.push_back(rng() >> (64 - bits));
+        }
+    }
+    return values;
+}
+
+} // namespace
+
+TEST_CASE("decodeVarints matches scalar decoding")
+{
+    std::mt19937_64 rng(42);
+    for (int round = 0; round < 200; round++)
+    {
+        std::vector<uint64_t> values = randomValues(rng, rng() % 300);
+        std::vector<uint8_t> buf;
+        for (uint64_t v : values) writeVarint(buf, v);
+        std::vector<uint64_t> decoded(buf.size());
+        size_t count = protobuf::decodeVarints(
+            buf.data(), buf.data() + buf.size(), decoded.data());
+        decoded.resize(count);
+        REQUIRE(decoded == values);
+    }
+}
+
+TEST_CASE("decodeVarints ignores a truncated varint")
+{
+    std::vector<uint8_t> buf;
+    for (int i = 0; i < 20; i++) writeVarint(buf, 5);
+    writeVarint(buf, 1'000'000);
+    buf.pop_back();
+    std::vector<uint64_t> decoded(buf.size());
+    size_t count = protobuf::decodeVarints(
+        buf.data(), buf.data() + buf.size(), decoded.data());
+    REQUIRE(count == 20);
+    REQUIRE(decoded[19] == 5);
+}
+
+TEST_CASE("readPackedSInt64 decodes deltas")
+{
+    std::mt19937_64 rng(7);
+    for (int round = 0; round < 100; round++)
+    {
+        size_t n = rng() % 100;
+        std::vector<int64_t> values;
+        std::vector<uint8_t> buf;
+        int64_t prev = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            // mostly small deltas, as in DenseNodes
+            int64_t v = prev + static_cast<int64_t>(rng() % 2001) - 1000;
+            if (rng() % 16 == 0) v = static_cast<int64_t>(rng());
+            writeVarint(buf, zigzag(v - prev));
+            values.push_back(v);
+            prev = v;
+        }
+        std::vector<int64_t> decoded;
+        protobuf::readPackedSInt64(ByteSpan(buf.data(), buf.size()), decoded, true);
+        REQUIRE(decoded == values);
+    }
+}
+
+TEST_CASE("readPackedSInt64 decodes plain values")
+{
+    std::vector<int64_t> values = { 0, -1, 1, INT64_MIN, INT64_MAX, -300, 300 };
+    std::vector<uint8_t> buf;
+    for (int64_t v : values) writeVarint(buf, zigzag(v));
+    std::vector<int64_t> decoded;
+    protobuf::readPackedSInt64(ByteSpan(buf.data(), buf.size()), decoded);
+    REQUIRE(decoded == values);
+}
+
+TEST_CASE("readPackedVarints narrows to the element type")
+{
+    std::vector<uint32_t> values = { 1, 0, 127, 128, 16384, 4'000'000'000u };
+    std::vector<uint8_t> buf;
+    for (uint32_t v : values) writeVarint(buf, v);
+    std::vector<uint32_t> decoded;
+    protobuf::readPackedVarints(ByteSpan(buf.data(), buf.size()), decoded);
+    REQUIRE(decoded == values);
+}
@@ -0,0 +1,129 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 5;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+template<typename V>
+std::vector<V> sorted(std::vector<V> values)
+{
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Pipelines produce the same values as sequential code")
+{
+    Features streets = world("w[highway]");
+
+    std::vector<int64_t> expectedIds;
+    std::vector<double> expectedLengths;
+    for (Feature f : streets)
+    {
+        expectedIds.push_back(f.id());
+        double len = f.length();
+        if (len > 500) expectedLengths.push_back(len);
+    }
+    REQUIRE(!expectedLengths.empty());
+    REQUIRE(expectedLengths.size() < expectedIds.size());
+
+    std::vector<int64_t> ids = streets
+        | geodesk::map([](Feature f) { return f.id(); })
+        | geodesk::collect();
+    REQUIRE(sorted(ids) == sorted(expectedIds));
+
+    std::vector<double> lengths = streets
+        | geodesk::map([](Feature f) { return f.length(); })
+        | geodesk::where([](double len) { return len > 500; })
+        | geodesk::collect();
+    REQUIRE(sorted(lengths) == sorted(expectedLengths));
+
+    // Stages can be chained in any order
+    std::vector<Feature> named = world
+        | geodesk::where([](Feature f) { return f.hasTag("highway"); })
+        | geodesk::collect();
+    REQUIRE(named.size() == world("*[highway]").count());
+
+    uint64_t count = streets
+        | geodesk::where([](Feature f) { return f.length() > 500; })
+        | geodesk::map([](Feature) { return uint64_t{1}; })
+        | geodesk::fold(uint64_t{0}, [](uint64_t a, uint64_t b) { return a + b; });
+    REQUIRE(count == expectedLengths.size());
+    REQUIRE(count == streets.reduce(uint64_t{0},
+        [](Feature f) { return f.length() > 500 ? uint64_t{1} : uint64_t{0}; },
+        [](uint64_t a, uint64_t b) { return a + b; }));
+}
+
+TEST_CASE_METHOD(World, "Pipelines run on the threads that scan the tiles")
+{
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::thread::id caller = std::this_thread::get_id();
+    std::vector<int64_t> ids = world.nodes()
+        | geodesk::map([&mutex, &threads, caller](Node node)
+            {
+                bool alone;
+                {
+                    std::lock_guard lock(mutex);
+                    threads.insert(std::this_thread::get_id());
+                    alone = threads.size() == 1;
+                }
+                // The calling thread helps scan tiles while it waits;
+                // slow it down until a worker has mapped a feature, so
+                // it can't scan all tiles with nodes by itself
+                if (alone && std::this_thread::get_id() == caller)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                return node.id();
+            })
+        | geodesk::collect();
+    REQUIRE(ids.size() == world.nodes().count());
+    REQUIRE((threads.size() > 1 || threads.count(caller) == 0));
+}
+
+TEST_CASE_METHOD(World, "Pipelines over members run on the calling thread")
+{
+    Relation rel = world.relations().first().value();
+    std::vector<int64_t> expected;
+    for (Feature member : rel.members()) expected.push_back(member.id());
+    REQUIRE(!expected.empty());
+
+    std::thread::id caller = std::this_thread::get_id();
+    bool sameThread = true;
+    std::vector<int64_t> ids = rel.members()
+        | geodesk::map([caller, &sameThread](Feature f)
+            {
+                sameThread &= std::this_thread::get_id() == caller;
+                return f.id();
+            })
+        | geodesk::collect();
+    REQUIRE(ids == expected);
+    REQUIRE(sameThread);
+}
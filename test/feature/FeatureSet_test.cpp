@@ -0,0 +1,129 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <set>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/FeatureSet.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+std::set<int64_t> idsOf(FeatureStore* store, const FeatureSet& set)
+{
+    std::set<int64_t> ids;
+    for (FeaturePtr p : set) ids.insert(Feature(store, p).id());
+    return ids;
+}
+
+std::set<int64_t> idsOf(const Features& features)
+{
+    std::set<int64_t> ids;
+    for (Feature f : features) ids.insert(f.id());
+    return ids;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 2000;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "FeatureSet")
+{
+    FeatureStore* store = world.store();
+
+    Features a = world(Box::ofWSEN(7.1, 43.6, 7.6, 44.1));
+    Features b = world("n")(Box::ofWSEN(7.4, 43.9, 7.9, 44.4));
+    FeatureSet setA(a);
+    FeatureSet setB(b);
+    std::set<int64_t> idsA = idsOf(a);
+    std::set<int64_t> idsB = idsOf(b);
+    REQUIRE(setA.size() == a.count());
+    REQUIRE(setB.size() == b.count());
+    REQUIRE(idsOf(store, setA) == idsA);
+    REQUIRE(setA.memoryUsage() < setA.size() * sizeof(FeaturePtr));
+
+    std::set<int64_t> expected;
+    expected.insert(idsA.begin(), idsA.end());
+    expected.insert(idsB.begin(), idsB.end());
+    FeatureSet united = setA | setB;
+    REQUIRE(united.size() == expected.size());
+    REQUIRE(idsOf(store, united) == expected);
+
+    expected.clear();
+    for (int64_t id : idsA)
+    {
+        if (idsB.count(id)) expected.insert(id);
+    }
+    FeatureSet common = setA & setB;
+    REQUIRE(!common.isEmpty());
+    REQUIRE(idsOf(store, common) == expected);
+    REQUIRE(common == (setB & setA));
+
+    FeatureSet diff = setA - setB;
+    REQUIRE(diff.size() == setA.size() - common.size());
+    REQUIRE((diff & setB).isEmpty());
+    REQUIRE((diff | common) == setA);
+
+    FeatureSet incremental(store);
+    for (uint64_t key : { uint64_t{5}, uint64_t{3}, uint64_t{5} })
+    {
+        incremental.addKey(key);
+    }
+    REQUIRE(incremental.size() == 2);
+    REQUIRE(incremental.containsKey(3));
+    REQUIRE(!incremental.containsKey(4));
+
+    FeatureSet none(world("n[amenity=nonexistent]"));
+    REQUIRE(none.isEmpty());
+    REQUIRE((setA & none).isEmpty());
+    REQUIRE((setA | none) == setA);
+}
+
+TEST_CASE("FeatureSet with dense containers")
+{
+    // Even keys form a bitmap container, every third key an array
+    FeatureSet even;
+    FeatureSet third;
+    for (uint64_t key = 0; key < 65536; key += 2) even.addKey(key);
+    for (uint64_t key = 0; key < 65536; key += 3) third.addKey(key);
+    REQUIRE(even.size() == 32768);
+    REQUIRE(even.memoryUsage() < 16384);
+
+    FeatureSet sixth = even & third;
+    REQUIRE(sixth.size() == 10923);
+    REQUIRE(sixth.containsKey(6));
+    REQUIRE(!sixth.containsKey(4));
+    REQUIRE((third & even) == sixth);
+
+    FeatureSet either = even | third;
+    REQUIRE(either.size() == 32768 + 21846 - 10923);
+    REQUIRE(((even - third) | sixth) == even);
+
+    FeatureSet sparse;
+    sparse.addKey(4);
+    sparse.addKey(5);
+    sparse.addKey(70000);
+    REQUIRE((even & sparse).size() == 1);
+    REQUIRE((sparse - even).size() == 2);
+    REQUIRE((even - sparse).size() == 32767);
+
+    uint64_t count = 0;
+    uint64_t prev = 0;
+    bool ordered = true;
+    sixth.forEachKey([&](uint64_t key)
+    {
+        if (count++ && key <= prev) ordered = false;
+        prev = key;
+    });
+    REQUIRE(ordered);
+    REQUIRE(count == sixth.size());
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <filesystem>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+TEST_CASE("FeatureStore::openSingle")
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 500;
+    SyntheticGol gol(settings);
+    const std::string& fileName = gol.fileName();
+
+    FeatureStore* store = FeatureStore::openSingle(fileName);
+    FeatureStore* again = FeatureStore::openSingle(fileName);
+    REQUIRE(again == store);
+    again->release();
+
+    const FeatureStore::OpenTimes& times = store->openTimes();
+    REQUIRE(times.totalNanos > 0);
+    REQUIRE(times.totalNanos >= times.resolveNanos + times.stringsNanos +
+        times.schemaNanos + times.hintsNanos);
+    clarisma::MetricsSnapshot metrics = store->metrics().snapshot();
+    REQUIRE(metrics.valueOf("geodesk_open_seconds") == times.totalNanos / 1e9);
+    REQUIRE(metrics.valueOf("geodesk_executor_queue_depth") == 0);
+
+    // The string table is hashed by the first lookup
+    Key highway = store->key("highway");
+    REQUIRE(highway.code() > 0);
+    REQUIRE(store->key("no_such_key").code() < 0);
+    int indexedKeys = 0;
+    for (uint32_t code = 0; code < store->strings().stringCount(); code++)
+    {
+        int category = store->getIndexCategory(code);
+        indexedKeys += category != 0;
+        REQUIRE(store->keyIndexBits(code) == IndexBits::fromCategory(category));
+    }
+    REQUIRE(indexedKeys > 0);
+    REQUIRE(store->getIndexCategory(0xffff) == 0);
+    REQUIRE(store->keyIndexBits(-1) == 0);
+
+    // The executor starts on first use
+    REQUIRE(store->executor().threadCount() > 0);
+    store->release();
+
+    // Once released, the file is opened anew
+    store = FeatureStore::openSingle(fileName);
+    REQUIRE(store->openTimes().totalNanos > 0);
+    store->release();
+}
+
+TEST_CASE("FeatureStore::hotSwap")
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 200;
+    SyntheticGol oldGol(settings);
+    settings.nodesPerTile = 500;
+    SyntheticGol newGol(settings);
+    std::string oldFile = oldGol.fileName();
+    std::string newFile = newGol.fileName();
+
+    // (Files named after a generated GOL are removed along with it)
+    std::string name = newFile + ".world.gol";
+    REQUIRE_THROWS_AS(FeatureStore::openSingle(name), clarisma::FileNotFoundException);
+
+    // The logical name doesn't have to be a file
+    FeatureStore::hotSwap(name, oldFile)->release();
+    Features before(name.c_str());
+    uint64_t oldCount = before("n").count();
+    REQUIRE(oldCount > 0);
+    (void)before("n").first();      // (so the old store has hot tiles)
+
+    FeatureStore* store = FeatureStore::hotSwap(name, newFile);
+    Features after(name.c_str());
+    REQUIRE(after.store() == store);
+    REQUIRE(before.store() != store);
+    REQUIRE(after("n").count() > oldCount);
+    // Queries on the replaced store keep working
+    REQUIRE(before("n").count() == oldCount);
+    before = after;
+    REQUIRE(Features(name.c_str()).store() == store);
+    store->release();
+
+    // Swapping in a file that was replaced since it was opened
+    std::string tempFile = newFile + ".temp.gol";
+    std::filesystem::copy_file(oldFile, tempFile,
+        std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::rename(tempFile, newFile);
+    FeatureStore* reloaded = FeatureStore::hotSwap(newFile, newFile);
+    REQUIRE(Features(newFile.c_str())("n").count() == oldCount);
+    reloaded->release();
+}
@@ -0,0 +1,176 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/feature/FeatureStore_v2.h>
+
+using namespace geodesk;
+
+namespace {
+
+constexpr uint32_t TILE_COUNT = 32;
+constexpr size_t TILE_SIZE = 100;
+
+/// Supplies tiles whose bytes are all set to their TIP (after a
+/// short delay), and keeps track of its fetches
+class FakeTileSource : public v2::TileSource
+{
+public:
+    explicit FakeTileSource(uint32_t failingTip = 0) : failingTip_(failingTip) {}
+
+    clarisma::ByteBlock fetchTile(Tip tip) override
+    {
+        int inFlight = ++inFlight_;
+        int max = maxInFlight.load();
+        while (inFlight > max && !maxInFlight.compare_exchange_weak(max, inFlight)) {}
+        fetches[tip]++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        inFlight_--;
+        if (tip == failingTip_) throw std::runtime_error("Tile server unavailable");
+        clarisma::ByteBlock data(TILE_SIZE);
+        memset(data.data(), static_cast<int>(tip), TILE_SIZE);
+        return data;
+    }
+
+    std::atomic<int> fetches[TILE_COUNT + 1] = {};
+    std::atomic<int> maxInFlight = 0;
+
+private:
+    uint32_t failingTip_;
+    std::atomic<int> inFlight_ = 0;
+};
+
+/// An empty v2 store (all of whose tiles are missing) in the temporary
+/// directory, which is removed along with its journal when this object
+/// is destroyed
+class EmptyStore
+{
+public:
+    EmptyStore()
+    {
+        fileName_ = (std::filesystem::temp_directory_path() /
+            ("geodesk-test-v2-" + std::to_string(std::random_device()()) + ".gol")).string();
+        std::vector<uint32_t> tileIndex(TILE_COUNT + 1, 0);
+        tileIndex[0] = TILE_COUNT;
+        uint8_t strings[] = { 0 };      // no global strings
+        v2::FeatureStore::CreateTransaction tx;
+        tx.begin(fileName_.c_str(), ZoomLevels(ZoomLevels::DEFAULT),
+            tileIndex.data(), strings, sizeof(strings));
+        tx.commit();
+        tx.end();
+
+        store_ = new v2::FeatureStore();
+        store_->open(fileName_.c_str(),
+            clarisma::File::OpenMode::READ | clarisma::File::OpenMode::WRITE);
+    }
+
+    ~EmptyStore()
+    {
+        store_->release();
+        std::error_code error;
+        std::filesystem::remove(fileName_, error);
+        std::filesystem::remove(fileName_ + ".journal", error);
+    }
+
+    v2::FeatureStore* operator->() const { return store_; }
+    v2::FeatureStore* get() const { return store_; }
+
+    /// The first byte of the tile's data (which the fake source
+    /// sets to its TIP)
+    static int firstByte(DataPtr pTile)
+    {
+        // (The data follows the 8-byte header of the blob)
+        return (pTile + 8).getByte();
+    }
+
+private:
+    std::string fileName_;
+    v2::FeatureStore* store_;
+};
+
+std::vector<Tip> allTips()
+{
+    std::vector<Tip> tips;
+    for (uint32_t tip = 1; tip <= TILE_COUNT; tip++) tips.push_back(Tip(tip));
+    return tips;
+}
+
+} // namespace
+
+TEST_CASE("Threads that need the same missing tile fetch it once")
+{
+    EmptyStore store;
+    auto source = std::make_shared<FakeTileSource>();
+    store->setTileSource(source, 4);
+    REQUIRE(store->tileIndexEntry(Tip(5)).status() == v2::TileIndexEntry::MISSING_OR_STALE);
+
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; i++)
+    {
+        threads.emplace_back([&store, &mismatches]()
+        {
+            v2::FeatureStore::ReadGuard guard(store.get());
+            mismatches += EmptyStore::firstByte(store->fetchTile(Tip(5))) != 5;
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    REQUIRE(mismatches == 0);
+    REQUIRE(source->fetches[5] == 1);
+    REQUIRE(store->tileIndexEntry(Tip(5)).status() == v2::TileIndexEntry::CURRENT);
+
+    // Once installed, the tile is no longer fetched
+    v2::FeatureStore::ReadGuard guard(store.get());
+    REQUIRE(EmptyStore::firstByte(store->fetchTile(Tip(5))) == 5);
+    REQUIRE(source->fetches[5] == 1);
+}
+
+TEST_CASE("Prefetching stays within the limit of concurrent fetches")
+{
+    EmptyStore store;
+    auto source = std::make_shared<FakeTileSource>();
+    store->setTileSource(source, 3);
+    REQUIRE(store->prefetchTiles(allTips()) == TILE_COUNT);
+    REQUIRE(source->maxInFlight <= 3);
+    REQUIRE(source->maxInFlight > 1);
+
+    v2::FeatureStore::ReadGuard guard(store.get());
+    for (uint32_t tip = 1; tip <= TILE_COUNT; tip++)
+    {
+        REQUIRE(source->fetches[tip] == 1);
+        REQUIRE(EmptyStore::firstByte(store->fetchTile(Tip(tip))) == static_cast<int>(tip));
+    }
+
+    // Tiles that are present are skipped
+    REQUIRE(store->prefetchTiles(allTips()) == 0);
+}
+
+TEST_CASE("A tile that can't be fetched fails the threads that need it")
+{
+    EmptyStore store;
+    auto source = std::make_shared<FakeTileSource>(7);
+    store->setTileSource(source, 2);
+    {
+        v2::FeatureStore::ReadGuard guard(store.get());
+        REQUIRE_THROWS_AS(store->fetchTile(Tip(7)), std::runtime_error);
+        REQUIRE(store->tileIndexEntry(Tip(7)).status() == v2::TileIndexEntry::MISSING_OR_STALE);
+
+        // The failed fetch frees its slot, and the tile is fetched
+        // again the next time it is needed
+        REQUIRE(EmptyStore::firstByte(store->fetchTile(Tip(8))) == 8);
+        REQUIRE_THROWS_AS(store->fetchTile(Tip(7)), std::runtime_error);
+        REQUIRE(source->fetches[7] == 2);
+    }
+    REQUIRE_THROWS_AS(store->prefetchTiles(allTips()), std::runtime_error);
+    REQUIRE(store->tileIndexEntry(Tip(7)).status() == v2::TileIndexEntry::MISSING_OR_STALE);
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+using namespace geodesk::keys;
+
+namespace {
+
+std::string str(TagValue v)
+{
+    return v;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "String keys give the same results as Keys")
+{
+    Key amenity = world.key("amenity");
+    Key highway = world.key("highway");
+    uint64_t count = 0;
+    for (Feature f : world)
+    {
+        REQUIRE(str(f["amenity"_key]) == str(f[amenity]));
+        REQUIRE(str(f["highway"]) == str(f[highway]));
+        REQUIRE(f.hasTag("amenity"_key) == f.hasTag(amenity));
+        REQUIRE(f.tags().hasTag("highway") == f.hasTag(highway));
+        if (f.hasTag(amenity)) count++;
+    }
+    REQUIRE(count > 0);
+}
+
+TEST_CASE_METHOD(World, "A reused key buffer is resolved again")
+{
+    Key amenity = world.key("amenity");
+    Key highway = world.key("highway");
+    // The cache is keyed by address, so changing the contents of a
+    // buffer must not return the code of the previous key
+    char buf[16];
+    for (Feature f : world)
+    {
+        std::strcpy(buf, "amenity");
+        REQUIRE(str(f[std::string_view(buf)]) == str(f[amenity]));
+        std::strcpy(buf, "highway");
+        REQUIRE(str(f[std::string_view(buf)]) == str(f[highway]));
+        // A key that isn't a global string (and can't be cached)
+        std::strcpy(buf, "no_such_key");
+        REQUIRE(!f.hasTag(std::string_view(buf)));
+    }
+}
@@ -0,0 +1,208 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/LineMerger.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/format/GeoJsonWriter.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+void addWay(LineMerger::Batch* batch, uint64_t id, std::string_view group,
+    std::vector<Coordinate> coords)
+{
+    batch->addWay(id, group, coords.data(), coords.size());
+}
+
+/// Finds the line that contains the given way
+size_t lineOf(const MergedLines& lines, uint64_t way)
+{
+    for (size_t i = 0; i < lines.lineCount(); i++)
+    {
+        for (uint64_t id : lines.ways(i))
+        {
+            if (id == way) return i;
+        }
+    }
+    FAIL("way not found");
+    return 0;
+}
+
+std::vector<uint64_t> sortedWays(const MergedLines& lines, size_t i)
+{
+    std::vector<uint64_t> ways(lines.ways(i).begin(), lines.ways(i).end());
+    std::sort(ways.begin(), ways.end());
+    return ways;
+}
+
+/// The lines as sets of ways (for comparing results regardless of the
+/// direction of the lines)
+std::set<std::pair<std::string, std::vector<uint64_t>>> waySets(const MergedLines& lines)
+{
+    std::set<std::pair<std::string, std::vector<uint64_t>>> sets;
+    for (size_t i = 0; i < lines.lineCount(); i++)
+    {
+        sets.emplace(std::string(lines.group(i)), sortedWays(lines, i));
+    }
+    return sets;
+}
+
+MergedLines mergeSample(bool directed)
+{
+    LineMerger merger(directed);
+    LineMerger::Batch* batch1 = merger.acquire();
+    LineMerger::Batch* batch2 = merger.acquire();
+
+    // A line split across batches, with its last way reversed
+    addWay(batch1, 1, "Main", { {0, 0}, {5, 0}, {10, 0} });
+    addWay(batch2, 2, "Main", { {10, 0}, {20, 0} });
+    addWay(batch1, 3, "Main", { {30, 0}, {20, 0} });
+
+    // Three ways meet at a junction
+    addWay(batch1, 4, "Main", { {100, 100}, {100, 200} });
+    addWay(batch2, 5, "Main", { {100, 100}, {200, 100} });
+    addWay(batch2, 6, "Main", { {0, 100}, {100, 100} });
+
+    // Ways of different groups
+    addWay(batch1, 7, "High", { {200, 0}, {210, 0} });
+    addWay(batch2, 8, "Low", { {210, 0}, {220, 0} });
+
+    // A ring formed by two ways
+    addWay(batch2, 9, "Ring", { {300, 0}, {310, 0}, {310, 10} });
+    addWay(batch1, 10, "Ring", { {310, 10}, {300, 10}, {300, 0} });
+
+    merger.release(batch1);
+    merger.release(batch2);
+    return merger.merge(2);
+}
+
+} // namespace
+
+TEST_CASE("LineMerger joins ways where exactly two of them end")
+{
+    MergedLines lines = mergeSample(false);
+    REQUIRE(lines.lineCount() == 7);
+
+    size_t main = lineOf(lines, 1);
+    REQUIRE(lines.group(main) == "Main");
+    REQUIRE((sortedWays(lines, main) == std::vector<uint64_t>{ 1, 2, 3 }));
+    std::span<const Coordinate> coords = lines.line(main);
+    REQUIRE(coords.size() == 5);
+    std::vector<Coordinate> expected { {0, 0}, {5, 0}, {10, 0}, {20, 0}, {30, 0} };
+    if (coords.front() != expected.front()) std::reverse(expected.begin(), expected.end());
+    REQUIRE(std::equal(coords.begin(), coords.end(), expected.begin()));
+    REQUIRE(!lines.isClosed(main));
+
+    REQUIRE(lines.ways(lineOf(lines, 4)).size() == 1);
+    REQUIRE(lines.ways(lineOf(lines, 5)).size() == 1);
+    REQUIRE(lines.ways(lineOf(lines, 6)).size() == 1);
+    REQUIRE(lineOf(lines, 7) != lineOf(lines, 8));
+
+    size_t ring = lineOf(lines, 9);
+    REQUIRE(lineOf(lines, 10) == ring);
+    REQUIRE(lines.isClosed(ring));
+    REQUIRE(lines.line(ring).size() == 5);
+
+    // Lines are ordered by group
+    for (size_t i = 1; i < lines.lineCount(); i++)
+    {
+        REQUIRE(lines.group(i - 1) <= lines.group(i));
+    }
+}
+
+TEST_CASE("LineMerger doesn't reverse directed ways")
+{
+    MergedLines lines = mergeSample(true);
+    size_t main = lineOf(lines, 1);
+    REQUIRE((sortedWays(lines, main) == std::vector<uint64_t>{ 1, 2 }));
+    REQUIRE(lines.line(main).front() == Coordinate(0, 0));
+    REQUIRE(lines.line(main).back() == Coordinate(20, 0));
+    REQUIRE(lines.ways(lineOf(lines, 3)).size() == 1);
+    // Ways 4 and 6 start/end at the junction, but so does way 5
+    REQUIRE(lines.ways(lineOf(lines, 6)).size() == 1);
+    REQUIRE(lines.isClosed(lineOf(lines, 9)));
+}
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.streetsPerTile = 300;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Features::mergedLines")
+{
+    Features streets = world("w[highway]");
+
+    MergedLines lines = streets.mergedLines("name");
+    REQUIRE(lines.lineCount() > 0);
+
+    // Every street appears in exactly one line, and each line has
+    // the coordinates of its ways (less the shared ones)
+    std::map<uint64_t, Feature> ways;
+    for (Feature way : streets) ways.emplace(way.id(), way);
+    size_t wayCount = 0;
+    for (size_t i = 0; i < lines.lineCount(); i++)
+    {
+        size_t coordCount = 1;
+        for (uint64_t id : lines.ways(i))
+        {
+            REQUIRE(ways.count(id) == 1);
+            Feature way = ways.at(id);
+            REQUIRE(std::string(way["name"]) == lines.group(i));
+            WayCoordinateIterator iter(WayPtr(way.ptr()));
+            coordCount += iter.coordinatesRemaining() - 1;
+            wayCount++;
+        }
+        REQUIRE(lines.line(i).size() == coordCount);
+    }
+    REQUIRE(wayCount == ways.size());
+    REQUIRE(lines.lineCount() < wayCount);
+
+    // Same result with a single batch and thread
+    LineMerger merger;
+    LineMerger::Batch* batch = merger.acquire();
+    for (auto& [id, way] : ways)
+    {
+        std::vector<Coordinate> coords;
+        WayCoordinateIterator iter(WayPtr(way.ptr()));
+        while (iter.coordinatesRemaining() > 0) coords.push_back(iter.next());
+        batch->addWay(id, std::string(way["name"]), coords.data(), coords.size());
+    }
+    merger.release(batch);
+    REQUIRE(waySets(merger.merge(1)) == waySets(lines));
+}
+
+TEST_CASE("Merged lines are written as GeoJSON")
+{
+    MergedLines lines = mergeSample(false);
+    clarisma::DynamicBuffer buf(1024);
+    {
+        GeoJsonWriter out(&buf);
+        out.pretty(false);
+        size_t main = lineOf(lines, 1);
+        out.writeAnonymousLine(lines.line(main), "name", lines.group(main));
+        out.flush();
+    }
+    std::string json(buf.data(), buf.length());
+    REQUIRE(json.find("\"type\":\"LineString\"") != std::string::npos);
+    REQUIRE(json.find("\"properties\":{\"name\":\"Main\"}") != std::string::npos);
+    REQUIRE(std::count(json.begin(), json.end(), '[') == 6);
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/MemberBatch.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 100;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 20;
+    settings.routesPerTile = 10;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::string roleOf(FeatureStore* store, const MemberBatch::Entry& entry)
+{
+    if (entry.roleCode >= 0)
+    {
+        return store->strings().getGlobalString(entry.roleCode)->toString();
+    }
+    return entry.localRole ? entry.localRole->toString() : std::string();
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "MemberBatch resolves the members of many relations")
+{
+    FeatureStore* store = world.store();
+    std::vector<RelationPtr> relations;
+    for (Feature rel : world.relations()) relations.push_back(RelationPtr(rel.ptr()));
+    REQUIRE(relations.size() > 100);
+
+    std::vector<MemberBatch::Entry> expected;
+    std::vector<std::string> expectedRoles;
+    for (uint32_t i = 0; i < relations.size(); i++)
+    {
+        Feature rel(store, relations[i]);
+        for (Feature member : rel.members())
+        {
+            expected.push_back({ member.ptr(), i, 0, nullptr });
+            expectedRoles.push_back(std::string(member.role()));
+        }
+    }
+
+    for (int threads : { 1, 4 })
+    {
+        std::vector<MemberBatch::Entry> members =
+            MemberBatch::membersOf(store, relations, threads);
+        REQUIRE(members.size() == expected.size());
+        bool same = true;
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            if (members[i].feature.ptr().ptr() != expected[i].feature.ptr().ptr() ||
+                members[i].parent != expected[i].parent ||
+                roleOf(store, members[i]) != expectedRoles[i])
+            {
+                same = false;
+            }
+        }
+        REQUIRE(same);
+    }
+}
+
+TEST_CASE_METHOD(World, "MemberBatch resolves the parents of many features")
+{
+    FeatureStore* store = world.store();
+    std::vector<FeaturePtr> features;
+    for (Feature f : world) features.push_back(f.ptr());
+
+    std::vector<MemberBatch::Entry> parents = MemberBatch::parentsOf(store, features);
+    size_t n = 0;
+    uint64_t parentCount = 0;
+    for (uint32_t i = 0; i < features.size(); i++)
+    {
+        Feature f(store, features[i]);
+        std::vector<const uint8_t*> expected;
+        for (Feature rel : f.parents().relations()) expected.push_back(rel.ptr().ptr().ptr());
+        std::vector<const uint8_t*> actual;
+        for (; n < parents.size() && parents[n].parent == i; n++)
+        {
+            actual.push_back(parents[n].feature.ptr().ptr());
+            REQUIRE(parents[n].roleCode == -1);
+        }
+        REQUIRE(actual == expected);
+        parentCount += expected.size();
+    }
+    REQUIRE(n == parents.size());
+    REQUIRE(parentCount > 100);
+
+    REQUIRE(MemberBatch::parentsOf(store, {}).empty());
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/NameIndex.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 100;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+/// A world whose name index has been built
+struct IndexedGol : SyntheticGol
+{
+    IndexedGol() : SyntheticGol(worldSettings())
+    {
+        Features world(fileName().c_str());
+        world.store()->buildNameIndex(2);
+    }
+};
+
+Features openWorld(bool withIndex)
+{
+    static const IndexedGol indexed;
+    static const SyntheticGol plain(worldSettings());
+    return Features((withIndex ? indexed.fileName() : plain.fileName()).c_str());
+}
+
+template<typename T>
+std::vector<uint64_t> typedIds(const std::vector<T>& features)
+{
+    std::vector<uint64_t> ids;
+    for (const T& f : features) ids.push_back(f.ptr().typedId());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/// The features whose name contains the text, found by scanning
+std::vector<uint64_t> scan(const Features& features, std::string_view text)
+{
+    std::string normalized = NameIndex::normalize(text);
+    std::vector<uint64_t> ids;
+    for (Feature f : features)
+    {
+        if (!f.hasTag("name")) continue;
+        std::string name = f["name"];
+        if (NameIndex::normalize(name).find(normalized) != std::string::npos)
+        {
+            ids.push_back(f.ptr().typedId());
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE("Name search finds the same features with and without an index")
+{
+    Features world = openWorld(true);
+    Features plain = openWorld(false);
+    const NameIndex* index = world.store()->nameIndex();
+    REQUIRE(index != nullptr);
+    REQUIRE(index->trigramCount() > 0);
+    REQUIRE(plain.store()->nameIndex() == nullptr);
+
+    for (const char* text : { "bahnhof", "Mühlenweg", "stube", "hof", "am Pl",
+        "au", "zzz", "Bahnhofstraßen" })
+    {
+        std::vector<uint64_t> expected = scan(world, text);
+        REQUIRE(typedIds(world.searchNames(text)) == expected);
+        REQUIRE(typedIds(plain.searchNames(text)) == scan(plain, text));
+    }
+    REQUIRE(!world.searchNames("bahnhof").empty());
+    REQUIRE(world.searchNames("zzz").empty());
+}
+
+TEST_CASE("Name search ignores case and respects the collection")
+{
+    Features world = openWorld(true);
+    REQUIRE((typedIds(world.searchNames("MÜHLEN")) ==
+        typedIds(world.searchNames("mühlen"))));
+    REQUIRE(!world.searchNames("MÜHLEN").empty());
+
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    Features streets = world("w[highway]")(bounds);
+    std::vector<uint64_t> expected = scan(streets, "weg");
+    REQUIRE(!expected.empty());
+    REQUIRE(typedIds(streets.searchNames("weg")) == expected);
+    REQUIRE(typedIds(world.nodes().searchNames("Eck")) == scan(world.nodes(), "Eck"));
+}
@@ -0,0 +1,189 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/NumericIndex.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 300;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+/// A world whose numeric index has been built
+struct IndexedGol : SyntheticGol
+{
+    IndexedGol() : SyntheticGol(worldSettings())
+    {
+        Features world(fileName().c_str());
+        world.store()->buildNumericIndex(
+            { "population", "maxspeed", "building:levels" }, 2);
+    }
+};
+
+Features openWorld(bool withIndex)
+{
+    static const IndexedGol indexed;
+    static const SyntheticGol plain(worldSettings());
+    return Features((withIndex ? indexed.fileName() : plain.fileName()).c_str());
+}
+
+std::vector<uint64_t> typedIds(const Features& features)
+{
+    std::vector<uint64_t> ids;
+    for (Feature f : features) ids.push_back(f.ptr().typedId());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+template<typename T>
+std::vector<uint64_t> typedIds(const std::vector<T>& features)
+{
+    std::vector<uint64_t> ids;
+    for (const T& f : features) ids.push_back(f.ptr().typedId());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/// The features whose value for the key lies within the range,
+/// found by scanning
+std::vector<uint64_t> scan(const Features& features, const char* key,
+    double min, double max)
+{
+    std::vector<uint64_t> ids;
+    for (Feature f : features)
+    {
+        if (!f.hasTag(key)) continue;
+        double value = f[key];
+        if (value >= min && value <= max) ids.push_back(f.ptr().typedId());
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE("Matchers know the numeric range they require")
+{
+    Features world = openWorld(false);
+    FeatureStore* store = world.store();
+    int maxspeed = store->key("maxspeed").code();
+    REQUIRE(maxspeed >= 0);
+
+    const auto* matcher = store->getMatcher("w[maxspeed>=30][maxspeed<80]");
+    NumericRange range = matcher->requiredRange();
+    matcher->release();
+    REQUIRE(range.isRequired());
+    REQUIRE(range.keyCode == maxspeed);
+    REQUIRE(range.min == 30);
+    REQUIRE(range.max == 80);
+
+    matcher = store->getMatcher("w[highway][maxspeed>100]");
+    range = matcher->requiredRange();
+    matcher->release();
+    REQUIRE(range.keyCode == maxspeed);
+    REQUIRE(range.min == 100);
+    REQUIRE(std::isinf(range.max));
+
+    for (const char* query : { "w[highway]", "w[maxspeed]", "w[maxspeed!=50]",
+        "w[maxspeed<30], w[maxspeed>100]" })
+    {
+        matcher = store->getMatcher(query);
+        REQUIRE(!matcher->requiredRange().isRequired());
+        matcher->release();
+    }
+}
+
+TEST_CASE("Queries with numeric ranges find the same features with an index")
+{
+    Features world = openWorld(true);
+    Features plain = openWorld(false);
+    REQUIRE(world.store()->numericIndex() != nullptr);
+    REQUIRE(plain.store()->numericIndex() == nullptr);
+    const NumericIndex* index = world.store()->numericIndex();
+    REQUIRE(index->keyCount() == 3);
+    REQUIRE(index->findKey("maxspeed") == 1);
+    REQUIRE(index->keyName(2) == "building:levels");
+    REQUIRE(index->findKey("lanes") < 0);
+    REQUIRE(index->valueCount(0) > 0);
+
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    for (const char* query : { "w[maxspeed>100]", "w[maxspeed>=30][maxspeed<=50]",
+        "n[population>10000]", "a[building:levels=3]", "w[highway][maxspeed<40]",
+        "w[lanes>2]", "n[population<0]" })
+    {
+        std::vector<uint64_t> expected = typedIds(plain(query));
+        REQUIRE(typedIds(world(query)) == expected);
+        REQUIRE(typedIds(world(query)(bounds)) == typedIds(plain(query)(bounds)));
+    }
+}
+
+TEST_CASE("A numeric index lets queries skip tiles outside the range")
+{
+    Features world = openWorld(true);
+    FeatureStore* store = world.store();
+    std::vector<double> populations;
+    for (Feature f : world("n[population]")) populations.push_back(f["population"]);
+    REQUIRE(!populations.empty());
+    std::sort(populations.begin(), populations.end());
+    double threshold = populations[populations.size() * 99 / 100];
+
+    std::string query = "n[population>=" + std::to_string(
+        static_cast<int64_t>(threshold)) + "]";
+    const auto* matcher = store->getMatcher(query.c_str());
+    QueryStats stats;
+    uint64_t count = 0;
+    {
+        Query q(store, Box::ofWorld(), matcher->acceptedTypes(),
+            matcher, nullptr, nullptr, &stats);
+        while (!q.next().isNull()) count++;
+    }
+    matcher->release();
+    REQUIRE(count > 0);
+    REQUIRE(count == scan(world.nodes(), "population", threshold, INFINITY).size());
+    REQUIRE(stats.tilesSkipped > 0);
+}
+
+TEST_CASE("Features in a numeric range are looked up via the index")
+{
+    Features world = openWorld(true);
+    Features plain = openWorld(false);
+    struct { const char* key; double min; double max; } ranges[] =
+    {
+        { "maxspeed", 30, 50 },
+        { "maxspeed", 120, 1000 },
+        { "population", 1000, 50000 },
+        { "building:levels", 2, 2 },
+        { "lanes", 2, 3 },              // not indexed
+        { "population", -10, -1 },
+    };
+    for (const auto& r : ranges)
+    {
+        std::vector<uint64_t> expected = scan(plain, r.key, r.min, r.max);
+        REQUIRE(typedIds(world.searchRange(r.key, r.min, r.max)) == expected);
+        REQUIRE(typedIds(plain.searchRange(r.key, r.min, r.max)) == expected);
+    }
+    REQUIRE(!world.searchRange("maxspeed", 30, 50).empty());
+
+    Features streets = world("w[highway]");
+    REQUIRE(typedIds(streets.searchRange("maxspeed", 30, 50)) ==
+        scan(streets, "maxspeed", 30, 50));
+    Features inBounds = world(Box::ofWSEN(7.2, 43.7, 7.6, 44.1));
+    REQUIRE(typedIds(inBounds.searchRange("population", 0, 1e9)) ==
+        scan(inBounds, "population", 0, 1e9));
+}
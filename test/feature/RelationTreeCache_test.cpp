@@ -0,0 +1,135 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/RelationTreeCache.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+Features nonAreaRelations(const Features& world)
+{
+    return world.relations().filter([](const Feature& f) { return !f.isArea(); });
+}
+
+bool isClose(double a, double b)
+{
+    return std::abs(a - b) <= 1e-9 * std::max(std::abs(a), std::abs(b)) + 1e-6;
+}
+
+std::set<uint64_t> idsOf(const Features& features)
+{
+    std::set<uint64_t> ids;
+    for (Feature f : features) ids.insert(f.ptr().typedId());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Cached relation trees give the same lengths and centroids")
+{
+    Features relations = nonAreaRelations(world);
+    std::map<uint64_t, double> lengths;
+    std::map<uint64_t, Coordinate> centroids;
+    for (Feature rel : relations)
+    {
+        lengths[rel.ptr().typedId()] = rel.length();
+        centroids[rel.ptr().typedId()] = rel.centroid();
+    }
+    REQUIRE(!lengths.empty());
+
+    FeatureStore* store = world.store();
+    store->enableRelationTreeCache(1 << 20, 1);
+    // Twice, so the second pass is served from the cache
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (Feature rel : relations)
+        {
+            REQUIRE(isClose(rel.length(), lengths[rel.ptr().typedId()]));
+            Coordinate c = rel.centroid();
+            Coordinate expected = centroids[rel.ptr().typedId()];
+            REQUIRE(std::abs(c.x - expected.x) <= 1);
+            REQUIRE(std::abs(c.y - expected.y) <= 1);
+        }
+    }
+    REQUIRE(store->memoryUsage().relationTreeCache > 0);
+    store->enableRelationTreeCache(0);
+}
+
+
+TEST_CASE_METHOD(World, "A relation tree is walked once and shared")
+{
+    FeatureStore* store = world.store();
+    store->enableRelationTreeCache(1 << 20, 1);
+    RelationTreeCache* cache = store->relationTreeCache();
+    REQUIRE(cache != nullptr);
+    for (Feature rel : nonAreaRelations(world))
+    {
+        RelationPtr relation(rel.ptr());
+        auto leaves = cache->leaves(store, relation);
+        REQUIRE(!leaves->empty());
+        REQUIRE(cache->leaves(store, relation) == leaves);
+        RelationTreeCache::Leaves walked;
+        RelationTreeCache::collect(store, relation, walked);
+        REQUIRE(walked.size() == leaves->size());
+        for (size_t i = 0; i < walked.size(); i++)
+        {
+            REQUIRE(walked[i].ptr() == (*leaves)[i].ptr());
+        }
+        for (FeaturePtr leaf : *leaves) REQUIRE(!leaf.isRelation());
+    }
+    store->enableRelationTreeCache(0);
+    REQUIRE(store->relationTreeCache() == nullptr);
+    REQUIRE(RelationTreeCache::leavesOf(store, RelationPtr(
+        nonAreaRelations(world).first()->ptr())) == nullptr);
+}
+
+
+TEST_CASE_METHOD(World, "Small relation trees are not cached")
+{
+    FeatureStore* store = world.store();
+    store->enableRelationTreeCache(1 << 20, 1'000'000);
+    for (Feature rel : nonAreaRelations(world)) (void)rel.length();
+    REQUIRE(store->memoryUsage().relationTreeCache == 0);
+
+    // A cache too small for a single tree never holds more than its limit
+    store->enableRelationTreeCache(64, 1);
+    for (Feature rel : nonAreaRelations(world)) (void)rel.length();
+    REQUIRE(store->memoryUsage().relationTreeCache <= 64);
+    store->enableRelationTreeCache(0);
+}
+
+
+TEST_CASE_METHOD(World, "within() accepts the same relations with cached trees")
+{
+    Features areas = world.ways().filter([](const Feature& f) { return f.isArea(); });
+    double maxArea = 0;
+    for (Feature f : areas) maxArea = std::max(maxArea, f.area());
+    for (Feature area : areas)
+    {
+        if (area.area() != maxArea) continue;
+        Features relations = nonAreaRelations(world);
+        std::set<uint64_t> expected = idsOf(relations.within(area));
+        world.store()->enableRelationTreeCache(1 << 20, 1);
+        REQUIRE(idsOf(relations.within(area)) == expected);
+        REQUIRE(idsOf(relations.within(area)) == expected);
+        world.store()->enableRelationTreeCache(0);
+        break;
+    }
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/ResidencyProfiler.h>
+#include <geodesk/query/TileIndexWalker.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+TEST_CASE("ResidencyProfiler")
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 500;
+    settings.buildingsPerTile = 500;
+    SyntheticGol gol(settings);
+    {
+        Features world(gol.fileName().c_str());
+        FeatureStore* store = world.store();
+
+        FeatureStore::ResidencyReport report = store->residency();
+        REQUIRE(report.tileIndex.bytes > 0);
+        REQUIRE(report.strings.bytes > 0);
+        REQUIRE(report.tileCount > 0);
+        uint64_t tileCount = 0;
+        uint64_t tileBytes = 0;
+        for (int zoom = 0; zoom <= report.MAX_ZOOM; zoom++)
+        {
+            tileCount += report.tileCountByZoom[zoom];
+            tileBytes += report.tilesByZoom[zoom].bytes;
+        }
+        REQUIRE(tileCount == report.tileCount);
+        REQUIRE(tileBytes == report.tiles.bytes);
+
+        ResidencyProfiler profiler(store, Box::ofWorld());
+        // Touch every page of every tile
+        uint64_t sum = 0;
+        TileIndexWalker walker(store->tileIndex(), store->zoomLevels(), Box::ofWorld(), nullptr);
+        while (walker.next())
+        {
+            DataPtr pTile = store->fetchTile(walker.currentTip());
+            uint32_t size = pTile.getUnsignedInt() & 0x3fff'ffff;
+            for (uint32_t ofs = 0; ofs < size; ofs += 512) sum += *(pTile + ofs).ptr();
+        }
+        ResidencyProfiler::Report result = profiler.finish();
+        REQUIRE(sum > 0);
+        REQUIRE(result.tiles == report.tileCount);
+        REQUIRE(result.tileBytes == report.tiles.bytes);
+        REQUIRE(result.residentAfter == result.tileBytes);
+        REQUIRE(result.residentAfter >= result.residentBefore);
+        REQUIRE(result.wallSeconds > 0);
+    }
+}
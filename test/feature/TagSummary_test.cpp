@@ -0,0 +1,33 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/feature/TagSummary.h>
+
+using namespace geodesk;
+
+TEST_CASE("TagSummary has no false negatives")
+{
+    uint64_t bits[TagSummary::WORDS_PER_TILE] = {};
+    for (uint32_t key = 0; key < 20; key++)
+    {
+        for (uint32_t value = 0; value < 10; value++)
+        {
+            TagSummary::add(bits, key, value * 7);
+        }
+    }
+    int falsePositives = 0;
+    for (uint32_t key = 0; key < 20; key++)
+    {
+        for (uint32_t value = 0; value < 70; value++)
+        {
+            bool present = (value % 7) == 0;
+            bool mayContain = TagSummary::mayContain(bits, key, value);
+            if (present) REQUIRE(mayContain);
+            falsePositives += !present && mayContain;
+        }
+    }
+    // 200 tags in 2048 bits, with 3 hashes: about 2% of
+    // the 1200 absent tags should be false positives
+    REQUIRE(falsePositives < 120);
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/alloc/Arena.h>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.optionalTagShare = 0.8;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Tags materialized as views in an Arena")
+{
+    clarisma::Arena arena;
+    uint64_t tagCount = 0;
+    int batch = 0;
+    for (Feature f : world)
+    {
+        Tags tags = f.tags();
+        auto views = tags.toViews(arena);
+        std::vector<std::pair<std::string, std::string>> expected = tags;
+        REQUIRE(views.size() == expected.size());
+        for (size_t i = 0; i < views.size(); i++)
+        {
+            REQUIRE(views[i].first == expected[i].first);
+            REQUIRE(views[i].second == expected[i].second);
+        }
+        tagCount += views.size();
+        if (++batch == 1000)
+        {
+            arena.clear();
+            batch = 0;
+        }
+    }
+    REQUIRE(tagCount > 1000);
+}
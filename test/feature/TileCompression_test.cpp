@@ -0,0 +1,62 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifdef GEODESK_WITH_ZLIB
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <vector>
+#include <clarisma/io/IOException.h>
+#include <geodesk/feature/TileCompression.h>
+
+using namespace geodesk;
+
+namespace {
+
+/// A blob with a header and a somewhat repetitive payload
+std::vector<uint8_t> makeBlob(uint32_t payloadSize, uint32_t seed)
+{
+    std::vector<uint8_t> blob(payloadSize + 4);
+    memcpy(blob.data(), &payloadSize, 4);
+    for (uint32_t i = 0; i < payloadSize; i++)
+    {
+        blob[i + 4] = static_cast<uint8_t>((i % 61) * seed + (i / 256));
+    }
+    return blob;
+}
+
+} // namespace
+
+TEST_CASE("TileCompression round trip")
+{
+    std::vector<uint8_t> blob = makeBlob(100'000, 7);
+    TileCompression compression;
+    std::vector<uint8_t> compressed = compression.compress(blob.data());
+    REQUIRE(TileCompression::isCompressed(compressed.data()));
+    REQUIRE(compressed.size() < blob.size() / 4);
+    REQUIRE(TileCompression::uncompressedSize(compressed.data()) == blob.size());
+
+    std::vector<uint8_t> restored(blob.size());
+    compression.decompress(compressed.data(), restored.data());
+    REQUIRE(restored == blob);
+}
+
+TEST_CASE("TileCompression with a dictionary")
+{
+    std::vector<uint8_t> sample = makeBlob(4000, 3);
+    std::vector<uint8_t> blob = makeBlob(2000, 3);
+    TileCompression plain;
+    TileCompression withDictionary(std::vector<uint8_t>(sample.begin() + 4, sample.end()));
+    std::vector<uint8_t> compressed = withDictionary.compress(blob.data());
+    REQUIRE(compressed.size() < plain.compress(blob.data()).size());
+
+    std::vector<uint8_t> restored(blob.size());
+    withDictionary.decompress(compressed.data(), restored.data());
+    REQUIRE(restored == blob);
+
+    // Without the dictionary, the tile can't be read
+    REQUIRE_THROWS_AS(plain.decompress(compressed.data(), restored.data()),
+        clarisma::IOException);
+}
+
+#endif // GEODESK_WITH_ZLIB
@@ -0,0 +1,105 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/TileStatistics.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+/// A world whose tile statistics have been built
+struct StatisticsGol : SyntheticGol
+{
+    StatisticsGol() : SyntheticGol(worldSettings())
+    {
+        Features world(fileName().c_str());
+        world.store()->buildTileStatistics(2);
+    }
+};
+
+Features openWorld()
+{
+    static const StatisticsGol gol;
+    return Features(gol.fileName().c_str());
+}
+
+int keyCode(FeatureStore* store, const char* key)
+{
+    return store->strings().getCode(key, std::strlen(key));
+}
+
+} // namespace
+
+TEST_CASE("Tile statistics count the features of a store")
+{
+    Features world = openWorld();
+    FeatureStore* store = world.store();
+    const TileStatistics* stats = store->tileStatistics();
+    REQUIRE(stats != nullptr);
+
+    uint64_t nodes = 0;
+    uint64_t ways = 0;
+    uint64_t all = 0;
+    uint64_t amenities = 0;
+    for (Feature f : world)
+    {
+        all++;
+        if (f.isNode()) nodes++;
+        if (f.isWay()) ways++;
+        if (f.hasTag("amenity")) amenities++;
+    }
+    REQUIRE(world.count() == all);
+    REQUIRE(world.nodes().count() == nodes);
+    // Ways are split across two indexes (ways and areas), which the
+    // statistics can't tell apart, so this count requires a scan
+    REQUIRE(!stats->count(FeatureTypes::WAYS));
+    REQUIRE(world.ways().count() == ways);
+
+    TileStatistics::Totals totals = stats->sum(store, Box::ofWorld());
+    REQUIRE(totals.exact);
+    REQUIRE(totals.count(FeatureTypes::ALL) == all);
+    int amenity = keyCode(store, "amenity");
+    REQUIRE(amenity >= 0);
+    REQUIRE(amenity < TileStatistics::POPULAR_KEYS);
+    REQUIRE(totals.keys[amenity] == amenities);
+    int category = store->getIndexCategory(amenity);
+    REQUIRE(category > 0);
+    REQUIRE(totals.categories[category - 1] == amenities);
+    double sized = 0;
+    for (double n : totals.sizes) sized += n;
+    REQUIRE(sized == all - nodes);
+
+    Box region = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    TileStatistics::Totals partial = stats->sum(store, region);
+    REQUIRE(!partial.exact);
+    REQUIRE(partial.features[0] > 0);
+    REQUIRE(partial.features[0] < totals.features[0]);
+}
+
+TEST_CASE("Queries skip tiles without the keys their matcher requires")
+{
+    Features world = openWorld();
+    uint64_t shops = 0;
+    for (Node node : world.nodes())
+    {
+        if (node.hasTag("shop")) shops++;
+    }
+    REQUIRE(world("n[shop]").count() == shops);
+
+    // Only relations are tagged `boundary`
+    QueryStats stats = world("n[boundary]").profile();
+    REQUIRE(stats.results == 0);
+    REQUIRE(stats.tilesSkipped > 0);
+    REQUIRE(stats.tilesScanned == 0);
+}
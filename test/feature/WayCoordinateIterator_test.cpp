@@ -0,0 +1,93 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <vector>
+#include <clarisma/util/varint.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+
+using namespace clarisma;
+using namespace geodesk;
+
+static std::vector<uint8_t> encodeWay(const std::vector<Coordinate>& coords)
+{
+    std::vector<uint8_t> buf(coords.size() * 10 + 16);
+    uint8_t* p = buf.data();
+    writeVarint(p, coords.size());
+    int32_t prevX = 0;
+    int32_t prevY = 0;
+    for (Coordinate c : coords)
+    {
+        writeSignedVarint(p, static_cast<int64_t>(c.x) - prevX);
+        writeSignedVarint(p, static_cast<int64_t>(c.y) - prevY);
+        prevX = c.x;
+        prevY = c.y;
+    }
+    return buf;
+}
+
+static std::vector<Coordinate> randomWay(std::mt19937& random, int count)
+{
+    std::uniform_int_distribution<int32_t> delta(-200000, 200000);
+    std::uniform_int_distribution<int32_t> nearby(-60, 60);
+    std::vector<Coordinate> coords;
+    int32_t x = 1'000'000;
+    int32_t y = -5'000'000;
+    for (int i = 0; i < count; i++)
+    {
+        // mix of short (1-byte) and longer (3-byte) deltas
+        bool isShort = (i % 3) != 0;
+        x += isShort ? nearby(random) : delta(random);
+        y += isShort ? nearby(random) : delta(random);
+        coords.emplace_back(x, y);
+    }
+    return coords;
+}
+
+TEST_CASE("WayCoordinateIterator::decode() matches next()")
+{
+    std::mt19937 random(7);
+    for (int count : { 2, 3, 5, 8, 63, 64, 65, 200 })
+    {
+        for (bool isArea : { false, true })
+        {
+            std::vector<Coordinate> coords = randomWay(random, count);
+            if (isArea) coords.back() = coords.front();
+            std::vector<uint8_t> encoded = encodeWay(isArea ?
+                std::vector<Coordinate>(coords.begin(), coords.end() - 1) : coords);
+
+            std::vector<Coordinate> expected;
+            WayCoordinateIterator iter;
+            iter.start(encoded.data(), 0, 0, isArea);
+            for (;;)
+            {
+                Coordinate c = iter.next();
+                if (c.isNull()) break;
+                expected.push_back(c);
+            }
+            REQUIRE(expected == coords);
+
+            for (int batchSize : { 1, 7, 64, 1000 })
+            {
+                std::vector<Coordinate> actual;
+                iter.start(encoded.data(), 0, 0, isArea);
+                Coordinate batch[1000];
+                for (;;)
+                {
+                    int n = iter.decode(batch, batchSize);
+                    if (n == 0) break;
+                    REQUIRE(n <= batchSize);
+                    actual.insert(actual.end(), batch, batch + n);
+                }
+                REQUIRE(actual == expected);
+            }
+
+            iter.start(encoded.data(), 0, 0, isArea);
+            std::vector<Coordinate> all(iter.coordinatesRemaining());
+            REQUIRE(iter.decodeAll(all.data()) == static_cast<int>(expected.size()));
+            REQUIRE(all == expected);
+            REQUIRE(iter.next().isNull());
+        }
+    }
+}
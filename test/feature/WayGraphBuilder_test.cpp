@@ -0,0 +1,81 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+#include <geodesk/feature/WayGraphBuilder.h>
+#include <geodesk/geom/Distance.h>
+
+using namespace geodesk;
+
+static size_t vertexAt(const WayGraph& graph, Coordinate c)
+{
+    for (size_t v = 0; v < graph.vertexCount(); v++)
+    {
+        if (graph.vertex(v) == c) return v;
+    }
+    FAIL("no vertex at location");
+    return 0;
+}
+
+TEST_CASE("WayGraphBuilder stitches ways at shared nodes")
+{
+    Coordinate a(0, 0), b(1000, 0), c(2000, 0), d(3000, 0);
+    Coordinate e(2000, 1000), f(2000, 2000);
+    Coordinate anonymous(1500, 0);
+
+    WayGraphBuilder builder;
+    WayGraphBuilder::Batch* batch1 = builder.acquire();
+    WayGraphBuilder::Batch* batch2 = builder.acquire();
+    std::vector<Coordinate> way1 { a, b, anonymous, c, d };
+    std::vector<Coordinate> way2 { f, e, c };
+    batch1->addWay(1, way1.data(), way1.size());
+    batch2->addWay(2, way2.data(), way2.size());
+    builder.release(batch1);
+    builder.release(batch2);
+    WayGraph graph = builder.build();
+
+    // a, d, f (ends) and c (shared); b, e and the anonymous
+    // node are interior nodes of a single way
+    REQUIRE(graph.vertexCount() == 4);
+    REQUIRE(graph.edgeCount() == 6);
+    REQUIRE(graph.offsets().size() == 5);
+    REQUIRE(graph.offsets().back() == 6);
+
+    size_t vc = vertexAt(graph, c);
+    REQUIRE(graph.edgesEnd(vc) - graph.edgesStart(vc) == 3);
+    double total = 0;
+    for (uint32_t i = graph.edgesStart(vc); i < graph.edgesEnd(vc); i++)
+    {
+        total += graph.length(i);
+        size_t target = graph.target(i);
+        REQUIRE(graph.way(i) == (graph.vertex(target) == f ? 2 : 1));
+    }
+    double expected = Distance::metersBetween(a, b) +
+        Distance::metersBetween(b, anonymous) +
+        Distance::metersBetween(anonymous, c) +
+        Distance::metersBetween(c, d) +
+        Distance::metersBetween(f, e) +
+        Distance::metersBetween(e, c);
+    REQUIRE(total > expected - 1e-6);
+    REQUIRE(total < expected + 1e-6);
+
+    size_t va = vertexAt(graph, a);
+    REQUIRE(graph.edgesEnd(va) - graph.edgesStart(va) == 1);
+    REQUIRE(graph.target(graph.edgesStart(va)) == vc);
+}
+
+TEST_CASE("WayGraphBuilder turns a closed way into a loop")
+{
+    Coordinate a(0, 0), b(1000, 0), c(1000, 1000);
+    WayGraphBuilder builder;
+    WayGraphBuilder::Batch* batch = builder.acquire();
+    std::vector<Coordinate> ring { a, b, c, a };
+    batch->addWay(7, ring.data(), ring.size());
+    builder.release(batch);
+    WayGraph graph = builder.build();
+    REQUIRE(graph.vertexCount() == 1);
+    REQUIRE(graph.edgeCount() == 2);
+    REQUIRE(graph.target(0) == 0);
+    REQUIRE(graph.way(1) == 7);
+}
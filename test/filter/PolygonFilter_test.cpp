@@ -0,0 +1,251 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+GolGenerator::Settings routeSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 50;
+    settings.streetsPerTile = 50;
+    settings.buildingsPerTile = 0;
+    settings.multipolygonsPerTile = 0;
+    settings.routesPerTile = 8;
+    return settings;
+}
+
+using RouteWorld = SyntheticGolFixture<routeSettings>;
+
+std::set<uint64_t> idsOf(const Features& features)
+{
+    std::set<uint64_t> ids;
+    for (Feature f : features) ids.insert(f.ptr().typedId());
+    return ids;
+}
+
+/// The coordinates of an area way, as an unclosed ring
+std::vector<Coordinate> ringOf(const Feature& area)
+{
+    std::vector<Coordinate> ring;
+    WayCoordinateIterator iter(WayPtr(area.ptr()));
+    while (iter.coordinatesRemaining() > 0) ring.push_back(iter.next());
+    ring.pop_back();    // drop the duplicate of the first coordinate
+    return ring;
+}
+
+std::vector<Coordinate> square(const Box& box)
+{
+    return { box.bottomLeft(), box.bottomRight(), box.topRight(), box.topLeft() };
+}
+
+/// A ring whose vertices alternate between two radii around the
+/// center, so its edges form many short monotone chains
+std::vector<Coordinate> gear(double lon, double lat, double radius, int vertexCount)
+{
+    std::vector<Coordinate> ring;
+    for (int i = 0; i < vertexCount; i++)
+    {
+        double angle = 2 * 3.141592653589793 * i / vertexCount;
+        double r = (i & 1) ? radius * 0.96 : radius;
+        ring.push_back(Coordinate::ofLonLat(lon + r * std::cos(angle),
+            lat + r * std::sin(angle) * 0.72));
+    }
+    return ring;
+}
+
+bool isInside(const std::vector<Coordinate>& ring, Coordinate c)
+{
+    bool inside = false;
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+    {
+        Coordinate a = ring[i];
+        Coordinate b = ring[j];
+        if ((a.y > c.y) != (b.y > c.y) &&
+            c.x < a.x + static_cast<double>(b.x - a.x) * (c.y - a.y) / (b.y - a.y))
+        {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+int64_t orientation(Coordinate a, Coordinate b, Coordinate c)
+{
+    int64_t d = static_cast<int64_t>(b.x - a.x) * (c.y - a.y) -
+        static_cast<int64_t>(b.y - a.y) * (c.x - a.x);
+    return (d > 0) - (d < 0);
+}
+
+bool crossesRing(const std::vector<Coordinate>& ring, Coordinate p, Coordinate q)
+{
+    for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+    {
+        Coordinate a = ring[i];
+        Coordinate b = ring[j];
+        if (orientation(p, q, a) != orientation(p, q, b) &&
+            orientation(a, b, p) != orientation(a, b, q))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<Coordinate> coordinatesOf(const Feature& way)
+{
+    std::vector<Coordinate> coords;
+    WayCoordinateIterator iter(WayPtr(way.ptr()));
+    while (iter.coordinatesRemaining() > 0) coords.push_back(iter.next());
+    return coords;
+}
+
+/// Checks a linear way or a route against the ring by brute force,
+/// returning 1 if all of its points lie inside, -1 if none lie inside
+/// and none of its segments cross the ring, and 0 otherwise
+int locate(const std::vector<Coordinate>& ring, const Feature& feature)
+{
+    bool anyInside = false;
+    bool anyOutside = false;
+    auto addWay = [&](const Feature& way)
+    {
+        std::vector<Coordinate> coords = coordinatesOf(way);
+        for (size_t i = 0; i < coords.size(); i++)
+        {
+            (isInside(ring, coords[i]) ? anyInside : anyOutside) = true;
+            if (i > 0 && crossesRing(ring, coords[i - 1], coords[i]))
+            {
+                anyInside = anyOutside = true;
+            }
+        }
+    };
+    if (feature.isWay())
+    {
+        addWay(feature);
+    }
+    else
+    {
+        for (Feature member : feature.members())
+        {
+            if (member.isWay())
+            {
+                addWay(member);
+            }
+            else
+            {
+                (isInside(ring, member.xy()) ? anyInside : anyOutside) = true;
+            }
+        }
+    }
+    if (!anyOutside) return 1;
+    return anyInside ? 0 : -1;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "A coordinate ring selects the same features as its area")
+{
+    Features areas = world.ways().filter([](const Feature& f) { return f.isArea(); });
+    double maxArea = 0;
+    for (Feature f : areas) maxArea = std::max(maxArea, f.area());
+    for (Feature area : areas)
+    {
+        if (area.area() != maxArea) continue;
+        std::vector<Coordinate> ring = ringOf(area);
+        REQUIRE(ring.size() >= 3);
+
+        std::set<uint64_t> within = idsOf(world.within(area));
+        std::set<uint64_t> intersecting = idsOf(world.intersecting(area));
+        REQUIRE(!intersecting.empty());
+        REQUIRE(idsOf(world.within(ring)) == within);
+        REQUIRE(idsOf(world.intersecting(ring)) == intersecting);
+
+        // A closed ring gives the same result
+        ring.push_back(ring.front());
+        REQUIRE(idsOf(world.intersecting(ring)) == intersecting);
+        break;
+    }
+}
+
+TEST_CASE_METHOD(World, "Nodes in a hole are excluded")
+{
+    Box outer = Box::ofWSEN(7.1, 43.6, 7.9, 44.4);
+    Box hole = Box::ofWSEN(7.3, 43.8, 7.7, 44.2);
+    std::vector<std::vector<Coordinate>> holes = { square(hole) };
+
+    uint64_t inShell = 0;
+    for (Feature node : world.nodes().within(square(outer), holes))
+    {
+        REQUIRE(outer.contains(node.xy()));
+        REQUIRE(!hole.contains(node.xy()));
+        inShell++;
+    }
+    uint64_t expected = 0;
+    for (Feature node : world.nodes()(outer))
+    {
+        Coordinate xy = node.xy();
+        // (leave out nodes that lie on one of the edges)
+        if (xy.x == outer.minX() || xy.x == outer.maxX() ||
+            xy.y == outer.minY() || xy.y == outer.maxY()) continue;
+        if (!hole.contains(xy)) expected++;
+    }
+    REQUIRE(inShell > 0);
+    REQUIRE(inShell == expected);
+}
+
+TEST_CASE_METHOD(World, "A ring needs at least 3 coordinates")
+{
+    std::vector<Coordinate> line = { Coordinate(0, 0), Coordinate(1000, 1000) };
+    bool thrown = false;
+    try
+    {
+        Features f = world.within(line);
+    }
+    catch (const QueryException&)
+    {
+        thrown = true;
+    }
+    REQUIRE(thrown);
+}
+
+TEST_CASE_METHOD(RouteWorld, "Relations are located by the bounding boxes of their members")
+{
+    std::vector<Coordinate> ring = gear(7.5, 44.0, 0.25, 240);
+    Features routes = world("r[type=route]");
+    Features streets = world("w[highway]").filter(
+        [](const Feature& f) { return !f.isArea(); });
+    for (const Features* features : { &routes, &streets })
+    {
+        std::set<uint64_t> within;
+        std::set<uint64_t> intersecting;
+        for (Feature f : *features)
+        {
+            int loc = locate(ring, f);
+            if (loc > 0) within.insert(f.ptr().typedId());
+            if (loc >= 0) intersecting.insert(f.ptr().typedId());
+        }
+        REQUIRE(!within.empty());
+        REQUIRE(intersecting.size() > within.size());
+        REQUIRE(idsOf(features->within(ring)) == within);
+        REQUIRE(idsOf(features->intersecting(ring)) == intersecting);
+    }
+}
@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <set>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+std::set<int64_t> idsOf(const Features& features)
+{
+    std::set<int64_t> ids;
+    uint64_t count = 0;
+    for (Feature f : features)
+    {
+        ids.insert(f.id());
+        count++;
+    }
+    // Each feature must be returned only once
+    CHECK(ids.size() == count);
+    return ids;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Set operations on Features")
+{
+    Features a = world("n")(Box::ofWSEN(7.1, 43.6, 7.6, 44.1));
+    Features b = world("n")(Box::ofWSEN(7.4, 43.9, 7.9, 44.4));
+    std::set<int64_t> idsA = idsOf(a);
+    std::set<int64_t> idsB = idsOf(b);
+    size_t common = 0;
+    for (int64_t id : idsA) common += idsB.count(id);
+    REQUIRE(common > 0);
+    REQUIRE(common < idsA.size());
+
+    std::set<int64_t> idsUnion = idsOf(a | b);
+    REQUIRE(idsUnion.size() == idsA.size() + idsB.size() - common);
+    REQUIRE((a | b).count() == idsUnion.size());
+
+    std::set<int64_t> idsDiff = idsOf(a - b);
+    REQUIRE(idsDiff.size() == idsA.size() - common);
+    for (int64_t id : idsDiff) REQUIRE(idsB.count(id) == 0);
+
+    std::set<int64_t> idsSym = idsOf(a ^ b);
+    REQUIRE(idsSym.size() == idsA.size() + idsB.size() - 2 * common);
+
+    Features restaurants = world("na[amenity=restaurant]");
+    Features cafes = world("na[amenity=cafe]");
+    REQUIRE((restaurants | cafes).count() == restaurants.count() + cafes.count());
+    REQUIRE((restaurants - cafes).count() == restaurants.count());
+    REQUIRE((a - a).count() == 0);
+
+    REQUIRE_THROWS_AS(world.ways().first()->nodes() | world.nodes(), QueryException);
+}
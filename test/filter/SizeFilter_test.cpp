@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::set<uint64_t> idsOf(const Features& features)
+{
+    std::set<uint64_t> ids;
+    for (Feature f : features) ids.insert(f.ptr().typedId());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "areaBetween() rejects small features by their bbox")
+{
+    Features buildings = world("a[building]");
+    std::set<uint64_t> all = idsOf(buildings);
+    REQUIRE(!all.empty());
+
+    // Pick the median area, so half of the buildings are too small
+    std::vector<double> areas;
+    for (Feature f : buildings) areas.push_back(f.area());
+    std::sort(areas.begin(), areas.end());
+    double minArea = areas[areas.size() / 2];
+
+    std::set<uint64_t> expected;
+    for (Feature f : buildings)
+    {
+        if (f.area() >= minArea) expected.insert(f.ptr().typedId());
+    }
+    Features large = buildings.areaBetween(minArea);
+    REQUIRE(idsOf(large) == expected);
+    REQUIRE(expected.size() < all.size());
+
+    QueryStats stats = large.profile();
+    REQUIRE(stats.results == expected.size());
+    REQUIRE(stats.boxLimitRejects > 0);
+    REQUIRE(stats.matcherCalls + stats.boxLimitRejects <= stats.bboxCandidates);
+}
+
+TEST_CASE_METHOD(World, "lengthBetween() rejects ways that are too long for their bbox")
+{
+    Features ways = world("w");
+    std::vector<double> lengths;
+    for (Feature f : ways) lengths.push_back(f.length());
+    REQUIRE(!lengths.empty());
+    std::sort(lengths.begin(), lengths.end());
+    double maxLength = lengths[lengths.size() / 2];
+
+    std::set<uint64_t> expected;
+    for (Feature f : ways)
+    {
+        if (f.length() <= maxLength) expected.insert(f.ptr().typedId());
+    }
+    Features shortWays = ways.lengthBetween(0, maxLength);
+    REQUIRE(idsOf(shortWays) == expected);
+
+    // Combined with another filter, the tighter limit applies
+    Features both = shortWays.areaBetween(0).lengthBetween(0, maxLength / 2);
+    std::set<uint64_t> shorter;
+    for (Feature f : ways)
+    {
+        if (f.length() <= maxLength / 2) shorter.insert(f.ptr().typedId());
+    }
+    REQUIRE(idsOf(both) == shorter);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <string_view>
+#include <geodesk/format/ArrowExport.h>
+
+using namespace geodesk;
+
+TEST_CASE("ArrowExport schema")
+{
+    ArrowExport exporter({ "name", "highway" });
+    ArrowSchema schema;
+    exporter.exportSchema(&schema);
+
+    REQUIRE(std::string_view(schema.format) == "+s");
+    REQUIRE(schema.n_children == 5);
+    REQUIRE(std::string_view(schema.children[0]->name) == "id");
+    REQUIRE(std::string_view(schema.children[0]->format) == "l");
+    REQUIRE(std::string_view(schema.children[1]->name) == "type");
+    REQUIRE(std::string_view(schema.children[1]->format) == "c");
+    for (int i = 2; i < 4; i++)
+    {
+        const ArrowSchema* col = schema.children[i];
+        REQUIRE(std::string_view(col->format) == "i");
+        REQUIRE((col->flags & ARROW_FLAG_NULLABLE) != 0);
+        REQUIRE(col->dictionary != nullptr);
+        REQUIRE(std::string_view(col->dictionary->format) == "u");
+    }
+    REQUIRE(std::string_view(schema.children[2]->name) == "name");
+    REQUIRE(std::string_view(schema.children[3]->name) == "highway");
+
+    const ArrowSchema* geom = schema.children[4];
+    REQUIRE(std::string_view(geom->format) == "z");
+    REQUIRE(geom->metadata != nullptr);
+    int32_t count;
+    std::memcpy(&count, geom->metadata, sizeof(count));
+    REQUIRE(count == 2);
+    int32_t keyLen;
+    std::memcpy(&keyLen, geom->metadata + 4, sizeof(keyLen));
+    REQUIRE(std::string_view(geom->metadata + 8, keyLen) == "ARROW:extension:name");
+
+    // Children can be moved out and released separately
+    ArrowSchema movedChild = *schema.children[4];
+    schema.children[4]->release = nullptr;
+    schema.release(&schema);
+    REQUIRE(schema.release == nullptr);
+    REQUIRE(std::string_view(movedChild.name) == "geometry");
+    movedChild.release(&movedChild);
+    REQUIRE(movedChild.release == nullptr);
+}
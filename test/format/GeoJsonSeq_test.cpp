@@ -0,0 +1,88 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#ifndef _WIN32
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/format/GeoJsonWriter.h>
+#include <geodesk/format/ParallelExport.h>
+#include "../SyntheticGol.h"
+#include <fcntl.h>      // (after the GeoDesk headers, whose enums
+#include <unistd.h>     //  clash with some POSIX macros)
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::string exportSequence(const Features& world, bool ordered)
+{
+    // (Placed next to the GOL, so it is removed along with it)
+    std::string fileName = world.store()->fileName() + ".geojsons";
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0);
+    {
+        clarisma::StreamBuffer stream(fd);
+        GeoJsonWriter out(&stream);
+        out.sequence(true);
+        ParallelExport exporter(&out,
+            [](clarisma::Buffer* b)
+            {
+                auto writer = std::make_unique<GeoJsonWriter>(b);
+                writer->sequence(true);
+                return writer;
+            }, ordered);
+        exporter.streamTo(&stream);
+        exporter.run(world.store(), Box::ofWorld(), FeatureTypes::ALL,
+            world.store()->borrowAllMatcher(), nullptr);
+        CHECK(exporter.featureCount() == world.count());
+        CHECK(stream.bytesSent() > 0);
+    }
+    close(fd);
+    std::ifstream in(fileName, std::ios::binary);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Each feature is a separate GeoJSON text")
+{
+    for (bool ordered : { false, true })
+    {
+        std::string text = exportSequence(world, ordered);
+        REQUIRE(!text.empty());
+        REQUIRE(text.front() == '\x1e');
+        REQUIRE(text.back() == '\n');
+        uint64_t count = 0;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find('\n', start);
+            REQUIRE(end != std::string::npos);
+            std::string_view line(text.data() + start, end - start);
+            REQUIRE(line.starts_with("\x1e{\"type\":\"Feature\""));
+            REQUIRE(line.ends_with("}"));
+            REQUIRE(line.find('\x1e', 1) == std::string_view::npos);
+            count++;
+            start = end + 1;
+        }
+        REQUIRE(count == world.count());
+    }
+}
+
+#endif
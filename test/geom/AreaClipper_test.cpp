@@ -0,0 +1,155 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <geodesk/geom/polygon/AreaClipper.h>
+
+using namespace geodesk;
+
+namespace {
+
+// (offset, since MCIndexBuilder treats 0,0 as a null coordinate)
+std::vector<Coordinate> square(int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+{
+    const int32_t offset = 10'000;
+    return { Coordinate(minX + offset, minY + offset), Coordinate(maxX + offset, minY + offset),
+        Coordinate(maxX + offset, maxY + offset), Coordinate(minX + offset, maxY + offset) };
+}
+
+// A star-shaped polygon with `n` spikes (not convex)
+std::vector<Coordinate> star(int n, double cx, double cy, double r1, double r2,
+    double rotation)
+{
+    std::vector<Coordinate> ring;
+    for (int i = 0; i < n * 2; i++)
+    {
+        double angle = rotation + 3.14159265358979 * i / n;
+        double r = (i & 1) ? r1 : r2;
+        ring.emplace_back(static_cast<int32_t>(cx + r * cos(angle)),
+            static_cast<int32_t>(cy + r * sin(angle)));
+    }
+    return ring;
+}
+
+struct Point
+{
+    double x;
+    double y;
+};
+
+// Sutherland-Hodgman: clips any polygon against a convex,
+// counter-clockwise polygon
+std::vector<Point> clipConvex(const std::vector<Coordinate>& subject,
+    const std::vector<Coordinate>& clip)
+{
+    std::vector<Point> out;
+    for (Coordinate c : subject) out.push_back({ double(c.x), double(c.y) });
+    for (size_t i = 0; i < clip.size(); i++)
+    {
+        Point a{ double(clip[i].x), double(clip[i].y) };
+        Point b{ double(clip[(i + 1) % clip.size()].x),
+            double(clip[(i + 1) % clip.size()].y) };
+        auto side = [&a, &b](Point p)
+        {
+            return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+        };
+        std::vector<Point> in = std::move(out);
+        out.clear();
+        for (size_t j = 0; j < in.size(); j++)
+        {
+            Point p = in[j];
+            Point q = in[(j + 1) % in.size()];
+            double sp = side(p);
+            double sq = side(q);
+            if (sp >= 0) out.push_back(p);
+            if ((sp >= 0) != (sq >= 0))
+            {
+                double t = sp / (sp - sq);
+                out.push_back({ p.x + (q.x - p.x) * t, p.y + (q.y - p.y) * t });
+            }
+        }
+    }
+    return out;
+}
+
+double area(const std::vector<Point>& ring)
+{
+    double sum = 0;
+    for (size_t i = 0; i < ring.size(); i++)
+    {
+        Point p = ring[i];
+        Point q = ring[(i + 1) % ring.size()];
+        sum += p.x * q.y - q.x * p.y;
+    }
+    return std::abs(sum / 2);
+}
+
+} // namespace
+
+TEST_CASE("AreaClipper measures overlapping squares")
+{
+    AreaClipper clipper(square(0, 0, 1000, 1000));
+    REQUIRE(clipper.mercatorAreaOf(square(500, 500, 1500, 1500)) == 250'000);
+    REQUIRE(clipper.mercatorAreaOf(square(100, 100, 200, 300)) == 20'000);
+    REQUIRE(clipper.mercatorAreaOf(square(2000, 0, 3000, 1000)) == 0);
+    // Region lies entirely within the polygon
+    REQUIRE(clipper.mercatorAreaOf(square(-10, -10, 2000, 2000)) == 1'000'000);
+}
+
+TEST_CASE("AreaClipper counts shared edges once")
+{
+    AreaClipper clipper(square(0, 0, 1000, 1000));
+    // Inside, sharing the region's left edge
+    REQUIRE(clipper.mercatorAreaOf(square(0, 200, 400, 600)) == 160'000);
+    // Half inside, sharing parts of the top and bottom edges
+    REQUIRE(clipper.mercatorAreaOf(square(600, 0, 1400, 1000)) == 400'000);
+    // Outside, touching along the right edge
+    REQUIRE(clipper.mercatorAreaOf(square(1000, 0, 1500, 1000)) == 0);
+    // Identical
+    REQUIRE(clipper.mercatorAreaOf(square(0, 0, 1000, 1000)) == 1'000'000);
+}
+
+TEST_CASE("AreaClipper respects holes")
+{
+    std::vector<std::vector<Coordinate>> regionHoles = { square(400, 400, 600, 600) };
+    AreaClipper clipper(square(0, 0, 1000, 1000), regionHoles);
+    REQUIRE(clipper.mercatorAreaOf(square(0, 0, 1000, 1000)) == 960'000);
+    REQUIRE(clipper.mercatorAreaOf(square(450, 450, 550, 550)) == 0);
+    REQUIRE(clipper.mercatorAreaOf(square(300, 300, 500, 500)) == 30'000);
+
+    std::vector<std::vector<Coordinate>> holes = { square(100, 100, 300, 300) };
+    REQUIRE(clipper.mercatorAreaOf(square(-500, -500, 500, 500), holes) == 200'000);
+}
+
+TEST_CASE("AreaClipper agrees with convex clipping")
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> pos(20000, 80000);
+    std::uniform_real_distribution<double> angle(0, 6.28);
+    for (int round = 0; round < 200; round++)
+    {
+        // A rotated square as region (convex and counter-clockwise)
+        double a = angle(rng);
+        double cx = pos(rng);
+        double cy = pos(rng);
+        std::vector<Coordinate> region;
+        for (int i = 0; i < 4; i++)
+        {
+            region.emplace_back(
+                static_cast<int32_t>(cx + 30000 * cos(a + i * 1.5707963)),
+                static_cast<int32_t>(cy + 30000 * sin(a + i * 1.5707963)));
+        }
+        std::vector<Coordinate> polygon = star(3 + round % 9,
+            pos(rng), pos(rng), 5000, 25000, angle(rng));
+        double expected = area(clipConvex(polygon, region));
+        double actual = AreaClipper(region).mercatorAreaOf(polygon);
+        REQUIRE(std::abs(actual - expected) <= 1 + expected * 1e-9);
+
+        // The same, with the roles swapped
+        actual = AreaClipper(polygon).mercatorAreaOf(region);
+        REQUIRE(std::abs(actual - expected) <= 1 + expected * 1e-9);
+    }
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cmath>
+#include <random>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/geom/BinGrid.h>
+#include <geodesk/geom/Tile.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+double distanceSquared(Coordinate a, Coordinate b)
+{
+    double dx = static_cast<double>(a.x) - b.x;
+    double dy = static_cast<double>(a.y) - b.y;
+    return dx * dx + dy * dy;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE("Rectangular and tile grids number cells from the top left")
+{
+    Box bounds(0, 0, 999, 499);
+    BinGrid grid = BinGrid::ofCells(bounds, 10, 5);
+    REQUIRE(grid.cellCount() == 50);
+    REQUIRE(grid.cellOf(Coordinate(0, 499)) == 0);
+    REQUIRE(grid.cellOf(Coordinate(999, 499)) == 9);
+    REQUIRE(grid.cellOf(Coordinate(0, 0)) == 40);
+    REQUIRE(grid.cellOf(Coordinate(999, 0)) == 49);
+    REQUIRE(grid.cellOf(Coordinate(150, 250)) == 21);
+    REQUIRE(grid.cellOf(Coordinate(1000, 0)) == -1);
+
+    Box lonLat = Box::ofWSEN(7.0, 43.5, 8.0, 44.5);
+    BinGrid tiles = BinGrid::ofTiles(12, lonLat);
+    Coordinate c = Coordinate::ofLonLat(7.3, 44.1);
+    Tile tile = Tile::fromColumnRowZoom(Tile::columnFromXZ(c.x, 12),
+        Tile::rowFromYZ(c.y, 12), 12);
+    Tile topLeft = Tile::fromColumnRowZoom(
+        Tile::columnFromXZ(lonLat.minX(), 12),
+        Tile::rowFromYZ(lonLat.maxY(), 12), 12);
+    REQUIRE(tiles.bounds().contains(lonLat));
+    REQUIRE(tiles.cellOf(c) == (tile.row() - topLeft.row()) * tiles.columns() +
+        tile.column() - topLeft.column());
+    REQUIRE(tiles.cellOf(tile.bounds().topLeft()) == tiles.cellOf(c));
+    REQUIRE(tiles.cellOf(tile.bounds().bottomRight()) == tiles.cellOf(c));
+    REQUIRE(tiles.cellOf(tile.bounds().center()) == tiles.cellOf(c));
+}
+
+TEST_CASE("Points are binned into the nearest hexagon")
+{
+    Box bounds = Box::ofWSEN(7.0, 43.5, 7.1, 43.6);
+    BinGrid grid = BinGrid::ofHexagons(bounds, 500);
+    REQUIRE(grid.cellCount() > 1);
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int32_t> x(bounds.minX(), bounds.maxX());
+    std::uniform_int_distribution<int32_t> y(bounds.minY(), bounds.maxY());
+    for (int i = 0; i < 2000; i++)
+    {
+        Coordinate c(x(random), y(random));
+        int64_t cell = grid.cellOf(c);
+        REQUIRE(cell >= 0);
+        double best = distanceSquared(c, grid.centerOf(static_cast<uint32_t>(cell)));
+        for (uint32_t other = 0; other < grid.cellCount(); other++)
+        {
+            // (allow for the rounding of the centers)
+            REQUIRE(std::sqrt(best) <=
+                std::sqrt(distanceSquared(c, grid.centerOf(other))) + 2);
+        }
+    }
+}
+
+TEST_CASE_METHOD(World, "binCount() and binSum() match a single-threaded loop")
+{
+    BinGrid grid = BinGrid::ofCells(Box::ofWSEN(7.2, 43.7, 7.8, 44.3), 16, 12);
+    Features features = world("n[amenity], w[highway], a[building]");
+
+    std::vector<uint64_t> expectedCounts(grid.cellCount());
+    std::vector<double> expectedSums(grid.cellCount());
+    for (Feature f : features)
+    {
+        int64_t cell = grid.cellOf(f.isNode() ? f.xy() : f.centroid());
+        if (cell < 0) continue;
+        expectedCounts[cell]++;
+        expectedSums[cell] += static_cast<double>(f.id() % 7);
+    }
+
+    std::vector<uint64_t> counts = features.binCount(grid);
+    std::vector<double> sums = features.binSum(grid,
+        [](Feature f) { return static_cast<double>(f.id() % 7); });
+    REQUIRE(counts == expectedCounts);
+    REQUIRE(sums == expectedSums);
+    uint64_t total = 0;
+    for (uint64_t n : counts) total += n;
+    REQUIRE(total > 0);
+    REQUIRE(total < features.count());
+}
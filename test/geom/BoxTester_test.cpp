@@ -0,0 +1,52 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <geodesk/geom/BoxTester.h>
+
+using namespace geodesk;
+
+TEST_CASE("BoxTester agrees with Box")
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int32_t> coord(-1000, 1000);
+    Box query(-200, -300, 400, 100);
+    BoxTester tester(query);
+
+    for (int n = 0; n < 1000; n++)
+    {
+        int32_t boxes[BoxTester::BATCH_SIZE][4];
+        const uint8_t* pBoxes[BoxTester::BATCH_SIZE];
+        const uint8_t* pPoints[BoxTester::BATCH_SIZE];
+        uint32_t expectedBoxes = 0;
+        uint32_t expectedPoints = 0;
+        for (int i = 0; i < BoxTester::BATCH_SIZE; i++)
+        {
+            int32_t x1 = coord(rng), x2 = coord(rng);
+            int32_t y1 = coord(rng), y2 = coord(rng);
+            Box b(std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2));
+            boxes[i][0] = b.minX();
+            boxes[i][1] = b.minY();
+            boxes[i][2] = b.maxX();
+            boxes[i][3] = b.maxY();
+            pBoxes[i] = reinterpret_cast<const uint8_t*>(boxes[i]);
+            pPoints[i] = pBoxes[i];
+            expectedBoxes |= static_cast<uint32_t>(query.intersects(b)) << i;
+            expectedPoints |= static_cast<uint32_t>(
+                query.containsSimple(b.minX(), b.minY())) << i;
+        }
+        REQUIRE(tester.intersects(pBoxes) == expectedBoxes);
+        REQUIRE(tester.containsSimple(pPoints) == expectedPoints);
+    }
+}
+
+TEST_CASE("BoxTester handles extreme coordinates")
+{
+    BoxTester tester(Box(INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX));
+    int32_t b[4] = { INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX };
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(b);
+    const uint8_t* boxes[BoxTester::BATCH_SIZE] = { p, p, p, p };
+    REQUIRE(tester.intersects(boxes) == 0xf);
+    REQUIRE(tester.containsSimple(boxes) == 0xf);
+}
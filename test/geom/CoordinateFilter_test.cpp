@@ -0,0 +1,69 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <vector>
+#include <geodesk/geom/CoordinateFilter.h>
+
+using namespace geodesk;
+
+TEST_CASE("CoordinateFilter clips a ring")
+{
+    CoordinateFilter filter;
+    std::vector<Coordinate> ring = { {0,0}, {100,0}, {100,100}, {0,100}, {0,0} };
+    filter.clip(ring, true, Box(50, -10, 150, 50));
+    REQUIRE(ring.front() == ring.back());
+    REQUIRE(ring.size() == 5);
+    for (Coordinate c : ring)
+    {
+        REQUIRE(c.x >= 50);
+        REQUIRE(c.x <= 100);
+        REQUIRE(c.y >= 0);
+        REQUIRE(c.y <= 50);
+    }
+
+    // A ring outside the box degenerates onto its boundary
+    std::vector<Coordinate> outside = { {200,200}, {300,200}, {300,300}, {200,200} };
+    filter.clip(outside, true, Box(0, 0, 100, 100));
+    REQUIRE(outside.size() == 4);
+    for (Coordinate c : outside) REQUIRE(c == Coordinate(100, 100));
+}
+
+TEST_CASE("CoordinateFilter clips a line")
+{
+    CoordinateFilter filter;
+    // Enters the box, leaves it across the right edge, and returns
+    std::vector<Coordinate> line = { {-50,50}, {50,50}, {150,50}, {150,60}, {50,60} };
+    filter.clip(line, false, Box(0, 0, 100, 100));
+    std::vector<Coordinate> expected = { {0,50}, {50,50}, {100,50}, {100,60}, {50,60} };
+    REQUIRE(line == expected);
+}
+
+TEST_CASE("CoordinateFilter simplifies")
+{
+    CoordinateFilter filter;
+    std::vector<Coordinate> line;
+    for (int i = 0; i <= 1000; i++)
+    {
+        line.emplace_back(i * 10, static_cast<int32_t>(std::lround(std::sin(i * 0.01) * 1000)));
+    }
+    std::vector<Coordinate> original = line;
+    filter.simplify(line, false, 5);
+    REQUIRE(line.size() < original.size() / 10);
+    REQUIRE(line.front() == original.front());
+    REQUIRE(line.back() == original.back());
+
+    // A small ring keeps at least a triangle
+    std::vector<Coordinate> ring;
+    for (int i = 0; i < 64; i++)
+    {
+        double a = i * 2 * 3.14159265358979 / 64;
+        ring.emplace_back(static_cast<int32_t>(std::lround(std::cos(a) * 10)),
+            static_cast<int32_t>(std::lround(std::sin(a) * 10)));
+    }
+    ring.push_back(ring.front());
+    filter.simplify(ring, true, 1000);
+    REQUIRE(ring.size() == 4);
+    REQUIRE(ring.front() == ring.back());
+}
@@ -0,0 +1,57 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <unordered_set>
+#include <geodesk/geom/CoordinateSet.h>
+
+using namespace geodesk;
+
+TEST_CASE("CoordinateSet agrees with std::unordered_set")
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int32_t> coord(-50000, 50000);
+    CoordinateSet set;
+    std::unordered_set<Coordinate> expected;
+    for (int i = 0; i < 5000; i++)
+    {
+        Coordinate c(coord(rng), coord(rng));
+        if (c.isNull()) continue;
+        set.insert(c);
+        expected.insert(c);
+    }
+    set.build();
+    REQUIRE(set.size() == expected.size());
+
+    for (Coordinate c : expected) REQUIRE(set.contains(c));
+    for (int i = 0; i < 5000; i++)
+    {
+        Coordinate c(coord(rng) * 2, coord(rng) * 2);
+        REQUIRE(set.contains(c) == (expected.count(c) != 0));
+    }
+}
+
+TEST_CASE("CoordinateSet skips boxes without coordinates")
+{
+    CoordinateSet set;
+    set.insert(Coordinate(1000, 1000));
+    set.insert(Coordinate(64000, 64000));
+    set.build();
+
+    CHECK(set.mayContainAny(Box(900, 900, 1100, 1100)));
+    CHECK(set.mayContainAny(Box(-5000, -5000, 100000, 100000)));
+    CHECK_FALSE(set.mayContainAny(Box(30000, 30000, 31000, 31000)));
+    CHECK_FALSE(set.mayContainAny(Box(70000, 70000, 80000, 80000)));
+    CHECK_FALSE(set.contains(Coordinate(30000, 30000)));
+    CHECK(set.contains(Coordinate(64000, 64000)));
+}
+
+TEST_CASE("Empty CoordinateSet contains nothing")
+{
+    CoordinateSet set;
+    set.build();
+    CHECK(set.isEmpty());
+    CHECK_FALSE(set.contains(Coordinate(1, 1)));
+    CHECK_FALSE(set.mayContainAny(Box(-10, -10, 10, 10)));
+}
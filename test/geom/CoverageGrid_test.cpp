@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geom/index/CoverageGrid.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+
+using namespace geodesk;
+
+// A triangle with corners (0,0), (100000,0) and (0,100000),
+// with each side made of `n` segments
+static MCIndex buildTriangle(int n)
+{
+    MCIndexBuilder builder;
+    int32_t step = 100000 / n;
+    for (int i = 0; i < n; i++)
+    {
+        int32_t a = i * step;
+        int32_t b = (i + 1) * step;
+        builder.addLineSegment(Coordinate(a, 0), Coordinate(b, 0));
+        builder.addLineSegment(Coordinate(0, a), Coordinate(0, b));
+        builder.addLineSegment(Coordinate(100000 - a, a), Coordinate(100000 - b, b));
+    }
+    return builder.build(Box(0, 0, 100000, 100000));
+}
+
+TEST_CASE("CoverageGrid classifies boxes inside and outside a polygon")
+{
+    MCIndex index = buildTriangle(100);
+    CoverageGrid grid(index, Box(0, 0, 100000, 100000));
+    REQUIRE(!grid.isEmpty());
+
+    CHECK(grid.locateBox(Box(20000, 20000, 20500, 20500)) == 1);
+    CHECK(grid.locateBox(Box(80000, 80000, 80500, 80500)) == -1);
+    CHECK(grid.locateBox(Box(200000, 200000, 200500, 200500)) == -1);
+
+    // Straddles the hypotenuse
+    CHECK(grid.locateBox(Box(49000, 49000, 51000, 51000)) == 0);
+    // Touches the bottom edge
+    CHECK(grid.locateBox(Box(20000, 0, 20500, 500)) == 0);
+    // Spans too many cells
+    CHECK(grid.locateBox(Box(1000, 1000, 40000, 40000)) == 0);
+    // Extends beyond the grid
+    CHECK(grid.locateBox(Box(-500, 20000, 500, 20500)) == 0);
+}
+
+TEST_CASE("CoverageGrid is empty for polygons with few chains")
+{
+    MCIndex index = buildTriangle(4);
+    CoverageGrid grid(index, Box(0, 0, 100000, 100000));
+    CHECK(grid.isEmpty());
+    CHECK(grid.locateBox(Box(20000, 20000, 20500, 20500)) == 0);
+}
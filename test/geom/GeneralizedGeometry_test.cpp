@@ -0,0 +1,189 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <map>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/FlatCoordinates.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/format/GeoJsonWriter.h>
+#include <geodesk/format/MvtTileBuilder.h>
+#include <geodesk/geom/CoordinateFilter.h>
+#include <geodesk/geom/GeneralizedGeometry.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 100;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 5;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+/// A world whose generalized geometries have been built
+struct GeneralizedGol : SyntheticGol
+{
+    GeneralizedGol() : SyntheticGol(worldSettings())
+    {
+        Features world(fileName().c_str());
+        world.store()->buildGeneralizedGeometry(2);
+    }
+};
+
+Features openWorld(bool generalized)
+{
+    static const GeneralizedGol generalizedGol;
+    static const SyntheticGol plain(worldSettings());
+    return Features((generalized ? generalizedGol.fileName() : plain.fileName()).c_str());
+}
+
+std::vector<Coordinate> wayCoordinates(WayPtr way)
+{
+    WayCoordinateIterator iter(way);
+    std::vector<Coordinate> coords(iter.coordinatesRemaining());
+    iter.decodeAll(coords.data());
+    return coords;
+}
+
+/// Writes each feature as GeoJSON, by typed ID (since queries return
+/// features in no particular order)
+std::map<uint64_t, std::string> toGeoJson(const Features& features, double tolerance)
+{
+    std::map<uint64_t, std::string> json;
+    for (Feature f : features)
+    {
+        clarisma::DynamicBuffer buf(4096);
+        {
+            GeoJsonWriter out(&buf);
+            out.simplify(tolerance);
+            out.writeFeature(features.store(), f.ptr());
+            out.flush();
+        }
+        json[f.ptr().typedId()] = std::string(buf.data(), buf.length());
+    }
+    return json;
+}
+
+size_t totalSize(const std::map<uint64_t, std::string>& json)
+{
+    size_t size = 0;
+    for (const auto& [id, text] : json) size += text.size();
+    return size;
+}
+
+size_t encodeTile(const Features& world, Tile tile, double tolerance)
+{
+    MvtTileBuilder builder(tile);
+    builder.simplify(tolerance);
+    int layer = builder.addLayer("all");
+    for (Feature f : world(builder.queryBounds()))
+    {
+        builder.addFeature(world.store(), f.ptr(), layer);
+    }
+    clarisma::DynamicBuffer buf(64 * 1024);
+    builder.encode(&buf);
+    return buf.length();
+}
+
+} // namespace
+
+TEST_CASE("Ways are simplified at each level")
+{
+    Features world = openWorld(true);
+    const GeneralizedGeometry* generalized = world.store()->generalizedGeometry();
+    REQUIRE(generalized != nullptr);
+    REQUIRE(generalized->featureCount() > 0);
+    REQUIRE(GeneralizedGeometry::levelFor(1000) == -1);
+    REQUIRE(GeneralizedGeometry::levelFor(GeneralizedGeometry::levelTolerance(0)) == 0);
+    REQUIRE(GeneralizedGeometry::levelFor(1e12) == GeneralizedGeometry::LEVEL_COUNT - 1);
+
+    CoordinateFilter filter;
+    size_t fullCount = 0;
+    size_t coarsestCount = 0;
+    for (Feature f : world.ways())
+    {
+        WayPtr way(f.ptr());
+        std::vector<Coordinate> original = wayCoordinates(way);
+        fullCount += original.size();
+        size_t prevCount = original.size();
+        for (int level = 0; level < GeneralizedGeometry::LEVEL_COUNT; level++)
+        {
+            std::vector<Coordinate> expected = original;
+            filter.simplify(expected, way.isArea(),
+                GeneralizedGeometry::levelTolerance(level));
+            std::vector<Coordinate> coords;
+            if (generalized->wayCoordinates(way, level, coords))
+            {
+                REQUIRE(coords == expected);
+            }
+            else
+            {
+                // Not stored because the way doesn't lose any vertexes
+                REQUIRE(expected.size() == original.size());
+                coords = original;
+            }
+            REQUIRE(coords.size() <= prevCount);
+            prevCount = coords.size();
+        }
+        coarsestCount += prevCount;
+    }
+    REQUIRE(fullCount > 0);
+    REQUIRE(coarsestCount * 2 < fullCount);
+}
+
+TEST_CASE("Writers start with the generalized geometries")
+{
+    Features world = openWorld(true);
+    Features plain = openWorld(false);
+    REQUIRE(world.store()->generalizedGeometry() != nullptr);
+    REQUIRE(plain.store()->generalizedGeometry() == nullptr);
+
+    // At the tolerance of a level, the output is the same as if the
+    // full geometries were simplified
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    for (int level : { 0, 2, 4 })
+    {
+        double tolerance = GeneralizedGeometry::levelTolerance(level);
+        std::map<uint64_t, std::string> json = toGeoJson(world("wa")(bounds), tolerance);
+        REQUIRE(json == toGeoJson(plain("wa")(bounds), tolerance));
+        REQUIRE(totalSize(json) < totalSize(toGeoJson(world("wa")(bounds), 0)));
+    }
+
+    // In between, simplification continues from the finer level
+    double tolerance = GeneralizedGeometry::levelTolerance(1) * 1.5;
+    REQUIRE(totalSize(toGeoJson(world("a"), tolerance)) <=
+        totalSize(toGeoJson(world("a"), GeneralizedGeometry::levelTolerance(1))));
+
+    // Tiles at low zoom use fewer coordinates
+    Coordinate center = bounds.center();
+    Tile tile = Tile::fromColumnRowZoom(Tile::columnFromXZ(center.x, 8),
+        Tile::rowFromYZ(center.y, 8), 8);
+    size_t fullSize = encodeTile(plain, tile, 16);
+    REQUIRE(fullSize == encodeTile(world, tile, 0));
+    REQUIRE(encodeTile(world, tile, 16) < fullSize);
+}
+
+TEST_CASE("Flat coordinates can be taken from generalized geometries")
+{
+    Features world = openWorld(true);
+    Features plain = openWorld(false);
+    double tolerance = GeneralizedGeometry::levelTolerance(3);
+    FlatCoordinates full = world.coordinates(CoordinateFormat::MERCATOR);
+    FlatCoordinates simplified = world.coordinates(CoordinateFormat::MERCATOR, tolerance);
+    REQUIRE(simplified.featureCount() == full.featureCount());
+    REQUIRE(simplified.partCount() == full.partCount());
+    REQUIRE(simplified.coordinateCount() < full.coordinateCount());
+
+    FlatCoordinates plainCoords = plain.coordinates(CoordinateFormat::MERCATOR, tolerance);
+    REQUIRE(plainCoords.coordinateCount() == full.coordinateCount());
+}
@@ -0,0 +1,156 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+#include <geodesk/geom/polygon/LabelPoint.h>
+#include <geodesk/geom/polygon/LabelPointCache.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+// (offset, since MCIndexBuilder treats 0,0 as a null coordinate)
+std::vector<Coordinate> ring(std::initializer_list<std::pair<int32_t, int32_t>> points)
+{
+    const int32_t offset = 10'000;
+    std::vector<Coordinate> coords;
+    for (auto [x, y] : points) coords.emplace_back(x + offset, y + offset);
+    return coords;
+}
+
+/// The distance from `c` to the boundary, negative if `c` lies outside
+double signedDistance(Coordinate c, const std::vector<Coordinate>& shell,
+    const std::vector<std::vector<Coordinate>>& holes)
+{
+    MCIndexBuilder builder;
+    Box bounds;
+    auto add = [&builder, &bounds](std::vector<Coordinate> r)
+    {
+        r.push_back(r.front());
+        for (Coordinate v : r) bounds.expandToInclude(v);
+        builder.segmentizeCoords(r);
+    };
+    add(shell);
+    for (const std::vector<Coordinate>& hole : holes) add(hole);
+    MCIndex index = builder.build(bounds);
+    double d = std::sqrt(index.distanceSquared(c));
+    return index.containsPoint(c) ? d : -d;
+}
+
+/// The best distance found by probing a fine grid
+double bestGridDistance(const std::vector<Coordinate>& shell,
+    const std::vector<std::vector<Coordinate>>& holes, int steps)
+{
+    Box bounds;
+    for (Coordinate c : shell) bounds.expandToInclude(c);
+    double best = -1e300;
+    for (int i = 0; i <= steps; i++)
+    {
+        for (int j = 0; j <= steps; j++)
+        {
+            Coordinate c(
+                static_cast<int32_t>(bounds.minX() + (static_cast<double>(bounds.maxX()) - bounds.minX()) * i / steps),
+                static_cast<int32_t>(bounds.minY() + (static_cast<double>(bounds.maxY()) - bounds.minY()) * j / steps));
+            best = std::max(best, signedDistance(c, shell, holes));
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+TEST_CASE("MCIndex measures the distance to the nearest segment")
+{
+    std::vector<Coordinate> square = ring({ {0, 0}, {1000, 0}, {1000, 1000}, {0, 1000} });
+    REQUIRE(signedDistance(Coordinate(10'500, 10'200), square, {}) == 200);
+    REQUIRE(signedDistance(Coordinate(10'500, 10'500), square, {}) == 500);
+    REQUIRE(signedDistance(Coordinate(13'000, 10'500), square, {}) == -2000);
+    REQUIRE(signedDistance(Coordinate(5'000'000, 10'500), square, {}) == -(5'000'000 - 11'000));
+}
+
+TEST_CASE("LabelPoint of a square is its center")
+{
+    std::vector<Coordinate> square = ring({ {0, 0}, {1000, 0}, {1000, 1000}, {0, 1000} });
+    Coordinate c = LabelPoint::ofRings(square);
+    REQUIRE(std::abs(c.x - 10'500) <= 1);
+    REQUIRE(std::abs(c.y - 10'500) <= 1);
+}
+
+TEST_CASE("LabelPoint lies inside a concave polygon")
+{
+    // A "C" shape, whose centroid lies in the opening
+    std::vector<Coordinate> shape = ring({ {0, 0}, {3000, 0}, {3000, 600},
+        {600, 600}, {600, 2400}, {3000, 2400}, {3000, 3000}, {0, 3000} });
+    Coordinate c = LabelPoint::ofRings(shape);
+    double d = signedDistance(c, shape, {});
+    REQUIRE(d >= 299);
+    REQUIRE(d >= bestGridDistance(shape, {}, 60) - 2);
+}
+
+TEST_CASE("LabelPoint avoids holes")
+{
+    std::vector<Coordinate> square = ring({ {0, 0}, {4000, 0}, {4000, 4000}, {0, 4000} });
+    std::vector<std::vector<Coordinate>> holes =
+        { ring({ {1000, 1000}, {3000, 1000}, {3000, 3000}, {1000, 3000} }) };
+    Coordinate c = LabelPoint::ofRings(square, holes);
+    double d = signedDistance(c, square, holes);
+    REQUIRE(d >= 499);
+    REQUIRE(d >= bestGridDistance(square, holes, 80) - 2);
+}
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 10;
+    settings.streetsPerTile = 10;
+    settings.buildingsPerTile = 200;
+    settings.multipolygonsPerTile = 20;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "LabelPoint of features")
+{
+    Features areas = world("a");
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, Coordinate> points;
+    areas.parallelForEachLabelPoint([&mutex, &points](Feature f, Coordinate c)
+    {
+        std::lock_guard lock(mutex);
+        points[f.ptr().typedId()] = c;
+    });
+    REQUIRE(points.size() > 100);
+    REQUIRE(points.size() == areas.count());
+
+    uint64_t inside = 0;
+    for (Feature f : areas)
+    {
+        Coordinate c = points[f.ptr().typedId()];
+        REQUIRE(f.bounds().contains(c));
+        if (areas.containing(c).contains(f)) inside++;
+    }
+    // Label points of (valid) areas always lie inside
+    REQUIRE(inside == points.size());
+
+    // The cache returns the same points
+    world.store()->enableLabelPointCache(1024 * 1024);
+    for (int round = 0; round < 2; round++)
+    {
+        for (Feature f : areas) REQUIRE(f.labelPoint() == points[f.ptr().typedId()]);
+    }
+    REQUIRE(world.store()->memoryUsage().labelPointCache > 0);
+}
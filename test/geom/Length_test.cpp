@@ -0,0 +1,113 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Area.h>
+#include <geodesk/geom/Length.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+bool isWithinTableError(double fast, double exact)
+{
+    return std::abs(fast - exact) <= exact * Length::MAX_TABLE_ERROR;
+}
+
+/// The area of a way, measured one coordinate at a time
+double referenceArea(WayPtr way)
+{
+    WayCoordinateIterator iter;
+    iter.start(way, FeatureFlags::AREA);
+    std::vector<Coordinate> coords;
+    while (iter.coordinatesRemaining() > 0) coords.push_back(iter.next());
+    double sum = 0;
+    for (size_t i = 1; i < coords.size(); i++)
+    {
+        sum += static_cast<double>(coords[i-1].x) * coords[i].y -
+            static_cast<double>(coords[i].x) * coords[i-1].y;
+    }
+    int32_t avgY = clarisma::Math::avg(way.minY(), way.maxY());
+    double scale = Mercator::metersPerUnitAtY(avgY);
+    return std::abs(sum / 2) * scale * scale;
+}
+
+} // namespace
+
+TEST_CASE("Length with interpolated scale stays within its error bound")
+{
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int32_t> step(-100'000, 100'000);
+    for (double lat : { 0.0, 0.001, 12.5, -33.3, 45.0, 60.1, -75.0, 84.9 })
+    {
+        std::vector<Coordinate> coords;
+        Coordinate c(0, Mercator::yFromLat(lat));
+        for (int i = 0; i < 1000; i++)
+        {
+            coords.push_back(c);
+            c = Coordinate(c.x + step(random), c.y + step(random));
+        }
+        // Odd and even counts, to cover the unpaired last segment
+        for (int count : { 0, 1, 2, 3, 999, 1000 })
+        {
+            double fast = Length::ofCoords(coords.data(), count);
+            double exact = Length::ofCoords(coords.data(), count, Length::Scale::EXACT);
+            REQUIRE(isWithinTableError(fast, exact));
+            if (count < 2) REQUIRE(fast == 0);
+        }
+    }
+
+    // Segments at the edges of the map (|y| reaches 2^31)
+    std::vector<Coordinate> edges =
+    {
+        { 0, INT32_MIN }, { 1000, INT32_MIN }, { 2000, INT32_MIN + 500 },
+        { 0, INT32_MAX }, { 1000, INT32_MAX - 500 }, { 5000, INT32_MAX }
+    };
+    REQUIRE(isWithinTableError(Length::ofCoords(edges.data(), 3),
+        Length::ofCoords(edges.data(), 3, Length::Scale::EXACT)));
+    REQUIRE(isWithinTableError(Length::ofCoords(edges.data() + 3, 3),
+        Length::ofCoords(edges.data() + 3, 3, Length::Scale::EXACT)));
+}
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 10;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.bounds = Box::ofWSEN(-0.5, 59.5, 0.5, 60.5);
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Length and Area of ways")
+{
+    int count = 0;
+    for (Feature f : world.ways())
+    {
+        WayPtr way(f.ptr());
+        double fast = Length::ofWay(way);
+        REQUIRE(isWithinTableError(fast, Length::ofWay(way, Length::Scale::EXACT)));
+        REQUIRE(Length::minOfWay(way) <= fast);
+        REQUIRE(f.length() == fast);
+        if (way.isArea())
+        {
+            double reference = referenceArea(way);
+            REQUIRE(std::abs(Area::ofWay(way) - reference) <= reference * 1e-9);
+        }
+        count++;
+    }
+    REQUIRE(count > 1000);
+}
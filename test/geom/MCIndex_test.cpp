@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+#include <geodesk/geom/index/FlatChains.h>
+#include <geodesk/geom/index/MCIndexBuilder.h>
+
+using namespace geodesk;
+
+// A star-shaped polygon with `n` spikes, centered on (50000,50000)
+static MCIndex buildStar(int n)
+{
+    MCIndexBuilder builder;
+    std::vector<Coordinate> ring;
+    for (int i = 0; i < n * 2; i++)
+    {
+        double angle = 3.14159265358979 * i / n;
+        double r = (i & 1) ? 20000 : 45000;
+        ring.emplace_back(50000 + static_cast<int32_t>(r * cos(angle)),
+            50000 + static_cast<int32_t>(r * sin(angle)));
+    }
+    for (size_t i = 0; i < ring.size(); i++)
+    {
+        builder.addLineSegment(ring[i], ring[(i + 1) % ring.size()]);
+    }
+    return builder.build(Box(0, 0, 100000, 100000));
+}
+
+TEST_CASE("MCIndex::containsPoints agrees with containsPoint")
+{
+    MCIndex index = buildStar(12);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int32_t> coord(-1000, 101000);
+    std::vector<Coordinate> points;
+    for (int i = 0; i < 2000; i++) points.emplace_back(coord(rng), coord(rng));
+    // Points on the boundary
+    points.emplace_back(95000, 50000);
+    points.emplace_back(50000 + 20000, 50000 + 0);
+    // Points on a horizontal and a vertical line
+    for (int i = 0; i < 50; i++) points.emplace_back(i * 2000, 50000);
+
+    std::unique_ptr<bool[]> results(new bool[points.size()]);
+    index.containsPoints(points, results.get());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        REQUIRE(results[i] == index.containsPoint(points[i]));
+    }
+
+    std::vector<Coordinate> line;
+    for (int i = 0; i < 50; i++) line.emplace_back(50000, i * 2000);
+    index.containsPoints(line, results.get());
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        REQUIRE(results[i] == index.containsPoint(line[i]));
+    }
+}
+
+TEST_CASE("FlatChains locate points like MCIndex")
+{
+    MCIndex index = buildStar(12);
+    FlatChains flat = FlatChains::fromIndex(index);
+    REQUIRE(flat.chainCount() == index.chainCount());
+    REQUIRE(flat.chainStarts.size() == flat.chainCount() + 1);
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int32_t> coord(-1000, 101000);
+    std::vector<Coordinate> points;
+    for (int i = 0; i < 5000; i++) points.emplace_back(coord(rng), coord(rng));
+    // The vertexes of the polygon, and points on its edges
+    for (size_t i = 0; i < flat.x.size(); i++)
+    {
+        points.emplace_back(flat.x[i], flat.y[i]);
+        points.emplace_back(flat.x[i] + 1, flat.y[i]);
+    }
+    points.emplace_back(95000, 50000);
+
+    std::unique_ptr<bool[]> results(new bool[points.size()]);
+    flat.containsPoints(points, results.get());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        REQUIRE(results[i] == index.containsPoint(points[i]));
+    }
+}
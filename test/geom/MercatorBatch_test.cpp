@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geom/MercatorBatch.h>
+
+using namespace geodesk;
+
+namespace {
+
+std::vector<double> randomLonLats(int count)
+{
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> lon(-179.9, 179.9);
+    std::uniform_real_distribution<double> lat(-85.05, 85.05);
+    std::vector<double> lonLat;
+    for (int i = 0; i < count; i++)
+    {
+        lonLat.push_back(lon(random));
+        lonLat.push_back(lat(random));
+    }
+    // Band boundaries, the equator and the limits of the projection
+    for (double v : { 0.0, 0.1, -0.1, 45.0, 60.05, -84.9, 85.0, -85.05, 85.0511287, -90.0, 90.0 })
+    {
+        lonLat.push_back(v);
+        lonLat.push_back(v);
+    }
+    return lonLat;
+}
+
+/// The largest difference from converting the points one at a time
+int64_t maxDifference(const std::vector<double>& lonLat, double maxError)
+{
+    std::vector<Coordinate> coords(lonLat.size() / 2);
+    MercatorBatch::coordsFromLonLat(lonLat, coords, maxError);
+    int64_t maxDiff = 0;
+    for (size_t i = 0; i < coords.size(); i++)
+    {
+        double lat = std::max(std::min(lonLat[i * 2 + 1], Mercator::MAX_LAT), Mercator::MIN_LAT);
+        Coordinate expected = Coordinate::ofLonLat(lonLat[i * 2], lat);
+        maxDiff = std::max(maxDiff, std::abs(static_cast<int64_t>(coords[i].x) - expected.x));
+        maxDiff = std::max(maxDiff, std::abs(static_cast<int64_t>(coords[i].y) - expected.y));
+    }
+    return maxDiff;
+}
+
+} // namespace
+
+TEST_CASE("MercatorBatch converts lon/lat within the tolerance")
+{
+    std::vector<double> lonLat = randomLonLats(100'001);
+    REQUIRE(maxDifference(lonLat, 0) == 0);
+    REQUIRE(maxDifference(lonLat, 0.9) == 0);
+    for (double maxError : { 1.5, 2.0, 3.0, 100.0 })
+    {
+        REQUIRE(maxDifference(lonLat, maxError) <= maxError);
+    }
+}
+
+TEST_CASE("MercatorBatch builds boxes around points")
+{
+    std::vector<Coordinate> points =
+    {
+        Coordinate::ofLonLat(0, 0), Coordinate::ofLonLat(13.4, 52.5),
+        Coordinate::ofLonLat(-70, -60), Coordinate(0, Mercator::MAX_Y)
+    };
+    std::vector<Box> boxes(points.size());
+    MercatorBatch::boxesAroundXY(points, 1000, boxes);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        REQUIRE(boxes[i] == Box::unitsAroundXY(1000, points[i]));
+    }
+    MercatorBatch::boxesAroundMeters(points, 500, boxes);
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        int32_t units = static_cast<int32_t>(std::ceil(
+            Mercator::unitsFromMeters(500, points[i].y)));
+        REQUIRE(boxes[i] == Box::unitsAroundXY(units, points[i]));
+        REQUIRE(boxes[i].contains(points[i]));
+    }
+}
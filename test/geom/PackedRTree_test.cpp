@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <set>
+#include <vector>
+#include <geodesk/geom/index/HilbertTreeBuilder.h>
+
+using namespace geodesk;
+
+struct Collector
+{
+    std::set<const int*> found;
+    const int* stopAt = nullptr;
+};
+
+static bool collect(const RTree<const int>::Node* node, Collector* collector)
+{
+    collector->found.insert(node->item());
+    return node->item() == collector->stopAt;
+}
+
+TEST_CASE("PackedRTree finds the same items as a linear scan")
+{
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int32_t> coord(0, 1000000);
+    std::uniform_int_distribution<int32_t> extent(0, 20000);
+
+    for (size_t itemCount : { 1, 7, 8, 9, 64, 65, 1000 })
+    {
+        std::vector<int> payload(itemCount);
+        std::vector<BoundedItem> items(itemCount);
+        for (size_t i = 0; i < itemCount; i++)
+        {
+            int32_t x = coord(rng);
+            int32_t y = coord(rng);
+            items[i].bounds = Box(x, y, x + extent(rng), y + extent(rng));
+            items[i].item = &payload[i];
+        }
+        HilbertTreeBuilder builder(nullptr);
+        PackedRTree<const int> tree = builder.buildPacked<const int>(
+            items.data(), itemCount, Box());
+
+        for (int q = 0; q < 100; q++)
+        {
+            int32_t x = coord(rng);
+            int32_t y = coord(rng);
+            Box box(x, y, x + extent(rng) * 10, y + extent(rng) * 10);
+            Collector collector;
+            CHECK_FALSE(tree.search(box, collect, &collector));
+            std::set<const int*> expected;
+            for (const BoundedItem& item : items)
+            {
+                if (item.bounds.intersects(box)) expected.insert(static_cast<int*>(item.item));
+            }
+            REQUIRE(collector.found == expected);
+
+            if (!expected.empty())
+            {
+                Collector stopping;
+                stopping.stopAt = *expected.begin();
+                CHECK(tree.search(box, collect, &stopping));
+            }
+        }
+    }
+}
+
+TEST_CASE("Empty PackedRTree finds nothing")
+{
+    PackedRTree<const int> tree;
+    Collector collector;
+    CHECK_FALSE(tree.search(Box(0, 0, 100, 100), collect, &collector));
+    CHECK(collector.found.empty());
+}
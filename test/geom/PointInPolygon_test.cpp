@@ -0,0 +1,54 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+#include <vector>
+#include <geodesk/geom/polygon/PointInPolygon.h>
+
+using namespace geodesk;
+
+// Straightforward crossing count, for comparison
+static bool isInsideOrOnBoundary(Coordinate pt, const std::vector<Coordinate>& ring)
+{
+    uint32_t crossings = 0;
+    for (size_t i = 0; i + 1 < ring.size(); i++)
+    {
+        Coordinate start = ring[i].y < ring[i+1].y ? ring[i] : ring[i+1];
+        Coordinate end = ring[i].y < ring[i+1].y ? ring[i+1] : ring[i];
+        if (pt.y < start.y || pt.y > end.y) continue;
+        int orientation = LineSegment::orientation(start, end, pt);
+        if (orientation == 0) return true;
+        if (orientation > 0) crossings += (pt.y == start.y || pt.y == end.y) ? 1 : 2;
+    }
+    return crossings & 2;
+}
+
+TEST_CASE("PointInPolygon counts crossings of a coordinate sequence")
+{
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int32_t> coord(0, 1000);
+    for (int round = 0; round < 50; round++)
+    {
+        // A zig-zag ring with vertexes on a coarse grid, so that
+        // points often coincide with vertexes and edges
+        std::vector<Coordinate> ring;
+        int n = 3 + round;
+        for (int i = 0; i < n; i++)
+        {
+            ring.emplace_back(i * 1000 / n, (i & 1) ? 900 : 100 + coord(rng) / 10 * 10);
+        }
+        ring.emplace_back(1000, 0);
+        ring.emplace_back(0, 0);
+        ring.push_back(ring[0]);
+
+        for (int i = 0; i < 200; i++)
+        {
+            Coordinate pt(coord(rng) / 10 * 10, coord(rng) / 10 * 10);
+            PointInPolygon tester(pt);
+            bool onBoundary = tester.testAgainstCoordinates(
+                ring.data(), static_cast<int>(ring.size()));
+            REQUIRE((onBoundary || tester.isInside()) == isInsideOrOnBoundary(pt, ring));
+        }
+    }
+}
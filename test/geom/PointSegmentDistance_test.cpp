@@ -0,0 +1,57 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <random>
+#include <geodesk/geom/Distance.h>
+#include <geodesk/geom/PointSegmentDistance.h>
+
+using namespace geodesk;
+
+TEST_CASE("PointSegmentDistance agrees with Distance::pointSegmentSquared")
+{
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int32_t> coord(-100000, 100000);
+    std::uniform_int_distribution<int> length(0, 23);
+
+    for (int n = 0; n < 1000; n++)
+    {
+        Coordinate point(coord(rng), coord(rng));
+        Coordinate coords[24];
+        int count = length(rng);
+        for (int i = 0; i < count; i++)
+        {
+            // Repeat some vertexes to produce zero-length segments
+            coords[i] = (i > 0 && coord(rng) > 80000) ? coords[i-1] :
+                Coordinate(coord(rng), coord(rng));
+        }
+        double expected = std::numeric_limits<double>::infinity();
+        for (int i = 1; i < count; i++)
+        {
+            expected = std::min(expected, Distance::pointSegmentSquared(
+                coords[i-1].x, coords[i-1].y, coords[i].x, coords[i].y,
+                point.x, point.y));
+        }
+        double actual = PointSegmentDistance(point).minSquared(coords, count);
+        if (count < 2)
+        {
+            REQUIRE(std::isinf(actual));
+        }
+        else
+        {
+            REQUIRE(std::abs(std::sqrt(actual) - std::sqrt(expected)) < 1e-3);
+        }
+    }
+}
+
+TEST_CASE("PointSegmentDistance stops early below the limit")
+{
+    Coordinate coords[9];
+    for (int i = 0; i < 9; i++) coords[i] = Coordinate(i * 100, 0);
+    coords[8] = Coordinate(800, 50);
+    PointSegmentDistance kernel(Coordinate(150, 10));
+    CHECK(kernel.minSquared(coords, 9) == 100);
+    CHECK(kernel.minSquared(coords, 9, 200) == 100);
+    CHECK(PointSegmentDistance(Coordinate(150, 0)).minSquared(coords, 2) == 2500);
+}
@@ -0,0 +1,78 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <filesystem>
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Buffer.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/format/WktWriter.h>
+#include <geodesk/geom/polygon/RingStore.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.multipolygonsPerTile = 20;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::string wkt(Feature f)
+{
+    clarisma::DynamicBuffer buf(4096);
+    {
+        WktWriter writer(&buf);
+        writer.writeFeature(f.store(), f.ptr());
+        writer.flush();
+    }
+    return std::string(buf.data(), buf.length());
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Precomputed rings match the rings assembled from member ways")
+{
+    // A copy of the GOL, which has no ring sidecar (placed next to the
+    // generated GOL, so it is removed along with it)
+    std::string copyName = fileName + ".copy.gol";
+    std::filesystem::copy_file(fileName, copyName,
+        std::filesystem::copy_options::overwrite_existing);
+    Features plain(copyName.c_str());
+    world.store()->buildRingStore(2);
+    const RingStore* rings = world.store()->ringStore();
+    REQUIRE(rings != nullptr);
+    REQUIRE(plain.store()->ringStore() == nullptr);
+
+    Relations areas = world.relations("a");
+    REQUIRE(rings->relationCount() == areas.count());
+    REQUIRE(rings->relationCount() > 0);
+    for (Feature area : areas)
+    {
+        std::optional<Feature> other = plain.byId(FeatureType::RELATION, area.id());
+        REQUIRE(other.has_value());
+        REQUIRE(rings->get(area.id()) != nullptr);
+        REQUIRE(area.area() == other->area());
+        REQUIRE(area.centroid() == other->centroid());
+        REQUIRE(wkt(area) == wkt(*other));
+    }
+    REQUIRE(rings->get(0) == nullptr);
+}
+
+TEST_CASE_METHOD(World, "Precomputed rings of another version of the store are ignored")
+{
+    FeatureStore* store = world.store();
+    store->buildRingStore();
+    REQUIRE(RingStore::open(fileName + ".rings",
+        store->creationTimestamp(), store->trueSize()) != nullptr);
+    REQUIRE(RingStore::open(fileName + ".rings",
+        store->creationTimestamp() + 1, store->trueSize()) == nullptr);
+    REQUIRE(RingStore::open(fileName + ".missing",
+        store->creationTimestamp(), store->trueSize()) == nullptr);
+}
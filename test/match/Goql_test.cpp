@@ -0,0 +1,99 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/match/Goql.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 400;
+    settings.streetsPerTile = 200;
+    settings.buildingsPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+/// Returns true if the query is bound to a specialized matcher, rather
+/// than the one compiled from the query string
+template<GoqlLiteral Q>
+bool isSpecialized(FeatureStore* store)
+{
+    const auto* matcher = CompiledQuery<Q>::bind(store);
+    const auto* runtimeMatcher = store->getMatcher(Q.chars);
+    bool specialized = matcher->mainMatcher().method() !=
+        runtimeMatcher->mainMatcher().method();
+    matcher->release();
+    runtimeMatcher->release();
+    return specialized;
+}
+
+/// The compiled query finds the same features as the query string
+template<GoqlLiteral Q>
+void checkSame(const Features& world, bool mustFind = true)
+{
+    uint64_t count = world(GOQL(Q)).count();
+    REQUIRE(count == world(Q.chars).count());
+    if (mustFind) REQUIRE(count > 0);
+}
+
+} // namespace
+
+TEST_CASE("GOQL parses selectors at compile time")
+{
+    using Q = CompiledQuery<"na[amenity=restaurant,cafe][ name ]">;
+    static_assert(Q::SELECTOR.types == (FeatureTypes::NODES | FeatureTypes::AREAS));
+    static_assert(Q::CLAUSE_COUNT == 2);
+    static_assert(Q::SELECTOR.clauses[0].op == GoqlSelector::Op::EQ);
+    static_assert(Q::SELECTOR.clauses[0].valueCount == 2);
+    static_assert(Q::SELECTOR.clauses[1].op == GoqlSelector::Op::HAS_KEY);
+    static_assert(CompiledQuery<"[!oneway][highway!='primary']">::SELECTOR.types ==
+        FeatureTypes::ALL);
+    static_assert(CompiledQuery<"[!oneway][highway!='primary']">::SELECTOR.clauses[1].op ==
+        GoqlSelector::Op::NE);
+
+    // Shapes beyond the compile-time subset are left to the MatcherCompiler
+    static_assert(CompiledQuery<"w[maxspeed>30]">::SELECTOR.runtimeOnly);
+    static_assert(CompiledQuery<"w[lanes=2]">::SELECTOR.runtimeOnly);
+    static_assert(CompiledQuery<"n[name=Sta*]">::SELECTOR.runtimeOnly);
+    static_assert(CompiledQuery<"n[name=Foo Bar]">::SELECTOR.runtimeOnly);
+    static_assert(CompiledQuery<"w[highway],a[building]">::SELECTOR.runtimeOnly);
+    static_assert(!CompiledQuery<"a[building]">::SELECTOR.runtimeOnly);
+}
+
+TEST_CASE_METHOD(World, "GOQL matches the same features as the query string")
+{
+    checkSame<"na[amenity=restaurant][name]">(world);
+    checkSame<"w[highway=primary,secondary,tertiary]">(world);
+    checkSame<"w[highway][!oneway]">(world);
+    checkSame<"w[highway][oneway]">(world);
+    checkSame<"w[highway][surface!=asphalt,paved]">(world);
+    checkSame<"a[building=yes,house][!name]">(world);
+    checkSame<"*[amenity]">(world);
+    checkSame<"a">(world);
+    checkSame<"n[highway=bus_stop][amenity=bench][shop][name]">(world, false);
+    checkSame<"na[amenity=pub]">(world, false);
+    checkSame<"w[lanes>2]">(world, false);
+    checkSame<"w[highway=primary],a[building]">(world, false);
+
+    // Combined with another query
+    Features streets = world("w[highway]");
+    REQUIRE(streets(GOQL("[surface=asphalt]")).count() ==
+        world("w[highway][surface=asphalt]").count());
+}
+
+TEST_CASE_METHOD(World, "GOQL falls back to the MatcherCompiler")
+{
+    FeatureStore* store = world.store();
+    REQUIRE(isSpecialized<"w[highway=primary][surface]">(store));
+    // "pub" isn't a global string in the generated GOL
+    REQUIRE(!isSpecialized<"na[amenity=pub]">(store));
+    REQUIRE(!isSpecialized<"w[lanes>2]">(store));
+}
@@ -0,0 +1,29 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Parser.h>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+using World = SyntheticGolFixture<SyntheticGol::defaultSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Queries are cached by their exact text")
+{
+    uint64_t count = world("n[amenity=restaurant]").count();
+    REQUIRE(count > 0);
+    // Spelled differently, the same query compiles to its own matcher
+    REQUIRE(world("n[ amenity = restaurant ]").count() == count);
+    REQUIRE(world("n[amenity=restaurant]").count() == count);
+
+    // An invalid spelling of a cached query is still rejected
+    world("n[population<=5000]").count();
+    REQUIRE_THROWS_AS(world("n[population< =5000]"), clarisma::ParseException);
+    REQUIRE_THROWS_AS(world("n[population< =5000]"), clarisma::ParseException);
+}
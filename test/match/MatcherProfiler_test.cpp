@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/match/MatcherProfiler.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 500;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "MatcherProfiler attributes instructions to clauses")
+{
+    const char* query = "w[highway=primary,secondary][maxspeed>30], a[building][name]";
+    MatcherProfiler profiler(world.store(), query);
+    REQUIRE(profiler.acceptedTypes() == (FeatureTypes::WAYS | FeatureTypes::AREAS));
+    uint64_t accepted = profiler.run(world);
+    REQUIRE(accepted == world(query).count());
+    REQUIRE(profiler.featuresAccepted() == accepted);
+    REQUIRE(profiler.featuresChecked() >= accepted);
+    REQUIRE(profiler.featuresChecked() > 0);
+
+    std::vector<MatcherProfiler::Origin> origins = profiler.origins();
+    uint64_t executions = 0;
+    bool seenMaxspeed = false;
+    for (const MatcherProfiler::Origin& o : origins)
+    {
+        REQUIRE(o.text == std::string_view(query).substr(o.position, o.text.size()));
+        if (o.text == "[maxspeed>30]")
+        {
+            REQUIRE(!o.isSelector);
+            seenMaxspeed = true;
+        }
+        executions += o.executions;
+    }
+    REQUIRE(seenMaxspeed);
+    REQUIRE(origins.size() >= 6);       // 2 selectors, 4 clauses
+    // Every feature runs at least a key check and a RETURN
+    REQUIRE(executions >= profiler.featuresChecked() * 2);
+
+    uint64_t opcodeExecutions = 0;
+    for (const MatcherProfiler::OpcodeCounts& c : profiler.opcodes())
+    {
+        opcodeExecutions += c.executions;
+    }
+    REQUIRE(opcodeExecutions == executions);
+
+    std::string report;
+    profiler.report(report);
+    REQUIRE(report.find("[highway=primary,secondary]") != std::string::npos);
+    REQUIRE(report.find("RETURN") != std::string::npos);
+
+    profiler.reset();
+    REQUIRE(profiler.featuresChecked() == 0);
+    REQUIRE_THROWS_AS(MatcherProfiler(world.store(), "w"), QueryException);
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/match/Matcher.h>
+#include <geodesk/match/MatcherProfiler.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 300;
+    settings.streetsPerTile = 200;
+    settings.buildingsPerTile = 100;
+    settings.routesPerTile = 3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+/// Checks every feature of the given types against the matcher that
+/// the store compiles for `types` + `clauses`, and against the
+/// bytecode that the MatcherProfiler compiles for the same query
+///
+/// @return the number of accepted features
+///
+uint64_t compare(const Features& world, const char* types,
+    const char* clauses, bool native)
+{
+    std::string query = std::string(types) + clauses;
+    const geodesk::MatcherHolder* matcher = world.store()->getMatcher(query.c_str());
+    CHECK(matcher->requiresTags() == native);
+    MatcherProfiler interpreted(world.store(), query.c_str());
+    uint64_t accepted = 0;
+    uint64_t mismatches = 0;
+    for (Feature f : world(types))
+    {
+        bool result = matcher->mainMatcher().accept(f.ptr());
+        mismatches += result != interpreted.accept(f.ptr());
+        accepted += result;
+    }
+    matcher->release();
+    CHECK(mismatches == 0);
+    return accepted;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Native matchers accept the same features as bytecode")
+{
+    // A single value, several values and several clauses (given in
+    // an order other than that of their keys)
+    REQUIRE(compare(world, "w", "[highway=primary]", true) > 0);
+    REQUIRE(compare(world, "w", "[highway=primary,secondary,tertiary]", true) > 0);
+    REQUIRE(compare(world, "w", "[highway=residential,service][surface=asphalt,paved]", true) > 0);
+    REQUIRE(compare(world, "w", "[surface=asphalt,gravel][highway=residential,track]", true) > 0);
+    REQUIRE(compare(world, "n", "[amenity=restaurant,cafe,fast_food][cuisine=pizza,italian]", true) > 0);
+    REQUIRE(compare(world, "a", "[building=yes,house,residential,garage,apartments,detached,shed,commercial]", true) > 0);
+
+    // The clause's key is the feature's last global tag (which carries
+    // the 0x8000 flag): `oneway` comes after every other global key of
+    // a street except `lanes`
+    REQUIRE(compare(world, "w", "[oneway=yes]", true) > 0);
+    REQUIRE(compare(world, "w", "[highway=residential,service,track][oneway=yes]", true) > 0);
+    uint64_t lastTag = 0;
+    for (Feature f : world("w[oneway=yes]"))
+    {
+        lastTag += !f.hasTag("lanes");
+    }
+    REQUIRE(lastTag > 0);
+
+    // Keys that the features don't have, or whose values aren't
+    // global strings (numbers, local strings)
+    REQUIRE(compare(world, "n", "[boundary=administrative]", true) == 0);
+    REQUIRE(compare(world, "w", "[highway=primary][boundary=administrative]", true) == 0);
+    REQUIRE(compare(world, "w", "[maxspeed=yes]", true) == 0);
+    REQUIRE(compare(world, "w", "[lanes=no,yes]", true) == 0);
+    REQUIRE(compare(world, "a", "[addr:housenumber=yes]", true) == 0);
+}
+
+TEST_CASE_METHOD(World, "Queries that native matchers can't handle fall back to bytecode")
+{
+    REQUIRE(compare(world, "w", "[highway!=primary]", false) > 0);
+    REQUIRE(compare(world, "w", "[highway=primary][!oneway]", false) > 0);
+    REQUIRE(compare(world, "w", "[maxspeed>30]", false) > 0);
+    REQUIRE(compare(world, "w", "[maxspeed=50]", false) > 0);
+    REQUIRE(compare(world, "w", "[highway=*ary]", false) > 0);
+    REQUIRE(compare(world, "n", "[name]", false) > 0);
+    REQUIRE(compare(world, "w", "[highway=residential][name]", false) > 0);
+    // More than MAX_NATIVE_VALUES values
+    REQUIRE(compare(world, "w", "[highway=residential,service,footway,track,"
+        "unclassified,tertiary,secondary,path,primary]", false) > 0);
+}
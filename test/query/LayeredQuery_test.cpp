@@ -0,0 +1,137 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/filter/AreaFilter.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 300;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 5;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::vector<uint64_t> typedIds(const Features& features)
+{
+    std::vector<uint64_t> ids;
+    for (Feature f : features) ids.push_back(f.ptr().typedId());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/// Runs a layered query and returns the sorted IDs of each layer
+std::vector<std::vector<uint64_t>> runLayers(FeatureStore* store, const Box& box,
+    const std::vector<QueryLayer>& layers, QueryStats* stats = nullptr)
+{
+    std::vector<std::vector<uint64_t>> ids(layers.size());
+    {
+        Query query(store, box, layers.data(),
+            static_cast<uint32_t>(layers.size()), stats);
+        for (;;)
+        {
+            uint32_t layer;
+            FeaturePtr feature = query.next(&layer);
+            if (feature.isNull()) break;
+            ids.at(layer).push_back(feature.typedId());
+        }
+    }
+    for (std::vector<uint64_t>& layerIds : ids) std::sort(layerIds.begin(), layerIds.end());
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "A layered query finds the features of each layer")
+{
+    FeatureStore* store = world.store();
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+
+    Features buildings = world("a[building]")(bounds);
+    std::vector<double> areas;
+    for (Feature f : buildings) areas.push_back(f.area());
+    REQUIRE(!areas.empty());
+    std::sort(areas.begin(), areas.end());
+    double minArea = areas[areas.size() / 2];
+    AreaFilter largeArea(minArea, std::numeric_limits<double>::infinity());
+
+    const auto* highways = store->getMatcher("w[highway]");
+    const auto* buildingMatcher = store->getMatcher("a[building]");
+    const auto* amenities = store->getMatcher("na[amenity]");
+    const auto* named = store->getMatcher("*[name]");
+    std::vector<QueryLayer> layers =
+    {
+        { FeatureTypes::ALL, highways, nullptr },
+        { FeatureTypes::ALL, buildingMatcher, &largeArea },
+        { FeatureTypes::ALL, amenities, nullptr },
+        { FeatureTypes::NODES, nullptr, nullptr },
+        { FeatureTypes::WAYS, named, nullptr },
+    };
+    std::vector<uint64_t> largeBuildings;
+    for (Feature f : buildings)
+    {
+        if (f.area() >= minArea) largeBuildings.push_back(f.ptr().typedId());
+    }
+    std::sort(largeBuildings.begin(), largeBuildings.end());
+    std::vector<std::vector<uint64_t>> expected =
+    {
+        typedIds(world("w[highway]")(bounds)),
+        largeBuildings,
+        typedIds(world("na[amenity]")(bounds)),
+        typedIds(world.nodes()(bounds)),
+        typedIds(world.ways()("*[name]")(bounds))
+    };
+    for (const std::vector<uint64_t>& ids : expected) REQUIRE(!ids.empty());
+
+    QueryStats stats;
+    REQUIRE(runLayers(store, bounds, layers, &stats) == expected);
+    QueryStats singleStats;
+    {
+        Query query(store, bounds, FeatureTypes::ALL,
+            store->borrowAllMatcher(), nullptr, nullptr, &singleStats);
+        while (!query.next().isNull()) {}
+    }
+    // Each tile is scanned once, regardless of the number of layers
+    REQUIRE(stats.tilesScanned == singleStats.tilesScanned);
+
+    highways->release();
+    buildingMatcher->release();
+    amenities->release();
+    named->release();
+}
+
+TEST_CASE_METHOD(World, "A layered query skips the indexes that no layer needs")
+{
+    FeatureStore* store = world.store();
+    Box bounds = Box::ofWSEN(7.1, 43.6, 7.9, 44.4);
+    const auto* highways = store->getMatcher("w[highway]");
+    const auto* amenities = store->getMatcher("na[amenity]");
+    std::vector<QueryLayer> layers =
+    {
+        { FeatureTypes::ALL, highways, nullptr },
+        { FeatureTypes::ALL, amenities, nullptr },
+    };
+    QueryStats stats;
+    std::vector<std::vector<uint64_t>> ids = runLayers(store, bounds, layers, &stats);
+    REQUIRE(ids[0] == typedIds(world("w[highway]")(bounds)));
+    REQUIRE(ids[1] == typedIds(world("na[amenity]")(bounds)));
+    REQUIRE(stats.indexRootsPruned > 0);
+    highways->release();
+    amenities->release();
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cmath>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/WayCoordinateIterator.h>
+#include <geodesk/geom/Mercator.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.streetsPerTile = 300;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+/// A trace that follows the way, with points every few meters that
+/// stray from it by up to 3 meters (alternating sides)
+MapMatcher::Trace traceAlong(WayPtr way)
+{
+    MapMatcher::Trace trace;
+    WayCoordinateIterator iter(way);
+    Coordinate prev = iter.next();
+    int n = 0;
+    while (iter.coordinatesRemaining() > 0)
+    {
+        Coordinate next = iter.next();
+        double dx = static_cast<double>(next.x) - prev.x;
+        double dy = static_cast<double>(next.y) - prev.y;
+        double length = std::sqrt(dx * dx + dy * dy);
+        double unitsPerMeter = Mercator::unitsFromMeters(1, prev.y);
+        int steps = std::max(1, static_cast<int>(length / unitsPerMeter / 10));
+        for (int i = 0; i < steps; i++, n++)
+        {
+            double t = static_cast<double>(i) / steps;
+            double offset = (n % 7 - 3) * unitsPerMeter;
+            double normal = length == 0 ? 0 : offset / length;
+            trace.emplace_back(
+                static_cast<int32_t>(prev.x + t * dx - dy * normal),
+                static_cast<int32_t>(prev.y + t * dy + dx * normal));
+        }
+        prev = next;
+    }
+    trace.push_back(prev);
+    return trace;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "MapMatcher snaps traces to the ways they follow")
+{
+    Features streets = world("w[highway]");
+
+    std::vector<MapMatcher::Trace> traces;
+    std::vector<uint64_t> sources;
+    for (Feature street : streets)
+    {
+        if (street.isArea()) continue;
+        traces.push_back(traceAlong(WayPtr(street.ptr())));
+        sources.push_back(street.id());
+        if (traces.size() == 500) break;
+    }
+    REQUIRE(traces.size() == 500);
+
+    std::vector<MapMatcher::MatchedTrace> results = streets.matchTraces(traces);
+    REQUIRE(results.size() == traces.size());
+    size_t pointCount = 0;
+    size_t onSource = 0;
+    for (size_t i = 0; i < traces.size(); i++)
+    {
+        REQUIRE(results[i].size() == traces[i].size());
+        for (const MapMatcher::MatchedPoint& point : results[i])
+        {
+            REQUIRE(point.isMatched());
+            pointCount++;
+            if (point.way != sources[i]) continue;
+            REQUIRE(point.meters < 3.5);
+            onSource++;
+        }
+    }
+    // Points near crossings may be matched to a crossing street
+    REQUIRE(onSource > pointCount * 9 / 10);
+}
+
+TEST_CASE_METHOD(World, "MapMatcher leaves points without nearby ways unmatched")
+{
+    Features streets = world("w[highway]");
+    MapMatcher::Settings settings;
+    settings.searchMeters = 40;
+
+    // Points on a grid across the generated area
+    Box bounds = Box::ofWSEN(7.0, 43.5, 8.0, 44.5);
+    MapMatcher::Trace grid;
+    for (int row = 0; row < 50; row++)
+    {
+        for (int col = 0; col < 50; col++)
+        {
+            grid.emplace_back(
+                bounds.minX() + static_cast<int32_t>(bounds.widthSimple() / 50 * col),
+                bounds.minY() + static_cast<int32_t>(bounds.height() / 50 * row));
+        }
+    }
+    // A point far from any street splits the trace
+    MapMatcher::Trace remote = grid;
+    remote.insert(remote.begin() + 100, Coordinate::ofLonLat(-40, 0));
+
+    std::vector<MapMatcher::MatchedTrace> results =
+        streets.matchTraces({ grid, remote }, settings);
+    REQUIRE(results.size() == 2);
+    size_t matchedCount = 0;
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        const MapMatcher::MatchedPoint& point = results[0][i];
+        bool nearStreet = streets.maxMetersFrom(settings.searchMeters, grid[i]).count() > 0;
+        REQUIRE(point.isMatched() == nearStreet);
+        if (!point.isMatched()) continue;
+        matchedCount++;
+        REQUIRE(point.meters <= settings.searchMeters);
+        REQUIRE(streets.maxMetersFrom(point.meters + 0.5, grid[i])
+            .contains(streets.nearest(grid[i], 1).front()));
+    }
+    REQUIRE(matchedCount > 0);
+    REQUIRE(matchedCount < grid.size());
+
+    REQUIRE(results[1].size() == remote.size());
+    REQUIRE(!results[1][100].isMatched());
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        REQUIRE(results[1][i < 100 ? i : i + 1].isMatched() == results[0][i].isMatched());
+    }
+}
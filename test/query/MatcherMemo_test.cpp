@@ -0,0 +1,117 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <string>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 400;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+bool dependsOnlyOnTags(FeatureStore* store, const char* query)
+{
+    const auto* matcher = store->getMatcher(query);
+    bool tagsOnly = matcher->dependsOnlyOnTags();
+    matcher->release();
+    return tagsOnly;
+}
+
+uint64_t count(FeatureStore* store, const char* query, QueryStats& stats)
+{
+    const auto* matcher = store->getMatcher(query);
+    uint64_t n = 0;
+    {
+        Query q(store, Box::ofWorld(), matcher->acceptedTypes(),
+            matcher, nullptr, nullptr, &stats);
+        while (!q.next().isNull()) n++;
+    }
+    matcher->release();
+    return n;
+}
+
+/// Counts the features accepted by the matcher, checking each one
+uint64_t countEach(const Features& world, const char* query)
+{
+    const auto* matcher = world.store()->getMatcher(query);
+    uint64_t n = 0;
+    for (Feature f : world)
+    {
+        FeaturePtr p = f.ptr();
+        if (matcher->acceptedTypes().acceptFlags(p.flags()) &&
+            matcher->mainMatcher().accept(p))
+        {
+            n++;
+        }
+    }
+    matcher->release();
+    return n;
+}
+
+/// Accepts features with odd IDs, regardless of their tags
+bool acceptOddId(const Matcher*, FeaturePtr p)
+{
+    return p.id() & 1;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Matchers know whether they depend only on tags")
+{
+    FeatureStore* store = world.store();
+    REQUIRE(dependsOnlyOnTags(store, "na[amenity]"));
+    REQUIRE(dependsOnlyOnTags(store, "w[highway=residential,service]"));
+    REQUIRE(dependsOnlyOnTags(store, "*[name][!building]"));
+    REQUIRE(dependsOnlyOnTags(store, "*[name=*straße]"));
+    REQUIRE(dependsOnlyOnTags(store, "n[amenity], w[highway]"));
+}
+
+TEST_CASE_METHOD(World, "Matcher verdicts are reused for shared tag tables")
+{
+    FeatureStore* store = world.store();
+    for (const char* query : { "*[name][!building]", "na[amenity]",
+        "w[highway=residential,service]", "*[name=*straße]",
+        "n[amenity], w[highway]", "a[building]" })
+    {
+        uint64_t expected = countEach(world, query);
+        QueryStats stats;
+        REQUIRE(count(store, query, stats) == expected);
+    }
+
+    QueryStats stats;
+    uint64_t buildings = count(store, "a[building][!name]", stats);
+    REQUIRE(buildings > 0);
+    REQUIRE(stats.matcherMemoHits > 0);
+    REQUIRE(stats.toString().find("reused") != std::string::npos);
+
+    // A matcher that looks at more than tags is called for every feature
+    const auto* oddIds = geodesk::MatcherHolder::createNative(FeatureTypes::AREAS,
+        0, Matcher(acceptOddId, store));
+    REQUIRE(!oddIds->dependsOnlyOnTags());
+    uint64_t expected = 0;
+    for (Feature f : world("a")) expected += f.id() & 1;
+    REQUIRE(expected > 0);
+    QueryStats oddStats;
+    uint64_t n = 0;
+    {
+        Query q(store, Box::ofWorld(), FeatureTypes::AREAS, oddIds,
+            nullptr, nullptr, &oddStats);
+        while (!q.next().isNull()) n++;
+    }
+    oddIds->release();
+    REQUIRE(n == expected);
+    REQUIRE(oddStats.matcherMemoHits == 0);
+}
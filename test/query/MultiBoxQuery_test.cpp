@@ -0,0 +1,60 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 20;
+    settings.buildingsPerTile = 20;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.6, 44.0);
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Multi-box queries report each feature once per box it intersects")
+{
+    // Boxes far apart, so most tiles in their union intersect none
+    // of them; the last one overlaps the first
+    std::vector<Box> boxes =
+    {
+        Box::ofWSEN(7.02, 43.52, 7.08, 43.57),
+        Box::ofWSEN(7.50, 43.93, 7.58, 43.98),
+        Box::ofWSEN(7.51, 43.53, 7.55, 43.56),
+        Box::ofWSEN(7.05, 43.55, 7.10, 43.60),
+    };
+
+    std::set<std::pair<uint64_t,uint32_t>> expected;
+    for (uint32_t i = 0; i < boxes.size(); i++)
+    {
+        for (Feature f : world(boxes[i]))
+        {
+            expected.insert({ f.ptr().typedId(), i });
+        }
+    }
+    REQUIRE(!expected.empty());
+
+    std::vector<std::pair<uint64_t,uint32_t>> reported;
+    world.forEachInBoxes(boxes, [&reported](Feature f, uint32_t box)
+    {
+        reported.push_back({ f.ptr().typedId(), box });
+    });
+    std::set<std::pair<uint64_t,uint32_t>> unique(reported.begin(), reported.end());
+    REQUIRE(unique.size() == reported.size());
+    REQUIRE(unique == expected);
+}
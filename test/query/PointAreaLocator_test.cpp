@@ -0,0 +1,95 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/PointAreaLocator.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+/// Stands in for a device: runs the reference kernel
+class TestAccelerator : public PointInPolygonAccelerator
+{
+public:
+    explicit TestAccelerator(bool available) : available_(available) {}
+
+    size_t minBatchSize() const override { return 2; }
+
+    bool containsPoints(const FlatChains& polygon,
+        std::span<const Coordinate> points, bool* results) override
+    {
+        batches++;
+        if (!available_) return false;
+        polygon.containsPoints(points, results);
+        return true;
+    }
+
+    std::atomic<int> batches = 0;
+
+private:
+    bool available_;
+};
+
+using AreaSets = std::vector<std::set<uint64_t>>;
+
+AreaSets locate(const Features& areas, const std::vector<Coordinate>& points)
+{
+    AreaSets found(points.size());
+    areas.forEachContainingArea(points, [&found](size_t i, Feature area)
+    {
+        found[i].insert(area.id());
+    });
+    return found;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.buildingsPerTile = 300;
+    settings.multipolygonsPerTile = 20;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "PointAreaLocator offloads batches to an accelerator")
+{
+    Features areas = world("a");
+
+    std::mt19937 rng(3);
+    Box bounds = worldSettings().bounds;
+    std::uniform_int_distribution<int32_t> x(bounds.minX(), bounds.maxX());
+    std::uniform_int_distribution<int32_t> y(bounds.minY(), bounds.maxY());
+    std::vector<Coordinate> points;
+    for (int i = 0; i < 20000; i++) points.emplace_back(x(rng), y(rng));
+
+    AreaSets expected = locate(areas, points);
+    size_t hitCount = 0;
+    for (const auto& found : expected) hitCount += found.size();
+    REQUIRE(hitCount > 0);
+
+    auto accelerator = std::make_shared<TestAccelerator>(true);
+    PointAreaLocator::setAccelerator(accelerator);
+    AreaSets offloaded = locate(areas, points);
+    REQUIRE(accelerator->batches > 0);
+    REQUIRE(offloaded == expected);
+
+    // If the device can't run a batch, the CPU takes over
+    auto unavailable = std::make_shared<TestAccelerator>(false);
+    PointAreaLocator::setAccelerator(unavailable);
+    REQUIRE(locate(areas, points) == expected);
+    REQUIRE(unavailable->batches > 0);
+
+    PointAreaLocator::setAccelerator(nullptr);
+    REQUIRE(PointAreaLocator::accelerator() == nullptr);
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 20;
+    settings.buildingsPerTile = 20;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.6, 44.0);
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+/// The column or row of the tile at the given zoom level
+int tileColumn(int32_t x, int zoom)
+{
+    return static_cast<int>((static_cast<int64_t>(x) + (1LL << 31)) >> (32 - zoom));
+}
+
+int tileRow(int32_t y, int zoom)
+{
+    return static_cast<int>((0x7fff'ffffLL - y) >> (32 - zoom));
+}
+
+/// The clusters of all tiles at the given zoom level that cover `bounds`
+std::vector<PointClusters::Cluster> clustersAt(const PointClusters& clusters,
+    const Box& bounds, int zoom)
+{
+    std::vector<PointClusters::Cluster> all;
+    for (int row = tileRow(bounds.maxY(), zoom); row <= tileRow(bounds.minY(), zoom); row++)
+    {
+        for (int col = tileColumn(bounds.minX(), zoom);
+            col <= tileColumn(bounds.maxX(), zoom); col++)
+        {
+            std::vector<PointClusters::Cluster> tile = clusters.clusters(col, row, zoom);
+            all.insert(all.end(), tile.begin(), tile.end());
+        }
+    }
+    return all;
+}
+
+/// The bounds of the locations of the features (which may extend
+/// slightly beyond the bounds of the generated world)
+Box pointBounds(const Features& features)
+{
+    Box bounds;
+    for (Feature f : features) bounds.expandToInclude(f.isNode() ? f.xy() : f.centroid());
+    return bounds;
+}
+
+uint64_t totalCount(const std::vector<PointClusters::Cluster>& clusters)
+{
+    uint64_t total = 0;
+    for (const PointClusters::Cluster& c : clusters) total += c.count;
+    return total;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Every point belongs to one cluster at each zoom level")
+{
+    Nodes nodes = world.nodes();
+    PointClusters::Settings settings;
+    settings.maxZoom = 14;
+    PointClusters clusters = nodes.clusters(settings);
+    uint64_t nodeCount = nodes.count();
+    REQUIRE(clusters.pointCount() == nodeCount);
+    REQUIRE(totalCount(clusters.clusters(Tile::fromColumnRowZoom(0, 0, 0))) == nodeCount);
+
+    Box bounds = pointBounds(nodes);
+    size_t previous = 0;
+    for (int zoom = 4; zoom <= 14; zoom += 2)
+    {
+        std::vector<PointClusters::Cluster> all = clustersAt(clusters, bounds, zoom);
+        REQUIRE(totalCount(all) == nodeCount);
+        REQUIRE(all.size() >= previous);     // finer cells, more clusters
+        previous = all.size();
+    }
+
+    // Above maxZoom, each feature is returned as a point
+    std::vector<PointClusters::Cluster> points = clustersAt(clusters, bounds, 15);
+    REQUIRE(points.size() == nodeCount);
+    std::set<uint64_t> ids;
+    for (const PointClusters::Cluster& c : points)
+    {
+        REQUIRE(c.isPoint());
+        ids.insert(c.typedId);
+    }
+    REQUIRE(ids.size() == nodeCount);
+    for (Node node : nodes)
+    {
+        REQUIRE(ids.count(node.ptr().typedId()) == 1);
+    }
+}
+
+TEST_CASE_METHOD(World, "Clusters count the points with each of the counted tags")
+{
+    Features features = world("na");
+    PointClusters::Settings settings;
+    settings.maxZoom = 12;
+    settings.minPoints = 3;
+    settings.countedTags = { "amenity", "shop=bakery" };
+    PointClusters clusters = features.clusters(settings);
+    REQUIRE(clusters.countedTagCount() == 2);
+
+    uint64_t amenities = world("na[amenity][amenity!=no]").count();
+    uint64_t bakeries = world("na[shop=bakery]").count();
+    REQUIRE(amenities > 0);
+    REQUIRE(bakeries > 0);
+    Box bounds = pointBounds(features);
+    for (int zoom = 0; zoom <= 12; zoom += 4)
+    {
+        std::vector<PointClusters::Cluster> all = clustersAt(clusters, bounds, zoom);
+        uint64_t amenityCount = 0;
+        uint64_t bakeryCount = 0;
+        for (const PointClusters::Cluster& c : all)
+        {
+            REQUIRE((c.count >= 3 || c.isPoint()));
+            REQUIRE(c.tagCount(0) <= c.count);
+            amenityCount += c.tagCount(0);
+            bakeryCount += c.tagCount(1);
+        }
+        REQUIRE(totalCount(all) == features.count());
+        REQUIRE(amenityCount == amenities);
+        REQUIRE(bakeryCount == bakeries);
+    }
+}
+
+TEST_CASE_METHOD(World, "Invalid cluster settings are rejected")
+{
+    PointClusters::Settings settings;
+    settings.cellsPerTile = 12;
+    REQUIRE_THROWS_AS(world.nodes().clusters(settings), clarisma::ValueException);
+    settings.cellsPerTile = 16;
+    settings.minZoom = 10;
+    settings.maxZoom = 8;
+    REQUIRE_THROWS_AS(world.nodes().clusters(settings), clarisma::ValueException);
+    settings.minZoom = 0;
+    settings.maxZoom = 30;
+    REQUIRE_THROWS_AS(world.nodes().clusters(settings), clarisma::ValueException);
+}
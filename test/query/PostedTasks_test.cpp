@@ -0,0 +1,106 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include <geodesk/query/TileReducer.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+/// Counts features, and keeps the workers busy on every tile
+/// they scan (but not the consumer)
+class SlowWorkers : public TileReducer
+{
+public:
+    explicit SlowWorkers(std::thread::id consumer) : consumer_(consumer) {}
+
+    void beginTile(uint32_t) override
+    {
+        if (std::this_thread::get_id() == consumer_)
+        {
+            consumerTiles++;
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    void reduce(FeatureStore*, const FeaturePtr*, size_t count) override
+    {
+        features += count;
+    }
+
+    std::atomic<uint64_t> features = 0;
+    std::atomic<uint64_t> consumerTiles = 0;
+
+private:
+    std::thread::id consumer_;
+};
+
+} // namespace
+
+TEST_CASE_METHOD(World, "The consumer runs its queued tiles while the workers are busy")
+{
+    FeatureStore* store = world.store();
+    uint64_t expected = world.nodes().count();
+    REQUIRE(expected > 0);
+    // Tasks of the count() that the consumer ran itself stay queued
+    // until a worker drops them; wait for that, so our tiles can be
+    // queued at all
+    while (store->executor().pendingTasks() > 0) std::this_thread::yield();
+
+    SlowWorkers reducer(std::this_thread::get_id());
+    QueryStats stats;
+    {
+        Query query(store, Box::ofWorld(), FeatureTypes::NODES,
+            store->borrowAllMatcher(), nullptr, &reducer, &stats);
+        // (Nodes are never duplicated, so the reducer sees them all)
+        REQUIRE(query.next().isNull());
+    }
+    REQUIRE(reducer.features == expected);
+    REQUIRE(stats.tasksHelped > 0);
+    REQUIRE(reducer.consumerTiles >= stats.tasksHelped);
+}
+
+TEST_CASE_METHOD(World, "Concurrent queries only run their own tiles")
+{
+    uint64_t nodes = world.nodes().count();
+    uint64_t streets = world("w[highway]").count();
+    std::atomic<int> mismatches = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++)
+    {
+        threads.emplace_back([this, i, nodes, streets, &mismatches]()
+        {
+            for (int run = 0; run < 20; run++)
+            {
+                if ((run + i) % 2)
+                {
+                    mismatches += world.nodes().count() != nodes;
+                }
+                else
+                {
+                    mismatches += world("w[highway]").count() != streets;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    REQUIRE(mismatches == 0);
+}
@@ -0,0 +1,124 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <unordered_set>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/PreparedQuery.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+uint64_t countAll(Query& query)
+{
+    uint64_t count = 0;
+    while (!query.next().isNull()) count++;
+    return count;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+GolGenerator::Settings multiTileSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    settings.multiTileShare = 0.25;
+    return settings;
+}
+
+using MultiTileWorld = SyntheticGolFixture<multiTileSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "PreparedQuery")
+{
+    Box box = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    Features buildings = world("a[building]")(box);
+
+    PreparedQuery prepared(buildings);
+    REQUIRE(prepared.tileCount() >= prepared.tiles().size());
+    REQUIRE(!prepared.tiles().empty());
+    for (size_t i = 1; i < prepared.tiles().size(); i++)
+    {
+        REQUIRE(prepared.tiles()[i - 1].key <= prepared.tiles()[i].key);
+    }
+
+    uint64_t expected = buildings.count();
+    REQUIRE(expected > 0);
+    for (int i = 0; i < 3; i++)
+    {
+        Query query(prepared);
+        REQUIRE(countAll(query) == expected);
+    }
+
+    QueryOptions options;
+    options.ordered = true;
+    Query ordered(prepared, nullptr, nullptr, options);
+    REQUIRE(countAll(ordered) == expected);
+
+    options = {};
+    options.sampleFraction = 0.5;
+    Query sampled(prepared, nullptr, nullptr, options);
+    uint64_t sampledCount = countAll(sampled);
+    REQUIRE(sampled.tileCount() == prepared.tileCount());
+    REQUIRE(sampled.sampledTileCount() < prepared.tiles().size());
+    REQUIRE(sampledCount <= expected);
+
+    REQUIRE_THROWS_AS(PreparedQuery(world.ways().first()->nodes()), QueryException);
+}
+
+TEST_CASE_METHOD(MultiTileWorld, "PreparedQuery shards")
+{
+    Features features = world(Box::ofWSEN(7.2, 43.7, 7.6, 44.1));
+
+    PreparedQuery full(features);
+    std::unordered_set<uint64_t> expected;
+    {
+        Query query(full);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            expected.insert(next.typedId());
+        }
+    }
+    REQUIRE(expected.size() > 0);
+
+    const uint32_t shardCount = 5;
+    std::unordered_set<uint64_t> found;
+    size_t tileCount = 0;
+    uint64_t totalBytes = 0;
+    uint64_t maxBytes = 0;
+    for (uint32_t shard = 0; shard < shardCount; shard++)
+    {
+        PreparedQuery prepared(features, shard, shardCount);
+        REQUIRE(prepared.isShard());
+        REQUIRE(prepared.tileCount() == full.tileCount());
+        tileCount += prepared.tiles().size();
+        totalBytes += prepared.tileBytes();
+        maxBytes = std::max(maxBytes, prepared.tileBytes());
+        Query query(prepared);
+        for (;;)
+        {
+            FeaturePtr next = query.next();
+            if (next.isNull()) break;
+            // No feature is returned by more than one shard
+            REQUIRE(found.insert(next.typedId()).second);
+        }
+    }
+    REQUIRE(tileCount == full.tiles().size());
+    REQUIRE(found == expected);
+    REQUIRE(maxBytes < totalBytes / shardCount * 2);
+
+    REQUIRE_THROWS_AS(PreparedQuery(features, 5, 5), QueryException);
+}
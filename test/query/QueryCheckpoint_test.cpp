@@ -0,0 +1,150 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <unordered_set>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/feature/QueryException.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 100;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+QueryOptions orderedOptions(const QueryCheckpoint* resume = nullptr)
+{
+    QueryOptions options;
+    options.ordered = true;
+    options.resume = resume;
+    return options;
+}
+
+std::vector<uint64_t> idsOf(Query& query, size_t max = SIZE_MAX)
+{
+    std::vector<uint64_t> ids;
+    while (ids.size() < max)
+    {
+        FeaturePtr f = query.next();
+        if (f.isNull()) break;
+        ids.push_back(f.idBits());
+    }
+    return ids;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Query resumes from a checkpoint")
+{
+    FeatureStore* store = world.store();
+    Box bounds = Box::ofWSEN(7.1, 43.6, 7.9, 44.4);
+
+    std::vector<uint64_t> expected;
+    {
+        Query query(store, bounds, FeatureTypes::ALL,
+            store->borrowAllMatcher(), nullptr, nullptr, nullptr, orderedOptions());
+        expected = idsOf(query);
+    }
+    REQUIRE(expected.size() > 1000);
+    REQUIRE(std::unordered_set<uint64_t>(expected.begin(), expected.end()).size() ==
+        expected.size());
+
+    // Page through the results, resuming each page from the checkpoint
+    // of the previous one (in serialized form)
+    for (size_t pageSize : { size_t(1), size_t(37), size_t(500), expected.size() })
+    {
+        std::vector<uint64_t> ids;
+        std::vector<uint8_t> saved;
+        int pages = 0;
+        for (;;)
+        {
+            QueryCheckpoint checkpoint;
+            if (pages > 0) checkpoint = QueryCheckpoint::deserialize(saved);
+            Query query(store, bounds, FeatureTypes::ALL, store->borrowAllMatcher(),
+                nullptr, nullptr, nullptr, orderedOptions(pages ? &checkpoint : nullptr));
+            std::vector<uint64_t> page = idsOf(query, pageSize);
+            if (page.empty()) break;
+            ids.insert(ids.end(), page.begin(), page.end());
+            QueryCheckpoint next = query.checkpoint();
+            saved = next.serialize();
+            REQUIRE(QueryCheckpoint::deserialize(saved) == next);
+            pages++;
+            if (pageSize == 1 && pages > 300) break;
+        }
+        if (pageSize == 1)
+        {
+            REQUIRE(ids.size() == 301);
+            ids.resize(301);
+            REQUIRE(std::vector<uint64_t>(expected.begin(), expected.begin() + 301) == ids);
+        }
+        else
+        {
+            REQUIRE(ids == expected);
+        }
+    }
+}
+
+TEST_CASE_METHOD(World, "Query checkpoint before the first feature")
+{
+    FeatureStore* store = world.store();
+    Query first(store, Box::ofWorld(), FeatureTypes::WAYS,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, orderedOptions());
+    QueryCheckpoint checkpoint = first.checkpoint();
+    REQUIRE(checkpoint.tile == 0);
+    REQUIRE(checkpoint.items == 0);
+    std::vector<uint64_t> expected = idsOf(first);
+
+    Query resumed(store, Box::ofWorld(), FeatureTypes::WAYS,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, orderedOptions(&checkpoint));
+    // A resumed query that hasn't returned anything yet yields the
+    // same checkpoint
+    REQUIRE(resumed.checkpoint() == checkpoint);
+    REQUIRE(idsOf(resumed) == expected);
+
+    // Resuming at the end yields nothing
+    QueryCheckpoint end = first.checkpoint();
+    REQUIRE(end.tile == end.tileCount);
+    Query done(store, Box::ofWorld(), FeatureTypes::WAYS,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, orderedOptions(&end));
+    REQUIRE(done.next().isNull());
+}
+
+TEST_CASE_METHOD(World, "Query rejects a mismatched checkpoint")
+{
+    FeatureStore* store = world.store();
+    Query query(store, Box::ofWorld(), FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, orderedOptions());
+    query.next();
+    QueryCheckpoint checkpoint = query.checkpoint();
+
+    QueryCheckpoint otherStore = checkpoint;
+    otherStore.storeTimestamp++;
+    REQUIRE_THROWS_AS(Query(store, Box::ofWorld(), FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr,
+        orderedOptions(&otherStore)), QueryException);
+    REQUIRE_THROWS_AS(Query(store, Box::ofWorld(), FeatureTypes::NODES,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr,
+        orderedOptions(&checkpoint)), QueryException);
+
+    QueryOptions unordered;
+    unordered.resume = &checkpoint;
+    REQUIRE_THROWS_AS(Query(store, Box::ofWorld(), FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, unordered), QueryException);
+
+    std::vector<uint8_t> data = checkpoint.serialize();
+    data.pop_back();
+    REQUIRE_THROWS_AS(QueryCheckpoint::deserialize(data), QueryException);
+}
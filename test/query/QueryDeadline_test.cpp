@@ -0,0 +1,141 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include <geodesk/query/TileReducer.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+double distance(Feature f, Coordinate focus)
+{
+    Coordinate xy = f.xy();
+    return std::hypot(static_cast<double>(xy.x) - focus.x,
+        static_cast<double>(xy.y) - focus.y);
+}
+
+/// Keeps the workers busy on every tile they scan (but not the
+/// consumer, which runs the tiles that are still queued once a
+/// worker has started one)
+class SlowWorkers : public TileReducer
+{
+public:
+    explicit SlowWorkers(std::thread::id consumer) : consumer_(consumer) {}
+
+    void beginTile(uint32_t) override
+    {
+        if (std::this_thread::get_id() == consumer_)
+        {
+            auto giveUp = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+            while (!workerStarted_ && std::chrono::steady_clock::now() < giveUp)
+            {
+                std::this_thread::yield();
+            }
+            return;
+        }
+        workerStarted_ = true;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    void reduce(FeatureStore*, const FeaturePtr*, size_t) override {}
+
+private:
+    std::thread::id consumer_;
+    std::atomic<bool> workerStarted_ = false;
+};
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Query with a focus scans the nearest tiles first")
+{
+    FeatureStore* store = world.store();
+    uint64_t expected = world.nodes().count();
+    REQUIRE(expected > 0);
+
+    QueryOptions options;
+    options.ordered = true;
+    options.focus = Coordinate::ofLonLat(7.5, 44.0);
+    Query query(store, Box::ofWorld(), FeatureTypes::NODES,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, options);
+    FeaturePtr first = query.next();
+    FeaturePtr last = first;
+    uint64_t count = 1;
+    for (;;)
+    {
+        FeaturePtr next = query.next();
+        if (next.isNull()) break;
+        last = next;
+        count++;
+    }
+    REQUIRE(count == expected);
+    REQUIRE(query.isComplete());
+    REQUIRE(distance(Feature(store, first), *options.focus) <
+        distance(Feature(store, last), *options.focus));
+}
+
+TEST_CASE_METHOD(World, "Query stops at its deadline")
+{
+    FeatureStore* store = world.store();
+    Features nodes = world.nodes();
+    uint64_t expected = nodes.count();
+    Coordinate focus = Coordinate::ofLonLat(7.5, 44.0);
+
+    uint64_t count = 0;
+    bool complete = nodes.forEachUntil(
+        std::chrono::steady_clock::now() + std::chrono::hours(1), focus,
+        [&count](Feature) { count++; });
+    REQUIRE(complete);
+    REQUIRE(count == expected);
+
+    QueryOptions options;
+    options.deadline = std::chrono::steady_clock::now();
+    Query query(store, Box::ofWorld(), FeatureTypes::NODES,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, options);
+    count = 0;
+    while (!query.next().isNull()) count++;
+    REQUIRE(!query.isComplete());
+    REQUIRE(count < expected);
+
+    count = 0;
+    complete = nodes.forEachUntil(std::chrono::steady_clock::now(), focus,
+        [&count](Feature) { count++; });
+    REQUIRE(!complete);
+    REQUIRE(count < expected);
+}
+
+TEST_CASE_METHOD(World, "A query that waits for its tiles stops at its deadline")
+{
+    FeatureStore* store = world.store();
+    // Tasks of earlier queries that the consumer ran itself stay
+    // queued until a worker drops them; wait for that, so a worker
+    // is free to start one of our tiles
+    while (store->executor().pendingTasks() > 0) std::this_thread::yield();
+    SlowWorkers reducer(std::this_thread::get_id());
+    QueryOptions options;
+    auto start = std::chrono::steady_clock::now();
+    options.deadline = start + std::chrono::milliseconds(100);
+    Query query(store, Box::ofWorld(), FeatureTypes::NODES,
+        store->borrowAllMatcher(), nullptr, &reducer, nullptr, options);
+    // The consumer runs out of tiles to help with long before the
+    // workers complete theirs, and then waits no longer than the deadline
+    REQUIRE(query.next().isNull());
+    REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(800));
+    REQUIRE(!query.isComplete());
+}
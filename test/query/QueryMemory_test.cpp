@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+uint64_t countAll(FeatureStore* store, const QueryOptions& options)
+{
+    Query query(store, Box::ofWorld(), FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, nullptr, options);
+    uint64_t count = 0;
+    while (!query.next().isNull()) count++;
+    return count;
+}
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 500;
+    settings.buildingsPerTile = 500;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Query memory accounting and limits")
+{
+    FeatureStore* store = world.store();
+
+    uint64_t expected = countAll(store, {});
+    REQUIRE(expected > 0);
+    REQUIRE(store->queryMemory() == 0);
+
+    {
+        Query query(store, Box::ofWorld(), FeatureTypes::ALL,
+            store->borrowAllMatcher(), nullptr);
+        REQUIRE(!query.next().isNull());
+        REQUIRE(query.memoryUsed() > 0);
+        REQUIRE(store->memoryUsage().queries == query.memoryUsed());
+        clarisma::MetricsSnapshot metrics = store->metrics().snapshot();
+        REQUIRE(metrics.valueOf("geodesk_query_memory_bytes") == query.memoryUsed());
+    }
+    REQUIRE(store->queryMemory() == 0);
+
+    // Tight limits only slow a query down (it keeps a single
+    // tile in flight until its results have been consumed)
+    QueryOptions options;
+    options.memoryLimit = 4096;
+    REQUIRE(countAll(store, options) == expected);
+    store->setQueryMemoryLimit(4096);
+    REQUIRE(world.count() == expected);
+    store->setQueryMemoryLimit(0);
+    REQUIRE(store->queryMemory() == 0);
+
+    store->enableQueryCache(1 << 20);
+    REQUIRE(countAll(store, {}) == expected);
+    REQUIRE(store->memoryUsage().queryCache > 0);
+    REQUIRE(store->metrics().snapshot().valueOf("geodesk_cache_memory_bytes") > 0);
+}
@@ -0,0 +1,52 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/query/QueryPlanner.h>
+
+using namespace geodesk;
+
+namespace {
+
+QueryPlanner::Sample sample(uint32_t matcherCalls, uint32_t matcherAccepts,
+    uint32_t filterCalls, uint32_t filterAccepts)
+{
+    QueryPlanner::Sample s;
+    s.matcherCalls = matcherCalls;
+    s.matcherAccepts = matcherAccepts;
+    s.filterCalls = filterCalls;
+    s.filterAccepts = filterAccepts;
+    return s;
+}
+
+}
+
+TEST_CASE("QueryPlanner runs the matcher first until it has enough samples")
+{
+    QueryPlanner planner(2);
+    planner.addSample(sample(100, 90, 90, 1));
+    REQUIRE(!planner.filterFirst());
+}
+
+TEST_CASE("QueryPlanner moves a selective filter ahead of the matcher")
+{
+    QueryPlanner planner(2);
+    // Matcher rejects 10%, filter (twice the cost) rejects 99%
+    planner.addSample(sample(1000, 900, 900, 9));
+    REQUIRE(planner.filterFirst());
+}
+
+TEST_CASE("QueryPlanner keeps an expensive filter behind a selective matcher")
+{
+    QueryPlanner planner(8);
+    // Matcher rejects 95%, filter rejects 50%
+    planner.addSample(sample(1000, 50, 500, 250));
+    REQUIRE(!planner.filterFirst());
+}
+
+TEST_CASE("QueryPlanner runs a matcher that rejects nothing last")
+{
+    QueryPlanner planner(8);
+    planner.addSample(sample(1000, 1000, 1000, 500));
+    REQUIRE(planner.filterFirst());
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <memory>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Parser.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/QueryRecorder.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+TEST_CASE("RecordedQuery log format round trip")
+{
+    RecordedQuery q;
+    q.start = 1234;
+    q.consumption = RecordedQuery::Consumption::COUNT;
+    q.results = 42;
+    q.nanos = 99000;
+    q.view = View::MEMBERS;
+    q.types = FeatureTypes::WAYS;
+    q.relatedId = static_cast<uint64_t>(TypedFeatureId::ofTypeAndId(FeatureType::RELATION, 7));
+    geodesk::Filter::Source source;
+    source.xy = Coordinate(100, -200);
+    source.meters = 250;
+    q.filters.push_back({ "max_meters_from", source });
+    q.usesMatcher = true;
+    q.query = std::string("w[name=\"a\tb\"]") + '\0' + "w[highway]";
+
+    std::string line;
+    q.format(line);
+    REQUIRE(line.back() == '\n');
+    line.pop_back();
+    REQUIRE(line.find('\n') == std::string::npos);
+    RecordedQuery p = RecordedQuery::parse(line);
+    REQUIRE(p.start == 1234);
+    REQUIRE(p.consumption == RecordedQuery::Consumption::COUNT);
+    REQUIRE(p.results == 42);
+    REQUIRE(p.nanos == 99000);
+    REQUIRE(p.view == View::MEMBERS);
+    REQUIRE(p.types == FeatureTypes::WAYS);
+    REQUIRE(p.relatedId == q.relatedId);
+    REQUIRE(p.filters.size() == 1);
+    REQUIRE(p.filters[0].name == "max_meters_from");
+    REQUIRE(p.filters[0].source.typedId == 0);
+    REQUIRE(p.filters[0].source.xy == source.xy);
+    REQUIRE(p.filters[0].source.meters == 250);
+    REQUIRE(p.query == q.query);
+    REQUIRE(p.isReplayable());
+
+    REQUIRE_THROWS_AS(RecordedQuery::parse("1\t0\tsomething"), clarisma::ParseException);
+}
+
+TEST_CASE("QueryRecorder records queries that replay to the same results")
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 500;
+    settings.buildingsPerTile = 500;
+    SyntheticGol gol(settings);
+    std::string logFile = gol.fileName() + ".log";
+
+    Features world(gol.fileName().c_str());
+    FeatureStore* store = world.store();
+    store->setRecorder(std::make_shared<QueryRecorder>(logFile.c_str()));
+
+    uint64_t restaurants = world("na[amenity=restaurant]").count();
+    Box box = Box::ofWSEN(7.42, 43.72, 7.45, 43.74);
+    uint64_t inBox = 0;
+    for (Feature f : world("w[highway]")(box)) inBox++;
+    std::optional<Feature> route = world("r[route]").first();
+    REQUIRE(route.has_value());
+    uint64_t members = world.membersOf(*route).count();
+    Coordinate center = box.center();
+    uint64_t nearby = world("n").maxMetersFrom(500, center).count();
+    int partial = 0;
+    for (Feature f : world("a[building]"))
+    {
+        if (++partial == 10) break;
+    }
+    store->setRecorder(nullptr);       // flushes the log
+
+    std::vector<RecordedQuery> log = QueryRecorder::load(logFile.c_str());
+    REQUIRE(log.size() == 6);
+    REQUIRE(log[0].consumption == RecordedQuery::Consumption::COUNT);
+    REQUIRE(log[0].results == restaurants);
+    REQUIRE(log[1].consumption == RecordedQuery::Consumption::ITERATE);
+    REQUIRE(log[1].complete);
+    REQUIRE(log[1].results == inBox);
+    REQUIRE(log[1].bounds == box);
+    REQUIRE(!log[2].complete);
+    REQUIRE(log[2].results == 1);
+    REQUIRE(log[3].view == View::MEMBERS);
+    REQUIRE(log[3].results == members);
+    REQUIRE(log[4].filters.size() == 1);
+    REQUIRE(log[4].results == nearby);
+    REQUIRE(!log[5].complete);
+    REQUIRE(log[5].results == 10);
+
+    for (const RecordedQuery& q : log)
+    {
+        REQUIRE(q.isReplayable());
+        View view = q.toView(store);
+        REQUIRE(q.replay(view) == q.results);
+    }
+}
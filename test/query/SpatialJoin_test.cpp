@@ -0,0 +1,89 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <set>
+#include <utility>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+using PairSet = std::set<std::pair<int64_t,int64_t>>;
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 400;
+    settings.streetsPerTile = 40;
+    settings.buildingsPerTile = 200;
+    settings.multipolygonsPerTile = 4;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.5, 44.0);
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+PairSet join(const Features& a, const Features& b,
+    SpatialPredicate predicate, double meters = 0)
+{
+    PairSet pairs;
+    size_t count = 0;
+    a.join(b, predicate, [&pairs, &count](Feature x, Feature y)
+    {
+        pairs.emplace(x.id(), y.id());
+        count++;
+    }, meters);
+    CHECK(count == pairs.size());      // no pair may be reported twice
+    return pairs;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Spatial join matches a nested loop of queries")
+{
+    Features places = world("n[amenity]");
+    Features landuse = world("a[landuse]");
+    Features buildings = world("a[building]");
+    Features streets = world("w[highway]");
+    REQUIRE(places.count() > 0);
+    REQUIRE(landuse.count() > 0);
+
+    PairSet expected;
+    for (Feature area : landuse)
+    {
+        for (Feature place : places.within(area)) expected.emplace(place.id(), area.id());
+    }
+    REQUIRE(!expected.empty());
+    REQUIRE(join(places, landuse, SpatialPredicate::WITHIN) == expected);
+
+    PairSet reversed;
+    for (const auto& [place, area] : expected) reversed.emplace(area, place);
+    REQUIRE(join(landuse, places, SpatialPredicate::CONTAINS) == reversed);
+
+    expected.clear();
+    for (Feature street : streets)
+    {
+        for (Feature building : buildings.intersecting(street))
+        {
+            expected.emplace(street.id(), building.id());
+        }
+    }
+    REQUIRE(join(streets, buildings, SpatialPredicate::INTERSECTS) == expected);
+
+    expected.clear();
+    for (Feature building : buildings)
+    {
+        for (Feature place : places.maxMetersFrom(25, building))
+        {
+            expected.emplace(place.id(), building.id());
+        }
+    }
+    REQUIRE(!expected.empty());
+    REQUIRE(join(places, buildings, SpatialPredicate::MAX_DISTANCE, 25) == expected);
+
+    REQUIRE_THROWS_AS(join(streets.first()->nodes(), places,
+        SpatialPredicate::INTERSECTS), QueryException);
+}
@@ -0,0 +1,116 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/geom/index/hilbert.h>
+#include <geodesk/query/SpilledFeatures.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 200;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+std::vector<uint64_t> sortedIds(const std::vector<uint64_t>& ids)
+{
+    std::vector<uint64_t> sorted = ids;
+    std::sort(sorted.begin(), sorted.end());
+    return sorted;
+}
+
+} // namespace
+
+TEST_CASE_METHOD(World, "SpilledFeatures writes runs and merges them")
+{
+    std::vector<uint64_t> expected;
+    for (Feature f : world) expected.push_back(f.ptr().typedId());
+    expected = sortedIds(expected);
+    REQUIRE(expected.size() > 10'000);
+
+    // A tiny budget (1024 features per run)
+    SpilledFeatures spilled(world.store(), SpilledFeatures::Order::ID, 0);
+    world.addTo(spilled);
+    REQUIRE(spilled.size() == expected.size());
+    REQUIRE(spilled.spilledRuns() >= 9);
+
+    std::vector<uint64_t> ids;
+    spilled.forEach([&ids](Feature f) { ids.push_back(f.ptr().typedId()); });
+    REQUIRE(ids == expected);
+
+    // Reading again yields the same
+    ids.clear();
+    spilled.forEach([&ids](Feature f) { ids.push_back(f.ptr().typedId()); });
+    REQUIRE(ids == expected);
+
+    spilled.clear();
+    REQUIRE(spilled.isEmpty());
+    REQUIRE(spilled.spilledRuns() == 0);
+}
+
+TEST_CASE_METHOD(World, "SpilledFeatures in the order in which they were added")
+{
+    Features buildings = world("a[building]");
+    SpilledFeatures spilled(world.store(), SpilledFeatures::Order::NONE, 0);
+    std::vector<uint64_t> added;
+    Query query(world.store(), Box::ofWorld(), FeatureTypes::AREAS,
+        world.store()->borrowAllMatcher(), nullptr);
+    for (;;)
+    {
+        FeaturePtr next = query.next();
+        if (next.isNull()) break;
+        spilled.add(query.currentTip(), query.currentTile(), next);
+        added.push_back(next.typedId());
+    }
+    REQUIRE(spilled.spilledRuns() > 0);
+    std::vector<uint64_t> ids;
+    spilled.forEach([&ids](Feature f) { ids.push_back(f.ptr().typedId()); });
+    REQUIRE(ids == added);
+
+    // Features stay usable
+    SpilledFeatures spilledBuildings(world.store());
+    buildings.addTo(spilledBuildings);
+    uint64_t count = 0;
+    spilledBuildings.forEach([&count](Feature f)
+    {
+        if (f.hasTag("building")) count++;
+    });
+    REQUIRE(count == buildings.count());
+    REQUIRE(spilledBuildings.spilledRuns() == 0);
+}
+
+TEST_CASE_METHOD(World, "SpilledFeatures sorted by Hilbert distance")
+{
+    SpilledFeatures spilled(world.store(), SpilledFeatures::Order::HILBERT, 0);
+    world.addTo(spilled);
+    REQUIRE(spilled.spilledRuns() > 0);
+    uint32_t prev = 0;
+    bool ordered = true;
+    uint64_t count = 0;
+    spilled.forEach([&](Feature f)
+    {
+        Coordinate center = f.isNode() ? f.xy() : f.bounds().center();
+        uint32_t d = hilbert::calculateHilbertDistance(center, Box::ofWorld());
+        if (d < prev) ordered = false;
+        prev = d;
+        count++;
+    });
+    REQUIRE(ordered);
+    REQUIRE(count == world.count());
+
+    // The nodes of a way can't be spilled
+    Feature way = *world.ways().first();
+    REQUIRE_THROWS_AS(way.nodes().addTo(spilled), QueryException);
+}
@@ -0,0 +1,75 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+uint64_t countAll(FeatureStore* store, QueryStats& stats, bool ordered)
+{
+    QueryOptions options;
+    options.ordered = ordered;
+    Query query(store, Box::ofWorld(), FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, &stats, options);
+    uint64_t count = 0;
+    while (!query.next().isNull()) count++;
+    return count;
+}
+
+GolGenerator::Settings largeTileSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 8000;
+    settings.streetsPerTile = 3000;
+    settings.buildingsPerTile = 8000;
+    settings.bounds = Box::ofWSEN(7.40, 43.70, 7.43, 43.72);
+    return settings;
+}
+
+using LargeTiles = SyntheticGolFixture<largeTileSettings>;
+
+GolGenerator::Settings smallTileSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 20;
+    settings.streetsPerTile = 2;
+    settings.buildingsPerTile = 2;
+    return settings;
+}
+
+using SmallTiles = SyntheticGolFixture<smallTileSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(LargeTiles, "Large tiles are split among tasks")
+{
+    QueryStats orderedStats;
+    uint64_t expected = countAll(world.store(), orderedStats, true);
+    REQUIRE(expected > 0);
+    REQUIRE(orderedStats.tilesSplit == 0);
+
+    QueryStats stats;
+    REQUIRE(countAll(world.store(), stats, false) == expected);
+    REQUIRE(stats.tilesSplit > 0);
+    REQUIRE(stats.tilesScanned == orderedStats.tilesScanned);
+    REQUIRE(world.nodes().count() + world.ways().count() +
+        world.relations().count() == expected);
+}
+
+TEST_CASE_METHOD(SmallTiles, "Small tiles are coalesced into one task")
+{
+    QueryStats orderedStats;
+    uint64_t expected = countAll(world.store(), orderedStats, true);
+    REQUIRE(expected > 0);
+
+    QueryStats stats;
+    REQUIRE(countAll(world.store(), stats, false) == expected);
+    REQUIRE(stats.tilesCoalesced > 0);
+    REQUIRE(stats.tilesScanned == orderedStats.tilesScanned);
+    REQUIRE(stats.toString().find("tiles coalesced") != std::string::npos);
+}
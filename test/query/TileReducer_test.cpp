@@ -0,0 +1,47 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <atomic>
+#include <stdexcept>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 200;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.6, 44.0);
+    return settings;
+}
+
+using World = SyntheticGolFixture<worldSettings>;
+
+} // namespace
+
+TEST_CASE_METHOD(World, "Exceptions thrown on worker threads reach the caller")
+{
+    uint64_t count = world.count();
+    REQUIRE(count > 0);
+
+    std::atomic<uint64_t> visited(0);
+    REQUIRE_THROWS_AS(world.parallelForEach([&visited](Feature)
+    {
+        if (visited.fetch_add(1) == 100) throw std::runtime_error("failed");
+    }), std::runtime_error);
+
+    REQUIRE_THROWS_AS(world.reduce(uint64_t{0},
+        [](Feature f) -> uint64_t
+        {
+            if (f.id() % 50 == 7) throw std::runtime_error("failed");
+            return 1;
+        },
+        [](uint64_t a, uint64_t b) { return a + b; }), std::runtime_error);
+
+    // The store remains usable
+    REQUIRE(world.count() == count);
+}
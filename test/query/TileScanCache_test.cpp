@@ -0,0 +1,118 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/query/Query.h>
+#include <geodesk/query/TileScanCache.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings worldSettings()
+{
+    GolGenerator::Settings settings = SyntheticGol::defaultSettings();
+    settings.nodesPerTile = 300;
+    settings.streetsPerTile = 100;
+    settings.buildingsPerTile = 100;
+    settings.multipolygonsPerTile = 5;
+    settings.multiTileShare = 0.3;
+    return settings;
+}
+
+/// Opens one of two identical worlds (the tile scan cache is enabled
+/// per store, so comparing against a world without one needs a second
+/// file)
+Features openWorld(bool second = false)
+{
+    static const SyntheticGol first(worldSettings());
+    static const SyntheticGol other(worldSettings());
+    return Features((second ? other.fileName() : first.fileName()).c_str());
+}
+
+std::vector<uint64_t> typedIds(const Features& features)
+{
+    std::vector<uint64_t> ids;
+    for (Feature f : features) ids.push_back(f.ptr().typedId());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+uint64_t countAll(FeatureStore* store, const Box& box, QueryStats& stats)
+{
+    Query query(store, box, FeatureTypes::ALL,
+        store->borrowAllMatcher(), nullptr, nullptr, &stats);
+    uint64_t count = 0;
+    while (!query.next().isNull()) count++;
+    return count;
+}
+
+} // namespace
+
+TEST_CASE("Queries find the same features in transcoded tiles")
+{
+    Features world = openWorld();
+    Features plain = openWorld(true);
+    world.store()->enableTileScanCache(64 * 1024 * 1024, 1);
+    REQUIRE(world.store()->tileScanCache() != nullptr);
+    REQUIRE(plain.store()->tileScanCache() == nullptr);
+
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+    Box point = Box::ofWSEN(7.5, 44.0, 7.5001, 44.0001);
+    for (int run = 0; run < 2; run++)
+    {
+        for (const char* query : { "*", "n", "w[highway]", "na[amenity]",
+            "a[building]", "r", "w[highway=residential]", "n[!amenity]" })
+        {
+            REQUIRE(typedIds(world(query)) == typedIds(plain(query)));
+            REQUIRE(typedIds(world(query)(bounds)) == typedIds(plain(query)(bounds)));
+            REQUIRE(typedIds(world(query)(point)) == typedIds(plain(query)(point)));
+        }
+        REQUIRE((typedIds(world.ways().maxMetersFromLonLat(200, 7.5, 44.0)) ==
+            typedIds(plain.ways().maxMetersFromLonLat(200, 7.5, 44.0))));
+    }
+    REQUIRE(world.store()->tileScanCache()->bytes() > 0);
+    REQUIRE(world.store()->memoryUsage().tileScanCache ==
+        world.store()->tileScanCache()->bytes());
+}
+
+TEST_CASE("Only tiles scanned often enough are transcoded")
+{
+    Features world = openWorld();
+    FeatureStore* store = world.store();
+    store->enableTileScanCache(64 * 1024 * 1024, 2);
+    Box bounds = Box::ofWSEN(7.2, 43.7, 7.6, 44.1);
+
+    QueryStats first;
+    uint64_t expected = countAll(store, bounds, first);
+    REQUIRE(expected > 0);
+    REQUIRE(first.tilesTranscoded == 0);
+    REQUIRE(store->tileScanCache()->bytes() == 0);
+
+    QueryStats second;
+    REQUIRE(countAll(store, bounds, second) == expected);
+    REQUIRE(second.tilesTranscoded > 0);
+    REQUIRE(store->tileScanCache()->bytes() > 0);
+    REQUIRE(second.toString().find("transcoded") != std::string::npos);
+
+    store->enableTileScanCache(0);
+    REQUIRE(store->tileScanCache() == nullptr);
+}
+
+TEST_CASE("The tile scan cache stays within its budget")
+{
+    Features world = openWorld();
+    FeatureStore* store = world.store();
+    size_t budget = TileScanCache::SHARD_COUNT * 64 * 1024;
+    store->enableTileScanCache(budget, 1);
+    Features inBounds = world(Box::ofWSEN(7.1, 43.6, 7.9, 44.4));
+    std::vector<uint64_t> expected = typedIds(inBounds);
+    REQUIRE(!expected.empty());
+    for (int run = 0; run < 3; run++) REQUIRE(typedIds(inBounds) == expected);
+    REQUIRE(store->tileScanCache()->bytes() <= budget);
+}
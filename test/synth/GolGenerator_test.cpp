@@ -0,0 +1,110 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <cstring>
+#include <filesystem>
+#include <unordered_set>
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/io/File.h>
+#include <geodesk/geodesk.h>
+#include <geodesk/synth/GolGenerator.h>
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings smallSettings()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 300;
+    settings.streetsPerTile = 200;
+    settings.buildingsPerTile = 300;
+    settings.multipolygonsPerTile = 6;
+    settings.routesPerTile = 3;
+    settings.multiTileShare = 0.25;
+    return settings;
+}
+
+std::string tempGol(const char* name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+bool haveSameContents(const std::string& a, const std::string& b)
+{
+    clarisma::ByteBlock dataA = clarisma::File::readAll(a.c_str());
+    clarisma::ByteBlock dataB = clarisma::File::readAll(b.c_str());
+    return dataA.size() == dataB.size() &&
+        memcmp(dataA.data(), dataB.data(), dataA.size()) == 0;
+}
+
+}
+
+TEST_CASE("GolGenerator: features can be queried")
+{
+    GolGenerator::Settings settings = smallSettings();
+    std::string fileName = tempGol("golgenerator_test.gol");
+    GolGenerator::Stats stats = GolGenerator(settings).generate(fileName.c_str());
+    REQUIRE(stats.multiTileWays > 0);
+    {
+        Features world(fileName.c_str());
+        REQUIRE(world.store()->verify().isValid());
+
+        // Multi-tile ways are only counted once
+        REQUIRE(world("n").count() == stats.nodes);
+        REQUIRE(world("w").count() == stats.ways);
+        REQUIRE(world("a").count() == stats.areas);
+        REQUIRE(world("r").count() == stats.relations);
+        std::unordered_set<uint64_t> ids;
+        for (Feature way : world("w")) ids.insert(way.id());
+        REQUIRE(ids.size() == stats.ways);
+
+        REQUIRE(world("na[amenity=restaurant]").count() > 0);
+        REQUIRE(world("w[highway=residential][maxspeed<60]").count() > 0);
+        REQUIRE(world("na[name~\".*stra(ss|ß)e\"]").count() == 0);
+        REQUIRE(world("w[name~\".*stra(ss|ß)e\"]").count() > 0);
+        REQUIRE(world("n[place][population>10000]").count() > 0);
+
+        int multipolygons = 0;
+        for (Feature rel : world("a[type=multipolygon]"))
+        {
+            REQUIRE(rel.isRelation());
+            REQUIRE(rel.area() > 0);
+            for (Feature member : rel.members())
+            {
+                REQUIRE(member.belongsToRelation());
+                REQUIRE(member.parents().relations().count() == 1);
+            }
+            multipolygons++;
+        }
+        REQUIRE(multipolygons == stats.areas - world("a[building]").count());
+
+        for (Feature route : world("r[type=route]"))
+        {
+            REQUIRE(route.members().count() >= settings.minRelationMembers);
+            uint64_t stops = 0;
+            for (Feature member : route.members())
+            {
+                if (member.role() == "stop") stops++;
+            }
+            REQUIRE(route.members()("n").count() == stops);
+        }
+    }
+    std::filesystem::remove(fileName);
+}
+
+TEST_CASE("GolGenerator: output depends only on the settings")
+{
+    GolGenerator::Settings settings = smallSettings();
+    settings.seed = 42;
+    std::string a = tempGol("golgenerator_test_a.gol");
+    std::string b = tempGol("golgenerator_test_b.gol");
+    GolGenerator(settings).generate(a.c_str());
+    GolGenerator(settings).generate(b.c_str());
+    REQUIRE(haveSameContents(a, b));
+    settings.seed = 43;
+    GolGenerator(settings).generate(b.c_str());
+    REQUIRE_FALSE(haveSameContents(a, b));
+    std::filesystem::remove(a);
+    std::filesystem::remove(b);
+}
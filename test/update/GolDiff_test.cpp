@@ -0,0 +1,158 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <catch2/catch_test_macros.hpp>
+#include <geodesk/geodesk.h>
+#include <geodesk/update/GolDiff.h>
+#include "../SyntheticGol.h"
+
+using namespace geodesk;
+
+namespace {
+
+GolGenerator::Settings smallWorld()
+{
+    GolGenerator::Settings settings;
+    settings.nodesPerTile = 100;
+    settings.streetsPerTile = 50;
+    settings.buildingsPerTile = 50;
+    settings.multipolygonsPerTile = 4;
+    settings.multiTileShare = 0.3;
+    settings.bounds = Box::ofWSEN(7.0, 43.5, 7.6, 44.0);
+    return settings;
+}
+
+/// The tags and geometry (or members) of each feature, by typed ID
+std::map<uint64_t, std::string> describe(const Features& features)
+{
+    std::map<uint64_t, std::string> result;
+    for (Feature f : features)
+    {
+        std::vector<std::pair<std::string, std::string>> tags;
+        for (Tag tag : f.tags())
+        {
+            tags.emplace_back(std::string(tag.key()), std::string(tag.value()));
+        }
+        std::sort(tags.begin(), tags.end());
+        std::string s;
+        for (const auto& [k, v] : tags) s += k + "=" + v + ";";
+        if (f.isRelation())
+        {
+            for (Feature member : f.members())
+            {
+                s += std::string(typeName(member.type())) + std::to_string(member.id()) +
+                    "@" + std::string(member.role()) + ",";
+            }
+        }
+        else
+        {
+            s += f.toString() + (f.isArea() ? "A" : "") + ":";
+            if (f.isNode())
+            {
+                s += std::to_string(f.x()) + "," + std::to_string(f.y());
+            }
+            else
+            {
+                for (Feature node : f.nodes())
+                {
+                    s += std::to_string(node.x()) + "," + std::to_string(node.y()) + " ";
+                }
+            }
+        }
+        result[f.ptr().typedId()] = s;
+    }
+    return result;
+}
+
+std::vector<uint64_t> typedIds(const std::vector<TypedFeatureId>& ids)
+{
+    std::vector<uint64_t> result;
+    for (TypedFeatureId id : ids) result.push_back(static_cast<uint64_t>(id));
+    return result;
+}
+
+/// Checks the diff against a comparison of all features
+void checkDiff(const Features& oldWorld, const Features& newWorld, const GolDiff::Result& diff)
+{
+    std::map<uint64_t, std::string> oldFeatures = describe(oldWorld);
+    std::map<uint64_t, std::string> newFeatures = describe(newWorld);
+    std::vector<uint64_t> created, modified, deleted;
+    for (const auto& [id, s] : newFeatures)
+    {
+        auto it = oldFeatures.find(id);
+        if (it == oldFeatures.end())
+        {
+            created.push_back(id);
+        }
+        else if (it->second != s)
+        {
+            modified.push_back(id);
+        }
+    }
+    for (const auto& [id, s] : oldFeatures)
+    {
+        if (newFeatures.count(id) == 0) deleted.push_back(id);
+    }
+    REQUIRE(typedIds(diff.created) == created);
+    REQUIRE(typedIds(diff.modified) == modified);
+    REQUIRE(typedIds(diff.deleted) == deleted);
+}
+
+} // namespace
+
+TEST_CASE("Identical GOLs have no differences")
+{
+    GolGenerator::Settings settings = smallWorld();
+    SyntheticGol oldGol(settings);
+    Features oldWorld(oldGol.fileName().c_str());
+    SyntheticGol newGol(settings);
+    Features newWorld(newGol.fileName().c_str());
+    GolDiff::Result diff = GolDiff::compare(oldWorld.store(), newWorld.store(), 2);
+    REQUIRE(diff.tiles > 1);
+    REQUIRE(diff.unchangedTiles == diff.tiles);
+    REQUIRE(diff.created.empty());
+    REQUIRE(diff.modified.empty());
+    REQUIRE(diff.deleted.empty());
+}
+
+TEST_CASE("Only the tiles that changed are compared")
+{
+    GolGenerator::Settings settings = smallWorld();
+    SyntheticGol oldGol(settings);
+    Features oldWorld(oldGol.fileName().c_str());
+    // New rows of tiles to the south: the IDs of the existing tiles
+    // stay the same, but streets of the last row now cross into them
+    settings.bounds = Box::ofWSEN(7.0, 43.2, 7.6, 44.0);
+    SyntheticGol newGol(settings);
+    Features newWorld(newGol.fileName().c_str());
+    GolDiff::Result diff = GolDiff::compare(oldWorld.store(), newWorld.store());
+    REQUIRE(diff.unchangedTiles > 0);
+    REQUIRE(diff.unchangedTiles < diff.tiles);
+    REQUIRE(!diff.created.empty());
+    checkDiff(oldWorld, newWorld, diff);
+
+    // ... and the other way around
+    GolDiff::Result reverse = GolDiff::compare(newWorld.store(), oldWorld.store(), 3);
+    REQUIRE(reverse.created == diff.deleted);
+    REQUIRE(reverse.deleted == diff.created);
+    REQUIRE(reverse.modified == diff.modified);
+}
+
+TEST_CASE("Changed tags and geometries are modifications")
+{
+    GolGenerator::Settings settings = smallWorld();
+    SyntheticGol oldGol(settings);
+    Features oldWorld(oldGol.fileName().c_str());
+    settings.optionalTagShare = 0.6;
+    settings.maxStreetLength = 30;
+    SyntheticGol newGol(settings);
+    Features newWorld(newGol.fileName().c_str());
+    GolDiff::Result diff = GolDiff::compare(oldWorld.store(), newWorld.store());
+    REQUIRE(!diff.modified.empty());
+    checkDiff(oldWorld, newWorld, diff);
+}
@@ -0,0 +1,69 @@
+// Copyright (c) 2024 Clarisma / GeoDesk contributors
+// SPDX-License-Identifier: LGPL-3.0-only
+
+#include <catch2/catch_test_macros.hpp>
+#include <clarisma/util/Parser.h>
+#include <geodesk/update/OsmChange.h>
+
+using namespace geodesk;
+
+TEST_CASE("Parse an OSM change file")
+{
+    const char* xml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<osmChange version="0.6" generator="test">
+  <!-- a comment with <node> inside -->
+  <create>
+    <node id="10" version="1" lat="43.7384" lon="7.4246">
+      <tag k="name" v="Caf&#233; &amp; Bar"/>
+    </node>
+  </create>
+  <modify>
+    <way id="20" version="3">
+      <nd ref="10"/>
+      <nd ref="11"/>
+      <tag k="highway" v="residential"/>
+    </way>
+    <relation id="30" version="2">
+      <member type="way" ref="20" role="outer"/>
+      <member type="node" ref="10" role=""/>
+    </relation>
+  </modify>
+  <delete>
+    <node id="12" version="5"/>
+  </delete>
+</osmChange>)";
+
+    OsmChange change = OsmChange::parse(xml);
+    const auto& elements = change.elements();
+    REQUIRE(elements.size() == 4);
+
+    REQUIRE(elements[0].action == OsmChange::Action::CREATE);
+    REQUIRE(elements[0].type == FeatureType::NODE);
+    REQUIRE(elements[0].id == 10);
+    REQUIRE(elements[0].xy == Coordinate::ofLonLat(7.4246, 43.7384));
+    REQUIRE(elements[0].tags.size() == 1);
+    REQUIRE(elements[0].tags[0].second == "Caf\xC3\xA9 & Bar");
+
+    REQUIRE(elements[1].action == OsmChange::Action::MODIFY);
+    REQUIRE(elements[1].type == FeatureType::WAY);
+    REQUIRE((elements[1].nodeIds == std::vector<uint64_t>{ 10, 11 }));
+    REQUIRE(elements[1].tags[0].first == "highway");
+
+    REQUIRE(elements[2].type == FeatureType::RELATION);
+    REQUIRE(elements[2].members.size() == 2);
+    REQUIRE(elements[2].members[0].type == FeatureType::WAY);
+    REQUIRE(elements[2].members[0].id == 20);
+    REQUIRE(elements[2].members[0].role == "outer");
+
+    REQUIRE(elements[3].action == OsmChange::Action::DELETE);
+    REQUIRE(elements[3].id == 12);
+    REQUIRE(elements[3].tags.empty());
+}
+
+TEST_CASE("Reject a malformed OSM change file")
+{
+    REQUIRE_THROWS_AS(OsmChange::parse("<osmChange><node id=\"1\"/></osmChange>"),
+        clarisma::ParseException);
+    REQUIRE_THROWS_AS(OsmChange::parse("<osmChange><create><node id=\"x\"/></create></osmChange>"),
+        clarisma::ParseException);
+}